@@ -0,0 +1,269 @@
+#include "colmap/estimators/bundle_adjustment.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/math/random.h"
+#include "colmap/scene/camera.h"
+#include "colmap/scene/camera_rig.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/scene/synthetic.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <ceres/ceres.h>
+
+using namespace colmap;
+
+// Number of images and 3D points of the synthetic problems. All 3D points are
+// observed by almost all images of `SynthesizeDataset`, such that the number
+// of points decreases with the number of images to bound the observations.
+const std::vector<std::pair<int, int>> kProblemScales = {
+    {100, 1000}, {1000, 500}, {10000, 100}};
+
+const std::vector<CameraModelId> kCameraModelIds = {
+    SimpleRadialCameraModel::model_id,
+    PinholeCameraModel::model_id,
+    OpenCVCameraModel::model_id};
+
+const std::vector<ceres::LinearSolverType> kLinearSolverTypes = {
+    ceres::DENSE_SCHUR, ceres::SPARSE_SCHUR, ceres::ITERATIVE_SCHUR};
+
+// The reduced camera systems of the synthetic scenes are dense, such that the
+// direct solvers are only benchmarked for moderately sized problems.
+constexpr int kMaxNumImagesDirectSolver = 1000;
+
+// Fixed number of solver iterations for comparable timings.
+constexpr int kNumSolverIterations = 10;
+
+struct BundleAdjustmentProblem {
+  Reconstruction reconstruction;
+  BundleAdjustmentConfig config;
+  std::vector<CameraRig> camera_rigs;
+};
+
+// Creates a synthetic scene with noisy observations and perturbed 3D points,
+// such that the solver requires several iterations. For rigs, consecutive
+// pairs of images form the snapshots of a rig with two cameras.
+static BundleAdjustmentProblem CreateProblem(const int num_images,
+                                             const int num_points3D,
+                                             const CameraModelId model_id,
+                                             const bool use_rig) {
+  SetPRNGSeed(num_images);
+
+  SyntheticDatasetOptions options;
+  options.num_cameras = use_rig ? 2 : 1;
+  options.num_images = num_images;
+  options.num_points3D = num_points3D;
+  options.camera_model_id = model_id;
+  options.camera_params = Camera::CreateFromModelId(kInvalidCameraId,
+                                                    model_id,
+                                                    1280,
+                                                    options.camera_width,
+                                                    options.camera_height)
+                              .params;
+  options.num_points2D_without_point3D = 0;
+
+  BundleAdjustmentProblem problem;
+  Reconstruction& reconstruction = problem.reconstruction;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::vector<image_t>& image_ids = reconstruction.RegImageIds();
+  if (use_rig) {
+    const Rigid3d cam2_from_rig(
+        Eigen::Quaterniond(Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitY())),
+        Eigen::Vector3d(0.2, 0, 0));
+    CameraRig& camera_rig = problem.camera_rigs.emplace_back();
+    camera_rig.AddCamera(reconstruction.Image(image_ids[0]).CameraId(),
+                         Rigid3d());
+    camera_rig.AddCamera(reconstruction.Image(image_ids[1]).CameraId(),
+                         cam2_from_rig);
+    camera_rig.SetRefCameraId(reconstruction.Image(image_ids[0]).CameraId());
+    for (size_t i = 0; i + 1 < image_ids.size(); i += 2) {
+      reconstruction.Image(image_ids[i + 1]).CamFromWorld() =
+          cam2_from_rig * reconstruction.Image(image_ids[i]).CamFromWorld();
+      camera_rig.AddSnapshot({image_ids[i], image_ids[i + 1]});
+    }
+  }
+
+  for (const image_t image_id : image_ids) {
+    Image& image = reconstruction.Image(image_id);
+    const Camera& camera = reconstruction.Camera(image.CameraId());
+    for (Point2D& point2D : image.Points2D()) {
+      const Eigen::Vector3d& xyz =
+          reconstruction.Point3D(point2D.point3D_id).xyz;
+      point2D.xy =
+          camera.ImgFromCam((image.CamFromWorld() * xyz).hnormalized()) +
+          Eigen::Vector2d(RandomGaussian<double>(0, 0.5),
+                          RandomGaussian<double>(0, 0.5));
+    }
+    problem.config.AddImage(image_id);
+  }
+
+  for (const point3D_t point3D_id : reconstruction.Point3DIds()) {
+    reconstruction.Point3D(point3D_id).xyz += 0.01 * Eigen::Vector3d::Random();
+  }
+
+  if (!use_rig) {
+    problem.config.SetConstantCamPose(image_ids[0]);
+    problem.config.SetConstantCamPositions(image_ids[1], {0});
+  }
+
+  return problem;
+}
+
+// Forces the given linear solver through the thresholds of the automatic
+// solver selection and uses the given number of threads for all problems. The
+// telemetry of all adjustments is accumulated in the given total.
+static BundleAdjustmentOptions CreateOptions(
+    const ceres::LinearSolverType linear_solver_type,
+    const int num_threads,
+    BundleAdjustmentTelemetry* total_telemetry) {
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+  options.min_num_residuals_for_multi_threading = 0;
+  options.solver_options.num_threads = num_threads;
+  options.solver_options.max_num_iterations = kNumSolverIterations;
+  options.max_num_images_direct_dense_cpu_solver = 0;
+  options.max_num_images_direct_sparse_cpu_solver = 0;
+  switch (linear_solver_type) {
+    case ceres::DENSE_SCHUR:
+      options.max_num_images_direct_dense_cpu_solver =
+          std::numeric_limits<int>::max();
+      break;
+    case ceres::SPARSE_SCHUR:
+      options.max_num_images_direct_sparse_cpu_solver =
+          std::numeric_limits<int>::max();
+      break;
+    default:
+      break;
+  }
+  options.telemetry_callback =
+      [total_telemetry](const BundleAdjustmentTelemetry& telemetry) {
+        total_telemetry->num_residuals = telemetry.num_residuals;
+        total_telemetry->num_iterations += telemetry.num_iterations;
+        total_telemetry->setup_time += telemetry.setup_time;
+        total_telemetry->jacobian_evaluation_time +=
+            telemetry.jacobian_evaluation_time;
+        total_telemetry->linear_solver_time += telemetry.linear_solver_time;
+      };
+  return options;
+}
+
+static void ReportTelemetry(const BundleAdjustmentTelemetry& telemetry,
+                            benchmark::State& state) {
+  state.SetLabel(CameraModelIdToName(
+      static_cast<CameraModelId>(state.range(2))));
+  state.counters["residuals"] = telemetry.num_residuals;
+  state.counters["iterations"] = benchmark::Counter(
+      telemetry.num_iterations, benchmark::Counter::kAvgIterations);
+  state.counters["setup_time"] = benchmark::Counter(
+      telemetry.setup_time, benchmark::Counter::kAvgIterations);
+  state.counters["jacobian_time"] = benchmark::Counter(
+      telemetry.jacobian_evaluation_time, benchmark::Counter::kAvgIterations);
+  state.counters["linear_solver_time"] = benchmark::Counter(
+      telemetry.linear_solver_time, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_BundleAdjuster(benchmark::State& state) {
+  const auto linear_solver_type =
+      static_cast<ceres::LinearSolverType>(state.range(3));
+  const BundleAdjustmentProblem problem =
+      CreateProblem(state.range(0),
+                    state.range(1),
+                    static_cast<CameraModelId>(state.range(2)),
+                    /*use_rig=*/false);
+  BundleAdjustmentTelemetry total_telemetry;
+  const BundleAdjustmentOptions options =
+      CreateOptions(linear_solver_type, state.range(4), &total_telemetry);
+  if (linear_solver_type == ceres::SPARSE_SCHUR &&
+      !ceres::IsSparseLinearAlgebraLibraryTypeAvailable(
+          options.solver_options.sparse_linear_algebra_library_type)) {
+    state.SkipWithError("Ceres was built without sparse linear algebra");
+    return;
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    Reconstruction reconstruction = problem.reconstruction;
+    BundleAdjuster bundle_adjuster(options, problem.config);
+    state.ResumeTiming();
+    THROW_CHECK(bundle_adjuster.Solve(&reconstruction));
+  }
+
+  ReportTelemetry(total_telemetry, state);
+}
+
+static void BM_RigBundleAdjuster(benchmark::State& state) {
+  const auto linear_solver_type =
+      static_cast<ceres::LinearSolverType>(state.range(3));
+  const BundleAdjustmentProblem problem =
+      CreateProblem(state.range(0),
+                    state.range(1),
+                    static_cast<CameraModelId>(state.range(2)),
+                    /*use_rig=*/true);
+  BundleAdjustmentTelemetry total_telemetry;
+  const BundleAdjustmentOptions options =
+      CreateOptions(linear_solver_type, state.range(4), &total_telemetry);
+  if (linear_solver_type == ceres::SPARSE_SCHUR &&
+      !ceres::IsSparseLinearAlgebraLibraryTypeAvailable(
+          options.solver_options.sparse_linear_algebra_library_type)) {
+    state.SkipWithError("Ceres was built without sparse linear algebra");
+    return;
+  }
+
+  const RigBundleAdjuster::Options rig_options;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Reconstruction reconstruction = problem.reconstruction;
+    std::vector<CameraRig> camera_rigs = problem.camera_rigs;
+    RigBundleAdjuster bundle_adjuster(options, rig_options, problem.config);
+    state.ResumeTiming();
+    THROW_CHECK(bundle_adjuster.Solve(&reconstruction, &camera_rigs));
+  }
+
+  ReportTelemetry(total_telemetry, state);
+}
+
+static void BundleAdjustmentArguments(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"images", "points", "model", "solver", "threads"});
+  std::vector<int> num_threads = {1};
+  const int max_num_threads = GetEffectiveNumThreads(-1);
+  if (max_num_threads > 1) {
+    num_threads.push_back(max_num_threads);
+  }
+  for (const auto& [num_images, num_points3D] : kProblemScales) {
+    for (const CameraModelId model_id : kCameraModelIds) {
+      for (const ceres::LinearSolverType linear_solver_type :
+           kLinearSolverTypes) {
+        if (linear_solver_type != ceres::ITERATIVE_SCHUR &&
+            num_images > kMaxNumImagesDirectSolver) {
+          continue;
+        }
+        for (const int threads : num_threads) {
+          b->Args({num_images,
+                   num_points3D,
+                   static_cast<int>(model_id),
+                   static_cast<int>(linear_solver_type),
+                   threads});
+        }
+      }
+    }
+  }
+}
+
+BENCHMARK(BM_BundleAdjuster)
+    ->Apply(BundleAdjustmentArguments)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(BM_RigBundleAdjuster)
+    ->Apply(BundleAdjustmentArguments)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -56,6 +56,39 @@ BENCHMARK_F(BM_ReprojErrorCostFunction, Run)(benchmark::State& state) {
   }
 }
 
+class BM_AnalyticalReprojErrorCostFunction
+    : public BM_ReprojErrorCostFunction {
+ public:
+  void SetUp(::benchmark::State& state) {
+    cost_function.reset(
+        AnalyticalReprojErrorCostFunction<camera_model>::Create(data.point2D));
+  }
+};
+
+BENCHMARK_F(BM_AnalyticalReprojErrorCostFunction, Run)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    cost_function->Evaluate(parameters, residuals, jacobians);
+  }
+}
+
+class BM_FloatJacobianAnalyticalReprojErrorCostFunction
+    : public BM_ReprojErrorCostFunction {
+ public:
+  void SetUp(::benchmark::State& state) {
+    cost_function.reset(
+        AnalyticalReprojErrorCostFunction<camera_model, float>::Create(
+            data.point2D));
+  }
+};
+
+BENCHMARK_F(BM_FloatJacobianAnalyticalReprojErrorCostFunction, Run)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    cost_function->Evaluate(parameters, residuals, jacobians);
+  }
+}
+
 class BM_ReprojErrorConstantPoseCostFunction : public benchmark::Fixture {
  public:
   void SetUp(::benchmark::State& state) {
@@ -81,6 +114,23 @@ BENCHMARK_F(BM_ReprojErrorConstantPoseCostFunction, Run)
   }
 }
 
+class BM_AnalyticalReprojErrorConstantPoseCostFunction
+    : public BM_ReprojErrorConstantPoseCostFunction {
+ public:
+  void SetUp(::benchmark::State& state) {
+    cost_function.reset(
+        AnalyticalReprojErrorConstantPoseCostFunction<camera_model>::Create(
+            data.cam_from_world, data.point2D));
+  }
+};
+
+BENCHMARK_F(BM_AnalyticalReprojErrorConstantPoseCostFunction, Run)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    cost_function->Evaluate(parameters, residuals, jacobians);
+  }
+}
+
 class BM_ReprojErrorConstantPoint3DCostFunction : public benchmark::Fixture {
  public:
   void SetUp(::benchmark::State& state) {
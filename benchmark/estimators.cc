@@ -0,0 +1,338 @@
+#include "colmap/estimators/absolute_pose.h"
+#include "colmap/estimators/essential_matrix.h"
+#include "colmap/estimators/fundamental_matrix.h"
+#include "colmap/estimators/generalized_absolute_pose.h"
+#include "colmap/estimators/homography_matrix.h"
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/math/random.h"
+#include "colmap/optim/loransac.h"
+#include "colmap/scene/camera.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+#include <benchmark/benchmark.h>
+
+using namespace colmap;
+
+// Number of distinct minimal samples, over which the minimal solver benchmarks
+// iterate, such that the measurements are not biased by a single input.
+constexpr int kNumMinimalSamples = 64;
+
+// Reprojection error threshold in pixels for the RANSAC benchmarks.
+constexpr double kMaxError = 4.0;
+
+// Synthetic scene from `SynthesizeDataset`, in which the observations of the
+// i-th 3D point in every image are stored at the i-th position.
+struct SyntheticProblem {
+  Camera camera;
+  std::vector<Rigid3d> cams_from_world;
+  std::vector<Eigen::Vector3d> points3D;
+  // Observations in pixel coordinates, indexed by the image and 3D point.
+  std::vector<std::vector<Eigen::Vector2d>> points2D;
+  // Observations in normalized camera coordinates.
+  std::vector<std::vector<Eigen::Vector2d>> normalized_points2D;
+};
+
+// Creates a synthetic scene, in which the observations of a fraction of
+// (1 - inlier_ratio) 3D points are replaced by uniform random image points.
+static SyntheticProblem CreateSyntheticProblem(const int num_images,
+                                               const int num_points3D,
+                                               const double inlier_ratio) {
+  SetPRNGSeed(num_points3D);
+
+  SyntheticDatasetOptions options;
+  options.num_cameras = 1;
+  options.num_images = num_images;
+  options.num_points3D = num_points3D;
+  options.num_points2D_without_point3D = 0;
+  options.point2D_stddev = 0.5;
+  Reconstruction reconstruction;
+  SynthesizeDataset(options, &reconstruction);
+
+  SyntheticProblem problem;
+  problem.camera = reconstruction.Camera(1);
+  problem.points2D.resize(num_images);
+  problem.normalized_points2D.resize(num_images);
+
+  std::vector<std::unordered_map<point3D_t, Eigen::Vector2d>> observations;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    const Image& image = reconstruction.Image(image_id);
+    problem.cams_from_world.push_back(image.CamFromWorld());
+    auto& image_observations = observations.emplace_back();
+    for (const Point2D& point2D : image.Points2D()) {
+      image_observations.emplace(point2D.point3D_id, point2D.xy);
+    }
+  }
+
+  // Only keep 3D points, which project into all images.
+  for (const auto& point3D : reconstruction.Points3D()) {
+    if (point3D.second.track.Length() != static_cast<size_t>(num_images)) {
+      continue;
+    }
+    const bool is_outlier = RandomUniformReal<double>(0, 1) > inlier_ratio;
+    problem.points3D.push_back(point3D.second.xyz);
+    for (int image_idx = 0; image_idx < num_images; ++image_idx) {
+      const Eigen::Vector2d point2D =
+          is_outlier
+              ? Eigen::Vector2d(
+                    RandomUniformReal<double>(0, problem.camera.width),
+                    RandomUniformReal<double>(0, problem.camera.height))
+              : observations[image_idx].at(point3D.first);
+      problem.points2D[image_idx].push_back(point2D);
+      problem.normalized_points2D[image_idx].push_back(
+          problem.camera.CamFromImg(point2D));
+    }
+  }
+
+  return problem;
+}
+
+// Draws random subsets of the given size from the (outlier-free) problem.
+static std::vector<std::vector<size_t>> CreateSamples(
+    const SyntheticProblem& problem, const int sample_size) {
+  std::vector<std::vector<size_t>> samples(kNumMinimalSamples);
+  std::vector<size_t> idxs(problem.points3D.size());
+  std::iota(idxs.begin(), idxs.end(), 0);
+  for (auto& sample : samples) {
+    std::shuffle(idxs.begin(), idxs.end(), *PRNG);
+    sample.assign(idxs.begin(), idxs.begin() + sample_size);
+  }
+  return samples;
+}
+
+template <typename T>
+static std::vector<T> GatherSample(const std::vector<T>& values,
+                                   const std::vector<size_t>& sample) {
+  std::vector<T> sample_values;
+  sample_values.reserve(sample.size());
+  for (const size_t idx : sample) {
+    sample_values.push_back(values[idx]);
+  }
+  return sample_values;
+}
+
+// Benchmarks the minimal solver of a two-view estimator on outlier-free
+// samples of normalized image points.
+template <typename Estimator>
+static void BM_TwoViewMinimalSolver(benchmark::State& state) {
+  const SyntheticProblem problem =
+      CreateSyntheticProblem(/*num_images=*/2, /*num_points3D=*/200, 1.0);
+  const int sample_size =
+      std::max<int>(Estimator::kMinNumSamples, state.range(0));
+  std::vector<std::vector<Eigen::Vector2d>> samples1;
+  std::vector<std::vector<Eigen::Vector2d>> samples2;
+  for (const auto& sample : CreateSamples(problem, sample_size)) {
+    samples1.push_back(GatherSample(problem.normalized_points2D[0], sample));
+    samples2.push_back(GatherSample(problem.normalized_points2D[1], sample));
+  }
+
+  std::vector<typename Estimator::M_t> models;
+  int sample_idx = 0;
+  for (auto _ : state) {
+    Estimator::Estimate(samples1[sample_idx], samples2[sample_idx], &models);
+    benchmark::DoNotOptimize(models.data());
+    sample_idx = (sample_idx + 1) % kNumMinimalSamples;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Benchmarks the solver of an absolute pose estimator on outlier-free samples
+// of 2D-3D correspondences.
+template <typename Estimator>
+static void BM_AbsolutePoseSolver(benchmark::State& state) {
+  const SyntheticProblem problem =
+      CreateSyntheticProblem(/*num_images=*/1, /*num_points3D=*/500, 1.0);
+  const int sample_size =
+      std::max<int>(Estimator::kMinNumSamples, state.range(0));
+  std::vector<std::vector<Eigen::Vector2d>> samples2D;
+  std::vector<std::vector<Eigen::Vector3d>> samples3D;
+  for (const auto& sample : CreateSamples(problem, sample_size)) {
+    samples2D.push_back(GatherSample(problem.normalized_points2D[0], sample));
+    samples3D.push_back(GatherSample(problem.points3D, sample));
+  }
+
+  std::vector<typename Estimator::M_t> models;
+  int sample_idx = 0;
+  for (auto _ : state) {
+    Estimator::Estimate(samples2D[sample_idx], samples3D[sample_idx], &models);
+    benchmark::DoNotOptimize(models.data());
+    sample_idx = (sample_idx + 1) % kNumMinimalSamples;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Creates the generalized observations of a rig composed of all images of the
+// problem, where the i-th 3D point is observed by the (i % num_images)-th
+// camera and the rig frame coincides with the first camera.
+static std::vector<GP3PEstimator::X_t> CreateGeneralizedPoints2D(
+    const SyntheticProblem& problem) {
+  const Rigid3d world_from_rig = Inverse(problem.cams_from_world[0]);
+  const size_t num_images = problem.cams_from_world.size();
+  std::vector<GP3PEstimator::X_t> points2D(problem.points3D.size());
+  for (size_t i = 0; i < problem.points3D.size(); ++i) {
+    const size_t image_idx = i % num_images;
+    points2D[i].cam_from_rig =
+        problem.cams_from_world[image_idx] * world_from_rig;
+    points2D[i].ray_in_cam = problem.normalized_points2D[image_idx][i]
+                                 .homogeneous()
+                                 .normalized();
+  }
+  return points2D;
+}
+
+static void BM_GP3PSolver(benchmark::State& state) {
+  const SyntheticProblem problem =
+      CreateSyntheticProblem(/*num_images=*/3, /*num_points3D=*/300, 1.0);
+  const std::vector<GP3PEstimator::X_t> points2D =
+      CreateGeneralizedPoints2D(problem);
+  std::vector<std::vector<GP3PEstimator::X_t>> samples2D;
+  std::vector<std::vector<Eigen::Vector3d>> samples3D;
+  for (const auto& sample :
+       CreateSamples(problem, GP3PEstimator::kMinNumSamples)) {
+    samples2D.push_back(GatherSample(points2D, sample));
+    samples3D.push_back(GatherSample(problem.points3D, sample));
+  }
+
+  std::vector<GP3PEstimator::M_t> models;
+  int sample_idx = 0;
+  for (auto _ : state) {
+    GP3PEstimator::Estimate(
+        samples2D[sample_idx], samples3D[sample_idx], &models);
+    benchmark::DoNotOptimize(models.data());
+    sample_idx = (sample_idx + 1) % kNumMinimalSamples;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static RANSACOptions CreateRANSACOptions(const Camera& camera) {
+  RANSACOptions options;
+  options.max_error = camera.CamFromImgThreshold(kMaxError);
+  options.confidence = 0.9999;
+  options.max_num_trials = 10000;
+  return options;
+}
+
+// The first argument is the number of correspondences and the second argument
+// the inlier ratio in percent.
+static void BM_LORANSACEssentialMatrix(benchmark::State& state) {
+  const SyntheticProblem problem = CreateSyntheticProblem(
+      /*num_images=*/2, state.range(0), state.range(1) / 100.0);
+  LORANSAC<EssentialMatrixFivePointEstimator,
+           EssentialMatrixEightPointEstimator>
+      ransac(CreateRANSACOptions(problem.camera));
+  size_t num_trials = 0;
+  for (auto _ : state) {
+    const auto report = ransac.Estimate(problem.normalized_points2D[0],
+                                        problem.normalized_points2D[1]);
+    num_trials += report.num_trials;
+  }
+  state.counters["num_trials"] = benchmark::Counter(
+      num_trials, benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * problem.points3D.size());
+}
+
+static void BM_LORANSACAbsolutePose(benchmark::State& state) {
+  const SyntheticProblem problem = CreateSyntheticProblem(
+      /*num_images=*/1, state.range(0), state.range(1) / 100.0);
+  LORANSAC<P3PEstimator, EPNPEstimator> ransac(
+      CreateRANSACOptions(problem.camera));
+  size_t num_trials = 0;
+  for (auto _ : state) {
+    const auto report =
+        ransac.Estimate(problem.normalized_points2D[0], problem.points3D);
+    num_trials += report.num_trials;
+  }
+  state.counters["num_trials"] = benchmark::Counter(
+      num_trials, benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * problem.points3D.size());
+}
+
+// GP3P has no non-minimal solver, so use plain RANSAC as in the pipeline.
+static void BM_RANSACGeneralizedAbsolutePose(benchmark::State& state) {
+  const SyntheticProblem problem = CreateSyntheticProblem(
+      /*num_images=*/3, state.range(0), state.range(1) / 100.0);
+  const std::vector<GP3PEstimator::X_t> points2D =
+      CreateGeneralizedPoints2D(problem);
+  RANSAC<GP3PEstimator> ransac(CreateRANSACOptions(problem.camera));
+  ransac.estimator.residual_type =
+      GP3PEstimator::ResidualType::ReprojectionError;
+  size_t num_trials = 0;
+  for (auto _ : state) {
+    const auto report = ransac.Estimate(points2D, problem.points3D);
+    num_trials += report.num_trials;
+  }
+  state.counters["num_trials"] = benchmark::Counter(
+      num_trials, benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * problem.points3D.size());
+}
+
+static void BM_EstimateTwoViewGeometry(benchmark::State& state) {
+  const SyntheticProblem problem = CreateSyntheticProblem(
+      /*num_images=*/2, state.range(0), state.range(1) / 100.0);
+  FeatureMatches matches(problem.points3D.size());
+  for (size_t i = 0; i < matches.size(); ++i) {
+    matches[i] = FeatureMatch(i, i);
+  }
+  TwoViewGeometryOptions options;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EstimateTwoViewGeometry(problem.camera,
+                                                     problem.points2D[0],
+                                                     problem.camera,
+                                                     problem.points2D[1],
+                                                     matches,
+                                                     options));
+  }
+  state.SetItemsProcessed(state.iterations() * matches.size());
+}
+
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver, EssentialMatrixFivePointEstimator)
+    ->Arg(EssentialMatrixFivePointEstimator::kMinNumSamples)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver,
+                   FundamentalMatrixSevenPointEstimator)
+    ->Arg(FundamentalMatrixSevenPointEstimator::kMinNumSamples)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver, HomographyMatrixEstimator)
+    ->Arg(HomographyMatrixEstimator::kMinNumSamples)
+    ->Arg(100)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(BM_AbsolutePoseSolver, P3PEstimator)
+    ->Arg(P3PEstimator::kMinNumSamples)
+    ->Unit(benchmark::kMicrosecond);
+
+// EPnP is also used for local optimization on the inliers.
+BENCHMARK_TEMPLATE(BM_AbsolutePoseSolver, EPNPEstimator)
+    ->Arg(EPNPEstimator::kMinNumSamples)
+    ->Arg(100)
+    ->Arg(400)
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_GP3PSolver)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_LORANSACEssentialMatrix)
+    ->ArgsProduct({{1000}, {90, 70, 50, 30}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_LORANSACAbsolutePose)
+    ->ArgsProduct({{1000}, {90, 70, 50, 30}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_RANSACGeneralizedAbsolutePose)
+    ->ArgsProduct({{1000}, {90, 70, 50, 30}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_EstimateTwoViewGeometry)
+    ->ArgsProduct({{1000}, {90, 70, 50, 30}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
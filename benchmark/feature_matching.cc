@@ -0,0 +1,220 @@
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/feature/sift.h"
+#include "colmap/feature/utils.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/scene/camera.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+using namespace colmap;
+
+constexpr int kImageWidth = 2000;
+constexpr int kImageHeight = 1500;
+
+struct FeatureSet {
+  std::shared_ptr<FeatureKeypoints> keypoints;
+  std::shared_ptr<FeatureDescriptors> descriptors;
+};
+
+// Creates two sets of random features, where the second set is a perturbed copy
+// of the first set, such that most features have a true match.
+static std::pair<FeatureSet, FeatureSet> CreateFeatureSets(
+    const int num_features) {
+  std::mt19937 prng(num_features);
+  std::uniform_real_distribution<float> descriptor_distribution(0.0f, 1.0f);
+  std::normal_distribution<float> descriptor_noise(0.0f, 0.02f);
+  std::uniform_real_distribution<float> x_distribution(0.0f, kImageWidth);
+  std::uniform_real_distribution<float> y_distribution(0.0f, kImageHeight);
+  std::normal_distribution<float> keypoint_noise(0.0f, 1.0f);
+
+  FeatureDescriptorsFloat descriptors1(num_features, 128);
+  FeatureDescriptorsFloat descriptors2(num_features, 128);
+  for (int i = 0; i < num_features; ++i) {
+    for (int j = 0; j < 128; ++j) {
+      descriptors1(i, j) = std::pow(descriptor_distribution(prng), 2);
+      descriptors2(i, j) =
+          std::max(0.0f, descriptors1(i, j) + descriptor_noise(prng));
+    }
+  }
+  L2NormalizeFeatureDescriptors(&descriptors1);
+  L2NormalizeFeatureDescriptors(&descriptors2);
+
+  FeatureSet features1;
+  FeatureSet features2;
+  features1.keypoints = std::make_shared<FeatureKeypoints>(num_features);
+  features2.keypoints = std::make_shared<FeatureKeypoints>(num_features);
+  for (int i = 0; i < num_features; ++i) {
+    const float x = x_distribution(prng);
+    const float y = y_distribution(prng);
+    (*features1.keypoints)[i] = FeatureKeypoint(x, y);
+    (*features2.keypoints)[i] =
+        FeatureKeypoint(x + keypoint_noise(prng), y + keypoint_noise(prng));
+  }
+  features1.descriptors = std::make_shared<FeatureDescriptors>(
+      FeatureDescriptorsToUnsignedByte(descriptors1));
+  features2.descriptors = std::make_shared<FeatureDescriptors>(
+      FeatureDescriptorsToUnsignedByte(descriptors2));
+  return {std::move(features1), std::move(features2)};
+}
+
+static SiftMatchingOptions CreateCPUMatchingOptions() {
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  options.max_num_matches = std::numeric_limits<int>::max();
+  return options;
+}
+
+// Each benchmark thread uses its own matcher, as in the matching pipeline,
+// where every worker thread owns a separate matcher.
+static void BM_SiftBuildDescriptorIndex(benchmark::State& state) {
+  const auto features = CreateFeatureSets(state.range(0)).first;
+  const std::unique_ptr<FeatureMatcher> matcher =
+      CreateSiftFeatureMatcher(CreateCPUMatchingOptions());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        matcher->CreateDescriptorIndex(features.descriptors));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_SiftMatchFLANN(benchmark::State& state) {
+  const auto features = CreateFeatureSets(state.range(0));
+  const std::unique_ptr<FeatureMatcher> matcher =
+      CreateSiftFeatureMatcher(CreateCPUMatchingOptions());
+  // Exclude the construction of the indices, which is benchmarked separately.
+  const auto index1 =
+      matcher->CreateDescriptorIndex(features.first.descriptors);
+  const auto index2 =
+      matcher->CreateDescriptorIndex(features.second.descriptors);
+  FeatureMatches matches;
+  for (auto _ : state) {
+    matcher->SetDescriptorIndices(index1, index2);
+    matcher->Match(
+        features.first.descriptors, features.second.descriptors, &matches);
+    benchmark::DoNotOptimize(matches.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_SiftMatchBruteForce(benchmark::State& state) {
+  const auto features = CreateFeatureSets(state.range(0));
+  SiftMatchingOptions options = CreateCPUMatchingOptions();
+  options.brute_force_cpu_matcher = true;
+  const std::unique_ptr<FeatureMatcher> matcher =
+      CreateSiftFeatureMatcher(options);
+  FeatureMatches matches;
+  for (auto _ : state) {
+    matcher->Match(
+        features.first.descriptors, features.second.descriptors, &matches);
+    benchmark::DoNotOptimize(matches.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_SiftMatchGuided(benchmark::State& state) {
+  const auto features = CreateFeatureSets(state.range(0));
+  const std::unique_ptr<FeatureMatcher> matcher =
+      CreateSiftFeatureMatcher(CreateCPUMatchingOptions());
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+  two_view_geometry.H = Eigen::Matrix3d::Identity();
+  for (auto _ : state) {
+    matcher->MatchGuided(/*max_error=*/4.0,
+                         features.first.keypoints,
+                         features.second.keypoints,
+                         features.first.descriptors,
+                         features.second.descriptors,
+                         &two_view_geometry);
+    benchmark::DoNotOptimize(two_view_geometry.inlier_matches.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_EstimateTwoViewGeometry(benchmark::State& state) {
+  const int num_matches = state.range(0);
+  const Camera camera = Camera::CreateFromModelId(
+      1, SimpleRadialCameraModel::model_id, 1200, kImageWidth, kImageHeight);
+  const Rigid3d cam2_from_cam1(
+      Eigen::Quaterniond(Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitY())),
+      Eigen::Vector3d(-1, 0.1, 0.2));
+
+  // Synthetic scene with 30% outlier matches.
+  std::mt19937 prng(num_matches);
+  std::uniform_real_distribution<double> xy_distribution(-2, 2);
+  std::uniform_real_distribution<double> z_distribution(4, 8);
+  std::uniform_real_distribution<double> outlier_distribution(0, 1);
+  std::uniform_real_distribution<double> x_distribution(0, kImageWidth);
+  std::uniform_real_distribution<double> y_distribution(0, kImageHeight);
+  std::vector<Eigen::Vector2d> points1(num_matches);
+  std::vector<Eigen::Vector2d> points2(num_matches);
+  FeatureMatches matches(num_matches);
+  for (int i = 0; i < num_matches; ++i) {
+    const Eigen::Vector3d point3D(
+        xy_distribution(prng), xy_distribution(prng), z_distribution(prng));
+    points1[i] = camera.ImgFromCam(point3D.hnormalized());
+    if (outlier_distribution(prng) < 0.3) {
+      points2[i] =
+          Eigen::Vector2d(x_distribution(prng), y_distribution(prng));
+    } else {
+      points2[i] = camera.ImgFromCam((cam2_from_cam1 * point3D).hnormalized());
+    }
+    matches[i] = FeatureMatch(i, i);
+  }
+
+  TwoViewGeometryOptions options;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EstimateTwoViewGeometry(
+        camera, points1, camera, points2, matches, options));
+  }
+  state.SetItemsProcessed(state.iterations() * num_matches);
+}
+
+BENCHMARK(BM_SiftBuildDescriptorIndex)
+    ->Arg(1024)
+    ->Arg(8192)
+    ->Arg(32768)
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(BM_SiftMatchFLANN)
+    ->Arg(1024)
+    ->Arg(8192)
+    ->Arg(32768)
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(BM_SiftMatchBruteForce)
+    ->Arg(1024)
+    ->Arg(8192)
+    ->Arg(32768)
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(BM_SiftMatchGuided)
+    ->Arg(1024)
+    ->Arg(8192)
+    ->Arg(32768)
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(BM_EstimateTwoViewGeometry)
+    ->Arg(1024)
+    ->Arg(8192)
+    ->Arg(32768)
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,499 @@
+import os
+import sys
+import json
+import time
+import socket
+import shutil
+import argparse
+import platform
+import datetime
+import threading
+import subprocess
+import configparser
+import urllib.request
+
+
+# Synthetic datasets start at the mapper, since they have no images.
+SYNTHETIC_MATCH_GRAPHS = ("sequential", "grid", "random")
+
+# Option sections of the project file passed to the individual stages.
+STAGE_OPTION_SECTIONS = {
+    "feature_extractor": ("ImageReader", "SiftExtraction"),
+    "exhaustive_matcher": (
+        "SiftMatching",
+        "TwoViewGeometry",
+        "ExhaustiveMatching",
+    ),
+    "vocab_tree_matcher": (
+        "SiftMatching",
+        "TwoViewGeometry",
+        "VocabTreeMatching",
+    ),
+    "mapper": ("Mapper",),
+    "patch_match_stereo": ("PatchMatchStereo",),
+    "stereo_fusion": ("StereoFusion",),
+    "poisson_mesher": ("PoissonMeshing",),
+    "delaunay_mesher": ("DelaunayMeshing",),
+}
+
+# Same threshold as in the automatic reconstructor.
+MIN_NUM_IMAGES_FOR_VOCAB_TREE_MATCHING = 200
+
+IMAGE_EXTENSIONS = (".jpg", ".jpeg", ".png", ".tif", ".tiff", ".bmp")
+
+
+def download_file(url, file_path, max_retries=3):
+    if os.path.exists(file_path):
+        return
+    print(f"Downloading {url} to {file_path}")
+    for retry in range(max_retries):
+        try:
+            urllib.request.urlretrieve(url, file_path)
+            return
+        except Exception as exc:
+            print(
+                f"Failed to download {url} (trial={retry+1}) to {file_path} due to {exc}"
+            )
+
+
+class GPUMemoryMonitor:
+    """Polls nvidia-smi for the peak GPU memory of a process in MiB."""
+
+    def __init__(self, pid, interval=0.2):
+        self.pid = pid
+        self.interval = interval
+        self.peak_memory_mb = None
+        self._stop = threading.Event()
+        self._thread = None
+
+    @staticmethod
+    def is_available():
+        return shutil.which("nvidia-smi") is not None
+
+    def _poll(self):
+        while not self._stop.is_set():
+            try:
+                output = subprocess.check_output(
+                    [
+                        "nvidia-smi",
+                        "--query-compute-apps=pid,used_memory",
+                        "--format=csv,noheader,nounits",
+                    ],
+                    stderr=subprocess.DEVNULL,
+                    text=True,
+                )
+            except (OSError, subprocess.CalledProcessError):
+                return
+            for line in output.splitlines():
+                fields = [field.strip() for field in line.split(",")]
+                if len(fields) != 2 or fields[0] != str(self.pid):
+                    continue
+                try:
+                    memory_mb = float(fields[1])
+                except ValueError:
+                    continue
+                self.peak_memory_mb = max(self.peak_memory_mb or 0, memory_mb)
+            self._stop.wait(self.interval)
+
+    def start(self):
+        if self.is_available():
+            self._thread = threading.Thread(target=self._poll, daemon=True)
+            self._thread.start()
+
+    def stop(self):
+        self._stop.set()
+        if self._thread is not None:
+            self._thread.join()
+
+
+def read_project_options(args, workspace_path):
+    """Returns the options of the quality preset as {section: {key: value}}."""
+    project_path = os.path.join(workspace_path, "project.ini")
+    subprocess.check_call(
+        [
+            os.path.realpath(args.colmap_path),
+            "project_generator",
+            "--output_path",
+            project_path,
+            "--quality",
+            args.quality,
+        ],
+        stdout=subprocess.DEVNULL,
+    )
+    # The options before the first section are not part of any stage.
+    with open(project_path, "r") as fid:
+        content = fid.read()
+    config = configparser.ConfigParser(interpolation=None)
+    config.optionxform = str
+    config.read_string("[Global]\n" + content)
+    return {section: dict(config[section]) for section in config.sections()}
+
+
+def stage_options(project_options, command, overrides):
+    options = {}
+    for section in STAGE_OPTION_SECTIONS.get(command, ()):
+        for key, value in project_options.get(section, {}).items():
+            if value != "":
+                options[f"{section}.{key}"] = value
+    options.update(overrides)
+    return options
+
+
+def run_stage(args, name, command, options, cwd):
+    """Runs a colmap command and measures its wall time and peak memory."""
+    cmd = [os.path.realpath(args.colmap_path), command]
+    for key, value in options.items():
+        cmd += [f"--{key}", str(value)]
+
+    print(f"Running stage {name}:", " ".join(cmd))
+    log_path = os.path.join(cwd, f"{name}.log")
+    with open(log_path, "w") as log_file:
+        start_time = time.monotonic()
+        process = subprocess.Popen(
+            cmd, cwd=cwd, stdout=log_file, stderr=subprocess.STDOUT
+        )
+        gpu_monitor = GPUMemoryMonitor(process.pid)
+        gpu_monitor.start()
+        # wait4 reports the resources of exactly this child, in contrast to
+        # getrusage(RUSAGE_CHILDREN), which accumulates all past children.
+        _, status, rusage = os.wait4(process.pid, 0)
+        wall_time = time.monotonic() - start_time
+        gpu_monitor.stop()
+        process.returncode = os.waitstatus_to_exitcode(status)
+
+    # ru_maxrss is in KiB on Linux and in bytes on macOS.
+    peak_rss_mb = rusage.ru_maxrss / 1024
+    if sys.platform == "darwin":
+        peak_rss_mb /= 1024
+
+    metrics = {
+        "name": name,
+        "command": command,
+        "return_code": process.returncode,
+        "wall_time_s": wall_time,
+        "user_time_s": rusage.ru_utime,
+        "system_time_s": rusage.ru_stime,
+        "peak_rss_mb": peak_rss_mb,
+        "peak_gpu_memory_mb": gpu_monitor.peak_memory_mb,
+        "log_path": log_path,
+    }
+
+    if process.returncode != 0:
+        print(f"Stage {name} failed, see {log_path}")
+    return metrics
+
+
+def num_images_in_dir(image_path):
+    num_images = 0
+    for _, _, file_names in os.walk(image_path):
+        for file_name in file_names:
+            if file_name.lower().endswith(IMAGE_EXTENSIONS):
+                num_images += 1
+    return num_images
+
+
+def prepare_eth3d_dataset(dataset_name, workspace_path):
+    dataset_archive_path = os.path.join(workspace_path, f"{dataset_name}.7z")
+    download_file(
+        f"https://www.eth3d.net/data/{dataset_name}_dslr_undistorted.7z",
+        dataset_archive_path,
+    )
+    image_path = os.path.join(workspace_path, dataset_name, "images")
+    if not os.path.exists(image_path):
+        subprocess.check_call(
+            ["7zz", "x", "-y", f"{dataset_name}.7z"], cwd=workspace_path
+        )
+    return image_path
+
+
+def reset_workspace_outputs(workspace_path):
+    for name in ("database.db", "sparse", "dense"):
+        path = os.path.join(workspace_path, name)
+        if os.path.isdir(path):
+            shutil.rmtree(path)
+        elif os.path.exists(path):
+            os.remove(path)
+
+
+def process_dataset(args, dataset_name):
+    print("Processing dataset:", dataset_name)
+
+    is_synthetic = dataset_name.startswith("synthetic-")
+    if os.path.isdir(dataset_name):
+        image_path = os.path.realpath(dataset_name)
+        dataset_name = os.path.basename(os.path.normpath(image_path))
+    else:
+        image_path = None
+
+    workspace_path = os.path.join(
+        os.path.realpath(args.workspace_path), dataset_name
+    )
+    os.makedirs(workspace_path, exist_ok=True)
+    reset_workspace_outputs(workspace_path)
+
+    project_options = read_project_options(args, workspace_path)
+    database_path = os.path.join(workspace_path, "database.db")
+    sparse_path = os.path.join(workspace_path, "sparse")
+    dense_path = os.path.join(workspace_path, "dense")
+    os.makedirs(sparse_path)
+
+    stages = []
+
+    def run(name, command, overrides):
+        metrics = run_stage(
+            args,
+            name,
+            command,
+            stage_options(project_options, command, overrides),
+            workspace_path,
+        )
+        stages.append(metrics)
+        return metrics["return_code"] == 0
+
+    def result(success):
+        return {
+            "name": dataset_name,
+            "synthetic": is_synthetic,
+            "success": success,
+            "num_images": num_images,
+            "stages": stages,
+        }
+
+    if is_synthetic:
+        match_graph = dataset_name[len("synthetic-") :]
+        if match_graph not in SYNTHETIC_MATCH_GRAPHS:
+            raise ValueError(f"Unknown synthetic dataset: {dataset_name}")
+        num_images = args.num_synthetic_images
+        # The synthetic ground-truth is written next to the reconstruction.
+        if not run(
+            "dataset_synthesizer",
+            "dataset_synthesizer",
+            {
+                "database_path": database_path,
+                "output_path": os.path.join(workspace_path, "ground_truth"),
+                "match_graph": match_graph,
+                "num_images": num_images,
+                "num_threads": args.num_threads,
+                "seed": args.seed,
+            },
+        ):
+            return result(False)
+        image_path = os.path.join(workspace_path, "images")
+        os.makedirs(image_path, exist_ok=True)
+    else:
+        if image_path is None:
+            image_path = prepare_eth3d_dataset(dataset_name, workspace_path)
+        num_images = num_images_in_dir(image_path)
+
+        if not run(
+            "feature_extraction",
+            "feature_extractor",
+            {
+                "database_path": database_path,
+                "image_path": image_path,
+                "SiftExtraction.use_gpu": int(args.use_gpu),
+            },
+        ):
+            return result(False)
+
+        # Choose the matcher as in the automatic reconstructor. Sequential
+        # matching of videos is not covered by the reference datasets.
+        matching_overrides = {
+            "database_path": database_path,
+            "SiftMatching.use_gpu": int(args.use_gpu),
+        }
+        if (
+            args.vocab_tree_path
+            and num_images >= MIN_NUM_IMAGES_FOR_VOCAB_TREE_MATCHING
+        ):
+            matcher = "vocab_tree_matcher"
+            matching_overrides["VocabTreeMatching.vocab_tree_path"] = (
+                args.vocab_tree_path
+            )
+        else:
+            matcher = "exhaustive_matcher"
+        if not run("feature_matching", matcher, matching_overrides):
+            return result(False)
+
+    if not run(
+        "sparse_mapping",
+        "mapper",
+        {
+            "database_path": database_path,
+            "image_path": image_path,
+            "output_path": sparse_path,
+            "Mapper.num_threads": args.num_threads,
+        },
+    ):
+        return result(False)
+
+    if is_synthetic or args.skip_dense:
+        return result(True)
+
+    # As in the automatic reconstructor, only the first (largest)
+    # reconstruction is densified for the benchmark.
+    if not os.path.isdir(os.path.join(sparse_path, "0")):
+        print("No reconstruction for dense stages")
+        return result(False)
+
+    if not run(
+        "image_undistortion",
+        "image_undistorter",
+        {
+            "image_path": image_path,
+            "input_path": os.path.join(sparse_path, "0"),
+            "output_path": dense_path,
+            "max_image_size": project_options.get("PatchMatchStereo", {}).get(
+                "max_image_size", -1
+            ),
+        },
+    ):
+        return result(False)
+
+    # PatchMatch stereo requires CUDA in the automatic reconstructor.
+    if args.use_gpu:
+        if not run(
+            "patch_match_stereo",
+            "patch_match_stereo",
+            {"workspace_path": dense_path},
+        ):
+            return result(False)
+        input_type = "geometric" if args.quality == "high" else "photometric"
+        if not run(
+            "stereo_fusion",
+            "stereo_fusion",
+            {
+                "workspace_path": dense_path,
+                "input_type": input_type,
+                "output_path": os.path.join(dense_path, "fused.ply"),
+            },
+        ):
+            return result(False)
+
+        if args.mesher == "poisson":
+            if not run(
+                "poisson_meshing",
+                "poisson_mesher",
+                {
+                    "input_path": os.path.join(dense_path, "fused.ply"),
+                    "output_path": os.path.join(dense_path, "meshed-poisson.ply"),
+                },
+            ):
+                return result(False)
+        elif args.mesher == "delaunay":
+            if not run(
+                "delaunay_meshing",
+                "delaunay_mesher",
+                {
+                    "input_path": dense_path,
+                    "output_path": os.path.join(
+                        dense_path, "meshed-delaunay.ply"
+                    ),
+                },
+            ):
+                return result(False)
+
+    return result(True)
+
+
+def query_gpu_names():
+    if not GPUMemoryMonitor.is_available():
+        return []
+    try:
+        output = subprocess.check_output(
+            ["nvidia-smi", "--query-gpu=name", "--format=csv,noheader"],
+            stderr=subprocess.DEVNULL,
+            text=True,
+        )
+    except (OSError, subprocess.CalledProcessError):
+        return []
+    return [line.strip() for line in output.splitlines() if line.strip()]
+
+
+def query_colmap_version(colmap_path):
+    try:
+        output = subprocess.check_output(
+            [os.path.realpath(colmap_path), "help"],
+            stderr=subprocess.STDOUT,
+            text=True,
+        )
+    except (OSError, subprocess.CalledProcessError):
+        return None
+    return output.splitlines()[0].strip() if output else None
+
+
+def print_summary(report):
+    print()
+    print(
+        f"{'dataset':<24} {'stage':<20} {'wall [s]':>10} "
+        f"{'RSS [MB]':>10} {'GPU [MB]':>10}"
+    )
+    for dataset in report["datasets"]:
+        for stage in dataset["stages"]:
+            gpu_memory = stage["peak_gpu_memory_mb"]
+            print(
+                f"{dataset['name']:<24} {stage['name']:<20} "
+                f"{stage['wall_time_s']:>10.2f} {stage['peak_rss_mb']:>10.1f} "
+                f"{'-' if gpu_memory is None else f'{gpu_memory:.1f}':>10}"
+            )
+
+
+def parse_args():
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        "--dataset_names",
+        required=True,
+        help="Comma-separated list of synthetic-{sequential,grid,random}, "
+        "ETH3D dataset names, or paths to image directories",
+    )
+    parser.add_argument("--workspace_path", required=True)
+    parser.add_argument("--colmap_path", required=True)
+    parser.add_argument("--report_path", default=None)
+    parser.add_argument("--use_gpu", default=True, action="store_true")
+    parser.add_argument("--use_cpu", dest="use_gpu", action="store_false")
+    parser.add_argument("--num_threads", type=int, default=-1)
+    parser.add_argument(
+        "--quality", default="medium", choices=["low", "medium", "high", "extreme"]
+    )
+    parser.add_argument("--vocab_tree_path", default="")
+    parser.add_argument(
+        "--mesher", default="none", choices=["none", "poisson", "delaunay"]
+    )
+    parser.add_argument("--skip_dense", default=False, action="store_true")
+    parser.add_argument("--num_synthetic_images", type=int, default=1000)
+    parser.add_argument("--seed", type=int, default=0)
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    report = {
+        "host": socket.gethostname(),
+        "platform": platform.platform(),
+        "processor": platform.processor(),
+        "cpu_count": os.cpu_count(),
+        "gpus": query_gpu_names(),
+        "colmap_version": query_colmap_version(args.colmap_path),
+        "timestamp": datetime.datetime.now().isoformat(),
+        "args": vars(args),
+        "datasets": [],
+    }
+
+    for dataset_name in args.dataset_names.split(","):
+        report["datasets"].append(process_dataset(args, dataset_name.strip()))
+
+    report_path = args.report_path or os.path.join(
+        os.path.realpath(args.workspace_path), "report.json"
+    )
+    with open(report_path, "w") as fid:
+        json.dump(report, fid, indent=2)
+    print_summary(report)
+    print("Wrote report to", report_path)
+
+    if not all(dataset["success"] for dataset in report["datasets"]):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
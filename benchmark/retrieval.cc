@@ -0,0 +1,86 @@
+#include "colmap/math/random.h"
+#include "colmap/retrieval/inverted_index.h"
+#include "colmap/util/eigen_alignment.h"
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+using namespace colmap;
+using namespace colmap::retrieval;
+
+typedef InvertedIndex<uint8_t, 128, 64> InvertedIndexType;
+
+constexpr int kNumVisualWords = 4096;
+constexpr int kNumFeaturesPerImage = 500;
+constexpr int kNumNeighbors = 5;
+
+static InvertedIndexType::DescType CreateDescriptors(const int num_features) {
+  InvertedIndexType::DescType descriptors(num_features, 128);
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    descriptors(i) = RandomUniformInteger<int>(0, 255);
+  }
+  return descriptors;
+}
+
+static Eigen::MatrixXi CreateWordIds(const int num_features,
+                                     const int num_neighbors) {
+  Eigen::MatrixXi word_ids(num_features, num_neighbors);
+  for (Eigen::Index i = 0; i < word_ids.size(); ++i) {
+    word_ids(i) = RandomUniformInteger<int>(0, kNumVisualWords - 1);
+  }
+  return word_ids;
+}
+
+// Creates an inverted index with random descriptors and visual word
+// assignments, such that all inverted files have a similar number of entries.
+static std::unique_ptr<InvertedIndexType> CreateInvertedIndex(
+    const int num_images) {
+  SetPRNGSeed(num_images);
+
+  auto inverted_index = std::make_unique<InvertedIndexType>();
+  inverted_index->Initialize(kNumVisualWords);
+  inverted_index->GenerateHammingEmbeddingProjection();
+
+  const int num_training_descriptors = 50 * kNumVisualWords;
+  inverted_index->ComputeHammingEmbedding(
+      CreateDescriptors(num_training_descriptors),
+      CreateWordIds(num_training_descriptors, 1));
+
+  const FeatureGeometry geometry;
+  for (int image_id = 0; image_id < num_images; ++image_id) {
+    const InvertedIndexType::DescType descriptors =
+        CreateDescriptors(kNumFeaturesPerImage);
+    const Eigen::MatrixXi word_ids = CreateWordIds(kNumFeaturesPerImage, 1);
+    for (int i = 0; i < kNumFeaturesPerImage; ++i) {
+      inverted_index->AddEntry(
+          image_id, word_ids(i), i, descriptors.row(i), geometry);
+    }
+  }
+
+  inverted_index->Finalize();
+  return inverted_index;
+}
+
+static void BM_InvertedIndexQuery(benchmark::State& state) {
+  const std::unique_ptr<InvertedIndexType> inverted_index =
+      CreateInvertedIndex(state.range(0));
+  const InvertedIndexType::DescType descriptors =
+      CreateDescriptors(kNumFeaturesPerImage);
+  const Eigen::MatrixXi word_ids =
+      CreateWordIds(kNumFeaturesPerImage, kNumNeighbors);
+  std::vector<ImageScore> image_scores;
+  for (auto _ : state) {
+    inverted_index->Query(descriptors, word_ids, &image_scores);
+    benchmark::DoNotOptimize(image_scores.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumFeaturesPerImage);
+}
+
+BENCHMARK(BM_InvertedIndexQuery)
+    ->Arg(1000)
+    ->Arg(5000)
+    ->Arg(20000)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
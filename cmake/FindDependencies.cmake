@@ -60,6 +60,35 @@ else()
     message(STATUS "Disabling OpenMP support")
 endif()
 
+if(JPEG_ENABLED)
+    find_package(JPEG QUIET)
+endif()
+
+if(JPEG_ENABLED AND JPEG_FOUND)
+    message(STATUS "Enabling libjpeg image decoder (version: ${JPEG_VERSION})")
+    add_definitions("-DCOLMAP_JPEG_ENABLED")
+else()
+    set(JPEG_ENABLED OFF)
+    message(STATUS "Disabling libjpeg image decoder")
+endif()
+
+if(FFMPEG_ENABLED)
+    find_package(PkgConfig QUIET)
+    if(PKG_CONFIG_FOUND)
+        pkg_check_modules(FFMPEG QUIET IMPORTED_TARGET
+            libavformat libavcodec libswscale libavutil)
+    endif()
+endif()
+
+if(FFMPEG_ENABLED AND FFMPEG_FOUND)
+    message(STATUS "Enabling FFmpeg video reader "
+                   "(libavformat version: ${FFMPEG_libavformat_VERSION})")
+    add_definitions("-DCOLMAP_FFMPEG_ENABLED")
+else()
+    set(FFMPEG_ENABLED OFF)
+    message(STATUS "Disabling FFmpeg video reader")
+endif()
+
 if(CGAL_ENABLED)
     set(CGAL_DO_NOT_WARN_ABOUT_CMAKE_BUILD_TYPE TRUE)
     # We do not use CGAL data. This prevents an unnecessary warning by CMake.
@@ -145,8 +174,18 @@ if(CUDA_ENABLED AND CUDA_FOUND)
 
     message(STATUS "Enabling CUDA support (version: ${CUDAToolkit_VERSION}, "
                     "archs: ${CMAKE_CUDA_ARCHITECTURES})")
+
+    if(TARGET CUDA::nvjpeg)
+        set(NVJPEG_ENABLED ON)
+        add_definitions("-DCOLMAP_NVJPEG_ENABLED")
+        message(STATUS "Enabling nvJPEG image decoder")
+    else()
+        set(NVJPEG_ENABLED OFF)
+        message(STATUS "Disabling nvJPEG image decoder")
+    endif()
 else()
     set(CUDA_ENABLED OFF)
+    set(NVJPEG_ENABLED OFF)
     message(STATUS "Disabling CUDA support")
 endif()
 
@@ -37,20 +37,42 @@ import struct
 
 
 def read_array(path):
+    """
+    see: src/mvs/mat.h
+        void Mat<T>::Read(const std::string& path)
+    """
     with open(path, "rb") as fid:
-        width, height, channels = np.genfromtxt(
-            fid, delimiter="&", max_rows=1, usecols=(0, 1, 2), dtype=int
-        )
-        fid.seek(0)
-        num_delimiter = 0
-        byte = fid.read(1)
-        while True:
-            if byte == b"&":
-                num_delimiter += 1
-                if num_delimiter >= 3:
-                    break
+        # Files in the half precision formats start with the format name.
+        fields = []
+        field = b""
+        while len(fields) < (3 if not fields or fields[0].isdigit() else 4):
             byte = fid.read(1)
-        array = np.fromfile(fid, np.float32)
+            if byte == b"&":
+                fields.append(field)
+                field = b""
+            else:
+                field += byte
+        file_format = "float"
+        if not fields[0].isdigit():
+            file_format = fields.pop(0).decode()
+        width, height, channels = map(int, fields)
+        if file_format == "float":
+            array = np.fromfile(fid, np.float32)
+        elif file_format == "half":
+            array = np.fromfile(fid, "<f2").astype(np.float32)
+        elif file_format == "half_lz4":
+            import lz4.block
+
+            num_values = width * height * channels
+            (num_compressed_bytes,) = struct.unpack("<Q", fid.read(8))
+            planes = lz4.block.decompress(
+                fid.read(num_compressed_bytes), uncompressed_size=2 * num_values
+            )
+            planes = np.frombuffer(planes, np.uint8).astype(np.uint16)
+            bits = planes[:num_values] | (planes[num_values:] << 8)
+            array = bits.view(np.float16).astype(np.float32)
+        else:
+            raise ValueError("Unknown file format: " + file_format)
     array = array.reshape((width, height, channels), order="F")
     return np.transpose(array, (1, 0, 2)).squeeze()
 
@@ -100,10 +100,12 @@ AutomaticReconstructionController::AutomaticReconstructionController(
 
   option_manager_.sift_extraction->use_gpu = options_.use_gpu;
   option_manager_.sift_matching->use_gpu = options_.use_gpu;
+  option_manager_.mapper->ba_use_gpu = options_.use_gpu;
 
   option_manager_.sift_extraction->gpu_index = options_.gpu_index;
   option_manager_.sift_matching->gpu_index = options_.gpu_index;
   option_manager_.patch_match_stereo->gpu_index = options_.gpu_index;
+  option_manager_.mapper->ba_gpu_index = options_.gpu_index;
 
   feature_extractor_ = CreateFeatureExtractorController(
       reader_options, *option_manager_.sift_extraction);
@@ -114,6 +116,19 @@ AutomaticReconstructionController::AutomaticReconstructionController(
                                      *option_manager_.two_view_geometry,
                                      *option_manager_.database_path);
 
+  if (options_.streaming && options_.data_type == DataType::VIDEO) {
+    // Match until the extraction is finished, however long it takes.
+    StreamingMatchingOptions streaming_options;
+    streaming_options.max_idle_time = 0;
+    streaming_matcher_ = CreateStreamingSequentialFeatureMatcher(
+        *option_manager_.sequential_matching,
+        streaming_options,
+        *option_manager_.sift_matching,
+        *option_manager_.two_view_geometry,
+        *option_manager_.database_path,
+        [this]() { return feature_extractor_->IsFinished(); });
+  }
+
   if (!options_.vocab_tree_path.empty()) {
     option_manager_.sequential_matching->loop_detection = true;
     option_manager_.sequential_matching->vocab_tree_path =
@@ -141,6 +156,9 @@ void AutomaticReconstructionController::Stop() {
   if (active_thread_ != nullptr) {
     active_thread_->Stop();
   }
+  if (streaming_matcher_ != nullptr) {
+    streaming_matcher_->Stop();
+  }
   Thread::Stop();
 }
 
@@ -149,6 +167,11 @@ void AutomaticReconstructionController::Run() {
     return;
   }
 
+  if (options_.streaming) {
+    RunStreaming();
+    return;
+  }
+
   RunFeatureExtraction();
 
   if (IsStopped()) {
@@ -174,6 +197,43 @@ void AutomaticReconstructionController::Run() {
   }
 }
 
+void AutomaticReconstructionController::RunStreaming() {
+  if (streaming_matcher_ != nullptr) {
+    // The mapper waits for the matches of the extracted images below.
+    THROW_CHECK_NOTNULL(feature_extractor_);
+    active_thread_ = feature_extractor_.get();
+    feature_extractor_->Start();
+    streaming_matcher_->Start();
+  } else {
+    // Exhaustive and vocabulary tree matching need the features of all images.
+    RunFeatureExtraction();
+    if (IsStopped()) {
+      return;
+    }
+    RunFeatureMatching();
+  }
+
+  if (options_.sparse && !IsStopped()) {
+    RunSparseMapper();
+  }
+
+  if (streaming_matcher_ != nullptr) {
+    feature_extractor_->Wait();
+    streaming_matcher_->Wait();
+    active_thread_ = nullptr;
+  }
+
+  if (IsStopped()) {
+    return;
+  }
+
+  // Densify the remaining reconstructions, which were not yet densified while
+  // mapping.
+  if (options_.dense) {
+    RunDenseMapper();
+  }
+}
+
 void AutomaticReconstructionController::RunFeatureExtraction() {
   THROW_CHECK_NOTNULL(feature_extractor_);
   active_thread_ = feature_extractor_.get();
@@ -223,13 +283,61 @@ void AutomaticReconstructionController::RunSparseMapper() {
     }
   }
 
-  IncrementalMapperController mapper(option_manager_.mapper,
+  auto mapper_options = option_manager_.mapper;
+  if (streaming_matcher_ != nullptr) {
+    // Wait for new images until the matching is finished.
+    mapper_options =
+        std::make_shared<IncrementalMapperOptions>(*option_manager_.mapper);
+    mapper_options->stream_new_images = true;
+    mapper_options->stream_max_idle_time = 0;
+  }
+
+  IncrementalMapperController mapper(mapper_options,
                                      *option_manager_.image_path,
                                      *option_manager_.database_path,
                                      reconstruction_manager_);
   mapper.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
+  if (streaming_matcher_ != nullptr) {
+    mapper.SetCheckIfInputFinishedFunc(
+        [this]() { return streaming_matcher_->IsFinished(); });
+  }
+
+  // When streaming, the finished sub-models are densified in the background.
+  // Concurrent sub-models are deleted from the reconstruction manager in any
+  // order, so the indices of the dense workspaces are only stable, when the
+  // sub-models are reconstructed one after another.
+  std::unique_ptr<ThreadPool> dense_thread_pool;
+  std::vector<std::future<void>> dense_futures;
+  size_t num_densified_reconstructions = 0;
+  if (options_.streaming && options_.dense &&
+      (mapper_options->num_parallel_models <= 1 ||
+       !mapper_options->multiple_models)) {
+    CreateDirIfNotExists(JoinPaths(options_.workspace_path, "dense"));
+    dense_thread_pool = std::make_unique<ThreadPool>(1);
+    mapper.AddCallback(
+        IncrementalMapperController::LAST_IMAGE_REG_CALLBACK, [&]() {
+          // All reconstructions in the manager are finished at this point,
+          // since the next sub-model is only added afterwards.
+          for (; num_densified_reconstructions <
+                 reconstruction_manager_->Size();
+               ++num_densified_reconstructions) {
+            const size_t reconstruction_idx = num_densified_reconstructions;
+            std::shared_ptr<const Reconstruction> reconstruction =
+                reconstruction_manager_->Get(reconstruction_idx);
+            dense_futures.push_back(dense_thread_pool->AddTask(
+                [this, reconstruction_idx, reconstruction]() {
+                  RunDenseMapper(reconstruction_idx, *reconstruction);
+                }));
+          }
+        });
+  }
+
   mapper.Run();
 
+  for (auto& dense_future : dense_futures) {
+    dense_future.get();
+  }
+
   CreateDirIfNotExists(sparse_path);
   reconstruction_manager_->Write(sparse_path);
   option_manager_.Write(JoinPaths(sparse_path, "project.ini"));
@@ -239,110 +347,110 @@ void AutomaticReconstructionController::RunDenseMapper() {
   CreateDirIfNotExists(JoinPaths(options_.workspace_path, "dense"));
 
   for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
-    if (IsStopped()) {
+    if (IsStopped() || !RunDenseMapper(i, *reconstruction_manager_->Get(i))) {
       return;
     }
+  }
+}
 
-    const std::string dense_path =
-        JoinPaths(options_.workspace_path, "dense", std::to_string(i));
-    const std::string fused_path = JoinPaths(dense_path, "fused.ply");
-
-    std::string meshing_path;
-    if (options_.mesher == Mesher::POISSON) {
-      meshing_path = JoinPaths(dense_path, "meshed-poisson.ply");
-    } else if (options_.mesher == Mesher::DELAUNAY) {
-      meshing_path = JoinPaths(dense_path, "meshed-delaunay.ply");
-    }
+bool AutomaticReconstructionController::RunDenseMapper(
+    const size_t reconstruction_idx, const Reconstruction& reconstruction) {
+  const std::string dense_path = JoinPaths(
+      options_.workspace_path, "dense", std::to_string(reconstruction_idx));
+  const std::string fused_path = JoinPaths(dense_path, "fused.ply");
+
+  std::string meshing_path;
+  if (options_.mesher == Mesher::POISSON) {
+    meshing_path = JoinPaths(dense_path, "meshed-poisson.ply");
+  } else if (options_.mesher == Mesher::DELAUNAY) {
+    meshing_path = JoinPaths(dense_path, "meshed-delaunay.ply");
+  }
 
-    if (ExistsFile(fused_path) && ExistsFile(meshing_path)) {
-      continue;
-    }
+  if (ExistsFile(fused_path) && ExistsFile(meshing_path)) {
+    return true;
+  }
 
-    // Image undistortion.
+  // Image undistortion.
 
-    if (!ExistsDir(dense_path)) {
-      CreateDirIfNotExists(dense_path);
+  if (!ExistsDir(dense_path)) {
+    CreateDirIfNotExists(dense_path);
 
-      UndistortCameraOptions undistortion_options;
-      undistortion_options.max_image_size =
-          option_manager_.patch_match_stereo->max_image_size;
-      COLMAPUndistorter undistorter(undistortion_options,
-                                    *reconstruction_manager_->Get(i),
-                                    *option_manager_.image_path,
-                                    dense_path);
-      undistorter.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
-      undistorter.Run();
-    }
+    UndistortCameraOptions undistortion_options;
+    undistortion_options.max_image_size =
+        option_manager_.patch_match_stereo->max_image_size;
+    COLMAPUndistorter undistorter(undistortion_options,
+                                  reconstruction,
+                                  *option_manager_.image_path,
+                                  dense_path);
+    undistorter.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
+    undistorter.Run();
+  }
 
-    if (IsStopped()) {
-      return;
-    }
+  if (IsStopped()) {
+    return false;
+  }
 
-    // Patch match stereo.
+  // Patch match stereo.
 
 #if defined(COLMAP_CUDA_ENABLED)
-    {
-      mvs::PatchMatchController patch_match_controller(
-          *option_manager_.patch_match_stereo, dense_path, "COLMAP", "");
-      patch_match_controller.SetCheckIfStoppedFunc(
-          [&]() { return IsStopped(); });
-      patch_match_controller.Run();
-    }
+  {
+    mvs::PatchMatchController patch_match_controller(
+        *option_manager_.patch_match_stereo, dense_path, "COLMAP", "");
+    patch_match_controller.SetCheckIfStoppedFunc(
+        [&]() { return IsStopped(); });
+    patch_match_controller.Run();
+  }
 #else   // COLMAP_CUDA_ENABLED
-    LOG(WARNING) << "Skipping patch match stereo because CUDA is not available";
-    return;
+  LOG(WARNING) << "Skipping patch match stereo because CUDA is not available";
+  return false;
 #endif  // COLMAP_CUDA_ENABLED
 
-    if (IsStopped()) {
-      return;
-    }
+  if (IsStopped()) {
+    return false;
+  }
 
-    // Stereo fusion.
-
-    if (!ExistsFile(fused_path)) {
-      auto fusion_options = *option_manager_.stereo_fusion;
-      const int num_reg_images =
-          reconstruction_manager_->Get(i)->NumRegImages();
-      fusion_options.min_num_pixels =
-          std::min(num_reg_images + 1, fusion_options.min_num_pixels);
-      mvs::StereoFusion fuser(
-          fusion_options,
-          dense_path,
-          "COLMAP",
-          "",
-          options_.quality == Quality::HIGH ? "geometric" : "photometric");
-      fuser.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
-      fuser.Run();
-
-      LOG(INFO) << "Writing output: " << fused_path;
-      WriteBinaryPlyPoints(fused_path, fuser.GetFusedPoints());
-      mvs::WritePointsVisibility(fused_path + ".vis",
-                                 fuser.GetFusedPointsVisibility());
-    }
+  // Stereo fusion.
+
+  if (!ExistsFile(fused_path)) {
+    auto fusion_options = *option_manager_.stereo_fusion;
+    const int num_reg_images = reconstruction.NumRegImages();
+    fusion_options.min_num_pixels =
+        std::min(num_reg_images + 1, fusion_options.min_num_pixels);
+    mvs::StereoFusion fuser(
+        fusion_options,
+        dense_path,
+        "COLMAP",
+        "",
+        options_.quality == Quality::HIGH ? "geometric" : "photometric");
+    fuser.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
+    LOG(INFO) << "Writing output: " << fused_path;
+    fuser.SetOutputPath(fused_path);
+    fuser.Run();
+  }
 
-    if (IsStopped()) {
-      return;
-    }
+  if (IsStopped()) {
+    return false;
+  }
 
-    // Surface meshing.
+  // Surface meshing.
 
-    if (!ExistsFile(meshing_path)) {
-      if (options_.mesher == Mesher::POISSON) {
-        mvs::PoissonMeshing(
-            *option_manager_.poisson_meshing, fused_path, meshing_path);
-      } else if (options_.mesher == Mesher::DELAUNAY) {
+  if (!ExistsFile(meshing_path)) {
+    if (options_.mesher == Mesher::POISSON) {
+      mvs::PoissonMeshing(
+          *option_manager_.poisson_meshing, fused_path, meshing_path);
+    } else if (options_.mesher == Mesher::DELAUNAY) {
 #if defined(COLMAP_CGAL_ENABLED)
-        mvs::DenseDelaunayMeshing(
-            *option_manager_.delaunay_meshing, dense_path, meshing_path);
+      mvs::DenseDelaunayMeshing(
+          *option_manager_.delaunay_meshing, dense_path, meshing_path);
 #else  // COLMAP_CGAL_ENABLED
-        LOG(WARNING)
-            << "Skipping Delaunay meshing because CGAL is not available";
-        return;
-
+      LOG(WARNING)
+          << "Skipping Delaunay meshing because CGAL is not available";
+      return false;
 #endif  // COLMAP_CGAL_ENABLED
-      }
     }
   }
+
+  return true;
 }
 
 }  // namespace colmap
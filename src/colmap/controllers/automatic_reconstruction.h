@@ -79,6 +79,13 @@ class AutomaticReconstructionController : public Thread {
     // Whether to perform sparse mapping.
     bool sparse = true;
 
+    // Whether to overlap the stages instead of running them one after another.
+    // For video data, the sequential matching consumes the images as their
+    // features are extracted and the mapper consumes the matched images. The
+    // dense reconstruction of finished sub-models starts while the mapper
+    // continues with the next sub-model.
+    bool streaming = false;
+
 // Whether to perform dense mapping.
 #if defined(COLMAP_CUDA_ENABLED)
     bool dense = true;
@@ -111,8 +118,12 @@ class AutomaticReconstructionController : public Thread {
   void Run() override;
   void RunFeatureExtraction();
   void RunFeatureMatching();
+  void RunStreaming();
   void RunSparseMapper();
   void RunDenseMapper();
+  // Returns false, if the dense reconstruction was stopped or is unavailable.
+  bool RunDenseMapper(size_t reconstruction_idx,
+                      const Reconstruction& reconstruction);
 
   const Options options_;
   OptionManager option_manager_;
@@ -122,6 +133,7 @@ class AutomaticReconstructionController : public Thread {
   std::unique_ptr<Thread> exhaustive_matcher_;
   std::unique_ptr<Thread> sequential_matcher_;
   std::unique_ptr<Thread> vocab_tree_matcher_;
+  std::unique_ptr<Thread> streaming_matcher_;
 };
 
 }  // namespace colmap
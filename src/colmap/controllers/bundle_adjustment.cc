@@ -97,8 +97,14 @@ void BundleAdjustmentController::Run() {
   ba_config.SetConstantCamPositions(reg_image_ids[1], {0});
 
   // Run bundle adjustment.
-  BundleAdjuster bundle_adjuster(ba_options, ba_config);
-  bundle_adjuster.Solve(reconstruction_.get());
+  if (options_.partitioned_bundle_adjustment->max_num_images > 0) {
+    PartitionedBundleAdjuster bundle_adjuster(
+        *options_.partitioned_bundle_adjustment, ba_options, ba_config);
+    bundle_adjuster.Solve(reconstruction_.get());
+  } else {
+    BundleAdjuster bundle_adjuster(ba_options, ba_config);
+    bundle_adjuster.Solve(reconstruction_.get());
+  }
 
   run_timer.PrintMinutes();
 }
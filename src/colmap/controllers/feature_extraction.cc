@@ -29,26 +29,37 @@
 
 #include "colmap/controllers/feature_extraction.h"
 
+#include "colmap/feature/binary.h"
+#include "colmap/feature/extraction_cache.h"
 #include "colmap/feature/sift.h"
+#include "colmap/feature/sift_pca.h"
 #include "colmap/geometry/gps.h"
 #include "colmap/scene/database.h"
 #include "colmap/util/cuda.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/timer.h"
 
+#include <deque>
 #include <numeric>
+#include <optional>
+#include <queue>
 
 namespace colmap {
 namespace {
 // api: 特征点恢复尺度
+// The full width and height are the extent of the bitmap in pixels of the full
+// resolution image, which only differ from the camera dimensions for images
+// decoded at a reduced resolution.
 void ScaleKeypoints(const Bitmap& bitmap,
-                    const Camera& camera,
+                    const int full_width,
+                    const int full_height,
                     FeatureKeypoints* keypoints) {
-  if (static_cast<size_t>(bitmap.Width()) != camera.width ||
-      static_cast<size_t>(bitmap.Height()) != camera.height) {
-    const float scale_x = static_cast<float>(camera.width) / bitmap.Width();
-    const float scale_y = static_cast<float>(camera.height) / bitmap.Height();
+  if (bitmap.Width() != full_width || bitmap.Height() != full_height) {
+    const float scale_x = static_cast<float>(full_width) / bitmap.Width();
+    const float scale_y = static_cast<float>(full_height) / bitmap.Height();
     for (auto& keypoint : *keypoints) {
       keypoint.Rescale(scale_x, scale_y);
     }
@@ -92,26 +103,79 @@ struct ImageData {
   Camera camera;         // 相机参数
   Image image;           // 图像信息
   PosePrior pose_prior;  // 先验pose
+  // Identifier of a new image in sharded mode, see ImageReader::ShardImageId.
+  image_t shard_image_id = kInvalidImageId;
   Bitmap bitmap;         // freeimage数据
   Bitmap mask;
+  // 原始分辨率下bitmap的范围
+  int full_width = 0;
+  int full_height = 0;
 
   FeatureKeypoints keypoints;      // 多level的特征点
   FeatureDescriptors descriptors;  // 多level的描述子
+
+  // 图像文件签名，用于检测图像的变化
+  bool has_signature = false;
+  FileSignature signature;
+
+  // Hash of the image file content, if the features are cached, and whether
+  // the features were read from the cache instead of being extracted.
+  bool has_content_hash = false;
+  uint64_t content_hash = 0;
+  bool has_cached_features = false;
+};
+
+// api: 预读取的图像数据
+struct PrefetchedBitmap {
+  ImageReader::Status status = ImageReader::Status::FAILURE;
+  Bitmap bitmap;
+  Bitmap mask;
+  bool has_signature = false;
+  FileSignature signature;
+  bool has_content_hash = false;
+  uint64_t content_hash = 0;
+  // Features read from the cache, in which case only the header of the bitmap
+  // is read.
+  bool has_cached_features = false;
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
 };
 
+// api: 原始分辨率下bitmap的范围
+// A JPEG image decoded at a reduced resolution of 1/scale has ceil(size/scale)
+// pixels, where each pixel covers scale pixels at full resolution, so the
+// bitmap covers slightly more than the image at its right and bottom border.
+void SetFullBitmapSize(ImageData* image_data) {
+  image_data->full_width = static_cast<int>(image_data->camera.width);
+  image_data->full_height = static_cast<int>(image_data->camera.height);
+  int original_width;
+  int original_height;
+  if (!image_data->bitmap.OriginalSize(&original_width, &original_height)) {
+    return;
+  }
+  for (const int scale : {2, 4, 8}) {
+    if ((original_width + scale - 1) / scale == image_data->bitmap.Width() &&
+        (original_height + scale - 1) / scale == image_data->bitmap.Height()) {
+      image_data->full_width = scale * image_data->bitmap.Width();
+      image_data->full_height = scale * image_data->bitmap.Height();
+      return;
+    }
+  }
+}
+
 // api: 图像降采样线程类
 class ImageResizerThread : public Thread {
  public:
   ImageResizerThread(int max_image_size,
-                     JobQueue<ImageData>* input_queue,
-                     JobQueue<ImageData>* output_queue)
+                     LockFreeJobQueue<ImageData>* input_queue,
+                     LockFreeJobQueue<ImageData>* output_queue)
       : max_image_size_(max_image_size),
         input_queue_(input_queue),
         output_queue_(output_queue) {}
 
  private:
   void Run() override {
-    std::cout << "run image resizer thread,,," << std::endl;
+    VLOG(1) << "run image resizer thread";
     while (true) {
       if (IsStopped()) {
         break;
@@ -119,6 +183,7 @@ class ImageResizerThread : public Thread {
 
       auto input_job = input_queue_->Pop();
       if (input_job.IsValid()) {
+        COLMAP_PROFILE_SCOPE("ImageResizerThread::Resize");
         auto& image_data = input_job.Data();
 
         if (image_data.status == ImageReader::Status::SUCCESS) {
@@ -149,8 +214,8 @@ class ImageResizerThread : public Thread {
 
   const int max_image_size_;
 
-  JobQueue<ImageData>* input_queue_;
-  JobQueue<ImageData>* output_queue_;
+  LockFreeJobQueue<ImageData>* input_queue_;
+  LockFreeJobQueue<ImageData>* output_queue_;
 };
 
 // api: 特征提取线程类
@@ -158,10 +223,12 @@ class SiftFeatureExtractorThread : public Thread {
  public:
   SiftFeatureExtractorThread(const SiftExtractionOptions& sift_options,
                              const std::shared_ptr<Bitmap>& camera_mask,
-                             JobQueue<ImageData>* input_queue,
-                             JobQueue<ImageData>* output_queue)
+                             const std::shared_ptr<const SiftPCA>& pca,
+                             LockFreeJobQueue<ImageData>* input_queue,
+                             LockFreeJobQueue<ImageData>* output_queue)
       : sift_options_(sift_options),
         camera_mask_(camera_mask),
+        pca_(pca),
         input_queue_(input_queue),
         output_queue_(output_queue) {
     THROW_CHECK(sift_options_.Check());
@@ -176,7 +243,7 @@ class SiftFeatureExtractorThread : public Thread {
  private:
   // api: 特征提取线程主函数
   void Run() override {
-    std::cout << "run feature extractor thread,,," << std::endl;
+    VLOG(1) << "run feature extractor thread";
     if (sift_options_.use_gpu) {
 #if !defined(COLMAP_CUDA_ENABLED)
       THROW_CHECK_NOTNULL(opengl_context_);
@@ -184,8 +251,15 @@ class SiftFeatureExtractorThread : public Thread {
 #endif
     }
     // step: 1 创建提取器
-    std::unique_ptr<FeatureExtractor> extractor =
-        CreateSiftFeatureExtractor(sift_options_);
+    std::unique_ptr<FeatureExtractor> extractor;
+    if (sift_options_.descriptor_type == FeatureDescriptorType::BINARY) {
+      BinaryExtractionOptions binary_options;
+      binary_options.max_num_features = sift_options_.max_num_features;
+      binary_options.upright = sift_options_.upright;
+      extractor = CreateBinaryFeatureExtractor(binary_options);
+    } else {
+      extractor = CreateSiftFeatureExtractor(sift_options_);
+    }
     if (extractor == nullptr) {
       LOG(ERROR) << "Failed to create feature extractor.";
       SignalInvalidSetup();
@@ -202,6 +276,7 @@ class SiftFeatureExtractorThread : public Thread {
 
       auto input_job = input_queue_->Pop();
       if (input_job.IsValid()) {
+        COLMAP_PROFILE_SCOPE("SiftFeatureExtractorThread::Extract");
         auto& image_data = input_job.Data();
 
         if (image_data.status == ImageReader::Status::SUCCESS) {
@@ -210,8 +285,10 @@ class SiftFeatureExtractorThread : public Thread {
                                  &image_data.keypoints,
                                  &image_data.descriptors)) {
             // step: 2.2 尺度恢复
-            ScaleKeypoints(
-                image_data.bitmap, image_data.camera, &image_data.keypoints);
+            ScaleKeypoints(image_data.bitmap,
+                           image_data.full_width,
+                           image_data.full_height,
+                           &image_data.keypoints);
 
             // step: 2.3 mask特征点
             if (camera_mask_) {
@@ -224,6 +301,11 @@ class SiftFeatureExtractorThread : public Thread {
                             &image_data.keypoints,
                             &image_data.descriptors);
             }
+
+            // step: 2.4 PCA降维
+            if (pca_) {
+              image_data.descriptors = pca_->Project(image_data.descriptors);
+            }
           } else {
             image_data.status = ImageReader::Status::FAILURE;
           }
@@ -243,27 +325,36 @@ class SiftFeatureExtractorThread : public Thread {
 
   const SiftExtractionOptions sift_options_;
   std::shared_ptr<Bitmap> camera_mask_;
+  std::shared_ptr<const SiftPCA> pca_;
 
   std::unique_ptr<OpenGLContextManager> opengl_context_;
 
-  JobQueue<ImageData>* input_queue_;
-  JobQueue<ImageData>* output_queue_;
+  LockFreeJobQueue<ImageData>* input_queue_;
+  LockFreeJobQueue<ImageData>* output_queue_;
 };
 
 // api: 特征输出线程类
 class FeatureWriterThread : public Thread {
  public:
   FeatureWriterThread(size_t num_images,
+                      int max_num_images_per_transaction,
+                      double max_transaction_duration,
+                      FeatureDescriptorType descriptor_type,
+                      std::shared_ptr<const FeatureExtractionCache> cache,
                       Database* database,
-                      JobQueue<ImageData>* input_queue)
+                      LockFreeJobQueue<ImageData>* input_queue)
       : num_images_(num_images),
+        max_num_images_per_transaction_(max_num_images_per_transaction),
+        max_transaction_duration_(max_transaction_duration),
+        descriptor_type_(descriptor_type),
+        cache_(std::move(cache)),
         database_(database),
         input_queue_(input_queue) {}
 
  private:
   // api: 特征输出线程主函数
   void Run() override {
-    std::cout << "run feature writer thread,,," << std::endl;
+    VLOG(1) << "run feature writer thread";
 
     size_t image_index = 0;
     while (true) {
@@ -273,20 +364,31 @@ class FeatureWriterThread : public Thread {
 
       auto input_job = input_queue_->Pop();
       if (input_job.IsValid()) {
+        COLMAP_PROFILE_SCOPE("FeatureWriterThread::Write");
         // step: 1 获取数据并打印基本信息
         auto& image_data = input_job.Data();
 
         image_index += 1;
 
-        LOG(INFO) << StringPrintf(
-            "Processed file [%d/%d]", image_index, num_images_);
-
-        LOG(INFO) << StringPrintf("  Name:            %s",
-                                  image_data.image.Name().c_str());
+        // With many extraction threads, the details of every image are only
+        // logged at an increased verbosity, while the progress is logged at
+        // most once per interval. Errors are always logged.
+        const bool log_image = VLOG_IS_ON(1) || image_index == num_images_ ||
+                               log_rate_limiter_.Allow();
+        if (log_image ||
+            (image_data.status != ImageReader::Status::SUCCESS &&
+             image_data.status != ImageReader::Status::IMAGE_EXISTS)) {
+          LOG(INFO) << StringPrintf(
+              "Processed file [%d/%d]", image_index, num_images_);
+          LOG(INFO) << StringPrintf("  Name:            %s",
+                                    image_data.image.Name().c_str());
+        }
 
         // step: 打印数据状态
         if (image_data.status == ImageReader::Status::IMAGE_EXISTS) {
-          LOG(INFO) << "  SKIP: Features for image already extracted.";
+          if (log_image) {
+            LOG(INFO) << "  SKIP: Features for image already extracted.";
+          }
         } else if (image_data.status == ImageReader::Status::BITMAP_ERROR) {
           LOG(ERROR) << "Failed to read image file format.";
         } else if (image_data.status ==
@@ -308,61 +410,119 @@ class FeatureWriterThread : public Thread {
           continue;
         }
 
-        LOG(INFO) << StringPrintf("  Dimensions:      %d x %d",
-                                  image_data.camera.width,
-                                  image_data.camera.height);
-        LOG(INFO) << StringPrintf("  Camera:          #%d - %s",
-                                  image_data.camera.camera_id,
-                                  image_data.camera.ModelName().c_str());
-        LOG(INFO) << StringPrintf(
-            "  Focal Length:    %.2fpx%s",
-            image_data.camera.MeanFocalLength(),
-            image_data.camera.has_prior_focal_length ? " (Prior)" : "");
-        LOG(INFO) << StringPrintf("  Features:        %d",
-                                  image_data.keypoints.size());
-
-        // step: 2 database开启并写入
-        // std::cout << "write feat. data into database,,," << std::endl;
-        DatabaseTransaction database_transaction(database_);
-
-        if (image_data.image.ImageId() == kInvalidImageId) {
-          // step: 2.1 image
-          image_data.image.SetImageId(database_->WriteImage(image_data.image));
+        if (log_image) {
+          LOG(INFO) << StringPrintf("  Dimensions:      %d x %d",
+                                    image_data.camera.width,
+                                    image_data.camera.height);
+          LOG(INFO) << StringPrintf("  Camera:          #%d - %s",
+                                    image_data.camera.camera_id,
+                                    image_data.camera.ModelName().c_str());
+          LOG(INFO) << StringPrintf(
+              "  Focal Length:    %.2fpx%s",
+              image_data.camera.MeanFocalLength(),
+              image_data.camera.has_prior_focal_length ? " (Prior)" : "");
+          LOG(INFO) << StringPrintf(
+              "  Features:        %d%s",
+              image_data.keypoints.size(),
+              image_data.has_cached_features ? " (Cached)" : "");
 
-          // step: 2.2 pose_prior
           if (image_data.pose_prior.IsValid()) {
             LOG(INFO) << StringPrintf(
                 "  GPS:             LAT=%.3f, LON=%.3f, ALT=%.3f",
                 image_data.pose_prior.position.x(),
                 image_data.pose_prior.position.y(),
                 image_data.pose_prior.position.z());
-            database_->WritePosePrior(image_data.image.ImageId(),
-                                      image_data.pose_prior);
           }
         }
 
-        // step: 2.3 keypoints
-        if (!database_->ExistsKeypoints(image_data.image.ImageId())) {
-          database_->WriteKeypoints(image_data.image.ImageId(),
-                                    image_data.keypoints);
+        if (cache_ && image_data.has_content_hash &&
+            !image_data.has_cached_features) {
+          cache_->Write(image_data.content_hash,
+                        image_data.keypoints,
+                        image_data.descriptors);
         }
 
-        // step: 2.4 desc.
-        if (!database_->ExistsDescriptors(image_data.image.ImageId())) {
-          database_->WriteDescriptors(image_data.image.ImageId(),
-                                      image_data.descriptors);
+        // step: 2 缓存数据，批量写入database
+        image_data.bitmap.Deallocate();
+        image_data.mask.Deallocate();
+        if (pending_image_data_.empty()) {
+          transaction_timer_.Restart();
+        }
+        pending_image_data_.push_back(std::move(image_data));
+        if (pending_image_data_.size() >=
+                static_cast<size_t>(max_num_images_per_transaction_) ||
+            transaction_timer_.ElapsedSeconds() >= max_transaction_duration_) {
+          WritePendingImageData();
         }
       } else {
         break;
       }
     }
 
+    WritePendingImageData();
     // std::cout << "exit feature writer thread." << std::endl;
   }
 
+  // api: 在一个transaction中写入缓存的数据
+  // The transaction is only open while writing, because the image reader
+  // writes the cameras through the same database in between.
+  void WritePendingImageData() {
+    if (pending_image_data_.empty()) {
+      return;
+    }
+
+    DatabaseTransaction database_transaction(database_);
+
+    for (auto& image_data : pending_image_data_) {
+      if (image_data.image.ImageId() == kInvalidImageId) {
+        // step: 2.1 image
+        if (image_data.shard_image_id != kInvalidImageId) {
+          image_data.image.SetImageId(image_data.shard_image_id);
+          database_->WriteImage(image_data.image, /*use_image_id=*/true);
+        } else {
+          image_data.image.SetImageId(database_->WriteImage(image_data.image));
+        }
+
+        // step: 2.2 pose_prior
+        if (image_data.pose_prior.IsValid()) {
+          database_->WritePosePrior(image_data.image.ImageId(),
+                                    image_data.pose_prior);
+        }
+      }
+
+      // step: 2.3 keypoints
+      if (!database_->ExistsKeypoints(image_data.image.ImageId())) {
+        database_->WriteKeypoints(image_data.image.ImageId(),
+                                  image_data.keypoints);
+      }
+
+      // step: 2.4 desc.
+      if (!database_->ExistsDescriptors(image_data.image.ImageId())) {
+        database_->WriteDescriptors(image_data.image.ImageId(),
+                                    image_data.descriptors,
+                                    descriptor_type_);
+      }
+
+      // step: 2.5 图像文件签名
+      if (image_data.has_signature) {
+        database_->WriteImageSignature(image_data.image.ImageId(),
+                                       image_data.signature);
+      }
+    }
+
+    pending_image_data_.clear();
+  }
+
   const size_t num_images_;
+  const int max_num_images_per_transaction_;
+  const double max_transaction_duration_;
+  const FeatureDescriptorType descriptor_type_;
+  const std::shared_ptr<const FeatureExtractionCache> cache_;
   Database* database_;
-  JobQueue<ImageData>* input_queue_;
+  LockFreeJobQueue<ImageData>* input_queue_;
+  std::vector<ImageData> pending_image_data_;
+  Timer transaction_timer_;
+  LogRateLimiter log_rate_limiter_{/*min_interval=*/1.0};
 };
 
 // Feature extraction class to extract features for all images in a directory.
@@ -378,11 +538,13 @@ class FeatureExtractorController : public Thread {
     THROW_CHECK(reader_options_.Check());
     THROW_CHECK(sift_options_.Check());
 
-    std::cout << "new feature extractor controller,,," << std::endl;
+    database_.SetProfile(Database::Profile::BULK);
+
+    VLOG(1) << "new feature extractor controller";
     // step: 1 camera_mask
     std::shared_ptr<Bitmap> camera_mask;
     if (!reader_options_.camera_mask_path.empty()) {
-      std::cout << "load camera_mask,,, " << std::endl;
+      VLOG(1) << "load camera_mask";
       camera_mask = std::make_shared<Bitmap>();
       if (!camera_mask->Read(reader_options_.camera_mask_path,
                              /*as_rgb*/ false)) {
@@ -393,22 +555,45 @@ class FeatureExtractorController : public Thread {
       }
     }
 
+    // The projection is shared by all extractor threads.
+    std::shared_ptr<const SiftPCA> pca;
+    FeatureDescriptorType descriptor_type = sift_options_.descriptor_type;
+    if (!sift_options_.pca_path.empty()) {
+      auto loaded_pca = std::make_shared<SiftPCA>();
+      loaded_pca->Read(sift_options_.pca_path);
+      LOG(INFO) << "Reducing descriptors to " << loaded_pca->NumDims()
+                << " dimensions";
+      pca = std::move(loaded_pca);
+      descriptor_type = FeatureDescriptorType::SIFT_PCA;
+    }
+
     // step: 2 线程资源
     const int num_threads = GetEffectiveNumThreads(sift_options_.num_threads);
     THROW_CHECK_GT(num_threads, 0);
-    std::cout << "num_threads: " << num_threads << std::endl;
+    VLOG(1) << "num_threads: " << num_threads;
 
     // Make sure that we only have limited number of objects in the queue to
     // avoid excess in memory usage since images and features take lots of
     // memory.
     // step: 3 控制JobQueue的数量
     const int kQueueSize = 1;
-    resizer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
-    extractor_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
-    writer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
+    resizer_queue_ = std::make_unique<LockFreeJobQueue<ImageData>>(kQueueSize);
+    extractor_queue_ =
+        std::make_unique<LockFreeJobQueue<ImageData>>(kQueueSize);
+    writer_queue_ = std::make_unique<LockFreeJobQueue<ImageData>>(kQueueSize);
+
+    // note: use_gpu就不可以domain_size_pooling或estimate_affine_shape
+    const bool use_gpu_extraction =
+        sift_options_.descriptor_type == FeatureDescriptorType::SIFT &&
+        !sift_options_.domain_size_pooling &&
+        !sift_options_.estimate_affine_shape && sift_options_.use_gpu;
 
     // step: 4 分配Resizer线程数组
-    if (sift_options_.max_image_size > 0) {
+    // SiftGPU down-samples images larger than the maximum image size itself,
+    // in which case the full resolution image is uploaded and the keypoints
+    // are returned in the original image coordinates.
+    if (sift_options_.max_image_size > 0 &&
+        !(use_gpu_extraction && sift_options_.gpu_downsample)) {
       for (int i = 0; i < num_threads; ++i) {
         resizers_.emplace_back(
             std::make_unique<ImageResizerThread>(sift_options_.max_image_size,
@@ -416,13 +601,11 @@ class FeatureExtractorController : public Thread {
                                                  extractor_queue_.get()));
       }
     }
-    std::cout << "resizers size: " << resizers_.size() << std::endl;
+    VLOG(1) << "resizers size: " << resizers_.size();
 
     // step: 5 特征提取
-    // note: use_gpu就不可以domain_size_pooling或estimate_affine_shape
-    if (!sift_options_.domain_size_pooling &&
-        !sift_options_.estimate_affine_shape && sift_options_.use_gpu) {
-      std::cout << "sift feat. using gpu,,," << std::endl;
+    if (use_gpu_extraction) {
+      VLOG(1) << "sift feat. using gpu";
 
       std::vector<int> gpu_indices = CSVToVector<int>(sift_options_.gpu_index);
       THROW_CHECK_GT(gpu_indices.size(), 0);
@@ -436,21 +619,27 @@ class FeatureExtractorController : public Thread {
       }
 #endif  // COLMAP_CUDA_ENABLED
       // step: 5.1 按GPU数量分配
+      // All threads pull from the same queue, so that faster GPUs process
+      // proportionally more images than slower ones.
       auto sift_gpu_options = sift_options_;
       for (const auto& gpu_index : gpu_indices) {
-        std::cout << "gpu_index: " << gpu_index << std::endl;
+        VLOG(1) << "gpu_index: " << gpu_index;
 
         sift_gpu_options.gpu_index = std::to_string(gpu_index);
-        extractors_.emplace_back(
-            std::make_unique<SiftFeatureExtractorThread>(sift_gpu_options,
-                                                         camera_mask,
-                                                         extractor_queue_.get(),
-                                                         writer_queue_.get()));
+        for (int i = 0; i < sift_options_.gpu_num_threads_per_device; ++i) {
+          extractors_.emplace_back(std::make_unique<SiftFeatureExtractorThread>(
+              sift_gpu_options,
+              camera_mask,
+              pca,
+              extractor_queue_.get(),
+              writer_queue_.get()));
+        }
       }
     } else {
-      std::cout << "sift feat. using cpu,,," << std::endl;
+      VLOG(1) << "sift feat. using cpu";
 
-      if (sift_options_.num_threads == -1 &&
+      if (sift_options_.descriptor_type == FeatureDescriptorType::SIFT &&
+          sift_options_.num_threads == -1 &&
           sift_options_.max_image_size ==
               SiftExtractionOptions().max_image_size &&
           sift_options_.first_octave == SiftExtractionOptions().first_octave) {
@@ -471,14 +660,42 @@ class FeatureExtractorController : public Thread {
         extractors_.emplace_back(
             std::make_unique<SiftFeatureExtractorThread>(custom_sift_options,
                                                          camera_mask,
+                                                         pca,
                                                          extractor_queue_.get(),
                                                          writer_queue_.get()));
       }
     }
 
+    // The cached features of an image are only valid for the same options and
+    // camera mask, whereas per-image masks are not part of the image content.
+    if (!sift_options_.feature_cache_path.empty()) {
+      if (reader_options_.mask_path.empty()) {
+        auto fingerprint_options = sift_options_;
+        fingerprint_options.use_gpu = use_gpu_extraction;
+        uint64_t fingerprint =
+            ComputeFeatureExtractionFingerprint(fingerprint_options);
+        if (camera_mask) {
+          const uint64_t camera_mask_hash =
+              ComputeFileContentHash(reader_options_.camera_mask_path);
+          fingerprint = ComputeFNV1aHash(
+              &camera_mask_hash, sizeof(camera_mask_hash), fingerprint);
+        }
+        feature_cache_ = std::make_shared<FeatureExtractionCache>(
+            sift_options_.feature_cache_path, fingerprint);
+      } else {
+        LOG(WARNING) << "The feature cache is disabled for images with masks.";
+      }
+    }
+
     // step: 6 特征输出
     writer_ = std::make_unique<FeatureWriterThread>(
-        image_reader_.NumImages(), &database_, writer_queue_.get());
+        image_reader_.NumImages(),
+        sift_options_.max_num_images_per_transaction,
+        sift_options_.max_transaction_duration,
+        descriptor_type,
+        feature_cache_,
+        &database_,
+        writer_queue_.get());
   }
 
  private:
@@ -506,6 +723,13 @@ class FeatureExtractorController : public Thread {
     }
 
     // step: 2 循环处理数据
+    // Decoding the images is the most expensive part of reading them and is
+    // done in parallel ahead of time, whereas the cameras are assigned in the
+    // order of the images by the image reader.
+    ThreadPool reader_pool(reader_options_.num_threads);
+    const size_t max_num_prefetched = 2 * reader_pool.NumThreads();
+    std::queue<std::future<PrefetchedBitmap>> prefetched_bitmaps;
+    size_t prefetch_index = image_reader_.NextIndex();
     while (image_reader_.NextIndex() < image_reader_.NumImages()) {
       if (IsStopped()) {
         resizer_queue_->Stop();
@@ -515,20 +739,89 @@ class FeatureExtractorController : public Thread {
         break;
       }
 
+      COLMAP_PROFILE_SCOPE("FeatureExtractorController::ReadImage");
+
+      while (prefetch_index < image_reader_.NumImages() &&
+             prefetched_bitmaps.size() < max_num_prefetched) {
+        prefetched_bitmaps.push(reader_pool.AddTask([this, prefetch_index]() {
+          PrefetchedBitmap prefetched;
+          if (!image_reader_.IsImageProcessed(prefetch_index)) {
+            // Cached features are looked up before decoding the image, which
+            // then only requires its header to assign the camera.
+            if (feature_cache_) {
+              prefetched.has_content_hash =
+                  image_reader_.ComputeImageContentHash(
+                      prefetch_index, &prefetched.content_hash);
+              prefetched.has_cached_features =
+                  prefetched.has_content_hash &&
+                  feature_cache_->Read(prefetched.content_hash,
+                                       &prefetched.keypoints,
+                                       &prefetched.descriptors);
+            }
+            prefetched.status =
+                prefetched.has_cached_features
+                    ? image_reader_.ReadBitmapHeader(prefetch_index,
+                                                     &prefetched.bitmap)
+                    : image_reader_.ReadBitmap(prefetch_index,
+                                               &prefetched.bitmap,
+                                               &prefetched.mask);
+            // The file is likely still cached after decoding it.
+            prefetched.has_signature = image_reader_.ComputeImageSignature(
+                prefetch_index, &prefetched.signature);
+          }
+          return prefetched;
+        }));
+        prefetch_index += 1;
+      }
+
       // step: 2.1 读取图片数据
+      PrefetchedBitmap prefetched = prefetched_bitmaps.front().get();
+      prefetched_bitmaps.pop();
       ImageData image_data;
-      image_data.status = image_reader_.Next(&image_data.camera,
-                                             &image_data.image,
-                                             &image_data.pose_prior,
-                                             &image_data.bitmap,
-                                             &image_data.mask);
+      image_data.bitmap = std::move(prefetched.bitmap);
+      image_data.mask = std::move(prefetched.mask);
+      image_data.has_signature = prefetched.has_signature;
+      image_data.signature = prefetched.signature;
+      image_data.has_content_hash = prefetched.has_content_hash;
+      image_data.content_hash = prefetched.content_hash;
+      image_data.has_cached_features = prefetched.has_cached_features;
+      if (image_reader_.IsImageProcessed(image_reader_.NextIndex())) {
+        // The bitmap is only read, if the features were removed in between.
+        image_data.status = image_reader_.Next(&image_data.camera,
+                                               &image_data.image,
+                                               &image_data.pose_prior,
+                                               &image_data.bitmap,
+                                               &image_data.mask);
+      } else {
+        image_data.status =
+            image_reader_.NextWithBitmap(&image_data.camera,
+                                         &image_data.image,
+                                         &image_data.pose_prior,
+                                         &image_data.bitmap,
+                                         &image_data.mask,
+                                         prefetched.status);
+      }
+      image_data.shard_image_id =
+          image_reader_.ShardImageId(image_reader_.NextIndex() - 1);
 
-      if (image_data.status != ImageReader::Status::SUCCESS) {
+      if (image_data.status == ImageReader::Status::SUCCESS) {
+        SetFullBitmapSize(&image_data);
+      } else {
         image_data.bitmap.Deallocate();
       }
 
       // step: 2.2 resizer / extractor 处理当前图片
-      if (sift_options_.max_image_size > 0) {
+      if (image_data.status == ImageReader::Status::SUCCESS &&
+          image_data.has_cached_features) {
+        static MetricCounter* num_cached_images =
+            MetricsRegistry::Instance().Counter(
+                "colmap_feature_cache_hits_total",
+                "Number of images whose features were read from the cache");
+        num_cached_images->Increment();
+        image_data.keypoints = std::move(prefetched.keypoints);
+        image_data.descriptors = std::move(prefetched.descriptors);
+        THROW_CHECK(writer_queue_->Push(std::move(image_data)));
+      } else if (!resizers_.empty()) {
         // std::cout << "resizer_queue_ data + 1" << std::endl;
         THROW_CHECK(resizer_queue_->Push(std::move(image_data)));
       } else {
@@ -562,18 +855,20 @@ class FeatureExtractorController : public Thread {
 
   Database database_;
   ImageReader image_reader_;
+  std::shared_ptr<const FeatureExtractionCache> feature_cache_;
 
   std::vector<std::unique_ptr<Thread>> resizers_;
   std::vector<std::unique_ptr<Thread>> extractors_;
   std::unique_ptr<Thread> writer_;
 
-  std::unique_ptr<JobQueue<ImageData>> resizer_queue_;
-  std::unique_ptr<JobQueue<ImageData>> extractor_queue_;
-  std::unique_ptr<JobQueue<ImageData>> writer_queue_;
+  std::unique_ptr<LockFreeJobQueue<ImageData>> resizer_queue_;
+  std::unique_ptr<LockFreeJobQueue<ImageData>> extractor_queue_;
+  std::unique_ptr<LockFreeJobQueue<ImageData>> writer_queue_;
 };
 
-// Import features from text files. Each image must have a corresponding text
-// file with the same name and an additional ".txt" suffix.
+// Import features from text or NumPy files. Each image must have a
+// corresponding text file with the same name and an additional ".txt" suffix
+// or a pair of ".keypoints.npy" and ".descriptors.npy" files.
 class FeatureImporterController : public Thread {
  public:
   FeatureImporterController(const ImageReaderOptions& reader_options,
@@ -592,58 +887,121 @@ class FeatureImporterController : public Thread {
     }
 
     Database database(reader_options_.database_path);
+    database.SetProfile(Database::Profile::BULK);
     ImageReader image_reader(reader_options_, &database);
 
-    while (image_reader.NextIndex() < image_reader.NumImages()) {
-      if (IsStopped()) {
-        break;
+    // The feature files are parsed in parallel, while this thread reads the
+    // image metadata and writes the parsed features of a batch of images in
+    // a single transaction. The next batch is parsed concurrently.
+    ThreadPool thread_pool(reader_options_.num_threads);
+    const size_t batch_size = 2 * thread_pool.NumThreads();
+    std::deque<PendingImage> pending_images;
+    while (!IsStopped()) {
+      while (pending_images.size() < 2 * batch_size &&
+             image_reader.NextIndex() < image_reader.NumImages()) {
+        LOG(INFO) << StringPrintf("Processing file [%d/%d]",
+                                  image_reader.NextIndex() + 1,
+                                  image_reader.NumImages());
+
+        // Load image metadata and possibly save camera to database. The
+        // pixels are not needed, so only the file header is read.
+        Camera camera;
+        PendingImage pending_image;
+        if (image_reader.NextMetadata(
+                &camera, &pending_image.image, &pending_image.pose_prior) !=
+            ImageReader::Status::SUCCESS) {
+          continue;
+        }
+        pending_image.shard_image_id =
+            image_reader.ShardImageId(image_reader.NextIndex() - 1);
+        pending_image.features = thread_pool.AddTask(
+            &FeatureImporterController::ReadFeatures,
+            this,
+            pending_image.image.Name());
+        pending_images.push_back(std::move(pending_image));
       }
 
-      LOG(INFO) << StringPrintf("Processing file [%d/%d]",
-                                image_reader.NextIndex() + 1,
-                                image_reader.NumImages());
-
-      // Load image data and possibly save camera to database.
-      Camera camera;
-      Image image;
-      PosePrior pose_prior;
-      Bitmap bitmap;
-      if (image_reader.Next(&camera, &image, &pose_prior, &bitmap, nullptr) !=
-          ImageReader::Status::SUCCESS) {
-        continue;
+      if (pending_images.empty()) {
+        break;
       }
 
-      const std::string path = JoinPaths(import_path_, image.Name() + ".txt");
-
-      if (ExistsFile(path)) {
-        FeatureKeypoints keypoints;
-        FeatureDescriptors descriptors;
-        LoadSiftFeaturesFromTextFile(path, &keypoints, &descriptors);
+      DatabaseTransaction database_transaction(&database);
+      for (size_t i = 0; i < batch_size && !pending_images.empty(); ++i) {
+        WriteFeatures(&pending_images.front(), &database);
+        pending_images.pop_front();
+      }
+    }
 
-        LOG(INFO) << "Features:       " << keypoints.size();
+    run_timer.PrintMinutes();
+  }
 
-        DatabaseTransaction database_transaction(&database);
+  struct ImportedFeatures {
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+  };
+
+  struct PendingImage {
+    Image image;
+    PosePrior pose_prior;
+    image_t shard_image_id = kInvalidImageId;
+    // Empty, if no features were found for the image.
+    std::future<std::optional<ImportedFeatures>> features;
+  };
+
+  // Read the features of the image from a text file, see
+  // LoadSiftFeaturesFromTextFile, or from binary .npy files, see
+  // LoadSiftFeaturesFromNpyFiles, if no text file exists.
+  std::optional<ImportedFeatures> ReadFeatures(
+      const std::string& image_name) const {
+    const std::string path = JoinPaths(import_path_, image_name);
+    ImportedFeatures features;
+    if (ExistsFile(path + ".txt")) {
+      LoadSiftFeaturesFromTextFile(
+          path + ".txt", &features.keypoints, &features.descriptors);
+    } else if (ExistsFile(path + ".keypoints.npy") &&
+               ExistsFile(path + ".descriptors.npy")) {
+      LoadSiftFeaturesFromNpyFiles(path + ".keypoints.npy",
+                                   path + ".descriptors.npy",
+                                   &features.keypoints,
+                                   &features.descriptors);
+    } else {
+      LOG(INFO) << "SKIP: No features found at " << path
+                << ".{txt,keypoints.npy}";
+      return std::nullopt;
+    }
+    return features;
+  }
 
-        if (image.ImageId() == kInvalidImageId) {
-          image.SetImageId(database.WriteImage(image));
-          if (pose_prior.IsValid()) {
-            database.WritePosePrior(image.ImageId(), pose_prior);
-          }
-        }
+  void WriteFeatures(PendingImage* pending_image, Database* database) const {
+    const std::optional<ImportedFeatures> features =
+        pending_image->features.get();
+    if (!features) {
+      return;
+    }
 
-        if (!database.ExistsKeypoints(image.ImageId())) {
-          database.WriteKeypoints(image.ImageId(), keypoints);
-        }
+    VLOG(1) << pending_image->image.Name()
+            << " features: " << features->keypoints.size();
 
-        if (!database.ExistsDescriptors(image.ImageId())) {
-          database.WriteDescriptors(image.ImageId(), descriptors);
-        }
+    Image& image = pending_image->image;
+    if (image.ImageId() == kInvalidImageId) {
+      if (pending_image->shard_image_id != kInvalidImageId) {
+        image.SetImageId(pending_image->shard_image_id);
+        database->WriteImage(image, /*use_image_id=*/true);
       } else {
-        LOG(INFO) << "SKIP: No features found at " << path;
+        image.SetImageId(database->WriteImage(image));
+      }
+      if (pending_image->pose_prior.IsValid()) {
+        database->WritePosePrior(image.ImageId(), pending_image->pose_prior);
       }
     }
 
-    run_timer.PrintMinutes();
+    if (!database->ExistsKeypoints(image.ImageId())) {
+      database->WriteKeypoints(image.ImageId(), features->keypoints);
+    }
+
+    if (!database->ExistsDescriptors(image.ImageId())) {
+      database->WriteDescriptors(image.ImageId(), features->descriptors);
+    }
   }
 
   const ImageReaderOptions reader_options_;
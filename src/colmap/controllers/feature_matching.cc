@@ -34,10 +34,17 @@
 #include "colmap/feature/matcher.h"
 #include "colmap/feature/utils.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/npy.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <future>
 #include <numeric>
+#include <thread>
+#include <unordered_set>
 
 namespace colmap {
 namespace {
@@ -46,6 +53,63 @@ void PrintElapsedTime(const Timer& timer) {
   LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
 }
 
+// Only sequential matching predicts the two-view geometries of the pairs.
+template <typename PairOptions, typename PairGenerator>
+std::unordered_map<image_pair_t, TwoViewGeometry> PredictTwoViewGeometries(
+    const PairOptions& /*pair_options*/,
+    const PairGenerator& /*pair_generator*/,
+    FeatureMatcherCache* /*cache*/,
+    const std::vector<std::pair<image_t, image_t>>& /*image_pairs*/) {
+  return {};
+}
+
+// Predict the geometry of each pair by the verified geometry of the preceding
+// pair in the sequence with the same offset. The fundamental matrix or
+// homography only carries over for images of the same camera.
+std::unordered_map<image_pair_t, TwoViewGeometry> PredictTwoViewGeometries(
+    const SequentialMatchingOptions& pair_options,
+    const SequentialPairGenerator& pair_generator,
+    FeatureMatcherCache* cache,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs) {
+  std::unordered_map<image_pair_t, TwoViewGeometry> predictions;
+  if (!pair_options.motion_prediction) {
+    return predictions;
+  }
+
+  for (const auto& image_pair : image_pairs) {
+    std::pair<image_t, image_t> preceding_image_pair;
+    if (!pair_generator.PrecedingImagePair(image_pair,
+                                           &preceding_image_pair) ||
+        !cache->ExistsInlierMatches(preceding_image_pair.first,
+                                    preceding_image_pair.second)) {
+      continue;
+    }
+    const camera_t camera_id = cache->GetImage(image_pair.first).CameraId();
+    if (cache->GetImage(image_pair.second).CameraId() != camera_id ||
+        cache->GetImage(preceding_image_pair.first).CameraId() != camera_id) {
+      continue;
+    }
+    TwoViewGeometry prediction = cache->GetTwoViewGeometry(
+        preceding_image_pair.first, preceding_image_pair.second);
+    prediction.inlier_matches.clear();
+    predictions.emplace(
+        Database::ImagePairToPairId(image_pair.first, image_pair.second),
+        std::move(prediction));
+  }
+  return predictions;
+}
+
+// Only imported pairs load the images on demand, since all other pair
+// generators visit all images in the database.
+template <typename PairOptions>
+bool UseLazyImageLoading(const PairOptions& /*pair_options*/) {
+  return false;
+}
+
+bool UseLazyImageLoading(const ImagePairsMatchingOptions& pair_options) {
+  return pair_options.lazy_image_loading;
+}
+
 // api: 特征匹配线程模板类，包含控制器对象
 template <typename DerivedPairGenerator>
 class GenericFeatureMatcher : public Thread {
@@ -63,6 +127,10 @@ class GenericFeatureMatcher : public Thread {
             matching_options, geometry_options, database_.get(), cache_.get()) {
     THROW_CHECK(matching_options.Check());
     THROW_CHECK(geometry_options.Check());
+    database_->SetProfile(Database::Profile::BULK);
+    cache_->SetFeatureStore(
+        FeatureStore::OpenForDatabase(database_path, *database_));
+    cache_->SetLazyImageLoading(UseLazyImageLoading(pair_options_));
   }
 
  private:
@@ -84,6 +152,7 @@ class GenericFeatureMatcher : public Thread {
     DerivedPairGenerator pair_generator(pair_options_, cache_);
     while (!pair_generator.HasFinished()) {
       if (IsStopped()) {
+        matcher_.Commit();
         run_timer.PrintMinutes();
         return;
       }
@@ -94,12 +163,15 @@ class GenericFeatureMatcher : public Thread {
       const std::vector<std::pair<image_t, image_t>> image_pairs =
           pair_generator.Next();
 
-      DatabaseTransaction database_transaction(database_.get());
-      
       // step: 3.2 特征匹配控制器 进行 Match
-      matcher_.Match(image_pairs);
+      matcher_.Match(image_pairs,
+                     PredictTwoViewGeometries(pair_options_,
+                                              pair_generator,
+                                              cache_.get(),
+                                              image_pairs));
       PrintElapsedTime(timer);
     }
+    matcher_.Commit();
     run_timer.PrintMinutes();
   }
 
@@ -129,6 +201,15 @@ std::unique_ptr<Thread> CreateVocabTreeFeatureMatcher(
       options, matching_options, geometry_options, database_path);
 }
 
+std::unique_ptr<Thread> CreateVLADFeatureMatcher(
+    const VLADMatchingOptions& options,
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    const std::string& database_path) {
+  return std::make_unique<GenericFeatureMatcher<VLADPairGenerator>>(
+      options, matching_options, geometry_options, database_path);
+}
+
 std::unique_ptr<Thread> CreateSequentialFeatureMatcher(
     const SequentialMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
@@ -149,6 +230,184 @@ std::unique_ptr<Thread> CreateSpatialFeatureMatcher(
 
 namespace {
 
+class StreamingSequentialFeatureMatcher : public Thread {
+ public:
+  StreamingSequentialFeatureMatcher(
+      const SequentialMatchingOptions& options,
+      const StreamingMatchingOptions& streaming_options,
+      const SiftMatchingOptions& matching_options,
+      const TwoViewGeometryOptions& geometry_options,
+      const std::string& database_path,
+      std::function<bool()> is_input_finished)
+      : options_(options),
+        streaming_options_(streaming_options),
+        matching_options_(matching_options),
+        is_input_finished_(std::move(is_input_finished)),
+        database_(std::make_shared<Database>(database_path)),
+        cache_(std::make_shared<FeatureMatcherCache>(
+            SequentialPairGenerator::CacheSize(options_), database_)),
+        matcher_(
+            matching_options, geometry_options, database_.get(), cache_.get()) {
+    THROW_CHECK(options.Check());
+    THROW_CHECK_GT(streaming_options.poll_interval, 0);
+    THROW_CHECK(matching_options.Check());
+    THROW_CHECK(geometry_options.Check());
+    if (options_.loop_detection) {
+      LOG(WARNING) << "Loop detection is not supported in streaming matching";
+    }
+    database_->SetProfile(Database::Profile::BULK);
+  }
+
+ private:
+  void Run() override {
+    PrintHeading1("Streaming sequential feature matching");
+    Timer run_timer;
+    run_timer.Start();
+
+    // The features of the images are not known before they are extracted, so
+    // the memory is bounded by the number of matches instead.
+    if (!matcher_.Setup(matching_options_.max_num_matches)) {
+      return;
+    }
+
+    cache_->Setup();
+
+    std::vector<image_t> new_image_ids = cache_->GetImageIds();
+
+    Timer idle_timer;
+    idle_timer.Start();
+    while (!IsStopped()) {
+      if (new_image_ids.empty()) {
+        // Check for completion before polling, such that the images written
+        // right before the input finished are not missed.
+        const bool is_input_finished =
+            is_input_finished_ && is_input_finished_();
+        new_image_ids = cache_->AddNewImages();
+        if (new_image_ids.empty()) {
+          if (is_input_finished ||
+              (streaming_options_.max_idle_time > 0 &&
+               idle_timer.ElapsedSeconds() >=
+                   streaming_options_.max_idle_time)) {
+            break;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(
+              static_cast<int64_t>(1000 * streaming_options_.poll_interval)));
+          continue;
+        }
+      }
+
+      Timer timer;
+      timer.Start();
+      LOG(INFO) << StringPrintf(
+          "Matching %d new images [%d total]",
+          new_image_ids.size(),
+          ordered_image_ids_.size() + new_image_ids.size());
+      matcher_.Match(NextImagePairs(new_image_ids));
+      // Commit, such that a concurrent mapper can read the matches.
+      matcher_.Commit();
+      PrintElapsedTime(timer);
+
+      new_image_ids.clear();
+      idle_timer.Restart();
+    }
+
+    matcher_.Commit();
+    run_timer.PrintMinutes();
+  }
+
+  // Insert the new images into the name order and pair them with their
+  // neighbors in the order, as in the sequential pair generator.
+  std::vector<std::pair<image_t, image_t>> NextImagePairs(
+      const std::vector<image_t>& new_image_ids) {
+    const auto name_less = [this](const image_t image_id1,
+                                  const image_t image_id2) {
+      return cache_->GetImage(image_id1).Name() <
+             cache_->GetImage(image_id2).Name();
+    };
+
+    for (const image_t image_id : new_image_ids) {
+      ordered_image_ids_.insert(std::upper_bound(ordered_image_ids_.begin(),
+                                                 ordered_image_ids_.end(),
+                                                 image_id,
+                                                 name_less),
+                                image_id);
+    }
+
+    std::vector<size_t> offsets;
+    for (int i = 1; i < options_.overlap; ++i) {
+      offsets.push_back(i);
+    }
+    if (options_.quadratic_overlap) {
+      for (int i = 0; i < options_.overlap && i < 63; ++i) {
+        offsets.push_back(size_t(1) << i);
+      }
+    }
+
+    const std::unordered_set<image_t> new_image_ids_set(new_image_ids.begin(),
+                                                        new_image_ids.end());
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    for (size_t idx = 0; idx < ordered_image_ids_.size(); ++idx) {
+      const image_t image_id = ordered_image_ids_[idx];
+      if (new_image_ids_set.count(image_id) == 0) {
+        continue;
+      }
+      for (const size_t offset : offsets) {
+        if (offset <= idx) {
+          image_pairs.emplace_back(ordered_image_ids_[idx - offset], image_id);
+        }
+        if (idx + offset < ordered_image_ids_.size()) {
+          image_pairs.emplace_back(image_id, ordered_image_ids_[idx + offset]);
+        }
+      }
+    }
+
+    // Pairs of two new images are generated twice and pairs that were matched
+    // before remain matched, when new images are inserted between them.
+    std::vector<std::pair<image_t, image_t>> unique_image_pairs;
+    unique_image_pairs.reserve(image_pairs.size());
+    for (const auto& image_pair : image_pairs) {
+      if (matched_image_pair_ids_
+              .insert(Database::ImagePairToPairId(image_pair.first,
+                                                  image_pair.second))
+              .second) {
+        unique_image_pairs.push_back(image_pair);
+      }
+    }
+
+    return unique_image_pairs;
+  }
+
+  const SequentialMatchingOptions options_;
+  const StreamingMatchingOptions streaming_options_;
+  const SiftMatchingOptions matching_options_;
+  const std::function<bool()> is_input_finished_;
+  const std::shared_ptr<Database> database_;
+  const std::shared_ptr<FeatureMatcherCache> cache_;
+  FeatureMatcherController matcher_;
+  std::vector<image_t> ordered_image_ids_;
+  std::unordered_set<image_pair_t> matched_image_pair_ids_;
+};
+
+}  // namespace
+
+std::unique_ptr<Thread> CreateStreamingSequentialFeatureMatcher(
+    const SequentialMatchingOptions& options,
+    const StreamingMatchingOptions& streaming_options,
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    const std::string& database_path,
+    std::function<bool()> is_input_finished) {
+  return std::make_unique<StreamingSequentialFeatureMatcher>(
+      options,
+      streaming_options,
+      matching_options,
+      geometry_options,
+      database_path,
+      std::move(is_input_finished));
+}
+
+namespace {
+
 class TransitiveFeatureMatcher : public Thread {
  public:
   TransitiveFeatureMatcher(const TransitiveMatchingOptions& options,
@@ -165,6 +424,9 @@ class TransitiveFeatureMatcher : public Thread {
     THROW_CHECK(options.Check());
     THROW_CHECK(matching_options.Check());
     THROW_CHECK(geometry_options.Check());
+    database_->SetProfile(Database::Profile::BULK);
+    cache_->SetFeatureStore(
+        FeatureStore::OpenForDatabase(database_path, *database_));
   }
 
  private:
@@ -179,13 +441,27 @@ class TransitiveFeatureMatcher : public Thread {
 
     cache_->Setup();
 
-    const std::vector<image_t> image_ids = cache_->GetImageIds();
+    // The graph of the image pairs with inlier matches is read once and then
+    // extended by the newly verified image pairs of every iteration.
+    std::vector<std::pair<image_t, image_t>> existing_image_pairs;
+    std::vector<int> existing_num_inliers;
+    database_->ReadTwoViewGeometryNumInliers(&existing_image_pairs,
+                                             &existing_num_inliers);
+    THROW_CHECK_EQ(existing_image_pairs.size(), existing_num_inliers.size());
+
+    std::unordered_map<image_t, std::vector<image_t>> adjacency;
+    for (const auto& image_pair : existing_image_pairs) {
+      adjacency[image_pair.first].push_back(image_pair.second);
+      adjacency[image_pair.second].push_back(image_pair.first);
+    }
+    existing_image_pairs = {};
+    existing_num_inliers = {};
 
-    std::vector<std::pair<image_t, image_t>> image_pairs;
-    std::unordered_set<image_pair_t> image_pair_ids;
+    ThreadPool thread_pool(matching_options_.num_threads);
 
     for (int iteration = 0; iteration < options_.num_iterations; ++iteration) {
       if (IsStopped()) {
+        matcher_.Commit();
         run_timer.PrintMinutes();
         return;
       }
@@ -196,62 +472,128 @@ class TransitiveFeatureMatcher : public Thread {
       LOG(INFO) << StringPrintf(
           "Iteration [%d/%d]", iteration + 1, options_.num_iterations);
 
-      std::vector<std::pair<image_t, image_t>> existing_image_pairs;
-      std::vector<int> existing_num_inliers;
-      database_->ReadTwoViewGeometryNumInliers(&existing_image_pairs,
-                                               &existing_num_inliers);
+      const std::vector<std::pair<image_t, image_t>> image_pairs =
+          FindTransitiveImagePairs(adjacency, &thread_pool);
+      if (image_pairs.empty()) {
+        LOG(INFO) << "  No new transitive image pairs";
+        break;
+      }
 
-      THROW_CHECK_EQ(existing_image_pairs.size(), existing_num_inliers.size());
+      const size_t batch_size = static_cast<size_t>(options_.batch_size);
+      const size_t num_batches =
+          (image_pairs.size() + batch_size - 1) / batch_size;
+      std::vector<std::pair<image_t, image_t>> batch_image_pairs;
+      for (size_t batch_idx = 0; batch_idx < num_batches; ++batch_idx) {
+        LOG(INFO) << StringPrintf("  Batch [%d/%d]",
+                                  static_cast<int>(batch_idx + 1),
+                                  static_cast<int>(num_batches));
+        const size_t begin = batch_idx * batch_size;
+        const size_t end = std::min(begin + batch_size, image_pairs.size());
+        batch_image_pairs.assign(image_pairs.begin() + begin,
+                                 image_pairs.begin() + end);
+        matcher_.Match(batch_image_pairs);
+        PrintElapsedTime(timer);
+        timer.Restart();
+
+        // Only the image pairs with inlier matches are added to the graph,
+        // such that failed pairs are not extended in the next iteration.
+        for (const auto& [image_id1, image_id2] : batch_image_pairs) {
+          if (database_->NumInlierMatchesForImagePair(image_id1, image_id2) >
+              0) {
+            adjacency[image_id1].push_back(image_id2);
+            adjacency[image_id2].push_back(image_id1);
+          }
+        }
 
-      std::unordered_map<image_t, std::vector<image_t>> adjacency;
-      for (const auto& image_pair : existing_image_pairs) {
-        adjacency[image_pair.first].push_back(image_pair.second);
-        adjacency[image_pair.second].push_back(image_pair.first);
+        if (IsStopped()) {
+          matcher_.Commit();
+          run_timer.PrintMinutes();
+          return;
+        }
       }
+    }
 
-      const size_t batch_size = static_cast<size_t>(options_.batch_size);
+    matcher_.Commit();
+    run_timer.PrintMinutes();
+  }
 
-      size_t num_batches = 0;
-      image_pairs.clear();
-      image_pair_ids.clear();
-      for (const auto& image : adjacency) {
-        const auto image_id1 = image.first;
-        for (const auto& image_id2 : image.second) {
-          if (adjacency.count(image_id2) > 0) {
-            for (const auto& image_id3 : adjacency.at(image_id2)) {
-              const auto image_pair_id =
-                  Database::ImagePairToPairId(image_id1, image_id3);
-              if (image_pair_ids.count(image_pair_id) == 0) {
-                image_pairs.emplace_back(image_id1, image_id3);
-                image_pair_ids.insert(image_pair_id);
-                if (image_pairs.size() >= batch_size) {
-                  num_batches += 1;
-                  LOG(INFO) << StringPrintf("  Batch %d", num_batches);
-                  DatabaseTransaction database_transaction(database_.get());
-                  matcher_.Match(image_pairs);
-                  image_pairs.clear();
-                  PrintElapsedTime(timer);
-                  timer.Restart();
-
-                  if (IsStopped()) {
-                    run_timer.PrintMinutes();
-                    return;
-                  }
-                }
+  // Find the image pairs that are connected through a common neighbor in the
+  // graph, but not directly, and that were not matched before. The images are
+  // partitioned over the threads, and the image pairs are returned sorted,
+  // such that the result does not depend on the number of threads.
+  std::vector<std::pair<image_t, image_t>> FindTransitiveImagePairs(
+      std::unordered_map<image_t, std::vector<image_t>>& adjacency,
+      ThreadPool* thread_pool) {
+    std::vector<image_t> image_ids;
+    image_ids.reserve(adjacency.size());
+    for (auto& [image_id, neighbor_image_ids] : adjacency) {
+      image_ids.push_back(image_id);
+      std::sort(neighbor_image_ids.begin(), neighbor_image_ids.end());
+      neighbor_image_ids.erase(
+          std::unique(neighbor_image_ids.begin(), neighbor_image_ids.end()),
+          neighbor_image_ids.end());
+    }
+    std::sort(image_ids.begin(), image_ids.end());
+
+    const size_t num_chunks =
+        std::min(image_ids.size(), 4 * thread_pool->NumThreads());
+    std::vector<std::vector<std::pair<image_t, image_t>>> chunk_image_pairs(
+        num_chunks);
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_chunks);
+    for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+      futures.push_back(thread_pool->AddTask([&, chunk_idx]() {
+        const auto& neighbors = adjacency;
+        std::vector<image_t> image_ids3;
+        for (size_t i = chunk_idx; i < image_ids.size(); i += num_chunks) {
+          const image_t image_id1 = image_ids[i];
+          const std::vector<image_t>& image_ids2 = neighbors.at(image_id1);
+          // Every pair is only generated from its smaller image identifier.
+          image_ids3.clear();
+          for (const image_t image_id2 : image_ids2) {
+            for (const image_t image_id3 : neighbors.at(image_id2)) {
+              if (image_id3 > image_id1 &&
+                  !std::binary_search(
+                      image_ids2.begin(), image_ids2.end(), image_id3)) {
+                image_ids3.push_back(image_id3);
               }
             }
           }
+          std::sort(image_ids3.begin(), image_ids3.end());
+          image_ids3.erase(std::unique(image_ids3.begin(), image_ids3.end()),
+                           image_ids3.end());
+          for (const image_t image_id3 : image_ids3) {
+            chunk_image_pairs[chunk_idx].emplace_back(image_id1, image_id3);
+          }
         }
-      }
-
-      num_batches += 1;
-      LOG(INFO) << StringPrintf("  Batch %d", num_batches);
-      DatabaseTransaction database_transaction(database_.get());
-      matcher_.Match(image_pairs);
-      PrintElapsedTime(timer);
+      }));
+    }
+    for (auto& future : futures) {
+      future.get();
     }
 
-    run_timer.PrintMinutes();
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    for (const auto& image_pairs_in_chunk : chunk_image_pairs) {
+      image_pairs.insert(image_pairs.end(),
+                         image_pairs_in_chunk.begin(),
+                         image_pairs_in_chunk.end());
+    }
+    std::sort(image_pairs.begin(), image_pairs.end());
+
+    // Previously matched pairs without inlier matches are skipped here and not
+    // only by the matcher, such that the iterations stop once the graph is
+    // closed under transitivity.
+    image_pairs.erase(
+        std::remove_if(image_pairs.begin(),
+                       image_pairs.end(),
+                       [this](const std::pair<image_t, image_t>& image_pair) {
+                         return cache_->ExistsMatches(image_pair.first,
+                                                      image_pair.second) &&
+                                cache_->ExistsInlierMatches(image_pair.first,
+                                                            image_pair.second);
+                       }),
+        image_pairs.end());
+    return image_pairs;
   }
 
   const TransitiveMatchingOptions options_;
@@ -298,6 +640,7 @@ class FeaturePairsFeatureMatcher : public Thread {
     THROW_CHECK(options.Check());
     THROW_CHECK(matching_options.Check());
     THROW_CHECK(geometry_options.Check());
+    database_->SetProfile(Database::Profile::BULK);
   }
 
  private:
@@ -317,113 +660,201 @@ class FeaturePairsFeatureMatcher : public Thread {
 
     std::ifstream file(options_.match_list_path);
     THROW_CHECK_FILE_OPEN(file, options_.match_list_path);
-
-    std::string line;
-    while (std::getline(file, line)) {
+    const std::string match_list_dir = GetParentDir(options_.match_list_path);
+
+    // The pairs are read in batches, whose matches are read from .npy files
+    // and verified in parallel and then written in a single transaction.
+    ThreadPool thread_pool;
+    std::unordered_set<image_pair_t> imported_pair_ids;
+    std::vector<ImportedPair> pairs;
+    bool end_of_file = false;
+    while (!end_of_file) {
       if (IsStopped()) {
         run_timer.PrintMinutes();
         return;
       }
 
-      StringTrim(&line);
-      if (line.empty()) {
-        continue;
+      pairs.clear();
+      while (pairs.size() < kNumPairsPerBatch) {
+        ImportedPair pair;
+        bool skip_pair = false;
+        if (!ReadPair(&file,
+                      image_name_to_image,
+                      match_list_dir,
+                      &imported_pair_ids,
+                      &pair,
+                      &skip_pair)) {
+          end_of_file = true;
+          break;
+        }
+        if (!skip_pair) {
+          pairs.push_back(std::move(pair));
+        }
       }
 
-      std::istringstream line_stream(line);
-
-      std::string image_name1, image_name2;
-      try {
-        line_stream >> image_name1 >> image_name2;
-      } catch (...) {
-        LOG(ERROR) << "Could not read image pair.";
-        break;
+      std::vector<std::future<void>> futures;
+      futures.reserve(pairs.size());
+      for (ImportedPair& pair : pairs) {
+        futures.push_back(thread_pool.AddTask(
+            &FeaturePairsFeatureMatcher::ProcessPair, this, &pair));
       }
-
-      LOG(INFO) << StringPrintf(
-          "%s - %s", image_name1.c_str(), image_name2.c_str());
-
-      if (image_name_to_image.count(image_name1) == 0) {
-        LOG(INFO) << StringPrintf("SKIP: Image %s not found in database.",
-                                  image_name1.c_str());
-        break;
+      for (auto& future : futures) {
+        future.get();
       }
-      if (image_name_to_image.count(image_name2) == 0) {
-        LOG(INFO) << StringPrintf("SKIP: Image %s not found in database.",
-                                  image_name2.c_str());
-        break;
+
+      DatabaseTransaction database_transaction(database_.get());
+      for (const ImportedPair& pair : pairs) {
+        if (options_.verify_matches) {
+          database_->WriteMatches(pair.image_id1, pair.image_id2, pair.matches);
+        }
+        database_->WriteTwoViewGeometry(
+            pair.image_id1, pair.image_id2, pair.two_view_geometry);
       }
+    }
 
-      const Image& image1 = *image_name_to_image[image_name1];
-      const Image& image2 = *image_name_to_image[image_name2];
+    run_timer.PrintMinutes();
+  }
 
-      bool skip_pair = false;
-      if (database_->ExistsInlierMatches(image1.ImageId(), image2.ImageId())) {
-        LOG(INFO) << "SKIP: Matches for image pair already exist in database.";
-        skip_pair = true;
+  struct ImportedPair {
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    // Optional .npy file from which the matches are read.
+    std::string matches_path;
+    FeatureMatches matches;
+    TwoViewGeometry two_view_geometry;
+  };
+
+  static constexpr size_t kNumPairsPerBatch = 1000;
+
+  // Read the next image pair and its matches from the match list. Returns
+  // false at the end of the file or if the pair cannot be read.
+  bool ReadPair(
+      std::ifstream* file,
+      const std::unordered_map<std::string, const Image*>& image_name_to_image,
+      const std::string& match_list_dir,
+      std::unordered_set<image_pair_t>* imported_pair_ids,
+      ImportedPair* pair,
+      bool* skip_pair) const {
+    std::string line;
+    do {
+      if (!std::getline(*file, line)) {
+        return false;
       }
+      StringTrim(&line);
+    } while (line.empty());
 
-      FeatureMatches matches;
-      while (std::getline(file, line)) {
-        StringTrim(&line);
-
-        if (line.empty()) {
-          break;
-        }
+    std::istringstream line_stream(line);
 
-        std::istringstream line_stream(line);
+    std::string image_name1, image_name2, matches_path;
+    try {
+      line_stream >> image_name1 >> image_name2 >> matches_path;
+    } catch (...) {
+      LOG(ERROR) << "Could not read image pair.";
+      return false;
+    }
 
-        FeatureMatch match;
-        try {
-          line_stream >> match.point2D_idx1 >> match.point2D_idx2;
-        } catch (...) {
-          LOG(ERROR) << "Cannot read feature matches.";
-          break;
-        }
+    VLOG(1) << StringPrintf(
+        "%s - %s", image_name1.c_str(), image_name2.c_str());
 
-        matches.push_back(match);
-      }
+    const auto image_it1 = image_name_to_image.find(image_name1);
+    if (image_it1 == image_name_to_image.end()) {
+      LOG(INFO) << StringPrintf("SKIP: Image %s not found in database.",
+                                image_name1.c_str());
+      return false;
+    }
+    const auto image_it2 = image_name_to_image.find(image_name2);
+    if (image_it2 == image_name_to_image.end()) {
+      LOG(INFO) << StringPrintf("SKIP: Image %s not found in database.",
+                                image_name2.c_str());
+      return false;
+    }
 
-      if (skip_pair) {
-        continue;
-      }
+    pair->image_id1 = image_it1->second->ImageId();
+    pair->image_id2 = image_it2->second->ImageId();
 
-      const Camera& camera1 = cache_->GetCamera(image1.CameraId());
-      const Camera& camera2 = cache_->GetCamera(image2.CameraId());
+    if (database_->ExistsInlierMatches(pair->image_id1, pair->image_id2) ||
+        !imported_pair_ids
+             ->insert(Database::ImagePairToPairId(pair->image_id1,
+                                                  pair->image_id2))
+             .second) {
+      LOG(INFO) << "SKIP: Matches for image pair already exist in database.";
+      *skip_pair = true;
+    }
 
-      if (options_.verify_matches) {
-        database_->WriteMatches(image1.ImageId(), image2.ImageId(), matches);
+    // The matches are either stored as an array of shape NUM_MATCHES x 2 in
+    // a .npy file, whose path is relative to the match list, or they are
+    // listed in the lines after the image pair until an empty line.
+    if (!matches_path.empty()) {
+      pair->matches_path = JoinPaths(match_list_dir, matches_path);
+      return true;
+    }
 
-        const auto keypoints1 = cache_->GetKeypoints(image1.ImageId());
-        const auto keypoints2 = cache_->GetKeypoints(image2.ImageId());
+    while (std::getline(*file, line)) {
+      StringTrim(&line);
 
-        TwoViewGeometry two_view_geometry =
-            EstimateTwoViewGeometry(camera1,
-                                    FeatureKeypointsToPointsVector(*keypoints1),
-                                    camera2,
-                                    FeatureKeypointsToPointsVector(*keypoints2),
-                                    matches,
-                                    geometry_options_);
+      if (line.empty()) {
+        break;
+      }
 
-        database_->WriteTwoViewGeometry(
-            image1.ImageId(), image2.ImageId(), two_view_geometry);
-      } else {
-        TwoViewGeometry two_view_geometry;
+      const char* begin = line.c_str();
+      char* end = nullptr;
+      FeatureMatch match;
+      match.point2D_idx1 = std::strtoul(begin, &end, 10);
+      if (end != begin) {
+        begin = end;
+        match.point2D_idx2 = std::strtoul(begin, &end, 10);
+      }
+      if (end == begin) {
+        LOG(ERROR) << "Cannot read feature matches.";
+        break;
+      }
 
-        if (camera1.has_prior_focal_length && camera2.has_prior_focal_length) {
-          two_view_geometry.config = TwoViewGeometry::CALIBRATED;
-        } else {
-          two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
-        }
+      pair->matches.push_back(match);
+    }
 
-        two_view_geometry.inlier_matches = matches;
+    return true;
+  }
 
-        database_->WriteTwoViewGeometry(
-            image1.ImageId(), image2.ImageId(), two_view_geometry);
+  // Read the matches of the pair, if they are stored in a separate file, and
+  // compute its two-view geometry.
+  void ProcessPair(ImportedPair* pair) {
+    if (!pair->matches_path.empty()) {
+      const NpyArray<uint32_t> matches_array =
+          ReadNpyArray<uint32_t>(pair->matches_path);
+      THROW_CHECK_EQ(matches_array.shape.size(), 2);
+      THROW_CHECK_EQ(matches_array.shape[1], 2);
+      pair->matches.resize(matches_array.shape[0]);
+      for (size_t i = 0; i < pair->matches.size(); ++i) {
+        pair->matches[i].point2D_idx1 = matches_array.data[2 * i];
+        pair->matches[i].point2D_idx2 = matches_array.data[2 * i + 1];
       }
     }
 
-    run_timer.PrintMinutes();
+    const Image& image1 = cache_->GetImage(pair->image_id1);
+    const Image& image2 = cache_->GetImage(pair->image_id2);
+    const Camera& camera1 = cache_->GetCamera(image1.CameraId());
+    const Camera& camera2 = cache_->GetCamera(image2.CameraId());
+
+    if (options_.verify_matches) {
+      const auto keypoints1 = cache_->GetKeypoints(pair->image_id1);
+      const auto keypoints2 = cache_->GetKeypoints(pair->image_id2);
+
+      pair->two_view_geometry =
+          EstimateTwoViewGeometry(camera1,
+                                  FeatureKeypointsToPointsVector(*keypoints1),
+                                  camera2,
+                                  FeatureKeypointsToPointsVector(*keypoints2),
+                                  pair->matches,
+                                  geometry_options_);
+    } else {
+      if (camera1.has_prior_focal_length && camera2.has_prior_focal_length) {
+        pair->two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+      } else {
+        pair->two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
+      }
+
+      pair->two_view_geometry.inlier_matches = pair->matches;
+    }
   }
 
   const FeaturePairsMatchingOptions options_;
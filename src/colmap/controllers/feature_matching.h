@@ -34,6 +34,7 @@
 #include "colmap/feature/sift.h"
 #include "colmap/util/threading.h"
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -75,6 +76,14 @@ std::unique_ptr<Thread> CreateVocabTreeFeatureMatcher(
     const TwoViewGeometryOptions& geometry_options,
     const std::string& database_path);
 
+// Match each image against its nearest neighbors using global VLAD
+// descriptors, which are stored in the database and reused in later runs.
+std::unique_ptr<Thread> CreateVLADFeatureMatcher(
+    const VLADMatchingOptions& options,
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    const std::string& database_path);
+
 // Sequentially match images within neighborhood:
 //
 // +-------------------------------+-----------------------> images[i]
@@ -101,6 +110,32 @@ std::unique_ptr<Thread> CreateSequentialFeatureMatcher(
     const TwoViewGeometryOptions& geometry_options,
     const std::string& database_path);
 
+struct StreamingMatchingOptions {
+  // The interval in seconds at which the database is polled for new images.
+  double poll_interval = 1.0;
+
+  // The maximum time in seconds to wait for new images, after which the
+  // matching is finished. If not positive, the matcher waits for new images
+  // until the input is finished or the matcher is stopped.
+  double max_idle_time = 60.0;
+};
+
+// Sequentially match images as they are written to the database, e.g., by a
+// concurrent feature extractor. Every new image is matched against its
+// neighbors in the name order of the images written so far, with the same
+// (quadratic) overlap as the sequential matcher, such that the matches are
+// available to a concurrent mapper without waiting for the extraction to
+// finish. Loop detection is not supported, since the vocabulary tree cannot
+// be indexed before all images are known. The matcher finishes once
+// `is_input_finished` returns true and all images are matched.
+std::unique_ptr<Thread> CreateStreamingSequentialFeatureMatcher(
+    const SequentialMatchingOptions& options,
+    const StreamingMatchingOptions& streaming_options,
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    const std::string& database_path,
+    std::function<bool()> is_input_finished = nullptr);
+
 // Match images against spatial nearest neighbors using prior location
 // information, e.g. provided manually or extracted from EXIF.
 std::unique_ptr<Thread> CreateSpatialFeatureMatcher(
@@ -30,12 +30,20 @@
 #include "colmap/controllers/feature_matching_utils.h"
 
 #include "colmap/estimators/two_view_geometry.h"
+#include "colmap/feature/binary.h"
 #include "colmap/feature/utils.h"
+#include "colmap/retrieval/vote_and_verify.h"
 #include "colmap/util/cuda.h"
+#include "colmap/util/memory.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
 
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <numeric>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace colmap {
@@ -44,12 +52,13 @@ FeatureMatcherWorker::FeatureMatcherWorker(
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
     FeatureMatcherCache* cache,
-    JobQueue<Input>* input_queue,
-    JobQueue<Output>* output_queue)
+    LockFreeJobQueue<Input>* input_queue,
+    LockFreeJobQueue<Output>* output_queue)
     : matching_options_(matching_options),
       geometry_options_(geometry_options),
       cache_(cache),
       input_queue_(input_queue),
+      batch_input_queue_(nullptr),
       output_queue_(output_queue) {
   THROW_CHECK(matching_options_.Check());
 
@@ -57,6 +66,8 @@ FeatureMatcherWorker::FeatureMatcherWorker(
   prev_keypoints_image_ids_[1] = kInvalidImageId;
   prev_descriptors_image_ids_[0] = kInvalidImageId;
   prev_descriptors_image_ids_[1] = kInvalidImageId;
+  coarse_image_ids_[0] = kInvalidImageId;
+  coarse_image_ids_[1] = kInvalidImageId;
 
   if (matching_options_.use_gpu) {
 #if !defined(COLMAP_CUDA_ENABLED)
@@ -65,6 +76,21 @@ FeatureMatcherWorker::FeatureMatcherWorker(
   }
 }
 
+FeatureMatcherWorker::FeatureMatcherWorker(
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    FeatureMatcherCache* cache,
+    LockFreeJobQueue<BatchInput>* batch_input_queue,
+    LockFreeJobQueue<Output>* output_queue)
+    : FeatureMatcherWorker(matching_options,
+                           geometry_options,
+                           cache,
+                           static_cast<LockFreeJobQueue<Input>*>(nullptr),
+                           output_queue) {
+  input_queue_ = nullptr;
+  batch_input_queue_ = THROW_CHECK_NOTNULL(batch_input_queue);
+}
+
 void FeatureMatcherWorker::SetMaxNumMatches(int max_num_matches) {
   matching_options_.max_num_matches = max_num_matches;
 }
@@ -85,6 +111,27 @@ void FeatureMatcherWorker::Run() {
     return;
   }
 
+  BinaryMatchingOptions binary_options;
+  binary_options.max_ratio = std::min(1.0, matching_options_.max_ratio);
+  binary_options.cross_check = matching_options_.cross_check;
+  binary_matcher_ = CreateBinaryFeatureMatcher(binary_options);
+
+  // Guided matching only refines the pairs that already passed the first
+  // stage of matching and verification.
+  if (matching_options_.coarse_num_features > 0 &&
+      !matching_options_.guided_matching) {
+    SiftMatchingOptions coarse_options = matching_options_;
+    coarse_options.max_num_matches =
+        std::min(matching_options_.max_num_matches,
+                 matching_options_.coarse_num_features);
+    coarse_matcher_ = CreateSiftFeatureMatcher(coarse_options);
+    if (coarse_matcher_ == nullptr) {
+      LOG(ERROR) << "Failed to create coarse feature matcher.";
+      SignalInvalidSetup();
+      return;
+    }
+  }
+
   SignalValidSetup();
 
   while (true) {
@@ -92,32 +139,137 @@ void FeatureMatcherWorker::Run() {
       break;
     }
 
-    auto input_job = input_queue_->Pop();
-    if (input_job.IsValid()) {
-      auto& data = input_job.Data();
-
-      if (!cache_->ExistsDescriptors(data.image_id1) ||
-          !cache_->ExistsDescriptors(data.image_id2)) {
-        THROW_CHECK(output_queue_->Push(std::move(data)));
-        continue;
+    if (batch_input_queue_ != nullptr) {
+      // The first image is the same for all pairs in the batch, so its
+      // keypoints and descriptors are only passed to the matcher once.
+      auto input_job = batch_input_queue_->Pop();
+      if (input_job.IsValid()) {
+        MatchImagePairBatch(matcher.get(), &input_job.Data());
       }
-
-      if (matching_options_.guided_matching) {
-        matcher->MatchGuided(geometry_options_.ransac_options.max_error,
-                             GetKeypointsPtr(0, data.image_id1),
-                             GetKeypointsPtr(1, data.image_id2),
-                             GetDescriptorsPtr(0, data.image_id1),
-                             GetDescriptorsPtr(1, data.image_id2),
-                             &data.two_view_geometry);
-      } else {
-        matcher->Match(GetDescriptorsPtr(0, data.image_id1),
-                       GetDescriptorsPtr(1, data.image_id2),
-                       &data.matches);
+    } else {
+      auto input_job = input_queue_->Pop();
+      if (input_job.IsValid()) {
+        MatchImagePair(matcher.get(), &input_job.Data());
       }
+    }
+  }
+}
+
+void FeatureMatcherWorker::MatchImagePair(FeatureMatcher* matcher,
+                                          FeatureMatcherData* data) {
+  COLMAP_PROFILE_SCOPE("FeatureMatcherWorker::MatchImagePair");
+  if (!cache_->ExistsDescriptors(data->image_id1) ||
+      !cache_->ExistsDescriptors(data->image_id2)) {
+    THROW_CHECK(output_queue_->Push(std::move(*data)));
+    return;
+  }
 
+  // Each image has descriptors of a single type, so consecutive pairs with
+  // the same image are always passed to the same matcher, which caches the
+  // descriptors of the previous pair.
+  const FeatureDescriptorType descriptor_type =
+      cache_->GetDescriptorType(data->image_id1);
+  if (descriptor_type != cache_->GetDescriptorType(data->image_id2)) {
+    LOG(WARNING) << "Cannot match images " << data->image_id1 << " and "
+                 << data->image_id2 << " with different descriptor types";
+    THROW_CHECK(output_queue_->Push(std::move(*data)));
+    return;
+  }
+  if (descriptor_type == FeatureDescriptorType::BINARY) {
+    matcher = binary_matcher_.get();
+  } else if (!matching_options_.guided_matching &&
+             MatchImagePairPredicted(matcher, data)) {
+    THROW_CHECK(output_queue_->Push(std::move(*data)));
+    return;
+  } else if (coarse_matcher_ != nullptr &&
+             !PassesCoarseMatching(data->image_id1, data->image_id2)) {
+    THROW_CHECK(output_queue_->Push(std::move(*data)));
+    return;
+  }
+
+  if (matching_options_.guided_matching) {
+    matcher->MatchGuided(geometry_options_.ransac_options.max_error,
+                         GetKeypointsPtr(0, data->image_id1),
+                         GetKeypointsPtr(1, data->image_id2),
+                         GetDescriptorsPtr(0, data->image_id1),
+                         GetDescriptorsPtr(1, data->image_id2),
+                         &data->two_view_geometry);
+  } else {
+    const std::shared_ptr<FeatureDescriptors> descriptors1 =
+        GetDescriptorsPtr(0, data->image_id1);
+    const std::shared_ptr<FeatureDescriptors> descriptors2 =
+        GetDescriptorsPtr(1, data->image_id2);
+    // Search indices are built once per image and shared across all workers.
+    matcher->SetDescriptorIndices(
+        descriptors1 == nullptr
+            ? nullptr
+            : GetDescriptorIndex(matcher, data->image_id1),
+        descriptors2 == nullptr
+            ? nullptr
+            : GetDescriptorIndex(matcher, data->image_id2));
+    matcher->Match(descriptors1, descriptors2, &data->matches);
+  }
+
+  THROW_CHECK(output_queue_->Push(std::move(*data)));
+}
+
+void FeatureMatcherWorker::MatchImagePairBatch(FeatureMatcher* matcher,
+                                               FeatureMatcherBatch* batch) {
+  COLMAP_PROFILE_SCOPE("FeatureMatcherWorker::MatchImagePairBatch");
+  // Guided matching needs the two-view geometry of each pair and the CPU
+  // matchers benefit more from the shared descriptor indices, so only the GPU
+  // matcher matches the batch of (PCA-reduced) SIFT descriptors in one go.
+  const FeatureDescriptorType descriptor_type =
+      batch->empty() ? FeatureDescriptorType::SIFT
+                     : cache_->GetDescriptorType(batch->front().image_id1);
+  if (matching_options_.guided_matching || !matching_options_.use_gpu ||
+      descriptor_type == FeatureDescriptorType::BINARY) {
+    for (auto& data : *batch) {
+      MatchImagePair(matcher, &data);
+    }
+    return;
+  }
+
+  std::vector<FeatureMatcherData*> batch_data;
+  batch_data.reserve(batch->size());
+  for (auto& data : *batch) {
+    // Pairs with a predicted geometry are matched guided by the prediction.
+    if (data.predicted_two_view_geometry.config !=
+        TwoViewGeometry::UNDEFINED) {
+      MatchImagePair(matcher, &data);
+      continue;
+    }
+    if (cache_->ExistsDescriptors(data.image_id1) &&
+        cache_->ExistsDescriptors(data.image_id2) &&
+        cache_->GetDescriptorType(data.image_id2) == descriptor_type &&
+        (coarse_matcher_ == nullptr ||
+         PassesCoarseMatching(data.image_id1, data.image_id2))) {
+      batch_data.push_back(&data);
+    } else {
       THROW_CHECK(output_queue_->Push(std::move(data)));
     }
   }
+
+  if (batch_data.empty()) {
+    return;
+  }
+
+  const std::shared_ptr<FeatureDescriptors> descriptors1 =
+      GetDescriptorsPtr(0, batch_data[0]->image_id1);
+  std::vector<std::shared_ptr<const FeatureDescriptors>> descriptors2;
+  descriptors2.reserve(batch_data.size());
+  for (const auto& data : batch_data) {
+    THROW_CHECK_EQ(data->image_id1, batch_data[0]->image_id1);
+    descriptors2.push_back(GetDescriptorsPtr(1, data->image_id2));
+  }
+
+  // Results are passed on to the verifiers as soon as they are available.
+  matcher->MatchBatch(
+      descriptors1, descriptors2, [&](size_t i, FeatureMatches* matches) {
+        FeatureMatcherData* data = batch_data[i];
+        data->matches = std::move(*matches);
+        THROW_CHECK(output_queue_->Push(std::move(*data)));
+      });
 }
 
 std::shared_ptr<FeatureKeypoints> FeatureMatcherWorker::GetKeypointsPtr(
@@ -146,6 +298,250 @@ std::shared_ptr<FeatureDescriptors> FeatureMatcherWorker::GetDescriptorsPtr(
   }
 }
 
+std::shared_ptr<const FeatureDescriptorIndex>
+FeatureMatcherWorker::GetDescriptorIndex(FeatureMatcher* matcher,
+                                         const image_t image_id) {
+  return cache_->GetDescriptorIndex(
+      image_id,
+      [matcher](const std::shared_ptr<const FeatureDescriptors>& descriptors) {
+        return matcher->CreateDescriptorIndex(descriptors);
+      });
+}
+
+bool FeatureMatcherWorker::MatchImagePairPredicted(FeatureMatcher* matcher,
+                                                   FeatureMatcherData* data) {
+  TwoViewGeometry& prediction = data->predicted_two_view_geometry;
+  if (prediction.config != TwoViewGeometry::CALIBRATED &&
+      prediction.config != TwoViewGeometry::UNCALIBRATED &&
+      prediction.config != TwoViewGeometry::PLANAR &&
+      prediction.config != TwoViewGeometry::PANORAMIC &&
+      prediction.config != TwoViewGeometry::PLANAR_OR_PANORAMIC) {
+    return false;
+  }
+
+  COLMAP_PROFILE_SCOPE("FeatureMatcherWorker::MatchImagePairPredicted");
+
+  // Guided matching needs the keypoints along with the descriptors, so both
+  // are passed again, even if they are the same as for the previous pair.
+  prev_keypoints_image_ids_.fill(kInvalidImageId);
+  prev_descriptors_image_ids_.fill(kInvalidImageId);
+  matcher->MatchGuided(matching_options_.prediction_max_error,
+                       GetKeypointsPtr(0, data->image_id1),
+                       GetKeypointsPtr(1, data->image_id2),
+                       GetDescriptorsPtr(0, data->image_id1),
+                       GetDescriptorsPtr(1, data->image_id2),
+                       &prediction);
+  // Guided matching discards the descriptor indices of the matcher, so the
+  // descriptors are passed again to the next unguided matching.
+  prev_descriptors_image_ids_.fill(kInvalidImageId);
+
+  if (prediction.inlier_matches.size() <
+      static_cast<size_t>(geometry_options_.min_num_inliers)) {
+    // The prediction failed, e.g., due to a sudden change of the motion.
+    prediction = TwoViewGeometry();
+    return false;
+  }
+
+  static MetricCounter* num_predicted_pairs =
+      MetricsRegistry::Instance().Counter(
+          "colmap_matcher_predicted_pairs_total",
+          "Number of image pairs matched guided by a predicted geometry");
+  num_predicted_pairs->Increment();
+
+  data->matches = std::move(prediction.inlier_matches);
+  prediction = TwoViewGeometry();
+  return true;
+}
+
+bool FeatureMatcherWorker::PassesCoarseMatching(const image_t image_id1,
+                                                const image_t image_id2) {
+  COLMAP_PROFILE_SCOPE("FeatureMatcherWorker::PassesCoarseMatching");
+  const size_t num_coarse_features =
+      static_cast<size_t>(matching_options_.coarse_num_features);
+  if (cache_->GetNumKeypoints(image_id1) <= num_coarse_features &&
+      cache_->GetNumKeypoints(image_id2) <= num_coarse_features) {
+    return true;
+  }
+
+  coarse_matcher_->Match(GetCoarseDescriptorsPtr(0, image_id1),
+                         GetCoarseDescriptorsPtr(1, image_id2),
+                         &coarse_matches_);
+
+  bool passes = coarse_matches_.size() >=
+                static_cast<size_t>(matching_options_.coarse_min_num_inliers);
+  if (passes) {
+    const Camera& camera1 =
+        cache_->GetCamera(cache_->GetImage(image_id1).CameraId());
+    const Camera& camera2 =
+        cache_->GetCamera(cache_->GetImage(image_id2).CameraId());
+    const TwoViewGeometry two_view_geometry =
+        EstimateTwoViewGeometry(camera1,
+                                coarse_points_[0],
+                                camera2,
+                                coarse_points_[1],
+                                coarse_matches_,
+                                geometry_options_);
+    passes = two_view_geometry.inlier_matches.size() >=
+             static_cast<size_t>(matching_options_.coarse_min_num_inliers);
+  }
+
+  if (!passes) {
+    static MetricCounter* num_rejected_pairs =
+        MetricsRegistry::Instance().Counter(
+            "colmap_matcher_coarse_rejected_pairs_total",
+            "Number of image pairs rejected by the coarse matching stage");
+    num_rejected_pairs->Increment();
+  }
+
+  return passes;
+}
+
+std::shared_ptr<FeatureDescriptors>
+FeatureMatcherWorker::GetCoarseDescriptorsPtr(const int index,
+                                              const image_t image_id) {
+  THROW_CHECK_GE(index, 0);
+  THROW_CHECK_LE(index, 1);
+  if (coarse_image_ids_[index] == image_id) {
+    return nullptr;
+  }
+  coarse_image_ids_[index] = image_id;
+
+  const std::shared_ptr<FeatureKeypoints> keypoints =
+      cache_->GetKeypoints(image_id);
+  const std::shared_ptr<FeatureDescriptors> descriptors =
+      cache_->GetDescriptors(image_id);
+  THROW_CHECK_EQ(keypoints->size(), descriptors->rows());
+
+  // Select the features with the largest scale, which are the most repeatable
+  // across views and viewpoints.
+  std::vector<float> scales(keypoints->size());
+  for (size_t i = 0; i < keypoints->size(); ++i) {
+    scales[i] = (*keypoints)[i].ComputeScale();
+  }
+  std::vector<size_t> order(keypoints->size());
+  std::iota(order.begin(), order.end(), 0);
+  const size_t num_coarse_features = std::min(
+      order.size(), static_cast<size_t>(matching_options_.coarse_num_features));
+  std::partial_sort(order.begin(),
+                    order.begin() + num_coarse_features,
+                    order.end(),
+                    [&scales](const size_t idx1, const size_t idx2) {
+                      return scales[idx1] > scales[idx2];
+                    });
+
+  auto coarse_descriptors = std::make_shared<FeatureDescriptors>(
+      num_coarse_features, descriptors->cols());
+  std::vector<Eigen::Vector2d>& points = coarse_points_[index];
+  points.resize(num_coarse_features);
+  for (size_t i = 0; i < num_coarse_features; ++i) {
+    coarse_descriptors->row(i) = descriptors->row(order[i]);
+    const FeatureKeypoint& keypoint = (*keypoints)[order[i]];
+    points[i] = Eigen::Vector2d(keypoint.x, keypoint.y);
+  }
+
+  return coarse_descriptors;
+}
+
+FeatureMatcherWriter::FeatureMatcherWriter(
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    FeatureMatcherCache* cache,
+    LockFreeJobQueue<Input>* input_queue)
+    : matching_options_(matching_options),
+      geometry_options_(geometry_options),
+      cache_(THROW_CHECK_NOTNULL(cache)),
+      input_queue_(THROW_CHECK_NOTNULL(input_queue)),
+      in_transaction_(false),
+      num_pairs_in_transaction_(0),
+      num_processed_(0) {
+  THROW_CHECK(matching_options_.Check());
+  THROW_CHECK(geometry_options_.Check());
+}
+
+void FeatureMatcherWriter::WaitForNumProcessed(const size_t num_processed) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_processed_condition_.wait(
+      lock, [&]() { return num_processed_ >= num_processed; });
+}
+
+void FeatureMatcherWriter::Run() {
+  while (true) {
+    if (IsStopped()) {
+      break;
+    }
+
+    auto input_job = input_queue_->Pop();
+    if (input_job.IsValid()) {
+      auto& data = input_job.Data();
+      if (data.image_id1 == kInvalidImageId ||
+          data.image_id2 == kInvalidImageId) {
+        Commit();
+      } else {
+        Write(&data);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        num_processed_ += 1;
+      }
+      num_processed_condition_.notify_all();
+    }
+  }
+
+  Commit();
+}
+
+void FeatureMatcherWriter::Write(FeatureMatcherData* data) {
+  COLMAP_PROFILE_SCOPE("FeatureMatcherWriter::Write");
+  if (data->matches.size() <
+      static_cast<size_t>(geometry_options_.min_num_inliers)) {
+    data->matches = {};
+  }
+
+  if (data->two_view_geometry.inlier_matches.size() <
+      static_cast<size_t>(geometry_options_.min_num_inliers)) {
+    data->two_view_geometry = TwoViewGeometry();
+  }
+
+  if (!in_transaction_) {
+    cache_->BeginTransaction();
+    in_transaction_ = true;
+    num_pairs_in_transaction_ = 0;
+    transaction_timer_.Restart();
+  }
+
+  cache_->WriteMatches(data->image_id1, data->image_id2, data->matches);
+  cache_->WriteTwoViewGeometry(
+      data->image_id1, data->image_id2, data->two_view_geometry);
+
+  static MetricCounter* num_pairs = MetricsRegistry::Instance().Counter(
+      "colmap_matcher_pairs_total", "Number of matched image pairs");
+  static MetricCounter* num_verified_pairs =
+      MetricsRegistry::Instance().Counter(
+          "colmap_matcher_verified_pairs_total",
+          "Number of image pairs with a verified two-view geometry");
+  num_pairs->Increment();
+  if (!data->two_view_geometry.inlier_matches.empty()) {
+    num_verified_pairs->Increment();
+  }
+
+  num_pairs_in_transaction_ += 1;
+  if (num_pairs_in_transaction_ >=
+          matching_options_.max_num_pairs_per_transaction ||
+      transaction_timer_.ElapsedSeconds() >=
+          matching_options_.max_transaction_duration) {
+    Commit();
+  }
+}
+
+void FeatureMatcherWriter::Commit() {
+  COLMAP_PROFILE_SCOPE("FeatureMatcherWriter::Commit");
+  if (in_transaction_) {
+    cache_->EndTransaction();
+    in_transaction_ = false;
+  }
+}
+
 namespace {
 
 // api: 验证特征匹配线程类，对极几何计算
@@ -154,14 +550,17 @@ class VerifierWorker : public Thread {
   typedef FeatureMatcherData Input;
   typedef FeatureMatcherData Output;
 
-  VerifierWorker(const TwoViewGeometryOptions& options,
+  VerifierWorker(const SiftMatchingOptions& matching_options,
+                 const TwoViewGeometryOptions& options,
                  FeatureMatcherCache* cache,
-                 JobQueue<Input>* input_queue,
-                 JobQueue<Output>* output_queue)
-      : options_(options),
+                 LockFreeJobQueue<Input>* input_queue,
+                 LockFreeJobQueue<Output>* output_queue)
+      : matching_options_(matching_options),
+        options_(options),
         cache_(cache),
         input_queue_(input_queue),
         output_queue_(output_queue) {
+    THROW_CHECK(matching_options_.Check());
     THROW_CHECK(options_.Check());
   }
 
@@ -175,6 +574,7 @@ class VerifierWorker : public Thread {
 
       auto input_job = input_queue_->Pop();
       if (input_job.IsValid()) {
+        COLMAP_PROFILE_SCOPE("VerifierWorker::Verify");
         auto& data = input_job.Data();
 
         // step: 1 是否满足验证数量
@@ -189,12 +589,18 @@ class VerifierWorker : public Thread {
             cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
         const auto& camera2 =
             cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
-        const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
-        const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
-        const std::vector<Eigen::Vector2d> points1 =
-            FeatureKeypointsToPointsVector(*keypoints1);
-        const std::vector<Eigen::Vector2d> points2 =
-            FeatureKeypointsToPointsVector(*keypoints2);
+        const std::vector<Eigen::Vector2d>& points1 =
+            GetPoints(0, data.image_id1);
+        const std::vector<Eigen::Vector2d>& points2 =
+            GetPoints(1, data.image_id2);
+
+        // Most candidate pairs of retrieval based matching are wrong, so
+        // first reject them with the much cheaper spatial verification.
+        if (matching_options_.vote_and_verify &&
+            !PassesVoteAndVerify(camera1, camera2, data.matches)) {
+          THROW_CHECK(output_queue_->Push(std::move(data)));
+          continue;
+        }
 
         // step: 3 估计对极几何关系，验证匹配结果是否合理
         data.two_view_geometry = EstimateTwoViewGeometry(
@@ -206,10 +612,64 @@ class VerifierWorker : public Thread {
   }
 
  private:
+  // The matchers output the pairs of a batch with the same first image one
+  // after the other, so the points of the previous images are kept and their
+  // buffers are reused for the next images.
+  const std::vector<Eigen::Vector2d>& GetPoints(const int index,
+                                                const image_t image_id) {
+    if (prev_image_ids_[index] != image_id) {
+      std::shared_ptr<FeatureKeypoints>& keypoints = prev_keypoints_[index];
+      keypoints = cache_->GetKeypoints(image_id);
+      std::vector<Eigen::Vector2d>& points = prev_points_[index];
+      points.resize(keypoints->size());
+      for (size_t i = 0; i < keypoints->size(); ++i) {
+        points[i] = Eigen::Vector2d((*keypoints)[i].x, (*keypoints)[i].y);
+      }
+      prev_image_ids_[index] = image_id;
+    }
+    return prev_points_[index];
+  }
+
+  // Requires the keypoints of both images to be loaded by GetPoints.
+  bool PassesVoteAndVerify(const Camera& camera1,
+                           const Camera& camera2,
+                           const FeatureMatches& matches) {
+    const FeatureKeypoints& keypoints1 = *prev_keypoints_[0];
+    const FeatureKeypoints& keypoints2 = *prev_keypoints_[1];
+    geometry_matches_.resize(matches.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+      const FeatureKeypoint& keypoint1 = keypoints1[matches[i].point2D_idx1];
+      const FeatureKeypoint& keypoint2 = keypoints2[matches[i].point2D_idx2];
+      retrieval::FeatureGeometryMatch& geometry_match = geometry_matches_[i];
+      geometry_match.geometry1.x = keypoint1.x;
+      geometry_match.geometry1.y = keypoint1.y;
+      geometry_match.geometry1.scale = keypoint1.ComputeScale();
+      geometry_match.geometry1.orientation = keypoint1.ComputeOrientation();
+      geometry_match.geometry2.x = keypoint2.x;
+      geometry_match.geometry2.y = keypoint2.y;
+      geometry_match.geometry2.scale = keypoint2.ComputeScale();
+      geometry_match.geometry2.orientation = keypoint2.ComputeOrientation();
+    }
+
+    // The translation bins must cover the range of both images.
+    retrieval::VoteAndVerifyOptions vote_and_verify_options;
+    vote_and_verify_options.max_image_size = static_cast<int>(std::max<size_t>(
+        {camera1.width, camera1.height, camera2.width, camera2.height, 1}));
+    return retrieval::VoteAndVerify(vote_and_verify_options,
+                                    geometry_matches_) >=
+           matching_options_.vote_and_verify_min_num_inliers;
+  }
+
+  const SiftMatchingOptions matching_options_;
   const TwoViewGeometryOptions options_;
   FeatureMatcherCache* cache_;
-  JobQueue<Input>* input_queue_;
-  JobQueue<Output>* output_queue_;
+  LockFreeJobQueue<Input>* input_queue_;
+  LockFreeJobQueue<Output>* output_queue_;
+
+  std::array<image_t, 2> prev_image_ids_ = {kInvalidImageId, kInvalidImageId};
+  std::array<std::shared_ptr<FeatureKeypoints>, 2> prev_keypoints_;
+  std::array<std::vector<Eigen::Vector2d>, 2> prev_points_;
+  std::vector<retrieval::FeatureGeometryMatch> geometry_matches_;
 };
 
 }  // namespace
@@ -223,7 +683,10 @@ FeatureMatcherController::FeatureMatcherController(
       geometry_options_(geometry_options),
       database_(database),
       cache_(cache),
-      is_setup_(false) {
+      is_setup_(false),
+      num_writer_inputs_(0),
+      output_queue_(static_cast<size_t>(
+          matching_options.max_num_pairs_per_transaction)) {
   THROW_CHECK(matching_options_.Check());
   THROW_CHECK(geometry_options_.Check());
 
@@ -277,13 +740,38 @@ FeatureMatcherController::FeatureMatcherController(
   }
 
   // step: 3 分配 verifiers
+  // The verifiers are distributed over the listed GPUs, if the hypotheses are
+  // scored on the GPU.
+  std::vector<TwoViewGeometryOptions> verifier_geometry_options(
+      num_threads, geometry_options_);
+  if (geometry_options_.use_gpu) {
+    std::vector<int> verifier_gpu_indices =
+        CSVToVector<int>(geometry_options_.gpu_index);
+#if defined(COLMAP_CUDA_ENABLED)
+    if (verifier_gpu_indices.size() == 1 && verifier_gpu_indices[0] == -1) {
+      const int num_cuda_devices = GetNumCudaDevices();
+      THROW_CHECK_GT(num_cuda_devices, 0);
+      verifier_gpu_indices.resize(num_cuda_devices);
+      std::iota(verifier_gpu_indices.begin(), verifier_gpu_indices.end(), 0);
+    }
+#endif  // COLMAP_CUDA_ENABLED
+    for (int i = 0; i < num_threads; ++i) {
+      verifier_geometry_options[i].gpu_index = std::to_string(
+          verifier_gpu_indices[i % verifier_gpu_indices.size()]);
+    }
+  }
+
   verifiers_.reserve(num_threads);
   if (matching_options_.guided_matching) {
     // step: 3.1 guided匹配，将验证verified结果重新传给guided matching
     // Redirect the verification output to final round of guided matching.
     for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(std::make_unique<VerifierWorker>(
-          geometry_options_, cache, &verifier_queue_, &guided_matcher_queue_));
+      verifiers_.emplace_back(
+          std::make_unique<VerifierWorker>(matching_options_,
+                                           verifier_geometry_options[i],
+                                           cache,
+                                           &verifier_queue_,
+                                           &guided_matcher_queue_));
     }
 
     if (matching_options_.use_gpu) {
@@ -314,9 +802,33 @@ FeatureMatcherController::FeatureMatcherController(
   } else {
     // step: 3.2 直接输出verified结果
     for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(std::make_unique<VerifierWorker>(
-          geometry_options_, cache, &verifier_queue_, &output_queue_));
+      verifiers_.emplace_back(
+          std::make_unique<VerifierWorker>(matching_options_,
+                                           verifier_geometry_options[i],
+                                           cache,
+                                           &verifier_queue_,
+                                           &output_queue_));
+    }
+  }
+
+  // step: 4 分配 writer
+  writer_ = std::make_unique<FeatureMatcherWriter>(
+      matching_options_, geometry_options_, cache, &output_queue_);
+
+  // The CPU workers of every stage are spread over the NUMA nodes, such that
+  // each node runs a share of matchers and verifiers. The GPU matchers are not
+  // pinned, because the node of their device is not known here.
+  if (matching_options_.numa_affinity && GetNumNumaNodes() > 1) {
+    const auto pin_workers = [](auto& workers) {
+      for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->SetNumaNode(GetNumaNodeOfThread(i, workers.size()));
+      }
+    };
+    if (!matching_options_.use_gpu) {
+      pin_workers(matchers_);
+      pin_workers(guided_matchers_);
     }
+    pin_workers(verifiers_);
   }
 }
 
@@ -338,6 +850,8 @@ FeatureMatcherController::~FeatureMatcherController() {
     guided_matcher->Stop();
   }
 
+  writer_->Stop();
+
   matcher_queue_.Stop();
   verifier_queue_.Stop();
   guided_matcher_queue_.Stop();
@@ -354,13 +868,16 @@ FeatureMatcherController::~FeatureMatcherController() {
   for (auto& guided_matcher : guided_matchers_) {
     guided_matcher->Wait();
   }
+
+  writer_->Wait();
 }
 
-bool FeatureMatcherController::Setup() {
+bool FeatureMatcherController::Setup(int max_num_features) {
   // Minimize the amount of allocated GPU memory by computing the maximum number
   // of descriptors for any image over the whole database.
-  const int max_num_features =
-      THROW_CHECK_NOTNULL(database_)->MaxNumKeypoints();
+  if (max_num_features <= 0) {
+    max_num_features = THROW_CHECK_NOTNULL(database_)->MaxNumKeypoints();
+  }
   matching_options_.max_num_matches =
       std::min(matching_options_.max_num_matches, max_num_features);
 
@@ -378,6 +895,8 @@ bool FeatureMatcherController::Setup() {
     guided_matcher->Start();
   }
 
+  writer_->Start();
+
   for (auto& matcher : matchers_) {
     if (!matcher->CheckValidSetup()) {
       return false;
@@ -396,16 +915,28 @@ bool FeatureMatcherController::Setup() {
 }
 
 void FeatureMatcherController::Match(
-    const std::vector<std::pair<image_t, image_t>>& image_pairs) {
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::unordered_map<image_pair_t, TwoViewGeometry>&
+        predicted_two_view_geometries) {
   THROW_CHECK_NOTNULL(database_);
   THROW_CHECK_NOTNULL(cache_);
   THROW_CHECK(is_setup_);
 
-  std::cout << "FeatureMatcherController Match,,," << std::endl;
+  VLOG(1) << "FeatureMatcherController Match";
   if (image_pairs.empty()) {
     return;
   }
 
+  // Prefetch the images of the pairs in one batch, if the cache only loads
+  // images on demand. This is a no-op, if all images are already loaded.
+  std::vector<image_t> pair_image_ids;
+  pair_image_ids.reserve(2 * image_pairs.size());
+  for (const auto& image_pair : image_pairs) {
+    pair_image_ids.push_back(image_pair.first);
+    pair_image_ids.push_back(image_pair.second);
+  }
+  cache_->LoadImages(pair_image_ids);
+
   //////////////////////////////////////////////////////////////////////////////
   // Match the image pairs
   //////////////////////////////////////////////////////////////////////////////
@@ -413,6 +944,15 @@ void FeatureMatcherController::Match(
   std::unordered_set<image_pair_t> image_pair_ids;
   image_pair_ids.reserve(image_pairs.size());
 
+  // Image pairs to be matched are grouped into batches with the same first
+  // image. The batches are pushed after all image pairs were visited.
+  const size_t batch_size = static_cast<size_t>(matching_options_.batch_size);
+  std::unordered_map<image_t, FeatureMatcherBatch> open_batches;
+  std::vector<FeatureMatcherBatch> batches;
+
+  // Pairs with existing matches are only verified.
+  std::vector<FeatureMatcherData> verifier_data;
+
   size_t num_outputs = 0;
   // step: 1 逐个遍历image_pair
   for (const auto& image_pair : image_pairs) {
@@ -461,37 +1001,90 @@ void FeatureMatcherController::Match(
     if (exists_matches) {
       data.matches = cache_->GetMatches(image_pair.first, image_pair.second);
       cache_->DeleteMatches(image_pair.first, image_pair.second);
-      THROW_CHECK(verifier_queue_.Push(std::move(data)));
+      verifier_data.push_back(std::move(data));
     } else {
-      THROW_CHECK(matcher_queue_.Push(std::move(data)));
+      const auto predicted_two_view_geometry =
+          predicted_two_view_geometries.find(pair_id);
+      if (predicted_two_view_geometry != predicted_two_view_geometries.end()) {
+        data.predicted_two_view_geometry = predicted_two_view_geometry->second;
+      }
+      FeatureMatcherBatch& batch = open_batches[data.image_id1];
+      batch.push_back(std::move(data));
+      if (batch.size() >= batch_size) {
+        batches.push_back(std::move(batch));
+        open_batches.erase(image_pair.first);
+      }
     }
   }
 
+  for (auto& image_id_and_batch : open_batches) {
+    batches.push_back(std::move(image_id_and_batch.second));
+  }
+
+  // The matching time of a pair grows with the product of the numbers of
+  // features. The matchers pull their work from the shared queue, so pushing
+  // the most expensive batches first leaves only cheap batches at the end,
+  // which are evenly spread over the matchers instead of a few expensive pairs
+  // delaying the completion of the whole call.
+  std::vector<std::pair<double, size_t>> batch_costs(batches.size());
+  for (size_t i = 0; i < batches.size(); ++i) {
+    double cost = 0;
+    for (const FeatureMatcherData& data : batches[i]) {
+      cost += static_cast<double>(cache_->GetNumKeypoints(data.image_id1)) *
+              cache_->GetNumKeypoints(data.image_id2);
+    }
+    batch_costs[i] = {cost, i};
+  }
+  std::stable_sort(batch_costs.begin(),
+                   batch_costs.end(),
+                   [](const std::pair<double, size_t>& batch_cost1,
+                      const std::pair<double, size_t>& batch_cost2) {
+                     return batch_cost1.first > batch_cost2.first;
+                   });
+  std::vector<FeatureMatcherBatch> sorted_batches;
+  sorted_batches.reserve(batches.size());
+  for (const auto& batch_cost : batch_costs) {
+    sorted_batches.push_back(std::move(batches[batch_cost.second]));
+  }
+  THROW_CHECK(matcher_queue_.PushBatch(std::move(sorted_batches)));
+
+  // The verification time mostly depends on the number of matches. Pairs with
+  // many and few matches are interleaved, such that the expensive pairs are
+  // spread over the verifiers instead of ending up in the same stretch of the
+  // queue, e.g., for the pairs of neighboring images.
+  std::sort(verifier_data.begin(),
+            verifier_data.end(),
+            [](const FeatureMatcherData& data1,
+               const FeatureMatcherData& data2) {
+              return data1.matches.size() > data2.matches.size();
+            });
+  std::vector<FeatureMatcherData> interleaved_verifier_data;
+  interleaved_verifier_data.reserve(verifier_data.size());
+  for (size_t i = 0, j = verifier_data.size(); i < j; ++i) {
+    interleaved_verifier_data.push_back(std::move(verifier_data[i]));
+    if (i < --j) {
+      interleaved_verifier_data.push_back(std::move(verifier_data[j]));
+    }
+  }
+  THROW_CHECK(verifier_queue_.PushBatch(std::move(interleaved_verifier_data)));
+
   //////////////////////////////////////////////////////////////////////////////
   // Write results to database
   //////////////////////////////////////////////////////////////////////////////
-  // step: 2 写入数据库
-  for (size_t i = 0; i < num_outputs; ++i) {
-    auto output_job = output_queue_.Pop();
-    THROW_CHECK(output_job.IsValid());
-    auto& output = output_job.Data();
-
-    if (output.matches.size() <
-        static_cast<size_t>(geometry_options_.min_num_inliers)) {
-      output.matches = {};
-    }
+  // step: 2 等待writer写入数据库
+  num_writer_inputs_ += num_outputs;
+  writer_->WaitForNumProcessed(num_writer_inputs_);
 
-    if (output.two_view_geometry.inlier_matches.size() <
-        static_cast<size_t>(geometry_options_.min_num_inliers)) {
-      output.two_view_geometry = TwoViewGeometry();
-    }
+  THROW_CHECK_EQ(output_queue_.Size(), 0);
 
-    cache_->WriteMatches(output.image_id1, output.image_id2, output.matches);
-    cache_->WriteTwoViewGeometry(
-        output.image_id1, output.image_id2, output.two_view_geometry);
-  }
+  SetMemoryUsage("feature_matcher_cache", cache_->NumBytes());
+}
 
-  THROW_CHECK_EQ(output_queue_.Size(), 0);
+void FeatureMatcherController::Commit() {
+  THROW_CHECK(is_setup_);
+  THROW_CHECK(output_queue_.Push(FeatureMatcherData()));
+  num_writer_inputs_ += 1;
+  writer_->WaitForNumProcessed(num_writer_inputs_);
 }
 
 }  // namespace colmap
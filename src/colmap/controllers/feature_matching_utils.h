@@ -35,10 +35,14 @@
 #include "colmap/scene/database.h"
 #include "colmap/util/opengl_utils.h"
 #include "colmap/util/threading.h"
+#include "colmap/util/timer.h"
 
 #include <array>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace colmap {
@@ -48,19 +52,36 @@ struct FeatureMatcherData {
   image_t image_id2 = kInvalidImageId;
   FeatureMatches matches;
   TwoViewGeometry two_view_geometry;
+  // Optional prediction of the two-view geometry, which guides the matching
+  // before falling back to the full matching, see
+  // `SiftMatchingOptions::prediction_max_error`.
+  TwoViewGeometry predicted_two_view_geometry;
 };
 
+// Batch of image pairs with the same first image that are matched in one go by
+// the same worker, see `SiftMatchingOptions::batch_size`.
+typedef std::vector<FeatureMatcherData> FeatureMatcherBatch;
+
 // api: 特征匹配工作线程类
 class FeatureMatcherWorker : public Thread {
  public:
   typedef FeatureMatcherData Input;
+  typedef FeatureMatcherBatch BatchInput;
   typedef FeatureMatcherData Output;
 
   FeatureMatcherWorker(const SiftMatchingOptions& matching_options,
                        const TwoViewGeometryOptions& geometry_options,
                        FeatureMatcherCache* cache,
-                       JobQueue<Input>* input_queue,
-                       JobQueue<Output>* output_queue);
+                       LockFreeJobQueue<Input>* input_queue,
+                       LockFreeJobQueue<Output>* output_queue);
+
+  // Worker that consumes batches of image pairs and outputs the results of
+  // the individual image pairs.
+  FeatureMatcherWorker(const SiftMatchingOptions& matching_options,
+                       const TwoViewGeometryOptions& geometry_options,
+                       FeatureMatcherCache* cache,
+                       LockFreeJobQueue<BatchInput>* batch_input_queue,
+                       LockFreeJobQueue<Output>* output_queue);
 
   void SetMaxNumMatches(int max_num_matches);
 
@@ -68,25 +89,92 @@ class FeatureMatcherWorker : public Thread {
   // api: 特征匹配工作线程主函数
   void Run() override;
 
+  void MatchImagePair(FeatureMatcher* matcher, FeatureMatcherData* data);
+  void MatchImagePairBatch(FeatureMatcher* matcher, FeatureMatcherBatch* batch);
+  // Match the image pair guided by its predicted two-view geometry and return
+  // whether the guided matching yields enough matches.
+  bool MatchImagePairPredicted(FeatureMatcher* matcher,
+                               FeatureMatcherData* data);
+
   std::shared_ptr<FeatureKeypoints> GetKeypointsPtr(int index,
                                                     image_t image_id);
   std::shared_ptr<FeatureDescriptors> GetDescriptorsPtr(int index,
                                                         image_t image_id);
+  std::shared_ptr<const FeatureDescriptorIndex> GetDescriptorIndex(
+      FeatureMatcher* matcher, image_t image_id);
+
+  // Whether the image pair passes the coarse matching and verification of the
+  // features with the largest scale, see
+  // `SiftMatchingOptions::coarse_num_features`.
+  bool PassesCoarseMatching(image_t image_id1, image_t image_id2);
+  // Returns the descriptors of the coarse features of the image, or null if
+  // they are the same as in the previous call, and updates their points.
+  std::shared_ptr<FeatureDescriptors> GetCoarseDescriptorsPtr(
+      int index, image_t image_id);
 
   SiftMatchingOptions matching_options_;
   TwoViewGeometryOptions geometry_options_;
   FeatureMatcherCache* cache_;
-  JobQueue<Input>* input_queue_;
-  JobQueue<Output>* output_queue_;
+  LockFreeJobQueue<Input>* input_queue_;
+  LockFreeJobQueue<BatchInput>* batch_input_queue_;
+  LockFreeJobQueue<Output>* output_queue_;
 
   std::unique_ptr<OpenGLContextManager> opengl_context_;
 
+  // Matcher for the image pairs with binary descriptors, which are always
+  // matched on the CPU.
+  std::unique_ptr<FeatureMatcher> binary_matcher_;
+
+  // Matcher for the coarse stage, which keeps the coarse features of the
+  // previous image pair, separately from the full features of the matcher.
+  std::unique_ptr<FeatureMatcher> coarse_matcher_;
+  std::array<image_t, 2> coarse_image_ids_;
+  std::array<std::vector<Eigen::Vector2d>, 2> coarse_points_;
+  FeatureMatches coarse_matches_;
+
   std::array<image_t, 2> prev_keypoints_image_ids_;
   std::array<std::shared_ptr<FeatureKeypoints>, 2> prev_keypoints_;
   std::array<image_t, 2> prev_descriptors_image_ids_;
   std::array<std::shared_ptr<FeatureDescriptors>, 2> prev_descriptors_;
 };
 
+// Writes the matching results to the database in a dedicated thread, so that
+// the verification throughput does not depend on the database latency. The
+// results are committed in transactions spanning many image pairs, see
+// `SiftMatchingOptions::max_num_pairs_per_transaction`. An input with invalid
+// image identifiers requests to commit the current transaction.
+class FeatureMatcherWriter : public Thread {
+ public:
+  typedef FeatureMatcherData Input;
+
+  FeatureMatcherWriter(const SiftMatchingOptions& matching_options,
+                       const TwoViewGeometryOptions& geometry_options,
+                       FeatureMatcherCache* cache,
+                       LockFreeJobQueue<Input>* input_queue);
+
+  // Wait until the given total number of inputs has been processed.
+  void WaitForNumProcessed(size_t num_processed);
+
+ private:
+  void Run() override;
+
+  void Write(FeatureMatcherData* data);
+  void Commit();
+
+  const SiftMatchingOptions matching_options_;
+  const TwoViewGeometryOptions geometry_options_;
+  FeatureMatcherCache* cache_;
+  LockFreeJobQueue<Input>* input_queue_;
+
+  bool in_transaction_;
+  int num_pairs_in_transaction_;
+  Timer transaction_timer_;
+
+  std::mutex mutex_;
+  std::condition_variable num_processed_condition_;
+  size_t num_processed_;
+};
+
 // Multi-threaded and multi-GPU SIFT feature matcher, which writes the computed
 // results to the database and skips already matched image pairs. To improve
 // performance of the matching by taking advantage of caching and database
@@ -103,13 +191,22 @@ class FeatureMatcherController {
 
   ~FeatureMatcherController();
 
-  // Setup the matchers and return if successful.
+  // Setup the matchers and return if successful. The allocated memory is
+  // bounded by the maximum number of features of any image in the database,
+  // unless a positive bound is given, e.g., for images that are added later.
   // api: 设置特征匹配控制器
-  bool Setup();
+  bool Setup(int max_num_features = -1);
 
-  // Match one batch of multiple image pairs.
+  // Match one batch of multiple image pairs. Pairs with a predicted two-view
+  // geometry are first matched guided by the prediction.
   // api: 匹配一批/组图像对数据
-  void Match(const std::vector<std::pair<image_t, image_t>>& image_pairs);
+  void Match(const std::vector<std::pair<image_t, image_t>>& image_pairs,
+             const std::unordered_map<image_pair_t, TwoViewGeometry>&
+                 predicted_two_view_geometries = {});
+
+  // Commit the results written by previous calls to `Match` to the database.
+  // Results are also committed periodically and when the matcher is destroyed.
+  void Commit();
 
  private:
   SiftMatchingOptions matching_options_;
@@ -122,12 +219,16 @@ class FeatureMatcherController {
   std::vector<std::unique_ptr<FeatureMatcherWorker>> matchers_; // 匹配
   std::vector<std::unique_ptr<FeatureMatcherWorker>> guided_matchers_;
   std::vector<std::unique_ptr<Thread>> verifiers_; // 验证
+  std::unique_ptr<FeatureMatcherWriter> writer_;
   std::unique_ptr<ThreadPool> thread_pool_;
 
-  JobQueue<FeatureMatcherData> matcher_queue_;
-  JobQueue<FeatureMatcherData> verifier_queue_;
-  JobQueue<FeatureMatcherData> guided_matcher_queue_;
-  JobQueue<FeatureMatcherData> output_queue_;
+  // Total number of inputs pushed to the writer.
+  size_t num_writer_inputs_;
+
+  LockFreeJobQueue<FeatureMatcherBatch> matcher_queue_;
+  LockFreeJobQueue<FeatureMatcherData> verifier_queue_;
+  LockFreeJobQueue<FeatureMatcherData> guided_matcher_queue_;
+  LockFreeJobQueue<FeatureMatcherData> output_queue_;
 };
 
 }  // namespace colmap
@@ -0,0 +1,176 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/controllers/global_mapper.h"
+
+#include "colmap/scene/database.h"
+#include "colmap/scene/database_cache.h"
+#include "colmap/scene/feature_store.h"
+#include "colmap/sfm/incremental_mapper.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/timer.h"
+
+namespace colmap {
+
+bool GlobalMapperController::Options::Check() const {
+  global_options.Check();
+  incremental_options.Check();
+  return true;
+}
+
+GlobalMapperController::GlobalMapperController(
+    const Options& options,
+    std::shared_ptr<ReconstructionManager> reconstruction_manager)
+    : options_(options),
+      reconstruction_manager_(std::move(reconstruction_manager)) {
+  THROW_CHECK(options_.Check());
+}
+
+void GlobalMapperController::Run() {
+  Timer run_timer;
+  run_timer.Start();
+
+  const IncrementalMapperOptions& incremental_options =
+      options_.incremental_options;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Load view graph
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Loading database");
+
+  std::shared_ptr<const DatabaseCache> database_cache;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  {
+    Database database(options_.database_path);
+    Timer timer;
+    timer.Start();
+    const std::shared_ptr<const FeatureStore> feature_store =
+        FeatureStore::OpenForDatabase(options_.database_path, database);
+    database_cache = DatabaseCache::Create(
+        database,
+        static_cast<size_t>(incremental_options.min_num_matches),
+        incremental_options.ignore_watermarks,
+        incremental_options.image_names,
+        feature_store.get());
+
+    std::vector<image_pair_t> pair_ids;
+    database.ReadTwoViewGeometries(&pair_ids, &two_view_geometries);
+    image_pairs.reserve(pair_ids.size());
+    for (const image_pair_t pair_id : pair_ids) {
+      image_pairs.push_back(Database::PairIdToImagePair(pair_id));
+    }
+    timer.PrintMinutes();
+  }
+
+  if (database_cache->NumImages() == 0) {
+    LOG(WARNING) << "No images with matches found in the database";
+    return;
+  }
+
+  GlobalMapper global_mapper(database_cache);
+  const size_t num_image_pairs = global_mapper.SetUpViewGraph(
+      options_.global_options, image_pairs, two_view_geometries);
+  LOG(INFO) << "=> Image pairs in view graph: " << num_image_pairs;
+  two_view_geometries.clear();
+
+  if (CheckIfStopped()) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Rotation and translation averaging
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Rotation averaging");
+
+  if (!global_mapper.EstimateGlobalRotations(options_.global_options)) {
+    LOG(ERROR) << "Failed to estimate the global rotations";
+    return;
+  }
+  LOG(INFO) << "=> Images with rotations: " << global_mapper.Rotations().size();
+
+  PrintHeading1("Translation averaging");
+
+  if (!global_mapper.EstimateGlobalPositions(options_.global_options)) {
+    LOG(ERROR) << "Failed to estimate the global positions";
+    return;
+  }
+  LOG(INFO) << "=> Images with positions: " << global_mapper.Positions().size();
+
+  if (CheckIfStopped()) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Triangulation and global bundle adjustment
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Global triangulation");
+
+  auto reconstruction = std::make_shared<Reconstruction>();
+  reconstruction->Load(*database_cache);
+  global_mapper.RegisterImages(reconstruction.get());
+
+  const IncrementalTriangulator::Options tri_options =
+      incremental_options.Triangulation();
+  IncrementalMapper mapper(database_cache);
+  mapper.BeginReconstruction(reconstruction);
+  for (const image_t image_id : reconstruction->RegImageIds()) {
+    mapper.TriangulateImage(tri_options, image_id);
+  }
+  LOG(INFO) << "=> Triangulated points: " << reconstruction->NumPoints3D();
+
+  PrintHeading1("Global bundle adjustment");
+
+  const IncrementalMapper::Options mapper_options =
+      incremental_options.Mapper();
+  mapper.IterativeGlobalRefinement(
+      incremental_options.ba_global_max_refinements,
+      incremental_options.ba_global_max_refinement_change,
+      mapper_options,
+      incremental_options.GlobalBundleAdjustment(),
+      tri_options,
+      /*normalize_reconstruction=*/true);
+  mapper.FilterImages(mapper_options);
+
+  const bool kDiscardReconstruction = false;
+  mapper.EndReconstruction(kDiscardReconstruction);
+
+  LOG(INFO) << "=> Registered images: " << reconstruction->NumRegImages();
+  LOG(INFO) << "=> Points: " << reconstruction->NumPoints3D();
+
+  reconstruction_manager_->Get(reconstruction_manager_->Add()) =
+      std::move(reconstruction);
+
+  run_timer.PrintMinutes();
+}
+
+}  // namespace colmap
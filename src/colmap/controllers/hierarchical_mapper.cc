@@ -29,16 +29,167 @@
 
 #include "colmap/controllers/hierarchical_mapper.h"
 
+#include "colmap/controllers/option_manager.h"
 #include "colmap/estimators/alignment.h"
+#include "colmap/scene/database_cache.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/scene/scene_clustering.h"
 #include "colmap/sfm/observation_manager.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/threading.h"
 
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <set>
+#include <thread>
+#include <unordered_set>
+
+#include <boost/filesystem.hpp>
+
 namespace colmap {
 namespace {
 
+const char* const kClusterJobProjectFileName = "project.ini";
+const char* const kClusterJobImageListFileName = "image_list.txt";
+const char* const kClusterJobClaimedDirName = "claimed";
+const char* const kClusterJobSparseDirName = "sparse";
+const char* const kClusterJobDoneFileName = "done";
+
+// Merges the reconstructions level by level like a binary tree. On every
+// level, the reconstructions are greedily paired by their number of common
+// images and all pairs are merged concurrently. Pairs that fail to merge are
+// only retried once one of the two reconstructions has changed.
+void MergeReconstructionTree(
+    const int num_threads,
+    std::vector<std::shared_ptr<Reconstruction>>* reconstructions) {
+  constexpr double kMaxReprojError = 8.0;
+
+  std::set<std::pair<const Reconstruction*, const Reconstruction*>>
+      failed_pairs;
+  const auto MakePair = [](const Reconstruction* reconstruction1,
+                           const Reconstruction* reconstruction2) {
+    return std::make_pair(std::min(reconstruction1, reconstruction2),
+                          std::max(reconstruction1, reconstruction2));
+  };
+  ThreadPool thread_pool(
+      std::max(1, std::min(GetEffectiveNumThreads(num_threads),
+                           static_cast<int>(reconstructions->size() / 2))));
+
+  while (reconstructions->size() > 1) {
+    // Count the common images of all pairs of reconstructions.
+    std::unordered_map<image_t, std::vector<int>> image_reconstruction_idxs;
+    for (size_t i = 0; i < reconstructions->size(); ++i) {
+      for (const image_t image_id : (*reconstructions)[i]->RegImageIds()) {
+        image_reconstruction_idxs[image_id].push_back(i);
+      }
+    }
+    std::map<std::pair<int, int>, int> num_common_images;
+    for (const auto& [_, reconstruction_idxs] : image_reconstruction_idxs) {
+      for (size_t i = 0; i < reconstruction_idxs.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+          num_common_images[std::make_pair(reconstruction_idxs[j],
+                                           reconstruction_idxs[i])] += 1;
+        }
+      }
+    }
+
+    std::vector<std::pair<int, std::pair<int, int>>> candidate_pairs;
+    for (const auto& [pair, num_common] : num_common_images) {
+      if (failed_pairs.count(
+              MakePair((*reconstructions)[pair.first].get(),
+                       (*reconstructions)[pair.second].get())) == 0) {
+        candidate_pairs.emplace_back(num_common, pair);
+      }
+    }
+    std::sort(candidate_pairs.begin(),
+              candidate_pairs.end(),
+              std::greater<std::pair<int, std::pair<int, int>>>());
+
+    // Merge the smaller into the larger reconstruction of every pair.
+    std::vector<std::pair<int, int>> src_tgt_idxs;
+    std::vector<char> is_paired(reconstructions->size(), false);
+    for (const auto& [_, pair] : candidate_pairs) {
+      if (is_paired[pair.first] || is_paired[pair.second]) {
+        continue;
+      }
+      is_paired[pair.first] = true;
+      is_paired[pair.second] = true;
+      if ((*reconstructions)[pair.first]->NumRegImages() <
+          (*reconstructions)[pair.second]->NumRegImages()) {
+        src_tgt_idxs.emplace_back(pair.first, pair.second);
+      } else {
+        src_tgt_idxs.emplace_back(pair.second, pair.first);
+      }
+    }
+
+    if (src_tgt_idxs.empty()) {
+      break;
+    }
+
+    std::vector<std::future<bool>> futures;
+    futures.reserve(src_tgt_idxs.size());
+    for (const auto& [src_idx, tgt_idx] : src_tgt_idxs) {
+      const Reconstruction& src_reconstruction = *(*reconstructions)[src_idx];
+      Reconstruction& tgt_reconstruction = *(*reconstructions)[tgt_idx];
+      futures.push_back(
+          thread_pool.AddTask([&src_reconstruction, &tgt_reconstruction]() {
+            const int num_reg_images_src = src_reconstruction.NumRegImages();
+            const int num_reg_images_tgt = tgt_reconstruction.NumRegImages();
+            if (!MergeAndFilterReconstructions(
+                    kMaxReprojError, src_reconstruction, tgt_reconstruction)) {
+              return false;
+            }
+            LOG(INFO) << StringPrintf(
+                "=> Merged clusters with %d and %d images into %d images",
+                num_reg_images_tgt,
+                num_reg_images_src,
+                tgt_reconstruction.NumRegImages());
+            return true;
+          }));
+    }
+
+    std::unordered_set<const Reconstruction*> changed_reconstructions;
+    std::vector<char> is_merged_src(reconstructions->size(), false);
+    for (size_t i = 0; i < src_tgt_idxs.size(); ++i) {
+      const auto [src_idx, tgt_idx] = src_tgt_idxs[i];
+      const Reconstruction* src_reconstruction =
+          (*reconstructions)[src_idx].get();
+      const Reconstruction* tgt_reconstruction =
+          (*reconstructions)[tgt_idx].get();
+      if (futures[i].get()) {
+        is_merged_src[src_idx] = true;
+        changed_reconstructions.insert(src_reconstruction);
+        changed_reconstructions.insert(tgt_reconstruction);
+      } else {
+        failed_pairs.insert(MakePair(src_reconstruction, tgt_reconstruction));
+      }
+    }
+
+    // The failed pairs with a changed reconstruction can be retried.
+    for (auto it = failed_pairs.begin(); it != failed_pairs.end();) {
+      if (changed_reconstructions.count(it->first) > 0 ||
+          changed_reconstructions.count(it->second) > 0) {
+        it = failed_pairs.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    // Remove the reconstructions merged into others.
+    std::vector<std::shared_ptr<Reconstruction>> remaining_reconstructions;
+    remaining_reconstructions.reserve(reconstructions->size());
+    for (size_t i = 0; i < reconstructions->size(); ++i) {
+      if (!is_merged_src[i]) {
+        remaining_reconstructions.push_back(std::move((*reconstructions)[i]));
+      }
+    }
+    *reconstructions = std::move(remaining_reconstructions);
+  }
+}
+
 void MergeClusters(const SceneClustering::Cluster& cluster,
+                   const int num_threads,
                    std::unordered_map<const SceneClustering::Cluster*,
                                       std::shared_ptr<ReconstructionManager>>*
                        reconstruction_managers) {
@@ -46,7 +197,7 @@ void MergeClusters(const SceneClustering::Cluster& cluster,
   std::vector<std::shared_ptr<Reconstruction>> reconstructions;
   for (const auto& child_cluster : cluster.child_clusters) {
     if (!child_cluster.child_clusters.empty()) {
-      MergeClusters(child_cluster, reconstruction_managers);
+      MergeClusters(child_cluster, num_threads, reconstruction_managers);
     }
 
     auto& reconstruction_manager = reconstruction_managers->at(&child_cluster);
@@ -56,35 +207,7 @@ void MergeClusters(const SceneClustering::Cluster& cluster,
   }
 
   // Try to merge all child cluster reconstruction.
-  while (reconstructions.size() > 1) {
-    bool merge_success = false;
-    for (size_t i = 0; i < reconstructions.size(); ++i) {
-      const int num_reg_images_i = reconstructions[i]->NumRegImages();
-      for (size_t j = 0; j < i; ++j) {
-        const double kMaxReprojError = 8.0;
-        const int num_reg_images_j = reconstructions[j]->NumRegImages();
-        if (MergeAndFilterReconstructions(
-                kMaxReprojError, *reconstructions[j], *reconstructions[i])) {
-          LOG(INFO) << StringPrintf(
-              "=> Merged clusters with %d and %d images into %d images",
-              num_reg_images_i,
-              num_reg_images_j,
-              reconstructions[i]->NumRegImages());
-          reconstructions.erase(reconstructions.begin() + j);
-          merge_success = true;
-          break;
-        }
-      }
-
-      if (merge_success) {
-        break;
-      }
-    }
-
-    if (!merge_success) {
-      break;
-    }
-  }
+  MergeReconstructionTree(num_threads, &reconstructions);
 
   // Insert a new reconstruction manager for merged cluster.
   auto& reconstruction_manager = (*reconstruction_managers)[&cluster];
@@ -99,14 +222,134 @@ void MergeClusters(const SceneClustering::Cluster& cluster,
   }
 }
 
+void AdjustGlobalBundle(const HierarchicalMapperController::Options& options,
+                        Reconstruction* reconstruction) {
+  const std::vector<image_t>& reg_image_ids = reconstruction->RegImageIds();
+  if (reg_image_ids.size() < 2) {
+    return;
+  }
+
+  // Avoid degeneracies in bundle adjustment.
+  ObservationManager observation_manager(*reconstruction);
+  observation_manager.FilterObservationsWithNegativeDepth();
+
+  BundleAdjustmentConfig ba_config;
+  for (const image_t image_id : reg_image_ids) {
+    ba_config.AddImage(image_id);
+  }
+  ba_config.SetConstantCamPose(reg_image_ids[0]);
+  ba_config.SetConstantCamPositions(reg_image_ids[1], {0});
+
+  PartitionedBundleAdjuster bundle_adjuster(
+      options.final_ba_partition_options,
+      options.incremental_options.GlobalBundleAdjustment(),
+      ba_config);
+  bundle_adjuster.Solve(reconstruction);
+
+  const IncrementalMapper::Options mapper_options =
+      options.incremental_options.Mapper();
+  observation_manager.FilterAllPoints3D(mapper_options.filter_max_reproj_error,
+                                        mapper_options.filter_min_tri_angle);
+}
+
 }  // namespace
 
+void HierarchicalMapperClusterJob::Write(const std::string& job_path) const {
+  CreateDirIfNotExists(job_path);
+
+  const std::string image_list_path =
+      JoinPaths(job_path, kClusterJobImageListFileName);
+  std::ofstream image_list_file(image_list_path);
+  THROW_CHECK_FILE_OPEN(image_list_file, image_list_path);
+  std::vector<std::string> image_names(
+      incremental_options.image_names.begin(),
+      incremental_options.image_names.end());
+  std::sort(image_names.begin(), image_names.end());
+  for (const std::string& image_name : image_names) {
+    image_list_file << image_name << "\n";
+  }
+  image_list_file.close();
+
+  // The project file is written last, since it marks the job as complete.
+  OptionManager options(/*add_project_options=*/false);
+  options.AddDatabaseOptions();
+  options.AddImageOptions();
+  options.AddMapperOptions();
+  *options.database_path = database_path;
+  *options.image_path = image_path;
+  *options.mapper = incremental_options;
+  options.Write(JoinPaths(job_path, kClusterJobProjectFileName));
+}
+
+HierarchicalMapperClusterJob HierarchicalMapperClusterJob::Read(
+    const std::string& job_path) {
+  OptionManager options(/*add_project_options=*/false);
+  options.AddDatabaseOptions();
+  options.AddImageOptions();
+  options.AddMapperOptions();
+  THROW_CHECK(options.Read(JoinPaths(job_path, kClusterJobProjectFileName)))
+      << "Invalid cluster job " << job_path;
+
+  HierarchicalMapperClusterJob job;
+  job.database_path = *options.database_path;
+  job.image_path = *options.image_path;
+  job.incremental_options = *options.mapper;
+  const std::vector<std::string> image_names =
+      ReadTextFileLines(JoinPaths(job_path, kClusterJobImageListFileName));
+  job.incremental_options.image_names =
+      std::unordered_set<std::string>(image_names.begin(), image_names.end());
+  return job;
+}
+
+bool ReconstructNextHierarchicalMapperClusterJob(
+    const std::string& cluster_jobs_path, const int num_threads) {
+  std::vector<std::string> job_paths = GetDirList(cluster_jobs_path);
+  std::sort(job_paths.begin(), job_paths.end());
+  for (const std::string& job_path : job_paths) {
+    if (!ExistsFile(JoinPaths(job_path, kClusterJobProjectFileName)) ||
+        !boost::filesystem::create_directory(
+            JoinPaths(job_path, kClusterJobClaimedDirName))) {
+      continue;
+    }
+
+    LOG(INFO) << "Reconstructing cluster job " << job_path;
+
+    HierarchicalMapperClusterJob job =
+        HierarchicalMapperClusterJob::Read(job_path);
+    if (num_threads > 0) {
+      job.incremental_options.num_threads = num_threads;
+    }
+
+    auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+    IncrementalMapperController mapper(
+        std::make_shared<IncrementalMapperOptions>(job.incremental_options),
+        job.image_path,
+        job.database_path,
+        reconstruction_manager);
+    mapper.Run();
+
+    const std::string sparse_path =
+        JoinPaths(job_path, kClusterJobSparseDirName);
+    CreateDirIfNotExists(sparse_path);
+    reconstruction_manager->Write(sparse_path);
+
+    const std::string done_path = JoinPaths(job_path, kClusterJobDoneFileName);
+    std::ofstream done_file(done_path);
+    THROW_CHECK_FILE_OPEN(done_file, done_path);
+
+    return true;
+  }
+
+  return false;
+}
+
 bool HierarchicalMapperController::Options::Check() const {
   CHECK_OPTION_GT(init_num_trials, -1);
   CHECK_OPTION_GE(num_workers, -1);
   clustering_options.Check();
   THROW_CHECK_EQ(clustering_options.branching, 2);
   incremental_options.Check();
+  final_ba_partition_options.Check();
   return true;
 }
 
@@ -170,6 +413,23 @@ void HierarchicalMapperController::Run() {
   const int num_threads_per_worker =
       std::max(1, num_eff_threads / num_eff_workers);
 
+  // Function to create the options to reconstruct one cluster.
+  auto CreateClusterOptions =
+      [&, this](const SceneClustering::Cluster& cluster) {
+        IncrementalMapperOptions incremental_options =
+            options_.incremental_options;
+        incremental_options.max_model_overlap = 3;
+        incremental_options.init_num_trials = options_.init_num_trials;
+        for (const auto image_id : cluster.image_ids) {
+          incremental_options.image_names.insert(
+              image_id_to_name.at(image_id));
+        }
+        return incremental_options;
+      };
+
+  // The database cache shared by all clusters, if reconstructed locally.
+  std::shared_ptr<const DatabaseCache> database_cache;
+
   // Function to reconstruct one cluster using incremental mapping.
   auto ReconstructCluster =
       [&, this](const SceneClustering::Cluster& cluster,
@@ -179,22 +439,19 @@ void HierarchicalMapperController::Run() {
         }
 
         auto incremental_options = std::make_shared<IncrementalMapperOptions>(
-            options_.incremental_options);
-        incremental_options->max_model_overlap = 3;
-        incremental_options->init_num_trials = options_.init_num_trials;
+            CreateClusterOptions(cluster));
         if (incremental_options->num_threads < 0) {
           incremental_options->num_threads = num_threads_per_worker;
         }
 
-        for (const auto image_id : cluster.image_ids) {
-          incremental_options->image_names.insert(
-              image_id_to_name.at(image_id));
-        }
-
         IncrementalMapperController mapper(std::move(incremental_options),
                                            options_.image_path,
                                            options_.database_path,
                                            std::move(reconstruction_manager));
+        mapper.SetDatabaseCache(DatabaseCache::CreateSubset(
+            database_cache,
+            std::unordered_set<image_t>(cluster.image_ids.begin(),
+                                        cluster.image_ids.end())));
         mapper.Run();
       };
 
@@ -213,14 +470,111 @@ void HierarchicalMapperController::Run() {
       reconstruction_managers;
   reconstruction_managers.reserve(leaf_clusters.size());
 
-  ThreadPool thread_pool(num_eff_workers);
-  for (const auto& cluster : leaf_clusters) {
-    reconstruction_managers[cluster] =
-        std::make_shared<ReconstructionManager>();
-    thread_pool.AddTask(
-        ReconstructCluster, *cluster, reconstruction_managers[cluster]);
+  if (options_.cluster_jobs_path.empty()) {
+    // Load the database only once and share it between all clusters, which
+    // only hold lightweight views on the images of the cluster.
+    LOG(INFO) << "Loading database";
+    const IncrementalMapperOptions& incremental_options =
+        options_.incremental_options;
+    const size_t min_num_matches =
+        static_cast<size_t>(incremental_options.min_num_matches);
+    const std::shared_ptr<const FeatureStore> feature_store =
+        FeatureStore::OpenForDatabase(options_.database_path, database);
+    if (incremental_options.lazy_load_points2D) {
+      database_cache = DatabaseCache::CreateLazy(
+          options_.database_path,
+          min_num_matches,
+          incremental_options.ignore_watermarks,
+          incremental_options.image_names,
+          feature_store,
+          static_cast<size_t>(1024.0 * 1024.0 * 1024.0 *
+                              incremental_options.lazy_points2D_cache_size));
+    } else if (incremental_options.compact_points2D) {
+      database_cache =
+          DatabaseCache::CreateCompact(database,
+                                       min_num_matches,
+                                       incremental_options.ignore_watermarks,
+                                       incremental_options.image_names,
+                                       feature_store.get());
+    } else {
+      database_cache =
+          DatabaseCache::Create(database,
+                                min_num_matches,
+                                incremental_options.ignore_watermarks,
+                                incremental_options.image_names,
+                                feature_store.get());
+    }
+
+    ThreadPool thread_pool(num_eff_workers);
+    for (const auto& cluster : leaf_clusters) {
+      reconstruction_managers[cluster] =
+          std::make_shared<ReconstructionManager>();
+      thread_pool.AddTask(
+          ReconstructCluster, *cluster, reconstruction_managers[cluster]);
+    }
+    thread_pool.Wait();
+  } else {
+    CreateDirIfNotExists(options_.cluster_jobs_path, /*recursive=*/true);
+
+    std::vector<std::pair<const SceneClustering::Cluster*, std::string>> jobs;
+    for (size_t i = 0; i < leaf_clusters.size(); ++i) {
+      reconstruction_managers[leaf_clusters[i]] =
+          std::make_shared<ReconstructionManager>();
+      if (leaf_clusters[i]->image_ids.empty()) {
+        continue;
+      }
+      const std::string job_path = JoinPaths(options_.cluster_jobs_path,
+                                             StringPrintf("cluster%06d", i));
+      if (!ExistsFile(JoinPaths(job_path, kClusterJobProjectFileName))) {
+        HierarchicalMapperClusterJob job;
+        job.database_path = options_.database_path;
+        job.image_path = options_.image_path;
+        job.incremental_options = CreateClusterOptions(*leaf_clusters[i]);
+        job.Write(job_path);
+      }
+      jobs.emplace_back(leaf_clusters[i], job_path);
+    }
+
+    LOG(INFO) << StringPrintf("Wrote %d cluster jobs to %s",
+                              jobs.size(),
+                              options_.cluster_jobs_path.c_str());
+
+    // The local workers reconstruct pending jobs like any other worker.
+    const int num_threads = options_.incremental_options.num_threads < 0
+                                ? num_threads_per_worker
+                                : options_.incremental_options.num_threads;
+    ThreadPool thread_pool(num_eff_workers);
+    for (int i = 0; i < num_eff_workers; ++i) {
+      thread_pool.AddTask([&, this]() {
+        while (!CheckIfStopped() &&
+               ReconstructNextHierarchicalMapperClusterJob(
+                   options_.cluster_jobs_path, num_threads)) {
+        }
+      });
+    }
+    thread_pool.Wait();
+
+    // Wait for the jobs claimed by other workers.
+    const int kPollIntervalSeconds = 10;
+    for (const auto& [cluster, job_path] : jobs) {
+      const std::string done_path =
+          JoinPaths(job_path, kClusterJobDoneFileName);
+      while (!ExistsFile(done_path)) {
+        if (CheckIfStopped()) {
+          return;
+        }
+        LOG_FIRST_N(INFO, 1) << "Waiting for cluster jobs of other workers";
+        std::this_thread::sleep_for(std::chrono::seconds(kPollIntervalSeconds));
+      }
+
+      std::vector<std::string> reconstruction_paths =
+          GetDirList(JoinPaths(job_path, kClusterJobSparseDirName));
+      std::sort(reconstruction_paths.begin(), reconstruction_paths.end());
+      for (const std::string& reconstruction_path : reconstruction_paths) {
+        reconstruction_managers.at(cluster)->Read(reconstruction_path);
+      }
+    }
   }
-  thread_pool.Wait();
 
   //////////////////////////////////////////////////////////////////////////////
   // Merge clusters
@@ -229,7 +583,9 @@ void HierarchicalMapperController::Run() {
   if (leaf_clusters.size() > 1) {
     PrintHeading1("Merging clusters");
 
-    MergeClusters(*scene_clustering.GetRootCluster(), &reconstruction_managers);
+    MergeClusters(*scene_clustering.GetRootCluster(),
+                  num_eff_threads,
+                  &reconstruction_managers);
   }
 
   THROW_CHECK_EQ(reconstruction_managers.size(), 1);
@@ -237,6 +593,13 @@ void HierarchicalMapperController::Run() {
       reconstruction_managers.begin()->second->Get(0)->NumRegImages(), 0);
   *reconstruction_manager_ = *reconstruction_managers.begin()->second;
 
+  if (options_.final_ba) {
+    PrintHeading1("Global bundle adjustment");
+    for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+      AdjustGlobalBundle(options_, reconstruction_manager_->Get(i).get());
+    }
+  }
+
   run_timer.PrintMinutes();
 }
 
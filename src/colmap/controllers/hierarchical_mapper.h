@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/controllers/incremental_mapper.h"
+#include "colmap/estimators/bundle_adjustment.h"
 #include "colmap/scene/reconstruction_manager.h"
 #include "colmap/scene/scene_clustering.h"
 #include "colmap/util/base_controller.h"
@@ -64,6 +65,22 @@ class HierarchicalMapperController : public BaseController {
     // Options used to reconstruction each cluster individually.
     IncrementalMapperOptions incremental_options;
 
+    // Whether to refine the merged reconstructions with a final global bundle
+    // adjustment, which is partitioned for large reconstructions.
+    bool final_ba = false;
+
+    // Options for partitioning the final global bundle adjustment.
+    PartitionedBundleAdjustmentOptions final_ba_partition_options;
+
+    // If not empty, the clusters are written as jobs to this folder instead
+    // of being reconstructed directly. The jobs are then reconstructed by the
+    // local workers together with any other workers sharing the folder, e.g.,
+    // `colmap hierarchical_mapper_worker` on other machines, see
+    // `ReconstructNextHierarchicalMapperClusterJob`. The merging waits for all
+    // jobs to be done. Existing jobs are not rewritten, such that an
+    // interrupted reconstruction can be resumed.
+    std::string cluster_jobs_path;
+
     bool Check() const;
   };
 
@@ -78,4 +95,30 @@ class HierarchicalMapperController : public BaseController {
   std::shared_ptr<ReconstructionManager> reconstruction_manager_;
 };
 
+// Job to reconstruct a single cluster of the hierarchical mapper, which is
+// serialized to a folder with the options in "project.ini" and the cluster
+// images in "image_list.txt". The jobs can thus be reconstructed on any
+// machine with access to the same database and image paths.
+struct HierarchicalMapperClusterJob {
+  std::string database_path;
+  std::string image_path;
+
+  // The options of the cluster reconstruction, including the image names.
+  IncrementalMapperOptions incremental_options;
+
+  void Write(const std::string& job_path) const;
+  static HierarchicalMapperClusterJob Read(const std::string& job_path);
+};
+
+// Claim and reconstruct the next pending job in the folder of cluster jobs.
+// A job is claimed by atomically creating its "claimed" folder, such that
+// multiple workers can share the same folder, e.g., on a network file system.
+// The reconstructions are written to the "sparse" folder of the job and the
+// job is marked as done by an empty "done" file. Jobs of failed workers can be
+// released by deleting their "claimed" folder. If positive, the number of
+// threads overrides the number of threads of the job options. Returns false,
+// if there is no pending job.
+bool ReconstructNextHierarchicalMapperClusterJob(
+    const std::string& cluster_jobs_path, int num_threads = -1);
+
 }  // namespace colmap
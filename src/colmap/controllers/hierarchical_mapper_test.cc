@@ -92,6 +92,98 @@ TEST(HierarchicalMapperController, WithoutNoise) {
                              /*num_obs_tolerance=*/0);
 }
 
+TEST(HierarchicalMapperController, WithPartitionedFinalBundleAdjustment) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 20;
+  synthetic_dataset_options.num_points3D = 50;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  HierarchicalMapperController::Options mapper_options;
+  mapper_options.database_path = database_path;
+  mapper_options.clustering_options.leaf_max_num_images = 5;
+  mapper_options.clustering_options.image_overlap = 3;
+  mapper_options.final_ba = true;
+  mapper_options.final_ba_partition_options.max_num_images = 10;
+  HierarchicalMapperController mapper(mapper_options, reconstruction_manager);
+  mapper.Run();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+}
+
+TEST(HierarchicalMapperController, WithClusterJobs) {
+  const std::string test_dir = CreateTestDir();
+  const std::string database_path = test_dir + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 20;
+  synthetic_dataset_options.num_points3D = 50;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  HierarchicalMapperController::Options mapper_options;
+  mapper_options.database_path = database_path;
+  mapper_options.image_path = test_dir;
+  mapper_options.clustering_options.leaf_max_num_images = 5;
+  mapper_options.clustering_options.image_overlap = 3;
+  mapper_options.cluster_jobs_path = test_dir + "/jobs";
+  HierarchicalMapperController mapper(mapper_options, reconstruction_manager);
+  mapper.Run();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+
+  // All jobs are done, such that there is nothing left to reconstruct.
+  const std::vector<std::string> job_paths =
+      GetDirList(mapper_options.cluster_jobs_path);
+  EXPECT_GT(job_paths.size(), 1);
+  for (const std::string& job_path : job_paths) {
+    EXPECT_TRUE(ExistsFile(JoinPaths(job_path, "done")));
+  }
+  EXPECT_FALSE(ReconstructNextHierarchicalMapperClusterJob(
+      mapper_options.cluster_jobs_path));
+}
+
+TEST(HierarchicalMapperClusterJob, ReadWrite) {
+  const std::string test_dir = CreateTestDir();
+  HierarchicalMapperClusterJob job;
+  job.database_path = test_dir + "/database.db";
+  job.image_path = test_dir;
+  job.incremental_options.image_names = {"image1.png", "image2.png"};
+  job.incremental_options.max_model_overlap = 3;
+  job.incremental_options.init_num_trials = 7;
+  const std::string job_path = test_dir + "/job";
+  job.Write(job_path);
+
+  const HierarchicalMapperClusterJob read_job =
+      HierarchicalMapperClusterJob::Read(job_path);
+  EXPECT_EQ(read_job.database_path, job.database_path);
+  EXPECT_EQ(read_job.image_path, job.image_path);
+  EXPECT_EQ(read_job.incremental_options.image_names,
+            job.incremental_options.image_names);
+  EXPECT_EQ(read_job.incremental_options.max_model_overlap, 3);
+  EXPECT_EQ(read_job.incremental_options.init_num_trials, 7);
+}
+
 TEST(HierarchicalMapperController, MultiReconstruction) {
   const std::string database_path = CreateTestDir() + "/database.db";
 
@@ -33,9 +33,40 @@
 #include "colmap/util/misc.h"
 
 namespace colmap {
+namespace {
+
+// Only hash the content of the file, if the modification time changed, such
+// that unchanged images are detected by a single stat call.
+bool IsFileChanged(const std::string& path, FileSignature* signature) {
+  const FileSignature prev_signature = *signature;
+  *signature = ComputeFileSignature(path, /*compute_hash=*/false);
+  if (signature->size != prev_signature.size) {
+    return true;
+  }
+  if (signature->modification_time == prev_signature.modification_time) {
+    signature->hash = prev_signature.hash;
+    return false;
+  }
+  *signature = ComputeFileSignature(path);
+  return signature->hash != prev_signature.hash;
+}
+
+}  // namespace
 
 bool ImageReaderOptions::Check() const {
   CHECK_OPTION_GT(default_focal_length_factor, 0.0);
+  CHECK_OPTION_GE(num_threads, -1);
+  CHECK_OPTION_NE(num_threads, 0);
+  CHECK_OPTION_GT(video_frame_step, 0);
+  CHECK_OPTION_GT(num_shards, 0);
+  CHECK_OPTION_GE(shard_index, 0);
+  CHECK_OPTION_LT(shard_index, num_shards);
+  if (!video_path.empty()) {
+    CHECK_OPTION(VideoReader::IsAvailable());
+  }
+  CHECK_OPTION(ExistsBitmapDecoderWithName(bitmap_decoder));
+  CHECK_OPTION(
+      IsBitmapDecoderAvailable(BitmapDecoderTypeFromString(bitmap_decoder)));
   CHECK_OPTION(ExistsCameraModelWithName(camera_model));
   const CameraModelId model_id = CameraModelNameToId(camera_model);
   if (!camera_params.empty()) {
@@ -58,7 +89,31 @@ ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
 
   // Get a list of all files in the image path, sorted by image name.
   // step: 2 获取图片路径列表，并排序
-  if (options_.image_list.empty()) {
+  if (!options_.video_path.empty()) {
+    video_reader_ = std::make_unique<VideoReader>(options_.video_path);
+    const std::string video_name = GetPathBaseName(options_.video_path);
+    options_.image_list.clear();
+    size_t num_selected_frames = 0;
+    for (size_t frame_idx = 0; frame_idx < video_reader_->NumFrames();
+         ++frame_idx) {
+      if (options_.video_keyframes_only &&
+          !video_reader_->IsKeyFrame(frame_idx)) {
+        continue;
+      }
+      num_selected_frames += 1;
+      if ((num_selected_frames - 1) % options_.video_frame_step != 0) {
+        continue;
+      }
+      const std::string frame_name = StringPrintf(
+          "%s/frame%06d.png", video_name.c_str(), static_cast<int>(frame_idx));
+      video_frame_idxs_.push_back(frame_idx);
+      options_.image_list.push_back(options_.image_path + frame_name);
+    }
+    // All frames of the video are taken by the same camera.
+    options_.single_camera = true;
+    options_.single_camera_per_folder = false;
+    options_.single_camera_per_image = false;
+  } else if (options_.image_list.empty()) {
     options_.image_list = GetRecursiveFileList(options_.image_path);
     std::sort(options_.image_list.begin(), options_.image_list.end());
   } else {
@@ -71,6 +126,26 @@ ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
     }
   }
 
+  // Keep the contiguous block of the shard, which is deterministic for the
+  // same listing and keeps most images of the same sub-folder together.
+  if (options_.num_shards > 1) {
+    const size_t num_images = options_.image_list.size();
+    shard_begin_ = num_images * options_.shard_index / options_.num_shards;
+    const size_t shard_end =
+        num_images * (options_.shard_index + 1) / options_.num_shards;
+    options_.image_list = std::vector<std::string>(
+        options_.image_list.begin() + shard_begin_,
+        options_.image_list.begin() + shard_end);
+    if (video_reader_) {
+      video_frame_idxs_ =
+          std::vector<size_t>(video_frame_idxs_.begin() + shard_begin_,
+                              video_frame_idxs_.begin() + shard_end);
+    }
+    LOG(INFO) << "Reading shard " << options_.shard_index + 1 << " / "
+              << options_.num_shards << " with images " << shard_begin_ + 1
+              << " to " << shard_end << " of " << num_images;
+  }
+
   // step: 3 配置相机参数
   if (static_cast<camera_t>(options_.existing_camera_id) != kInvalidCameraId) {
     THROW_CHECK(database->ExistsCamera(options_.existing_camera_id));
@@ -86,6 +161,40 @@ ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
       prev_camera_.has_prior_focal_length = true;
     }
   }
+
+  // step: 4 已提取特征的图片
+  DatabaseTransaction database_transaction(database_);
+  for (const Image& image : database->ReadAllImages()) {
+    if (!database->ExistsKeypoints(image.ImageId()) ||
+        !database->ExistsDescriptors(image.ImageId())) {
+      continue;
+    }
+    const std::string image_path = JoinPaths(options_.image_path, image.Name());
+    if (options_.detect_changed_images && !video_reader_ &&
+        ExistsFile(image_path)) {
+      if (!database->ExistsImageSignature(image.ImageId())) {
+        // The features were extracted before signatures were stored, so the
+        // image is assumed to be unchanged.
+        database->WriteImageSignature(image.ImageId(),
+                                      ComputeFileSignature(image_path));
+      } else {
+        FileSignature signature = database->ReadImageSignature(image.ImageId());
+        const FileSignature prev_signature = signature;
+        if (IsFileChanged(image_path, &signature)) {
+          changed_image_names_.insert(image.Name());
+          continue;
+        }
+        if (signature != prev_signature) {
+          // Avoid hashing the file again, if only the modification time
+          // changed, e.g., when the images were copied.
+          database->WriteImageSignature(image.ImageId(), signature);
+        }
+      }
+    }
+    processed_image_names_.insert(image.Name());
+  }
+
+  bitmap_decoder_ = CreateBitmapDecoder(options_.bitmap_decoder);
 }
 
 ImageReader::Status ImageReader::Next(Camera* camera,
@@ -93,6 +202,159 @@ ImageReader::Status ImageReader::Next(Camera* camera,
                                       PosePrior* pose_prior,
                                       Bitmap* bitmap,
                                       Bitmap* mask) {
+  return NextImpl(camera,
+                  image,
+                  pose_prior,
+                  bitmap,
+                  mask,
+                  /*bitmap_status=*/nullptr);
+}
+
+ImageReader::Status ImageReader::NextWithBitmap(Camera* camera,
+                                                Image* image,
+                                                PosePrior* pose_prior,
+                                                Bitmap* bitmap,
+                                                Bitmap* mask,
+                                                const Status bitmap_status) {
+  return NextImpl(camera, image, pose_prior, bitmap, mask, &bitmap_status);
+}
+
+ImageReader::Status ImageReader::NextMetadata(Camera* camera,
+                                              Image* image,
+                                              PosePrior* pose_prior) {
+  THROW_CHECK_LT(image_index_, options_.image_list.size());
+  Bitmap bitmap;
+  const Status header_status = IsImageProcessed(image_index_)
+                                   ? Status::SUCCESS
+                                   : ReadBitmapHeader(image_index_, &bitmap);
+  return NextImpl(camera,
+                  image,
+                  pose_prior,
+                  &bitmap,
+                  /*mask=*/nullptr,
+                  &header_status);
+}
+
+ImageReader::Status ImageReader::ReadBitmapHeader(const size_t image_index,
+                                                  Bitmap* bitmap) const {
+  if (video_reader_) {
+    return ReadVideoFrame(image_index, bitmap) ? Status::SUCCESS
+                                               : Status::BITMAP_ERROR;
+  }
+  return bitmap->ReadHeader(options_.image_list[image_index])
+             ? Status::SUCCESS
+             : Status::BITMAP_ERROR;
+}
+
+ImageReader::Status ImageReader::ReadBitmap(const size_t image_index,
+                                            Bitmap* bitmap,
+                                            Bitmap* mask) const {
+  THROW_CHECK_NOTNULL(bitmap);
+  THROW_CHECK_LT(image_index, options_.image_list.size());
+
+  if (video_reader_) {
+    if (!ReadVideoFrame(image_index, bitmap)) {
+      return Status::BITMAP_ERROR;
+    }
+  } else if (!bitmap_decoder_->Decode(options_.image_list[image_index],
+                                      /*as_rgb=*/false,
+                                      options_.max_image_size,
+                                      bitmap)) {
+    return Status::BITMAP_ERROR;
+  }
+
+  if (mask && !options_.mask_path.empty()) {
+    const std::string mask_path =
+        JoinPaths(options_.mask_path, ImageName(image_index) + ".png");
+    if (ExistsFile(mask_path) && !mask->Read(mask_path, false)) {
+      // NOTE: Maybe introduce a separate error type MASK_ERROR?
+      return Status::BITMAP_ERROR;
+    }
+  }
+
+  return Status::SUCCESS;
+}
+
+bool ImageReader::ReadVideoFrame(const size_t image_index,
+                                 Bitmap* bitmap) const {
+  std::lock_guard<std::mutex> lock(video_reader_mutex_);
+
+  const auto cached_frame = cached_video_frames_.find(image_index);
+  if (cached_frame != cached_video_frames_.end()) {
+    *bitmap = std::move(cached_frame->second);
+    cached_video_frames_.erase(cached_frame);
+    return true;
+  }
+
+  // Concurrent calls may request the frames slightly out of order. Instead of
+  // seeking back later, the skipped frames right before the requested frame
+  // are decoded on the way and cached for the pending requests.
+  constexpr size_t kMaxNumCachedFrames = 16;
+  if (image_index > next_video_image_index_) {
+    for (size_t i = std::max(next_video_image_index_,
+                             image_index > kMaxNumCachedFrames
+                                 ? image_index - kMaxNumCachedFrames
+                                 : 0);
+         i < image_index;
+         ++i) {
+      if (IsImageProcessed(i)) {
+        continue;
+      }
+      Bitmap frame;
+      if (video_reader_->ReadFrame(
+              video_frame_idxs_[i], /*as_rgb=*/false, &frame)) {
+        cached_video_frames_.emplace(i, std::move(frame));
+      }
+    }
+    while (cached_video_frames_.size() > kMaxNumCachedFrames) {
+      cached_video_frames_.erase(cached_video_frames_.begin());
+    }
+  }
+
+  next_video_image_index_ = image_index + 1;
+  return video_reader_->ReadFrame(
+      video_frame_idxs_[image_index], /*as_rgb=*/false, bitmap);
+}
+
+bool ImageReader::IsImageProcessed(const size_t image_index) const {
+  return processed_image_names_.count(ImageName(image_index)) > 0;
+}
+
+bool ImageReader::ComputeImageSignature(const size_t image_index,
+                                        FileSignature* signature) const {
+  THROW_CHECK_NOTNULL(signature);
+  THROW_CHECK_LT(image_index, options_.image_list.size());
+  if (video_reader_ || !ExistsFile(options_.image_list[image_index])) {
+    return false;
+  }
+  *signature = ComputeFileSignature(options_.image_list[image_index]);
+  return true;
+}
+
+bool ImageReader::ComputeImageContentHash(const size_t image_index,
+                                          uint64_t* hash) const {
+  THROW_CHECK_NOTNULL(hash);
+  THROW_CHECK_LT(image_index, options_.image_list.size());
+  if (video_reader_ || !ExistsFile(options_.image_list[image_index])) {
+    return false;
+  }
+  *hash = ComputeFileContentHash(options_.image_list[image_index]);
+  return true;
+}
+
+std::string ImageReader::ImageName(const size_t image_index) const {
+  const std::string image_path =
+      StringReplace(options_.image_list.at(image_index), "\\", "/");
+  return image_path.substr(options_.image_path.size(),
+                           image_path.size() - options_.image_path.size());
+}
+
+ImageReader::Status ImageReader::NextImpl(Camera* camera,
+                                          Image* image,
+                                          PosePrior* pose_prior,
+                                          Bitmap* bitmap,
+                                          Bitmap* mask,
+                                          const Status* bitmap_status) {
   THROW_CHECK_NOTNULL(camera);
   THROW_CHECK_NOTNULL(image);
   THROW_CHECK_NOTNULL(bitmap);
@@ -100,19 +362,13 @@ ImageReader::Status ImageReader::Next(Camera* camera,
   image_index_ += 1;
   THROW_CHECK_LE(image_index_, options_.image_list.size());
 
-  const std::string image_path = options_.image_list.at(image_index_ - 1);
-
   DatabaseTransaction database_transaction(database_);
 
   //////////////////////////////////////////////////////////////////////////////
   // Set the image name.
   //////////////////////////////////////////////////////////////////////////////
 
-  image->SetName(image_path);
-  image->SetName(StringReplace(image->Name(), "\\", "/"));
-  image->SetName(
-      image->Name().substr(options_.image_path.size(),
-                           image->Name().size() - options_.image_path.size()));
+  image->SetName(ImageName(image_index_ - 1));
 
   const std::string image_folder = GetParentDir(image->Name());
 
@@ -129,30 +385,30 @@ ImageReader::Status ImageReader::Next(Camera* camera,
         database_->ExistsDescriptors(image->ImageId());
 
     if (exists_keypoints && exists_descriptors) {
-      return Status::IMAGE_EXISTS;
+      if (changed_image_names_.count(image->Name()) == 0) {
+        return Status::IMAGE_EXISTS;
+      }
+      LOG(INFO) << "Image " << image->Name()
+                << " changed, re-extracting its features";
+      database_->DeleteImageFeatures(image->ImageId());
     }
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // Read image.
+  // Read image and mask.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (!bitmap->Read(image_path, false)) {
-    return Status::BITMAP_ERROR;
+  const Status read_status = bitmap_status == nullptr
+                                 ? ReadBitmap(image_index_ - 1, bitmap, mask)
+                                 : *bitmap_status;
+  if (read_status != Status::SUCCESS) {
+    return read_status;
   }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Read mask.
-  //////////////////////////////////////////////////////////////////////////////
-
-  if (mask && !options_.mask_path.empty()) {
-    const std::string mask_path =
-        JoinPaths(options_.mask_path, image->Name() + ".png");
-    if (ExistsFile(mask_path) && !mask->Read(mask_path, false)) {
-      // NOTE: Maybe introduce a separate error type MASK_ERROR?
-      return Status::BITMAP_ERROR;
-    }
-  }
+  // The camera has the full resolution of images decoded at reduced size.
+  int width = bitmap->Width();
+  int height = bitmap->Height();
+  bitmap->OriginalSize(&width, &height);
 
   //////////////////////////////////////////////////////////////////////////////
   // Check for well-formed data.
@@ -167,8 +423,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
-    if (static_cast<size_t>(bitmap->Width()) != current_camera.width ||
-        static_cast<size_t>(bitmap->Height()) != current_camera.height) {
+    if (static_cast<size_t>(width) != current_camera.width ||
+        static_cast<size_t>(height) != current_camera.height) {
       return Status::CAMERA_EXIST_DIM_ERROR;
     }
 
@@ -183,8 +439,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
         ((options_.single_camera && !options_.single_camera_per_folder) ||
          (options_.single_camera_per_folder &&
           image_folder == prev_image_folder_)) &&
-        (prev_camera_.width != static_cast<size_t>(bitmap->Width()) ||
-         prev_camera_.height != static_cast<size_t>(bitmap->Height()))) {
+        (prev_camera_.width != static_cast<size_t>(width) ||
+         prev_camera_.height != static_cast<size_t>(height))) {
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
@@ -196,8 +452,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
     if (camera_model_to_id_.count(camera_model) > 0) {
       Camera camera =
           database_->ReadCamera(camera_model_to_id_.at(camera_model));
-      if (camera.width != static_cast<size_t>(bitmap->Width()) ||
-          camera.height != static_cast<size_t>(bitmap->Height())) {
+      if (camera.width != static_cast<size_t>(width) ||
+          camera.height != static_cast<size_t>(height)) {
         return Status::CAMERA_EXIST_DIM_ERROR;
       }
       prev_camera_ = std::move(camera);
@@ -223,19 +479,19 @@ ImageReader::Status ImageReader::Next(Camera* camera,
           has_focal_length = true;
         } else {
           focal_length = options_.default_focal_length_factor *
-                         std::max(bitmap->Width(), bitmap->Height());
+                         std::max(width, height);
         }
 
         prev_camera_ = Camera::CreateFromModelId(prev_camera_.camera_id,
                                                  prev_camera_.model_id,
                                                  focal_length,
-                                                 bitmap->Width(),
-                                                 bitmap->Height());
+                                                 width,
+                                                 height);
         prev_camera_.has_prior_focal_length = has_focal_length;
       }
 
-      prev_camera_.width = static_cast<size_t>(bitmap->Width());
-      prev_camera_.height = static_cast<size_t>(bitmap->Height());
+      prev_camera_.width = static_cast<size_t>(width);
+      prev_camera_.height = static_cast<size_t>(height);
 
       if (!prev_camera_.VerifyParams()) {
         return Status::CAMERA_PARAM_ERROR;
@@ -274,4 +530,11 @@ size_t ImageReader::NextIndex() const { return image_index_; }
 
 size_t ImageReader::NumImages() const { return options_.image_list.size(); }
 
+image_t ImageReader::ShardImageId(const size_t image_index) const {
+  if (options_.num_shards <= 1) {
+    return kInvalidImageId;
+  }
+  return static_cast<image_t>(shard_begin_ + image_index + 1);
+}
+
 }  // namespace colmap
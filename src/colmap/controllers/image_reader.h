@@ -32,8 +32,12 @@
 #include "colmap/geometry/gps.h"
 #include "colmap/scene/database.h"
 #include "colmap/sensor/bitmap.h"
+#include "colmap/sensor/bitmap_decoder.h"
+#include "colmap/sensor/video_reader.h"
 #include "colmap/util/threading.h"
 
+#include <map>
+#include <mutex>
 #include <unordered_set>
 
 namespace colmap {
@@ -58,6 +62,20 @@ struct ImageReaderOptions {
   // of the images with respect to the image_path.
   std::vector<std::string> image_list;
 
+  // Optional path to a video file, whose frames are decoded directly instead
+  // of reading the images in image_path. This requires FFmpeg support. The
+  // frames are named "<video file name>/frame<frame index>.png" relative to
+  // image_path, where the index in presentation order is independent of the
+  // selected frames, and all frames share a single camera.
+  std::string video_path = "";
+
+  // Only read every n-th selected frame of the video.
+  int video_frame_step = 1;
+
+  // Only select the keyframes of the video, which avoids decoding the frames
+  // in between.
+  bool video_keyframes_only = false;
+
   // Name of the camera model.
   std::string camera_model = "SIMPLE_RADIAL";
 
@@ -88,6 +106,38 @@ struct ImageReaderOptions {
   // intensity value 0 in grayscale).
   std::string camera_mask_path = "";
 
+  // The number of threads used to read and decode images ahead of the feature
+  // extraction. The cameras are still assigned in the order of the images.
+  int num_threads = -1;
+
+  // If positive, JPEG images that are at least twice as large are decoded at
+  // a reduced resolution of 1/2, 1/4, or 1/8, such that their maximum
+  // dimension is still at least this size. This is typically set to the
+  // maximum image size of the feature extraction, which avoids decoding all
+  // pixels at full resolution before down-sampling. The cameras always have
+  // the full image resolution.
+  int max_image_size = -1;
+
+  // The backend used to decode the images, i.e., "freeimage", "libjpeg", or
+  // "nvjpeg". Masks are always read with FreeImage.
+  std::string bitmap_decoder = "freeimage";
+
+  // Whether to detect images that changed since their features were
+  // extracted by comparing the file size, modification time, and content hash
+  // with the signature stored in the database. The features and matches of
+  // changed images are deleted and extracted again, while unchanged images
+  // are skipped without decoding them.
+  bool detect_changed_images = true;
+
+  // Only read the shard_index-th of num_shards contiguous, equally sized
+  // blocks of the sorted images, e.g., to distribute the feature extraction
+  // over multiple machines. New images of a shard are written with their
+  // index in the listing of all shards plus one as identifier, such that the
+  // per-shard databases have globally consistent, disjoint image identifiers,
+  // provided that they are initially empty.
+  int shard_index = 0;
+  int num_shards = 1;
+
   bool Check() const;
 };
 
@@ -114,10 +164,67 @@ class ImageReader {
               PosePrior* pose_prior,
               Bitmap* bitmap,
               Bitmap* mask);
+
+  // Same as Next, but uses the bitmap and mask of the next image that were
+  // already read by ReadBitmap, where bitmap_status is its return value.
+  Status NextWithBitmap(Camera* camera,
+                        Image* image,
+                        PosePrior* pose_prior,
+                        Bitmap* bitmap,
+                        Bitmap* mask,
+                        Status bitmap_status);
+
+  // Same as Next, but only reads the dimensions and EXIF metadata of the image
+  // from the file header instead of decoding the bitmap. This is much faster
+  // for callers that need no pixels, e.g., to import images or features.
+  Status NextMetadata(Camera* camera, Image* image, PosePrior* pose_prior);
+
+  // Read the bitmap and, if a mask path is set, the mask of an image. This
+  // method does not change the state of the reader, so it can be called
+  // concurrently to decode images ahead of NextWithBitmap.
+  Status ReadBitmap(size_t image_index, Bitmap* bitmap, Bitmap* mask) const;
+
+  // Read the header of the image file, or decode the frame for videos, which
+  // suffices for NextWithBitmap, if no pixels are needed. Like ReadBitmap,
+  // this can be called concurrently.
+  Status ReadBitmapHeader(size_t image_index, Bitmap* bitmap) const;
+
+  // Whether the features of the image were already extracted, when the reader
+  // was created, in which case its bitmap need not be read. The features of
+  // changed images are not considered as extracted.
+  bool IsImageProcessed(size_t image_index) const;
+
+  // Compute the signature of the image file, which should be stored in the
+  // database together with its features. Video frames have no signature.
+  bool ComputeImageSignature(size_t image_index,
+                             FileSignature* signature) const;
+
+  // Compute the hash of the entire content of the image file, e.g., to look up
+  // its features in a cache. Video frames have no content hash.
+  bool ComputeImageContentHash(size_t image_index, uint64_t* hash) const;
+
   size_t NextIndex() const;
   size_t NumImages() const;
 
+  // Identifier of a new image in sharded mode, i.e., its index in the listing
+  // of all shards plus one, or kInvalidImageId without sharding, in which case
+  // the database assigns the identifiers.
+  image_t ShardImageId(size_t image_index) const;
+
  private:
+  Status NextImpl(Camera* camera,
+                  Image* image,
+                  PosePrior* pose_prior,
+                  Bitmap* bitmap,
+                  Bitmap* mask,
+                  const Status* bitmap_status);
+
+  std::string ImageName(size_t image_index) const;
+
+  // Decodes the video frame of the image. Frames that are requested out of
+  // order by concurrent calls are decoded ahead and cached.
+  bool ReadVideoFrame(size_t image_index, Bitmap* bitmap) const;
+
   // Image reader options.
   ImageReaderOptions options_;
   Database* database_;
@@ -129,6 +236,20 @@ class ImageReader {
   // Names of image sub-folders.
   std::string prev_image_folder_;
   std::unordered_set<std::string> image_folders_;
+  // Names of images with keypoints and descriptors in the database.
+  std::unordered_set<std::string> processed_image_names_;
+  // Names of images whose features are outdated, because the file changed.
+  std::unordered_set<std::string> changed_image_names_;
+  // Shared by concurrent calls to ReadBitmap.
+  std::unique_ptr<BitmapDecoder> bitmap_decoder_;
+  // Video frames of the images, if reading from a video.
+  std::unique_ptr<VideoReader> video_reader_;
+  std::vector<size_t> video_frame_idxs_;
+  // Index of the first image of the shard in the listing of all shards.
+  size_t shard_begin_ = 0;
+  mutable std::mutex video_reader_mutex_;
+  mutable size_t next_video_image_index_ = 0;
+  mutable std::map<size_t, Bitmap> cached_video_frames_;
 };
 
 }  // namespace colmap
@@ -29,22 +29,212 @@
 
 #include "colmap/controllers/incremental_mapper.h"
 
+#include "colmap/scene/scene_clustering.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/memory.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
 
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
 namespace colmap {
 namespace {
 
 void IterativeGlobalRefinement(const IncrementalMapperOptions& options,
                                const IncrementalMapper::Options& mapper_options,
+                               const BundleAdjustmentOptions& ba_options,
                                IncrementalMapper& mapper) {
   LOG(INFO) << "Retriangulation and Global bundle adjustment";
   mapper.IterativeGlobalRefinement(options.ba_global_max_refinements,
                                    options.ba_global_max_refinement_change,
                                    mapper_options,
-                                   options.GlobalBundleAdjustment(),
+                                   ba_options,
                                    options.Triangulation());
   mapper.FilterImages(mapper_options);
+  // The reconstruction grows the most between the global refinements.
+  SetMemoryUsage("reconstruction", mapper.Reconstruction()->NumBytes());
+}
+
+void PartialGlobalRefinement(const IncrementalMapper::Options& mapper_options,
+                             const BundleAdjustmentOptions& ba_options,
+                             IncrementalMapper& mapper) {
+  LOG(INFO) << "Partial global bundle adjustment";
+  const std::unordered_set<image_t> image_ids =
+      mapper.LocalBundleDriftImageIds();
+  mapper.AdjustPartialGlobalBundle(mapper_options, ba_options, image_ids);
+  mapper.FilterPoints(mapper_options);
+  mapper.FilterImages(mapper_options);
+}
+
+// Triangulate the registered images of the given cluster in a separate
+// reconstruction. All registered images of the cluster provide observations,
+// but only the given subset of images is triangulated.
+std::shared_ptr<Reconstruction> TriangulateCluster(
+    const IncrementalMapperOptions& options,
+    const std::string& database_path,
+    const Reconstruction& reconstruction,
+    const std::vector<image_t>& image_ids,
+    const std::vector<image_t>& tri_image_ids) {
+  auto cluster_reconstruction = std::make_shared<Reconstruction>();
+  std::unordered_set<std::string> image_names;
+  for (const image_t image_id : image_ids) {
+    Image image = reconstruction.Image(image_id);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      if (image.Point2D(point2D_idx).HasPoint3D()) {
+        image.ResetPoint3DForPoint2D(point2D_idx);
+      }
+    }
+    if (!cluster_reconstruction->ExistsCamera(image.CameraId())) {
+      cluster_reconstruction->AddCamera(
+          reconstruction.Camera(image.CameraId()));
+    }
+    image_names.insert(image.Name());
+    cluster_reconstruction->AddImage(std::move(image));
+    cluster_reconstruction->RegisterImage(image_id);
+  }
+
+  std::shared_ptr<class DatabaseCache> database_cache;
+  {
+    const Database database(database_path);
+    database_cache = DatabaseCache::Create(
+        database,
+        static_cast<size_t>(options.min_num_matches),
+        options.ignore_watermarks,
+        image_names);
+  }
+
+  // The clusters are already triangulated in parallel.
+  IncrementalTriangulator::Options tri_options = options.Triangulation();
+  tri_options.num_threads = 1;
+
+  IncrementalMapper mapper(database_cache);
+  mapper.BeginReconstruction(cluster_reconstruction);
+  for (const image_t image_id : tri_image_ids) {
+    mapper.TriangulateImage(tri_options, image_id);
+  }
+  mapper.EndReconstruction(/*discard=*/false);
+
+  return cluster_reconstruction;
+}
+
+// Merge the 3D points of a triangulated cluster into the reconstruction. Points
+// whose observations are not yet triangulated are added as new points, while
+// points that overlap with exactly one existing point are merged into it.
+// Ambiguous overlaps are resolved by only adding the new observations, which
+// are later merged with the existing tracks by the triangulator.
+size_t MergeClusterPoints3D(const Reconstruction& cluster_reconstruction,
+                            const Reconstruction& reconstruction,
+                            ObservationManager& obs_manager) {
+  size_t num_merged_observations = 0;
+  for (const auto& point3D : cluster_reconstruction.Points3D()) {
+    Track new_track;
+    point3D_t old_point3D_id = kInvalidPoint3DId;
+    bool is_ambiguous = false;
+    for (const auto& track_el : point3D.second.track.Elements()) {
+      const Point2D& point2D = reconstruction.Image(track_el.image_id)
+                                   .Point2D(track_el.point2D_idx);
+      if (!point2D.HasPoint3D()) {
+        new_track.AddElement(track_el);
+      } else if (old_point3D_id == kInvalidPoint3DId) {
+        old_point3D_id = point2D.point3D_id;
+      } else if (old_point3D_id != point2D.point3D_id) {
+        is_ambiguous = true;
+      }
+    }
+
+    if (old_point3D_id != kInvalidPoint3DId && !is_ambiguous) {
+      for (const auto& track_el : new_track.Elements()) {
+        obs_manager.AddObservation(old_point3D_id, track_el);
+      }
+      num_merged_observations += new_track.Length();
+    } else if (new_track.Length() >= 2) {
+      obs_manager.AddPoint3D(point3D.second.xyz, new_track);
+      num_merged_observations += new_track.Length();
+    }
+  }
+  return num_merged_observations;
+}
+
+// Triangulate the registered images of the reconstruction in overlapping
+// clusters in parallel. Each image is triangulated in the first cluster that
+// contains it, while the overlapping images of the other clusters only
+// contribute observations to tracks across the cluster boundaries. Images
+// without matches are not part of any cluster and have nothing to triangulate.
+void TriangulatePartitions(const IncrementalMapperOptions& options,
+                           const std::string& database_path,
+                           const Reconstruction& reconstruction,
+                           IncrementalMapper& mapper) {
+  SceneClustering::Options clustering_options;
+  clustering_options.leaf_max_num_images =
+      options.tri_partition_max_num_images;
+  clustering_options.image_overlap =
+      std::min(clustering_options.image_overlap,
+               options.tri_partition_max_num_images);
+  THROW_CHECK(clustering_options.Check());
+
+  std::vector<std::vector<image_t>> cluster_image_ids;
+  std::vector<std::vector<image_t>> cluster_tri_image_ids;
+  {
+    const Database database(database_path);
+    const SceneClustering scene_clustering =
+        SceneClustering::Create(clustering_options, database);
+    std::unordered_set<image_t> tri_image_ids;
+    for (const auto* cluster : scene_clustering.GetLeafClusters()) {
+      std::vector<image_t>& image_ids = cluster_image_ids.emplace_back();
+      std::vector<image_t>& owned_image_ids =
+          cluster_tri_image_ids.emplace_back();
+      for (const image_t image_id : cluster->image_ids) {
+        if (!reconstruction.ExistsImage(image_id) ||
+            !reconstruction.IsImageRegistered(image_id)) {
+          continue;
+        }
+        image_ids.push_back(image_id);
+        if (tri_image_ids.insert(image_id).second) {
+          owned_image_ids.push_back(image_id);
+        }
+      }
+    }
+  }
+
+  LOG(INFO) << StringPrintf("Triangulating %d image clusters",
+                            cluster_image_ids.size());
+
+  ThreadPool thread_pool(GetEffectiveNumThreads(options.num_threads));
+  std::vector<std::future<std::shared_ptr<Reconstruction>>> futures;
+  futures.reserve(cluster_image_ids.size());
+  for (size_t i = 0; i < cluster_image_ids.size(); ++i) {
+    futures.push_back(thread_pool.AddTask(TriangulateCluster,
+                                          std::cref(options),
+                                          std::cref(database_path),
+                                          std::cref(reconstruction),
+                                          std::cref(cluster_image_ids[i]),
+                                          std::cref(cluster_tri_image_ids[i])));
+  }
+
+  // The clusters read the reconstruction while they are triangulated, so their
+  // points can only be merged once all of them are finished.
+  std::vector<std::shared_ptr<Reconstruction>> cluster_reconstructions;
+  cluster_reconstructions.reserve(futures.size());
+  for (auto& future : futures) {
+    cluster_reconstructions.push_back(future.get());
+  }
+
+  for (size_t i = 0; i < cluster_reconstructions.size(); ++i) {
+    const size_t num_merged_observations = MergeClusterPoints3D(
+        *cluster_reconstructions[i], reconstruction, mapper.ObservationManager());
+    LOG(INFO) << StringPrintf(
+        "=> Merged %d observations of cluster #%d with %d images",
+        num_merged_observations,
+        i + 1,
+        cluster_image_ids[i].size());
+    cluster_reconstructions[i].reset();
+  }
 }
 
 void ExtractColors(const std::string& image_path,
@@ -73,6 +263,82 @@ void WriteSnapshot(const Reconstruction& reconstruction,
   reconstruction.Write(path);
 }
 
+template <typename T>
+void WriteBinarySet(std::ostream* stream, const std::unordered_set<T>& set) {
+  WriteBinaryLittleEndian<uint64_t>(stream, set.size());
+  for (const T& value : set) {
+    WriteBinaryLittleEndian<T>(stream, value);
+  }
+}
+
+template <typename T>
+std::unordered_set<T> ReadBinarySet(std::istream* stream) {
+  std::unordered_set<T> set;
+  const size_t size = ReadBinaryLittleEndian<uint64_t>(stream);
+  set.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    set.insert(ReadBinaryLittleEndian<T>(stream));
+  }
+  return set;
+}
+
+template <typename K>
+void WriteBinaryCounts(std::ostream* stream,
+                       const std::unordered_map<K, size_t>& counts) {
+  WriteBinaryLittleEndian<uint64_t>(stream, counts.size());
+  for (const auto& [key, count] : counts) {
+    WriteBinaryLittleEndian<K>(stream, key);
+    WriteBinaryLittleEndian<uint64_t>(stream, count);
+  }
+}
+
+template <typename K>
+std::unordered_map<K, size_t> ReadBinaryCounts(std::istream* stream) {
+  std::unordered_map<K, size_t> counts;
+  const size_t size = ReadBinaryLittleEndian<uint64_t>(stream);
+  counts.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    const K key = ReadBinaryLittleEndian<K>(stream);
+    counts.emplace(key, ReadBinaryLittleEndian<uint64_t>(stream));
+  }
+  return counts;
+}
+
+void WriteMapperState(std::ostream* stream,
+                      const IncrementalMapper::State& state) {
+  WriteBinaryLittleEndian<uint64_t>(stream, state.num_total_reg_images);
+  WriteBinaryLittleEndian<uint64_t>(stream, state.num_shared_reg_images);
+  WriteBinaryCounts(stream, state.init_num_reg_trials);
+  WriteBinarySet(stream, state.init_image_pairs);
+  WriteBinaryCounts(stream, state.num_registrations);
+  WriteBinarySet(stream, state.filtered_images);
+  WriteBinaryCounts(stream, state.num_reg_trials);
+  WriteBinarySet(stream, state.existing_image_ids);
+  WriteBinaryLittleEndian<double>(stream, state.local_ba_drift);
+  WriteBinarySet(stream, state.local_ba_drift_image_ids);
+}
+
+IncrementalMapper::State ReadMapperState(std::istream* stream) {
+  IncrementalMapper::State state;
+  state.num_total_reg_images = ReadBinaryLittleEndian<uint64_t>(stream);
+  state.num_shared_reg_images = ReadBinaryLittleEndian<uint64_t>(stream);
+  state.init_num_reg_trials = ReadBinaryCounts<image_t>(stream);
+  state.init_image_pairs = ReadBinarySet<image_pair_t>(stream);
+  state.num_registrations = ReadBinaryCounts<image_t>(stream);
+  state.filtered_images = ReadBinarySet<image_t>(stream);
+  state.num_reg_trials = ReadBinaryCounts<image_t>(stream);
+  state.existing_image_ids = ReadBinarySet<image_t>(stream);
+  state.local_ba_drift = ReadBinaryLittleEndian<double>(stream);
+  state.local_ba_drift_image_ids = ReadBinarySet<image_t>(stream);
+  return state;
+}
+
+// The checkpoints are written to numbered folders. The name of the latest
+// complete checkpoint is written to a separate file, which is replaced
+// atomically, such that an interrupted write never corrupts the latest
+// checkpoint.
+const char* const kLatestCheckpointFileName = "LATEST";
+const char* const kCheckpointStateFileName = "state.bin";
 }  // namespace
 
 IncrementalMapper::Options IncrementalMapperOptions::Mapper() const {
@@ -94,6 +360,7 @@ IncrementalTriangulator::Options IncrementalMapperOptions::Triangulation()
   options.min_focal_length_ratio = min_focal_length_ratio;
   options.max_focal_length_ratio = max_focal_length_ratio;
   options.max_extra_param = max_extra_param;
+  options.num_threads = num_threads;
   return options;
 }
 
@@ -116,6 +383,8 @@ BundleAdjustmentOptions IncrementalMapperOptions::LocalBundleAdjustment()
   options.refine_extra_params = ba_refine_extra_params;
   options.min_num_residuals_for_multi_threading =
       ba_min_num_residuals_for_multi_threading;
+  options.use_float_jacobians = ba_use_float_jacobians;
+  options.telemetry_label = "local";
   options.loss_function_scale = 1.0;
   options.loss_function_type =
       BundleAdjustmentOptions::LossFunctionType::SOFT_L1;
@@ -143,6 +412,16 @@ BundleAdjustmentOptions IncrementalMapperOptions::GlobalBundleAdjustment()
   options.refine_extra_params = ba_refine_extra_params;
   options.min_num_residuals_for_multi_threading =
       ba_min_num_residuals_for_multi_threading;
+  options.use_gpu = ba_use_gpu;
+  options.gpu_index = ba_gpu_index;
+  options.min_num_images_gpu_solver = ba_min_num_images_gpu_solver;
+  options.use_float_jacobians = ba_use_float_jacobians;
+  options.marginalize_constant_pose_points =
+      ba_global_marginalize_constant_pose_points;
+  if (ba_global_reject_outliers_in_solver) {
+    options.outlier_max_reproj_error = mapper.filter_max_reproj_error;
+  }
+  options.telemetry_label = "global";
   options.loss_function_type =
       BundleAdjustmentOptions::LossFunctionType::TRIVIAL;
   return options;
@@ -150,10 +429,14 @@ BundleAdjustmentOptions IncrementalMapperOptions::GlobalBundleAdjustment()
 
 bool IncrementalMapperOptions::Check() const {
   CHECK_OPTION_GT(min_num_matches, 0);
+  CHECK_OPTION_GT(lazy_points2D_cache_size, 0);
   CHECK_OPTION_GT(max_num_models, 0);
   CHECK_OPTION_GT(max_model_overlap, 0);
   CHECK_OPTION_GE(min_model_size, 0);
   CHECK_OPTION_GT(init_num_trials, 0);
+  CHECK_OPTION_GT(num_parallel_reg_images, 0);
+  CHECK_OPTION_GT(num_parallel_models, 0);
+  CHECK_OPTION_GE(tri_partition_max_num_images, 0);
   CHECK_OPTION_GT(min_focal_length_ratio, 0);
   CHECK_OPTION_GT(max_focal_length_ratio, 0);
   CHECK_OPTION_GE(max_extra_param, 0);
@@ -163,12 +446,18 @@ bool IncrementalMapperOptions::Check() const {
   CHECK_OPTION_GT(ba_global_points_ratio, 1.0);
   CHECK_OPTION_GT(ba_global_images_freq, 0);
   CHECK_OPTION_GT(ba_global_points_freq, 0);
+  CHECK_OPTION_GE(ba_min_num_images_gpu_solver, 0);
+  CHECK_OPTION_GE(ba_global_max_drift, 0);
+  CHECK_OPTION_GE(ba_global_partial_max_images_ratio, 0);
+  CHECK_OPTION_LE(ba_global_partial_max_images_ratio, 1);
   CHECK_OPTION_GT(ba_global_max_num_iterations, 0);
   CHECK_OPTION_GT(ba_local_max_refinements, 0);
   CHECK_OPTION_GE(ba_local_max_refinement_change, 0);
   CHECK_OPTION_GT(ba_global_max_refinements, 0);
   CHECK_OPTION_GE(ba_global_max_refinement_change, 0);
   CHECK_OPTION_GE(snapshot_images_freq, 0);
+  CHECK_OPTION_GT(checkpoint_images_freq, 0);
+  CHECK_OPTION_GT(stream_poll_interval, 0);
   CHECK_OPTION(Mapper().Check());
   CHECK_OPTION(Triangulation().Check());
   return true;
@@ -189,38 +478,142 @@ IncrementalMapperController::IncrementalMapperController(
   RegisterCallback(LAST_IMAGE_REG_CALLBACK);
 }
 
+void IncrementalMapperController::BundleAdjustmentTotals::Add(
+    const BundleAdjustmentTelemetry& telemetry) {
+  num_adjustments += 1;
+  num_iterations += telemetry.num_iterations;
+  num_residuals += telemetry.num_residuals;
+  setup_time += telemetry.setup_time;
+  jacobian_evaluation_time += telemetry.jacobian_evaluation_time;
+  linear_solver_time += telemetry.linear_solver_time;
+  total_time += telemetry.total_time;
+}
+
 void IncrementalMapperController::Run() {
   Timer run_timer;
   run_timer.Start();
-  if (!LoadDatabase()) {
+
+  {
+    std::lock_guard<std::mutex> lock(ba_telemetry_mutex_);
+    ba_totals_.clear();
+    if (!options_->ba_telemetry_path.empty()) {
+      ba_telemetry_file_.open(options_->ba_telemetry_path,
+                              std::ios::out | std::ios::app);
+      THROW_CHECK_FILE_OPEN(ba_telemetry_file_, options_->ba_telemetry_path);
+    }
+  }
+
+  // When streaming, the reconstruction may start before any images with
+  // matches are written to the database.
+  if (database_cache_ == nullptr) {
+    if (!LoadDatabase() && !options_->stream_new_images) {
+      return;
+    }
+  } else if (database_cache_->NumImages() == 0 &&
+             !options_->stream_new_images) {
+    LOG(WARNING) << "No images with matches found in the database cache";
     return;
   }
 
-  IncrementalMapper::Options init_mapper_options = options_->Mapper();
-  Reconstruct(init_mapper_options);
+  progress_ = Checkpoint();
+  resume_checkpoint_.reset();
+  if (!options_->checkpoint_path.empty()) {
+    CreateDirIfNotExists(options_->checkpoint_path);
+    ReadLatestCheckpoint();
+  }
 
-  const size_t kNumInitRelaxations = 2;
-  for (size_t i = 0; i < kNumInitRelaxations; ++i) {
-    if (reconstruction_manager_->Size() > 0 || CheckIfStopped()) {
-      break;
+  // The initialization constraints are relaxed alternately, unless the
+  // previous constraints yielded a reconstruction. When resuming, the
+  // relaxations of the checkpoint are applied before continuing.
+  const int num_resumed_init_relaxations =
+      resume_checkpoint_ ? resume_checkpoint_->num_init_relaxations : 0;
+  IncrementalMapper::Options init_mapper_options = options_->Mapper();
+  const int kNumInitRelaxations = 2;
+  for (int i = 0; i <= 2 * kNumInitRelaxations; ++i) {
+    if (i > 0) {
+      if (i > num_resumed_init_relaxations &&
+          (reconstruction_manager_->Size() > 0 || CheckIfStopped())) {
+        break;
+      }
+      if (i % 2 == 1) {
+        init_mapper_options.init_min_num_inliers /= 2;
+      } else {
+        init_mapper_options.init_min_tri_angle /= 2;
+      }
+      if (i >= num_resumed_init_relaxations) {
+        LOG(INFO) << "=> Relaxing the initialization constraints.";
+      }
     }
-
-    LOG(INFO) << "=> Relaxing the initialization constraints.";
-    init_mapper_options.init_min_num_inliers /= 2;
+    if (i < num_resumed_init_relaxations) {
+      continue;
+    }
+    progress_.num_init_relaxations = i;
     Reconstruct(init_mapper_options);
+  }
 
-    if (reconstruction_manager_->Size() > 0 || CheckIfStopped()) {
-      break;
-    }
+  WaitForCheckpoint();
 
-    LOG(INFO) << "=> Relaxing the initialization constraints.";
-    init_mapper_options.init_min_tri_angle /= 2;
-    Reconstruct(init_mapper_options);
+  {
+    std::lock_guard<std::mutex> lock(ba_telemetry_mutex_);
+    for (const auto& [label, totals] : ba_totals_) {
+      LOG(INFO) << StringPrintf(
+          "Bundle adjustment (%s): %d adjustments, %d iterations, "
+          "setup %.3fs, Jacobians %.3fs, linear solver %.3fs, total %.3fs",
+          label.c_str(),
+          totals.num_adjustments,
+          totals.num_iterations,
+          totals.setup_time,
+          totals.jacobian_evaluation_time,
+          totals.linear_solver_time,
+          totals.total_time);
+    }
+    if (ba_telemetry_file_.is_open()) {
+      ba_telemetry_file_.close();
+    }
   }
 
   run_timer.PrintMinutes();
 }
 
+std::map<std::string, IncrementalMapperController::BundleAdjustmentTotals>
+IncrementalMapperController::BundleAdjustmentTotalsByLabel() const {
+  std::lock_guard<std::mutex> lock(ba_telemetry_mutex_);
+  return ba_totals_;
+}
+
+BundleAdjustmentOptions IncrementalMapperController::LocalBundleAdjustment() {
+  BundleAdjustmentOptions ba_options = options_->LocalBundleAdjustment();
+  ba_options.telemetry_callback =
+      [this](const BundleAdjustmentTelemetry& telemetry) {
+        RecordBundleAdjustment(telemetry);
+      };
+  return ba_options;
+}
+
+BundleAdjustmentOptions IncrementalMapperController::GlobalBundleAdjustment() {
+  BundleAdjustmentOptions ba_options = options_->GlobalBundleAdjustment();
+  ba_options.telemetry_callback =
+      [this](const BundleAdjustmentTelemetry& telemetry) {
+        RecordBundleAdjustment(telemetry);
+      };
+  return ba_options;
+}
+
+void IncrementalMapperController::RecordBundleAdjustment(
+    const BundleAdjustmentTelemetry& telemetry) {
+  MetricsRegistry::Instance()
+      .Histogram("colmap_bundle_adjustment_seconds",
+                 "Wall time of the bundle adjustments",
+                 ExponentialMetricBuckets(0.01, 4, 10),
+                 {{"type", telemetry.label}})
+      ->Observe(telemetry.total_time);
+  std::lock_guard<std::mutex> lock(ba_telemetry_mutex_);
+  ba_totals_[telemetry.label].Add(telemetry);
+  if (ba_telemetry_file_.is_open()) {
+    ba_telemetry_file_ << telemetry.ToJson() << std::endl;
+  }
+}
+
 bool IncrementalMapperController::LoadDatabase() {
   LOG(INFO) << "Loading database";
 
@@ -239,8 +632,37 @@ bool IncrementalMapperController::LoadDatabase() {
   Timer timer;
   timer.Start();
   const size_t min_num_matches = static_cast<size_t>(options_->min_num_matches);
-  database_cache_ = DatabaseCache::Create(
-      database, min_num_matches, options_->ignore_watermarks, image_names);
+  const std::shared_ptr<const FeatureStore> feature_store =
+      FeatureStore::OpenForDatabase(database_path_, database);
+  if (options_->lazy_load_points2D) {
+    database_cache_ = DatabaseCache::CreateLazy(
+        database_path_,
+        min_num_matches,
+        options_->ignore_watermarks,
+        image_names,
+        feature_store,
+        static_cast<size_t>(1024.0 * 1024.0 * 1024.0 *
+                            options_->lazy_points2D_cache_size));
+  } else if (options_->compact_points2D) {
+    database_cache_ = DatabaseCache::CreateCompact(database,
+                                                   min_num_matches,
+                                                   options_->ignore_watermarks,
+                                                   image_names,
+                                                   feature_store.get());
+  } else {
+    database_cache_ = DatabaseCache::Create(database,
+                                            min_num_matches,
+                                            options_->ignore_watermarks,
+                                            image_names,
+                                            feature_store.get());
+  }
+  if (options_->precompute_tracks) {
+    database_cache_->ComputeTracks(options_->num_threads);
+  }
+  SetMemoryUsage("database_cache", database_cache_->NumBytes());
+  SetMemoryUsage("correspondence_graph",
+                 database_cache_->CorrespondenceGraph()->NumBytes());
+  LogMemoryUsage();
   timer.PrintMinutes();
 
   if (database_cache_->NumImages() == 0) {
@@ -251,6 +673,22 @@ bool IncrementalMapperController::LoadDatabase() {
   return true;
 }
 
+void IncrementalMapperController::SetDatabaseCache(
+    std::shared_ptr<class DatabaseCache> database_cache) {
+  THROW_CHECK_NOTNULL(database_cache);
+  database_cache_ = std::move(database_cache);
+}
+
+void IncrementalMapperController::SetCheckIfInputFinishedFunc(
+    std::function<bool()> func) {
+  check_if_input_finished_fn_ = std::move(func);
+}
+
+void IncrementalMapperController::SetCameraRigs(
+    std::vector<CameraRig> camera_rigs) {
+  camera_rigs_ = std::move(camera_rigs);
+}
+
 IncrementalMapperController::Status
 IncrementalMapperController::InitializeReconstruction(
     IncrementalMapper& mapper,
@@ -292,7 +730,7 @@ IncrementalMapperController::InitializeReconstruction(
       mapper_options, two_view_geometry, image_id1, image_id2);
 
   LOG(INFO) << "Global bundle adjustment";
-  mapper.AdjustGlobalBundle(mapper_options, options_->GlobalBundleAdjustment());
+  mapper.AdjustGlobalBundle(mapper_options, GlobalBundleAdjustment());
   reconstruction.Normalize();
   mapper.FilterPoints(mapper_options);
   mapper.FilterImages(mapper_options);
@@ -312,12 +750,16 @@ bool IncrementalMapperController::CheckRunGlobalRefinement(
     const Reconstruction& reconstruction,
     const size_t ba_prev_num_reg_images,
     const size_t ba_prev_num_points) {
-  return reconstruction.NumRegImages() >=
-             options_->ba_global_images_ratio * ba_prev_num_reg_images ||
+  // With drift-based scheduling, the growth ratios are replaced by the drift.
+  const bool use_growth_ratios = options_->ba_global_max_drift <= 0;
+  return (use_growth_ratios &&
+          reconstruction.NumRegImages() >=
+              options_->ba_global_images_ratio * ba_prev_num_reg_images) ||
          reconstruction.NumRegImages() >=
              options_->ba_global_images_freq + ba_prev_num_reg_images ||
-         reconstruction.NumPoints3D() >=
-             options_->ba_global_points_ratio * ba_prev_num_points ||
+         (use_growth_ratios &&
+          reconstruction.NumPoints3D() >=
+              options_->ba_global_points_ratio * ba_prev_num_points) ||
          reconstruction.NumPoints3D() >=
              options_->ba_global_points_freq + ba_prev_num_points;
 }
@@ -329,27 +771,47 @@ IncrementalMapperController::ReconstructSubModel(
     const std::shared_ptr<Reconstruction>& reconstruction) {
   mapper.BeginReconstruction(reconstruction);
 
+  size_t snapshot_prev_num_reg_images = reconstruction->NumRegImages();
+  size_t ba_prev_num_reg_images = reconstruction->NumRegImages();
+  size_t ba_prev_num_points = reconstruction->NumPoints3D();
+  if (resume_checkpoint_ && resume_checkpoint_->in_progress) {
+    LOG(INFO) << StringPrintf(
+        "Resuming reconstruction with %d registered images from checkpoint",
+        reconstruction->NumRegImages());
+    mapper.SetState(resume_checkpoint_->mapper_state);
+    snapshot_prev_num_reg_images =
+        resume_checkpoint_->snapshot_prev_num_reg_images;
+    ba_prev_num_reg_images = resume_checkpoint_->ba_prev_num_reg_images;
+    ba_prev_num_points = resume_checkpoint_->ba_prev_num_points;
+    resume_checkpoint_.reset();
+  }
+
   ////////////////////////////////////////////////////////////////////////////
   // Register initial pair
   ////////////////////////////////////////////////////////////////////////////
 
   if (reconstruction->NumRegImages() == 0) {
-    const Status init_status =
-        IncrementalMapperController::InitializeReconstruction(
-            mapper, mapper_options, *reconstruction);
+    Status init_status;
+    do {
+      init_status = IncrementalMapperController::InitializeReconstruction(
+          mapper, mapper_options, *reconstruction);
+    } while (init_status == Status::NO_INITIAL_PAIR &&
+             options_->stream_new_images && WaitForNewImages(mapper));
     if (init_status != Status::SUCCESS) {
       return init_status;
     }
   }
-  Callback(INITIAL_IMAGE_PAIR_REG_CALLBACK);
+  SynchronizedCallback(INITIAL_IMAGE_PAIR_REG_CALLBACK);
 
   ////////////////////////////////////////////////////////////////////////////
   // Incremental mapping
   ////////////////////////////////////////////////////////////////////////////
 
-  size_t snapshot_prev_num_reg_images = reconstruction->NumRegImages();
-  size_t ba_prev_num_reg_images = reconstruction->NumRegImages();
-  size_t ba_prev_num_points = reconstruction->NumPoints3D();
+  // Checkpoints are only written for sub-models that are reconstructed one
+  // after another, since the progress of concurrent sub-models is not shared.
+  const bool write_checkpoints =
+      !options_->checkpoint_path.empty() && mapper.ImageRegistry() == nullptr;
+  size_t checkpoint_prev_num_reg_images = reconstruction->NumRegImages();
 
   bool reg_next_success = true;
   bool prev_reg_next_success = true;
@@ -365,52 +827,40 @@ IncrementalMapperController::ReconstructSubModel(
         mapper.FindNextImages(mapper_options);
 
     if (next_images.empty()) {
-      break;
-    }
-
-    image_t next_image_id;
-    for (size_t reg_trial = 0; reg_trial < next_images.size(); ++reg_trial) {
-      next_image_id = next_images[reg_trial];
-
-      LOG(INFO) << StringPrintf("Registering image #%d (%d)",
-                                next_image_id,
-                                reconstruction->NumRegImages() + 1);
-      LOG(INFO) << StringPrintf(
-          "=> Image sees %d / %d points",
-          mapper.ObservationManager().NumVisiblePoints3D(next_image_id),
-          mapper.ObservationManager().NumObservations(next_image_id));
-
-      reg_next_success =
-          mapper.RegisterNextImage(mapper_options, next_image_id);
-
-      if (reg_next_success) {
-        break;
-      } else {
-        LOG(INFO) << "=> Could not register, trying another image.";
-
-        // If initial pair fails to continue for some time,
-        // abort and try different initial pair.
-        const size_t kMinNumInitialRegTrials = 30;
-        if (reg_trial >= kMinNumInitialRegTrials &&
-            reconstruction->NumRegImages() <
-                static_cast<size_t>(options_->min_model_size)) {
-          break;
-        }
+      if (options_->stream_new_images && WaitForNewImages(mapper)) {
+        reg_next_success = true;
+        continue;
       }
+      break;
     }
 
-    if (reg_next_success) {
+    auto PostProcessNextImage = [&](const image_t next_image_id) {
       mapper.TriangulateImage(options_->Triangulation(), next_image_id);
       mapper.IterativeLocalRefinement(options_->ba_local_max_refinements,
                                       options_->ba_local_max_refinement_change,
                                       mapper_options,
-                                      options_->LocalBundleAdjustment(),
+                                      LocalBundleAdjustment(),
                                       options_->Triangulation(),
                                       next_image_id);
 
-      if (CheckRunGlobalRefinement(
-              *reconstruction, ba_prev_num_reg_images, ba_prev_num_points)) {
-        IterativeGlobalRefinement(*options_, mapper_options, mapper);
+      // If the drift is confined to a small region of the model, only this
+      // region is adjusted and the regular global refinement still follows
+      // the growth frequencies.
+      const bool drift_exceeded =
+          options_->ba_global_max_drift > 0 &&
+          mapper.LocalBundleDrift() >= options_->ba_global_max_drift;
+      if (drift_exceeded &&
+          mapper.LocalBundleDriftImageIds().size() <=
+              options_->ba_global_partial_max_images_ratio *
+                  reconstruction->NumRegImages()) {
+        PartialGlobalRefinement(
+            mapper_options, GlobalBundleAdjustment(), mapper);
+      } else if (drift_exceeded ||
+                 CheckRunGlobalRefinement(*reconstruction,
+                                          ba_prev_num_reg_images,
+                                          ba_prev_num_points)) {
+        IterativeGlobalRefinement(
+            *options_, mapper_options, GlobalBundleAdjustment(), mapper);
         ba_prev_num_points = reconstruction->NumPoints3D();
         ba_prev_num_reg_images = reconstruction->NumRegImages();
       }
@@ -426,7 +876,103 @@ IncrementalMapperController::ReconstructSubModel(
         WriteSnapshot(*reconstruction, options_->snapshot_path);
       }
 
-      Callback(NEXT_IMAGE_REG_CALLBACK);
+      if (write_checkpoints &&
+          reconstruction->NumRegImages() >=
+              options_->checkpoint_images_freq +
+                  checkpoint_prev_num_reg_images) {
+        checkpoint_prev_num_reg_images = reconstruction->NumRegImages();
+        progress_.in_progress = true;
+        progress_.snapshot_prev_num_reg_images = snapshot_prev_num_reg_images;
+        progress_.ba_prev_num_reg_images = ba_prev_num_reg_images;
+        progress_.ba_prev_num_points = ba_prev_num_points;
+        WriteCheckpoint(mapper);
+      }
+
+      SynchronizedCallback(NEXT_IMAGE_REG_CALLBACK);
+    };
+
+    // The poses of a batch of candidate images are estimated in parallel
+    // against the current model and then registered one after another. Each
+    // estimate is re-validated against the model updated by the previous
+    // registrations of the batch.
+    const size_t num_parallel_reg_images =
+        static_cast<size_t>(options_->num_parallel_reg_images);
+    bool abort_reg_trials = false;
+    for (size_t batch_begin = 0;
+         batch_begin < next_images.size() && !reg_next_success &&
+         !abort_reg_trials;
+         batch_begin += num_parallel_reg_images) {
+      const size_t batch_end = std::min(
+          next_images.size(), batch_begin + num_parallel_reg_images);
+      const std::vector<image_t> batch_image_ids(
+          next_images.begin() + batch_begin, next_images.begin() + batch_end);
+
+      // The images of rig snapshots are registered jointly with the other
+      // images of their snapshot and their poses are not estimated up front.
+      std::vector<IncrementalMapper::NextImagePose> next_image_poses;
+      if (batch_image_ids.size() > 1 && mapper.CameraRigs().empty()) {
+        next_image_poses =
+            mapper.EstimateNextImagePoses(mapper_options, batch_image_ids);
+      }
+
+      for (size_t batch_idx = 0; batch_idx < batch_image_ids.size();
+           ++batch_idx) {
+        const size_t reg_trial = batch_begin + batch_idx;
+        const image_t next_image_id = batch_image_ids[batch_idx];
+
+        LOG(INFO) << StringPrintf("Registering image #%d (%d)",
+                                  next_image_id,
+                                  reconstruction->NumRegImages() + 1);
+        LOG(INFO) << StringPrintf(
+            "=> Image sees %d / %d points",
+            mapper.ObservationManager().NumVisiblePoints3D(next_image_id),
+            mapper.ObservationManager().NumObservations(next_image_id));
+
+        // Images of earlier snapshots in the batch may have been registered.
+        if (reconstruction->Image(next_image_id).IsRegistered()) {
+          continue;
+        }
+
+        std::vector<image_t> reg_image_ids;
+        bool success = false;
+        if (mapper.IsRigSnapshotImage(next_image_id)) {
+          success = mapper.RegisterNextRigSnapshot(
+              mapper_options, next_image_id, &reg_image_ids);
+        } else {
+          success =
+              next_image_poses.empty()
+                  ? mapper.RegisterNextImage(mapper_options, next_image_id)
+                  : mapper.RegisterNextImage(mapper_options,
+                                             next_image_poses[batch_idx]);
+          if (success) {
+            reg_image_ids.push_back(next_image_id);
+          }
+        }
+
+        if (success) {
+          static MetricCounter* num_registered_images =
+              MetricsRegistry::Instance().Counter(
+                  "colmap_mapper_registered_images_total",
+                  "Number of registered next images");
+          num_registered_images->Increment(reg_image_ids.size());
+          reg_next_success = true;
+          for (const image_t reg_image_id : reg_image_ids) {
+            PostProcessNextImage(reg_image_id);
+          }
+        } else {
+          LOG(INFO) << "=> Could not register, trying another image.";
+
+          // If initial pair fails to continue for some time,
+          // abort and try different initial pair.
+          const size_t kMinNumInitialRegTrials = 30;
+          if (!reg_next_success && reg_trial >= kMinNumInitialRegTrials &&
+              reconstruction->NumRegImages() <
+                  static_cast<size_t>(options_->min_model_size)) {
+            abort_reg_trials = true;
+            break;
+          }
+        }
+      }
     }
 
     const size_t max_model_overlap =
@@ -439,9 +985,11 @@ IncrementalMapperController::ReconstructSubModel(
     // bundle adjustment and try again to register one image. If this fails
     // once, then exit the incremental mapping.
     if (!reg_next_success && prev_reg_next_success) {
-      IterativeGlobalRefinement(*options_, mapper_options, mapper);
+      IterativeGlobalRefinement(
+          *options_, mapper_options, GlobalBundleAdjustment(), mapper);
     }
-  } while (reg_next_success || prev_reg_next_success);
+  } while (reg_next_success || prev_reg_next_success ||
+           (options_->stream_new_images && WaitForNewImages(mapper)));
 
   if (CheckIfStopped()) {
     return Status::INTERRUPTED;
@@ -451,7 +999,8 @@ IncrementalMapperController::ReconstructSubModel(
   if (reconstruction->NumRegImages() >= 2 &&
       reconstruction->NumRegImages() != ba_prev_num_reg_images &&
       reconstruction->NumPoints3D() != ba_prev_num_points) {
-    IterativeGlobalRefinement(*options_, mapper_options, mapper);
+    IterativeGlobalRefinement(
+        *options_, mapper_options, GlobalBundleAdjustment(), mapper);
   }
   return Status::SUCCESS;
 }
@@ -459,22 +1008,56 @@ IncrementalMapperController::ReconstructSubModel(
 void IncrementalMapperController::Reconstruct(
     const IncrementalMapper::Options& mapper_options) {
   IncrementalMapper mapper(database_cache_);
+  mapper.SetCameraRigs(camera_rigs_);
 
   // Is there a sub-model before we start the reconstruction? I.e. the user
-  // has imported an existing reconstruction.
-  const bool initial_reconstruction_given = reconstruction_manager_->Size() > 0;
-  THROW_CHECK_LE(reconstruction_manager_->Size(), 1)
-      << "Can only resume from a "
-         "single reconstruction, but "
-         "multiple are given.";
-
-  for (int num_trials = 0; num_trials < options_->init_num_trials;
+  // has imported an existing reconstruction. When resuming from a checkpoint,
+  // the reconstructions of the checkpoint are given instead.
+  int first_trial = 0;
+  bool initial_reconstruction_given = reconstruction_manager_->Size() > 0;
+  bool resume_reconstruction = false;
+  if (resume_checkpoint_) {
+    initial_reconstruction_given =
+        resume_checkpoint_->initial_reconstruction_given;
+    first_trial = resume_checkpoint_->num_trials;
+    if (resume_checkpoint_->trials_finished) {
+      resume_checkpoint_.reset();
+      return;
+    }
+    resume_reconstruction = resume_checkpoint_->in_progress;
+    if (!resume_reconstruction) {
+      mapper.SetState(resume_checkpoint_->mapper_state);
+      resume_checkpoint_.reset();
+    }
+  } else {
+    THROW_CHECK_LE(reconstruction_manager_->Size(), 1)
+        << "Can only resume from a "
+           "single reconstruction, but "
+           "multiple are given.";
+  }
+  progress_.initial_reconstruction_given = initial_reconstruction_given;
+
+  // The database cache is only extended by new images, while it is not used
+  // by concurrent sub-models.
+  if (options_->num_parallel_models > 1 && options_->multiple_models &&
+      !options_->stream_new_images && !initial_reconstruction_given &&
+      first_trial == 0 && options_->init_image_id1 == -1 &&
+      options_->init_image_id2 == -1) {
+    ReconstructParallel(mapper_options);
+    return;
+  }
+
+  for (int num_trials = first_trial; num_trials < options_->init_num_trials;
        ++num_trials) {
     if (CheckIfStopped()) {
       break;
     }
+    progress_.num_trials = num_trials;
     size_t reconstruction_idx;
-    if (!initial_reconstruction_given || num_trials > 0) {
+    if (resume_reconstruction) {
+      reconstruction_idx = reconstruction_manager_->Size() - 1;
+      resume_reconstruction = false;
+    } else if (!initial_reconstruction_given || num_trials > 0) {
       reconstruction_idx = reconstruction_manager_->Add();
     } else {
       reconstruction_idx = 0;
@@ -494,8 +1077,11 @@ void IncrementalMapperController::Reconstruct(
         mapper.EndReconstruction(/*discard=*/true);
         reconstruction_manager_->Delete(reconstruction_idx);
         // If both initial images are manually specified, there is no need for
-        // further initialization trials.
-        if (options_->IsInitialPairProvided()) {
+        // further initialization trials. When streaming, no new images were
+        // added while waiting for an initial pair.
+        if (options_->IsInitialPairProvided() ||
+            (status == Status::NO_INITIAL_PAIR &&
+             options_->stream_new_images)) {
           return;
         }
         break;
@@ -510,6 +1096,10 @@ void IncrementalMapperController::Reconstruct(
         // minimum model size so that we can reconstruct small image
         // collections. Always keep the first reconstruction, independent of
         // size.
+        SetMemoryUsage("reconstruction", reconstruction->NumBytes());
+        SetMemoryUsage("database_cache", database_cache_->NumBytes());
+        LogMemoryUsage();
+
         const size_t min_model_size = std::min<size_t>(
             0.8 * database_cache_->NumImages(), options_->min_model_size);
         if ((options_->multiple_models && reconstruction_manager_->Size() > 1 &&
@@ -521,12 +1111,113 @@ void IncrementalMapperController::Reconstruct(
           mapper.EndReconstruction(/*discard=*/false);
         }
 
-        Callback(LAST_IMAGE_REG_CALLBACK);
+        SynchronizedCallback(LAST_IMAGE_REG_CALLBACK);
 
-        if (initial_reconstruction_given || !options_->multiple_models ||
+        const bool trials_finished =
+            initial_reconstruction_given || !options_->multiple_models ||
             reconstruction_manager_->Size() >=
                 static_cast<size_t>(options_->max_num_models) ||
-            total_num_reg_images >= database_cache_->NumImages() - 1) {
+            total_num_reg_images >= database_cache_->NumImages() - 1;
+
+        if (!options_->checkpoint_path.empty()) {
+          progress_.num_trials = num_trials + 1;
+          progress_.in_progress = false;
+          progress_.trials_finished = trials_finished;
+          WriteCheckpoint(mapper);
+          progress_.trials_finished = false;
+        }
+
+        if (trials_finished) {
+          return;
+        }
+      } break;
+
+      default:
+        LOG(FATAL_THROW) << "Unknown reconstruction status.";
+    }
+  }
+}
+
+void IncrementalMapperController::ReconstructParallel(
+    const IncrementalMapper::Options& mapper_options) {
+  auto image_registry =
+      std::make_shared<IncrementalMapperImageRegistry>(*database_cache_);
+  std::atomic<int> num_trials(0);
+
+  ThreadPool thread_pool(options_->num_parallel_models);
+  std::vector<std::future<void>> futures;
+  futures.reserve(thread_pool.NumThreads());
+  for (size_t i = 0; i < thread_pool.NumThreads(); ++i) {
+    futures.push_back(thread_pool.AddTask([&]() {
+      ReconstructParallelModels(mapper_options, image_registry, &num_trials);
+    }));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+void IncrementalMapperController::ReconstructParallelModels(
+    const IncrementalMapper::Options& mapper_options,
+    const std::shared_ptr<IncrementalMapperImageRegistry>& image_registry,
+    std::atomic<int>* num_trials) {
+  IncrementalMapper mapper(database_cache_);
+  mapper.SetImageRegistry(image_registry);
+  mapper.SetCameraRigs(camera_rigs_);
+
+  const size_t max_num_models = static_cast<size_t>(options_->max_num_models);
+  const size_t min_model_size = std::min<size_t>(
+      0.8 * database_cache_->NumImages(), options_->min_model_size);
+
+  while ((*num_trials)++ < options_->init_num_trials) {
+    if (CheckIfStopped()) {
+      break;
+    }
+
+    std::shared_ptr<Reconstruction> reconstruction;
+    {
+      std::lock_guard<std::mutex> lock(reconstruction_manager_mutex_);
+      if (reconstruction_manager_->Size() >= max_num_models) {
+        break;
+      }
+      reconstruction =
+          reconstruction_manager_->Get(reconstruction_manager_->Add());
+    }
+
+    const Status status =
+        ReconstructSubModel(mapper, mapper_options, reconstruction);
+    switch (status) {
+      case Status::INTERRUPTED:
+        mapper.EndReconstruction(/*discard=*/false);
+        return;
+
+      case Status::NO_INITIAL_PAIR:
+      case Status::BAD_INITIAL_PAIR:
+        mapper.EndReconstruction(/*discard=*/true);
+        DeleteReconstruction(reconstruction);
+        break;
+
+      case Status::SUCCESS: {
+        // Always keep the first reconstruction, independent of size, as in
+        // the sequential case.
+        bool is_only_reconstruction;
+        {
+          std::lock_guard<std::mutex> lock(reconstruction_manager_mutex_);
+          is_only_reconstruction = reconstruction_manager_->Size() == 1;
+        }
+        if ((!is_only_reconstruction &&
+             reconstruction->NumRegImages() < min_model_size) ||
+            reconstruction->NumRegImages() == 0) {
+          mapper.EndReconstruction(/*discard=*/true);
+          DeleteReconstruction(reconstruction);
+        } else {
+          mapper.EndReconstruction(/*discard=*/false);
+        }
+
+        SynchronizedCallback(LAST_IMAGE_REG_CALLBACK);
+
+        if (image_registry->NumClaimedImages() >=
+            database_cache_->NumImages() - 1) {
           return;
         }
       } break;
@@ -537,40 +1228,251 @@ void IncrementalMapperController::Reconstruct(
   }
 }
 
+void IncrementalMapperController::DeleteReconstruction(
+    const std::shared_ptr<Reconstruction>& reconstruction) {
+  std::lock_guard<std::mutex> lock(reconstruction_manager_mutex_);
+  for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+    if (reconstruction_manager_->Get(i) == reconstruction) {
+      reconstruction_manager_->Delete(i);
+      return;
+    }
+  }
+}
+
+void IncrementalMapperController::WriteCheckpoint(
+    const IncrementalMapper& mapper) {
+  // The reconstructions are copied, such that the mapper can continue, while
+  // they are written in the background.
+  std::vector<Reconstruction> reconstructions;
+  reconstructions.reserve(reconstruction_manager_->Size());
+  for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+    reconstructions.push_back(*reconstruction_manager_->Get(i));
+  }
+  Checkpoint checkpoint = progress_;
+  checkpoint.mapper_state = mapper.GetState();
+
+  WaitForCheckpoint();
+  if (checkpoint_thread_pool_ == nullptr) {
+    checkpoint_thread_pool_ = std::make_unique<ThreadPool>(1);
+  }
+
+  const std::string checkpoint_name = StringPrintf("%010d", checkpoint_idx_++);
+  checkpoint_future_ = checkpoint_thread_pool_->AddTask(
+      [checkpoint_path = options_->checkpoint_path,
+       checkpoint_name,
+       reconstructions = std::move(reconstructions),
+       checkpoint = std::move(checkpoint)]() {
+        Timer timer;
+        timer.Start();
+
+        const std::string path = JoinPaths(checkpoint_path, checkpoint_name);
+        CreateDirIfNotExists(path);
+        for (size_t i = 0; i < reconstructions.size(); ++i) {
+          const std::string reconstruction_path =
+              JoinPaths(path, std::to_string(i));
+          CreateDirIfNotExists(reconstruction_path);
+          reconstructions[i].WriteBinary(reconstruction_path);
+        }
+
+        {
+          const std::string state_path =
+              JoinPaths(path, kCheckpointStateFileName);
+          std::ofstream file(state_path, std::ios::trunc | std::ios::binary);
+          THROW_CHECK_FILE_OPEN(file, state_path);
+          WriteBinaryLittleEndian<int32_t>(&file,
+                                           checkpoint.num_init_relaxations);
+          WriteBinaryLittleEndian<int32_t>(&file, checkpoint.num_trials);
+          WriteBinaryLittleEndian<uint8_t>(
+              &file, checkpoint.initial_reconstruction_given);
+          WriteBinaryLittleEndian<uint8_t>(&file, checkpoint.in_progress);
+          WriteBinaryLittleEndian<uint8_t>(&file, checkpoint.trials_finished);
+          WriteBinaryLittleEndian<uint64_t>(&file, reconstructions.size());
+          WriteBinaryLittleEndian<uint64_t>(
+              &file, checkpoint.snapshot_prev_num_reg_images);
+          WriteBinaryLittleEndian<uint64_t>(&file,
+                                            checkpoint.ba_prev_num_reg_images);
+          WriteBinaryLittleEndian<uint64_t>(&file,
+                                            checkpoint.ba_prev_num_points);
+          WriteMapperState(&file, checkpoint.mapper_state);
+        }
+
+        const std::string latest_path =
+            JoinPaths(checkpoint_path, kLatestCheckpointFileName);
+        std::string prev_checkpoint_name;
+        if (ExistsFile(latest_path)) {
+          std::ifstream file(latest_path);
+          std::getline(file, prev_checkpoint_name);
+        }
+
+        {
+          const std::string tmp_latest_path = latest_path + ".tmp";
+          std::ofstream file(tmp_latest_path, std::ios::trunc);
+          THROW_CHECK_FILE_OPEN(file, tmp_latest_path);
+          file << checkpoint_name << std::endl;
+        }
+        RenameFile(latest_path + ".tmp", latest_path);
+
+        if (!prev_checkpoint_name.empty() &&
+            prev_checkpoint_name != checkpoint_name) {
+          boost::filesystem::remove_all(
+              JoinPaths(checkpoint_path, prev_checkpoint_name));
+        }
+
+        VLOG(1) << StringPrintf("Wrote checkpoint %s in %.3fs",
+                                checkpoint_name.c_str(),
+                                timer.ElapsedSeconds());
+      });
+}
+
+bool IncrementalMapperController::ReadLatestCheckpoint() {
+  const std::string latest_path =
+      JoinPaths(options_->checkpoint_path, kLatestCheckpointFileName);
+  if (!ExistsFile(latest_path)) {
+    return false;
+  }
+
+  std::string checkpoint_name;
+  {
+    std::ifstream file(latest_path);
+    std::getline(file, checkpoint_name);
+  }
+  const std::string path =
+      JoinPaths(options_->checkpoint_path, checkpoint_name);
+  const std::string state_path = JoinPaths(path, kCheckpointStateFileName);
+  if (checkpoint_name.empty() || !ExistsFile(state_path)) {
+    LOG(WARNING) << "Ignoring incomplete checkpoint in "
+                 << options_->checkpoint_path;
+    return false;
+  }
+
+  LOG(INFO) << "Resuming from checkpoint " << path;
+
+  auto checkpoint = std::make_unique<Checkpoint>();
+  size_t num_reconstructions = 0;
+  {
+    std::ifstream file(state_path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, state_path);
+    checkpoint->num_init_relaxations = ReadBinaryLittleEndian<int32_t>(&file);
+    checkpoint->num_trials = ReadBinaryLittleEndian<int32_t>(&file);
+    checkpoint->initial_reconstruction_given =
+        ReadBinaryLittleEndian<uint8_t>(&file) != 0;
+    checkpoint->in_progress = ReadBinaryLittleEndian<uint8_t>(&file) != 0;
+    checkpoint->trials_finished = ReadBinaryLittleEndian<uint8_t>(&file) != 0;
+    num_reconstructions = ReadBinaryLittleEndian<uint64_t>(&file);
+    checkpoint->snapshot_prev_num_reg_images =
+        ReadBinaryLittleEndian<uint64_t>(&file);
+    checkpoint->ba_prev_num_reg_images =
+        ReadBinaryLittleEndian<uint64_t>(&file);
+    checkpoint->ba_prev_num_points = ReadBinaryLittleEndian<uint64_t>(&file);
+    checkpoint->mapper_state = ReadMapperState(&file);
+  }
+
+  if (reconstruction_manager_->Size() > 0) {
+    LOG(WARNING) << "Replacing the given reconstructions by the checkpoint";
+    reconstruction_manager_->Clear();
+  }
+  for (size_t i = 0; i < num_reconstructions; ++i) {
+    reconstruction_manager_->Read(JoinPaths(path, std::to_string(i)));
+  }
+
+  // Continue numbering after the latest checkpoint, which is only replaced
+  // once the next checkpoint is complete.
+  checkpoint_idx_ = std::stoull(checkpoint_name) + 1;
+  resume_checkpoint_ = std::move(checkpoint);
+  return true;
+}
+
+void IncrementalMapperController::WaitForCheckpoint() {
+  if (checkpoint_future_.valid()) {
+    checkpoint_future_.get();
+  }
+}
+
+bool IncrementalMapperController::WaitForNewImages(IncrementalMapper& mapper) {
+  LOG(INFO) << "Waiting for new images";
+  Timer timer;
+  timer.Start();
+  while (!CheckIfStopped()) {
+    // Check for completion before polling, such that the images written right
+    // before the input finished are not missed.
+    const bool is_input_finished =
+        check_if_input_finished_fn_ && check_if_input_finished_fn_();
+    std::vector<image_t> new_image_ids;
+    {
+      Database database(database_path_);
+      new_image_ids = database_cache_->AddNewImages(
+          database,
+          static_cast<size_t>(options_->min_num_matches),
+          options_->ignore_watermarks,
+          options_->image_names);
+    }
+    if (!new_image_ids.empty()) {
+      LOG(INFO) << StringPrintf("=> Added %d new images",
+                                new_image_ids.size());
+      mapper.AddImages(new_image_ids);
+      return true;
+    }
+    if (is_input_finished) {
+      LOG(INFO) << "=> Input finished.";
+      return false;
+    }
+    if (options_->stream_max_idle_time > 0 &&
+        timer.ElapsedSeconds() >= options_->stream_max_idle_time) {
+      LOG(INFO) << "=> No new images found.";
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        static_cast<int64_t>(1000 * options_->stream_poll_interval)));
+  }
+  return false;
+}
+
+void IncrementalMapperController::SynchronizedCallback(const int id) {
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  Callback(id);
+}
+
 void IncrementalMapperController::TriangulateReconstruction(
     const std::shared_ptr<Reconstruction>& reconstruction) {
   THROW_CHECK(LoadDatabase());
   IncrementalMapper mapper(database_cache_);
   mapper.BeginReconstruction(reconstruction);
 
-  LOG(INFO) << "Iterative triangulation";
   const std::vector<image_t>& reg_image_ids = reconstruction->RegImageIds();
-  for (size_t i = 0; i < reg_image_ids.size(); ++i) {
-    const image_t image_id = reg_image_ids[i];
-    const auto& image = reconstruction->Image(image_id);
+  if (options_->tri_partition_max_num_images > 0 &&
+      reg_image_ids.size() >
+          static_cast<size_t>(options_->tri_partition_max_num_images)) {
+    LOG(INFO) << "Partitioned triangulation";
+    TriangulatePartitions(*options_, database_path_, *reconstruction, mapper);
+  } else {
+    LOG(INFO) << "Iterative triangulation";
+    for (size_t i = 0; i < reg_image_ids.size(); ++i) {
+      const image_t image_id = reg_image_ids[i];
+      const auto& image = reconstruction->Image(image_id);
 
-    LOG(INFO) << StringPrintf("Triangulating image #%d (%d)", image_id, i);
-    const size_t num_existing_points3D = image.NumPoints3D();
-    LOG(INFO) << "=> Image sees " << num_existing_points3D << " / "
-              << mapper.ObservationManager().NumObservations(image_id)
-              << " points";
+      LOG(INFO) << StringPrintf("Triangulating image #%d (%d)", image_id, i);
+      const size_t num_existing_points3D = image.NumPoints3D();
+      LOG(INFO) << "=> Image sees " << num_existing_points3D << " / "
+                << mapper.ObservationManager().NumObservations(image_id)
+                << " points";
 
-    mapper.TriangulateImage(options_->Triangulation(), image_id);
-    VLOG(1) << "=> Triangulated "
-            << (image.NumPoints3D() - num_existing_points3D) << " points";
+      mapper.TriangulateImage(options_->Triangulation(), image_id);
+      VLOG(1) << "=> Triangulated "
+              << (image.NumPoints3D() - num_existing_points3D) << " points";
+    }
   }
 
   LOG(INFO) << "Retriangulation and Global bundle adjustment";
   mapper.IterativeGlobalRefinement(options_->ba_global_max_refinements,
                                    options_->ba_global_max_refinement_change,
                                    options_->Mapper(),
-                                   options_->GlobalBundleAdjustment(),
+                                   GlobalBundleAdjustment(),
                                    options_->Triangulation(),
                                    /*normalize_reconstruction=*/false);
   mapper.EndReconstruction(/*discard=*/false);
 
   LOG(INFO) << "Extracting colors";
-  reconstruction->ExtractColorsForAllImages(image_path_);
+  reconstruction->ExtractColorsForAllImages(image_path_, options_->num_threads);
 }
 
 }  // namespace colmap
@@ -32,6 +32,14 @@
 #include "colmap/scene/reconstruction_manager.h"
 #include "colmap/sfm/incremental_mapper.h"
 #include "colmap/util/base_controller.h"
+#include "colmap/util/threading.h"
+
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace colmap {
 
@@ -42,6 +50,30 @@ struct IncrementalMapperOptions {
   // Whether to ignore the inlier matches of watermark image pairs.
   bool ignore_watermarks = false;
 
+  // Whether to load the 2D points of an image from the database only once the
+  // reconstruction first tries to register it or one of its neighbors. This
+  // reduces the memory usage for large collections, of which only a subset of
+  // the images can be registered.
+  bool lazy_load_points2D = false;
+
+  // The maximum memory in gigabytes of lazily loaded 2D points that are kept in
+  // memory by the database cache, in addition to the points in the
+  // reconstruction.
+  double lazy_points2D_cache_size = 1.0;
+
+  // Whether to keep the 2D points of the images that are not part of the
+  // reconstruction in a compact single-precision array in the database cache,
+  // which uses a third of the memory of the eager cache without reading the
+  // database again. Ignored if the 2D points are loaded lazily.
+  bool compact_points2D = false;
+
+  // Whether to precompute the feature tracks of all verified matches after
+  // loading the database, such that the triangulation looks up the tracks
+  // instead of searching transitive correspondences. Only takes effect with a
+  // triangulation transitivity above one, in which case the transitivity of
+  // conflict-free tracks is no longer limited.
+  bool precompute_tracks = false;
+
   // Whether to reconstruct multiple sub-models.
   bool multiple_models = true;
 
@@ -67,6 +99,24 @@ struct IncrementalMapperOptions {
   // The number of trials to initialize the reconstruction.
   int init_num_trials = 200;
 
+  // The number of sub-models that are reconstructed concurrently, if multiple
+  // models are reconstructed from scratch without given initial images. The
+  // concurrent sub-models start from disjoint initial pairs and never share
+  // any registered images, i.e., there is no overlap between them.
+  int num_parallel_models = 1;
+
+  // The number of next image candidates whose poses are estimated in
+  // parallel before they are registered one after another. A value of 1
+  // registers the candidates strictly sequentially.
+  int num_parallel_reg_images = 1;
+
+  // The maximum number of images per partition when triangulating a
+  // reconstruction with fixed poses. If positive and exceeded by the number
+  // of registered images, the images are partitioned into overlapping
+  // clusters with many shared matches, which are triangulated in parallel
+  // before their tracks are merged.
+  int tri_partition_max_num_images = 0;
+
   // Whether to extract colors for reconstructed points.
   bool extract_colors = true;
 
@@ -87,6 +137,24 @@ struct IncrementalMapperOptions {
   // enable multi-threading solving of the problems.
   int ba_min_num_residuals_for_multi_threading = 50000;
 
+  // Whether to use the GPU for the global bundle adjustment, if Ceres was
+  // built with CUDA support, and the minimum number of images to do so.
+  bool ba_use_gpu = false;
+  std::string ba_gpu_index = "-1";
+  int ba_min_num_images_gpu_solver = 50;
+
+  // Whether to evaluate the reprojection Jacobians in single precision.
+  bool ba_use_float_jacobians = false;
+
+  // Whether to marginalize the points only observed by constant camera poses
+  // in the global bundle adjustment, e.g., with fixed existing images.
+  bool ba_global_marginalize_constant_pose_points = false;
+
+  // Whether to reject the observations exceeding `filter_max_reproj_error`
+  // during the global bundle adjustment solve. The iterative refinement then
+  // performs a single adjustment instead of repeated adjustments and filtering.
+  bool ba_global_reject_outliers_in_solver = false;
+
   // The number of images to optimize in local bundle adjustment.
   int ba_local_num_images = 6;
 
@@ -102,6 +170,18 @@ struct IncrementalMapperOptions {
   int ba_global_images_freq = 500;
   int ba_global_points_freq = 250000;
 
+  // The accumulated drift in pixels of the local bundle adjustments, after
+  // which to perform global bundle adjustment. If positive, global bundle
+  // adjustment is scheduled by the drift instead of the growth ratios, while
+  // the growth frequencies still apply. The drift is measured as the mean
+  // displacement of the projected observations by each local adjustment.
+  double ba_global_max_drift = 0.0;
+
+  // If the images adjusted by the drifted local bundle adjustments are at
+  // most this fraction of the registered images, only these images are
+  // adjusted in a partial global bundle adjustment.
+  double ba_global_partial_max_images_ratio = 0.5;
+
   // Ceres solver function tolerance for global bundle adjustment
   double ba_global_function_tolerance = 0.0;
 
@@ -120,6 +200,19 @@ struct IncrementalMapperOptions {
   std::string snapshot_path = "";
   int snapshot_images_freq = 0;
 
+  // Path to a folder in which checkpoints of the reconstructions and of the
+  // mapper state are written in the background, whenever the specified number
+  // of images were registered and whenever a sub-model is finished. If the
+  // folder contains a checkpoint, the reconstruction resumes from the latest
+  // checkpoint instead of starting from scratch. No checkpoints are written
+  // while reconstructing multiple sub-models in parallel.
+  std::string checkpoint_path = "";
+  int checkpoint_images_freq = 100;
+
+  // Path to a file to which the telemetry of every bundle adjustment during
+  // the reconstruction is appended as one line of JSON, if not empty.
+  std::string ba_telemetry_path = "";
+
   // Which images to reconstruct. If no images are specified, all images will
   // be reconstructed by default.
   std::unordered_set<std::string> image_names;
@@ -127,6 +220,21 @@ struct IncrementalMapperOptions {
   // If reconstruction is provided as input, fix the existing image poses.
   bool fix_existing_images = false;
 
+  // Whether to wait for new images, once no more images can be registered,
+  // e.g., while the features of further images are extracted and matched
+  // concurrently. The images with matches that are written to the database in
+  // the meantime are added to the current reconstruction and registered as
+  // usual without reloading the database or the reconstruction.
+  bool stream_new_images = false;
+
+  // The interval in seconds at which the database is polled for new images.
+  double stream_poll_interval = 1.0;
+
+  // The maximum time in seconds to wait for new images, after which the
+  // reconstruction is finished. If not positive, the controller waits for new
+  // images until it is stopped.
+  double stream_max_idle_time = 60.0;
+
   IncrementalMapper::Options mapper;
   IncrementalTriangulator::Options triangulation;
 
@@ -154,6 +262,19 @@ class IncrementalMapperController : public BaseController {
 
   enum class Status { NO_INITIAL_PAIR, BAD_INITIAL_PAIR, SUCCESS, INTERRUPTED };
 
+  // Accumulated telemetry of the bundle adjustments with the same label.
+  struct BundleAdjustmentTotals {
+    size_t num_adjustments = 0;
+    size_t num_iterations = 0;
+    size_t num_residuals = 0;
+    double setup_time = 0;
+    double jacobian_evaluation_time = 0;
+    double linear_solver_time = 0;
+    double total_time = 0;
+
+    void Add(const BundleAdjustmentTelemetry& telemetry);
+  };
+
   IncrementalMapperController(
       std::shared_ptr<const IncrementalMapperOptions> options,
       const std::string& image_path,
@@ -167,6 +288,21 @@ class IncrementalMapperController : public BaseController {
 
   bool LoadDatabase();
 
+  // Use an already loaded database cache, e.g., a subset of a cache shared
+  // with other controllers, instead of loading it from the database in Run.
+  void SetDatabaseCache(std::shared_ptr<class DatabaseCache> database_cache);
+
+  // When streaming new images, the function is polled to check whether no
+  // more images will be written to the database, e.g., by a concurrent
+  // matcher, such that the reconstruction finishes without waiting for the
+  // maximum idle time.
+  void SetCheckIfInputFinishedFunc(std::function<bool()> func);
+
+  // Register the snapshots of the camera rigs jointly, see
+  // `IncrementalMapper::RegisterNextRigSnapshot`. The relative poses of the
+  // cameras in the rigs must be known.
+  void SetCameraRigs(std::vector<CameraRig> camera_rigs);
+
   // getter functions for python pipelines
   const std::string& ImagePath() const { return image_path_; }
   const std::string& DatabasePath() const { return database_path_; }
@@ -197,12 +333,85 @@ class IncrementalMapperController : public BaseController {
                                 size_t ba_prev_num_reg_images,
                                 size_t ba_prev_num_points);
 
+  // The accumulated telemetry of the bundle adjustments by their label, i.e.,
+  // "local" and "global", since the start of the last call to `Run`.
+  std::map<std::string, BundleAdjustmentTotals> BundleAdjustmentTotalsByLabel()
+      const;
+
  private:
+  // The bundle adjustment options that report their telemetry.
+  BundleAdjustmentOptions LocalBundleAdjustment();
+  BundleAdjustmentOptions GlobalBundleAdjustment();
+  void RecordBundleAdjustment(const BundleAdjustmentTelemetry& telemetry);
+
+  // Reconstruct sub-models concurrently on multiple threads, which claim their
+  // images in a shared registry.
+  void ReconstructParallel(const IncrementalMapper::Options& mapper_options);
+  void ReconstructParallelModels(
+      const IncrementalMapper::Options& mapper_options,
+      const std::shared_ptr<IncrementalMapperImageRegistry>& image_registry,
+      std::atomic<int>* num_trials);
+
+  // Delete a reconstruction from the manager, whose index might have changed
+  // due to concurrent sub-models.
+  void DeleteReconstruction(
+      const std::shared_ptr<Reconstruction>& reconstruction);
+
+  // Invoke the callbacks one at a time, also for concurrent sub-models.
+  void SynchronizedCallback(int id);
+
+  // The progress of the reconstruction, which is written to checkpoints
+  // together with the reconstructions and the state of the mapper.
+  struct Checkpoint {
+    // The number of relaxations of the initialization constraints.
+    int num_init_relaxations = 0;
+    // The initialization trial, in which to continue.
+    int num_trials = 0;
+    bool initial_reconstruction_given = false;
+    // Whether the last reconstruction is not finished yet.
+    bool in_progress = false;
+    // Whether all trials with the current initialization constraints are done.
+    bool trials_finished = false;
+    size_t snapshot_prev_num_reg_images = 0;
+    size_t ba_prev_num_reg_images = 0;
+    size_t ba_prev_num_points = 0;
+    IncrementalMapper::State mapper_state;
+  };
+
+  // Write the current reconstructions and the progress to a new checkpoint in
+  // the background, once the previous checkpoint was written.
+  void WriteCheckpoint(const IncrementalMapper& mapper);
+
+  // Read the reconstructions and the progress of the latest checkpoint, if
+  // any, and return whether a checkpoint was read.
+  bool ReadLatestCheckpoint();
+
+  // Wait for the checkpoint that is written in the background, if any.
+  void WaitForCheckpoint();
+
+  // Poll the database for new images, until new images were added to the
+  // database cache and the current reconstruction of the mapper or until the
+  // controller is stopped, the input is finished, or the maximum idle time
+  // elapsed.
+  bool WaitForNewImages(IncrementalMapper& mapper);
+
   const std::shared_ptr<const IncrementalMapperOptions> options_;
   const std::string image_path_;
   const std::string database_path_;
   std::shared_ptr<class ReconstructionManager> reconstruction_manager_;
   std::shared_ptr<class DatabaseCache> database_cache_;
+  std::function<bool()> check_if_input_finished_fn_;
+  std::vector<CameraRig> camera_rigs_;
+  Checkpoint progress_;
+  std::unique_ptr<Checkpoint> resume_checkpoint_;
+  std::unique_ptr<ThreadPool> checkpoint_thread_pool_;
+  std::future<void> checkpoint_future_;
+  size_t checkpoint_idx_ = 0;
+  std::mutex reconstruction_manager_mutex_;
+  std::mutex callback_mutex_;
+  mutable std::mutex ba_telemetry_mutex_;
+  std::map<std::string, BundleAdjustmentTotals> ba_totals_;
+  std::ofstream ba_telemetry_file_;
 };
 
 }  // namespace colmap
@@ -31,6 +31,7 @@
 
 #include "colmap/estimators/alignment.h"
 #include "colmap/scene/synthetic.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/testing.h"
 
 #include <gtest/gtest.h>
@@ -120,6 +121,39 @@ TEST(IncrementalMapperController, WithNoise) {
                              /*num_obs_tolerance=*/0.02);
 }
 
+TEST(IncrementalMapperController, WithPositionPriors) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 10;
+  synthetic_dataset_options.num_points3D = 100;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+  for (const auto& [image_id, image] : gt_reconstruction.Images()) {
+    database.WritePosePrior(
+        image_id,
+        PosePrior(image.ProjectionCenter(),
+                  PosePrior::CoordinateSystem::CARTESIAN));
+  }
+
+  auto options = std::make_shared<IncrementalMapperOptions>();
+  options->mapper.abs_pose_use_position_prior = true;
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  IncrementalMapperController mapper(
+      options, /*image_path=*/"", database_path, reconstruction_manager);
+  mapper.Run();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+}
+
 TEST(IncrementalMapperController, MultiReconstruction) {
   const std::string database_path = CreateTestDir() + "/database.db";
 
@@ -196,5 +230,51 @@ TEST(IncrementalMapperController, ChainedMatches) {
                              /*num_obs_tolerance=*/0);
 }
 
+TEST(IncrementalMapperController, ResumeFromCheckpoint) {
+  const std::string test_dir = CreateTestDir();
+  const std::string database_path = test_dir + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 7;
+  synthetic_dataset_options.num_points3D = 50;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto options = std::make_shared<IncrementalMapperOptions>();
+  options->checkpoint_path = test_dir + "/checkpoints";
+  options->checkpoint_images_freq = 1;
+
+  // Interrupt the reconstruction after a few images were registered.
+  {
+    auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+    IncrementalMapperController mapper(
+        options, /*image_path=*/"", database_path, reconstruction_manager);
+    int num_next_image_regs = 0;
+    mapper.AddCallback(
+        IncrementalMapperController::NEXT_IMAGE_REG_CALLBACK,
+        [&num_next_image_regs]() { ++num_next_image_regs; });
+    mapper.SetCheckIfStoppedFunc(
+        [&num_next_image_regs]() { return num_next_image_regs >= 2; });
+    mapper.Run();
+  }
+
+  EXPECT_TRUE(ExistsFile(JoinPaths(options->checkpoint_path, "LATEST")));
+
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  IncrementalMapperController mapper(
+      options, /*image_path=*/"", database_path, reconstruction_manager);
+  mapper.Run();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+}
+
 }  // namespace
 }  // namespace colmap
@@ -0,0 +1,341 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/controllers/localization.h"
+
+#include "colmap/feature/utils.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/metrics.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/timer.h"
+
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/util/cuda.h"
+#endif  // COLMAP_CUDA_ENABLED
+
+#include <numeric>
+#include <unordered_set>
+
+namespace colmap {
+
+bool LocalizationOptions::Check() const {
+  CHECK_OPTION_GT(num_images, 0);
+  CHECK_OPTION_GT(num_nearest_neighbors, 0);
+  CHECK_OPTION_GT(num_checks, 0);
+  CHECK_OPTION_GT(num_matchers, 0);
+  CHECK_OPTION_GT(abs_pose_max_error, 0);
+  CHECK_OPTION_GE(abs_pose_min_num_inliers, 0);
+  CHECK_OPTION_GE(abs_pose_min_inlier_ratio, 0);
+  CHECK_OPTION_LE(abs_pose_min_inlier_ratio, 1);
+  return matching.Check();
+}
+
+Localizer::Localizer(const LocalizationOptions& options,
+                     std::shared_ptr<const Reconstruction> reconstruction,
+                     const Database& database)
+    : options_(options),
+      reconstruction_(std::move(THROW_CHECK_NOTNULL(reconstruction))) {
+  THROW_CHECK(options_.Check());
+
+  std::unordered_map<point3D_t, int> point3D_id_to_row;
+  point3D_id_to_row.reserve(reconstruction_->NumPoints3D());
+  point3D_ids_.reserve(reconstruction_->NumPoints3D());
+  for (const auto& point3D : reconstruction_->Points3D()) {
+    point3D_id_to_row.emplace(point3D.first, point3D_ids_.size());
+    point3D_ids_.push_back(point3D.first);
+  }
+
+  if (!options_.vocab_tree_path.empty()) {
+    visual_index_ = std::make_unique<retrieval::VisualIndex<>>();
+    visual_index_->Read(options_.vocab_tree_path);
+  }
+
+  retrieval::VisualIndex<>::IndexOptions index_options;
+  index_options.num_threads = options_.num_threads;
+  index_options.num_checks = options_.num_checks;
+
+  // Accumulate the descriptors of the observations of each 3D point, which
+  // are averaged and normalized below.
+  FeatureDescriptorsFloat point_descriptor_sums;
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    const Image& image = reconstruction_->Image(image_id);
+    THROW_CHECK(database.ReadDescriptorsType(image_id) ==
+                FeatureDescriptorType::SIFT)
+        << "Only SIFT descriptors can be localized: " << image.Name();
+    FeatureDescriptors descriptors = database.ReadDescriptors(image_id);
+    THROW_CHECK_EQ(descriptors.rows(), image.NumPoints2D());
+    if (point_descriptor_sums.size() == 0) {
+      point_descriptor_sums = FeatureDescriptorsFloat::Zero(
+          point3D_ids_.size(), descriptors.cols());
+    }
+    THROW_CHECK_EQ(descriptors.cols(), point_descriptor_sums.cols());
+
+    std::vector<int>& point_rows = image_point_rows_[image_id];
+    point_rows.reserve(image.NumPoints3D());
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.Point2D(point2D_idx);
+      if (point2D.HasPoint3D()) {
+        const int row = point3D_id_to_row.at(point2D.point3D_id);
+        point_descriptor_sums.row(row) +=
+            descriptors.row(point2D_idx).cast<float>();
+        point_rows.push_back(row);
+      }
+    }
+
+    if (visual_index_ != nullptr && !visual_index_->ImageIndexed(image_id)) {
+      FeatureKeypoints keypoints = database.ReadKeypoints(image_id);
+      if (options_.max_num_features > 0 &&
+          descriptors.rows() > options_.max_num_features) {
+        ExtractTopScaleFeatures(
+            &keypoints, &descriptors, options_.max_num_features);
+      }
+      visual_index_->Add(index_options, image_id, keypoints, descriptors);
+    }
+  }
+
+  L2NormalizeFeatureDescriptors(&point_descriptor_sums);
+  point_descriptors_ = std::make_shared<const FeatureDescriptors>(
+      FeatureDescriptorsToUnsignedByte(point_descriptor_sums));
+
+  if (visual_index_ != nullptr) {
+    visual_index_->Prepare();
+  }
+
+  std::vector<int> gpu_indices = CSVToVector<int>(options_.matching.gpu_index);
+  THROW_CHECK_GT(gpu_indices.size(), 0);
+#if defined(COLMAP_CUDA_ENABLED)
+  if (options_.matching.use_gpu && gpu_indices.size() == 1 &&
+      gpu_indices[0] == -1) {
+    const int num_cuda_devices = GetNumCudaDevices();
+    THROW_CHECK_GT(num_cuda_devices, 0);
+    gpu_indices.resize(num_cuda_devices);
+    std::iota(gpu_indices.begin(), gpu_indices.end(), 0);
+  }
+#endif  // COLMAP_CUDA_ENABLED
+
+  SiftMatchingOptions matching_options = options_.matching;
+  free_matchers_.reserve(options_.num_matchers);
+  for (int i = 0; i < options_.num_matchers; ++i) {
+    if (matching_options.use_gpu) {
+      matching_options.gpu_index =
+          std::to_string(gpu_indices[i % gpu_indices.size()]);
+    }
+    free_matchers_.push_back(
+        THROW_CHECK_NOTNULL(CreateSiftFeatureMatcher(matching_options)));
+  }
+
+  // Without retrieval, all queries are matched against the same descriptors,
+  // whose search index is only built once.
+  if (visual_index_ == nullptr && point_descriptors_->rows() > 0) {
+    point_descriptor_index_ =
+        free_matchers_.front()->CreateDescriptorIndex(point_descriptors_);
+  }
+
+  LOG(INFO) << StringPrintf(
+      "Localizer with %d 3D points in %d images",
+      point3D_ids_.size(),
+      image_point_rows_.size());
+}
+
+size_t Localizer::NumPoints3D() const { return point3D_ids_.size(); }
+
+std::vector<image_t> Localizer::RetrieveImages(
+    const FeatureKeypoints& keypoints,
+    const FeatureDescriptors& descriptors) const {
+  FeatureKeypoints top_keypoints = keypoints;
+  FeatureDescriptors top_descriptors = descriptors;
+  if (options_.max_num_features > 0 &&
+      top_descriptors.rows() > options_.max_num_features) {
+    ExtractTopScaleFeatures(
+        &top_keypoints, &top_descriptors, options_.max_num_features);
+  }
+
+  retrieval::VisualIndex<>::QueryOptions query_options;
+  query_options.max_num_images = options_.num_images;
+  query_options.num_neighbors = options_.num_nearest_neighbors;
+  query_options.num_checks = options_.num_checks;
+  query_options.num_threads = options_.num_threads;
+
+  std::vector<retrieval::ImageScore> image_scores;
+  visual_index_->Query(
+      query_options, top_keypoints, top_descriptors, &image_scores);
+
+  // A visual index of a previous run may contain images, which are not
+  // registered in the reconstruction.
+  std::vector<image_t> image_ids;
+  image_ids.reserve(image_scores.size());
+  for (const auto& image_score : image_scores) {
+    const image_t image_id = static_cast<image_t>(image_score.image_id);
+    if (image_point_rows_.count(image_id) > 0) {
+      image_ids.push_back(image_id);
+    }
+  }
+  return image_ids;
+}
+
+std::unique_ptr<FeatureMatcher> Localizer::AcquireMatcher() const {
+  std::unique_lock<std::mutex> lock(matchers_mutex_);
+  matchers_condition_.wait(lock, [this]() { return !free_matchers_.empty(); });
+  std::unique_ptr<FeatureMatcher> matcher = std::move(free_matchers_.back());
+  free_matchers_.pop_back();
+  return matcher;
+}
+
+void Localizer::ReleaseMatcher(std::unique_ptr<FeatureMatcher> matcher) const {
+  {
+    std::lock_guard<std::mutex> lock(matchers_mutex_);
+    free_matchers_.push_back(std::move(matcher));
+  }
+  matchers_condition_.notify_one();
+}
+
+bool Localizer::Localize(const FeatureKeypoints& keypoints,
+                         const FeatureDescriptors& descriptors,
+                         Camera* camera,
+                         LocalizationResult* result) const {
+  THROW_CHECK_NOTNULL(camera);
+  THROW_CHECK_NOTNULL(result);
+  THROW_CHECK_EQ(keypoints.size(), descriptors.rows());
+
+  Timer timer;
+  timer.Start();
+  *result = LocalizationResult();
+
+  static MetricHistogram* localization_seconds =
+      MetricsRegistry::Instance().Histogram(
+          "colmap_localization_seconds",
+          "Wall time of the localized queries",
+          ExponentialMetricBuckets(0.01, 2, 10));
+  static MetricCounter* num_failed_localizations =
+      MetricsRegistry::Instance().Counter(
+          "colmap_localization_failures_total",
+          "Number of queries that could not be localized");
+  auto Finish = [&](const bool success) {
+    result->elapsed_seconds = timer.ElapsedSeconds();
+    if (success) {
+      localization_seconds->Observe(result->elapsed_seconds);
+    } else {
+      num_failed_localizations->Increment();
+    }
+    return success;
+  };
+
+  // Gather the 3D points observed by the retrieved images.
+  std::shared_ptr<const FeatureDescriptors> candidate_descriptors;
+  std::vector<int> candidate_rows;
+  if (visual_index_ == nullptr) {
+    candidate_descriptors = point_descriptors_;
+  } else {
+    result->retrieved_image_ids = RetrieveImages(keypoints, descriptors);
+    std::unordered_set<int> candidate_rows_set;
+    for (const image_t image_id : result->retrieved_image_ids) {
+      for (const int row : image_point_rows_.at(image_id)) {
+        if (candidate_rows_set.insert(row).second) {
+          candidate_rows.push_back(row);
+        }
+      }
+    }
+    auto gathered_descriptors = std::make_shared<FeatureDescriptors>(
+        candidate_rows.size(), point_descriptors_->cols());
+    for (size_t i = 0; i < candidate_rows.size(); ++i) {
+      gathered_descriptors->row(i) = point_descriptors_->row(candidate_rows[i]);
+    }
+    candidate_descriptors = std::move(gathered_descriptors);
+  }
+
+  if (descriptors.rows() == 0 || candidate_descriptors->rows() == 0) {
+    return Finish(false);
+  }
+
+  FeatureMatches matches;
+  {
+    const auto query_descriptors =
+        std::make_shared<const FeatureDescriptors>(descriptors);
+    std::unique_ptr<FeatureMatcher> matcher = AcquireMatcher();
+    try {
+      matcher->SetDescriptorIndices(nullptr, point_descriptor_index_);
+      matcher->Match(query_descriptors, candidate_descriptors, &matches);
+    } catch (...) {
+      ReleaseMatcher(std::move(matcher));
+      throw;
+    }
+    ReleaseMatcher(std::move(matcher));
+  }
+
+  if (matches.size() <
+      static_cast<size_t>(options_.abs_pose_min_num_inliers)) {
+    return Finish(false);
+  }
+
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+  points2D.reserve(matches.size());
+  points3D.reserve(matches.size());
+  result->correspondences.reserve(matches.size());
+  for (const FeatureMatch& match : matches) {
+    const int row = candidate_rows.empty() ? match.point2D_idx2
+                                           : candidate_rows[match.point2D_idx2];
+    const point3D_t point3D_id = point3D_ids_[row];
+    const FeatureKeypoint& keypoint = keypoints[match.point2D_idx1];
+    points2D.emplace_back(keypoint.x, keypoint.y);
+    points3D.push_back(reconstruction_->Point3D(point3D_id).xyz);
+    result->correspondences.emplace_back(match.point2D_idx1, point3D_id);
+  }
+
+  AbsolutePoseEstimationOptions abs_pose_options = options_.abs_pose;
+  abs_pose_options.ransac_options.max_error = options_.abs_pose_max_error;
+  abs_pose_options.ransac_options.min_inlier_ratio =
+      options_.abs_pose_min_inlier_ratio;
+  if (!EstimateAbsolutePose(abs_pose_options,
+                            points2D,
+                            points3D,
+                            &result->cam_from_world,
+                            camera,
+                            &result->num_inliers,
+                            &result->inlier_mask) ||
+      result->num_inliers <
+          static_cast<size_t>(options_.abs_pose_min_num_inliers)) {
+    return Finish(false);
+  }
+
+  if (!RefineAbsolutePose(options_.abs_pose_refinement,
+                          result->inlier_mask,
+                          points2D,
+                          points3D,
+                          &result->cam_from_world,
+                          camera)) {
+    return Finish(false);
+  }
+
+  return Finish(true);
+}
+
+}  // namespace colmap
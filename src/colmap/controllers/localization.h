@@ -0,0 +1,169 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/estimators/pose.h"
+#include "colmap/feature/matcher.h"
+#include "colmap/feature/sift.h"
+#include "colmap/feature/types.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/retrieval/visual_index.h"
+#include "colmap/scene/camera.h"
+#include "colmap/scene/database.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/util/types.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace colmap {
+
+struct LocalizationOptions {
+  // Path to the vocabulary tree or to the visual index of a previous
+  // vocabulary tree matching run, which is used to retrieve the images of the
+  // reconstruction that are most similar to a query. If empty, every query is
+  // matched against all 3D points, which is only feasible for small models.
+  std::string vocab_tree_path = "";
+
+  // The number of most similar images retrieved per query, whose 3D points
+  // are matched against the features of the query.
+  int num_images = 10;
+
+  // The number of nearest neighbor visual words of each feature and the
+  // number of checks in the nearest neighbor search of the retrieval.
+  int num_nearest_neighbors = 5;
+  int num_checks = 256;
+
+  // The maximum number of largest-scale features of the query and indexed
+  // images used for the retrieval.
+  int max_num_features = -1;
+
+  // The number of queries that are localized concurrently, i.e. the number of
+  // resident matchers. The matchers are assigned round-robin to the GPUs in
+  // `matching.gpu_index`, when matching on the GPU.
+  int num_matchers = 1;
+
+  // The number of threads used to build the localizer.
+  int num_threads = -1;
+
+  // Maximum reprojection error in pixels of the inliers of the pose.
+  double abs_pose_max_error = 12.0;
+
+  // Minimum number of inliers of the pose and minimum inlier ratio of the
+  // 2D-3D correspondences.
+  int abs_pose_min_num_inliers = 30;
+  double abs_pose_min_inlier_ratio = 0.25;
+
+  // Options to match the query features against the 3D point descriptors.
+  SiftMatchingOptions matching;
+
+  // Options to estimate and refine the pose. The RANSAC error threshold and
+  // inlier ratio are taken from the options above.
+  AbsolutePoseEstimationOptions abs_pose;
+  AbsolutePoseRefinementOptions abs_pose_refinement;
+
+  bool Check() const;
+};
+
+struct LocalizationResult {
+  Rigid3d cam_from_world;
+
+  // The images retrieved for the query in the order of their similarity.
+  std::vector<image_t> retrieved_image_ids;
+
+  // The 2D-3D correspondences between the query features and the 3D points of
+  // the reconstruction and whether they are inliers of the pose.
+  std::vector<std::pair<point2D_t, point3D_t>> correspondences;
+  std::vector<char> inlier_mask;
+  size_t num_inliers = 0;
+
+  // The wall time of the query in seconds.
+  double elapsed_seconds = 0;
+};
+
+// Localizes query images against a fixed reconstruction. All data needed for
+// the queries, i.e. one descriptor per 3D point, the visual index, and the
+// matchers, is built once and stays resident in memory, so that queries do not
+// access the database or disk.
+class Localizer {
+ public:
+  // The descriptor of each 3D point is the normalized mean of the descriptors
+  // of its observations, which are read from the database. The registered
+  // images that are not yet in the visual index are indexed.
+  Localizer(const LocalizationOptions& options,
+            std::shared_ptr<const Reconstruction> reconstruction,
+            const Database& database);
+
+  // Estimate the pose of a query image from its features. The camera holds
+  // the known intrinsics of the query, which are estimated or refined as set
+  // in the options. Returns false, if the query could not be localized. The
+  // method is thread-safe and up to `num_matchers` queries are localized
+  // concurrently, while further queries wait for a free matcher.
+  bool Localize(const FeatureKeypoints& keypoints,
+                const FeatureDescriptors& descriptors,
+                Camera* camera,
+                LocalizationResult* result) const;
+
+  size_t NumPoints3D() const;
+
+ private:
+  std::vector<image_t> RetrieveImages(const FeatureKeypoints& keypoints,
+                                      const FeatureDescriptors& descriptors)
+      const;
+
+  std::unique_ptr<FeatureMatcher> AcquireMatcher() const;
+  void ReleaseMatcher(std::unique_ptr<FeatureMatcher> matcher) const;
+
+  const LocalizationOptions options_;
+  const std::shared_ptr<const Reconstruction> reconstruction_;
+
+  // The descriptors of all 3D points in rows and their identifiers.
+  std::shared_ptr<const FeatureDescriptors> point_descriptors_;
+  std::vector<point3D_t> point3D_ids_;
+  // The rows of the 3D points in `point_descriptors_` observed by each
+  // registered image.
+  std::unordered_map<image_t, std::vector<int>> image_point_rows_;
+  // Search index over all point descriptors, if matching without retrieval.
+  std::shared_ptr<const FeatureDescriptorIndex> point_descriptor_index_;
+
+  std::unique_ptr<retrieval::VisualIndex<>> visual_index_;
+
+  mutable std::mutex matchers_mutex_;
+  mutable std::condition_variable matchers_condition_;
+  mutable std::vector<std::unique_ptr<FeatureMatcher>> free_matchers_;
+};
+
+}  // namespace colmap
@@ -0,0 +1,121 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/controllers/localization.h"
+
+#include "colmap/feature/utils.h"
+#include "colmap/scene/synthetic.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+FeatureDescriptors RandomDescriptor(const unsigned seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> distribution(0, 1);
+  FeatureDescriptorsFloat descriptor(1, 128);
+  for (int i = 0; i < descriptor.cols(); ++i) {
+    descriptor(0, i) = distribution(generator);
+  }
+  L2NormalizeFeatureDescriptors(&descriptor);
+  return FeatureDescriptorsToUnsignedByte(descriptor);
+}
+
+// Write descriptors, which are identical for all observations of a 3D point.
+void WriteDescriptors(const Reconstruction& reconstruction,
+                      const Database& database) {
+  for (const auto& image : reconstruction.Images()) {
+    FeatureDescriptors descriptors(image.second.NumPoints2D(), 128);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.second.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.second.Point2D(point2D_idx);
+      descriptors.row(point2D_idx) = RandomDescriptor(
+          point2D.HasPoint3D() ? point2D.point3D_id
+                               : 1000000 + 1000 * image.first + point2D_idx);
+    }
+    database.WriteDescriptors(image.first, descriptors);
+  }
+}
+
+TEST(Localizer, Nominal) {
+  Database database(Database::kInMemoryDatabasePath);
+  auto reconstruction = std::make_shared<Reconstruction>();
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 5;
+  synthetic_dataset_options.num_points3D = 200;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(
+      synthetic_dataset_options, reconstruction.get(), &database);
+  WriteDescriptors(*reconstruction, database);
+
+  LocalizationOptions options;
+  options.matching.use_gpu = false;
+  options.abs_pose_refinement.refine_focal_length = false;
+  options.abs_pose_refinement.refine_extra_params = false;
+  Localizer localizer(options, reconstruction, database);
+  EXPECT_EQ(localizer.NumPoints3D(), reconstruction->NumPoints3D());
+
+  const Image& image = reconstruction->Image(1);
+  Camera camera = reconstruction->Camera(image.CameraId());
+  LocalizationResult result;
+  EXPECT_TRUE(localizer.Localize(database.ReadKeypoints(image.ImageId()),
+                                 database.ReadDescriptors(image.ImageId()),
+                                 &camera,
+                                 &result));
+  EXPECT_GE(result.num_inliers, 0.9 * image.NumPoints3D());
+  EXPECT_LT(result.cam_from_world.rotation.angularDistance(
+                image.CamFromWorld().rotation),
+            1e-6);
+  EXPECT_LT((result.cam_from_world.translation -
+             image.CamFromWorld().translation)
+                .norm(),
+            1e-6);
+  EXPECT_TRUE(result.retrieved_image_ids.empty());
+  EXPECT_GE(result.elapsed_seconds, 0);
+
+  // Descriptors without correspondences in the reconstruction.
+  FeatureDescriptors random_descriptors(image.NumPoints2D(), 128);
+  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+       ++point2D_idx) {
+    random_descriptors.row(point2D_idx) =
+        RandomDescriptor(2000000 + point2D_idx);
+  }
+  EXPECT_FALSE(localizer.Localize(database.ReadKeypoints(image.ImageId()),
+                                  random_descriptors,
+                                  &camera,
+                                  &result));
+}
+
+}  // namespace
+}  // namespace colmap
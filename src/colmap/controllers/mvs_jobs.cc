@@ -0,0 +1,389 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/controllers/mvs_jobs.h"
+
+#include "colmap/controllers/option_manager.h"
+#include "colmap/mvs/model.h"
+#include "colmap/mvs/view_selection.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/ply.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+namespace colmap {
+namespace {
+
+const char* const kMVSJobFileName = "job.txt";
+const char* const kMVSJobProjectFileName = "project.ini";
+const char* const kMVSJobPatchMatchConfigFileName = "patch-match.cfg";
+const char* const kMVSJobClaimedDirName = "claimed";
+const char* const kMVSJobDoneFileName = "done";
+const char* const kMVSJobFusedFileName = "fused.ply";
+
+// Only reads the type of the job, which is the first line of the job file.
+MVSJob::Type ReadMVSJobType(const std::string& job_path) {
+  const std::string path = JoinPaths(job_path, kMVSJobFileName);
+  std::ifstream file(path);
+  THROW_CHECK_FILE_OPEN(file, path);
+  int type = -1;
+  file >> type;
+  THROW_CHECK_GE(type, static_cast<int>(MVSJob::Type::PHOTOMETRIC_STEREO));
+  THROW_CHECK_LE(type, static_cast<int>(MVSJob::Type::MERGE));
+  return static_cast<MVSJob::Type>(type);
+}
+
+std::vector<std::string> GetMVSJobPaths(const std::string& jobs_path) {
+  std::vector<std::string> job_paths;
+  for (const std::string& job_path : GetDirList(jobs_path)) {
+    if (ExistsFile(JoinPaths(job_path, kMVSJobFileName))) {
+      job_paths.push_back(job_path);
+    }
+  }
+  std::sort(job_paths.begin(), job_paths.end());
+  return job_paths;
+}
+
+// Wait until all jobs of a type before the given type are done.
+void WaitForPreviousMVSJobs(const std::vector<std::string>& job_paths,
+                            const MVSJob::Type type) {
+  const int kPollIntervalSeconds = 10;
+  for (const std::string& job_path : job_paths) {
+    if (ReadMVSJobType(job_path) >= type) {
+      continue;
+    }
+    const std::string done_path = JoinPaths(job_path, kMVSJobDoneFileName);
+    while (!ExistsFile(done_path)) {
+      LOG_FIRST_N(INFO, 1) << "Waiting for MVS jobs of other workers";
+      std::this_thread::sleep_for(std::chrono::seconds(kPollIntervalSeconds));
+    }
+  }
+}
+
+void MergeFusedPoints(const std::string& jobs_path,
+                      const std::string& workspace_path) {
+  const std::string output_path = JoinPaths(workspace_path, "fused.ply");
+  PlyPointWriter ply_writer(output_path);
+  mvs::PointsVisibilityWriter visibility_writer(output_path + ".vis");
+
+  std::vector<int> visibility;
+  for (const std::string& job_path : GetMVSJobPaths(jobs_path)) {
+    if (ReadMVSJobType(job_path) != MVSJob::Type::FUSION) {
+      continue;
+    }
+
+    const std::string fused_path = JoinPaths(job_path, kMVSJobFusedFileName);
+    const std::vector<PlyPoint> points = ReadPly(fused_path);
+    ply_writer.Write(points);
+
+    const std::string visibility_path = fused_path + ".vis";
+    std::ifstream visibility_file(visibility_path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(visibility_file, visibility_path);
+    const uint64_t num_points =
+        ReadBinaryLittleEndian<uint64_t>(&visibility_file);
+    THROW_CHECK_EQ(num_points, points.size());
+    for (uint64_t i = 0; i < num_points; ++i) {
+      visibility.resize(ReadBinaryLittleEndian<uint32_t>(&visibility_file));
+      for (int& image_idx : visibility) {
+        image_idx = ReadBinaryLittleEndian<uint32_t>(&visibility_file);
+      }
+      visibility_writer.Write(visibility);
+    }
+  }
+
+  LOG(INFO) << StringPrintf("Merged %d fused points into %s",
+                            ply_writer.NumPoints(),
+                            output_path.c_str());
+
+  ply_writer.Close();
+  visibility_writer.Close();
+}
+
+void RunMVSJob(const MVSJob& job,
+               const std::string& jobs_path,
+               const std::string& job_path) {
+  switch (job.type) {
+    case MVSJob::Type::PHOTOMETRIC_STEREO:
+    case MVSJob::Type::GEOMETRIC_STEREO: {
+#if defined(COLMAP_CUDA_ENABLED)
+      mvs::PatchMatchController controller(
+          job.patch_match_options,
+          job.workspace_path,
+          "COLMAP",
+          "option-all",
+          JoinPaths(job_path, kMVSJobPatchMatchConfigFileName));
+      controller.Run();
+#else   // COLMAP_CUDA_ENABLED
+      LOG(FATAL_THROW) << "Dense stereo reconstruction requires CUDA, which "
+                          "is not available on your system.";
+#endif  // COLMAP_CUDA_ENABLED
+      break;
+    }
+    case MVSJob::Type::FUSION: {
+      mvs::StereoFusion fuser(job.fusion_options,
+                              job.workspace_path,
+                              "COLMAP",
+                              "option-all",
+                              job.input_type);
+      fuser.SetOutputPath(JoinPaths(job_path, kMVSJobFusedFileName));
+      fuser.Run();
+      break;
+    }
+    case MVSJob::Type::MERGE:
+      MergeFusedPoints(jobs_path, job.workspace_path);
+      break;
+  }
+}
+
+}  // namespace
+
+void MVSJob::Write(const std::string& job_path) const {
+  CreateDirIfNotExists(job_path);
+
+  if (type == Type::PHOTOMETRIC_STEREO || type == Type::GEOMETRIC_STEREO) {
+    const std::string config_path =
+        JoinPaths(job_path, kMVSJobPatchMatchConfigFileName);
+    std::ofstream config_file(config_path);
+    THROW_CHECK_FILE_OPEN(config_file, config_path);
+    for (const std::string& line : patch_match_config) {
+      config_file << line << "\n";
+    }
+  }
+
+  OptionManager options(/*add_project_options=*/false);
+  options.AddPatchMatchStereoOptions();
+  options.AddStereoFusionOptions();
+  *options.patch_match_stereo = patch_match_options;
+  *options.stereo_fusion = fusion_options;
+  options.Write(JoinPaths(job_path, kMVSJobProjectFileName));
+
+  // The job file is written last, since it marks the job as complete.
+  const std::string path = JoinPaths(job_path, kMVSJobFileName);
+  std::ofstream file(path);
+  THROW_CHECK_FILE_OPEN(file, path);
+  // The bounds are parsed as doubles, such that they are written exactly.
+  file.precision(std::numeric_limits<double>::max_digits10);
+  file << static_cast<int>(type) << "\n";
+  file << workspace_path << "\n";
+  file << input_type << "\n";
+  const auto& bounding_box = fusion_options.bounding_box;
+  file << bounding_box.first(0) << ", " << bounding_box.first(1) << ", "
+       << bounding_box.first(2) << "\n";
+  file << bounding_box.second(0) << ", " << bounding_box.second(1) << ", "
+       << bounding_box.second(2) << "\n";
+}
+
+MVSJob MVSJob::Read(const std::string& job_path) {
+  const std::vector<std::string> lines =
+      ReadTextFileLines(JoinPaths(job_path, kMVSJobFileName));
+  THROW_CHECK_EQ(lines.size(), 5) << "Invalid MVS job " << job_path;
+
+  OptionManager options(/*add_project_options=*/false);
+  options.AddPatchMatchStereoOptions();
+  options.AddStereoFusionOptions();
+  THROW_CHECK(options.Read(JoinPaths(job_path, kMVSJobProjectFileName)))
+      << "Invalid MVS job " << job_path;
+
+  MVSJob job;
+  job.type = ReadMVSJobType(job_path);
+  job.workspace_path = lines[1];
+  job.input_type = lines[2];
+  job.patch_match_options = *options.patch_match_stereo;
+  job.fusion_options = *options.stereo_fusion;
+  const std::vector<float> min_bound = CSVToVector<float>(lines[3]);
+  const std::vector<float> max_bound = CSVToVector<float>(lines[4]);
+  THROW_CHECK_EQ(min_bound.size(), 3);
+  THROW_CHECK_EQ(max_bound.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    job.fusion_options.bounding_box.first(i) = min_bound[i];
+    job.fusion_options.bounding_box.second(i) = max_bound[i];
+  }
+
+  if (job.type == Type::PHOTOMETRIC_STEREO ||
+      job.type == Type::GEOMETRIC_STEREO) {
+    job.patch_match_config = ReadTextFileLines(
+        JoinPaths(job_path, kMVSJobPatchMatchConfigFileName));
+  }
+
+  return job;
+}
+
+size_t CreateMVSJobs(const std::string& jobs_path,
+                     const std::string& workspace_path,
+                     const mvs::PatchMatchOptions& patch_match_options,
+                     const mvs::StereoFusionOptions& fusion_options,
+                     const int num_problems_per_job) {
+  THROW_CHECK_GT(num_problems_per_job, 0);
+
+  mvs::Model model;
+  model.Read(workspace_path, "COLMAP");
+  ReadOrComputeViewSelectionIndex(
+      model,
+      JoinPaths(workspace_path, "stereo", "view-selection.bin"),
+      fusion_options.num_threads);
+
+  // Every problem consists of a reference and a source image line.
+  std::vector<std::string> config_lines;
+  for (const std::string& line : ReadTextFileLines(
+           JoinPaths(workspace_path, "stereo", "patch-match.cfg"))) {
+    if (line[0] != '#') {
+      config_lines.push_back(line);
+    }
+  }
+  THROW_CHECK_EQ(config_lines.size() % 2, 0)
+      << "Invalid patch-match.cfg in " << workspace_path;
+  const size_t num_problems = config_lines.size() / 2;
+
+  std::vector<MVSJob> jobs;
+
+  MVSJob stereo_job;
+  stereo_job.workspace_path = workspace_path;
+  stereo_job.patch_match_options = patch_match_options;
+  stereo_job.fusion_options = fusion_options;
+
+  // As in PatchMatchController, the photometric output is computed without
+  // filtering, if it is the input of the geometric stereo.
+  const bool geom_consistency = patch_match_options.geom_consistency;
+  auto photometric_options = patch_match_options;
+  if (geom_consistency) {
+    photometric_options.geom_consistency = false;
+    photometric_options.filter = false;
+  }
+
+  for (size_t begin = 0; begin < num_problems; begin += num_problems_per_job) {
+    const size_t end = std::min(begin + num_problems_per_job, num_problems);
+    stereo_job.patch_match_config.assign(config_lines.begin() + 2 * begin,
+                                         config_lines.begin() + 2 * end);
+    stereo_job.type = MVSJob::Type::PHOTOMETRIC_STEREO;
+    stereo_job.input_type = "photometric";
+    stereo_job.patch_match_options = photometric_options;
+    jobs.push_back(stereo_job);
+  }
+
+  if (geom_consistency) {
+    for (size_t begin = 0; begin < num_problems;
+         begin += num_problems_per_job) {
+      const size_t end = std::min(begin + num_problems_per_job, num_problems);
+      stereo_job.patch_match_config.assign(config_lines.begin() + 2 * begin,
+                                           config_lines.begin() + 2 * end);
+      stereo_job.type = MVSJob::Type::GEOMETRIC_STEREO;
+      stereo_job.input_type = "geometric";
+      stereo_job.patch_match_options = patch_match_options;
+      jobs.push_back(stereo_job);
+    }
+  }
+
+  MVSJob fusion_job;
+  fusion_job.type = MVSJob::Type::FUSION;
+  fusion_job.workspace_path = workspace_path;
+  fusion_job.patch_match_options = patch_match_options;
+  fusion_job.fusion_options = fusion_options;
+  fusion_job.input_type = geom_consistency ? "geometric" : "photometric";
+  if (fusion_options.max_num_tile_images > 0) {
+    // The fusion of a tile computes the same tile again from its bounding
+    // box, such that it only reads the data of the images of the tile.
+    const std::vector<mvs::internal::FusionTile> tiles =
+        mvs::internal::ComputeFusionTiles(model.points,
+                                          fusion_options.bounding_box,
+                                          fusion_options.max_num_tile_images);
+    for (const auto& tile : tiles) {
+      if (!tile.image_idxs.empty()) {
+        fusion_job.fusion_options.bounding_box = tile.bounding_box;
+        jobs.push_back(fusion_job);
+      }
+    }
+  } else {
+    jobs.push_back(fusion_job);
+  }
+
+  MVSJob merge_job = fusion_job;
+  merge_job.type = MVSJob::Type::MERGE;
+  merge_job.fusion_options.bounding_box = fusion_options.bounding_box;
+  jobs.push_back(merge_job);
+
+  CreateDirIfNotExists(jobs_path, /*recursive=*/true);
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const std::string job_path =
+        JoinPaths(jobs_path, StringPrintf("job%06d", i));
+    if (!ExistsFile(JoinPaths(job_path, kMVSJobFileName))) {
+      jobs[i].Write(job_path);
+    }
+  }
+
+  LOG(INFO) << StringPrintf(
+      "Wrote %d MVS jobs to %s", jobs.size(), jobs_path.c_str());
+
+  return jobs.size();
+}
+
+bool RunNextMVSJob(const std::string& jobs_path) {
+  const std::vector<std::string> job_paths = GetMVSJobPaths(jobs_path);
+  for (const std::string& job_path : job_paths) {
+    if (ExistsDir(JoinPaths(job_path, kMVSJobClaimedDirName))) {
+      continue;
+    }
+
+    const MVSJob::Type type = ReadMVSJobType(job_path);
+#if !defined(COLMAP_CUDA_ENABLED)
+    if (type == MVSJob::Type::PHOTOMETRIC_STEREO ||
+        type == MVSJob::Type::GEOMETRIC_STEREO) {
+      continue;
+    }
+#endif
+
+    WaitForPreviousMVSJobs(job_paths, type);
+
+    if (!boost::filesystem::create_directory(
+            JoinPaths(job_path, kMVSJobClaimedDirName))) {
+      continue;
+    }
+
+    LOG(INFO) << "Running MVS job " << job_path;
+
+    RunMVSJob(MVSJob::Read(job_path), jobs_path, job_path);
+
+    const std::string done_path = JoinPaths(job_path, kMVSJobDoneFileName);
+    std::ofstream done_file(done_path);
+    THROW_CHECK_FILE_OPEN(done_file, done_path);
+
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace colmap
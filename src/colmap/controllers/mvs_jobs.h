@@ -0,0 +1,103 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/mvs/fusion.h"
+#include "colmap/mvs/patch_match.h"
+
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Job of a sharded dense reconstruction of a COLMAP workspace, which is
+// serialized to a folder with the job description in "job.txt" and the stereo
+// and fusion options in "project.ini". Stereo jobs additionally store their
+// problems in "patch-match.cfg". The jobs can thus be run on any machine with
+// access to the same workspace path, e.g., on a network file system.
+struct MVSJob {
+  // The jobs of a type only depend on the outputs of the jobs of the previous
+  // types, such that all jobs of the same type can run in parallel.
+  enum class Type {
+    PHOTOMETRIC_STEREO = 0,
+    GEOMETRIC_STEREO = 1,
+    FUSION = 2,
+    MERGE = 3,
+  };
+
+  Type type = Type::PHOTOMETRIC_STEREO;
+
+  std::string workspace_path;
+
+  mvs::PatchMatchOptions patch_match_options;
+
+  // The bounding box of the fusion options is the tile of fusion jobs.
+  mvs::StereoFusionOptions fusion_options;
+
+  // The input type of fusion jobs, i.e., "photometric" or "geometric".
+  std::string input_type;
+
+  // The problems of stereo jobs in the format of "patch-match.cfg".
+  std::vector<std::string> patch_match_config;
+
+  void Write(const std::string& job_path) const;
+  static MVSJob Read(const std::string& job_path);
+};
+
+// Split the dense reconstruction of a COLMAP workspace into jobs:
+// 1. Photometric stereo jobs with the given number of problems of the
+//    "patch-match.cfg" of the workspace per job.
+// 2. Geometric stereo jobs for the same problems, if geometric consistency is
+//    enabled in the stereo options.
+// 3. Fusion jobs for the tiles of the bounding box of the fusion options with
+//    at most max_num_tile_images images, such that every fusion job only reads
+//    the depth and normal maps of the images observing its tile, see
+//    StereoFusionOptions::max_num_tile_images.
+// 4. A merge job, which concatenates the fused points of all tiles into
+//    "fused.ply" and "fused.ply.vis" of the workspace.
+// The view selection of the workspace is computed once, such that the jobs
+// do not have to compute it concurrently. Existing jobs are not rewritten.
+// Returns the number of jobs.
+size_t CreateMVSJobs(const std::string& jobs_path,
+                     const std::string& workspace_path,
+                     const mvs::PatchMatchOptions& patch_match_options,
+                     const mvs::StereoFusionOptions& fusion_options,
+                     int num_problems_per_job);
+
+// Claim and run the next pending job in the folder of MVS jobs. Jobs are
+// claimed by atomically creating their "claimed" folder and are marked as
+// done by an empty "done" file, as for the hierarchical mapper cluster jobs.
+// If the next pending jobs depend on jobs claimed by other workers, this
+// waits until they are done. Stereo jobs are not claimed without CUDA, such
+// that workers without a GPU only run the fusion and merge jobs. Returns
+// false, if there is no pending job that can be run by this worker.
+bool RunNextMVSJob(const std::string& jobs_path);
+
+}  // namespace colmap
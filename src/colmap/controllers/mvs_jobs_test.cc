@@ -0,0 +1,94 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/controllers/mvs_jobs.h"
+
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(MVSJob, ReadWrite) {
+  const std::string test_dir = CreateTestDir();
+  MVSJob job;
+  job.type = MVSJob::Type::GEOMETRIC_STEREO;
+  job.workspace_path = test_dir;
+  job.input_type = "geometric";
+  job.patch_match_options.geom_consistency = true;
+  job.patch_match_options.window_radius = 3;
+  job.fusion_options.min_num_pixels = 7;
+  job.fusion_options.bounding_box.first = Eigen::Vector3f(-1, -2.5f, -3);
+  job.fusion_options.bounding_box.second = Eigen::Vector3f(0.1f, 2, 3);
+  job.patch_match_config = {"image1.png", "__auto__, 20", "image2.png",
+                            "image1.png"};
+  const std::string job_path = test_dir + "/job";
+  job.Write(job_path);
+
+  const MVSJob read_job = MVSJob::Read(job_path);
+  EXPECT_EQ(read_job.type, job.type);
+  EXPECT_EQ(read_job.workspace_path, job.workspace_path);
+  EXPECT_EQ(read_job.input_type, job.input_type);
+  EXPECT_TRUE(read_job.patch_match_options.geom_consistency);
+  EXPECT_EQ(read_job.patch_match_options.window_radius, 3);
+  EXPECT_EQ(read_job.fusion_options.min_num_pixels, 7);
+  EXPECT_EQ(read_job.fusion_options.bounding_box.first,
+            job.fusion_options.bounding_box.first);
+  EXPECT_EQ(read_job.fusion_options.bounding_box.second,
+            job.fusion_options.bounding_box.second);
+  EXPECT_EQ(read_job.patch_match_config, job.patch_match_config);
+}
+
+TEST(MVSJob, ReadWriteUnboundedFusion) {
+  const std::string test_dir = CreateTestDir();
+  MVSJob job;
+  job.type = MVSJob::Type::FUSION;
+  job.workspace_path = test_dir;
+  job.input_type = "photometric";
+  const std::string job_path = test_dir + "/job";
+  job.Write(job_path);
+
+  const MVSJob read_job = MVSJob::Read(job_path);
+  EXPECT_EQ(read_job.type, MVSJob::Type::FUSION);
+  EXPECT_EQ(read_job.fusion_options.bounding_box.first,
+            job.fusion_options.bounding_box.first);
+  EXPECT_EQ(read_job.fusion_options.bounding_box.second,
+            job.fusion_options.bounding_box.second);
+  EXPECT_TRUE(read_job.patch_match_config.empty());
+}
+
+TEST(RunNextMVSJob, NoJobs) {
+  const std::string test_dir = CreateTestDir();
+  EXPECT_FALSE(RunNextMVSJob(test_dir));
+}
+
+}  // namespace
+}  // namespace colmap
@@ -41,7 +41,9 @@
 #include "colmap/mvs/meshing.h"
 #include "colmap/mvs/patch_match.h"
 #include "colmap/ui/render_options.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/version.h"
 
 #include <boost/filesystem/operations.hpp>
@@ -52,11 +54,14 @@ namespace config = boost::program_options;
 namespace colmap {
 
 OptionManager::OptionManager(bool add_project_options) {
-  std::cout << "new option_manager,,," << std::endl;
+  VLOG(1) << "new option_manager";
 
   project_path = std::make_shared<std::string>();
   database_path = std::make_shared<std::string>();
   image_path = std::make_shared<std::string>();
+  profile_path = std::make_shared<std::string>();
+  metrics_path = std::make_shared<std::string>();
+  log_async = std::make_shared<bool>(false);
 
   image_reader = std::make_shared<ImageReaderOptions>();
   sift_extraction = std::make_shared<SiftExtractionOptions>();
@@ -65,10 +70,13 @@ OptionManager::OptionManager(bool add_project_options) {
   exhaustive_matching = std::make_shared<ExhaustiveMatchingOptions>();
   sequential_matching = std::make_shared<SequentialMatchingOptions>();
   vocab_tree_matching = std::make_shared<VocabTreeMatchingOptions>();
+  vlad_matching = std::make_shared<VLADMatchingOptions>();
   spatial_matching = std::make_shared<SpatialMatchingOptions>();
   transitive_matching = std::make_shared<TransitiveMatchingOptions>();
   image_pairs_matching = std::make_shared<ImagePairsMatchingOptions>();
   bundle_adjustment = std::make_shared<BundleAdjustmentOptions>();
+  partitioned_bundle_adjustment =
+      std::make_shared<PartitionedBundleAdjustmentOptions>();
   mapper = std::make_shared<IncrementalMapperOptions>();
   patch_match_stereo = std::make_shared<mvs::PatchMatchOptions>();
   stereo_fusion = std::make_shared<mvs::StereoFusionOptions>();
@@ -115,6 +123,7 @@ void OptionManager::ModifyForLowQuality() {
   sift_extraction->max_num_features = 2048;
   sequential_matching->loop_detection_num_images /= 2;
   vocab_tree_matching->num_images /= 2;
+  vlad_matching->num_images /= 2;
   mapper->ba_local_max_num_iterations /= 2;
   mapper->ba_global_max_num_iterations /= 2;
   mapper->ba_global_images_ratio *= 1.2;
@@ -135,6 +144,7 @@ void OptionManager::ModifyForMediumQuality() {
   sift_extraction->max_num_features = 4096;
   sequential_matching->loop_detection_num_images /= 1.5;
   vocab_tree_matching->num_images /= 1.5;
+  vlad_matching->num_images /= 1.5;
   mapper->ba_local_max_num_iterations /= 1.5;
   mapper->ba_global_max_num_iterations /= 1.5;
   mapper->ba_global_images_ratio *= 1.1;
@@ -182,6 +192,7 @@ void OptionManager::AddAllOptions() {
   AddExhaustiveMatchingOptions();
   AddSequentialMatchingOptions();
   AddVocabTreeMatchingOptions();
+  AddVLADMatchingOptions();
   AddSpatialMatchingOptions();
   AddTransitiveMatchingOptions();
   AddImagePairsMatchingOptions();
@@ -202,6 +213,9 @@ void OptionManager::AddLogOptions() {
 
   AddAndRegisterDefaultOption("log_to_stderr", &FLAGS_logtostderr);
   AddAndRegisterDefaultOption("log_level", &FLAGS_v);
+  AddAndRegisterDefaultOption("log_async", log_async.get());
+  AddAndRegisterDefaultOption("profile_path", profile_path.get());
+  AddAndRegisterDefaultOption("metrics_path", metrics_path.get());
 }
 
 void OptionManager::AddRandomOptions() {
@@ -232,7 +246,7 @@ void OptionManager::AddImageOptions() {
 }
 
 void OptionManager::AddExtractionOptions() {
-  std::cout << "add extraction options,,, " << std::endl;
+  VLOG(1) << "add extraction options";
 
   if (added_extraction_options_) {
     return;
@@ -257,6 +271,24 @@ void OptionManager::AddExtractionOptions() {
                               &image_reader->default_focal_length_factor);
   AddAndRegisterDefaultOption("ImageReader.camera_mask_path",
                               &image_reader->camera_mask_path);
+  AddAndRegisterDefaultOption("ImageReader.num_threads",
+                              &image_reader->num_threads);
+  AddAndRegisterDefaultOption("ImageReader.max_image_size",
+                              &image_reader->max_image_size);
+  AddAndRegisterDefaultOption("ImageReader.bitmap_decoder",
+                              &image_reader->bitmap_decoder);
+  AddAndRegisterDefaultOption("ImageReader.video_path",
+                              &image_reader->video_path);
+  AddAndRegisterDefaultOption("ImageReader.video_frame_step",
+                              &image_reader->video_frame_step);
+  AddAndRegisterDefaultOption("ImageReader.video_keyframes_only",
+                              &image_reader->video_keyframes_only);
+  AddAndRegisterDefaultOption("ImageReader.detect_changed_images",
+                              &image_reader->detect_changed_images);
+  AddAndRegisterDefaultOption("ImageReader.shard_index",
+                              &image_reader->shard_index);
+  AddAndRegisterDefaultOption("ImageReader.num_shards",
+                              &image_reader->num_shards);
 
   AddAndRegisterDefaultOption("SiftExtraction.num_threads",
                               &sift_extraction->num_threads);
@@ -266,8 +298,20 @@ void OptionManager::AddExtractionOptions() {
                               &sift_extraction->gpu_index);
   AddAndRegisterDefaultOption("SiftExtraction.max_image_size",
                               &sift_extraction->max_image_size);
+  AddAndRegisterDefaultOption("SiftExtraction.gpu_downsample",
+                              &sift_extraction->gpu_downsample);
+  AddAndRegisterDefaultOption("SiftExtraction.gpu_num_threads_per_device",
+                              &sift_extraction->gpu_num_threads_per_device);
+  AddAndRegisterDefaultOption("SiftExtraction.gpu_pyramid_bucket_size",
+                              &sift_extraction->gpu_pyramid_bucket_size);
   AddAndRegisterDefaultOption("SiftExtraction.max_num_features",
                               &sift_extraction->max_num_features);
+  AddAndRegisterDefaultOption("SiftExtraction.tile_size",
+                              &sift_extraction->tile_size);
+  AddAndRegisterDefaultOption("SiftExtraction.tile_overlap",
+                              &sift_extraction->tile_overlap);
+  AddAndRegisterDefaultOption("SiftExtraction.tile_num_threads",
+                              &sift_extraction->tile_num_threads);
   AddAndRegisterDefaultOption("SiftExtraction.first_octave",
                               &sift_extraction->first_octave);
   AddAndRegisterDefaultOption("SiftExtraction.num_octaves",
@@ -292,6 +336,14 @@ void OptionManager::AddExtractionOptions() {
                               &sift_extraction->dsp_max_scale);
   AddAndRegisterDefaultOption("SiftExtraction.dsp_num_scales",
                               &sift_extraction->dsp_num_scales);
+  AddAndRegisterDefaultOption("SiftExtraction.pca_path",
+                              &sift_extraction->pca_path);
+  AddAndRegisterDefaultOption("SiftExtraction.feature_cache_path",
+                              &sift_extraction->feature_cache_path);
+  AddAndRegisterDefaultOption("SiftExtraction.max_num_images_per_transaction",
+                              &sift_extraction->max_num_images_per_transaction);
+  AddAndRegisterDefaultOption("SiftExtraction.max_transaction_duration",
+                              &sift_extraction->max_transaction_duration);
 }
 
 void OptionManager::AddMatchingOptions() {
@@ -315,6 +367,30 @@ void OptionManager::AddMatchingOptions() {
                               &sift_matching->guided_matching);
   AddAndRegisterDefaultOption("SiftMatching.max_num_matches",
                               &sift_matching->max_num_matches);
+  AddAndRegisterDefaultOption("SiftMatching.vote_and_verify",
+                              &sift_matching->vote_and_verify);
+  AddAndRegisterDefaultOption("SiftMatching.vote_and_verify_min_num_inliers",
+                              &sift_matching->vote_and_verify_min_num_inliers);
+  AddAndRegisterDefaultOption("SiftMatching.coarse_num_features",
+                              &sift_matching->coarse_num_features);
+  AddAndRegisterDefaultOption("SiftMatching.coarse_min_num_inliers",
+                              &sift_matching->coarse_min_num_inliers);
+  AddAndRegisterDefaultOption("SiftMatching.prediction_max_error",
+                              &sift_matching->prediction_max_error);
+  AddAndRegisterDefaultOption("SiftMatching.pca_path",
+                              &sift_matching->pca_path);
+  AddAndRegisterDefaultOption("SiftMatching.batch_size",
+                              &sift_matching->batch_size);
+  AddAndRegisterDefaultOption("SiftMatching.max_num_pairs_per_transaction",
+                              &sift_matching->max_num_pairs_per_transaction);
+  AddAndRegisterDefaultOption("SiftMatching.max_transaction_duration",
+                              &sift_matching->max_transaction_duration);
+  AddAndRegisterDefaultOption("SiftMatching.numa_affinity",
+                              &sift_matching->numa_affinity);
+  AddAndRegisterDefaultOption("SiftMatching.gpu_tiled_matching",
+                              &sift_matching->gpu_tiled_matching);
+  AddAndRegisterDefaultOption("SiftMatching.gpu_descriptor_cache_size",
+                              &sift_matching->gpu_descriptor_cache_size);
   AddAndRegisterDefaultOption("TwoViewGeometry.min_num_inliers",
                               &two_view_geometry->min_num_inliers);
   AddAndRegisterDefaultOption("TwoViewGeometry.multiple_models",
@@ -331,6 +407,14 @@ void OptionManager::AddMatchingOptions() {
   AddAndRegisterDefaultOption(
       "TwoViewGeometry.min_inlier_ratio",
       &two_view_geometry->ransac_options.min_inlier_ratio);
+  AddAndRegisterDefaultOption("TwoViewGeometry.use_sprt",
+                              &two_view_geometry->ransac_options.use_sprt);
+  AddAndRegisterDefaultOption("TwoViewGeometry.parallel_estimation",
+                              &two_view_geometry->parallel_estimation);
+  AddAndRegisterDefaultOption("TwoViewGeometry.use_gpu",
+                              &two_view_geometry->use_gpu);
+  AddAndRegisterDefaultOption("TwoViewGeometry.gpu_index",
+                              &two_view_geometry->gpu_index);
 }
 
 void OptionManager::AddExhaustiveMatchingOptions() {
@@ -357,6 +441,8 @@ void OptionManager::AddSequentialMatchingOptions() {
                               &sequential_matching->overlap);
   AddAndRegisterDefaultOption("SequentialMatching.quadratic_overlap",
                               &sequential_matching->quadratic_overlap);
+  AddAndRegisterDefaultOption("SequentialMatching.motion_prediction",
+                              &sequential_matching->motion_prediction);
   AddAndRegisterDefaultOption("SequentialMatching.loop_detection",
                               &sequential_matching->loop_detection);
   AddAndRegisterDefaultOption("SequentialMatching.loop_detection_period",
@@ -374,6 +460,9 @@ void OptionManager::AddSequentialMatchingOptions() {
   AddAndRegisterDefaultOption(
       "SequentialMatching.loop_detection_max_num_features",
       &sequential_matching->loop_detection_max_num_features);
+  AddAndRegisterDefaultOption(
+      "SequentialMatching.loop_detection_incremental",
+      &sequential_matching->loop_detection_incremental);
   AddAndRegisterDefaultOption("SequentialMatching.vocab_tree_path",
                               &sequential_matching->vocab_tree_path);
 }
@@ -401,6 +490,42 @@ void OptionManager::AddVocabTreeMatchingOptions() {
                               &vocab_tree_matching->vocab_tree_path);
   AddAndRegisterDefaultOption("VocabTreeMatching.match_list_path",
                               &vocab_tree_matching->match_list_path);
+  AddAndRegisterDefaultOption("VocabTreeMatching.index_path",
+                              &vocab_tree_matching->index_path);
+  AddAndRegisterDefaultOption("VocabTreeMatching.index_shard_paths",
+                              &vocab_tree_matching->index_shard_paths);
+  AddAndRegisterDefaultOption("VocabTreeMatching.spatial_max_distance",
+                              &vocab_tree_matching->spatial_max_distance);
+  AddAndRegisterDefaultOption("VocabTreeMatching.spatial_union",
+                              &vocab_tree_matching->spatial_union);
+  AddAndRegisterDefaultOption("VocabTreeMatching.spatial_max_num_neighbors",
+                              &vocab_tree_matching->spatial_max_num_neighbors);
+  AddAndRegisterDefaultOption("VocabTreeMatching.spatial_ignore_z",
+                              &vocab_tree_matching->spatial_ignore_z);
+}
+
+void OptionManager::AddVLADMatchingOptions() {
+  if (added_vlad_match_options_) {
+    return;
+  }
+  added_vlad_match_options_ = true;
+
+  AddMatchingOptions();
+
+  AddAndRegisterDefaultOption("VLADMatching.num_images",
+                              &vlad_matching->num_images);
+  AddAndRegisterDefaultOption("VLADMatching.num_clusters",
+                              &vlad_matching->num_clusters);
+  AddAndRegisterDefaultOption("VLADMatching.num_lists",
+                              &vlad_matching->num_lists);
+  AddAndRegisterDefaultOption("VLADMatching.num_probes",
+                              &vlad_matching->num_probes);
+  AddAndRegisterDefaultOption("VLADMatching.max_num_features",
+                              &vlad_matching->max_num_features);
+  AddAndRegisterDefaultOption("VLADMatching.vocab_tree_path",
+                              &vlad_matching->vocab_tree_path);
+  AddAndRegisterDefaultOption("VLADMatching.match_list_path",
+                              &vlad_matching->match_list_path);
 }
 
 void OptionManager::AddSpatialMatchingOptions() {
@@ -443,6 +568,8 @@ void OptionManager::AddImagePairsMatchingOptions() {
 
   AddAndRegisterDefaultOption("ImagePairsMatching.block_size",
                               &image_pairs_matching->block_size);
+  AddAndRegisterDefaultOption("ImagePairsMatching.lazy_image_loading",
+                              &image_pairs_matching->lazy_image_loading);
 }
 
 void OptionManager::AddBundleAdjustmentOptions() {
@@ -474,6 +601,43 @@ void OptionManager::AddBundleAdjustmentOptions() {
                               &bundle_adjustment->refine_extra_params);
   AddAndRegisterDefaultOption("BundleAdjustment.refine_extrinsics",
                               &bundle_adjustment->refine_extrinsics);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_gpu",
+                              &bundle_adjustment->use_gpu);
+  AddAndRegisterDefaultOption("BundleAdjustment.gpu_index",
+                              &bundle_adjustment->gpu_index);
+  AddAndRegisterDefaultOption("BundleAdjustment.min_num_images_gpu_solver",
+                              &bundle_adjustment->min_num_images_gpu_solver);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.max_num_images_direct_dense_cpu_solver",
+      &bundle_adjustment->max_num_images_direct_dense_cpu_solver);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.max_num_images_direct_sparse_cpu_solver",
+      &bundle_adjustment->max_num_images_direct_sparse_cpu_solver);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.max_num_images_direct_dense_gpu_solver",
+      &bundle_adjustment->max_num_images_direct_dense_gpu_solver);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.max_num_images_direct_sparse_gpu_solver",
+      &bundle_adjustment->max_num_images_direct_sparse_gpu_solver);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_float_jacobians",
+                              &bundle_adjustment->use_float_jacobians);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.marginalize_constant_pose_points",
+      &bundle_adjustment->marginalize_constant_pose_points);
+  AddAndRegisterDefaultOption("BundleAdjustment.outlier_max_reproj_error",
+                              &bundle_adjustment->outlier_max_reproj_error);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.partition_max_num_images",
+      &partitioned_bundle_adjustment->max_num_images);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.partition_max_num_iterations",
+      &partitioned_bundle_adjustment->max_num_iterations);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.partition_consensus_weight",
+      &partitioned_bundle_adjustment->consensus_weight);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.partition_consensus_tolerance",
+      &partitioned_bundle_adjustment->consensus_tolerance);
 }
 
 void OptionManager::AddMapperOptions() {
@@ -486,6 +650,14 @@ void OptionManager::AddMapperOptions() {
                               &mapper->min_num_matches);
   AddAndRegisterDefaultOption("Mapper.ignore_watermarks",
                               &mapper->ignore_watermarks);
+  AddAndRegisterDefaultOption("Mapper.lazy_load_points2D",
+                              &mapper->lazy_load_points2D);
+  AddAndRegisterDefaultOption("Mapper.lazy_points2D_cache_size",
+                              &mapper->lazy_points2D_cache_size);
+  AddAndRegisterDefaultOption("Mapper.compact_points2D",
+                              &mapper->compact_points2D);
+  AddAndRegisterDefaultOption("Mapper.precompute_tracks",
+                              &mapper->precompute_tracks);
   AddAndRegisterDefaultOption("Mapper.multiple_models",
                               &mapper->multiple_models);
   AddAndRegisterDefaultOption("Mapper.max_num_models", &mapper->max_num_models);
@@ -496,6 +668,12 @@ void OptionManager::AddMapperOptions() {
   AddAndRegisterDefaultOption("Mapper.init_image_id2", &mapper->init_image_id2);
   AddAndRegisterDefaultOption("Mapper.init_num_trials",
                               &mapper->init_num_trials);
+  AddAndRegisterDefaultOption("Mapper.num_parallel_models",
+                              &mapper->num_parallel_models);
+  AddAndRegisterDefaultOption("Mapper.num_parallel_reg_images",
+                              &mapper->num_parallel_reg_images);
+  AddAndRegisterDefaultOption("Mapper.tri_partition_max_num_images",
+                              &mapper->tri_partition_max_num_images);
   AddAndRegisterDefaultOption("Mapper.extract_colors", &mapper->extract_colors);
   AddAndRegisterDefaultOption("Mapper.num_threads", &mapper->num_threads);
   AddAndRegisterDefaultOption("Mapper.min_focal_length_ratio",
@@ -513,6 +691,17 @@ void OptionManager::AddMapperOptions() {
   AddAndRegisterDefaultOption(
       "Mapper.ba_min_num_residuals_for_multi_threading",
       &mapper->ba_min_num_residuals_for_multi_threading);
+  AddAndRegisterDefaultOption("Mapper.ba_use_gpu", &mapper->ba_use_gpu);
+  AddAndRegisterDefaultOption("Mapper.ba_gpu_index", &mapper->ba_gpu_index);
+  AddAndRegisterDefaultOption("Mapper.ba_min_num_images_gpu_solver",
+                              &mapper->ba_min_num_images_gpu_solver);
+  AddAndRegisterDefaultOption("Mapper.ba_use_float_jacobians",
+                              &mapper->ba_use_float_jacobians);
+  AddAndRegisterDefaultOption(
+      "Mapper.ba_global_marginalize_constant_pose_points",
+      &mapper->ba_global_marginalize_constant_pose_points);
+  AddAndRegisterDefaultOption("Mapper.ba_global_reject_outliers_in_solver",
+                              &mapper->ba_global_reject_outliers_in_solver);
   AddAndRegisterDefaultOption("Mapper.ba_local_num_images",
                               &mapper->ba_local_num_images);
   AddAndRegisterDefaultOption("Mapper.ba_local_function_tolerance",
@@ -527,6 +716,10 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_global_images_freq);
   AddAndRegisterDefaultOption("Mapper.ba_global_points_freq",
                               &mapper->ba_global_points_freq);
+  AddAndRegisterDefaultOption("Mapper.ba_global_max_drift",
+                              &mapper->ba_global_max_drift);
+  AddAndRegisterDefaultOption("Mapper.ba_global_partial_max_images_ratio",
+                              &mapper->ba_global_partial_max_images_ratio);
   AddAndRegisterDefaultOption("Mapper.ba_global_function_tolerance",
                               &mapper->ba_global_function_tolerance);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_num_iterations",
@@ -542,8 +735,20 @@ void OptionManager::AddMapperOptions() {
   AddAndRegisterDefaultOption("Mapper.snapshot_path", &mapper->snapshot_path);
   AddAndRegisterDefaultOption("Mapper.snapshot_images_freq",
                               &mapper->snapshot_images_freq);
+  AddAndRegisterDefaultOption("Mapper.checkpoint_path",
+                              &mapper->checkpoint_path);
+  AddAndRegisterDefaultOption("Mapper.checkpoint_images_freq",
+                              &mapper->checkpoint_images_freq);
+  AddAndRegisterDefaultOption("Mapper.ba_telemetry_path",
+                              &mapper->ba_telemetry_path);
   AddAndRegisterDefaultOption("Mapper.fix_existing_images",
                               &mapper->fix_existing_images);
+  AddAndRegisterDefaultOption("Mapper.stream_new_images",
+                              &mapper->stream_new_images);
+  AddAndRegisterDefaultOption("Mapper.stream_poll_interval",
+                              &mapper->stream_poll_interval);
+  AddAndRegisterDefaultOption("Mapper.stream_max_idle_time",
+                              &mapper->stream_max_idle_time);
 
   // IncrementalMapper.
   AddAndRegisterDefaultOption("Mapper.init_min_num_inliers",
@@ -562,6 +767,11 @@ void OptionManager::AddMapperOptions() {
                               &mapper->mapper.abs_pose_min_num_inliers);
   AddAndRegisterDefaultOption("Mapper.abs_pose_min_inlier_ratio",
                               &mapper->mapper.abs_pose_min_inlier_ratio);
+  AddAndRegisterDefaultOption("Mapper.abs_pose_use_position_prior",
+                              &mapper->mapper.abs_pose_use_position_prior);
+  AddAndRegisterDefaultOption(
+      "Mapper.abs_pose_position_prior_max_error",
+      &mapper->mapper.abs_pose_position_prior_max_error);
   AddAndRegisterDefaultOption("Mapper.filter_max_reproj_error",
                               &mapper->mapper.filter_max_reproj_error);
   AddAndRegisterDefaultOption("Mapper.filter_min_tri_angle",
@@ -590,6 +800,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->triangulation.re_min_ratio);
   AddAndRegisterDefaultOption("Mapper.tri_re_max_trials",
                               &mapper->triangulation.re_max_trials);
+  AddAndRegisterDefaultOption("Mapper.tri_re_min_pose_change",
+                              &mapper->triangulation.re_min_pose_change);
   AddAndRegisterDefaultOption("Mapper.tri_min_angle",
                               &mapper->triangulation.min_angle);
   AddAndRegisterDefaultOption("Mapper.tri_ignore_two_view_tracks",
@@ -628,6 +840,16 @@ void OptionManager::AddPatchMatchStereoOptions() {
                               &patch_match_stereo->incident_angle_sigma);
   AddAndRegisterDefaultOption("PatchMatchStereo.num_iterations",
                               &patch_match_stereo->num_iterations);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_pyramid_levels",
+                              &patch_match_stereo->num_pyramid_levels);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_pyramid_iterations",
+                              &patch_match_stereo->num_pyramid_iterations);
+  AddAndRegisterDefaultOption("PatchMatchStereo.init_from_sparse_points",
+                              &patch_match_stereo->init_from_sparse_points);
+  AddAndRegisterDefaultOption("PatchMatchStereo.init_from_src_maps",
+                              &patch_match_stereo->init_from_src_maps);
+  AddAndRegisterDefaultOption("PatchMatchStereo.init_radius",
+                              &patch_match_stereo->init_radius);
   AddAndRegisterDefaultOption("PatchMatchStereo.geom_consistency",
                               &patch_match_stereo->geom_consistency);
   AddAndRegisterDefaultOption(
@@ -649,10 +871,20 @@ void OptionManager::AddPatchMatchStereoOptions() {
       &patch_match_stereo->filter_geom_consistency_max_cost);
   AddAndRegisterDefaultOption("PatchMatchStereo.cache_size",
                               &patch_match_stereo->cache_size);
+  AddAndRegisterDefaultOption("PatchMatchStereo.gpu_cache_size",
+                              &patch_match_stereo->gpu_cache_size);
   AddAndRegisterDefaultOption("PatchMatchStereo.allow_missing_files",
                               &patch_match_stereo->allow_missing_files);
   AddAndRegisterDefaultOption("PatchMatchStereo.write_consistency_graph",
                               &patch_match_stereo->write_consistency_graph);
+  AddAndRegisterDefaultOption("PatchMatchStereo.map_file_format",
+                              &patch_match_stereo->map_file_format);
+  AddAndRegisterDefaultOption("PatchMatchStereo.bitmap_decoder",
+                              &patch_match_stereo->bitmap_decoder);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_problems_per_gpu",
+                              &patch_match_stereo->num_problems_per_gpu);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_prefetch_problems",
+                              &patch_match_stereo->num_prefetch_problems);
 }
 
 void OptionManager::AddStereoFusionOptions() {
@@ -685,6 +917,13 @@ void OptionManager::AddStereoFusionOptions() {
                               &stereo_fusion->cache_size);
   AddAndRegisterDefaultOption("StereoFusion.use_cache",
                               &stereo_fusion->use_cache);
+  AddAndRegisterDefaultOption("StereoFusion.bitmap_decoder",
+                              &stereo_fusion->bitmap_decoder);
+  AddAndRegisterDefaultOption("StereoFusion.use_gpu", &stereo_fusion->use_gpu);
+  AddAndRegisterDefaultOption("StereoFusion.gpu_index",
+                              &stereo_fusion->gpu_index);
+  AddAndRegisterDefaultOption("StereoFusion.max_num_tile_images",
+                              &stereo_fusion->max_num_tile_images);
 }
 
 void OptionManager::AddPoissonMeshingOptions() {
@@ -700,6 +939,12 @@ void OptionManager::AddPoissonMeshingOptions() {
   AddAndRegisterDefaultOption("PoissonMeshing.trim", &poisson_meshing->trim);
   AddAndRegisterDefaultOption("PoissonMeshing.num_threads",
                               &poisson_meshing->num_threads);
+  AddAndRegisterDefaultOption("PoissonMeshing.max_num_block_points",
+                              &poisson_meshing->max_num_block_points);
+  AddAndRegisterDefaultOption("PoissonMeshing.block_overlap",
+                              &poisson_meshing->block_overlap);
+  AddAndRegisterDefaultOption("PoissonMeshing.voxel_size",
+                              &poisson_meshing->voxel_size);
 }
 
 void OptionManager::AddDelaunayMeshingOptions() {
@@ -724,6 +969,8 @@ void OptionManager::AddDelaunayMeshingOptions() {
                               &delaunay_meshing->max_side_length_percentile);
   AddAndRegisterDefaultOption("DelaunayMeshing.num_threads",
                               &delaunay_meshing->num_threads);
+  AddAndRegisterDefaultOption("DelaunayMeshing.voxel_size",
+                              &delaunay_meshing->voxel_size);
 }
 
 void OptionManager::AddRenderOptions() {
@@ -734,6 +981,8 @@ void OptionManager::AddRenderOptions() {
 
   AddAndRegisterDefaultOption("Render.min_track_len", &render->min_track_len);
   AddAndRegisterDefaultOption("Render.max_error", &render->max_error);
+  AddAndRegisterDefaultOption("Render.max_num_points",
+                              &render->max_num_points);
   AddAndRegisterDefaultOption("Render.refresh_rate", &render->refresh_rate);
   AddAndRegisterDefaultOption("Render.adapt_refresh_rate",
                               &render->adapt_refresh_rate);
@@ -744,7 +993,7 @@ void OptionManager::AddRenderOptions() {
 }
 
 void OptionManager::Reset() {
-  std::cout << "reset option_manager,,, " << std::endl;
+  VLOG(1) << "reset option_manager";
 
   FLAGS_logtostderr = true;
 
@@ -767,6 +1016,7 @@ void OptionManager::Reset() {
   added_exhaustive_match_options_ = false;
   added_sequential_match_options_ = false;
   added_vocab_tree_match_options_ = false;
+  added_vlad_match_options_ = false;
   added_spatial_match_options_ = false;
   added_transitive_match_options_ = false;
   added_image_pairs_match_options_ = false;
@@ -784,6 +1034,8 @@ void OptionManager::ResetOptions(const bool reset_paths) {
     *project_path = "";
     *database_path = "";
     *image_path = "";
+    *profile_path = "";
+    *metrics_path = "";
   }
   *image_reader = ImageReaderOptions();
   *sift_extraction = SiftExtractionOptions();
@@ -791,10 +1043,12 @@ void OptionManager::ResetOptions(const bool reset_paths) {
   *exhaustive_matching = ExhaustiveMatchingOptions();
   *sequential_matching = SequentialMatchingOptions();
   *vocab_tree_matching = VocabTreeMatchingOptions();
+  *vlad_matching = VLADMatchingOptions();
   *spatial_matching = SpatialMatchingOptions();
   *transitive_matching = TransitiveMatchingOptions();
   *image_pairs_matching = ImagePairsMatchingOptions();
   *bundle_adjustment = BundleAdjustmentOptions();
+  *partitioned_bundle_adjustment = PartitionedBundleAdjustmentOptions();
   *mapper = IncrementalMapperOptions();
   *patch_match_stereo = mvs::PatchMatchOptions();
   *stereo_fusion = mvs::StereoFusionOptions();
@@ -824,11 +1078,14 @@ bool OptionManager::Check() {
   if (exhaustive_matching) success = success && exhaustive_matching->Check();
   if (sequential_matching) success = success && sequential_matching->Check();
   if (vocab_tree_matching) success = success && vocab_tree_matching->Check();
+  if (vlad_matching) success = success && vlad_matching->Check();
   if (spatial_matching) success = success && spatial_matching->Check();
   if (transitive_matching) success = success && transitive_matching->Check();
   if (image_pairs_matching) success = success && image_pairs_matching->Check();
 
   if (bundle_adjustment) success = success && bundle_adjustment->Check();
+  if (partitioned_bundle_adjustment)
+    success = success && partitioned_bundle_adjustment->Check();
   if (mapper) success = success && mapper->Check();
 
   if (patch_match_stereo) success = success && patch_match_stereo->Check();
@@ -845,7 +1102,7 @@ bool OptionManager::Check() {
 
 void OptionManager::Parse(const int argc, char** argv) {
   config::variables_map vmap;
-  std::cout << "parsing options,,, " << std::endl;
+  VLOG(1) << "parsing options";
   try {
     config::store(config::parse_command_line(argc, argv, *desc_), vmap);
     if (vmap.count("help")) {
@@ -883,6 +1140,20 @@ void OptionManager::Parse(const int argc, char** argv) {
     // NOLINTNEXTLINE(concurrency-mt-unsafe)
     exit(EXIT_FAILURE);
   }
+
+  if (*log_async) {
+    InstallAsyncFileLogging();
+  }
+
+  if (!profile_path->empty()) {
+    Profiler::Instance().Start(*profile_path);
+  }
+
+  if (!metrics_path->empty()) {
+    const double kMetricsDumpIntervalSeconds = 15;
+    MetricsRegistry::Instance().StartFileDump(*metrics_path,
+                                              kMetricsDumpIntervalSeconds);
+  }
 }
 
 bool OptionManager::Read(const std::string& path) {
@@ -44,10 +44,12 @@ struct TwoViewGeometryOptions;     // 视图几何参数
 struct ExhaustiveMatchingOptions;  // Exhaustive匹配参数
 struct SequentialMatchingOptions;  // Sequential匹配参数
 struct VocabTreeMatchingOptions;
+struct VLADMatchingOptions;
 struct SpatialMatchingOptions;
 struct TransitiveMatchingOptions;
 struct ImagePairsMatchingOptions;
 struct BundleAdjustmentOptions;   // BA参数
+struct PartitionedBundleAdjustmentOptions;
 struct IncrementalMapperOptions;  // incremental建图参数
 struct RenderOptions;
 
@@ -88,6 +90,7 @@ class OptionManager {
   void AddExhaustiveMatchingOptions();
   void AddSequentialMatchingOptions();
   void AddVocabTreeMatchingOptions();
+  void AddVLADMatchingOptions();
   void AddSpatialMatchingOptions();
   void AddTransitiveMatchingOptions();
   void AddImagePairsMatchingOptions();
@@ -123,6 +126,15 @@ class OptionManager {
   std::shared_ptr<std::string> project_path;
   std::shared_ptr<std::string> database_path;
   std::shared_ptr<std::string> image_path;
+  // Path to the Chrome trace of the profiled regions written after the
+  // command, or empty to disable profiling.
+  std::shared_ptr<std::string> profile_path;
+  // Path to the file, to which the metrics are periodically written in the
+  // Prometheus text format, or empty to disable the dump.
+  std::shared_ptr<std::string> metrics_path;
+  // Whether to write the log files asynchronously from a background thread,
+  // see `InstallAsyncFileLogging`.
+  std::shared_ptr<bool> log_async;
 
   std::shared_ptr<ImageReaderOptions> image_reader;
   std::shared_ptr<SiftExtractionOptions> sift_extraction;
@@ -132,11 +144,14 @@ class OptionManager {
   std::shared_ptr<ExhaustiveMatchingOptions> exhaustive_matching;
   std::shared_ptr<SequentialMatchingOptions> sequential_matching;
   std::shared_ptr<VocabTreeMatchingOptions> vocab_tree_matching;
+  std::shared_ptr<VLADMatchingOptions> vlad_matching;
   std::shared_ptr<SpatialMatchingOptions> spatial_matching;
   std::shared_ptr<TransitiveMatchingOptions> transitive_matching;
   std::shared_ptr<ImagePairsMatchingOptions> image_pairs_matching;
 
   std::shared_ptr<BundleAdjustmentOptions> bundle_adjustment;
+  std::shared_ptr<PartitionedBundleAdjustmentOptions>
+      partitioned_bundle_adjustment;
   std::shared_ptr<IncrementalMapperOptions> mapper;
 
   std::shared_ptr<mvs::PatchMatchOptions> patch_match_stereo;
@@ -179,6 +194,7 @@ class OptionManager {
   bool added_exhaustive_match_options_;
   bool added_sequential_match_options_;
   bool added_vocab_tree_match_options_;
+  bool added_vlad_match_options_;
   bool added_spatial_match_options_;
   bool added_transitive_match_options_;
   bool added_image_pairs_match_options_;
@@ -96,15 +96,15 @@ void P3PEstimator::Estimate(const std::vector<X_t>& points2D,
               (p * r + q * p2 - 2 * q) * b + (r * p + 2 * q) * a * b - 2 * q;
   coeffs(4) = a2 + b2 - 2 * a + (2 - p2) * b - 2 * a * b + 1;
 
-  Eigen::VectorXd roots_real;
-  Eigen::VectorXd roots_imag;
+  PolynomialRootsVector<4> roots_real;
+  PolynomialRootsVector<4> roots_imag;
   if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
     return;
   }
 
   models->reserve(roots_real.size());
 
-  for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
+  for (Eigen::Index i = 0; i < roots_real.size(); ++i) {
     const double kMaxRootImag = 1e-10;
     if (std::abs(roots_imag(i)) > kMaxRootImag) {
       continue;
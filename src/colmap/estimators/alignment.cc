@@ -31,33 +31,87 @@
 
 #include "colmap/estimators/similarity_transform.h"
 #include "colmap/geometry/pose.h"
+#include "colmap/math/random.h"
 #include "colmap/optim/loransac.h"
 #include "colmap/scene/projection.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
+#include <numeric>
 #include <unordered_map>
 
 namespace colmap {
 namespace {
 
+// Common image of the two reconstructions with the observations of the 2D
+// points that are triangulated in both reconstructions. The observations are
+// gathered once up front, so that the residuals are computed over contiguous
+// arrays instead of looking up the 3D points in every RANSAC iteration.
+struct CommonImageObservations {
+  Eigen::Vector3d src_proj_center;
+  Eigen::Vector3d tgt_proj_center;
+  Eigen::Matrix3x4d src_cam_from_world;
+  Eigen::Matrix3x4d tgt_cam_from_world;
+  const Camera* src_camera = nullptr;
+  const Camera* tgt_camera = nullptr;
+  std::vector<Eigen::Vector2d> src_points2D;
+  std::vector<Eigen::Vector2d> tgt_points2D;
+  std::vector<Eigen::Vector3d> src_points3D;
+  std::vector<Eigen::Vector3d> tgt_points3D;
+};
+
+CommonImageObservations GatherCommonImageObservations(
+    const Reconstruction& src_reconstruction,
+    const Reconstruction& tgt_reconstruction,
+    const Image& src_image,
+    const Image& tgt_image) {
+  THROW_CHECK_EQ(src_image.ImageId(), tgt_image.ImageId());
+  THROW_CHECK_EQ(src_image.NumPoints2D(), tgt_image.NumPoints2D());
+
+  CommonImageObservations observations;
+  observations.src_proj_center = src_image.ProjectionCenter();
+  observations.tgt_proj_center = tgt_image.ProjectionCenter();
+  observations.src_cam_from_world = src_image.CamFromWorld().ToMatrix();
+  observations.tgt_cam_from_world = tgt_image.CamFromWorld().ToMatrix();
+  observations.src_camera = &src_reconstruction.Camera(src_image.CameraId());
+  observations.tgt_camera = &tgt_reconstruction.Camera(tgt_image.CameraId());
+
+  for (point2D_t point2D_idx = 0; point2D_idx < src_image.NumPoints2D();
+       ++point2D_idx) {
+    // Check if both images have a 3D point.
+    const auto& src_point2D = src_image.Point2D(point2D_idx);
+    if (!src_point2D.HasPoint3D()) {
+      continue;
+    }
+    const auto& tgt_point2D = tgt_image.Point2D(point2D_idx);
+    if (!tgt_point2D.HasPoint3D()) {
+      continue;
+    }
+    observations.src_points2D.push_back(src_point2D.xy);
+    observations.tgt_points2D.push_back(tgt_point2D.xy);
+    observations.src_points3D.push_back(
+        src_reconstruction.Point3D(src_point2D.point3D_id).xyz);
+    observations.tgt_points3D.push_back(
+        tgt_reconstruction.Point3D(tgt_point2D.point3D_id).xyz);
+  }
+
+  return observations;
+}
+
 struct ReconstructionAlignmentEstimator {
   static const int kMinNumSamples = 3;
 
-  typedef const Image* X_t;
-  typedef const Image* Y_t;
+  typedef const CommonImageObservations* X_t;
+  typedef const CommonImageObservations* Y_t;
   typedef Sim3d M_t;
 
   void SetMaxReprojError(const double max_reproj_error) {
     max_squared_reproj_error_ = max_reproj_error * max_reproj_error;
   }
 
-  void SetReconstructions(const Reconstruction* src_reconstruction,
-                          const Reconstruction* tgt_reconstruction) {
-    THROW_CHECK_NOTNULL(src_reconstruction);
-    THROW_CHECK_NOTNULL(tgt_reconstruction);
-    src_reconstruction_ = src_reconstruction;
-    tgt_reconstruction_ = tgt_reconstruction;
-  }
+  // The residuals of the images are computed in parallel, if a thread pool
+  // is given.
+  void SetThreadPool(ThreadPool* thread_pool) { thread_pool_ = thread_pool; }
 
   // Estimate 3D similarity transform from corresponding projection centers.
   void Estimate(const std::vector<X_t>& src_images,
@@ -73,9 +127,9 @@ struct ReconstructionAlignmentEstimator {
     std::vector<Eigen::Vector3d> proj_centers1(src_images.size());
     std::vector<Eigen::Vector3d> proj_centers2(tgt_images.size());
     for (size_t i = 0; i < src_images.size(); ++i) {
-      THROW_CHECK_EQ(src_images[i]->ImageId(), tgt_images[i]->ImageId());
-      proj_centers1[i] = src_images[i]->ProjectionCenter();
-      proj_centers2[i] = tgt_images[i]->ProjectionCenter();
+      THROW_CHECK_EQ(src_images[i], tgt_images[i]);
+      proj_centers1[i] = src_images[i]->src_proj_center;
+      proj_centers2[i] = tgt_images[i]->tgt_proj_center;
     }
 
     Sim3d tgt_from_src;
@@ -97,90 +151,162 @@ struct ReconstructionAlignmentEstimator {
                  const M_t& tgt_from_src,
                  std::vector<double>* residuals) const {
     THROW_CHECK_EQ(src_images.size(), tgt_images.size());
-    THROW_CHECK_NOTNULL(src_reconstruction_);
-    THROW_CHECK_NOTNULL(tgt_reconstruction_);
 
-    const Sim3d srcFromTgt = Inverse(tgt_from_src);
+    const Sim3d src_from_tgt = Inverse(tgt_from_src);
 
     residuals->resize(src_images.size());
 
-    for (size_t i = 0; i < src_images.size(); ++i) {
-      const auto& src_image = *src_images[i];
-      const auto& tgt_image = *tgt_images[i];
-
-      THROW_CHECK_EQ(src_image.ImageId(), tgt_image.ImageId());
-
-      const auto& src_camera =
-          src_reconstruction_->Camera(src_image.CameraId());
-      const auto& tgt_camera =
-          tgt_reconstruction_->Camera(tgt_image.CameraId());
-
-      const Eigen::Matrix3x4d src_cam_from_world =
-          src_image.CamFromWorld().ToMatrix();
-      const Eigen::Matrix3x4d tgt_cam_from_world =
-          tgt_image.CamFromWorld().ToMatrix();
+    auto ComputeResiduals = [&](const size_t begin, const size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        THROW_CHECK_EQ(src_images[i], tgt_images[i]);
+        const CommonImageObservations& image = *src_images[i];
+
+        const size_t num_common_points = image.src_points3D.size();
+        size_t num_inliers = 0;
+        for (size_t j = 0; j < num_common_points; ++j) {
+          if (CalculateSquaredReprojectionError(
+                  image.tgt_points2D[j],
+                  tgt_from_src * image.src_points3D[j],
+                  image.tgt_cam_from_world,
+                  *image.tgt_camera) > max_squared_reproj_error_) {
+            continue;
+          }
+          if (CalculateSquaredReprojectionError(
+                  image.src_points2D[j],
+                  src_from_tgt * image.tgt_points3D[j],
+                  image.src_cam_from_world,
+                  *image.src_camera) > max_squared_reproj_error_) {
+            continue;
+          }
+          num_inliers += 1;
+        }
 
-      THROW_CHECK_EQ(src_image.NumPoints2D(), tgt_image.NumPoints2D());
+        if (num_common_points == 0) {
+          (*residuals)[i] = 1.0;
+        } else {
+          const double negative_inlier_ratio =
+              1.0 - static_cast<double>(num_inliers) /
+                        static_cast<double>(num_common_points);
+          (*residuals)[i] = negative_inlier_ratio * negative_inlier_ratio;
+        }
+      }
+    };
 
-      size_t num_inliers = 0;
-      size_t num_common_points = 0;
+    ParallelForChunks(thread_pool_,
+                      src_images.size(),
+                      /*min_chunk_size=*/16,
+                      ComputeResiduals);
+  }
 
-      for (point2D_t point2D_idx = 0; point2D_idx < src_image.NumPoints2D();
-           ++point2D_idx) {
-        // Check if both images have a 3D point.
+ private:
+  double max_squared_reproj_error_ = 0.0;
+  ThreadPool* thread_pool_ = nullptr;
+};
 
-        const auto& src_point2D = src_image.Point2D(point2D_idx);
-        if (!src_point2D.HasPoint3D()) {
-          continue;
-        }
+// Static k-d tree over 3D points for exact nearest neighbor queries within a
+// maximum distance. The tree is stored implicitly: The median of every range
+// of points is its splitting point, so the nodes need no child pointers.
+class PointKDTree {
+ public:
+  explicit PointKDTree(const std::vector<Eigen::Vector3d>& points)
+      : points_(points), idxs_(points.size()), split_dims_(points.size(), 0) {
+    std::iota(idxs_.begin(), idxs_.end(), 0);
+    Build(0, idxs_.size());
+    // Store the points in tree order for a cache friendly traversal.
+    for (size_t i = 0; i < idxs_.size(); ++i) {
+      points_[i] = points[idxs_[i]];
+    }
+  }
 
-        const auto& tgt_point2D = tgt_image.Point2D(point2D_idx);
-        if (!tgt_point2D.HasPoint3D()) {
-          continue;
-        }
+  // Returns the index of the point nearest to the query or -1, if there is no
+  // point within the maximum distance.
+  int64_t FindNearest(const Eigen::Vector3d& query,
+                      const double max_squared_distance) const {
+    int64_t nearest_idx = -1;
+    double nearest_squared_distance = max_squared_distance;
+    FindNearest(
+        0, idxs_.size(), query, &nearest_idx, &nearest_squared_distance);
+    return nearest_idx < 0 ? -1 : static_cast<int64_t>(idxs_[nearest_idx]);
+  }
 
-        num_common_points += 1;
+ private:
+  static constexpr size_t kMaxLeafSize = 8;
 
-        const Eigen::Vector3d src_point_in_tgt =
-            tgt_from_src *
-            src_reconstruction_->Point3D(src_point2D.point3D_id).xyz;
-        if (CalculateSquaredReprojectionError(tgt_point2D.xy,
-                                              src_point_in_tgt,
-                                              tgt_cam_from_world,
-                                              tgt_camera) >
-            max_squared_reproj_error_) {
-          continue;
-        }
+  void Build(const size_t begin, const size_t end) {
+    if (end - begin <= kMaxLeafSize) {
+      return;
+    }
 
-        const Eigen::Vector3d tgt_point_in_src =
-            srcFromTgt *
-            tgt_reconstruction_->Point3D(tgt_point2D.point3D_id).xyz;
-        if (CalculateSquaredReprojectionError(src_point2D.xy,
-                                              tgt_point_in_src,
-                                              src_cam_from_world,
-                                              src_camera) >
-            max_squared_reproj_error_) {
-          continue;
-        }
+    // Split along the dimension of largest extent to keep the cells compact.
+    Eigen::AlignedBox3d bbox;
+    for (size_t i = begin; i < end; ++i) {
+      bbox.extend(points_[idxs_[i]]);
+    }
+    int split_dim;
+    bbox.sizes().maxCoeff(&split_dim);
+
+    const size_t mid = begin + (end - begin) / 2;
+    std::nth_element(idxs_.begin() + begin,
+                     idxs_.begin() + mid,
+                     idxs_.begin() + end,
+                     [&](const size_t idx1, const size_t idx2) {
+                       return points_[idx1](split_dim) <
+                              points_[idx2](split_dim);
+                     });
+    split_dims_[mid] = split_dim;
+
+    Build(begin, mid);
+    Build(mid + 1, end);
+  }
 
-        num_inliers += 1;
+  void FindNearest(const size_t begin,
+                   const size_t end,
+                   const Eigen::Vector3d& query,
+                   int64_t* nearest_idx,
+                   double* nearest_squared_distance) const {
+    if (end - begin <= kMaxLeafSize) {
+      for (size_t i = begin; i < end; ++i) {
+        UpdateNearest(i, query, nearest_idx, nearest_squared_distance);
       }
+      return;
+    }
 
-      if (num_common_points == 0) {
-        (*residuals)[i] = 1.0;
-      } else {
-        const double negative_inlier_ratio =
-            1.0 - static_cast<double>(num_inliers) /
-                      static_cast<double>(num_common_points);
-        (*residuals)[i] = negative_inlier_ratio * negative_inlier_ratio;
+    const size_t mid = begin + (end - begin) / 2;
+    UpdateNearest(mid, query, nearest_idx, nearest_squared_distance);
+
+    // Descend into the side of the query first and only visit the other side,
+    // if the splitting plane is closer than the nearest point so far.
+    const double split_distance =
+        query(split_dims_[mid]) - points_[mid](split_dims_[mid]);
+    if (split_distance < 0) {
+      FindNearest(begin, mid, query, nearest_idx, nearest_squared_distance);
+      if (split_distance * split_distance <= *nearest_squared_distance) {
+        FindNearest(
+            mid + 1, end, query, nearest_idx, nearest_squared_distance);
+      }
+    } else {
+      FindNearest(mid + 1, end, query, nearest_idx, nearest_squared_distance);
+      if (split_distance * split_distance <= *nearest_squared_distance) {
+        FindNearest(begin, mid, query, nearest_idx, nearest_squared_distance);
       }
     }
   }
 
- private:
-  double max_squared_reproj_error_ = 0.0;
-  const Reconstruction* src_reconstruction_ = nullptr;
-  const Reconstruction* tgt_reconstruction_ = nullptr;
+  void UpdateNearest(const size_t i,
+                     const Eigen::Vector3d& query,
+                     int64_t* nearest_idx,
+                     double* nearest_squared_distance) const {
+    const double squared_distance = (points_[i] - query).squaredNorm();
+    if (squared_distance <= *nearest_squared_distance) {
+      *nearest_idx = static_cast<int64_t>(i);
+      *nearest_squared_distance = squared_distance;
+    }
+  }
+
+  // The points are in input order while building and in tree order after.
+  std::vector<Eigen::Vector3d> points_;
+  std::vector<size_t> idxs_;
+  std::vector<int> split_dims_;
 };
 
 }  // namespace
@@ -256,14 +382,6 @@ bool AlignReconstructionsViaReprojections(
   ransac_options.max_error = 1.0 - min_inlier_observations;
   ransac_options.min_inlier_ratio = 0.2;
 
-  LORANSAC<ReconstructionAlignmentEstimator, ReconstructionAlignmentEstimator>
-      ransac(ransac_options);
-  ransac.estimator.SetMaxReprojError(max_reproj_error);
-  ransac.estimator.SetReconstructions(&src_reconstruction, &tgt_reconstruction);
-  ransac.local_estimator.SetMaxReprojError(max_reproj_error);
-  ransac.local_estimator.SetReconstructions(&src_reconstruction,
-                                            &tgt_reconstruction);
-
   const std::vector<std::pair<image_t, image_t>> common_image_ids =
       src_reconstruction.FindCommonRegImageIds(tgt_reconstruction);
 
@@ -271,14 +389,36 @@ bool AlignReconstructionsViaReprojections(
     return false;
   }
 
-  std::vector<const Image*> src_images(common_image_ids.size());
-  std::vector<const Image*> tgt_images(common_image_ids.size());
-  for (size_t i = 0; i < common_image_ids.size(); ++i) {
-    src_images[i] = &src_reconstruction.Image(common_image_ids[i].first);
-    tgt_images[i] = &tgt_reconstruction.Image(common_image_ids[i].second);
+  ThreadPool thread_pool;
+
+  std::vector<CommonImageObservations> common_images(common_image_ids.size());
+  ParallelForChunks(
+      &thread_pool,
+      common_image_ids.size(),
+      /*min_chunk_size=*/4,
+      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          common_images[i] = GatherCommonImageObservations(
+              src_reconstruction,
+              tgt_reconstruction,
+              src_reconstruction.Image(common_image_ids[i].first),
+              tgt_reconstruction.Image(common_image_ids[i].second));
+        }
+      });
+
+  std::vector<const CommonImageObservations*> images(common_images.size());
+  for (size_t i = 0; i < common_images.size(); ++i) {
+    images[i] = &common_images[i];
   }
 
-  const auto report = ransac.Estimate(src_images, tgt_images);
+  LORANSAC<ReconstructionAlignmentEstimator, ReconstructionAlignmentEstimator>
+      ransac(ransac_options);
+  ransac.estimator.SetMaxReprojError(max_reproj_error);
+  ransac.estimator.SetThreadPool(&thread_pool);
+  ransac.local_estimator.SetMaxReprojError(max_reproj_error);
+  ransac.local_estimator.SetThreadPool(&thread_pool);
+
+  const auto report = ransac.Estimate(images, images);
 
   if (report.success) {
     *tgt_from_src = report.model;
@@ -354,41 +494,63 @@ bool AlignReconstructionsViaPoints(const Reconstruction& src_reconstruction,
   THROW_CHECK_GE(min_inlier_ratio, 0.0);
   THROW_CHECK_LE(min_inlier_ratio, 1.0);
 
-  std::vector<Eigen::Vector3d> src_xyz;
-  std::vector<Eigen::Vector3d> tgt_xyz;
-  std::unordered_map<point3D_t, size_t> counts;
-  // Associate 3D points using point2D_idx
+  std::vector<const Point3D*> src_points3D;
+  src_points3D.reserve(src_reconstruction.NumPoints3D());
   for (const auto& src_point3D : src_reconstruction.Points3D()) {
-    counts.clear();
-    // Count how often a 3D point in tgt is associated to this 3D point.
-    for (const auto& track_el : src_point3D.second.track.Elements()) {
-      if (!tgt_reconstruction.IsImageRegistered(track_el.image_id)) {
+    src_points3D.push_back(&src_point3D.second);
+  }
+
+  // Associate 3D points using point2D_idx. The points are associated in
+  // parallel chunks, which each count the associations for their points.
+  std::vector<point3D_t> tgt_point3D_ids(src_points3D.size(),
+                                         kInvalidPoint3DId);
+  auto AssociatePoints3D = [&](const size_t begin, const size_t end) {
+    std::unordered_map<point3D_t, size_t> counts;
+    for (size_t i = begin; i < end; ++i) {
+      counts.clear();
+      // Count how often a 3D point in tgt is associated to this 3D point.
+      for (const auto& track_el : src_points3D[i]->track.Elements()) {
+        if (!tgt_reconstruction.IsImageRegistered(track_el.image_id)) {
+          continue;
+        }
+        const Point2D& tgt_point2D =
+            tgt_reconstruction.Image(track_el.image_id)
+                .Point2D(track_el.point2D_idx);
+        if (tgt_point2D.HasPoint3D()) {
+          if (counts.find(tgt_point2D.point3D_id) != counts.end()) {
+            counts[tgt_point2D.point3D_id]++;
+          } else {
+            counts[tgt_point2D.point3D_id] = 0;
+          }
+        }
+      }
+      if (counts.empty()) {
         continue;
       }
-      const Point2D& tgt_point2D = tgt_reconstruction.Image(track_el.image_id)
-                                       .Point2D(track_el.point2D_idx);
-      if (tgt_point2D.HasPoint3D()) {
-        if (counts.find(tgt_point2D.point3D_id) != counts.end()) {
-          counts[tgt_point2D.point3D_id]++;
-        } else {
-          counts[tgt_point2D.point3D_id] = 0;
-        }
+      // The 3D point in tgt who is associated the most is selected
+      auto best_p3D =
+          std::max_element(counts.begin(),
+                           counts.end(),
+                           [](const std::pair<point3D_t, size_t>& p1,
+                              const std::pair<point3D_t, size_t>& p2) {
+                             return p1.second < p2.second;
+                           });
+      if (best_p3D->second >= min_common_observations) {
+        tgt_point3D_ids[i] = best_p3D->first;
       }
     }
-    if (counts.empty()) {
-      continue;
-    }
-    // The 3D point in tgt who is associated the most is selected
-    auto best_p3D =
-        std::max_element(counts.begin(),
-                         counts.end(),
-                         [](const std::pair<point3D_t, size_t>& p1,
-                            const std::pair<point3D_t, size_t>& p2) {
-                           return p1.second < p2.second;
-                         });
-    if (best_p3D->second >= min_common_observations) {
-      src_xyz.push_back(src_point3D.second.xyz);
-      tgt_xyz.push_back(tgt_reconstruction.Point3D(best_p3D->first).xyz);
+  };
+  ParallelForChunks(ThreadPool::kMaxNumThreads,
+                    src_points3D.size(),
+                    /*min_chunk_size=*/1024,
+                    AssociatePoints3D);
+
+  std::vector<Eigen::Vector3d> src_xyz;
+  std::vector<Eigen::Vector3d> tgt_xyz;
+  for (size_t i = 0; i < src_points3D.size(); ++i) {
+    if (tgt_point3D_ids[i] != kInvalidPoint3DId) {
+      src_xyz.push_back(src_points3D[i]->xyz);
+      tgt_xyz.push_back(tgt_reconstruction.Point3D(tgt_point3D_ids[i]).xyz);
     }
   }
   THROW_CHECK_EQ(src_xyz.size(), tgt_xyz.size());
@@ -401,11 +563,157 @@ bool AlignReconstructionsViaPoints(const Reconstruction& src_reconstruction,
   LORANSAC<SimilarityTransformEstimator<3, true>,
            SimilarityTransformEstimator<3, true>>
       ransac(ransac_options);
-  const auto report = ransac.Estimate(src_xyz, tgt_xyz);
-  if (report.success) {
-    *tgt_from_src = Sim3d::FromMatrix(report.model);
+
+  // Every RANSAC iteration evaluates all correspondences, so large models are
+  // coarsely aligned with a random subset of the correspondences. The coarse
+  // alignment is then refined and verified with all correspondences.
+  constexpr size_t kMaxNumCoarseCorrespondences = 10000;
+  if (src_xyz.size() <= kMaxNumCoarseCorrespondences) {
+    const auto report = ransac.Estimate(src_xyz, tgt_xyz);
+    if (report.success) {
+      *tgt_from_src = Sim3d::FromMatrix(report.model);
+    }
+    return report.success;
   }
-  return report.success;
+
+  std::vector<size_t> sample_idxs(src_xyz.size());
+  std::iota(sample_idxs.begin(), sample_idxs.end(), 0);
+  Shuffle(kMaxNumCoarseCorrespondences, &sample_idxs);
+  std::vector<Eigen::Vector3d> sample_src_xyz(kMaxNumCoarseCorrespondences);
+  std::vector<Eigen::Vector3d> sample_tgt_xyz(kMaxNumCoarseCorrespondences);
+  for (size_t i = 0; i < kMaxNumCoarseCorrespondences; ++i) {
+    sample_src_xyz[i] = src_xyz[sample_idxs[i]];
+    sample_tgt_xyz[i] = tgt_xyz[sample_idxs[i]];
+  }
+
+  const auto report = ransac.Estimate(sample_src_xyz, sample_tgt_xyz);
+  if (!report.success) {
+    return false;
+  }
+
+  const double max_squared_error = max_error * max_error;
+  Sim3d refined_tgt_from_src = Sim3d::FromMatrix(report.model);
+  std::vector<Eigen::Vector3d> inlier_src_xyz;
+  std::vector<Eigen::Vector3d> inlier_tgt_xyz;
+  // Alternate between collecting the inliers and re-estimating the transform
+  // from them, as in the local optimization of LO-RANSAC.
+  for (int iter = 0; iter < 2; ++iter) {
+    inlier_src_xyz.clear();
+    inlier_tgt_xyz.clear();
+    for (size_t i = 0; i < src_xyz.size(); ++i) {
+      if ((refined_tgt_from_src * src_xyz[i] - tgt_xyz[i]).squaredNorm() <=
+          max_squared_error) {
+        inlier_src_xyz.push_back(src_xyz[i]);
+        inlier_tgt_xyz.push_back(tgt_xyz[i]);
+      }
+    }
+    if (inlier_src_xyz.size() < 3 ||
+        inlier_src_xyz.size() < min_inlier_ratio * src_xyz.size()) {
+      return false;
+    }
+    Sim3d inlier_tgt_from_src;
+    if (!EstimateSim3d(inlier_src_xyz, inlier_tgt_xyz, inlier_tgt_from_src)) {
+      break;
+    }
+    refined_tgt_from_src = inlier_tgt_from_src;
+  }
+
+  *tgt_from_src = refined_tgt_from_src;
+  return true;
+}
+
+bool RefineAlignmentViaNearestPoints(
+    const std::vector<Eigen::Vector3d>& src_points,
+    const std::vector<Eigen::Vector3d>& tgt_points,
+    const double max_distance,
+    const int max_num_iterations,
+    Sim3d* tgt_from_src) {
+  THROW_CHECK_GT(max_distance, 0.0);
+  THROW_CHECK_GT(max_num_iterations, 0);
+  THROW_CHECK_NOTNULL(tgt_from_src);
+
+  if (src_points.size() < 3 || tgt_points.size() < 3) {
+    return false;
+  }
+
+  const PointKDTree tgt_tree(tgt_points);
+  const double max_squared_distance = max_distance * max_distance;
+
+  ThreadPool thread_pool;
+
+  // Nearest target point of each source point or -1, if there is none.
+  std::vector<int64_t> nearest_idxs(src_points.size(), -1);
+  std::vector<int64_t> prev_nearest_idxs;
+  std::vector<Eigen::Vector3d> matched_src_points;
+  std::vector<Eigen::Vector3d> matched_tgt_points;
+  Sim3d refined_tgt_from_src = *tgt_from_src;
+
+  for (int iter = 0; iter < max_num_iterations; ++iter) {
+    ParallelForChunks(&thread_pool,
+                      src_points.size(),
+                      /*min_chunk_size=*/1024,
+                      [&](const size_t begin, const size_t end) {
+                        for (size_t i = begin; i < end; ++i) {
+                          nearest_idxs[i] = tgt_tree.FindNearest(
+                              refined_tgt_from_src * src_points[i],
+                              max_squared_distance);
+                        }
+                      });
+
+    // The transform no longer changes once the associations are stable.
+    if (nearest_idxs == prev_nearest_idxs) {
+      break;
+    }
+
+    matched_src_points.clear();
+    matched_tgt_points.clear();
+    for (size_t i = 0; i < src_points.size(); ++i) {
+      if (nearest_idxs[i] >= 0) {
+        matched_src_points.push_back(src_points[i]);
+        matched_tgt_points.push_back(tgt_points[nearest_idxs[i]]);
+      }
+    }
+
+    Sim3d iter_tgt_from_src;
+    if (matched_src_points.size() < 3 ||
+        !EstimateSim3d(
+            matched_src_points, matched_tgt_points, iter_tgt_from_src)) {
+      return false;
+    }
+    refined_tgt_from_src = iter_tgt_from_src;
+
+    std::swap(nearest_idxs, prev_nearest_idxs);
+    nearest_idxs.resize(src_points.size());
+  }
+
+  VLOG(2) << "Aligned " << matched_src_points.size() << " / "
+          << src_points.size() << " points to their nearest neighbors.";
+
+  *tgt_from_src = refined_tgt_from_src;
+  return true;
+}
+
+bool RefineReconstructionAlignmentViaNearestPoints(
+    const Reconstruction& src_reconstruction,
+    const Reconstruction& tgt_reconstruction,
+    const double max_distance,
+    const int max_num_iterations,
+    Sim3d* tgt_from_src) {
+  std::vector<Eigen::Vector3d> src_points;
+  src_points.reserve(src_reconstruction.NumPoints3D());
+  for (const auto& point3D : src_reconstruction.Points3D()) {
+    src_points.push_back(point3D.second.xyz);
+  }
+  std::vector<Eigen::Vector3d> tgt_points;
+  tgt_points.reserve(tgt_reconstruction.NumPoints3D());
+  for (const auto& point3D : tgt_reconstruction.Points3D()) {
+    tgt_points.push_back(point3D.second.xyz);
+  }
+  return RefineAlignmentViaNearestPoints(src_points,
+                                         tgt_points,
+                                         max_distance,
+                                         max_num_iterations,
+                                         tgt_from_src);
 }
 
 bool MergeReconstructions(const double max_reproj_error,
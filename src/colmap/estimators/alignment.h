@@ -68,7 +68,9 @@ bool AlignReconstructionsViaProjCenters(
 
 // Robustly compute the alignment between reconstructions that share the
 // same 2D points. It is estimated by minimizing the 3D distance between
-// corresponding 3D points.
+// corresponding 3D points. For large reconstructions, the alignment is
+// coarsely estimated from a random subset of the correspondences and then
+// refined with all correspondences.
 bool AlignReconstructionsViaPoints(const Reconstruction& src_reconstruction,
                                    const Reconstruction& tgt_reconstruction,
                                    size_t min_common_observations,
@@ -76,6 +78,27 @@ bool AlignReconstructionsViaPoints(const Reconstruction& src_reconstruction,
                                    double min_inlier_ratio,
                                    Sim3d* tgt_from_src);
 
+// Refine an initial alignment of the source to the target points using the
+// iterative closest point method. In each iteration, the transformed source
+// points are associated with their nearest target points within max_distance
+// and the alignment is re-estimated from these associations. In contrast to
+// the above methods, this requires no corresponding images or tracks, but
+// only converges from a sufficiently accurate initial alignment.
+bool RefineAlignmentViaNearestPoints(
+    const std::vector<Eigen::Vector3d>& src_points,
+    const std::vector<Eigen::Vector3d>& tgt_points,
+    double max_distance,
+    int max_num_iterations,
+    Sim3d* tgt_from_src);
+
+// Same as above for the 3D points of two reconstructions.
+bool RefineReconstructionAlignmentViaNearestPoints(
+    const Reconstruction& src_reconstruction,
+    const Reconstruction& tgt_reconstruction,
+    double max_distance,
+    int max_num_iterations,
+    Sim3d* tgt_from_src);
+
 // Compute image alignment errors in the target coordinate frame.
 struct ImageAlignmentError {
   std::string image_name;
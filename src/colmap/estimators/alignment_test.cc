@@ -116,4 +116,65 @@ TEST(Alignment, AlignReconstructionsViaPoints) {
   ExpectEqualSim3d(gt_tgt_from_src, tgt_from_src);
 }
 
+TEST(Alignment, AlignReconstructionsViaPointsCoarseToFine) {
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 10;
+  synthetic_dataset_options.num_points3D = 12000;
+  synthetic_dataset_options.point2D_stddev = 0;
+  Reconstruction src_reconstruction;
+  SynthesizeDataset(synthetic_dataset_options, &src_reconstruction);
+  Reconstruction tgt_reconstruction = src_reconstruction;
+
+  Sim3d gt_tgt_from_src = TestSim3d();
+  tgt_reconstruction.Transform(gt_tgt_from_src);
+
+  Sim3d tgt_from_src;
+  THROW_CHECK(AlignReconstructionsViaPoints(src_reconstruction,
+                                            tgt_reconstruction,
+                                            /*min_common_observations=*/3,
+                                            /*max_error=*/0.01,
+                                            /*min_inlier_ratio=*/0.9,
+                                            &tgt_from_src));
+  ExpectEqualSim3d(gt_tgt_from_src, tgt_from_src);
+}
+
+TEST(Alignment, RefineAlignmentViaNearestPoints) {
+  SetPRNGSeed(0);
+  std::vector<Eigen::Vector3d> src_points(1000);
+  for (auto& src_point : src_points) {
+    src_point = Eigen::Vector3d::Random();
+  }
+  const Sim3d gt_tgt_from_src(
+      1.5,
+      Eigen::Quaterniond(Eigen::AngleAxisd(0.02, Eigen::Vector3d::UnitZ())),
+      Eigen::Vector3d(0.1, -0.2, 0.05));
+  // The target points are in reverse order, so there is no correspondence by
+  // index and the points must be associated by their distance.
+  std::vector<Eigen::Vector3d> tgt_points;
+  for (const auto& src_point : src_points) {
+    tgt_points.push_back(gt_tgt_from_src * src_point);
+  }
+  std::reverse(tgt_points.begin(), tgt_points.end());
+
+  const Sim3d init_tgt_from_src(1.49,
+                                Eigen::Quaterniond::Identity(),
+                                Eigen::Vector3d(0.11, -0.19, 0.05));
+
+  Sim3d tgt_from_src = init_tgt_from_src;
+  EXPECT_TRUE(RefineAlignmentViaNearestPoints(src_points,
+                                              tgt_points,
+                                              /*max_distance=*/0.2,
+                                              /*max_num_iterations=*/100,
+                                              &tgt_from_src));
+  ExpectEqualSim3d(gt_tgt_from_src, tgt_from_src);
+
+  tgt_from_src = init_tgt_from_src;
+  EXPECT_FALSE(RefineAlignmentViaNearestPoints(src_points,
+                                               tgt_points,
+                                               /*max_distance=*/1e-6,
+                                               /*max_num_iterations=*/100,
+                                               &tgt_from_src));
+}
+
 }  // namespace colmap
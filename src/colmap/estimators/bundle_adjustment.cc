@@ -31,15 +31,137 @@
 
 #include "colmap/estimators/cost_functions.h"
 #include "colmap/estimators/manifold.h"
+#include "colmap/scene/database.h"
 #include "colmap/scene/projection.h"
+#include "colmap/scene/scene_clustering.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
 
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/util/cuda.h"
+#endif  // COLMAP_CUDA_ENABLED
+
+#include <atomic>
+#include <functional>
 #include <iomanip>
+#include <map>
+
+#include <Eigen/Dense>
+
+// The CUDA backends of Ceres for the dense and sparse Schur complement solvers.
+#if !defined(CERES_NO_CUDA) && \
+    (CERES_VERSION_MAJOR >= 3 ||  \
+     (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2))
+#define COLMAP_CERES_CUDA_DENSE_ENABLED
+#endif
+#if !defined(CERES_NO_CUDA) && !defined(CERES_NO_CUDSS) && \
+    (CERES_VERSION_MAJOR >= 3 ||                           \
+     (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 3))
+#define COLMAP_CERES_CUDA_SPARSE_ENABLED
+#endif
 
 namespace colmap {
+namespace {
+
+std::string SolverTerminationToString(
+    const ceres::TerminationType termination_type) {
+  switch (termination_type) {
+    case ceres::CONVERGENCE:
+      return "Convergence";
+    case ceres::NO_CONVERGENCE:
+      return "No convergence";
+    case ceres::FAILURE:
+      return "Failure";
+    case ceres::USER_SUCCESS:
+      return "User success";
+    case ceres::USER_FAILURE:
+      return "User failure";
+    default:
+      return "Unknown";
+  }
+}
+
+std::string EscapeJsonString(const std::string& str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += StringPrintf("\\u%04x", c);
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+class FunctionIterationCallback : public ceres::IterationCallback {
+ public:
+  explicit FunctionIterationCallback(
+      std::function<void(const ceres::IterationSummary&)> func)
+      : func_(std::move(func)) {}
+
+  ceres::CallbackReturnType operator()(
+      const ceres::IterationSummary& summary) override {
+    func_(summary);
+    return ceres::SOLVER_CONTINUE;
+  }
+
+ private:
+  const std::function<void(const ceres::IterationSummary&)> func_;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// BundleAdjustmentTelemetry
+////////////////////////////////////////////////////////////////////////////////
+
+std::string BundleAdjustmentTelemetry::ToJson() const {
+  std::ostringstream json;
+  json << std::setprecision(9);
+  json << "{\"label\":\"" << EscapeJsonString(label) << "\"";
+  json << ",\"setup_time\":" << setup_time;
+  json << ",\"preprocessor_time\":" << preprocessor_time;
+  json << ",\"residual_evaluation_time\":" << residual_evaluation_time;
+  json << ",\"jacobian_evaluation_time\":" << jacobian_evaluation_time;
+  json << ",\"linear_solver_time\":" << linear_solver_time;
+  json << ",\"minimizer_time\":" << minimizer_time;
+  json << ",\"total_time\":" << total_time;
+  json << ",\"num_images\":" << num_images;
+  json << ",\"num_points\":" << num_points;
+  json << ",\"num_residuals\":" << num_residuals;
+  json << ",\"num_residual_blocks\":" << num_residual_blocks;
+  json << ",\"num_parameters\":" << num_parameters;
+  json << ",\"num_parameter_blocks\":" << num_parameter_blocks;
+  json << ",\"num_threads\":" << num_threads;
+  json << ",\"num_iterations\":" << num_iterations;
+  json << ",\"num_successful_iterations\":" << num_successful_iterations;
+  json << ",\"initial_error\":" << initial_error;
+  json << ",\"final_error\":" << final_error;
+  json << ",\"termination\":\"" << EscapeJsonString(termination) << "\"";
+  json << ",\"iterations\":[";
+  for (size_t i = 0; i < iterations.size(); ++i) {
+    const Iteration& iteration = iterations[i];
+    if (i > 0) {
+      json << ",";
+    }
+    json << "{\"error\":" << iteration.error;
+    json << ",\"time\":" << iteration.time;
+    json << ",\"linear_solver_time\":" << iteration.linear_solver_time;
+    json << ",\"num_linear_solver_iterations\":"
+         << iteration.num_linear_solver_iterations;
+    json << ",\"successful\":" << (iteration.successful ? "true" : "false");
+    json << "}";
+  }
+  json << "]}";
+  return json.str();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // BundleAdjustmentOptions
@@ -64,6 +186,12 @@ ceres::LossFunction* BundleAdjustmentOptions::CreateLossFunction() const {
 
 bool BundleAdjustmentOptions::Check() const {
   CHECK_OPTION_GE(loss_function_scale, 0);
+  CHECK_OPTION_GE(min_num_images_gpu_solver, 0);
+  CHECK_OPTION_GE(max_num_images_direct_dense_cpu_solver, 0);
+  CHECK_OPTION_GE(max_num_images_direct_sparse_cpu_solver, 0);
+  CHECK_OPTION_GE(max_num_images_direct_dense_gpu_solver, 0);
+  CHECK_OPTION_GE(max_num_images_direct_sparse_gpu_solver, 0);
+  CHECK_OPTION_GE(outlier_max_reproj_error, 0);
   return true;
 }
 
@@ -256,10 +384,266 @@ void BundleAdjustmentConfig::RemoveConstantPoint(const point3D_t point3D_id) {
   constant_point3D_ids_.erase(point3D_id);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// BundleAdjustmentCostFunctionPool
+////////////////////////////////////////////////////////////////////////////////
+
+BundleAdjustmentCostFunctionPool::BundleAdjustmentCostFunctionPool(
+    const size_t max_num_images)
+    : max_num_images_(max_num_images) {}
+
+ceres::CostFunction* BundleAdjustmentCostFunctionPool::Get(
+    const image_t image_id,
+    const point2D_t point2D_idx,
+    const CameraModelId camera_model_id,
+    const Eigen::Vector2d& point2D) {
+  auto it = images_.find(image_id);
+  if (it == images_.end()) {
+    lru_image_ids_.push_front(image_id);
+    it = images_.emplace(image_id, ImageCostFunctions()).first;
+    it->second.lru_it = lru_image_ids_.begin();
+  } else if (it->second.lru_it != lru_image_ids_.begin()) {
+    lru_image_ids_.splice(
+        lru_image_ids_.begin(), lru_image_ids_, it->second.lru_it);
+  }
+
+  auto& cost_functions = it->second.cost_functions;
+  if (cost_functions.size() <= point2D_idx) {
+    cost_functions.resize(point2D_idx + 1);
+  }
+  auto& cost_function = cost_functions[point2D_idx];
+  if (!cost_function) {
+    cost_function.reset(CameraCostFunction<DefaultReprojErrorCostFunction>(
+        camera_model_id, point2D, float_jacobians_));
+  }
+  return cost_function.get();
+}
+
+void BundleAdjustmentCostFunctionPool::SetFloatJacobians(
+    const bool float_jacobians) {
+  if (float_jacobians != float_jacobians_) {
+    Clear();
+    float_jacobians_ = float_jacobians;
+  }
+}
+
+void BundleAdjustmentCostFunctionPool::Trim() {
+  while (lru_image_ids_.size() > max_num_images_) {
+    images_.erase(lru_image_ids_.back());
+    lru_image_ids_.pop_back();
+  }
+}
+
+size_t BundleAdjustmentCostFunctionPool::NumImages() const {
+  return images_.size();
+}
+
+void BundleAdjustmentCostFunctionPool::Clear() {
+  lru_image_ids_.clear();
+  images_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BundleAdjustmentMarginalizationCache
+////////////////////////////////////////////////////////////////////////////////
+
+const BundleAdjustmentMarginalizationCache::PointPrior*
+BundleAdjustmentMarginalizationCache::Get(
+    const point3D_t point3D_id,
+    const TrackElements& track,
+    const std::vector<camera_t>& camera_ids) const {
+  const auto it = priors_.find(point3D_id);
+  if (it == priors_.end() || it->second.camera_ids != camera_ids ||
+      it->second.track.size() != track.size()) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < track.size(); ++i) {
+    if (it->second.track[i].image_id != track[i].image_id ||
+        it->second.track[i].point2D_idx != track[i].point2D_idx) {
+      return nullptr;
+    }
+  }
+  return &it->second;
+}
+
+void BundleAdjustmentMarginalizationCache::Set(const point3D_t point3D_id,
+                                               PointPrior prior) {
+  priors_[point3D_id] = std::move(prior);
+}
+
+void BundleAdjustmentMarginalizationCache::Retain(
+    const std::unordered_set<point3D_t>& point3D_ids) {
+  for (auto it = priors_.begin(); it != priors_.end();) {
+    if (point3D_ids.count(it->first) == 0) {
+      it = priors_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t BundleAdjustmentMarginalizationCache::NumPoints() const {
+  return priors_.size();
+}
+
+void BundleAdjustmentMarginalizationCache::Clear() { priors_.clear(); }
+
 ////////////////////////////////////////////////////////////////////////////////
 // BundleAdjuster
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Gauss-Newton approximation of the reprojection errors of a point, whose
+// observations all have constant camera poses, w.r.t. the point and the given
+// variable cameras. The robust loss is accounted for by scaling the residuals
+// and Jacobians with the square root of its first derivative.
+struct PointLinearization {
+  double cost = 0;
+  Eigen::Matrix3d H_pp = Eigen::Matrix3d::Zero();
+  Eigen::Vector3d g_p = Eigen::Vector3d::Zero();
+  // Blocks of the variable cameras, which are independent of each other.
+  std::vector<Eigen::MatrixXd> H_pc;
+  std::vector<Eigen::MatrixXd> H_cc;
+  std::vector<Eigen::VectorXd> g_c;
+};
+
+std::vector<std::unique_ptr<ceres::CostFunction>> CreatePointCostFunctions(
+    Reconstruction* reconstruction, const Point3D& point3D) {
+  std::vector<std::unique_ptr<ceres::CostFunction>> cost_functions;
+  cost_functions.reserve(point3D.track.Length());
+  for (const auto& track_el : point3D.track.Elements()) {
+    Image& image = reconstruction->Image(track_el.image_id);
+    // CostFunction assumes unit quaternions.
+    image.CamFromWorld().rotation.normalize();
+    cost_functions.emplace_back(
+        CameraCostFunction<DefaultReprojErrorConstantPoseCostFunction>(
+            reconstruction->Camera(image.CameraId()).model_id,
+            image.CamFromWorld(),
+            image.Point2D(track_el.point2D_idx).xy));
+  }
+  return cost_functions;
+}
+
+bool LinearizePoint(
+    const Reconstruction& reconstruction,
+    const Track& track,
+    const Eigen::Vector3d& xyz,
+    const std::vector<camera_t>& camera_ids,
+    const std::vector<std::unique_ptr<ceres::CostFunction>>& cost_functions,
+    const ceres::LossFunction* loss_function,
+    PointLinearization* linearization) {
+  for (const camera_t camera_id : camera_ids) {
+    const int num_params = reconstruction.Camera(camera_id).params.size();
+    linearization->H_pc.push_back(Eigen::MatrixXd::Zero(3, num_params));
+    linearization->H_cc.push_back(
+        Eigen::MatrixXd::Zero(num_params, num_params));
+    linearization->g_c.push_back(Eigen::VectorXd::Zero(num_params));
+  }
+
+  for (size_t i = 0; i < track.Length(); ++i) {
+    const Image& image = reconstruction.Image(track.Element(i).image_id);
+    const Camera& camera = reconstruction.Camera(image.CameraId());
+    const double* parameters[2] = {xyz.data(), camera.params.data()};
+    Eigen::Vector2d residuals;
+    Eigen::Matrix<double, 2, 3, Eigen::RowMajor> J_p;
+    Eigen::Matrix<double, 2, Eigen::Dynamic, Eigen::RowMajor> J_c(
+        2, camera.params.size());
+    double* jacobians[2] = {J_p.data(), J_c.data()};
+    if (!cost_functions[i]->Evaluate(parameters, residuals.data(), jacobians)) {
+      return false;
+    }
+
+    const double squared_norm = residuals.squaredNorm();
+    double rho[3] = {squared_norm, 1, 0};
+    if (loss_function != nullptr) {
+      loss_function->Evaluate(squared_norm, rho);
+    }
+    linearization->cost += 0.5 * rho[0];
+    const double sqrt_rho1 = std::sqrt(rho[1]);
+    residuals *= sqrt_rho1;
+    J_p *= sqrt_rho1;
+    J_c *= sqrt_rho1;
+
+    linearization->H_pp += J_p.transpose() * J_p;
+    linearization->g_p += J_p.transpose() * residuals;
+    const auto camera_it =
+        std::find(camera_ids.begin(), camera_ids.end(), image.CameraId());
+    if (camera_it != camera_ids.end()) {
+      const size_t k = camera_it - camera_ids.begin();
+      linearization->H_pc[k] += J_p.transpose() * J_c;
+      linearization->H_cc[k] += J_c.transpose() * J_c;
+      linearization->g_c[k] += J_c.transpose() * residuals;
+    }
+  }
+
+  return true;
+}
+
+// Marginalize the point from its linearized reprojection errors by the Schur
+// complement, which yields the prior on the stacked variable camera parameters.
+bool ComputePointPrior(
+    Reconstruction* reconstruction,
+    const Point3D& point3D,
+    const std::vector<camera_t>& camera_ids,
+    const ceres::LossFunction* loss_function,
+    BundleAdjustmentMarginalizationCache::PointPrior* prior) {
+  PointLinearization linearization;
+  if (!LinearizePoint(*reconstruction,
+                      point3D.track,
+                      point3D.xyz,
+                      camera_ids,
+                      CreatePointCostFunctions(reconstruction, point3D),
+                      loss_function,
+                      &linearization)) {
+    return false;
+  }
+
+  // The point must be well constrained by its observations.
+  const double kMinEigenvalueRatio = 1e-12;
+  const Eigen::Vector3d eigenvalues =
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d>(linearization.H_pp,
+                                                     Eigen::EigenvaluesOnly)
+          .eigenvalues();
+  if (!eigenvalues.allFinite() ||
+      eigenvalues(0) <= kMinEigenvalueRatio * eigenvalues(2)) {
+    return false;
+  }
+
+  int num_params = 0;
+  for (const camera_t camera_id : camera_ids) {
+    num_params += reconstruction->Camera(camera_id).params.size();
+  }
+  Eigen::MatrixXd H_pc(3, num_params);
+  Eigen::MatrixXd H_cc = Eigen::MatrixXd::Zero(num_params, num_params);
+  Eigen::VectorXd g_c(num_params);
+  Eigen::VectorXd params(num_params);
+  int offset = 0;
+  for (size_t k = 0; k < camera_ids.size(); ++k) {
+    const std::vector<double>& camera_params =
+        reconstruction->Camera(camera_ids[k]).params;
+    const int size = camera_params.size();
+    H_pc.middleCols(offset, size) = linearization.H_pc[k];
+    H_cc.block(offset, offset, size, size) = linearization.H_cc[k];
+    g_c.segment(offset, size) = linearization.g_c[k];
+    params.segment(offset, size) =
+        Eigen::Map<const Eigen::VectorXd>(camera_params.data(), size);
+    offset += size;
+  }
+
+  const Eigen::LLT<Eigen::Matrix3d> H_pp_llt(linearization.H_pp);
+  prior->track = point3D.track.Elements();
+  prior->camera_ids = camera_ids;
+  prior->information = H_cc - H_pc.transpose() * H_pp_llt.solve(H_pc);
+  prior->information_vector =
+      prior->information * params -
+      (g_c - H_pc.transpose() * H_pp_llt.solve(linearization.g_p));
+  return true;
+}
+
+}  // namespace
+
+
 BundleAdjuster::BundleAdjuster(const BundleAdjustmentOptions& options,
                                const BundleAdjustmentConfig& config)
     : options_(options), config_(config) {
@@ -267,16 +651,26 @@ BundleAdjuster::BundleAdjuster(const BundleAdjustmentOptions& options,
 }
 
 bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
+  COLMAP_PROFILE_SCOPE("BundleAdjuster::Solve");
+  Timer timer;
+  timer.Start();
+
   loss_function_ =
       std::unique_ptr<ceres::LossFunction>(options_.CreateLossFunction());
   SetUpProblem(reconstruction, loss_function_.get());
+  const double setup_time = timer.ElapsedSeconds();
 
   if (problem_->NumResiduals() == 0) {
-    return false;
+    if (marginalized_point3D_ids_.empty()) {
+      return false;
+    }
+    RefineMarginalizedPoints(reconstruction, loss_function_.get());
+    return true;
   }
 
   ceres::Solver::Options solver_options =
       SetUpSolverOptions(*problem_, options_.solver_options);
+  SetUpOutlierRejection(&solver_options);
 
   ceres::Solve(solver_options, problem_.get(), &summary_);
 
@@ -284,6 +678,10 @@ bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
     PrintSolverSummary(summary_, "Bundle adjustment report");
   }
 
+  RefineMarginalizedPoints(reconstruction, loss_function_.get());
+
+  ReportTelemetry(setup_time, timer.ElapsedSeconds());
+
   return true;
 }
 
@@ -299,6 +697,27 @@ const ceres::Solver::Summary& BundleAdjuster::Summary() const {
   return summary_;
 }
 
+const BundleAdjustmentTelemetry& BundleAdjuster::Telemetry() const {
+  return telemetry_;
+}
+
+void BundleAdjuster::SetCostFunctionPool(
+    BundleAdjustmentCostFunctionPool* pool) {
+  THROW_CHECK(problem_ == nullptr);
+  cost_function_pool_ = pool;
+}
+
+void BundleAdjuster::SetMarginalizationCache(
+    BundleAdjustmentMarginalizationCache* cache) {
+  THROW_CHECK(problem_ == nullptr);
+  marginalization_cache_ = cache;
+}
+
+const std::unordered_set<point3D_t>& BundleAdjuster::MarginalizedPoints()
+    const {
+  return marginalized_point3D_ids_;
+}
+
 void BundleAdjuster::SetUpProblem(Reconstruction* reconstruction,
                                   ceres::LossFunction* loss_function) {
   THROW_CHECK_NOTNULL(reconstruction);
@@ -306,13 +725,60 @@ void BundleAdjuster::SetUpProblem(Reconstruction* reconstruction,
   // Initialize an empty problem
   ceres::Problem::Options problem_options;
   problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  if (cost_function_pool_ != nullptr) {
+    problem_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    cost_function_pool_->SetFloatJacobians(options_.use_float_jacobians);
+    cost_function_pool_->Trim();
+  }
   problem_ = std::make_shared<ceres::Problem>(problem_options);
+  observation_residuals_.clear();
+
+  MarginalizePoints(reconstruction, loss_function, [this](image_t image_id) {
+    return !config_.HasImage(image_id) || !options_.refine_extrinsics ||
+           config_.HasConstantCamPose(image_id);
+  });
+
+  // Create the cost functions of the images in parallel, if the problem is
+  // large enough to be solved with multiple threads. The problem is not
+  // thread-safe, so the residuals are added in the order of the images,
+  // resulting in the same problem as for serial construction.
+  const std::vector<image_t> image_ids(config_.Images().begin(),
+                                       config_.Images().end());
+  int num_observations = 0;
+  for (const image_t image_id : image_ids) {
+    num_observations += reconstruction->Image(image_id).NumPoints3D();
+  }
+  std::vector<ImageResiduals> image_residuals(image_ids.size());
+  const int num_threads =
+      num_observations < options_.min_num_residuals_for_multi_threading
+          ? 1
+          : std::min(
+                GetEffectiveNumThreads(options_.solver_options.num_threads),
+                static_cast<int>(image_ids.size()));
+  if (num_threads > 1) {
+    ThreadPool thread_pool(num_threads);
+    std::vector<std::future<void>> futures;
+    futures.reserve(image_ids.size());
+    for (size_t i = 0; i < image_ids.size(); ++i) {
+      futures.push_back(thread_pool.AddTask([&, i]() {
+        image_residuals[i] = CreateImageResiduals(image_ids[i], reconstruction);
+      }));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  } else {
+    for (size_t i = 0; i < image_ids.size(); ++i) {
+      image_residuals[i] = CreateImageResiduals(image_ids[i], reconstruction);
+    }
+  }
 
   // Set up problem
   // Warning: AddPointsToProblem assumes that AddImageToProblem is called first.
   // Do not change order of instructions!
-  for (const image_t image_id : config_.Images()) {
-    AddImageToProblem(image_id, reconstruction, loss_function);
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    AddImageToProblem(
+        image_ids[i], reconstruction, loss_function, image_residuals[i]);
   }
   for (const auto point3D_id : config_.VariablePoints()) {
     AddPointToProblem(point3D_id, reconstruction, loss_function);
@@ -332,13 +798,44 @@ ceres::Solver::Options BundleAdjuster::SetUpSolverOptions(
   const bool has_sparse =
       solver_options.sparse_linear_algebra_library_type != ceres::NO_SPARSE;
 
-  // Empirical choice.
-  const size_t kMaxNumImagesDirectDenseSolver = 50;
-  const size_t kMaxNumImagesDirectSparseSolver = 1000;
-  const size_t num_images = config_.NumImages();
-  if (num_images <= kMaxNumImagesDirectDenseSolver) {
+  const int num_images = static_cast<int>(config_.NumImages());
+
+  const bool use_gpu =
+      options_.use_gpu && num_images >= options_.min_num_images_gpu_solver;
+  bool cuda_solver_enabled = false;
+#if defined(COLMAP_CERES_CUDA_DENSE_ENABLED)
+  if (use_gpu &&
+      num_images <= options_.max_num_images_direct_dense_gpu_solver) {
+    solver_options.linear_solver_type = ceres::DENSE_SCHUR;
+    solver_options.dense_linear_algebra_library_type = ceres::CUDA;
+    cuda_solver_enabled = true;
+  }
+#else
+  if (options_.use_gpu) {
+    LOG_FIRST_N(WARNING, 1)
+        << "Requested to use GPU for bundle adjustment, but Ceres was "
+           "compiled without CUDA support. Falling back to CPU-based solvers.";
+  }
+#endif  // COLMAP_CERES_CUDA_DENSE_ENABLED
+#if defined(COLMAP_CERES_CUDA_SPARSE_ENABLED)
+  if (use_gpu && !cuda_solver_enabled &&
+      num_images <= options_.max_num_images_direct_sparse_gpu_solver) {
+    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+    solver_options.sparse_linear_algebra_library_type = ceres::CUDA_SPARSE;
+    cuda_solver_enabled = true;
+  }
+#endif  // COLMAP_CERES_CUDA_SPARSE_ENABLED
+
+  if (cuda_solver_enabled) {
+    const std::vector<int> gpu_indices = CSVToVector<int>(options_.gpu_index);
+    THROW_CHECK_GT(gpu_indices.size(), 0);
+#if defined(COLMAP_CUDA_ENABLED)
+    SetBestCudaDevice(gpu_indices[0]);
+#endif  // COLMAP_CUDA_ENABLED
+  } else if (num_images <= options_.max_num_images_direct_dense_cpu_solver) {
     solver_options.linear_solver_type = ceres::DENSE_SCHUR;
-  } else if (num_images <= kMaxNumImagesDirectSparseSolver && has_sparse) {
+  } else if (num_images <= options_.max_num_images_direct_sparse_cpu_solver &&
+             has_sparse) {
     solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
   } else {  // Indirect sparse (preconditioned CG) solver.
     solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
@@ -364,15 +861,54 @@ ceres::Solver::Options BundleAdjuster::SetUpSolverOptions(
   return solver_options;
 }
 
-void BundleAdjuster::AddImageToProblem(const image_t image_id,
-                                       Reconstruction* reconstruction,
-                                       ceres::LossFunction* loss_function) {
+BundleAdjuster::ImageResiduals BundleAdjuster::CreateImageResiduals(
+    const image_t image_id, Reconstruction* reconstruction) const {
   Image& image = reconstruction->Image(image_id);
-  Camera& camera = reconstruction->Camera(image.CameraId());
+  const Camera& camera = reconstruction->Camera(image.CameraId());
 
   // CostFunction assumes unit quaternions.
   image.CamFromWorld().rotation.normalize();
 
+  const bool constant_cam_pose =
+      !options_.refine_extrinsics || config_.HasConstantCamPose(image_id);
+
+  ImageResiduals residuals;
+  residuals.point2D_idxs.reserve(image.NumPoints3D());
+  residuals.cost_functions.reserve(image.NumPoints3D());
+  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+       ++point2D_idx) {
+    const Point2D& point2D = image.Point2D(point2D_idx);
+    if (!point2D.HasPoint3D() ||
+        marginalized_point3D_ids_.count(point2D.point3D_id) > 0) {
+      continue;
+    }
+
+    ceres::CostFunction* cost_function = nullptr;
+    if (constant_cam_pose) {
+      cost_function =
+          CameraCostFunction<DefaultReprojErrorConstantPoseCostFunction>(
+              camera.model_id,
+              image.CamFromWorld(),
+              point2D.xy,
+              options_.use_float_jacobians);
+    } else if (cost_function_pool_ == nullptr) {
+      cost_function = CameraCostFunction<DefaultReprojErrorCostFunction>(
+          camera.model_id, point2D.xy, options_.use_float_jacobians);
+    }
+    residuals.point2D_idxs.push_back(point2D_idx);
+    residuals.cost_functions.push_back(cost_function);
+  }
+
+  return residuals;
+}
+
+void BundleAdjuster::AddImageToProblem(const image_t image_id,
+                                       Reconstruction* reconstruction,
+                                       ceres::LossFunction* loss_function,
+                                       const ImageResiduals& residuals) {
+  Image& image = reconstruction->Image(image_id);
+  Camera& camera = reconstruction->Camera(image.CameraId());
+
   double* cam_from_world_rotation =
       image.CamFromWorld().rotation.coeffs().data();
   double* cam_from_world_translation = image.CamFromWorld().translation.data();
@@ -382,37 +918,38 @@ void BundleAdjuster::AddImageToProblem(const image_t image_id,
       !options_.refine_extrinsics || config_.HasConstantCamPose(image_id);
 
   // Add residuals to bundle adjustment problem.
-  size_t num_observations = 0;
-  for (const Point2D& point2D : image.Points2D()) {
-    if (!point2D.HasPoint3D()) {
-      continue;
-    }
+  for (size_t i = 0; i < residuals.point2D_idxs.size(); ++i) {
+    const point2D_t point2D_idx = residuals.point2D_idxs[i];
+    const Point2D& point2D = image.Point2D(point2D_idx);
 
-    num_observations += 1;
     point3D_num_observations_[point2D.point3D_id] += 1;
 
     Point3D& point3D = reconstruction->Point3D(point2D.point3D_id);
     assert(point3D.track.Length() > 1);
 
     if (constant_cam_pose) {
-      problem_->AddResidualBlock(
-          CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-              camera.model_id, image.CamFromWorld(), point2D.xy),
-          loss_function,
-          point3D.xyz.data(),
-          camera_params);
+      AddObservationResidualBlock(TrackElement(image_id, point2D_idx),
+                                  OwnCostFunction(residuals.cost_functions[i]),
+                                  loss_function,
+                                  point3D.xyz.data(),
+                                  camera_params);
     } else {
-      problem_->AddResidualBlock(CameraCostFunction<ReprojErrorCostFunction>(
-                                     camera.model_id, point2D.xy),
-                                 loss_function,
-                                 cam_from_world_rotation,
-                                 cam_from_world_translation,
-                                 point3D.xyz.data(),
-                                 camera_params);
+      ceres::CostFunction* cost_function =
+          residuals.cost_functions[i] != nullptr
+              ? residuals.cost_functions[i]
+              : cost_function_pool_->Get(
+                    image_id, point2D_idx, camera.model_id, point2D.xy);
+      AddObservationResidualBlock(TrackElement(image_id, point2D_idx),
+                                  cost_function,
+                                  loss_function,
+                                  cam_from_world_rotation,
+                                  cam_from_world_translation,
+                                  point3D.xyz.data(),
+                                  camera_params);
     }
   }
 
-  if (num_observations > 0) {
+  if (!residuals.point2D_idxs.empty()) {
     camera_ids_.insert(image.CameraId());
 
     // Set pose parameterization.
@@ -438,7 +975,8 @@ void BundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
   // Is 3D point already fully contained in the problem? I.e. its entire track
   // is contained in `variable_image_ids`, `constant_image_ids`,
   // `constant_x_image_ids`.
-  if (point3D_num_observations_[point3D_id] == point3D.track.Length()) {
+  if (marginalized_point3D_ids_.count(point3D_id) > 0 ||
+      point3D_num_observations_[point3D_id] == point3D.track.Length()) {
     return;
   }
 
@@ -464,15 +1002,28 @@ void BundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
       camera_ids_.insert(image.CameraId());
       config_.SetConstantCamIntrinsics(image.CameraId());
     }
-    problem_->AddResidualBlock(
-        CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-            camera.model_id, image.CamFromWorld(), point2D.xy),
+    AddObservationResidualBlock(
+        track_el,
+        OwnCostFunction(
+            CameraCostFunction<DefaultReprojErrorConstantPoseCostFunction>(
+                camera.model_id,
+                image.CamFromWorld(),
+                point2D.xy,
+                options_.use_float_jacobians)),
         loss_function,
         point3D.xyz.data(),
         camera.params.data());
   }
 }
 
+ceres::CostFunction* BundleAdjuster::OwnCostFunction(
+    ceres::CostFunction* cost_function) {
+  if (cost_function_pool_ != nullptr) {
+    owned_cost_functions_.emplace_back(cost_function);
+  }
+  return cost_function;
+}
+
 void BundleAdjuster::ParameterizeCameras(Reconstruction* reconstruction) {
   const bool constant_camera = !options_.refine_focal_length &&
                                !options_.refine_principal_point &&
@@ -512,6 +1063,338 @@ void BundleAdjuster::ParameterizeCameras(Reconstruction* reconstruction) {
   }
 }
 
+void BundleAdjuster::MarginalizePoints(
+    Reconstruction* reconstruction,
+    ceres::LossFunction* loss_function,
+    const std::function<bool(image_t)>& has_constant_cam_pose) {
+  marginalized_point3D_ids_.clear();
+  if (!options_.marginalize_constant_pose_points) {
+    return;
+  }
+
+  const bool constant_camera = !options_.refine_focal_length &&
+                               !options_.refine_principal_point &&
+                               !options_.refine_extra_params;
+  std::unordered_set<camera_t> variable_camera_ids;
+  if (!constant_camera) {
+    for (const image_t image_id : config_.Images()) {
+      const camera_t camera_id = reconstruction->Image(image_id).CameraId();
+      if (!config_.HasConstantCamIntrinsics(camera_id)) {
+        variable_camera_ids.insert(camera_id);
+      }
+    }
+  }
+
+  // Accumulate the priors of the marginalized points per set of variable
+  // cameras in the absolute form 0.5 x^T H x - b^T x.
+  std::map<std::vector<camera_t>, std::pair<Eigen::MatrixXd, Eigen::VectorXd>>
+      priors;
+  std::unordered_set<point3D_t> rejected_point3D_ids;
+  for (const image_t image_id : config_.Images()) {
+    for (const Point2D& point2D : reconstruction->Image(image_id).Points2D()) {
+      const point3D_t point3D_id = point2D.point3D_id;
+      if (!point2D.HasPoint3D() || config_.HasConstantPoint(point3D_id) ||
+          marginalized_point3D_ids_.count(point3D_id) > 0 ||
+          rejected_point3D_ids.count(point3D_id) > 0) {
+        continue;
+      }
+
+      const Point3D& point3D = reconstruction->Point3D(point3D_id);
+      bool constant_cam_poses = true;
+      std::vector<camera_t> camera_ids;
+      for (const auto& track_el : point3D.track.Elements()) {
+        if (!has_constant_cam_pose(track_el.image_id)) {
+          constant_cam_poses = false;
+          break;
+        }
+        const camera_t camera_id =
+            reconstruction->Image(track_el.image_id).CameraId();
+        if (variable_camera_ids.count(camera_id) > 0) {
+          camera_ids.push_back(camera_id);
+        }
+      }
+      if (!constant_cam_poses) {
+        rejected_point3D_ids.insert(point3D_id);
+        continue;
+      }
+      std::sort(camera_ids.begin(), camera_ids.end());
+      camera_ids.erase(std::unique(camera_ids.begin(), camera_ids.end()),
+                       camera_ids.end());
+
+      const BundleAdjustmentMarginalizationCache::PointPrior* prior =
+          marginalization_cache_ == nullptr
+              ? nullptr
+              : marginalization_cache_->Get(
+                    point3D_id, point3D.track.Elements(), camera_ids);
+      BundleAdjustmentMarginalizationCache::PointPrior new_prior;
+      if (prior == nullptr) {
+        if (!ComputePointPrior(reconstruction,
+                               point3D,
+                               camera_ids,
+                               loss_function,
+                               &new_prior)) {
+          rejected_point3D_ids.insert(point3D_id);
+          continue;
+        }
+        prior = &new_prior;
+      }
+
+      marginalized_point3D_ids_.insert(point3D_id);
+      if (!camera_ids.empty()) {
+        auto& [information, information_vector] = priors[camera_ids];
+        if (information.size() == 0) {
+          information = prior->information;
+          information_vector = prior->information_vector;
+        } else {
+          information += prior->information;
+          information_vector += prior->information_vector;
+        }
+      }
+
+      if (marginalization_cache_ != nullptr && prior == &new_prior) {
+        marginalization_cache_->Set(point3D_id, std::move(new_prior));
+      }
+    }
+  }
+
+  if (marginalization_cache_ != nullptr) {
+    marginalization_cache_->Retain(marginalized_point3D_ids_);
+  }
+
+  // Add the priors in the square root form restricted to the observable
+  // subspace of the information matrix.
+  const double kMinEigenvalueRatio = 1e-12;
+  for (const auto& [camera_ids, prior] : priors) {
+    const auto& [information, information_vector] = prior;
+    const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigen_solver(
+        information);
+    const Eigen::VectorXd& eigenvalues = eigen_solver.eigenvalues();
+    const double min_eigenvalue =
+        kMinEigenvalueRatio * eigenvalues(eigenvalues.size() - 1);
+    int num_observable = 0;
+    while (num_observable < eigenvalues.size() &&
+           eigenvalues(eigenvalues.size() - 1 - num_observable) >
+               min_eigenvalue) {
+      ++num_observable;
+    }
+    if (num_observable == 0) {
+      continue;
+    }
+
+    // Eigenvalues are in ascending order.
+    const Eigen::MatrixXd eigenvectors =
+        eigen_solver.eigenvectors().rightCols(num_observable);
+    const Eigen::VectorXd observable_eigenvalues =
+        eigenvalues.tail(num_observable);
+    const Eigen::MatrixXd sqrt_information =
+        observable_eigenvalues.cwiseSqrt().asDiagonal() *
+        eigenvectors.transpose();
+    const Eigen::VectorXd mean =
+        eigenvectors * (observable_eigenvalues.cwiseInverse().asDiagonal() *
+                        (eigenvectors.transpose() * information_vector));
+
+    std::vector<double*> parameter_blocks;
+    std::vector<int> parameter_block_sizes;
+    for (const camera_t camera_id : camera_ids) {
+      Camera& camera = reconstruction->Camera(camera_id);
+      parameter_blocks.push_back(camera.params.data());
+      parameter_block_sizes.push_back(camera.params.size());
+      camera_ids_.insert(camera_id);
+    }
+    problem_->AddResidualBlock(
+        OwnCostFunction(LinearPriorCostFunction::Create(
+            sqrt_information, mean, parameter_block_sizes)),
+        nullptr,
+        parameter_blocks);
+  }
+
+  VLOG(2) << "Marginalized " << marginalized_point3D_ids_.size()
+          << " points with constant camera poses";
+}
+
+void BundleAdjuster::RefineMarginalizedPoints(
+    Reconstruction* reconstruction, const ceres::LossFunction* loss_function) {
+  const int kMaxNumIterations = 10;
+  const int kMaxNumStepHalvings = 5;
+  const double kMinRelativeStepSize = 1e-10;
+  for (const point3D_t point3D_id : marginalized_point3D_ids_) {
+    Point3D& point3D = reconstruction->Point3D(point3D_id);
+    const std::vector<std::unique_ptr<ceres::CostFunction>> cost_functions =
+        CreatePointCostFunctions(reconstruction, point3D);
+    PointLinearization linearization;
+    if (!LinearizePoint(*reconstruction,
+                        point3D.track,
+                        point3D.xyz,
+                        /*camera_ids=*/{},
+                        cost_functions,
+                        loss_function,
+                        &linearization)) {
+      continue;
+    }
+
+    // Gauss-Newton iterations with step halving until the cost decreases.
+    for (int i = 0; i < kMaxNumIterations; ++i) {
+      Eigen::Vector3d step =
+          -linearization.H_pp.ldlt().solve(linearization.g_p);
+      bool accepted = false;
+      for (int j = 0; j < kMaxNumStepHalvings && step.allFinite(); ++j) {
+        const Eigen::Vector3d xyz = point3D.xyz + step;
+        PointLinearization trial_linearization;
+        if (LinearizePoint(*reconstruction,
+                           point3D.track,
+                           xyz,
+                           /*camera_ids=*/{},
+                           cost_functions,
+                           loss_function,
+                           &trial_linearization) &&
+            trial_linearization.cost < linearization.cost) {
+          point3D.xyz = xyz;
+          linearization = std::move(trial_linearization);
+          accepted = true;
+          break;
+        }
+        step *= 0.5;
+      }
+      if (!accepted ||
+          step.norm() < kMinRelativeStepSize * point3D.xyz.norm()) {
+        break;
+      }
+    }
+  }
+}
+
+std::vector<TrackElement> BundleAdjuster::OutlierObservations() const {
+  std::vector<TrackElement> outliers;
+  for (const ObservationResidual& residual : observation_residuals_) {
+    if (!residual.loss_function->IsActive()) {
+      outliers.push_back(residual.observation);
+    }
+  }
+  return outliers;
+}
+
+void BundleAdjuster::SetUpOutlierRejection(
+    ceres::Solver::Options* solver_options) {
+  outlier_rejection_callback_.reset();
+  if (options_.outlier_max_reproj_error <= 0 ||
+      observation_residuals_.empty()) {
+    return;
+  }
+
+  outlier_rejection_thread_pool_.reset();
+  const int num_threads = GetEffectiveNumThreads(solver_options->num_threads);
+  if (num_threads > 1) {
+    outlier_rejection_thread_pool_ = std::make_unique<ThreadPool>(num_threads);
+  }
+
+  // The outliers are rejected before the first step and after every
+  // successful step, which requires the parameter blocks to be updated after
+  // every iteration. Rejected observations are never reactivated.
+  outlier_rejection_callback_ = std::make_unique<FunctionIterationCallback>(
+      [this](const ceres::IterationSummary& summary) {
+        if (summary.iteration == 0 || summary.step_is_successful) {
+          const size_t num_outliers =
+              RejectOutliers(outlier_rejection_thread_pool_.get());
+          if (num_outliers > 0) {
+            VLOG(2) << "Rejected " << num_outliers
+                    << " outlier observations in iteration "
+                    << summary.iteration;
+          }
+        }
+      });
+  solver_options->callbacks.push_back(outlier_rejection_callback_.get());
+  solver_options->update_state_every_iteration = true;
+}
+
+size_t BundleAdjuster::RejectOutliers(ThreadPool* thread_pool) {
+  const double max_squared_reproj_error =
+      options_.outlier_max_reproj_error * options_.outlier_max_reproj_error;
+  std::atomic<size_t> num_outliers(0);
+  const size_t kMinNumResidualsPerChunk = 256;
+  ParallelForChunks(
+      thread_pool,
+      observation_residuals_.size(),
+      kMinNumResidualsPerChunk,
+      [&](const size_t begin, const size_t end) {
+        std::vector<double*> parameter_blocks;
+        for (size_t i = begin; i < end; ++i) {
+          ObservationResidual& residual = observation_residuals_[i];
+          if (!residual.loss_function->IsActive()) {
+            continue;
+          }
+          const ceres::CostFunction* cost_function =
+              problem_->GetCostFunctionForResidualBlock(
+                  residual.residual_block_id);
+          problem_->GetParameterBlocksForResidualBlock(
+              residual.residual_block_id, &parameter_blocks);
+          Eigen::Vector2d residuals;
+          // Observations behind the camera fail to evaluate and are handled
+          // by the subsequent filtering of the reconstruction.
+          if (!cost_function->Evaluate(
+                  parameter_blocks.data(), residuals.data(), nullptr)) {
+            continue;
+          }
+          if (residuals.squaredNorm() > max_squared_reproj_error) {
+            residual.loss_function->Deactivate();
+            ++num_outliers;
+          }
+        }
+      });
+  return num_outliers;
+}
+
+void BundleAdjuster::ReportTelemetry(const double setup_time,
+                                     const double total_time) {
+  telemetry_ = BundleAdjustmentTelemetry();
+  telemetry_.label = options_.telemetry_label;
+  telemetry_.setup_time = setup_time;
+  telemetry_.preprocessor_time = summary_.preprocessor_time_in_seconds;
+  telemetry_.residual_evaluation_time =
+      summary_.residual_evaluation_time_in_seconds;
+  telemetry_.jacobian_evaluation_time =
+      summary_.jacobian_evaluation_time_in_seconds;
+  telemetry_.linear_solver_time = summary_.linear_solver_time_in_seconds;
+  telemetry_.minimizer_time = summary_.minimizer_time_in_seconds;
+  telemetry_.total_time = total_time;
+  telemetry_.num_images = config_.NumImages();
+  telemetry_.num_points =
+      point3D_num_observations_.size() + marginalized_point3D_ids_.size();
+  telemetry_.num_residuals = summary_.num_residuals_reduced;
+  telemetry_.num_residual_blocks = summary_.num_residual_blocks_reduced;
+  telemetry_.num_parameters = summary_.num_effective_parameters_reduced;
+  telemetry_.num_parameter_blocks = summary_.num_parameter_blocks_reduced;
+  telemetry_.num_threads = summary_.num_threads_used;
+  telemetry_.num_iterations =
+      summary_.num_successful_steps + summary_.num_unsuccessful_steps;
+  telemetry_.num_successful_iterations = summary_.num_successful_steps;
+  const auto ComputeError = [this](const double cost) {
+    return summary_.num_residuals_reduced > 0
+               ? std::sqrt(cost / summary_.num_residuals_reduced)
+               : 0.0;
+  };
+  telemetry_.initial_error = ComputeError(summary_.initial_cost);
+  telemetry_.final_error = ComputeError(summary_.final_cost);
+  telemetry_.termination =
+      SolverTerminationToString(summary_.termination_type);
+  telemetry_.iterations.reserve(summary_.iterations.size());
+  for (const ceres::IterationSummary& iteration_summary :
+       summary_.iterations) {
+    BundleAdjustmentTelemetry::Iteration& iteration =
+        telemetry_.iterations.emplace_back();
+    iteration.error = ComputeError(iteration_summary.cost);
+    iteration.time = iteration_summary.iteration_time_in_seconds;
+    iteration.linear_solver_time =
+        iteration_summary.step_solver_time_in_seconds;
+    iteration.num_linear_solver_iterations =
+        iteration_summary.linear_solver_iterations;
+    iteration.successful = iteration_summary.step_is_successful;
+  }
+
+  if (options_.telemetry_callback) {
+    options_.telemetry_callback(telemetry_);
+  }
+}
+
 void BundleAdjuster::ParameterizePoints(Reconstruction* reconstruction) {
   for (const auto elem : point3D_num_observations_) {
     Point3D& point3D = reconstruction->Point3D(elem.first);
@@ -537,16 +1420,26 @@ RigBundleAdjuster::RigBundleAdjuster(const BundleAdjustmentOptions& options,
 
 bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
                               std::vector<CameraRig>* camera_rigs) {
+  COLMAP_PROFILE_SCOPE("RigBundleAdjuster::Solve");
+  Timer timer;
+  timer.Start();
+
   loss_function_ =
       std::unique_ptr<ceres::LossFunction>(options_.CreateLossFunction());
   SetUpProblem(reconstruction, camera_rigs, loss_function_.get());
+  const double setup_time = timer.ElapsedSeconds();
 
   if (problem_->NumResiduals() == 0) {
-    return false;
+    if (marginalized_point3D_ids_.empty()) {
+      return false;
+    }
+    RefineMarginalizedPoints(reconstruction, loss_function_.get());
+    return true;
   }
 
   ceres::Solver::Options solver_options =
       SetUpSolverOptions(*problem_, options_.solver_options);
+  SetUpOutlierRejection(&solver_options);
 
   ceres::Solve(solver_options, problem_.get(), &summary_);
 
@@ -554,8 +1447,12 @@ bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
     PrintSolverSummary(summary_, "Rig Bundle adjustment report");
   }
 
+  RefineMarginalizedPoints(reconstruction, loss_function_.get());
+
   TearDown(reconstruction, *camera_rigs);
 
+  ReportTelemetry(setup_time, timer.ElapsedSeconds());
+
   return true;
 }
 
@@ -590,6 +1487,14 @@ void RigBundleAdjuster::SetUpProblem(Reconstruction* reconstruction,
   ceres::Problem::Options problem_options;
   problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
   problem_ = std::make_shared<ceres::Problem>(problem_options);
+  observation_residuals_.clear();
+
+  // Images in camera rigs always have variable poses.
+  MarginalizePoints(reconstruction, loss_function, [this](image_t image_id) {
+    return !config_.HasImage(image_id) ||
+           (image_id_to_camera_rig_.count(image_id) == 0 &&
+            config_.HasConstantCamPose(image_id));
+  });
 
   // Set up problem
   ComputeCameraRigPoses(*reconstruction, *camera_rigs);
@@ -669,8 +1574,11 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
   size_t num_observations = 0;
 
   // Add residuals to bundle adjustment problem.
-  for (const Point2D& point2D : image.Points2D()) {
-    if (!point2D.HasPoint3D()) {
+  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+       ++point2D_idx) {
+    const Point2D& point2D = image.Point2D(point2D_idx);
+    if (!point2D.HasPoint3D() ||
+        marginalized_point3D_ids_.count(point2D.point3D_id) > 0) {
       continue;
     }
 
@@ -687,33 +1595,42 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
     num_observations += 1;
     point3D_num_observations_[point2D.point3D_id] += 1;
 
+    const TrackElement observation(image_id, point2D_idx);
     if (camera_rig == nullptr) {
       if (constant_cam_pose) {
-        problem_->AddResidualBlock(
-            CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-                camera.model_id, image.CamFromWorld(), point2D.xy),
+        AddObservationResidualBlock(
+            observation,
+            CameraCostFunction<DefaultReprojErrorConstantPoseCostFunction>(
+                camera.model_id,
+                image.CamFromWorld(),
+                point2D.xy,
+                options_.use_float_jacobians),
             loss_function,
             point3D.xyz.data(),
             camera_params);
       } else {
-        problem_->AddResidualBlock(CameraCostFunction<ReprojErrorCostFunction>(
-                                       camera.model_id, point2D.xy),
-                                   loss_function,
-                                   cam_from_rig_rotation,     // rig == world
-                                   cam_from_rig_translation,  // rig == world
-                                   point3D.xyz.data(),
-                                   camera_params);
+        AddObservationResidualBlock(
+            observation,
+            CameraCostFunction<DefaultReprojErrorCostFunction>(
+                camera.model_id, point2D.xy, options_.use_float_jacobians),
+            loss_function,
+            cam_from_rig_rotation,     // rig == world
+            cam_from_rig_translation,  // rig == world
+            point3D.xyz.data(),
+            camera_params);
       }
     } else {
-      problem_->AddResidualBlock(CameraCostFunction<RigReprojErrorCostFunction>(
-                                     camera.model_id, point2D.xy),
-                                 loss_function,
-                                 cam_from_rig_rotation,
-                                 cam_from_rig_translation,
-                                 rig_from_world_rotation,
-                                 rig_from_world_translation,
-                                 point3D.xyz.data(),
-                                 camera_params);
+      AddObservationResidualBlock(
+          observation,
+          CameraCostFunction<RigReprojErrorCostFunction>(camera.model_id,
+                                                         point2D.xy),
+          loss_function,
+          cam_from_rig_rotation,
+          cam_from_rig_translation,
+          rig_from_world_rotation,
+          rig_from_world_translation,
+          point3D.xyz.data(),
+          camera_params);
     }
   }
 
@@ -751,7 +1668,8 @@ void RigBundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
   // Is 3D point already fully contained in the problem? I.e. its entire track
   // is contained in `variable_image_ids`, `constant_image_ids`,
   // `constant_x_image_ids`.
-  if (point3D_num_observations_[point3D_id] == point3D.track.Length()) {
+  if (marginalized_point3D_ids_.count(point3D_id) > 0 ||
+      point3D_num_observations_[point3D_id] == point3D.track.Length()) {
     return;
   }
 
@@ -775,9 +1693,13 @@ void RigBundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
       config_.SetConstantCamIntrinsics(image.CameraId());
     }
 
-    problem_->AddResidualBlock(
-        CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-            camera.model_id, image.CamFromWorld(), point2D.xy),
+    AddObservationResidualBlock(
+        track_el,
+        CameraCostFunction<DefaultReprojErrorConstantPoseCostFunction>(
+            camera.model_id,
+            image.CamFromWorld(),
+            point2D.xy,
+            options_.use_float_jacobians),
         loss_function,
         point3D.xyz.data(),
         camera.params.data());
@@ -811,6 +1733,499 @@ void RigBundleAdjuster::ParameterizeCameraRigs(Reconstruction* reconstruction) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// PartitionedBundleAdjuster
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Local copy of a parameter block that is shared between partitions, together
+// with its scaled dual variable and consensus penalty weight.
+struct SharedParam {
+  size_t consensus_idx;
+  Eigen::VectorXd dual;
+  double weight;
+  // Approximate projected displacement in pixels per unit deviation.
+  double pixel_scale;
+};
+
+struct Partition {
+  Reconstruction reconstruction;
+  BundleAdjustmentConfig config;
+  std::vector<std::pair<point3D_t, SharedParam>> shared_points3D;
+  std::vector<std::pair<camera_t, SharedParam>> shared_cameras;
+};
+
+Eigen::Map<Eigen::VectorXd> Point3DParams(Reconstruction* reconstruction,
+                                          const point3D_t point3D_id) {
+  return Eigen::Map<Eigen::VectorXd>(
+      reconstruction->Point3D(point3D_id).xyz.data(), 3);
+}
+
+Eigen::Map<Eigen::VectorXd> CameraParams(Reconstruction* reconstruction,
+                                         const camera_t camera_id) {
+  std::vector<double>& params = reconstruction->Camera(camera_id).params;
+  return Eigen::Map<Eigen::VectorXd>(params.data(), params.size());
+}
+
+// Adjust the partition with the consensus penalties on its shared parameters.
+bool AdjustPartition(const BundleAdjustmentOptions& ba_options,
+                     const std::vector<Eigen::VectorXd>& consensus_points3D,
+                     const std::vector<Eigen::VectorXd>& consensus_cameras,
+                     Partition* partition) {
+  Reconstruction* reconstruction = &partition->reconstruction;
+  BundleAdjuster bundle_adjuster(ba_options, partition->config);
+  std::unique_ptr<ceres::LossFunction> loss_function(
+      ba_options.CreateLossFunction());
+  bundle_adjuster.SetUpProblem(reconstruction, loss_function.get());
+  std::shared_ptr<ceres::Problem> problem = bundle_adjuster.Problem();
+  if (problem->NumResiduals() == 0) {
+    return false;
+  }
+
+  auto AddConsensusPrior = [&problem](const Eigen::VectorXd& consensus,
+                                      const SharedParam& param,
+                                      Eigen::Map<Eigen::VectorXd> values) {
+    if (problem->HasParameterBlock(values.data())) {
+      problem->AddResidualBlock(ConsensusPriorCostFunction::Create(
+                                    consensus - param.dual, param.weight),
+                                nullptr,
+                                values.data());
+    }
+  };
+  for (const auto& [point3D_id, param] : partition->shared_points3D) {
+    AddConsensusPrior(consensus_points3D[param.consensus_idx],
+                      param,
+                      Point3DParams(reconstruction, point3D_id));
+  }
+  for (const auto& [camera_id, param] : partition->shared_cameras) {
+    AddConsensusPrior(consensus_cameras[param.consensus_idx],
+                      param,
+                      CameraParams(reconstruction, camera_id));
+  }
+
+  const ceres::Solver::Options solver_options =
+      bundle_adjuster.SetUpSolverOptions(*problem, ba_options.solver_options);
+  ceres::Solver::Summary summary;
+  ceres::Solve(solver_options, problem.get(), &summary);
+  return summary.IsSolutionUsable();
+}
+
+// Update the consensus values as the weighted mean of the local copies and
+// their scaled duals, followed by the update of the scaled duals. Returns the
+// total deviation of the local copies from the consensus.
+template <typename ID, typename ParamsFunc>
+double UpdateConsensus(
+    std::vector<Partition>* partitions,
+    std::vector<std::pair<ID, SharedParam>> Partition::*shared_params,
+    ParamsFunc params_func,
+    std::vector<Eigen::VectorXd>* consensus) {
+  std::vector<double> weight_sums(consensus->size(), 0);
+  for (auto& value : *consensus) {
+    value.setZero();
+  }
+  for (auto& partition : *partitions) {
+    for (const auto& [id, param] : partition.*shared_params) {
+      (*consensus)[param.consensus_idx] +=
+          param.weight *
+          (params_func(&partition.reconstruction, id) + param.dual);
+      weight_sums[param.consensus_idx] += param.weight;
+    }
+  }
+  for (size_t i = 0; i < consensus->size(); ++i) {
+    (*consensus)[i] /= weight_sums[i];
+  }
+
+  double deviation = 0;
+  for (auto& partition : *partitions) {
+    for (auto& [id, param] : partition.*shared_params) {
+      const Eigen::VectorXd residual =
+          params_func(&partition.reconstruction, id) -
+          (*consensus)[param.consensus_idx];
+      param.dual += residual;
+      deviation += param.pixel_scale * residual.norm();
+    }
+  }
+  return deviation;
+}
+
+}  // namespace
+
+bool PartitionedBundleAdjustmentOptions::Check() const {
+  CHECK_OPTION_GE(max_num_images, 0);
+  CHECK_OPTION_GT(max_num_iterations, 0);
+  CHECK_OPTION_GT(consensus_weight, 0);
+  CHECK_OPTION_GE(consensus_tolerance, 0);
+  CHECK_OPTION_GE(num_threads, -1);
+  return true;
+}
+
+PartitionedBundleAdjuster::PartitionedBundleAdjuster(
+    const PartitionedBundleAdjustmentOptions& options,
+    const BundleAdjustmentOptions& ba_options,
+    const BundleAdjustmentConfig& config)
+    : options_(options), ba_options_(ba_options), config_(config) {
+  THROW_CHECK(options_.Check());
+  THROW_CHECK(ba_options_.Check());
+}
+
+bool PartitionedBundleAdjuster::Solve(Reconstruction* reconstruction) {
+  COLMAP_PROFILE_SCOPE("PartitionedBundleAdjuster::Solve");
+  THROW_CHECK_NOTNULL(reconstruction);
+  // Partitions are formed from the images and the points they observe.
+  THROW_CHECK_EQ(config_.NumPoints(), 0);
+
+  partitions_ = PartitionImages(*reconstruction);
+  if (partitions_.size() <= 1) {
+    BundleAdjuster bundle_adjuster(ba_options_, config_);
+    return bundle_adjuster.Solve(reconstruction);
+  }
+
+  const size_t num_partitions = partitions_.size();
+  LOG(INFO) << StringPrintf("Adjusting %d partitions", num_partitions);
+
+  Timer timer;
+  timer.Start();
+
+  std::unordered_map<image_t, size_t> image_id_to_partition_idx;
+  std::vector<std::unordered_set<camera_t>> partition_camera_ids(
+      num_partitions);
+  for (size_t partition_idx = 0; partition_idx < num_partitions;
+       ++partition_idx) {
+    LOG(INFO) << StringPrintf("  Partition %d with %d images",
+                              partition_idx + 1,
+                              partitions_[partition_idx].size());
+    for (const image_t image_id : partitions_[partition_idx]) {
+      image_id_to_partition_idx.emplace(image_id, partition_idx);
+      partition_camera_ids[partition_idx].insert(
+          reconstruction->Image(image_id).CameraId());
+    }
+  }
+
+  // Determine the partitions that observe each 3D point. Observations of
+  // registered images outside of the configuration are kept in all partitions
+  // observing the point, which keeps the point constant as in BundleAdjuster.
+  std::vector<Partition> partitions(num_partitions);
+  std::vector<std::unordered_set<image_t>> partition_image_ids(num_partitions);
+  std::vector<Eigen::VectorXd> consensus_points3D;
+  std::vector<size_t> point3D_partition_idxs;
+  for (const auto& [point3D_id, point3D] : reconstruction->Points3D()) {
+    point3D_partition_idxs.clear();
+    for (const auto& track_el : point3D.track.Elements()) {
+      const auto it = image_id_to_partition_idx.find(track_el.image_id);
+      if (it != image_id_to_partition_idx.end()) {
+        point3D_partition_idxs.push_back(it->second);
+      }
+    }
+    std::sort(point3D_partition_idxs.begin(), point3D_partition_idxs.end());
+    point3D_partition_idxs.erase(std::unique(point3D_partition_idxs.begin(),
+                                             point3D_partition_idxs.end()),
+                                 point3D_partition_idxs.end());
+
+    const bool is_shared = point3D_partition_idxs.size() > 1;
+    if (is_shared) {
+      consensus_points3D.push_back(point3D.xyz);
+    }
+
+    for (const size_t partition_idx : point3D_partition_idxs) {
+      Partition& partition = partitions[partition_idx];
+      Track track;
+      double info = 0;
+      for (const auto& track_el : point3D.track.Elements()) {
+        const auto it = image_id_to_partition_idx.find(track_el.image_id);
+        if (it == image_id_to_partition_idx.end()
+                ? !reconstruction->IsImageRegistered(track_el.image_id)
+                : it->second != partition_idx) {
+          continue;
+        }
+        track.AddElement(track_el);
+        partition_image_ids[partition_idx].insert(track_el.image_id);
+        const Image& image = reconstruction->Image(track_el.image_id);
+        const double depth = (image.CamFromWorld() * point3D.xyz).z();
+        if (depth > std::numeric_limits<double>::epsilon()) {
+          const double focal_length =
+              reconstruction->Camera(image.CameraId()).MeanFocalLength();
+          info += (focal_length / depth) * (focal_length / depth);
+        }
+      }
+
+      if (is_shared) {
+        SharedParam param;
+        param.consensus_idx = consensus_points3D.size() - 1;
+        param.dual = Eigen::Vector3d::Zero();
+        info = std::max(info, std::numeric_limits<double>::epsilon());
+        param.weight = options_.consensus_weight * info;
+        param.pixel_scale = std::sqrt(info / track.Length());
+        partition.shared_points3D.emplace_back(point3D_id, std::move(param));
+      }
+
+      struct Point3D partition_point3D;
+      partition_point3D.xyz = point3D.xyz;
+      partition_point3D.color = point3D.color;
+      partition_point3D.error = point3D.error;
+      partition_point3D.track = std::move(track);
+      partition.reconstruction.AddPoint3D(point3D_id,
+                                          std::move(partition_point3D));
+    }
+  }
+
+  // Build the reconstruction and configuration of each partition. Cameras of
+  // images outside the partition are kept constant and the intrinsics of the
+  // cameras shared between partitions are reconciled through consensus.
+  std::unordered_map<camera_t, size_t> camera_id_to_consensus_idx;
+  std::vector<Eigen::VectorXd> consensus_cameras;
+  for (size_t partition_idx = 0; partition_idx < num_partitions;
+       ++partition_idx) {
+    Partition& partition = partitions[partition_idx];
+    Reconstruction& partition_reconstruction = partition.reconstruction;
+
+    for (const image_t image_id : partition_image_ids[partition_idx]) {
+      Image image = reconstruction->Image(image_id);
+      for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+           ++point2D_idx) {
+        if (image.Point2D(point2D_idx).HasPoint3D()) {
+          image.ResetPoint3DForPoint2D(point2D_idx);
+        }
+      }
+      if (!partition_reconstruction.ExistsCamera(image.CameraId())) {
+        partition_reconstruction.AddCamera(
+            reconstruction->Camera(image.CameraId()));
+      }
+      partition_reconstruction.AddImage(std::move(image));
+    }
+    for (const auto& [point3D_id, point3D] :
+         partition_reconstruction.Points3D()) {
+      for (const auto& track_el : point3D.track.Elements()) {
+        partition_reconstruction.Image(track_el.image_id)
+            .SetPoint3DForPoint2D(track_el.point2D_idx, point3D_id);
+      }
+    }
+
+    std::unordered_map<camera_t, size_t> camera_num_observations;
+    for (const image_t image_id : partitions_[partition_idx]) {
+      partition.config.AddImage(image_id);
+      if (config_.HasConstantCamPose(image_id)) {
+        partition.config.SetConstantCamPose(image_id);
+      }
+      if (config_.HasConstantCamPositions(image_id)) {
+        partition.config.SetConstantCamPositions(
+            image_id, config_.ConstantCamPositions(image_id));
+      }
+      const Image& image = partition_reconstruction.Image(image_id);
+      camera_num_observations[image.CameraId()] += image.NumPoints3D();
+    }
+
+    for (const auto& [camera_id, camera] : partition_reconstruction.Cameras()) {
+      if (config_.HasConstantCamIntrinsics(camera_id) ||
+          partition_camera_ids[partition_idx].count(camera_id) == 0) {
+        partition.config.SetConstantCamIntrinsics(camera_id);
+        continue;
+      }
+
+      size_t num_camera_partitions = 0;
+      for (const auto& camera_ids : partition_camera_ids) {
+        num_camera_partitions += camera_ids.count(camera_id);
+      }
+      if (num_camera_partitions <= 1) {
+        continue;
+      }
+
+      const auto it = camera_id_to_consensus_idx.emplace(
+          camera_id, consensus_cameras.size());
+      if (it.second) {
+        consensus_cameras.push_back(
+            CameraParams(reconstruction, camera_id).eval());
+      }
+
+      SharedParam param;
+      param.consensus_idx = it.first->second;
+      param.dual = Eigen::VectorXd::Zero(camera.params.size());
+      param.weight = options_.consensus_weight *
+                     std::max<size_t>(camera_num_observations[camera_id], 1);
+      param.pixel_scale = 0;
+      partition.shared_cameras.emplace_back(camera_id, std::move(param));
+    }
+  }
+
+  LOG(INFO) << StringPrintf("Sharing %d points and %d cameras",
+                            consensus_points3D.size(),
+                            consensus_cameras.size());
+
+  // Determine the number of workers and threads per worker.
+  const int num_eff_threads = GetEffectiveNumThreads(options_.num_threads);
+  const int num_eff_workers =
+      std::min(static_cast<int>(num_partitions), num_eff_threads);
+  BundleAdjustmentOptions partition_ba_options = ba_options_;
+  partition_ba_options.print_summary = false;
+  partition_ba_options.solver_options.num_threads =
+      std::max(1, num_eff_threads / num_eff_workers);
+
+  size_t num_shared_points3D = 0;
+  for (const auto& partition : partitions) {
+    num_shared_points3D += partition.shared_points3D.size();
+  }
+
+  ThreadPool thread_pool(num_eff_workers);
+  bool success = false;
+  for (int iteration = 0; iteration < options_.max_num_iterations;
+       ++iteration) {
+    std::vector<std::future<bool>> futures;
+    futures.reserve(num_partitions);
+    for (auto& partition : partitions) {
+      futures.push_back(thread_pool.AddTask(AdjustPartition,
+                                            std::cref(partition_ba_options),
+                                            std::cref(consensus_points3D),
+                                            std::cref(consensus_cameras),
+                                            &partition));
+    }
+    for (auto& future : futures) {
+      success = future.get() || success;
+    }
+
+    const double points3D_deviation =
+        UpdateConsensus(&partitions,
+                        &Partition::shared_points3D,
+                        Point3DParams,
+                        &consensus_points3D);
+    UpdateConsensus(&partitions,
+                    &Partition::shared_cameras,
+                    CameraParams,
+                    &consensus_cameras);
+
+    const double mean_deviation =
+        num_shared_points3D == 0 ? 0
+                                 : points3D_deviation / num_shared_points3D;
+    LOG(INFO) << StringPrintf("Consensus iteration %d: mean deviation %.3fpx",
+                              iteration + 1,
+                              mean_deviation);
+    if (mean_deviation <= options_.consensus_tolerance) {
+      break;
+    }
+  }
+
+  // Write back the poses of the partition images, the consensus of the shared
+  // parameters, and the parameters that are local to a partition.
+  for (size_t partition_idx = 0; partition_idx < num_partitions;
+       ++partition_idx) {
+    Partition& partition = partitions[partition_idx];
+    for (const image_t image_id : partitions_[partition_idx]) {
+      reconstruction->Image(image_id).CamFromWorld() =
+          partition.reconstruction.Image(image_id).CamFromWorld();
+    }
+    for (const auto& [point3D_id, point3D] :
+         partition.reconstruction.Points3D()) {
+      reconstruction->Point3D(point3D_id).xyz = point3D.xyz;
+    }
+    for (const camera_t camera_id : partition_camera_ids[partition_idx]) {
+      if (!config_.HasConstantCamIntrinsics(camera_id)) {
+        CameraParams(reconstruction, camera_id) =
+            CameraParams(&partition.reconstruction, camera_id);
+      }
+    }
+  }
+  for (const auto& partition : partitions) {
+    for (const auto& [point3D_id, param] : partition.shared_points3D) {
+      reconstruction->Point3D(point3D_id).xyz =
+          consensus_points3D[param.consensus_idx];
+    }
+    for (const auto& [camera_id, param] : partition.shared_cameras) {
+      CameraParams(reconstruction, camera_id) =
+          consensus_cameras[param.consensus_idx];
+    }
+  }
+
+  timer.PrintMinutes();
+
+  return success;
+}
+
+const std::vector<std::vector<image_t>>& PartitionedBundleAdjuster::Partitions()
+    const {
+  return partitions_;
+}
+
+std::vector<std::vector<image_t>> PartitionedBundleAdjuster::PartitionImages(
+    const Reconstruction& reconstruction) const {
+  const std::unordered_set<image_t>& image_ids = config_.Images();
+  if (options_.max_num_images == 0 ||
+      image_ids.size() <= static_cast<size_t>(options_.max_num_images)) {
+    return {std::vector<image_t>(image_ids.begin(), image_ids.end())};
+  }
+
+  // Weight the covisibility graph by the number of commonly observed points.
+  std::unordered_map<image_pair_t, int> pair_num_points3D;
+  std::vector<image_t> track_image_ids;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    track_image_ids.clear();
+    for (const auto& track_el : point3D.second.track.Elements()) {
+      if (image_ids.count(track_el.image_id)) {
+        track_image_ids.push_back(track_el.image_id);
+      }
+    }
+    std::sort(track_image_ids.begin(), track_image_ids.end());
+    track_image_ids.erase(
+        std::unique(track_image_ids.begin(), track_image_ids.end()),
+        track_image_ids.end());
+    for (size_t i = 0; i < track_image_ids.size(); ++i) {
+      for (size_t j = 0; j < i; ++j) {
+        pair_num_points3D[Database::ImagePairToPairId(track_image_ids[i],
+                                                      track_image_ids[j])] +=
+            1;
+      }
+    }
+  }
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_points3D;
+  image_pairs.reserve(pair_num_points3D.size());
+  num_points3D.reserve(pair_num_points3D.size());
+  for (const auto& [pair_id, num_pair_points3D] : pair_num_points3D) {
+    image_pairs.push_back(Database::PairIdToImagePair(pair_id));
+    num_points3D.push_back(num_pair_points3D);
+  }
+
+  // Each image belongs to exactly one partition, so that the partitions are
+  // only coupled through the points and cameras they share.
+  SceneClustering::Options clustering_options;
+  clustering_options.leaf_max_num_images = options_.max_num_images;
+  clustering_options.image_overlap = 0;
+  SceneClustering scene_clustering(clustering_options);
+  scene_clustering.Partition(image_pairs, num_points3D);
+
+  std::vector<std::vector<image_t>> partitions;
+  std::unordered_set<image_t> partitioned_image_ids;
+  for (const auto* cluster : scene_clustering.GetLeafClusters()) {
+    std::vector<image_t> partition;
+    for (const image_t image_id : cluster->image_ids) {
+      if (partitioned_image_ids.insert(image_id).second) {
+        partition.push_back(image_id);
+      }
+    }
+    if (!partition.empty()) {
+      partitions.push_back(std::move(partition));
+    }
+  }
+
+  // Images without covisible images are not clustered and are added to the
+  // smallest partition.
+  if (partitions.empty()) {
+    partitions.emplace_back();
+  }
+  for (const image_t image_id : image_ids) {
+    if (partitioned_image_ids.count(image_id) == 0) {
+      std::min_element(partitions.begin(),
+                       partitions.end(),
+                       [](const std::vector<image_t>& partition1,
+                          const std::vector<image_t>& partition2) {
+                         return partition1.size() < partition2.size();
+                       })
+          ->push_back(image_id);
+    }
+  }
+
+  return partitions;
+}
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary,
                         const std::string& header) {
   std::ostringstream log;
@@ -839,31 +2254,8 @@ void PrintSolverSummary(const ceres::Solver::Summary& summary,
       << " [px]\n";
 
   log << std::right << std::setw(16) << "Termination : ";
-
-  std::string termination = "";
-
-  switch (summary.termination_type) {
-    case ceres::CONVERGENCE:
-      termination = "Convergence";
-      break;
-    case ceres::NO_CONVERGENCE:
-      termination = "No convergence";
-      break;
-    case ceres::FAILURE:
-      termination = "Failure";
-      break;
-    case ceres::USER_SUCCESS:
-      termination = "User success";
-      break;
-    case ceres::USER_FAILURE:
-      termination = "User failure";
-      break;
-    default:
-      termination = "Unknown";
-      break;
-  }
-
-  log << std::right << termination << "\n\n";
+  log << std::right << SolverTerminationToString(summary.termination_type)
+      << "\n\n";
   LOG(INFO) << log.str();
 }
 
@@ -32,15 +32,67 @@
 #include "colmap/scene/camera_rig.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/threading.h"
 
+#include <functional>
+#include <list>
 #include <memory>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <Eigen/Core>
 #include <ceres/ceres.h>
 
 namespace colmap {
 
+// Structured report of a single bundle adjustment, e.g., for capacity planning
+// across many adjustments. All times are in seconds and the errors are the
+// root mean squared residuals, as printed in the solver summary.
+struct BundleAdjustmentTelemetry {
+  // Optional label of the adjustment, e.g., "local" or "global".
+  std::string label;
+
+  // Time to set up the problem, including the marginalization of points.
+  double setup_time = 0;
+  // Times reported by Ceres, where the preprocessing includes the creation of
+  // the linear solver and the minimizer time includes the evaluations.
+  double preprocessor_time = 0;
+  double residual_evaluation_time = 0;
+  double jacobian_evaluation_time = 0;
+  double linear_solver_time = 0;
+  double minimizer_time = 0;
+  // Wall time of the whole adjustment, including setup and refinements.
+  double total_time = 0;
+
+  // Size of the reduced problem that was solved.
+  size_t num_images = 0;
+  size_t num_points = 0;
+  size_t num_residuals = 0;
+  size_t num_residual_blocks = 0;
+  size_t num_parameters = 0;
+  size_t num_parameter_blocks = 0;
+  int num_threads = 0;
+
+  int num_iterations = 0;
+  int num_successful_iterations = 0;
+  double initial_error = 0;
+  double final_error = 0;
+  std::string termination;
+
+  struct Iteration {
+    double error = 0;
+    double time = 0;
+    double linear_solver_time = 0;
+    int num_linear_solver_iterations = 0;
+    bool successful = false;
+  };
+  std::vector<Iteration> iterations;
+
+  // Serialize to a single line of JSON without a trailing newline.
+  std::string ToJson() const;
+};
+
 struct BundleAdjustmentOptions {
   // Loss function types: Trivial (non-robust) and Cauchy (robust) loss.
   enum class LossFunctionType { TRIVIAL, SOFT_L1, CAUCHY };
@@ -69,6 +121,50 @@ struct BundleAdjustmentOptions {
   // due to the overhead of threading.
   int min_num_residuals_for_multi_threading = 50000;
 
+  // Whether to solve the linear systems on the GPU with the CUDA backends of
+  // Ceres, if Ceres was built with CUDA support. Dense Schur complements
+  // require Ceres 2.2 and sparse Schur complements Ceres 2.3 with cuDSS.
+  bool use_gpu = false;
+  std::string gpu_index = "-1";
+
+  // Minimum number of images to use the GPU solver. Small problems are
+  // typically faster on the CPU due to the overhead of the data transfers.
+  int min_num_images_gpu_solver = 50;
+
+  // Maximum number of images to use the direct dense and sparse solvers on
+  // the CPU and on the GPU. Larger problems use the iterative solver on the
+  // CPU. The defaults are empirical, see the bundle adjustment benchmark to
+  // tune them for the given hardware.
+  int max_num_images_direct_dense_cpu_solver = 50;
+  int max_num_images_direct_sparse_cpu_solver = 1000;
+  int max_num_images_direct_dense_gpu_solver = 200;
+  int max_num_images_direct_sparse_gpu_solver = 4000;
+
+  // Whether to evaluate the Jacobians of the reprojection errors in single
+  // precision for the camera models with analytical cost functions. The
+  // residuals are still evaluated and the normal equations are accumulated in
+  // double precision, which only affects the accuracy of the step direction.
+  bool use_float_jacobians = false;
+
+  // Whether to marginalize the 3D points whose observations all have constant
+  // camera poses into fixed priors on the intrinsics of the variable cameras
+  // before solving. The priors are linearized at the initial values and the
+  // marginalized points are refined in isolation after solving, which saves
+  // the elimination of the points in every iteration of the solver.
+  bool marginalize_constant_pose_points = false;
+
+  // Maximum reprojection error in pixels of the observations, if positive.
+  // Observations exceeding it are deactivated as outliers by an iteration
+  // callback during the solve. They remain in the problem without contributing
+  // to the cost, such that the problem is neither rebuilt nor solved again.
+  double outlier_max_reproj_error = 0;
+
+  // Optional label and callback that receives the telemetry after every
+  // solved problem. The callback may be invoked concurrently by adjustments
+  // on different threads.
+  std::string telemetry_label;
+  std::function<void(const BundleAdjustmentTelemetry&)> telemetry_callback;
+
   // Ceres-Solver options.
   ceres::Solver::Options solver_options;
 
@@ -163,6 +259,115 @@ class BundleAdjustmentConfig {
   std::unordered_map<image_t, std::vector<int>> constant_cam_positions_;
 };
 
+// Pool of the reprojection error cost functions for variable camera poses,
+// which only depend on the camera model and the observation. They can thus be
+// reused by consecutive bundle adjustment problems of the same reconstruction,
+// e.g., by the sliding window of local bundle adjustments. The cost functions
+// of the least recently used images are evicted by `Trim`, which invalidates
+// any problem that still uses them.
+class BundleAdjustmentCostFunctionPool {
+ public:
+  explicit BundleAdjustmentCostFunctionPool(size_t max_num_images = 100);
+
+  // Get the cost function of the given observation, which is created on first
+  // use. The pool retains the ownership.
+  ceres::CostFunction* Get(image_t image_id,
+                           point2D_t point2D_idx,
+                           CameraModelId camera_model_id,
+                           const Eigen::Vector2d& point2D);
+
+  // Set the precision of the Jacobians of the pooled cost functions, which
+  // clears the pool if the precision changes.
+  void SetFloatJacobians(bool float_jacobians);
+
+  // Evict the least recently used images beyond the maximum number of images.
+  void Trim();
+
+  size_t NumImages() const;
+
+  void Clear();
+
+ private:
+  struct ImageCostFunctions {
+    std::vector<std::unique_ptr<ceres::CostFunction>> cost_functions;
+    std::list<image_t>::iterator lru_it;
+  };
+
+  const size_t max_num_images_;
+  bool float_jacobians_ = false;
+  // Ordered from most to least recently used.
+  std::list<image_t> lru_image_ids_;
+  std::unordered_map<image_t, ImageCostFunctions> images_;
+};
+
+// Cache of the priors on the camera intrinsics that remain after marginalizing
+// the 3D points whose observations all have constant camera poses, see
+// `BundleAdjustmentOptions::marginalize_constant_pose_points`. The prior of a
+// point is linearized once and reused by consecutive bundle adjustments of the
+// same reconstruction as long as its track and variable cameras are unchanged,
+// e.g., by the iterative global refinement of the incremental mapper.
+class BundleAdjustmentMarginalizationCache {
+ public:
+  struct PointPrior {
+    // The track of the point at the time of the marginalization.
+    TrackElements track;
+    // The variable cameras of the track, on whose stacked parameters x the
+    // prior 0.5 x^T information x - information_vector^T x is defined.
+    std::vector<camera_t> camera_ids;
+    Eigen::MatrixXd information;
+    Eigen::VectorXd information_vector;
+  };
+
+  // Get the prior of the point, if it was marginalized with the same track and
+  // variable cameras before, or nullptr otherwise.
+  const PointPrior* Get(point3D_t point3D_id,
+                        const TrackElements& track,
+                        const std::vector<camera_t>& camera_ids) const;
+
+  void Set(point3D_t point3D_id, PointPrior prior);
+
+  // Evict the priors of all points except the given ones.
+  void Retain(const std::unordered_set<point3D_t>& point3D_ids);
+
+  size_t NumPoints() const;
+
+  void Clear();
+
+ private:
+  std::unordered_map<point3D_t, PointPrior> priors_;
+};
+
+// Wrapper of the loss function of a single residual, which can be deactivated
+// during the solve, such that the residual no longer contributes to the cost
+// and the derivatives. The state must only change between the evaluations of
+// the solver, i.e., in iteration callbacks.
+class DeactivatableLossFunction : public ceres::LossFunction {
+ public:
+  explicit DeactivatableLossFunction(const ceres::LossFunction* loss_function)
+      : loss_function_(loss_function) {}
+
+  void Evaluate(double sq_norm, double rho[3]) const override {
+    if (!active_) {
+      rho[0] = 0;
+      rho[1] = 0;
+      rho[2] = 0;
+    } else if (loss_function_ == nullptr) {
+      rho[0] = sq_norm;
+      rho[1] = 1;
+      rho[2] = 0;
+    } else {
+      loss_function_->Evaluate(sq_norm, rho);
+    }
+  }
+
+  bool IsActive() const { return active_; }
+  void Deactivate() { active_ = false; }
+
+ private:
+  const ceres::LossFunction* loss_function_;
+  bool active_ = true;
+};
+
 // Bundle adjustment based on Ceres-Solver. Enables most flexible configurations
 // and provides best solution quality.
 class BundleAdjuster {
@@ -186,27 +391,110 @@ class BundleAdjuster {
   std::shared_ptr<ceres::Problem> Problem();
   // Get the Ceres solver summary after the last call to `Solve`.
   const ceres::Solver::Summary& Summary() const;
+  // Get the telemetry after the last call to `Solve`.
+  const BundleAdjustmentTelemetry& Telemetry() const;
+
+  // Reuse the cost functions of variable camera poses from the given pool,
+  // which must outlive the problem. Must be set before setting up the problem.
+  void SetCostFunctionPool(BundleAdjustmentCostFunctionPool* pool);
+
+  // Reuse the priors of marginalized points from the given cache, which must
+  // outlive the adjuster. Must be set before setting up the problem.
+  void SetMarginalizationCache(BundleAdjustmentMarginalizationCache* cache);
+
+  // The points marginalized by the last call to `SetUpProblem`.
+  const std::unordered_set<point3D_t>& MarginalizedPoints() const;
+
+  // The observations deactivated as outliers by the last call to `Solve`, see
+  // `BundleAdjustmentOptions::outlier_max_reproj_error`.
+  std::vector<TrackElement> OutlierObservations() const;
 
  private:
+  // The observations of an image with their cost functions, which are created
+  // independently of the problem, such that the images can be processed in
+  // parallel. The cost functions of pooled observations are null and only
+  // retrieved from the pool when the image is added to the problem.
+  struct ImageResiduals {
+    std::vector<point2D_t> point2D_idxs;
+    std::vector<ceres::CostFunction*> cost_functions;
+  };
+
+  ImageResiduals CreateImageResiduals(image_t image_id,
+                                      Reconstruction* reconstruction) const;
+
   void AddImageToProblem(image_t image_id,
                          Reconstruction* reconstruction,
-                         ceres::LossFunction* loss_function);
+                         ceres::LossFunction* loss_function,
+                         const ImageResiduals& residuals);
 
   void AddPointToProblem(point3D_t point3D_id,
                          Reconstruction* reconstruction,
                          ceres::LossFunction* loss_function);
 
+  // Take the ownership of a cost function that is not pooled, if the problem
+  // does not own its cost functions.
+  ceres::CostFunction* OwnCostFunction(ceres::CostFunction* cost_function);
+
  protected:
   void ParameterizeCameras(Reconstruction* reconstruction);
   void ParameterizePoints(Reconstruction* reconstruction);
 
+  // Marginalize the variable points observed by the configured images whose
+  // observations all have constant camera poses into priors on the variable
+  // cameras, if enabled. Must be called before adding images and points.
+  void MarginalizePoints(
+      Reconstruction* reconstruction,
+      ceres::LossFunction* loss_function,
+      const std::function<bool(image_t)>& has_constant_cam_pose);
+  // Refine the marginalized points w.r.t. the adjusted cameras.
+  void RefineMarginalizedPoints(Reconstruction* reconstruction,
+                                const ceres::LossFunction* loss_function);
+
+  // Add the residual block of an observation. If outliers are rejected during
+  // the solve, the residual gets a separate deactivatable loss function.
+  template <typename... Ts>
+  void AddObservationResidualBlock(const TrackElement& observation,
+                                   ceres::CostFunction* cost_function,
+                                   ceres::LossFunction* loss_function,
+                                   Ts*... parameter_blocks);
+  // Register the callback that rejects the outliers after every successful
+  // iteration in the solver options, if enabled.
+  void SetUpOutlierRejection(ceres::Solver::Options* solver_options);
+  // Deactivate the active observations whose reprojection error exceeds the
+  // threshold at the current parameters and return their number.
+  size_t RejectOutliers(ThreadPool* thread_pool);
+
+  // Fill the telemetry from the solver summary and report it to the callback.
+  void ReportTelemetry(double setup_time, double total_time);
+
   const BundleAdjustmentOptions options_;
   BundleAdjustmentConfig config_;
   std::shared_ptr<ceres::Problem> problem_;
   ceres::Solver::Summary summary_;
+  BundleAdjustmentTelemetry telemetry_;
   std::unordered_set<camera_t> camera_ids_;
   std::unordered_map<point3D_t, size_t> point3D_num_observations_;
 
+  // Optional pool of reusable cost functions. If set, the problem does not
+  // own its cost functions and the non-pooled ones are owned by the adjuster.
+  BundleAdjustmentCostFunctionPool* cost_function_pool_ = nullptr;
+  std::vector<std::unique_ptr<ceres::CostFunction>> owned_cost_functions_;
+
+  // Optional cache of the priors of the marginalized points.
+  BundleAdjustmentMarginalizationCache* marginalization_cache_ = nullptr;
+  std::unordered_set<point3D_t> marginalized_point3D_ids_;
+
+  // The residuals of the observations with their deactivatable loss functions,
+  // if outliers are rejected during the solve.
+  struct ObservationResidual {
+    TrackElement observation;
+    ceres::ResidualBlockId residual_block_id = nullptr;
+    std::unique_ptr<DeactivatableLossFunction> loss_function;
+  };
+  std::vector<ObservationResidual> observation_residuals_;
+  std::unique_ptr<ThreadPool> outlier_rejection_thread_pool_;
+  std::unique_ptr<ceres::IterationCallback> outlier_rejection_callback_;
+
   // Hold the life of loss function for Solve()
   std::unique_ptr<ceres::LossFunction> loss_function_;
 };
@@ -270,7 +558,79 @@ class RigBundleAdjuster : public BundleAdjuster {
   std::unordered_set<double*> parameterized_quats_;
 };
 
+struct PartitionedBundleAdjustmentOptions {
+  // Maximum number of images per partition. Problems with fewer images are
+  // adjusted as a single problem. Partitioning is disabled if zero.
+  int max_num_images = 0;
+
+  // Maximum number of consensus iterations between the partitions.
+  int max_num_iterations = 10;
+
+  // Weight of the consensus penalty on the parameters shared between
+  // partitions, relative to their reprojection information.
+  double consensus_weight = 1.0;
+
+  // Stop iterating once the mean deviation of the shared 3D points from their
+  // consensus, measured as projected displacement in pixels, is below this.
+  double consensus_tolerance = 0.1;
+
+  // The number of partitions to adjust in parallel.
+  int num_threads = -1;
+
+  bool Check() const;
+};
+
+// Bundle adjustment of large problems by partitioning the covisibility graph
+// of the images using scene clustering. The partitions are adjusted in
+// parallel as separate problems and reconciled with consensus ADMM on the 3D
+// points and camera intrinsics that they share. Each image pose belongs to
+// exactly one partition, registered images outside of the configuration are
+// kept constant in all partitions observing their points.
+class PartitionedBundleAdjuster {
+ public:
+  PartitionedBundleAdjuster(const PartitionedBundleAdjustmentOptions& options,
+                            const BundleAdjustmentOptions& ba_options,
+                            const BundleAdjustmentConfig& config);
+
+  bool Solve(Reconstruction* reconstruction);
+
+  // The images of each partition after the last call to `Solve`.
+  const std::vector<std::vector<image_t>>& Partitions() const;
+
+ private:
+  std::vector<std::vector<image_t>> PartitionImages(
+      const Reconstruction& reconstruction) const;
+
+  const PartitionedBundleAdjustmentOptions options_;
+  const BundleAdjustmentOptions ba_options_;
+  const BundleAdjustmentConfig config_;
+  std::vector<std::vector<image_t>> partitions_;
+};
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary,
                         const std::string& header);
 
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename... Ts>
+void BundleAdjuster::AddObservationResidualBlock(
+    const TrackElement& observation,
+    ceres::CostFunction* cost_function,
+    ceres::LossFunction* loss_function,
+    Ts*... parameter_blocks) {
+  if (options_.outlier_max_reproj_error <= 0) {
+    problem_->AddResidualBlock(
+        cost_function, loss_function, parameter_blocks...);
+    return;
+  }
+  ObservationResidual& residual = observation_residuals_.emplace_back();
+  residual.observation = observation;
+  residual.loss_function =
+      std::make_unique<DeactivatableLossFunction>(loss_function);
+  residual.residual_block_id = problem_->AddResidualBlock(
+      cost_function, residual.loss_function.get(), parameter_blocks...);
+}
+
 }  // namespace colmap
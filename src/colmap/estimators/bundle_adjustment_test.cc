@@ -251,6 +251,176 @@ TEST(BundleAdjustment, TwoView) {
   }
 }
 
+TEST(BundleAdjustment, TwoViewOutlierRejection) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, 100, &reconstruction);
+  const point2D_t outlier_point2D_idx = 3;
+  reconstruction.Image(1).Point2D(outlier_point2D_idx).xy +=
+      Eigen::Vector2d(100, -100);
+  Reconstruction robust_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+  EXPECT_TRUE(bundle_adjuster.OutlierObservations().empty());
+
+  options.outlier_max_reproj_error = 10;
+  BundleAdjuster robust_bundle_adjuster(options, config);
+  ASSERT_TRUE(robust_bundle_adjuster.Solve(&robust_reconstruction));
+
+  // The outlier remains in the problem without contributing to the cost.
+  EXPECT_EQ(robust_bundle_adjuster.Summary().num_residuals_reduced, 400);
+  const std::vector<TrackElement> outliers =
+      robust_bundle_adjuster.OutlierObservations();
+  ASSERT_EQ(outliers.size(), 1);
+  EXPECT_EQ(outliers[0].image_id, 1);
+  EXPECT_EQ(outliers[0].point2D_idx, outlier_point2D_idx);
+  EXPECT_LT(robust_bundle_adjuster.Summary().final_cost,
+            bundle_adjuster.Summary().final_cost);
+}
+
+TEST(BundleAdjustment, TwoViewCostFunctionPool) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, 100, &reconstruction);
+  Reconstruction pooled_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  BundleAdjustmentCostFunctionPool pool;
+  for (int i = 0; i < 2; ++i) {
+    Reconstruction repeated_reconstruction = pooled_reconstruction;
+    BundleAdjuster pooled_bundle_adjuster(options, config);
+    pooled_bundle_adjuster.SetCostFunctionPool(&pool);
+    ASSERT_TRUE(pooled_bundle_adjuster.Solve(&repeated_reconstruction));
+    // Only the variable image uses pooled cost functions.
+    EXPECT_EQ(pool.NumImages(), 1);
+    EXPECT_EQ(pooled_bundle_adjuster.Summary().num_residuals_reduced, 400);
+    for (const auto& point3D : reconstruction.Points3D()) {
+      EXPECT_EQ(repeated_reconstruction.Point3D(point3D.first).xyz,
+                point3D.second.xyz);
+    }
+  }
+}
+
+TEST(BundleAdjustment, TwoViewTelemetry) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, 100, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.telemetry_label = "test";
+  std::vector<BundleAdjustmentTelemetry> reported_telemetry;
+  options.telemetry_callback =
+      [&reported_telemetry](const BundleAdjustmentTelemetry& telemetry) {
+        reported_telemetry.push_back(telemetry);
+      };
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  ASSERT_EQ(reported_telemetry.size(), 1);
+  const BundleAdjustmentTelemetry& telemetry = bundle_adjuster.Telemetry();
+  EXPECT_EQ(reported_telemetry[0].ToJson(), telemetry.ToJson());
+  EXPECT_EQ(telemetry.label, "test");
+  EXPECT_EQ(telemetry.num_images, 2);
+  EXPECT_EQ(telemetry.num_points, 100);
+  EXPECT_EQ(telemetry.num_residuals, 400);
+  EXPECT_EQ(telemetry.num_residual_blocks, 200);
+  EXPECT_EQ(telemetry.num_parameters, 309);
+  EXPECT_GE(telemetry.num_threads, 1);
+  EXPECT_GE(telemetry.total_time, telemetry.setup_time);
+  EXPECT_GE(telemetry.total_time, telemetry.minimizer_time);
+  EXPECT_LE(telemetry.final_error, telemetry.initial_error);
+  EXPECT_FALSE(telemetry.termination.empty());
+  // The first iteration is the evaluation at the initial parameters.
+  ASSERT_EQ(telemetry.iterations.size(), telemetry.num_iterations + 1);
+  EXPECT_NEAR(
+      telemetry.iterations.front().error, telemetry.initial_error, 1e-6);
+
+  const std::string json = telemetry.ToJson();
+  EXPECT_EQ(json.front(), '{');
+  EXPECT_EQ(json.back(), '}');
+  EXPECT_EQ(json.find('\n'), std::string::npos);
+  EXPECT_NE(json.find("\"label\":\"test\""), std::string::npos);
+  EXPECT_NE(json.find("\"num_residuals\":400"), std::string::npos);
+  EXPECT_NE(json.find("\"iterations\":[{"), std::string::npos);
+}
+
+TEST(BundleAdjustment, SolverTypeThresholds) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, 100, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+
+  BundleAdjustmentOptions options;
+  std::unique_ptr<ceres::LossFunction> loss_function(
+      options.CreateLossFunction());
+  {
+    BundleAdjuster bundle_adjuster(options, config);
+    bundle_adjuster.SetUpProblem(&reconstruction, loss_function.get());
+    EXPECT_EQ(bundle_adjuster
+                  .SetUpSolverOptions(*bundle_adjuster.Problem(),
+                                      options.solver_options)
+                  .linear_solver_type,
+              ceres::DENSE_SCHUR);
+  }
+
+  options.max_num_images_direct_dense_cpu_solver = 1;
+  options.max_num_images_direct_sparse_cpu_solver = 1;
+  {
+    BundleAdjuster bundle_adjuster(options, config);
+    bundle_adjuster.SetUpProblem(&reconstruction, loss_function.get());
+    EXPECT_EQ(bundle_adjuster
+                  .SetUpSolverOptions(*bundle_adjuster.Problem(),
+                                      options.solver_options)
+                  .linear_solver_type,
+              ceres::ITERATIVE_SCHUR);
+  }
+}
+
+TEST(BundleAdjustmentCostFunctionPool, ReuseAndTrim) {
+  BundleAdjustmentCostFunctionPool pool(/*max_num_images=*/2);
+  const Eigen::Vector2d point2D(1, 2);
+  ceres::CostFunction* cost_function1 =
+      pool.Get(1, 3, SimplePinholeCameraModel::model_id, point2D);
+  EXPECT_EQ(pool.Get(1, 3, SimplePinholeCameraModel::model_id, point2D),
+            cost_function1);
+  EXPECT_NE(pool.Get(1, 0, SimplePinholeCameraModel::model_id, point2D),
+            cost_function1);
+  pool.Get(2, 0, SimplePinholeCameraModel::model_id, point2D);
+  pool.Get(1, 0, SimplePinholeCameraModel::model_id, point2D);
+  pool.Get(3, 0, SimplePinholeCameraModel::model_id, point2D);
+  EXPECT_EQ(pool.NumImages(), 3);
+  pool.Trim();
+  EXPECT_EQ(pool.NumImages(), 2);
+  // Image 2 was least recently used and evicted.
+  pool.Get(1, 0, SimplePinholeCameraModel::model_id, point2D);
+  pool.Get(3, 0, SimplePinholeCameraModel::model_id, point2D);
+  EXPECT_EQ(pool.NumImages(), 2);
+  pool.Clear();
+  EXPECT_EQ(pool.NumImages(), 0);
+}
+
 TEST(BundleAdjustment, TwoViewConstantCamera) {
   Reconstruction reconstruction;
   GenerateReconstruction(2, 100, &reconstruction);
@@ -287,6 +457,91 @@ TEST(BundleAdjustment, TwoViewConstantCamera) {
   }
 }
 
+TEST(BundleAdjustment, TwoViewMarginalizeConstantPosePoints) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPose(1);
+  config.SetConstantCamIntrinsics(0);
+
+  BundleAdjustmentOptions options;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  Reconstruction marginalized_reconstruction = orig_reconstruction;
+  options.marginalize_constant_pose_points = true;
+  BundleAdjustmentMarginalizationCache cache;
+  BundleAdjuster marginalized_bundle_adjuster(options, config);
+  marginalized_bundle_adjuster.SetMarginalizationCache(&cache);
+  ASSERT_TRUE(marginalized_bundle_adjuster.Solve(&marginalized_reconstruction));
+  EXPECT_EQ(marginalized_bundle_adjuster.MarginalizedPoints().size(), 100);
+  EXPECT_EQ(cache.NumPoints(), 100);
+
+  // Only the prior on the variable camera remains in the problem.
+  const auto summary = marginalized_bundle_adjuster.Summary();
+  EXPECT_GT(summary.num_residuals_reduced, 0);
+  EXPECT_LE(summary.num_residuals_reduced, 4);
+  // 2 camera parameters.
+  EXPECT_EQ(summary.num_effective_parameters_reduced, 2);
+
+  CheckConstantCamera(marginalized_reconstruction.Camera(0),
+                      orig_reconstruction.Camera(0));
+  CheckVariableCamera(marginalized_reconstruction.Camera(1),
+                      orig_reconstruction.Camera(1));
+  for (const auto& point3D : marginalized_reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+
+  // The linearized priors closely approximate the joint problem.
+  const Camera& camera = reconstruction.Camera(1);
+  const Camera& marginalized_camera = marginalized_reconstruction.Camera(1);
+  EXPECT_NEAR(marginalized_camera.FocalLength(),
+              camera.FocalLength(),
+              1e-3 * camera.FocalLength());
+  EXPECT_NEAR(marginalized_camera.params[3], camera.params[3], 1e-3);
+  for (const auto& point3D : reconstruction.Points3D()) {
+    EXPECT_LT((marginalized_reconstruction.Point3D(point3D.first).xyz -
+               point3D.second.xyz)
+                  .norm(),
+              1e-2);
+  }
+
+  // The cached priors yield identical results.
+  Reconstruction cached_reconstruction = orig_reconstruction;
+  BundleAdjuster cached_bundle_adjuster(options, config);
+  cached_bundle_adjuster.SetMarginalizationCache(&cache);
+  ASSERT_TRUE(cached_bundle_adjuster.Solve(&cached_reconstruction));
+  EXPECT_EQ(cache.NumPoints(), 100);
+  EXPECT_EQ(cached_reconstruction.Camera(1).params,
+            marginalized_reconstruction.Camera(1).params);
+}
+
+TEST(BundleAdjustment, MarginalizeConstantPosePointsVariableImage) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(3, 100, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.AddImage(2);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  // All points are observed by the variable images.
+  BundleAdjustmentOptions options;
+  options.marginalize_constant_pose_points = true;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+  EXPECT_TRUE(bundle_adjuster.MarginalizedPoints().empty());
+  EXPECT_EQ(bundle_adjuster.Summary().num_residuals_reduced, 600);
+}
+
 TEST(BundleAdjustment, PartiallyContainedTracks) {
   Reconstruction reconstruction;
   GenerateReconstruction(3, 100, &reconstruction);
@@ -643,6 +898,65 @@ TEST(BundleAdjustment, ConstantExtraParam) {
   }
 }
 
+TEST(BundleAdjustment, PartitionedSingleProblem) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(4, 100, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    config.AddImage(image_id);
+  }
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  PartitionedBundleAdjustmentOptions options;
+  options.max_num_images = 0;
+  PartitionedBundleAdjuster bundle_adjuster(
+      options, BundleAdjustmentOptions(), config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+  ASSERT_EQ(bundle_adjuster.Partitions().size(), 1);
+  EXPECT_EQ(bundle_adjuster.Partitions()[0].size(), 4);
+}
+
+TEST(BundleAdjustment, PartitionedSixView) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(6, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    config.AddImage(image_id);
+  }
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  PartitionedBundleAdjustmentOptions options;
+  options.max_num_images = 3;
+  options.max_num_iterations = 5;
+  PartitionedBundleAdjuster bundle_adjuster(
+      options, BundleAdjustmentOptions(), config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  // Every image is adjusted in exactly one partition.
+  const auto& partitions = bundle_adjuster.Partitions();
+  EXPECT_GT(partitions.size(), 1);
+  std::unordered_set<image_t> partitioned_image_ids;
+  for (const auto& partition : partitions) {
+    EXPECT_LE(partition.size(), static_cast<size_t>(options.max_num_images));
+    for (const image_t image_id : partition) {
+      EXPECT_TRUE(partitioned_image_ids.insert(image_id).second);
+    }
+  }
+  EXPECT_EQ(partitioned_image_ids.size(), 6);
+
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+  for (image_t image_id = 2; image_id < 6; ++image_id) {
+    CheckVariableImage(reconstruction.Image(image_id),
+                       orig_reconstruction.Image(image_id));
+  }
+}
+
 TEST(BundleAdjustment, RigTwoView) {
   Reconstruction reconstruction;
   GenerateReconstruction(2, 100, &reconstruction);
@@ -34,6 +34,8 @@
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/logging.h"
 
+#include <type_traits>
+
 #include <Eigen/Core>
 #include <ceres/ceres.h>
 #include <ceres/conditioned_cost_function.h>
@@ -137,6 +139,442 @@ class ReprojErrorConstantPoseCostFunction
   const Rigid3d& cam_from_world_;
 };
 
+// Projection of normalized camera coordinates to image coordinates with
+// analytic Jacobians w.r.t. the normalized coordinates (2x2) and the camera
+// parameters (2xN), both in row-major order. The parameter Jacobian may be
+// null. Specialized for the most common camera models used in bundle
+// adjustment, for which the analytical cost functions are used.
+template <typename CameraModel>
+struct AnalyticalImgFromCam {
+  static constexpr bool kEnabled = false;
+};
+
+template <>
+struct AnalyticalImgFromCam<SimpleRadialCameraModel> {
+  static constexpr bool kEnabled = true;
+
+  template <typename T>
+  static void Evaluate(const T* params,
+                       const T u,
+                       const T v,
+                       T* xy,
+                       T* J_uv,
+                       T* J_params) {
+    const T f = params[0];
+    const T k = params[3];
+    const T r2 = u * u + v * v;
+    const T scale = 1 + k * r2;
+    xy[0] = f * u * scale + params[1];
+    xy[1] = f * v * scale + params[2];
+    const T duv = 2 * f * k * u * v;
+    J_uv[0] = f * (scale + 2 * k * u * u);
+    J_uv[1] = duv;
+    J_uv[2] = duv;
+    J_uv[3] = f * (scale + 2 * k * v * v);
+    if (J_params != nullptr) {
+      J_params[0] = u * scale;
+      J_params[1] = 1;
+      J_params[2] = 0;
+      J_params[3] = f * u * r2;
+      J_params[4] = v * scale;
+      J_params[5] = 0;
+      J_params[6] = 1;
+      J_params[7] = f * v * r2;
+    }
+  }
+};
+
+template <>
+struct AnalyticalImgFromCam<PinholeCameraModel> {
+  static constexpr bool kEnabled = true;
+
+  template <typename T>
+  static void Evaluate(const T* params,
+                       const T u,
+                       const T v,
+                       T* xy,
+                       T* J_uv,
+                       T* J_params) {
+    xy[0] = params[0] * u + params[2];
+    xy[1] = params[1] * v + params[3];
+    J_uv[0] = params[0];
+    J_uv[1] = 0;
+    J_uv[2] = 0;
+    J_uv[3] = params[1];
+    if (J_params != nullptr) {
+      J_params[0] = u;
+      J_params[1] = 0;
+      J_params[2] = 1;
+      J_params[3] = 0;
+      J_params[4] = 0;
+      J_params[5] = v;
+      J_params[6] = 0;
+      J_params[7] = 1;
+    }
+  }
+};
+
+template <>
+struct AnalyticalImgFromCam<RadialCameraModel> {
+  static constexpr bool kEnabled = true;
+
+  template <typename T>
+  static void Evaluate(const T* params,
+                       const T u,
+                       const T v,
+                       T* xy,
+                       T* J_uv,
+                       T* J_params) {
+    const T f = params[0];
+    const T k1 = params[3];
+    const T k2 = params[4];
+    const T r2 = u * u + v * v;
+    const T scale = 1 + k1 * r2 + k2 * r2 * r2;
+    const T dscale_dr2 = k1 + 2 * k2 * r2;
+    xy[0] = f * u * scale + params[1];
+    xy[1] = f * v * scale + params[2];
+    const T duv = 2 * f * dscale_dr2 * u * v;
+    J_uv[0] = f * (scale + 2 * dscale_dr2 * u * u);
+    J_uv[1] = duv;
+    J_uv[2] = duv;
+    J_uv[3] = f * (scale + 2 * dscale_dr2 * v * v);
+    if (J_params != nullptr) {
+      J_params[0] = u * scale;
+      J_params[1] = 1;
+      J_params[2] = 0;
+      J_params[3] = f * u * r2;
+      J_params[4] = f * u * r2 * r2;
+      J_params[5] = v * scale;
+      J_params[6] = 0;
+      J_params[7] = 1;
+      J_params[8] = f * v * r2;
+      J_params[9] = f * v * r2 * r2;
+    }
+  }
+};
+
+template <>
+struct AnalyticalImgFromCam<OpenCVCameraModel> {
+  static constexpr bool kEnabled = true;
+
+  template <typename T>
+  static void Evaluate(const T* params,
+                       const T u,
+                       const T v,
+                       T* xy,
+                       T* J_uv,
+                       T* J_params) {
+    const T f1 = params[0];
+    const T f2 = params[1];
+    const T k1 = params[4];
+    const T k2 = params[5];
+    const T p1 = params[6];
+    const T p2 = params[7];
+    const T u2 = u * u;
+    const T uv = u * v;
+    const T v2 = v * v;
+    const T r2 = u2 + v2;
+    const T scale = 1 + k1 * r2 + k2 * r2 * r2;
+    const T dscale_dr2 = k1 + 2 * k2 * r2;
+    const T xd = u * scale + 2 * p1 * uv + p2 * (r2 + 2 * u2);
+    const T yd = v * scale + 2 * p2 * uv + p1 * (r2 + 2 * v2);
+    xy[0] = f1 * xd + params[2];
+    xy[1] = f2 * yd + params[3];
+    J_uv[0] = f1 * (scale + 2 * dscale_dr2 * u2 + 2 * p1 * v + 6 * p2 * u);
+    J_uv[1] = f1 * (2 * dscale_dr2 * uv + 2 * p1 * u + 2 * p2 * v);
+    J_uv[2] = f2 * (2 * dscale_dr2 * uv + 2 * p2 * v + 2 * p1 * u);
+    J_uv[3] = f2 * (scale + 2 * dscale_dr2 * v2 + 2 * p2 * u + 6 * p1 * v);
+    if (J_params != nullptr) {
+      J_params[0] = xd;
+      J_params[1] = 0;
+      J_params[2] = 1;
+      J_params[3] = 0;
+      J_params[4] = f1 * u * r2;
+      J_params[5] = f1 * u * r2 * r2;
+      J_params[6] = f1 * 2 * uv;
+      J_params[7] = f1 * (r2 + 2 * u2);
+      J_params[8] = 0;
+      J_params[9] = yd;
+      J_params[10] = 0;
+      J_params[11] = 1;
+      J_params[12] = f2 * v * r2;
+      J_params[13] = f2 * v * r2 * r2;
+      J_params[14] = f2 * (r2 + 2 * v2);
+      J_params[15] = f2 * 2 * uv;
+    }
+  }
+};
+
+// Residual and Jacobians of the reprojection error w.r.t. the camera point,
+// shared by the analytical cost functions. Returns the 2x3 Jacobian of the
+// residual w.r.t. the point in camera coordinates in J_point3D_in_cam.
+template <typename CameraModel, typename T>
+inline void EvaluateAnalyticalReprojError(
+    const T observed_x,
+    const T observed_y,
+    const Eigen::Matrix<T, 3, 1>& point3D_in_cam,
+    const T* camera_params,
+    T* residuals,
+    T* J_point3D_in_cam,
+    T* J_params) {
+  const T inv_z = 1 / point3D_in_cam[2];
+  const T u = point3D_in_cam[0] * inv_z;
+  const T v = point3D_in_cam[1] * inv_z;
+  T J_uv[4];
+  AnalyticalImgFromCam<CameraModel>::Evaluate(
+      camera_params, u, v, residuals, J_uv, J_params);
+  residuals[0] -= observed_x;
+  residuals[1] -= observed_y;
+  if (J_point3D_in_cam != nullptr) {
+    // Chain rule with d(u, v) / d(point3D_in_cam).
+    J_point3D_in_cam[0] = J_uv[0] * inv_z;
+    J_point3D_in_cam[1] = J_uv[1] * inv_z;
+    J_point3D_in_cam[2] = -(J_uv[0] * u + J_uv[1] * v) * inv_z;
+    J_point3D_in_cam[3] = J_uv[2] * inv_z;
+    J_point3D_in_cam[4] = J_uv[3] * inv_z;
+    J_point3D_in_cam[5] = -(J_uv[2] * u + J_uv[3] * v) * inv_z;
+  }
+}
+
+// Jacobians of the reprojection error w.r.t. the point in camera coordinates
+// and the camera parameters, evaluated in the precision T. The residuals are
+// always evaluated in double precision, such that the cost and thus the step
+// acceptance of the solver is unaffected by a lower precision of T.
+template <typename CameraModel, typename T>
+inline void EvaluateMixedPrecisionReprojError(
+    const Eigen::Vector2d& observed,
+    const Eigen::Vector3d& point3D_in_cam,
+    const double* camera_params,
+    double* residuals,
+    Eigen::Matrix<T, 2, 3, Eigen::RowMajor>* J_point3D_in_cam,
+    double* J_params) {
+  if constexpr (std::is_same_v<T, double>) {
+    EvaluateAnalyticalReprojError<CameraModel>(observed.x(),
+                                               observed.y(),
+                                               point3D_in_cam,
+                                               camera_params,
+                                               residuals,
+                                               J_point3D_in_cam->data(),
+                                               J_params);
+  } else {
+    EvaluateAnalyticalReprojError<CameraModel, double>(observed.x(),
+                                                       observed.y(),
+                                                       point3D_in_cam,
+                                                       camera_params,
+                                                       residuals,
+                                                       nullptr,
+                                                       nullptr);
+    const Eigen::Matrix<T, CameraModel::num_params, 1> camera_params_T =
+        Eigen::Map<const Eigen::Matrix<double, CameraModel::num_params, 1>>(
+            camera_params)
+            .template cast<T>();
+    T residuals_T[2];
+    Eigen::Matrix<T, 2, CameraModel::num_params, Eigen::RowMajor> J_params_T;
+    EvaluateAnalyticalReprojError<CameraModel>(
+        static_cast<T>(observed.x()),
+        static_cast<T>(observed.y()),
+        Eigen::Matrix<T, 3, 1>(point3D_in_cam.template cast<T>()),
+        camera_params_T.data(),
+        residuals_T,
+        J_point3D_in_cam->data(),
+        J_params == nullptr ? nullptr : J_params_T.data());
+    if (J_params != nullptr) {
+      Eigen::Map<
+          Eigen::Matrix<double, 2, CameraModel::num_params, Eigen::RowMajor>>
+          J_params_map(J_params);
+      J_params_map = J_params_T.template cast<double>();
+    }
+  }
+}
+
+// Analytical variant of ReprojErrorCostFunction, which avoids the overhead of
+// automatic differentiation over the camera model and the quaternion rotation.
+// The quaternion Jacobian is w.r.t. the ambient Eigen coefficients (x, y, z,
+// w) and identical to the automatic one of the rotation by Eigen. The
+// Jacobians are evaluated in the precision T and the residuals in double.
+template <typename CameraModel, typename T = double>
+class AnalyticalReprojErrorCostFunction
+    : public ceres::SizedCostFunction<2, 4, 3, 3, CameraModel::num_params> {
+ public:
+  explicit AnalyticalReprojErrorCostFunction(const Eigen::Vector2d& point2D)
+      : observed_(point2D) {}
+
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D) {
+    return new AnalyticalReprojErrorCostFunction(point2D);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const final {
+    // Rotation by the unit quaternion as in Eigen:
+    // p = X + w * uv + q_xyz x uv, with uv = 2 * q_xyz x X.
+    const Eigen::Map<const Eigen::Vector3d> q_xyz(parameters[0]);
+    const double q_w = parameters[0][3];
+    const Eigen::Map<const Eigen::Vector3d> point3D(parameters[2]);
+    const Eigen::Vector3d uv = 2 * q_xyz.cross(point3D);
+    const Eigen::Vector3d point3D_in_cam =
+        point3D + q_w * uv + q_xyz.cross(uv) +
+        Eigen::Map<const Eigen::Vector3d>(parameters[1]);
+
+    if (jacobians == nullptr) {
+      EvaluateAnalyticalReprojError<CameraModel, double>(observed_.x(),
+                                                         observed_.y(),
+                                                         point3D_in_cam,
+                                                         parameters[3],
+                                                         residuals,
+                                                         nullptr,
+                                                         nullptr);
+      return true;
+    }
+
+    Eigen::Matrix<T, 2, 3, Eigen::RowMajor> J_point3D_in_cam;
+    EvaluateMixedPrecisionReprojError<CameraModel>(observed_,
+                                                   point3D_in_cam,
+                                                   parameters[3],
+                                                   residuals,
+                                                   &J_point3D_in_cam,
+                                                   jacobians[3]);
+
+    const Eigen::Matrix<T, 3, 1> q_xyz_T = q_xyz.template cast<T>();
+    const T q_w_T = static_cast<T>(q_w);
+    const Eigen::Matrix<T, 3, 1> point3D_T = point3D.template cast<T>();
+    const Eigen::Matrix<T, 3, 1> uv_T = uv.template cast<T>();
+
+    // The Jacobians of the rotation are chained row-wise with the identity
+    // r^T [a]x = (r x a)^T, where [a]x is the cross product matrix of a.
+    for (int i = 0; i < 2; ++i) {
+      const Eigen::Matrix<T, 3, 1> r = J_point3D_in_cam.row(i).transpose();
+      const Eigen::Matrix<T, 3, 1> r_cross_q = r.cross(q_xyz_T);
+      if (jacobians[0] != nullptr) {
+        // d(p) / d(q_xyz) = -2 w [X]x - [uv]x - 2 [q_xyz]x [X]x and
+        // d(p) / d(q_w) = uv.
+        Eigen::Map<Eigen::Vector3d>(jacobians[0] + 4 * i) =
+            (-2 * q_w_T * r.cross(point3D_T) - r.cross(uv_T) -
+             2 * r_cross_q.cross(point3D_T))
+                .template cast<double>();
+        jacobians[0][4 * i + 3] = static_cast<double>(r.dot(uv_T));
+      }
+      if (jacobians[1] != nullptr) {
+        Eigen::Map<Eigen::Vector3d>(jacobians[1] + 3 * i) =
+            r.template cast<double>();
+      }
+      if (jacobians[2] != nullptr) {
+        // d(p) / d(X) = I + 2 w [q_xyz]x + 2 [q_xyz]x^2, i.e., the rotation.
+        Eigen::Map<Eigen::Vector3d>(jacobians[2] + 3 * i) =
+            (r + 2 * q_w_T * r_cross_q + 2 * r_cross_q.cross(q_xyz_T))
+                .template cast<double>();
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  const Eigen::Vector2d observed_;
+};
+
+// Analytical variant of ReprojErrorConstantPoseCostFunction.
+template <typename CameraModel, typename T = double>
+class AnalyticalReprojErrorConstantPoseCostFunction
+    : public ceres::SizedCostFunction<2, 3, CameraModel::num_params> {
+ public:
+  AnalyticalReprojErrorConstantPoseCostFunction(const Rigid3d& cam_from_world,
+                                                const Eigen::Vector2d& point2D)
+      : observed_(point2D), cam_from_world_(cam_from_world) {}
+
+  static ceres::CostFunction* Create(const Rigid3d& cam_from_world,
+                                     const Eigen::Vector2d& point2D) {
+    return new AnalyticalReprojErrorConstantPoseCostFunction(cam_from_world,
+                                                             point2D);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const final {
+    const Eigen::Vector3d point3D_in_cam =
+        cam_from_world_ * Eigen::Map<const Eigen::Vector3d>(parameters[0]);
+
+    if (jacobians == nullptr) {
+      EvaluateAnalyticalReprojError<CameraModel, double>(observed_.x(),
+                                                         observed_.y(),
+                                                         point3D_in_cam,
+                                                         parameters[1],
+                                                         residuals,
+                                                         nullptr,
+                                                         nullptr);
+      return true;
+    }
+
+    Eigen::Matrix<T, 2, 3, Eigen::RowMajor> J_point3D_in_cam;
+    EvaluateMixedPrecisionReprojError<CameraModel>(observed_,
+                                                   point3D_in_cam,
+                                                   parameters[1],
+                                                   residuals,
+                                                   &J_point3D_in_cam,
+                                                   jacobians[1]);
+
+    if (jacobians[0] != nullptr) {
+      // Chain with the rotation as in AnalyticalReprojErrorCostFunction.
+      const Eigen::Matrix<T, 3, 1> q_xyz =
+          cam_from_world_.rotation.vec().template cast<T>();
+      const T q_w = static_cast<T>(cam_from_world_.rotation.w());
+      for (int i = 0; i < 2; ++i) {
+        const Eigen::Matrix<T, 3, 1> r = J_point3D_in_cam.row(i).transpose();
+        const Eigen::Matrix<T, 3, 1> r_cross_q = r.cross(q_xyz);
+        Eigen::Map<Eigen::Vector3d>(jacobians[0] + 3 * i) =
+            (r + 2 * q_w * r_cross_q + 2 * r_cross_q.cross(q_xyz))
+                .template cast<double>();
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  const Eigen::Vector2d observed_;
+  const Rigid3d& cam_from_world_;
+};
+
+// Create the analytical reprojection error cost functions for the camera
+// models that support them and the automatically differentiated ones
+// otherwise. The Jacobians of the analytical cost functions are optionally
+// evaluated in single precision.
+template <typename CameraModel>
+struct DefaultReprojErrorCostFunction {
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D,
+                                     const bool float_jacobians = false) {
+    if constexpr (AnalyticalImgFromCam<CameraModel>::kEnabled) {
+      if (float_jacobians) {
+        return AnalyticalReprojErrorCostFunction<CameraModel, float>::Create(
+            point2D);
+      }
+      return AnalyticalReprojErrorCostFunction<CameraModel>::Create(point2D);
+    } else {
+      return ReprojErrorCostFunction<CameraModel>::Create(point2D);
+    }
+  }
+};
+
+template <typename CameraModel>
+struct DefaultReprojErrorConstantPoseCostFunction {
+  static ceres::CostFunction* Create(const Rigid3d& cam_from_world,
+                                     const Eigen::Vector2d& point2D,
+                                     const bool float_jacobians = false) {
+    if constexpr (AnalyticalImgFromCam<CameraModel>::kEnabled) {
+      if (float_jacobians) {
+        return AnalyticalReprojErrorConstantPoseCostFunction<
+            CameraModel,
+            float>::Create(cam_from_world, point2D);
+      }
+      return AnalyticalReprojErrorConstantPoseCostFunction<
+          CameraModel>::Create(cam_from_world, point2D);
+    } else {
+      return ReprojErrorConstantPoseCostFunction<CameraModel>::Create(
+          cam_from_world, point2D);
+    }
+  }
+};
+
 // Bundle adjustment cost function for variable
 // camera pose and calibration parameters, and fixed point.
 template <typename CameraModel>
@@ -453,6 +891,79 @@ struct MetricRelativePoseErrorCostFunction {
   const EigenMatrix6d sqrt_information_j_;
 };
 
+// 3-DoF error between the rotations of two absolute poses based on a
+// measurement of their relative rotation, as used in rotation averaging. The
+// residual is the angle-axis of the error rotation:
+// ΔR = log(j_R_w·i_R_w⁻¹·j_R_i⁻¹)
+struct RelativeRotationErrorCostFunction {
+ public:
+  explicit RelativeRotationErrorCostFunction(
+      const Eigen::Quaterniond& j_from_i)
+      : i_from_j_(j_from_i.inverse()) {}
+
+  static ceres::CostFunction* Create(const Eigen::Quaterniond& j_from_i) {
+    return (
+        new ceres::AutoDiffCostFunction<RelativeRotationErrorCostFunction,
+                                        3,
+                                        4,
+                                        4>(
+            new RelativeRotationErrorCostFunction(j_from_i)));
+  }
+
+  template <typename T>
+  bool operator()(const T* const i_from_world_q,
+                  const T* const j_from_world_q,
+                  T* residuals_ptr) const {
+    const Eigen::Quaternion<T> param_from_measured_q =
+        EigenQuaternionMap<T>(j_from_world_q) *
+        EigenQuaternionMap<T>(i_from_world_q).inverse() *
+        i_from_j_.cast<T>();
+    EigenQuaternionToAngleAxis(param_from_measured_q.coeffs().data(),
+                               residuals_ptr);
+    return true;
+  }
+
+ private:
+  const Eigen::Quaterniond i_from_j_;
+};
+
+// Error between the positions of two cameras based on a measurement of the
+// unit direction from the first to the second camera in the world frame, as
+// used in translation averaging. The unknown distance of the cameras is a
+// separate parameter, which should be bounded below by 1 to fix the scale and
+// to avoid the trivial solution of coincident positions:
+// residual = position_j - position_i - distance * direction_ij
+struct PairwiseDirectionErrorCostFunction {
+ public:
+  explicit PairwiseDirectionErrorCostFunction(
+      const Eigen::Vector3d& direction_ij)
+      : direction_ij_(direction_ij) {}
+
+  static ceres::CostFunction* Create(const Eigen::Vector3d& direction_ij) {
+    return (new ceres::AutoDiffCostFunction<PairwiseDirectionErrorCostFunction,
+                                            3,
+                                            3,
+                                            3,
+                                            1>(
+        new PairwiseDirectionErrorCostFunction(direction_ij)));
+  }
+
+  template <typename T>
+  bool operator()(const T* const position_i,
+                  const T* const position_j,
+                  const T* const distance,
+                  T* residuals_ptr) const {
+    Eigen::Map<Eigen::Matrix<T, 3, 1>> residuals(residuals_ptr);
+    residuals = EigenVector3Map<T>(position_j) -
+                EigenVector3Map<T>(position_i) -
+                distance[0] * direction_ij_.cast<T>();
+    return true;
+  }
+
+ private:
+  const Eigen::Vector3d direction_ij_;
+};
+
 // Cost function for aligning one 3D point with a reference 3D point with
 // covariance. Convention is similar to colmap::Sim3d
 // residual = scale_b_from_a * R_b_from_a * point_in_a + t_b_from_a -
@@ -493,6 +1004,103 @@ struct Point3dAlignmentCostFunction {
   const Eigen::Matrix3d sqrt_information_point_;
 };
 
+// Linear cost function pulling a parameter block of arbitrary size towards a
+// reference value with an isotropic weight, i.e. the penalty term of consensus
+// optimization schemes such as ADMM:
+// residual = sqrt(weight) * (param - ref_param)
+class ConsensusPriorCostFunction : public ceres::CostFunction {
+ public:
+  ConsensusPriorCostFunction(const Eigen::VectorXd& ref_param,
+                             const double weight)
+      : ref_param_(ref_param), sqrt_weight_(std::sqrt(weight)) {
+    set_num_residuals(ref_param_.size());
+    mutable_parameter_block_sizes()->push_back(ref_param_.size());
+  }
+
+  static ceres::CostFunction* Create(const Eigen::VectorXd& ref_param,
+                                     const double weight) {
+    return new ConsensusPriorCostFunction(ref_param, weight);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const final {
+    const int size = ref_param_.size();
+    Eigen::Map<Eigen::VectorXd>(residuals, size) =
+        sqrt_weight_ *
+        (Eigen::Map<const Eigen::VectorXd>(parameters[0], size) - ref_param_);
+    if (jacobians != nullptr && jacobians[0] != nullptr) {
+      Eigen::Map<Eigen::MatrixXd>(jacobians[0], size, size) =
+          sqrt_weight_ * Eigen::MatrixXd::Identity(size, size);
+    }
+    return true;
+  }
+
+ private:
+  const Eigen::VectorXd ref_param_;
+  const double sqrt_weight_;
+};
+
+// Linear cost function of the stacked parameter blocks x as the square root
+// form of the quadratic prior 0.5 (x - mean)^T H (x - mean), where
+// H = sqrt_information^T sqrt_information, e.g., the prior that remains on
+// the other parameters after marginalizing parameters of a linearized problem:
+// residual = sqrt_information * (x - mean)
+class LinearPriorCostFunction : public ceres::CostFunction {
+ public:
+  LinearPriorCostFunction(const Eigen::MatrixXd& sqrt_information,
+                          const Eigen::VectorXd& mean,
+                          const std::vector<int>& parameter_block_sizes)
+      : sqrt_information_(sqrt_information), mean_(mean) {
+    THROW_CHECK_EQ(sqrt_information_.cols(), mean_.size());
+    int num_params = 0;
+    for (const int block_size : parameter_block_sizes) {
+      num_params += block_size;
+      mutable_parameter_block_sizes()->push_back(block_size);
+    }
+    THROW_CHECK_EQ(num_params, mean_.size());
+    set_num_residuals(sqrt_information_.rows());
+  }
+
+  static ceres::CostFunction* Create(
+      const Eigen::MatrixXd& sqrt_information,
+      const Eigen::VectorXd& mean,
+      const std::vector<int>& parameter_block_sizes) {
+    return new LinearPriorCostFunction(
+        sqrt_information, mean, parameter_block_sizes);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const final {
+    const std::vector<int32_t>& block_sizes = parameter_block_sizes();
+    Eigen::Map<Eigen::VectorXd> residuals_map(residuals, num_residuals());
+    residuals_map.setZero();
+    int offset = 0;
+    for (size_t i = 0; i < block_sizes.size(); ++i) {
+      const int block_size = block_sizes[i];
+      residuals_map += sqrt_information_.middleCols(offset, block_size) *
+                       (Eigen::Map<const Eigen::VectorXd>(parameters[i],
+                                                          block_size) -
+                        mean_.segment(offset, block_size));
+      if (jacobians != nullptr && jacobians[i] != nullptr) {
+        Eigen::Map<Eigen::Matrix<double,
+                                 Eigen::Dynamic,
+                                 Eigen::Dynamic,
+                                 Eigen::RowMajor>>(
+            jacobians[i], num_residuals(), block_size) =
+            sqrt_information_.middleCols(offset, block_size);
+      }
+      offset += block_size;
+    }
+    return true;
+  }
+
+ private:
+  const Eigen::MatrixXd sqrt_information_;
+  const Eigen::VectorXd mean_;
+};
+
 // A cost function that wraps another one and whiten its residuals with an
 // isotropic covariance, i.e. assuming that the variance is identical in and
 // independent between each dimension of the residual.
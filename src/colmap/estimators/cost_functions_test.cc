@@ -111,6 +111,113 @@ TEST(BundleAdjustment, ConstantPoseAbsolutePose) {
   EXPECT_EQ(residuals[1], 2);
 }
 
+template <typename CameraModel, typename T = double>
+void ExpectEqualAnalyticalReprojErrorCostFunction(
+    const std::vector<double>& camera_params) {
+  ASSERT_EQ(camera_params.size(), CameraModel::num_params);
+  const Eigen::Vector2d point2D(RandomUniformReal(-10.0, 10.0),
+                                RandomUniformReal(-10.0, 10.0));
+  Rigid3d cam_from_world(Eigen::Quaterniond::UnitRandom(),
+                         Eigen::Vector3d::Random());
+  Eigen::Vector3d point3D = Eigen::Vector3d::Random();
+  point3D.z() += 10;
+  std::vector<double> params = camera_params;
+
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      ReprojErrorCostFunction<CameraModel>::Create(point2D));
+  std::unique_ptr<ceres::CostFunction> analytical_cost_function(
+      AnalyticalReprojErrorCostFunction<CameraModel, T>::Create(point2D));
+  const double* parameters[4] = {cam_from_world.rotation.coeffs().data(),
+                                 cam_from_world.translation.data(),
+                                 point3D.data(),
+                                 params.data()};
+  const int block_sizes[4] = {4, 3, 3, CameraModel::num_params};
+  std::vector<std::vector<double>> jacobians(4);
+  std::vector<std::vector<double>> analytical_jacobians(4);
+  double* jacobian_ptrs[4];
+  double* analytical_jacobian_ptrs[4];
+  for (int i = 0; i < 4; ++i) {
+    jacobians[i].resize(2 * block_sizes[i]);
+    analytical_jacobians[i].resize(2 * block_sizes[i]);
+    jacobian_ptrs[i] = jacobians[i].data();
+    analytical_jacobian_ptrs[i] = analytical_jacobians[i].data();
+  }
+  double residuals[2];
+  double analytical_residuals[2];
+  EXPECT_TRUE(cost_function->Evaluate(parameters, residuals, jacobian_ptrs));
+  EXPECT_TRUE(analytical_cost_function->Evaluate(
+      parameters, analytical_residuals, analytical_jacobian_ptrs));
+  // The residuals are always evaluated in double precision.
+  constexpr double kEps = 1e-8;
+  const double kJacobianEps = std::is_same_v<T, float> ? 1e-4 : kEps;
+  for (int r = 0; r < 2; ++r) {
+    EXPECT_NEAR(analytical_residuals[r], residuals[r], kEps);
+  }
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 2 * block_sizes[i]; ++j) {
+      EXPECT_NEAR(analytical_jacobians[i][j],
+                  jacobians[i][j],
+                  kJacobianEps * std::max(1.0, std::abs(jacobians[i][j])));
+    }
+  }
+
+  std::unique_ptr<ceres::CostFunction> analytical_constant_pose_cost_function(
+      AnalyticalReprojErrorConstantPoseCostFunction<CameraModel, T>::Create(
+          cam_from_world, point2D));
+  const double* constant_pose_parameters[2] = {point3D.data(), params.data()};
+  double* constant_pose_jacobian_ptrs[2] = {analytical_jacobian_ptrs[2],
+                                            analytical_jacobian_ptrs[3]};
+  EXPECT_TRUE(analytical_constant_pose_cost_function->Evaluate(
+      constant_pose_parameters,
+      analytical_residuals,
+      constant_pose_jacobian_ptrs));
+  for (int r = 0; r < 2; ++r) {
+    EXPECT_NEAR(analytical_residuals[r], residuals[r], kEps);
+  }
+  for (int i = 2; i < 4; ++i) {
+    for (int j = 0; j < 2 * block_sizes[i]; ++j) {
+      EXPECT_NEAR(analytical_jacobians[i][j],
+                  jacobians[i][j],
+                  kJacobianEps * std::max(1.0, std::abs(jacobians[i][j])));
+    }
+  }
+
+  // Residuals without Jacobians.
+  EXPECT_TRUE(analytical_cost_function->Evaluate(
+      parameters, analytical_residuals, nullptr));
+  for (int r = 0; r < 2; ++r) {
+    EXPECT_NEAR(analytical_residuals[r], residuals[r], kEps);
+  }
+}
+
+TEST(BundleAdjustment, AnalyticalReprojErrorCostFunction) {
+  SetPRNGSeed(0);
+  for (int i = 0; i < 10; ++i) {
+    ExpectEqualAnalyticalReprojErrorCostFunction<SimpleRadialCameraModel>(
+        {500, 300, 200, 0.05});
+    ExpectEqualAnalyticalReprojErrorCostFunction<PinholeCameraModel>(
+        {500, 480, 300, 200});
+    ExpectEqualAnalyticalReprojErrorCostFunction<RadialCameraModel>(
+        {500, 300, 200, 0.05, -0.01});
+    ExpectEqualAnalyticalReprojErrorCostFunction<OpenCVCameraModel>(
+        {500, 480, 300, 200, 0.05, -0.01, 0.001, -0.002});
+  }
+}
+
+TEST(BundleAdjustment, FloatJacobianAnalyticalReprojErrorCostFunction) {
+  SetPRNGSeed(0);
+  for (int i = 0; i < 10; ++i) {
+    ExpectEqualAnalyticalReprojErrorCostFunction<SimpleRadialCameraModel,
+                                                 float>({500, 300, 200, 0.05});
+    ExpectEqualAnalyticalReprojErrorCostFunction<PinholeCameraModel, float>(
+        {500, 480, 300, 200});
+    ExpectEqualAnalyticalReprojErrorCostFunction<RadialCameraModel, float>(
+        {500, 300, 200, 0.05, -0.01});
+    ExpectEqualAnalyticalReprojErrorCostFunction<OpenCVCameraModel, float>(
+        {500, 480, 300, 200, 0.05, -0.01, 0.001, -0.002});
+  }
+}
+
 TEST(BundleAdjustment, ConstantPoint3DAbsolutePose) {
   Eigen::Vector2d point2D = Eigen::Vector2d::Zero();
   Eigen::Vector3d point3D;
@@ -362,6 +469,55 @@ TEST(PoseGraphOptimization, RelativePose) {
   EXPECT_NEAR(residuals[5], 0.5, 1e-6);
 }
 
+TEST(RotationAveraging, RelativeRotationError) {
+  // Rotation by 90 degrees around the Y axis.
+  Eigen::Matrix3d rotation_matrix;
+  rotation_matrix << 0, 0, 1, 0, 1, 0, -1, 0, 0;
+  const Eigen::Quaterniond j_from_i(rotation_matrix);
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      RelativeRotationErrorCostFunction::Create(j_from_i));
+
+  Eigen::Quaterniond i_from_world = Eigen::Quaterniond::UnitRandom();
+  Eigen::Quaterniond j_from_world = j_from_i * i_from_world;
+  double residuals[3];
+  const double* parameters[2] = {i_from_world.coeffs().data(),
+                                 j_from_world.coeffs().data()};
+  EXPECT_TRUE(cost_function->Evaluate(parameters, residuals, nullptr));
+  EXPECT_NEAR(residuals[0], 0, 1e-6);
+  EXPECT_NEAR(residuals[1], 0, 1e-6);
+  EXPECT_NEAR(residuals[2], 0, 1e-6);
+
+  j_from_world =
+      Eigen::Quaterniond(Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitZ())) *
+      j_from_world;
+  EXPECT_TRUE(cost_function->Evaluate(parameters, residuals, nullptr));
+  EXPECT_NEAR(residuals[0], 0, 1e-6);
+  EXPECT_NEAR(residuals[1], 0, 1e-6);
+  EXPECT_NEAR(residuals[2], 0.1, 1e-6);
+}
+
+TEST(TranslationAveraging, PairwiseDirectionError) {
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      PairwiseDirectionErrorCostFunction::Create(Eigen::Vector3d(0, 0, 1)));
+
+  double position_i[3] = {1, 2, 3};
+  double position_j[3] = {1, 2, 5};
+  double distance = 2;
+  double residuals[3];
+  const double* parameters[3] = {position_i, position_j, &distance};
+  EXPECT_TRUE(cost_function->Evaluate(parameters, residuals, nullptr));
+  EXPECT_EQ(residuals[0], 0);
+  EXPECT_EQ(residuals[1], 0);
+  EXPECT_EQ(residuals[2], 0);
+
+  position_j[0] = 2;
+  distance = 1;
+  EXPECT_TRUE(cost_function->Evaluate(parameters, residuals, nullptr));
+  EXPECT_EQ(residuals[0], 1);
+  EXPECT_EQ(residuals[1], 0);
+  EXPECT_EQ(residuals[2], 1);
+}
+
 TEST(PoseGraphOptimization, Point3dAlignment) {
   // generate a test transformation
   Sim3d tform = Sim3d(RandomUniformReal<double>(0.1, 10),
@@ -388,5 +544,41 @@ TEST(PoseGraphOptimization, Point3dAlignment) {
   EXPECT_NEAR(residuals[2], error[2] / 2.0, 1e-6);
 }
 
+TEST(ConsensusPrior, Evaluate) {
+  const Eigen::VectorXd ref_param = Eigen::Vector4d(1, 2, 3, 4);
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      ConsensusPriorCostFunction::Create(ref_param, 4.));
+  const Eigen::Vector4d param(2, 2, 1, 4);
+  const double* parameters[1] = {param.data()};
+  Eigen::Vector4d residuals;
+  Eigen::Matrix4d jacobian;
+  double* jacobians[1] = {jacobian.data()};
+  EXPECT_TRUE(
+      cost_function->Evaluate(parameters, residuals.data(), jacobians));
+  EXPECT_EQ(residuals, Eigen::Vector4d(2, 0, -4, 0));
+  EXPECT_EQ(jacobian, 2 * Eigen::Matrix4d::Identity());
+}
+
+TEST(LinearPrior, Evaluate) {
+  Eigen::MatrixXd sqrt_information(2, 3);
+  sqrt_information << 1, 2, 3, 4, 5, 6;
+  const Eigen::VectorXd mean = Eigen::Vector3d(1, 2, 3);
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      LinearPriorCostFunction::Create(sqrt_information, mean, {1, 2}));
+  EXPECT_EQ(cost_function->num_residuals(), 2);
+  const double param1 = 2;
+  const Eigen::Vector2d param2(2, 4);
+  const double* parameters[2] = {&param1, param2.data()};
+  Eigen::Vector2d residuals;
+  Eigen::Vector2d jacobian1;
+  Eigen::Matrix<double, 2, 2, Eigen::RowMajor> jacobian2;
+  double* jacobians[2] = {jacobian1.data(), jacobian2.data()};
+  EXPECT_TRUE(
+      cost_function->Evaluate(parameters, residuals.data(), jacobians));
+  EXPECT_EQ(residuals, Eigen::Vector2d(4, 10));
+  EXPECT_EQ(jacobian1, Eigen::Vector2d(1, 4));
+  EXPECT_EQ(jacobian2, sqrt_information.rightCols(2));
+}
+
 }  // namespace
 }  // namespace colmap
@@ -30,10 +30,126 @@
 #include "colmap/estimators/covariance.h"
 
 #include "colmap/estimators/manifold.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <set>
 
 #include <ceres/crs_matrix.h>
 
 namespace colmap {
+namespace {
+
+// Entries of the inverse of a sparse symmetric positive definite matrix
+// A = P^T L D L^T P on the sparsity pattern of its Cholesky factor L, which
+// contains the pattern of A. The entries are recovered by the Takahashi
+// recursion without forming the dense inverse:
+// Z_ij = delta_ij / D_i - sum_{k > i} L_ki Z_kj for i <= j, where Z is the
+// inverse of L D L^T. Column i only depends on the columns of its ancestors
+// in the elimination tree, such that the columns of every level of the tree
+// are recovered in parallel.
+class SparseInverseSubset {
+ public:
+  SparseInverseSubset(
+      const Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>>& ldlt,
+      ThreadPool* thread_pool)
+      : perm_(ldlt.permutationP().indices()) {
+    const Eigen::SparseMatrix<double> L = ldlt.matrixL();
+    const Eigen::VectorXd D = ldlt.vectorD();
+    const int n = L.cols();
+    rows_.resize(n);
+    L_values_.resize(n);
+    Z_values_.resize(n);
+    Z_diag_.resize(n);
+    for (int col = 0; col < n; ++col) {
+      std::vector<std::pair<int, double>> entries;
+      for (Eigen::SparseMatrix<double>::InnerIterator it(L, col); it; ++it) {
+        if (it.row() > col) {
+          entries.emplace_back(it.row(), it.value());
+        }
+      }
+      std::sort(entries.begin(), entries.end());
+      for (const auto& [row, value] : entries) {
+        rows_[col].push_back(row);
+        L_values_[col].push_back(value);
+      }
+      Z_values_[col].resize(entries.size());
+    }
+
+    // The parent of a column in the elimination tree is the row of its first
+    // off-diagonal entry and all its ancestors have a lower depth.
+    std::vector<int> depths(n, 0);
+    int max_depth = 0;
+    for (int col = n - 1; col >= 0; --col) {
+      if (!rows_[col].empty()) {
+        depths[col] = depths[rows_[col].front()] + 1;
+        max_depth = std::max(max_depth, depths[col]);
+      }
+    }
+    std::vector<std::vector<int>> levels(max_depth + 1);
+    for (int col = 0; col < n; ++col) {
+      levels[depths[col]].push_back(col);
+    }
+
+    const size_t kMinNumColumnsPerChunk = 16;
+    for (const std::vector<int>& level : levels) {
+      ParallelForChunks(thread_pool,
+                        level.size(),
+                        kMinNumColumnsPerChunk,
+                        [&](const size_t begin, const size_t end) {
+                          for (size_t i = begin; i < end; ++i) {
+                            RecoverColumn(level[i], D(level[i]));
+                          }
+                        });
+    }
+  }
+
+  // Entry of the inverse of A, which must be on the pattern of L or L^T.
+  double Coeff(const int row, const int col) const {
+    return PermutedCoeff(perm_(row), perm_(col));
+  }
+
+ private:
+  double PermutedCoeff(const int row, const int col) const {
+    if (row == col) {
+      return Z_diag_[row];
+    }
+    const int lower = std::min(row, col);
+    const int upper = std::max(row, col);
+    const std::vector<int>& rows = rows_[lower];
+    const auto it = std::lower_bound(rows.begin(), rows.end(), upper);
+    THROW_CHECK(it != rows.end() && *it == upper)
+        << "Entry is not on the sparsity pattern of the Cholesky factor";
+    return Z_values_[lower][it - rows.begin()];
+  }
+
+  void RecoverColumn(const int col, const double d) {
+    const std::vector<int>& rows = rows_[col];
+    const std::vector<double>& L_values = L_values_[col];
+    std::vector<double>& Z_values = Z_values_[col];
+    for (size_t j = 0; j < rows.size(); ++j) {
+      double value = 0;
+      for (size_t k = 0; k < rows.size(); ++k) {
+        value -= L_values[k] * PermutedCoeff(rows[k], rows[j]);
+      }
+      Z_values[j] = value;
+    }
+    double diag = 1 / d;
+    for (size_t k = 0; k < rows.size(); ++k) {
+      diag -= L_values[k] * Z_values[k];
+    }
+    Z_diag_[col] = diag;
+  }
+
+  const Eigen::VectorXi perm_;
+  // Strictly lower triangular part of L and Z in column-major order.
+  std::vector<std::vector<int>> rows_;
+  std::vector<std::vector<double>> L_values_;
+  std::vector<std::vector<double>> Z_values_;
+  std::vector<double> Z_diag_;
+};
+
+}  // namespace
 
 BundleAdjustmentCovarianceEstimatorBase::
     BundleAdjustmentCovarianceEstimatorBase(ceres::Problem* problem,
@@ -483,13 +599,26 @@ bool BundleAdjustmentCovarianceEstimator::HasValidPoseFactorization() const {
   return L_matrix_poses_inv_.size() != 0;
 }
 
+bool BundleAdjustmentCovarianceEstimator::HasValidBlockDiagonalPoseCovariance()
+    const {
+  return !cov_pose_blocks_.empty();
+}
+
 double BundleAdjustmentCovarianceEstimator::GetPoseCovarianceByIndex(
     int row, int col) const {
-  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization());
-  if (HasValidPoseCovariance())
+  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization() ||
+              HasValidBlockDiagonalPoseCovariance());
+  if (HasValidPoseCovariance()) {
     return cov_poses_(row, col);
-  else
+  } else if (HasValidPoseFactorization()) {
     return L_matrix_poses_inv_.col(row).dot(L_matrix_poses_inv_.col(col));
+  }
+  // HasValidBlockDiagonalPoseCovariance() == true
+  const auto& [row_block, row_index] = pose_index_to_block_.at(row);
+  const auto& [col_block, col_index] = pose_index_to_block_.at(col);
+  THROW_CHECK_EQ(row_block, col_block)
+      << "Only the block-diagonal pose covariances were computed";
+  return cov_pose_blocks_[row_block](row_index, col_index);
 }
 
 Eigen::MatrixXd
@@ -498,17 +627,19 @@ BundleAdjustmentCovarianceEstimator::GetPoseCovarianceBlockOperation(
     int col_start,
     int row_block_size,
     int col_block_size) const {
-  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization());
+  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization() ||
+              HasValidBlockDiagonalPoseCovariance());
   if (HasValidPoseCovariance()) {
     return cov_poses_.block(
         row_start, col_start, row_block_size, col_block_size);
   }
-  // HasValidPoseRefactorization() == true
+  // HasValidPoseRefactorization() == true or
+  // HasValidBlockDiagonalPoseCovariance() == true
   Eigen::MatrixXd output(row_block_size, col_block_size);
   for (int row = 0; row < row_block_size; ++row) {
     for (int col = 0; col < col_block_size; ++col) {
-      output(row, col) = L_matrix_poses_inv_.col(row_start + row)
-                             .dot(L_matrix_poses_inv_.col(col_start + col));
+      output(row, col) =
+          GetPoseCovarianceByIndex(row_start + row, col_start + col);
     }
   }
   return output;
@@ -736,6 +867,97 @@ bool BundleAdjustmentCovarianceEstimator::Compute() {
   return true;
 }
 
+bool BundleAdjustmentCovarianceEstimator::ComputeBlockDiagonal(
+    const int num_threads) {
+  if (!HasValidSchurComplement()) {
+    ComputeSchurComplement();
+  }
+
+  // Instead of eliminating the other variables, which generally fills in the
+  // Schur complement on the poses, factorize the Schur complement on all
+  // variables, whose inverse contains the pose covariances as a sub-block.
+  Eigen::SparseMatrix<double> S = S_matrix_;
+  for (int i = num_params_poses_; i < S.rows(); ++i) {
+    S.coeffRef(i, i) += lambda_;
+  }
+
+  LOG(INFO) << StringPrintf("Start sparse Cholesky decomposition (n = %d)",
+                            S.rows());
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldltOfS(S);
+  int rank = 0;
+  for (int i = 0; i < S.rows(); ++i) {
+    if (ldltOfS.vectorD().coeff(i) != 0.0) rank++;
+  }
+  if (ldltOfS.info() != Eigen::Success || rank < S.rows()) {
+    LOG(INFO) << StringPrintf(
+        "Unable to compute covariance. The Schur complement on all variables "
+        "(except for 3D points) is rank deficient. Number of columns: %d, "
+        "rank: %d. This is likely due to the poses being underconstrained "
+        "with Gauge ambiguity.",
+        S.rows(),
+        rank);
+    return false;
+  }
+  LOG(INFO) << "Finish sparse Cholesky decomposition.";
+
+  // Group the pose parameters by image, if possible.
+  std::vector<std::vector<const double*>> pose_block_groups;
+  std::set<const double*> grouped_pose_blocks;
+  if (HasReconstruction()) {
+    for (const auto& image : reconstruction_->Images()) {
+      if (!HasPose(image.first)) continue;
+      const double* qvec = image.second.CamFromWorld().rotation.coeffs().data();
+      const double* tvec = image.second.CamFromWorld().translation.data();
+      pose_block_groups.push_back({qvec, tvec});
+      grouped_pose_blocks.insert(qvec);
+      grouped_pose_blocks.insert(tvec);
+    }
+  }
+  for (const double* block : pose_blocks_) {
+    if (grouped_pose_blocks.count(block) == 0) {
+      pose_block_groups.push_back({block});
+    }
+  }
+
+  std::vector<std::vector<int>> pose_block_indices(pose_block_groups.size());
+  pose_index_to_block_.resize(num_params_poses_);
+  for (size_t i = 0; i < pose_block_groups.size(); ++i) {
+    for (const double* block : pose_block_groups[i]) {
+      const int index = GetBlockIndex(block);
+      for (int j = 0; j < GetBlockTangentSize(block); ++j) {
+        pose_index_to_block_[index + j] = {
+            static_cast<int>(i),
+            static_cast<int>(pose_block_indices[i].size())};
+        pose_block_indices[i].push_back(index + j);
+      }
+    }
+  }
+
+  LOG(INFO) << "Recover the block-diagonal pose covariances";
+  ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
+  const SparseInverseSubset S_inv(ldltOfS, &thread_pool);
+  std::vector<Eigen::MatrixXd> cov_pose_blocks(pose_block_groups.size());
+  const size_t kMinNumBlocksPerChunk = 64;
+  ParallelForChunks(
+      &thread_pool,
+      pose_block_indices.size(),
+      kMinNumBlocksPerChunk,
+      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const std::vector<int>& indices = pose_block_indices[i];
+          Eigen::MatrixXd& cov = cov_pose_blocks[i];
+          cov.resize(indices.size(), indices.size());
+          for (size_t row = 0; row < indices.size(); ++row) {
+            for (size_t col = 0; col < indices.size(); ++col) {
+              cov(row, col) = S_inv.Coeff(indices[row], indices[col]);
+            }
+          }
+        }
+      });
+  cov_pose_blocks_ = std::move(cov_pose_blocks);
+  return true;
+}
+
 bool EstimatePoseCovarianceCeresBackend(
     ceres::Problem* problem,
     Reconstruction* reconstruction,
@@ -759,7 +981,7 @@ bool EstimatePoseCovariance(
     double lambda) {
   BundleAdjustmentCovarianceEstimator estimator(
       problem, reconstruction, lambda);
-  if (!estimator.Factorize()) return false;
+  if (!estimator.ComputeBlockDiagonal()) return false;
   image_id_to_covar.clear();
   for (const auto& image : reconstruction->Images()) {
     image_t image_id = image.first;
@@ -195,6 +195,15 @@ class BundleAdjustmentCovarianceEstimator
   bool HasValidFullFactorization() const;
   bool HasValidPoseFactorization() const;
 
+  // Compute the block-diagonal pose covariances, i.e. the covariance of every
+  // image pose (or of every pose block, if constructed without reconstruction)
+  // without the cross-covariances between them. Only the entries of the
+  // inverse on the sparsity pattern of the sparse Cholesky factor of the Schur
+  // complement are recovered, which avoids any dense inversion and scales to
+  // large reconstructions.
+  bool ComputeBlockDiagonal(int num_threads = -1);
+  bool HasValidBlockDiagonalPoseCovariance() const;
+
  private:
   // indexing the covariance matrix
   double GetCovarianceByIndex(int row, int col) const override;
@@ -225,6 +234,11 @@ class BundleAdjustmentCovarianceEstimator
   // The inverse of L matrix after Cholesky factorization
   Eigen::MatrixXd L_matrix_variables_inv_;
   Eigen::MatrixXd L_matrix_poses_inv_;
+
+  // The block-diagonal pose covariances, and the block and the index within
+  // the block for every pose parameter
+  std::vector<Eigen::MatrixXd> cov_pose_blocks_;
+  std::vector<std::pair<int, int>> pose_index_to_block_;
 };
 
 // The covariance for each image is in the order [R, t] with both of them
@@ -239,6 +253,8 @@ bool EstimatePoseCovarianceCeresBackend(
     std::map<image_t, Eigen::MatrixXd>& image_id_to_covar);
 
 // Similar to the convention above for ``EstimatePoseCovarianceCeresBackend``.
+// Only the block-diagonal pose covariances are computed from a sparse
+// factorization, see ``ComputeBlockDiagonal``.
 bool EstimatePoseCovariance(
     ceres::Problem* problem,
     Reconstruction* reconstruction,
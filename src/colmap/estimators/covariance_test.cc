@@ -159,6 +159,40 @@ TEST(Covariance, Compute) {
   ExpectNearEigenMatrixXd(covar, covar_ceres, 1e-6);
 }
 
+TEST(Covariance, ComputeBlockDiagonal) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(&reconstruction);
+  std::shared_ptr<BundleAdjuster> bundle_adjuster =
+      BuildBundleAdjuster(&reconstruction);
+  bundle_adjuster->Solve(&reconstruction);
+  std::shared_ptr<ceres::Problem> problem = bundle_adjuster->Problem();
+
+  BundleAdjustmentCovarianceEstimator estimator(problem.get(), &reconstruction);
+  ASSERT_TRUE(estimator.Compute());
+  BundleAdjustmentCovarianceEstimator sparse_estimator(problem.get(),
+                                                       &reconstruction);
+  ASSERT_TRUE(sparse_estimator.ComputeBlockDiagonal());
+  EXPECT_TRUE(sparse_estimator.HasValidBlockDiagonalPoseCovariance());
+  EXPECT_FALSE(sparse_estimator.HasValidPoseCovariance());
+
+  std::vector<image_t> image_ids;
+  for (const auto& image : reconstruction.Images()) {
+    if (estimator.HasPose(image.first)) {
+      image_ids.push_back(image.first);
+    }
+  }
+  ASSERT_GE(image_ids.size(), 2);
+  for (const image_t image_id : image_ids) {
+    ExpectNearEigenMatrixXd(sparse_estimator.GetPoseCovariance(image_id),
+                            estimator.GetPoseCovariance(image_id),
+                            1e-6);
+  }
+
+  // No cross image covariance is computed.
+  EXPECT_ANY_THROW(
+      sparse_estimator.GetPoseCovariance(image_ids[0], image_ids[1]));
+}
+
 TEST(Covariance, ComputeFull) {
   Reconstruction reconstruction;
   GenerateReconstruction(&reconstruction);
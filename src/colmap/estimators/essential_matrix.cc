@@ -54,20 +54,28 @@ void EssentialMatrixFivePointEstimator::Estimate(
   models->clear();
 
   // Setup system of equations: [points2(i,:), 1]' * E * [points1(i,:), 1]'.
+  // The system of the minimal case is fixed-size to avoid heap allocations.
 
-  Eigen::Matrix<double, Eigen::Dynamic, 9> Q(points1.size(), 9);
-  for (size_t i = 0; i < points1.size(); ++i) {
-    Q.row(i) << points2[i].x() * points1[i].transpose().homogeneous(),
-        points2[i].y() * points1[i].transpose().homogeneous(),
-        points1[i].transpose().homogeneous();
-  }
+  const auto fill_equations = [&points1, &points2](auto* Q) {
+    for (size_t i = 0; i < points1.size(); ++i) {
+      Q->row(i) << points2[i].x() * points1[i].transpose().homogeneous(),
+          points2[i].y() * points1[i].transpose().homogeneous(),
+          points1[i].transpose().homogeneous();
+    }
+  };
 
   // Step 1: Extraction of the nullspace.
 
   Eigen::Matrix<double, 9, 4> E;
   if (points1.size() == 5) {
-    E = Q.transpose().fullPivHouseholderQr().matrixQ().rightCols<4>();
+    Eigen::Matrix<double, 5, 9> Q;
+    fill_equations(&Q);
+    const Eigen::Matrix<double, 9, 9> Q_full =
+        Q.transpose().fullPivHouseholderQr().matrixQ();
+    E = Q_full.rightCols<4>();
   } else {
+    Eigen::Matrix<double, Eigen::Dynamic, 9> Q(points1.size(), 9);
+    fill_equations(&Q);
     const Eigen::JacobiSVD<Eigen::Matrix<double, Eigen::Dynamic, 9>> svd(
         Q, Eigen::ComputeFullV);
     E = svd.matrixV().rightCols<4>();
@@ -100,8 +108,8 @@ void EssentialMatrixFivePointEstimator::Estimate(
   Eigen::Matrix<double, 11, 1> coeffs;
 #include "colmap/estimators/essential_matrix_coeffs.h"
 
-  Eigen::VectorXd roots_real;
-  Eigen::VectorXd roots_imag;
+  PolynomialRootsVector<10> roots_real;
+  PolynomialRootsVector<10> roots_imag;
   if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
     return;
   }
@@ -89,9 +89,8 @@ Eigen::Vector3d PointFromPlueckerLineAndDepth(const Eigen::Vector6d& pluecker,
 //    B_fi = q_i x q_i' + lambda_i * q_i.
 //
 Eigen::Matrix<double, 3, 6> ComputePolynomialCoefficients(
-    const std::vector<Eigen::Vector6d>& plueckers,
+    const std::array<Eigen::Vector6d, 3>& plueckers,
     const std::vector<Eigen::Vector3d>& points3D) {
-  THROW_CHECK_EQ(plueckers.size(), 3);
   THROW_CHECK_EQ(points3D.size(), 3);
 
   Eigen::Matrix<double, 3, 6> K;
@@ -130,42 +129,47 @@ int SolveQuadratic(const double b, const double c, double* roots) {
   }
 }
 
-// Given lambda_j, return the values for lambda_i, where:
+// Given lambda_j, return the positive values for lambda_i and their number,
+// where:
 //     k1 lambda_i^2 + (k2 lambda_j + k3) lambda_i
 //      + k4 lambda_j^2 + k5 lambda_j + k6          = 0.
-void ComputeLambdaValues(const Eigen::Matrix<double, 3, 6>::ConstRowXpr& k,
-                         const double lambda_j,
-                         std::vector<double>* lambdas_i) {
+int ComputeLambdaValues(const Eigen::Matrix<double, 3, 6>::ConstRowXpr& k,
+                        const double lambda_j,
+                        double* lambdas_i) {
   // Note that we solve x^2 + bx + c = 0, since k(0) is one.
   double roots[2];
   const int num_solutions =
       SolveQuadratic(k(1) * lambda_j + k(2),
                      lambda_j * (k(3) * lambda_j + k(4)) + k(5),
                      roots);
+  int num_lambdas = 0;
   for (int i = 0; i < num_solutions; ++i) {
     if (roots[i] > 0) {
-      lambdas_i->push_back(roots[i]);
+      lambdas_i[num_lambdas++] = roots[i];
     }
   }
+  return num_lambdas;
 }
 
 // Given the coefficients of the polynomial system return the depths of the
 // points along the Pluecker lines. Use Sylvester resultant to get and 8th
 // degree polynomial for lambda_3 and back-substite in the original equations.
-std::vector<Eigen::Vector3d> ComputeDepthsSylvester(
-    const Eigen::Matrix<double, 3, 6>& K) {
+// The depths are computed without any heap allocations, since this is called
+// for every minimal sample in RANSAC.
+void ComputeDepthsSylvester(const Eigen::Matrix<double, 3, 6>& K,
+                            std::vector<Eigen::Vector3d>* depths) {
+  depths->clear();
+
   const Eigen::Matrix<double, 9, 1> coeffs = ComputeDepthsSylvesterCoeffs(K);
 
-  Eigen::VectorXd roots_real;
-  Eigen::VectorXd roots_imag;
+  PolynomialRootsVector<8> roots_real;
+  PolynomialRootsVector<8> roots_imag;
   if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
-    return std::vector<Eigen::Vector3d>();
+    return;
   }
 
   // Back-substitute every lambda_3 to the system of equations.
-  std::vector<Eigen::Vector3d> depths;
-  depths.reserve(roots_real.size());
-  for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
+  for (Eigen::Index i = 0; i < roots_real.size(); ++i) {
     const double kMaxRootImagRatio = 1e-3;
     if (std::abs(roots_imag(i)) > kMaxRootImagRatio * std::abs(roots_real(i))) {
       continue;
@@ -176,31 +180,37 @@ std::vector<Eigen::Vector3d> ComputeDepthsSylvester(
       continue;
     }
 
-    std::vector<double> lambdas_2;
-    ComputeLambdaValues(K.row(2), lambda_3, &lambdas_2);
+    double lambdas_2[2];
+    const int num_lambdas_2 =
+        ComputeLambdaValues(K.row(2), lambda_3, lambdas_2);
+
+    // The second equation for lambda_1 only depends on lambda_3.
+    double lambdas_1_2[2];
+    const int num_lambdas_1_2 =
+        ComputeLambdaValues(K.row(1), lambda_3, lambdas_1_2);
 
     // Now we have two depths, lambda_2 and lambda_3. From the two remaining
     // equations, we must get the same lambda_1, otherwise the solution is
     // invalid.
-    for (const double lambda_2 : lambdas_2) {
-      std::vector<double> lambdas_1_1;
-      ComputeLambdaValues(K.row(0), lambda_2, &lambdas_1_1);
-      std::vector<double> lambdas_1_2;
-      ComputeLambdaValues(K.row(1), lambda_3, &lambdas_1_2);
-      for (const double lambda_1_1 : lambdas_1_1) {
-        for (const double lambda_1_2 : lambdas_1_2) {
+    for (int j = 0; j < num_lambdas_2; ++j) {
+      const double lambda_2 = lambdas_2[j];
+      double lambdas_1_1[2];
+      const int num_lambdas_1_1 =
+          ComputeLambdaValues(K.row(0), lambda_2, lambdas_1_1);
+      for (int k = 0; k < num_lambdas_1_1; ++k) {
+        for (int l = 0; l < num_lambdas_1_2; ++l) {
+          const double lambda_1_1 = lambdas_1_1[k];
+          const double lambda_1_2 = lambdas_1_2[l];
           const double kMaxLambdaRatio = 1e-2;
           if (std::abs(lambda_1_1 - lambda_1_2) <
               kMaxLambdaRatio * std::max(lambda_1_1, lambda_1_2)) {
             const double lambda_1 = (lambda_1_1 + lambda_1_2) / 2;
-            depths.emplace_back(lambda_1, lambda_2, lambda_3);
+            depths->emplace_back(lambda_1, lambda_2, lambda_3);
           }
         }
       }
     }
   }
-
-  return depths;
 }
 
 }  // namespace
@@ -219,7 +229,7 @@ void GP3PEstimator::Estimate(const std::vector<X_t>& points2D,
   }
 
   // Transform 2D points into compact Pluecker line representation.
-  std::vector<Eigen::Vector6d> plueckers(3);
+  std::array<Eigen::Vector6d, 3> plueckers;
   for (size_t i = 0; i < 3; ++i) {
     plueckers[i] = ComposePlueckerLine(Inverse(points2D[i].cam_from_rig),
                                        points2D[i].ray_in_cam);
@@ -235,8 +245,11 @@ void GP3PEstimator::Estimate(const std::vector<X_t>& points2D,
   const Eigen::Matrix<double, 3, 6> K =
       ComputePolynomialCoefficients(plueckers, points3D);
 
-  // Compute the depths along the Pluecker lines of the observations.
-  const std::vector<Eigen::Vector3d> depths = ComputeDepthsSylvester(K);
+  // Compute the depths along the Pluecker lines of the observations. At most 8
+  // real roots each with at most 4 back-substituted solutions exist.
+  thread_local std::vector<Eigen::Vector3d> depths;
+  depths.reserve(32);
+  ComputeDepthsSylvester(K, &depths);
   if (depths.empty()) {
     return;
   }
@@ -273,9 +286,24 @@ void GP3PEstimator::Residuals(const std::vector<X_t>& points2D,
                               std::vector<double>* residuals) {
   THROW_CHECK_EQ(points2D.size(), points3D.size());
   residuals->resize(points2D.size(), 0);
+
+  // The observations of a rig are typically ordered by camera, so the pose of
+  // each camera is only composed once for a run of observations of the same
+  // camera and the points are then transformed by a single matrix product,
+  // instead of two quaternion rotations per point.
+  Eigen::Matrix3x4d cam_from_world;
+  const Rigid3d* prev_cam_from_rig = nullptr;
   for (size_t i = 0; i < points2D.size(); ++i) {
+    const Rigid3d& cam_from_rig = points2D[i].cam_from_rig;
+    if (prev_cam_from_rig == nullptr ||
+        cam_from_rig.rotation.coeffs() !=
+            prev_cam_from_rig->rotation.coeffs() ||
+        cam_from_rig.translation != prev_cam_from_rig->translation) {
+      cam_from_world = (cam_from_rig * rig_from_world).ToMatrix();
+      prev_cam_from_rig = &cam_from_rig;
+    }
     const Eigen::Vector3d point3D_in_cam =
-        points2D[i].cam_from_rig * (rig_from_world * points3D[i]);
+        cam_from_world * points3D[i].homogeneous();
     // Check if 3D point is in front of camera.
     if (point3D_in_cam.z() > std::numeric_limits<double>::epsilon()) {
       if (residual_type == ResidualType::CosineDistance) {
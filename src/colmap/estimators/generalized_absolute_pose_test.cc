@@ -118,5 +118,45 @@ TEST(GeneralizedAbsolutePose, Estimate) {
   }
 }
 
+TEST(GeneralizedAbsolutePose, ResidualsGroupedByCamera) {
+  const Rigid3d rig_from_world(Eigen::Quaterniond(1, 0.1, 0.2, 0).normalized(),
+                               Eigen::Vector3d(0.1, -0.2, 0.3));
+  const std::array<Rigid3d, 2> cams_from_rig = {{
+      Rigid3d(),
+      Rigid3d(Eigen::Quaterniond(1, 0, 0.3, 0).normalized(),
+              Eigen::Vector3d(-1, 0, 0)),
+  }};
+
+  // The observations of each camera are consecutive.
+  std::vector<GP3PEstimator::X_t> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+  for (size_t cam_idx = 0; cam_idx < cams_from_rig.size(); ++cam_idx) {
+    for (int i = 0; i < 5; ++i) {
+      points3D.emplace_back(0.1 * i, -0.2 * i, 5 + i);
+      points2D.emplace_back();
+      points2D.back().cam_from_rig = cams_from_rig[cam_idx];
+      points2D.back().ray_in_cam =
+          (cams_from_rig[cam_idx] * (rig_from_world * points3D.back()) +
+           Eigen::Vector3d(0.01 * i, 0, 0))
+              .normalized();
+    }
+  }
+
+  GP3PEstimator estimator;
+  estimator.residual_type = GP3PEstimator::ResidualType::ReprojectionError;
+  std::vector<double> residuals;
+  estimator.Residuals(points2D, points3D, rig_from_world, &residuals);
+  ASSERT_EQ(residuals.size(), points2D.size());
+  for (size_t i = 0; i < points2D.size(); ++i) {
+    const Eigen::Vector3d point3D_in_cam =
+        points2D[i].cam_from_rig * (rig_from_world * points3D[i]);
+    EXPECT_NEAR(residuals[i],
+                (point3D_in_cam.hnormalized() -
+                 points2D[i].ray_in_cam.hnormalized())
+                    .squaredNorm(),
+                1e-12);
+  }
+}
+
 }  // namespace
 }  // namespace colmap
@@ -113,13 +113,20 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
   ThreadPool thread_pool(std::min(
       options.num_threads, static_cast<int>(focal_length_factors.size())));
 
+  // Without focal length sampling, there is only a single RANSAC problem, so
+  // use the available threads for its hypothesis evaluation instead.
+  RANSACOptions ransac_options = options.ransac_options;
+  if (focal_length_factors.size() == 1 && ransac_options.num_threads == 1) {
+    ransac_options.num_threads = options.num_threads;
+  }
+
   for (size_t i = 0; i < focal_length_factors.size(); ++i) {
     futures[i] = thread_pool.AddTask(EstimateAbsolutePoseKernel,
                                      *camera,
                                      focal_length_factors[i],
                                      points2D,
                                      points3D,
-                                     options.ransac_options,
+                                     ransac_options,
                                      &reports[i]);
   }
 
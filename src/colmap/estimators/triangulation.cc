@@ -38,6 +38,8 @@
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/logging.h"
 
+#include <algorithm>
+
 #include <Eigen/Geometry>
 
 namespace colmap {
@@ -136,30 +138,76 @@ void TriangulationEstimator::Residuals(const std::vector<X_t>& point_data,
   }
 }
 
-bool EstimateTriangulation(const EstimateTriangulationOptions& options,
-                           const std::vector<Eigen::Vector2d>& points,
-                           const std::vector<Rigid3d const*>& cams_from_world,
-                           const std::vector<Camera const*>& cameras,
-                           std::vector<char>* inlier_mask,
-                           Eigen::Vector3d* xyz) {
-  THROW_CHECK_NOTNULL(inlier_mask);
-  THROW_CHECK_NOTNULL(xyz);
-  THROW_CHECK_GE(points.size(), 2);
-  THROW_CHECK_EQ(points.size(), cams_from_world.size());
-  THROW_CHECK_EQ(points.size(), cameras.size());
-  options.Check();
+void TriangulationBatch::Clear() {
+  track_offsets.clear();
+  track_offsets.push_back(0);
+  points.clear();
+  cams_from_world.clear();
+  cameras.clear();
+}
 
+namespace {
+
+// Minimum number of tracks per chunk when estimating a batch in parallel.
+const size_t kMinNumTracksPerChunk = 64;
+
+// Buffers that are reused for the estimation of consecutive tracks.
+struct TriangulationData {
   std::vector<TriangulationEstimator::PointData> point_data;
-  point_data.resize(points.size());
   std::vector<TriangulationEstimator::PoseData> pose_data;
-  pose_data.resize(points.size());
-  for (size_t i = 0; i < points.size(); ++i) {
-    point_data[i].point = points[i];
-    point_data[i].point_normalized = cameras[i]->CamFromImg(points[i]);
-    pose_data[i].proj_matrix = cams_from_world[i]->ToMatrix();
-    pose_data[i].proj_center = cams_from_world[i]->rotation.inverse() *
-                               -cams_from_world[i]->translation;
-    pose_data[i].camera = cameras[i];
+  std::vector<Eigen::Vector3d> models;
+  std::vector<double> residuals;
+};
+
+bool EstimateTriangulation(const EstimateTriangulationOptions& options,
+                           const size_t num_points,
+                           const Eigen::Vector2d* points,
+                           Rigid3d const* const* cams_from_world,
+                           Camera const* const* cameras,
+                           TriangulationData& data,
+                           char* inlier_mask,
+                           Eigen::Vector3d* xyz) {
+  THROW_CHECK_GE(num_points, 2);
+
+  data.point_data.resize(num_points);
+  data.pose_data.resize(num_points);
+  for (size_t i = 0; i < num_points; ++i) {
+    data.point_data[i].point = points[i];
+    data.point_data[i].point_normalized = cameras[i]->CamFromImg(points[i]);
+    data.pose_data[i].proj_matrix = cams_from_world[i]->ToMatrix();
+    data.pose_data[i].proj_center = cams_from_world[i]->rotation.inverse() *
+                                    -cams_from_world[i]->translation;
+    data.pose_data[i].camera = cameras[i];
+  }
+
+  // For two observations, RANSAC only evaluates the single minimal sample,
+  // which is successful if both observations are inliers. Estimating it
+  // directly yields the same result without the overhead of RANSAC.
+  if (num_points == 2 && !options.ransac_options.use_sprt &&
+      options.ransac_options.max_num_trials > 0) {
+    TriangulationEstimator estimator;
+    estimator.SetMinTriAngle(options.min_tri_angle);
+    estimator.SetResidualType(options.residual_type);
+    estimator.Estimate(data.point_data, data.pose_data, &data.models);
+    if (data.models.empty()) {
+      return false;
+    }
+    estimator.Residuals(
+        data.point_data, data.pose_data, data.models[0], &data.residuals);
+    const double max_residual =
+        options.ransac_options.max_error * options.ransac_options.max_error;
+    if (data.residuals[0] > max_residual || data.residuals[1] > max_residual) {
+      return false;
+    }
+    inlier_mask[0] = true;
+    inlier_mask[1] = true;
+    *xyz = data.models[0];
+    return true;
+  }
+
+  RANSACOptions ransac_options = options.ransac_options;
+  if (num_points <= static_cast<size_t>(options.max_exhaustive_track_length)) {
+    ransac_options.min_num_trials = NChooseK(num_points, 2);
   }
 
   // Robustly estimate track using LORANSAC.
@@ -167,20 +215,96 @@ bool EstimateTriangulation(const EstimateTriangulationOptions& options,
            TriangulationEstimator,
            InlierSupportMeasurer,
            CombinationSampler>
-      ransac(options.ransac_options);
+      ransac(ransac_options);
   ransac.estimator.SetMinTriAngle(options.min_tri_angle);
   ransac.estimator.SetResidualType(options.residual_type);
   ransac.local_estimator.SetMinTriAngle(options.min_tri_angle);
   ransac.local_estimator.SetResidualType(options.residual_type);
-  const auto report = ransac.Estimate(point_data, pose_data);
+  const auto report = ransac.Estimate(data.point_data, data.pose_data);
   if (!report.success) {
     return false;
   }
 
-  *inlier_mask = report.inlier_mask;
+  std::copy(report.inlier_mask.begin(), report.inlier_mask.end(), inlier_mask);
   *xyz = report.model;
 
   return report.success;
 }
 
+}  // namespace
+
+bool EstimateTriangulation(const EstimateTriangulationOptions& options,
+                           const std::vector<Eigen::Vector2d>& points,
+                           const std::vector<Rigid3d const*>& cams_from_world,
+                           const std::vector<Camera const*>& cameras,
+                           std::vector<char>* inlier_mask,
+                           Eigen::Vector3d* xyz) {
+  THROW_CHECK_NOTNULL(inlier_mask);
+  THROW_CHECK_NOTNULL(xyz);
+  THROW_CHECK_GE(points.size(), 2);
+  THROW_CHECK_EQ(points.size(), cams_from_world.size());
+  THROW_CHECK_EQ(points.size(), cameras.size());
+  options.Check();
+
+  TriangulationData data;
+  std::vector<char> estimated_inlier_mask(points.size());
+  if (!EstimateTriangulation(options,
+                             points.size(),
+                             points.data(),
+                             cams_from_world.data(),
+                             cameras.data(),
+                             data,
+                             estimated_inlier_mask.data(),
+                             xyz)) {
+    return false;
+  }
+
+  *inlier_mask = std::move(estimated_inlier_mask);
+
+  return true;
+}
+
+void EstimateTriangulations(const EstimateTriangulationOptions& options,
+                            const TriangulationBatch& batch,
+                            ThreadPool* thread_pool,
+                            std::vector<char>* success,
+                            std::vector<char>* inlier_mask,
+                            std::vector<Eigen::Vector3d>* xyzs) {
+  THROW_CHECK_NOTNULL(success);
+  THROW_CHECK_NOTNULL(inlier_mask);
+  THROW_CHECK_NOTNULL(xyzs);
+  THROW_CHECK(!batch.track_offsets.empty());
+  THROW_CHECK_EQ(batch.track_offsets.front(), 0);
+  THROW_CHECK_EQ(batch.track_offsets.back(), batch.NumObservations());
+  THROW_CHECK_EQ(batch.points.size(), batch.cams_from_world.size());
+  THROW_CHECK_EQ(batch.points.size(), batch.cameras.size());
+  options.Check();
+
+  const size_t num_tracks = batch.NumTracks();
+  success->assign(num_tracks, false);
+  inlier_mask->assign(batch.NumObservations(), false);
+  xyzs->resize(num_tracks);
+
+  ParallelForChunks(
+      thread_pool,
+      num_tracks,
+      kMinNumTracksPerChunk,
+      [&](const size_t begin, const size_t end) {
+        TriangulationData data;
+        for (size_t i = begin; i < end; ++i) {
+          const size_t offset = batch.track_offsets[i];
+          const size_t num_points = batch.track_offsets[i + 1] - offset;
+          (*success)[i] = EstimateTriangulation(options,
+                                                num_points,
+                                                batch.points.data() + offset,
+                                                batch.cams_from_world.data() +
+                                                    offset,
+                                                batch.cameras.data() + offset,
+                                                data,
+                                                inlier_mask->data() + offset,
+                                                &(*xyzs)[i]);
+        }
+      });
+}
+
 }  // namespace colmap
@@ -34,6 +34,7 @@
 #include "colmap/optim/ransac.h"
 #include "colmap/scene/camera.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/types.h"
 
 #include <vector>
@@ -129,12 +130,41 @@ struct EstimateTriangulationOptions {
   // RANSAC options for TriangulationEstimator.
   RANSACOptions ransac_options;
 
+  // Evaluate all pairs of observations for tracks with at most this number of
+  // observations by enforcing the minimum number of RANSAC trials.
+  int max_exhaustive_track_length = 0;
+
   void Check() const {
     THROW_CHECK_GE(min_tri_angle, 0.0);
+    THROW_CHECK_GE(max_exhaustive_track_length, 0);
     ransac_options.Check();
   }
 };
 
+// Batch of triangulation problems in structure-of-arrays layout. The
+// observations of the i-th track are stored in the range
+// [track_offsets[i], track_offsets[i + 1]) of the observation arrays.
+struct TriangulationBatch {
+  std::vector<size_t> track_offsets = {0};
+  std::vector<Eigen::Vector2d> points;
+  std::vector<Rigid3d const*> cams_from_world;
+  std::vector<Camera const*> cameras;
+
+  inline size_t NumTracks() const { return track_offsets.size() - 1; }
+  inline size_t NumObservations() const { return points.size(); }
+
+  // Add an observation to the current track.
+  inline void AddObservation(const Eigen::Vector2d& point,
+                             const Rigid3d* cam_from_world,
+                             const Camera* camera);
+
+  // Finish the current track, such that the next observations are added to a
+  // new track.
+  inline void FinishTrack() { track_offsets.push_back(points.size()); }
+
+  void Clear();
+};
+
 // Robustly estimate 3D point from observations in multiple views using RANSAC
 // and a subsequent non-linear refinement using all inliers. Returns true
 // if the estimated number of inliers has more than two views.
@@ -145,4 +175,28 @@ bool EstimateTriangulation(const EstimateTriangulationOptions& options,
                            std::vector<char>* inlier_mask,
                            Eigen::Vector3d* xyz);
 
+// Robustly estimate the 3D points of a batch of tracks, as for the individual
+// estimation above. The tracks are estimated in parallel chunks using the
+// optional thread pool, where the result is independent of the number of
+// threads. The inlier mask is stored per observation of the batch and is only
+// valid for successfully estimated tracks.
+void EstimateTriangulations(const EstimateTriangulationOptions& options,
+                            const TriangulationBatch& batch,
+                            ThreadPool* thread_pool,
+                            std::vector<char>* success,
+                            std::vector<char>* inlier_mask,
+                            std::vector<Eigen::Vector3d>* xyzs);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+void TriangulationBatch::AddObservation(const Eigen::Vector2d& point,
+                                        const Rigid3d* cam_from_world,
+                                        const Camera* camera) {
+  points.push_back(point);
+  cams_from_world.push_back(cam_from_world);
+  cameras.push_back(camera);
+}
+
 }  // namespace colmap
@@ -0,0 +1,194 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/estimators/triangulation.h"
+
+#include "colmap/geometry/rigid3.h"
+#include "colmap/math/random.h"
+#include "colmap/scene/camera.h"
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/threading.h"
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+struct TriangulationProblem {
+  Camera camera;
+  std::vector<Rigid3d> cams_from_world;
+  std::vector<Eigen::Vector3d> points3D;
+};
+
+TriangulationProblem CreateTriangulationProblem(const int num_cams,
+                                                const int num_points3D) {
+  TriangulationProblem problem;
+  problem.camera = Camera::CreateFromModelName(1, "PINHOLE", 100, 100, 100);
+  for (int i = 0; i < num_cams; ++i) {
+    problem.cams_from_world.emplace_back(
+        Eigen::Quaterniond::Identity(),
+        Eigen::Vector3d(i - 0.5 * num_cams, RandomUniformReal(-0.1, 0.1), 0));
+  }
+  for (int i = 0; i < num_points3D; ++i) {
+    problem.points3D.emplace_back(RandomUniformReal(-1.0, 1.0),
+                                  RandomUniformReal(-1.0, 1.0),
+                                  RandomUniformReal(4.0, 8.0));
+  }
+  return problem;
+}
+
+EstimateTriangulationOptions CreateOptions() {
+  EstimateTriangulationOptions options;
+  options.min_tri_angle = DegToRad(1.0);
+  options.residual_type =
+      TriangulationEstimator::ResidualType::REPROJECTION_ERROR;
+  options.ransac_options.max_error = 1.0;
+  return options;
+}
+
+TEST(EstimateTriangulation, Nominal) {
+  SetPRNGSeed(0);
+  const TriangulationProblem problem = CreateTriangulationProblem(5, 1);
+  std::vector<Eigen::Vector2d> points;
+  std::vector<Rigid3d const*> cams_from_world;
+  std::vector<Camera const*> cameras;
+  for (const Rigid3d& cam_from_world : problem.cams_from_world) {
+    points.push_back(problem.camera.ImgFromCam(
+        (cam_from_world * problem.points3D[0]).hnormalized()));
+    cams_from_world.push_back(&cam_from_world);
+    cameras.push_back(&problem.camera);
+  }
+  // Outlier observation.
+  points[2] += Eigen::Vector2d(20, 0);
+
+  std::vector<char> inlier_mask;
+  Eigen::Vector3d xyz;
+  EXPECT_TRUE(EstimateTriangulation(
+      CreateOptions(), points, cams_from_world, cameras, &inlier_mask, &xyz));
+  EXPECT_EQ(inlier_mask, std::vector<char>({1, 1, 0, 1, 1}));
+  EXPECT_LT((xyz - problem.points3D[0]).norm(), 1e-6);
+
+  // Two observations with insufficient triangulation angle.
+  EstimateTriangulationOptions options = CreateOptions();
+  options.min_tri_angle = DegToRad(45.0);
+  points.resize(2);
+  cams_from_world.resize(2);
+  cameras.resize(2);
+  EXPECT_FALSE(EstimateTriangulation(
+      options, points, cams_from_world, cameras, &inlier_mask, &xyz));
+}
+
+TEST(EstimateTriangulations, EqualsIndividualEstimation) {
+  SetPRNGSeed(0);
+  const int kNumCams = 6;
+  const TriangulationProblem problem =
+      CreateTriangulationProblem(kNumCams, 500);
+
+  TriangulationBatch batch;
+  for (size_t i = 0; i < problem.points3D.size(); ++i) {
+    const int num_obs = 2 + i % (kNumCams - 1);
+    for (int j = 0; j < num_obs; ++j) {
+      const Rigid3d& cam_from_world = problem.cams_from_world[j];
+      Eigen::Vector2d point = problem.camera.ImgFromCam(
+          (cam_from_world * problem.points3D[i]).hnormalized());
+      if (i % 7 == 0 && j == 1) {
+        point += Eigen::Vector2d(10, 10);
+      } else {
+        point += Eigen::Vector2d(RandomGaussian(0.0, 0.5),
+                                 RandomGaussian(0.0, 0.5));
+      }
+      batch.AddObservation(point, &cam_from_world, &problem.camera);
+    }
+    batch.FinishTrack();
+  }
+  EXPECT_EQ(batch.NumTracks(), problem.points3D.size());
+
+  EstimateTriangulationOptions options = CreateOptions();
+  options.max_exhaustive_track_length = 4;
+
+  std::vector<char> success;
+  std::vector<char> inlier_mask;
+  std::vector<Eigen::Vector3d> xyzs;
+  EstimateTriangulations(
+      options, batch, /*thread_pool=*/nullptr, &success, &inlier_mask, &xyzs);
+  ASSERT_EQ(success.size(), batch.NumTracks());
+  ASSERT_EQ(inlier_mask.size(), batch.NumObservations());
+  ASSERT_EQ(xyzs.size(), batch.NumTracks());
+
+  size_t num_success = 0;
+  for (size_t i = 0; i < batch.NumTracks(); ++i) {
+    const size_t begin = batch.track_offsets[i];
+    const size_t end = batch.track_offsets[i + 1];
+    std::vector<char> expected_inlier_mask;
+    Eigen::Vector3d expected_xyz;
+    const bool expected_success = EstimateTriangulation(
+        options,
+        {batch.points.begin() + begin, batch.points.begin() + end},
+        {batch.cams_from_world.begin() + begin,
+         batch.cams_from_world.begin() + end},
+        {batch.cameras.begin() + begin, batch.cameras.begin() + end},
+        &expected_inlier_mask,
+        &expected_xyz);
+    EXPECT_EQ(success[i], expected_success);
+    if (expected_success) {
+      num_success += 1;
+      EXPECT_EQ(xyzs[i], expected_xyz);
+      EXPECT_EQ(std::vector<char>(inlier_mask.begin() + begin,
+                                  inlier_mask.begin() + end),
+                expected_inlier_mask);
+    }
+  }
+  EXPECT_GT(num_success, batch.NumTracks() / 2);
+
+  ThreadPool thread_pool(4);
+  std::vector<char> parallel_success;
+  std::vector<char> parallel_inlier_mask;
+  std::vector<Eigen::Vector3d> parallel_xyzs;
+  EstimateTriangulations(options,
+                         batch,
+                         &thread_pool,
+                         &parallel_success,
+                         &parallel_inlier_mask,
+                         &parallel_xyzs);
+  EXPECT_EQ(parallel_success, success);
+  EXPECT_EQ(parallel_inlier_mask, inlier_mask);
+  for (size_t i = 0; i < batch.NumTracks(); ++i) {
+    if (success[i]) {
+      EXPECT_EQ(parallel_xyzs[i], xyzs[i]);
+    }
+  }
+
+  batch.Clear();
+  EXPECT_EQ(batch.NumTracks(), 0);
+  EXPECT_EQ(batch.NumObservations(), 0);
+}
+
+}  // namespace
+}  // namespace colmap
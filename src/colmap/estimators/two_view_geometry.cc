@@ -33,6 +33,7 @@
 #include "colmap/estimators/fundamental_matrix.h"
 #include "colmap/estimators/homography_matrix.h"
 #include "colmap/estimators/translation_transform.h"
+#include "colmap/estimators/two_view_geometry_cuda.h"
 #include "colmap/geometry/essential_matrix.h"
 #include "colmap/geometry/homography_matrix.h"
 #include "colmap/geometry/pose.h"
@@ -41,7 +42,11 @@
 #include "colmap/optim/loransac.h"
 #include "colmap/optim/ransac.h"
 #include "colmap/scene/camera.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
 
+#include <algorithm>
+#include <memory>
 #include <unordered_set>
 
 namespace colmap {
@@ -84,6 +89,240 @@ FeatureMatches ExtractOutlierMatches(const FeatureMatches& matches,
   return outlier_matches;
 }
 
+#if defined(COLMAP_CUDA_ENABLED)
+
+// The scorer and its device buffers are reused for all pairs that are verified
+// by the same thread, e.g., the verifier workers of the matching pipeline.
+CudaTwoViewGeometryScorer* GetThreadCudaScorer(const int gpu_index) {
+  thread_local std::unique_ptr<CudaTwoViewGeometryScorer> scorer;
+  if (!scorer || scorer->GpuIndex() != gpu_index) {
+    scorer = std::make_unique<CudaTwoViewGeometryScorer>(gpu_index);
+  }
+  return scorer.get();
+}
+
+// LO-RANSAC variant, which samples and solves the minimal problems of a batch
+// of trials on the CPU and then scores all resulting hypotheses in a single
+// launch on the GPU. Only the best hypothesis of a batch is locally optimized
+// on the CPU. Note that the support is only measured by the number of inliers.
+template <typename Estimator, typename LocalEstimator>
+class CudaLORANSAC : public RANSAC<Estimator> {
+ public:
+  using typename RANSAC<Estimator>::Report;
+
+  CudaLORANSAC(const RANSACOptions& options,
+               CudaTwoViewGeometryScorer::ModelType model_type,
+               CudaTwoViewGeometryScorer* scorer)
+      : RANSAC<Estimator>(options), model_type_(model_type), scorer_(scorer) {}
+
+  Report Estimate(const std::vector<typename Estimator::X_t>& X,
+                  const std::vector<typename Estimator::Y_t>& Y);
+
+  using RANSAC<Estimator>::estimator;
+  LocalEstimator local_estimator;
+  using RANSAC<Estimator>::sampler;
+  using RANSAC<Estimator>::support_measurer;
+
+ private:
+  using RANSAC<Estimator>::options_;
+
+  const CudaTwoViewGeometryScorer::ModelType model_type_;
+  CudaTwoViewGeometryScorer* scorer_;
+};
+
+template <typename Estimator, typename LocalEstimator>
+typename CudaLORANSAC<Estimator, LocalEstimator>::Report
+CudaLORANSAC<Estimator, LocalEstimator>::Estimate(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) {
+  THROW_CHECK_EQ(X.size(), Y.size());
+
+  const size_t num_samples = X.size();
+
+  Report report;
+  report.success = false;
+  report.num_trials = 0;
+
+  if (num_samples < Estimator::kMinNumSamples) {
+    return report;
+  }
+
+  // Number of trials whose hypotheses are scored in one launch. The dynamic
+  // termination is only checked between batches.
+  constexpr size_t kNumBatchTrials = 128;
+
+  typename InlierSupportMeasurer::Support best_support;
+  typename Estimator::M_t best_model;
+  bool best_model_is_local = false;
+
+  const double max_residual = options_.max_error * options_.max_error;
+
+  std::vector<double> residuals;
+  std::vector<double> best_local_residuals;
+
+  std::vector<typename LocalEstimator::X_t> X_inlier;
+  std::vector<typename LocalEstimator::Y_t> Y_inlier;
+
+  std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
+  std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
+  std::vector<typename Estimator::M_t> sample_models;
+  std::vector<typename Estimator::M_t> batch_models;
+  std::vector<size_t> batch_num_inliers;
+  std::vector<typename LocalEstimator::M_t> local_models;
+
+  sampler.Initialize(num_samples);
+  scorer_->SetPoints(X, Y);
+
+  const size_t max_num_trials =
+      std::min<size_t>(options_.max_num_trials, sampler.MaxNumSamples());
+  size_t dyn_max_num_trials = max_num_trials;
+  const size_t min_num_trials = options_.min_num_trials;
+
+  while (report.num_trials < max_num_trials &&
+         (report.num_trials < dyn_max_num_trials ||
+          report.num_trials < min_num_trials)) {
+    const size_t num_batch_trials =
+        std::min(kNumBatchTrials, max_num_trials - report.num_trials);
+    batch_models.clear();
+    for (size_t i = 0; i < num_batch_trials; ++i) {
+      sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+      estimator.Estimate(X_rand, Y_rand, &sample_models);
+      batch_models.insert(
+          batch_models.end(), sample_models.begin(), sample_models.end());
+    }
+    report.num_trials += num_batch_trials;
+
+    scorer_->CountInliers(
+        model_type_, batch_models, max_residual, &batch_num_inliers);
+    if (batch_models.empty()) {
+      continue;
+    }
+
+    const size_t best_batch_idx =
+        std::max_element(batch_num_inliers.begin(), batch_num_inliers.end()) -
+        batch_num_inliers.begin();
+    if (batch_num_inliers[best_batch_idx] <= best_support.num_inliers) {
+      continue;
+    }
+
+    // The support of the candidate is recomputed in double precision.
+    estimator.Residuals(X, Y, batch_models[best_batch_idx], &residuals);
+    THROW_CHECK_EQ(residuals.size(), num_samples);
+    const auto support = support_measurer.Evaluate(residuals, max_residual);
+    if (!support_measurer.Compare(support, best_support)) {
+      continue;
+    }
+
+    best_support = support;
+    best_model = batch_models[best_batch_idx];
+    best_model_is_local = false;
+
+    // Estimate locally optimized model from inliers.
+    if (support.num_inliers > Estimator::kMinNumSamples &&
+        support.num_inliers >= LocalEstimator::kMinNumSamples) {
+      // Recursive local optimization to expand inlier set.
+      const size_t kMaxNumLocalTrials = 10;
+      for (size_t local_num_trials = 0; local_num_trials < kMaxNumLocalTrials;
+           ++local_num_trials) {
+        X_inlier.clear();
+        Y_inlier.clear();
+        X_inlier.reserve(num_samples);
+        Y_inlier.reserve(num_samples);
+        for (size_t i = 0; i < residuals.size(); ++i) {
+          if (residuals[i] <= max_residual) {
+            X_inlier.push_back(X[i]);
+            Y_inlier.push_back(Y[i]);
+          }
+        }
+
+        local_estimator.Estimate(X_inlier, Y_inlier, &local_models);
+
+        const size_t prev_best_num_inliers = best_support.num_inliers;
+
+        for (const auto& local_model : local_models) {
+          local_estimator.Residuals(X, Y, local_model, &residuals);
+          THROW_CHECK_EQ(residuals.size(), num_samples);
+
+          const auto local_support =
+              support_measurer.Evaluate(residuals, max_residual);
+
+          // Check if locally optimized model is better.
+          if (support_measurer.Compare(local_support, best_support)) {
+            best_support = local_support;
+            best_model = local_model;
+            best_model_is_local = true;
+            std::swap(residuals, best_local_residuals);
+          }
+        }
+
+        // Only continue recursive local optimization, if the inlier set
+        // size increased and we thus have a chance to further improve.
+        if (best_support.num_inliers <= prev_best_num_inliers) {
+          break;
+        }
+
+        // Swap back the residuals, so we can extract the best inlier
+        // set in the next recursion of local optimization.
+        std::swap(residuals, best_local_residuals);
+      }
+    }
+
+    dyn_max_num_trials =
+        RANSAC<Estimator>::ComputeNumTrials(best_support.num_inliers,
+                                            num_samples,
+                                            options_.confidence,
+                                            options_.dyn_num_trials_multiplier);
+  }
+
+  report.support = best_support;
+  report.model = best_model;
+
+  // No valid model was found
+  if (report.support.num_inliers < estimator.kMinNumSamples) {
+    return report;
+  }
+
+  report.success = true;
+
+  if (best_model_is_local) {
+    local_estimator.Residuals(X, Y, report.model, &residuals);
+  } else {
+    estimator.Residuals(X, Y, report.model, &residuals);
+  }
+
+  THROW_CHECK_EQ(residuals.size(), num_samples);
+
+  report.inlier_mask.resize(num_samples);
+  for (size_t i = 0; i < residuals.size(); ++i) {
+    report.inlier_mask[i] = residuals[i] <= max_residual;
+  }
+
+  return report;
+}
+
+#endif  // COLMAP_CUDA_ENABLED
+
+// Robustly estimate the model with LO-RANSAC, either on the CPU or with the
+// hypotheses scored on the GPU.
+template <typename Estimator, typename LocalEstimator>
+typename RANSAC<Estimator>::Report EstimateLORANSAC(
+    const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector2d>& points2,
+    const RANSACOptions& ransac_options,
+    const CudaTwoViewGeometryScorer::ModelType model_type,
+    const TwoViewGeometryOptions& options) {
+#if defined(COLMAP_CUDA_ENABLED)
+  if (options.use_gpu) {
+    const std::vector<int> gpu_indices = CSVToVector<int>(options.gpu_index);
+    CudaLORANSAC<Estimator, LocalEstimator> ransac(
+        ransac_options, model_type, GetThreadCudaScorer(gpu_indices[0]));
+    return ransac.Estimate(points1, points2);
+  }
+#endif  // COLMAP_CUDA_ENABLED
+  LORANSAC<Estimator, LocalEstimator> ransac(ransac_options);
+  return ransac.Estimate(points1, points2);
+}
+
 inline bool IsImagePointInBoundingBox(const Eigen::Vector2d& point,
                                       const double minx,
                                       const double maxx,
@@ -118,9 +357,13 @@ TwoViewGeometry EstimateCalibratedHomography(
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  const auto H_report =
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          matched_points1,
+          matched_points2,
+          options.ransac_options,
+          CudaTwoViewGeometryScorer::ModelType::HOMOGRAPHY,
+          options);
   geometry.H = H_report.model;
 
   if (!H_report.success || H_report.support.num_inliers < min_num_inliers) {
@@ -174,17 +417,25 @@ TwoViewGeometry EstimateUncalibratedTwoViewGeometry(
 
   // Estimate epipolar model.
 
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
+  const auto F_report =
+      EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                       FundamentalMatrixEightPointEstimator>(
+          matched_points1,
+          matched_points2,
+          options.ransac_options,
+          CudaTwoViewGeometryScorer::ModelType::EPIPOLAR,
+          options);
   geometry.F = F_report.model;
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  const auto H_report =
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          matched_points1,
+          matched_points2,
+          options.ransac_options,
+          CudaTwoViewGeometryScorer::ModelType::HOMOGRAPHY,
+          options);
   geometry.H = H_report.model;
 
   if ((!F_report.success && !H_report.success) ||
@@ -298,6 +549,7 @@ bool TwoViewGeometryOptions::Check() const {
   CHECK_OPTION_GE(ransac_options.confidence, 0);
   CHECK_OPTION_LE(ransac_options.confidence, 1);
   CHECK_OPTION_LE(ransac_options.min_num_trials, ransac_options.max_num_trials);
+  CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
   return true;
 }
 
@@ -457,25 +709,66 @@ TwoViewGeometry EstimateCalibratedTwoViewGeometry(
        camera2.CamFromImgThreshold(options.ransac_options.max_error)) /
       2;
 
-  LORANSAC<EssentialMatrixFivePointEstimator, EssentialMatrixFivePointEstimator>
-      E_ransac(E_ransac_options);
-  const auto E_report =
-      E_ransac.Estimate(matched_points1_normalized, matched_points2_normalized);
-  geometry.E = E_report.model;
+  const auto estimate_E = [&]() {
+    return EstimateLORANSAC<EssentialMatrixFivePointEstimator,
+                            EssentialMatrixFivePointEstimator>(
+        matched_points1_normalized,
+        matched_points2_normalized,
+        E_ransac_options,
+        CudaTwoViewGeometryScorer::ModelType::EPIPOLAR,
+        options);
+  };
 
   // step: 3.2 FundamentalMatrix
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
-  geometry.F = F_report.model;
+  const auto estimate_F = [&]() {
+    return EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                            FundamentalMatrixEightPointEstimator>(
+        matched_points1,
+        matched_points2,
+        options.ransac_options,
+        CudaTwoViewGeometryScorer::ModelType::EPIPOLAR,
+        options);
+  };
 
   // Estimate planar or panoramic model.
 
   // step: 3.3 HomographyMatrix
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  const auto estimate_H = [&]() {
+    return EstimateLORANSAC<HomographyMatrixEstimator,
+                            HomographyMatrixEstimator>(
+        matched_points1,
+        matched_points2,
+        options.ransac_options,
+        CudaTwoViewGeometryScorer::ModelType::HOMOGRAPHY,
+        options);
+  };
+
+  decltype(estimate_E()) E_report;
+  decltype(estimate_F()) F_report;
+  decltype(estimate_H()) H_report;
+#if defined(COLMAP_CUDA_ENABLED)
+  const bool parallel_estimation =
+      options.parallel_estimation && !options.use_gpu;
+#else
+  const bool parallel_estimation = options.parallel_estimation;
+#endif  // COLMAP_CUDA_ENABLED
+  if (parallel_estimation) {
+    // The three models are independent and share the same correspondences,
+    // so F and H are estimated on separate threads while E is estimated on
+    // the calling thread.
+    ThreadPool thread_pool(2);
+    auto F_future = thread_pool.AddTask(estimate_F);
+    auto H_future = thread_pool.AddTask(estimate_H);
+    E_report = estimate_E();
+    F_report = F_future.get();
+    H_report = H_future.get();
+  } else {
+    E_report = estimate_E();
+    F_report = estimate_F();
+    H_report = estimate_H();
+  }
+  geometry.E = E_report.model;
+  geometry.F = F_report.model;
   geometry.H = H_report.model;
 
   // step: 3.4 E&F&H失败 或者 三者内点数都较少，则退化DEGENERATE
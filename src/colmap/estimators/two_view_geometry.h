@@ -36,6 +36,8 @@
 #include "colmap/scene/two_view_geometry.h"
 #include "colmap/util/logging.h"
 
+#include <string>
+
 namespace colmap {
 
 // Estimation options.
@@ -97,6 +99,22 @@ struct TwoViewGeometryOptions {
   // field will be initialized.
   bool multiple_models = false;
 
+  // Whether to estimate the essential, fundamental, and homography matrices of
+  // calibrated image pairs concurrently on separate threads. This reduces the
+  // latency per pair, if there are fewer pairs than cores to verify, e.g., for
+  // small sequential matching windows. Ignored if use_gpu is enabled, since
+  // the GPU scorers are owned by the verification threads.
+  bool parallel_estimation = false;
+
+  // Whether to score the RANSAC hypotheses of the epipolar and homography
+  // models on the GPU. Ignored if COLMAP is built without CUDA.
+  bool use_gpu = false;
+
+  // Index of the GPU used for scoring the hypotheses. Only the first index of
+  // a comma-separated list is used here, while the matching pipeline assigns
+  // the listed GPUs to its verification threads. If -1, the best GPU is used.
+  std::string gpu_index = "-1";
+
   // TwoViewGeometryOptions used to robustly estimate the geometry.
   RANSACOptions ransac_options;
 
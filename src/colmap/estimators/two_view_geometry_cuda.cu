@@ -0,0 +1,221 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/estimators/two_view_geometry_cuda.h"
+
+#include "colmap/util/cuda.h"
+#include "colmap/util/cudacc.h"
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <cuda_runtime.h>
+
+namespace colmap {
+namespace {
+
+constexpr int kNumThreadsPerBlock = 256;
+
+// Each block counts the inliers of one row-major 3x3 model and each thread
+// evaluates a strided subset of the correspondences (x1, y1, x2, y2).
+template <CudaTwoViewGeometryScorer::ModelType kModelType>
+__global__ void CountInliersKernel(const float4* points,
+                                   const int num_points,
+                                   const float* models,
+                                   const float max_residual,
+                                   int* num_inliers) {
+  __shared__ float M[9];
+  __shared__ int block_num_inliers;
+
+  if (threadIdx.x < 9) {
+    M[threadIdx.x] = models[9 * blockIdx.x + threadIdx.x];
+  }
+  if (threadIdx.x == 0) {
+    block_num_inliers = 0;
+  }
+  __syncthreads();
+
+  int thread_num_inliers = 0;
+  for (int i = threadIdx.x; i < num_points; i += blockDim.x) {
+    const float4 point = points[i];
+
+    const float Mx1_0 = M[0] * point.x + M[1] * point.y + M[2];
+    const float Mx1_1 = M[3] * point.x + M[4] * point.y + M[5];
+    const float Mx1_2 = M[6] * point.x + M[7] * point.y + M[8];
+
+    float residual;
+    if (kModelType == CudaTwoViewGeometryScorer::ModelType::EPIPOLAR) {
+      const float Mtx2_0 = M[0] * point.z + M[3] * point.w + M[6];
+      const float Mtx2_1 = M[1] * point.z + M[4] * point.w + M[7];
+      const float x2tMx1 = point.z * Mx1_0 + point.w * Mx1_1 + Mx1_2;
+      residual = x2tMx1 * x2tMx1 / (Mx1_0 * Mx1_0 + Mx1_1 * Mx1_1 +
+                                    Mtx2_0 * Mtx2_0 + Mtx2_1 * Mtx2_1);
+    } else {
+      const float inv_Mx1_2 = 1.0f / Mx1_2;
+      const float dx = point.z - Mx1_0 * inv_Mx1_2;
+      const float dy = point.w - Mx1_1 * inv_Mx1_2;
+      residual = dx * dx + dy * dy;
+    }
+
+    // Degenerate residuals are NaN and never counted as inliers.
+    if (residual <= max_residual) {
+      thread_num_inliers += 1;
+    }
+  }
+
+  atomicAdd(&block_num_inliers, thread_num_inliers);
+  __syncthreads();
+
+  if (threadIdx.x == 0) {
+    num_inliers[blockIdx.x] = block_num_inliers;
+  }
+}
+
+}  // namespace
+
+CudaTwoViewGeometryScorer::CudaTwoViewGeometryScorer(const int gpu_index)
+    : gpu_index_(gpu_index) {
+  SetBestCudaDevice(gpu_index_);
+}
+
+CudaTwoViewGeometryScorer::~CudaTwoViewGeometryScorer() {
+  CUDA_SAFE_CALL(cudaFree(points_device_));
+  CUDA_SAFE_CALL(cudaFree(models_device_));
+  CUDA_SAFE_CALL(cudaFree(num_inliers_device_));
+}
+
+int CudaTwoViewGeometryScorer::GpuIndex() const { return gpu_index_; }
+
+void CudaTwoViewGeometryScorer::SetPoints(
+    const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector2d>& points2) {
+  THROW_CHECK_EQ(points1.size(), points2.size());
+
+  num_points_ = points1.size();
+  if (num_points_ > points_capacity_) {
+    CUDA_SAFE_CALL(cudaFree(points_device_));
+    points_capacity_ = std::max(num_points_, 2 * points_capacity_);
+    CUDA_SAFE_CALL(cudaMalloc(reinterpret_cast<void**>(&points_device_),
+                              4 * points_capacity_ * sizeof(float)));
+  }
+
+  points_host_.resize(4 * num_points_);
+  for (size_t i = 0; i < num_points_; ++i) {
+    points_host_[4 * i + 0] = static_cast<float>(points1[i].x());
+    points_host_[4 * i + 1] = static_cast<float>(points1[i].y());
+    points_host_[4 * i + 2] = static_cast<float>(points2[i].x());
+    points_host_[4 * i + 3] = static_cast<float>(points2[i].y());
+  }
+
+  CUDA_SAFE_CALL(cudaMemcpy(points_device_,
+                            points_host_.data(),
+                            points_host_.size() * sizeof(float),
+                            cudaMemcpyHostToDevice));
+}
+
+void CudaTwoViewGeometryScorer::CountInliers(
+    const ModelType model_type,
+    const std::vector<Eigen::Matrix3d>& models,
+    const double max_residual,
+    std::vector<size_t>* num_inliers) {
+  const size_t num_models = models.size();
+  num_inliers->resize(num_models);
+  if (num_models == 0) {
+    return;
+  }
+
+  if (num_points_ == 0) {
+    std::fill(num_inliers->begin(), num_inliers->end(), 0);
+    return;
+  }
+
+  if (num_models > models_capacity_) {
+    CUDA_SAFE_CALL(cudaFree(models_device_));
+    CUDA_SAFE_CALL(cudaFree(num_inliers_device_));
+    models_capacity_ = std::max(num_models, 2 * models_capacity_);
+    CUDA_SAFE_CALL(cudaMalloc(reinterpret_cast<void**>(&models_device_),
+                              9 * models_capacity_ * sizeof(float)));
+    CUDA_SAFE_CALL(cudaMalloc(reinterpret_cast<void**>(&num_inliers_device_),
+                              models_capacity_ * sizeof(int)));
+  }
+
+  // Both residuals are invariant to the scale of the model, which is
+  // normalized to avoid underflow in single precision, e.g., for fundamental
+  // matrices in pixel coordinates.
+  models_host_.resize(9 * num_models);
+  for (size_t i = 0; i < num_models; ++i) {
+    const double max_coeff = models[i].cwiseAbs().maxCoeff();
+    const double scale = max_coeff > 0 ? 1.0 / max_coeff : 1.0;
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        models_host_[9 * i + 3 * r + c] =
+            static_cast<float>(scale * models[i](r, c));
+      }
+    }
+  }
+
+  CUDA_SAFE_CALL(cudaMemcpy(models_device_,
+                            models_host_.data(),
+                            models_host_.size() * sizeof(float),
+                            cudaMemcpyHostToDevice));
+
+  const float4* points = reinterpret_cast<const float4*>(points_device_);
+  const float max_residual_float = static_cast<float>(max_residual);
+  switch (model_type) {
+    case ModelType::EPIPOLAR:
+      CountInliersKernel<ModelType::EPIPOLAR>
+          <<<num_models, kNumThreadsPerBlock>>>(points,
+                                                static_cast<int>(num_points_),
+                                                models_device_,
+                                                max_residual_float,
+                                                num_inliers_device_);
+      break;
+    case ModelType::HOMOGRAPHY:
+      CountInliersKernel<ModelType::HOMOGRAPHY>
+          <<<num_models, kNumThreadsPerBlock>>>(points,
+                                                static_cast<int>(num_points_),
+                                                models_device_,
+                                                max_residual_float,
+                                                num_inliers_device_);
+      break;
+  }
+  CUDA_CHECK();
+
+  num_inliers_host_.resize(num_models);
+  CUDA_SAFE_CALL(cudaMemcpy(num_inliers_host_.data(),
+                            num_inliers_device_,
+                            num_models * sizeof(int),
+                            cudaMemcpyDeviceToHost));
+  for (size_t i = 0; i < num_models; ++i) {
+    (*num_inliers)[i] = static_cast<size_t>(num_inliers_host_[i]);
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,88 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+// Scores batches of two-view geometry hypotheses on the GPU. The
+// correspondences of an image pair are uploaded once and the hypotheses of
+// many RANSAC trials are then scored in a single kernel launch, with one
+// thread block per hypothesis. The device buffers are reused across pairs.
+//
+// The residuals are computed in single precision, so the inlier counts may
+// differ from the CPU residuals for correspondences close to the threshold.
+class CudaTwoViewGeometryScorer {
+ public:
+  enum class ModelType {
+    // Fundamental or essential matrix scored by the squared Sampson error.
+    EPIPOLAR,
+    // Homography scored by the squared transfer error in the second image.
+    HOMOGRAPHY,
+  };
+
+  // The scorer uses the given device (or the best device for -1) and must
+  // only be used from the thread that constructed it.
+  explicit CudaTwoViewGeometryScorer(int gpu_index);
+  ~CudaTwoViewGeometryScorer();
+
+  int GpuIndex() const;
+
+  // Upload the correspondences for the following calls to CountInliers.
+  void SetPoints(const std::vector<Eigen::Vector2d>& points1,
+                 const std::vector<Eigen::Vector2d>& points2);
+
+  // Count the number of correspondences with a squared residual smaller or
+  // equal to max_residual for each of the models.
+  void CountInliers(ModelType model_type,
+                    const std::vector<Eigen::Matrix3d>& models,
+                    double max_residual,
+                    std::vector<size_t>* num_inliers);
+
+ private:
+  const int gpu_index_;
+
+  size_t num_points_ = 0;
+  size_t points_capacity_ = 0;
+  float* points_device_ = nullptr;
+
+  size_t models_capacity_ = 0;
+  float* models_device_ = nullptr;
+  int* num_inliers_device_ = nullptr;
+
+  std::vector<float> points_host_;
+  std::vector<float> models_host_;
+  std::vector<int> num_inliers_host_;
+};
+
+}  // namespace colmap
@@ -0,0 +1,136 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/estimators/two_view_geometry_cuda.h"
+
+#include "colmap/estimators/homography_matrix.h"
+#include "colmap/estimators/utils.h"
+#include "colmap/geometry/essential_matrix.h"
+#include "colmap/math/random.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+size_t CountInliersCPU(const std::vector<double>& residuals,
+                       const double max_residual) {
+  size_t num_inliers = 0;
+  for (const double residual : residuals) {
+    if (residual <= max_residual) {
+      num_inliers += 1;
+    }
+  }
+  return num_inliers;
+}
+
+TEST(CudaTwoViewGeometryScorer, Epipolar) {
+  SetPRNGSeed(0);
+
+  const Rigid3d cam2_from_cam1(
+      Eigen::Quaterniond(Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitY())),
+      Eigen::Vector3d(-1, 0.1, 0.2));
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  for (int i = 0; i < 1000; ++i) {
+    const Eigen::Vector3d point3D(RandomUniformReal(-2.0, 2.0),
+                                  RandomUniformReal(-2.0, 2.0),
+                                  RandomUniformReal(4.0, 8.0));
+    points1.push_back(point3D.hnormalized());
+    points2.push_back((cam2_from_cam1 * point3D).hnormalized());
+    if (i % 2 == 0) {
+      points2.back() += Eigen::Vector2d(RandomUniformReal(-1.0, 1.0), 0.5);
+    }
+  }
+
+  const std::vector<Eigen::Matrix3d> models = {
+      EssentialMatrixFromPose(cam2_from_cam1),
+      EssentialMatrixFromPose(Rigid3d(
+          Eigen::Quaterniond(Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitX())),
+          Eigen::Vector3d(0, 1, 0)))};
+
+  CudaTwoViewGeometryScorer scorer(/*gpu_index=*/-1);
+  scorer.SetPoints(points1, points2);
+  std::vector<size_t> num_inliers;
+  const double max_residual = 1e-6;
+  scorer.CountInliers(CudaTwoViewGeometryScorer::ModelType::EPIPOLAR,
+                      models,
+                      max_residual,
+                      &num_inliers);
+  ASSERT_EQ(num_inliers.size(), models.size());
+
+  std::vector<double> residuals;
+  for (size_t i = 0; i < models.size(); ++i) {
+    ComputeSquaredSampsonError(points1, points2, models[i], &residuals);
+    EXPECT_NEAR(num_inliers[i], CountInliersCPU(residuals, max_residual), 2);
+  }
+  EXPECT_GE(num_inliers[0], 500);
+}
+
+TEST(CudaTwoViewGeometryScorer, Homography) {
+  SetPRNGSeed(0);
+
+  Eigen::Matrix3d H;
+  H << 1.1, 0.1, 20, -0.05, 0.9, -10, 1e-4, 2e-4, 1;
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  for (int i = 0; i < 1000; ++i) {
+    points1.emplace_back(RandomUniformReal(0.0, 1000.0),
+                         RandomUniformReal(0.0, 1000.0));
+    points2.push_back((H * points1.back().homogeneous()).hnormalized());
+    if (i % 4 == 0) {
+      points2.back() += Eigen::Vector2d(10, -10);
+    }
+  }
+
+  CudaTwoViewGeometryScorer scorer(/*gpu_index=*/-1);
+  scorer.SetPoints(points1, points2);
+  std::vector<size_t> num_inliers;
+  scorer.CountInliers(CudaTwoViewGeometryScorer::ModelType::HOMOGRAPHY,
+                      {H, 2 * H, Eigen::Matrix3d::Identity()},
+                      /*max_residual=*/1,
+                      &num_inliers);
+  ASSERT_EQ(num_inliers.size(), 3);
+  EXPECT_EQ(num_inliers[0], 750);
+  EXPECT_EQ(num_inliers[1], 750);
+
+  std::vector<double> residuals;
+  HomographyMatrixEstimator::Residuals(
+      points1, points2, Eigen::Matrix3d::Identity(), &residuals);
+  EXPECT_EQ(num_inliers[2], CountInliersCPU(residuals, 1));
+
+  scorer.CountInliers(CudaTwoViewGeometryScorer::ModelType::HOMOGRAPHY,
+                      {},
+                      /*max_residual=*/1,
+                      &num_inliers);
+  EXPECT_TRUE(num_inliers.empty());
+}
+
+}  // namespace
+}  // namespace colmap
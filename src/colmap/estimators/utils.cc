@@ -34,6 +34,18 @@
 
 #include <Eigen/Geometry>
 
+#if defined(COLMAP_SIMD_ENABLED) && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define COLMAP_SAMPSON_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(COLMAP_SIMD_ENABLED) && defined(__aarch64__) && \
+    defined(__ARM_NEON)
+#define COLMAP_SAMPSON_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
 namespace colmap {
 
 void CenterAndNormalizeImagePoints(const std::vector<Eigen::Vector2d>& points,
@@ -69,22 +81,163 @@ void CenterAndNormalizeImagePoints(const std::vector<Eigen::Vector2d>& points,
   }
 }
 
+namespace {
+
+// Squared Sampson error for the column-major matrix E.
+inline double SquaredSampsonError(const double* E,
+                                  const double x1,
+                                  const double y1,
+                                  const double x2,
+                                  const double y2) {
+  const double line1_x = E[0] * x1 + E[3] * y1 + E[6];
+  const double line1_y = E[1] * x1 + E[4] * y1 + E[7];
+  const double line1_z = E[2] * x1 + E[5] * y1 + E[8];
+  const double line2_x = x2 * E[0] + y2 * E[1] + E[2];
+  const double line2_y = x2 * E[3] + y2 * E[4] + E[5];
+  const double num = x2 * line1_x + y2 * line1_y + line1_z;
+  return num * num / (line2_x * line2_x + line2_y * line2_y +
+                      line1_x * line1_x + line1_y * line1_y);
+}
+
+// The SIMD kernels de-interleave the points in registers, so the residuals of
+// all models are computed without a structure-of-arrays copy of the points.
+// They return the number of processed points, leaving the rest to the scalar
+// code.
+
+#if defined(COLMAP_SAMPSON_KERNELS_X86)
+
+// Computes a * x + b * y + c.
+__attribute__((target("avx2"))) inline __m256d DotAVX2(
+    __m256d a, __m256d b, __m256d c, __m256d x, __m256d y) {
+  return _mm256_add_pd(
+      _mm256_add_pd(_mm256_mul_pd(a, x), _mm256_mul_pd(b, y)), c);
+}
+
+__attribute__((target("avx2"))) size_t ComputeSquaredSampsonErrorAVX2(
+    const double* points1,
+    const double* points2,
+    const size_t num_points,
+    const double* E,
+    double* residuals) {
+  __m256d e[9];
+  for (int i = 0; i < 9; ++i) {
+    e[i] = _mm256_set1_pd(E[i]);
+  }
+  size_t i = 0;
+  for (; i + 4 <= num_points; i += 4) {
+    // The coordinates are in the order of the points 0, 2, 1, 3.
+    const __m256d p1a = _mm256_loadu_pd(points1 + 2 * i);
+    const __m256d p1b = _mm256_loadu_pd(points1 + 2 * i + 4);
+    const __m256d p2a = _mm256_loadu_pd(points2 + 2 * i);
+    const __m256d p2b = _mm256_loadu_pd(points2 + 2 * i + 4);
+    const __m256d x1 = _mm256_unpacklo_pd(p1a, p1b);
+    const __m256d y1 = _mm256_unpackhi_pd(p1a, p1b);
+    const __m256d x2 = _mm256_unpacklo_pd(p2a, p2b);
+    const __m256d y2 = _mm256_unpackhi_pd(p2a, p2b);
+    const __m256d line1_x = DotAVX2(e[0], e[3], e[6], x1, y1);
+    const __m256d line1_y = DotAVX2(e[1], e[4], e[7], x1, y1);
+    const __m256d line1_z = DotAVX2(e[2], e[5], e[8], x1, y1);
+    const __m256d line2_x = DotAVX2(e[0], e[1], e[2], x2, y2);
+    const __m256d line2_y = DotAVX2(e[3], e[4], e[5], x2, y2);
+    const __m256d num = DotAVX2(line1_x, line1_y, line1_z, x2, y2);
+    const __m256d denom = _mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(line2_x, line2_x),
+                      _mm256_mul_pd(line2_y, line2_y)),
+        _mm256_add_pd(_mm256_mul_pd(line1_x, line1_x),
+                      _mm256_mul_pd(line1_y, line1_y)));
+    const __m256d residual = _mm256_div_pd(_mm256_mul_pd(num, num), denom);
+    // Restore the order of the points.
+    _mm256_storeu_pd(residuals + i,
+                     _mm256_permute4x64_pd(residual, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  return i;
+}
+
+#endif  // COLMAP_SAMPSON_KERNELS_X86
+
+#if defined(COLMAP_SAMPSON_KERNELS_NEON)
+
+// Computes a * x + b * y + c.
+inline float64x2_t DotNEON(float64x2_t a,
+                           float64x2_t b,
+                           float64x2_t c,
+                           float64x2_t x,
+                           float64x2_t y) {
+  return vaddq_f64(vaddq_f64(vmulq_f64(a, x), vmulq_f64(b, y)), c);
+}
+
+size_t ComputeSquaredSampsonErrorNEON(const double* points1,
+                                      const double* points2,
+                                      const size_t num_points,
+                                      const double* E,
+                                      double* residuals) {
+  float64x2_t e[9];
+  for (int i = 0; i < 9; ++i) {
+    e[i] = vdupq_n_f64(E[i]);
+  }
+  size_t i = 0;
+  for (; i + 2 <= num_points; i += 2) {
+    const float64x2x2_t p1 = vld2q_f64(points1 + 2 * i);
+    const float64x2x2_t p2 = vld2q_f64(points2 + 2 * i);
+    const float64x2_t x1 = p1.val[0];
+    const float64x2_t y1 = p1.val[1];
+    const float64x2_t x2 = p2.val[0];
+    const float64x2_t y2 = p2.val[1];
+    const float64x2_t line1_x = DotNEON(e[0], e[3], e[6], x1, y1);
+    const float64x2_t line1_y = DotNEON(e[1], e[4], e[7], x1, y1);
+    const float64x2_t line1_z = DotNEON(e[2], e[5], e[8], x1, y1);
+    const float64x2_t line2_x = DotNEON(e[0], e[1], e[2], x2, y2);
+    const float64x2_t line2_y = DotNEON(e[3], e[4], e[5], x2, y2);
+    const float64x2_t num = DotNEON(line1_x, line1_y, line1_z, x2, y2);
+    const float64x2_t denom = vaddq_f64(
+        vaddq_f64(vmulq_f64(line2_x, line2_x), vmulq_f64(line2_y, line2_y)),
+        vaddq_f64(vmulq_f64(line1_x, line1_x), vmulq_f64(line1_y, line1_y)));
+    vst1q_f64(residuals + i, vdivq_f64(vmulq_f64(num, num), denom));
+  }
+  return i;
+}
+
+#endif  // COLMAP_SAMPSON_KERNELS_NEON
+
+}  // namespace
+
 void ComputeSquaredSampsonError(const std::vector<Eigen::Vector2d>& points1,
                                 const std::vector<Eigen::Vector2d>& points2,
                                 const Eigen::Matrix3d& E,
                                 std::vector<double>* residuals) {
-  const size_t num_points1 = points1.size();
-  THROW_CHECK_EQ(num_points1, points2.size());
-  residuals->resize(num_points1);
-  for (size_t i = 0; i < num_points1; ++i) {
-    const Eigen::Vector3d epipolar_line1 = E * points1[i].homogeneous();
-    const Eigen::Vector3d point2_homogeneous = points2[i].homogeneous();
-    const double num = point2_homogeneous.dot(epipolar_line1);
-    const Eigen::Vector4d denom(point2_homogeneous.dot(E.col(0)),
-                                point2_homogeneous.dot(E.col(1)),
-                                epipolar_line1.x(),
-                                epipolar_line1.y());
-    (*residuals)[i] = num * num / denom.squaredNorm();
+  const size_t num_points = points1.size();
+  THROW_CHECK_EQ(num_points, points2.size());
+  residuals->resize(num_points);
+  if (num_points == 0) {
+    return;
+  }
+
+  // Eigen::Vector2d has no padding, so the points are contiguous x, y pairs.
+  static_assert(sizeof(Eigen::Vector2d) == 2 * sizeof(double));
+  const double* points1_data = points1[0].data();
+  const double* points2_data = points2[0].data();
+  // Column-major storage of the matrix.
+  const double* E_data = E.data();
+  double* residuals_data = residuals->data();
+
+  size_t i = 0;
+#if defined(COLMAP_SAMPSON_KERNELS_X86)
+  static const bool kHasAVX2 = __builtin_cpu_supports("avx2");
+  if (kHasAVX2) {
+    i = ComputeSquaredSampsonErrorAVX2(
+        points1_data, points2_data, num_points, E_data, residuals_data);
+  }
+#elif defined(COLMAP_SAMPSON_KERNELS_NEON)
+  i = ComputeSquaredSampsonErrorNEON(
+      points1_data, points2_data, num_points, E_data, residuals_data);
+#endif
+
+  for (; i < num_points; ++i) {
+    residuals_data[i] = SquaredSampsonError(E_data,
+                                            points1_data[2 * i],
+                                            points1_data[2 * i + 1],
+                                            points2_data[2 * i],
+                                            points2_data[2 * i + 1]);
   }
 }
 
@@ -60,7 +60,8 @@ void CenterAndNormalizeImagePoints(const std::vector<Eigen::Vector2d>& points,
 // Calculate the residuals of a set of corresponding points and a given
 // fundamental or essential matrix.
 //
-// Residuals are defined as the squared Sampson error.
+// Residuals are defined as the squared Sampson error. The residuals are
+// computed with AVX2 or NEON, if SIMD is enabled and supported by the CPU.
 //
 // @param points1     First set of corresponding points as Nx2 matrix.
 // @param points2     Second set of corresponding points as Nx2 matrix.
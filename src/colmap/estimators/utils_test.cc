@@ -81,6 +81,33 @@ TEST(ComputeSquaredSampsonError, Nominal) {
   EXPECT_EQ(residuals[2], 2);
 }
 
+TEST(ComputeSquaredSampsonError, RandomPoints) {
+  // The number of points is not a multiple of the SIMD width to cover the
+  // remaining points.
+  constexpr int kNumPoints = 103;
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  for (int i = 0; i < kNumPoints; ++i) {
+    points1.push_back(Eigen::Vector2d::Random());
+    points2.push_back(Eigen::Vector2d::Random());
+  }
+  const Eigen::Matrix3d F = Eigen::Matrix3d::Random();
+
+  std::vector<double> residuals;
+  ComputeSquaredSampsonError(points1, points2, F, &residuals);
+
+  ASSERT_EQ(residuals.size(), kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i) {
+    const Eigen::Vector3d line1 = F * points1[i].homogeneous();
+    const Eigen::Vector3d line2 = F.transpose() * points2[i].homogeneous();
+    const double num = points2[i].homogeneous().dot(line1);
+    const double expected_residual =
+        num * num / (line1.head<2>().squaredNorm() +
+                     line2.head<2>().squaredNorm());
+    EXPECT_NEAR(residuals[i], expected_residual, 1e-12 * expected_residual);
+  }
+}
+
 TEST(ComputeSquaredReprojectionError, Nominal) {
   std::vector<Eigen::Vector2d> points2D;
   points2D.emplace_back(0, 0);
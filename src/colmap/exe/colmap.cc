@@ -35,6 +35,8 @@
 #include "colmap/exe/mvs.h"
 #include "colmap/exe/sfm.h"
 #include "colmap/exe/vocab_tree.h"
+#include "colmap/util/metrics.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/version.h"
 
 namespace {
@@ -101,11 +103,17 @@ int main(int argc, char** argv) {
   commands.emplace_back("database_cleaner", &colmap::RunDatabaseCleaner);
   commands.emplace_back("database_creator", &colmap::RunDatabaseCreator);
   commands.emplace_back("database_merger", &colmap::RunDatabaseMerger);
+  commands.emplace_back("dataset_synthesizer", &colmap::RunDatasetSynthesizer);
   commands.emplace_back("delaunay_mesher", &colmap::RunDelaunayMesher);
   commands.emplace_back("exhaustive_matcher", &colmap::RunExhaustiveMatcher);
   commands.emplace_back("feature_extractor", &colmap::RunFeatureExtractor);
   commands.emplace_back("feature_importer", &colmap::RunFeatureImporter);
+  commands.emplace_back("feature_store_exporter",
+                        &colmap::RunFeatureStoreExporter);
+  commands.emplace_back("global_mapper", &colmap::RunGlobalMapper);
   commands.emplace_back("hierarchical_mapper", &colmap::RunHierarchicalMapper);
+  commands.emplace_back("hierarchical_mapper_worker",
+                        &colmap::RunHierarchicalMapperWorker);
   commands.emplace_back("image_deleter", &colmap::RunImageDeleter);
   commands.emplace_back("image_filterer", &colmap::RunImageFilterer);
   commands.emplace_back("image_rectifier", &colmap::RunImageRectifier);
@@ -125,16 +133,22 @@ int main(int argc, char** argv) {
                         &colmap::RunModelOrientationAligner);
   commands.emplace_back("model_splitter", &colmap::RunModelSplitter);
   commands.emplace_back("model_transformer", &colmap::RunModelTransformer);
+  commands.emplace_back("mvs_job_creator", &colmap::RunMVSJobCreator);
+  commands.emplace_back("mvs_job_worker", &colmap::RunMVSJobWorker);
   commands.emplace_back("patch_match_stereo", &colmap::RunPatchMatchStereo);
+  commands.emplace_back("point_cloud_downsampler",
+                        &colmap::RunPointCloudDownsampler);
   commands.emplace_back("point_filtering", &colmap::RunPointFiltering);
   commands.emplace_back("point_triangulator", &colmap::RunPointTriangulator);
   commands.emplace_back("poisson_mesher", &colmap::RunPoissonMesher);
   commands.emplace_back("project_generator", &colmap::RunProjectGenerator);
   commands.emplace_back("rig_bundle_adjuster", &colmap::RunRigBundleAdjuster);
   commands.emplace_back("sequential_matcher", &colmap::RunSequentialMatcher);
+  commands.emplace_back("sift_pca_learner", &colmap::RunSiftPCALearner);
   commands.emplace_back("spatial_matcher", &colmap::RunSpatialMatcher);
   commands.emplace_back("stereo_fusion", &colmap::RunStereoFuser);
   commands.emplace_back("transitive_matcher", &colmap::RunTransitiveMatcher);
+  commands.emplace_back("vlad_matcher", &colmap::RunVLADMatcher);
   commands.emplace_back("vocab_tree_builder", &colmap::RunVocabTreeBuilder);
   commands.emplace_back("vocab_tree_matcher", &colmap::RunVocabTreeMatcher);
   commands.emplace_back("vocab_tree_retriever", &colmap::RunVocabTreeRetriever);
@@ -164,7 +178,10 @@ int main(int argc, char** argv) {
       int command_argc = argc - 1;
       char** command_argv = &argv[1];
       command_argv[0] = argv[0];
-      return matched_command_func(command_argc, command_argv);
+      const int status = matched_command_func(command_argc, command_argv);
+      colmap::Profiler::Instance().Finish();
+      colmap::MetricsRegistry::Instance().StopFileDump();
+      return status;
     }
   }
 
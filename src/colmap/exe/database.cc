@@ -31,7 +31,13 @@
 
 #include "colmap/controllers/option_manager.h"
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
+#include "colmap/scene/synthetic.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/timer.h"
+
+#include <memory>
+#include <vector>
 
 namespace colmap {
 
@@ -39,7 +45,8 @@ int RunDatabaseCleaner(int argc, char** argv) {
   std::string type;
 
   OptionManager options;
-  options.AddRequiredOption("type", &type, "{all, images, features, matches}");
+  options.AddRequiredOption(
+      "type", &type, "{all, images, features, global_descriptors, matches}");
   options.AddDatabaseOptions();
   options.Parse(argc, argv);
 
@@ -59,9 +66,13 @@ int RunDatabaseCleaner(int argc, char** argv) {
     } else if (type == "features") {
       PrintHeading2("Clearing image features and matches");
       database.ClearDescriptors();
+      database.ClearGlobalDescriptors();
       database.ClearKeypoints();
       database.ClearTwoViewGeometries();
       database.ClearMatches();
+    } else if (type == "global_descriptors") {
+      PrintHeading2("Clearing global image descriptors");
+      database.ClearGlobalDescriptors();
     } else if (type == "matches") {
       PrintHeading2("Clearing image matches");
       database.ClearTwoViewGeometries();
@@ -88,12 +99,25 @@ int RunDatabaseCreator(int argc, char** argv) {
 int RunDatabaseMerger(int argc, char** argv) {
   std::string database_path1;
   std::string database_path2;
+  std::string database_list_path;
   std::string merged_database_path;
+  bool compress_blobs = false;
+  bool preserve_image_ids = false;
+  int num_threads = -1;
 
   OptionManager options;
-  options.AddRequiredOption("database_path1", &database_path1);
-  options.AddRequiredOption("database_path2", &database_path2);
+  options.AddDefaultOption("database_path1", &database_path1);
+  options.AddDefaultOption("database_path2", &database_path2);
+  options.AddDefaultOption("database_list_path",
+                           &database_list_path,
+                           "Text file with one database path per line");
   options.AddRequiredOption("merged_database_path", &merged_database_path);
+  options.AddDefaultOption("compress_blobs", &compress_blobs);
+  options.AddDefaultOption(
+      "preserve_image_ids",
+      &preserve_image_ids,
+      "Keep the image ids, e.g., of the databases of a sharded extraction");
+  options.AddDefaultOption("num_threads", &num_threads);
   options.Parse(argc, argv);
 
   if (ExistsFile(merged_database_path)) {
@@ -101,10 +125,123 @@ int RunDatabaseMerger(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
-  Database database1(database_path1);
-  Database database2(database_path2);
+  std::vector<std::string> database_paths;
+  if (!database_list_path.empty()) {
+    database_paths = ReadTextFileLines(database_list_path);
+  }
+  for (const auto& database_path : {database_path1, database_path2}) {
+    if (!database_path.empty()) {
+      database_paths.push_back(database_path);
+    }
+  }
+
+  if (database_paths.size() < 2) {
+    LOG(ERROR) << "At least two databases must be given, either with "
+                  "--database_path1 and --database_path2 or with "
+                  "--database_list_path.";
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::unique_ptr<Database>> databases;
+  std::vector<const Database*> database_ptrs;
+  for (const auto& database_path : database_paths) {
+    databases.push_back(std::make_unique<Database>(database_path));
+    database_ptrs.push_back(databases.back().get());
+  }
+
   Database merged_database(merged_database_path);
-  Database::Merge(database1, database2, &merged_database);
+  merged_database.SetProfile(Database::Profile::BULK);
+  merged_database.SetBlobCompression(compress_blobs);
+
+  Timer timer;
+  timer.Start();
+  Database::Merge(
+      database_ptrs, &merged_database, num_threads, preserve_image_ids);
+  LOG(INFO) << "Merged " << database_paths.size() << " databases in "
+            << timer.ElapsedSeconds() << "s";
+
+  return EXIT_SUCCESS;
+}
+
+int RunDatasetSynthesizer(int argc, char** argv) {
+  std::string output_path;
+  std::string match_graph = "sequential";
+  StreamingSyntheticDatasetOptions synthetic_options;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddDefaultOption("output_path",
+                           &output_path,
+                           "Binary sparse model, which is skipped if empty");
+  options.AddDefaultOption(
+      "match_graph", &match_graph, "{sequential, grid, random}");
+  options.AddDefaultOption("num_cameras", &synthetic_options.num_cameras);
+  options.AddDefaultOption("num_images", &synthetic_options.num_images);
+  options.AddDefaultOption("num_points3D_per_image",
+                           &synthetic_options.num_points3D_per_image);
+  options.AddDefaultOption("num_points2D_without_point3D",
+                           &synthetic_options.num_points2D_without_point3D);
+  options.AddDefaultOption("point2D_stddev",
+                           &synthetic_options.point2D_stddev);
+  options.AddDefaultOption("inlier_match_ratio",
+                           &synthetic_options.inlier_match_ratio);
+  options.AddDefaultOption("view_overlap", &synthetic_options.view_overlap);
+  options.AddDefaultOption("max_tilt_deg", &synthetic_options.max_tilt_deg);
+  options.AddDefaultOption("terrain_height_stddev",
+                           &synthetic_options.terrain_height_stddev);
+  options.AddDefaultOption("num_threads", &synthetic_options.num_threads);
+  options.AddDefaultOption("seed", &synthetic_options.seed);
+  options.Parse(argc, argv);
+
+  StringToLower(&match_graph);
+  if (match_graph == "sequential") {
+    synthetic_options.match_graph =
+        StreamingSyntheticDatasetOptions::MatchGraph::SEQUENTIAL;
+  } else if (match_graph == "grid") {
+    synthetic_options.match_graph =
+        StreamingSyntheticDatasetOptions::MatchGraph::GRID;
+  } else if (match_graph == "random") {
+    synthetic_options.match_graph =
+        StreamingSyntheticDatasetOptions::MatchGraph::RANDOM;
+  } else {
+    LOG(ERROR) << "Invalid match graph: " << match_graph;
+    return EXIT_FAILURE;
+  }
+
+  if (!output_path.empty()) {
+    CreateDirIfNotExists(output_path);
+  }
+
+  Database database(*options.database_path);
+  database.SetProfile(Database::Profile::BULK);
+
+  Timer timer;
+  timer.Start();
+  SynthesizeStreamingDataset(synthetic_options, &database, output_path);
+  LOG(INFO) << "Synthesized " << synthetic_options.num_images
+            << " images in " << timer.ElapsedSeconds() << "s";
+
+  return EXIT_SUCCESS;
+}
+
+int RunFeatureStoreExporter(int argc, char** argv) {
+  std::string output_path;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddDefaultOption(
+      "output_path", &output_path, "Defaults to DATABASE_PATH.features");
+  options.Parse(argc, argv);
+
+  if (output_path.empty()) {
+    output_path = FeatureStore::DefaultPath(*options.database_path);
+  }
+
+  Database database(*options.database_path);
+  PrintHeading1("Exporting features");
+  FeatureStore::Write(database, output_path);
+  LOG(INFO) << "Exported features of " << database.NumImages()
+            << " images to " << output_path;
 
   return EXIT_SUCCESS;
 }
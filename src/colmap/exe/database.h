@@ -32,5 +32,7 @@ namespace colmap {
 int RunDatabaseCleaner(int argc, char** argv);
 int RunDatabaseCreator(int argc, char** argv);
 int RunDatabaseMerger(int argc, char** argv);
+int RunDatasetSynthesizer(int argc, char** argv);
+int RunFeatureStoreExporter(int argc, char** argv);
 
 }  // namespace colmap
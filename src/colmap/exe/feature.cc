@@ -34,6 +34,9 @@
 #include "colmap/controllers/image_reader.h"
 #include "colmap/controllers/option_manager.h"
 #include "colmap/exe/gui.h"
+#include "colmap/feature/sift_pca.h"
+#include "colmap/math/random.h"
+#include "colmap/scene/database.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
@@ -103,6 +106,7 @@ int RunFeatureExtractor(int argc, char** argv) {
   std::string image_list_path;
   int camera_mode = -1;
   std::string descriptor_normalization = "l1_root";
+  std::string descriptor_type = "sift";
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -112,6 +116,8 @@ int RunFeatureExtractor(int argc, char** argv) {
   options.AddDefaultOption("descriptor_normalization",
                            &descriptor_normalization,
                            "{'l1_root', 'l2'}");
+  options.AddDefaultOption(
+      "descriptor_type", &descriptor_type, "{'sift', 'binary'}");
   options.AddExtractionOptions();
   options.Parse(argc, argv);
 
@@ -139,6 +145,18 @@ int RunFeatureExtractor(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  StringToLower(&descriptor_type);
+  if (descriptor_type == "sift") {
+    options.sift_extraction->descriptor_type = FeatureDescriptorType::SIFT;
+  } else if (descriptor_type == "binary") {
+    options.sift_extraction->descriptor_type = FeatureDescriptorType::BINARY;
+    // Binary features are only extracted on the CPU.
+    options.sift_extraction->use_gpu = false;
+  } else {
+    LOG(ERROR) << "Invalid `descriptor_type`";
+    return EXIT_FAILURE;
+  }
+
   if (!image_list_path.empty()) {
     reader_options.image_list = ReadTextFileLines(image_list_path);
     if (reader_options.image_list.empty()) {
@@ -221,6 +239,75 @@ int RunFeatureImporter(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunSiftPCALearner(int argc, char** argv) {
+  std::string output_path;
+  int num_dims = 64;
+  int max_num_descriptors = 1000000;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("num_dims", &num_dims);
+  options.AddDefaultOption("max_num_descriptors", &max_num_descriptors);
+  options.Parse(argc, argv);
+
+  if (num_dims <= 0 || num_dims >= 128 || num_dims % 16 != 0) {
+    LOG(ERROR) << "`num_dims` must be a positive multiple of 16 below 128";
+    return EXIT_FAILURE;
+  }
+
+  // The images are visited in random order, so that the sample is not biased
+  // towards the first images, e.g., of a sequence.
+  LOG(INFO) << "Loading descriptors...";
+  FeatureDescriptors descriptors(0, 128);
+  {
+    Database database(*options.database_path);
+    DatabaseTransaction database_transaction(&database);
+    std::vector<Image> images = database.ReadAllImages();
+    Shuffle(images.size(), &images);
+    std::vector<FeatureDescriptors> image_descriptors;
+    Eigen::Index num_descriptors = 0;
+    for (const Image& image : images) {
+      if (num_descriptors >= max_num_descriptors) {
+        break;
+      }
+      if (!database.ExistsDescriptors(image.ImageId()) ||
+          database.ReadDescriptorsType(image.ImageId()) !=
+              FeatureDescriptorType::SIFT) {
+        continue;
+      }
+      image_descriptors.push_back(database.ReadDescriptors(image.ImageId()));
+      num_descriptors += image_descriptors.back().rows();
+    }
+
+    descriptors.resize(
+        std::min<Eigen::Index>(num_descriptors, max_num_descriptors), 128);
+    Eigen::Index row = 0;
+    for (const FeatureDescriptors& image_descriptor : image_descriptors) {
+      const Eigen::Index num_rows =
+          std::min(image_descriptor.rows(), descriptors.rows() - row);
+      descriptors.middleRows(row, num_rows) =
+          image_descriptor.topRows(num_rows);
+      row += num_rows;
+    }
+  }
+  LOG(INFO) << "=> Loaded a total of " << descriptors.rows() << " descriptors";
+
+  if (descriptors.rows() == 0) {
+    LOG(ERROR) << "No SIFT descriptors in the database";
+    return EXIT_FAILURE;
+  }
+
+  LOG(INFO) << "Learning projection...";
+  const SiftPCA pca = SiftPCA::Learn(descriptors, num_dims);
+  LOG(INFO) << StringPrintf("=> Captured %.2f%% of the descriptor energy",
+                            100 * pca.ExplainedEnergy());
+
+  pca.Write(output_path);
+
+  return EXIT_SUCCESS;
+}
+
 int RunExhaustiveMatcher(int argc, char** argv) {
   OptionManager options;
   options.AddDatabaseOptions();
@@ -425,4 +512,34 @@ int RunVocabTreeMatcher(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunVLADMatcher(int argc, char** argv) {
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddVLADMatchingOptions();
+  options.Parse(argc, argv);
+
+  if (!VerifySiftGPUParams(options.sift_matching->use_gpu)) {
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<QApplication> app;
+  if (options.sift_matching->use_gpu && kUseOpenGL) {
+    app.reset(new QApplication(argc, argv));
+  }
+
+  auto matcher = CreateVLADFeatureMatcher(*options.vlad_matching,
+                                          *options.sift_matching,
+                                          *options.two_view_geometry,
+                                          *options.database_path);
+
+  if (options.sift_matching->use_gpu && kUseOpenGL) {
+    RunThreadWithOpenGLContext(matcher.get());
+  } else {
+    matcher->Start();
+    matcher->Wait();
+  }
+
+  return EXIT_SUCCESS;
+}
+
 }  // namespace colmap
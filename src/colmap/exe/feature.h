@@ -77,6 +77,7 @@ bool VerifyCameraParams(const std::string& camera_model,
 // api: feature_extractor入口函数
 int RunFeatureExtractor(int argc, char** argv);
 int RunFeatureImporter(int argc, char** argv);
+int RunSiftPCALearner(int argc, char** argv);
 // api: exhaustive_matcher入口函数
 int RunExhaustiveMatcher(int argc, char** argv);
 int RunMatchesImporter(int argc, char** argv);
@@ -84,6 +85,7 @@ int RunMatchesImporter(int argc, char** argv);
 int RunSequentialMatcher(int argc, char** argv);
 int RunSpatialMatcher(int argc, char** argv);
 int RunTransitiveMatcher(int argc, char** argv);
+int RunVLADMatcher(int argc, char** argv);
 int RunVocabTreeMatcher(int argc, char** argv);
 
 }  // namespace colmap
@@ -73,6 +73,96 @@ std::vector<std::pair<image_t, image_t>> ReadStereoImagePairs(
   return stereo_pairs;
 }
 
+// Create a reconstruction with the registered images of the database cache
+// and the 3D points observed by them, whose tracks are restricted to these
+// images. The identifiers of the copied 3D points are the same as in the
+// given reconstruction.
+std::shared_ptr<Reconstruction> ExtractNeighborhoodReconstruction(
+    const Reconstruction& reconstruction,
+    const DatabaseCache& database_cache,
+    std::unordered_set<point3D_t>* point3D_ids) {
+  auto neighborhood = std::make_shared<Reconstruction>();
+  for (const auto& [image_id, _] : database_cache.Images()) {
+    if (!reconstruction.ExistsImage(image_id) ||
+        !reconstruction.IsImageRegistered(image_id)) {
+      continue;
+    }
+    const Image& image = reconstruction.Image(image_id);
+    if (!neighborhood->ExistsCamera(image.CameraId())) {
+      neighborhood->AddCamera(reconstruction.Camera(image.CameraId()));
+    }
+    neighborhood->AddImage(image);
+    for (const Point2D& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D()) {
+        point3D_ids->insert(point2D.point3D_id);
+      }
+    }
+  }
+
+  for (const point3D_t point3D_id : *point3D_ids) {
+    Point3D point3D = reconstruction.Point3D(point3D_id);
+    Track track;
+    for (const TrackElement& track_el : point3D.track.Elements()) {
+      if (neighborhood->ExistsImage(track_el.image_id)) {
+        track.AddElement(track_el);
+      }
+    }
+    point3D.track = std::move(track);
+    neighborhood->AddPoint3D(point3D_id, std::move(point3D));
+  }
+
+  return neighborhood;
+}
+
+// Add the newly registered images of the neighborhood to the reconstruction
+// together with their observations of the copied 3D points.
+void MergeNeighborhoodReconstruction(
+    const Reconstruction& neighborhood,
+    const std::unordered_set<point3D_t>& point3D_ids,
+    Reconstruction& reconstruction) {
+  std::vector<image_t> new_image_ids;
+  for (const image_t image_id : neighborhood.RegImageIds()) {
+    if (reconstruction.ExistsImage(image_id) &&
+        reconstruction.IsImageRegistered(image_id)) {
+      continue;
+    }
+    new_image_ids.push_back(image_id);
+    Image image = neighborhood.Image(image_id);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      image.ResetPoint3DForPoint2D(point2D_idx);
+    }
+    if (!reconstruction.ExistsCamera(image.CameraId())) {
+      reconstruction.AddCamera(neighborhood.Camera(image.CameraId()));
+    }
+    if (reconstruction.ExistsImage(image_id)) {
+      Image& existing_image = reconstruction.Image(image_id);
+      existing_image.CamFromWorld() = image.CamFromWorld();
+      if (existing_image.NumPoints2D() == 0) {
+        existing_image.SetPoints2D(image.Points2D());
+      }
+      reconstruction.RegisterImage(image_id);
+    } else {
+      reconstruction.AddImage(std::move(image));
+    }
+  }
+
+  // The registration only continues the tracks of the copied 3D points.
+  for (const image_t image_id : new_image_ids) {
+    const Image& image = neighborhood.Image(image_id);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      const point3D_t point3D_id = image.Point2D(point2D_idx).point3D_id;
+      if (point3D_id != kInvalidPoint3DId &&
+          point3D_ids.count(point3D_id) > 0 &&
+          reconstruction.ExistsPoint3D(point3D_id)) {
+        reconstruction.AddObservation(point3D_id,
+                                      TrackElement(image_id, point2D_idx));
+      }
+    }
+  }
+}
+
 }  // namespace
 
 int RunImageDeleter(int argc, char** argv) {
@@ -240,11 +330,17 @@ int RunImageRectifier(int argc, char** argv) {
 int RunImageRegistrator(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
+  bool load_neighborhood_only = false;
 
   OptionManager options;
   options.AddDatabaseOptions();
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption(
+      "load_neighborhood_only",
+      &load_neighborhood_only,
+      "Whether to only load the new images, their matched images, and the 3D "
+      "points observed by them instead of the entire database");
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -260,6 +356,9 @@ int RunImageRegistrator(int argc, char** argv) {
 
   PrintHeading1("Loading database");
 
+  auto reconstruction = std::make_shared<Reconstruction>();
+  reconstruction->Read(input_path);
+
   std::shared_ptr<DatabaseCache> database_cache;
 
   {
@@ -267,15 +366,60 @@ int RunImageRegistrator(int argc, char** argv) {
     timer.Start();
     const size_t min_num_matches =
         static_cast<size_t>(options.mapper->min_num_matches);
-    database_cache = DatabaseCache::Create(Database(*options.database_path),
-                                           min_num_matches,
-                                           options.mapper->ignore_watermarks,
-                                           options.mapper->image_names);
+    const Database database(*options.database_path);
+    const std::shared_ptr<const FeatureStore> feature_store =
+        FeatureStore::OpenForDatabase(*options.database_path, database);
+    if (load_neighborhood_only) {
+      std::unordered_set<image_t> new_image_ids;
+      for (const Image& image : database.ReadAllImages()) {
+        if ((options.mapper->image_names.empty() ||
+             options.mapper->image_names.count(image.Name()) > 0) &&
+            (!reconstruction->ExistsImage(image.ImageId()) ||
+             !reconstruction->IsImageRegistered(image.ImageId()))) {
+          new_image_ids.insert(image.ImageId());
+        }
+      }
+      database_cache =
+          DatabaseCache::CreateNeighborhood(database,
+                                            min_num_matches,
+                                            options.mapper->ignore_watermarks,
+                                            new_image_ids,
+                                            feature_store.get());
+    } else if (options.mapper->lazy_load_points2D) {
+      database_cache = DatabaseCache::CreateLazy(
+          *options.database_path,
+          min_num_matches,
+          options.mapper->ignore_watermarks,
+          options.mapper->image_names,
+          feature_store,
+          static_cast<size_t>(1024.0 * 1024.0 * 1024.0 *
+                              options.mapper->lazy_points2D_cache_size));
+    } else if (options.mapper->compact_points2D) {
+      database_cache =
+          DatabaseCache::CreateCompact(database,
+                                       min_num_matches,
+                                       options.mapper->ignore_watermarks,
+                                       options.mapper->image_names,
+                                       feature_store.get());
+    } else {
+      database_cache = DatabaseCache::Create(database,
+                                             min_num_matches,
+                                             options.mapper->ignore_watermarks,
+                                             options.mapper->image_names,
+                                             feature_store.get());
+    }
     timer.PrintMinutes();
   }
 
-  auto reconstruction = std::make_shared<Reconstruction>();
-  reconstruction->Read(input_path);
+  // The registration runs on the subset of the reconstruction observed by the
+  // neighborhood, which is merged back before writing the reconstruction.
+  std::shared_ptr<Reconstruction> full_reconstruction;
+  std::unordered_set<point3D_t> neighborhood_point3D_ids;
+  if (load_neighborhood_only) {
+    full_reconstruction = reconstruction;
+    reconstruction = ExtractNeighborhoodReconstruction(
+        *full_reconstruction, *database_cache, &neighborhood_point3D_ids);
+  }
 
   IncrementalMapper mapper(database_cache);
   mapper.BeginReconstruction(reconstruction);
@@ -301,6 +445,12 @@ int RunImageRegistrator(int argc, char** argv) {
 
   mapper.EndReconstruction(/*discard=*/false);
 
+  if (load_neighborhood_only) {
+    MergeNeighborhoodReconstruction(
+        *reconstruction, neighborhood_point3D_ids, *full_reconstruction);
+    reconstruction = full_reconstruction;
+  }
+
   reconstruction->Write(output_path);
 
   return EXIT_SUCCESS;
@@ -313,6 +463,7 @@ int RunImageUndistorter(int argc, char** argv) {
   std::string image_list_path;
   std::string copy_policy = "copy";
   int num_patch_match_src_images = 20;
+  bool keep_distorted_images = false;
   CopyType copy_type;
 
   UndistortCameraOptions undistort_camera_options;
@@ -328,6 +479,7 @@ int RunImageUndistorter(int argc, char** argv) {
       "copy_policy", &copy_policy, "{copy, soft-link, hard-link}");
   options.AddDefaultOption("num_patch_match_src_images",
                            &num_patch_match_src_images);
+  options.AddDefaultOption("keep_distorted_images", &keep_distorted_images);
   options.AddDefaultOption("blank_pixels",
                            &undistort_camera_options.blank_pixels);
   options.AddDefaultOption("min_scale", &undistort_camera_options.min_scale);
@@ -338,6 +490,10 @@ int RunImageUndistorter(int argc, char** argv) {
   options.AddDefaultOption("roi_min_y", &undistort_camera_options.roi_min_y);
   options.AddDefaultOption("roi_max_x", &undistort_camera_options.roi_max_x);
   options.AddDefaultOption("roi_max_y", &undistort_camera_options.roi_max_y);
+  options.AddDefaultOption("jpeg_quality",
+                           &undistort_camera_options.jpeg_quality);
+  options.AddDefaultOption("png_compression_level",
+                           &undistort_camera_options.png_compression_level);
   options.Parse(argc, argv);
 
   CreateDirIfNotExists(output_path);
@@ -384,7 +540,8 @@ int RunImageUndistorter(int argc, char** argv) {
                                             output_path,
                                             num_patch_match_src_images,
                                             copy_type,
-                                            image_ids);
+                                            image_ids,
+                                            keep_distorted_images);
   } else if (output_type == "PMVS") {
     undistorter = std::make_unique<PMVSUndistorter>(undistort_camera_options,
                                                     reconstruction,
@@ -426,6 +583,10 @@ int RunImageUndistorterStandalone(int argc, char** argv) {
   options.AddDefaultOption("roi_min_y", &undistort_camera_options.roi_min_y);
   options.AddDefaultOption("roi_max_x", &undistort_camera_options.roi_max_x);
   options.AddDefaultOption("roi_max_y", &undistort_camera_options.roi_max_y);
+  options.AddDefaultOption("jpeg_quality",
+                           &undistort_camera_options.jpeg_quality);
+  options.AddDefaultOption("png_compression_level",
+                           &undistort_camera_options.png_compression_level);
   options.Parse(argc, argv);
 
   CreateDirIfNotExists(output_path);
@@ -35,19 +35,22 @@
 #include "colmap/geometry/gps.h"
 #include "colmap/geometry/pose.h"
 #include "colmap/optim/ransac.h"
+#include "colmap/scene/reconstruction_chunked_io.h"
 #include "colmap/scene/reconstruction_io.h"
 #include "colmap/sfm/observation_manager.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/ply_octree.h"
 #include "colmap/util/threading.h"
 
+#include <boost/filesystem.hpp>
+
 namespace colmap {
 namespace {
 
 std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>>
-ComputeEqualPartsBounds(const Reconstruction& reconstruction,
+ComputeEqualPartsBounds(const std::pair<Eigen::Vector3d, Eigen::Vector3d>& bbox,
                         const Eigen::Vector3i& split) {
   std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> bounds;
-  const auto bbox = reconstruction.ComputeBoundingBox();
   const Eigen::Vector3d extent = bbox.second - bbox.first;
   const Eigen::Vector3d offset(
       extent(0) / split(0), extent(1) / split(1), extent(2) / split(2));
@@ -66,6 +69,15 @@ ComputeEqualPartsBounds(const Reconstruction& reconstruction,
   return bounds;
 }
 
+// Whether the reconstruction is read from the binary format, such that it can
+// be cropped without loading it into memory.
+bool IsBinaryReconstruction(const std::string& path) {
+  return !ExistsFile(JoinPaths(path, kChunkedReconstructionFileName)) &&
+         ExistsFile(JoinPaths(path, "cameras.bin")) &&
+         ExistsFile(JoinPaths(path, "images.bin")) &&
+         ExistsFile(JoinPaths(path, "points3D.bin"));
+}
+
 Eigen::Vector3d TransformLatLonAltToModelCoords(const Sim3d& tform,
                                                 const double lat,
                                                 const double lon,
@@ -434,21 +446,21 @@ int RunModelAnalyzer(int argc, char** argv) {
 
   Reconstruction reconstruction;
   reconstruction.Read(path);
+  const ReconstructionStatistics statistics =
+      reconstruction.ComputeStatistics();
 
   LOG(INFO) << StringPrintf("Cameras: %d", reconstruction.NumCameras());
   LOG(INFO) << StringPrintf("Images: %d", reconstruction.NumImages());
   LOG(INFO) << StringPrintf("Registered images: %d",
                             reconstruction.NumRegImages());
   LOG(INFO) << StringPrintf("Points: %d", reconstruction.NumPoints3D());
-  LOG(INFO) << StringPrintf("Observations: %d",
-                            reconstruction.ComputeNumObservations());
+  LOG(INFO) << StringPrintf("Observations: %d", statistics.num_observations);
   LOG(INFO) << StringPrintf("Mean track length: %f",
-                            reconstruction.ComputeMeanTrackLength());
-  LOG(INFO) << StringPrintf(
-      "Mean observations per image: %f",
-      reconstruction.ComputeMeanObservationsPerRegImage());
+                            statistics.mean_track_length);
+  LOG(INFO) << StringPrintf("Mean observations per image: %f",
+                            statistics.mean_observations_per_reg_image);
   LOG(INFO) << StringPrintf("Mean reprojection error: %fpx",
-                            reconstruction.ComputeMeanReprojectionError());
+                            statistics.mean_reprojection_error);
 
   // verbose information
   if (verbose) {
@@ -587,22 +599,40 @@ int RunModelConverter(int argc, char** argv) {
   std::string output_path;
   std::string output_type;
   bool skip_distortion = false;
+  PlyOctreeOptions octree_options;
 
   OptionManager options;
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddRequiredOption("output_type",
                             &output_type,
-                            "{BIN, TXT, NVM, Bundler, VRML, PLY, R3D, CAM}");
+                            "{BIN, CBIN, TXT, NVM, Bundler, VRML, PLY, "
+                            "PLY_OCTREE, R3D, CAM}");
   options.AddDefaultOption("skip_distortion", &skip_distortion);
+  options.AddDefaultOption("octree_max_num_points_per_node",
+                           &octree_options.max_num_points_per_node);
+  options.AddDefaultOption("octree_grid_size", &octree_options.grid_size);
+  options.AddDefaultOption("octree_max_depth", &octree_options.max_depth);
+  options.AddDefaultOption("octree_max_num_points_in_memory",
+                           &octree_options.max_num_points_in_memory);
   options.Parse(argc, argv);
 
+  StringToLower(&output_type);
+
+  // Point clouds, e.g., fused by the stereo fusion, are streamed from disk.
+  if (output_type == "ply_octree" && HasFileExtension(input_path, ".ply")) {
+    CreateDirIfNotExists(output_path);
+    WritePlyOctree(input_path, output_path, octree_options);
+    return EXIT_SUCCESS;
+  }
+
   Reconstruction reconstruction;
   reconstruction.Read(input_path);
 
-  StringToLower(&output_type);
   if (output_type == "bin") {
     reconstruction.WriteBinary(output_path);
+  } else if (output_type == "cbin") {
+    reconstruction.WriteChunked(output_path);
   } else if (output_type == "txt") {
     reconstruction.WriteText(output_path);
   } else if (output_type == "nvm") {
@@ -618,6 +648,9 @@ int RunModelConverter(int argc, char** argv) {
     ExportCam(reconstruction, output_path, skip_distortion);
   } else if (output_type == "ply") {
     ExportPLY(reconstruction, output_path);
+  } else if (output_type == "ply_octree") {
+    CreateDirIfNotExists(output_path);
+    ExportPLYOctree(reconstruction, output_path, octree_options);
   } else if (output_type == "vrml") {
     const auto base_path = output_path.substr(0, output_path.find_last_of('.'));
     ExportVRML(reconstruction,
@@ -667,8 +700,15 @@ int RunModelCropper(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  // Binary reconstructions are cropped while streaming them from disk, unless
+  // they are cropped in place.
+  const bool is_streamed =
+      IsBinaryReconstruction(input_path) &&
+      !boost::filesystem::equivalent(input_path, output_path);
   Reconstruction reconstruction;
-  reconstruction.Read(input_path);
+  if (!is_streamed) {
+    reconstruction.Read(input_path);
+  }
 
   PrintHeading2("Calculating boundary coordinates");
   std::pair<Eigen::Vector3d, Eigen::Vector3d> bounding_box;
@@ -695,13 +735,22 @@ int RunModelCropper(int argc, char** argv) {
                : Eigen::Vector3d(boundary_elements[3],
                                  boundary_elements[4],
                                  boundary_elements[5]);
+  } else if (is_streamed) {
+    bounding_box = ComputePoints3DBoundingBoxBinary(
+        JoinPaths(input_path, "points3D.bin"),
+        boundary_elements[0],
+        boundary_elements[1]);
   } else {
     bounding_box = reconstruction.ComputeBoundingBox(boundary_elements[0],
                                                      boundary_elements[1]);
   }
 
   PrintHeading2("Cropping reconstruction");
-  reconstruction.Crop(bounding_box).Write(output_path);
+  if (is_streamed) {
+    CropReconstructionBinary(input_path, {bounding_box}, {output_path});
+  } else {
+    reconstruction.Crop(bounding_box).Write(output_path);
+  }
   WriteBoundingBox(output_path, bounding_box);
 
   LOG(INFO) << "=> Cropping succeeded";
@@ -886,8 +935,22 @@ int RunModelSplitter(int argc, char** argv) {
   PrintHeading1("Splitting sparse model");
   LOG(INFO) << StringPrintf("=> Using \"%s\" split type", split_type.c_str());
 
+  // Binary reconstructions are split while streaming them from disk, so that
+  // the memory does not scale with the size of the reconstruction.
+  const bool is_streamed = IsBinaryReconstruction(input_path);
   Reconstruction reconstruction;
-  reconstruction.Read(input_path);
+  if (!is_streamed) {
+    reconstruction.Read(input_path);
+  }
+
+  auto ComputeBoundingBox = [&]() {
+    if (is_streamed) {
+      return ComputePoints3DBoundingBoxBinary(
+          JoinPaths(input_path, "points3D.bin"), 0.0, 1.0, num_threads);
+    } else {
+      return reconstruction.ComputeBoundingBox();
+    }
+  };
 
   Sim3d tform;
   if (!gps_transform_path.empty()) {
@@ -932,14 +995,14 @@ int RunModelSplitter(int argc, char** argv) {
       extent(i) = parts[i] * tform.scale;
     }
 
-    const auto bbox = reconstruction.ComputeBoundingBox();
+    const auto bbox = ComputeBoundingBox();
     const Eigen::Vector3d full_extent = bbox.second - bbox.first;
     const Eigen::Vector3i split(
         static_cast<int>(full_extent(0) / extent(0)) + 1,
         static_cast<int>(full_extent(1) / extent(1)) + 1,
         static_cast<int>(full_extent(2) / extent(2)) + 1);
 
-    exact_bounds = ComputeEqualPartsBounds(reconstruction, split);
+    exact_bounds = ComputeEqualPartsBounds(bbox, split);
 
   } else if (split_type == "parts") {
     auto parts = CSVToVector<int>(split_params);
@@ -951,7 +1014,7 @@ int RunModelSplitter(int argc, char** argv) {
         return EXIT_FAILURE;
       }
     }
-    exact_bounds = ComputeEqualPartsBounds(reconstruction, split);
+    exact_bounds = ComputeEqualPartsBounds(ComputeBoundingBox(), split);
   } else {
     LOG(ERROR) << "Invalid split type: " << split_type;
     return EXIT_FAILURE;
@@ -970,52 +1033,75 @@ int RunModelSplitter(int argc, char** argv) {
 
   const bool use_tile_keys = split_type == "tiles";
 
-  auto SplitReconstruction = [&](const int idx) {
-    Reconstruction tile_recon = reconstruction.Crop(bounds[idx]);
+  std::vector<std::string> tile_paths;
+  tile_paths.reserve(num_parts);
+  for (size_t idx = 0; idx < num_parts; ++idx) {
+    tile_paths.push_back(JoinPaths(
+        output_path, use_tile_keys ? tile_keys[idx] : std::to_string(idx)));
+  }
+
+  auto IncludeTile = [&](const int idx,
+                         const CroppedReconstructionSummary& summary) {
     // calculate area covered by model as proportion of box area
     auto bbox_extent = bounds[idx].second - bounds[idx].first;
-    auto model_bbox = tile_recon.ComputeBoundingBox();
-    auto model_extent = model_bbox.second - model_bbox.first;
+    auto model_extent = summary.bbox.second - summary.bbox.first;
     double area_ratio =
         (model_extent(0) * model_extent(1)) / (bbox_extent(0) * bbox_extent(1));
-    int tile_num_points = tile_recon.NumPoints3D();
 
     std::string name = use_tile_keys ? tile_keys[idx] : std::to_string(idx);
     const bool include_tile =
-        area_ratio >= min_area_ratio &&       //
-        tile_num_points >= min_num_points &&  //
-        tile_recon.NumRegImages() >= static_cast<size_t>(min_reg_images);
-
-    if (include_tile) {
-      LOG(INFO) << StringPrintf(
-          "Writing reconstruction %s with %d images, %d points, "
-          "and %.2f%% area coverage",
-          name.c_str(),
-          tile_recon.NumRegImages(),
-          tile_num_points,
-          100.0 * area_ratio);
-      const std::string reconstruction_path = JoinPaths(output_path, name);
-      CreateDirIfNotExists(reconstruction_path);
-      tile_recon.Write(reconstruction_path);
-      WriteBoundingBox(reconstruction_path, bounds[idx]);
-      WriteBoundingBox(reconstruction_path, exact_bounds[idx], "_exact");
+        area_ratio >= min_area_ratio &&  //
+        summary.num_points3D >= static_cast<size_t>(min_num_points) &&
+        summary.num_reg_images >= static_cast<size_t>(min_reg_images);
+
+    LOG(INFO) << StringPrintf(
+        "%s reconstruction %s with %d images, %d points, "
+        "and %.2f%% area coverage",
+        include_tile ? "Writing" : "Skipping",
+        name.c_str(),
+        summary.num_reg_images,
+        summary.num_points3D,
+        100.0 * area_ratio);
+    return include_tile;
+  };
 
-    } else {
-      LOG(INFO) << StringPrintf(
-          "Skipping reconstruction %s with %d images, %d points, "
-          "and %.2f%% area coverage",
-          name.c_str(),
-          tile_recon.NumRegImages(),
-          tile_num_points,
-          100.0 * area_ratio);
+  if (is_streamed) {
+    // All tiles are cropped in one pass over the reconstruction and skipped
+    // tiles are removed afterwards.
+    for (const std::string& tile_path : tile_paths) {
+      CreateDirIfNotExists(tile_path);
     }
-  };
+    const std::vector<CroppedReconstructionSummary> summaries =
+        CropReconstructionBinary(input_path, bounds, tile_paths, num_threads);
+    for (size_t idx = 0; idx < num_parts; ++idx) {
+      if (IncludeTile(idx, summaries[idx])) {
+        WriteBoundingBox(tile_paths[idx], bounds[idx]);
+        WriteBoundingBox(tile_paths[idx], exact_bounds[idx], "_exact");
+      } else {
+        boost::filesystem::remove_all(tile_paths[idx]);
+      }
+    }
+  } else {
+    auto SplitReconstruction = [&](const int idx) {
+      Reconstruction tile_recon = reconstruction.Crop(bounds[idx]);
+      CroppedReconstructionSummary summary;
+      summary.num_reg_images = tile_recon.NumRegImages();
+      summary.num_points3D = tile_recon.NumPoints3D();
+      summary.bbox = tile_recon.ComputeBoundingBox();
+      if (IncludeTile(idx, summary)) {
+        CreateDirIfNotExists(tile_paths[idx]);
+        tile_recon.Write(tile_paths[idx]);
+        WriteBoundingBox(tile_paths[idx], bounds[idx]);
+        WriteBoundingBox(tile_paths[idx], exact_bounds[idx], "_exact");
+      }
+    };
 
-  ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
-  for (size_t idx = 0; idx < num_parts; ++idx) {
-    thread_pool.AddTask(SplitReconstruction, idx);
+    ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
+    for (size_t idx = 0; idx < num_parts; ++idx) {
+      thread_pool.AddTask(SplitReconstruction, idx);
+    }
+    thread_pool.Wait();
   }
-  thread_pool.Wait();
 
   timer.PrintMinutes();
   return EXIT_SUCCESS;
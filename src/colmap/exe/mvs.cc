@@ -29,6 +29,7 @@
 
 #include "colmap/exe/mvs.h"
 
+#include "colmap/controllers/mvs_jobs.h"
 #include "colmap/controllers/option_manager.h"
 #include "colmap/mvs/fusion.h"
 #include "colmap/mvs/meshing.h"
@@ -75,6 +76,76 @@ int RunDelaunayMesher(int argc, char** argv) {
 #endif  // COLMAP_CGAL_ENABLED
 }
 
+int RunMVSJobCreator(int argc, char** argv) {
+  std::string workspace_path;
+  std::string jobs_path;
+  std::string bbox_path;
+  int num_problems_per_job = 10;
+
+  OptionManager options;
+  options.AddRequiredOption(
+      "workspace_path",
+      &workspace_path,
+      "Path to the COLMAP workspace folder of the undistorted images");
+  options.AddRequiredOption("jobs_path", &jobs_path);
+  options.AddDefaultOption("bbox_path", &bbox_path);
+  options.AddDefaultOption("num_problems_per_job", &num_problems_per_job);
+  options.AddPatchMatchStereoOptions();
+  options.AddStereoFusionOptions();
+  options.Parse(argc, argv);
+
+  if (num_problems_per_job <= 0) {
+    LOG(ERROR) << "`num_problems_per_job` must be positive.";
+    return EXIT_FAILURE;
+  }
+
+  if (!bbox_path.empty()) {
+    std::ifstream file(bbox_path);
+    if (file.is_open()) {
+      auto& min_bound = options.stereo_fusion->bounding_box.first;
+      auto& max_bound = options.stereo_fusion->bounding_box.second;
+      file >> min_bound(0) >> min_bound(1) >> min_bound(2);
+      file >> max_bound(0) >> max_bound(1) >> max_bound(2);
+    } else {
+      LOG(WARNING) << "Invalid bounds path: \"" << bbox_path
+                   << "\" - continuing without bounds check";
+    }
+  }
+
+  CreateMVSJobs(jobs_path,
+                workspace_path,
+                *options.patch_match_stereo,
+                *options.stereo_fusion,
+                num_problems_per_job);
+
+  return EXIT_SUCCESS;
+}
+
+int RunMVSJobWorker(int argc, char** argv) {
+  std::string jobs_path;
+  int max_num_jobs = -1;
+
+  OptionManager options;
+  options.AddRequiredOption("jobs_path", &jobs_path);
+  options.AddDefaultOption("max_num_jobs", &max_num_jobs);
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(jobs_path)) {
+    LOG(ERROR) << "`jobs_path` is not a directory.";
+    return EXIT_FAILURE;
+  }
+
+  int num_jobs = 0;
+  while ((max_num_jobs < 0 || num_jobs < max_num_jobs) &&
+         RunNextMVSJob(jobs_path)) {
+    num_jobs += 1;
+  }
+
+  LOG(INFO) << "Ran " << num_jobs << " MVS jobs";
+
+  return EXIT_SUCCESS;
+}
+
 int RunPatchMatchStereo(int argc, char** argv) {
 #if !defined(COLMAP_CUDA_ENABLED)
   LOG(ERROR) << "Dense stereo reconstruction requires CUDA, which is not "
@@ -117,6 +188,23 @@ int RunPatchMatchStereo(int argc, char** argv) {
 #endif  // COLMAP_CUDA_ENABLED
 }
 
+int RunPointCloudDownsampler(int argc, char** argv) {
+  std::string input_path;
+  std::string output_path;
+  mvs::PointCloudDownsamplingOptions downsampling_options;
+
+  OptionManager options;
+  options.AddRequiredOption("input_path", &input_path);
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("voxel_size", &downsampling_options.voxel_size);
+  options.AddDefaultOption("num_threads", &downsampling_options.num_threads);
+  options.Parse(argc, argv);
+
+  mvs::DownsamplePointCloud(downsampling_options, input_path, output_path);
+
+  return EXIT_SUCCESS;
+}
+
 int RunPoissonMesher(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
@@ -182,12 +270,30 @@ int RunStereoFuser(int argc, char** argv) {
     }
   }
 
+  StringToLower(&output_type);
+  if (output_type != "bin" && output_type != "txt" && output_type != "ply") {
+    LOG(ERROR) << "Invalid `output_type`";
+    return EXIT_FAILURE;
+  }
+  if (options.stereo_fusion->max_num_tile_images > 0 && output_type != "ply") {
+    LOG(ERROR) << "Tiled fusion only supports the PLY output type.";
+    return EXIT_FAILURE;
+  }
+
   mvs::StereoFusion fuser(*options.stereo_fusion,
                           workspace_path,
                           workspace_format,
                           pmvs_option_name,
                           input_type);
 
+  // The fused points are directly streamed to the PLY output.
+  if (output_type == "ply") {
+    LOG(INFO) << "Writing output: " << output_path;
+    fuser.SetOutputPath(output_path);
+    fuser.Run();
+    return EXIT_SUCCESS;
+  }
+
   fuser.Run();
 
   Reconstruction reconstruction;
@@ -203,18 +309,10 @@ int RunStereoFuser(int argc, char** argv) {
   LOG(INFO) << "Writing output: " << output_path;
 
   // write output
-  StringToLower(&output_type);
   if (output_type == "bin") {
     reconstruction.WriteBinary(output_path);
-  } else if (output_type == "txt") {
-    reconstruction.WriteText(output_path);
-  } else if (output_type == "ply") {
-    WriteBinaryPlyPoints(output_path, fuser.GetFusedPoints());
-    mvs::WritePointsVisibility(output_path + ".vis",
-                               fuser.GetFusedPointsVisibility());
   } else {
-    LOG(ERROR) << "Invalid `output_type`";
-    return EXIT_FAILURE;
+    reconstruction.WriteText(output_path);
   }
 
   return EXIT_SUCCESS;
@@ -30,7 +30,10 @@
 namespace colmap {
 
 int RunDelaunayMesher(int argc, char** argv);
+int RunMVSJobCreator(int argc, char** argv);
+int RunMVSJobWorker(int argc, char** argv);
 int RunPatchMatchStereo(int argc, char** argv);
+int RunPointCloudDownsampler(int argc, char** argv);
 int RunPoissonMesher(int argc, char** argv);
 int RunStereoFuser(int argc, char** argv);
 
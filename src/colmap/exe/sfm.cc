@@ -31,6 +31,7 @@
 
 #include "colmap/controllers/automatic_reconstruction.h"
 #include "colmap/controllers/bundle_adjustment.h"
+#include "colmap/controllers/global_mapper.h"
 #include "colmap/controllers/hierarchical_mapper.h"
 #include "colmap/controllers/option_manager.h"
 #include "colmap/estimators/similarity_transform.h"
@@ -69,6 +70,7 @@ int RunAutomaticReconstructor(int argc, char** argv) {
                            &reconstruction_options.camera_params);
   options.AddDefaultOption("sparse", &reconstruction_options.sparse);
   options.AddDefaultOption("dense", &reconstruction_options.dense);
+  options.AddDefaultOption("streaming", &reconstruction_options.streaming);
   options.AddDefaultOption("mesher", &mesher, "{poisson, delaunay}");
   options.AddDefaultOption("num_threads", &reconstruction_options.num_threads);
   options.AddDefaultOption("use_gpu", &reconstruction_options.use_gpu);
@@ -168,25 +170,225 @@ int RunBundleAdjuster(int argc, char** argv) {
 int RunColorExtractor(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
+  int num_threads = -1;
+  int min_image_size = -1;
 
   OptionManager options;
   options.AddImageOptions();
   options.AddDefaultOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("num_threads", &num_threads);
+  options.AddDefaultOption("min_image_size", &min_image_size);
   options.Parse(argc, argv);
 
   Reconstruction reconstruction;
   reconstruction.Read(input_path);
-  reconstruction.ExtractColorsForAllImages(*options.image_path);
+  reconstruction.ExtractColorsForAllImages(
+      *options.image_path, num_threads, min_image_size);
   reconstruction.Write(output_path);
 
   return EXIT_SUCCESS;
 }
 
+namespace {
+
+// Read the configuration of the camera rigs from a JSON file. The input images
+// of a camera rig must be named consistently to assign them to the appropriate
+// camera rig and the respective snapshots.
+//
+// An example configuration of a single camera rig:
+// [
+//   {
+//     "ref_camera_id": 1,
+//     "cameras":
+//     [
+//       {
+//           "camera_id": 1,
+//           "image_prefix": "left1_image"
+//           "cam_from_rig_rotation": [1, 0, 0, 0],
+//           "cam_from_rig_translation": [0, 0, 0]
+//       },
+//       {
+//           "camera_id": 2,
+//           "image_prefix": "left2_image"
+//           "cam_from_rig_rotation": [1, 0, 0, 0],
+//           "cam_from_rig_translation": [0, 0, 1]
+//       },
+//       {
+//           "camera_id": 3,
+//           "image_prefix": "right1_image"
+//           "cam_from_rig_rotation": [1, 0, 0, 0],
+//           "cam_from_rig_translation": [0, 0, 2]
+//       },
+//       {
+//           "camera_id": 4,
+//           "image_prefix": "right2_image"
+//           "cam_from_rig_rotation": [1, 0, 0, 0],
+//           "cam_from_rig_translation": [0, 0, 3]
+//       }
+//     ]
+//   }
+// ]
+//
+// The "camera_id" and "image_prefix" fields are required, whereas the
+// "cam_from_rig_rotation" and "cam_from_rig_translation" fields optionally
+// specify the relative extrinsics of the camera rig in the form of a
+// translation vector and a rotation quaternion (w, x, y, z). If the relative
+// extrinsics are not provided then they are automatically inferred from the
+// reconstruction.
+//
+// This file specifies the configuration for a single camera rig and that you
+// could potentially define multiple camera rigs. The rig is composed of 4
+// cameras: all images of the first camera must have "left1_image" as a name
+// prefix, e.g., "left1_image_frame000.png" or "left1_image/frame000.png".
+// Images with the same suffix ("_frame000.png" and "/frame000.png") are
+// assigned to the same snapshot, i.e., they are assumed to be captured at the
+// same time. Only snapshots with the reference image registered will be added
+// to the bundle adjustment problem. The remaining images will be added with
+// independent poses to the bundle adjustment problem. If all images of the
+// reconstruction are considered, e.g., to register the snapshots jointly in
+// the mapper, the relative extrinsics must be provided. The above configuration
+// could have the following input image file structure:
+//
+//    /path/to/images/...
+//        left1_image/...
+//            frame000.png
+//            frame001.png
+//            frame002.png
+//            ...
+//        left2_image/...
+//            frame000.png
+//            frame001.png
+//            frame002.png
+//            ...
+//        right1_image/...
+//            frame000.png
+//            frame001.png
+//            frame002.png
+//            ...
+//        right2_image/...
+//            frame000.png
+//            frame001.png
+//            frame002.png
+//            ...
+//
+std::vector<CameraRig> ReadCameraRigConfig(
+    const std::string& rig_config_path,
+    const Reconstruction& reconstruction,
+    bool estimate_rig_relative_poses,
+    const bool only_registered_images = true) {
+  std::vector<image_t> image_ids;
+  if (only_registered_images) {
+    image_ids = reconstruction.RegImageIds();
+  } else {
+    image_ids.reserve(reconstruction.NumImages());
+    for (const auto& image : reconstruction.Images()) {
+      image_ids.push_back(image.first);
+    }
+    std::sort(image_ids.begin(), image_ids.end());
+  }
+
+  boost::property_tree::ptree pt;
+  boost::property_tree::read_json(rig_config_path.c_str(), pt);
+
+  std::vector<CameraRig> camera_rigs;
+  for (const auto& rig_config : pt) {
+    CameraRig camera_rig;
+
+    std::vector<std::string> image_prefixes;
+    for (const auto& camera : rig_config.second.get_child("cameras")) {
+      const int camera_id = camera.second.get<int>("camera_id");
+      image_prefixes.push_back(camera.second.get<std::string>("image_prefix"));
+
+      Rigid3d cam_from_rig;
+
+      auto cam_from_rig_rotation_node =
+          camera.second.get_child_optional("cam_from_rig_rotation");
+      if (cam_from_rig_rotation_node) {
+        int index = 0;
+        Eigen::Vector4d cam_from_rig_wxyz;
+        for (const auto& node : cam_from_rig_rotation_node.get()) {
+          cam_from_rig_wxyz[index++] = node.second.get_value<double>();
+        }
+        cam_from_rig.rotation = Eigen::Quaterniond(cam_from_rig_wxyz(0),
+                                                   cam_from_rig_wxyz(1),
+                                                   cam_from_rig_wxyz(2),
+                                                   cam_from_rig_wxyz(3));
+      } else {
+        estimate_rig_relative_poses = true;
+      }
+
+      auto cam_from_rig_translation_node =
+          camera.second.get_child_optional("cam_from_rig_translation");
+      if (cam_from_rig_translation_node) {
+        int index = 0;
+        for (const auto& node : cam_from_rig_translation_node.get()) {
+          cam_from_rig.translation(index++) = node.second.get_value<double>();
+        }
+      } else {
+        estimate_rig_relative_poses = true;
+      }
+
+      camera_rig.AddCamera(camera_id, cam_from_rig);
+    }
+
+    camera_rig.SetRefCameraId(rig_config.second.get<int>("ref_camera_id"));
+
+    std::unordered_map<std::string, std::vector<image_t>> snapshots;
+    for (const auto image_id : image_ids) {
+      const auto& image = reconstruction.Image(image_id);
+      for (const auto& image_prefix : image_prefixes) {
+        if (StringContains(image.Name(), image_prefix)) {
+          const std::string image_suffix =
+              StringGetAfter(image.Name(), image_prefix);
+          snapshots[image_suffix].push_back(image_id);
+        }
+      }
+    }
+
+    for (const auto& snapshot : snapshots) {
+      bool has_ref_camera = false;
+      for (const auto image_id : snapshot.second) {
+        const auto& image = reconstruction.Image(image_id);
+        if (image.CameraId() == camera_rig.RefCameraId()) {
+          has_ref_camera = true;
+          break;
+        }
+      }
+
+      if (has_ref_camera) {
+        camera_rig.AddSnapshot(snapshot.second);
+      }
+    }
+
+    camera_rig.Check(reconstruction);
+    if (estimate_rig_relative_poses) {
+      if (!only_registered_images) {
+        LOG(ERROR) << "The relative rig poses cannot be estimated from "
+                      "unregistered images";
+        return std::vector<CameraRig>();
+      }
+      PrintHeading2("Estimating relative rig poses");
+      if (!camera_rig.ComputeCamsFromRigs(reconstruction)) {
+        LOG(WARNING) << "Failed to estimate rig poses from reconstruction; "
+                        "cannot use rig BA";
+        return std::vector<CameraRig>();
+      }
+    }
+
+    camera_rigs.push_back(camera_rig);
+  }
+
+  return camera_rigs;
+}
+
+}  // namespace
+
 int RunMapper(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
   std::string image_list_path;
+  std::string rig_config_path;
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -194,6 +396,7 @@ int RunMapper(int argc, char** argv) {
   options.AddDefaultOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("image_list_path", &image_list_path);
+  options.AddDefaultOption("rig_config_path", &rig_config_path);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -239,6 +442,31 @@ int RunMapper(int argc, char** argv) {
                                      *options.database_path,
                                      reconstruction_manager);
 
+  // The snapshots of camera rigs are registered jointly, for which the rig
+  // configuration is read for all images in the database.
+  if (!rig_config_path.empty()) {
+    Reconstruction database_reconstruction;
+    {
+      const Database database(*options.database_path);
+      for (auto& camera : database.ReadAllCameras()) {
+        database_reconstruction.AddCamera(std::move(camera));
+      }
+      for (auto& image : database.ReadAllImages()) {
+        database_reconstruction.AddImage(std::move(image));
+      }
+    }
+    std::vector<CameraRig> camera_rigs =
+        ReadCameraRigConfig(rig_config_path,
+                            database_reconstruction,
+                            /*estimate_rig_relative_poses=*/false,
+                            /*only_registered_images=*/false);
+    if (camera_rigs.empty()) {
+      LOG(ERROR) << "Failed to read the camera rig configuration.";
+      return EXIT_FAILURE;
+    }
+    mapper.SetCameraRigs(std::move(camera_rigs));
+  }
+
   // In case a new reconstruction is started, write results of individual sub-
   // models to as their reconstruction finishes instead of writing all results
   // after all reconstructions finished.
@@ -301,9 +529,55 @@ int RunMapper(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunGlobalMapper(int argc, char** argv) {
+  GlobalMapperController::Options mapper_options;
+  std::string output_path;
+
+  OptionManager options;
+  options.AddRequiredOption("database_path", &mapper_options.database_path);
+  options.AddRequiredOption("image_path", &mapper_options.image_path);
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("min_num_inliers",
+                           &mapper_options.global_options.min_num_inliers);
+  options.AddDefaultOption("min_tri_angle",
+                           &mapper_options.global_options.min_tri_angle);
+  options.AddDefaultOption("rotation_loss_scale",
+                           &mapper_options.global_options.rotation_loss_scale);
+  options.AddDefaultOption("max_rotation_error",
+                           &mapper_options.global_options.max_rotation_error);
+  options.AddDefaultOption("position_loss_scale",
+                           &mapper_options.global_options.position_loss_scale);
+  options.AddDefaultOption("max_num_iterations",
+                           &mapper_options.global_options.max_num_iterations);
+  options.AddMapperOptions();
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(output_path)) {
+    LOG(ERROR) << "`output_path` is not a directory.";
+    return EXIT_FAILURE;
+  }
+
+  mapper_options.incremental_options = *options.mapper;
+  mapper_options.global_options.num_threads = options.mapper->num_threads;
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  GlobalMapperController global_mapper(mapper_options, reconstruction_manager);
+  global_mapper.Run();
+
+  if (reconstruction_manager->Size() == 0) {
+    LOG(ERROR) << "failed to create sparse model";
+    return EXIT_FAILURE;
+  }
+
+  reconstruction_manager->Write(output_path);
+  options.Write(JoinPaths(output_path, "project.ini"));
+
+  return EXIT_SUCCESS;
+}
+
 int RunHierarchicalMapper(int argc, char** argv) {
   HierarchicalMapperController::Options mapper_options;
   std::string output_path;
+  std::string partitioner = "normalized_cut";
 
   OptionManager options;
   options.AddRequiredOption("database_path", &mapper_options.database_path);
@@ -315,6 +589,17 @@ int RunHierarchicalMapper(int argc, char** argv) {
   options.AddDefaultOption(
       "leaf_max_num_images",
       &mapper_options.clustering_options.leaf_max_num_images);
+  options.AddDefaultOption(
+      "partitioner", &partitioner, "{normalized_cut, multilevel}");
+  options.AddDefaultOption("final_ba", &mapper_options.final_ba);
+  options.AddDefaultOption("cluster_jobs_path",
+                           &mapper_options.cluster_jobs_path);
+  options.AddDefaultOption(
+      "final_ba_partition_max_num_images",
+      &mapper_options.final_ba_partition_options.max_num_images);
+  options.AddDefaultOption(
+      "final_ba_partition_max_num_iterations",
+      &mapper_options.final_ba_partition_options.max_num_iterations);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -323,6 +608,19 @@ int RunHierarchicalMapper(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  StringToLower(&partitioner);
+  if (partitioner == "normalized_cut") {
+    mapper_options.clustering_options.partitioner =
+        SceneClustering::Partitioner::NORMALIZED_CUT;
+  } else if (partitioner == "multilevel") {
+    mapper_options.clustering_options.partitioner =
+        SceneClustering::Partitioner::MULTILEVEL;
+  } else {
+    LOG(ERROR) << "Invalid partitioner - "
+                  "supported values are 'normalized_cut' and 'multilevel'.";
+    return EXIT_FAILURE;
+  }
+
   mapper_options.incremental_options = *options.mapper;
   auto reconstruction_manager = std::make_shared<ReconstructionManager>();
   HierarchicalMapperController hierarchical_mapper(mapper_options,
@@ -340,6 +638,31 @@ int RunHierarchicalMapper(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunHierarchicalMapperWorker(int argc, char** argv) {
+  std::string cluster_jobs_path;
+  int num_threads = -1;
+
+  OptionManager options;
+  options.AddRequiredOption("cluster_jobs_path", &cluster_jobs_path);
+  options.AddDefaultOption("num_threads", &num_threads);
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(cluster_jobs_path)) {
+    LOG(ERROR) << "`cluster_jobs_path` is not a directory.";
+    return EXIT_FAILURE;
+  }
+
+  size_t num_jobs = 0;
+  while (ReconstructNextHierarchicalMapperClusterJob(cluster_jobs_path,
+                                                     num_threads)) {
+    num_jobs += 1;
+  }
+
+  LOG(INFO) << "Reconstructed " << num_jobs << " cluster jobs";
+
+  return EXIT_SUCCESS;
+}
+
 int RunPointFiltering(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
@@ -455,180 +778,6 @@ void RunPointTriangulatorImpl(
   reconstruction->Write(output_path);
 }
 
-namespace {
-
-// Read the configuration of the camera rigs from a JSON file. The input images
-// of a camera rig must be named consistently to assign them to the appropriate
-// camera rig and the respective snapshots.
-//
-// An example configuration of a single camera rig:
-// [
-//   {
-//     "ref_camera_id": 1,
-//     "cameras":
-//     [
-//       {
-//           "camera_id": 1,
-//           "image_prefix": "left1_image"
-//           "cam_from_rig_rotation": [1, 0, 0, 0],
-//           "cam_from_rig_translation": [0, 0, 0]
-//       },
-//       {
-//           "camera_id": 2,
-//           "image_prefix": "left2_image"
-//           "cam_from_rig_rotation": [1, 0, 0, 0],
-//           "cam_from_rig_translation": [0, 0, 1]
-//       },
-//       {
-//           "camera_id": 3,
-//           "image_prefix": "right1_image"
-//           "cam_from_rig_rotation": [1, 0, 0, 0],
-//           "cam_from_rig_translation": [0, 0, 2]
-//       },
-//       {
-//           "camera_id": 4,
-//           "image_prefix": "right2_image"
-//           "cam_from_rig_rotation": [1, 0, 0, 0],
-//           "cam_from_rig_translation": [0, 0, 3]
-//       }
-//     ]
-//   }
-// ]
-//
-// The "camera_id" and "image_prefix" fields are required, whereas the
-// "cam_from_rig_rotation" and "cam_from_rig_translation" fields optionally
-// specify the relative extrinsics of the camera rig in the form of a
-// translation vector and a rotation quaternion (w, x, y, z). If the relative
-// extrinsics are not provided then they are automatically inferred from the
-// reconstruction.
-//
-// This file specifies the configuration for a single camera rig and that you
-// could potentially define multiple camera rigs. The rig is composed of 4
-// cameras: all images of the first camera must have "left1_image" as a name
-// prefix, e.g., "left1_image_frame000.png" or "left1_image/frame000.png".
-// Images with the same suffix ("_frame000.png" and "/frame000.png") are
-// assigned to the same snapshot, i.e., they are assumed to be captured at the
-// same time. Only snapshots with the reference image registered will be added
-// to the bundle adjustment problem. The remaining images will be added with
-// independent poses to the bundle adjustment problem. The above configuration
-// could have the following input image file structure:
-//
-//    /path/to/images/...
-//        left1_image/...
-//            frame000.png
-//            frame001.png
-//            frame002.png
-//            ...
-//        left2_image/...
-//            frame000.png
-//            frame001.png
-//            frame002.png
-//            ...
-//        right1_image/...
-//            frame000.png
-//            frame001.png
-//            frame002.png
-//            ...
-//        right2_image/...
-//            frame000.png
-//            frame001.png
-//            frame002.png
-//            ...
-//
-std::vector<CameraRig> ReadCameraRigConfig(const std::string& rig_config_path,
-                                           const Reconstruction& reconstruction,
-                                           bool estimate_rig_relative_poses) {
-  boost::property_tree::ptree pt;
-  boost::property_tree::read_json(rig_config_path.c_str(), pt);
-
-  std::vector<CameraRig> camera_rigs;
-  for (const auto& rig_config : pt) {
-    CameraRig camera_rig;
-
-    std::vector<std::string> image_prefixes;
-    for (const auto& camera : rig_config.second.get_child("cameras")) {
-      const int camera_id = camera.second.get<int>("camera_id");
-      image_prefixes.push_back(camera.second.get<std::string>("image_prefix"));
-
-      Rigid3d cam_from_rig;
-
-      auto cam_from_rig_rotation_node =
-          camera.second.get_child_optional("cam_from_rig_rotation");
-      if (cam_from_rig_rotation_node) {
-        int index = 0;
-        Eigen::Vector4d cam_from_rig_wxyz;
-        for (const auto& node : cam_from_rig_rotation_node.get()) {
-          cam_from_rig_wxyz[index++] = node.second.get_value<double>();
-        }
-        cam_from_rig.rotation = Eigen::Quaterniond(cam_from_rig_wxyz(0),
-                                                   cam_from_rig_wxyz(1),
-                                                   cam_from_rig_wxyz(2),
-                                                   cam_from_rig_wxyz(3));
-      } else {
-        estimate_rig_relative_poses = true;
-      }
-
-      auto cam_from_rig_translation_node =
-          camera.second.get_child_optional("cam_from_rig_translation");
-      if (cam_from_rig_translation_node) {
-        int index = 0;
-        for (const auto& node : cam_from_rig_translation_node.get()) {
-          cam_from_rig.translation(index++) = node.second.get_value<double>();
-        }
-      } else {
-        estimate_rig_relative_poses = true;
-      }
-
-      camera_rig.AddCamera(camera_id, cam_from_rig);
-    }
-
-    camera_rig.SetRefCameraId(rig_config.second.get<int>("ref_camera_id"));
-
-    std::unordered_map<std::string, std::vector<image_t>> snapshots;
-    for (const auto image_id : reconstruction.RegImageIds()) {
-      const auto& image = reconstruction.Image(image_id);
-      for (const auto& image_prefix : image_prefixes) {
-        if (StringContains(image.Name(), image_prefix)) {
-          const std::string image_suffix =
-              StringGetAfter(image.Name(), image_prefix);
-          snapshots[image_suffix].push_back(image_id);
-        }
-      }
-    }
-
-    for (const auto& snapshot : snapshots) {
-      bool has_ref_camera = false;
-      for (const auto image_id : snapshot.second) {
-        const auto& image = reconstruction.Image(image_id);
-        if (image.CameraId() == camera_rig.RefCameraId()) {
-          has_ref_camera = true;
-          break;
-        }
-      }
-
-      if (has_ref_camera) {
-        camera_rig.AddSnapshot(snapshot.second);
-      }
-    }
-
-    camera_rig.Check(reconstruction);
-    if (estimate_rig_relative_poses) {
-      PrintHeading2("Estimating relative rig poses");
-      if (!camera_rig.ComputeCamsFromRigs(reconstruction)) {
-        LOG(WARNING) << "Failed to estimate rig poses from reconstruction; "
-                        "cannot use rig BA";
-        return std::vector<CameraRig>();
-      }
-    }
-
-    camera_rigs.push_back(camera_rig);
-  }
-
-  return camera_rigs;
-}
-
-}  // namespace
-
 int RunRigBundleAdjuster(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
@@ -47,7 +47,9 @@ int RunAutomaticReconstructor(int argc, char** argv);
 int RunBundleAdjuster(int argc, char** argv);
 int RunColorExtractor(int argc, char** argv);
 int RunMapper(int argc, char** argv);
+int RunGlobalMapper(int argc, char** argv);
 int RunHierarchicalMapper(int argc, char** argv);
+int RunHierarchicalMapperWorker(int argc, char** argv);
 int RunPointFiltering(int argc, char** argv);
 int RunPointTriangulator(int argc, char** argv);
 int RunRigBundleAdjuster(int argc, char** argv);
@@ -34,12 +34,19 @@
 #include "colmap/feature/sift.h"
 #include "colmap/feature/utils.h"
 #include "colmap/optim/random_sampler.h"
+#include "colmap/retrieval/sharded_visual_index.h"
 #include "colmap/retrieval/visual_index.h"
 #include "colmap/scene/database.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
+#include "colmap/util/threading.h"
+#include "colmap/util/timer.h"
 
+#include <iostream>
+#include <mutex>
 #include <numeric>
+#include <sstream>
+#include <unordered_map>
 
 namespace colmap {
 namespace {
@@ -114,12 +121,100 @@ std::vector<Image> ReadVocabTreeRetrievalImageList(const std::string& path,
   return images;
 }
 
+// Answers the queries that are read line by line from the input stream until
+// the end of the stream, such that the visual index is only loaded once. Each
+// line is either the name of a database image or the path to a text file with
+// SIFT features (see LoadSiftFeaturesFromTextFile). The queries are answered
+// concurrently and, as soon as a query is answered, its results are written to
+// the output stream as one "<query> <image_name> <score>" line per retrieved
+// image followed by an empty line.
+void StreamVocabTreeQueries(
+    const retrieval::ShardedVisualIndex<>& visual_index,
+    const retrieval::VisualIndex<>::QueryOptions& query_options,
+    const int max_num_features,
+    const int num_threads,
+    const std::unordered_map<image_t, const Image*>& image_id_to_image,
+    Database* database,
+    std::istream& input,
+    std::ostream& output) {
+  ThreadPool thread_pool(num_threads);
+
+  // The queries are parallelized over the threads of the pool.
+  retrieval::VisualIndex<>::QueryOptions stream_query_options = query_options;
+  if (thread_pool.NumThreads() > 1) {
+    stream_query_options.num_threads = 1;
+  }
+
+  std::mutex database_mutex;
+  std::mutex output_mutex;
+
+  auto QueryLine = [&](const std::string& query) {
+    Timer timer;
+    timer.Start();
+
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+    bool valid_query = false;
+    {
+      std::lock_guard<std::mutex> lock(database_mutex);
+      if (database->ExistsImageWithName(query)) {
+        const image_t image_id = database->ReadImageWithName(query).ImageId();
+        keypoints = database->ReadKeypoints(image_id);
+        descriptors = database->ReadDescriptors(image_id);
+        valid_query = true;
+      }
+    }
+    if (!valid_query && ExistsFile(query)) {
+      LoadSiftFeaturesFromTextFile(query, &keypoints, &descriptors);
+      valid_query = true;
+    }
+
+    std::vector<retrieval::ImageScore> image_scores;
+    if (valid_query) {
+      if (max_num_features > 0 && descriptors.rows() > max_num_features) {
+        ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
+      }
+      visual_index.Query(
+          stream_query_options, keypoints, descriptors, &image_scores);
+    } else {
+      LOG(ERROR) << "Query " << query
+                 << " is neither a database image nor a features file";
+    }
+
+    std::ostringstream result;
+    for (const auto& image_score : image_scores) {
+      const auto image = image_id_to_image.find(image_score.image_id);
+      if (image != image_id_to_image.end()) {
+        result << query << " " << image->second->Name() << " "
+               << image_score.score << "\n";
+      }
+    }
+    result << "\n";
+
+    std::lock_guard<std::mutex> lock(output_mutex);
+    output << result.str() << std::flush;
+    LOG(INFO) << StringPrintf(
+        "Queried for %s in %.3fs", query.c_str(), timer.ElapsedSeconds());
+  };
+
+  std::string line;
+  while (std::getline(input, line)) {
+    StringTrim(&line);
+    if (!line.empty()) {
+      thread_pool.AddTask(QueryLine, line);
+    }
+  }
+
+  thread_pool.Wait();
+}
+
 }  // namespace
 
 int RunVocabTreeBuilder(int argc, char** argv) {
   std::string vocab_tree_path;
   retrieval::VisualIndex<>::BuildOptions build_options;
   int max_num_images = -1;
+  bool write_packed = false;
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -128,7 +223,14 @@ int RunVocabTreeBuilder(int argc, char** argv) {
   options.AddDefaultOption("num_checks", &build_options.num_checks);
   options.AddDefaultOption("branching", &build_options.branching);
   options.AddDefaultOption("num_iterations", &build_options.num_iterations);
+  options.AddDefaultOption("native_kmeans", &build_options.native_kmeans);
+  options.AddDefaultOption("kmeans_batch_size",
+                           &build_options.kmeans_batch_size);
+  options.AddDefaultOption(
+      "kmeans_max_num_descriptors_per_cluster",
+      &build_options.kmeans_max_num_descriptors_per_cluster);
   options.AddDefaultOption("max_num_images", &max_num_images);
+  options.AddDefaultOption("write_packed", &write_packed);
   options.Parse(argc, argv);
 
   LOG(INFO) << "Loading descriptors...";
@@ -146,7 +248,11 @@ int RunVocabTreeBuilder(int argc, char** argv) {
             << visual_index.NumVisualWords() << " visual words";
 
   LOG(INFO) << "Saving index to file...";
-  visual_index.Write(vocab_tree_path);
+  if (write_packed) {
+    visual_index.WritePacked(vocab_tree_path);
+  } else {
+    visual_index.Write(vocab_tree_path);
+  }
 
   return EXIT_SUCCESS;
 }
@@ -158,6 +264,12 @@ int RunVocabTreeRetriever(int argc, char** argv) {
   std::string output_index_path;
   retrieval::VisualIndex<>::QueryOptions query_options;
   int max_num_features = -1;
+  bool write_packed = false;
+  int num_images_per_shard = -1;
+  int shard_idx = -1;
+  std::string index_shard_paths;
+  bool stream_queries = false;
+  int num_threads = -1;
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -172,17 +284,36 @@ int RunVocabTreeRetriever(int argc, char** argv) {
   options.AddDefaultOption("num_images_after_verification",
                            &query_options.num_images_after_verification);
   options.AddDefaultOption("max_num_features", &max_num_features);
+  options.AddDefaultOption("write_packed", &write_packed);
+  options.AddDefaultOption("num_images_per_shard", &num_images_per_shard);
+  options.AddDefaultOption("shard_idx", &shard_idx);
+  options.AddDefaultOption("index_shard_paths", &index_shard_paths);
+  options.AddDefaultOption("stream_queries", &stream_queries);
+  options.AddDefaultOption("num_threads", &num_threads);
   options.Parse(argc, argv);
 
-  retrieval::VisualIndex<> visual_index;
-  visual_index.Read(vocab_tree_path);
+  auto visual_index = std::make_shared<retrieval::VisualIndex<>>();
+  visual_index->Read(vocab_tree_path);
+
+  // Previously built shards that are queried together with the new images.
+  retrieval::ShardedVisualIndex<> sharded_index(query_options.num_threads);
+  for (std::string shard_path : StringSplit(index_shard_paths, ",")) {
+    StringTrim(&shard_path);
+    if (shard_path.empty()) {
+      continue;
+    }
+    auto shard = std::make_shared<retrieval::VisualIndex<>>();
+    shard->Read(shard_path);
+    sharded_index.AddShard(std::move(shard));
+  }
 
   Database database(*options.database_path);
 
   const auto database_images =
       ReadVocabTreeRetrievalImageList(database_image_list_path, &database);
   const auto query_images =
-      (!query_image_list_path.empty() || output_index_path.empty())
+      (!query_image_list_path.empty() ||
+       (output_index_path.empty() && !stream_queries))
           ? ReadVocabTreeRetrievalImageList(query_image_list_path, &database)
           : std::vector<Image>();
 
@@ -198,34 +329,49 @@ int RunVocabTreeRetriever(int argc, char** argv) {
                      "Indexing image [%d/%d]", i + 1, database_images.size())
               << std::flush;
 
-    if (visual_index.ImageIndexed(database_images[i].ImageId())) {
+    const image_t image_id = database_images[i].ImageId();
+    if (visual_index->ImageIndexed(image_id) ||
+        sharded_index.ImageIndexed(image_id)) {
       continue;
     }
 
-    auto keypoints = database.ReadKeypoints(database_images[i].ImageId());
-    auto descriptors = database.ReadDescriptors(database_images[i].ImageId());
+    // Only index the images in the identifier range of the built shard.
+    if (num_images_per_shard > 0 && shard_idx >= 0 &&
+        retrieval::ImageIdToShardIdx(image_id, num_images_per_shard) !=
+            shard_idx) {
+      continue;
+    }
+
+    auto keypoints = database.ReadKeypoints(image_id);
+    auto descriptors = database.ReadDescriptors(image_id);
     if (max_num_features > 0 && descriptors.rows() > max_num_features) {
       ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
     }
 
-    visual_index.Add(retrieval::VisualIndex<>::IndexOptions(),
-                     database_images[i].ImageId(),
-                     keypoints,
-                     descriptors);
+    visual_index->Add(retrieval::VisualIndex<>::IndexOptions(),
+                      image_id,
+                      keypoints,
+                      descriptors);
 
     LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
   }
 
   // Compute the TF-IDF weights, etc.
-  visual_index.Prepare();
+  visual_index->Prepare();
 
   // Optionally save the indexing data for the database images (as well as the
   // original vocabulary tree data) to speed up future indexing.
   if (!output_index_path.empty()) {
-    visual_index.Write(output_index_path);
+    if (write_packed) {
+      visual_index->WritePacked(output_index_path);
+    } else {
+      visual_index->Write(output_index_path);
+    }
   }
 
-  if (query_images.empty()) {
+  sharded_index.AddShard(visual_index);
+
+  if (query_images.empty() && !stream_queries) {
     return EXIT_SUCCESS;
   }
 
@@ -233,9 +379,11 @@ int RunVocabTreeRetriever(int argc, char** argv) {
   // Perform image queries
   //////////////////////////////////////////////////////////////////////////////
 
+  // The shards may also contain images that are not in the database list.
+  const std::vector<Image> images = database.ReadAllImages();
   std::unordered_map<image_t, const Image*> image_id_to_image;
-  image_id_to_image.reserve(database_images.size());
-  for (const auto& image : database_images) {
+  image_id_to_image.reserve(images.size());
+  for (const auto& image : images) {
     image_id_to_image.emplace(image.ImageId(), &image);
   }
 
@@ -256,7 +404,7 @@ int RunVocabTreeRetriever(int argc, char** argv) {
     }
 
     std::vector<retrieval::ImageScore> image_scores;
-    visual_index.Query(query_options, keypoints, descriptors, &image_scores);
+    sharded_index.Query(query_options, keypoints, descriptors, &image_scores);
 
     LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
     for (const auto& image_score : image_scores) {
@@ -268,6 +416,18 @@ int RunVocabTreeRetriever(int argc, char** argv) {
     }
   }
 
+  if (stream_queries) {
+    LOG(INFO) << "Waiting for queries on the standard input";
+    StreamVocabTreeQueries(sharded_index,
+                           query_options,
+                           max_num_features,
+                           num_threads,
+                           image_id_to_image,
+                           &database,
+                           std::cin,
+                           std::cout);
+  }
+
   return EXIT_SUCCESS;
 }
 
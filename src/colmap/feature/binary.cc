@@ -0,0 +1,954 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/feature/binary.h"
+
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace colmap {
+
+bool BinaryExtractionOptions::Check() const {
+  CHECK_OPTION_GT(max_num_features, 0);
+  CHECK_OPTION_GT(num_levels, 0);
+  CHECK_OPTION_GT(scale_factor, 1.0);
+  CHECK_OPTION_GT(fast_threshold, 0);
+  CHECK_OPTION_LT(fast_threshold, 255);
+  return true;
+}
+
+bool BinaryMatchingOptions::Check() const {
+  CHECK_OPTION_GE(max_hamming_distance, 0);
+  CHECK_OPTION_GT(max_ratio, 0.0);
+  CHECK_OPTION_LE(max_ratio, 1.0);
+  return true;
+}
+
+namespace {
+
+// Radius of the circular patch used for the orientation and the descriptor.
+constexpr int kPatchRadius = 15;
+// Maximum absolute coordinate of the sampling points of the descriptor before
+// rotation, such that the rotated points remain inside the patch.
+constexpr int kMaxSamplingOffset = 13;
+// Radius of the box filter, which smooths the image for the descriptor.
+constexpr int kBoxRadius = 2;
+// Minimum distance of the keypoints to the image border, such that the
+// rotated sampling points, the box filter, and the orientation patch are
+// fully contained in the image.
+constexpr int kBorder = kPatchRadius + kBoxRadius + 5;
+constexpr int kNumDescriptorBits = 256;
+constexpr int kNumDescriptorBytes = kNumDescriptorBits / 8;
+
+// Pairs of sampling points (x1, y1, x2, y2) of the BRIEF descriptor. In
+// contrast to the learned pattern of ORB, the points are drawn from an
+// approximately isotropic Gaussian distribution around the keypoint, as in
+// the best performing pattern of BRIEF. A fixed integer random number
+// generator is used, such that the pattern is the same on all platforms and
+// descriptors remain comparable across builds.
+const std::array<std::array<int, 4>, kNumDescriptorBits>& GetBriefPattern() {
+  static const std::array<std::array<int, 4>, kNumDescriptorBits> kPattern =
+      []() {
+        uint32_t state = 2463534242u;
+        auto SampleOffset = [&state]() {
+          int offset = 0;
+          // The sum of three uniform integers in [-6, 6] has a standard
+          // deviation of about 6.5, close to the 31 / 5 pixels of BRIEF.
+          for (int i = 0; i < 3; ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            offset += static_cast<int>(state % 13) - 6;
+          }
+          return std::clamp(offset, -kMaxSamplingOffset, kMaxSamplingOffset);
+        };
+
+        std::array<std::array<int, 4>, kNumDescriptorBits> pattern;
+        for (auto& pair : pattern) {
+          do {
+            for (int& offset : pair) {
+              offset = SampleOffset();
+            }
+          } while (pair[0] == pair[2] && pair[1] == pair[3]);
+        }
+        return pattern;
+      }();
+  return kPattern;
+}
+
+// Offsets of the 16 pixels on the Bresenham circle of radius 3 of the FAST
+// segment test in clockwise order.
+constexpr int kFastCircleX[16] = {
+    0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3, -3, -3, -2, -1};
+constexpr int kFastCircleY[16] = {
+    -3, -3, -2, -1, 0, 1, 2, 3, 3, 3, 2, 1, 0, -1, -2, -3};
+
+// Whether the circular 16-bit mask contains at least 9 consecutive set bits.
+inline bool HasFastArc(const uint32_t mask) {
+  const uint32_t circular_mask = mask | (mask << 16);
+  uint32_t arc = circular_mask;
+  for (int k = 1; k < 9; ++k) {
+    arc &= circular_mask >> k;
+  }
+  return arc != 0;
+}
+
+struct GrayImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> data;
+
+  uint8_t operator()(const int x, const int y) const {
+    return data[y * width + x];
+  }
+};
+
+GrayImage DownsampleBilinear(const GrayImage& image,
+                             const int width,
+                             const int height) {
+  GrayImage downsampled;
+  downsampled.width = width;
+  downsampled.height = height;
+  downsampled.data.resize(static_cast<size_t>(width) * height);
+  const float scale_x = static_cast<float>(image.width) / width;
+  const float scale_y = static_cast<float>(image.height) / height;
+  for (int y = 0; y < height; ++y) {
+    const float src_y = std::clamp(
+        (y + 0.5f) * scale_y - 0.5f, 0.0f, image.height - 1.0f);
+    const int y0 = std::min(static_cast<int>(src_y), image.height - 2);
+    const float wy = src_y - y0;
+    for (int x = 0; x < width; ++x) {
+      const float src_x = std::clamp(
+          (x + 0.5f) * scale_x - 0.5f, 0.0f, image.width - 1.0f);
+      const int x0 = std::min(static_cast<int>(src_x), image.width - 2);
+      const float wx = src_x - x0;
+      const float value =
+          (1 - wy) * ((1 - wx) * image(x0, y0) + wx * image(x0 + 1, y0)) +
+          wy * ((1 - wx) * image(x0, y0 + 1) + wx * image(x0 + 1, y0 + 1));
+      downsampled.data[y * width + x] =
+          static_cast<uint8_t>(std::min(255.0f, value + 0.5f));
+    }
+  }
+  return downsampled;
+}
+
+struct Corner {
+  int x = 0;
+  int y = 0;
+  float response = 0;
+};
+
+// FAST-9 corners with non-maximum suppression of their scores in a 3x3
+// neighborhood. The score is the sum of the absolute differences that exceed
+// the threshold on the side of the arc.
+std::vector<Corner> DetectFastCorners(const GrayImage& image,
+                                      const int threshold) {
+  const int width = image.width;
+  std::array<int, 16> circle_offsets;
+  for (int i = 0; i < 16; ++i) {
+    circle_offsets[i] = kFastCircleY[i] * width + kFastCircleX[i];
+  }
+
+  std::vector<int> scores(image.data.size(), 0);
+  for (int y = kBorder; y < image.height - kBorder; ++y) {
+    for (int x = kBorder; x < width - kBorder; ++x) {
+      const uint8_t* pixel = image.data.data() + y * width + x;
+      const int center = *pixel;
+      const int upper = center + threshold;
+      const int lower = center - threshold;
+
+      // Any arc of 9 pixels contains at least two of the four pixels at the
+      // compass directions.
+      int num_brighter = 0;
+      int num_darker = 0;
+      for (int i = 0; i < 16; i += 4) {
+        const int value = pixel[circle_offsets[i]];
+        num_brighter += value > upper;
+        num_darker += value < lower;
+      }
+      if (num_brighter < 2 && num_darker < 2) {
+        continue;
+      }
+
+      uint32_t brighter_mask = 0;
+      uint32_t darker_mask = 0;
+      int brighter_score = 0;
+      int darker_score = 0;
+      for (int i = 0; i < 16; ++i) {
+        const int value = pixel[circle_offsets[i]];
+        if (value > upper) {
+          brighter_mask |= 1u << i;
+          brighter_score += value - upper;
+        } else if (value < lower) {
+          darker_mask |= 1u << i;
+          darker_score += lower - value;
+        }
+      }
+
+      if (HasFastArc(brighter_mask)) {
+        scores[y * width + x] = std::max(1, brighter_score);
+      } else if (HasFastArc(darker_mask)) {
+        scores[y * width + x] = std::max(1, darker_score);
+      }
+    }
+  }
+
+  std::vector<Corner> corners;
+  for (int y = kBorder; y < image.height - kBorder; ++y) {
+    for (int x = kBorder; x < width - kBorder; ++x) {
+      const int score = scores[y * width + x];
+      if (score == 0) {
+        continue;
+      }
+      // Of multiple neighbors with the same score, the last one in scan order
+      // is kept.
+      bool is_maximum = true;
+      for (int dy = -1; dy <= 1 && is_maximum; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          const int other_score = scores[(y + dy) * width + x + dx];
+          const bool is_before = dy < 0 || (dy == 0 && dx < 0);
+          if ((dx != 0 || dy != 0) &&
+              (is_before ? other_score > score : other_score >= score)) {
+            is_maximum = false;
+            break;
+          }
+        }
+      }
+      if (is_maximum) {
+        Corner corner;
+        corner.x = x;
+        corner.y = y;
+        corners.push_back(corner);
+      }
+    }
+  }
+
+  return corners;
+}
+
+// Harris corner response in a 7x7 window with central difference gradients.
+float ComputeHarrisResponse(const GrayImage& image, const int x, const int y) {
+  constexpr int kRadius = 3;
+  constexpr float kHarrisK = 0.04f;
+  float a = 0;
+  float b = 0;
+  float c = 0;
+  for (int v = y - kRadius; v <= y + kRadius; ++v) {
+    for (int u = x - kRadius; u <= x + kRadius; ++u) {
+      const float dx = static_cast<float>(image(u + 1, v)) - image(u - 1, v);
+      const float dy = static_cast<float>(image(u, v + 1)) - image(u, v - 1);
+      a += dx * dx;
+      b += dy * dy;
+      c += dx * dy;
+    }
+  }
+  return a * b - c * c - kHarrisK * (a + b) * (a + b);
+}
+
+// Orientation of the vector from the keypoint to the intensity centroid of
+// the circular patch around it.
+float ComputeIntensityCentroidOrientation(const GrayImage& image,
+                                          const int x,
+                                          const int y) {
+  int64_t m01 = 0;
+  int64_t m10 = 0;
+  for (int dy = -kPatchRadius; dy <= kPatchRadius; ++dy) {
+    const int max_dx = static_cast<int>(
+        std::sqrt(static_cast<float>(kPatchRadius * kPatchRadius - dy * dy)));
+    for (int dx = -max_dx; dx <= max_dx; ++dx) {
+      const int value = image(x + dx, y + dy);
+      m10 += dx * value;
+      m01 += dy * value;
+    }
+  }
+  return static_cast<float>(
+      std::atan2(static_cast<double>(m01), static_cast<double>(m10)));
+}
+
+// Summed area table with an additional leading row and column of zeros.
+std::vector<uint32_t> ComputeIntegralImage(const GrayImage& image) {
+  const int stride = image.width + 1;
+  std::vector<uint32_t> integral(
+      static_cast<size_t>(stride) * (image.height + 1), 0);
+  for (int y = 0; y < image.height; ++y) {
+    uint32_t row_sum = 0;
+    for (int x = 0; x < image.width; ++x) {
+      row_sum += image(x, y);
+      integral[(y + 1) * stride + x + 1] = integral[y * stride + x + 1] + row_sum;
+    }
+  }
+  return integral;
+}
+
+void ComputeSteeredBriefDescriptor(const std::vector<uint32_t>& integral,
+                                   const int width,
+                                   const int x,
+                                   const int y,
+                                   const float orientation,
+                                   uint8_t* descriptor) {
+  const int stride = width + 1;
+  // Sum over the box of the given radius, which yields the same comparisons
+  // as the mean intensity.
+  const auto BoxSum = [&](const int u, const int v) {
+    const int u0 = u - kBoxRadius;
+    const int v0 = v - kBoxRadius;
+    const int u1 = u + kBoxRadius + 1;
+    const int v1 = v + kBoxRadius + 1;
+    return integral[v1 * stride + u1] - integral[v0 * stride + u1] -
+           integral[v1 * stride + u0] + integral[v0 * stride + u0];
+  };
+
+  const float cos_angle = std::cos(orientation);
+  const float sin_angle = std::sin(orientation);
+  const auto& pattern = GetBriefPattern();
+  std::fill(descriptor, descriptor + kNumDescriptorBytes, 0);
+  for (int i = 0; i < kNumDescriptorBits; ++i) {
+    const std::array<int, 4>& pair = pattern[i];
+    const int u1 = x + static_cast<int>(std::lround(cos_angle * pair[0] -
+                                                    sin_angle * pair[1]));
+    const int v1 = y + static_cast<int>(std::lround(sin_angle * pair[0] +
+                                                    cos_angle * pair[1]));
+    const int u2 = x + static_cast<int>(std::lround(cos_angle * pair[2] -
+                                                    sin_angle * pair[3]));
+    const int v2 = y + static_cast<int>(std::lround(sin_angle * pair[2] +
+                                                    cos_angle * pair[3]));
+    if (BoxSum(u1, v1) < BoxSum(u2, v2)) {
+      descriptor[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+    }
+  }
+}
+
+class BinaryFeatureExtractor : public FeatureExtractor {
+ public:
+  explicit BinaryFeatureExtractor(const BinaryExtractionOptions& options)
+      : options_(options) {
+    THROW_CHECK(options_.Check());
+  }
+
+  bool Extract(const Bitmap& bitmap,
+               FeatureKeypoints* keypoints,
+               FeatureDescriptors* descriptors) override {
+    THROW_CHECK_NOTNULL(keypoints);
+    THROW_CHECK_NOTNULL(descriptors);
+
+    GrayImage level_image;
+    level_image.width = bitmap.Width();
+    level_image.height = bitmap.Height();
+    level_image.data = bitmap.IsGrey()
+                           ? bitmap.ConvertToRowMajorArray()
+                           : bitmap.CloneAsGrey().ConvertToRowMajorArray();
+
+    // The features are distributed over the levels in proportion to their
+    // image area. The unused share of a level is passed on to the next one.
+    const double area_factor =
+        1.0 / (options_.scale_factor * options_.scale_factor);
+    double level_share = (1.0 - area_factor) /
+                         (1.0 - std::pow(area_factor, options_.num_levels));
+
+    struct LevelFeature {
+      float x;
+      float y;
+      float scale;
+      float orientation;
+      std::array<uint8_t, kNumDescriptorBytes> descriptor;
+    };
+    std::vector<LevelFeature> features;
+    features.reserve(options_.max_num_features);
+
+    double num_remaining_features = 0;
+    for (int level = 0; level < options_.num_levels; ++level) {
+      if (level > 0) {
+        const double scale = std::pow(options_.scale_factor, level);
+        const int width =
+            static_cast<int>(std::round(bitmap.Width() / scale));
+        const int height =
+            static_cast<int>(std::round(bitmap.Height() / scale));
+        if (width <= 2 * kBorder || height <= 2 * kBorder) {
+          break;
+        }
+        level_image = DownsampleBilinear(level_image, width, height);
+        level_share *= area_factor;
+      }
+
+      num_remaining_features += options_.max_num_features * level_share;
+      const size_t max_num_level_features = std::min<size_t>(
+          options_.max_num_features - features.size(),
+          static_cast<size_t>(num_remaining_features));
+
+      std::vector<Corner> corners =
+          DetectFastCorners(level_image, options_.fast_threshold);
+      for (Corner& corner : corners) {
+        corner.response =
+            ComputeHarrisResponse(level_image, corner.x, corner.y);
+      }
+      if (corners.size() > max_num_level_features) {
+        std::nth_element(corners.begin(),
+                         corners.begin() + max_num_level_features,
+                         corners.end(),
+                         [](const Corner& corner1, const Corner& corner2) {
+                           return corner1.response > corner2.response;
+                         });
+        corners.resize(max_num_level_features);
+      }
+      num_remaining_features -= corners.size();
+
+      if (corners.empty()) {
+        continue;
+      }
+
+      const float scale_x =
+          static_cast<float>(bitmap.Width()) / level_image.width;
+      const float scale_y =
+          static_cast<float>(bitmap.Height()) / level_image.height;
+      const std::vector<uint32_t> integral = ComputeIntegralImage(level_image);
+      for (const Corner& corner : corners) {
+        LevelFeature feature;
+        feature.x = (corner.x + 0.5f) * scale_x;
+        feature.y = (corner.y + 0.5f) * scale_y;
+        // The patch covers about three times the scale in each direction,
+        // similar to the support of SIFT features.
+        feature.scale = 0.5f * (scale_x + scale_y) * kPatchRadius / 3.0f;
+        feature.orientation =
+            options_.upright ? 0.0f
+                             : ComputeIntensityCentroidOrientation(
+                                   level_image, corner.x, corner.y);
+        ComputeSteeredBriefDescriptor(integral,
+                                      level_image.width,
+                                      corner.x,
+                                      corner.y,
+                                      feature.orientation,
+                                      feature.descriptor.data());
+        features.push_back(feature);
+      }
+    }
+
+    keypoints->resize(features.size());
+    descriptors->resize(features.size(), kNumDescriptorBytes);
+    for (size_t i = 0; i < features.size(); ++i) {
+      const LevelFeature& feature = features[i];
+      (*keypoints)[i] = FeatureKeypoint(
+          feature.x, feature.y, feature.scale, feature.orientation);
+      std::copy(feature.descriptor.begin(),
+                feature.descriptor.end(),
+                descriptors->row(i).data());
+    }
+
+    return true;
+  }
+
+ private:
+  const BinaryExtractionOptions options_;
+};
+
+}  // namespace
+
+std::unique_ptr<FeatureExtractor> CreateBinaryFeatureExtractor(
+    const BinaryExtractionOptions& options) {
+  return std::make_unique<BinaryFeatureExtractor>(options);
+}
+
+namespace {
+
+// All 16-bit masks ordered by their number of set bits, such that the masks
+// with up to r set bits are the first ends[r] masks.
+struct SubstringMasks {
+  std::vector<uint16_t> masks;
+  std::array<int, 17> ends;
+};
+
+const SubstringMasks& GetSubstringMasks() {
+  static const SubstringMasks kMasks = []() {
+    SubstringMasks substring_masks;
+    substring_masks.masks.reserve(1 << 16);
+    for (int num_bits = 0; num_bits <= 16; ++num_bits) {
+      for (uint32_t mask = 0; mask < (1u << 16); ++mask) {
+        int mask_num_bits = 0;
+        for (uint32_t bits = mask; bits != 0; bits &= bits - 1) {
+          ++mask_num_bits;
+        }
+        if (mask_num_bits == num_bits) {
+          substring_masks.masks.push_back(static_cast<uint16_t>(mask));
+        }
+      }
+      substring_masks.ends[num_bits] =
+          static_cast<int>(substring_masks.masks.size());
+    }
+    return substring_masks;
+  }();
+  return kMasks;
+}
+
+inline uint16_t GetSubstring(const uint8_t* descriptor, const int substring) {
+  return static_cast<uint16_t>(descriptor[2 * substring]) |
+         static_cast<uint16_t>(descriptor[2 * substring + 1] << 8);
+}
+
+}  // namespace
+
+BinaryMultiIndexHash::BinaryMultiIndexHash(
+    std::shared_ptr<const FeatureDescriptors> descriptors)
+    : descriptors_(std::move(descriptors)) {
+  THROW_CHECK_NOTNULL(descriptors_);
+  THROW_CHECK_EQ(descriptors_->cols() % 8, 0);
+  num_substrings_ = descriptors_->cols() / 2;
+
+  // About one descriptor per bucket, which keeps the lookup cost independent
+  // of the number of descriptors without wasting memory on empty buckets.
+  const int num_descriptors = descriptors_->rows();
+  int num_buckets = 1;
+  while (num_buckets < num_descriptors && num_buckets < (1 << 16)) {
+    num_buckets *= 2;
+  }
+  bucket_mask_ = num_buckets - 1;
+
+  bucket_offsets_.resize(num_substrings_);
+  bucket_values_.resize(num_substrings_);
+  bucket_idxs_.resize(num_substrings_);
+  for (int s = 0; s < num_substrings_; ++s) {
+    // Counting sort of the descriptors by the bucket of their substring.
+    std::vector<int>& offsets = bucket_offsets_[s];
+    offsets.assign(num_buckets + 1, 0);
+    for (int i = 0; i < num_descriptors; ++i) {
+      offsets[(GetSubstring(descriptors_->row(i).data(), s) & bucket_mask_) +
+              1] += 1;
+    }
+    for (int b = 1; b <= num_buckets; ++b) {
+      offsets[b] += offsets[b - 1];
+    }
+    std::vector<int> bucket_sizes(num_buckets, 0);
+    bucket_values_[s].resize(num_descriptors);
+    bucket_idxs_[s].resize(num_descriptors);
+    for (int i = 0; i < num_descriptors; ++i) {
+      const uint16_t value = GetSubstring(descriptors_->row(i).data(), s);
+      const uint32_t bucket = value & bucket_mask_;
+      const int k = offsets[bucket] + bucket_sizes[bucket]++;
+      bucket_values_[s][k] = value;
+      bucket_idxs_[s][k] = i;
+    }
+  }
+}
+
+void BinaryMultiIndexHash::Search(const uint8_t* query,
+                                  const int max_dist,
+                                  BinaryBestHammingDistances* best) const {
+  THROW_CHECK_NOTNULL(best);
+  *best = BinaryBestHammingDistances();
+  if (descriptors_->rows() == 0) {
+    return;
+  }
+
+  const SubstringMasks& substring_masks = GetSubstringMasks();
+  const int num_masks =
+      substring_masks.ends[std::min(16, max_dist / num_substrings_)];
+  const int num_bytes = descriptors_->cols();
+  const SiftKernelISA isa = GetBestSiftKernelISA();
+
+  for (int s = 0; s < num_substrings_; ++s) {
+    const uint16_t query_value = GetSubstring(query, s);
+    const std::vector<int>& offsets = bucket_offsets_[s];
+    const std::vector<uint16_t>& values = bucket_values_[s];
+    const std::vector<int>& idxs = bucket_idxs_[s];
+    for (int m = 0; m < num_masks; ++m) {
+      const uint16_t value = query_value ^ substring_masks.masks[m];
+      const uint32_t bucket = value & bucket_mask_;
+      for (int k = offsets[bucket]; k < offsets[bucket + 1]; ++k) {
+        // The same descriptor can be found through multiple substrings.
+        if (values[k] != value || idxs[k] == best->best_idx) {
+          continue;
+        }
+        int dist;
+        ComputeHammingDistances(
+            query, descriptors_->row(idxs[k]).data(), 1, num_bytes, &dist, isa);
+        if (dist < best->best_dist) {
+          best->best_idx = idxs[k];
+          best->second_best_dist = best->best_dist;
+          best->best_dist = dist;
+        } else if (dist < best->second_best_dist) {
+          best->second_best_dist = dist;
+        }
+      }
+    }
+  }
+}
+
+size_t BinaryMultiIndexHash::NumBytes() const {
+  size_t num_bytes = 0;
+  for (int s = 0; s < num_substrings_; ++s) {
+    num_bytes += bucket_offsets_[s].size() * sizeof(int) +
+                 bucket_values_[s].size() * sizeof(uint16_t) +
+                 bucket_idxs_[s].size() * sizeof(int);
+  }
+  return num_bytes;
+}
+
+namespace {
+
+size_t FindBestMatchesOneWay(
+    const std::vector<BinaryBestHammingDistances>& best_dists,
+    const int max_hamming_distance,
+    const double max_ratio,
+    std::vector<int>* matches) {
+  size_t num_matches = 0;
+  matches->assign(best_dists.size(), -1);
+
+  for (size_t i1 = 0; i1 < best_dists.size(); ++i1) {
+    const BinaryBestHammingDistances& best = best_dists[i1];
+
+    // Check if any match found and if the match distance passes threshold.
+    if (best.best_idx == -1 || best.best_dist > max_hamming_distance) {
+      continue;
+    }
+
+    // Check if match passes ratio test. Keep this comparison >= in order to
+    // ensure that the case of best == second_best is detected.
+    if (best.best_dist >=
+        max_ratio * static_cast<double>(best.second_best_dist)) {
+      continue;
+    }
+
+    num_matches += 1;
+    (*matches)[i1] = best.best_idx;
+  }
+
+  return num_matches;
+}
+
+void FindBestMatchesFromBestHammingDistances(
+    const std::vector<BinaryBestHammingDistances>& best12,
+    const std::vector<BinaryBestHammingDistances>& best21,
+    const BinaryMatchingOptions& options,
+    FeatureMatches* matches) {
+  matches->clear();
+
+  std::vector<int> matches12;
+  const size_t num_matches12 = FindBestMatchesOneWay(
+      best12, options.max_hamming_distance, options.max_ratio, &matches12);
+
+  std::vector<int> matches21;
+  if (options.cross_check) {
+    const size_t num_matches21 = FindBestMatchesOneWay(
+        best21, options.max_hamming_distance, options.max_ratio, &matches21);
+    matches->reserve(std::min(num_matches12, num_matches21));
+  } else {
+    matches->reserve(num_matches12);
+  }
+
+  for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
+    if (matches12[i1] == -1) {
+      continue;
+    }
+    if (options.cross_check &&
+        matches21[matches12[i1]] != static_cast<int>(i1)) {
+      continue;
+    }
+    matches->emplace_back(i1, matches12[i1]);
+  }
+}
+
+// Best Hamming distances between the descriptors, only considering keypoint
+// pairs that pass the guided filter. The descriptors of the second image are
+// scanned in order for every descriptor of the first image, so ties are
+// resolved as in the unguided brute-force search.
+template <typename GuidedFilter>
+void FindGuidedBestHammingDistances(
+    const FeatureKeypoints& keypoints1,
+    const FeatureKeypoints& keypoints2,
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2,
+    const GuidedFilter& guided_filter,
+    std::vector<BinaryBestHammingDistances>* best12,
+    std::vector<BinaryBestHammingDistances>* best21) {
+  best12->assign(descriptors1.rows(), BinaryBestHammingDistances());
+  if (best21 != nullptr) {
+    best21->assign(descriptors2.rows(), BinaryBestHammingDistances());
+  }
+
+  const SiftKernelISA isa = GetBestSiftKernelISA();
+  std::vector<int> dists(descriptors2.rows());
+  for (FeatureDescriptors::Index i1 = 0; i1 < descriptors1.rows(); ++i1) {
+    ComputeHammingDistances(descriptors1.row(i1).data(),
+                            descriptors2.data(),
+                            descriptors2.rows(),
+                            descriptors2.cols(),
+                            dists.data(),
+                            isa);
+    const float x1 = keypoints1[i1].x;
+    const float y1 = keypoints1[i1].y;
+    BinaryBestHammingDistances& best1 = (*best12)[i1];
+    for (FeatureDescriptors::Index i2 = 0; i2 < descriptors2.rows(); ++i2) {
+      if (guided_filter(x1, y1, keypoints2[i2].x, keypoints2[i2].y)) {
+        continue;
+      }
+      const int dist = dists[i2];
+      if (dist < best1.best_dist) {
+        best1.best_idx = i2;
+        best1.second_best_dist = best1.best_dist;
+        best1.best_dist = dist;
+      } else if (dist < best1.second_best_dist) {
+        best1.second_best_dist = dist;
+      }
+      if (best21 != nullptr) {
+        BinaryBestHammingDistances& best2 = (*best21)[i2];
+        if (dist < best2.best_dist) {
+          best2.best_idx = i1;
+          best2.second_best_dist = best2.best_dist;
+          best2.best_dist = dist;
+        } else if (dist < best2.second_best_dist) {
+          best2.second_best_dist = dist;
+        }
+      }
+    }
+  }
+}
+
+class BinaryCPUFeatureMatcher : public FeatureMatcher {
+ public:
+  explicit BinaryCPUFeatureMatcher(const BinaryMatchingOptions& options)
+      : options_(options) {
+    THROW_CHECK(options_.Check());
+  }
+
+  std::shared_ptr<const FeatureDescriptorIndex> CreateDescriptorIndex(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors)
+      const override {
+    if (!options_.multi_index_hashing) {
+      return nullptr;
+    }
+    return std::make_shared<const BinaryMultiIndexHash>(descriptors);
+  }
+
+  void SetDescriptorIndices(
+      std::shared_ptr<const FeatureDescriptorIndex> index1,
+      std::shared_ptr<const FeatureDescriptorIndex> index2) override {
+    pending_index1_ = std::move(index1);
+    pending_index2_ = std::move(index2);
+  }
+
+  void Match(const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+             const std::shared_ptr<const FeatureDescriptors>& descriptors2,
+             FeatureMatches* matches) override {
+    THROW_CHECK_NOTNULL(matches);
+    matches->clear();
+
+    if (descriptors1 != nullptr) {
+      THROW_CHECK_EQ(descriptors1->cols() % 8, 0);
+      descriptors1_ = descriptors1;
+      index1_ = GetOrBuildIndex(descriptors1_, &pending_index1_);
+    }
+
+    if (descriptors2 != nullptr) {
+      THROW_CHECK_EQ(descriptors2->cols() % 8, 0);
+      descriptors2_ = descriptors2;
+      index2_ = GetOrBuildIndex(descriptors2_, &pending_index2_);
+    }
+
+    THROW_CHECK_NOTNULL(descriptors1_);
+    THROW_CHECK_NOTNULL(descriptors2_);
+    THROW_CHECK_EQ(descriptors1_->cols(), descriptors2_->cols());
+
+    if (descriptors1_->rows() == 0 || descriptors2_->rows() == 0) {
+      return;
+    }
+
+    std::vector<BinaryBestHammingDistances> best12;
+    std::vector<BinaryBestHammingDistances> best21;
+    if (options_.multi_index_hashing) {
+      // The ratio test only needs the exact second best distance, if it is
+      // smaller than the best distance divided by the ratio. Searching this
+      // larger radius thus yields the same matches as brute-force search.
+      const int max_dist = static_cast<int>(
+          std::floor(options_.max_hamming_distance / options_.max_ratio));
+      // The indices may have been reset by a previous guided matching call.
+      if (index1_ == nullptr) {
+        index1_ = GetOrBuildIndex(descriptors1_, &pending_index1_);
+      }
+      if (index2_ == nullptr) {
+        index2_ = GetOrBuildIndex(descriptors2_, &pending_index2_);
+      }
+      SearchIndex(*descriptors1_, *index2_, max_dist, &best12);
+      if (options_.cross_check) {
+        SearchIndex(*descriptors2_, *index1_, max_dist, &best21);
+      }
+    } else {
+      FindBinaryBestHammingDistances(*descriptors1_,
+                                     *descriptors2_,
+                                     &best12,
+                                     options_.cross_check ? &best21 : nullptr);
+    }
+
+    FindBestMatchesFromBestHammingDistances(best12, best21, options_, matches);
+  }
+
+  void MatchGuided(
+      const double max_error,
+      const std::shared_ptr<const FeatureKeypoints>& keypoints1,
+      const std::shared_ptr<const FeatureKeypoints>& keypoints2,
+      const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+      const std::shared_ptr<const FeatureDescriptors>& descriptors2,
+      TwoViewGeometry* two_view_geometry) override {
+    THROW_CHECK_NOTNULL(two_view_geometry);
+    two_view_geometry->inlier_matches.clear();
+
+    if (descriptors1 != nullptr) {
+      THROW_CHECK_NOTNULL(keypoints1);
+      THROW_CHECK_EQ(descriptors1->rows(), keypoints1->size());
+      THROW_CHECK_EQ(descriptors1->cols() % 8, 0);
+      keypoints1_ = keypoints1;
+      descriptors1_ = descriptors1;
+      // Guided matching does not use the indices.
+      index1_.reset();
+      pending_index1_.reset();
+    }
+
+    if (descriptors2 != nullptr) {
+      THROW_CHECK_NOTNULL(keypoints2);
+      THROW_CHECK_EQ(descriptors2->rows(), keypoints2->size());
+      THROW_CHECK_EQ(descriptors2->cols() % 8, 0);
+      keypoints2_ = keypoints2;
+      descriptors2_ = descriptors2;
+      index2_.reset();
+      pending_index2_.reset();
+    }
+
+    THROW_CHECK_NOTNULL(keypoints1_);
+    THROW_CHECK_NOTNULL(keypoints2_);
+    THROW_CHECK_EQ(descriptors1_->cols(), descriptors2_->cols());
+    if (keypoints1_->empty() || keypoints2_->empty()) {
+      return;
+    }
+
+    const float max_residual = max_error * max_error;
+
+    std::vector<BinaryBestHammingDistances> best12;
+    std::vector<BinaryBestHammingDistances> best21;
+
+    if (two_view_geometry->config == TwoViewGeometry::CALIBRATED ||
+        two_view_geometry->config == TwoViewGeometry::UNCALIBRATED) {
+      const Eigen::Matrix3f F = two_view_geometry->F.cast<float>();
+      const auto guided_filter =
+          [&](const float x1, const float y1, const float x2, const float y2) {
+            const Eigen::Vector3f p1(x1, y1, 1.0f);
+            const Eigen::Vector3f p2(x2, y2, 1.0f);
+            const Eigen::Vector3f Fx1 = F * p1;
+            const Eigen::Vector3f Ftx2 = F.transpose() * p2;
+            const float x2tFx1 = p2.transpose() * Fx1;
+            return x2tFx1 * x2tFx1 /
+                       (Fx1(0) * Fx1(0) + Fx1(1) * Fx1(1) + Ftx2(0) * Ftx2(0) +
+                        Ftx2(1) * Ftx2(1)) >
+                   max_residual;
+          };
+      FindGuidedBestHammingDistances(*keypoints1_,
+                                     *keypoints2_,
+                                     *descriptors1_,
+                                     *descriptors2_,
+                                     guided_filter,
+                                     &best12,
+                                     options_.cross_check ? &best21 : nullptr);
+    } else if (two_view_geometry->config == TwoViewGeometry::PLANAR ||
+               two_view_geometry->config == TwoViewGeometry::PANORAMIC ||
+               two_view_geometry->config ==
+                   TwoViewGeometry::PLANAR_OR_PANORAMIC) {
+      const Eigen::Matrix3f H = two_view_geometry->H.cast<float>();
+      const auto guided_filter =
+          [&](const float x1, const float y1, const float x2, const float y2) {
+            const Eigen::Vector3f p1(x1, y1, 1.0f);
+            const Eigen::Vector2f p2(x2, y2);
+            return ((H * p1).hnormalized() - p2).squaredNorm() > max_residual;
+          };
+      FindGuidedBestHammingDistances(*keypoints1_,
+                                     *keypoints2_,
+                                     *descriptors1_,
+                                     *descriptors2_,
+                                     guided_filter,
+                                     &best12,
+                                     options_.cross_check ? &best21 : nullptr);
+    } else {
+      return;
+    }
+
+    FindBestMatchesFromBestHammingDistances(
+        best12, best21, options_, &two_view_geometry->inlier_matches);
+  }
+
+ private:
+  static void SearchIndex(const FeatureDescriptors& descriptors,
+                          const BinaryMultiIndexHash& index,
+                          const int max_dist,
+                          std::vector<BinaryBestHammingDistances>* best) {
+    best->resize(descriptors.rows());
+    for (FeatureDescriptors::Index i = 0; i < descriptors.rows(); ++i) {
+      index.Search(descriptors.row(i).data(), max_dist, &(*best)[i]);
+    }
+  }
+
+  // Use the pre-built index, if one was set, and otherwise build a new one.
+  std::shared_ptr<const BinaryMultiIndexHash> GetOrBuildIndex(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors,
+      std::shared_ptr<const FeatureDescriptorIndex>* pending_index) const {
+    if (!options_.multi_index_hashing) {
+      pending_index->reset();
+      return nullptr;
+    }
+    std::shared_ptr<const BinaryMultiIndexHash> index;
+    if (*pending_index != nullptr) {
+      index = std::dynamic_pointer_cast<const BinaryMultiIndexHash>(
+          *pending_index);
+      THROW_CHECK_NOTNULL(index);
+      THROW_CHECK_EQ(index->Descriptors().rows(), descriptors->rows());
+      pending_index->reset();
+    } else {
+      index = std::make_shared<const BinaryMultiIndexHash>(descriptors);
+    }
+    return index;
+  }
+
+  const BinaryMatchingOptions options_;
+  std::shared_ptr<const FeatureKeypoints> keypoints1_;
+  std::shared_ptr<const FeatureKeypoints> keypoints2_;
+  std::shared_ptr<const FeatureDescriptors> descriptors1_;
+  std::shared_ptr<const FeatureDescriptors> descriptors2_;
+  std::shared_ptr<const BinaryMultiIndexHash> index1_;
+  std::shared_ptr<const BinaryMultiIndexHash> index2_;
+  std::shared_ptr<const FeatureDescriptorIndex> pending_index1_;
+  std::shared_ptr<const FeatureDescriptorIndex> pending_index2_;
+};
+
+}  // namespace
+
+std::unique_ptr<FeatureMatcher> CreateBinaryFeatureMatcher(
+    const BinaryMatchingOptions& options) {
+  return std::make_unique<BinaryCPUFeatureMatcher>(options);
+}
+
+}  // namespace colmap
@@ -0,0 +1,131 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/feature/descriptor_kernels.h"
+#include "colmap/feature/extractor.h"
+#include "colmap/feature/matcher.h"
+
+#include <memory>
+#include <vector>
+
+namespace colmap {
+
+// Options of the ORB-like binary feature extractor, which detects FAST corners
+// on an image pyramid, keeps the corners with the strongest Harris response,
+// orients them by their intensity centroid, and describes them by 256-bit
+// steered BRIEF descriptors. See "ORB: An efficient alternative to SIFT or
+// SURF", E. Rublee et al., ICCV 2011. Binary features are much cheaper to
+// extract and match than SIFT features but less distinctive.
+struct BinaryExtractionOptions {
+  // Maximum number of features over all pyramid levels.
+  int max_num_features = 8192;
+
+  // Number of pyramid levels and the downsampling factor between two levels.
+  int num_levels = 8;
+  double scale_factor = 1.2;
+
+  // Minimum intensity difference between the center pixel and the contiguous
+  // arc of pixels on the circle of the FAST segment test.
+  int fast_threshold = 20;
+
+  // Fix the orientation to 0 for upright features.
+  bool upright = false;
+
+  bool Check() const;
+};
+
+// Create a binary feature extractor. The same instance can be used to extract
+// features for multiple images in the same thread.
+std::unique_ptr<FeatureExtractor> CreateBinaryFeatureExtractor(
+    const BinaryExtractionOptions& options);
+
+struct BinaryMatchingOptions {
+  // Maximum Hamming distance to the best match.
+  int max_hamming_distance = 64;
+
+  // Maximum distance ratio between first and second best match.
+  double max_ratio = 0.8;
+
+  // Whether to enable cross checking in matching.
+  bool cross_check = true;
+
+  // Whether to search the nearest neighbors with multi-index hashing instead
+  // of brute force. The search is exact, so the matches are the same as for
+  // brute-force matching, but it is only faster for many descriptors per image
+  // or small maximum Hamming distances.
+  bool multi_index_hashing = false;
+
+  bool Check() const;
+};
+
+// Create a binary feature matcher on the CPU.
+std::unique_ptr<FeatureMatcher> CreateBinaryFeatureMatcher(
+    const BinaryMatchingOptions& options);
+
+// Multi-index hash over binary descriptors for exact nearest neighbor search
+// in Hamming space, see "Fast Exact Search in Hamming Space with Multi-Index
+// Hashing", M. Norouzi et al., TPAMI 2014. The descriptors are split into
+// 16-bit substrings, each of which is indexed by a separate hash table. Two
+// descriptors within a Hamming distance r differ in at most r / m bits in at
+// least one of their m substrings, so probing all substrings within that
+// radius finds all descriptors within the distance r.
+class BinaryMultiIndexHash : public FeatureDescriptorIndex {
+ public:
+  explicit BinaryMultiIndexHash(
+      std::shared_ptr<const FeatureDescriptors> descriptors);
+
+  // Finds the best and second best descriptors of the query. Both are exact,
+  // if their distances are at most max_dist. Otherwise, the distances are
+  // those of descriptors further than max_dist or the maximum integer value.
+  void Search(const uint8_t* query,
+              int max_dist,
+              BinaryBestHammingDistances* best) const;
+
+  const FeatureDescriptors& Descriptors() const { return *descriptors_; }
+
+  size_t NumBytes() const override;
+
+ private:
+  static constexpr int kNumSubstringBits = 16;
+
+  const std::shared_ptr<const FeatureDescriptors> descriptors_;
+  int num_substrings_ = 0;
+  uint32_t bucket_mask_ = 0;
+  // The substring values and indices of the descriptors, whose substring s
+  // falls into bucket b, are stored in the range
+  // [bucket_offsets_[s][b], bucket_offsets_[s][b + 1]).
+  std::vector<std::vector<int>> bucket_offsets_;
+  std::vector<std::vector<uint16_t>> bucket_values_;
+  std::vector<std::vector<int>> bucket_idxs_;
+};
+
+}  // namespace colmap
@@ -0,0 +1,310 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/feature/binary.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+// Random grey squares produce many corners at their junctions.
+void CreateImageWithRandomSquares(const int size, Bitmap* bitmap) {
+  constexpr int kSquareSize = 8;
+  std::mt19937 prng(42);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  bitmap->Allocate(size, size, false);
+  std::vector<uint8_t> square_values(size * size / (kSquareSize * kSquareSize));
+  for (uint8_t& value : square_values) {
+    value = static_cast<uint8_t>(distribution(prng));
+  }
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      bitmap->SetPixel(
+          x,
+          y,
+          BitmapColor<uint8_t>(
+              square_values[(y / kSquareSize) * (size / kSquareSize) +
+                            x / kSquareSize]));
+    }
+  }
+}
+
+// Rotates the image by 90 degrees in clockwise direction, such that the
+// point (x, y) maps to (height - y, x).
+Bitmap RotateImage(const Bitmap& bitmap) {
+  Bitmap rotated_bitmap;
+  rotated_bitmap.Allocate(bitmap.Height(), bitmap.Width(), false);
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    for (int x = 0; x < bitmap.Width(); ++x) {
+      BitmapColor<uint8_t> color;
+      bitmap.GetPixel(x, y, &color);
+      rotated_bitmap.SetPixel(bitmap.Height() - 1 - y, x, color);
+    }
+  }
+  return rotated_bitmap;
+}
+
+FeatureDescriptors CreateRandomDescriptors(const int num_descriptors,
+                                           std::mt19937* prng) {
+  std::uniform_int_distribution<int> distribution(0, 255);
+  FeatureDescriptors descriptors(num_descriptors, 32);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = static_cast<uint8_t>(distribution(*prng));
+  }
+  return descriptors;
+}
+
+// Flips the given number of random bits of each descriptor.
+FeatureDescriptors FlipRandomBits(const FeatureDescriptors& descriptors,
+                                  const int num_bits,
+                                  std::mt19937* prng) {
+  std::uniform_int_distribution<int> distribution(0, 8 * descriptors.cols() - 1);
+  FeatureDescriptors flipped_descriptors = descriptors;
+  for (FeatureDescriptors::Index i = 0; i < descriptors.rows(); ++i) {
+    for (int k = 0; k < num_bits; ++k) {
+      const int bit = distribution(*prng);
+      flipped_descriptors(i, bit / 8) ^= static_cast<uint8_t>(1 << (bit % 8));
+    }
+  }
+  return flipped_descriptors;
+}
+
+TEST(ExtractBinaryFeatures, Nominal) {
+  Bitmap bitmap;
+  CreateImageWithRandomSquares(256, &bitmap);
+
+  BinaryExtractionOptions options;
+  options.max_num_features = 500;
+  auto extractor = CreateBinaryFeatureExtractor(options);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+
+  EXPECT_GT(keypoints.size(), 100);
+  EXPECT_LE(keypoints.size(), options.max_num_features);
+  EXPECT_EQ(descriptors.rows(), keypoints.size());
+  EXPECT_EQ(descriptors.cols(), 32);
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    EXPECT_GE(keypoints[i].x, 0);
+    EXPECT_GE(keypoints[i].y, 0);
+    EXPECT_LE(keypoints[i].x, bitmap.Width());
+    EXPECT_LE(keypoints[i].y, bitmap.Height());
+    EXPECT_GT(keypoints[i].ComputeScale(), 0);
+    EXPECT_GE(keypoints[i].ComputeOrientation(), -M_PI);
+    EXPECT_LE(keypoints[i].ComputeOrientation(), M_PI);
+  }
+
+  // The extraction is deterministic.
+  FeatureKeypoints keypoints2;
+  FeatureDescriptors descriptors2;
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints2, &descriptors2));
+  EXPECT_EQ(keypoints2.size(), keypoints.size());
+  EXPECT_EQ(descriptors2, descriptors);
+}
+
+TEST(ExtractBinaryFeatures, EmptyImage) {
+  Bitmap bitmap;
+  bitmap.Allocate(16, 16, false);
+  bitmap.Fill(BitmapColor<uint8_t>(0));
+  auto extractor = CreateBinaryFeatureExtractor(BinaryExtractionOptions());
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+  EXPECT_EQ(keypoints.size(), 0);
+  EXPECT_EQ(descriptors.rows(), 0);
+}
+
+TEST(ExtractBinaryFeatures, RotationInvariance) {
+  Bitmap bitmap;
+  CreateImageWithRandomSquares(256, &bitmap);
+  const Bitmap rotated_bitmap = RotateImage(bitmap);
+
+  BinaryExtractionOptions options;
+  options.max_num_features = 500;
+  auto extractor = CreateBinaryFeatureExtractor(options);
+  auto keypoints1 = std::make_shared<FeatureKeypoints>();
+  auto keypoints2 = std::make_shared<FeatureKeypoints>();
+  auto descriptors1 = std::make_shared<FeatureDescriptors>();
+  auto descriptors2 = std::make_shared<FeatureDescriptors>();
+  EXPECT_TRUE(extractor->Extract(bitmap, keypoints1.get(), descriptors1.get()));
+  EXPECT_TRUE(
+      extractor->Extract(rotated_bitmap, keypoints2.get(), descriptors2.get()));
+
+  auto matcher = CreateBinaryFeatureMatcher(BinaryMatchingOptions());
+  FeatureMatches matches;
+  matcher->Match(descriptors1, descriptors2, &matches);
+  EXPECT_GT(matches.size(), keypoints1->size() / 2);
+
+  size_t num_correct_matches = 0;
+  for (const FeatureMatch& match : matches) {
+    const FeatureKeypoint& keypoint1 = (*keypoints1)[match.point2D_idx1];
+    const FeatureKeypoint& keypoint2 = (*keypoints2)[match.point2D_idx2];
+    if (std::abs(keypoint2.x - (bitmap.Height() - keypoint1.y)) < 2 &&
+        std::abs(keypoint2.y - keypoint1.x) < 2) {
+      ++num_correct_matches;
+    }
+  }
+  EXPECT_GT(num_correct_matches, 0.9 * matches.size());
+}
+
+TEST(BinaryCPUFeatureMatcher, Nominal) {
+  std::mt19937 prng(42);
+  auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(CreateRandomDescriptors(100, &prng));
+  auto descriptors2 = std::make_shared<FeatureDescriptors>(
+      FlipRandomBits(*descriptors1, 10, &prng));
+
+  for (const bool multi_index_hashing : {false, true}) {
+    BinaryMatchingOptions options;
+    options.multi_index_hashing = multi_index_hashing;
+    auto matcher = CreateBinaryFeatureMatcher(options);
+    FeatureMatches matches;
+    matcher->Match(descriptors1, descriptors2, &matches);
+    ASSERT_EQ(matches.size(), 100);
+    for (size_t i = 0; i < matches.size(); ++i) {
+      EXPECT_EQ(matches[i].point2D_idx1, i);
+      EXPECT_EQ(matches[i].point2D_idx2, i);
+    }
+
+    // Cached descriptors of both images.
+    matcher->Match(nullptr, nullptr, &matches);
+    EXPECT_EQ(matches.size(), 100);
+
+    auto empty_descriptors = std::make_shared<FeatureDescriptors>(0, 32);
+    matcher->Match(empty_descriptors, descriptors2, &matches);
+    EXPECT_EQ(matches.size(), 0);
+  }
+}
+
+TEST(BinaryCPUFeatureMatcher, MultiIndexHashingVsBruteForce) {
+  std::mt19937 prng(42);
+  const FeatureDescriptors random_descriptors =
+      CreateRandomDescriptors(2000, &prng);
+  // Half of the descriptors have a close counterpart at different distances
+  // around the maximum Hamming distance and the rest is random.
+  FeatureDescriptors descriptors2_data = random_descriptors;
+  for (int i = 0; i < 1000; ++i) {
+    descriptors2_data.row(i) =
+        FlipRandomBits(random_descriptors.row(i), i % 80, &prng);
+  }
+  descriptors2_data.bottomRows(1000) = CreateRandomDescriptors(1000, &prng);
+  auto descriptors1 = std::make_shared<FeatureDescriptors>(random_descriptors);
+  auto descriptors2 = std::make_shared<FeatureDescriptors>(descriptors2_data);
+
+  for (const bool cross_check : {false, true}) {
+    BinaryMatchingOptions options;
+    options.cross_check = cross_check;
+    options.max_hamming_distance = 48;
+    auto brute_force_matcher = CreateBinaryFeatureMatcher(options);
+    FeatureMatches brute_force_matches;
+    brute_force_matcher->Match(
+        descriptors1, descriptors2, &brute_force_matches);
+    EXPECT_GT(brute_force_matches.size(), 0);
+
+    options.multi_index_hashing = true;
+    auto hashing_matcher = CreateBinaryFeatureMatcher(options);
+    // Pre-built indices as shared by the feature matcher cache.
+    hashing_matcher->SetDescriptorIndices(
+        hashing_matcher->CreateDescriptorIndex(descriptors1),
+        hashing_matcher->CreateDescriptorIndex(descriptors2));
+    FeatureMatches hashing_matches;
+    hashing_matcher->Match(descriptors1, descriptors2, &hashing_matches);
+
+    ASSERT_EQ(hashing_matches.size(), brute_force_matches.size());
+    for (size_t i = 0; i < hashing_matches.size(); ++i) {
+      EXPECT_EQ(hashing_matches[i].point2D_idx1,
+                brute_force_matches[i].point2D_idx1);
+      EXPECT_EQ(hashing_matches[i].point2D_idx2,
+                brute_force_matches[i].point2D_idx2);
+    }
+  }
+}
+
+TEST(BinaryMultiIndexHash, Search) {
+  std::mt19937 prng(42);
+  auto descriptors =
+      std::make_shared<FeatureDescriptors>(CreateRandomDescriptors(500, &prng));
+  const BinaryMultiIndexHash index(descriptors);
+  EXPECT_GT(index.NumBytes(), 0);
+  for (const int num_flipped_bits : {0, 5, 20}) {
+    const FeatureDescriptors queries =
+        FlipRandomBits(*descriptors, num_flipped_bits, &prng);
+    for (FeatureDescriptors::Index i = 0; i < queries.rows(); ++i) {
+      BinaryBestHammingDistances best;
+      index.Search(queries.row(i).data(), 32, &best);
+      EXPECT_EQ(best.best_idx, i);
+      EXPECT_LE(best.best_dist, num_flipped_bits);
+      // Random descriptors differ by about half of their bits.
+      EXPECT_GT(best.second_best_dist, 32);
+    }
+  }
+}
+
+TEST(MatchGuidedBinaryFeatures, Nominal) {
+  std::mt19937 prng(42);
+  auto keypoints1 = std::make_shared<FeatureKeypoints>();
+  auto keypoints2 = std::make_shared<FeatureKeypoints>();
+  for (int i = 0; i < 4; ++i) {
+    keypoints1->emplace_back(i * 10, 0);
+    keypoints2->emplace_back(i * 10 + 1, 0);
+  }
+  // The descriptors of the last two keypoints are swapped in the second
+  // image, such that only guided matching finds the correct matches.
+  auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(CreateRandomDescriptors(4, &prng));
+  auto descriptors2 = std::make_shared<FeatureDescriptors>(*descriptors1);
+  descriptors2->row(2) = descriptors1->row(3);
+  descriptors2->row(3) = descriptors1->row(2);
+
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+  two_view_geometry.H = Eigen::Matrix3d::Identity();
+  two_view_geometry.H(0, 2) = 1;
+
+  auto matcher = CreateBinaryFeatureMatcher(BinaryMatchingOptions());
+  matcher->MatchGuided(/*max_error=*/1,
+                       keypoints1,
+                       keypoints2,
+                       descriptors1,
+                       descriptors2,
+                       &two_view_geometry);
+  ASSERT_EQ(two_view_geometry.inlier_matches.size(), 2);
+  EXPECT_EQ(two_view_geometry.inlier_matches[0].point2D_idx1, 0);
+  EXPECT_EQ(two_view_geometry.inlier_matches[0].point2D_idx2, 0);
+  EXPECT_EQ(two_view_geometry.inlier_matches[1].point2D_idx1, 1);
+  EXPECT_EQ(two_view_geometry.inlier_matches[1].point2D_idx2, 1);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -0,0 +1,879 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/feature/descriptor_kernels.h"
+
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+
+#if defined(COLMAP_SIMD_ENABLED) && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define COLMAP_SIFT_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(COLMAP_SIMD_ENABLED) && defined(__aarch64__) && \
+    defined(__ARM_NEON)
+#define COLMAP_SIFT_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace colmap {
+namespace {
+
+constexpr int kSiftDim = 128;
+
+typedef void (*SiftDotProductsFunc)(const uint8_t* query,
+                                    const uint8_t* refs,
+                                    int num_refs,
+                                    int* dots);
+
+void ComputeSiftDotProductsScalar(const uint8_t* query,
+                                  const uint8_t* refs,
+                                  const int num_refs,
+                                  int* dots) {
+  for (int r = 0; r < num_refs; ++r) {
+    const uint8_t* ref = refs + r * kSiftDim;
+    int dot = 0;
+    for (int d = 0; d < kSiftDim; ++d) {
+      dot += static_cast<int>(query[d]) * static_cast<int>(ref[d]);
+    }
+    dots[r] = dot;
+  }
+}
+
+#if defined(COLMAP_SIFT_KERNELS_X86)
+
+// The query is widened to 16-bit integers only once and then stays resident in
+// registers for all references. The products of two uint8 values do not fit
+// into int16 but the pairwise sums of madd are computed in int32.
+__attribute__((target("avx2"))) void ComputeSiftDotProductsAVX2(
+    const uint8_t* query, const uint8_t* refs, const int num_refs, int* dots) {
+  __m256i query16[8];
+  for (int k = 0; k < 8; ++k) {
+    query16[k] = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(query + 16 * k)));
+  }
+
+  for (int r = 0; r < num_refs; ++r) {
+    const uint8_t* ref = refs + r * kSiftDim;
+    __m256i acc = _mm256_setzero_si256();
+    for (int k = 0; k < 8; ++k) {
+      const __m256i ref16 = _mm256_cvtepu8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + 16 * k)));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(query16[k], ref16));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                                _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    dots[r] = _mm_cvtsi128_si32(sum);
+  }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) void
+ComputeSiftDotProductsAVX512VNNI(const uint8_t* query,
+                                 const uint8_t* refs,
+                                 const int num_refs,
+                                 int* dots) {
+  __m512i query16[4];
+  for (int k = 0; k < 4; ++k) {
+    query16[k] = _mm512_cvtepu8_epi16(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query + 32 * k)));
+  }
+
+  for (int r = 0; r < num_refs; ++r) {
+    const uint8_t* ref = refs + r * kSiftDim;
+    __m512i acc = _mm512_setzero_si512();
+    for (int k = 0; k < 4; ++k) {
+      const __m512i ref16 = _mm512_cvtepu8_epi16(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ref + 32 * k)));
+      acc = _mm512_dpwssd_epi32(acc, query16[k], ref16);
+    }
+    dots[r] = _mm512_reduce_add_epi32(acc);
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_X86
+
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+
+void ComputeSiftDotProductsNEON(const uint8_t* query,
+                                const uint8_t* refs,
+                                const int num_refs,
+                                int* dots) {
+  uint8x16_t query8[8];
+  for (int k = 0; k < 8; ++k) {
+    query8[k] = vld1q_u8(query + 16 * k);
+  }
+
+  for (int r = 0; r < num_refs; ++r) {
+    const uint8_t* ref = refs + r * kSiftDim;
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (int k = 0; k < 8; ++k) {
+      const uint8x16_t ref8 = vld1q_u8(ref + 16 * k);
+      acc = vpadalq_u16(acc,
+                        vmull_u8(vget_low_u8(query8[k]), vget_low_u8(ref8)));
+      acc = vpadalq_u16(acc,
+                        vmull_u8(vget_high_u8(query8[k]), vget_high_u8(ref8)));
+    }
+    dots[r] = static_cast<int>(vaddvq_u32(acc));
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_NEON
+
+typedef void (*SiftPCADotProductsFunc)(const uint8_t* query,
+                                       const uint8_t* refs,
+                                       int num_refs,
+                                       int num_dims,
+                                       int* dots);
+
+// The reduced descriptors are signed bytes stored in unsigned containers.
+void ComputeSiftPCADotProductsScalar(const uint8_t* query,
+                                     const uint8_t* refs,
+                                     const int num_refs,
+                                     const int num_dims,
+                                     int* dots) {
+  const int8_t* query8 = reinterpret_cast<const int8_t*>(query);
+  for (int r = 0; r < num_refs; ++r) {
+    const int8_t* ref8 = reinterpret_cast<const int8_t*>(refs + r * num_dims);
+    int dot = 0;
+    for (int d = 0; d < num_dims; ++d) {
+      dot += static_cast<int>(query8[d]) * static_cast<int>(ref8[d]);
+    }
+    dots[r] = dot;
+  }
+}
+
+#if defined(COLMAP_SIFT_KERNELS_X86)
+
+// Same as the full SIFT kernel with sign instead of zero extension. The
+// quantized values are within [-127, 127], so their products fit into int16.
+__attribute__((target("avx2"))) void ComputeSiftPCADotProductsAVX2(
+    const uint8_t* query,
+    const uint8_t* refs,
+    const int num_refs,
+    const int num_dims,
+    int* dots) {
+  const int num_blocks = num_dims / 16;
+  __m256i query16[8];
+  for (int k = 0; k < num_blocks; ++k) {
+    query16[k] = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(query + 16 * k)));
+  }
+
+  for (int r = 0; r < num_refs; ++r) {
+    const uint8_t* ref = refs + r * num_dims;
+    __m256i acc = _mm256_setzero_si256();
+    for (int k = 0; k < num_blocks; ++k) {
+      const __m256i ref16 = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + 16 * k)));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(query16[k], ref16));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                                _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    dots[r] = _mm_cvtsi128_si32(sum);
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_X86
+
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+
+void ComputeSiftPCADotProductsNEON(const uint8_t* query,
+                                   const uint8_t* refs,
+                                   const int num_refs,
+                                   const int num_dims,
+                                   int* dots) {
+  const int num_blocks = num_dims / 16;
+  int8x16_t query8[8];
+  for (int k = 0; k < num_blocks; ++k) {
+    query8[k] = vld1q_s8(reinterpret_cast<const int8_t*>(query + 16 * k));
+  }
+
+  for (int r = 0; r < num_refs; ++r) {
+    const int8_t* ref = reinterpret_cast<const int8_t*>(refs + r * num_dims);
+    int32x4_t acc = vdupq_n_s32(0);
+    for (int k = 0; k < num_blocks; ++k) {
+      const int8x16_t ref8 = vld1q_s8(ref + 16 * k);
+      acc = vpadalq_s16(acc,
+                        vmull_s8(vget_low_s8(query8[k]), vget_low_s8(ref8)));
+      acc = vpadalq_s16(acc,
+                        vmull_s8(vget_high_s8(query8[k]), vget_high_s8(ref8)));
+    }
+    dots[r] = vaddvq_s32(acc);
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_NEON
+
+typedef void (*HammingDistancesFunc)(const uint8_t* query,
+                                     const uint8_t* refs,
+                                     int num_refs,
+                                     int num_bytes,
+                                     int* dists);
+
+// Hamming distance of the bytes [begin, end) of two descriptors, which are
+// processed in 64-bit words.
+inline int ComputeHammingDistanceScalar(const uint8_t* descriptor1,
+                                        const uint8_t* descriptor2,
+                                        const int begin,
+                                        const int end) {
+  int dist = 0;
+  for (int k = begin; k < end; k += 8) {
+    uint64_t word1;
+    uint64_t word2;
+    std::memcpy(&word1, descriptor1 + k, 8);
+    std::memcpy(&word2, descriptor2 + k, 8);
+    dist += static_cast<int>(std::bitset<64>(word1 ^ word2).count());
+  }
+  return dist;
+}
+
+void ComputeHammingDistancesScalar(const uint8_t* query,
+                                   const uint8_t* refs,
+                                   const int num_refs,
+                                   const int num_bytes,
+                                   int* dists) {
+  for (int r = 0; r < num_refs; ++r) {
+    dists[r] = ComputeHammingDistanceScalar(
+        query, refs + r * num_bytes, 0, num_bytes);
+  }
+}
+
+#if defined(COLMAP_SIFT_KERNELS_X86)
+
+// Counts the bits of 32 bytes at a time by looking up the counts of the low
+// and high nibbles with pshufb. The per-byte counts are summed with psadbw,
+// which directly yields four 64-bit partial sums without overflow.
+__attribute__((target("avx2"))) void ComputeHammingDistancesAVX2(
+    const uint8_t* query,
+    const uint8_t* refs,
+    const int num_refs,
+    const int num_bytes,
+    int* dists) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  const int num_vector_bytes = num_bytes - num_bytes % 32;
+
+  for (int r = 0; r < num_refs; ++r) {
+    const uint8_t* ref = refs + r * num_bytes;
+    __m256i acc = _mm256_setzero_si256();
+    for (int k = 0; k < num_vector_bytes; k += 32) {
+      const __m256i bits = _mm256_xor_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query + k)),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ref + k)));
+      const __m256i counts = _mm256_add_epi8(
+          _mm256_shuffle_epi8(lookup, _mm256_and_si256(bits, low_mask)),
+          _mm256_shuffle_epi8(
+              lookup, _mm256_and_si256(_mm256_srli_epi16(bits, 4), low_mask)));
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(counts, zero));
+    }
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                                _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+    dists[r] = _mm_cvtsi128_si32(sum) +
+               ComputeHammingDistanceScalar(
+                   query, ref, num_vector_bytes, num_bytes);
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_X86
+
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+
+void ComputeHammingDistancesNEON(const uint8_t* query,
+                                 const uint8_t* refs,
+                                 const int num_refs,
+                                 const int num_bytes,
+                                 int* dists) {
+  const int num_vector_bytes = num_bytes - num_bytes % 16;
+
+  for (int r = 0; r < num_refs; ++r) {
+    const uint8_t* ref = refs + r * num_bytes;
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (int k = 0; k < num_vector_bytes; k += 16) {
+      acc = vpadalq_u8(
+          acc, vcntq_u8(veorq_u8(vld1q_u8(query + k), vld1q_u8(ref + k))));
+    }
+    dists[r] = static_cast<int>(vaddlvq_u16(acc)) +
+               ComputeHammingDistanceScalar(
+                   query, ref, num_vector_bytes, num_bytes);
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_NEON
+
+typedef void (*SiftNormalizeAndQuantizeFunc)(const float* descriptor,
+                                             bool l1_root,
+                                             uint8_t* quantized);
+
+// Matches std::round for non-negative values, i.e., rounds half away from
+// zero. The fractional part x - trunc(x) is computed exactly in float.
+inline float RoundHalfAwayFromZero(const float x) {
+  const float t = std::trunc(x);
+  return (x - t >= 0.5f) ? t + 1.0f : t;
+}
+
+inline uint8_t QuantizeSiftValue(const float value) {
+  const float rounded = RoundHalfAwayFromZero(512.0f * value);
+  if (!(rounded > 0.0f)) {
+    return 0;
+  } else if (rounded >= 255.0f) {
+    return 255;
+  }
+  return static_cast<uint8_t>(rounded);
+}
+
+void NormalizeAndQuantizeSiftDescriptorScalar(const float* descriptor,
+                                              const bool l1_root,
+                                              uint8_t* quantized) {
+  float norm = 0.0f;
+  if (l1_root) {
+    for (int d = 0; d < kSiftDim; ++d) {
+      norm += std::abs(descriptor[d]);
+    }
+  } else {
+    for (int d = 0; d < kSiftDim; ++d) {
+      norm += descriptor[d] * descriptor[d];
+    }
+    norm = std::sqrt(norm);
+  }
+
+  if (norm <= 0.0f) {
+    std::fill(quantized, quantized + kSiftDim, 0);
+    return;
+  }
+
+  if (l1_root) {
+    const float inv_norm = 1.0f / norm;
+    for (int d = 0; d < kSiftDim; ++d) {
+      quantized[d] = QuantizeSiftValue(std::sqrt(descriptor[d] * inv_norm));
+    }
+  } else {
+    for (int d = 0; d < kSiftDim; ++d) {
+      quantized[d] = QuantizeSiftValue(descriptor[d] / norm);
+    }
+  }
+}
+
+#if defined(COLMAP_SIFT_KERNELS_X86)
+
+__attribute__((target("avx2,fma"))) inline float HorizontalSumAVX2(
+    const __m256 v) {
+  __m128 sum =
+      _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+  return _mm_cvtss_f32(sum);
+}
+
+// The descriptor is loaded into registers once and stays resident between the
+// norm computation and the quantization. Rounding and saturation follow the
+// scalar kernel exactly, so only the summation order of the norm differs.
+__attribute__((target("avx2,fma"))) void
+NormalizeAndQuantizeSiftDescriptorAVX2(const float* descriptor,
+                                       const bool l1_root,
+                                       uint8_t* quantized) {
+  __m256 values[16];
+  __m256 acc = _mm256_setzero_ps();
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  for (int k = 0; k < 16; ++k) {
+    values[k] = _mm256_loadu_ps(descriptor + 8 * k);
+    if (l1_root) {
+      acc = _mm256_add_ps(acc, _mm256_and_ps(values[k], abs_mask));
+    } else {
+      acc = _mm256_fmadd_ps(values[k], values[k], acc);
+    }
+  }
+
+  float norm = HorizontalSumAVX2(acc);
+  if (!l1_root) {
+    norm = std::sqrt(norm);
+  }
+
+  if (norm <= 0.0f) {
+    std::fill(quantized, quantized + kSiftDim, 0);
+    return;
+  }
+
+  const __m256 norm8 = _mm256_set1_ps(l1_root ? 1.0f / norm : norm);
+  const __m256 scale8 = _mm256_set1_ps(512.0f);
+  const __m256 half8 = _mm256_set1_ps(0.5f);
+  const __m256 one8 = _mm256_set1_ps(1.0f);
+  const __m256 zero8 = _mm256_setzero_ps();
+  const __m256 max8 = _mm256_set1_ps(255.0f);
+  for (int k = 0; k < 16; k += 2) {
+    __m256i rounded[2];
+    for (int j = 0; j < 2; ++j) {
+      __m256 value;
+      if (l1_root) {
+        value = _mm256_sqrt_ps(_mm256_mul_ps(values[k + j], norm8));
+      } else {
+        value = _mm256_div_ps(values[k + j], norm8);
+      }
+      value = _mm256_mul_ps(value, scale8);
+      const __m256 trunc =
+          _mm256_round_ps(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+      const __m256 round_up =
+          _mm256_cmp_ps(_mm256_sub_ps(value, trunc), half8, _CMP_GE_OQ);
+      value = _mm256_add_ps(trunc, _mm256_and_ps(round_up, one8));
+      // The max with zero as the second operand also maps NaN to zero.
+      value = _mm256_min_ps(_mm256_max_ps(value, zero8), max8);
+      rounded[j] = _mm256_cvttps_epi32(value);
+    }
+    // Pack 16 int32 values to 16 uint8 values. The packs operate per 128-bit
+    // lane, so the result needs to be permuted back into order.
+    const __m256i packed16 = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(rounded[0], rounded[1]), _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128i packed8 =
+        _mm_packus_epi16(_mm256_castsi256_si128(packed16),
+                         _mm256_extracti128_si256(packed16, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(quantized + 8 * k), packed8);
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_X86
+
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+
+void NormalizeAndQuantizeSiftDescriptorNEON(const float* descriptor,
+                                            const bool l1_root,
+                                            uint8_t* quantized) {
+  float32x4_t values[32];
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  for (int k = 0; k < 32; ++k) {
+    values[k] = vld1q_f32(descriptor + 4 * k);
+    if (l1_root) {
+      acc = vaddq_f32(acc, vabsq_f32(values[k]));
+    } else {
+      acc = vfmaq_f32(acc, values[k], values[k]);
+    }
+  }
+
+  float norm = vaddvq_f32(acc);
+  if (!l1_root) {
+    norm = std::sqrt(norm);
+  }
+
+  if (norm <= 0.0f) {
+    std::fill(quantized, quantized + kSiftDim, 0);
+    return;
+  }
+
+  const float32x4_t norm4 = vdupq_n_f32(l1_root ? 1.0f / norm : norm);
+  const float32x4_t half4 = vdupq_n_f32(0.5f);
+  const float32x4_t one4 = vdupq_n_f32(1.0f);
+  const float32x4_t max4 = vdupq_n_f32(255.0f);
+  for (int k = 0; k < 32; k += 4) {
+    uint16x4_t rounded[4];
+    for (int j = 0; j < 4; ++j) {
+      float32x4_t value;
+      if (l1_root) {
+        value = vsqrtq_f32(vmulq_f32(values[k + j], norm4));
+      } else {
+        value = vdivq_f32(values[k + j], norm4);
+      }
+      value = vmulq_n_f32(value, 512.0f);
+      const float32x4_t trunc = vrndq_f32(value);
+      const uint32x4_t round_up = vcgeq_f32(vsubq_f32(value, trunc), half4);
+      value = vaddq_f32(
+          trunc,
+          vreinterpretq_f32_u32(
+              vandq_u32(round_up, vreinterpretq_u32_f32(one4))));
+      // The float to unsigned conversion saturates negative values and NaN
+      // to zero.
+      rounded[j] = vmovn_u32(vcvtq_u32_f32(vminq_f32(value, max4)));
+    }
+    const uint8x8_t low = vmovn_u16(vcombine_u16(rounded[0], rounded[1]));
+    const uint8x8_t high = vmovn_u16(vcombine_u16(rounded[2], rounded[3]));
+    vst1q_u8(quantized + 4 * k, vcombine_u8(low, high));
+  }
+}
+
+#endif  // COLMAP_SIFT_KERNELS_NEON
+
+SiftDotProductsFunc GetSiftDotProductsFunc(const SiftKernelISA isa) {
+  THROW_CHECK(IsSiftKernelISASupported(isa))
+      << SiftKernelISAToString(isa) << " not supported";
+  switch (isa) {
+#if defined(COLMAP_SIFT_KERNELS_X86)
+    case SiftKernelISA::AVX2:
+      return &ComputeSiftDotProductsAVX2;
+    case SiftKernelISA::AVX512_VNNI:
+      return &ComputeSiftDotProductsAVX512VNNI;
+#endif  // COLMAP_SIFT_KERNELS_X86
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+    case SiftKernelISA::NEON:
+      return &ComputeSiftDotProductsNEON;
+#endif  // COLMAP_SIFT_KERNELS_NEON
+    default:
+      return &ComputeSiftDotProductsScalar;
+  }
+}
+
+SiftPCADotProductsFunc GetSiftPCADotProductsFunc(const SiftKernelISA isa) {
+  THROW_CHECK(IsSiftKernelISASupported(isa))
+      << SiftKernelISAToString(isa) << " not supported";
+  switch (isa) {
+#if defined(COLMAP_SIFT_KERNELS_X86)
+    // The reduced descriptors are not necessarily a multiple of 32 bytes long,
+    // which the 512-bit kernel would require.
+    case SiftKernelISA::AVX2:
+    case SiftKernelISA::AVX512_VNNI:
+      return &ComputeSiftPCADotProductsAVX2;
+#endif  // COLMAP_SIFT_KERNELS_X86
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+    case SiftKernelISA::NEON:
+      return &ComputeSiftPCADotProductsNEON;
+#endif  // COLMAP_SIFT_KERNELS_NEON
+    default:
+      return &ComputeSiftPCADotProductsScalar;
+  }
+}
+
+HammingDistancesFunc GetHammingDistancesFunc(const SiftKernelISA isa) {
+  THROW_CHECK(IsSiftKernelISASupported(isa))
+      << SiftKernelISAToString(isa) << " not supported";
+  switch (isa) {
+#if defined(COLMAP_SIFT_KERNELS_X86)
+    // VNNI does not accelerate bit counting and the AVX-512 population count
+    // extension is not implied by it.
+    case SiftKernelISA::AVX2:
+    case SiftKernelISA::AVX512_VNNI:
+      return &ComputeHammingDistancesAVX2;
+#endif  // COLMAP_SIFT_KERNELS_X86
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+    case SiftKernelISA::NEON:
+      return &ComputeHammingDistancesNEON;
+#endif  // COLMAP_SIFT_KERNELS_NEON
+    default:
+      return &ComputeHammingDistancesScalar;
+  }
+}
+
+SiftNormalizeAndQuantizeFunc GetSiftNormalizeAndQuantizeFunc(
+    const SiftKernelISA isa) {
+  THROW_CHECK(IsSiftKernelISASupported(isa))
+      << SiftKernelISAToString(isa) << " not supported";
+  switch (isa) {
+#if defined(COLMAP_SIFT_KERNELS_X86)
+    // The floating point kernels do not benefit from VNNI and AVX-512 implies
+    // AVX2 support on all relevant CPUs.
+    case SiftKernelISA::AVX2:
+    case SiftKernelISA::AVX512_VNNI:
+      return &NormalizeAndQuantizeSiftDescriptorAVX2;
+#endif  // COLMAP_SIFT_KERNELS_X86
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+    case SiftKernelISA::NEON:
+      return &NormalizeAndQuantizeSiftDescriptorNEON;
+#endif  // COLMAP_SIFT_KERNELS_NEON
+    default:
+      return &NormalizeAndQuantizeSiftDescriptorScalar;
+  }
+}
+
+inline void UpdateSiftBestDotProducts(const int idx,
+                                      const int dot,
+                                      SiftBestDotProducts* best) {
+  if (dot > best->best_dot) {
+    best->best_idx = idx;
+    best->second_best_dot = best->best_dot;
+    best->best_dot = dot;
+  } else if (dot > best->second_best_dot) {
+    best->second_best_dot = dot;
+  }
+}
+
+inline void UpdateBinaryBestHammingDistances(
+    const int idx, const int dist, BinaryBestHammingDistances* best) {
+  if (dist < best->best_dist) {
+    best->best_idx = idx;
+    best->second_best_dist = best->best_dist;
+    best->best_dist = dist;
+  } else if (dist < best->second_best_dist) {
+    best->second_best_dist = dist;
+  }
+}
+
+// The reference descriptors are processed in blocks of 32KB that remain in
+// the L1/L2 cache while all query descriptors are scanned against them. The
+// blocks are visited in order, so that ties are resolved in the same way as
+// in a row-by-row scan over the full distance matrix.
+template <typename DotProductsFunc>
+void FindBestDotProductsBlocked(const FeatureDescriptors& descriptors1,
+                                const FeatureDescriptors& descriptors2,
+                                const DotProductsFunc& dot_products_func,
+                                std::vector<SiftBestDotProducts>* best12,
+                                std::vector<SiftBestDotProducts>* best21) {
+  THROW_CHECK_NOTNULL(best12);
+
+  const int num_dims = descriptors1.cols();
+  const int num_descriptors1 = descriptors1.rows();
+  const int num_descriptors2 = descriptors2.rows();
+
+  best12->assign(num_descriptors1, SiftBestDotProducts());
+  if (best21 != nullptr) {
+    best21->assign(num_descriptors2, SiftBestDotProducts());
+  }
+
+  if (num_descriptors1 == 0 || num_descriptors2 == 0) {
+    return;
+  }
+
+  const int block_size = (32 * 1024) / num_dims;
+  std::vector<int> dots(block_size);
+
+  for (int block_begin = 0; block_begin < num_descriptors2;
+       block_begin += block_size) {
+    const int num_refs = std::min(block_size, num_descriptors2 - block_begin);
+    const uint8_t* refs = descriptors2.data() + block_begin * num_dims;
+    for (int i1 = 0; i1 < num_descriptors1; ++i1) {
+      dot_products_func(
+          descriptors1.data() + i1 * num_dims, refs, num_refs, dots.data());
+      SiftBestDotProducts& best1 = (*best12)[i1];
+      for (int j = 0; j < num_refs; ++j) {
+        UpdateSiftBestDotProducts(block_begin + j, dots[j], &best1);
+      }
+      if (best21 != nullptr) {
+        for (int j = 0; j < num_refs; ++j) {
+          UpdateSiftBestDotProducts(
+              i1, dots[j], &(*best21)[block_begin + j]);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+std::string SiftKernelISAToString(const SiftKernelISA isa) {
+  switch (isa) {
+    case SiftKernelISA::SCALAR:
+      return "SCALAR";
+    case SiftKernelISA::AVX2:
+      return "AVX2";
+    case SiftKernelISA::AVX512_VNNI:
+      return "AVX512_VNNI";
+    case SiftKernelISA::NEON:
+      return "NEON";
+  }
+  return "UNKNOWN";
+}
+
+bool IsSiftKernelISASupported(const SiftKernelISA isa) {
+  switch (isa) {
+    case SiftKernelISA::SCALAR:
+      return true;
+#if defined(COLMAP_SIFT_KERNELS_X86)
+    case SiftKernelISA::AVX2:
+      return __builtin_cpu_supports("avx2");
+    case SiftKernelISA::AVX512_VNNI:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512bw") &&
+             __builtin_cpu_supports("avx512vnni");
+#endif  // COLMAP_SIFT_KERNELS_X86
+#if defined(COLMAP_SIFT_KERNELS_NEON)
+    case SiftKernelISA::NEON:
+      return true;
+#endif  // COLMAP_SIFT_KERNELS_NEON
+    default:
+      return false;
+  }
+}
+
+SiftKernelISA GetBestSiftKernelISA() {
+  static const SiftKernelISA kBestISA = []() {
+    for (const SiftKernelISA isa : {SiftKernelISA::AVX512_VNNI,
+                                    SiftKernelISA::AVX2,
+                                    SiftKernelISA::NEON}) {
+      if (IsSiftKernelISASupported(isa)) {
+        return isa;
+      }
+    }
+    return SiftKernelISA::SCALAR;
+  }();
+  return kBestISA;
+}
+
+void ComputeSiftDotProducts(const uint8_t* query,
+                            const uint8_t* refs,
+                            const int num_refs,
+                            int* dots,
+                            const SiftKernelISA isa) {
+  GetSiftDotProductsFunc(isa)(query, refs, num_refs, dots);
+}
+
+void FindSiftBestDotProducts(const FeatureDescriptors& descriptors1,
+                             const FeatureDescriptors& descriptors2,
+                             std::vector<SiftBestDotProducts>* best12,
+                             std::vector<SiftBestDotProducts>* best21,
+                             const SiftKernelISA isa) {
+  THROW_CHECK_EQ(descriptors1.cols(), kSiftDim);
+  THROW_CHECK_EQ(descriptors2.cols(), kSiftDim);
+  const SiftDotProductsFunc dot_products_func = GetSiftDotProductsFunc(isa);
+  FindBestDotProductsBlocked(
+      descriptors1,
+      descriptors2,
+      [dot_products_func](const uint8_t* query,
+                          const uint8_t* refs,
+                          const int num_refs,
+                          int* dots) {
+        dot_products_func(query, refs, num_refs, dots);
+      },
+      best12,
+      best21);
+}
+
+void ComputeSiftPCADotProducts(const uint8_t* query,
+                               const uint8_t* refs,
+                               const int num_refs,
+                               const int num_dims,
+                               int* dots,
+                               const SiftKernelISA isa) {
+  THROW_CHECK_GT(num_dims, 0);
+  THROW_CHECK_LE(num_dims, kSiftDim);
+  THROW_CHECK_EQ(num_dims % 16, 0);
+  GetSiftPCADotProductsFunc(isa)(query, refs, num_refs, num_dims, dots);
+}
+
+void FindSiftPCABestDotProducts(const FeatureDescriptors& descriptors1,
+                                const FeatureDescriptors& descriptors2,
+                                std::vector<SiftBestDotProducts>* best12,
+                                std::vector<SiftBestDotProducts>* best21,
+                                const SiftKernelISA isa) {
+  const int num_dims = descriptors1.cols();
+  THROW_CHECK_EQ(descriptors2.cols(), num_dims);
+  THROW_CHECK_GT(num_dims, 0);
+  THROW_CHECK_LE(num_dims, kSiftDim);
+  THROW_CHECK_EQ(num_dims % 16, 0);
+  const SiftPCADotProductsFunc dot_products_func =
+      GetSiftPCADotProductsFunc(isa);
+  FindBestDotProductsBlocked(
+      descriptors1,
+      descriptors2,
+      [dot_products_func, num_dims](const uint8_t* query,
+                                    const uint8_t* refs,
+                                    const int num_refs,
+                                    int* dots) {
+        dot_products_func(query, refs, num_refs, num_dims, dots);
+      },
+      best12,
+      best21);
+}
+
+void ComputeHammingDistances(const uint8_t* query,
+                             const uint8_t* refs,
+                             const int num_refs,
+                             const int num_bytes,
+                             int* dists,
+                             const SiftKernelISA isa) {
+  THROW_CHECK_EQ(num_bytes % 8, 0);
+  GetHammingDistancesFunc(isa)(query, refs, num_refs, num_bytes, dists);
+}
+
+void FindBinaryBestHammingDistances(
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2,
+    std::vector<BinaryBestHammingDistances>* best12,
+    std::vector<BinaryBestHammingDistances>* best21,
+    const SiftKernelISA isa) {
+  const int num_bytes = descriptors1.cols();
+  THROW_CHECK_EQ(descriptors2.cols(), num_bytes);
+  THROW_CHECK_EQ(num_bytes % 8, 0);
+  THROW_CHECK_NOTNULL(best12);
+
+  const int num_descriptors1 = descriptors1.rows();
+  const int num_descriptors2 = descriptors2.rows();
+
+  best12->assign(num_descriptors1, BinaryBestHammingDistances());
+  if (best21 != nullptr) {
+    best21->assign(num_descriptors2, BinaryBestHammingDistances());
+  }
+
+  if (num_descriptors1 == 0 || num_descriptors2 == 0 || num_bytes == 0) {
+    return;
+  }
+
+  const HammingDistancesFunc hamming_distances_func =
+      GetHammingDistancesFunc(isa);
+
+  // Same blocking of the reference descriptors into 32KB as for SIFT.
+  const int block_size = std::max(1, (32 * 1024) / num_bytes);
+  std::vector<int> dists(block_size);
+
+  for (int block_begin = 0; block_begin < num_descriptors2;
+       block_begin += block_size) {
+    const int num_refs = std::min(block_size, num_descriptors2 - block_begin);
+    const uint8_t* refs = descriptors2.data() + block_begin * num_bytes;
+    for (int i1 = 0; i1 < num_descriptors1; ++i1) {
+      hamming_distances_func(descriptors1.data() + i1 * num_bytes,
+                             refs,
+                             num_refs,
+                             num_bytes,
+                             dists.data());
+      BinaryBestHammingDistances& best1 = (*best12)[i1];
+      for (int j = 0; j < num_refs; ++j) {
+        UpdateBinaryBestHammingDistances(block_begin + j, dists[j], &best1);
+      }
+      if (best21 != nullptr) {
+        for (int j = 0; j < num_refs; ++j) {
+          UpdateBinaryBestHammingDistances(
+              i1, dists[j], &(*best21)[block_begin + j]);
+        }
+      }
+    }
+  }
+}
+
+void NormalizeAndQuantizeSiftDescriptors(const float* descriptors,
+                                         const int num_descriptors,
+                                         const bool l1_root,
+                                         uint8_t* quantized,
+                                         const SiftKernelISA isa) {
+  const SiftNormalizeAndQuantizeFunc normalize_and_quantize_func =
+      GetSiftNormalizeAndQuantizeFunc(isa);
+  for (int i = 0; i < num_descriptors; ++i) {
+    normalize_and_quantize_func(
+        descriptors + i * kSiftDim, l1_root, quantized + i * kSiftDim);
+  }
+}
+
+}  // namespace colmap
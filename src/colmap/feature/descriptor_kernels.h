@@ -0,0 +1,152 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/feature/types.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Instruction sets for which specialized SIFT and binary descriptor kernels
+// exist. The best supported instruction set is determined once at runtime, so
+// the same binary can be deployed on machines with different CPU generations.
+enum class SiftKernelISA {
+  SCALAR,
+  AVX2,
+  AVX512_VNNI,
+  NEON,
+};
+
+// Name of the instruction set, e.g. for logging.
+std::string SiftKernelISAToString(SiftKernelISA isa);
+
+// Whether the given instruction set can be used on the current CPU and was
+// compiled into the binary.
+bool IsSiftKernelISASupported(SiftKernelISA isa);
+
+// Best instruction set supported by the current CPU. Evaluated only once.
+SiftKernelISA GetBestSiftKernelISA();
+
+// Best and second best dot products of a descriptor against a set of other
+// descriptors. Since SIFT descriptors are normalized to the same length, a
+// larger dot product corresponds to a smaller distance.
+struct SiftBestDotProducts {
+  int best_idx = -1;
+  int best_dot = 0;
+  int second_best_dot = 0;
+};
+
+// Computes the dot products of a 128-dimensional query descriptor against
+// num_refs consecutive 128-dimensional reference descriptors.
+void ComputeSiftDotProducts(const uint8_t* query,
+                            const uint8_t* refs,
+                            int num_refs,
+                            int* dots,
+                            SiftKernelISA isa = GetBestSiftKernelISA());
+
+// Brute-force search of the two nearest neighbors of every descriptor in
+// descriptors1 among descriptors2 and, if best21 is not null, vice versa. The
+// uint8 descriptors are consumed directly and the top-2 selection is fused
+// with the distance computation, so the full distance matrix is never
+// materialized. Ties are resolved in favor of the lower index, equivalent to
+// a sequential scan over the full distance matrix.
+void FindSiftBestDotProducts(const FeatureDescriptors& descriptors1,
+                             const FeatureDescriptors& descriptors2,
+                             std::vector<SiftBestDotProducts>* best12,
+                             std::vector<SiftBestDotProducts>* best21,
+                             SiftKernelISA isa = GetBestSiftKernelISA());
+
+// Computes the dot products of a PCA-reduced query descriptor of num_dims
+// signed bytes against num_refs consecutive reduced reference descriptors of
+// the same length, see SiftPCA. The number of dimensions must be a multiple of
+// 16 and at most 128.
+void ComputeSiftPCADotProducts(const uint8_t* query,
+                               const uint8_t* refs,
+                               int num_refs,
+                               int num_dims,
+                               int* dots,
+                               SiftKernelISA isa = GetBestSiftKernelISA());
+
+// Same as FindSiftBestDotProducts for PCA-reduced descriptors. Negative dot
+// products, i.e. angles above 90 degrees, are never selected, which has the
+// same effect on matching as orthogonal descriptors.
+void FindSiftPCABestDotProducts(const FeatureDescriptors& descriptors1,
+                                const FeatureDescriptors& descriptors2,
+                                std::vector<SiftBestDotProducts>* best12,
+                                std::vector<SiftBestDotProducts>* best21,
+                                SiftKernelISA isa = GetBestSiftKernelISA());
+
+// L2- or, if l1_root is true, L1-Root-normalizes num_descriptors consecutive
+// 128-dimensional float descriptors and converts them to unsigned bytes as in
+// FeatureDescriptorsToUnsignedByte. Normalization, square rooting and
+// quantization are fused into a single pass over each descriptor without any
+// temporary allocations. Descriptors with zero norm are quantized to zero.
+// The input and output may not alias.
+void NormalizeAndQuantizeSiftDescriptors(
+    const float* descriptors,
+    int num_descriptors,
+    bool l1_root,
+    uint8_t* quantized,
+    SiftKernelISA isa = GetBestSiftKernelISA());
+
+// Best and second best Hamming distances of a binary descriptor against a set
+// of other descriptors.
+struct BinaryBestHammingDistances {
+  int best_idx = -1;
+  int best_dist = std::numeric_limits<int>::max();
+  int second_best_dist = std::numeric_limits<int>::max();
+};
+
+// Computes the Hamming distances of a binary query descriptor of num_bytes
+// bytes against num_refs consecutive reference descriptors of the same length.
+// The number of bytes must be a multiple of 8.
+void ComputeHammingDistances(const uint8_t* query,
+                             const uint8_t* refs,
+                             int num_refs,
+                             int num_bytes,
+                             int* dists,
+                             SiftKernelISA isa = GetBestSiftKernelISA());
+
+// Brute-force search of the two nearest neighbors in Hamming distance of every
+// binary descriptor in descriptors1 among descriptors2 and, if best21 is not
+// null, vice versa. As in FindSiftBestDotProducts, the top-2 selection is fused
+// with the distance computation and ties are resolved in favor of the lower
+// index.
+void FindBinaryBestHammingDistances(
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2,
+    std::vector<BinaryBestHammingDistances>* best12,
+    std::vector<BinaryBestHammingDistances>* best21,
+    SiftKernelISA isa = GetBestSiftKernelISA());
+
+}  // namespace colmap
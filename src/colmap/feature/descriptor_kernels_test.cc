@@ -0,0 +1,451 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/feature/descriptor_kernels.h"
+
+#include "colmap/feature/utils.h"
+
+#include <bitset>
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+FeatureDescriptors CreateRandomDescriptors(const int num_descriptors,
+                                           std::mt19937* prng,
+                                           const int num_bytes = 128) {
+  std::uniform_int_distribution<int> distribution(0, 255);
+  FeatureDescriptors descriptors(num_descriptors, num_bytes);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = static_cast<uint8_t>(distribution(*prng));
+  }
+  return descriptors;
+}
+
+std::vector<SiftKernelISA> GetSupportedISAs() {
+  std::vector<SiftKernelISA> isas;
+  for (const SiftKernelISA isa : {SiftKernelISA::SCALAR,
+                                  SiftKernelISA::AVX2,
+                                  SiftKernelISA::AVX512_VNNI,
+                                  SiftKernelISA::NEON}) {
+    if (IsSiftKernelISASupported(isa)) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+TEST(GetBestSiftKernelISA, Nominal) {
+  EXPECT_TRUE(IsSiftKernelISASupported(SiftKernelISA::SCALAR));
+  EXPECT_TRUE(IsSiftKernelISASupported(GetBestSiftKernelISA()));
+}
+
+TEST(ComputeSiftDotProducts, Nominal) {
+  std::mt19937 prng(42);
+  const FeatureDescriptors query = CreateRandomDescriptors(1, &prng);
+  const FeatureDescriptors refs = CreateRandomDescriptors(37, &prng);
+  const Eigen::VectorXi expected_dots =
+      refs.cast<int>() * query.cast<int>().transpose();
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    std::vector<int> dots(refs.rows());
+    ComputeSiftDotProducts(
+        query.data(), refs.data(), refs.rows(), dots.data(), isa);
+    for (int i = 0; i < refs.rows(); ++i) {
+      EXPECT_EQ(dots[i], expected_dots(i)) << SiftKernelISAToString(isa);
+    }
+  }
+}
+
+TEST(ComputeSiftDotProducts, MaxValues) {
+  FeatureDescriptors query(1, 128);
+  query.setConstant(255);
+  FeatureDescriptors refs(2, 128);
+  refs.setConstant(255);
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    std::vector<int> dots(refs.rows());
+    ComputeSiftDotProducts(
+        query.data(), refs.data(), refs.rows(), dots.data(), isa);
+    EXPECT_EQ(dots[0], 128 * 255 * 255);
+    EXPECT_EQ(dots[1], 128 * 255 * 255);
+  }
+}
+
+TEST(FindSiftBestDotProducts, Empty) {
+  std::mt19937 prng(42);
+  const FeatureDescriptors descriptors1 = CreateRandomDescriptors(0, &prng);
+  const FeatureDescriptors descriptors2 = CreateRandomDescriptors(10, &prng);
+  std::vector<SiftBestDotProducts> best12;
+  std::vector<SiftBestDotProducts> best21;
+  FindSiftBestDotProducts(descriptors1, descriptors2, &best12, &best21);
+  EXPECT_EQ(best12.size(), 0);
+  ASSERT_EQ(best21.size(), 10);
+  for (const auto& best : best21) {
+    EXPECT_EQ(best.best_idx, -1);
+  }
+}
+
+TEST(FindSiftBestDotProducts, Nominal) {
+  std::mt19937 prng(42);
+  // More than one block of reference descriptors.
+  const FeatureDescriptors descriptors1 = CreateRandomDescriptors(100, &prng);
+  const FeatureDescriptors descriptors2 = CreateRandomDescriptors(600, &prng);
+  const Eigen::MatrixXi dists =
+      descriptors1.cast<int>() * descriptors2.cast<int>().transpose();
+
+  auto ComputeExpected = [](const Eigen::MatrixXi& dists) {
+    std::vector<SiftBestDotProducts> expected(dists.rows());
+    for (int i = 0; i < dists.rows(); ++i) {
+      for (int j = 0; j < dists.cols(); ++j) {
+        if (dists(i, j) > expected[i].best_dot) {
+          expected[i].best_idx = j;
+          expected[i].second_best_dot = expected[i].best_dot;
+          expected[i].best_dot = dists(i, j);
+        } else if (dists(i, j) > expected[i].second_best_dot) {
+          expected[i].second_best_dot = dists(i, j);
+        }
+      }
+    }
+    return expected;
+  };
+
+  const std::vector<SiftBestDotProducts> expected12 = ComputeExpected(dists);
+  const std::vector<SiftBestDotProducts> expected21 =
+      ComputeExpected(dists.transpose());
+
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    std::vector<SiftBestDotProducts> best12;
+    std::vector<SiftBestDotProducts> best21;
+    FindSiftBestDotProducts(descriptors1, descriptors2, &best12, &best21, isa);
+    ASSERT_EQ(best12.size(), expected12.size());
+    ASSERT_EQ(best21.size(), expected21.size());
+    for (size_t i = 0; i < best12.size(); ++i) {
+      EXPECT_EQ(best12[i].best_idx, expected12[i].best_idx);
+      EXPECT_EQ(best12[i].best_dot, expected12[i].best_dot);
+      EXPECT_EQ(best12[i].second_best_dot, expected12[i].second_best_dot);
+    }
+    for (size_t i = 0; i < best21.size(); ++i) {
+      EXPECT_EQ(best21[i].best_idx, expected21[i].best_idx);
+      EXPECT_EQ(best21[i].best_dot, expected21[i].best_dot);
+      EXPECT_EQ(best21[i].second_best_dot, expected21[i].second_best_dot);
+    }
+  }
+}
+
+Eigen::MatrixXi ComputeExpectedSiftPCADotProducts(
+    const FeatureDescriptors& descriptors1,
+    const FeatureDescriptors& descriptors2) {
+  const Eigen::MatrixXi signed1 =
+      Eigen::Map<const Eigen::Matrix<int8_t,
+                                    Eigen::Dynamic,
+                                    Eigen::Dynamic,
+                                    Eigen::RowMajor>>(
+          reinterpret_cast<const int8_t*>(descriptors1.data()),
+          descriptors1.rows(),
+          descriptors1.cols())
+          .cast<int>();
+  const Eigen::MatrixXi signed2 =
+      Eigen::Map<const Eigen::Matrix<int8_t,
+                                    Eigen::Dynamic,
+                                    Eigen::Dynamic,
+                                    Eigen::RowMajor>>(
+          reinterpret_cast<const int8_t*>(descriptors2.data()),
+          descriptors2.rows(),
+          descriptors2.cols())
+          .cast<int>();
+  return signed1 * signed2.transpose();
+}
+
+TEST(ComputeSiftPCADotProducts, Nominal) {
+  std::mt19937 prng(42);
+  for (const int num_dims : {16, 32, 48, 64, 128}) {
+    const FeatureDescriptors query =
+        CreateRandomDescriptors(1, &prng, num_dims);
+    const FeatureDescriptors refs =
+        CreateRandomDescriptors(37, &prng, num_dims);
+    const Eigen::MatrixXi expected_dots =
+        ComputeExpectedSiftPCADotProducts(query, refs);
+    for (const SiftKernelISA isa : GetSupportedISAs()) {
+      std::vector<int> dots(refs.rows());
+      ComputeSiftPCADotProducts(query.data(),
+                                refs.data(),
+                                refs.rows(),
+                                num_dims,
+                                dots.data(),
+                                isa);
+      for (int i = 0; i < refs.rows(); ++i) {
+        EXPECT_EQ(dots[i], expected_dots(0, i)) << SiftKernelISAToString(isa);
+      }
+    }
+  }
+}
+
+TEST(ComputeSiftPCADotProducts, MaxValues) {
+  FeatureDescriptors query(1, 128);
+  query.setConstant(static_cast<uint8_t>(-128));
+  FeatureDescriptors refs(2, 128);
+  refs.row(0).setConstant(static_cast<uint8_t>(-128));
+  refs.row(1).setConstant(127);
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    std::vector<int> dots(refs.rows());
+    ComputeSiftPCADotProducts(
+        query.data(), refs.data(), refs.rows(), 128, dots.data(), isa);
+    EXPECT_EQ(dots[0], 128 * 128 * 128);
+    EXPECT_EQ(dots[1], -128 * 128 * 127);
+  }
+}
+
+TEST(FindSiftPCABestDotProducts, Nominal) {
+  std::mt19937 prng(42);
+  // More than one block of reference descriptors.
+  const FeatureDescriptors descriptors1 =
+      CreateRandomDescriptors(100, &prng, 64);
+  const FeatureDescriptors descriptors2 =
+      CreateRandomDescriptors(700, &prng, 64);
+  const Eigen::MatrixXi dots =
+      ComputeExpectedSiftPCADotProducts(descriptors1, descriptors2);
+
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    std::vector<SiftBestDotProducts> best12;
+    std::vector<SiftBestDotProducts> best21;
+    FindSiftPCABestDotProducts(
+        descriptors1, descriptors2, &best12, &best21, isa);
+    ASSERT_EQ(best12.size(), descriptors1.rows());
+    ASSERT_EQ(best21.size(), descriptors2.rows());
+    for (int i = 0; i < dots.rows(); ++i) {
+      Eigen::Index best_idx;
+      const int best_dot = dots.row(i).maxCoeff(&best_idx);
+      if (best_dot > 0) {
+        EXPECT_EQ(best12[i].best_idx, best_idx);
+        EXPECT_EQ(best12[i].best_dot, best_dot);
+      } else {
+        EXPECT_EQ(best12[i].best_idx, -1);
+      }
+    }
+    for (int j = 0; j < dots.cols(); ++j) {
+      Eigen::Index best_idx;
+      const int best_dot = dots.col(j).maxCoeff(&best_idx);
+      if (best_dot > 0) {
+        EXPECT_EQ(best21[j].best_idx, best_idx);
+        EXPECT_EQ(best21[j].best_dot, best_dot);
+      } else {
+        EXPECT_EQ(best21[j].best_idx, -1);
+      }
+    }
+  }
+}
+
+int ComputeExpectedHammingDistance(const uint8_t* descriptor1,
+                                   const uint8_t* descriptor2,
+                                   const int num_bytes) {
+  int dist = 0;
+  for (int k = 0; k < num_bytes; ++k) {
+    dist += std::bitset<8>(descriptor1[k] ^ descriptor2[k]).count();
+  }
+  return dist;
+}
+
+TEST(ComputeHammingDistances, Nominal) {
+  std::mt19937 prng(42);
+  // Multiples of the vector width and with a remainder.
+  for (const int num_bytes : {8, 32, 40, 64}) {
+    const FeatureDescriptors query =
+        CreateRandomDescriptors(1, &prng, num_bytes);
+    const FeatureDescriptors refs =
+        CreateRandomDescriptors(37, &prng, num_bytes);
+    for (const SiftKernelISA isa : GetSupportedISAs()) {
+      std::vector<int> dists(refs.rows());
+      ComputeHammingDistances(query.data(),
+                              refs.data(),
+                              refs.rows(),
+                              num_bytes,
+                              dists.data(),
+                              isa);
+      for (int i = 0; i < refs.rows(); ++i) {
+        EXPECT_EQ(dists[i],
+                  ComputeExpectedHammingDistance(
+                      query.data(), refs.row(i).data(), num_bytes))
+            << SiftKernelISAToString(isa);
+      }
+    }
+  }
+}
+
+TEST(ComputeHammingDistances, MaxValues) {
+  FeatureDescriptors query(1, 32);
+  query.setConstant(0);
+  FeatureDescriptors refs(2, 32);
+  refs.setConstant(255);
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    std::vector<int> dists(refs.rows());
+    ComputeHammingDistances(
+        query.data(), refs.data(), refs.rows(), 32, dists.data(), isa);
+    EXPECT_EQ(dists[0], 256);
+    EXPECT_EQ(dists[1], 256);
+  }
+}
+
+TEST(FindBinaryBestHammingDistances, Nominal) {
+  std::mt19937 prng(42);
+  // More than one block of reference descriptors.
+  const FeatureDescriptors descriptors1 =
+      CreateRandomDescriptors(100, &prng, 32);
+  const FeatureDescriptors descriptors2 =
+      CreateRandomDescriptors(1500, &prng, 32);
+  Eigen::MatrixXi dists(descriptors1.rows(), descriptors2.rows());
+  for (int i = 0; i < dists.rows(); ++i) {
+    for (int j = 0; j < dists.cols(); ++j) {
+      dists(i, j) = ComputeExpectedHammingDistance(
+          descriptors1.row(i).data(), descriptors2.row(j).data(), 32);
+    }
+  }
+
+  auto ComputeExpected = [](const Eigen::MatrixXi& dists) {
+    std::vector<BinaryBestHammingDistances> expected(dists.rows());
+    for (int i = 0; i < dists.rows(); ++i) {
+      for (int j = 0; j < dists.cols(); ++j) {
+        if (dists(i, j) < expected[i].best_dist) {
+          expected[i].best_idx = j;
+          expected[i].second_best_dist = expected[i].best_dist;
+          expected[i].best_dist = dists(i, j);
+        } else if (dists(i, j) < expected[i].second_best_dist) {
+          expected[i].second_best_dist = dists(i, j);
+        }
+      }
+    }
+    return expected;
+  };
+
+  const std::vector<BinaryBestHammingDistances> expected12 =
+      ComputeExpected(dists);
+  const std::vector<BinaryBestHammingDistances> expected21 =
+      ComputeExpected(dists.transpose());
+
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    std::vector<BinaryBestHammingDistances> best12;
+    std::vector<BinaryBestHammingDistances> best21;
+    FindBinaryBestHammingDistances(
+        descriptors1, descriptors2, &best12, &best21, isa);
+    ASSERT_EQ(best12.size(), expected12.size());
+    ASSERT_EQ(best21.size(), expected21.size());
+    for (size_t i = 0; i < best12.size(); ++i) {
+      EXPECT_EQ(best12[i].best_idx, expected12[i].best_idx);
+      EXPECT_EQ(best12[i].best_dist, expected12[i].best_dist);
+      EXPECT_EQ(best12[i].second_best_dist, expected12[i].second_best_dist);
+    }
+    for (size_t i = 0; i < best21.size(); ++i) {
+      EXPECT_EQ(best21[i].best_idx, expected21[i].best_idx);
+      EXPECT_EQ(best21[i].best_dist, expected21[i].best_dist);
+      EXPECT_EQ(best21[i].second_best_dist, expected21[i].second_best_dist);
+    }
+  }
+}
+
+void ExpectNearDescriptors(const FeatureDescriptors& descriptors,
+                           const FeatureDescriptors& expected_descriptors) {
+  ASSERT_EQ(descriptors.rows(), expected_descriptors.rows());
+  ASSERT_EQ(descriptors.cols(), expected_descriptors.cols());
+  // The summation order of the norm differs from Eigen's, which can flip the
+  // rounding of values close to the quantization boundaries.
+  const Eigen::MatrixXi diff =
+      descriptors.cast<int>() - expected_descriptors.cast<int>();
+  EXPECT_LE(diff.cwiseAbs().maxCoeff(), 1);
+}
+
+TEST(NormalizeAndQuantizeSiftDescriptors, L2) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+  FeatureDescriptorsFloat descriptors(100, 128);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = std::pow(distribution(prng), 4);
+  }
+
+  FeatureDescriptorsFloat normalized_descriptors = descriptors;
+  L2NormalizeFeatureDescriptors(&normalized_descriptors);
+  const FeatureDescriptors expected_descriptors =
+      FeatureDescriptorsToUnsignedByte(normalized_descriptors);
+
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    FeatureDescriptors quantized_descriptors(descriptors.rows(), 128);
+    NormalizeAndQuantizeSiftDescriptors(descriptors.data(),
+                                        descriptors.rows(),
+                                        /*l1_root=*/false,
+                                        quantized_descriptors.data(),
+                                        isa);
+    ExpectNearDescriptors(quantized_descriptors, expected_descriptors);
+  }
+}
+
+TEST(NormalizeAndQuantizeSiftDescriptors, L1Root) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+  FeatureDescriptorsFloat descriptors(100, 128);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = std::pow(distribution(prng), 4);
+  }
+
+  FeatureDescriptorsFloat normalized_descriptors = descriptors;
+  L1RootNormalizeFeatureDescriptors(&normalized_descriptors);
+  const FeatureDescriptors expected_descriptors =
+      FeatureDescriptorsToUnsignedByte(normalized_descriptors);
+
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    FeatureDescriptors quantized_descriptors(descriptors.rows(), 128);
+    NormalizeAndQuantizeSiftDescriptors(descriptors.data(),
+                                        descriptors.rows(),
+                                        /*l1_root=*/true,
+                                        quantized_descriptors.data(),
+                                        isa);
+    ExpectNearDescriptors(quantized_descriptors, expected_descriptors);
+  }
+}
+
+TEST(NormalizeAndQuantizeSiftDescriptors, ZeroAndSaturated) {
+  FeatureDescriptorsFloat descriptors(2, 128);
+  descriptors.row(0).setZero();
+  descriptors.row(1).setZero();
+  descriptors(1, 7) = 1.0f;
+  for (const SiftKernelISA isa : GetSupportedISAs()) {
+    for (const bool l1_root : {false, true}) {
+      FeatureDescriptors quantized_descriptors(descriptors.rows(), 128);
+      NormalizeAndQuantizeSiftDescriptors(descriptors.data(),
+                                          descriptors.rows(),
+                                          l1_root,
+                                          quantized_descriptors.data(),
+                                          isa);
+      EXPECT_EQ(quantized_descriptors.row(0).cast<int>().sum(), 0);
+      EXPECT_EQ(quantized_descriptors(1, 7), 255);
+      EXPECT_EQ(quantized_descriptors.row(1).cast<int>().sum(), 255);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace colmap
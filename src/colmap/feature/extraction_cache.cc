@@ -0,0 +1,177 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/feature/extraction_cache.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace colmap {
+namespace {
+
+// Identifies cache entries and must be changed, whenever their format or the
+// semantics of the extracted features change.
+constexpr uint64_t kCacheEntryMagic = 0x31434650414d4c43ull;  // "CLMAPFC1"
+
+}  // namespace
+
+uint64_t ComputeFeatureExtractionFingerprint(
+    const SiftExtractionOptions& options) {
+  std::ostringstream stream;
+  stream << std::setprecision(17);
+  stream << kCacheEntryMagic << ' ' << options.use_gpu << ' '
+         << options.max_image_size << ' ' << options.gpu_downsample << ' '
+         << options.tile_size << ' ' << options.tile_overlap << ' '
+         << options.max_num_features << ' ' << options.first_octave << ' '
+         << options.num_octaves << ' ' << options.octave_resolution << ' '
+         << options.peak_threshold << ' ' << options.edge_threshold << ' '
+         << options.estimate_affine_shape << ' '
+         << options.max_num_orientations << ' ' << options.upright << ' '
+         << options.darkness_adaptivity << ' ' << options.domain_size_pooling
+         << ' ' << options.dsp_min_scale << ' ' << options.dsp_max_scale << ' '
+         << options.dsp_num_scales << ' ' << options.force_covariant_extractor
+         << ' ' << static_cast<int>(options.normalization) << ' '
+         << static_cast<int>(options.descriptor_type);
+  if (!options.pca_path.empty()) {
+    stream << ' ' << ComputeFileContentHash(options.pca_path);
+  }
+  const std::string data = stream.str();
+  return ComputeFNV1aHash(data.data(), data.size());
+}
+
+FeatureExtractionCache::FeatureExtractionCache(const std::string& path,
+                                               const uint64_t fingerprint)
+    : dir_path_(JoinPaths(
+          path, StringPrintf("%016llx", static_cast<unsigned long long>(
+                                            fingerprint)))) {
+  CreateDirIfNotExists(dir_path_, /*recursive=*/true);
+}
+
+bool FeatureExtractionCache::Read(const uint64_t content_hash,
+                                  FeatureKeypoints* keypoints,
+                                  FeatureDescriptors* descriptors) const {
+  THROW_CHECK_NOTNULL(keypoints);
+  THROW_CHECK_NOTNULL(descriptors);
+
+  const std::string path = EntryPath(content_hash);
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  if (ReadBinaryLittleEndian<uint64_t>(&file) != kCacheEntryMagic ||
+      ReadBinaryLittleEndian<uint64_t>(&file) != content_hash) {
+    LOG(WARNING) << "Ignoring invalid feature cache entry " << path;
+    return false;
+  }
+
+  const uint64_t num_features = ReadBinaryLittleEndian<uint64_t>(&file);
+  const uint64_t num_dims = ReadBinaryLittleEndian<uint64_t>(&file);
+  if (!file.good()) {
+    LOG(WARNING) << "Ignoring truncated feature cache entry " << path;
+    return false;
+  }
+
+  keypoints->resize(num_features);
+  for (auto& keypoint : *keypoints) {
+    keypoint.x = ReadBinaryLittleEndian<float>(&file);
+    keypoint.y = ReadBinaryLittleEndian<float>(&file);
+    keypoint.a11 = ReadBinaryLittleEndian<float>(&file);
+    keypoint.a12 = ReadBinaryLittleEndian<float>(&file);
+    keypoint.a21 = ReadBinaryLittleEndian<float>(&file);
+    keypoint.a22 = ReadBinaryLittleEndian<float>(&file);
+  }
+
+  descriptors->resize(num_features, num_dims);
+  file.read(reinterpret_cast<char*>(descriptors->data()), descriptors->size());
+  if (!file.good()) {
+    LOG(WARNING) << "Ignoring truncated feature cache entry " << path;
+    keypoints->clear();
+    descriptors->resize(0, 0);
+    return false;
+  }
+
+  return true;
+}
+
+void FeatureExtractionCache::Write(
+    const uint64_t content_hash,
+    const FeatureKeypoints& keypoints,
+    const FeatureDescriptors& descriptors) const {
+  THROW_CHECK_EQ(keypoints.size(), descriptors.rows());
+
+  // Write to a unique temporary file first and then rename it, so that
+  // concurrent readers never observe partially written entries.
+  const std::string path = EntryPath(content_hash);
+  thread_local std::mt19937_64 random_generator{std::random_device()()};
+  const std::string tmp_path =
+      StringPrintf("%s.%016llx.tmp",
+                   path.c_str(),
+                   static_cast<unsigned long long>(random_generator()));
+
+  {
+    std::ofstream file(tmp_path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
+
+    WriteBinaryLittleEndian<uint64_t>(&file, kCacheEntryMagic);
+    WriteBinaryLittleEndian<uint64_t>(&file, content_hash);
+    WriteBinaryLittleEndian<uint64_t>(&file, keypoints.size());
+    WriteBinaryLittleEndian<uint64_t>(&file, descriptors.cols());
+    for (const auto& keypoint : keypoints) {
+      WriteBinaryLittleEndian<float>(&file, keypoint.x);
+      WriteBinaryLittleEndian<float>(&file, keypoint.y);
+      WriteBinaryLittleEndian<float>(&file, keypoint.a11);
+      WriteBinaryLittleEndian<float>(&file, keypoint.a12);
+      WriteBinaryLittleEndian<float>(&file, keypoint.a21);
+      WriteBinaryLittleEndian<float>(&file, keypoint.a22);
+    }
+    file.write(reinterpret_cast<const char*>(descriptors.data()),
+               descriptors.size());
+    THROW_CHECK(file.good()) << "Failed to write " << tmp_path;
+  }
+
+  RenameFile(tmp_path, path);
+}
+
+std::string FeatureExtractionCache::EntryPath(
+    const uint64_t content_hash) const {
+  return JoinPaths(
+      dir_path_,
+      StringPrintf("%016llx.bin",
+                   static_cast<unsigned long long>(content_hash)));
+}
+
+}  // namespace colmap
@@ -0,0 +1,75 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/feature/sift.h"
+#include "colmap/feature/types.h"
+
+#include <cstdint>
+#include <string>
+
+namespace colmap {
+
+// Fingerprint of the extraction options that affect the extracted features,
+// e.g., the detection thresholds and the content of the PCA file, whereas
+// options that only affect the execution, e.g., the number of threads or the
+// GPU indices, are ignored.
+uint64_t ComputeFeatureExtractionFingerprint(
+    const SiftExtractionOptions& options);
+
+// Content-addressed cache of extracted features on disk, which can be shared
+// by many databases over overlapping sets of images. Features are stored per
+// hash of the image file content, so that renamed or copied images are found,
+// and per fingerprint of the extraction options, so that different options
+// never share features. The methods can be called concurrently by multiple
+// threads and processes, since entries are replaced atomically.
+class FeatureExtractionCache {
+ public:
+  FeatureExtractionCache(const std::string& path, uint64_t fingerprint);
+
+  // Read the features of the image with the given content hash. Returns false,
+  // if the cache has no (valid) entry for the image.
+  bool Read(uint64_t content_hash,
+            FeatureKeypoints* keypoints,
+            FeatureDescriptors* descriptors) const;
+
+  // Write the features of the image with the given content hash.
+  void Write(uint64_t content_hash,
+             const FeatureKeypoints& keypoints,
+             const FeatureDescriptors& descriptors) const;
+
+ private:
+  std::string EntryPath(uint64_t content_hash) const;
+
+  const std::string dir_path_;
+};
+
+}  // namespace colmap
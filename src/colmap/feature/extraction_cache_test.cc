@@ -0,0 +1,117 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/feature/extraction_cache.h"
+
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(ComputeFeatureExtractionFingerprint, Nominal) {
+  SiftExtractionOptions options;
+  const uint64_t fingerprint = ComputeFeatureExtractionFingerprint(options);
+  EXPECT_EQ(fingerprint, ComputeFeatureExtractionFingerprint(options));
+
+  // Options that only affect the execution are ignored.
+  options.num_threads = 3;
+  options.gpu_index = "1";
+  options.max_num_images_per_transaction = 7;
+  options.feature_cache_path = "cache";
+  EXPECT_EQ(fingerprint, ComputeFeatureExtractionFingerprint(options));
+
+  options.peak_threshold *= 2;
+  EXPECT_NE(fingerprint, ComputeFeatureExtractionFingerprint(options));
+  options = SiftExtractionOptions();
+  options.upright = true;
+  EXPECT_NE(fingerprint, ComputeFeatureExtractionFingerprint(options));
+}
+
+TEST(FeatureExtractionCache, ReadWrite) {
+  const std::string test_dir = CreateTestDir();
+  const FeatureExtractionCache cache(test_dir, /*fingerprint=*/1);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_FALSE(cache.Read(/*content_hash=*/2, &keypoints, &descriptors));
+
+  FeatureKeypoints ref_keypoints = {FeatureKeypoint(1, 2, 3, 4, 5, 6),
+                                    FeatureKeypoint(7, 8, 0.5, 1)};
+  FeatureDescriptors ref_descriptors = FeatureDescriptors::Random(2, 128);
+  cache.Write(/*content_hash=*/2, ref_keypoints, ref_descriptors);
+  EXPECT_FALSE(cache.Read(/*content_hash=*/3, &keypoints, &descriptors));
+  ASSERT_TRUE(cache.Read(/*content_hash=*/2, &keypoints, &descriptors));
+  ASSERT_EQ(keypoints.size(), ref_keypoints.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    EXPECT_EQ(keypoints[i].x, ref_keypoints[i].x);
+    EXPECT_EQ(keypoints[i].y, ref_keypoints[i].y);
+    EXPECT_EQ(keypoints[i].a11, ref_keypoints[i].a11);
+    EXPECT_EQ(keypoints[i].a12, ref_keypoints[i].a12);
+    EXPECT_EQ(keypoints[i].a21, ref_keypoints[i].a21);
+    EXPECT_EQ(keypoints[i].a22, ref_keypoints[i].a22);
+  }
+  EXPECT_EQ(descriptors, ref_descriptors);
+
+  // Entries of other options are not shared.
+  const FeatureExtractionCache other_cache(test_dir, /*fingerprint=*/4);
+  EXPECT_FALSE(other_cache.Read(/*content_hash=*/2, &keypoints, &descriptors));
+
+  // Images without features are cached as well.
+  cache.Write(/*content_hash=*/5, {}, FeatureDescriptors(0, 128));
+  ASSERT_TRUE(cache.Read(/*content_hash=*/5, &keypoints, &descriptors));
+  EXPECT_TRUE(keypoints.empty());
+  EXPECT_EQ(descriptors.rows(), 0);
+}
+
+TEST(FeatureExtractionCache, IgnoresTruncatedEntries) {
+  const std::string test_dir = CreateTestDir();
+  const FeatureExtractionCache cache(test_dir, /*fingerprint=*/1);
+  cache.Write(/*content_hash=*/2,
+              {FeatureKeypoint(1, 2)},
+              FeatureDescriptors::Random(1, 128));
+
+  const std::string path =
+      JoinPaths(test_dir, "0000000000000001", "0000000000000002.bin");
+  ASSERT_TRUE(ExistsFile(path));
+  std::vector<char> data;
+  ReadBinaryBlob(path, &data);
+  data.resize(data.size() - 1);
+  WriteBinaryBlob(path, data);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_FALSE(cache.Read(/*content_hash=*/2, &keypoints, &descriptors));
+}
+
+}  // namespace
+}  // namespace colmap
@@ -29,64 +29,217 @@
 
 #include "colmap/feature/matcher.h"
 
+#include "colmap/util/memory.h"
+#include "colmap/util/metrics.h"
+
+#include <algorithm>
+
 namespace colmap {
 
+void FeatureMatcher::MatchBatch(
+    const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+    const std::vector<std::shared_ptr<const FeatureDescriptors>>& descriptors2,
+    const MatchBatchCallback& callback) {
+  THROW_CHECK(callback);
+  FeatureMatches matches;
+  for (size_t i = 0; i < descriptors2.size(); ++i) {
+    Match(i == 0 ? descriptors1 : nullptr, descriptors2[i], &matches);
+    callback(i, &matches);
+  }
+}
+
 FeatureMatcherCache::FeatureMatcherCache(const size_t cache_size,
                                          std::shared_ptr<Database> database,
-                                         const bool do_setup)
+                                         const bool do_setup,
+                                         size_t max_descriptor_index_num_bytes)
     : cache_size_(cache_size),
-      database_(std::move(THROW_CHECK_NOTNULL(database))) {
+      database_(std::move(THROW_CHECK_NOTNULL(database))),
+      max_descriptor_index_num_bytes_(max_descriptor_index_num_bytes) {
   if (do_setup) {
     Setup();
   }
 }
 
 void FeatureMatcherCache::Setup() {
-  std::vector<Camera> cameras = database_->ReadAllCameras();
-  cameras_cache_.reserve(cameras.size());
-  for (Camera& camera : cameras) {
-    cameras_cache_.emplace(camera.camera_id, std::move(camera));
-  }
+  if (!lazy_image_loading_) {
+    std::vector<Camera> cameras = database_->ReadAllCameras();
+    cameras_cache_.reserve(cameras.size());
+    for (Camera& camera : cameras) {
+      cameras_cache_.emplace(camera.camera_id, std::move(camera));
+    }
 
-  std::vector<Image> images = database_->ReadAllImages();
-  images_cache_.reserve(images.size());
-  for (Image& image : images) {
-    images_cache_.emplace(image.ImageId(), std::move(image));
-  }
+    std::vector<Image> images = database_->ReadAllImages();
+    images_cache_.reserve(images.size());
+    for (Image& image : images) {
+      images_cache_.emplace(image.ImageId(), std::move(image));
+    }
 
-  locations_priors_cache_.reserve(database_->NumPosePriors());
-  for (const auto& id_and_image : images_cache_) {
-    if (database_->ExistsPosePrior(id_and_image.first)) {
-      locations_priors_cache_.emplace(
-          id_and_image.first, database_->ReadPosePrior(id_and_image.first));
+    locations_priors_cache_.reserve(database_->NumPosePriors());
+    for (const auto& id_and_image : images_cache_) {
+      if (database_->ExistsPosePrior(id_and_image.first)) {
+        locations_priors_cache_.emplace(
+            id_and_image.first, database_->ReadPosePrior(id_and_image.first));
+      }
     }
   }
 
-  keypoints_cache_ =
-      std::make_unique<LRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>(
-          cache_size_, [this](const image_t image_id) {
-            return std::make_shared<FeatureKeypoints>(
-                database_->ReadKeypoints(image_id));
-          });
+  // Deciding which pairs are already matched must not issue one query per
+  // pair, e.g. when resuming the matching of many millions of pairs.
+  matched_pair_ids_ = ImagePairIdSet(database_->ReadAllMatchedImagePairIds());
+  verified_pair_ids_ =
+      ImagePairIdSet(database_->ReadAllVerifiedImagePairIds());
 
-  descriptors_cache_ =
-      std::make_unique<LRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>(
-          cache_size_, [this](const image_t image_id) {
-            return std::make_shared<FeatureDescriptors>(
-                database_->ReadDescriptors(image_id));
-          });
+  // The matchers require owning containers, so the features in the store are
+  // copied once per cache miss, which is still much cheaper than reading them
+  // from the database. The caches are thread-safe, such that only cache misses
+  // of the database contend for the database lock.
+  keypoints_cache_ = std::make_unique<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>(
+      cache_size_, [this](const image_t image_id) {
+        GetCacheMetrics("feature_matcher_keypoints").misses->Increment();
+        if (feature_store_ != nullptr &&
+            feature_store_->ExistsKeypoints(image_id)) {
+          return std::make_shared<FeatureKeypoints>(
+              feature_store_->ReadKeypoints(image_id));
+        }
+        std::lock_guard<std::mutex> lock(database_mutex_);
+        return std::make_shared<FeatureKeypoints>(
+            database_->ReadKeypoints(image_id));
+      });
+
+  descriptors_cache_ = std::make_unique<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>(
+      cache_size_, [this](const image_t image_id) {
+        GetCacheMetrics("feature_matcher_descriptors").misses->Increment();
+        if (feature_store_ != nullptr &&
+            feature_store_->ExistsDescriptors(image_id)) {
+          return std::make_shared<FeatureDescriptors>(
+              feature_store_->ReadDescriptors(image_id));
+        }
+        std::lock_guard<std::mutex> lock(database_mutex_);
+        return std::make_shared<FeatureDescriptors>(
+            database_->ReadDescriptors(image_id));
+      });
 
-  keypoints_exists_cache_ = std::make_unique<LRUCache<image_t, bool>>(
-      images_cache_.size(), [this](const image_t image_id) {
+  // Images can be added after the setup, so the per-image caches hold at
+  // least as many images as the feature caches.
+  const size_t num_images_cache_size =
+      std::max(images_cache_.size(), cache_size_);
+
+  num_keypoints_cache_ = std::make_unique<ThreadSafeLRUCache<image_t, size_t>>(
+      num_images_cache_size, [this](const image_t image_id) {
+        if (feature_store_ != nullptr &&
+            feature_store_->ExistsKeypoints(image_id)) {
+          return feature_store_->KeypointsData(image_id).size;
+        }
+        std::lock_guard<std::mutex> lock(database_mutex_);
+        return database_->NumKeypointsForImage(image_id);
+      });
+
+  keypoints_exists_cache_ = std::make_unique<ThreadSafeLRUCache<image_t, bool>>(
+      num_images_cache_size, [this](const image_t image_id) {
+        if (feature_store_ != nullptr &&
+            feature_store_->ExistsKeypoints(image_id)) {
+          return true;
+        }
+        std::lock_guard<std::mutex> lock(database_mutex_);
         return database_->ExistsKeypoints(image_id);
       });
 
-  descriptors_exists_cache_ = std::make_unique<LRUCache<image_t, bool>>(
-      images_cache_.size(), [this](const image_t image_id) {
-        return database_->ExistsDescriptors(image_id);
+  descriptors_exists_cache_ =
+      std::make_unique<ThreadSafeLRUCache<image_t, bool>>(
+          num_images_cache_size, [this](const image_t image_id) {
+            if (feature_store_ != nullptr &&
+                feature_store_->ExistsDescriptors(image_id)) {
+              return true;
+            }
+            std::lock_guard<std::mutex> lock(database_mutex_);
+            return database_->ExistsDescriptors(image_id);
+          });
+
+  descriptor_types_cache_ = std::make_unique<
+      ThreadSafeLRUCache<image_t, FeatureDescriptorType>>(
+      num_images_cache_size, [this](const image_t image_id) {
+        std::lock_guard<std::mutex> lock(database_mutex_);
+        return database_->ReadDescriptorsType(image_id);
+      });
+
+  // The indices are always set explicitly in GetDescriptorIndex, such that
+  // they can be created outside of the lock.
+  descriptor_index_cache_ = std::make_unique<
+      MemoryConstrainedLRUCache<image_t, CachedDescriptorIndex>>(
+      max_descriptor_index_num_bytes_, [](const image_t image_id) {
+        LOG(FATAL_THROW) << "Descriptor index for image " << image_id
+                         << " not cached";
+        return CachedDescriptorIndex();
       });
 }
 
+void FeatureMatcherCache::SetFeatureStore(
+    std::shared_ptr<const FeatureStore> feature_store) {
+  THROW_CHECK(keypoints_cache_ == nullptr)
+      << "The feature store must be set before setup";
+  feature_store_ = std::move(feature_store);
+}
+
+void FeatureMatcherCache::SetLazyImageLoading(const bool lazy_image_loading) {
+  THROW_CHECK(keypoints_cache_ == nullptr)
+      << "Lazy image loading must be set before setup";
+  lazy_image_loading_ = lazy_image_loading;
+}
+
+void FeatureMatcherCache::LoadImages(const std::vector<image_t>& image_ids) {
+  std::vector<image_t> missing_image_ids;
+  for (const image_t image_id : image_ids) {
+    if (images_cache_.count(image_id) == 0) {
+      missing_image_ids.push_back(image_id);
+    }
+  }
+  if (missing_image_ids.empty()) {
+    return;
+  }
+
+  // Reading the images in the order of the primary key of the table keeps the
+  // lookups local in the database file.
+  std::sort(missing_image_ids.begin(), missing_image_ids.end());
+  missing_image_ids.erase(
+      std::unique(missing_image_ids.begin(), missing_image_ids.end()),
+      missing_image_ids.end());
+
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  for (const image_t image_id : missing_image_ids) {
+    if (database_->ExistsImage(image_id)) {
+      AddImage(database_->ReadImage(image_id));
+    }
+  }
+}
+
+image_t FeatureMatcherCache::FindImageWithName(const std::string& name) {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  if (!database_->ExistsImageWithName(name)) {
+    return kInvalidImageId;
+  }
+  Image image = database_->ReadImageWithName(name);
+  const image_t image_id = image.ImageId();
+  if (images_cache_.count(image_id) == 0) {
+    AddImage(std::move(image));
+  }
+  return image_id;
+}
+
+void FeatureMatcherCache::AddImage(Image image) {
+  const image_t image_id = image.ImageId();
+  const camera_t camera_id = image.CameraId();
+  if (cameras_cache_.count(camera_id) == 0) {
+    cameras_cache_.emplace(camera_id, database_->ReadCamera(camera_id));
+  }
+  if (database_->ExistsPosePrior(image_id)) {
+    locations_priors_cache_.emplace(image_id,
+                                    database_->ReadPosePrior(image_id));
+  }
+  images_cache_.emplace(image_id, std::move(image));
+}
+
 const Camera& FeatureMatcherCache::GetCamera(const camera_t camera_id) const {
   return cameras_cache_.at(camera_id);
 }
@@ -102,13 +255,17 @@ const PosePrior& FeatureMatcherCache::GetPosePrior(
 
 std::shared_ptr<FeatureKeypoints> FeatureMatcherCache::GetKeypoints(
     const image_t image_id) {
-  std::lock_guard<std::mutex> lock(database_mutex_);
+  static const CacheMetrics metrics =
+      GetCacheMetrics("feature_matcher_keypoints");
+  metrics.lookups->Increment();
   return keypoints_cache_->Get(image_id);
 }
 
 std::shared_ptr<FeatureDescriptors> FeatureMatcherCache::GetDescriptors(
     const image_t image_id) {
-  std::lock_guard<std::mutex> lock(database_mutex_);
+  static const CacheMetrics metrics =
+      GetCacheMetrics("feature_matcher_descriptors");
+  metrics.lookups->Increment();
   return descriptors_cache_->Get(image_id);
 }
 
@@ -118,6 +275,12 @@ FeatureMatches FeatureMatcherCache::GetMatches(const image_t image_id1,
   return database_->ReadMatches(image_id1, image_id2);
 }
 
+TwoViewGeometry FeatureMatcherCache::GetTwoViewGeometry(
+    const image_t image_id1, const image_t image_id2) {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  return database_->ReadTwoViewGeometry(image_id1, image_id2);
+}
+
 std::vector<image_t> FeatureMatcherCache::GetImageIds() const {
   std::vector<image_t> image_ids;
   image_ids.reserve(images_cache_.size());
@@ -127,31 +290,134 @@ std::vector<image_t> FeatureMatcherCache::GetImageIds() const {
   return image_ids;
 }
 
+std::vector<image_t> FeatureMatcherCache::AddNewImages() {
+  THROW_CHECK(keypoints_cache_ != nullptr)
+      << "New images can only be added after setup";
+
+  std::lock_guard<std::mutex> lock(database_mutex_);
+
+  for (Camera& camera : database_->ReadAllCameras()) {
+    const camera_t camera_id = camera.camera_id;
+    cameras_cache_.emplace(camera_id, std::move(camera));
+  }
+
+  std::vector<image_t> new_image_ids;
+  for (Image& image : database_->ReadAllImages()) {
+    const image_t image_id = image.ImageId();
+    if (images_cache_.count(image_id) > 0) {
+      continue;
+    }
+    if (database_->ExistsPosePrior(image_id)) {
+      locations_priors_cache_.emplace(image_id,
+                                      database_->ReadPosePrior(image_id));
+    }
+    images_cache_.emplace(image_id, std::move(image));
+    new_image_ids.push_back(image_id);
+  }
+
+  return new_image_ids;
+}
+
+std::shared_ptr<const FeatureDescriptorIndex>
+FeatureMatcherCache::GetDescriptorIndex(
+    const image_t image_id,
+    const std::function<std::shared_ptr<const FeatureDescriptorIndex>(
+        const std::shared_ptr<const FeatureDescriptors>&)>& create_index) {
+  std::unique_lock<std::mutex> lock(descriptor_index_mutex_);
+  if (descriptor_index_cache_->Exists(image_id)) {
+    return descriptor_index_cache_->Get(image_id).index;
+  }
+
+  // Another thread is already creating the index, so wait for it.
+  const auto pending_it = pending_descriptor_indices_.find(image_id);
+  if (pending_it != pending_descriptor_indices_.end()) {
+    const auto pending_index = pending_it->second;
+    lock.unlock();
+    return pending_index.get();
+  }
+
+  std::promise<std::shared_ptr<const FeatureDescriptorIndex>> promise;
+  pending_descriptor_indices_.emplace(image_id, promise.get_future().share());
+  lock.unlock();
+
+  std::shared_ptr<const FeatureDescriptorIndex> index;
+  try {
+    index = create_index(GetDescriptors(image_id));
+  } catch (...) {
+    lock.lock();
+    promise.set_exception(std::current_exception());
+    pending_descriptor_indices_.erase(image_id);
+    throw;
+  }
+
+  lock.lock();
+  descriptor_index_cache_->Set(image_id, CachedDescriptorIndex{index});
+  promise.set_value(index);
+  pending_descriptor_indices_.erase(image_id);
+  return index;
+}
+
 bool FeatureMatcherCache::ExistsPosePrior(const image_t image_id) const {
   return locations_priors_cache_.find(image_id) !=
          locations_priors_cache_.end();
 }
 
+size_t FeatureMatcherCache::NumBytes() {
+  size_t num_bytes = 0;
+  if (keypoints_cache_) {
+    keypoints_cache_->ForEach(
+        [&num_bytes](const image_t,
+                     const std::shared_ptr<FeatureKeypoints>& keypoints) {
+          if (keypoints) {
+            num_bytes += EstimateNumBytes(*keypoints);
+          }
+        });
+  }
+  if (descriptors_cache_) {
+    descriptors_cache_->ForEach(
+        [&num_bytes](const image_t,
+                     const std::shared_ptr<FeatureDescriptors>& descriptors) {
+          if (descriptors) {
+            num_bytes += descriptors->size() * sizeof(uint8_t);
+          }
+        });
+  }
+  std::lock_guard<std::mutex> lock(descriptor_index_mutex_);
+  if (descriptor_index_cache_) {
+    num_bytes += descriptor_index_cache_->NumBytes();
+  }
+  return num_bytes;
+}
+
+size_t FeatureMatcherCache::GetNumKeypoints(const image_t image_id) {
+  return num_keypoints_cache_->Get(image_id);
+}
+
+FeatureDescriptorType FeatureMatcherCache::GetDescriptorType(
+    const image_t image_id) {
+  return descriptor_types_cache_->Get(image_id);
+}
+
 bool FeatureMatcherCache::ExistsKeypoints(const image_t image_id) {
-  std::lock_guard<std::mutex> lock(database_mutex_);
   return keypoints_exists_cache_->Get(image_id);
 }
 
 bool FeatureMatcherCache::ExistsDescriptors(const image_t image_id) {
-  std::lock_guard<std::mutex> lock(database_mutex_);
   return descriptors_exists_cache_->Get(image_id);
 }
 
 bool FeatureMatcherCache::ExistsMatches(const image_t image_id1,
                                         const image_t image_id2) {
   std::lock_guard<std::mutex> lock(database_mutex_);
-  return database_->ExistsMatches(image_id1, image_id2);
+  return matched_pair_ids_.Exists(
+      Database::ImagePairToPairId(image_id1, image_id2));
 }
 
 bool FeatureMatcherCache::ExistsInlierMatches(const image_t image_id1,
                                               const image_t image_id2) {
   std::lock_guard<std::mutex> lock(database_mutex_);
-  return database_->ExistsInlierMatches(image_id1, image_id2);
+  return verified_pair_ids_.Exists(
+      Database::ImagePairToPairId(image_id1, image_id2));
 }
 
 void FeatureMatcherCache::WriteMatches(const image_t image_id1,
@@ -159,6 +425,7 @@ void FeatureMatcherCache::WriteMatches(const image_t image_id1,
                                        const FeatureMatches& matches) {
   std::lock_guard<std::mutex> lock(database_mutex_);
   database_->WriteMatches(image_id1, image_id2, matches);
+  matched_pair_ids_.Insert(Database::ImagePairToPairId(image_id1, image_id2));
 }
 
 void FeatureMatcherCache::WriteTwoViewGeometry(
@@ -167,18 +434,83 @@ void FeatureMatcherCache::WriteTwoViewGeometry(
     const TwoViewGeometry& two_view_geometry) {
   std::lock_guard<std::mutex> lock(database_mutex_);
   database_->WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  verified_pair_ids_.Insert(Database::ImagePairToPairId(image_id1, image_id2));
+}
+
+Eigen::VectorXf FeatureMatcherCache::GetGlobalDescriptor(
+    const image_t image_id) {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  return database_->ReadGlobalDescriptor(image_id);
+}
+
+void FeatureMatcherCache::WriteGlobalDescriptor(
+    const image_t image_id, const Eigen::VectorXf& descriptor) {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  database_->WriteGlobalDescriptor(image_id, descriptor);
 }
 
 void FeatureMatcherCache::DeleteMatches(const image_t image_id1,
                                         const image_t image_id2) {
   std::lock_guard<std::mutex> lock(database_mutex_);
   database_->DeleteMatches(image_id1, image_id2);
+  matched_pair_ids_.Erase(Database::ImagePairToPairId(image_id1, image_id2));
 }
 
 void FeatureMatcherCache::DeleteInlierMatches(const image_t image_id1,
                                               const image_t image_id2) {
   std::lock_guard<std::mutex> lock(database_mutex_);
   database_->DeleteInlierMatches(image_id1, image_id2);
+  verified_pair_ids_.Erase(Database::ImagePairToPairId(image_id1, image_id2));
+}
+
+FeatureMatcherCache::ImagePairIdSet::ImagePairIdSet(
+    std::vector<image_pair_t> sorted_pair_ids)
+    : sorted_pair_ids_(std::move(sorted_pair_ids)) {
+  THROW_CHECK(
+      std::is_sorted(sorted_pair_ids_.begin(), sorted_pair_ids_.end()));
+}
+
+bool FeatureMatcherCache::ImagePairIdSet::Exists(
+    const image_pair_t pair_id) const {
+  if (inserted_pair_ids_.count(pair_id) > 0) {
+    return true;
+  }
+  if (erased_pair_ids_.count(pair_id) > 0) {
+    return false;
+  }
+  return ExistsSorted(pair_id);
+}
+
+void FeatureMatcherCache::ImagePairIdSet::Insert(const image_pair_t pair_id) {
+  erased_pair_ids_.erase(pair_id);
+  if (!ExistsSorted(pair_id)) {
+    inserted_pair_ids_.insert(pair_id);
+  }
+}
+
+void FeatureMatcherCache::ImagePairIdSet::Erase(const image_pair_t pair_id) {
+  inserted_pair_ids_.erase(pair_id);
+  if (ExistsSorted(pair_id)) {
+    erased_pair_ids_.insert(pair_id);
+  }
+}
+
+bool FeatureMatcherCache::ImagePairIdSet::ExistsSorted(
+    const image_pair_t pair_id) const {
+  return std::binary_search(
+      sorted_pair_ids_.begin(), sorted_pair_ids_.end(), pair_id);
+}
+
+void FeatureMatcherCache::BeginTransaction() {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  THROW_CHECK(database_transaction_ == nullptr);
+  database_transaction_ = std::make_unique<DatabaseTransaction>(database_.get());
+}
+
+void FeatureMatcherCache::EndTransaction() {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  THROW_CHECK_NOTNULL(database_transaction_);
+  database_transaction_.reset();
 }
 
 }  // namespace colmap
@@ -33,16 +33,35 @@
 #include "colmap/geometry/gps.h"
 #include "colmap/scene/camera.h"
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/scene/image.h"
 #include "colmap/scene/two_view_geometry.h"
 #include "colmap/util/cache.h"
 #include "colmap/util/types.h"
 
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace colmap {
+
+// Search index over the descriptors of one image, e.g., a kd-tree used for
+// approximate nearest neighbor search. Building an index can be expensive and
+// the same image usually participates in many image pairs, so the indices are
+// built once per image and shared across matchers, see
+// `FeatureMatcherCache::GetDescriptorIndex`.
+class FeatureDescriptorIndex {
+ public:
+  virtual ~FeatureDescriptorIndex() = default;
+
+  // Approximate memory consumption of the index in bytes.
+  virtual size_t NumBytes() const = 0;
+};
+
 // api: 特征匹配类，FeatureMatcherWorker的每次Run中实例化
 class FeatureMatcher {
  public:
@@ -67,6 +86,37 @@ class FeatureMatcher {
       const std::shared_ptr<const FeatureDescriptors>& descriptors1,
       const std::shared_ptr<const FeatureDescriptors>& descriptors2,
       TwoViewGeometry* two_view_geometry) = 0;
+
+  // Match one set of query descriptors against multiple sets of target
+  // descriptors. The callback is invoked with the index of the target and its
+  // matches as soon as the matches of that target are available, so that the
+  // caller can start processing the results while the remaining targets are
+  // still being matched. As in `Match`, the query descriptors may be null, if
+  // they are identical to the previous call. The default implementation calls
+  // `Match` for each target, while implementations can override it to keep the
+  // query resident on the device and amortize setup costs across the batch.
+  typedef std::function<void(size_t target_idx, FeatureMatches* matches)>
+      MatchBatchCallback;
+  virtual void MatchBatch(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+      const std::vector<std::shared_ptr<const FeatureDescriptors>>&
+          descriptors2,
+      const MatchBatchCallback& callback);
+
+  // Create a search index over the given descriptors that can be passed to
+  // `SetDescriptorIndices`. Returns null, if the matcher does not use indices.
+  virtual std::shared_ptr<const FeatureDescriptorIndex> CreateDescriptorIndex(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors) const {
+    return nullptr;
+  }
+
+  // Pre-built indices for the non-null descriptors passed to the next call of
+  // Match or MatchGuided. If an index is null, the matcher builds the index
+  // itself, if it needs one. Each index must have been created by
+  // `CreateDescriptorIndex` of the same type of matcher.
+  virtual void SetDescriptorIndices(
+      std::shared_ptr<const FeatureDescriptorIndex> index1,
+      std::shared_ptr<const FeatureDescriptorIndex> index2) {}
 };
 
 // Cache for feature matching to minimize database access during matching.
@@ -75,23 +125,77 @@ class FeatureMatcherCache {
  public:
   FeatureMatcherCache(size_t cache_size,
                       std::shared_ptr<Database> database,
-                      bool do_setup = false);
+                      bool do_setup = false,
+                      size_t max_descriptor_index_num_bytes =
+                          kDefaultMaxDescriptorIndexNumBytes);
+
+  // Default memory limit of the cached descriptor indices.
+  static constexpr size_t kDefaultMaxDescriptorIndexNumBytes = 4ull << 30;
 
   // api: 设置特征匹配数据缓存
   void Setup();
 
+  // Read keypoints and descriptors from the given store instead of the
+  // database for the images contained in the store. Must be called before
+  // `Setup`.
+  void SetFeatureStore(std::shared_ptr<const FeatureStore> feature_store);
+
+  // Only load the cameras, images, and pose priors of the images requested by
+  // `LoadImages` and `FindImageWithName` instead of all images in the
+  // database during setup. Must be called before `Setup`.
+  void SetLazyImageLoading(bool lazy_image_loading);
+
+  // Load the cameras, images, and pose priors of the given images, unless
+  // they are already loaded. The images are read in one batch sorted by their
+  // identifiers. Must not be called concurrently with the other accessors of
+  // the images.
+  void LoadImages(const std::vector<image_t>& image_ids);
+
+  // Find and load the image with the given name. Returns kInvalidImageId, if
+  // the image does not exist. Must not be called concurrently with the other
+  // accessors of the images.
+  image_t FindImageWithName(const std::string& name);
+
   const Camera& GetCamera(camera_t camera_id) const;
   const Image& GetImage(image_t image_id) const;
   const PosePrior& GetPosePrior(image_t image_id) const;
   std::shared_ptr<FeatureKeypoints> GetKeypoints(image_t image_id);
   std::shared_ptr<FeatureDescriptors> GetDescriptors(image_t image_id);
   FeatureMatches GetMatches(image_t image_id1, image_t image_id2);
+  TwoViewGeometry GetTwoViewGeometry(image_t image_id1, image_t image_id2);
   std::vector<image_t> GetImageIds() const;
 
+  // Add the cameras and images written to the database since the setup, e.g.,
+  // by a concurrent feature extractor, and return the ids of the new images.
+  // Must not be called concurrently with the other accessors of the images.
+  std::vector<image_t> AddNewImages();
+
+  // Get the search index over the descriptors of the image. If the index is not
+  // cached, it is created once using the given function, even if multiple
+  // threads request the index concurrently. The index is created without
+  // blocking other accesses to the cache.
+  std::shared_ptr<const FeatureDescriptorIndex> GetDescriptorIndex(
+      image_t image_id,
+      const std::function<std::shared_ptr<const FeatureDescriptorIndex>(
+          const std::shared_ptr<const FeatureDescriptors>&)>& create_index);
+
+  // Number of keypoints of the image without reading the keypoints.
+  size_t GetNumKeypoints(image_t image_id);
+
+  // Estimated memory usage of the cached keypoints, descriptors, and
+  // descriptor indices in bytes.
+  size_t NumBytes();
+
+  // Type of the descriptors of the image as recorded in the database.
+  FeatureDescriptorType GetDescriptorType(image_t image_id);
+
   bool ExistsPosePrior(image_t image_id) const;
   bool ExistsKeypoints(image_t image_id);
   bool ExistsDescriptors(image_t image_id);
 
+  // The image pairs with (inlier) matches are read once during setup and then
+  // kept up to date by the writes and deletes of the cache, such that these
+  // lookups do not query the database.
   bool ExistsMatches(image_t image_id1, image_t image_id2);
   bool ExistsInlierMatches(image_t image_id1, image_t image_id2);
 
@@ -102,22 +206,82 @@ class FeatureMatcherCache {
                             image_t image_id2,
                             const TwoViewGeometry& two_view_geometry);
 
+  // Global descriptor of the image in the database, which is empty, if the
+  // image has no stored descriptor. Global descriptors are not cached.
+  Eigen::VectorXf GetGlobalDescriptor(image_t image_id);
+  void WriteGlobalDescriptor(image_t image_id,
+                             const Eigen::VectorXf& descriptor);
+
   void DeleteMatches(image_t image_id1, image_t image_id2);
   void DeleteInlierMatches(image_t image_id1, image_t image_id2);
 
+  // Begin and end a transaction on the database that is synchronized with the
+  // other database accesses of the cache. Both must be called from the same
+  // thread, see `DatabaseTransaction`.
+  void BeginTransaction();
+  void EndTransaction();
+
  private:
+  // Compact set of image pairs, which holds the pairs read during setup in a
+  // sorted array and only the later changes in hash sets.
+  class ImagePairIdSet {
+   public:
+    ImagePairIdSet() = default;
+    explicit ImagePairIdSet(std::vector<image_pair_t> sorted_pair_ids);
+
+    bool Exists(image_pair_t pair_id) const;
+    void Insert(image_pair_t pair_id);
+    void Erase(image_pair_t pair_id);
+
+   private:
+    bool ExistsSorted(image_pair_t pair_id) const;
+
+    std::vector<image_pair_t> sorted_pair_ids_;
+    std::unordered_set<image_pair_t> inserted_pair_ids_;
+    std::unordered_set<image_pair_t> erased_pair_ids_;
+  };
+
   const size_t cache_size_;
+
+  // Add the image and its camera and pose prior to the caches. Requires the
+  // database to be locked by the caller.
+  void AddImage(Image image);
+
   const std::shared_ptr<Database> database_;
   std::mutex database_mutex_;
+  std::unique_ptr<DatabaseTransaction> database_transaction_;
+  std::shared_ptr<const FeatureStore> feature_store_;
+  bool lazy_image_loading_ = false;
   std::unordered_map<camera_t, Camera> cameras_cache_;
   std::unordered_map<image_t, Image> images_cache_;
   std::unordered_map<image_t, PosePrior> locations_priors_cache_;
-  std::unique_ptr<LRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>
+  ImagePairIdSet matched_pair_ids_;
+  ImagePairIdSet verified_pair_ids_;
+  std::unique_ptr<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>
       keypoints_cache_;
-  std::unique_ptr<LRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>
+  std::unique_ptr<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>
       descriptors_cache_;
-  std::unique_ptr<LRUCache<image_t, bool>> keypoints_exists_cache_;
-  std::unique_ptr<LRUCache<image_t, bool>> descriptors_exists_cache_;
+  std::unique_ptr<ThreadSafeLRUCache<image_t, size_t>> num_keypoints_cache_;
+  std::unique_ptr<ThreadSafeLRUCache<image_t, bool>> keypoints_exists_cache_;
+  std::unique_ptr<ThreadSafeLRUCache<image_t, bool>> descriptors_exists_cache_;
+  std::unique_ptr<ThreadSafeLRUCache<image_t, FeatureDescriptorType>>
+      descriptor_types_cache_;
+
+  struct CachedDescriptorIndex {
+    std::shared_ptr<const FeatureDescriptorIndex> index;
+    size_t NumBytes() const { return index == nullptr ? 0 : index->NumBytes(); }
+  };
+
+  const size_t max_descriptor_index_num_bytes_;
+  std::mutex descriptor_index_mutex_;
+  std::unique_ptr<MemoryConstrainedLRUCache<image_t, CachedDescriptorIndex>>
+      descriptor_index_cache_;
+  std::unordered_map<
+      image_t,
+      std::shared_future<std::shared_ptr<const FeatureDescriptorIndex>>>
+      pending_descriptor_indices_;
 };
 
 }  // namespace colmap
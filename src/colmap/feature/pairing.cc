@@ -31,11 +31,17 @@
 
 #include "colmap/feature/utils.h"
 #include "colmap/geometry/gps.h"
+#include "colmap/retrieval/vlad.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/timer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
 #include <numeric>
 #include <unordered_map>
 #include <unordered_set>
@@ -46,7 +52,7 @@ namespace {
 
 std::vector<std::pair<image_t, image_t>> ReadImagePairsText(
     const std::string& path,
-    const std::unordered_map<std::string, image_t>& image_name_to_image_id) {
+    const std::function<image_t(const std::string&)>& find_image_id) {
   std::ifstream file(path);
   THROW_CHECK_FILE_OPEN(file, path);
 
@@ -70,17 +76,17 @@ std::vector<std::pair<image_t, image_t>> ReadImagePairsText(
     std::getline(line_stream, image_name2, ' ');
     StringTrim(&image_name2);
 
-    if (image_name_to_image_id.count(image_name1) == 0) {
+    const image_t image_id1 = find_image_id(image_name1);
+    if (image_id1 == kInvalidImageId) {
       LOG(ERROR) << "Image " << image_name1 << " does not exist.";
       continue;
     }
-    if (image_name_to_image_id.count(image_name2) == 0) {
+    const image_t image_id2 = find_image_id(image_name2);
+    if (image_id2 == kInvalidImageId) {
       LOG(ERROR) << "Image " << image_name2 << " does not exist.";
       continue;
     }
 
-    const image_t image_id1 = image_name_to_image_id.at(image_name1);
-    const image_t image_id2 = image_name_to_image_id.at(image_name2);
     const image_pair_t image_pair =
         Database::ImagePairToPairId(image_id1, image_id2);
     const bool image_pair_exists = image_pairs_set.insert(image_pair).second;
@@ -91,6 +97,38 @@ std::vector<std::pair<image_t, image_t>> ReadImagePairsText(
   return image_pairs;
 }
 
+std::vector<image_t> ReadImageNamesList(
+    const std::string& path,
+    const std::vector<image_t>& image_ids,
+    const FeatureMatcherCache& cache) {
+  // Map image names to image identifiers.
+  std::unordered_map<std::string, image_t> image_name_to_image_id;
+  image_name_to_image_id.reserve(image_ids.size());
+  for (const auto image_id : image_ids) {
+    const auto& image = cache.GetImage(image_id);
+    image_name_to_image_id.emplace(image.Name(), image_id);
+  }
+
+  std::ifstream file(path);
+  THROW_CHECK_FILE_OPEN(file, path);
+  std::string line;
+  std::vector<image_t> list_image_ids;
+  while (std::getline(file, line)) {
+    StringTrim(&line);
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    if (image_name_to_image_id.count(line) == 0) {
+      LOG(ERROR) << "Image " << line << " does not exist.";
+    } else {
+      list_image_ids.push_back(image_name_to_image_id.at(line));
+    }
+  }
+  return list_image_ids;
+}
+
 }  // namespace
 
 bool ExhaustiveMatchingOptions::Check() const {
@@ -102,6 +140,26 @@ bool VocabTreeMatchingOptions::Check() const {
   CHECK_OPTION_GT(num_images, 0);
   CHECK_OPTION_GT(num_nearest_neighbors, 0);
   CHECK_OPTION_GT(num_checks, 0);
+  if (spatial_union) {
+    CHECK_OPTION_GT(spatial_max_distance, 0.0);
+    CHECK_OPTION_GT(spatial_max_num_neighbors, 0);
+  }
+  return true;
+}
+
+SpatialMatchingOptions VocabTreeMatchingOptions::SpatialOptions() const {
+  SpatialMatchingOptions options;
+  options.ignore_z = spatial_ignore_z;
+  options.max_num_neighbors = spatial_max_num_neighbors;
+  options.max_distance = spatial_max_distance;
+  options.num_threads = num_threads;
+  return options;
+}
+
+bool VLADMatchingOptions::Check() const {
+  CHECK_OPTION_GT(num_images, 0);
+  CHECK_OPTION_GT(num_clusters, 1);
+  CHECK_OPTION_GT(num_probes, 0);
   return true;
 }
 
@@ -230,53 +288,78 @@ VocabTreePairGenerator::VocabTreePairGenerator(
     : options_(options),
       cache_(std::move(THROW_CHECK_NOTNULL(cache))),
       thread_pool(options_.num_threads),
-      queue(options_.num_threads) {
+      queue(options_.num_threads),
+      visual_index_(std::make_shared<retrieval::VisualIndex<>>()) {
   THROW_CHECK(options.Check());
   LOG(INFO) << "Generating image pairs with vocabulary tree...";
 
-  // Read the pre-trained vocabulary tree from disk.
-  visual_index_.Read(options_.vocab_tree_path);
-
   const std::vector<image_t> all_image_ids = cache_->GetImageIds();
-  if (query_image_ids.size() > 0) {
-    query_image_ids_ = query_image_ids;
-  } else if (options_.match_list_path == "") {
-    query_image_ids_ = cache_->GetImageIds();
+
+  if (!options_.index_path.empty() && ExistsFile(options_.index_path)) {
+    // Read the visual index of a previous run from disk.
+    LOG(INFO) << "Reading visual index from " << options_.index_path;
+    visual_index_->Read(options_.index_path);
+    database_image_ids_.insert(all_image_ids.begin(), all_image_ids.end());
   } else {
-    // Map image names to image identifiers.
-    std::unordered_map<std::string, image_t> image_name_to_image_id;
-    image_name_to_image_id.reserve(all_image_ids.size());
-    for (const auto image_id : all_image_ids) {
-      const auto& image = cache_->GetImage(image_id);
-      image_name_to_image_id.emplace(image.Name(), image_id);
-    }
+    // Read the pre-trained vocabulary tree from disk.
+    visual_index_->Read(options_.vocab_tree_path);
+  }
 
-    // Read the match list path.
-    std::ifstream file(options_.match_list_path);
-    THROW_CHECK_FILE_OPEN(file, options_.match_list_path);
-    std::string line;
-    while (std::getline(file, line)) {
-      StringTrim(&line);
+  for (std::string shard_path : StringSplit(options_.index_shard_paths, ",")) {
+    StringTrim(&shard_path);
+    if (shard_path.empty()) {
+      continue;
+    }
+    LOG(INFO) << "Reading visual index shard from " << shard_path;
+    auto shard = std::make_shared<retrieval::VisualIndex<>>();
+    shard->Read(shard_path);
+    sharded_index_.AddShard(std::move(shard));
+  }
+  const bool has_shards = sharded_index_.NumShards() > 0;
+  if (has_shards) {
+    database_image_ids_.insert(all_image_ids.begin(), all_image_ids.end());
+  }
 
-      if (line.empty() || line[0] == '#') {
-        continue;
-      }
+  std::vector<image_t> new_image_ids;
+  for (const image_t image_id : all_image_ids) {
+    if (!visual_index_->ImageIndexed(image_id) &&
+        !sharded_index_.ImageIndexed(image_id)) {
+      new_image_ids.push_back(image_id);
+    }
+  }
 
-      if (image_name_to_image_id.count(line) == 0) {
-        LOG(ERROR) << "Image " << line << " does not exist.";
-      } else {
-        query_image_ids_.push_back(image_name_to_image_id.at(line));
-      }
+  if (query_image_ids.size() > 0) {
+    query_image_ids_ = query_image_ids;
+  } else if (options_.match_list_path == "") {
+    if (options_.index_path.empty() && !has_shards) {
+      query_image_ids_ = all_image_ids;
+    } else {
+      query_image_ids_ = new_image_ids;
     }
+  } else {
+    query_image_ids_ = ReadImageNamesList(
+        options_.match_list_path, all_image_ids, *cache_);
   }
 
-  IndexImages(all_image_ids);
+  LOG(INFO) << StringPrintf("Indexing %d of %d images",
+                            new_image_ids.size(),
+                            all_image_ids.size());
+  IndexImages(new_image_ids);
+  if (!new_image_ids.empty()) {
+    WriteIndex();
+  }
+  sharded_index_.AddShard(visual_index_);
 
   query_options_.max_num_images = options_.num_images;
   query_options_.num_neighbors = options_.num_nearest_neighbors;
   query_options_.num_checks = options_.num_checks;
   query_options_.num_images_after_verification =
       options_.num_images_after_verification;
+
+  if (options_.spatial_max_distance > 0) {
+    spatial_pair_generator_ =
+        std::make_unique<SpatialPairGenerator>(options_.SpatialOptions(), cache_);
+  }
 }
 
 VocabTreePairGenerator::VocabTreePairGenerator(
@@ -290,6 +373,8 @@ VocabTreePairGenerator::VocabTreePairGenerator(
                                                 /*do_setup=*/true),
           query_image_ids) {}
 
+VocabTreePairGenerator::~VocabTreePairGenerator() = default;
+
 void VocabTreePairGenerator::Reset() {
   query_idx_ = 0;
   result_idx_ = 0;
@@ -333,9 +418,35 @@ std::vector<std::pair<image_t, image_t>> VocabTreePairGenerator::Next() {
 
   // Compose the image pairs from the scores.
   image_pairs_.reserve(image_scores.size());
-  for (const auto image_score : image_scores) {
-    image_pairs_.emplace_back(image_id, image_score.image_id);
+  if (spatial_pair_generator_ == nullptr || options_.spatial_union) {
+    for (const auto image_score : image_scores) {
+      image_pairs_.emplace_back(image_id, image_score.image_id);
+    }
+  } else {
+    // Reject the retrieved images that are too far away, before their
+    // features are loaded and matched.
+    for (const auto image_score : image_scores) {
+      if (spatial_pair_generator_->IsWithinMaxDistance(image_id,
+                                                       image_score.image_id)) {
+        image_pairs_.emplace_back(image_id, image_score.image_id);
+      }
+    }
   }
+
+  if (spatial_pair_generator_ != nullptr && options_.spatial_union) {
+    std::unordered_set<image_t> retrieved_image_ids;
+    retrieved_image_ids.reserve(image_scores.size());
+    for (const auto image_score : image_scores) {
+      retrieved_image_ids.insert(image_score.image_id);
+    }
+    for (const image_t nn_image_id :
+         spatial_pair_generator_->FindNeighbors(image_id)) {
+      if (retrieved_image_ids.count(nn_image_id) == 0) {
+        image_pairs_.emplace_back(image_id, nn_image_id);
+      }
+    }
+  }
+
   ++result_idx_;
   return image_pairs_;
 }
@@ -358,12 +469,12 @@ void VocabTreePairGenerator::IndexImages(
       ExtractTopScaleFeatures(
           &keypoints, &descriptors, options_.max_num_features);
     }
-    visual_index_.Add(index_options, image_ids[i], keypoints, descriptors);
+    visual_index_->Add(index_options, image_ids[i], keypoints, descriptors);
     LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
   }
 
   // Compute the TF-IDF weights, etc.
-  visual_index_.Prepare();
+  visual_index_->Prepare();
 }
 
 void VocabTreePairGenerator::Query(const image_t image_id) {
@@ -377,12 +488,182 @@ void VocabTreePairGenerator::Query(const image_t image_id) {
 
   Retrieval retrieval;
   retrieval.image_id = image_id;
-  visual_index_.Query(
+  sharded_index_.Query(
       query_options_, keypoints, descriptors, &retrieval.image_scores);
 
+  if (!database_image_ids_.empty()) {
+    retrieval.image_scores.erase(
+        std::remove_if(retrieval.image_scores.begin(),
+                       retrieval.image_scores.end(),
+                       [this](const retrieval::ImageScore& image_score) {
+                         return database_image_ids_.count(
+                                    image_score.image_id) == 0;
+                       }),
+        retrieval.image_scores.end());
+  }
+
   THROW_CHECK(queue.Push(std::move(retrieval)));
 }
 
+void VocabTreePairGenerator::WriteIndex() {
+  if (options_.index_path.empty()) {
+    return;
+  }
+  // The index might be mapped from the index path, so it is written to a
+  // temporary file first, which then replaces the mapped file.
+  LOG(INFO) << "Writing visual index to " << options_.index_path;
+  const std::string tmp_index_path = options_.index_path + ".tmp";
+  visual_index_->WritePacked(tmp_index_path);
+  RenameFile(tmp_index_path, options_.index_path);
+}
+
+VLADPairGenerator::VLADPairGenerator(
+    const VLADMatchingOptions& options,
+    std::shared_ptr<FeatureMatcherCache> cache)
+    : options_(options), cache_(std::move(THROW_CHECK_NOTNULL(cache))) {
+  THROW_CHECK(options.Check());
+  LOG(INFO) << "Generating image pairs with global VLAD descriptors...";
+
+  const std::vector<image_t> image_ids = cache_->GetImageIds();
+  if (options_.match_list_path == "") {
+    query_image_ids_ = image_ids;
+  } else {
+    query_image_ids_ =
+        ReadImageNamesList(options_.match_list_path, image_ids, *cache_);
+  }
+
+  if (image_ids.empty()) {
+    return;
+  }
+
+  const retrieval::IVFIndex::DescType descriptors = DescribeImages(image_ids);
+
+  Timer timer;
+  timer.Start();
+  LOG(INFO) << "Building index...";
+  retrieval::IVFIndex::BuildOptions build_options;
+  build_options.num_lists = options_.num_lists;
+  build_options.num_threads = options_.num_threads;
+  index_.Build(build_options,
+               std::vector<int>(image_ids.begin(), image_ids.end()),
+               descriptors);
+  LOG(INFO) << StringPrintf(
+      " %d lists in %.3fs", index_.NumLists(), timer.ElapsedSeconds());
+}
+
+VLADPairGenerator::VLADPairGenerator(const VLADMatchingOptions& options,
+                                     const std::shared_ptr<Database>& database)
+    : VLADPairGenerator(
+          options,
+          std::make_shared<FeatureMatcherCache>(CacheSize(options),
+                                                THROW_CHECK_NOTNULL(database),
+                                                /*do_setup=*/true)) {}
+
+void VLADPairGenerator::Reset() { query_idx_ = 0; }
+
+bool VLADPairGenerator::HasFinished() const {
+  return query_idx_ >= query_image_ids_.size();
+}
+
+std::vector<std::pair<image_t, image_t>> VLADPairGenerator::Next() {
+  image_pairs_.clear();
+  if (HasFinished()) {
+    return image_pairs_;
+  }
+
+  LOG(INFO) << StringPrintf(
+      "Matching image [%d/%d]", query_idx_ + 1, query_image_ids_.size());
+
+  // The query image is retrieved as well, so one more image is requested.
+  const image_t image_id = query_image_ids_[query_idx_++];
+  index_.Query(cache_->GetGlobalDescriptor(image_id),
+               options_.num_probes,
+               options_.num_images + 1,
+               &image_scores_);
+
+  image_pairs_.reserve(image_scores_.size());
+  for (const auto& image_score : image_scores_) {
+    if (image_score.image_id != static_cast<int>(image_id) &&
+        image_pairs_.size() < static_cast<size_t>(options_.num_images)) {
+      image_pairs_.emplace_back(image_id, image_score.image_id);
+    }
+  }
+  return image_pairs_;
+}
+
+retrieval::IVFIndex::DescType VLADPairGenerator::DescribeImages(
+    const std::vector<image_t>& image_ids) {
+  Timer timer;
+  timer.Start();
+
+  // Descriptors of previous runs are reused, if they have the dimension of
+  // the VLAD descriptors of SIFT features with the given number of clusters.
+  const int num_dims = options_.num_clusters * 128;
+  std::vector<Eigen::VectorXf> descriptors(image_ids.size());
+  std::vector<size_t> new_image_idxs;
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    descriptors[i] = cache_->GetGlobalDescriptor(image_ids[i]);
+    if (descriptors[i].size() != num_dims) {
+      new_image_idxs.push_back(i);
+    }
+  }
+
+  // The vocabulary tree is only read, if any descriptors must be computed.
+  retrieval::VLADEncoder encoder;
+  if (!new_image_idxs.empty()) {
+    LOG(INFO) << "Learning VLAD codebook from vocabulary tree...";
+    retrieval::VisualIndex<> visual_index;
+    visual_index.Read(options_.vocab_tree_path);
+    retrieval::HierarchicalKMeansOptions kmeans_options;
+    kmeans_options.num_clusters = options_.num_clusters;
+    kmeans_options.branching = options_.num_clusters;
+    kmeans_options.num_threads = options_.num_threads;
+    encoder = retrieval::VLADEncoder(retrieval::HierarchicalKMeans(
+        kmeans_options, visual_index.VisualWords()));
+    THROW_CHECK_EQ(encoder.NumDims(), num_dims)
+        << "The vocabulary tree has fewer distinct visual words than the "
+           "number of clusters";
+  }
+
+  LOG(INFO) << StringPrintf("Describing %d of %d images",
+                            new_image_idxs.size(),
+                            image_ids.size());
+
+  ThreadPool thread_pool(options_.num_threads);
+  std::vector<std::future<void>> futures;
+  futures.reserve(new_image_idxs.size());
+  for (const size_t image_idx : new_image_idxs) {
+    futures.push_back(thread_pool.AddTask([&, image_idx]() {
+      auto keypoints = *cache_->GetKeypoints(image_ids[image_idx]);
+      auto descriptors_i = *cache_->GetDescriptors(image_ids[image_idx]);
+      if (options_.max_num_features > 0 &&
+          descriptors_i.rows() > options_.max_num_features) {
+        ExtractTopScaleFeatures(
+            &keypoints, &descriptors_i, options_.max_num_features);
+      }
+      descriptors[image_idx] = encoder.Encode(descriptors_i);
+    }));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  cache_->BeginTransaction();
+  for (const size_t image_idx : new_image_idxs) {
+    cache_->WriteGlobalDescriptor(image_ids[image_idx],
+                                  descriptors[image_idx]);
+  }
+  cache_->EndTransaction();
+
+  retrieval::IVFIndex::DescType descriptors_matrix(image_ids.size(), num_dims);
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    descriptors_matrix.row(i) = descriptors[i];
+  }
+
+  LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
+  return descriptors_matrix;
+}
+
 SequentialPairGenerator::SequentialPairGenerator(
     const SequentialMatchingOptions& options,
     std::shared_ptr<FeatureMatcherCache> cache)
@@ -390,9 +671,24 @@ SequentialPairGenerator::SequentialPairGenerator(
   THROW_CHECK(options.Check());
   LOG(INFO) << "Generating sequential image pairs...";
   image_ids_ = GetOrderedImageIds();
+  image_idxs_.reserve(image_ids_.size());
+  for (size_t i = 0; i < image_ids_.size(); ++i) {
+    image_idxs_.emplace(image_ids_[i], i);
+  }
   image_pairs_.reserve(options_.overlap);
 
-  if (options_.loop_detection) {
+  if (options_.loop_detection && options_.loop_detection_incremental) {
+    loop_detection_index_ = std::make_unique<retrieval::VisualIndex<>>();
+    loop_detection_index_->Read(options_.vocab_tree_path);
+    loop_detection_query_options_.max_num_images =
+        options_.loop_detection_num_images;
+    loop_detection_query_options_.num_neighbors =
+        options_.loop_detection_num_nearest_neighbors;
+    loop_detection_query_options_.num_checks =
+        options_.loop_detection_num_checks;
+    loop_detection_query_options_.num_images_after_verification =
+        options_.loop_detection_num_images_after_verification;
+  } else if (options_.loop_detection) {
     std::vector<image_t> query_image_ids;
     for (size_t i = 0; i < image_ids_.size();
          i += options_.loop_detection_period) {
@@ -413,6 +709,10 @@ SequentialPairGenerator::SequentialPairGenerator(
                                                 /*do_setup=*/true)) {}
 
 void SequentialPairGenerator::Reset() {
+  if (loop_detection_index_ && image_idx_ > 0) {
+    // Start over with an empty index for the restarted sequence.
+    loop_detection_index_->Read(options_.vocab_tree_path);
+  }
   image_idx_ = 0;
   if (vocab_tree_pair_generator_) {
     vocab_tree_pair_generator_->Reset();
@@ -454,10 +754,79 @@ std::vector<std::pair<image_t, image_t>> SequentialPairGenerator::Next() {
       break;
     }
   }
+  if (loop_detection_index_) {
+    DetectLoopsIncrementally();
+  }
   ++image_idx_;
   return image_pairs_;
 }
 
+bool SequentialPairGenerator::PrecedingImagePair(
+    const std::pair<image_t, image_t>& image_pair,
+    std::pair<image_t, image_t>* preceding_image_pair) const {
+  const auto image_idx1 = image_idxs_.find(image_pair.first);
+  const auto image_idx2 = image_idxs_.find(image_pair.second);
+  if (image_idx1 == image_idxs_.end() || image_idx2 == image_idxs_.end() ||
+      image_idx2->second <= image_idx1->second) {
+    return false;
+  }
+  const size_t offset = image_idx2->second - image_idx1->second;
+  if (offset > image_idx1->second) {
+    return false;
+  }
+  preceding_image_pair->first = image_ids_[image_idx1->second - offset];
+  preceding_image_pair->second = image_pair.first;
+  return true;
+}
+
+void SequentialPairGenerator::ReadLoopDetectionFeatures(
+    const image_t image_id,
+    FeatureKeypoints* keypoints,
+    FeatureDescriptors* descriptors) const {
+  *keypoints = *cache_->GetKeypoints(image_id);
+  *descriptors = *cache_->GetDescriptors(image_id);
+  if (options_.loop_detection_max_num_features > 0 &&
+      descriptors->rows() > options_.loop_detection_max_num_features) {
+    ExtractTopScaleFeatures(
+        keypoints, descriptors, options_.loop_detection_max_num_features);
+  }
+}
+
+void SequentialPairGenerator::DetectLoopsIncrementally() {
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+
+  // The preceding images within the overlap are matched sequentially, so only
+  // the images before are candidates for loops.
+  if (image_idx_ < static_cast<size_t>(options_.overlap)) {
+    return;
+  }
+
+  const image_t prev_image_id = image_ids_.at(image_idx_ - options_.overlap);
+  ReadLoopDetectionFeatures(prev_image_id, &keypoints, &descriptors);
+  retrieval::VisualIndex<>::IndexOptions index_options;
+  index_options.num_checks = options_.loop_detection_num_checks;
+  loop_detection_index_->Add(
+      index_options, prev_image_id, keypoints, descriptors);
+
+  if (image_idx_ % options_.loop_detection_period != 0) {
+    return;
+  }
+
+  // The index is only prepared before the queries, such that the cost of
+  // updating the weights is amortized over the loop detection period.
+  loop_detection_index_->Prepare();
+
+  const image_t image_id = image_ids_.at(image_idx_);
+  ReadLoopDetectionFeatures(image_id, &keypoints, &descriptors);
+  std::vector<retrieval::ImageScore> image_scores;
+  loop_detection_index_->Query(
+      loop_detection_query_options_, keypoints, descriptors, &image_scores);
+  for (const auto& image_score : image_scores) {
+    image_pairs_.emplace_back(image_id, image_score.image_id);
+  }
+}
+
 std::vector<image_t> SequentialPairGenerator::GetOrderedImageIds() const {
   const std::vector<image_t> image_ids = cache_->GetImageIds();
 
@@ -485,7 +854,9 @@ std::vector<image_t> SequentialPairGenerator::GetOrderedImageIds() const {
 SpatialPairGenerator::SpatialPairGenerator(
     const SpatialMatchingOptions& options,
     const std::shared_ptr<FeatureMatcherCache>& cache)
-    : options_(options), image_ids_(cache->GetImageIds()) {
+    : options_(options),
+      thread_pool_(options_.num_threads),
+      image_ids_(cache->GetImageIds()) {
   LOG(INFO) << "Generating spatial image pairs...";
   THROW_CHECK(options.Check());
 
@@ -493,9 +864,8 @@ SpatialPairGenerator::SpatialPairGenerator(
   timer.Start();
   LOG(INFO) << "Indexing images...";
 
-  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix =
-      ReadLocationData(*cache);
-  size_t num_locations = location_idxs_.size();
+  location_matrix_ = ReadLocationData(*cache);
+  const size_t num_locations = location_idxs_.size();
 
   LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
   if (num_locations == 0) {
@@ -506,38 +876,13 @@ SpatialPairGenerator::SpatialPairGenerator(
   timer.Restart();
   LOG(INFO) << "Building search index...";
 
+  // Exact k-d tree, which only visits the locations near the query, unlike a
+  // linear search over all locations.
   flann::Matrix<float> locations(
-      location_matrix.data(), num_locations, location_matrix.cols());
-
-  flann::LinearIndexParams index_params;
-  flann::LinearIndex<flann::L2<float>> search_index(index_params);
-  search_index.buildIndex(locations);
-
-  LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
-
-  timer.Restart();
-  LOG(INFO) << "Searching for nearest neighbors...";
-
-  const int knn = std::min<int>(options_.max_num_neighbors, num_locations);
-  image_pairs_.reserve(knn);
-
-  index_matrix_.resize(num_locations, knn);
-  flann::Matrix<size_t> indices(index_matrix_.data(), num_locations, knn);
-
-  distance_matrix_.resize(num_locations, knn);
-  flann::Matrix<float> distances(distance_matrix_.data(), num_locations, knn);
-
-  flann::SearchParams search_params(flann::FLANN_CHECKS_AUTOTUNED);
-  if (options_.num_threads == ThreadPool::kMaxNumThreads) {
-    search_params.cores = std::thread::hardware_concurrency();
-  } else {
-    search_params.cores = options_.num_threads;
-  }
-  if (search_params.cores <= 0) {
-    search_params.cores = 1;
-  }
-
-  search_index.knnSearch(locations, indices, distances, knn, search_params);
+      location_matrix_.data(), num_locations, location_matrix_.cols());
+  search_index_ =
+      std::make_unique<SearchIndex>(flann::KDTreeSingleIndexParams());
+  search_index_->buildIndex(locations);
 
   LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
 }
@@ -563,33 +908,138 @@ std::vector<std::pair<image_t, image_t>> SpatialPairGenerator::Next() {
     return image_pairs_;
   }
 
+  if (current_idx_ < batch_begin_idx_ ||
+      current_idx_ >= batch_begin_idx_ + batch_neighbor_idxs_.size()) {
+    SearchNeighbors(current_idx_);
+  }
+
   LOG(INFO) << StringPrintf(
       "Matching image [%d/%d]", current_idx_ + 1, location_idxs_.size());
-  const int knn =
-      std::min<int>(options_.max_num_neighbors, location_idxs_.size());
-  const float max_distance =
-      static_cast<float>(options_.max_distance * options_.max_distance);
-  for (int j = 0; j < knn; ++j) {
+  const image_t image_id = image_ids_.at(location_idxs_[current_idx_]);
+  for (const size_t nn_idx :
+       batch_neighbor_idxs_[current_idx_ - batch_begin_idx_]) {
     // Check if query equals result.
-    if (index_matrix_(current_idx_, j) == current_idx_) {
+    if (nn_idx == current_idx_) {
       continue;
     }
-
-    // Since the nearest neighbors are sorted by distance, we can break.
-    if (distance_matrix_(current_idx_, j) > max_distance) {
-      break;
-    }
-
-    const image_t image_id = image_ids_.at(location_idxs_[current_idx_]);
-    const size_t nn_idx = location_idxs_.at(index_matrix_(current_idx_, j));
-    const image_t nn_image_id = image_ids_.at(nn_idx);
+    const image_t nn_image_id = image_ids_.at(location_idxs_.at(nn_idx));
     image_pairs_.emplace_back(image_id, nn_image_id);
   }
   ++current_idx_;
   return image_pairs_;
 }
 
-Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>
+std::vector<image_t> SpatialPairGenerator::FindNeighbors(
+    const image_t image_id) const {
+  std::vector<image_t> nn_image_ids;
+  const auto location_row = image_location_rows_.find(image_id);
+  if (location_row == image_location_rows_.end()) {
+    return nn_image_ids;
+  }
+
+  flann::SearchParams search_params(flann::FLANN_CHECKS_UNLIMITED);
+  // The query image itself is among the neighbors.
+  search_params.max_neighbors = options_.max_num_neighbors + 1;
+  search_params.sorted = true;
+  search_params.cores = 1;
+
+  const float max_distance = std::nextafter(
+      static_cast<float>(options_.max_distance * options_.max_distance),
+      std::numeric_limits<float>::max());
+
+  flann::Matrix<float> query(
+      const_cast<float*>(location_matrix_.data()) + location_row->second * 3,
+      1,
+      3);
+  std::vector<std::vector<size_t>> indices;
+  std::vector<std::vector<float>> distances;
+  search_index_->radiusSearch(
+      query, indices, distances, max_distance, search_params);
+
+  nn_image_ids.reserve(indices[0].size());
+  for (const size_t nn_idx : indices[0]) {
+    if (nn_idx == location_row->second ||
+        nn_image_ids.size() >= static_cast<size_t>(options_.max_num_neighbors)) {
+      continue;
+    }
+    nn_image_ids.push_back(image_ids_.at(location_idxs_.at(nn_idx)));
+  }
+  return nn_image_ids;
+}
+
+bool SpatialPairGenerator::IsWithinMaxDistance(const image_t image_id1,
+                                               const image_t image_id2) const {
+  const auto location_row1 = image_location_rows_.find(image_id1);
+  const auto location_row2 = image_location_rows_.find(image_id2);
+  if (location_row1 == image_location_rows_.end() ||
+      location_row2 == image_location_rows_.end()) {
+    return true;
+  }
+  return (location_matrix_.row(location_row1->second) -
+          location_matrix_.row(location_row2->second))
+             .cast<double>()
+             .squaredNorm() <= options_.max_distance * options_.max_distance;
+}
+
+void SpatialPairGenerator::SearchNeighbors(const size_t begin_idx) {
+  // The neighbors are searched in batches to bound the memory for the search
+  // results, while amortizing the overhead of the parallel search.
+  constexpr size_t kBatchSize = 16384;
+
+  Timer timer;
+  timer.Start();
+  LOG(INFO) << "Searching for nearest neighbors...";
+
+  batch_begin_idx_ = begin_idx;
+  const size_t num_queries =
+      std::min(kBatchSize, location_idxs_.size() - begin_idx);
+  batch_neighbor_idxs_.resize(num_queries);
+
+  flann::SearchParams search_params(flann::FLANN_CHECKS_UNLIMITED);
+  search_params.max_neighbors = options_.max_num_neighbors;
+  search_params.sorted = true;
+  search_params.cores = 1;
+
+  // The index returns squared distances strictly within the radius, whereas
+  // neighbors at exactly the maximum distance are also matched.
+  const float max_distance = std::nextafter(
+      static_cast<float>(options_.max_distance * options_.max_distance),
+      std::numeric_limits<float>::max());
+
+  auto SearchChunk = [&](const size_t chunk_begin, const size_t chunk_end) {
+    flann::Matrix<float> queries(
+        location_matrix_.data() + (begin_idx + chunk_begin) * 3,
+        chunk_end - chunk_begin,
+        3);
+    std::vector<std::vector<size_t>> indices;
+    std::vector<std::vector<float>> distances;
+    search_index_->radiusSearch(
+        queries, indices, distances, max_distance, search_params);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      batch_neighbor_idxs_[chunk_begin + i] = std::move(indices[i]);
+    }
+  };
+
+  const size_t num_chunks =
+      std::min(num_queries, 4 * thread_pool_.NumThreads());
+  const size_t chunk_size = (num_queries + num_chunks - 1) / num_chunks;
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_chunks);
+  for (size_t chunk_begin = 0; chunk_begin < num_queries;
+       chunk_begin += chunk_size) {
+    futures.push_back(thread_pool_.AddTask(
+        SearchChunk,
+        chunk_begin,
+        std::min(chunk_begin + chunk_size, num_queries)));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
+}
+
+SpatialPairGenerator::LocationMatrix
 SpatialPairGenerator::ReadLocationData(const FeatureMatcherCache& cache) {
   GPSTransform gps_transform;
   std::vector<Eigen::Vector3d> ells(1);
@@ -597,8 +1047,8 @@ SpatialPairGenerator::ReadLocationData(const FeatureMatcherCache& cache) {
   size_t num_locations = 0;
   location_idxs_.clear();
   location_idxs_.reserve(image_ids_.size());
-  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
-      image_ids_.size(), 3);
+  image_location_rows_.clear();
+  LocationMatrix location_matrix(image_ids_.size(), 3);
 
   for (size_t i = 0; i < image_ids_.size(); ++i) {
     if (!cache.ExistsPosePrior(image_ids_[i])) {
@@ -639,6 +1089,7 @@ SpatialPairGenerator::ReadLocationData(const FeatureMatcherCache& cache) {
             static_cast<float>(options_.ignore_z ? 0 : translation_prior(2));
     }
 
+    image_location_rows_.emplace(image_ids_[i], num_locations);
     num_locations += 1;
   }
   return location_matrix;
@@ -651,26 +1102,43 @@ ImportedPairGenerator::ImportedPairGenerator(
   LOG(INFO) << "Importing image pairs...";
   THROW_CHECK(options.Check());
 
-  const std::vector<image_t> image_ids = cache->GetImageIds();
-  std::unordered_map<std::string, image_t> image_name_to_image_id;
-  image_name_to_image_id.reserve(image_ids.size());
-  for (const auto image_id : image_ids) {
-    const auto& image = cache->GetImage(image_id);
-    image_name_to_image_id.emplace(image.Name(), image_id);
+  if (options_.lazy_image_loading) {
+    // Only look up and load the images referenced by the match list.
+    image_pairs_ = ReadImagePairsText(
+        options_.match_list_path, [&cache](const std::string& image_name) {
+          return cache->FindImageWithName(image_name);
+        });
+  } else {
+    const std::vector<image_t> image_ids = cache->GetImageIds();
+    std::unordered_map<std::string, image_t> image_name_to_image_id;
+    image_name_to_image_id.reserve(image_ids.size());
+    for (const auto image_id : image_ids) {
+      const auto& image = cache->GetImage(image_id);
+      image_name_to_image_id.emplace(image.Name(), image_id);
+    }
+    image_pairs_ = ReadImagePairsText(
+        options_.match_list_path,
+        [&image_name_to_image_id](const std::string& image_name) {
+          const auto it = image_name_to_image_id.find(image_name);
+          return it == image_name_to_image_id.end() ? kInvalidImageId
+                                                    : it->second;
+        });
   }
-  image_pairs_ =
-      ReadImagePairsText(options_.match_list_path, image_name_to_image_id);
   block_image_pairs_.reserve(options_.block_size);
 }
 
 ImportedPairGenerator::ImportedPairGenerator(
     const ImagePairsMatchingOptions& options,
     const std::shared_ptr<Database>& database)
-    : ImportedPairGenerator(
-          options,
-          std::make_shared<FeatureMatcherCache>(CacheSize(options),
-                                                THROW_CHECK_NOTNULL(database),
-                                                /*do_setup=*/true)) {}
+    : ImportedPairGenerator(options, [&options, &database]() {
+        auto cache = std::make_shared<FeatureMatcherCache>(
+            CacheSize(options),
+            THROW_CHECK_NOTNULL(database),
+            /*do_setup=*/false);
+        cache->SetLazyImageLoading(options.lazy_image_loading);
+        cache->Setup();
+        return cache;
+      }()) {}
 
 void ImportedPairGenerator::Reset() { pair_idx_ = 0; }
 
@@ -30,11 +30,19 @@
 #pragma once
 
 #include "colmap/feature/matcher.h"
+#include "colmap/retrieval/ivf_index.h"
+#include "colmap/retrieval/sharded_visual_index.h"
 #include "colmap/retrieval/visual_index.h"
 #include "colmap/scene/database.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/types.h"
 
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <flann/flann.hpp>
+
 namespace colmap {
 
 struct ExhaustiveMatchingOptions {
@@ -44,6 +52,8 @@ struct ExhaustiveMatchingOptions {
   bool Check() const;
 };
 
+struct SpatialMatchingOptions;
+
 struct VocabTreeMatchingOptions {
   // Number of images to retrieve for each query image.
   int num_images = 100;
@@ -68,9 +78,78 @@ struct VocabTreeMatchingOptions {
   // Optional path to file with specific image names to match.
   std::string match_list_path = "";
 
+  // Optional path to a persistent visual index of the database images. If the
+  // index exists, it is read instead of the vocabulary tree, and only images
+  // that are not yet in the index are indexed and, if no query images are
+  // specified, queried against the whole index. The updated index is written
+  // back to the path in the packed format for memory-mapped reading.
+  std::string index_path = "";
+
+  // Optional comma-separated list of paths to visual index shards, e.g.,
+  // built by the vocab_tree_retriever for separate image identifier ranges.
+  // The shards are only read and queried together with the index of the
+  // remaining images, which are the only ones indexed and, if no query images
+  // are specified, queried.
+  std::string index_shard_paths = "";
+
   // Number of threads for indexing and retrieval.
   int num_threads = -1;
 
+  // Optional combination of the retrieved image pairs with the location
+  // priors of the images, as used by the spatial matching. If positive,
+  // retrieved image pairs whose priors are farther apart than this distance
+  // are rejected before matching. Pairs with an image without a prior are
+  // kept, such that loops between images without priors are still found.
+  double spatial_max_distance = -1;
+
+  // Whether to match the union of the retrieved image pairs and the spatial
+  // nearest neighbors within the maximum distance of every query image,
+  // instead of rejecting the retrieved pairs that are too far apart.
+  bool spatial_union = false;
+
+  // The maximum number of spatial nearest neighbors for the union.
+  int spatial_max_num_neighbors = 50;
+
+  // Whether to ignore the Z-component of the location priors.
+  bool spatial_ignore_z = true;
+
+  bool Check() const;
+
+  SpatialMatchingOptions SpatialOptions() const;
+};
+
+struct VLADMatchingOptions {
+  // Number of images to retrieve for each query image.
+  int num_images = 100;
+
+  // The number of clusters of the VLAD codebook, which is learned from the
+  // visual words of the vocabulary tree. The dimension of the global
+  // descriptors is the number of clusters times the descriptor dimension.
+  int num_clusters = 16;
+
+  // The number of lists of the inverted file index. If not positive, the
+  // square root of the number of images is used.
+  int num_lists = -1;
+
+  // The number of lists to search for each query image. Larger values
+  // increase the recall at the cost of slower retrieval.
+  int num_probes = 8;
+
+  // The maximum number of features to use for describing an image. If an
+  // image has more features, only the largest-scale features will be used.
+  int max_num_features = -1;
+
+  // Path to the vocabulary tree. The global descriptors that are stored in
+  // the database from previous runs are reused, if they have the expected
+  // dimension, and must be cleared after changing the vocabulary tree.
+  std::string vocab_tree_path = "";
+
+  // Optional path to file with specific image names to match.
+  std::string match_list_path = "";
+
+  // Number of threads for describing and indexing the images.
+  int num_threads = -1;
+
   bool Check() const;
 };
 
@@ -84,6 +163,14 @@ struct SequentialMatchingOptions {
   // 是否对二次近邻图像进行匹配
   bool quadratic_overlap = true;
 
+  // Whether to predict the two-view geometry of the pair (i, i + d) by the
+  // verified geometry of the preceding pair (i - d, i) for images of the same
+  // camera, which holds for the smooth motion of video-like sequences. The
+  // pairs are then first matched guided by the prediction, see
+  // `SiftMatchingOptions::prediction_max_error`, and only fully matched, if
+  // the guided matching yields too few matches.
+  bool motion_prediction = false;
+
   // Whether to enable vocabulary tree based loop detection.
   bool loop_detection = false;
 
@@ -108,6 +195,13 @@ struct SequentialMatchingOptions {
   // image has more features, only the largest-scale features will be indexed.
   int loop_detection_max_num_features = -1;
 
+  // Whether to detect loops with an incremental index that only contains the
+  // images preceding the current image in the sequence by more than the
+  // overlap, instead of indexing all images up front. Each image is added to
+  // the index as the sequence passes, such that loops are only detected
+  // against the previous images and no global indexing pass is needed.
+  bool loop_detection_incremental = false;
+
   // Path to the vocabulary tree.
   std::string vocab_tree_path = "";
 
@@ -150,6 +244,12 @@ struct ImagePairsMatchingOptions {
   // Path to the file with the matches.
   std::string match_list_path = "";
 
+  // Whether to only load the cameras, images, and pose priors of the images
+  // in the match list instead of all images in the database. This avoids the
+  // start-up cost of reading the whole database, when matching a small list
+  // of pairs against a database of many images.
+  bool lazy_image_loading = false;
+
   bool Check() const;
 };
 
@@ -205,6 +305,8 @@ class ExhaustivePairGenerator : public PairGenerator {
   std::vector<std::pair<image_t, image_t>> image_pairs_;
 };
 
+class SpatialPairGenerator;
+
 class VocabTreePairGenerator : public PairGenerator {
  public:
   using PairOptions = VocabTreeMatchingOptions;
@@ -220,6 +322,8 @@ class VocabTreePairGenerator : public PairGenerator {
                          const std::shared_ptr<Database>& database,
                          const std::vector<image_t>& query_image_ids = {});
 
+  ~VocabTreePairGenerator();
+
   void Reset() override;
 
   bool HasFinished() const override;
@@ -236,18 +340,69 @@ class VocabTreePairGenerator : public PairGenerator {
 
   void Query(image_t image_id);
 
+  // Write the visual index to the index path, if one is given.
+  void WriteIndex();
+
   const VocabTreeMatchingOptions options_;
   const std::shared_ptr<FeatureMatcherCache> cache_;
   ThreadPool thread_pool;
   JobQueue<Retrieval> queue;
-  retrieval::VisualIndex<> visual_index_;
+  std::shared_ptr<retrieval::VisualIndex<>> visual_index_;
+  // The given index shards and the visual index of the remaining images.
+  retrieval::ShardedVisualIndex<> sharded_index_;
   retrieval::VisualIndex<>::QueryOptions query_options_;
   std::vector<image_t> query_image_ids_;
+  // Images of the database, if the visual index was read from the index path
+  // or the index shards and might contain images that were deleted from the
+  // database.
+  std::unordered_set<image_t> database_image_ids_;
+  // Spatial constraint of the retrieved image pairs, if enabled.
+  std::unique_ptr<SpatialPairGenerator> spatial_pair_generator_;
   std::vector<std::pair<image_t, image_t>> image_pairs_;
   size_t query_idx_ = 0;
   size_t result_idx_ = 0;
 };
 
+// Generates image pairs by retrieving the most similar images in terms of
+// global VLAD descriptors, which summarize all features of an image in a
+// single vector. In contrast to the vocabulary tree, every query is a single
+// approximate nearest neighbor search in an inverted file index. The global
+// descriptors are stored in the database and reused in subsequent runs.
+class VLADPairGenerator : public PairGenerator {
+ public:
+  using PairOptions = VLADMatchingOptions;
+  static size_t CacheSize(const VLADMatchingOptions& options) {
+    return 5 * options.num_images;
+  }
+
+  VLADPairGenerator(const VLADMatchingOptions& options,
+                    std::shared_ptr<FeatureMatcherCache> cache);
+
+  VLADPairGenerator(const VLADMatchingOptions& options,
+                    const std::shared_ptr<Database>& database);
+
+  void Reset() override;
+
+  bool HasFinished() const override;
+
+  std::vector<std::pair<image_t, image_t>> Next() override;
+
+ private:
+  // Read the global descriptors of the images from the database, where
+  // missing descriptors or descriptors of a different dimension are computed
+  // and written to the database.
+  retrieval::IVFIndex::DescType DescribeImages(
+      const std::vector<image_t>& image_ids);
+
+  const VLADMatchingOptions options_;
+  const std::shared_ptr<FeatureMatcherCache> cache_;
+  retrieval::IVFIndex index_;
+  std::vector<image_t> query_image_ids_;
+  std::vector<retrieval::ImageScore> image_scores_;
+  std::vector<std::pair<image_t, image_t>> image_pairs_;
+  size_t query_idx_ = 0;
+};
+
 // api: 序列化图像对生成器类
 class SequentialPairGenerator : public PairGenerator {
  public:
@@ -270,14 +425,34 @@ class SequentialPairGenerator : public PairGenerator {
 
   std::vector<std::pair<image_t, image_t>> Next() override;
 
+  // Find the pair (i - d, i) preceding the pair (i, i + d) in the sequence,
+  // whose relative motion predicts the motion of the pair for smooth camera
+  // trajectories. Returns false for pairs without predecessor, e.g., at the
+  // start of the sequence or loop detection pairs.
+  bool PrecedingImagePair(
+      const std::pair<image_t, image_t>& image_pair,
+      std::pair<image_t, image_t>* preceding_image_pair) const;
+
  private:
   // api: 获取排好顺序的图像id
   std::vector<image_t> GetOrderedImageIds() const;
 
+  // Read the features of an image for loop detection.
+  void ReadLoopDetectionFeatures(image_t image_id,
+                                 FeatureKeypoints* keypoints,
+                                 FeatureDescriptors* descriptors) const;
+
+  // Add the image that left the overlap to the incremental index and, every
+  // loop detection period, query the index for loops of the current image.
+  void DetectLoopsIncrementally();
+
   const SequentialMatchingOptions options_;
   const std::shared_ptr<FeatureMatcherCache> cache_;
   std::vector<image_t> image_ids_;
+  std::unordered_map<image_t, size_t> image_idxs_;
   std::unique_ptr<VocabTreePairGenerator> vocab_tree_pair_generator_;
+  std::unique_ptr<retrieval::VisualIndex<>> loop_detection_index_;
+  retrieval::VisualIndex<>::QueryOptions loop_detection_query_options_;
   std::vector<std::pair<image_t, image_t>> image_pairs_;
   size_t image_idx_ = 0;
 };
@@ -301,18 +476,39 @@ class SpatialPairGenerator : public PairGenerator {
 
   std::vector<std::pair<image_t, image_t>> Next() override;
 
+  // Find the other images whose location priors are within the maximum
+  // distance of the prior of the given image, up to the maximum number of
+  // neighbors. Returns no images, if the image has no location prior.
+  std::vector<image_t> FindNeighbors(image_t image_id) const;
+
+  // Whether the location priors of the two images are within the maximum
+  // distance. Also true, if any of the images has no location prior.
+  bool IsWithinMaxDistance(image_t image_id1, image_t image_id2) const;
+
  private:
-  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> ReadLocationData(
-      const FeatureMatcherCache& cache);
+  typedef Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>
+      LocationMatrix;
+  typedef flann::KDTreeSingleIndex<flann::L2<float>> SearchIndex;
+
+  LocationMatrix ReadLocationData(const FeatureMatcherCache& cache);
+
+  // Search the neighbors within the maximum distance for the next batch of
+  // locations starting at the given index in parallel.
+  void SearchNeighbors(size_t begin_idx);
 
   const SpatialMatchingOptions options_;
+  ThreadPool thread_pool_;
   std::vector<std::pair<image_t, image_t>> image_pairs_;
-  Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      index_matrix_;
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distance_matrix_;
+  // The k-d tree over the locations is built once and reused for all batches
+  // of neighbor searches, also after resetting the generator.
+  LocationMatrix location_matrix_;
+  std::unique_ptr<SearchIndex> search_index_;
+  size_t batch_begin_idx_ = 0;
+  std::vector<std::vector<size_t>> batch_neighbor_idxs_;
   std::vector<image_t> image_ids_;
   std::vector<size_t> location_idxs_;
+  // The row of each image with a location prior in the location matrix.
+  std::unordered_map<image_t, size_t> image_location_rows_;
   size_t current_idx_ = 0;
 };
 
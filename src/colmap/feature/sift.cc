@@ -29,12 +29,16 @@
 
 #include "colmap/feature/sift.h"
 
+#include "colmap/feature/descriptor_kernels.h"
+#include "colmap/feature/sift_pca.h"
 #include "colmap/feature/utils.h"
 #include "colmap/math/math.h"
 #include "colmap/util/cuda.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/npy.h"
 #include "colmap/util/opengl_utils.h"
+#include "colmap/util/threading.h"
 
 #if defined(COLMAP_GPU_ENABLED)
 #include "thirdparty/SiftGPU/SiftGPU.h"
@@ -48,9 +52,12 @@
 #include "thirdparty/VLFeat/covdet.h"
 #include "thirdparty/VLFeat/sift.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <fstream>
 #include <memory>
+#include <unordered_map>
 
 #include <Eigen/Geometry>
 #include <flann/flann.hpp>
@@ -60,9 +67,14 @@ namespace colmap {
 bool SiftExtractionOptions::Check() const {
   if (use_gpu) {
     CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
+    CHECK_OPTION_GT(gpu_num_threads_per_device, 0);
   }
   CHECK_OPTION_GT(max_image_size, 0);
   CHECK_OPTION_GT(max_num_features, 0);
+  if (tile_size > 0) {
+    CHECK_OPTION_GE(tile_overlap, 0);
+    CHECK_OPTION_LT(tile_overlap, tile_size);
+  }
   CHECK_OPTION_GT(octave_resolution, 0);
   CHECK_OPTION_GT(peak_threshold, 0.0);
   CHECK_OPTION_GT(edge_threshold, 0.0);
@@ -72,6 +84,11 @@ bool SiftExtractionOptions::Check() const {
     CHECK_OPTION_GE(dsp_max_scale, dsp_min_scale);
     CHECK_OPTION_GT(dsp_num_scales, 0);
   }
+  if (!pca_path.empty()) {
+    CHECK_OPTION(descriptor_type == FeatureDescriptorType::SIFT);
+  }
+  CHECK_OPTION_GT(max_num_images_per_transaction, 0);
+  CHECK_OPTION_GE(max_transaction_duration, 0);
   return true;
 }
 
@@ -82,6 +99,14 @@ bool SiftMatchingOptions::Check() const {
   CHECK_OPTION_GT(max_ratio, 0.0);
   CHECK_OPTION_GT(max_distance, 0.0);
   CHECK_OPTION_GT(max_num_matches, 0);
+  CHECK_OPTION_GE(gpu_descriptor_cache_size, 0);
+  CHECK_OPTION_GE(vote_and_verify_min_num_inliers, 0);
+  CHECK_OPTION_GE(coarse_num_features, 0);
+  CHECK_OPTION_GE(coarse_min_num_inliers, 0);
+  CHECK_OPTION_GT(prediction_max_error, 0);
+  CHECK_OPTION_GT(batch_size, 0);
+  CHECK_OPTION_GT(max_num_pairs_per_transaction, 0);
+  CHECK_OPTION_GE(max_transaction_duration, 0);
   return true;
 }
 
@@ -91,24 +116,94 @@ void WarnDarknessAdaptivityNotAvailable() {
   LOG(WARNING) << "Darkness adaptivity only available for GLSL SiftGPU.";
 }
 
+// Normalizes the float descriptors and converts them to unsigned bytes in a
+// single pass. The quantized descriptors are written to consecutive rows.
+void NormalizeAndQuantizeDescriptors(
+    const SiftExtractionOptions::Normalization normalization,
+    const FeatureDescriptorsFloat& descriptors,
+    uint8_t* quantized) {
+  THROW_CHECK_EQ(descriptors.cols(), 128);
+  if (normalization != SiftExtractionOptions::Normalization::L2 &&
+      normalization != SiftExtractionOptions::Normalization::L1_ROOT) {
+    LOG(FATAL_THROW) << "Normalization type not supported";
+  }
+  NormalizeAndQuantizeSiftDescriptors(
+      descriptors.data(),
+      descriptors.rows(),
+      normalization == SiftExtractionOptions::Normalization::L1_ROOT,
+      quantized);
+}
+
 // VLFeat uses a different convention to store its descriptors. This transforms
-// the VLFeat format into the original SIFT format that is also used by SiftGPU.
-FeatureDescriptors TransformVLFeatToUBCFeatureDescriptors(
-    const FeatureDescriptors& vlfeat_descriptors) {
-  FeatureDescriptors ubc_descriptors(vlfeat_descriptors.rows(),
-                                     vlfeat_descriptors.cols());
+// num_descriptors consecutive descriptors in the VLFeat format into the
+// original SIFT format that is also used by SiftGPU.
+void TransformVLFeatToUBCFeatureDescriptors(
+    const uint8_t* vlfeat_descriptors,
+    const size_t num_descriptors,
+    FeatureDescriptors* ubc_descriptors) {
+  ubc_descriptors->resize(num_descriptors, 128);
   const std::array<int, 8> q{{0, 7, 6, 5, 4, 3, 2, 1}};
-  for (FeatureDescriptors::Index n = 0; n < vlfeat_descriptors.rows(); ++n) {
+  for (size_t n = 0; n < num_descriptors; ++n) {
+    const uint8_t* vlfeat_descriptor = vlfeat_descriptors + n * 128;
+    uint8_t* ubc_descriptor = ubc_descriptors->data() + n * 128;
     for (int i = 0; i < 4; ++i) {
       for (int j = 0; j < 4; ++j) {
         for (int k = 0; k < 8; ++k) {
-          ubc_descriptors(n, 8 * (j + 4 * i) + q[k]) =
-              vlfeat_descriptors(n, 8 * (j + 4 * i) + k);
+          ubc_descriptor[8 * (j + 4 * i) + q[k]] =
+              vlfeat_descriptor[8 * (j + 4 * i) + k];
         }
       }
     }
   }
-  return ubc_descriptors;
+}
+
+// Converts the grey-scale bitmap to a row-major float image in the range
+// [0, 1]. The image buffer is only reallocated if it is too small.
+void ConvertBitmapToFloatImage(const Bitmap& bitmap,
+                               std::vector<float>* image) {
+  const int width = bitmap.Width();
+  const int height = bitmap.Height();
+  image->resize(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* line = bitmap.GetScanline(y);
+    float* image_row = image->data() + static_cast<size_t>(y) * width;
+    for (int x = 0; x < width; ++x) {
+      image_row[x] = static_cast<float>(line[x]) / 255.0f;
+    }
+  }
+}
+
+// A tile of an image with the region [core_begin, core_end) used to assign
+// keypoints in the overlap bands uniquely to one tile.
+struct ImageTileRange {
+  int begin = 0;
+  int end = 0;
+  int core_begin = 0;
+  int core_end = 0;
+};
+
+// Splits the image dimension into overlapping tiles. The boundary between the
+// core regions of two tiles lies in the middle of their overlap band.
+std::vector<ImageTileRange> ComputeImageTileRanges(const int size,
+                                                   const int tile_size,
+                                                   const int tile_overlap) {
+  std::vector<ImageTileRange> ranges;
+  const int stride = tile_size - tile_overlap;
+  for (int begin = 0;; begin += stride) {
+    ImageTileRange range;
+    range.begin = begin;
+    range.end = std::min(begin + tile_size, size);
+    range.core_begin = ranges.empty() ? 0 : begin + tile_overlap / 2;
+    ranges.push_back(range);
+    if (range.end == size) {
+      break;
+    }
+  }
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    ranges[i].core_end =
+        (i + 1 < ranges.size()) ? ranges[i + 1].core_begin : size;
+  }
+  return ranges;
 }
 
 // api: SIFT CPU 特征提取类
@@ -117,7 +212,7 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
   using VlSiftType = std::unique_ptr<VlSiftFilt, void (*)(VlSiftFilt*)>;
 
   explicit SiftCPUFeatureExtractor(const SiftExtractionOptions& options)
-      : options_(options), sift_(nullptr, &vl_sift_delete) {
+      : options_(options) {
     std::cout << "new sift cpu (vlfeat),,, " << std::endl;
 
     THROW_CHECK(options_.Check());
@@ -139,82 +234,99 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
     THROW_CHECK(bitmap.IsGrey());
     THROW_CHECK_NOTNULL(keypoints);
 
+    if (options_.tile_size <= 0 ||
+        std::max(bitmap.Width(), bitmap.Height()) <= options_.tile_size) {
+      ConvertBitmapToFloatImage(bitmap, &workspace_.image);
+      return ExtractFromImage(workspace_.image.data(),
+                              bitmap.Width(),
+                              bitmap.Height(),
+                              &workspace_,
+                              keypoints,
+                              descriptors);
+    }
+
+    ConvertBitmapToFloatImage(bitmap, &image_buffer_);
+    return ExtractTiled(
+        bitmap.Width(), bitmap.Height(), keypoints, descriptors);
+  }
+
+ private:
+  // VLFeat filter and scratch buffers of one extraction thread. They retain
+  // their capacity across images, so that consecutive images of similar size
+  // do not allocate any new memory.
+  struct Workspace {
+    VlSiftType sift = VlSiftType(nullptr, &vl_sift_delete);
+    std::vector<float> image;
+    FeatureKeypoints keypoints;
+    std::vector<uint8_t> descriptors;
+    std::vector<size_t> level_num_features;
+    std::vector<size_t> level_offsets;
+    FeatureDescriptorsFloat descriptor_float = FeatureDescriptorsFloat(1, 128);
+  };
+
+  bool ExtractFromImage(const float* image,
+                        const int width,
+                        const int height,
+                        Workspace* workspace,
+                        FeatureKeypoints* keypoints,
+                        FeatureDescriptors* descriptors) const {
     // step: 1 创建 sift
-    if (sift_ == nullptr || sift_->width != bitmap.Width() ||
-        sift_->height != bitmap.Height()) {
-      sift_ = VlSiftType(vl_sift_new(bitmap.Width(),
-                                     bitmap.Height(),
-                                     options_.num_octaves,
-                                     options_.octave_resolution,
-                                     options_.first_octave),
-                         &vl_sift_delete);
-      if (!sift_) {
+    VlSiftType& sift = workspace->sift;
+    if (sift == nullptr || sift->width != width || sift->height != height) {
+      sift = VlSiftType(vl_sift_new(width,
+                                    height,
+                                    options_.num_octaves,
+                                    options_.octave_resolution,
+                                    options_.first_octave),
+                        &vl_sift_delete);
+      if (!sift) {
         return false;
       }
     }
 
     // step: 2 设置 peak/edge 阈值
-    vl_sift_set_peak_thresh(sift_.get(), options_.peak_threshold);
-    vl_sift_set_edge_thresh(sift_.get(), options_.edge_threshold);
+    vl_sift_set_peak_thresh(sift.get(), options_.peak_threshold);
+    vl_sift_set_edge_thresh(sift.get(), options_.edge_threshold);
 
-    // Iterate through octaves.
-    std::vector<size_t> level_num_features;
-    std::vector<FeatureKeypoints> level_keypoints;
-    std::vector<FeatureDescriptors> level_descriptors;
+    workspace->keypoints.clear();
+    workspace->descriptors.clear();
+    workspace->level_num_features.clear();
+    workspace->level_offsets.clear();
+
+    // Iterate through octaves. The features of all DOG levels are appended to
+    // the same buffers in the order of increasing scale.
     bool first_octave = true;
     while (true) {
       if (first_octave) {
-        const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
-        std::vector<float> data_float(data_uint8.size());
-        for (size_t i = 0; i < data_uint8.size(); ++i) {
-          data_float[i] = static_cast<float>(data_uint8[i]) / 255.0f;
-        }
-        if (vl_sift_process_first_octave(sift_.get(), data_float.data())) {
+        if (vl_sift_process_first_octave(sift.get(), image)) {
           break;
         }
         first_octave = false;
       } else {
-        if (vl_sift_process_next_octave(sift_.get())) {
+        if (vl_sift_process_next_octave(sift.get())) {
           break;
         }
       }
 
       // Detect keypoints.
-      vl_sift_detect(sift_.get());
+      vl_sift_detect(sift.get());
 
       // Extract detected keypoints.
-      const VlSiftKeypoint* vl_keypoints = vl_sift_get_keypoints(sift_.get());
-      const int num_keypoints = vl_sift_get_nkeypoints(sift_.get());
+      const VlSiftKeypoint* vl_keypoints = vl_sift_get_keypoints(sift.get());
+      const int num_keypoints = vl_sift_get_nkeypoints(sift.get());
       if (num_keypoints == 0) {
         continue;
       }
 
       // Extract features with different orientations per DOG level.
-      size_t level_idx = 0;
       int prev_level = -1;
-      FeatureDescriptorsFloat desc(1, 128);
       for (int i = 0; i < num_keypoints; ++i) {
         if (vl_keypoints[i].is != prev_level) {
-          if (i > 0) {
-            // Resize containers of previous DOG level.
-            level_keypoints.back().resize(level_idx);
-            if (descriptors != nullptr) {
-              level_descriptors.back().conservativeResize(level_idx, 128);
-            }
-          }
-
-          // Add containers for new DOG level.
-          level_idx = 0;
-          level_num_features.push_back(0);
-          level_keypoints.emplace_back(options_.max_num_orientations *
-                                       num_keypoints);
-          if (descriptors != nullptr) {
-            level_descriptors.emplace_back(
-                options_.max_num_orientations * num_keypoints, 128);
-          }
+          workspace->level_num_features.push_back(0);
+          workspace->level_offsets.push_back(workspace->keypoints.size());
         }
 
-        level_num_features.back() += 1;
+        workspace->level_num_features.back() += 1;
         prev_level = vl_keypoints[i].is;
 
         // Extract feature orientations.
@@ -225,7 +337,7 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
           angles[0] = 0.0;
         } else {
           num_orientations = vl_sift_calc_keypoint_orientations(
-              sift_.get(), angles, &vl_keypoints[i]);
+              sift.get(), angles, &vl_keypoints[i]);
         }
 
         // Note that this is different from SiftGPU, which selects the top
@@ -235,83 +347,164 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
             std::min(num_orientations, options_.max_num_orientations);
 
         for (int o = 0; o < num_used_orientations; ++o) {
-          level_keypoints.back()[level_idx] =
-              FeatureKeypoint(vl_keypoints[i].x + 0.5f,
-                              vl_keypoints[i].y + 0.5f,
-                              vl_keypoints[i].sigma,
-                              angles[o]);
+          workspace->keypoints.emplace_back(vl_keypoints[i].x + 0.5f,
+                                            vl_keypoints[i].y + 0.5f,
+                                            vl_keypoints[i].sigma,
+                                            angles[o]);
           if (descriptors != nullptr) {
-            vl_sift_calc_keypoint_descriptor(
-                sift_.get(), desc.data(), &vl_keypoints[i], angles[o]);
-            if (options_.normalization ==
-                SiftExtractionOptions::Normalization::L2) {
-              L2NormalizeFeatureDescriptors(&desc);
-            } else if (options_.normalization ==
-                       SiftExtractionOptions::Normalization::L1_ROOT) {
-              L1RootNormalizeFeatureDescriptors(&desc);
-            } else {
-              LOG(FATAL_THROW) << "Normalization type not supported";
-            }
-
-            level_descriptors.back().row(level_idx) =
-                FeatureDescriptorsToUnsignedByte(desc);
+            vl_sift_calc_keypoint_descriptor(sift.get(),
+                                             workspace->descriptor_float.data(),
+                                             &vl_keypoints[i],
+                                             angles[o]);
+            std::vector<uint8_t>& quantized = workspace->descriptors;
+            quantized.resize(quantized.size() + 128);
+            NormalizeAndQuantizeDescriptors(options_.normalization,
+                                            workspace->descriptor_float,
+                                            quantized.data() +
+                                                quantized.size() - 128);
           }
-
-          level_idx += 1;
         }
       }
-
-      // Resize containers for last DOG level in octave.
-      level_keypoints.back().resize(level_idx);
-      if (descriptors != nullptr) {
-        level_descriptors.back().conservativeResize(level_idx, 128);
-      }
     }
 
     // Determine how many DOG levels to keep to satisfy max_num_features option.
     int first_level_to_keep = 0;
     int num_features = 0;
-    int num_features_with_orientations = 0;
-    for (int i = level_keypoints.size() - 1; i >= 0; --i) {
-      num_features += level_num_features[i];
-      num_features_with_orientations += level_keypoints[i].size();
+    for (int i = workspace->level_num_features.size() - 1; i >= 0; --i) {
+      num_features += workspace->level_num_features[i];
       if (num_features > options_.max_num_features) {
         first_level_to_keep = i;
         break;
       }
     }
 
-    // Extract the features to be kept.
-    {
-      size_t k = 0;
-      keypoints->resize(num_features_with_orientations);
-      for (size_t i = first_level_to_keep; i < level_keypoints.size(); ++i) {
-        for (size_t j = 0; j < level_keypoints[i].size(); ++j) {
-          (*keypoints)[k] = level_keypoints[i][j];
-          k += 1;
+    // Extract the features to be kept, which are the trailing DOG levels.
+    const size_t first_feature_to_keep =
+        workspace->level_offsets.empty()
+            ? 0
+            : workspace->level_offsets[first_level_to_keep];
+    const size_t num_features_with_orientations =
+        workspace->keypoints.size() - first_feature_to_keep;
+    keypoints->assign(workspace->keypoints.begin() + first_feature_to_keep,
+                      workspace->keypoints.end());
+
+    // Compute the descriptors for the detected keypoints.
+    if (descriptors != nullptr) {
+      TransformVLFeatToUBCFeatureDescriptors(
+          workspace->descriptors.data() + first_feature_to_keep * 128,
+          num_features_with_orientations,
+          descriptors);
+    }
+
+    return true;
+  }
+
+  // Extracts the features of the overlapping tiles in parallel. Keypoints are
+  // only kept in the core region of their tile, so that features detected in
+  // the overlap bands of multiple tiles are not duplicated. The largest-scale
+  // features across all tiles are kept to satisfy max_num_features.
+  bool ExtractTiled(const int width,
+                    const int height,
+                    FeatureKeypoints* keypoints,
+                    FeatureDescriptors* descriptors) {
+    if (thread_pool_ == nullptr) {
+      thread_pool_ = std::make_unique<ThreadPool>(options_.tile_num_threads);
+      tile_workspaces_.resize(thread_pool_->NumThreads());
+    }
+
+    const std::vector<ImageTileRange> x_ranges = ComputeImageTileRanges(
+        width, options_.tile_size, options_.tile_overlap);
+    const std::vector<ImageTileRange> y_ranges = ComputeImageTileRanges(
+        height, options_.tile_size, options_.tile_overlap);
+    const size_t num_tiles = x_ranges.size() * y_ranges.size();
+
+    std::vector<FeatureKeypoints> tile_keypoints(num_tiles);
+    std::vector<FeatureDescriptors> tile_descriptors(num_tiles);
+    std::vector<std::future<bool>> futures;
+    futures.reserve(num_tiles);
+    for (size_t tile_idx = 0; tile_idx < num_tiles; ++tile_idx) {
+      futures.push_back(thread_pool_->AddTask([&, tile_idx]() {
+        const ImageTileRange& x_range = x_ranges[tile_idx % x_ranges.size()];
+        const ImageTileRange& y_range = y_ranges[tile_idx / x_ranges.size()];
+        const int tile_width = x_range.end - x_range.begin;
+        const int tile_height = y_range.end - y_range.begin;
+
+        Workspace& workspace = tile_workspaces_[thread_pool_->GetThreadIndex()];
+        workspace.image.resize(static_cast<size_t>(tile_width) * tile_height);
+        for (int y = 0; y < tile_height; ++y) {
+          const float* row = image_buffer_.data() +
+                             static_cast<size_t>(y_range.begin + y) * width +
+                             x_range.begin;
+          std::copy(row,
+                    row + tile_width,
+                    workspace.image.data() +
+                        static_cast<size_t>(y) * tile_width);
+        }
+
+        return ExtractFromImage(
+            workspace.image.data(),
+            tile_width,
+            tile_height,
+            &workspace,
+            &tile_keypoints[tile_idx],
+            descriptors == nullptr ? nullptr : &tile_descriptors[tile_idx]);
+      }));
+    }
+
+    bool success = true;
+    for (auto& future : futures) {
+      success &= future.get();
+    }
+    if (!success) {
+      return false;
+    }
+
+    // Merge the keypoints in the core regions in global image coordinates.
+    keypoints->clear();
+    std::vector<std::pair<size_t, FeatureDescriptors::Index>> feature_idxs;
+    for (size_t tile_idx = 0; tile_idx < num_tiles; ++tile_idx) {
+      const ImageTileRange& x_range = x_ranges[tile_idx % x_ranges.size()];
+      const ImageTileRange& y_range = y_ranges[tile_idx / x_ranges.size()];
+      for (size_t i = 0; i < tile_keypoints[tile_idx].size(); ++i) {
+        FeatureKeypoint keypoint = tile_keypoints[tile_idx][i];
+        keypoint.x += x_range.begin;
+        keypoint.y += y_range.begin;
+        if (keypoint.x >= x_range.core_begin && keypoint.x < x_range.core_end &&
+            keypoint.y >= y_range.core_begin && keypoint.y < y_range.core_end) {
+          keypoints->push_back(keypoint);
+          feature_idxs.emplace_back(tile_idx, i);
         }
       }
     }
 
-    // Compute the descriptors for the detected keypoints.
+    // Without descriptors, the top-scale selection operates on empty rows.
+    FeatureDescriptors merged_descriptors(feature_idxs.size(),
+                                          descriptors == nullptr ? 0 : 128);
     if (descriptors != nullptr) {
-      size_t k = 0;
-      descriptors->resize(num_features_with_orientations, 128);
-      for (size_t i = first_level_to_keep; i < level_keypoints.size(); ++i) {
-        for (size_t j = 0; j < level_keypoints[i].size(); ++j) {
-          descriptors->row(k) = level_descriptors[i].row(j);
-          k += 1;
-        }
+      for (size_t i = 0; i < feature_idxs.size(); ++i) {
+        merged_descriptors.row(i) = tile_descriptors[feature_idxs[i].first].row(
+            feature_idxs[i].second);
       }
-      *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
+    }
+
+    ExtractTopScaleFeatures(
+        keypoints, &merged_descriptors, options_.max_num_features);
+
+    if (descriptors != nullptr) {
+      *descriptors = std::move(merged_descriptors);
     }
 
     return true;
   }
 
- private:
   const SiftExtractionOptions options_;
-  VlSiftType sift_;
+
+  Workspace workspace_;
+
+  // Full image and per-thread workspaces for tiled extraction.
+  std::vector<float> image_buffer_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::vector<Workspace> tile_workspaces_;
 };
 
 // api: Covariant SIFT CPU 特征提取类
@@ -319,7 +512,9 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
  public:
   explicit CovariantSiftCPUFeatureExtractor(
       const SiftExtractionOptions& options)
-      : options_(options) {
+      : options_(options),
+        covdet_(nullptr, &vl_covdet_delete),
+        sift_(nullptr, &vl_sift_delete) {
     THROW_CHECK(options_.Check());
     if (options_.darkness_adaptivity) {
       WarnDarknessAdaptivityNotAvailable();
@@ -337,43 +532,41 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
     THROW_CHECK(bitmap.IsGrey());
     THROW_CHECK_NOTNULL(keypoints);
 
-    // Setup covariant SIFT detector.
-    std::unique_ptr<VlCovDet, void (*)(VlCovDet*)> covdet(
-        vl_covdet_new(VL_COVDET_METHOD_DOG), &vl_covdet_delete);
-    if (!covdet) {
-      return false;
+    // Setup covariant SIFT detector. The detector is reused across images and
+    // only reallocates its scale spaces if the image geometry changes.
+    if (!covdet_) {
+      covdet_ = VlCovDetType(vl_covdet_new(VL_COVDET_METHOD_DOG),
+                             &vl_covdet_delete);
+      if (!covdet_) {
+        return false;
+      }
     }
+    VlCovDet* covdet = covdet_.get();
 
     const int kMaxOctaveResolution = 1000;
     THROW_CHECK_LE(options_.octave_resolution, kMaxOctaveResolution);
 
-    vl_covdet_set_first_octave(covdet.get(), options_.first_octave);
-    vl_covdet_set_octave_resolution(covdet.get(), options_.octave_resolution);
-    vl_covdet_set_peak_threshold(covdet.get(), options_.peak_threshold);
-    vl_covdet_set_edge_threshold(covdet.get(), options_.edge_threshold);
+    vl_covdet_set_first_octave(covdet, options_.first_octave);
+    vl_covdet_set_octave_resolution(covdet, options_.octave_resolution);
+    vl_covdet_set_peak_threshold(covdet, options_.peak_threshold);
+    vl_covdet_set_edge_threshold(covdet, options_.edge_threshold);
 
-    {
-      const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
-      std::vector<float> data_float(data_uint8.size());
-      for (size_t i = 0; i < data_uint8.size(); ++i) {
-        data_float[i] = static_cast<float>(data_uint8[i]) / 255.0f;
-      }
-      vl_covdet_put_image(
-          covdet.get(), data_float.data(), bitmap.Width(), bitmap.Height());
-    }
+    ConvertBitmapToFloatImage(bitmap, &image_buffer_);
+    vl_covdet_put_image(
+        covdet, image_buffer_.data(), bitmap.Width(), bitmap.Height());
 
-    vl_covdet_detect(covdet.get(), options_.max_num_features);
+    vl_covdet_detect(covdet, options_.max_num_features);
 
     if (!options_.upright) {
       if (options_.estimate_affine_shape) {
-        vl_covdet_extract_affine_shape(covdet.get());
+        vl_covdet_extract_affine_shape(covdet);
       } else {
-        vl_covdet_extract_orientations(covdet.get());
+        vl_covdet_extract_orientations(covdet);
       }
     }
 
-    const int num_features = vl_covdet_get_num_features(covdet.get());
-    VlCovDetFeature* features = vl_covdet_get_features(covdet.get());
+    const int num_features = vl_covdet_get_num_features(covdet);
+    VlCovDetFeature* features = vl_covdet_get_features(covdet);
 
     // Sort features according to detected octave and scale.
     std::sort(
@@ -417,7 +610,7 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
 
     // Compute the descriptors for the detected keypoints.
     if (descriptors != nullptr) {
-      descriptors->resize(keypoints->size(), 128);
+      descriptors_buffer_.resize(keypoints->size() * 128);
 
       const size_t kPatchResolution = 15;
       const size_t kPatchSide = 2 * kPatchResolution + 1;
@@ -427,8 +620,8 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
       const double kSigma =
           kPatchRelativeExtent / (3.0 * (4 + 1) / 2) / kPatchStep;
 
-      std::vector<float> patch(kPatchSide * kPatchSide);
-      std::vector<float> patchXY(2 * kPatchSide * kPatchSide);
+      patch_.resize(kPatchSide * kPatchSide);
+      patch_xy_.resize(2 * kPatchSide * kPatchSide);
 
       float dsp_min_scale = 1;
       float dsp_scale_step = 0;
@@ -440,17 +633,17 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
         dsp_num_scales = options_.dsp_num_scales;
       }
 
-      FeatureDescriptorsFloat descriptor(1, 128);
-      FeatureDescriptorsFloat scaled_descriptors(dsp_num_scales, 128);
+      descriptor_.resize(1, 128);
+      scaled_descriptors_.resize(dsp_num_scales, 128);
 
-      std::unique_ptr<VlSiftFilt, void (*)(VlSiftFilt*)> sift(
-          vl_sift_new(16, 16, 1, 3, 0), &vl_sift_delete);
-      if (!sift) {
-        return false;
+      if (!sift_) {
+        sift_ = VlSiftType(vl_sift_new(16, 16, 1, 3, 0), &vl_sift_delete);
+        if (!sift_) {
+          return false;
+        }
+        vl_sift_set_magnif(sift_.get(), 3.0);
       }
 
-      vl_sift_set_magnif(sift.get(), 3.0);
-
       for (size_t i = 0; i < keypoints->size(); ++i) {
         for (int s = 0; s < dsp_num_scales; ++s) {
           const double dsp_scale = dsp_min_scale + s * dsp_scale_step;
@@ -461,25 +654,25 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
           scaled_frame.a21 *= dsp_scale;
           scaled_frame.a22 *= dsp_scale;
 
-          vl_covdet_extract_patch_for_frame(covdet.get(),
-                                            patch.data(),
+          vl_covdet_extract_patch_for_frame(covdet,
+                                            patch_.data(),
                                             kPatchResolution,
                                             kPatchRelativeExtent,
                                             kPatchRelativeSmoothing,
                                             scaled_frame);
 
-          vl_imgradient_polar_f(patchXY.data(),
-                                patchXY.data() + 1,
+          vl_imgradient_polar_f(patch_xy_.data(),
+                                patch_xy_.data() + 1,
                                 2,
                                 2 * kPatchSide,
-                                patch.data(),
+                                patch_.data(),
                                 kPatchSide,
                                 kPatchSide,
                                 kPatchSide);
 
-          vl_sift_calc_raw_descriptor(sift.get(),
-                                      patchXY.data(),
-                                      scaled_descriptors.row(s).data(),
+          vl_sift_calc_raw_descriptor(sift_.get(),
+                                      patch_xy_.data(),
+                                      scaled_descriptors_.row(s).data(),
                                       kPatchSide,
                                       kPatchSide,
                                       kPatchResolution,
@@ -489,34 +682,40 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
         }
 
         if (options_.domain_size_pooling) {
-          descriptor = scaled_descriptors.colwise().mean();
+          descriptor_ = scaled_descriptors_.colwise().mean();
         } else {
-          descriptor = scaled_descriptors;
+          descriptor_ = scaled_descriptors_;
         }
 
-        THROW_CHECK_EQ(descriptor.cols(), 128);
+        THROW_CHECK_EQ(descriptor_.cols(), 128);
 
-        if (options_.normalization ==
-            SiftExtractionOptions::Normalization::L2) {
-          L2NormalizeFeatureDescriptors(&descriptor);
-        } else if (options_.normalization ==
-                   SiftExtractionOptions::Normalization::L1_ROOT) {
-          L1RootNormalizeFeatureDescriptors(&descriptor);
-        } else {
-          LOG(FATAL_THROW) << "Normalization type not supported";
-        }
-
-        descriptors->row(i) = FeatureDescriptorsToUnsignedByte(descriptor);
+        NormalizeAndQuantizeDescriptors(options_.normalization,
+                                        descriptor_,
+                                        descriptors_buffer_.data() + i * 128);
       }
 
-      *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
+      TransformVLFeatToUBCFeatureDescriptors(
+          descriptors_buffer_.data(), keypoints->size(), descriptors);
     }
 
     return true;
   }
 
  private:
+  using VlCovDetType = std::unique_ptr<VlCovDet, void (*)(VlCovDet*)>;
+  using VlSiftType = std::unique_ptr<VlSiftFilt, void (*)(VlSiftFilt*)>;
+
   const SiftExtractionOptions options_;
+
+  // Detector, descriptor filter and scratch buffers reused across images.
+  VlCovDetType covdet_;
+  VlSiftType sift_;
+  std::vector<float> image_buffer_;
+  std::vector<float> patch_;
+  std::vector<float> patch_xy_;
+  std::vector<uint8_t> descriptors_buffer_;
+  FeatureDescriptorsFloat descriptor_;
+  FeatureDescriptorsFloat scaled_descriptors_;
 };
 
 // api: （重点）SIFT GPU 特征提取类
@@ -650,8 +849,6 @@ class SiftGPUFeatureExtractor : public FeatureExtractor {
   bool Extract(const Bitmap& bitmap,
                FeatureKeypoints* keypoints,
                FeatureDescriptors* descriptors) override {
-    std::cout << "extract feat. using sift_gpu,,," << std::endl;
-    
     THROW_CHECK(bitmap.IsGrey());
     THROW_CHECK_NOTNULL(keypoints);
     THROW_CHECK_NOTNULL(descriptors);
@@ -663,34 +860,42 @@ class SiftGPUFeatureExtractor : public FeatureExtractor {
     THROW_CHECK_EQ(options_.max_image_size * compensation_factor,
                    sift_gpu_.GetMaxDimension());
 
-    std::lock_guard<std::mutex> lock(*sift_gpu_mutexes_[sift_gpu_.gpu_index]);
-
-    // step: 2 调用SIFT
     // Note, that this produces slightly different results than using SiftGPU
     // directly for RGB->GRAY conversion, since it uses different weights.
     const std::vector<uint8_t> bitmap_raw_bits = bitmap.ConvertToRawBits();
-    const int code = sift_gpu_.RunSIFT(bitmap.Pitch(),
-                                       bitmap.Height(),
-                                       bitmap_raw_bits.data(),
-                                       GL_LUMINANCE,
-                                       GL_UNSIGNED_BYTE);
-
-    const int kSuccessCode = 1;
-    if (code != kSuccessCode) {
-      return false;
-    }
 
-    // step: 3 获取结果数据
-    const size_t num_features = static_cast<size_t>(sift_gpu_.GetFeatureNum());
-    // std::cout << "feat. num: " << num_features << std::endl;
-    keypoints_buffer_.resize(num_features);
+    // Only the SiftGPU calls hold the lock of the GPU, such that other
+    // threads on the same GPU can convert and post-process their images.
+    FeatureDescriptorsFloat descriptors_float;
+    {
+      std::lock_guard<std::mutex> lock(
+          *sift_gpu_mutexes_[sift_gpu_.gpu_index]);
+
+      // step: 2 调用SIFT
+      ReservePyramid(bitmap.Pitch(), bitmap.Height());
+      const int code = sift_gpu_.RunSIFT(bitmap.Pitch(),
+                                         bitmap.Height(),
+                                         bitmap_raw_bits.data(),
+                                         GL_LUMINANCE,
+                                         GL_UNSIGNED_BYTE);
+
+      const int kSuccessCode = 1;
+      if (code != kSuccessCode) {
+        return false;
+      }
 
-    FeatureDescriptorsFloat descriptors_float(num_features, 128);
+      // step: 3 获取结果数据
+      const size_t num_features =
+          static_cast<size_t>(sift_gpu_.GetFeatureNum());
+      keypoints_buffer_.resize(num_features);
+      descriptors_float.resize(num_features, 128);
 
-    // Download the extracted keypoints and descriptors.
-    sift_gpu_.GetFeatureVector(keypoints_buffer_.data(),
-                               descriptors_float.data());
+      // Download the extracted keypoints and descriptors.
+      sift_gpu_.GetFeatureVector(keypoints_buffer_.data(),
+                                 descriptors_float.data());
+    }
 
+    const size_t num_features = keypoints_buffer_.size();
     keypoints->resize(num_features);
     for (size_t i = 0; i < num_features; ++i) {
       (*keypoints)[i] = FeatureKeypoint(keypoints_buffer_[i].x,
@@ -700,24 +905,44 @@ class SiftGPUFeatureExtractor : public FeatureExtractor {
     }
 
     // Save and normalize the descriptors.
-    if (options_.normalization == SiftExtractionOptions::Normalization::L2) {
-      L2NormalizeFeatureDescriptors(&descriptors_float);
-    } else if (options_.normalization ==
-               SiftExtractionOptions::Normalization::L1_ROOT) {
-      L1RootNormalizeFeatureDescriptors(&descriptors_float);
-    } else {
-      LOG(FATAL_THROW) << "Normalization type not supported";
-    }
-
-    *descriptors = FeatureDescriptorsToUnsignedByte(descriptors_float);
+    descriptors->resize(num_features, 128);
+    NormalizeAndQuantizeDescriptors(
+        options_.normalization, descriptors_float, descriptors->data());
 
     return true;
   }
 
  private:
+  // Grows the pyramid of the SiftGPU context such that it fits the given image
+  // size rounded up to the pyramid bucket size. SiftGPU reallocates the
+  // pyramid whenever an image exceeds it, so that without bucketing a stream
+  // of slightly larger images reallocates it for each image. Images larger
+  // than max_image_size are down-sampled by SiftGPU and not reserved for.
+  void ReservePyramid(const int width, const int height) {
+    const int bucket_size = options_.gpu_pyramid_bucket_size;
+    if (bucket_size <= 0 || std::max(width, height) > options_.max_image_size) {
+      return;
+    }
+    const auto round_up = [&](int size) {
+      return std::min(options_.max_image_size,
+                      (size + bucket_size - 1) / bucket_size * bucket_size);
+    };
+    const int reserved_width = std::max(reserved_width_, round_up(width));
+    const int reserved_height = std::max(reserved_height_, round_up(height));
+    if (reserved_width == reserved_width_ &&
+        reserved_height == reserved_height_) {
+      return;
+    }
+    sift_gpu_.AllocatePyramid(reserved_width, reserved_height);
+    reserved_width_ = reserved_width;
+    reserved_height_ = reserved_height;
+  }
+
   const SiftExtractionOptions options_;
   SiftGPU sift_gpu_;
   std::vector<SiftKeypoint> keypoints_buffer_;
+  int reserved_width_ = 0;
+  int reserved_height_ = 0;
 };
 #endif  // COLMAP_GPU_ENABLED
 
@@ -747,38 +972,50 @@ std::unique_ptr<FeatureExtractor> CreateSiftFeatureExtractor(
 
 namespace {
 
-size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
-                                       const float max_ratio,
-                                       const float max_distance,
-                                       std::vector<int>* matches) {
-  // SIFT descriptor vectors are normalized to length 512.
-  const float kDistNorm = 1.0f / (512.0f * 512.0f);
+// Full SIFT descriptors have 128 dimensions, while PCA-reduced descriptors have
+// fewer dimensions, see SiftPCA.
+bool IsSiftPCADescriptors(const FeatureDescriptors& descriptors) {
+  return descriptors.cols() != 128;
+}
+
+void CheckSiftDescriptorsDims(const FeatureDescriptors& descriptors) {
+  if (IsSiftPCADescriptors(descriptors)) {
+    THROW_CHECK_GT(descriptors.cols(), 0);
+    THROW_CHECK_LT(descriptors.cols(), 128);
+    THROW_CHECK_EQ(descriptors.cols() % 16, 0);
+  }
+}
 
+// Factor that converts the dot products of two descriptors to the cosine of
+// their angle.
+float GetSiftDotProductNorm(const FeatureDescriptors& descriptors) {
+  // SIFT descriptor vectors are normalized to length 512, which PCA-reduced
+  // descriptors approximate in units of the quantization step.
+  const float length = IsSiftPCADescriptors(descriptors)
+                           ? 512.0f / SiftPCA::kQuantizationStep
+                           : 512.0f;
+  return 1.0f / (length * length);
+}
+
+size_t FindBestMatchesOneWayBruteForce(
+    const std::vector<SiftBestDotProducts>& best_dots,
+    const float max_ratio,
+    const float max_distance,
+    const float dist_norm,
+    std::vector<int>* matches) {
   size_t num_matches = 0;
-  matches->resize(dists.rows(), -1);
+  matches->resize(best_dots.size(), -1);
 
-  for (Eigen::Index i1 = 0; i1 < dists.rows(); ++i1) {
-    int best_i2 = -1;
-    int best_dist = 0;
-    int second_best_dist = 0;
-    for (Eigen::Index i2 = 0; i2 < dists.cols(); ++i2) {
-      const int dist = dists(i1, i2);
-      if (dist > best_dist) {
-        best_i2 = i2;
-        second_best_dist = best_dist;
-        best_dist = dist;
-      } else if (dist > second_best_dist) {
-        second_best_dist = dist;
-      }
-    }
+  for (size_t i1 = 0; i1 < best_dots.size(); ++i1) {
+    const SiftBestDotProducts& best = best_dots[i1];
 
     // Check if any match found.
-    if (best_i2 == -1) {
+    if (best.best_idx == -1) {
       continue;
     }
 
     const float best_dist_normed =
-        std::acos(std::min(kDistNorm * best_dist, 1.0f));
+        std::acos(std::min(dist_norm * best.best_dot, 1.0f));
 
     // Check if match distance passes threshold.
     if (best_dist_normed > max_distance) {
@@ -786,7 +1023,7 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     const float second_best_dist_normed =
-        std::acos(std::min(kDistNorm * second_best_dist, 1.0f));
+        std::acos(std::min(dist_norm * best.second_best_dot, 1.0f));
 
     // Check if match passes ratio test. Keep this comparison >= in order to
     // ensure that the case of best == second_best is detected.
@@ -795,27 +1032,30 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     num_matches += 1;
-    (*matches)[i1] = best_i2;
+    (*matches)[i1] = best.best_idx;
   }
 
   return num_matches;
 }
 
-void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
-                               const float max_ratio,
-                               const float max_distance,
-                               const bool cross_check,
-                               FeatureMatches* matches) {
+void FindBestMatchesFromBestDotProducts(
+    const std::vector<SiftBestDotProducts>& best12,
+    const std::vector<SiftBestDotProducts>& best21,
+    const float max_ratio,
+    const float max_distance,
+    const float dist_norm,
+    const bool cross_check,
+    FeatureMatches* matches) {
   matches->clear();
 
   std::vector<int> matches12;
   const size_t num_matches12 = FindBestMatchesOneWayBruteForce(
-      dists, max_ratio, max_distance, &matches12);
+      best12, max_ratio, max_distance, dist_norm, &matches12);
 
   if (cross_check) {
     std::vector<int> matches21;
     const size_t num_matches21 = FindBestMatchesOneWayBruteForce(
-        dists.transpose(), max_ratio, max_distance, &matches21);
+        best21, max_ratio, max_distance, dist_norm, &matches21);
     matches->reserve(std::min(num_matches12, num_matches21));
     for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
       if (matches12[i1] != -1 && matches21[matches12[i1]] != -1 &&
@@ -839,41 +1079,195 @@ void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
   }
 }
 
-Eigen::MatrixXi ComputeSiftDistanceMatrix(
-    const FeatureKeypoints* keypoints1,
-    const FeatureKeypoints* keypoints2,
-    const FeatureDescriptors& descriptors1,
-    const FeatureDescriptors& descriptors2,
-    const std::function<bool(float, float, float, float)>& guided_filter) {
-  if (guided_filter != nullptr) {
-    THROW_CHECK_NOTNULL(keypoints1);
-    THROW_CHECK_NOTNULL(keypoints2);
-    THROW_CHECK_EQ(keypoints1->size(), descriptors1.rows());
-    THROW_CHECK_EQ(keypoints2->size(), descriptors2.rows());
+// The top-2 selection is fused with the distance computation in the SIMD
+// kernel, so that the full distance matrix is never materialized.
+void FindBestMatchesBruteForce(const FeatureDescriptors& descriptors1,
+                               const FeatureDescriptors& descriptors2,
+                               const float max_ratio,
+                               const float max_distance,
+                               const bool cross_check,
+                               FeatureMatches* matches) {
+  std::vector<SiftBestDotProducts> best12;
+  std::vector<SiftBestDotProducts> best21;
+  if (IsSiftPCADescriptors(descriptors1)) {
+    FindSiftPCABestDotProducts(
+        descriptors1, descriptors2, &best12, cross_check ? &best21 : nullptr);
+  } else {
+    FindSiftBestDotProducts(
+        descriptors1, descriptors2, &best12, cross_check ? &best21 : nullptr);
   }
+  FindBestMatchesFromBestDotProducts(best12,
+                                     best21,
+                                     max_ratio,
+                                     max_distance,
+                                     GetSiftDotProductNorm(descriptors1),
+                                     cross_check,
+                                     matches);
+}
 
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors1_int =
-      descriptors1.cast<int>();
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors2_int =
-      descriptors2.cast<int>();
+// Keypoints of the second image bucketed into a regular grid of square cells,
+// such that guided matching only computes the descriptor distances to the
+// keypoints in the cells overlapping the geometric search region of a keypoint
+// in the first image. The keypoints and descriptors are reordered by cell in
+// column-major order, so the keypoints in a range of rows of one column are
+// stored consecutively and processed by a single call to the SIMD kernel.
+struct SiftGuidedMatchingGrid {
+  // Average number of keypoints per cell.
+  static constexpr int kNumKeypointsPerCell = 8;
+
+  explicit SiftGuidedMatchingGrid(const FeatureKeypoints& keypoints,
+                                  const FeatureDescriptors& descriptors) {
+    THROW_CHECK_EQ(keypoints.size(), descriptors.rows());
+    THROW_CHECK_GT(keypoints.size(), 0);
+
+    float max_x = keypoints[0].x;
+    float max_y = keypoints[0].y;
+    min_x = keypoints[0].x;
+    min_y = keypoints[0].y;
+    for (const FeatureKeypoint& keypoint : keypoints) {
+      min_x = std::min(min_x, keypoint.x);
+      min_y = std::min(min_y, keypoint.y);
+      max_x = std::max(max_x, keypoint.x);
+      max_y = std::max(max_y, keypoint.y);
+    }
 
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> dists(
-      descriptors1.rows(), descriptors2.rows());
+    const double width = std::max(1.0, static_cast<double>(max_x) - min_x);
+    const double height = std::max(1.0, static_cast<double>(max_y) - min_y);
+    const double num_cells = std::max<double>(
+        1.0, static_cast<double>(keypoints.size()) / kNumKeypointsPerCell);
+    cell_size = std::sqrt(width * height / num_cells);
+    num_cols = std::max(1, static_cast<int>(std::ceil(width / cell_size)));
+    num_rows = std::max(1, static_cast<int>(std::ceil(height / cell_size)));
+
+    // Counting sort of the keypoints by their cell.
+    std::vector<int> cell_idxs(keypoints.size());
+    cell_offsets.resize(num_cols * num_rows + 1, 0);
+    for (size_t i = 0; i < keypoints.size(); ++i) {
+      cell_idxs[i] = ColIdx(keypoints[i].x) * num_rows + RowIdx(keypoints[i].y);
+      cell_offsets[cell_idxs[i] + 1] += 1;
+    }
+    for (size_t i = 1; i < cell_offsets.size(); ++i) {
+      cell_offsets[i] += cell_offsets[i - 1];
+    }
 
-  for (FeatureDescriptors::Index i1 = 0; i1 < descriptors1.rows(); ++i1) {
-    for (FeatureDescriptors::Index i2 = 0; i2 < descriptors2.rows(); ++i2) {
-      if (guided_filter != nullptr && guided_filter((*keypoints1)[i1].x,
-                                                    (*keypoints1)[i1].y,
-                                                    (*keypoints2)[i2].x,
-                                                    (*keypoints2)[i2].y)) {
-        dists(i1, i2) = 0;
-      } else {
-        dists(i1, i2) = descriptors1_int.row(i1).dot(descriptors2_int.row(i2));
-      }
+    std::vector<int> cell_sizes(num_cols * num_rows, 0);
+    point_idxs.resize(keypoints.size());
+    xs.resize(keypoints.size());
+    ys.resize(keypoints.size());
+    this->descriptors.resize(descriptors.rows(), descriptors.cols());
+    for (size_t i = 0; i < keypoints.size(); ++i) {
+      const int k = cell_offsets[cell_idxs[i]] + cell_sizes[cell_idxs[i]]++;
+      point_idxs[k] = i;
+      xs[k] = keypoints[i].x;
+      ys[k] = keypoints[i].y;
+      this->descriptors.row(k) = descriptors.row(i);
     }
   }
 
-  return dists;
+  int ColIdx(const double x) const {
+    return std::clamp(
+        static_cast<int>(std::floor((x - min_x) / cell_size)), 0, num_cols - 1);
+  }
+
+  int RowIdx(const double y) const {
+    return std::clamp(
+        static_cast<int>(std::floor((y - min_y) / cell_size)), 0, num_rows - 1);
+  }
+
+  float min_x = 0;
+  float min_y = 0;
+  double cell_size = 1;
+  int num_cols = 0;
+  int num_rows = 0;
+  // The keypoints of the cell in column c and row r are stored in the range
+  // [cell_offsets[c * num_rows + r], cell_offsets[c * num_rows + r + 1]).
+  std::vector<int> cell_offsets;
+  std::vector<int> point_idxs;
+  std::vector<float> xs;
+  std::vector<float> ys;
+  FeatureDescriptors descriptors;
+};
+
+// Same as the top-2 selection of a sequential scan in the order of the
+// indices, in which the first of multiple equal best dot products wins, but
+// independent of the order in which the dot products are visited.
+inline void UpdateGuidedBestDotProducts(const int idx,
+                                        const int dot,
+                                        SiftBestDotProducts* best) {
+  if (dot > best->best_dot) {
+    best->best_idx = idx;
+    best->second_best_dot = best->best_dot;
+    best->best_dot = dot;
+  } else if (dot == best->best_dot && best->best_idx != -1) {
+    best->best_idx = std::min(best->best_idx, idx);
+    best->second_best_dot = dot;
+  } else if (dot > best->second_best_dot) {
+    best->second_best_dot = dot;
+  }
+}
+
+// Finds the best and second best dot products between the descriptors, only
+// considering keypoint pairs that pass the guided filter. The search region
+// visits the grid cells that may contain keypoints passing the filter by
+// calling visit_column(col, row_begin, row_end) with an inclusive range of
+// rows, at most once per column. The result is identical to the brute-force
+// search over all pairs, which pass the filter.
+template <typename SearchRegion, typename GuidedFilter>
+void FindGuidedBestDotProducts(const FeatureKeypoints& keypoints1,
+                               const FeatureDescriptors& descriptors1,
+                               const SiftGuidedMatchingGrid& grid2,
+                               const SearchRegion& search_region,
+                               const GuidedFilter& guided_filter,
+                               std::vector<SiftBestDotProducts>* best12,
+                               std::vector<SiftBestDotProducts>* best21) {
+  best12->assign(descriptors1.rows(), SiftBestDotProducts());
+  if (best21 != nullptr) {
+    best21->assign(grid2.descriptors.rows(), SiftBestDotProducts());
+  }
+
+  const SiftKernelISA isa = GetBestSiftKernelISA();
+  const int num_dims = descriptors1.cols();
+  const bool is_pca = IsSiftPCADescriptors(descriptors1);
+  std::vector<int> dots(grid2.descriptors.rows());
+  for (FeatureDescriptors::Index i1 = 0; i1 < descriptors1.rows(); ++i1) {
+    const float x1 = keypoints1[i1].x;
+    const float y1 = keypoints1[i1].y;
+    SiftBestDotProducts& best1 = (*best12)[i1];
+    search_region(
+        x1, y1, [&](const int col, const int row_begin, const int row_end) {
+          const int col_offset = col * grid2.num_rows;
+          const int begin = grid2.cell_offsets[col_offset + row_begin];
+          const int end = grid2.cell_offsets[col_offset + row_end + 1];
+          if (begin == end) {
+            return;
+          }
+          if (is_pca) {
+            ComputeSiftPCADotProducts(descriptors1.row(i1).data(),
+                                      grid2.descriptors.row(begin).data(),
+                                      end - begin,
+                                      num_dims,
+                                      dots.data(),
+                                      isa);
+          } else {
+            ComputeSiftDotProducts(descriptors1.row(i1).data(),
+                                   grid2.descriptors.row(begin).data(),
+                                   end - begin,
+                                   dots.data(),
+                                   isa);
+          }
+          for (int k = begin; k < end; ++k) {
+            if (guided_filter(x1, y1, grid2.xs[k], grid2.ys[k])) {
+              continue;
+            }
+            const int i2 = grid2.point_idxs[k];
+            const int dot = dots[k - begin];
+            UpdateGuidedBestDotProducts(i2, dot, &best1);
+            if (best21 != nullptr) {
+              UpdateGuidedBestDotProducts(i1, dot, &(*best21)[i2]);
+            }
+          }
+        });
+  }
 }
 
 void FindNearestNeighborsFlann(
@@ -1024,6 +1418,40 @@ void FindBestMatchesFlann(
   }
 }
 
+// Randomized kd-tree forest over the descriptors of one image. The index
+// references the descriptor data, so it keeps the descriptors alive.
+class SiftFlannDescriptorIndex : public FeatureDescriptorIndex {
+ public:
+  using FlannIndexType = flann::Index<flann::L2<uint8_t>>;
+
+  explicit SiftFlannDescriptorIndex(
+      std::shared_ptr<const FeatureDescriptors> descriptors)
+      : descriptors_(std::move(THROW_CHECK_NOTNULL(descriptors))) {
+    THROW_CHECK_EQ(descriptors_->cols(), 128);
+    if (descriptors_->rows() == 0) {
+      // Flann is not happy when the input has no descriptors.
+      return;
+    }
+    const flann::Matrix<uint8_t> descriptors_matrix(
+        const_cast<uint8_t*>(descriptors_->data()), descriptors_->rows(), 128);
+    constexpr size_t kNumTreesInForest = 4;
+    index_ = std::make_unique<FlannIndexType>(
+        descriptors_matrix, flann::KDTreeIndexParams(kNumTreesInForest));
+    index_->buildIndex();
+  }
+
+  size_t NumBytes() const override {
+    return index_ == nullptr ? 0 : index_->usedMemory();
+  }
+
+  const FeatureDescriptors& Descriptors() const { return *descriptors_; }
+  const FlannIndexType* Index() const { return index_.get(); }
+
+ private:
+  const std::shared_ptr<const FeatureDescriptors> descriptors_;
+  std::unique_ptr<FlannIndexType> index_;
+};
+
 class SiftCPUFeatureMatcher : public FeatureMatcher {
  public:
   explicit SiftCPUFeatureMatcher(const SiftMatchingOptions& options)
@@ -1036,6 +1464,23 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
     return std::make_unique<SiftCPUFeatureMatcher>(options);
   }
 
+  std::shared_ptr<const FeatureDescriptorIndex> CreateDescriptorIndex(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors)
+      const override {
+    if (options_.brute_force_cpu_matcher ||
+        IsSiftPCADescriptors(*descriptors)) {
+      return nullptr;
+    }
+    return std::make_shared<const SiftFlannDescriptorIndex>(descriptors);
+  }
+
+  void SetDescriptorIndices(
+      std::shared_ptr<const FeatureDescriptorIndex> index1,
+      std::shared_ptr<const FeatureDescriptorIndex> index2) override {
+    pending_index1_ = std::move(index1);
+    pending_index2_ = std::move(index2);
+  }
+
   void Match(const std::shared_ptr<const FeatureDescriptors>& descriptors1,
              const std::shared_ptr<const FeatureDescriptors>& descriptors2,
              FeatureMatches* matches) override {
@@ -1043,28 +1488,31 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
     matches->clear();
 
     if (descriptors1 != nullptr) {
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
+      CheckSiftDescriptorsDims(*descriptors1);
       descriptors1_ = descriptors1;
-      flann_index1_ = BuildFlannIndex(*descriptors1_);
+      flann_index1_ = GetOrBuildFlannIndex(descriptors1_, &pending_index1_);
     }
 
     if (descriptors2 != nullptr) {
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
+      CheckSiftDescriptorsDims(*descriptors2);
       descriptors2_ = descriptors2;
-      flann_index2_ = BuildFlannIndex(*descriptors2_);
+      flann_index2_ = GetOrBuildFlannIndex(descriptors2_, &pending_index2_);
     }
 
     THROW_CHECK_NOTNULL(descriptors1_);
     THROW_CHECK_NOTNULL(descriptors2_);
+    THROW_CHECK_EQ(descriptors1_->cols(), descriptors2_->cols());
 
     if (descriptors1_->rows() == 0 || descriptors2_->rows() == 0) {
       return;
     }
 
-    if (options_.brute_force_cpu_matcher) {
-      const Eigen::MatrixXi distances = ComputeSiftDistanceMatrix(
-          nullptr, nullptr, *descriptors1_, *descriptors2_, nullptr);
-      FindBestMatchesBruteForce(distances,
+    // The FLANN index uses the L2 distance of unsigned bytes, which does not
+    // apply to the signed PCA-reduced descriptors.
+    if (options_.brute_force_cpu_matcher ||
+        IsSiftPCADescriptors(*descriptors1_)) {
+      FindBestMatchesBruteForce(*descriptors1_,
+                                *descriptors2_,
                                 options_.max_ratio,
                                 options_.max_distance,
                                 options_.cross_check,
@@ -1081,15 +1529,23 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
     Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
         distances_2to1;
 
+    // The indices may have been reset by a previous guided matching call.
+    if (flann_index1_ == nullptr) {
+      flann_index1_ = GetOrBuildFlannIndex(descriptors1_, &pending_index1_);
+    }
+    if (flann_index2_ == nullptr) {
+      flann_index2_ = GetOrBuildFlannIndex(descriptors2_, &pending_index2_);
+    }
+
     FindNearestNeighborsFlann(*descriptors1_,
-                              *descriptors2_,
-                              *flann_index2_,
+                              flann_index2_->Descriptors(),
+                              *flann_index2_->Index(),
                               &indices_1to2,
                               &distances_1to2);
     if (options_.cross_check) {
       FindNearestNeighborsFlann(*descriptors2_,
-                                *descriptors1_,
-                                *flann_index1_,
+                                flann_index1_->Descriptors(),
+                                *flann_index1_->Index(),
                                 &indices_2to1,
                                 &distances_2to1);
     }
@@ -1117,30 +1573,45 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
     if (descriptors1 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints1);
       THROW_CHECK_EQ(descriptors1->rows(), keypoints1->size());
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
+      CheckSiftDescriptorsDims(*descriptors1);
       keypoints1_ = keypoints1;
       descriptors1_ = descriptors1;
-      flann_index1_ = BuildFlannIndex(*descriptors1_);
+      // Guided matching does not use the indices.
+      flann_index1_.reset();
+      pending_index1_.reset();
     }
 
     if (descriptors2 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints2);
       THROW_CHECK_EQ(descriptors2->rows(), keypoints2->size());
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
+      CheckSiftDescriptorsDims(*descriptors2);
       keypoints2_ = keypoints2;
       descriptors2_ = descriptors2;
-      flann_index2_ = BuildFlannIndex(*descriptors2_);
+      flann_index2_.reset();
+      pending_index2_.reset();
+    }
+
+    THROW_CHECK_NOTNULL(keypoints1_);
+    THROW_CHECK_NOTNULL(keypoints2_);
+    THROW_CHECK_EQ(descriptors1_->cols(), descriptors2_->cols());
+    if (keypoints1_->empty() || keypoints2_->empty()) {
+      return;
     }
 
     const float max_residual = max_error * max_error;
 
-    const Eigen::Matrix3f F = two_view_geometry->F.cast<float>();
-    const Eigen::Matrix3f H = two_view_geometry->H.cast<float>();
+    // The search regions are slightly enlarged, so that they are guaranteed
+    // to contain all keypoints passing the filters despite rounding errors.
+    constexpr double kSearchRegionPadding = 1.01;
+
+    std::vector<SiftBestDotProducts> best12;
+    std::vector<SiftBestDotProducts> best21;
+    const SiftGuidedMatchingGrid grid2(*keypoints2_, *descriptors2_);
 
-    std::function<bool(float, float, float, float)> guided_filter;
     if (two_view_geometry->config == TwoViewGeometry::CALIBRATED ||
         two_view_geometry->config == TwoViewGeometry::UNCALIBRATED) {
-      guided_filter =
+      const Eigen::Matrix3f F = two_view_geometry->F.cast<float>();
+      const auto guided_filter =
           [&](const float x1, const float y1, const float x2, const float y2) {
             const Eigen::Vector3f p1(x1, y1, 1.0f);
             const Eigen::Vector3f p2(x2, y2, 1.0f);
@@ -1152,72 +1623,143 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
                         Ftx2(1) * Ftx2(1)) >
                    max_residual;
           };
+
+      // The Sampson error is at most max_error, only if the algebraic error
+      // |x2'Fx1| is at most max_error * sqrt(|Fx1|^2 + |F'x2|^2), where |.|
+      // is the norm of the first two components, so bounding |F'x2| over all
+      // keypoints in the second image yields a band around the epipolar line.
+      const Eigen::Matrix3d F_double = two_view_geometry->F;
+      double max_sq_norm_Ftx2 = 0;
+      for (const FeatureKeypoint& keypoint2 : *keypoints2_) {
+        const Eigen::Vector3d Ftx2 =
+            F_double.transpose() *
+            Eigen::Vector3d(keypoint2.x, keypoint2.y, 1.0);
+        max_sq_norm_Ftx2 =
+            std::max(max_sq_norm_Ftx2, Ftx2.head<2>().squaredNorm());
+      }
+
+      const auto search_region =
+          [&](const float x1, const float y1, const auto& visit_column) {
+            const Eigen::Vector3d line =
+                F_double * Eigen::Vector3d(x1, y1, 1.0);
+            const double max_algebraic_error =
+                kSearchRegionPadding * max_error *
+                std::sqrt(line.head<2>().squaredNorm() + max_sq_norm_Ftx2);
+            for (int col = 0; col < grid2.num_cols; ++col) {
+              const double x_begin = grid2.min_x + col * grid2.cell_size;
+              const double x_end = x_begin + grid2.cell_size;
+              if (line(1) == 0) {
+                // Vertical epipolar line, for which the algebraic error does
+                // not depend on the row.
+                const double error_begin = line(0) * x_begin + line(2);
+                const double error_end = line(0) * x_end + line(2);
+                if (std::min(std::abs(error_begin), std::abs(error_end)) >
+                        max_algebraic_error &&
+                    error_begin * error_end > 0) {
+                  continue;
+                }
+                visit_column(col, 0, grid2.num_rows - 1);
+                continue;
+              }
+              // Range of y within the band over the x-range of the column.
+              const double y_begin = -(line(0) * x_begin + line(2)) / line(1);
+              const double y_end = -(line(0) * x_end + line(2)) / line(1);
+              const double y_margin = max_algebraic_error / std::abs(line(1));
+              const double min_y = std::min(y_begin, y_end) - y_margin;
+              const double max_y = std::max(y_begin, y_end) + y_margin;
+              if (max_y < grid2.min_y ||
+                  min_y > grid2.min_y + grid2.num_rows * grid2.cell_size) {
+                continue;
+              }
+              visit_column(col, grid2.RowIdx(min_y), grid2.RowIdx(max_y));
+            }
+          };
+
+      FindGuidedBestDotProducts(*keypoints1_,
+                                *descriptors1_,
+                                grid2,
+                                search_region,
+                                guided_filter,
+                                &best12,
+                                options_.cross_check ? &best21 : nullptr);
     } else if (two_view_geometry->config == TwoViewGeometry::PLANAR ||
                two_view_geometry->config == TwoViewGeometry::PANORAMIC ||
                two_view_geometry->config ==
                    TwoViewGeometry::PLANAR_OR_PANORAMIC) {
-      guided_filter =
+      const Eigen::Matrix3f H = two_view_geometry->H.cast<float>();
+      const auto guided_filter =
           [&](const float x1, const float y1, const float x2, const float y2) {
             const Eigen::Vector3f p1(x1, y1, 1.0f);
             const Eigen::Vector2f p2(x2, y2);
             return ((H * p1).hnormalized() - p2).squaredNorm() > max_residual;
           };
-    } else {
-      return;
-    }
-
-    THROW_CHECK(guided_filter);
 
-    const Eigen::MatrixXi dists = ComputeSiftDistanceMatrix(keypoints1_.get(),
-                                                            keypoints2_.get(),
-                                                            *descriptors1_,
-                                                            *descriptors2_,
-                                                            guided_filter);
-
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        indices_1to2(dists.rows(), dists.cols());
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        indices_2to1(dists.cols(), dists.rows());
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        distances_1to2 = dists;
-    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-        distances_2to1 = dists.transpose();
+      // Square around the projection of the keypoint into the second image.
+      const Eigen::Matrix3d H_double = two_view_geometry->H;
+      const double max_offset = kSearchRegionPadding * max_error;
+      const auto search_region =
+          [&](const float x1, const float y1, const auto& visit_column) {
+            const Eigen::Vector2d x2 =
+                (H_double * Eigen::Vector3d(x1, y1, 1.0)).hnormalized();
+            if (!x2.allFinite() ||
+                x2.x() + max_offset < grid2.min_x ||
+                x2.y() + max_offset < grid2.min_y ||
+                x2.x() - max_offset >
+                    grid2.min_x + grid2.num_cols * grid2.cell_size ||
+                x2.y() - max_offset >
+                    grid2.min_y + grid2.num_rows * grid2.cell_size) {
+              return;
+            }
+            const int row_begin = grid2.RowIdx(x2.y() - max_offset);
+            const int row_end = grid2.RowIdx(x2.y() + max_offset);
+            const int col_end = grid2.ColIdx(x2.x() + max_offset);
+            for (int col = grid2.ColIdx(x2.x() - max_offset); col <= col_end;
+                 ++col) {
+              visit_column(col, row_begin, row_end);
+            }
+          };
 
-    for (int i = 0; i < indices_1to2.rows(); ++i) {
-      indices_1to2.row(i) = Eigen::VectorXi::LinSpaced(
-          indices_1to2.cols(), 0, indices_1to2.cols() - 1);
-    }
-    for (int i = 0; i < indices_2to1.rows(); ++i) {
-      indices_2to1.row(i) = Eigen::VectorXi::LinSpaced(
-          indices_2to1.cols(), 0, indices_2to1.cols() - 1);
+      FindGuidedBestDotProducts(*keypoints1_,
+                                *descriptors1_,
+                                grid2,
+                                search_region,
+                                guided_filter,
+                                &best12,
+                                options_.cross_check ? &best21 : nullptr);
+    } else {
+      return;
     }
 
-    FindBestMatchesFlann(indices_1to2,
-                         distances_1to2,
-                         indices_2to1,
-                         distances_2to1,
-                         options_.max_ratio,
-                         options_.max_distance,
-                         options_.cross_check,
-                         &two_view_geometry->inlier_matches);
+    FindBestMatchesFromBestDotProducts(best12,
+                                       best21,
+                                       options_.max_ratio,
+                                       options_.max_distance,
+                                       GetSiftDotProductNorm(*descriptors1_),
+                                       options_.cross_check,
+                                       &two_view_geometry->inlier_matches);
   }
 
  private:
-  using FlannIndexType = flann::Index<flann::L2<uint8_t>>;
-
-  static std::unique_ptr<FlannIndexType> BuildFlannIndex(
-      const FeatureDescriptors& descriptors) {
-    THROW_CHECK_EQ(descriptors.cols(), 128);
-    if (descriptors.rows() == 0) {
-      // Flann is not happy when the input has no descriptors.
+  // Use the pre-built index, if one was set, and otherwise build a new one.
+  std::shared_ptr<const SiftFlannDescriptorIndex> GetOrBuildFlannIndex(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors,
+      std::shared_ptr<const FeatureDescriptorIndex>* pending_index) const {
+    if (options_.brute_force_cpu_matcher ||
+        IsSiftPCADescriptors(*descriptors)) {
+      pending_index->reset();
       return nullptr;
     }
-    const flann::Matrix<uint8_t> descriptors_matrix(
-        const_cast<uint8_t*>(descriptors.data()), descriptors.rows(), 128);
-    constexpr size_t kNumTreesInForest = 4;
-    auto index = std::make_unique<FlannIndexType>(
-        descriptors_matrix, flann::KDTreeIndexParams(kNumTreesInForest));
-    index->buildIndex();
+    std::shared_ptr<const SiftFlannDescriptorIndex> index;
+    if (*pending_index != nullptr) {
+      index =
+          std::dynamic_pointer_cast<const SiftFlannDescriptorIndex>(
+              *pending_index);
+      THROW_CHECK_NOTNULL(index);
+      THROW_CHECK_EQ(index->Descriptors().rows(), descriptors->rows());
+      pending_index->reset();
+    } else {
+      index = std::make_shared<const SiftFlannDescriptorIndex>(descriptors);
+    }
     return index;
   }
 
@@ -1226,8 +1768,10 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
   std::shared_ptr<const FeatureKeypoints> keypoints2_;
   std::shared_ptr<const FeatureDescriptors> descriptors1_;
   std::shared_ptr<const FeatureDescriptors> descriptors2_;
-  std::unique_ptr<FlannIndexType> flann_index1_;
-  std::unique_ptr<FlannIndexType> flann_index2_;
+  std::shared_ptr<const SiftFlannDescriptorIndex> flann_index1_;
+  std::shared_ptr<const SiftFlannDescriptorIndex> flann_index2_;
+  std::shared_ptr<const FeatureDescriptorIndex> pending_index1_;
+  std::shared_ptr<const FeatureDescriptorIndex> pending_index2_;
 };
 
 #if defined(COLMAP_GPU_ENABLED)
@@ -1287,6 +1831,9 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
       return nullptr;
     }
 
+    matcher->sift_match_gpu_.SetDescriptorCacheSize(static_cast<size_t>(
+        options.gpu_descriptor_cache_size * 1024 * 1024 * 1024));
+
 #if !defined(COLMAP_CUDA_ENABLED)
     if (matcher->sift_match_gpu_.GetMaxSift() < options.max_num_matches) {
       LOG(WARNING) << StringPrintf(
@@ -1297,6 +1844,11 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     }
 #endif  // COLMAP_CUDA_ENABLED
 
+    if (!options.pca_path.empty()) {
+      matcher->pca_ = std::make_unique<SiftPCA>();
+      matcher->pca_->Read(options.pca_path);
+    }
+
     matcher->sift_match_gpu_.gpu_index = gpu_indices[0];
     if (sift_match_gpu_mutexes_.count(gpu_indices[0]) == 0) {
       sift_match_gpu_mutexes_.emplace(gpu_indices[0],
@@ -1315,37 +1867,32 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     std::lock_guard<std::mutex> lock(
         *sift_match_gpu_mutexes_[sift_match_gpu_.gpu_index]);
 
-    if (descriptors1 != nullptr) {
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
-      WarnIfMaxNumMatchesReachedGPU(*descriptors1);
-      sift_match_gpu_.SetDescriptors(
-          0, descriptors1->rows(), descriptors1->data());
-    }
-
-    if (descriptors2 != nullptr) {
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
-      WarnIfMaxNumMatchesReachedGPU(*descriptors2);
-      sift_match_gpu_.SetDescriptors(
-          1, descriptors2->rows(), descriptors2->data());
-    }
+    SetDescriptorsGPU(0, descriptors1);
+    SetDescriptorsGPU(1, descriptors2);
+    MatchDescriptorsGPU(matches);
+  }
 
-    matches->resize(static_cast<size_t>(options_.max_num_matches));
+  void MatchBatch(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors1,
+      const std::vector<std::shared_ptr<const FeatureDescriptors>>&
+          descriptors2,
+      const MatchBatchCallback& callback) override {
+    THROW_CHECK(callback);
+
+    // The GPU is locked for the entire batch, such that the query stays
+    // uploaded and the targets are matched back-to-back without interleaving
+    // with other matchers on the same device. SiftMatchGPU only holds two
+    // descriptor sets at a time, so each target is still matched separately.
+    std::lock_guard<std::mutex> lock(
+        *sift_match_gpu_mutexes_[sift_match_gpu_.gpu_index]);
 
-    const int num_matches = sift_match_gpu_.GetSiftMatch(
-        options_.max_num_matches,
-        reinterpret_cast<uint32_t(*)[2]>(matches->data()),
-        static_cast<float>(options_.max_distance),
-        static_cast<float>(options_.max_ratio),
-        options_.cross_check);
+    SetDescriptorsGPU(0, descriptors1);
 
-    if (num_matches < 0) {
-      LOG(ERROR) << "Feature matching failed. This is probably caused by "
-                    "insufficient GPU memory. Consider reducing the maximum "
-                    "number of features and/or matches.";
-      matches->clear();
-    } else {
-      THROW_CHECK_LE(num_matches, matches->size());
-      matches->resize(num_matches);
+    FeatureMatches matches;
+    for (size_t i = 0; i < descriptors2.size(); ++i) {
+      SetDescriptorsGPU(1, descriptors2[i]);
+      MatchDescriptorsGPU(&matches);
+      callback(i, &matches);
     }
   }
 
@@ -1371,14 +1918,19 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
 
     constexpr size_t kFeatureShapeNumElems = 4;
 
+    // Guided matching is not tiled and needs the feature locations of the
+    // uploaded descriptors, which are not kept after tiled matching.
+    THROW_CHECK(descriptors1 != nullptr || uploaded_descriptors_[0])
+        << "Guided matching cannot reuse the descriptors of tiled matching";
+    THROW_CHECK(descriptors2 != nullptr || uploaded_descriptors_[1])
+        << "Guided matching cannot reuse the descriptors of tiled matching";
+
     if (descriptors1 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints1);
       THROW_CHECK_EQ(descriptors1->rows(), keypoints1->size());
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
-      WarnIfMaxNumMatchesReachedGPU(*descriptors1);
       const size_t kIndex = 0;
-      sift_match_gpu_.SetDescriptors(
-          kIndex, descriptors1->rows(), descriptors1->data());
+      SetDescriptorsGPU(kIndex, descriptors1);
+      UploadDescriptorsGPU(kIndex);
       sift_match_gpu_.SetFeautreLocation(
           kIndex,
           reinterpret_cast<const float*>(keypoints1->data()),
@@ -1388,11 +1940,9 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     if (descriptors2 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints2);
       THROW_CHECK_EQ(descriptors2->rows(), keypoints2->size());
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
-      WarnIfMaxNumMatchesReachedGPU(*descriptors2);
       const size_t kIndex = 1;
-      sift_match_gpu_.SetDescriptors(
-          kIndex, descriptors2->rows(), descriptors2->data());
+      SetDescriptorsGPU(kIndex, descriptors2);
+      UploadDescriptorsGPU(kIndex);
       sift_match_gpu_.SetFeautreLocation(
           kIndex,
           reinterpret_cast<const float*>(keypoints2->data()),
@@ -1448,6 +1998,228 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
   }
 
  private:
+  // Set the descriptors of the given index, if they are not null, and
+  // otherwise keep the previous descriptors. The descriptors are only
+  // uploaded to the GPU when they are matched, since tiled matching uploads
+  // them block by block and overwrites the previously uploaded descriptors.
+  // SiftGPU only supports 128-dimensional descriptors, so that PCA-reduced
+  // descriptors are reconstructed here. Requires the GPU to be locked by the
+  // caller.
+  void SetDescriptorsGPU(
+      const int index,
+      const std::shared_ptr<const FeatureDescriptors>& descriptors) {
+    if (descriptors == nullptr) {
+      return;
+    }
+    uploaded_descriptors_[index] = false;
+    descriptors_ids_[index] = GetDescriptorsId(descriptors);
+    if (!IsSiftPCADescriptors(*descriptors)) {
+      descriptors_[index] = descriptors;
+      return;
+    }
+    THROW_CHECK(pca_ != nullptr)
+        << "GPU matching of PCA-reduced descriptors requires the pca_path "
+           "of the projection";
+    THROW_CHECK_EQ(descriptors->cols(), pca_->NumDims());
+    descriptors_[index] =
+        std::make_shared<FeatureDescriptors>(pca_->Reconstruct(*descriptors));
+  }
+
+  // Upload the current descriptors of the given index to the GPU, unless they
+  // are already uploaded.
+  void UploadDescriptorsGPU(const int index) {
+    if (uploaded_descriptors_[index]) {
+      return;
+    }
+    THROW_CHECK_NOTNULL(descriptors_[index]);
+    const FeatureDescriptors& descriptors = *descriptors_[index];
+    WarnIfMaxNumMatchesReachedGPU(descriptors);
+    sift_match_gpu_.SetDescriptors(
+        index, descriptors.rows(), descriptors.data(), descriptors_ids_[index]);
+    uploaded_descriptors_[index] = true;
+  }
+
+  // Identifier of the descriptors in the device cache of SiftGPU, or -1 if
+  // the cache is disabled. The descriptors keep their identifier as long as
+  // they are alive, which the weak pointer detects even if their address is
+  // later reused by other descriptors, and identifiers are never reused.
+  int GetDescriptorsId(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors) {
+    if (options_.gpu_descriptor_cache_size <= 0) {
+      return -1;
+    }
+    auto it = descriptors_ids_map_.find(descriptors.get());
+    if (it != descriptors_ids_map_.end()) {
+      if (!it->second.first.expired()) {
+        return it->second.second;
+      }
+      descriptors_ids_map_.erase(it);
+    }
+    if (descriptors_ids_map_.size() >= max_descriptors_ids_map_size_) {
+      for (it = descriptors_ids_map_.begin();
+           it != descriptors_ids_map_.end();) {
+        if (it->second.first.expired()) {
+          it = descriptors_ids_map_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      max_descriptors_ids_map_size_ =
+          std::max<size_t>(1024, 2 * descriptors_ids_map_.size());
+    }
+    const int id = next_descriptors_id_++;
+    descriptors_ids_map_.emplace(descriptors.get(),
+                                 std::make_pair(descriptors, id));
+    return id;
+  }
+
+  // Match the current descriptors, which are tiled if tiled matching is
+  // enabled and either of them exceed the capacity of the GPU.
+  void MatchDescriptorsGPU(FeatureMatches* matches) {
+    THROW_CHECK_NOTNULL(descriptors_[0]);
+    THROW_CHECK_NOTNULL(descriptors_[1]);
+    if (options_.gpu_tiled_matching &&
+        (descriptors_[0]->rows() > sift_match_gpu_.GetMaxSift() ||
+         descriptors_[1]->rows() > sift_match_gpu_.GetMaxSift())) {
+      GetTiledSiftMatchGPU(matches);
+    } else {
+      UploadDescriptorsGPU(0);
+      UploadDescriptorsGPU(1);
+      GetSiftMatchGPU(matches);
+    }
+  }
+
+  // Match the currently uploaded descriptors. Requires the GPU to be locked by
+  // the caller.
+  void GetSiftMatchGPU(FeatureMatches* matches) {
+    matches->resize(static_cast<size_t>(options_.max_num_matches));
+
+    const int num_matches = sift_match_gpu_.GetSiftMatch(
+        options_.max_num_matches,
+        reinterpret_cast<uint32_t(*)[2]>(matches->data()),
+        static_cast<float>(options_.max_distance),
+        static_cast<float>(options_.max_ratio),
+        options_.cross_check);
+
+    if (num_matches < 0) {
+      LOG(ERROR) << "Feature matching failed. This is probably caused by "
+                    "insufficient GPU memory. Consider reducing the maximum "
+                    "number of features and/or matches.";
+      matches->clear();
+    } else {
+      THROW_CHECK_LE(num_matches, matches->size());
+      matches->resize(num_matches);
+    }
+  }
+
+  // Best and second best dot product of a feature and the index of its best
+  // match, as computed by SiftMatchGPU for a block of features.
+  typedef std::array<int, 3> BestMatch;
+
+  // Match the current descriptors block by block, where each block fits into
+  // the GPU memory. The GPU reduces each pair of blocks to the best matches
+  // of its rows (and columns for cross checking), which are merged here
+  // before applying the same distance, ratio, and cross check tests as
+  // SiftMatchGPU. Requires the GPU to be locked by the caller.
+  void GetTiledSiftMatchGPU(FeatureMatches* matches) {
+    matches->clear();
+
+    const FeatureDescriptors& descriptors1 = *descriptors_[0];
+    const FeatureDescriptors& descriptors2 = *descriptors_[1];
+    const int num_descriptors1 = descriptors1.rows();
+    const int num_descriptors2 = descriptors2.rows();
+    if (num_descriptors1 == 0 || num_descriptors2 == 0) {
+      return;
+    }
+
+    uploaded_descriptors_[0] = false;
+    uploaded_descriptors_[1] = false;
+
+    const int block_size = sift_match_gpu_.GetMaxSift();
+    const BestMatch kNoMatch = {0, -1, 0};
+    std::vector<BestMatch> best_matches1(num_descriptors1, kNoMatch);
+    std::vector<BestMatch> best_matches2(
+        options_.cross_check ? num_descriptors2 : 0, kNoMatch);
+    std::vector<BestMatch> block_best_matches1(block_size);
+    std::vector<BestMatch> block_best_matches2(block_size);
+
+    for (int begin1 = 0; begin1 < num_descriptors1; begin1 += block_size) {
+      const int num_block1 = std::min(block_size, num_descriptors1 - begin1);
+      sift_match_gpu_.SetDescriptors(
+          0, num_block1, descriptors1.row(begin1).data());
+      for (int begin2 = 0; begin2 < num_descriptors2; begin2 += block_size) {
+        const int num_block2 = std::min(block_size, num_descriptors2 - begin2);
+        sift_match_gpu_.SetDescriptors(
+            1, num_block2, descriptors2.row(begin2).data());
+
+        const int status = sift_match_gpu_.GetSiftMatchCandidates(
+            reinterpret_cast<int(*)[3]>(block_best_matches1.data()),
+            options_.cross_check
+                ? reinterpret_cast<int(*)[3]>(block_best_matches2.data())
+                : nullptr);
+        if (status <= 0) {
+          LOG(ERROR) << (status == 0
+                             ? "Tiled feature matching is only supported by "
+                               "the CUDA version of SiftGPU."
+                             : "Feature matching failed. This is probably "
+                               "caused by insufficient GPU memory. Consider "
+                               "reducing the maximum number of matches.");
+          return;
+        }
+
+        for (int i = 0; i < num_block1; ++i) {
+          MergeBestMatch(
+              block_best_matches1[i], begin2, &best_matches1[begin1 + i]);
+        }
+        if (options_.cross_check) {
+          for (int i = 0; i < num_block2; ++i) {
+            MergeBestMatch(
+                block_best_matches2[i], begin1, &best_matches2[begin2 + i]);
+          }
+        }
+      }
+    }
+
+    for (int i = 0; i < num_descriptors1; ++i) {
+      const int j = best_matches1[i][1];
+      if (j < 0 || !PassesMatchTests(best_matches1[i])) {
+        continue;
+      }
+      if (options_.cross_check && (best_matches2[j][1] != i ||
+                                   !PassesMatchTests(best_matches2[j]))) {
+        continue;
+      }
+      matches->emplace_back(i, j);
+    }
+  }
+
+  // Merge the best match within a block, whose indices start at the given
+  // offset, into the best match across all previous blocks. As in SiftGPU,
+  // the first of several equally good matches is kept.
+  static void MergeBestMatch(const BestMatch& block_best_match,
+                             const int offset,
+                             BestMatch* best_match) {
+    if (block_best_match[0] > (*best_match)[0]) {
+      (*best_match)[2] = std::max((*best_match)[0], block_best_match[2]);
+      (*best_match)[0] = block_best_match[0];
+      (*best_match)[1] = block_best_match[1] + offset;
+    } else {
+      (*best_match)[2] = std::max((*best_match)[2], block_best_match[0]);
+    }
+  }
+
+  // The distance and ratio tests of SiftMatchGPU, where the descriptors are
+  // normalized to 512 and their distance is the angle between them.
+  bool PassesMatchTests(const BestMatch& best_match) const {
+    constexpr double kDotScale = 1.0 / (512 * 512);
+    const double dist =
+        std::acos(std::min(best_match[0] * kDotScale, 1.0));
+    const double second_dist =
+        std::acos(std::min(best_match[2] * kDotScale, 1.0));
+    return dist < options_.max_distance &&
+           dist < second_dist * options_.max_ratio;
+  }
+
   void WarnIfMaxNumMatchesReachedGPU(const FeatureDescriptors& descriptors) {
     if (sift_match_gpu_.GetMaxSift() < descriptors.rows()) {
       LOG(WARNING) << StringPrintf(
@@ -1460,6 +2232,20 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
 
   const SiftMatchingOptions options_;
   SiftMatchGPU sift_match_gpu_;
+  std::unique_ptr<SiftPCA> pca_;
+  // The current (reconstructed) descriptors per index and whether they are
+  // uploaded to the GPU as a whole.
+  std::shared_ptr<const FeatureDescriptors> descriptors_[2];
+  bool uploaded_descriptors_[2] = {false, false};
+  // Identifiers of the current descriptors in the device cache of SiftGPU.
+  int descriptors_ids_[2] = {-1, -1};
+  std::unordered_map<
+      const FeatureDescriptors*,
+      std::pair<std::weak_ptr<const FeatureDescriptors>, int>>
+      descriptors_ids_map_;
+  size_t max_descriptors_ids_map_size_ = 1024;
+  // SiftGPU initializes the identifiers of its descriptor slots to 0.
+  int next_descriptors_id_ = 1;
 };
 #endif  // COLMAP_GPU_ENABLED
 
@@ -1535,4 +2321,48 @@ void LoadSiftFeaturesFromTextFile(const std::string& path,
   }
 }
 
+void LoadSiftFeaturesFromNpyFiles(const std::string& keypoints_path,
+                                  const std::string& descriptors_path,
+                                  FeatureKeypoints* keypoints,
+                                  FeatureDescriptors* descriptors) {
+  THROW_CHECK_NOTNULL(keypoints);
+  THROW_CHECK_NOTNULL(descriptors);
+
+  const NpyArray<float> keypoints_array = ReadNpyArray<float>(keypoints_path);
+  THROW_CHECK_EQ(keypoints_array.shape.size(), 2);
+  const size_t num_features = keypoints_array.shape[0];
+  const size_t num_params = keypoints_array.shape[1];
+  THROW_CHECK(num_params == 2 || num_params == 4 || num_params == 6)
+      << "Keypoints must have 2, 4, or 6 parameters";
+
+  const NpyArray<float> descriptors_array =
+      ReadNpyArray<float>(descriptors_path);
+  THROW_CHECK_EQ(descriptors_array.shape.size(), 2);
+  THROW_CHECK_EQ(descriptors_array.shape[0], num_features);
+  const size_t dim = descriptors_array.shape[1];
+  THROW_CHECK_EQ(dim, 128) << "SIFT features must have 128 dimensions";
+
+  keypoints->resize(num_features);
+  for (size_t i = 0; i < num_features; ++i) {
+    const float* params = keypoints_array.data.data() + i * num_params;
+    if (num_params == 2) {
+      (*keypoints)[i] = FeatureKeypoint(params[0], params[1]);
+    } else if (num_params == 4) {
+      (*keypoints)[i] =
+          FeatureKeypoint(params[0], params[1], params[2], params[3]);
+    } else {
+      (*keypoints)[i] = FeatureKeypoint(
+          params[0], params[1], params[2], params[3], params[4], params[5]);
+    }
+  }
+
+  descriptors->resize(num_features, dim);
+  for (size_t i = 0; i < num_features * dim; ++i) {
+    const float value = descriptors_array.data[i];
+    THROW_CHECK_GE(value, 0);
+    THROW_CHECK_LE(value, 255);
+    descriptors->data()[i] = TruncateCast<float, uint8_t>(value);
+  }
+}
+
 }  //  namespace colmap
@@ -50,6 +50,38 @@ struct SiftExtractionOptions {
   // 最大图像尺寸，否则降采样
   int max_image_size = 3200;
 
+  // Whether to upload images at full resolution and let SiftGPU down-scale
+  // them on the GPU instead of resizing them on the CPU. SiftGPU down-scales
+  // by powers of two, so that images may be processed at less than
+  // max_image_size. Only used for GPU extraction.
+  bool gpu_downsample = false;
+
+  // Number of extraction threads per GPU in gpu_index, each with its own
+  // SiftGPU context. While one thread runs SIFT on the GPU, the others convert
+  // the next images and post-process their results on the CPU. All threads
+  // pull from the same queue, so that faster GPUs process more images. By
+  // default, two images are in flight per GPU, such that the GPU does not idle
+  // while the results of the previous image are post-processed.
+  int gpu_num_threads_per_device = 2;
+
+  // Granularity in pixels of the SiftGPU pyramid allocation. Each context
+  // grows its pyramid to the image size rounded up to a multiple of this
+  // value, so that images of similar sizes reuse the allocated pyramid
+  // instead of reallocating it. Disabled if <= 0.
+  int gpu_pyramid_bucket_size = 512;
+
+  // Split images larger than tile_size in either dimension into overlapping
+  // tiles, which are processed in parallel on tile_num_threads threads. This
+  // provides intra-image parallelism for very large images, e.g., aerial
+  // images or orthophotos, which requires max_image_size to be increased
+  // accordingly. Keypoints in the overlap bands are assigned to exactly one
+  // tile, so tile_overlap should exceed the support region of the largest
+  // features. Disabled if tile_size <= 0. Only used by the standard CPU
+  // extractor, i.e., not for GPU and covariant extraction.
+  int tile_size = -1;
+  int tile_overlap = 256;
+  int tile_num_threads = -1;
+
   // Maximum number of features to detect, keeping larger-scale features.
   // 最大特征数，保留较大尺度的特征
   int max_num_features = 8192;
@@ -121,6 +153,29 @@ struct SiftExtractionOptions {
   };
   Normalization normalization = Normalization::L1_ROOT;
 
+  // Type of the extracted descriptors. Binary descriptors are extracted on the
+  // CPU by the extractor in binary.h, which only uses the maximum number of
+  // features and the upright option from these options.
+  FeatureDescriptorType descriptor_type = FeatureDescriptorType::SIFT;
+
+  // Path to a SiftPCA projection, e.g., learned by sift_pca_learner. If set,
+  // SIFT descriptors are reduced by the projection before they are stored, so
+  // that they are matched in fewer dimensions.
+  std::string pca_path = "";
+
+  // Path to a directory of cached features, which can be shared by the
+  // extractions into many databases, e.g., over overlapping image sets. The
+  // features of images with identical content and extraction options are read
+  // from the cache instead of being extracted again. Disabled if empty.
+  std::string feature_cache_path = "";
+
+  // The extracted features are written to the database in transactions of at
+  // most this many images or after the given number of seconds since the
+  // first image of the transaction was extracted. Larger transactions reduce
+  // the number of disk syncs, e.g., on network file systems.
+  int max_num_images_per_transaction = 100;
+  double max_transaction_duration = 10.0;
+
   bool Check() const;
 };
 
@@ -162,14 +217,77 @@ struct SiftMatchingOptions {
   // 最大匹配数
   int max_num_matches = 32768;
 
+  // Whether to match descriptor sets, which exceed the maximum number of
+  // matches allocated on the GPU, block by block instead of clamping them.
+  // The best and second best matches are merged across the blocks, so that
+  // the ratio and cross check tests see all features at a fixed GPU memory
+  // footprint. Only supported by the CUDA version of the GPU matcher.
+  bool gpu_tiled_matching = false;
+
+  // Cache size in gigabytes for the descriptors of recently matched images,
+  // which each GPU matcher keeps in device memory, such that images that are
+  // matched again, e.g., in vocabulary tree or spatial matching, are not
+  // uploaded again. Only supported by the CUDA version of the GPU matcher.
+  // Set to 0 to disable the cache.
+  double gpu_descriptor_cache_size = 0.25;
+
   // Whether to perform guided matching, if geometric verification succeeds.
   // 几何位置guide的匹配
   bool guided_matching = false;
 
   // Whether to use brute-force instead of FLANN based CPU matching.
+  // PCA-reduced descriptors are always matched by brute force on the CPU.
   // 是否使用cpu的暴力匹配
   bool brute_force_cpu_matcher = false;
 
+  // Path to the SiftPCA projection of PCA-reduced descriptors. Only required
+  // for GPU matching, since SiftGPU only supports 128-dimensional descriptors,
+  // which are reconstructed from the reduced descriptors on upload.
+  std::string pca_path = "";
+
+  // Whether to reject image pairs with the cheap vote-and-verify spatial
+  // verification before the full geometric verification. Pairs, for which
+  // the voting of similarity transformations between the feature shapes
+  // yields fewer effective inliers than the given minimum, are dropped.
+  bool vote_and_verify = false;
+  int vote_and_verify_min_num_inliers = 8;
+
+  // Number of features with the largest scale per image, which are first
+  // matched and verified in a cheap coarse stage. Only the image pairs with
+  // at least the given number of inliers in the coarse stage are then fully
+  // matched and verified, which saves the work for most wrong candidate
+  // pairs of exhaustive and retrieval based matching. Pairs of images with
+  // no more features than the coarse stage are always fully matched. Set to
+  // 0 to disable the coarse stage.
+  int coarse_num_features = 0;
+  int coarse_min_num_inliers = 8;
+
+  // Maximum error in pixels of the matching guided by a predicted two-view
+  // geometry, e.g., from the motion of the preceding pair in sequential
+  // matching. The prediction is less accurate than an estimated geometry, so
+  // the threshold is larger than the RANSAC error of guided matching.
+  double prediction_max_error = 16.0;
+
+  // Maximum number of image pairs with the same first image that are matched
+  // in one batch by the same worker. The descriptors of the first image are
+  // then loaded once and stay resident in the CPU cache or GPU memory for the
+  // entire batch. This mainly benefits exhaustive matching, where one image
+  // is matched against a whole block of images. Set to 1 to disable batching.
+  int batch_size = 1;
+
+  // The matching results are written to the database by a dedicated thread,
+  // which commits them in transactions of at most this many image pairs or
+  // after the given number of seconds since the start of the transaction.
+  // Larger transactions reduce the number of disk syncs.
+  int max_num_pairs_per_transaction = 1000;
+  double max_transaction_duration = 10.0;
+
+  // Whether to pin the CPU matching and verification threads to the NUMA
+  // nodes of the system, which are assigned consecutive blocks of threads.
+  // The descriptors and buffers of a worker are then mostly allocated in the
+  // memory of its node. Only effective on Linux systems with multiple nodes.
+  bool numa_affinity = false;
+
   bool Check() const;
 };
 
@@ -197,4 +315,15 @@ void LoadSiftFeaturesFromTextFile(const std::string& path,
                                   FeatureKeypoints* keypoints,
                                   FeatureDescriptors* descriptors);
 
+// Load keypoints and descriptors from binary NumPy .npy files, e.g., written
+// by numpy.save, which is much faster than parsing text files. The keypoints
+// are an array of shape NUM_FEATURES x 2 with X Y, NUM_FEATURES x 4 with
+// X Y SCALE ORIENTATION, or NUM_FEATURES x 6 with X Y A_11 A_12 A_21 A_22 of
+// the affine shape. The descriptors are an array of shape NUM_FEATURES x 128
+// with values in the range [0, 255].
+void LoadSiftFeaturesFromNpyFiles(const std::string& keypoints_path,
+                                  const std::string& descriptors_path,
+                                  FeatureKeypoints* keypoints,
+                                  FeatureDescriptors* descriptors);
+
 }  // namespace colmap
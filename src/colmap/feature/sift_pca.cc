@@ -0,0 +1,170 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/feature/sift_pca.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <Eigen/Eigenvalues>
+
+namespace colmap {
+namespace {
+
+constexpr int kSiftDim = 128;
+
+}  // namespace
+
+SiftPCA SiftPCA::Learn(const FeatureDescriptors& descriptors,
+                       const int num_dims) {
+  THROW_CHECK_EQ(descriptors.cols(), kSiftDim);
+  THROW_CHECK_GT(descriptors.rows(), 0);
+  THROW_CHECK_GT(num_dims, 0);
+  THROW_CHECK_LT(num_dims, kSiftDim);
+  THROW_CHECK_EQ(num_dims % 16, 0);
+
+  // The second moment matrix is accumulated in chunks, so that large samples
+  // are never converted to floating point as a whole.
+  constexpr int kChunkSize = 4096;
+  Eigen::MatrixXd second_moment = Eigen::MatrixXd::Zero(kSiftDim, kSiftDim);
+  for (int begin = 0; begin < descriptors.rows(); begin += kChunkSize) {
+    const int num_rows =
+        std::min(kChunkSize, static_cast<int>(descriptors.rows()) - begin);
+    const Eigen::MatrixXd chunk =
+        descriptors.middleRows(begin, num_rows).cast<double>();
+    second_moment.noalias() += chunk.transpose() * chunk;
+  }
+
+  // The eigenvalues are sorted in increasing order.
+  const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(second_moment);
+  THROW_CHECK_EQ(solver.info(), Eigen::Success);
+
+  SiftPCA pca;
+  pca.components_.resize(num_dims, kSiftDim);
+  double captured_energy = 0;
+  for (int i = 0; i < num_dims; ++i) {
+    const int eigen_idx = kSiftDim - 1 - i;
+    Eigen::VectorXd component = solver.eigenvectors().col(eigen_idx);
+    // The sign of the eigenvectors is arbitrary. Fix it deterministically, so
+    // that the first component, which is close to the mean direction of the
+    // non-negative descriptors, has positive coefficients.
+    if (component.sum() < 0) {
+      component = -component;
+    }
+    pca.components_.row(i) = component.transpose().cast<float>();
+    captured_energy += std::max(0.0, solver.eigenvalues()(eigen_idx));
+  }
+
+  const double total_energy = second_moment.trace();
+  pca.explained_energy_ =
+      total_energy > 0 ? static_cast<float>(captured_energy / total_energy)
+                       : 1.0f;
+
+  return pca;
+}
+
+FeatureDescriptors SiftPCA::Project(
+    const FeatureDescriptors& descriptors) const {
+  THROW_CHECK_GT(NumDims(), 0);
+  THROW_CHECK_EQ(descriptors.cols(), kSiftDim);
+  const Eigen::MatrixXf coefficients =
+      descriptors.cast<float>() * components_.transpose() /
+      kQuantizationStep;
+  FeatureDescriptors reduced_descriptors(descriptors.rows(), NumDims());
+  for (Eigen::Index i = 0; i < coefficients.rows(); ++i) {
+    for (Eigen::Index j = 0; j < coefficients.cols(); ++j) {
+      const int8_t value = static_cast<int8_t>(
+          std::clamp(std::round(coefficients(i, j)), -127.0f, 127.0f));
+      reduced_descriptors(i, j) = static_cast<uint8_t>(value);
+    }
+  }
+  return reduced_descriptors;
+}
+
+FeatureDescriptors SiftPCA::Reconstruct(
+    const FeatureDescriptors& reduced_descriptors) const {
+  THROW_CHECK_GT(NumDims(), 0);
+  THROW_CHECK_EQ(reduced_descriptors.cols(), NumDims());
+  Eigen::MatrixXf coefficients(reduced_descriptors.rows(), NumDims());
+  for (Eigen::Index i = 0; i < coefficients.rows(); ++i) {
+    for (Eigen::Index j = 0; j < coefficients.cols(); ++j) {
+      coefficients(i, j) =
+          kQuantizationStep *
+          static_cast<int8_t>(reduced_descriptors(i, j));
+    }
+  }
+  const Eigen::MatrixXf values = coefficients * components_;
+  FeatureDescriptors descriptors(reduced_descriptors.rows(), kSiftDim);
+  for (Eigen::Index i = 0; i < values.rows(); ++i) {
+    for (Eigen::Index j = 0; j < values.cols(); ++j) {
+      descriptors(i, j) = static_cast<uint8_t>(
+          std::clamp(std::round(values(i, j)), 0.0f, 255.0f));
+    }
+  }
+  return descriptors;
+}
+
+void SiftPCA::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  const uint64_t num_dims = ReadBinaryLittleEndian<uint64_t>(&file);
+  const uint64_t dim = ReadBinaryLittleEndian<uint64_t>(&file);
+  THROW_CHECK_GT(num_dims, 0);
+  THROW_CHECK_LT(num_dims, kSiftDim);
+  THROW_CHECK_EQ(num_dims % 16, 0);
+  THROW_CHECK_EQ(dim, kSiftDim);
+  explained_energy_ = ReadBinaryLittleEndian<float>(&file);
+  components_.resize(num_dims, kSiftDim);
+  for (Eigen::Index i = 0; i < components_.rows(); ++i) {
+    for (Eigen::Index j = 0; j < components_.cols(); ++j) {
+      components_(i, j) = ReadBinaryLittleEndian<float>(&file);
+    }
+  }
+  THROW_CHECK(file.good()) << "Truncated SIFT PCA file: " << path;
+}
+
+void SiftPCA::Write(const std::string& path) const {
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  WriteBinaryLittleEndian<uint64_t>(&file, components_.rows());
+  WriteBinaryLittleEndian<uint64_t>(&file, components_.cols());
+  WriteBinaryLittleEndian<float>(&file, explained_energy_);
+  for (Eigen::Index i = 0; i < components_.rows(); ++i) {
+    for (Eigen::Index j = 0; j < components_.cols(); ++j) {
+      WriteBinaryLittleEndian<float>(&file, components_(i, j));
+    }
+  }
+}
+
+}  // namespace colmap
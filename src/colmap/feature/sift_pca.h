@@ -0,0 +1,88 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/feature/types.h"
+
+#include <string>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+// Projection of 128-dimensional SIFT descriptors onto their leading principal
+// components for faster matching and smaller storage. The components are the
+// eigenvectors of the uncentered second moment matrix of the descriptors, so
+// that the dot products of the descriptors, from which the SIFT matchers
+// derive their normalized distances, are preserved up to the energy of the
+// truncated components. The coefficients are quantized to signed bytes and
+// stored reinterpreted as bytes in FeatureDescriptors with the
+// FeatureDescriptorType::SIFT_PCA type.
+class SiftPCA {
+ public:
+  // The quantized coefficients are the coefficients of the descriptors of
+  // length 512 divided by this step, i.e., reduced descriptors have a length
+  // of approximately 512 / kQuantizationStep.
+  static constexpr float kQuantizationStep = 4.0f;
+
+  // Learns the projection onto num_dims dimensions from a sample of SIFT
+  // descriptors. The number of dimensions must be a positive multiple of 16
+  // and less than 128, so that reduced descriptors can be distinguished from
+  // full descriptors by their number of columns.
+  static SiftPCA Learn(const FeatureDescriptors& descriptors, int num_dims);
+
+  // Number of dimensions of the reduced descriptors.
+  int NumDims() const { return components_.rows(); }
+
+  // Principal components in the rows, ordered by decreasing eigenvalue.
+  const Eigen::MatrixXf& Components() const { return components_; }
+
+  // Fraction of the second moment of the learning sample that is captured by
+  // the principal components.
+  float ExplainedEnergy() const { return explained_energy_; }
+
+  // Reduces 128-dimensional descriptors to NumDims() signed bytes.
+  FeatureDescriptors Project(const FeatureDescriptors& descriptors) const;
+
+  // Approximately reconstructs the 128-dimensional descriptors from reduced
+  // descriptors, e.g., for matchers that only support full descriptors.
+  FeatureDescriptors Reconstruct(
+      const FeatureDescriptors& reduced_descriptors) const;
+
+  // Read/write the projection from/to a binary file.
+  void Read(const std::string& path);
+  void Write(const std::string& path) const;
+
+ private:
+  Eigen::MatrixXf components_;
+  float explained_energy_ = 0;
+};
+
+}  // namespace colmap
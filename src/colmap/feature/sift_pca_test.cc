@@ -0,0 +1,154 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/feature/sift_pca.h"
+
+#include "colmap/util/testing.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+// Non-negative descriptors of length ~512 in a subspace of the given number of
+// dimensions, such that the subspace is exactly recoverable by the PCA.
+FeatureDescriptors CreateLowRankDescriptors(const int num_descriptors,
+                                            const int rank) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(0, 1);
+  Eigen::MatrixXf basis(rank, 128);
+  for (int i = 0; i < basis.size(); ++i) {
+    basis.data()[i] = distribution(prng);
+  }
+  FeatureDescriptors descriptors(num_descriptors, 128);
+  for (int i = 0; i < num_descriptors; ++i) {
+    Eigen::RowVectorXf coefficients(rank);
+    for (int j = 0; j < rank; ++j) {
+      coefficients(j) = distribution(prng);
+    }
+    Eigen::RowVectorXf descriptor = coefficients * basis;
+    descriptor *= 512 / descriptor.norm();
+    descriptors.row(i) =
+        descriptor.array().round().min(255.0f).cast<uint8_t>().matrix();
+  }
+  return descriptors;
+}
+
+float ComputeAngle(const Eigen::RowVectorXf& descriptor1,
+                   const Eigen::RowVectorXf& descriptor2) {
+  return std::acos(std::min(
+      1.0f,
+      descriptor1.dot(descriptor2) / (descriptor1.norm() * descriptor2.norm())));
+}
+
+Eigen::RowVectorXf SignedRow(const FeatureDescriptors& descriptors,
+                             const int row) {
+  Eigen::RowVectorXf values(descriptors.cols());
+  for (int j = 0; j < descriptors.cols(); ++j) {
+    values(j) = static_cast<int8_t>(descriptors(row, j));
+  }
+  return values;
+}
+
+TEST(SiftPCA, Learn) {
+  const FeatureDescriptors descriptors = CreateLowRankDescriptors(500, 16);
+  const SiftPCA pca = SiftPCA::Learn(descriptors, 32);
+  EXPECT_EQ(pca.NumDims(), 32);
+  ASSERT_EQ(pca.Components().rows(), 32);
+  ASSERT_EQ(pca.Components().cols(), 128);
+  EXPECT_GT(pca.ExplainedEnergy(), 0.999);
+  EXPECT_LE(pca.ExplainedEnergy(), 1.0 + 1e-6);
+  const Eigen::MatrixXf identity =
+      pca.Components() * pca.Components().transpose();
+  EXPECT_TRUE(identity.isApprox(Eigen::MatrixXf::Identity(32, 32), 1e-4));
+  // The first component is the mean direction of non-negative descriptors.
+  EXPECT_GT(pca.Components().row(0).minCoeff(), 0);
+}
+
+TEST(SiftPCA, Invalid) {
+  const FeatureDescriptors descriptors = CreateLowRankDescriptors(10, 4);
+  EXPECT_ANY_THROW(SiftPCA::Learn(descriptors, 0));
+  EXPECT_ANY_THROW(SiftPCA::Learn(descriptors, 24));
+  EXPECT_ANY_THROW(SiftPCA::Learn(descriptors, 128));
+  EXPECT_ANY_THROW(SiftPCA::Learn(FeatureDescriptors(0, 128), 32));
+  EXPECT_ANY_THROW(SiftPCA::Learn(FeatureDescriptors(10, 64), 32));
+}
+
+TEST(SiftPCA, ProjectAndReconstruct) {
+  const FeatureDescriptors descriptors = CreateLowRankDescriptors(200, 16);
+  const SiftPCA pca = SiftPCA::Learn(descriptors, 16);
+  const FeatureDescriptors reduced_descriptors = pca.Project(descriptors);
+  ASSERT_EQ(reduced_descriptors.rows(), descriptors.rows());
+  ASSERT_EQ(reduced_descriptors.cols(), 16);
+
+  for (int i = 0; i < 10; ++i) {
+    // Reduced descriptors have a length of 512 / kQuantizationStep.
+    EXPECT_NEAR(SignedRow(reduced_descriptors, i).norm(),
+                512 / SiftPCA::kQuantizationStep,
+                2);
+    for (int j = 0; j < 10; ++j) {
+      EXPECT_NEAR(ComputeAngle(descriptors.row(i).cast<float>(),
+                               descriptors.row(j).cast<float>()),
+                  ComputeAngle(SignedRow(reduced_descriptors, i),
+                               SignedRow(reduced_descriptors, j)),
+                  0.02);
+    }
+  }
+
+  const FeatureDescriptors reconstructed_descriptors =
+      pca.Reconstruct(reduced_descriptors);
+  ASSERT_EQ(reconstructed_descriptors.rows(), descriptors.rows());
+  ASSERT_EQ(reconstructed_descriptors.cols(), 128);
+  for (int i = 0; i < descriptors.rows(); ++i) {
+    EXPECT_LT(ComputeAngle(descriptors.row(i).cast<float>(),
+                           reconstructed_descriptors.row(i).cast<float>()),
+              0.02);
+  }
+
+  EXPECT_ANY_THROW(pca.Project(reduced_descriptors));
+  EXPECT_ANY_THROW(pca.Reconstruct(descriptors));
+}
+
+TEST(SiftPCA, ReadWrite) {
+  const FeatureDescriptors descriptors = CreateLowRankDescriptors(100, 8);
+  const SiftPCA pca = SiftPCA::Learn(descriptors, 16);
+  const std::string path = CreateTestDir() + "/pca.bin";
+  pca.Write(path);
+  SiftPCA read_pca;
+  read_pca.Read(path);
+  EXPECT_EQ(read_pca.NumDims(), pca.NumDims());
+  EXPECT_EQ(read_pca.ExplainedEnergy(), pca.ExplainedEnergy());
+  EXPECT_EQ(read_pca.Components(), pca.Components());
+  EXPECT_EQ(read_pca.Project(descriptors), pca.Project(descriptors));
+}
+
+}  // namespace
+}  // namespace colmap
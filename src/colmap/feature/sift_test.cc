@@ -36,10 +36,13 @@
 #endif
 
 #include "colmap/feature/sift.h"
+#include "colmap/feature/sift_pca.h"
 #include "colmap/feature/utils.h"
 #include "colmap/math/math.h"
 #include "colmap/math/random.h"
+#include "colmap/util/npy.h"
 #include "colmap/util/opengl_utils.h"
+#include "colmap/util/testing.h"
 
 #include "thirdparty/SiftGPU/SiftGPU.h"
 
@@ -88,6 +91,103 @@ TEST(ExtractSiftFeaturesCPU, Nominal) {
   }
 }
 
+void ExpectEqualFeaturesAcrossImages(const SiftExtractionOptions& options) {
+  Bitmap bitmap;
+  CreateImageWithSquare(256, &bitmap);
+  Bitmap other_bitmap;
+  CreateImageWithSquare(192, &other_bitmap);
+
+  auto extractor = CreateSiftFeatureExtractor(options);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+
+  // The reused scratch buffers of the extractor must not leak state between
+  // images of the same or different size.
+  for (const Bitmap* next_bitmap : {&other_bitmap, &bitmap, &bitmap}) {
+    FeatureKeypoints next_keypoints;
+    FeatureDescriptors next_descriptors;
+    EXPECT_TRUE(
+        extractor->Extract(*next_bitmap, &next_keypoints, &next_descriptors));
+    EXPECT_EQ(next_keypoints.size(), next_descriptors.rows());
+    if (next_bitmap == &bitmap) {
+      ASSERT_EQ(next_keypoints.size(), keypoints.size());
+      for (size_t i = 0; i < keypoints.size(); ++i) {
+        EXPECT_EQ(next_keypoints[i].x, keypoints[i].x);
+        EXPECT_EQ(next_keypoints[i].y, keypoints[i].y);
+      }
+      EXPECT_EQ(next_descriptors, descriptors);
+    }
+  }
+}
+
+TEST(ExtractSiftFeaturesCPU, ReuseAcrossImages) {
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.estimate_affine_shape = false;
+  options.domain_size_pooling = false;
+  options.force_covariant_extractor = false;
+  ExpectEqualFeaturesAcrossImages(options);
+}
+
+TEST(ExtractCovariantSiftFeaturesCPU, ReuseAcrossImages) {
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.estimate_affine_shape = false;
+  options.domain_size_pooling = false;
+  options.force_covariant_extractor = true;
+  ExpectEqualFeaturesAcrossImages(options);
+}
+
+TEST(ExtractSiftFeaturesCPU, Tiled) {
+  Bitmap bitmap;
+  CreateImageWithSquare(512, &bitmap);
+
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.estimate_affine_shape = false;
+  options.domain_size_pooling = false;
+  options.force_covariant_extractor = false;
+  options.tile_size = 200;
+  options.tile_overlap = 64;
+  options.tile_num_threads = 4;
+  auto extractor = CreateSiftFeatureExtractor(options);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+
+  EXPECT_GT(keypoints.size(), 0);
+  EXPECT_EQ(keypoints.size(), descriptors.rows());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    EXPECT_GE(keypoints[i].x, 0);
+    EXPECT_GE(keypoints[i].y, 0);
+    EXPECT_LE(keypoints[i].x, bitmap.Width());
+    EXPECT_LE(keypoints[i].y, bitmap.Height());
+    EXPECT_GT(keypoints[i].ComputeScale(), 0);
+    for (size_t j = 0; j < i; ++j) {
+      EXPECT_FALSE(keypoints[i].x == keypoints[j].x &&
+                   keypoints[i].y == keypoints[j].y &&
+                   keypoints[i].ComputeScale() == keypoints[j].ComputeScale() &&
+                   keypoints[i].ComputeOrientation() ==
+                       keypoints[j].ComputeOrientation());
+    }
+  }
+  for (FeatureDescriptors::Index i = 0; i < descriptors.rows(); ++i) {
+    EXPECT_LT(std::abs(descriptors.row(i).cast<float>().norm() - 512), 1);
+  }
+
+  options.max_num_features = 10;
+  extractor = CreateSiftFeatureExtractor(options);
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+  EXPECT_EQ(keypoints.size(), 10);
+  EXPECT_EQ(descriptors.rows(), 10);
+
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, nullptr));
+  EXPECT_EQ(keypoints.size(), 10);
+}
+
 TEST(ExtractCovariantSiftFeaturesCPU, Nominal) {
   Bitmap bitmap;
   CreateImageWithSquare(256, &bitmap);
@@ -366,6 +466,70 @@ TEST(SiftCPUFeatureMatcher, Nominal) {
   EXPECT_EQ(matches.size(), 0);
 }
 
+TEST(SiftCPUFeatureMatcher, DescriptorIndices) {
+  const auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(50));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  auto matcher = CreateSiftFeatureMatcher(options);
+
+  FeatureMatches matches;
+  matcher->Match(descriptors1, descriptors2, &matches);
+
+  const auto index1 = matcher->CreateDescriptorIndex(descriptors1);
+  const auto index2 = matcher->CreateDescriptorIndex(descriptors2);
+  ASSERT_NE(index1, nullptr);
+  ASSERT_NE(index2, nullptr);
+  EXPECT_GT(index1->NumBytes(), 0);
+
+  // Indices are shareable across matchers.
+  auto other_matcher = CreateSiftFeatureMatcher(options);
+  FeatureMatches matches_with_indices;
+  other_matcher->SetDescriptorIndices(index1, index2);
+  other_matcher->Match(descriptors1, descriptors2, &matches_with_indices);
+  CheckEqualMatches(matches, matches_with_indices);
+
+  other_matcher->SetDescriptorIndices(nullptr, index1);
+  other_matcher->Match(nullptr, descriptors1, &matches_with_indices);
+  EXPECT_EQ(matches_with_indices.size(), 50);
+
+  options.brute_force_cpu_matcher = true;
+  auto bf_matcher = CreateSiftFeatureMatcher(options);
+  EXPECT_EQ(bf_matcher->CreateDescriptorIndex(descriptors1), nullptr);
+}
+
+TEST(SiftCPUFeatureMatcher, MatchBatch) {
+  const auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(50));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+  const auto empty_descriptors = std::make_shared<FeatureDescriptors>(0, 128);
+
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  auto matcher = CreateSiftFeatureMatcher(options);
+
+  FeatureMatches matches;
+  matcher->Match(descriptors1, descriptors2, &matches);
+
+  std::vector<FeatureMatches> batch_matches;
+  matcher->MatchBatch(
+      descriptors1,
+      {descriptors2, empty_descriptors, nullptr, descriptors2},
+      [&batch_matches](size_t i, FeatureMatches* matches) {
+        EXPECT_EQ(i, batch_matches.size());
+        batch_matches.push_back(*matches);
+      });
+  ASSERT_EQ(batch_matches.size(), 4);
+  CheckEqualMatches(matches, batch_matches[0]);
+  EXPECT_EQ(batch_matches[1].size(), 0);
+  EXPECT_EQ(batch_matches[2].size(), 0);
+  CheckEqualMatches(matches, batch_matches[3]);
+}
+
 TEST(SiftCPUFeatureMatcherFlannVsBruteForce, Nominal) {
   SiftMatchingOptions match_options;
   match_options.max_num_matches = 1000;
@@ -546,6 +710,135 @@ TEST(MatchGuidedSiftFeaturesCPU, Nominal) {
   EXPECT_EQ(two_view_geometry.inlier_matches.size(), 0);
 }
 
+TEST(MatchGuidedSiftFeaturesCPU, Epipolar) {
+  constexpr int kNumFeatures = 200;
+  const auto descriptors1 = std::make_shared<FeatureDescriptors>(
+      CreateRandomFeatureDescriptors(kNumFeatures));
+  const auto descriptors2 = std::make_shared<FeatureDescriptors>(*descriptors1);
+
+  // Horizontal epipolar lines, where even features lie on their epipolar line
+  // and odd features are off by more than the maximum error.
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
+  two_view_geometry.F << 0, 0, 0, 0, 0, -1, 0, 1, 0;
+  auto keypoints1 = std::make_shared<FeatureKeypoints>(kNumFeatures);
+  auto keypoints2 = std::make_shared<FeatureKeypoints>(kNumFeatures);
+  for (int i = 0; i < kNumFeatures; ++i) {
+    (*keypoints1)[i].x = RandomUniformReal(0.0f, 1000.0f);
+    (*keypoints1)[i].y = RandomUniformReal(0.0f, 800.0f);
+    (*keypoints2)[i].x = RandomUniformReal(0.0f, 1000.0f);
+    (*keypoints2)[i].y = (*keypoints1)[i].y + (i % 2 == 0 ? 1.0f : 10.0f);
+  }
+
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  options.brute_force_cpu_matcher = true;
+  auto matcher = CreateSiftFeatureMatcher(options);
+
+  matcher->MatchGuided(/*max_error=*/4.0,
+                       keypoints1,
+                       keypoints2,
+                       descriptors1,
+                       descriptors2,
+                       &two_view_geometry);
+  EXPECT_EQ(two_view_geometry.inlier_matches.size(), kNumFeatures / 2);
+  for (const auto& match : two_view_geometry.inlier_matches) {
+    EXPECT_EQ(match.point2D_idx1 % 2, 0);
+    EXPECT_EQ(match.point2D_idx1, match.point2D_idx2);
+  }
+
+  // Without effective geometric constraint, guided matching is equivalent to
+  // unguided matching.
+  matcher->MatchGuided(/*max_error=*/1e6,
+                       keypoints1,
+                       keypoints2,
+                       descriptors1,
+                       descriptors2,
+                       &two_view_geometry);
+  FeatureMatches matches;
+  matcher->Match(descriptors1, descriptors2, &matches);
+  CheckEqualMatches(two_view_geometry.inlier_matches, matches);
+}
+
+TEST(SiftCPUFeatureMatcher, PCA) {
+  const FeatureDescriptors descriptors = CreateRandomFeatureDescriptors(100);
+  const SiftPCA pca = SiftPCA::Learn(descriptors, 64);
+  const auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(pca.Project(descriptors));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+  ASSERT_EQ(descriptors1->cols(), 64);
+
+  for (const bool brute_force_cpu_matcher : {true, false}) {
+    SiftMatchingOptions options;
+    options.use_gpu = false;
+    options.brute_force_cpu_matcher = brute_force_cpu_matcher;
+    auto matcher = CreateSiftFeatureMatcher(options);
+    // Reduced descriptors are always matched by brute force.
+    EXPECT_EQ(matcher->CreateDescriptorIndex(descriptors1), nullptr);
+
+    FeatureMatches matches;
+    matcher->Match(descriptors1, descriptors2, &matches);
+    ASSERT_EQ(matches.size(), descriptors1->rows());
+    for (size_t i = 0; i < matches.size(); ++i) {
+      EXPECT_EQ(matches[i].point2D_idx1, i);
+      EXPECT_EQ(matches[i].point2D_idx2, descriptors1->rows() - 1 - i);
+    }
+
+    const auto full_descriptors =
+        std::make_shared<FeatureDescriptors>(descriptors);
+    EXPECT_ANY_THROW(matcher->Match(descriptors1, full_descriptors, &matches));
+  }
+}
+
+TEST(MatchGuidedSiftFeaturesCPU, PCA) {
+  const FeatureDescriptors descriptors = CreateRandomFeatureDescriptors(2);
+  const SiftPCA pca = SiftPCA::Learn(CreateRandomFeatureDescriptors(100), 32);
+  auto keypoints1 = std::make_shared<FeatureKeypoints>(2);
+  (*keypoints1)[0].x = 1;
+  (*keypoints1)[1].x = 2;
+  auto keypoints2 = std::make_shared<FeatureKeypoints>(2);
+  (*keypoints2)[0].x = 2;
+  (*keypoints2)[1].x = 1;
+  const auto descriptors1 =
+      std::make_shared<FeatureDescriptors>(pca.Project(descriptors));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+  two_view_geometry.H = Eigen::Matrix3d::Identity();
+
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  auto matcher = CreateSiftFeatureMatcher(options);
+
+  constexpr double kMaxError = 4.0;
+
+  matcher->MatchGuided(kMaxError,
+                       keypoints1,
+                       keypoints2,
+                       descriptors1,
+                       descriptors2,
+                       &two_view_geometry);
+  EXPECT_EQ(two_view_geometry.inlier_matches.size(), 2);
+  EXPECT_EQ(two_view_geometry.inlier_matches[0].point2D_idx1, 0);
+  EXPECT_EQ(two_view_geometry.inlier_matches[0].point2D_idx2, 1);
+  EXPECT_EQ(two_view_geometry.inlier_matches[1].point2D_idx1, 1);
+  EXPECT_EQ(two_view_geometry.inlier_matches[1].point2D_idx2, 0);
+
+  (*keypoints1)[0].x = 100;
+  matcher->MatchGuided(kMaxError,
+                       keypoints1,
+                       keypoints2,
+                       descriptors1,
+                       descriptors2,
+                       &two_view_geometry);
+  EXPECT_EQ(two_view_geometry.inlier_matches.size(), 1);
+  EXPECT_EQ(two_view_geometry.inlier_matches[0].point2D_idx1, 1);
+  EXPECT_EQ(two_view_geometry.inlier_matches[0].point2D_idx2, 0);
+}
+
 TEST(MatchSiftFeaturesGPU, Nominal) {
   char app_name[] = "Test";
   int argc = 1;
@@ -604,6 +897,19 @@ TEST(MatchSiftFeaturesGPU, Nominal) {
       EXPECT_EQ(matches.size(), 0);
       matcher->Match(empty_descriptors, empty_descriptors, &matches);
       EXPECT_EQ(matches.size(), 0);
+
+      std::vector<FeatureMatches> batch_matches;
+      matcher->MatchBatch(
+          descriptors1,
+          {descriptors2, empty_descriptors, descriptors2},
+          [&batch_matches](size_t i, FeatureMatches* matches) {
+            EXPECT_EQ(i, batch_matches.size());
+            batch_matches.push_back(*matches);
+          });
+      ASSERT_EQ(batch_matches.size(), 3);
+      EXPECT_EQ(batch_matches[0].size(), 2);
+      EXPECT_EQ(batch_matches[1].size(), 0);
+      EXPECT_EQ(batch_matches[2].size(), 2);
     }
     OpenGLContextManager opengl_context_;
   };
@@ -741,6 +1047,46 @@ TEST(MatchSiftFeaturesCPUvsGPU, Nominal) {
   RunThreadWithOpenGLContext(&thread);
 }
 
+TEST(MatchSiftFeaturesGPU, Tiled) {
+#if defined(COLMAP_CUDA_ENABLED)
+  SiftMatchingOptions options;
+  options.use_gpu = true;
+  options.gpu_index = "0";
+  options.max_num_matches = 128;
+  options.gpu_tiled_matching = true;
+
+  for (const bool cross_check : {false, true}) {
+    options.cross_check = cross_check;
+    auto gpu_matcher = THROW_CHECK_NOTNULL(CreateSiftFeatureMatcher(options));
+    options.use_gpu = false;
+    auto cpu_matcher = CreateSiftFeatureMatcher(options);
+    options.use_gpu = true;
+
+    const auto descriptors1 = std::make_shared<FeatureDescriptors>(
+        CreateRandomFeatureDescriptors(300));
+    // Duplicate features in different blocks fail the ratio test.
+    descriptors1->row(250) = descriptors1->row(10);
+    const auto descriptors2 = std::make_shared<FeatureDescriptors>(
+        descriptors1->colwise().reverse());
+
+    FeatureMatches matches_cpu;
+    FeatureMatches matches_gpu;
+    cpu_matcher->Match(descriptors1, descriptors2, &matches_cpu);
+    gpu_matcher->Match(descriptors1, descriptors2, &matches_gpu);
+    EXPECT_EQ(matches_gpu.size(), 298);
+    CheckEqualMatches(matches_cpu, matches_gpu);
+
+    // Reuse the previous descriptors after tiled matching.
+    const auto descriptors3 = std::make_shared<FeatureDescriptors>(
+        descriptors2->middleRows(100, 100));
+    gpu_matcher->Match(nullptr, descriptors3, &matches_gpu);
+    cpu_matcher->Match(nullptr, descriptors3, &matches_cpu);
+    EXPECT_EQ(matches_gpu.size(), 100);
+    CheckEqualMatches(matches_cpu, matches_gpu);
+  }
+#endif
+}
+
 TEST(MatchGuidedSiftFeaturesGPU, Nominal) {
   char app_name[] = "Test";
   int argc = 1;
@@ -860,5 +1206,40 @@ TEST(MatchGuidedSiftFeaturesGPU, Nominal) {
   RunThreadWithOpenGLContext(&thread);
 }
 
+TEST(LoadSiftFeaturesFromNpyFiles, Nominal) {
+  const std::string test_dir = CreateTestDir();
+  const std::string keypoints_path = test_dir + "/keypoints.npy";
+  const std::string descriptors_path = test_dir + "/descriptors.npy";
+  NpyArray<float> keypoints_array;
+  keypoints_array.shape = {2, 4};
+  keypoints_array.data = {1, 2, 3, 0, 4, 5, 6, 0};
+  WriteNpyArray(keypoints_path, keypoints_array);
+  NpyArray<uint8_t> descriptors_array;
+  descriptors_array.shape = {2, 128};
+  descriptors_array.data.resize(2 * 128);
+  for (size_t i = 0; i < descriptors_array.data.size(); ++i) {
+    descriptors_array.data[i] = i % 256;
+  }
+  WriteNpyArray(descriptors_path, descriptors_array);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  LoadSiftFeaturesFromNpyFiles(
+      keypoints_path, descriptors_path, &keypoints, &descriptors);
+  ASSERT_EQ(keypoints.size(), 2);
+  EXPECT_EQ(keypoints[1].x, 4);
+  EXPECT_EQ(keypoints[1].y, 5);
+  EXPECT_NEAR(keypoints[1].ComputeScale(), 6, 1e-5);
+  ASSERT_EQ(descriptors.rows(), 2);
+  ASSERT_EQ(descriptors.cols(), 128);
+  EXPECT_EQ(descriptors(1, 127), 255);
+
+  descriptors_array.shape = {1, 128};
+  descriptors_array.data.resize(128);
+  WriteNpyArray(descriptors_path, descriptors_array);
+  EXPECT_ANY_THROW(LoadSiftFeaturesFromNpyFiles(
+      keypoints_path, descriptors_path, &keypoints, &descriptors));
+}
+
 }  // namespace
 }  // namespace colmap
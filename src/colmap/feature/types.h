@@ -83,6 +83,19 @@ typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
 typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
     FeatureDescriptorsFloat;
 
+// Type of the descriptors of an image. The values are stored in the database,
+// so existing values must not change.
+enum class FeatureDescriptorType {
+  // 128-dimensional SIFT descriptors compared by their (quantized) L2 distance.
+  SIFT = 0,
+  // Bit strings, e.g. 256-bit ORB-like descriptors, where each byte packs 8
+  // bits and descriptors are compared by their Hamming distance.
+  BINARY = 1,
+  // SIFT descriptors reduced to fewer than 128 dimensions by a SiftPCA and
+  // stored as signed bytes, which are compared by their dot products.
+  SIFT_PCA = 2,
+};
+
 // api: 特征匹配数据结构体
 struct FeatureMatch {
   FeatureMatch()
@@ -36,6 +36,7 @@
 #include "colmap/util/misc.h"
 #include "colmap/util/threading.h"
 
+#include <algorithm>
 #include <fstream>
 
 namespace colmap {
@@ -160,14 +161,17 @@ COLMAPUndistorter::COLMAPUndistorter(const UndistortCameraOptions& options,
                                      const std::string& output_path,
                                      const int num_patch_match_src_images,
                                      const CopyType copy_type,
-                                     const std::vector<image_t>& image_ids)
+                                     const std::vector<image_t>& image_ids,
+                                     const bool keep_distorted_images)
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
       copy_type_(copy_type),
       num_patch_match_src_images_(num_patch_match_src_images),
       reconstruction_(reconstruction),
-      image_ids_(image_ids) {}
+      image_ids_(image_ids),
+      keep_distorted_images_(keep_distorted_images),
+      undistort_cache_(options) {}
 
 void COLMAPUndistorter::Run() {
   PrintHeading1("Image undistortion");
@@ -228,6 +232,11 @@ void COLMAPUndistorter::Run() {
   Reconstruction undistorted_reconstruction = reconstruction_;
   UndistortReconstruction(options_, &undistorted_reconstruction);
   undistorted_reconstruction.Write(JoinPaths(output_path_, "sparse"));
+  if (keep_distorted_images_) {
+    WriteCamerasBinary(
+        reconstruction_,
+        JoinPaths(output_path_, "sparse", kDistortedCamerasFileName));
+  }
 
   LOG(INFO) << "Writing configuration...";
   WritePatchMatchConfig();
@@ -253,8 +262,9 @@ bool COLMAPUndistorter::Undistort(const image_t image_id) const {
       JoinPaths(output_path_, "images", image.Name());
 
   // Check if the image is already undistorted and copy from source if no
-  // scaling is needed
-  if (camera.IsUndistorted() && options_.max_image_size < 0 &&
+  // scaling is needed. Distorted images are kept as is, if requested.
+  if ((keep_distorted_images_ ||
+       (camera.IsUndistorted() && options_.max_image_size < 0)) &&
       ExistsFile(input_image_path)) {
     LOG(INFO) << "Undistorted image found; copying to location: "
               << output_image_path;
@@ -267,12 +277,11 @@ bool COLMAPUndistorter::Undistort(const image_t image_id) const {
     return false;
   }
 
-  UndistortImage(options_,
-                 distorted_bitmap,
-                 camera,
-                 &undistorted_bitmap,
-                 &undistorted_camera);
-  return undistorted_bitmap.Write(output_image_path);
+  undistort_cache_.Undistort(
+      distorted_bitmap, camera, &undistorted_bitmap, &undistorted_camera);
+  return undistorted_bitmap.Write(output_image_path,
+                                 options_.jpeg_quality,
+                                 options_.png_compression_level);
 }
 
 void COLMAPUndistorter::WritePatchMatchConfig() const {
@@ -313,7 +322,8 @@ PMVSUndistorter::PMVSUndistorter(const UndistortCameraOptions& options,
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      reconstruction_(reconstruction),
+      undistort_cache_(options) {}
 
 void PMVSUndistorter::Run() {
   Timer run_timer;
@@ -391,14 +401,13 @@ bool PMVSUndistorter::Undistort(const size_t reg_image_idx) const {
 
   Bitmap undistorted_bitmap;
   Camera undistorted_camera;
-  UndistortImage(options_,
-                 distorted_bitmap,
-                 camera,
-                 &undistorted_bitmap,
-                 &undistorted_camera);
+  undistort_cache_.Undistort(
+      distorted_bitmap, camera, &undistorted_bitmap, &undistorted_camera);
 
   WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
-  return undistorted_bitmap.Write(output_image_path);
+  return undistorted_bitmap.Write(output_image_path,
+                                 options_.jpeg_quality,
+                                 options_.png_compression_level);
 }
 
 void PMVSUndistorter::WriteVisibilityData() const {
@@ -552,7 +561,8 @@ CMPMVSUndistorter::CMPMVSUndistorter(const UndistortCameraOptions& options,
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      reconstruction_(reconstruction),
+      undistort_cache_(options) {}
 
 void CMPMVSUndistorter::Run() {
   Timer run_timer;
@@ -600,14 +610,13 @@ bool CMPMVSUndistorter::Undistort(const size_t reg_image_idx) const {
 
   Bitmap undistorted_bitmap;
   Camera undistorted_camera;
-  UndistortImage(options_,
-                 distorted_bitmap,
-                 camera,
-                 &undistorted_bitmap,
-                 &undistorted_camera);
+  undistort_cache_.Undistort(
+      distorted_bitmap, camera, &undistorted_bitmap, &undistorted_camera);
 
   WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
-  return undistorted_bitmap.Write(output_image_path);
+  return undistorted_bitmap.Write(output_image_path,
+                                 options_.jpeg_quality,
+                                 options_.png_compression_level);
 }
 
 PureImageUndistorter::PureImageUndistorter(
@@ -618,7 +627,8 @@ PureImageUndistorter::PureImageUndistorter(
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      image_names_and_cameras_(image_names_and_cameras) {}
+      image_names_and_cameras_(image_names_and_cameras),
+      undistort_cache_(options) {}
 
 void PureImageUndistorter::Run() {
   Timer run_timer;
@@ -665,13 +675,12 @@ bool PureImageUndistorter::Undistort(const size_t image_idx) const {
 
   Bitmap undistorted_bitmap;
   Camera undistorted_camera;
-  UndistortImage(options_,
-                 distorted_bitmap,
-                 camera,
-                 &undistorted_bitmap,
-                 &undistorted_camera);
+  undistort_cache_.Undistort(
+      distorted_bitmap, camera, &undistorted_bitmap, &undistorted_camera);
 
-  return undistorted_bitmap.Write(output_image_path);
+  return undistorted_bitmap.Write(output_image_path,
+                                 options_.jpeg_quality,
+                                 options_.png_compression_level);
 }
 
 StereoImageRectifier::StereoImageRectifier(
@@ -767,8 +776,12 @@ void StereoImageRectifier::Rectify(const image_t image_id1,
                                   &undistorted_camera,
                                   &Q);
 
-  undistorted_bitmap1.Write(output_image1_path);
-  undistorted_bitmap2.Write(output_image2_path);
+  undistorted_bitmap1.Write(output_image1_path,
+                            options_.jpeg_quality,
+                            options_.png_compression_level);
+  undistorted_bitmap2.Write(output_image2_path,
+                            options_.jpeg_quality,
+                            options_.png_compression_level);
 
   const auto Q_path = JoinPaths(output_path_, stereo_pair_name, "Q.txt");
   std::ofstream Q_file(Q_path, std::ios::trunc);
@@ -955,6 +968,101 @@ Camera UndistortCamera(const UndistortCameraOptions& options,
   return undistorted_camera;
 }
 
+UndistortImageCache::UndistortImageCache(
+    const UndistortCameraOptions& options, const size_t max_num_cameras)
+    : options_(options), max_num_cameras_(max_num_cameras) {
+  THROW_CHECK_GT(max_num_cameras, 0);
+}
+
+void UndistortImageCache::Undistort(const Bitmap& distorted_bitmap,
+                                    const Camera& distorted_camera,
+                                    Bitmap* undistorted_bitmap,
+                                    Camera* undistorted_camera) {
+  THROW_CHECK_EQ(distorted_camera.width, distorted_bitmap.Width());
+  THROW_CHECK_EQ(distorted_camera.height, distorted_bitmap.Height());
+  GetWarpTable(distorted_camera,
+               /*given_undistorted_camera=*/nullptr,
+               undistorted_camera)
+      ->Warp(distorted_bitmap, undistorted_bitmap);
+  distorted_bitmap.CloneMetadata(undistorted_bitmap);
+}
+
+void UndistortImageCache::Undistort(const Bitmap& distorted_bitmap,
+                                    const Camera& distorted_camera,
+                                    const Camera& undistorted_camera,
+                                    Bitmap* undistorted_bitmap) {
+  THROW_CHECK_EQ(distorted_camera.width, distorted_bitmap.Width());
+  THROW_CHECK_EQ(distorted_camera.height, distorted_bitmap.Height());
+  Camera entry_undistorted_camera;
+  GetWarpTable(
+      distorted_camera, &undistorted_camera, &entry_undistorted_camera)
+      ->Warp(distorted_bitmap, undistorted_bitmap);
+  distorted_bitmap.CloneMetadata(undistorted_bitmap);
+}
+
+std::shared_ptr<const CameraWarpTable> UndistortImageCache::GetWarpTable(
+    const Camera& distorted_camera,
+    const Camera* given_undistorted_camera,
+    Camera* undistorted_camera) {
+  auto CamerasEqual = [](const Camera& camera1, const Camera& camera2) {
+    return camera1.model_id == camera2.model_id &&
+           camera1.width == camera2.width &&
+           camera1.height == camera2.height && camera1.params == camera2.params;
+  };
+
+  std::shared_future<std::shared_ptr<const CameraWarpTable>> warp_table;
+  std::promise<std::shared_ptr<const CameraWarpTable>> warp_table_promise;
+  bool compute_warp_table = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(
+        entries_.begin(), entries_.end(), [&](const Entry& entry) {
+          if (!CamerasEqual(entry.distorted_camera, distorted_camera)) {
+            return false;
+          }
+          if (given_undistorted_camera == nullptr) {
+            return !entry.given_undistorted_camera;
+          }
+          return entry.given_undistorted_camera &&
+                 CamerasEqual(entry.undistorted_camera,
+                              *given_undistorted_camera);
+        });
+    if (it == entries_.end()) {
+      Entry entry;
+      entry.distorted_camera = distorted_camera;
+      if (given_undistorted_camera == nullptr) {
+        entry.undistorted_camera = UndistortCamera(options_, distorted_camera);
+      } else {
+        entry.undistorted_camera = *given_undistorted_camera;
+        entry.given_undistorted_camera = true;
+      }
+      entry.warp_table = warp_table_promise.get_future().share();
+      entries_.push_front(std::move(entry));
+      if (entries_.size() > max_num_cameras_) {
+        entries_.pop_back();
+      }
+      compute_warp_table = true;
+    } else {
+      entries_.splice(entries_.begin(), entries_, it);
+    }
+    *undistorted_camera = entries_.front().undistorted_camera;
+    warp_table = entries_.front().warp_table;
+  }
+
+  // The warp table is computed outside the lock, such that images of other
+  // cameras are not blocked, while images of the same camera wait for it.
+  if (compute_warp_table) {
+    try {
+      warp_table_promise.set_value(std::make_shared<const CameraWarpTable>(
+          distorted_camera, *undistorted_camera));
+    } catch (...) {
+      warp_table_promise.set_exception(std::current_exception());
+    }
+  }
+
+  return warp_table.get();
+}
+
 void UndistortImage(const UndistortCameraOptions& options,
                     const Bitmap& distorted_bitmap,
                     const Camera& distorted_camera,
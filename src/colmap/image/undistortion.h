@@ -35,8 +35,15 @@
 #include "colmap/util/base_controller.h"
 #include "colmap/util/misc.h"
 
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+
 namespace colmap {
 
+class CameraWarpTable;
+
 struct UndistortCameraOptions {
   // The amount of blank pixels in the undistorted image in the range [0, 1].
   double blank_pixels = 0.0;
@@ -57,10 +64,69 @@ struct UndistortCameraOptions {
   double roi_min_y = 0.0;
   double roi_max_x = 1.0;
   double roi_max_y = 1.0;
+
+  // The JPEG quality in the range [1, 100] and the PNG compression level in
+  // the range [0, 9] of the written undistorted images. By default, the
+  // images are written at superb JPEG quality and default PNG compression,
+  // whose encoding can dominate the run-time of the undistortion.
+  int jpeg_quality = -1;
+  int png_compression_level = -1;
 };
 
+// Thread-safe cache of the undistorted cameras and the warp tables of
+// distorted cameras, such that the camera models are evaluated only once for
+// all images of a camera. The least recently used cameras are evicted.
+class UndistortImageCache {
+ public:
+  explicit UndistortImageCache(const UndistortCameraOptions& options,
+                               size_t max_num_cameras = 4);
+
+  // Same as UndistortImage up to the rounding of the warp table.
+  void Undistort(const Bitmap& distorted_image,
+                 const Camera& distorted_camera,
+                 Bitmap* undistorted_image,
+                 Camera* undistorted_camera);
+
+  // Warp the distorted image to the given undistorted camera, which was
+  // computed ahead of time, e.g., by UndistortReconstruction.
+  void Undistort(const Bitmap& distorted_image,
+                 const Camera& distorted_camera,
+                 const Camera& undistorted_camera,
+                 Bitmap* undistorted_image);
+
+ private:
+  // Returns the warp table of the distorted camera. If no undistorted camera
+  // is given, it is computed from the options and returned in the entry.
+  std::shared_ptr<const CameraWarpTable> GetWarpTable(
+      const Camera& distorted_camera,
+      const Camera* given_undistorted_camera,
+      Camera* undistorted_camera);
+
+  struct Entry {
+    Camera distorted_camera;
+    Camera undistorted_camera;
+    // Whether the undistorted camera was given instead of computed.
+    bool given_undistorted_camera = false;
+    // Only computed once by the first image of the camera.
+    std::shared_future<std::shared_ptr<const CameraWarpTable>> warp_table;
+  };
+
+  const UndistortCameraOptions options_;
+  const size_t max_num_cameras_;
+  std::mutex mutex_;
+  std::list<Entry> entries_;
+};
+
+// Name of the file in the sparse folder of a workspace that stores the
+// cameras of the distorted images, see COLMAPUndistorter.
+constexpr char kDistortedCamerasFileName[] = "distorted_cameras.bin";
+
 // Undistort images and export undistorted cameras, as required by the
 // mvs::PatchMatchController class.
+// If the distorted images are kept, the original images are copied or linked
+// into the workspace together with their distorted cameras, and are only
+// undistorted when read by mvs::Workspace, which avoids writing and reading
+// back a second set of images.
 class COLMAPUndistorter : public BaseController {
  public:
   COLMAPUndistorter(
@@ -70,7 +136,8 @@ class COLMAPUndistorter : public BaseController {
       const std::string& output_path,
       int num_related_images = 20,
       CopyType copy_type = CopyType::COPY,
-      const std::vector<image_t>& image_ids = std::vector<image_t>());
+      const std::vector<image_t>& image_ids = std::vector<image_t>(),
+      bool keep_distorted_images = false);
 
   void Run();
 
@@ -87,7 +154,9 @@ class COLMAPUndistorter : public BaseController {
   const int num_patch_match_src_images_;
   const Reconstruction& reconstruction_;
   const std::vector<image_t> image_ids_;
+  const bool keep_distorted_images_;
   std::vector<std::string> image_names_;
+  mutable UndistortImageCache undistort_cache_;
 };
 
 // Undistort images and prepare data for CMVS/PMVS.
@@ -113,6 +182,7 @@ class PMVSUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  mutable UndistortImageCache undistort_cache_;
 };
 
 // Undistort images and prepare data for CMP-MVS.
@@ -132,6 +202,7 @@ class CMPMVSUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  mutable UndistortImageCache undistort_cache_;
 };
 
 // Undistort images and export undistorted cameras without the need for a
@@ -154,6 +225,7 @@ class PureImageUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const std::vector<std::pair<std::string, Camera>>& image_names_and_cameras_;
+  mutable UndistortImageCache undistort_cache_;
 };
 
 // Rectify stereo image pairs.
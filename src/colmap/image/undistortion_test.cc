@@ -144,6 +144,103 @@ TEST(UndistortCamera, BlankPixels) {
   EXPECT_GT(num_blank_pixels, 0);
 }
 
+TEST(UndistortImageCache, Nominal) {
+  UndistortCameraOptions options;
+  options.blank_pixels = 1;
+
+  Camera distorted_camera =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 100, 100, 100);
+  distorted_camera.params[3] = 0.5;
+
+  Bitmap distorted_image;
+  distorted_image.Allocate(100, 100, false);
+  distorted_image.Fill(BitmapColor<uint8_t>(255));
+
+  Bitmap undistorted_image;
+  Camera undistorted_camera;
+  UndistortImage(options,
+                 distorted_image,
+                 distorted_camera,
+                 &undistorted_image,
+                 &undistorted_camera);
+
+  UndistortImageCache cache(options, /*max_num_cameras=*/1);
+  Camera other_camera = distorted_camera;
+  other_camera.params[3] = 0;
+  for (const Camera& camera : {distorted_camera, other_camera, distorted_camera,
+                               distorted_camera}) {
+    Bitmap cached_undistorted_image;
+    Camera cached_undistorted_camera;
+    cache.Undistort(distorted_image,
+                    camera,
+                    &cached_undistorted_image,
+                    &cached_undistorted_camera);
+    EXPECT_EQ(cached_undistorted_camera.ModelName(), "PINHOLE");
+    if (camera.params != distorted_camera.params) {
+      continue;
+    }
+    EXPECT_EQ(cached_undistorted_camera.params, undistorted_camera.params);
+    ASSERT_EQ(cached_undistorted_image.Width(), undistorted_image.Width());
+    ASSERT_EQ(cached_undistorted_image.Height(), undistorted_image.Height());
+    // Pixels at the border of the blank region can differ due to the rounding
+    // of the fixed point coordinates of the warp table.
+    int num_different_pixels = 0;
+    for (int y = 1; y < undistorted_image.Height() - 1; ++y) {
+      for (int x = 1; x < undistorted_image.Width() - 1; ++x) {
+        BitmapColor<uint8_t> color;
+        BitmapColor<uint8_t> cached_color;
+        EXPECT_TRUE(undistorted_image.GetPixel(x, y, &color));
+        EXPECT_TRUE(cached_undistorted_image.GetPixel(x, y, &cached_color));
+        if (std::abs(color.r - cached_color.r) > 1) {
+          num_different_pixels += 1;
+        }
+      }
+    }
+    EXPECT_LE(num_different_pixels, 5);
+  }
+}
+
+TEST(UndistortImageCache, GivenUndistortedCamera) {
+  UndistortCameraOptions options;
+  options.blank_pixels = 1;
+
+  Camera distorted_camera =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 100, 100, 100);
+  distorted_camera.params[3] = 0.5;
+
+  Bitmap distorted_image;
+  distorted_image.Allocate(100, 100, false);
+  distorted_image.Fill(BitmapColor<uint8_t>(255));
+
+  UndistortImageCache cache(options);
+  Bitmap undistorted_image;
+  Camera undistorted_camera;
+  cache.Undistort(distorted_image,
+                  distorted_camera,
+                  &undistorted_image,
+                  &undistorted_camera);
+
+  // A given undistorted camera does not reuse the warp table of the options.
+  Camera given_undistorted_camera = undistorted_camera;
+  given_undistorted_camera.Rescale(0.5);
+  Bitmap given_undistorted_image;
+  cache.Undistort(distorted_image,
+                  distorted_camera,
+                  given_undistorted_camera,
+                  &given_undistorted_image);
+  EXPECT_EQ(given_undistorted_image.Width(), given_undistorted_camera.width);
+  EXPECT_EQ(given_undistorted_image.Height(), given_undistorted_camera.height);
+
+  cache.Undistort(distorted_image,
+                  distorted_camera,
+                  undistorted_camera,
+                  &given_undistorted_image);
+  ASSERT_EQ(given_undistorted_image.Width(), undistorted_image.Width());
+  ASSERT_EQ(given_undistorted_image.Height(), undistorted_image.Height());
+  EXPECT_EQ(given_undistorted_image.ConvertToRowMajorArray(),
+            undistorted_image.ConvertToRowMajorArray());
+}
+
 TEST(UndistortCamera, NoBlankPixels) {
   UndistortCameraOptions options;
   options.blank_pixels = 0;
@@ -34,6 +34,8 @@
 
 #include "thirdparty/VLFeat/imopv.h"
 
+#include <vector>
+
 #include <Eigen/Geometry>
 
 namespace colmap {
@@ -73,24 +75,34 @@ void WarpImageBetweenCameras(const Camera& source_camera,
     scaled_target_camera.Rescale(source_camera.width, source_camera.height);
   }
 
-  Eigen::Vector2d image_point;
+  // Project the pixels row by row, so that the camera models are dispatched
+  // once per row instead of once per pixel.
+  const size_t width = static_cast<size_t>(target_image->Width());
+  std::vector<Eigen::Vector2d> image_points(width);
+  std::vector<Eigen::Vector3d> cam_rays(width);
+  std::vector<Eigen::Vector2d> source_points(width);
+  std::vector<BitmapColor<float>> colors(width);
+  std::vector<char> mask(width);
   for (int y = 0; y < target_image->Height(); ++y) {
-    image_point.y() = y + 0.5;
-    for (int x = 0; x < target_image->Width(); ++x) {
-      image_point.x() = x + 0.5;
+    // Camera models assume that the upper left pixel center is (0.5, 0.5).
+    for (size_t x = 0; x < width; ++x) {
+      image_points[x] = Eigen::Vector2d(x + 0.5, y + 0.5);
+    }
+    scaled_target_camera.CamFromImg({image_points.data(), width},
+                                    {cam_rays.data(), width});
+    source_camera.ImgFromCam({cam_rays.data(), width},
+                             {source_points.data(), width});
 
-      // Camera models assume that the upper left pixel center is (0.5, 0.5).
-      const Eigen::Vector2d cam_point =
-          scaled_target_camera.CamFromImg(image_point);
-      const Eigen::Vector2d source_point = source_camera.ImgFromCam(cam_point);
+    for (Eigen::Vector2d& source_point : source_points) {
+      source_point.array() -= 0.5;
+    }
+    // The colors of points outside of the source image are zero.
+    source_image.InterpolateBilinear({source_points.data(), width},
+                                     {colors.data(), width},
+                                     {mask.data(), width});
 
-      BitmapColor<float> color;
-      if (source_image.InterpolateBilinear(
-              source_point.x() - 0.5, source_point.y() - 0.5, &color)) {
-        target_image->SetPixel(x, y, color.Cast<uint8_t>());
-      } else {
-        target_image->SetPixel(x, y, BitmapColor<uint8_t>(0));
-      }
+    for (int x = 0; x < target_image->Width(); ++x) {
+      target_image->SetPixel(x, y, colors[x].Cast<uint8_t>());
     }
   }
 
@@ -100,6 +112,127 @@ void WarpImageBetweenCameras(const Camera& source_camera,
   }
 }
 
+CameraWarpTable::CameraWarpTable(const Camera& source_camera,
+                                 const Camera& target_camera)
+    : source_width_(static_cast<int>(source_camera.width)),
+      source_height_(static_cast<int>(source_camera.height)),
+      target_width_(static_cast<int>(target_camera.width)),
+      target_height_(static_cast<int>(target_camera.height)) {
+  // To avoid aliasing, perform the warping in the source resolution and
+  // then rescale the image at the end.
+  Camera scaled_target_camera = target_camera;
+  if (target_camera.width != source_camera.width ||
+      target_camera.height != source_camera.height) {
+    scaled_target_camera.Rescale(source_camera.width, source_camera.height);
+  }
+
+  const double kScale = 1 << kNumFractionalBits;
+
+  source_coords_.resize(static_cast<size_t>(source_width_) * source_height_);
+  const size_t width = static_cast<size_t>(source_width_);
+  std::vector<Eigen::Vector2d> image_points(width);
+  std::vector<Eigen::Vector3d> cam_rays(width);
+  std::vector<Eigen::Vector2d> source_points(width);
+  for (int y = 0; y < source_height_; ++y) {
+    // Camera models assume that the upper left pixel center is (0.5, 0.5).
+    for (size_t x = 0; x < width; ++x) {
+      image_points[x] = Eigen::Vector2d(x + 0.5, y + 0.5);
+    }
+    scaled_target_camera.CamFromImg({image_points.data(), width},
+                                    {cam_rays.data(), width});
+    source_camera.ImgFromCam({cam_rays.data(), width},
+                             {source_points.data(), width});
+
+    for (int x = 0; x < source_width_; ++x) {
+      const Eigen::Vector2d source_point =
+          source_points[x] - Eigen::Vector2d(0.5, 0.5);
+
+      SourceCoord& source_coord = source_coords_[y * source_width_ + x];
+      source_coord.x = -1;
+      source_coord.y = -1;
+      // The bilinear interpolation requires the right and bottom neighbors.
+      if (source_point.x() >= 0 && source_point.x() < source_width_ - 1 &&
+          source_point.y() >= 0 && source_point.y() < source_height_ - 1) {
+        const int32_t source_x = std::lround(kScale * source_point.x());
+        const int32_t source_y = std::lround(kScale * source_point.y());
+        if ((source_x >> kNumFractionalBits) + 1 < source_width_ &&
+            (source_y >> kNumFractionalBits) + 1 < source_height_) {
+          source_coord.x = source_x;
+          source_coord.y = source_y;
+        }
+      }
+    }
+  }
+}
+
+void CameraWarpTable::Warp(const Bitmap& source_image,
+                           Bitmap* target_image) const {
+  THROW_CHECK_EQ(source_width_, source_image.Width());
+  THROW_CHECK_EQ(source_height_, source_image.Height());
+  THROW_CHECK_NOTNULL(target_image);
+
+  target_image->Allocate(source_width_, source_height_, source_image.IsRGB());
+
+  if (source_image.IsRGB()) {
+    WarpScanlines<3>(source_image, target_image);
+  } else {
+    WarpScanlines<1>(source_image, target_image);
+  }
+
+  if (target_width_ != source_width_ || target_height_ != source_height_) {
+    target_image->Rescale(target_width_, target_height_);
+  }
+}
+
+size_t CameraWarpTable::NumBytes() const {
+  return source_coords_.size() * sizeof(SourceCoord);
+}
+
+template <int kNumChannels>
+void CameraWarpTable::WarpScanlines(const Bitmap& source_image,
+                                    Bitmap* target_image) const {
+  constexpr int32_t kFractionalMask = (1 << kNumFractionalBits) - 1;
+  constexpr int32_t kRounding = 1 << (2 * kNumFractionalBits - 1);
+
+  std::vector<const uint8_t*> source_scanlines(source_height_);
+  for (int y = 0; y < source_height_; ++y) {
+    source_scanlines[y] = source_image.GetScanline(y);
+  }
+
+  for (int y = 0; y < source_height_; ++y) {
+    uint8_t* target_pixel = target_image->GetScanline(y);
+    const SourceCoord* source_coord = &source_coords_[y * source_width_];
+    for (int x = 0; x < source_width_;
+         ++x, ++source_coord, target_pixel += kNumChannels) {
+      if (source_coord->x < 0) {
+        for (int c = 0; c < kNumChannels; ++c) {
+          target_pixel[c] = 0;
+        }
+        continue;
+      }
+
+      const int32_t x0 = source_coord->x >> kNumFractionalBits;
+      const int32_t y0 = source_coord->y >> kNumFractionalBits;
+      const int32_t dx = source_coord->x & kFractionalMask;
+      const int32_t dy = source_coord->y & kFractionalMask;
+
+      const uint8_t* p00 = source_scanlines[y0] + kNumChannels * x0;
+      const uint8_t* p10 = source_scanlines[y0 + 1] + kNumChannels * x0;
+      for (int c = 0; c < kNumChannels; ++c) {
+        // Column-wise linear interpolation of the top and bottom row.
+        const int32_t v0 = (p00[c] << kNumFractionalBits) +
+                           dx * (p00[c + kNumChannels] - p00[c]);
+        const int32_t v1 = (p10[c] << kNumFractionalBits) +
+                           dx * (p10[c + kNumChannels] - p10[c]);
+        // Row-wise linear interpolation.
+        target_pixel[c] = static_cast<uint8_t>(
+            ((v0 << kNumFractionalBits) + dy * (v1 - v0) + kRounding) >>
+            (2 * kNumFractionalBits));
+      }
+    }
+  }
+}
+
 void WarpImageWithHomography(const Eigen::Matrix3d& H,
                              const Bitmap& source_image,
                              Bitmap* target_image) {
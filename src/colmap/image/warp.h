@@ -32,6 +32,8 @@
 #include "colmap/scene/camera.h"
 #include "colmap/sensor/bitmap.h"
 
+#include <vector>
+
 namespace colmap {
 
 // Warp source image to target image by projecting the pixels of the target
@@ -42,6 +44,41 @@ void WarpImageBetweenCameras(const Camera& source_camera,
                              const Bitmap& source_image,
                              Bitmap* target_image);
 
+// Precomputed inverse mapping of WarpImageBetweenCameras, which warps many
+// images between the same cameras without evaluating the camera models. The
+// source coordinates of every target pixel are stored in fixed point, such
+// that the warped intensities differ from WarpImageBetweenCameras by at most
+// one due to rounding.
+class CameraWarpTable {
+ public:
+  CameraWarpTable(const Camera& source_camera, const Camera& target_camera);
+
+  // Same as WarpImageBetweenCameras for the cameras of the table.
+  void Warp(const Bitmap& source_image, Bitmap* target_image) const;
+
+  size_t NumBytes() const;
+
+ private:
+  // Number of fractional bits of the fixed point source coordinates.
+  static constexpr int kNumFractionalBits = 8;
+
+  template <int kNumChannels>
+  void WarpScanlines(const Bitmap& source_image, Bitmap* target_image) const;
+
+  // Fixed point source coordinates of the target pixels in row-major order,
+  // where negative coordinates mark pixels without a source pixel.
+  struct SourceCoord {
+    int32_t x;
+    int32_t y;
+  };
+
+  int source_width_;
+  int source_height_;
+  int target_width_;
+  int target_height_;
+  std::vector<SourceCoord> source_coords_;
+};
+
 // Warp an image with the given homography, where H defines the pixel mapping
 // from the target to source image. Note that the pixel centers are assumed to
 // have coordinates (0.5, 0.5).
@@ -131,6 +131,45 @@ TEST(Warp, ShiftedCameras) {
   }
 }
 
+TEST(CameraWarpTable, Nominal) {
+  Camera source_camera =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 100, 100, 80);
+  source_camera.params[3] = 0.1;
+  const Camera target_camera =
+      Camera::CreateFromModelName(1, "PINHOLE", 90, 100, 80);
+  const CameraWarpTable warp_table(source_camera, target_camera);
+  EXPECT_EQ(warp_table.NumBytes(), 100 * 80 * 2 * sizeof(int32_t));
+  for (const bool as_rgb : {false, true}) {
+    Bitmap source_image;
+    GenerateRandomBitmap(100, 80, as_rgb, &source_image);
+    Bitmap target_image;
+    WarpImageBetweenCameras(
+        source_camera, target_camera, source_image, &target_image);
+    Bitmap table_target_image;
+    warp_table.Warp(source_image, &table_target_image);
+    ASSERT_EQ(table_target_image.IsRGB(), as_rgb);
+    ASSERT_EQ(table_target_image.Width(), target_image.Width());
+    ASSERT_EQ(table_target_image.Height(), target_image.Height());
+    // Pixels at the border of the valid source region can differ due to the
+    // rounding of the fixed point coordinates.
+    int num_different_pixels = 0;
+    for (int y = 1; y < target_image.Height() - 1; ++y) {
+      for (int x = 1; x < target_image.Width() - 1; ++x) {
+        BitmapColor<uint8_t> color;
+        BitmapColor<uint8_t> table_color;
+        EXPECT_TRUE(target_image.GetPixel(x, y, &color));
+        EXPECT_TRUE(table_target_image.GetPixel(x, y, &table_color));
+        if (std::abs(color.r - table_color.r) > 1 ||
+            std::abs(color.g - table_color.g) > 1 ||
+            std::abs(color.b - table_color.b) > 1) {
+          num_different_pixels += 1;
+        }
+      }
+    }
+    EXPECT_LE(num_different_pixels, 5);
+  }
+}
+
 TEST(Warp, WarpImageWithHomographyIdentity) {
   Bitmap source_image_gray;
   GenerateRandomBitmap(100, 100, false, &source_image_gray);
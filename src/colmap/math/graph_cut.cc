@@ -29,6 +29,15 @@
 
 #include "colmap/math/graph_cut.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <random>
 #include <unordered_map>
 
 #include <boost/graph/stoer_wagner_min_cut.hpp>
@@ -47,6 +56,7 @@ extern "C" {
 #endif
 
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
 namespace colmap {
 namespace {
@@ -129,6 +139,434 @@ class MetisGraph {
   std::vector<idx_t> adjwgt_;
 };
 
+// Weighted, undirected graph in compressed sparse row format for the
+// multilevel partitioning.
+struct CsrGraph {
+  std::vector<int> offsets;
+  std::vector<int> neighbors;
+  std::vector<int64_t> edge_weights;
+  std::vector<int64_t> vertex_weights;
+
+  int NumVertices() const { return static_cast<int>(vertex_weights.size()); }
+};
+
+// Minimum number of vertices per chunk of the parallel loops.
+constexpr size_t kMinNumVerticesPerChunk = 1024;
+
+// Coarsening stops, once the graph has less vertices than this number times
+// the number of parts or if it does not shrink sufficiently anymore.
+constexpr int kCoarsestNumVerticesPerPart = 20;
+constexpr double kMinCoarseningRatio = 0.95;
+
+// Maximum ratio of the weight of a part to the average weight of all parts.
+constexpr double kMaxPartImbalance = 1.03;
+
+// Maximum number of refinement passes per level. The refinement of a level
+// stops early, once only a small fraction of the vertices is moved in a pass.
+constexpr int kNumRefinementPasses = 8;
+constexpr double kMinRefinementMoveRatio = 0.005;
+
+// Contracts the graph by matching every vertex with its unmatched neighbor of
+// largest edge weight, as long as the combined vertex weight is bounded.
+// Returns the coarse graph and the coarse vertex of every fine vertex.
+CsrGraph CoarsenGraph(const CsrGraph& graph,
+                      const int64_t max_vertex_weight,
+                      std::mt19937* prng,
+                      ThreadPool* thread_pool,
+                      std::vector<int>* fine_to_coarse) {
+  const int num_vertices = graph.NumVertices();
+
+  std::vector<int> visit_order(num_vertices);
+  std::iota(visit_order.begin(), visit_order.end(), 0);
+  std::shuffle(visit_order.begin(), visit_order.end(), *prng);
+
+  std::vector<int> matches(num_vertices, -1);
+  for (const int vertex : visit_order) {
+    if (matches[vertex] != -1) {
+      continue;
+    }
+    int best_neighbor = vertex;
+    int64_t best_edge_weight = 0;
+    for (int i = graph.offsets[vertex]; i < graph.offsets[vertex + 1]; ++i) {
+      const int neighbor = graph.neighbors[i];
+      if (matches[neighbor] == -1 && graph.edge_weights[i] > best_edge_weight &&
+          graph.vertex_weights[vertex] + graph.vertex_weights[neighbor] <=
+              max_vertex_weight) {
+        best_neighbor = neighbor;
+        best_edge_weight = graph.edge_weights[i];
+      }
+    }
+    matches[vertex] = best_neighbor;
+    matches[best_neighbor] = vertex;
+  }
+
+  fine_to_coarse->resize(num_vertices);
+  std::vector<std::pair<int, int>> coarse_to_fine;
+  coarse_to_fine.reserve(num_vertices);
+  for (int vertex = 0; vertex < num_vertices; ++vertex) {
+    if (vertex <= matches[vertex]) {
+      (*fine_to_coarse)[vertex] = coarse_to_fine.size();
+      (*fine_to_coarse)[matches[vertex]] = coarse_to_fine.size();
+      coarse_to_fine.emplace_back(vertex, matches[vertex]);
+    }
+  }
+
+  // The adjacency of every coarse vertex is first merged into the range of
+  // the concatenated fine adjacencies and then compacted.
+  const int num_coarse_vertices = coarse_to_fine.size();
+  std::vector<int> fine_offsets(num_coarse_vertices + 1, 0);
+  for (int coarse_vertex = 0; coarse_vertex < num_coarse_vertices;
+       ++coarse_vertex) {
+    const auto [vertex1, vertex2] = coarse_to_fine[coarse_vertex];
+    int degree = graph.offsets[vertex1 + 1] - graph.offsets[vertex1];
+    if (vertex1 != vertex2) {
+      degree += graph.offsets[vertex2 + 1] - graph.offsets[vertex2];
+    }
+    fine_offsets[coarse_vertex + 1] = fine_offsets[coarse_vertex] + degree;
+  }
+
+  CsrGraph coarse_graph;
+  coarse_graph.vertex_weights.resize(num_coarse_vertices);
+  std::vector<int> merged_neighbors(fine_offsets.back());
+  std::vector<int64_t> merged_edge_weights(fine_offsets.back());
+  std::vector<int> num_merged_neighbors(num_coarse_vertices);
+  ParallelForChunks(
+      thread_pool,
+      num_coarse_vertices,
+      kMinNumVerticesPerChunk,
+      [&](const size_t begin, const size_t end) {
+        // Hash table from the coarse neighbors to their merged position.
+        std::vector<int> table;
+        for (size_t coarse_vertex = begin; coarse_vertex < end;
+             ++coarse_vertex) {
+          const auto [vertex1, vertex2] = coarse_to_fine[coarse_vertex];
+          const int max_num_merged =
+              fine_offsets[coarse_vertex + 1] - fine_offsets[coarse_vertex];
+          size_t table_size = 1;
+          while (table_size < 2 * static_cast<size_t>(max_num_merged)) {
+            table_size *= 2;
+          }
+          table.assign(table_size, -1);
+
+          int num_merged = 0;
+          int* neighbors =
+              merged_neighbors.data() + fine_offsets[coarse_vertex];
+          int64_t* edge_weights =
+              merged_edge_weights.data() + fine_offsets[coarse_vertex];
+          for (const int vertex : {vertex1, vertex2}) {
+            for (int i = graph.offsets[vertex]; i < graph.offsets[vertex + 1];
+                 ++i) {
+              const int coarse_neighbor =
+                  (*fine_to_coarse)[graph.neighbors[i]];
+              if (coarse_neighbor == static_cast<int>(coarse_vertex)) {
+                continue;
+              }
+              // Merge the parallel edges using linear probing.
+              size_t slot = (static_cast<size_t>(coarse_neighbor) *
+                             2654435761u) & (table_size - 1);
+              while (table[slot] != -1 &&
+                     neighbors[table[slot]] != coarse_neighbor) {
+                slot = (slot + 1) & (table_size - 1);
+              }
+              if (table[slot] == -1) {
+                table[slot] = num_merged;
+                neighbors[num_merged] = coarse_neighbor;
+                edge_weights[num_merged] = 0;
+                ++num_merged;
+              }
+              edge_weights[table[slot]] += graph.edge_weights[i];
+            }
+            if (vertex1 == vertex2) {
+              break;
+            }
+          }
+          num_merged_neighbors[coarse_vertex] = num_merged;
+
+          coarse_graph.vertex_weights[coarse_vertex] =
+              graph.vertex_weights[vertex1] +
+              (vertex1 == vertex2 ? 0 : graph.vertex_weights[vertex2]);
+        }
+      });
+
+  coarse_graph.offsets.resize(num_coarse_vertices + 1, 0);
+  for (int coarse_vertex = 0; coarse_vertex < num_coarse_vertices;
+       ++coarse_vertex) {
+    coarse_graph.offsets[coarse_vertex + 1] =
+        coarse_graph.offsets[coarse_vertex] +
+        num_merged_neighbors[coarse_vertex];
+  }
+  coarse_graph.neighbors.resize(coarse_graph.offsets.back());
+  coarse_graph.edge_weights.resize(coarse_graph.offsets.back());
+  ParallelForChunks(
+      thread_pool,
+      num_coarse_vertices,
+      kMinNumVerticesPerChunk,
+      [&](const size_t begin, const size_t end) {
+        for (size_t coarse_vertex = begin; coarse_vertex < end;
+             ++coarse_vertex) {
+          std::copy_n(
+              merged_neighbors.begin() + fine_offsets[coarse_vertex],
+              num_merged_neighbors[coarse_vertex],
+              coarse_graph.neighbors.begin() +
+                  coarse_graph.offsets[coarse_vertex]);
+          std::copy_n(
+              merged_edge_weights.begin() + fine_offsets[coarse_vertex],
+              num_merged_neighbors[coarse_vertex],
+              coarse_graph.edge_weights.begin() +
+                  coarse_graph.offsets[coarse_vertex]);
+        }
+      });
+
+  return coarse_graph;
+}
+
+// Number of trials with different seeds per bisection of the initial
+// partition, from which the bisection with the smallest cut is chosen.
+constexpr int kNumInitialBisectionTrials = 4;
+
+// Bisects the given vertices by growing a region from a random seed vertex,
+// where the next vertex is always the one most strongly connected to the
+// region, until the region has the target weight. The vertices of the region
+// are moved to the front. Returns the number of vertices in the region.
+size_t BisectGraph(const CsrGraph& graph,
+                   const int64_t target_weight,
+                   std::mt19937* prng,
+                   std::vector<int>* subset_labels,
+                   std::vector<int64_t>* connectivity,
+                   int* vertices_begin,
+                   int* vertices_end) {
+  const int num_vertices = vertices_end - vertices_begin;
+  const int kRegion = 1;
+  const int kOutside = 0;
+
+  int64_t best_cut_weight = std::numeric_limits<int64_t>::max();
+  std::vector<int> best_region;
+  std::vector<int> region;
+  for (int trial = 0; trial < kNumInitialBisectionTrials; ++trial) {
+    region.clear();
+    for (int* vertex = vertices_begin; vertex != vertices_end; ++vertex) {
+      (*subset_labels)[*vertex] = kOutside;
+      (*connectivity)[*vertex] = 0;
+    }
+
+    std::priority_queue<std::pair<int64_t, int>> queue;
+    std::uniform_int_distribution<int> seed_distribution(0, num_vertices - 1);
+    int64_t region_weight = 0;
+    int64_t cut_weight = 0;
+    int next_seed = seed_distribution(*prng);
+    while (region_weight < target_weight) {
+      // Continue with another seed for disconnected subsets.
+      while (!queue.empty() &&
+             (*subset_labels)[queue.top().second] != kOutside) {
+        queue.pop();
+      }
+      int vertex;
+      if (queue.empty()) {
+        while ((*subset_labels)[vertices_begin[next_seed]] != kOutside) {
+          next_seed = (next_seed + 1) % num_vertices;
+        }
+        vertex = vertices_begin[next_seed];
+      } else {
+        vertex = queue.top().second;
+        queue.pop();
+      }
+
+      (*subset_labels)[vertex] = kRegion;
+      region.push_back(vertex);
+      region_weight += graph.vertex_weights[vertex];
+      for (int i = graph.offsets[vertex]; i < graph.offsets[vertex + 1]; ++i) {
+        const int neighbor = graph.neighbors[i];
+        if ((*subset_labels)[neighbor] == kOutside) {
+          (*connectivity)[neighbor] += graph.edge_weights[i];
+          cut_weight += graph.edge_weights[i];
+          queue.emplace((*connectivity)[neighbor], neighbor);
+        } else if ((*subset_labels)[neighbor] == kRegion) {
+          cut_weight -= graph.edge_weights[i];
+        }
+      }
+    }
+
+    if (cut_weight < best_cut_weight) {
+      best_cut_weight = cut_weight;
+      best_region = region;
+    }
+  }
+
+  for (int* vertex = vertices_begin; vertex != vertices_end; ++vertex) {
+    (*subset_labels)[*vertex] = kOutside;
+  }
+  for (const int vertex : best_region) {
+    (*subset_labels)[vertex] = kRegion;
+  }
+  const int* region_end = std::stable_partition(
+      vertices_begin, vertices_end, [subset_labels](const int vertex) {
+        return (*subset_labels)[vertex] == kRegion;
+      });
+  return region_end - vertices_begin;
+}
+
+// Initial partition of the coarsest graph by recursive bisection.
+std::vector<int> ComputeInitialPartition(const CsrGraph& graph,
+                                         const int num_parts,
+                                         std::mt19937* prng) {
+  const int num_vertices = graph.NumVertices();
+
+  std::vector<int> vertices(num_vertices);
+  std::iota(vertices.begin(), vertices.end(), 0);
+
+  // Vertices outside the currently bisected subset are excluded from the
+  // region growing by a label different from the two labels of the subset.
+  const int kExcluded = -1;
+  std::vector<int> subset_labels(num_vertices, kExcluded);
+  std::vector<int64_t> connectivity(num_vertices, 0);
+
+  std::vector<int> labels(num_vertices, 0);
+  std::function<void(int*, int*, int, int)> RecursiveBisection =
+      [&](int* vertices_begin,
+          int* vertices_end,
+          const int parts_begin,
+          const int num_subset_parts) {
+        if (num_subset_parts == 1 || vertices_end - vertices_begin <= 1) {
+          for (int* vertex = vertices_begin; vertex != vertices_end; ++vertex) {
+            labels[*vertex] = parts_begin;
+          }
+          return;
+        }
+
+        int64_t subset_weight = 0;
+        for (int* vertex = vertices_begin; vertex != vertices_end; ++vertex) {
+          subset_weight += graph.vertex_weights[*vertex];
+        }
+        const int num_parts1 = num_subset_parts / 2;
+        const int64_t target_weight =
+            subset_weight * num_parts1 / num_subset_parts;
+        const size_t num_vertices1 =
+            BisectGraph(graph,
+                        std::max<int64_t>(1, target_weight),
+                        prng,
+                        &subset_labels,
+                        &connectivity,
+                        vertices_begin,
+                        vertices_end);
+        for (int* vertex = vertices_begin; vertex != vertices_end; ++vertex) {
+          subset_labels[*vertex] = kExcluded;
+        }
+
+        RecursiveBisection(vertices_begin,
+                           vertices_begin + num_vertices1,
+                           parts_begin,
+                           num_parts1);
+        RecursiveBisection(vertices_begin + num_vertices1,
+                           vertices_end,
+                           parts_begin + num_parts1,
+                           num_subset_parts - num_parts1);
+      };
+
+  RecursiveBisection(
+      vertices.data(), vertices.data() + num_vertices, 0, num_parts);
+
+  return labels;
+}
+
+// Greedily moves boundary vertices to the neighboring part they are most
+// strongly connected to, as long as this reduces the cut, the target part does
+// not exceed the maximum weight, and the source part does not become empty.
+// The gains are computed in parallel and the moves are then applied in order
+// of decreasing gain. Alternating passes only move vertices to parts with
+// larger or smaller labels, respectively, to prevent neighboring vertices from
+// swapping their parts back and forth.
+void RefinePartition(const CsrGraph& graph,
+                     const int num_parts,
+                     const int64_t max_part_weight,
+                     ThreadPool* thread_pool,
+                     std::vector<int>* labels) {
+  const int num_vertices = graph.NumVertices();
+
+  std::vector<int64_t> part_weights(num_parts, 0);
+  for (int vertex = 0; vertex < num_vertices; ++vertex) {
+    part_weights[(*labels)[vertex]] += graph.vertex_weights[vertex];
+  }
+
+  struct Move {
+    int64_t gain;
+    int vertex;
+    int part;
+  };
+
+  for (int pass = 0; pass < kNumRefinementPasses; ++pass) {
+    int num_moves = 0;
+    for (const bool to_larger_labels : {true, false}) {
+      std::vector<std::optional<Move>> moves(num_vertices);
+      ParallelForChunks(
+          thread_pool,
+          num_vertices,
+          kMinNumVerticesPerChunk,
+          [&](const size_t begin, const size_t end) {
+            std::vector<std::pair<int, int64_t>> connectivity;
+            for (size_t vertex = begin; vertex < end; ++vertex) {
+              const int label = (*labels)[vertex];
+              int64_t internal_weight = 0;
+              connectivity.clear();
+              for (int i = graph.offsets[vertex]; i < graph.offsets[vertex + 1];
+                   ++i) {
+                const int neighbor_label = (*labels)[graph.neighbors[i]];
+                if (neighbor_label == label) {
+                  internal_weight += graph.edge_weights[i];
+                } else if ((neighbor_label > label) == to_larger_labels) {
+                  auto it = std::find_if(
+                      connectivity.begin(),
+                      connectivity.end(),
+                      [neighbor_label](const std::pair<int, int64_t>& part) {
+                        return part.first == neighbor_label;
+                      });
+                  if (it == connectivity.end()) {
+                    connectivity.emplace_back(neighbor_label, 0);
+                    it = std::prev(connectivity.end());
+                  }
+                  it->second += graph.edge_weights[i];
+                }
+              }
+              for (const auto& [part, external_weight] : connectivity) {
+                const int64_t gain = external_weight - internal_weight;
+                if (gain > 0 &&
+                    (!moves[vertex] || gain > moves[vertex]->gain)) {
+                  moves[vertex] = Move{gain, static_cast<int>(vertex), part};
+                }
+              }
+            }
+          });
+
+      std::vector<Move> sorted_moves;
+      for (const auto& move : moves) {
+        if (move) {
+          sorted_moves.push_back(*move);
+        }
+      }
+      std::sort(sorted_moves.begin(),
+                sorted_moves.end(),
+                [](const Move& move1, const Move& move2) {
+                  return move1.gain > move2.gain;
+                });
+      for (const Move& move : sorted_moves) {
+        // Keep the parts balanced and non-empty.
+        const int64_t vertex_weight = graph.vertex_weights[move.vertex];
+        if (part_weights[move.part] + vertex_weight > max_part_weight ||
+            part_weights[(*labels)[move.vertex]] == vertex_weight) {
+          continue;
+        }
+        part_weights[(*labels)[move.vertex]] -= vertex_weight;
+        part_weights[move.part] += vertex_weight;
+        (*labels)[move.vertex] = move.part;
+        num_moves += 1;
+      }
+    }
+
+    if (num_moves <= kMinRefinementMoveRatio * num_vertices) {
+      break;
+    }
+  }
+}
+
 }  // namespace
 
 void ComputeMinGraphCutStoerWagner(
@@ -223,4 +661,149 @@ std::unordered_map<int, int> ComputeNormalizedMinGraphCut(
   return labels;
 }
 
+std::unordered_map<int, int> ComputeMultilevelGraphPartition(
+    const std::vector<std::pair<int, int>>& edges,
+    const std::vector<int>& weights,
+    const int num_parts,
+    const int num_threads) {
+  THROW_CHECK(!edges.empty());
+  THROW_CHECK_EQ(edges.size(), weights.size());
+  THROW_CHECK_GT(num_parts, 0);
+
+  // Image identifiers are typically dense, such that the vertex indices can
+  // be looked up in a vector instead of a hash map.
+  int min_vertex_id = std::numeric_limits<int>::max();
+  int max_vertex_id = std::numeric_limits<int>::min();
+  for (const auto& edge : edges) {
+    min_vertex_id = std::min({min_vertex_id, edge.first, edge.second});
+    max_vertex_id = std::max({max_vertex_id, edge.first, edge.second});
+  }
+  const int64_t vertex_id_range =
+      static_cast<int64_t>(max_vertex_id) - min_vertex_id + 1;
+  std::vector<int> vertex_ids;
+  std::vector<int> vertex_id_to_idx;
+  if (vertex_id_range <= 4 * static_cast<int64_t>(edges.size())) {
+    vertex_id_to_idx.resize(vertex_id_range, -1);
+    for (const auto& edge : edges) {
+      vertex_id_to_idx[edge.first - min_vertex_id] = 0;
+      vertex_id_to_idx[edge.second - min_vertex_id] = 0;
+    }
+    for (int64_t i = 0; i < vertex_id_range; ++i) {
+      if (vertex_id_to_idx[i] != -1) {
+        vertex_id_to_idx[i] = vertex_ids.size();
+        vertex_ids.push_back(min_vertex_id + i);
+      }
+    }
+  } else {
+    vertex_ids.reserve(2 * edges.size());
+    for (const auto& edge : edges) {
+      vertex_ids.push_back(edge.first);
+      vertex_ids.push_back(edge.second);
+    }
+    std::sort(vertex_ids.begin(), vertex_ids.end());
+    vertex_ids.erase(std::unique(vertex_ids.begin(), vertex_ids.end()),
+                     vertex_ids.end());
+  }
+  const int num_vertices = vertex_ids.size();
+  const auto GetVertexIdx = [&](const int vertex_id) {
+    if (!vertex_id_to_idx.empty()) {
+      return vertex_id_to_idx[vertex_id - min_vertex_id];
+    }
+    return static_cast<int>(
+        std::lower_bound(vertex_ids.begin(), vertex_ids.end(), vertex_id) -
+        vertex_ids.begin());
+  };
+
+  // Build the finest graph without self-loops. Parallel edges are merged by
+  // the coarsening.
+  CsrGraph graph;
+  graph.vertex_weights.resize(num_vertices, 1);
+  graph.offsets.resize(num_vertices + 1, 0);
+  std::vector<std::pair<int, int>> edge_idxs(edges.size());
+  for (size_t i = 0; i < edges.size(); ++i) {
+    edge_idxs[i].first = GetVertexIdx(edges[i].first);
+    edge_idxs[i].second = GetVertexIdx(edges[i].second);
+    if (edge_idxs[i].first != edge_idxs[i].second) {
+      graph.offsets[edge_idxs[i].first + 1] += 1;
+      graph.offsets[edge_idxs[i].second + 1] += 1;
+    }
+  }
+  for (int vertex = 0; vertex < num_vertices; ++vertex) {
+    graph.offsets[vertex + 1] += graph.offsets[vertex];
+  }
+  graph.neighbors.resize(graph.offsets.back());
+  graph.edge_weights.resize(graph.offsets.back());
+  std::vector<int> fill_offsets(graph.offsets.begin(), graph.offsets.end() - 1);
+  for (size_t i = 0; i < edges.size(); ++i) {
+    const auto [vertex1, vertex2] = edge_idxs[i];
+    if (vertex1 != vertex2) {
+      graph.neighbors[fill_offsets[vertex1]] = vertex2;
+      graph.edge_weights[fill_offsets[vertex1]++] = weights[i];
+      graph.neighbors[fill_offsets[vertex2]] = vertex1;
+      graph.edge_weights[fill_offsets[vertex2]++] = weights[i];
+    }
+  }
+
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_eff_threads > 1) {
+    thread_pool = std::make_unique<ThreadPool>(num_eff_threads);
+  }
+
+  const int64_t total_weight = num_vertices;
+  const int64_t max_part_weight = std::max<int64_t>(
+      1, std::ceil(kMaxPartImbalance * total_weight / num_parts));
+
+  // Coarsen the graph until it is small enough for the initial partition.
+  // The weight of the coarse vertices is bounded for a balanced partition.
+  const int max_num_coarsest_vertices = kCoarsestNumVerticesPerPart * num_parts;
+  const int64_t max_vertex_weight =
+      std::max<int64_t>(1, total_weight / max_num_coarsest_vertices);
+  std::mt19937 prng(0);
+  std::vector<CsrGraph> graphs;
+  std::vector<std::vector<int>> fine_to_coarse;
+  graphs.push_back(std::move(graph));
+  while (graphs.back().NumVertices() > max_num_coarsest_vertices) {
+    std::vector<int> level_fine_to_coarse;
+    CsrGraph coarse_graph = CoarsenGraph(graphs.back(),
+                                         max_vertex_weight,
+                                         &prng,
+                                         thread_pool.get(),
+                                         &level_fine_to_coarse);
+    const bool is_converged =
+        coarse_graph.NumVertices() >
+        kMinCoarseningRatio * graphs.back().NumVertices();
+    graphs.push_back(std::move(coarse_graph));
+    fine_to_coarse.push_back(std::move(level_fine_to_coarse));
+    if (is_converged) {
+      break;
+    }
+  }
+
+  // Partition the coarsest graph and refine the partition on every level
+  // while projecting it back to the finest graph.
+  std::vector<int> labels =
+      ComputeInitialPartition(graphs.back(), num_parts, &prng);
+  RefinePartition(
+      graphs.back(), num_parts, max_part_weight, thread_pool.get(), &labels);
+  for (int level = static_cast<int>(graphs.size()) - 2; level >= 0; --level) {
+    const std::vector<int>& level_fine_to_coarse = fine_to_coarse[level];
+    std::vector<int> fine_labels(graphs[level].NumVertices());
+    for (size_t vertex = 0; vertex < fine_labels.size(); ++vertex) {
+      fine_labels[vertex] = labels[level_fine_to_coarse[vertex]];
+    }
+    labels = std::move(fine_labels);
+    RefinePartition(
+        graphs[level], num_parts, max_part_weight, thread_pool.get(), &labels);
+  }
+
+  std::unordered_map<int, int> vertex_labels;
+  vertex_labels.reserve(num_vertices);
+  for (int vertex = 0; vertex < num_vertices; ++vertex) {
+    vertex_labels.emplace(vertex_ids[vertex], labels[vertex]);
+  }
+
+  return vertex_labels;
+}
+
 }  // namespace colmap
@@ -55,6 +55,19 @@ std::unordered_map<int, int> ComputeNormalizedMinGraphCut(
     const std::vector<int>& weights,
     int num_parts);
 
+// Partition an undirected graph into the given number of parts with a
+// balanced number of vertices using a multilevel scheme similar to Metis: The
+// graph is coarsened by heavy-edge matching, the coarsest graph is partitioned
+// in breadth-first order, and the partition is projected back and greedily
+// refined on every level. Coarsening and refinement run in parallel, which is
+// much faster than recursive normalized cuts for large graphs. Returns the
+// part label per vertex.
+std::unordered_map<int, int> ComputeMultilevelGraphPartition(
+    const std::vector<std::pair<int, int>>& edges,
+    const std::vector<int>& weights,
+    int num_parts,
+    int num_threads = -1);
+
 // Compute the minimum graph cut of a directed S-T graph using the
 // Boykov-Kolmogorov max-flow min-cut algorithm, as descibed in:
 //   "An Experimental Comparison of Min-Cut/Max-Flow Algorithms for Energy
@@ -238,6 +238,63 @@ TEST(GraphCut, ComputeNormalizedMinGraphCutDisconnected) {
   EXPECT_EQ(cut_labels.at(3), cut_labels.at(4));
 }
 
+TEST(GraphCut, ComputeMultilevelGraphPartitionDisconnected) {
+  const std::vector<std::pair<int, int>> edges = {{0, 1}, {1, 2}, {3, 4}};
+  const std::vector<int> weights = {1, 3, 1};
+  const auto labels = ComputeMultilevelGraphPartition(edges, weights, 2);
+  EXPECT_EQ(labels.size(), 5);
+  EXPECT_EQ(labels.at(0), labels.at(1));
+  EXPECT_EQ(labels.at(1), labels.at(2));
+  EXPECT_NE(labels.at(2), labels.at(3));
+  EXPECT_EQ(labels.at(3), labels.at(4));
+}
+
+TEST(GraphCut, ComputeMultilevelGraphPartitionGrid) {
+  // Four dense blocks of a grid graph, which are weakly connected.
+  const int kGridSize = 40;
+  const int kBlockSize = kGridSize / 2;
+  std::vector<std::pair<int, int>> edges;
+  std::vector<int> weights;
+  for (int y = 0; y < kGridSize; ++y) {
+    for (int x = 0; x < kGridSize; ++x) {
+      const int vertex = y * kGridSize + x;
+      if (x + 1 < kGridSize) {
+        edges.emplace_back(vertex, vertex + 1);
+        weights.push_back((x + 1) % kBlockSize == 0 ? 1 : 10);
+      }
+      if (y + 1 < kGridSize) {
+        edges.emplace_back(vertex, vertex + kGridSize);
+        weights.push_back((y + 1) % kBlockSize == 0 ? 1 : 10);
+      }
+    }
+  }
+
+  for (const int num_threads : {1, 4}) {
+    const auto labels = ComputeMultilevelGraphPartition(
+        edges, weights, /*num_parts=*/4, num_threads);
+    EXPECT_EQ(labels.size(), kGridSize * kGridSize);
+    std::vector<int> part_sizes(4, 0);
+    for (const auto& [vertex, label] : labels) {
+      ASSERT_GE(label, 0);
+      ASSERT_LT(label, 4);
+      part_sizes[label] += 1;
+    }
+    for (const int part_size : part_sizes) {
+      EXPECT_GT(part_size, 0);
+      EXPECT_LE(part_size, 1.03 * kGridSize * kGridSize / 4 + 1);
+    }
+    int cut_weight = 0;
+    for (size_t i = 0; i < edges.size(); ++i) {
+      if (labels.at(edges[i].first) != labels.at(edges[i].second)) {
+        cut_weight += weights[i];
+      }
+    }
+    // The optimal cut separates the blocks with a weight of 80, whereas a
+    // random partition has a weight of several thousands.
+    EXPECT_LT(cut_weight, 1000);
+  }
+}
+
 TEST(GraphCut, MinSTGraphCut1) {
   MinSTGraphCut<int, int> graph(2);
   EXPECT_EQ(graph.NumNodes(), 2);
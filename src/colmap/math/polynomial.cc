@@ -38,7 +38,8 @@ namespace colmap {
 namespace {
 
 // Remove leading zero coefficients.
-Eigen::VectorXd RemoveLeadingZeros(const Eigen::VectorXd& coeffs) {
+Eigen::Ref<const Eigen::VectorXd> RemoveLeadingZeros(
+    const Eigen::Ref<const Eigen::VectorXd>& coeffs) {
   Eigen::VectorXd::Index num_zeros = 0;
   for (; num_zeros < coeffs.size(); ++num_zeros) {
     if (coeffs(num_zeros) != 0) {
@@ -49,7 +50,8 @@ Eigen::VectorXd RemoveLeadingZeros(const Eigen::VectorXd& coeffs) {
 }
 
 // Remove trailing zero coefficients.
-Eigen::VectorXd RemoveTrailingZeros(const Eigen::VectorXd& coeffs) {
+Eigen::Ref<const Eigen::VectorXd> RemoveTrailingZeros(
+    const Eigen::Ref<const Eigen::VectorXd>& coeffs) {
   Eigen::VectorXd::Index num_zeros = 0;
   for (; num_zeros < coeffs.size(); ++num_zeros) {
     if (coeffs(coeffs.size() - 1 - num_zeros) != 0) {
@@ -59,11 +61,15 @@ Eigen::VectorXd RemoveTrailingZeros(const Eigen::VectorXd& coeffs) {
   return coeffs.head(coeffs.size() - num_zeros);
 }
 
-}  // namespace
+// The root finders are implemented for dynamic and fixed-capacity root
+// vectors, where the latter are used by the minimal solvers to avoid heap
+// allocations in each RANSAC iteration.
 
-bool FindLinearPolynomialRoots(const Eigen::VectorXd& coeffs,
-                               Eigen::VectorXd* real,
-                               Eigen::VectorXd* imag) {
+template <typename Vector>
+bool FindLinearPolynomialRootsImpl(
+    const Eigen::Ref<const Eigen::VectorXd>& coeffs,
+    Vector* real,
+    Vector* imag) {
   THROW_CHECK_EQ(coeffs.size(), 2);
 
   if (coeffs(0) == 0) {
@@ -83,14 +89,16 @@ bool FindLinearPolynomialRoots(const Eigen::VectorXd& coeffs,
   return true;
 }
 
-bool FindQuadraticPolynomialRoots(const Eigen::VectorXd& coeffs,
-                                  Eigen::VectorXd* real,
-                                  Eigen::VectorXd* imag) {
+template <typename Vector>
+bool FindQuadraticPolynomialRootsImpl(
+    const Eigen::Ref<const Eigen::VectorXd>& coeffs,
+    Vector* real,
+    Vector* imag) {
   THROW_CHECK_EQ(coeffs.size(), 3);
 
   const double a = coeffs(0);
   if (a == 0) {
-    return FindLinearPolynomialRoots(coeffs.tail(2), real, imag);
+    return FindLinearPolynomialRootsImpl(coeffs.tail(2), real, imag);
   }
 
   const double b = coeffs(1);
@@ -140,6 +148,99 @@ bool FindQuadraticPolynomialRoots(const Eigen::VectorXd& coeffs,
   return true;
 }
 
+template <typename Vector>
+bool FindPolynomialRootsCompanionMatrixImpl(
+    const Eigen::Ref<const Eigen::VectorXd>& coeffs_all,
+    Vector* real,
+    Vector* imag) {
+  THROW_CHECK_GE(coeffs_all.size(), 2);
+
+  const Eigen::Ref<const Eigen::VectorXd> coeffs_nonzero =
+      RemoveLeadingZeros(coeffs_all);
+
+  const int degree = coeffs_nonzero.size() - 1;
+
+  if (degree <= 0) {
+    return false;
+  } else if (degree == 1) {
+    return FindLinearPolynomialRootsImpl(coeffs_nonzero, real, imag);
+  } else if (degree == 2) {
+    return FindQuadraticPolynomialRootsImpl(coeffs_nonzero, real, imag);
+  }
+
+  // Remove the coefficients where zero is a solution.
+  const Eigen::Ref<const Eigen::VectorXd> coeffs =
+      RemoveTrailingZeros(coeffs_nonzero);
+
+  // Check if only zero is a solution.
+  if (coeffs.size() == 1) {
+    if (real != nullptr) {
+      real->resize(1);
+      (*real)(0) = 0;
+    }
+    if (imag != nullptr) {
+      imag->resize(1);
+      (*imag)(0) = 0;
+    }
+    return true;
+  }
+
+  // Fill the companion matrix, which has the same capacity as the roots.
+  using CompanionMatrix = Eigen::Matrix<double,
+                                        Eigen::Dynamic,
+                                        Eigen::Dynamic,
+                                        0,
+                                        Vector::MaxRowsAtCompileTime,
+                                        Vector::MaxRowsAtCompileTime>;
+  CompanionMatrix C(coeffs.size() - 1, coeffs.size() - 1);
+  C.setZero();
+  for (Eigen::Index i = 1; i < C.rows(); ++i) {
+    C(i, i - 1) = 1;
+  }
+  C.row(0) = -coeffs.tail(coeffs.size() - 1) / coeffs(0);
+
+  // Solve for the roots of the polynomial.
+  Eigen::EigenSolver<CompanionMatrix> solver(C, false);
+  if (solver.info() != Eigen::Success) {
+    return false;
+  }
+
+  // If there are trailing zeros, we must add zero as a solution.
+  const int effective_degree =
+      coeffs.size() - 1 < degree ? coeffs.size() : coeffs.size() - 1;
+
+  if (real != nullptr) {
+    real->resize(effective_degree);
+    real->head(coeffs.size() - 1) = solver.eigenvalues().real();
+    if (effective_degree > coeffs.size() - 1) {
+      (*real)(real->size() - 1) = 0;
+    }
+  }
+  if (imag != nullptr) {
+    imag->resize(effective_degree);
+    imag->head(coeffs.size() - 1) = solver.eigenvalues().imag();
+    if (effective_degree > coeffs.size() - 1) {
+      (*imag)(imag->size() - 1) = 0;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace
+
+bool FindLinearPolynomialRoots(const Eigen::VectorXd& coeffs,
+                               Eigen::VectorXd* real,
+                               Eigen::VectorXd* imag) {
+  return FindLinearPolynomialRootsImpl(coeffs, real, imag);
+}
+
+bool FindQuadraticPolynomialRoots(const Eigen::VectorXd& coeffs,
+                                  Eigen::VectorXd* real,
+                                  Eigen::VectorXd* imag) {
+  return FindQuadraticPolynomialRootsImpl(coeffs, real, imag);
+}
+
 int FindCubicPolynomialRoots(double c2,
                              double c1,
                              double c0,
@@ -244,73 +345,31 @@ bool FindPolynomialRootsDurandKerner(const Eigen::VectorXd& coeffs_all,
   return true;
 }
 
-bool FindPolynomialRootsCompanionMatrix(const Eigen::VectorXd& coeffs_all,
+bool FindPolynomialRootsCompanionMatrix(const Eigen::VectorXd& coeffs,
                                         Eigen::VectorXd* real,
                                         Eigen::VectorXd* imag) {
-  THROW_CHECK_GE(coeffs_all.size(), 2);
-
-  Eigen::VectorXd coeffs = RemoveLeadingZeros(coeffs_all);
-
-  const int degree = coeffs.size() - 1;
-
-  if (degree <= 0) {
-    return false;
-  } else if (degree == 1) {
-    return FindLinearPolynomialRoots(coeffs, real, imag);
-  } else if (degree == 2) {
-    return FindQuadraticPolynomialRoots(coeffs, real, imag);
-  }
-
-  // Remove the coefficients where zero is a solution.
-  coeffs = RemoveTrailingZeros(coeffs);
-
-  // Check if only zero is a solution.
-  if (coeffs.size() == 1) {
-    if (real != nullptr) {
-      real->resize(1);
-      (*real)(0) = 0;
-    }
-    if (imag != nullptr) {
-      imag->resize(1);
-      (*imag)(0) = 0;
-    }
-    return true;
-  }
-
-  // Fill the companion matrix.
-  Eigen::MatrixXd C(coeffs.size() - 1, coeffs.size() - 1);
-  C.setZero();
-  for (Eigen::MatrixXd::Index i = 1; i < C.rows(); ++i) {
-    C(i, i - 1) = 1;
-  }
-  C.row(0) = -coeffs.tail(coeffs.size() - 1) / coeffs(0);
-
-  // Solve for the roots of the polynomial.
-  Eigen::EigenSolver<Eigen::MatrixXd> solver(C, false);
-  if (solver.info() != Eigen::Success) {
-    return false;
-  }
-
-  // If there are trailing zeros, we must add zero as a solution.
-  const int effective_degree =
-      coeffs.size() - 1 < degree ? coeffs.size() : coeffs.size() - 1;
-
-  if (real != nullptr) {
-    real->resize(effective_degree);
-    real->head(coeffs.size() - 1) = solver.eigenvalues().real();
-    if (effective_degree > coeffs.size() - 1) {
-      (*real)(real->size() - 1) = 0;
-    }
-  }
-  if (imag != nullptr) {
-    imag->resize(effective_degree);
-    imag->head(coeffs.size() - 1) = solver.eigenvalues().imag();
-    if (effective_degree > coeffs.size() - 1) {
-      (*imag)(imag->size() - 1) = 0;
-    }
-  }
+  return FindPolynomialRootsCompanionMatrixImpl(coeffs, real, imag);
+}
 
-  return true;
+template <int kMaxDegree>
+bool FindPolynomialRootsCompanionMatrix(
+    const Eigen::Matrix<double, kMaxDegree + 1, 1>& coeffs,
+    PolynomialRootsVector<kMaxDegree>* real,
+    PolynomialRootsVector<kMaxDegree>* imag) {
+  return FindPolynomialRootsCompanionMatrixImpl(coeffs, real, imag);
 }
 
+template bool FindPolynomialRootsCompanionMatrix<4>(
+    const Eigen::Matrix<double, 5, 1>& coeffs,
+    PolynomialRootsVector<4>* real,
+    PolynomialRootsVector<4>* imag);
+template bool FindPolynomialRootsCompanionMatrix<8>(
+    const Eigen::Matrix<double, 9, 1>& coeffs,
+    PolynomialRootsVector<8>* real,
+    PolynomialRootsVector<8>* imag);
+template bool FindPolynomialRootsCompanionMatrix<10>(
+    const Eigen::Matrix<double, 11, 1>& coeffs,
+    PolynomialRootsVector<10>* real,
+    PolynomialRootsVector<10>* imag);
+
 }  // namespace colmap
@@ -91,6 +91,23 @@ bool FindPolynomialRootsCompanionMatrix(const Eigen::VectorXd& coeffs,
                                         Eigen::VectorXd* real,
                                         Eigen::VectorXd* imag);
 
+// Vector of the roots of a polynomial with at most degree kMaxDegree, which is
+// stored without heap allocation.
+template <int kMaxDegree>
+using PolynomialRootsVector =
+    Eigen::Matrix<double, Eigen::Dynamic, 1, 0, kMaxDegree, 1>;
+
+// Same as above for a polynomial of at most degree kMaxDegree, given by
+// kMaxDegree + 1 coefficients (possibly with leading zeros). The roots and the
+// companion matrix are not allocated on the heap, such that this can be used
+// in minimal solvers, which are called for every RANSAC trial. Instantiated
+// for the degrees 4, 8, and 10.
+template <int kMaxDegree>
+bool FindPolynomialRootsCompanionMatrix(
+    const Eigen::Matrix<double, kMaxDegree + 1, 1>& coeffs,
+    PolynomialRootsVector<kMaxDegree>* real,
+    PolynomialRootsVector<kMaxDegree>* imag);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
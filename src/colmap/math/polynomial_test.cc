@@ -234,5 +234,32 @@ TEST(FindPolynomialRootsCompanionMatrixZeroSolution, Nominal) {
   EXPECT_TRUE(imag.isApprox(ref_imag, 1e-6));
 }
 
+TEST(FindPolynomialRootsCompanionMatrixFixedSize, Nominal) {
+  const std::vector<Eigen::Matrix<double, 5, 1>> coeffs_list = {
+      (Eigen::Matrix<double, 5, 1>() << 10, -5, 3, -3, 1).finished(),
+      (Eigen::Matrix<double, 5, 1>() << 10, -5, 3, -3, 0).finished(),
+      (Eigen::Matrix<double, 5, 1>() << 0, 0, 1, 2, 3).finished(),
+      (Eigen::Matrix<double, 5, 1>() << 0, 0, 0, 1, 2).finished(),
+      (Eigen::Matrix<double, 5, 1>() << 1, 0, 0, 0, 0).finished()};
+  for (const auto& coeffs : coeffs_list) {
+    Eigen::VectorXd real;
+    Eigen::VectorXd imag;
+    const bool success = FindPolynomialRootsCompanionMatrix(
+        Eigen::VectorXd(coeffs), &real, &imag);
+    PolynomialRootsVector<4> real_fixed;
+    PolynomialRootsVector<4> imag_fixed;
+    EXPECT_EQ(
+        FindPolynomialRootsCompanionMatrix(coeffs, &real_fixed, &imag_fixed),
+        success);
+    EXPECT_EQ(real_fixed, real);
+    EXPECT_EQ(imag_fixed, imag);
+  }
+
+  PolynomialRootsVector<4> real;
+  PolynomialRootsVector<4> imag;
+  EXPECT_FALSE(FindPolynomialRootsCompanionMatrix(
+      Eigen::Matrix<double, 5, 1>::Unit(4), &real, &imag));
+}
+
 }  // namespace
 }  // namespace colmap
@@ -32,99 +32,197 @@
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 
-#include <fstream>
-#include <numeric>
+#include <limits>
 
 namespace colmap {
 namespace mvs {
 
-const int ConsistencyGraph::kNoConsistentImageIds = -1;
+const int ConsistencyGraph::kLegacyFileVersion = 1;
+const int ConsistencyGraph::kCompactFileVersion = 2;
+
+namespace {
+
+// Reads the "width&height&version&" header and returns the position of the
+// binary data following it.
+std::streampos ReadHeader(std::istream* file,
+                          size_t* width,
+                          size_t* height,
+                          int* version) {
+  char unused_char;
+  *file >> *width >> unused_char >> *height >> unused_char >> *version >>
+      unused_char;
+  THROW_CHECK(!file->fail());
+  THROW_CHECK_GT(*width, 0);
+  THROW_CHECK_GT(*height, 0);
+  return file->tellg();
+}
+
+}  // namespace
 
 ConsistencyGraph::ConsistencyGraph() {}
 
 ConsistencyGraph::ConsistencyGraph(const size_t width,
                                    const size_t height,
-                                   const std::vector<int>& data)
-    : data_(data) {
-  InitializeMap(width, height);
+                                   const std::vector<int>& data) {
+  Initialize(width, height, data);
 }
 
 size_t ConsistencyGraph::GetNumBytes() const {
-  return (data_.size() + map_.size()) * sizeof(int);
+  return image_idxs_.size() * sizeof(uint16_t) +
+         offsets_.size() * sizeof(uint32_t);
 }
 
 void ConsistencyGraph::GetImageIdxs(const int row,
                                     const int col,
                                     int* num_images,
-                                    const int** image_idxs) const {
-  const int index = map_(row, col);
-  if (index == kNoConsistentImageIds) {
-    *num_images = 0;
-    *image_idxs = nullptr;
-  } else {
-    *num_images = data_.at(index);
-    *image_idxs = &data_.at(index + 1);
-  }
+                                    const uint16_t** image_idxs) const {
+  const size_t pixel_idx = row * width_ + col;
+  const uint32_t begin = offsets_.at(pixel_idx);
+  *num_images = offsets_.at(pixel_idx + 1) - begin;
+  *image_idxs = *num_images > 0 ? image_idxs_.data() + begin : nullptr;
 }
 
 void ConsistencyGraph::Read(const std::string& path) {
-  std::fstream text_file(path, std::ios::in | std::ios::binary);
-  THROW_CHECK_FILE_OPEN(text_file, path);
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
 
   size_t width = 0;
   size_t height = 0;
-  size_t depth = 0;
-  char unused_char;
-
-  text_file >> width >> unused_char >> height >> unused_char >> depth >>
-      unused_char;
-  const std::streampos pos = text_file.tellg();
-  text_file.close();
-
-  THROW_CHECK_GT(width, 0);
-  THROW_CHECK_GT(height, 0);
-  THROW_CHECK_GT(depth, 0);
+  int version = 0;
+  const std::streampos pos = ReadHeader(&file, &width, &height, &version);
+
+  if (version == kLegacyFileVersion) {
+    file.seekg(0, std::ios::end);
+    const size_t num_bytes = file.tellg() - pos;
+    std::vector<int> data(num_bytes / sizeof(int));
+    file.seekg(pos);
+    ReadBinaryLittleEndian<int>(&file, &data);
+    Initialize(width, height, data);
+    return;
+  }
 
-  std::fstream binary_file(path, std::ios::in | std::ios::binary);
-  THROW_CHECK_FILE_OPEN(binary_file, path);
+  THROW_CHECK_EQ(version, kCompactFileVersion);
+
+  width_ = width;
+  height_ = height;
+  image_idxs_.clear();
+  offsets_.resize(width * height + 1);
+  offsets_[0] = 0;
+
+  std::vector<uint16_t> num_images(width);
+  for (size_t row = 0; row < height; ++row) {
+    ReadBinaryLittleEndian<uint16_t>(&file, &num_images);
+    const size_t row_begin = image_idxs_.size();
+    uint32_t offset = offsets_[row * width];
+    for (size_t col = 0; col < width; ++col) {
+      offset += num_images[col];
+      offsets_[row * width + col + 1] = offset;
+    }
+    image_idxs_.resize(offset);
+    for (size_t i = row_begin; i < image_idxs_.size(); ++i) {
+      image_idxs_[i] = ReadBinaryLittleEndian<uint16_t>(&file);
+    }
+  }
+  THROW_CHECK(!file.fail()) << path;
+}
 
-  binary_file.seekg(0, std::ios::end);
-  const size_t num_bytes = binary_file.tellg() - pos;
+void ConsistencyGraph::Write(const std::string& path) const {
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  file << width_ << "&" << height_ << "&" << kCompactFileVersion << "&";
+
+  for (size_t row = 0; row < height_; ++row) {
+    const size_t row_begin = row * width_;
+    for (size_t col = 0; col < width_; ++col) {
+      const uint16_t num_images = static_cast<uint16_t>(
+          offsets_[row_begin + col + 1] - offsets_[row_begin + col]);
+      WriteBinaryLittleEndian<uint16_t>(&file, num_images);
+    }
+    for (uint32_t i = offsets_[row_begin]; i < offsets_[row_begin + width_];
+         ++i) {
+      WriteBinaryLittleEndian<uint16_t>(&file, image_idxs_[i]);
+    }
+  }
+}
 
-  data_.resize(num_bytes / sizeof(int));
+void ConsistencyGraph::Initialize(const size_t width,
+                                  const size_t height,
+                                  const std::vector<int>& data) {
+  width_ = width;
+  height_ = height;
+
+  // Count the consistent images per pixel, then scatter their indices into
+  // row-major order, since the pixels in the data may be in arbitrary order.
+  std::vector<uint32_t> num_images(width * height, 0);
+  for (size_t i = 0; i < data.size();) {
+    const int col = data.at(i);
+    const int row = data.at(i + 1);
+    const int num_pixel_images = data.at(i + 2);
+    THROW_CHECK_LT(col, static_cast<int>(width));
+    THROW_CHECK_LT(row, static_cast<int>(height));
+    num_images[row * width + col] = num_pixel_images;
+    i += 3 + num_pixel_images;
+  }
 
-  binary_file.seekg(pos);
-  ReadBinaryLittleEndian<int>(&binary_file, &data_);
-  binary_file.close();
+  offsets_.resize(width * height + 1);
+  offsets_[0] = 0;
+  for (size_t i = 0; i < num_images.size(); ++i) {
+    offsets_[i + 1] = offsets_[i] + num_images[i];
+  }
 
-  InitializeMap(width, height);
+  image_idxs_.resize(offsets_.back());
+  for (size_t i = 0; i < data.size();) {
+    const int col = data[i];
+    const int row = data[i + 1];
+    const int num_pixel_images = data[i + 2];
+    uint16_t* pixel_image_idxs =
+        image_idxs_.data() + offsets_[row * width + col];
+    for (int j = 0; j < num_pixel_images; ++j) {
+      const int image_idx = data.at(i + 3 + j);
+      THROW_CHECK_GE(image_idx, 0);
+      THROW_CHECK_LE(image_idx, std::numeric_limits<uint16_t>::max());
+      pixel_image_idxs[j] = static_cast<uint16_t>(image_idx);
+    }
+    i += 3 + num_pixel_images;
+  }
 }
 
-void ConsistencyGraph::Write(const std::string& path) const {
-  std::fstream text_file(path, std::ios::out);
-  THROW_CHECK_FILE_OPEN(text_file, path);
-  text_file << map_.cols() << "&" << map_.rows() << "&" << 1 << "&";
-  text_file.close();
-
-  std::fstream binary_file(path,
-                           std::ios::out | std::ios::binary | std::ios::app);
-  THROW_CHECK_FILE_OPEN(binary_file, path);
-  WriteBinaryLittleEndian<int>(&binary_file, data_);
-  binary_file.close();
+ConsistencyGraphReader::ConsistencyGraphReader(const std::string& path)
+    : file_(path, std::ios::binary) {
+  THROW_CHECK_FILE_OPEN(file_, path);
+  int version = 0;
+  ReadHeader(&file_, &width_, &height_, &version);
+  THROW_CHECK_EQ(version, ConsistencyGraph::kCompactFileVersion)
+      << "Only the compact encoding can be read row by row: " << path;
+  num_images_.resize(width_);
+  offsets_.resize(width_ + 1);
 }
 
-void ConsistencyGraph::InitializeMap(const size_t width, const size_t height) {
-  map_.resize(height, width);
-  map_.setConstant(kNoConsistentImageIds);
-  for (size_t i = 0; i < data_.size();) {
-    const int num_images = data_.at(i + 2);
-    if (num_images > 0) {
-      const int col = data_.at(i);
-      const int row = data_.at(i + 1);
-      map_(row, col) = i + 2;
-    }
-    i += 3 + num_images;
+bool ConsistencyGraphReader::ReadNextRow() {
+  if (row_ + 1 >= static_cast<int>(height_)) {
+    return false;
+  }
+
+  ReadBinaryLittleEndian<uint16_t>(&file_, &num_images_);
+  offsets_[0] = 0;
+  for (size_t col = 0; col < width_; ++col) {
+    offsets_[col + 1] = offsets_[col] + num_images_[col];
   }
+  image_idxs_.resize(offsets_.back());
+  ReadBinaryLittleEndian<uint16_t>(&file_, &image_idxs_);
+  THROW_CHECK(!file_.fail());
+
+  row_ += 1;
+  return true;
+}
+
+void ConsistencyGraphReader::GetImageIdxs(const int col,
+                                          int* num_images,
+                                          const uint16_t** image_idxs) const {
+  THROW_CHECK_GE(row_, 0);
+  *num_images = num_images_.at(col);
+  *image_idxs =
+      *num_images > 0 ? image_idxs_.data() + offsets_.at(col) : nullptr;
 }
 
 }  // namespace mvs
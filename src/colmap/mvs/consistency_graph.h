@@ -32,6 +32,8 @@
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
+#include <cstdint>
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -40,7 +42,8 @@
 namespace colmap {
 namespace mvs {
 
-// List of geometrically consistent images, in the following format:
+// List of geometrically consistent images, which is constructed from the
+// following format:
 //
 //    r_1, c_1, N_1, i_11, i_12, ..., i_1N_1,
 //    r_2, c_2, N_2, i_21, i_22, ..., i_2N_2, ...
@@ -49,27 +52,72 @@ namespace mvs {
 // N is the number of consistent images, followed by the N image indices.
 // Note that only pixels are listed which are not filtered and that the
 // consistency graph is only filled if filtering is enabled.
+//
+// The graph is stored compactly as 16-bit image indices of all pixels in
+// row-major order and the offsets of each pixel into these indices. The files
+// are written in the same compact encoding, where each row is stored as the
+// 16-bit numbers of consistent images of its pixels followed by their image
+// indices, such that the rows can be read one after the other, see
+// `ConsistencyGraphReader`. Files in the original format, which stores the
+// list above as 32-bit integers, can still be read.
 class ConsistencyGraph {
  public:
   ConsistencyGraph();
   ConsistencyGraph(size_t width, size_t height, const std::vector<int>& data);
 
+  inline size_t GetWidth() const { return width_; }
+  inline size_t GetHeight() const { return height_; }
+
   size_t GetNumBytes() const;
 
   void GetImageIdxs(int row,
                     int col,
                     int* num_images,
-                    const int** image_idxs) const;
+                    const uint16_t** image_idxs) const;
 
   void Read(const std::string& path);
   void Write(const std::string& path) const;
 
+  // The version of the file format, which is stored in the third field of the
+  // header, e.g., "width&height&2&" for the compact encoding.
+  static const int kLegacyFileVersion;
+  static const int kCompactFileVersion;
+
  private:
-  void InitializeMap(size_t width, size_t height);
+  void Initialize(size_t width, size_t height, const std::vector<int>& data);
 
-  const static int kNoConsistentImageIds;
-  std::vector<int> data_;
-  Eigen::MatrixXi map_;
+  size_t width_ = 0;
+  size_t height_ = 0;
+  std::vector<uint16_t> image_idxs_;
+  std::vector<uint32_t> offsets_;
+};
+
+// Read the rows of a consistency graph file in the compact encoding one after
+// the other, without loading the entire graph, e.g., to stream it into the
+// fusion of depth maps.
+class ConsistencyGraphReader {
+ public:
+  explicit ConsistencyGraphReader(const std::string& path);
+
+  inline size_t GetWidth() const { return width_; }
+  inline size_t GetHeight() const { return height_; }
+
+  // Read the next row of the graph, whose index is then returned by GetRow.
+  // Returns false, if all rows were read.
+  bool ReadNextRow();
+  inline int GetRow() const { return row_; }
+
+  // The consistent images of a pixel in the current row.
+  void GetImageIdxs(int col, int* num_images, const uint16_t** image_idxs) const;
+
+ private:
+  std::ifstream file_;
+  size_t width_ = 0;
+  size_t height_ = 0;
+  int row_ = -1;
+  std::vector<uint16_t> num_images_;
+  std::vector<uint16_t> image_idxs_;
+  std::vector<uint32_t> offsets_;
 };
 
 }  // namespace mvs
@@ -29,6 +29,11 @@
 
 #include "colmap/mvs/consistency_graph.h"
 
+#include "colmap/util/endian.h"
+#include "colmap/util/testing.h"
+
+#include <fstream>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -41,20 +46,20 @@ TEST(ConsistencyGraph, Empty) {
   for (size_t i = 0; i < 2; ++i) {
     for (size_t j = 0; j < 2; ++j) {
       int num_images;
-      const int* image_idxs;
+      const uint16_t* image_idxs;
       consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
       EXPECT_EQ(num_images, 0);
       EXPECT_TRUE(image_idxs == nullptr);
     }
   }
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 16);
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 20);
 }
 
 TEST(ConsistencyGraph, Partial) {
   const std::vector<int> data = {0, 0, 3, 5, 7, 33};
   ConsistencyGraph consistency_graph(2, 1, data);
   int num_images;
-  const int* image_idxs;
+  const uint16_t* image_idxs;
   consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
   EXPECT_EQ(num_images, 3);
   EXPECT_EQ(image_idxs[0], 5);
@@ -63,28 +68,28 @@ TEST(ConsistencyGraph, Partial) {
   consistency_graph.GetImageIdxs(0, 1, &num_images, &image_idxs);
   EXPECT_EQ(num_images, 0);
   EXPECT_TRUE(image_idxs == nullptr);
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 32);
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 18);
 }
 
 TEST(ConsistencyGraph, Zero) {
   const std::vector<int> data = {0, 0, 0};
   ConsistencyGraph consistency_graph(2, 1, data);
   int num_images;
-  const int* image_idxs;
+  const uint16_t* image_idxs;
   consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
   EXPECT_EQ(num_images, 0);
   EXPECT_TRUE(image_idxs == nullptr);
   consistency_graph.GetImageIdxs(0, 1, &num_images, &image_idxs);
   EXPECT_EQ(num_images, 0);
   EXPECT_TRUE(image_idxs == nullptr);
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 20);
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 12);
 }
 
 TEST(ConsistencyGraph, Full) {
   const std::vector<int> data = {0, 0, 3, 5, 7, 33, 0, 1, 1, 100};
   ConsistencyGraph consistency_graph(1, 2, data);
   int num_images;
-  const int* image_idxs;
+  const uint16_t* image_idxs;
   consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
   EXPECT_EQ(num_images, 3);
   EXPECT_EQ(image_idxs[0], 5);
@@ -93,7 +98,81 @@ TEST(ConsistencyGraph, Full) {
   consistency_graph.GetImageIdxs(1, 0, &num_images, &image_idxs);
   EXPECT_EQ(num_images, 1);
   EXPECT_EQ(image_idxs[0], 100);
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 48);
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 20);
+}
+
+void ExpectEqualImageIdxs(const ConsistencyGraph& consistency_graph1,
+                          const ConsistencyGraph& consistency_graph2) {
+  ASSERT_EQ(consistency_graph1.GetWidth(), consistency_graph2.GetWidth());
+  ASSERT_EQ(consistency_graph1.GetHeight(), consistency_graph2.GetHeight());
+  for (size_t row = 0; row < consistency_graph1.GetHeight(); ++row) {
+    for (size_t col = 0; col < consistency_graph1.GetWidth(); ++col) {
+      int num_images1;
+      const uint16_t* image_idxs1;
+      consistency_graph1.GetImageIdxs(row, col, &num_images1, &image_idxs1);
+      int num_images2;
+      const uint16_t* image_idxs2;
+      consistency_graph2.GetImageIdxs(row, col, &num_images2, &image_idxs2);
+      ASSERT_EQ(num_images1, num_images2);
+      for (int i = 0; i < num_images1; ++i) {
+        EXPECT_EQ(image_idxs1[i], image_idxs2[i]);
+      }
+    }
+  }
+}
+
+TEST(ConsistencyGraph, ReadWrite) {
+  const std::vector<int> data = {1, 0, 2, 4, 2, 0, 1, 1, 65535, 2, 1, 1, 3};
+  const ConsistencyGraph consistency_graph(3, 2, data);
+  const std::string path = CreateTestDir() + "/consistency_graph.bin";
+  consistency_graph.Write(path);
+  ConsistencyGraph read_consistency_graph;
+  read_consistency_graph.Read(path);
+  ExpectEqualImageIdxs(consistency_graph, read_consistency_graph);
+}
+
+TEST(ConsistencyGraph, ReadLegacy) {
+  const std::vector<int> data = {0, 0, 3, 5, 7, 33, 0, 1, 1, 100};
+  const std::string path = CreateTestDir() + "/consistency_graph.bin";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << 1 << "&" << 2 << "&" << ConsistencyGraph::kLegacyFileVersion
+         << "&";
+    WriteBinaryLittleEndian<int>(&file, data);
+  }
+  ConsistencyGraph read_consistency_graph;
+  read_consistency_graph.Read(path);
+  ExpectEqualImageIdxs(ConsistencyGraph(1, 2, data), read_consistency_graph);
+}
+
+TEST(ConsistencyGraphReader, Nominal) {
+  const std::vector<int> data = {1, 0, 2, 4, 2, 0, 1, 1, 65535, 2, 1, 1, 3};
+  const ConsistencyGraph consistency_graph(3, 2, data);
+  const std::string path = CreateTestDir() + "/consistency_graph.bin";
+  consistency_graph.Write(path);
+
+  ConsistencyGraphReader reader(path);
+  EXPECT_EQ(reader.GetWidth(), 3);
+  EXPECT_EQ(reader.GetHeight(), 2);
+  int num_rows = 0;
+  while (reader.ReadNextRow()) {
+    EXPECT_EQ(reader.GetRow(), num_rows);
+    for (size_t col = 0; col < reader.GetWidth(); ++col) {
+      int num_images;
+      const uint16_t* image_idxs;
+      reader.GetImageIdxs(col, &num_images, &image_idxs);
+      int expected_num_images;
+      const uint16_t* expected_image_idxs;
+      consistency_graph.GetImageIdxs(
+          num_rows, col, &expected_num_images, &expected_image_idxs);
+      ASSERT_EQ(num_images, expected_num_images);
+      for (int i = 0; i < num_images; ++i) {
+        EXPECT_EQ(image_idxs[i], expected_image_idxs[i]);
+      }
+    }
+    num_rows += 1;
+  }
+  EXPECT_EQ(num_rows, 2);
 }
 
 }  // namespace
@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/mvs/gpu_mat.h"
+#include "colmap/util/cuda_memory_pool.h"
 #include "colmap/util/cudacc.h"
 #include "colmap/util/logging.h"
 
@@ -74,7 +75,7 @@ class CudaArrayLayeredTexture {
   const size_t height_;
   const size_t depth_;
 
-  cudaArray_t array_;
+  std::shared_ptr<cudaArray> array_;
   const cudaTextureDesc texture_desc_;
   cudaResourceDesc resource_desc_;
   cudaTextureObject_t texture_;
@@ -98,7 +99,7 @@ CudaArrayLayeredTexture<T>::FromGpuMat(const cudaTextureDesc& texture_desc,
   params.kind = cudaMemcpyDeviceToDevice;
   params.srcPtr = make_cudaPitchedPtr(
       (void*)mat.GetPtr(), mat.GetPitch(), mat.GetWidth(), mat.GetHeight());
-  params.dstArray = array->array_;
+  params.dstArray = array->array_.get();
   CUDA_SAFE_CALL(cudaMemcpy3D(&params));
 
   return array;
@@ -120,7 +121,7 @@ CudaArrayLayeredTexture<T>::FromHostArray(const cudaTextureDesc& texture_desc,
   params.kind = cudaMemcpyHostToDevice;
   params.srcPtr =
       make_cudaPitchedPtr((void*)data, width * sizeof(T), width, height);
-  params.dstArray = array->array_;
+  params.dstArray = array->array_.get();
   CUDA_SAFE_CALL(cudaMemcpy3D(&params));
 
   return array;
@@ -140,13 +141,14 @@ CudaArrayLayeredTexture<T>::CudaArrayLayeredTexture(
   THROW_CHECK_GT(height_, 0);
   THROW_CHECK_GT(depth_, 0);
 
-  cudaExtent extent = make_cudaExtent(width_, height_, depth_);
-  cudaChannelFormatDesc fmt = cudaCreateChannelDesc<T>();
-  CUDA_SAFE_CALL(cudaMalloc3DArray(&array_, &fmt, extent, cudaArrayLayered));
+  // The array is returned to the pool on destruction and reused by later
+  // textures with the same format and extent.
+  array_ = CudaMemoryPool::Get().AllocateLayeredArray(
+      cudaCreateChannelDesc<T>(), width_, height_, depth_);
 
   memset(&resource_desc_, 0, sizeof(resource_desc_));
   resource_desc_.resType = cudaResourceTypeArray;
-  resource_desc_.res.array.array = array_;
+  resource_desc_.res.array.array = array_.get();
 
   CUDA_SAFE_CALL(cudaCreateTextureObject(
       &texture_, &resource_desc_, &texture_desc_, nullptr));
@@ -154,7 +156,6 @@ CudaArrayLayeredTexture<T>::CudaArrayLayeredTexture(
 
 template <typename T>
 CudaArrayLayeredTexture<T>::~CudaArrayLayeredTexture() {
-  CUDA_SAFE_CALL(cudaFreeArray(array_));
   CUDA_SAFE_CALL(cudaDestroyTextureObject(texture_));
 }
 
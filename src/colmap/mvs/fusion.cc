@@ -29,11 +29,19 @@
 
 #include "colmap/mvs/fusion.h"
 
+#include "colmap/mvs/fusion_cuda.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/memory.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
 
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/util/cuda.h"
+#endif
+
 #include <Eigen/Geometry>
 
 namespace colmap {
@@ -81,6 +89,122 @@ int FindNextImage(const std::vector<std::vector<int>>& overlapping_images,
   return -1;
 }
 
+namespace {
+
+void SplitFusionTile(
+    const std::vector<Model::Point>& points,
+    const std::pair<Eigen::Vector3f, Eigen::Vector3f>& bounding_box,
+    std::vector<int> point_idxs,
+    const int max_num_images,
+    std::vector<FusionTile>* tiles) {
+  std::vector<int> image_idxs;
+  for (const int point_idx : point_idxs) {
+    image_idxs.insert(image_idxs.end(),
+                      points[point_idx].track.begin(),
+                      points[point_idx].track.end());
+  }
+  std::sort(image_idxs.begin(), image_idxs.end());
+  image_idxs.erase(std::unique(image_idxs.begin(), image_idxs.end()),
+                   image_idxs.end());
+
+  auto AddTile = [&]() {
+    FusionTile& tile = tiles->emplace_back();
+    tile.bounding_box = bounding_box;
+    tile.image_idxs = std::move(image_idxs);
+  };
+
+  if (image_idxs.size() <= static_cast<size_t>(max_num_images) ||
+      point_idxs.size() < 2) {
+    AddTile();
+    return;
+  }
+
+  Eigen::Vector3f min_xyz = Eigen::Vector3f::Constant(FLT_MAX);
+  Eigen::Vector3f max_xyz = Eigen::Vector3f::Constant(-FLT_MAX);
+  for (const int point_idx : point_idxs) {
+    const Eigen::Vector3f xyz(
+        points[point_idx].x, points[point_idx].y, points[point_idx].z);
+    min_xyz = min_xyz.cwiseMin(xyz);
+    max_xyz = max_xyz.cwiseMax(xyz);
+  }
+
+  int axis = 0;
+  (max_xyz - min_xyz).maxCoeff(&axis);
+  const auto Coord = [&points, axis](const int point_idx) {
+    const Model::Point& point = points[point_idx];
+    return axis == 0 ? point.x : (axis == 1 ? point.y : point.z);
+  };
+
+  const size_t mid_idx = point_idxs.size() / 2;
+  std::nth_element(point_idxs.begin(),
+                   point_idxs.begin() + mid_idx,
+                   point_idxs.end(),
+                   [&Coord](const int point_idx1, const int point_idx2) {
+                     return Coord(point_idx1) < Coord(point_idx2);
+                   });
+  const float split = Coord(point_idxs[mid_idx]);
+
+  std::vector<int> lower_point_idxs;
+  std::vector<int> upper_point_idxs;
+  for (const int point_idx : point_idxs) {
+    if (Coord(point_idx) < split) {
+      lower_point_idxs.push_back(point_idx);
+    } else {
+      upper_point_idxs.push_back(point_idx);
+    }
+  }
+
+  // All points have the same coordinate along the axis of largest extent.
+  if (lower_point_idxs.empty()) {
+    AddTile();
+    return;
+  }
+
+  auto lower_bounding_box = bounding_box;
+  lower_bounding_box.second(axis) = split;
+  auto upper_bounding_box = bounding_box;
+  upper_bounding_box.first(axis) = split;
+
+  point_idxs.clear();
+  point_idxs.shrink_to_fit();
+  image_idxs.clear();
+  image_idxs.shrink_to_fit();
+  SplitFusionTile(points,
+                  lower_bounding_box,
+                  std::move(lower_point_idxs),
+                  max_num_images,
+                  tiles);
+  SplitFusionTile(points,
+                  upper_bounding_box,
+                  std::move(upper_point_idxs),
+                  max_num_images,
+                  tiles);
+}
+
+}  // namespace
+
+std::vector<FusionTile> ComputeFusionTiles(
+    const std::vector<Model::Point>& points,
+    const std::pair<Eigen::Vector3f, Eigen::Vector3f>& bounding_box,
+    const int max_num_images) {
+  THROW_CHECK_GT(max_num_images, 0);
+
+  std::vector<int> point_idxs;
+  for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+    const Eigen::Vector3f xyz(
+        points[point_idx].x, points[point_idx].y, points[point_idx].z);
+    if ((xyz.array() >= bounding_box.first.array()).all() &&
+        (xyz.array() <= bounding_box.second.array()).all()) {
+      point_idxs.push_back(point_idx);
+    }
+  }
+
+  std::vector<FusionTile> tiles;
+  SplitFusionTile(
+      points, bounding_box, std::move(point_idxs), max_num_images, &tiles);
+  return tiles;
+}
+
 }  // namespace internal
 
 void StereoFusionOptions::Print() const {
@@ -97,6 +221,10 @@ void StereoFusionOptions::Print() const {
   PrintOption(check_num_images);
   PrintOption(use_cache);
   PrintOption(cache_size);
+  PrintOption(bitmap_decoder);
+  PrintOption(use_gpu);
+  PrintOption(gpu_index);
+  PrintOption(max_num_tile_images);
   const auto& bbox_min = bounding_box.first.transpose().eval();
   const auto& bbox_max = bounding_box.second.transpose().eval();
   PrintOption(bbox_min);
@@ -113,6 +241,9 @@ bool StereoFusionOptions::Check() const {
   CHECK_OPTION_GE(max_normal_error, 0);
   CHECK_OPTION_GT(check_num_images, 0);
   CHECK_OPTION_GT(cache_size, 0);
+  if (use_gpu) {
+    CHECK_OPTION_EQ(CSVToVector<int>(gpu_index).size(), 1);
+  }
   return true;
 }
 
@@ -132,6 +263,8 @@ StereoFusion::StereoFusion(const StereoFusionOptions& options,
   THROW_CHECK(options_.Check());
 }
 
+StereoFusion::~StereoFusion() = default;
+
 const std::vector<PlyPoint>& StereoFusion::GetFusedPoints() const {
   return fused_points_;
 }
@@ -141,7 +274,12 @@ const std::vector<std::vector<int>>& StereoFusion::GetFusedPointsVisibility()
   return fused_points_visibility_;
 }
 
+void StereoFusion::SetOutputPath(const std::string& path) {
+  output_path_ = path;
+}
+
 void StereoFusion::Run() {
+  COLMAP_PROFILE_SCOPE("StereoFusion::Run");
   Timer run_timer;
   run_timer.Start();
 
@@ -150,6 +288,21 @@ void StereoFusion::Run() {
 
   options_.Print();
 
+  if (options_.max_num_tile_images > 0 && output_path_.empty()) {
+    LOG(ERROR) << "Tiled fusion requires an output path for the fused points.";
+    run_timer.PrintMinutes();
+    return;
+  }
+
+#if !defined(COLMAP_CUDA_ENABLED)
+  if (options_.use_gpu) {
+    LOG(ERROR) << "Fusion on the GPU requires CUDA, which is not available "
+                  "on your system.";
+    run_timer.PrintMinutes();
+    return;
+  }
+#endif
+
   LOG(INFO) << "Reading workspace...";
 
   Workspace::Options workspace_options;
@@ -164,6 +317,7 @@ void StereoFusion::Run() {
   workspace_options.num_threads = options_.num_threads;
   workspace_options.max_image_size = options_.max_image_size;
   workspace_options.image_as_rgb = true;
+  workspace_options.bitmap_decoder = options_.bitmap_decoder;
   workspace_options.cache_size = options_.cache_size;
   workspace_options.workspace_path = workspace_path_;
   workspace_options.workspace_format = workspace_format_;
@@ -173,10 +327,12 @@ void StereoFusion::Run() {
       workspace_path_, workspace_options.stereo_folder, "fusion.cfg"));
   int num_threads = 1;
   if (options_.use_cache) {
-    workspace_ = std::make_unique<CachedWorkspace>(workspace_options);
+    auto cached_workspace =
+        std::make_unique<CachedWorkspace>(workspace_options);
+    cached_workspace_ = cached_workspace.get();
+    workspace_ = std::move(cached_workspace);
   } else {
     workspace_ = std::make_unique<Workspace>(workspace_options);
-    workspace_->Load(image_names);
     num_threads = GetEffectiveNumThreads(options_.num_threads);
   }
 
@@ -191,12 +347,16 @@ void StereoFusion::Run() {
 
   const double kMinTriangulationAngle = 0;
   if (model.GetMaxOverlappingImagesFromPMVS().empty()) {
-    overlapping_images_ = model.GetMaxOverlappingImages(
+    overlapping_images_ = workspace_->GetViewSelectionIndex().SelectImages(
         options_.check_num_images, kMinTriangulationAngle);
   } else {
     overlapping_images_ = model.GetMaxOverlappingImagesFromPMVS();
   }
 
+  task_scratch_.resize(num_threads);
+  for (auto& scratch : task_scratch_) {
+    scratch.is_visible.resize(model.images.size(), false);
+  }
   task_fused_points_.resize(num_threads);
   task_fused_points_visibility_.resize(num_threads);
 
@@ -209,6 +369,98 @@ void StereoFusion::Run() {
   inv_P_.resize(model.images.size());
   inv_R_.resize(model.images.size());
 
+  ThreadPool thread_pool(num_threads);
+
+  if (!output_path_.empty()) {
+    ply_writer_ = std::make_unique<PlyPointWriter>(output_path_);
+    visibility_writer_ =
+        std::make_unique<PointsVisibilityWriter>(output_path_ + ".vis");
+  }
+
+  if (options_.max_num_tile_images > 0) {
+    const std::vector<internal::FusionTile> tiles =
+        internal::ComputeFusionTiles(model.points,
+                                     options_.bounding_box,
+                                     options_.max_num_tile_images);
+
+    std::vector<char> is_tile_image(model.images.size());
+    std::vector<std::string> tile_image_names;
+    for (size_t tile_idx = 0; tile_idx < tiles.size(); ++tile_idx) {
+      if (CheckIfStopped()) {
+        break;
+      }
+
+      const internal::FusionTile& tile = tiles[tile_idx];
+      std::fill(is_tile_image.begin(), is_tile_image.end(), false);
+      for (const int image_idx : tile.image_idxs) {
+        is_tile_image.at(image_idx) = true;
+      }
+      tile_image_names.clear();
+      for (const auto& image_name : image_names) {
+        if (is_tile_image.at(model.GetImageIdx(image_name))) {
+          tile_image_names.push_back(image_name);
+        }
+      }
+      if (tile_image_names.empty()) {
+        continue;
+      }
+
+      LOG(INFO) << StringPrintf("Fusing tile [%d/%d] with %d images",
+                                tile_idx + 1,
+                                tiles.size(),
+                                tile_image_names.size());
+
+      bounding_box_ = tile.bounding_box;
+      workspace_->Load(tile_image_names);
+      InitImages(tile_image_names);
+      FuseImages(&thread_pool);
+    }
+  } else {
+    bounding_box_ = options_.bounding_box;
+    workspace_->Load(image_names);
+    InitImages(image_names);
+    FuseImages(&thread_pool);
+  }
+
+  size_t num_fused_points = 0;
+  if (ply_writer_) {
+    num_fused_points = ply_writer_->NumPoints();
+    ply_writer_->Close();
+    ply_writer_.reset();
+    visibility_writer_->Close();
+    visibility_writer_.reset();
+  } else {
+    GatherFusedPoints();
+    num_fused_points = fused_points_.size();
+  }
+
+  if (num_fused_points == 0) {
+    LOG(WARNING)
+        << "Could not fuse any points. This is likely caused by "
+           "incorrect settings - filtering must be enabled for the last "
+           "call to patch match stereo.";
+  }
+
+  LOG(INFO) << "Number of fused points: " << num_fused_points;
+  UpdateMemoryUsage();
+  LogMemoryUsage();
+  run_timer.PrintMinutes();
+}
+
+void StereoFusion::InitImages(const std::vector<std::string>& image_names) {
+  COLMAP_PROFILE_SCOPE("StereoFusion::InitImages");
+  const auto& model = workspace_->GetModel();
+
+  // Reset the state and release the pixel masks of the previous tile.
+  std::fill(used_images_.begin(), used_images_.end(), false);
+  std::fill(fused_images_.begin(), fused_images_.end(), false);
+  std::fill(depth_map_sizes_.begin(),
+            depth_map_sizes_.end(),
+            std::make_pair(0, 0));
+  for (auto& fused_pixel_mask : fused_pixel_masks_) {
+    fused_pixel_mask = Mat<char>();
+  }
+
   for (const auto& image_name : image_names) {
     const int image_idx = model.GetImageIdx(image_name);
 
@@ -252,9 +504,19 @@ void StereoFusion::Run() {
             image.GetR())
             .transpose();
   }
+}
 
-  LOG(INFO) << StringPrintf("Starting fusion with %d threads", num_threads);
-  ThreadPool thread_pool(num_threads);
+void StereoFusion::FuseImages(ThreadPool* thread_pool) {
+  COLMAP_PROFILE_SCOPE("StereoFusion::FuseImages");
+  if (options_.use_gpu) {
+#if defined(COLMAP_CUDA_ENABLED)
+    InitFusionCuda();
+#endif
+    LOG(INFO) << "Starting fusion on the GPU";
+  } else {
+    LOG(INFO) << StringPrintf("Starting fusion with %d threads",
+                              thread_pool->NumThreads());
+  }
 
   // Using a row stride of 10 to avoid starting parallel processing in rows that
   // are too close to each other which may lead to duplicated work, since nearby
@@ -266,17 +528,18 @@ void StereoFusion::Run() {
                                     const int image_idx,
                                     const Mat<char>& fused_pixel_mask) {
     const int row_end = std::min(height, row_start + kRowStride);
+    const int thread_id = thread_pool->GetThreadIndex();
     for (int row = row_start; row < row_end; ++row) {
       for (int col = 0; col < width; ++col) {
         if (fused_pixel_mask.Get(row, col) > 0) {
           continue;
         }
-        const int thread_id = thread_pool.GetThreadIndex();
         Fuse(thread_id, image_idx, row, col);
       }
     }
   };
 
+  const auto& model = workspace_->GetModel();
   size_t num_fused_images = 0;
   size_t total_fused_points = 0;
   for (int image_idx = 0; image_idx >= 0;
@@ -295,29 +558,104 @@ void StereoFusion::Run() {
                               image_idx)
               << std::flush;
 
+    if (cached_workspace_) {
+      PrefetchImages(image_idx);
+    }
+
     const int width = depth_map_sizes_.at(image_idx).first;
     const int height = depth_map_sizes_.at(image_idx).second;
     const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
 
-    for (int row_start = 0; row_start < height; row_start += kRowStride) {
-      thread_pool.AddTask(ProcessImageRows,
-                          row_start,
-                          height,
-                          width,
-                          image_idx,
-                          fused_pixel_mask);
+    if (options_.use_gpu) {
+#if defined(COLMAP_CUDA_ENABLED)
+      FuseCuda(image_idx);
+#endif
+    } else {
+      for (int row_start = 0; row_start < height; row_start += kRowStride) {
+        thread_pool->AddTask(ProcessImageRows,
+                             row_start,
+                             height,
+                             width,
+                             image_idx,
+                             std::cref(fused_pixel_mask));
+      }
+      thread_pool->Wait();
     }
-    thread_pool.Wait();
 
     num_fused_images += 1;
     fused_images_.at(image_idx) = true;
 
-    total_fused_points = 0;
-    for (const auto& task_fused_points : task_fused_points_) {
-      total_fused_points += task_fused_points.size();
+    if (ply_writer_) {
+      WriteTaskFusedPoints();
+      total_fused_points = ply_writer_->NumPoints();
+    } else {
+      total_fused_points = 0;
+      for (const auto& task_fused_points : task_fused_points_) {
+        total_fused_points += task_fused_points.size();
+      }
     }
     LOG(INFO) << StringPrintf(
         " in %.3fs (%d points)", timer.ElapsedSeconds(), total_fused_points);
+
+    static MetricCounter* num_fused_images_counter =
+        MetricsRegistry::Instance().Counter("colmap_fusion_images_total",
+                                            "Number of fused images");
+    static MetricHistogram* fuse_image_seconds =
+        MetricsRegistry::Instance().Histogram(
+            "colmap_fusion_image_seconds",
+            "Time to fuse the pixels of an image",
+            ExponentialMetricBuckets(0.01, 4, 10));
+    static MetricGauge* num_fused_points =
+        MetricsRegistry::Instance().Gauge("colmap_fusion_points",
+                                          "Number of fused points");
+    num_fused_images_counter->Increment();
+    fuse_image_seconds->Observe(timer.ElapsedSeconds());
+    num_fused_points->Set(total_fused_points);
+    // The estimate visits all fused points, so it is only updated periodically.
+    const int kMemoryUsageInterval = 16;
+    if (num_fused_images % kMemoryUsageInterval == 0) {
+      UpdateMemoryUsage();
+    }
+  }
+
+  fusion_cuda_.reset();
+}
+
+void StereoFusion::PrefetchImages(const int image_idx) {
+  // The fusion of an image traverses its overlapping images, of which the
+  // first are also the most likely next images. The number of prefetched
+  // images is bounded, since their data is not yet limited by the cache size.
+  const int kMaxNumPrefetchImages = 4;
+  cached_workspace_->InsertPrefetched();
+  int num_prefetch_images = 0;
+  for (const int next_image_idx : overlapping_images_.at(image_idx)) {
+    if (num_prefetch_images >= kMaxNumPrefetchImages) {
+      break;
+    }
+    if (used_images_.at(next_image_idx) && !fused_images_.at(next_image_idx)) {
+      cached_workspace_->Prefetch(next_image_idx, /*prefetch_maps=*/true);
+      num_prefetch_images += 1;
+    }
+  }
+}
+
+void StereoFusion::WriteTaskFusedPoints() {
+  for (size_t thread_id = 0; thread_id < task_fused_points_.size();
+       ++thread_id) {
+    ply_writer_->Write(task_fused_points_[thread_id]);
+    task_fused_points_[thread_id].clear();
+    for (const auto& visibility : task_fused_points_visibility_[thread_id]) {
+      visibility_writer_->Write(visibility);
+    }
+    task_fused_points_visibility_[thread_id].clear();
+  }
+}
+
+void StereoFusion::GatherFusedPoints() {
+  COLMAP_PROFILE_SCOPE("StereoFusion::GatherFusedPoints");
+  size_t total_fused_points = 0;
+  for (const auto& task_fused_points : task_fused_points_) {
+    total_fused_points += task_fused_points.size();
   }
 
   fused_points_.reserve(total_fused_points);
@@ -335,16 +673,6 @@ void StereoFusion::Run() {
         task_fused_points_visibility_[thread_id].end());
     task_fused_points_visibility_[thread_id].clear();
   }
-
-  if (fused_points_.empty()) {
-    LOG(WARNING)
-        << "Could not fuse any points. This is likely caused by "
-           "incorrect settings - filtering must be enabled for the last "
-           "call to patch match stereo.";
-  }
-
-  LOG(INFO) << "Number of fused points: " << fused_points_.size();
-  run_timer.PrintMinutes();
 }
 
 void StereoFusion::InitFusedPixelMask(int image_idx,
@@ -373,29 +701,77 @@ void StereoFusion::InitFusedPixelMask(int image_idx,
   }
 }
 
+size_t StereoFusion::NumFusionBytes() const {
+  size_t num_bytes = 0;
+  for (const auto& fused_pixel_mask : fused_pixel_masks_) {
+    num_bytes += fused_pixel_mask.GetNumBytes();
+  }
+  num_bytes += EstimateNumBytes(fused_points_) +
+               EstimateNumBytes(fused_points_visibility_);
+  for (const auto& visibility : fused_points_visibility_) {
+    num_bytes += EstimateNumBytes(visibility);
+  }
+  for (size_t i = 0; i < task_fused_points_.size(); ++i) {
+    num_bytes += EstimateNumBytes(task_fused_points_[i]) +
+                 EstimateNumBytes(task_fused_points_visibility_[i]);
+    for (const auto& visibility : task_fused_points_visibility_[i]) {
+      num_bytes += EstimateNumBytes(visibility);
+    }
+  }
+  for (const FusionScratch& scratch : task_scratch_) {
+    num_bytes += EstimateNumBytes(scratch.queue) +
+                 EstimateNumBytes(scratch.point_x) +
+                 EstimateNumBytes(scratch.point_y) +
+                 EstimateNumBytes(scratch.point_z) +
+                 EstimateNumBytes(scratch.point_nx) +
+                 EstimateNumBytes(scratch.point_ny) +
+                 EstimateNumBytes(scratch.point_nz) +
+                 EstimateNumBytes(scratch.point_r) +
+                 EstimateNumBytes(scratch.point_g) +
+                 EstimateNumBytes(scratch.point_b) +
+                 EstimateNumBytes(scratch.visibility) +
+                 EstimateNumBytes(scratch.is_visible);
+  }
+  return num_bytes;
+}
+
+void StereoFusion::UpdateMemoryUsage() const {
+  SetMemoryUsage("fusion", NumFusionBytes());
+  if (cached_workspace_) {
+    SetMemoryUsage("workspace", cached_workspace_->NumBytes());
+  }
+}
+
+void StereoFusion::FusionScratch::Clear() {
+  queue.clear();
+  point_x.clear();
+  point_y.clear();
+  point_z.clear();
+  point_nx.clear();
+  point_ny.clear();
+  point_nz.clear();
+  point_r.clear();
+  point_g.clear();
+  point_b.clear();
+  for (const int image_idx : visibility) {
+    is_visible[image_idx] = false;
+  }
+  visibility.clear();
+}
+
 void StereoFusion::Fuse(const int thread_id,
                         const int image_idx,
                         const int row,
                         const int col) {
-  // Next points to fuse.
-  std::vector<FusionData> fusion_queue;
+  FusionScratch& scratch = task_scratch_[thread_id];
+  scratch.Clear();
+
+  auto& fusion_queue = scratch.queue;
   fusion_queue.emplace_back(image_idx, row, col, 0);
 
   Eigen::Vector4f fused_ref_point = Eigen::Vector4f::Zero();
   Eigen::Vector3f fused_ref_normal = Eigen::Vector3f::Zero();
 
-  // Points of different pixels of the currently point to be fused.
-  std::vector<float> fused_point_x;
-  std::vector<float> fused_point_y;
-  std::vector<float> fused_point_z;
-  std::vector<float> fused_point_nx;
-  std::vector<float> fused_point_ny;
-  std::vector<float> fused_point_nz;
-  std::vector<uint8_t> fused_point_r;
-  std::vector<uint8_t> fused_point_g;
-  std::vector<uint8_t> fused_point_b;
-  std::unordered_set<int> fused_point_visibility;
-
   while (!fusion_queue.empty()) {
     const auto data = fusion_queue.back();
     const int image_idx = data.image_idx;
@@ -406,7 +782,7 @@ void StereoFusion::Fuse(const int thread_id,
     fusion_queue.pop_back();
 
     // Check if pixel already fused.
-    auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
+    const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
     if (fused_pixel_mask.Get(row, col) > 0) {
       continue;
     }
@@ -461,44 +837,18 @@ void StereoFusion::Fuse(const int thread_id,
         inv_P_.at(image_idx) *
         Eigen::Vector4f(col * depth, row * depth, depth, 1.0f);
 
-    // Read the color of the pixel.
-    BitmapColor<uint8_t> color;
-    const auto& bitmap_scale = bitmap_scales_.at(image_idx);
-    workspace_->GetBitmap(image_idx).InterpolateNearestNeighbor(
-        col / bitmap_scale.first, row / bitmap_scale.second, &color);
-
-    // Set the current pixel as visited.
-    fused_pixel_mask.Set(row, col, 1);
-
-    // Pixels out of bounds are filtered
-    if (xyz(0) < options_.bounding_box.first(0) ||
-        xyz(1) < options_.bounding_box.first(1) ||
-        xyz(2) < options_.bounding_box.first(2) ||
-        xyz(0) > options_.bounding_box.second(0) ||
-        xyz(1) > options_.bounding_box.second(1) ||
-        xyz(2) > options_.bounding_box.second(2)) {
+    if (!AddPixel(&scratch, image_idx, row, col, xyz, normal)) {
       continue;
     }
 
-    // Accumulate statistics for fused point.
-    fused_point_x.push_back(xyz(0));
-    fused_point_y.push_back(xyz(1));
-    fused_point_z.push_back(xyz(2));
-    fused_point_nx.push_back(normal(0));
-    fused_point_ny.push_back(normal(1));
-    fused_point_nz.push_back(normal(2));
-    fused_point_r.push_back(color.r);
-    fused_point_g.push_back(color.g);
-    fused_point_b.push_back(color.b);
-    fused_point_visibility.insert(image_idx);
-
     // Remember the first pixel as the reference.
     if (traversal_depth == 0) {
       fused_ref_point = Eigen::Vector4f(xyz(0), xyz(1), xyz(2), 1.0f);
       fused_ref_normal = normal;
     }
 
-    if (fused_point_x.size() >= static_cast<size_t>(options_.max_num_pixels)) {
+    if (scratch.point_x.size() >=
+        static_cast<size_t>(options_.max_num_pixels)) {
       break;
     }
 
@@ -529,6 +879,61 @@ void StereoFusion::Fuse(const int thread_id,
     }
   }
 
+  AddFusedPoint(thread_id);
+}
+
+bool StereoFusion::AddPixel(FusionScratch* scratch,
+                            const int image_idx,
+                            const int row,
+                            const int col,
+                            const Eigen::Vector3f& xyz,
+                            const Eigen::Vector3f& normal) {
+  // Set the current pixel as visited.
+  fused_pixel_masks_.at(image_idx).Set(row, col, 1);
+
+  // Pixels out of bounds are filtered
+  if (xyz(0) < bounding_box_.first(0) || xyz(1) < bounding_box_.first(1) ||
+      xyz(2) < bounding_box_.first(2) || xyz(0) > bounding_box_.second(0) ||
+      xyz(1) > bounding_box_.second(1) || xyz(2) > bounding_box_.second(2)) {
+    return false;
+  }
+
+  // Read the color of the pixel.
+  BitmapColor<uint8_t> color;
+  const auto& bitmap_scale = bitmap_scales_.at(image_idx);
+  workspace_->GetBitmap(image_idx).InterpolateNearestNeighbor(
+      col / bitmap_scale.first, row / bitmap_scale.second, &color);
+
+  // Accumulate statistics for fused point.
+  scratch->point_x.push_back(xyz(0));
+  scratch->point_y.push_back(xyz(1));
+  scratch->point_z.push_back(xyz(2));
+  scratch->point_nx.push_back(normal(0));
+  scratch->point_ny.push_back(normal(1));
+  scratch->point_nz.push_back(normal(2));
+  scratch->point_r.push_back(color.r);
+  scratch->point_g.push_back(color.g);
+  scratch->point_b.push_back(color.b);
+  if (!scratch->is_visible[image_idx]) {
+    scratch->is_visible[image_idx] = true;
+    scratch->visibility.push_back(image_idx);
+  }
+
+  return true;
+}
+
+void StereoFusion::AddFusedPoint(const int thread_id) {
+  FusionScratch& scratch = task_scratch_[thread_id];
+  auto& fused_point_x = scratch.point_x;
+  auto& fused_point_y = scratch.point_y;
+  auto& fused_point_z = scratch.point_z;
+  auto& fused_point_nx = scratch.point_nx;
+  auto& fused_point_ny = scratch.point_ny;
+  auto& fused_point_nz = scratch.point_nz;
+  auto& fused_point_r = scratch.point_r;
+  auto& fused_point_g = scratch.point_g;
+  auto& fused_point_b = scratch.point_b;
+
   const size_t num_pixels = fused_point_x.size();
   if (num_pixels >= static_cast<size_t>(options_.min_num_pixels)) {
     PlyPoint fused_point;
@@ -558,25 +963,216 @@ void StereoFusion::Fuse(const int thread_id,
         std::round(internal::Median(&fused_point_b)));
 
     task_fused_points_[thread_id].push_back(fused_point);
-    task_fused_points_visibility_[thread_id].emplace_back(
-        fused_point_visibility.begin(), fused_point_visibility.end());
+    task_fused_points_visibility_[thread_id].push_back(scratch.visibility);
+  }
+}
+
+#if defined(COLMAP_CUDA_ENABLED)
+
+void StereoFusion::InitFusionCuda() {
+  SetBestCudaDevice(CSVToVector<int>(options_.gpu_index).at(0));
+
+  FusionCuda::Options cuda_options;
+  cuda_options.max_squared_reproj_error = max_squared_reproj_error_;
+  cuda_options.max_depth_error = options_.max_depth_error;
+  cuda_options.min_cos_normal_error = min_cos_normal_error_;
+  for (int d = 0; d < 3; ++d) {
+    cuda_options.bbox_min[d] = bounding_box_.first(d);
+    cuda_options.bbox_max[d] = bounding_box_.second(d);
+  }
+  // Every source image contributes at most one candidate per pixel.
+  if (options_.max_traversal_depth > 1) {
+    size_t max_num_overlapping_images = 0;
+    for (const auto& image_idxs : overlapping_images_) {
+      max_num_overlapping_images =
+          std::max(max_num_overlapping_images, image_idxs.size());
+    }
+    cuda_options.max_num_candidates =
+        std::max(0,
+                 std::min<int>(max_num_overlapping_images,
+                               options_.max_num_pixels - 1));
+  }
+
+  std::vector<FusionCuda::Camera> cameras(P_.size());
+  for (size_t image_idx = 0; image_idx < cameras.size(); ++image_idx) {
+    Eigen::Map<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>>(
+        cameras[image_idx].P) = P_[image_idx];
+    Eigen::Map<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>>(
+        cameras[image_idx].inv_P) = inv_P_[image_idx];
+    Eigen::Map<Eigen::Matrix<float, 3, 3, Eigen::RowMajor>>(
+        cameras[image_idx].inv_R) = inv_R_[image_idx];
   }
+
+  fusion_cuda_ = std::make_unique<FusionCuda>(
+      cuda_options,
+      std::move(cameras),
+      [this](const int image_idx) -> const Mat<float>& {
+        return workspace_->GetDepthMap(image_idx);
+      },
+      [this](const int image_idx) -> const Mat<float>& {
+        return workspace_->GetNormalMap(image_idx);
+      });
+}
+
+void StereoFusion::FuseCuda(const int image_idx) {
+  COLMAP_PROFILE_SCOPE("StereoFusion::FuseCuda");
+  // The source images of the reference pixels are the same as the direct
+  // neighbors in the traversal of Fuse.
+  std::vector<int> src_image_idxs;
+  for (const auto src_image_idx : overlapping_images_.at(image_idx)) {
+    if (used_images_.at(src_image_idx) && !fused_images_.at(src_image_idx)) {
+      src_image_idxs.push_back(src_image_idx);
+    }
+  }
+
+  // Process the reference image in bands of rows, such that the candidates
+  // of a band use a bounded amount of memory.
+  const size_t kMaxNumBandBytes = 256 * 1024 * 1024;
+  const int width = depth_map_sizes_.at(image_idx).first;
+  const int height = depth_map_sizes_.at(image_idx).second;
+  const size_t num_row_bytes =
+      width * (2 * fusion_cuda_->MaxNumCandidates() + 1) * sizeof(int);
+  const int band_height = static_cast<int>(std::max<size_t>(
+      1, std::min<size_t>(height, kMaxNumBandBytes / num_row_bytes)));
+
+  const int thread_id = 0;
+  FusionScratch& scratch = task_scratch_[thread_id];
+  Mat<int> num_candidates;
+  Mat<int> candidates;
+  for (int row_begin = 0; row_begin < height; row_begin += band_height) {
+    const int row_end = std::min(height, row_begin + band_height);
+    fusion_cuda_->ComputeCandidates(image_idx,
+                                    src_image_idxs,
+                                    row_begin,
+                                    row_end,
+                                    &num_candidates,
+                                    &candidates);
+
+    // Greedily assign the candidates to points in row-major order of the
+    // reference pixels, which makes the result deterministic. The maps are
+    // looked up for every pixel, since the workspace cache may evict them.
+    for (int row = row_begin; row < row_end; ++row) {
+      for (int col = 0; col < width; ++col) {
+        if (fused_pixel_masks_.at(image_idx).Get(row, col) > 0) {
+          continue;
+        }
+
+        const float depth = workspace_->GetDepthMap(image_idx).Get(row, col);
+        if (depth <= 0.0f) {
+          continue;
+        }
+
+        scratch.Clear();
+        const auto& normal_map = workspace_->GetNormalMap(image_idx);
+        const Eigen::Vector3f xyz =
+            inv_P_.at(image_idx) *
+            Eigen::Vector4f(col * depth, row * depth, depth, 1.0f);
+        const Eigen::Vector3f normal =
+            inv_R_.at(image_idx) * Eigen::Vector3f(normal_map.Get(row, col, 0),
+                                                   normal_map.Get(row, col, 1),
+                                                   normal_map.Get(row, col, 2));
+        if (!AddPixel(&scratch, image_idx, row, col, xyz, normal)) {
+          continue;
+        }
+
+        const int band_row = row - row_begin;
+        const int num_pixel_candidates = num_candidates.Get(band_row, col);
+        for (int i = 0; i < num_pixel_candidates &&
+                        scratch.point_x.size() <
+                            static_cast<size_t>(options_.max_num_pixels);
+             ++i) {
+          const int src_image_idx =
+              src_image_idxs[candidates.Get(band_row, col, 2 * i)];
+          const int src_pixel_idx = candidates.Get(band_row, col, 2 * i + 1);
+          const int src_width = depth_map_sizes_[src_image_idx].first;
+          const int src_row = src_pixel_idx / src_width;
+          const int src_col = src_pixel_idx % src_width;
+          if (fused_pixel_masks_[src_image_idx].Get(src_row, src_col) > 0) {
+            continue;
+          }
+
+          const float src_depth =
+              workspace_->GetDepthMap(src_image_idx).Get(src_row, src_col);
+          const auto& src_normal_map = workspace_->GetNormalMap(src_image_idx);
+          const Eigen::Vector3f src_xyz =
+              inv_P_[src_image_idx] * Eigen::Vector4f(src_col * src_depth,
+                                                      src_row * src_depth,
+                                                      src_depth,
+                                                      1.0f);
+          const Eigen::Vector3f src_normal =
+              inv_R_[src_image_idx] *
+              Eigen::Vector3f(src_normal_map.Get(src_row, src_col, 0),
+                              src_normal_map.Get(src_row, src_col, 1),
+                              src_normal_map.Get(src_row, src_col, 2));
+          AddPixel(
+              &scratch, src_image_idx, src_row, src_col, src_xyz, src_normal);
+        }
+
+        AddFusedPoint(thread_id);
+      }
+    }
+  }
+}
+
+#endif  // COLMAP_CUDA_ENABLED
+
+PointsVisibilityWriter::PointsVisibilityWriter(const std::string& path)
+    : path_(path),
+      file_(path, std::ios::out | std::ios::binary),
+      num_points_(0) {
+  THROW_CHECK_FILE_OPEN(file_, path);
+  WriteBinaryLittleEndian<uint64_t>(&file_, num_points_);
+}
+
+size_t PointsVisibilityWriter::NumPoints() const { return num_points_; }
+
+void PointsVisibilityWriter::Write(const std::vector<int>& visibility) {
+  num_points_ += 1;
+  WriteBinaryLittleEndian<uint32_t>(&file_, visibility.size());
+  for (const auto& image_idx : visibility) {
+    WriteBinaryLittleEndian<uint32_t>(&file_, image_idx);
+  }
+}
+
+void PointsVisibilityWriter::Close() {
+  file_.seekp(0);
+  WriteBinaryLittleEndian<uint64_t>(&file_, num_points_);
+  file_.close();
+  THROW_CHECK(!file_.fail()) << "Failed to write visibility file: " << path_;
+}
+
+PointsVisibilityReader::PointsVisibilityReader(const std::string& path)
+    : path_(path),
+      file_(path, std::ios::in | std::ios::binary),
+      num_points_(0),
+      num_read_points_(0) {
+  THROW_CHECK_FILE_OPEN(file_, path);
+  num_points_ = ReadBinaryLittleEndian<uint64_t>(&file_);
+}
+
+size_t PointsVisibilityReader::NumPoints() const { return num_points_; }
+
+bool PointsVisibilityReader::Next(std::vector<int>* visibility) {
+  if (num_read_points_ >= num_points_) {
+    return false;
+  }
+  num_read_points_ += 1;
+  visibility->resize(ReadBinaryLittleEndian<uint32_t>(&file_));
+  for (auto& image_idx : *visibility) {
+    image_idx = ReadBinaryLittleEndian<uint32_t>(&file_);
+  }
+  THROW_CHECK(file_.good()) << "Failed to read visibility file: " << path_;
+  return true;
 }
 
 void WritePointsVisibility(
     const std::string& path,
     const std::vector<std::vector<int>>& points_visibility) {
-  std::fstream file(path, std::ios::out | std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
-
-  WriteBinaryLittleEndian<uint64_t>(&file, points_visibility.size());
-
+  PointsVisibilityWriter writer(path);
   for (const auto& visibility : points_visibility) {
-    WriteBinaryLittleEndian<uint32_t>(&file, visibility.size());
-    for (const auto& image_idx : visibility) {
-      WriteBinaryLittleEndian<uint32_t>(&file, image_idx);
-    }
+    writer.Write(visibility);
   }
+  writer.Close();
 }
 
 }  // namespace mvs
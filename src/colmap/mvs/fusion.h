@@ -40,9 +40,11 @@
 #include "colmap/util/cache.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/ply.h"
+#include "colmap/util/threading.h"
 
 #include <cfloat>
-#include <unordered_set>
+#include <fstream>
+#include <memory>
 #include <vector>
 
 #include <Eigen/Core>
@@ -50,6 +52,8 @@
 namespace colmap {
 namespace mvs {
 
+class FusionCuda;
+
 struct StereoFusionOptions {
   // Path for PNG masks. Same format expected as ImageReaderOptions.
   std::string mask_path = "";
@@ -91,6 +95,26 @@ struct StereoFusionOptions {
   // consume a lot of memory, if the consistency graph is dense.
   double cache_size = 32.0;
 
+  // The backend used to decode the images, see ImageReaderOptions.
+  std::string bitmap_decoder = "freeimage";
+
+  // Whether to run the consistency checks on the GPU. The GPU backend only
+  // fuses pixels that are directly consistent with the reference pixel, as
+  // for max_traversal_depth of 2, and assigns the pixels to points in a
+  // deterministic order independent of the number of threads.
+  bool use_gpu = false;
+
+  // Index of the GPU used for fusion. By default, the best GPU is selected.
+  std::string gpu_index = "-1";
+
+  // Maximum number of images per tile of the scene. If positive, the bounding
+  // box is recursively split at the median of the sparse points until every
+  // tile is observed by at most this number of images. The tiles are then
+  // fused one after another with only the data of their images in memory.
+  // Tiled fusion requires the fused points to be streamed to an output file,
+  // see StereoFusion::SetOutputPath.
+  int max_num_tile_images = -1;
+
   std::pair<Eigen::Vector3f, Eigen::Vector3f> bounding_box =
       std::make_pair(Eigen::Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX),
                      Eigen::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX));
@@ -102,6 +126,45 @@ struct StereoFusionOptions {
   void Print() const;
 };
 
+// Incrementally write the visibility of points to a file in the format of
+// WritePointsVisibility. The number of points is written on close.
+class PointsVisibilityWriter {
+ public:
+  explicit PointsVisibilityWriter(const std::string& path);
+
+  size_t NumPoints() const;
+
+  void Write(const std::vector<int>& visibility);
+
+  void Close();
+
+ private:
+  const std::string path_;
+  std::ofstream file_;
+  size_t num_points_;
+};
+
+// Incrementally read the visibility of points from a file in the format of
+// WritePointsVisibility, such that arbitrarily large files can be processed
+// with constant memory.
+class PointsVisibilityReader {
+ public:
+  explicit PointsVisibilityReader(const std::string& path);
+
+  // Number of points declared in the file.
+  size_t NumPoints() const;
+
+  // Read the visibility of the next point. Returns false if all points were
+  // read.
+  bool Next(std::vector<int>* visibility);
+
+ private:
+  const std::string path_;
+  std::ifstream file_;
+  size_t num_points_;
+  size_t num_read_points_;
+};
+
 class StereoFusion : public BaseController {
  public:
   StereoFusion(const StereoFusionOptions& options,
@@ -109,15 +172,37 @@ class StereoFusion : public BaseController {
                const std::string& workspace_format,
                const std::string& pmvs_option_name,
                const std::string& input_type);
+  ~StereoFusion();
 
+  // The fused points are empty if they were streamed to an output file.
   const std::vector<PlyPoint>& GetFusedPoints() const;
   const std::vector<std::vector<int>>& GetFusedPointsVisibility() const;
 
+  // If set before Run, the fused points are streamed to a binary PLY file at
+  // the given path and their visibility to the same path with the additional
+  // extension .vis, instead of being kept in memory.
+  void SetOutputPath(const std::string& path);
+
   void Run();
 
  private:
+  void InitImages(const std::vector<std::string>& image_names);
   void InitFusedPixelMask(int image_idx, size_t width, size_t height);
+  void FuseImages(ThreadPool* thread_pool);
+  // Asynchronously read the overlapping images of the given image.
+  void PrefetchImages(int image_idx);
+  void GatherFusedPoints();
+  void WriteTaskFusedPoints();
+  // Estimated memory of the pixel masks, the fusion buffers, and the fused
+  // points in bytes, excluding the workspace.
+  size_t NumFusionBytes() const;
+  // Report the memory of the fusion and the workspace to the metrics.
+  void UpdateMemoryUsage() const;
   void Fuse(int thread_id, int image_idx, int row, int col);
+#if defined(COLMAP_CUDA_ENABLED)
+  void InitFusionCuda();
+  void FuseCuda(int image_idx);
+#endif
 
   const StereoFusionOptions options_;
   const std::string workspace_path_;
@@ -128,6 +213,8 @@ class StereoFusion : public BaseController {
   const float min_cos_normal_error_;
 
   std::unique_ptr<Workspace> workspace_;
+  // Set if the workspace is cached, such that the inputs are prefetched.
+  CachedWorkspace* cached_workspace_ = nullptr;
   std::vector<char> used_images_;
   std::vector<char> fused_images_;
   std::vector<std::vector<int>> overlapping_images_;
@@ -139,6 +226,9 @@ class StereoFusion : public BaseController {
   std::vector<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> P_;
   std::vector<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> inv_P_;
   std::vector<Eigen::Matrix<float, 3, 3, Eigen::RowMajor>> inv_R_;
+  std::unique_ptr<FusionCuda> fusion_cuda_;
+  // Bounding box of the current tile or of the whole scene.
+  std::pair<Eigen::Vector3f, Eigen::Vector3f> bounding_box_;
 
   struct FusionData {
     int image_idx = kInvalidImageId;
@@ -155,14 +245,77 @@ class StereoFusion : public BaseController {
     }
   };
 
+  // Buffers of a fusion thread that are reused across calls of Fuse, such
+  // that fusing a pixel does not allocate memory once the buffers are grown.
+  struct FusionScratch {
+    // Next points to fuse.
+    std::vector<FusionData> queue;
+
+    // Points of different pixels of the currently point to be fused.
+    std::vector<float> point_x;
+    std::vector<float> point_y;
+    std::vector<float> point_z;
+    std::vector<float> point_nx;
+    std::vector<float> point_ny;
+    std::vector<float> point_nz;
+    std::vector<uint8_t> point_r;
+    std::vector<uint8_t> point_g;
+    std::vector<uint8_t> point_b;
+
+    // Images that observe the fused point and a flag for every image of the
+    // workspace whether it is contained in the visibility.
+    std::vector<int> visibility;
+    std::vector<char> is_visible;
+
+    void Clear();
+  };
+
+  // Mark the pixel as fused and add it to the points of the scratch, unless
+  // it is outside of the bounding box, in which case false is returned.
+  bool AddPixel(FusionScratch* scratch,
+                int image_idx,
+                int row,
+                int col,
+                const Eigen::Vector3f& xyz,
+                const Eigen::Vector3f& normal);
+
+  // Add the median of the points of the thread's scratch to the fused points,
+  // if sufficiently many pixels were fused.
+  void AddFusedPoint(int thread_id);
+
   // Already fused points.
   std::vector<PlyPoint> fused_points_;
   std::vector<std::vector<int>> fused_points_visibility_;
 
+  std::vector<FusionScratch> task_scratch_;
   std::vector<std::vector<PlyPoint>> task_fused_points_;
   std::vector<std::vector<std::vector<int>>> task_fused_points_visibility_;
+
+  // Writers of the fused points, if they are streamed to an output file.
+  std::string output_path_;
+  std::unique_ptr<PlyPointWriter> ply_writer_;
+  std::unique_ptr<PointsVisibilityWriter> visibility_writer_;
+};
+
+namespace internal {
+
+struct FusionTile {
+  std::pair<Eigen::Vector3f, Eigen::Vector3f> bounding_box;
+  // Sorted indices of the images that observe the sparse points in the tile.
+  std::vector<int> image_idxs;
 };
 
+// Recursively split the bounding box at the median of the sparse points along
+// the axis of their largest extent, until every tile is observed by at most
+// the given number of images or cannot be split further. The tiles partition
+// the bounding box.
+std::vector<FusionTile> ComputeFusionTiles(
+    const std::vector<Model::Point>& points,
+    const std::pair<Eigen::Vector3f, Eigen::Vector3f>& bounding_box,
+    int max_num_images);
+
+}  // namespace internal
+
 // Write the visiblity information into a binary file of the following format:
 //
 //    <num_points : uint64_t>
@@ -0,0 +1,312 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/fusion_cuda.h"
+
+#include "colmap/mvs/gpu_mat.h"
+#include "colmap/util/cudacc.h"
+
+#include <algorithm>
+
+#include <cuda_runtime.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+// Depth and normal map of a source image together with its camera.
+struct SrcImage {
+  const float* depth_map;
+  const float* normal_map;
+  size_t depth_map_pitch;
+  size_t normal_map_pitch;
+  int width;
+  int height;
+  FusionCuda::Camera camera;
+};
+
+size_t GetMaxNumBytes(const double cache_size) {
+  if (cache_size >= 0) {
+    return static_cast<size_t>(1024.0 * 1024.0 * 1024.0 * cache_size);
+  }
+  size_t free_num_bytes = 0;
+  size_t total_num_bytes = 0;
+  CUDA_SAFE_CALL(cudaMemGetInfo(&free_num_bytes, &total_num_bytes));
+  return free_num_bytes / 4;
+}
+
+__device__ inline float GetPitched(const float* data,
+                                   const size_t pitch,
+                                   const int height,
+                                   const int row,
+                                   const int col,
+                                   const int slice) {
+  const char* row_ptr = reinterpret_cast<const char*>(data) +
+                        (static_cast<size_t>(slice) * height + row) * pitch;
+  return reinterpret_cast<const float*>(row_ptr)[col];
+}
+
+// Multiply the row-major 3x4 matrix with the homogeneous point.
+__device__ inline void Mat34DotVec3(const float mat[12],
+                                    const float vec[3],
+                                    float result[3]) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2] + mat[3];
+  result[1] = mat[4] * vec[0] + mat[5] * vec[1] + mat[6] * vec[2] + mat[7];
+  result[2] = mat[8] * vec[0] + mat[9] * vec[1] + mat[10] * vec[2] + mat[11];
+}
+
+__device__ inline void Mat33DotVec3(const float mat[9],
+                                    const float vec[3],
+                                    float result[3]) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2];
+  result[1] = mat[3] * vec[0] + mat[4] * vec[1] + mat[5] * vec[2];
+  result[2] = mat[6] * vec[0] + mat[7] * vec[1] + mat[8] * vec[2];
+}
+
+// The checks are the same as for the neighbors of the reference pixel in the
+// CPU traversal of StereoFusion::Fuse.
+__global__ void ComputeCandidatesKernel(const GpuMat<float> ref_depth_map,
+                                        const GpuMat<float> ref_normal_map,
+                                        const FusionCuda::Camera ref_camera,
+                                        const SrcImage* src_images,
+                                        const int num_src_images,
+                                        const int row_begin,
+                                        const FusionCuda::Options options,
+                                        GpuMat<int> num_candidates,
+                                        GpuMat<int> candidates) {
+  const int band_row = blockDim.y * blockIdx.y + threadIdx.y;
+  const int col = blockDim.x * blockIdx.x + threadIdx.x;
+  if (col >= num_candidates.GetWidth() ||
+      band_row >= num_candidates.GetHeight()) {
+    return;
+  }
+
+  const int row = row_begin + band_row;
+  const float depth = ref_depth_map.Get(row, col);
+  if (depth <= 0.0f) {
+    num_candidates.Set(band_row, col, 0);
+    return;
+  }
+
+  const float ref_point[3] = {col * depth, row * depth, depth};
+  float xyz[3];
+  Mat34DotVec3(ref_camera.inv_P, ref_point, xyz);
+  for (int d = 0; d < 3; ++d) {
+    if (xyz[d] < options.bbox_min[d] || xyz[d] > options.bbox_max[d]) {
+      num_candidates.Set(band_row, col, 0);
+      return;
+    }
+  }
+
+  float ref_normal_cam[3];
+  ref_normal_map.GetSlice(row, col, ref_normal_cam);
+  float ref_normal[3];
+  Mat33DotVec3(ref_camera.inv_R, ref_normal_cam, ref_normal);
+
+  int num = 0;
+  for (int i = 0; i < num_src_images && num < options.max_num_candidates;
+       ++i) {
+    const SrcImage& src = src_images[i];
+
+    float proj[3];
+    Mat34DotVec3(src.camera.P, xyz, proj);
+    if (proj[2] <= 0.0f) {
+      continue;
+    }
+
+    const float proj_col = proj[0] / proj[2];
+    const float proj_row = proj[1] / proj[2];
+    const int src_col = static_cast<int>(roundf(proj_col));
+    const int src_row = static_cast<int>(roundf(proj_row));
+    if (src_col < 0 || src_row < 0 || src_col >= src.width ||
+        src_row >= src.height) {
+      continue;
+    }
+
+    const float src_depth = GetPitched(src.depth_map,
+                                       src.depth_map_pitch,
+                                       src.height,
+                                       src_row,
+                                       src_col,
+                                       0);
+    if (src_depth <= 0.0f) {
+      continue;
+    }
+
+    const float depth_error = fabsf((proj[2] - src_depth) / src_depth);
+    if (depth_error > options.max_depth_error) {
+      continue;
+    }
+
+    const float col_diff = proj_col - src_col;
+    const float row_diff = proj_row - src_row;
+    if (col_diff * col_diff + row_diff * row_diff >
+        options.max_squared_reproj_error) {
+      continue;
+    }
+
+    float src_normal_cam[3];
+    for (int d = 0; d < 3; ++d) {
+      src_normal_cam[d] = GetPitched(src.normal_map,
+                                     src.normal_map_pitch,
+                                     src.height,
+                                     src_row,
+                                     src_col,
+                                     d);
+    }
+    float src_normal[3];
+    Mat33DotVec3(src.camera.inv_R, src_normal_cam, src_normal);
+    const float cos_normal_error = ref_normal[0] * src_normal[0] +
+                                   ref_normal[1] * src_normal[1] +
+                                   ref_normal[2] * src_normal[2];
+    if (cos_normal_error < options.min_cos_normal_error) {
+      continue;
+    }
+
+    candidates.Set(band_row, col, 2 * num, i);
+    candidates.Set(band_row, col, 2 * num + 1, src_row * src.width + src_col);
+    num += 1;
+  }
+
+  num_candidates.Set(band_row, col, num);
+}
+
+}  // namespace
+
+size_t FusionCuda::CachedMaps::NumBytes() const {
+  return depth_map->GetPitch() * depth_map->GetHeight() *
+             depth_map->GetDepth() +
+         normal_map->GetPitch() * normal_map->GetHeight() *
+             normal_map->GetDepth();
+}
+
+FusionCuda::FusionCuda(const Options& options,
+                       std::vector<Camera> cameras,
+                       MapGetter depth_map_getter,
+                       MapGetter normal_map_getter)
+    : options_(options),
+      cameras_(std::move(cameras)),
+      depth_map_getter_(std::move(depth_map_getter)),
+      normal_map_getter_(std::move(normal_map_getter)),
+      cache_(GetMaxNumBytes(options.cache_size),
+             [this](const int image_idx) { return UploadMaps(image_idx); }) {
+  THROW_CHECK_GE(options_.max_num_candidates, 0);
+}
+
+void FusionCuda::ComputeCandidates(const int ref_image_idx,
+                                   const std::vector<int>& src_image_idxs,
+                                   const int row_begin,
+                                   const int row_end,
+                                   Mat<int>* num_candidates,
+                                   Mat<int>* candidates) {
+  // Keep references to the maps of all images, such that they stay alive
+  // during the kernel even if the cache evicts them.
+  const CachedMaps ref_maps = cache_.Get(ref_image_idx);
+  THROW_CHECK_GE(row_begin, 0);
+  THROW_CHECK_LT(row_begin, row_end);
+  THROW_CHECK_LE(row_end, ref_maps.depth_map->GetHeight());
+
+  std::vector<CachedMaps> src_maps;
+  src_maps.reserve(src_image_idxs.size());
+  std::vector<SrcImage> src_images;
+  src_images.reserve(src_image_idxs.size());
+  for (const int src_image_idx : src_image_idxs) {
+    const CachedMaps& maps = src_maps.emplace_back(cache_.Get(src_image_idx));
+    SrcImage& src_image = src_images.emplace_back();
+    src_image.depth_map = maps.depth_map->GetPtr();
+    src_image.normal_map = maps.normal_map->GetPtr();
+    src_image.depth_map_pitch = maps.depth_map->GetPitch();
+    src_image.normal_map_pitch = maps.normal_map->GetPitch();
+    src_image.width = maps.depth_map->GetWidth();
+    src_image.height = maps.depth_map->GetHeight();
+    src_image.camera = cameras_.at(src_image_idx);
+  }
+
+  SrcImage* src_images_device = nullptr;
+  const size_t src_images_num_bytes = src_images.size() * sizeof(SrcImage);
+  if (!src_images.empty()) {
+    CUDA_SAFE_CALL(cudaMalloc(&src_images_device, src_images_num_bytes));
+    CUDA_SAFE_CALL(cudaMemcpy(src_images_device,
+                              src_images.data(),
+                              src_images_num_bytes,
+                              cudaMemcpyHostToDevice));
+  }
+
+  const size_t width = ref_maps.depth_map->GetWidth();
+  const size_t height = row_end - row_begin;
+  const size_t depth = std::max(1, 2 * options_.max_num_candidates);
+  GpuMat<int> num_candidates_device(width, height);
+  GpuMat<int> candidates_device(width, height, depth);
+
+  const dim3 block_size(32, 16);
+  const dim3 grid_size((width - 1) / block_size.x + 1,
+                       (height - 1) / block_size.y + 1);
+  ComputeCandidatesKernel<<<grid_size, block_size>>>(
+      *ref_maps.depth_map,
+      *ref_maps.normal_map,
+      cameras_.at(ref_image_idx),
+      src_images_device,
+      static_cast<int>(src_images.size()),
+      row_begin,
+      options_,
+      num_candidates_device,
+      candidates_device);
+  CUDA_SYNC_AND_CHECK();
+
+  if (src_images_device != nullptr) {
+    CUDA_SAFE_CALL(cudaFree(src_images_device));
+  }
+
+  *num_candidates = Mat<int>(width, height, 1);
+  num_candidates_device.CopyToHost(num_candidates->GetPtr(),
+                                   width * sizeof(int));
+  *candidates = Mat<int>(width, height, depth);
+  candidates_device.CopyToHost(candidates->GetPtr(), width * sizeof(int));
+}
+
+FusionCuda::CachedMaps FusionCuda::UploadMaps(const int image_idx) const {
+  CachedMaps maps;
+  const Mat<float>& depth_map = depth_map_getter_(image_idx);
+  maps.depth_map = std::make_shared<GpuMat<float>>(depth_map.GetWidth(),
+                                                   depth_map.GetHeight());
+  maps.depth_map->CopyToDevice(depth_map.GetPtr(),
+                               depth_map.GetWidth() * sizeof(float));
+  const Mat<float>& normal_map = normal_map_getter_(image_idx);
+  THROW_CHECK_EQ(normal_map.GetWidth(), depth_map.GetWidth());
+  THROW_CHECK_EQ(normal_map.GetHeight(), depth_map.GetHeight());
+  THROW_CHECK_EQ(normal_map.GetDepth(), 3);
+  maps.normal_map = std::make_shared<GpuMat<float>>(
+      normal_map.GetWidth(), normal_map.GetHeight(), 3);
+  maps.normal_map->CopyToDevice(normal_map.GetPtr(),
+                                normal_map.GetWidth() * sizeof(float));
+  return maps;
+}
+
+}  // namespace mvs
+}  // namespace colmap
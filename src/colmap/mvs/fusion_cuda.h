@@ -0,0 +1,121 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/mvs/mat.h"
+#include "colmap/util/cache.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace colmap {
+namespace mvs {
+
+template <typename T>
+class GpuMat;
+
+// Consistency checks of the stereo fusion on the GPU. For every pixel of a
+// reference depth map, the 3D point is projected into the depth maps of the
+// source images and the projected source pixels with consistent depth,
+// reprojection error, and normal are collected as candidates. The greedy
+// assignment of the candidates to fused points is left to the caller, which
+// consumes them in a deterministic order on the CPU.
+class FusionCuda {
+ public:
+  struct Options {
+    // Thresholds of the consistency checks, see StereoFusionOptions.
+    float max_squared_reproj_error = 0.0f;
+    float max_depth_error = 0.0f;
+    float min_cos_normal_error = 1.0f;
+
+    // Reference pixels outside of the bounding box have no candidates.
+    float bbox_min[3] = {0.0f, 0.0f, 0.0f};
+    float bbox_max[3] = {0.0f, 0.0f, 0.0f};
+
+    // Maximum number of candidates per reference pixel.
+    int max_num_candidates = 0;
+
+    // Size in gigabytes of the cache for depth and normal maps in GPU
+    // memory. If negative, a quarter of the free memory is used.
+    double cache_size = -1.0;
+  };
+
+  // Projection matrices for the pixel coordinates of the depth map and the
+  // rotation from camera to world frame, all in row-major order.
+  struct Camera {
+    float P[12];
+    float inv_P[12];
+    float inv_R[9];
+  };
+
+  // The getters are called for images whose depth and normal map are not
+  // yet cached on the GPU. All methods must be called on the device that was
+  // current when the object was created.
+  using MapGetter = std::function<const Mat<float>&(int image_idx)>;
+  FusionCuda(const Options& options,
+             std::vector<Camera> cameras,
+             MapGetter depth_map_getter,
+             MapGetter normal_map_getter);
+
+  inline int MaxNumCandidates() const { return options_.max_num_candidates; }
+
+  // Compute the candidates of the reference pixels in the rows
+  // [row_begin, row_end) of the reference image. For the pixel in band row
+  // row - row_begin and column col, num_candidates(row - row_begin, col)
+  // holds the number of candidates and candidates(row - row_begin, col, 2 * i)
+  // and candidates(row - row_begin, col, 2 * i + 1) hold the index into
+  // src_image_idxs and the row-major pixel index of the i-th candidate.
+  // Candidates are ordered by the index of their source image.
+  void ComputeCandidates(int ref_image_idx,
+                         const std::vector<int>& src_image_idxs,
+                         int row_begin,
+                         int row_end,
+                         Mat<int>* num_candidates,
+                         Mat<int>* candidates);
+
+ private:
+  struct CachedMaps {
+    size_t NumBytes() const;
+    std::shared_ptr<GpuMat<float>> depth_map;
+    std::shared_ptr<GpuMat<float>> normal_map;
+  };
+
+  CachedMaps UploadMaps(int image_idx) const;
+
+  const Options options_;
+  const std::vector<Camera> cameras_;
+  const MapGetter depth_map_getter_;
+  const MapGetter normal_map_getter_;
+  MemoryConstrainedLRUCache<int, CachedMaps> cache_;
+};
+
+}  // namespace mvs
+}  // namespace colmap
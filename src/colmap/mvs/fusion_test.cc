@@ -0,0 +1,134 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/fusion.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+// Points on a line along the x-axis, where every point is observed by the two
+// images closest to it.
+std::vector<Model::Point> CreateLinePoints(const int num_images) {
+  std::vector<Model::Point> points;
+  for (int image_idx = 0; image_idx + 1 < num_images; ++image_idx) {
+    for (int i = 0; i < 10; ++i) {
+      Model::Point& point = points.emplace_back();
+      point.x = image_idx + 0.1f * i;
+      point.y = 0.01f * i;
+      point.track = {image_idx, image_idx + 1};
+    }
+  }
+  return points;
+}
+
+const std::pair<Eigen::Vector3f, Eigen::Vector3f> kInfiniteBoundingBox =
+    std::make_pair(Eigen::Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+                   Eigen::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX));
+
+TEST(ComputeFusionTiles, SingleTile) {
+  const std::vector<Model::Point> points = CreateLinePoints(4);
+  const std::vector<internal::FusionTile> tiles =
+      internal::ComputeFusionTiles(points, kInfiniteBoundingBox, 4);
+  ASSERT_EQ(tiles.size(), 1);
+  EXPECT_EQ(tiles[0].bounding_box.first, kInfiniteBoundingBox.first);
+  EXPECT_EQ(tiles[0].bounding_box.second, kInfiniteBoundingBox.second);
+  EXPECT_EQ(tiles[0].image_idxs, std::vector<int>({0, 1, 2, 3}));
+}
+
+TEST(ComputeFusionTiles, Empty) {
+  const std::vector<internal::FusionTile> tiles =
+      internal::ComputeFusionTiles({}, kInfiniteBoundingBox, 1);
+  ASSERT_EQ(tiles.size(), 1);
+  EXPECT_TRUE(tiles[0].image_idxs.empty());
+}
+
+TEST(ComputeFusionTiles, Split) {
+  const int kNumImages = 16;
+  const int kMaxNumImages = 3;
+  const std::vector<Model::Point> points = CreateLinePoints(kNumImages);
+  const std::vector<internal::FusionTile> tiles =
+      internal::ComputeFusionTiles(points, kInfiniteBoundingBox, kMaxNumImages);
+  EXPECT_GT(tiles.size(), 1);
+
+  std::vector<int> num_point_tiles(points.size(), 0);
+  for (const auto& tile : tiles) {
+    EXPECT_LE(tile.image_idxs.size(), kMaxNumImages);
+    EXPECT_TRUE(std::is_sorted(tile.image_idxs.begin(), tile.image_idxs.end()));
+    // The line is only split along the x-axis.
+    EXPECT_EQ(tile.bounding_box.first.tail<2>(),
+              kInfiniteBoundingBox.first.tail<2>());
+    EXPECT_EQ(tile.bounding_box.second.tail<2>(),
+              kInfiniteBoundingBox.second.tail<2>());
+    for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+      const float x = points[point_idx].x;
+      if (x >= tile.bounding_box.first.x() &&
+          x < tile.bounding_box.second.x()) {
+        num_point_tiles[point_idx] += 1;
+        for (const int image_idx : points[point_idx].track) {
+          EXPECT_TRUE(std::binary_search(
+              tile.image_idxs.begin(), tile.image_idxs.end(), image_idx));
+        }
+      }
+    }
+  }
+
+  for (const int num_tiles : num_point_tiles) {
+    EXPECT_EQ(num_tiles, 1);
+  }
+}
+
+TEST(ComputeFusionTiles, BoundingBox) {
+  const std::vector<Model::Point> points = CreateLinePoints(16);
+  const std::pair<Eigen::Vector3f, Eigen::Vector3f> bounding_box =
+      std::make_pair(Eigen::Vector3f(-1, -1, -1), Eigen::Vector3f(1.95, 1, 1));
+  const std::vector<internal::FusionTile> tiles =
+      internal::ComputeFusionTiles(points, bounding_box, 16);
+  ASSERT_EQ(tiles.size(), 1);
+  EXPECT_EQ(tiles[0].bounding_box.first, bounding_box.first);
+  EXPECT_EQ(tiles[0].bounding_box.second, bounding_box.second);
+  EXPECT_EQ(tiles[0].image_idxs, std::vector<int>({0, 1, 2}));
+}
+
+TEST(ComputeFusionTiles, Degenerate) {
+  std::vector<Model::Point> points(10);
+  for (size_t i = 0; i < points.size(); ++i) {
+    points[i].track = {static_cast<int>(i)};
+  }
+  const std::vector<internal::FusionTile> tiles =
+      internal::ComputeFusionTiles(points, kInfiniteBoundingBox, 2);
+  ASSERT_EQ(tiles.size(), 1);
+  EXPECT_EQ(tiles[0].image_idxs.size(), 10);
+}
+
+}  // namespace
+}  // namespace mvs
+}  // namespace colmap
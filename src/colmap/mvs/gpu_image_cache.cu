@@ -0,0 +1,166 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/mvs/gpu_image_cache.h"
+
+#include "colmap/util/cudacc.h"
+
+#include <cuda_runtime.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+size_t GetMaxNumBytes(const double cache_size) {
+  if (cache_size >= 0) {
+    return static_cast<size_t>(1024.0 * 1024.0 * 1024.0 * cache_size);
+  }
+  size_t free_num_bytes = 0;
+  size_t total_num_bytes = 0;
+  CUDA_SAFE_CALL(cudaMemGetInfo(&free_num_bytes, &total_num_bytes));
+  return free_num_bytes / 4;
+}
+
+template <typename T>
+size_t GetNumBytes(const GpuMat<T>& mat) {
+  return mat.GetPitch() * mat.GetHeight() * mat.GetDepth();
+}
+
+// Copy the first slice of the source to the given slice of the target.
+template <typename T>
+void CopyToSlice(const GpuMat<T>& src, const size_t slice, GpuMat<T>* dst) {
+  THROW_CHECK_LE(src.GetWidth(), dst->GetWidth());
+  THROW_CHECK_LE(src.GetHeight(), dst->GetHeight());
+  THROW_CHECK_LT(slice, dst->GetDepth());
+  uint8_t* dst_ptr = reinterpret_cast<uint8_t*>(dst->GetPtr()) +
+                     slice * dst->GetHeight() * dst->GetPitch();
+  CUDA_SAFE_CALL(cudaMemcpy2D(dst_ptr,
+                              dst->GetPitch(),
+                              src.GetPtr(),
+                              src.GetPitch(),
+                              src.GetWidth() * sizeof(T),
+                              src.GetHeight(),
+                              cudaMemcpyDeviceToDevice));
+}
+
+}  // namespace
+
+GpuImageCache::CachedImage::CachedImage(CachedImage&& other) noexcept {
+  num_bytes = other.num_bytes;
+  image = std::move(other.image);
+  depth_map = std::move(other.depth_map);
+}
+
+GpuImageCache::CachedImage& GpuImageCache::CachedImage::operator=(
+    CachedImage&& other) noexcept {
+  if (this != &other) {
+    num_bytes = other.num_bytes;
+    image = std::move(other.image);
+    depth_map = std::move(other.depth_map);
+  }
+  return *this;
+}
+
+GpuImageCache::GpuImageCache(const double cache_size)
+    : cache_(GetMaxNumBytes(cache_size),
+             [](const int) { return CachedImage(); }) {}
+
+size_t GpuImageCache::NumBytes() const { return cache_.NumBytes(); }
+
+size_t GpuImageCache::MaxNumBytes() const { return cache_.MaxNumBytes(); }
+
+std::unique_ptr<GpuMat<uint8_t>> GpuImageCache::StackImages(
+    const std::vector<int>& image_idxs,
+    const std::vector<Image>& images,
+    const size_t width,
+    const size_t height) {
+  auto stacked_images =
+      std::make_unique<GpuMat<uint8_t>>(width, height, image_idxs.size());
+  stacked_images->FillWithScalar(0);
+  for (size_t i = 0; i < image_idxs.size(); ++i) {
+    const int image_idx = image_idxs[i];
+    CopyToSlice(GetImage(image_idx, images.at(image_idx)),
+                i,
+                stacked_images.get());
+  }
+  return stacked_images;
+}
+
+std::unique_ptr<GpuMat<float>> GpuImageCache::StackDepthMaps(
+    const std::vector<int>& image_idxs,
+    const std::vector<DepthMap>& depth_maps,
+    const size_t width,
+    const size_t height) {
+  auto stacked_depth_maps =
+      std::make_unique<GpuMat<float>>(width, height, image_idxs.size());
+  stacked_depth_maps->FillWithScalar(0.0f);
+  for (size_t i = 0; i < image_idxs.size(); ++i) {
+    const int image_idx = image_idxs[i];
+    CopyToSlice(GetDepthMap(image_idx, depth_maps.at(image_idx)),
+                i,
+                stacked_depth_maps.get());
+  }
+  return stacked_depth_maps;
+}
+
+void GpuImageCache::Clear() { cache_.Clear(); }
+
+const GpuMat<uint8_t>& GpuImageCache::GetImage(const int image_idx,
+                                               const Image& image) {
+  auto& cached_image = cache_.GetMutable(image_idx);
+  if (!cached_image.image) {
+    const std::vector<uint8_t> image_array =
+        image.GetBitmap().ConvertToRowMajorArray();
+    cached_image.image = std::make_unique<GpuMat<uint8_t>>(image.GetWidth(),
+                                                           image.GetHeight());
+    cached_image.image->CopyToDevice(image_array.data(),
+                                     image.GetWidth() * sizeof(uint8_t));
+    cached_image.num_bytes += GetNumBytes(*cached_image.image);
+    cache_.UpdateNumBytes(image_idx);
+  }
+  return *cached_image.image;
+}
+
+const GpuMat<float>& GpuImageCache::GetDepthMap(const int image_idx,
+                                                const DepthMap& depth_map) {
+  auto& cached_image = cache_.GetMutable(image_idx);
+  if (!cached_image.depth_map) {
+    cached_image.depth_map = std::make_unique<GpuMat<float>>(
+        depth_map.GetWidth(), depth_map.GetHeight());
+    cached_image.depth_map->CopyToDevice(
+        depth_map.GetPtr(), depth_map.GetWidth() * sizeof(float));
+    cached_image.num_bytes += GetNumBytes(*cached_image.depth_map);
+    cache_.UpdateNumBytes(image_idx);
+  }
+  return *cached_image.depth_map;
+}
+
+}  // namespace mvs
+}  // namespace colmap
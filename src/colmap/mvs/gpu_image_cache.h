@@ -0,0 +1,97 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/mvs/depth_map.h"
+#include "colmap/mvs/gpu_mat.h"
+#include "colmap/mvs/image.h"
+#include "colmap/util/cache.h"
+#include "colmap/util/types.h"
+
+#include <memory>
+#include <vector>
+
+namespace colmap {
+namespace mvs {
+
+// Least recently used cache of source images and depth maps in GPU memory.
+// Neighboring patch match problems share most of their source images, which
+// are then copied on the device instead of being uploaded again. The cache is
+// not thread-safe and all methods must be called on the device that was
+// current when the cache was created.
+class GpuImageCache {
+ public:
+  // Create a cache with the given size in gigabytes. If negative, a quarter
+  // of the free memory of the current device is used.
+  explicit GpuImageCache(double cache_size);
+
+  size_t NumBytes() const;
+  size_t MaxNumBytes() const;
+
+  // Stack the images or depth maps with the given indices into the slices of
+  // a new matrix of the given size, in which the pixels outside of the
+  // smaller images are zero. Images that are not yet cached are uploaded.
+  std::unique_ptr<GpuMat<uint8_t>> StackImages(
+      const std::vector<int>& image_idxs,
+      const std::vector<Image>& images,
+      size_t width,
+      size_t height);
+  std::unique_ptr<GpuMat<float>> StackDepthMaps(
+      const std::vector<int>& image_idxs,
+      const std::vector<DepthMap>& depth_maps,
+      size_t width,
+      size_t height);
+
+  void Clear();
+
+ private:
+  const GpuMat<uint8_t>& GetImage(int image_idx, const Image& image);
+  const GpuMat<float>& GetDepthMap(int image_idx, const DepthMap& depth_map);
+
+  class CachedImage {
+   public:
+    CachedImage() {}
+    CachedImage(CachedImage&& other) noexcept;
+    CachedImage& operator=(CachedImage&& other) noexcept;
+    inline size_t NumBytes() const { return num_bytes; }
+    size_t num_bytes = 0;
+    std::unique_ptr<GpuMat<uint8_t>> image;
+    std::unique_ptr<GpuMat<float>> depth_map;
+
+   private:
+    NON_COPYABLE(CachedImage)
+  };
+
+  MemoryConstrainedLRUCache<int, CachedImage> cache_;
+};
+
+}  // namespace mvs
+}  // namespace colmap
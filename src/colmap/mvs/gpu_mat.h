@@ -34,6 +34,7 @@
 #include "colmap/mvs/cuda_transpose.h"
 #include "colmap/mvs/mat.h"
 #include "colmap/util/cuda.h"
+#include "colmap/util/cuda_memory_pool.h"
 #include "colmap/util/cudacc.h"
 #include "colmap/util/endian.h"
 
@@ -175,10 +176,12 @@ GpuMat<T>::GpuMat(const size_t width, const size_t height, const size_t depth)
       width_(width),
       height_(height),
       depth_(depth) {
-  CUDA_SAFE_CALL(cudaMallocPitch(
-      (void**)&array_ptr_, &pitch_, width_ * sizeof(T), height_ * depth_));
-
-  array_ = std::shared_ptr<T>(array_ptr_, cudaFree);
+  // The memory is returned to the pool and reused by later matrices of
+  // similar size, when the last copy of this matrix is destroyed.
+  const std::shared_ptr<void> memory = CudaMemoryPool::Get().AllocatePitched(
+      width_ * sizeof(T), height_ * depth_, &pitch_);
+  array_ = std::shared_ptr<T>(memory, static_cast<T*>(memory.get()));
+  array_ptr_ = array_.get();
 
   ComputeCudaConfig();
 }
@@ -283,14 +286,16 @@ void GpuMat<T>::FillWithScalar(const T value) {
 
 template <typename T>
 void GpuMat<T>::FillWithVector(const T* values) {
-  T* values_device;
-  CUDA_SAFE_CALL(cudaMalloc((void**)&values_device, depth_ * sizeof(T)));
+  size_t values_pitch;
+  const std::shared_ptr<void> values_memory =
+      CudaMemoryPool::Get().AllocatePitched(
+          depth_ * sizeof(T), 1, &values_pitch);
+  T* values_device = static_cast<T*>(values_memory.get());
   CUDA_SAFE_CALL(cudaMemcpy(
       values_device, values, depth_ * sizeof(T), cudaMemcpyHostToDevice));
   internal::FillWithVectorKernel<T>
       <<<gridSize_, blockSize_>>>(values_device, *this);
   CUDA_SYNC_AND_CHECK();
-  CUDA_SAFE_CALL(cudaFree(values_device));
 }
 
 template <typename T>
@@ -34,6 +34,7 @@
 #include "colmap/math/math.h"
 #include "colmap/mvs/gpu_mat.h"
 #include "colmap/mvs/gpu_mat_prng.h"
+#include "colmap/util/cuda_memory_pool.h"
 
 #include <gtest/gtest.h>
 
@@ -202,5 +203,40 @@ TEST(GpuMat, Rotate) {
   }
 }
 
+TEST(GpuMat, ReusesPooledMemory) {
+  CudaMemoryPool::Get().Clear();
+  const float* ptr = nullptr;
+  {
+    GpuMat<float> array(100, 100, 2);
+    ptr = array.GetPtr();
+    EXPECT_EQ(CudaMemoryPool::Get().NumCachedBytes(), 0);
+  }
+  EXPECT_GT(CudaMemoryPool::Get().NumCachedBytes(), 0);
+
+  // Similar sizes fall into the same size class.
+  GpuMat<float> array(101, 99, 2);
+  EXPECT_EQ(array.GetPtr(), ptr);
+  EXPECT_EQ(CudaMemoryPool::Get().NumCachedBytes(), 0);
+
+  // The reused memory is fully functional.
+  array.FillWithScalar(1.0f);
+  const Mat<float> mat = array.CopyToMat();
+  for (size_t i = 0; i < mat.GetNumBytes() / sizeof(float); ++i) {
+    EXPECT_EQ(mat.GetPtr()[i], 1.0f);
+  }
+
+  CudaMemoryPool::Get().Clear();
+  EXPECT_EQ(CudaMemoryPool::Get().NumCachedBytes(), 0);
+}
+
+TEST(GpuMat, PooledMemoryRespectsLimit) {
+  CudaMemoryPool::Get().Clear();
+  const size_t max_cached_bytes = CudaMemoryPool::Get().MaxCachedBytes();
+  CudaMemoryPool::Get().SetMaxCachedBytes(0);
+  { GpuMat<float> array(100, 100); }
+  EXPECT_EQ(CudaMemoryPool::Get().NumCachedBytes(), 0);
+  CudaMemoryPool::Get().SetMaxCachedBytes(max_cached_bytes);
+}
+
 }  // namespace mvs
 }  // namespace colmap
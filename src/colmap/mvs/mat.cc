@@ -0,0 +1,189 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/mvs/mat.h"
+
+#include "colmap/util/string.h"
+
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include <Eigen/Core>
+#include <lz4.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+uint16_t FloatToHalf(const float value) {
+  return Eigen::numext::bit_cast<uint16_t>(Eigen::half(value));
+}
+
+float HalfToFloat(const uint16_t value) {
+  return static_cast<float>(Eigen::numext::bit_cast<Eigen::half>(value));
+}
+
+}  // namespace
+
+std::string MatFileFormatToString(const MatFileFormat format) {
+  switch (format) {
+    case MatFileFormat::FLOAT:
+      return "float";
+    case MatFileFormat::HALF:
+      return "half";
+    case MatFileFormat::HALF_LZ4:
+      return "half_lz4";
+  }
+  return "";
+}
+
+MatFileFormat MatFileFormatFromString(const std::string& name) {
+  std::string lower_name = name;
+  StringToLower(&lower_name);
+  for (const MatFileFormat format : {MatFileFormat::FLOAT,
+                                     MatFileFormat::HALF,
+                                     MatFileFormat::HALF_LZ4}) {
+    if (lower_name == MatFileFormatToString(format)) {
+      return format;
+    }
+  }
+  throw std::invalid_argument(
+      StringPrintf("Unknown matrix file format: %s", name.c_str()));
+}
+
+namespace internal {
+
+MatFileHeader ReadMatFileHeader(const char* data, const size_t num_bytes) {
+  MatFileHeader header;
+  size_t pos = 0;
+  auto ReadField = [&]() {
+    const size_t begin = pos;
+    while (pos < num_bytes && data[pos] != '&') {
+      ++pos;
+    }
+    THROW_CHECK_LT(pos, num_bytes) << "Invalid matrix header";
+    return std::string(data + begin, data + pos++);
+  };
+  auto ReadDimension = [&]() {
+    const std::string field = ReadField();
+    THROW_CHECK(!field.empty() &&
+                field.find_first_not_of("0123456789") == std::string::npos)
+        << "Invalid matrix dimension: " << field;
+    return static_cast<size_t>(std::stoull(field));
+  };
+
+  // Files in the half precision formats start with the name of the format,
+  // whereas float files directly start with the width.
+  if (num_bytes > 0 && !std::isdigit(static_cast<unsigned char>(data[0]))) {
+    header.format = MatFileFormatFromString(ReadField());
+  }
+  header.width = ReadDimension();
+  header.height = ReadDimension();
+  header.depth = ReadDimension();
+  header.num_bytes = pos;
+  return header;
+}
+
+// The compressed format stores the low and high bytes of all values in two
+// separate planes, which compresses considerably better than the interleaved
+// values, because the high bytes of neighboring values are mostly equal.
+void WriteHalfFloats(std::ostream* stream,
+                     const std::vector<float>& data,
+                     const bool compress) {
+  if (!compress) {
+    for (const float value : data) {
+      WriteBinaryLittleEndian<uint16_t>(stream, FloatToHalf(value));
+    }
+    return;
+  }
+
+  const size_t num_values = data.size();
+  std::vector<char> planes(2 * num_values);
+  for (size_t i = 0; i < num_values; ++i) {
+    const uint16_t value = FloatToHalf(data[i]);
+    planes[i] = static_cast<char>(value & 0xFF);
+    planes[num_values + i] = static_cast<char>(value >> 8);
+  }
+
+  THROW_CHECK_LE(planes.size(), static_cast<size_t>(LZ4_MAX_INPUT_SIZE));
+  std::vector<char> compressed_planes(
+      LZ4_compressBound(static_cast<int>(planes.size())));
+  const int num_compressed_bytes =
+      LZ4_compress_default(planes.data(),
+                           compressed_planes.data(),
+                           static_cast<int>(planes.size()),
+                           static_cast<int>(compressed_planes.size()));
+  THROW_CHECK_GT(num_compressed_bytes, 0);
+  WriteBinaryLittleEndian<uint64_t>(stream, num_compressed_bytes);
+  stream->write(compressed_planes.data(), num_compressed_bytes);
+}
+
+void ReadHalfFloats(const char* data,
+                    const size_t num_bytes,
+                    const bool compressed,
+                    std::vector<float>* values) {
+  const size_t num_values = values->size();
+  if (!compressed) {
+    THROW_CHECK_GE(num_bytes, 2 * num_values) << "Truncated matrix";
+    for (size_t i = 0; i < num_values; ++i) {
+      uint16_t value;
+      std::memcpy(&value, data + 2 * i, sizeof(uint16_t));
+      (*values)[i] = HalfToFloat(LittleEndianToNative(value));
+    }
+    return;
+  }
+
+  THROW_CHECK_LE(2 * num_values, static_cast<size_t>(LZ4_MAX_INPUT_SIZE));
+  THROW_CHECK_GE(num_bytes, sizeof(uint64_t)) << "Truncated matrix";
+  uint64_t num_compressed_bytes;
+  std::memcpy(&num_compressed_bytes, data, sizeof(uint64_t));
+  num_compressed_bytes = LittleEndianToNative(num_compressed_bytes);
+  THROW_CHECK_LE(num_compressed_bytes, num_bytes - sizeof(uint64_t))
+      << "Truncated matrix";
+
+  std::vector<char> planes(2 * num_values);
+  const int num_decompressed_bytes =
+      LZ4_decompress_safe(data + sizeof(uint64_t),
+                          planes.data(),
+                          static_cast<int>(num_compressed_bytes),
+                          static_cast<int>(planes.size()));
+  THROW_CHECK_EQ(num_decompressed_bytes, static_cast<int>(planes.size()))
+      << "Corrupt compressed matrix";
+  for (size_t i = 0; i < num_values; ++i) {
+    const uint16_t low = static_cast<uint8_t>(planes[i]);
+    const uint16_t high = static_cast<uint8_t>(planes[num_values + i]);
+    (*values)[i] = HalfToFloat(static_cast<uint16_t>(low | (high << 8)));
+  }
+}
+
+}  // namespace internal
+}  // namespace mvs
+}  // namespace colmap
@@ -31,8 +31,10 @@
 
 #include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/misc.h"
 
+#include <cstring>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -40,6 +42,60 @@
 namespace colmap {
 namespace mvs {
 
+// On-disk formats of matrices. The half precision formats store float
+// matrices with 16 bits per element, i.e., with a relative precision of about
+// 5e-4, which is sufficient for depth and normal maps and halves the file
+// size. HALF_LZ4 additionally compresses the half precision values
+// losslessly. Mat::Read detects the format of a file automatically.
+enum class MatFileFormat {
+  FLOAT,
+  HALF,
+  HALF_LZ4,
+};
+
+std::string MatFileFormatToString(MatFileFormat format);
+MatFileFormat MatFileFormatFromString(const std::string& name);
+
+namespace internal {
+
+struct MatFileHeader {
+  MatFileFormat format = MatFileFormat::FLOAT;
+  size_t width = 0;
+  size_t height = 0;
+  size_t depth = 0;
+  // Number of bytes of the header, after which the values start.
+  size_t num_bytes = 0;
+};
+
+// Parse the text header at the start of the given file data.
+MatFileHeader ReadMatFileHeader(const char* data, size_t num_bytes);
+
+void WriteHalfFloats(std::ostream* stream,
+                     const std::vector<float>& data,
+                     bool compress);
+// Decode the half precision values from the file data after the header.
+void ReadHalfFloats(const char* data,
+                    size_t num_bytes,
+                    bool compressed,
+                    std::vector<float>* values);
+
+template <typename T>
+void WriteHalfFloats(std::ostream* stream,
+                     const std::vector<T>& data,
+                     bool compress) {
+  LOG(FATAL_THROW) << "Half precision is only supported for float matrices";
+}
+
+template <typename T>
+void ReadHalfFloats(const char* data,
+                    size_t num_bytes,
+                    bool compressed,
+                    std::vector<T>* values) {
+  LOG(FATAL_THROW) << "Half precision is only supported for float matrices";
+}
+
+}  // namespace internal
+
 template <typename T>
 class Mat {
  public:
@@ -64,8 +120,12 @@ class Mat {
 
   void Fill(T value);
 
+  // Read the matrix through a memory mapping, such that the values are
+  // copied once from the page cache and repeated reads of the same file, e.g.,
+  // after eviction from a cache, do not access the disk again.
   void Read(const std::string& path);
-  void Write(const std::string& path) const;
+  void Write(const std::string& path,
+             MatFileFormat format = MatFileFormat::FLOAT) const;
 
  protected:
   size_t width_ = 0;
@@ -154,27 +214,49 @@ void Mat<T>::Fill(const T value) {
 
 template <typename T>
 void Mat<T>::Read(const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
-
-  char unused_char;
-  file >> width_ >> unused_char >> height_ >> unused_char >> depth_ >>
-      unused_char;
-  THROW_CHECK_GT(width_, 0) << path;
-  THROW_CHECK_GT(height_, 0) << path;
-  THROW_CHECK_GT(depth_, 0) << path;
+  const MappedFile file(path);
+  const internal::MatFileHeader header =
+      internal::ReadMatFileHeader(file.Data(), file.NumBytes());
+  THROW_CHECK_GT(header.width, 0) << path;
+  THROW_CHECK_GT(header.height, 0) << path;
+  THROW_CHECK_GT(header.depth, 0) << path;
+  width_ = header.width;
+  height_ = header.height;
+  depth_ = header.depth;
   data_.resize(width_ * height_ * depth_);
 
-  ReadBinaryLittleEndian<T>(&file, &data_);
-  file.close();
+  const char* values = file.Data() + header.num_bytes;
+  const size_t num_bytes = file.NumBytes() - header.num_bytes;
+  if (header.format == MatFileFormat::FLOAT) {
+    THROW_CHECK_GE(num_bytes, data_.size() * sizeof(T))
+        << "Truncated file " << path;
+    std::memcpy(data_.data(), values, data_.size() * sizeof(T));
+    if (IsBigEndian()) {
+      for (T& value : data_) {
+        value = LittleEndianToNative(value);
+      }
+    }
+  } else {
+    internal::ReadHalfFloats(
+        values, num_bytes, header.format == MatFileFormat::HALF_LZ4, &data_);
+  }
 }
 
 template <typename T>
-void Mat<T>::Write(const std::string& path) const {
+void Mat<T>::Write(const std::string& path,
+                   const MatFileFormat format) const {
   std::ofstream file(path, std::ios::binary);
   THROW_CHECK_FILE_OPEN(file, path);
+  if (format != MatFileFormat::FLOAT) {
+    file << MatFileFormatToString(format) << "&";
+  }
   file << width_ << "&" << height_ << "&" << depth_ << "&";
-  WriteBinaryLittleEndian<T>(&file, data_);
+  if (format == MatFileFormat::FLOAT) {
+    WriteBinaryLittleEndian<T>(&file, data_);
+  } else {
+    internal::WriteHalfFloats(
+        &file, data_, format == MatFileFormat::HALF_LZ4);
+  }
   file.close();
 }
 
@@ -29,6 +29,11 @@
 
 #include "colmap/mvs/mat.h"
 
+#include "colmap/util/testing.h"
+
+#include <fstream>
+#include <iterator>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -95,6 +100,92 @@ TEST(Mat, Fill) {
   mat.Set(1, 0, 2, 10);
 }
 
+TEST(Mat, ReadWrite) {
+  Mat<float> mat(4, 3, 2);
+  for (size_t slice = 0; slice < mat.GetDepth(); ++slice) {
+    for (size_t row = 0; row < mat.GetHeight(); ++row) {
+      for (size_t col = 0; col < mat.GetWidth(); ++col) {
+        mat.Set(row, col, slice, 0.1f * (row + 1) + col - 0.3f * slice);
+      }
+    }
+  }
+
+  const std::string path = CreateTestDir() + "/mat.bin";
+  for (const MatFileFormat format : {MatFileFormat::FLOAT,
+                                     MatFileFormat::HALF,
+                                     MatFileFormat::HALF_LZ4}) {
+    mat.Write(path, format);
+    Mat<float> read_mat;
+    read_mat.Read(path);
+    EXPECT_EQ(read_mat.GetWidth(), mat.GetWidth());
+    EXPECT_EQ(read_mat.GetHeight(), mat.GetHeight());
+    EXPECT_EQ(read_mat.GetDepth(), mat.GetDepth());
+    // Half precision has a relative precision of 2^-11.
+    const float eps = format == MatFileFormat::FLOAT ? 0 : 5e-4f;
+    for (size_t i = 0; i < mat.GetData().size(); ++i) {
+      EXPECT_NEAR(read_mat.GetData()[i],
+                  mat.GetData()[i],
+                  eps * std::abs(mat.GetData()[i]));
+    }
+  }
+}
+
+TEST(Mat, ReadWriteInt) {
+  Mat<int> mat(3, 2, 1);
+  for (size_t i = 0; i < 6; ++i) {
+    mat.GetPtr()[i] = static_cast<int>(i) - 2;
+  }
+  const std::string path = CreateTestDir() + "/mat.bin";
+  mat.Write(path);
+  Mat<int> read_mat;
+  read_mat.Read(path);
+  EXPECT_EQ(read_mat.GetWidth(), 3);
+  EXPECT_EQ(read_mat.GetHeight(), 2);
+  EXPECT_EQ(read_mat.GetDepth(), 1);
+  EXPECT_EQ(read_mat.GetData(), mat.GetData());
+}
+
+TEST(Mat, ReadTruncated) {
+  const std::string path = CreateTestDir() + "/mat.bin";
+  for (const MatFileFormat format : {MatFileFormat::FLOAT,
+                                     MatFileFormat::HALF,
+                                     MatFileFormat::HALF_LZ4}) {
+    Mat<float> mat(4, 3, 2);
+    mat.Write(path, format);
+    std::string data;
+    {
+      std::ifstream file(path, std::ios::binary);
+      data.assign(std::istreambuf_iterator<char>(file),
+                  std::istreambuf_iterator<char>());
+    }
+    {
+      std::ofstream file(path, std::ios::binary);
+      file.write(data.data(), data.size() - 1);
+    }
+    Mat<float> read_mat;
+    EXPECT_ANY_THROW(read_mat.Read(path));
+  }
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "4&3";
+  }
+  Mat<float> read_mat;
+  EXPECT_ANY_THROW(read_mat.Read(path));
+}
+
+TEST(Mat, HalfOnlyForFloat) {
+  Mat<int> mat(1, 2, 3);
+  const std::string path = CreateTestDir() + "/mat.bin";
+  EXPECT_ANY_THROW(mat.Write(path, MatFileFormat::HALF));
+}
+
+TEST(Mat, MatFileFormatFromString) {
+  EXPECT_EQ(MatFileFormatFromString("float"), MatFileFormat::FLOAT);
+  EXPECT_EQ(MatFileFormatFromString("HALF"), MatFileFormat::HALF);
+  EXPECT_EQ(MatFileFormatFromString("half_lz4"), MatFileFormat::HALF_LZ4);
+  EXPECT_THROW(MatFileFormatFromString("unknown"), std::invalid_argument);
+}
+
 }  // namespace
 }  // namespace mvs
 }  // namespace colmap
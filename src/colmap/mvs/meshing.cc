@@ -29,7 +29,16 @@
 
 #include "colmap/mvs/meshing.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -40,9 +49,11 @@
 
 #include "colmap/math/graph_cut.h"
 #include "colmap/math/random.h"
+#include "colmap/mvs/fusion.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/memory.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/ply.h"
 #include "colmap/util/threading.h"
@@ -93,6 +104,13 @@ struct hash<const Delaunay::Cell_handle> {
 namespace colmap {
 namespace mvs {
 
+bool PointCloudDownsamplingOptions::Check() const {
+  CHECK_OPTION_GT(voxel_size, 0);
+  CHECK_OPTION_GE(num_threads, -1);
+  CHECK_OPTION_NE(num_threads, 0);
+  return true;
+}
+
 bool PoissonMeshingOptions::Check() const {
   CHECK_OPTION_GE(point_weight, 0);
   CHECK_OPTION_GT(depth, 0);
@@ -100,6 +118,7 @@ bool PoissonMeshingOptions::Check() const {
   CHECK_OPTION_GE(trim, 0);
   CHECK_OPTION_GE(num_threads, -1);
   CHECK_OPTION_NE(num_threads, 0);
+  CHECK_OPTION_GE(block_overlap, 0);
   return true;
 }
 
@@ -118,11 +137,750 @@ bool DelaunayMeshingOptions::Check() const {
   return true;
 }
 
+namespace {
+
+typedef std::array<int64_t, 3> VoxelCoords;
+
+struct VoxelCoordsHash {
+  size_t operator()(const VoxelCoords& coords) const {
+    uint64_t hash = static_cast<uint64_t>(coords[0]) * 73856093ull ^
+                    static_cast<uint64_t>(coords[1]) * 19349663ull ^
+                    static_cast<uint64_t>(coords[2]) * 83492791ull;
+    // Mix the bits, such that the high bits can be used to shard the voxels
+    // independent of the buckets of the hash maps.
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+};
+
+// Sums of the points merged into a voxel.
+struct DownsamplingVoxel {
+  Eigen::Vector3d xyz_sum = Eigen::Vector3d::Zero();
+  Eigen::Vector3d normal_sum = Eigen::Vector3d::Zero();
+  Eigen::Vector3d rgb_sum = Eigen::Vector3d::Zero();
+  size_t num_points = 0;
+  // Unique indices of the images observing the merged points.
+  std::vector<int> visibility;
+};
+
+struct DownsamplingBatch {
+  std::vector<PlyPoint> points;
+  std::vector<std::vector<int>> visibility;
+};
+
+// Merge the points of input_path and, if requested, their visibility from
+// "<input_path>.vis" on a voxel grid and pass the merged points to the given
+// function in a deterministic order. The points are read in batches, which are
+// merged while the next batch is read. Every thread merges the points of a
+// disjoint shard of the voxels, such that no synchronization is needed.
+void DownsamplePoints(
+    const PointCloudDownsamplingOptions& options,
+    const std::string& input_path,
+    const bool read_visibility,
+    const std::function<void(const PlyPoint&, const std::vector<int>&)>&
+        merged_point_func) {
+  THROW_CHECK(options.Check());
+
+  PlyPointReader reader(input_path);
+  std::unique_ptr<PointsVisibilityReader> visibility_reader;
+  if (read_visibility) {
+    visibility_reader =
+        std::make_unique<PointsVisibilityReader>(input_path + ".vis");
+    THROW_CHECK_EQ(visibility_reader->NumPoints(), reader.NumPoints());
+  }
+
+  ThreadPool thread_pool(options.num_threads);
+  const size_t num_shards = thread_pool.NumThreads();
+  typedef std::unordered_map<VoxelCoords, DownsamplingVoxel, VoxelCoordsHash>
+      VoxelMap;
+  std::vector<VoxelMap> shards(num_shards);
+
+  const double inv_voxel_size = 1.0 / options.voxel_size;
+  auto PointVoxelCoords = [inv_voxel_size](const PlyPoint& point) {
+    return VoxelCoords{
+        static_cast<int64_t>(std::floor(point.x * inv_voxel_size)),
+        static_cast<int64_t>(std::floor(point.y * inv_voxel_size)),
+        static_cast<int64_t>(std::floor(point.z * inv_voxel_size))};
+  };
+
+  auto MergeBatch = [&](const DownsamplingBatch& batch,
+                        const size_t shard_idx) {
+    auto& shard = shards[shard_idx];
+    const VoxelCoordsHash hasher;
+    for (size_t i = 0; i < batch.points.size(); ++i) {
+      const PlyPoint& point = batch.points[i];
+      const VoxelCoords coords = PointVoxelCoords(point);
+      if ((hasher(coords) >> 32) % num_shards != shard_idx) {
+        continue;
+      }
+      DownsamplingVoxel& voxel = shard[coords];
+      voxel.xyz_sum += Eigen::Vector3d(point.x, point.y, point.z);
+      voxel.normal_sum += Eigen::Vector3d(point.nx, point.ny, point.nz);
+      voxel.rgb_sum += Eigen::Vector3d(point.r, point.g, point.b);
+      voxel.num_points += 1;
+      if (read_visibility) {
+        // The visibility of a voxel is usually small, such that a linear
+        // search is faster than a set.
+        for (const int image_idx : batch.visibility[i]) {
+          if (std::find(voxel.visibility.begin(),
+                        voxel.visibility.end(),
+                        image_idx) == voxel.visibility.end()) {
+            voxel.visibility.push_back(image_idx);
+          }
+        }
+      }
+    }
+  };
+
+  const size_t kBatchSize = 1 << 20;
+  std::array<DownsamplingBatch, 2> batches;
+  std::vector<std::future<void>> futures;
+  size_t num_input_points = 0;
+  for (size_t batch_idx = 0;; batch_idx = 1 - batch_idx) {
+    // The other batch is merged by the thread pool in the meantime.
+    DownsamplingBatch& batch = batches[batch_idx];
+    batch.points.resize(kBatchSize);
+    batch.visibility.resize(read_visibility ? kBatchSize : 0);
+    size_t num_batch_points = 0;
+    while (num_batch_points < kBatchSize &&
+           reader.Next(&batch.points[num_batch_points])) {
+      if (read_visibility) {
+        THROW_CHECK(
+            visibility_reader->Next(&batch.visibility[num_batch_points]));
+      }
+      num_batch_points += 1;
+    }
+    batch.points.resize(num_batch_points);
+    batch.visibility.resize(read_visibility ? num_batch_points : 0);
+    num_input_points += num_batch_points;
+
+    for (auto& future : futures) {
+      future.get();
+    }
+    futures.clear();
+
+    if (num_batch_points == 0) {
+      break;
+    }
+
+    for (size_t shard_idx = 0; shard_idx < num_shards; ++shard_idx) {
+      futures.push_back(
+          thread_pool.AddTask(MergeBatch, std::cref(batch), shard_idx));
+    }
+  }
+
+  size_t num_merged_points = 0;
+  for (const auto& shard : shards) {
+    num_merged_points += shard.size();
+  }
+
+  std::vector<std::pair<VoxelCoords, const DownsamplingVoxel*>> voxels;
+  voxels.reserve(num_merged_points);
+  for (const auto& shard : shards) {
+    for (const auto& [coords, voxel] : shard) {
+      voxels.emplace_back(coords, &voxel);
+    }
+  }
+  std::sort(voxels.begin(), voxels.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+
+  std::vector<int> visibility;
+  for (const auto& [coords, voxel] : voxels) {
+    const double inv_num_points = 1.0 / voxel->num_points;
+    const Eigen::Vector3d xyz = voxel->xyz_sum * inv_num_points;
+    const Eigen::Vector3d normal =
+        voxel->normal_sum.squaredNorm() > 0 ? voxel->normal_sum.normalized()
+                                            : Eigen::Vector3d::Zero();
+    const Eigen::Vector3d rgb = voxel->rgb_sum * inv_num_points;
+    PlyPoint point;
+    point.x = static_cast<float>(xyz.x());
+    point.y = static_cast<float>(xyz.y());
+    point.z = static_cast<float>(xyz.z());
+    point.nx = static_cast<float>(normal.x());
+    point.ny = static_cast<float>(normal.y());
+    point.nz = static_cast<float>(normal.z());
+    point.r = static_cast<uint8_t>(std::round(rgb.x()));
+    point.g = static_cast<uint8_t>(std::round(rgb.y()));
+    point.b = static_cast<uint8_t>(std::round(rgb.z()));
+    visibility = voxel->visibility;
+    std::sort(visibility.begin(), visibility.end());
+    merged_point_func(point, visibility);
+  }
+
+  LOG(INFO) << StringPrintf("Merged %d points into %d voxels",
+                            num_input_points,
+                            num_merged_points);
+}
+
+}  // namespace
+
+void DownsamplePointCloud(const PointCloudDownsamplingOptions& options,
+                          const std::string& input_path,
+                          const std::string& output_path) {
+  const bool has_visibility = ExistsFile(input_path + ".vis");
+  PlyPointWriter writer(output_path);
+  std::unique_ptr<PointsVisibilityWriter> visibility_writer;
+  if (has_visibility) {
+    visibility_writer =
+        std::make_unique<PointsVisibilityWriter>(output_path + ".vis");
+  }
+  DownsamplePoints(
+      options,
+      input_path,
+      has_visibility,
+      [&](const PlyPoint& point, const std::vector<int>& visibility) {
+        writer.Write(point);
+        if (visibility_writer) {
+          visibility_writer->Write(visibility);
+        }
+      });
+  writer.Close();
+  if (visibility_writer) {
+    visibility_writer->Close();
+  }
+}
+
+namespace {
+
+// Depth of the grid that counts the points to partition them into blocks.
+constexpr int kMaxBlockDepth = 6;
+
+// Maximum number of points that are buffered per block before they are
+// appended to its temporary file.
+constexpr size_t kMaxNumBufferedPointsPerBlock = 4096;
+
+// Width of the number of elements in the header of the stitched mesh, which
+// is padded with spaces, such that it can be overwritten in place.
+constexpr int kPlyNumElementsWidth = 20;
+
+Eigen::Vector3i BlockGridCoords(const Eigen::Vector3f& point,
+                                const Eigen::Vector3f& root_min,
+                                const float root_size) {
+  const int grid_size = 1 << kMaxBlockDepth;
+  return ((point - root_min) * (grid_size / root_size))
+      .cast<int>()
+      .cwiseMax(0)
+      .cwiseMin(grid_size - 1);
+}
+
+size_t BlockGridIndex(const Eigen::Vector3i& coords) {
+  const size_t grid_size = 1 << kMaxBlockDepth;
+  return (coords.x() * grid_size + coords.y()) * grid_size + coords.z();
+}
+
+// Point is inside the half-open box, such that points on the shared sides of
+// neighboring boxes belong to exactly one of them.
+bool IsInsideBlockBox(const Eigen::AlignedBox3f& box,
+                      const Eigen::Vector3f& point) {
+  return (point.array() >= box.min().array()).all() &&
+         (point.array() < box.max().array()).all();
+}
+
+void SplitPoissonMeshingBlock(
+    const std::vector<size_t>& counts,
+    const Eigen::Vector3f& root_min,
+    const float root_size,
+    const int depth,
+    const Eigen::Vector3i& coords,
+    const int max_num_points,
+    const double overlap,
+    std::vector<internal::PoissonMeshingBlock>* blocks) {
+  const int num_cells = 1 << (kMaxBlockDepth - depth);
+  size_t num_points = 0;
+  for (int x = 0; x < num_cells; ++x) {
+    for (int y = 0; y < num_cells; ++y) {
+      for (int z = 0; z < num_cells; ++z) {
+        num_points += counts[BlockGridIndex(
+            num_cells * coords + Eigen::Vector3i(x, y, z))];
+      }
+    }
+  }
+
+  if (num_points == 0) {
+    return;
+  }
+
+  if (num_points > static_cast<size_t>(max_num_points) &&
+      depth < kMaxBlockDepth) {
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      const Eigen::Vector3i child_coords =
+          2 * coords + Eigen::Vector3i((child_idx >> 2) & 1,
+                                       (child_idx >> 1) & 1,
+                                       child_idx & 1);
+      SplitPoissonMeshingBlock(counts,
+                               root_min,
+                               root_size,
+                               depth + 1,
+                               child_coords,
+                               max_num_points,
+                               overlap,
+                               blocks);
+    }
+    return;
+  }
+
+  const int num_blocks = 1 << depth;
+  const float block_size = root_size / num_blocks;
+  const Eigen::Vector3f block_min =
+      root_min + block_size * coords.cast<float>();
+  const Eigen::Vector3f block_max =
+      block_min + Eigen::Vector3f::Constant(block_size);
+
+  internal::PoissonMeshingBlock& block = blocks->emplace_back();
+  block.depth = depth;
+  block.num_points = num_points;
+  block.extended_box = Eigen::AlignedBox3f(
+      block_min - Eigen::Vector3f::Constant(overlap * block_size),
+      block_max + Eigen::Vector3f::Constant(overlap * block_size));
+  block.box = Eigen::AlignedBox3f(block_min, block_max);
+  for (int i = 0; i < 3; ++i) {
+    if (coords(i) == 0) {
+      block.box.min()(i) = -std::numeric_limits<float>::infinity();
+    }
+    if (coords(i) == num_blocks - 1) {
+      block.box.max()(i) = std::numeric_limits<float>::infinity();
+    }
+  }
+}
+
+int PlyPropertyTypeSize(const std::string& type) {
+  if (type == "char" || type == "uchar" || type == "int8" ||
+      type == "uint8") {
+    return 1;
+  } else if (type == "short" || type == "ushort" || type == "int16" ||
+             type == "uint16") {
+    return 2;
+  } else if (type == "int" || type == "uint" || type == "float" ||
+             type == "int32" || type == "uint32" || type == "float32") {
+    return 4;
+  } else if (type == "double" || type == "float64") {
+    return 8;
+  }
+  LOG(FATAL_THROW) << "Invalid PLY property type: " << type;
+  return 0;
+}
+
+// Stitches the binary PLY meshes of the blocks into a single binary PLY mesh.
+// Only the faces with their centroid inside the box of their block are kept,
+// such that the faces of overlapping blocks are disjoint. The vertex
+// properties of all meshes must be the same. The faces are written to a
+// temporary file first, since they must follow all vertices in the output.
+class PoissonBlockMeshStitcher {
+ public:
+  explicit PoissonBlockMeshStitcher(const std::string& path)
+      : path_(path),
+        faces_path_(path + ".faces.tmp"),
+        num_vertices_(0),
+        num_faces_(0) {}
+
+  void Append(const std::string& mesh_path, const Eigen::AlignedBox3f& box) {
+    std::ifstream file(mesh_path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, mesh_path);
+
+    std::vector<std::string> vertex_property_lines;
+    std::string element;
+    size_t num_vertices = 0;
+    size_t num_faces = 0;
+    size_t vertex_size = 0;
+    int x_pos = -1;
+    int y_pos = -1;
+    int z_pos = -1;
+    std::string line;
+    while (std::getline(file, line)) {
+      StringTrim(&line);
+      if (line == "end_header") {
+        break;
+      }
+
+      const std::vector<std::string> items = StringSplit(line, " ");
+      if (items[0] == "format") {
+        THROW_CHECK(items.size() >= 2 && items[1] == "binary_little_endian")
+            << "Only binary little endian meshes can be stitched";
+      } else if (items[0] == "element") {
+        THROW_CHECK_EQ(items.size(), 3);
+        element = items[1];
+        if (element == "vertex") {
+          num_vertices = std::stoull(items[2]);
+        } else if (element == "face") {
+          num_faces = std::stoull(items[2]);
+        } else {
+          THROW_CHECK_EQ(std::stoull(items[2]), 0)
+              << "Invalid PLY element: " << element;
+        }
+      } else if (items[0] == "property" && element == "vertex") {
+        THROW_CHECK_EQ(items.size(), 3);
+        const bool is_float = items[1] == "float" || items[1] == "float32";
+        if (items[2] == "x" && is_float) {
+          x_pos = vertex_size;
+        } else if (items[2] == "y" && is_float) {
+          y_pos = vertex_size;
+        } else if (items[2] == "z" && is_float) {
+          z_pos = vertex_size;
+        }
+        vertex_size += PlyPropertyTypeSize(items[1]);
+        vertex_property_lines.push_back(line);
+      } else if (items[0] == "property" && element == "face") {
+        THROW_CHECK(items.size() == 5 && items[1] == "list" &&
+                    PlyPropertyTypeSize(items[2]) == 1 &&
+                    PlyPropertyTypeSize(items[3]) == 4)
+            << "Invalid PLY face property: " << line;
+      }
+    }
+
+    THROW_CHECK(x_pos >= 0 && y_pos >= 0 && z_pos >= 0)
+        << "Missing vertex positions in " << mesh_path;
+
+    if (!file_.is_open()) {
+      WriteHeader(vertex_property_lines);
+    } else {
+      THROW_CHECK(vertex_property_lines == vertex_property_lines_)
+          << "Meshes of blocks have different vertex properties";
+    }
+
+    std::vector<char> vertex_data(num_vertices * vertex_size);
+    file.read(vertex_data.data(), vertex_data.size());
+    THROW_CHECK(file.good()) << "Failed to read " << mesh_path;
+
+    auto VertexCoord = [&](const size_t vertex_idx, const int pos) {
+      float value;
+      std::memcpy(
+          &value, vertex_data.data() + vertex_idx * vertex_size + pos, 4);
+      return LittleEndianToNative(value);
+    };
+
+    std::vector<uint8_t> face_sizes;
+    std::vector<uint32_t> face_vertex_idxs;
+    std::vector<int64_t> new_vertex_idxs(num_vertices, -1);
+    std::vector<uint32_t> vertex_idxs;
+    for (size_t face_idx = 0; face_idx < num_faces; ++face_idx) {
+      const uint8_t face_size = ReadBinaryLittleEndian<uint8_t>(&file);
+      vertex_idxs.resize(face_size);
+      Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+      for (uint32_t& vertex_idx : vertex_idxs) {
+        vertex_idx = ReadBinaryLittleEndian<uint32_t>(&file);
+        THROW_CHECK_LT(vertex_idx, num_vertices);
+        centroid += Eigen::Vector3f(VertexCoord(vertex_idx, x_pos),
+                                    VertexCoord(vertex_idx, y_pos),
+                                    VertexCoord(vertex_idx, z_pos));
+      }
+      if (face_size == 0 || !IsInsideBlockBox(box, centroid / face_size)) {
+        continue;
+      }
+      face_sizes.push_back(face_size);
+      for (const uint32_t vertex_idx : vertex_idxs) {
+        face_vertex_idxs.push_back(vertex_idx);
+        new_vertex_idxs[vertex_idx] = 0;
+      }
+    }
+    THROW_CHECK(file.good()) << "Failed to read " << mesh_path;
+
+    // Append the vertices of the kept faces in their original order.
+    for (size_t vertex_idx = 0; vertex_idx < num_vertices; ++vertex_idx) {
+      if (new_vertex_idxs[vertex_idx] == 0) {
+        new_vertex_idxs[vertex_idx] = num_vertices_;
+        num_vertices_ += 1;
+        file_.write(vertex_data.data() + vertex_idx * vertex_size,
+                    vertex_size);
+      }
+    }
+
+    size_t face_vertex_idx = 0;
+    for (const uint8_t face_size : face_sizes) {
+      WriteBinaryLittleEndian<uint8_t>(&faces_file_, face_size);
+      for (uint8_t i = 0; i < face_size; ++i) {
+        WriteBinaryLittleEndian<uint32_t>(
+            &faces_file_,
+            new_vertex_idxs[face_vertex_idxs[face_vertex_idx + i]]);
+      }
+      face_vertex_idx += face_size;
+    }
+    num_faces_ += face_sizes.size();
+  }
+
+  void Close() {
+    if (!file_.is_open()) {
+      WriteHeader({"property float x", "property float y", "property float z"});
+    }
+
+    faces_file_.close();
+    {
+      std::ifstream faces_file(faces_path_, std::ios::binary);
+      THROW_CHECK_FILE_OPEN(faces_file, faces_path_);
+      if (num_faces_ > 0) {
+        file_ << faces_file.rdbuf();
+      }
+    }
+    std::remove(faces_path_.c_str());
+
+    file_.seekp(num_vertices_pos_);
+    file_ << num_vertices_;
+    file_.seekp(num_faces_pos_);
+    file_ << num_faces_;
+    file_.close();
+    THROW_CHECK(!file_.fail()) << "Failed to write mesh: " << path_;
+  }
+
+ private:
+  void WriteHeader(const std::vector<std::string>& vertex_property_lines) {
+    vertex_property_lines_ = vertex_property_lines;
+
+    file_.open(path_, std::ios::out | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file_, path_);
+    faces_file_.open(faces_path_, std::ios::out | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(faces_file_, faces_path_);
+
+    file_ << "ply\n";
+    file_ << "format binary_little_endian 1.0\n";
+    file_ << "element vertex ";
+    num_vertices_pos_ = file_.tellp();
+    file_ << std::string(kPlyNumElementsWidth, ' ') << "\n";
+    for (const auto& line : vertex_property_lines) {
+      file_ << line << "\n";
+    }
+    file_ << "element face ";
+    num_faces_pos_ = file_.tellp();
+    file_ << std::string(kPlyNumElementsWidth, ' ') << "\n";
+    file_ << "property list uchar int vertex_indices\n";
+    file_ << "end_header\n";
+  }
+
+  const std::string path_;
+  const std::string faces_path_;
+  std::fstream file_;
+  std::ofstream faces_file_;
+  std::vector<std::string> vertex_property_lines_;
+  std::streampos num_vertices_pos_;
+  std::streampos num_faces_pos_;
+  size_t num_vertices_;
+  size_t num_faces_;
+};
+
+void AppendPoissonMeshingBlockPoints(const std::string& path,
+                                     std::vector<PlyPoint>* points) {
+  if (points->empty()) {
+    return;
+  }
+  std::ofstream file(path, std::ios::app | std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  file.write(reinterpret_cast<const char*>(points->data()),
+             points->size() * sizeof(PlyPoint));
+  THROW_CHECK(file.good()) << "Failed to write " << path;
+  points->clear();
+}
+
+std::vector<PlyPoint> ReadPoissonMeshingBlockPoints(const std::string& path) {
+  std::vector<PlyPoint> points;
+  {
+    std::ifstream file(path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, path);
+    points.resize(GetFileSize(path) / sizeof(PlyPoint));
+    file.read(reinterpret_cast<char*>(points.data()),
+              points.size() * sizeof(PlyPoint));
+    THROW_CHECK(file.good()) << "Failed to read " << path;
+  }
+  std::remove(path.c_str());
+  return points;
+}
+
+bool BlockPoissonMeshing(const PoissonMeshingOptions& options,
+                         const std::string& input_path,
+                         const std::string& output_path) {
+  const std::vector<internal::PoissonMeshingBlock> blocks =
+      internal::ComputePoissonMeshingBlocks(
+          input_path, options.max_num_block_points, options.block_overlap);
+
+  LOG(INFO) << StringPrintf("Partitioned points into %d blocks",
+                            blocks.size());
+
+  std::vector<std::string> block_paths(blocks.size());
+  for (size_t block_idx = 0; block_idx < blocks.size(); ++block_idx) {
+    block_paths[block_idx] =
+        output_path + ".block" + std::to_string(block_idx) + ".tmp";
+  }
+
+  // The blocks, whose extended box may contain a point, for every grid cell.
+  Eigen::AlignedBox3f root_box;
+  for (const auto& block : blocks) {
+    root_box.extend(block.extended_box);
+  }
+  const float root_size = std::max(root_box.sizes().maxCoeff(), 1e-6f);
+  const int grid_size = 1 << kMaxBlockDepth;
+  std::vector<std::vector<int>> cell_block_idxs(grid_size * grid_size *
+                                                grid_size);
+  for (size_t block_idx = 0; block_idx < blocks.size(); ++block_idx) {
+    const Eigen::AlignedBox3f& extended_box = blocks[block_idx].extended_box;
+    const Eigen::Vector3i min_coords =
+        BlockGridCoords(extended_box.min(), root_box.min(), root_size);
+    const Eigen::Vector3i max_coords =
+        BlockGridCoords(extended_box.max(), root_box.min(), root_size);
+    for (int x = min_coords.x(); x <= max_coords.x(); ++x) {
+      for (int y = min_coords.y(); y <= max_coords.y(); ++y) {
+        for (int z = min_coords.z(); z <= max_coords.z(); ++z) {
+          cell_block_idxs[BlockGridIndex(Eigen::Vector3i(x, y, z))].push_back(
+              block_idx);
+        }
+      }
+    }
+  }
+
+  // Distribute the points to the temporary files of the blocks, where the
+  // points in the overlap of blocks are written to all of them.
+  {
+    std::vector<std::vector<PlyPoint>> buffers(blocks.size());
+    for (const auto& block_path : block_paths) {
+      // Truncate files of previous runs.
+      std::ofstream file(block_path, std::ios::trunc | std::ios::binary);
+      THROW_CHECK_FILE_OPEN(file, block_path);
+    }
+    PlyPointReader reader(input_path);
+    PlyPoint point;
+    while (reader.Next(&point)) {
+      const Eigen::Vector3f xyz(point.x, point.y, point.z);
+      for (const int block_idx : cell_block_idxs[BlockGridIndex(
+               BlockGridCoords(xyz, root_box.min(), root_size))]) {
+        if (blocks[block_idx].extended_box.contains(xyz)) {
+          std::vector<PlyPoint>& buffer = buffers[block_idx];
+          buffer.push_back(point);
+          if (buffer.size() >= kMaxNumBufferedPointsPerBlock) {
+            AppendPoissonMeshingBlockPoints(block_paths[block_idx], &buffer);
+          }
+        }
+      }
+    }
+    for (size_t block_idx = 0; block_idx < blocks.size(); ++block_idx) {
+      AppendPoissonMeshingBlockPoints(block_paths[block_idx],
+                                      &buffers[block_idx]);
+    }
+  }
+
+  // The depth of the blocks is reduced by their depth in the octree, such
+  // that all blocks are reconstructed at the resolution of the scene.
+  PoissonMeshingOptions block_options = options;
+  block_options.max_num_block_points = -1;
+
+  const std::string block_points_path = output_path + ".block_points.ply";
+  const std::string block_mesh_path = output_path + ".block_mesh.ply";
+
+  bool success = true;
+  PoissonBlockMeshStitcher stitcher(output_path);
+  for (size_t block_idx = 0; block_idx < blocks.size(); ++block_idx) {
+    if (!success) {
+      std::remove(block_paths[block_idx].c_str());
+      continue;
+    }
+
+    const std::vector<PlyPoint> points =
+        ReadPoissonMeshingBlockPoints(block_paths[block_idx]);
+
+    LOG(INFO) << StringPrintf("Meshing block [%d/%d] with %d points",
+                              block_idx + 1,
+                              blocks.size(),
+                              points.size());
+
+    WriteBinaryPlyPoints(block_points_path, points);
+    block_options.depth =
+        std::max(1, options.depth - blocks[block_idx].depth);
+    success = PoissonMeshing(block_options, block_points_path, block_mesh_path);
+    if (success) {
+      stitcher.Append(block_mesh_path, blocks[block_idx].box);
+    }
+  }
+
+  std::remove(block_points_path.c_str());
+  std::remove(block_mesh_path.c_str());
+
+  stitcher.Close();
+
+  return success;
+}
+
+}  // namespace
+
+namespace internal {
+
+std::vector<PoissonMeshingBlock> ComputePoissonMeshingBlocks(
+    const std::string& path, const int max_num_points, const double overlap) {
+  THROW_CHECK_GT(max_num_points, 0);
+  THROW_CHECK_GE(overlap, 0);
+
+  Eigen::AlignedBox3f bounding_box;
+  {
+    PlyPointReader reader(path);
+    PlyPoint point;
+    while (reader.Next(&point)) {
+      bounding_box.extend(Eigen::Vector3f(point.x, point.y, point.z));
+    }
+  }
+
+  if (bounding_box.isEmpty()) {
+    return {};
+  }
+
+  // The root is the bounding cube of the points, such that all blocks at the
+  // same depth have the same resolution.
+  const float root_size = std::max(bounding_box.sizes().maxCoeff(), 1e-6f);
+
+  const int grid_size = 1 << kMaxBlockDepth;
+  std::vector<size_t> counts(grid_size * grid_size * grid_size, 0);
+  {
+    PlyPointReader reader(path);
+    PlyPoint point;
+    while (reader.Next(&point)) {
+      counts[BlockGridIndex(
+          BlockGridCoords(Eigen::Vector3f(point.x, point.y, point.z),
+                          bounding_box.min(),
+                          root_size))] += 1;
+    }
+  }
+
+  std::vector<PoissonMeshingBlock> blocks;
+  SplitPoissonMeshingBlock(counts,
+                           bounding_box.min(),
+                           root_size,
+                           /*depth=*/0,
+                           Eigen::Vector3i::Zero(),
+                           max_num_points,
+                           overlap,
+                           &blocks);
+  return blocks;
+}
+
+}  // namespace internal
+
 bool PoissonMeshing(const PoissonMeshingOptions& options,
                     const std::string& input_path,
                     const std::string& output_path) {
   THROW_CHECK(options.Check());
 
+  if (options.voxel_size > 0) {
+    PointCloudDownsamplingOptions downsampling_options;
+    downsampling_options.voxel_size = options.voxel_size;
+    downsampling_options.num_threads = options.num_threads;
+    const std::string downsampled_path = output_path + ".downsampled.ply";
+    PlyPointWriter writer(downsampled_path);
+    DownsamplePoints(downsampling_options,
+                     input_path,
+                     /*read_visibility=*/false,
+                     [&writer](const PlyPoint& point, const std::vector<int>&) {
+                       writer.Write(point);
+                     });
+    writer.Close();
+
+    PoissonMeshingOptions downsampled_options = options;
+    downsampled_options.voxel_size = -1;
+    const bool success =
+        PoissonMeshing(downsampled_options, downsampled_path, output_path);
+    std::remove(downsampled_path.c_str());
+    return success;
+  }
+
+  if (options.max_num_block_points > 0) {
+    return BlockPoissonMeshing(options, input_path, output_path);
+  }
+
   std::vector<std::string> args;
 
   args.push_back("./binary");
@@ -260,7 +1018,11 @@ class DelaunayMeshingInput {
     }
   }
 
-  void ReadDenseReconstruction(const std::string& path) {
+  // If the voxel size is positive, the fused points are merged on a voxel grid
+  // of this size while they are read, see DownsamplePointCloud.
+  void ReadDenseReconstruction(const std::string& path,
+                               const double voxel_size = -1,
+                               const int num_threads = -1) {
     {
       Reconstruction reconstruction;
       reconstruction.Read(JoinPaths(path, "sparse"));
@@ -278,6 +1040,29 @@ class DelaunayMeshingInput {
       }
     }
 
+    if (voxel_size > 0) {
+      PointCloudDownsamplingOptions downsampling_options;
+      downsampling_options.voxel_size = voxel_size;
+      downsampling_options.num_threads = num_threads;
+      DownsamplePoints(
+          downsampling_options,
+          JoinPaths(path, "fused.ply"),
+          /*read_visibility=*/true,
+          [this](const PlyPoint& ply_point,
+                 const std::vector<int>& visibility) {
+            const int point_idx = points.size();
+            DelaunayMeshingInput::Point input_point;
+            input_point.position =
+                Eigen::Vector3f(ply_point.x, ply_point.y, ply_point.z);
+            input_point.num_visible_images = visibility.size();
+            for (const int image_idx : visibility) {
+              images.at(image_idx).point_idxs.push_back(point_idx);
+            }
+            points.push_back(input_point);
+          });
+      return;
+    }
+
     const auto& ply_points = ReadPly(JoinPaths(path, "fused.ply"));
 
     const std::string vis_path = JoinPaths(path, "fused.ply.vis");
@@ -313,8 +1098,16 @@ class DelaunayMeshingInput {
     return Delaunay(delaunay_points.begin(), delaunay_points.end());
   }
 
+  // Insert the points in random order into the triangulation, while skipping
+  // points that are close to the vertices of their located cell in all
+  // visible images. The points are processed in batches, whose insertion is
+  // decided in parallel against the current triangulation and which are then
+  // inserted at once. The batch size is a fraction of the number of vertices,
+  // such that only few decisions miss the other points of the same batch.
   Delaunay CreateSubSampledDelaunayTriangulation(
-      const float max_proj_dist, const float max_depth_dist) const {
+      const float max_proj_dist,
+      const float max_depth_dist,
+      ThreadPool* thread_pool) const {
     THROW_CHECK_GE(max_proj_dist, 0);
 
     if (max_proj_dist == 0) {
@@ -338,31 +1131,21 @@ class DelaunayMeshingInput {
     const float min_depth_ratio = 1.0f - max_depth_dist;
     const float max_depth_ratio = 1.0f + max_depth_dist;
 
-    for (const auto point_idx : point_idxs) {
+    auto ShouldInsertPoint = [&](const size_t point_idx) {
       const auto& point = points[point_idx];
       const auto& visible_image_idxs = points_visible_image_idxs[point_idx];
 
-      const K::Point_3 point_position = EigenToCGAL(point.position);
-
-      // Insert point into triangulation until there is one cell.
-      if (triangulation.number_of_vertices() < 4) {
-        triangulation.insert(point_position);
-        continue;
-      }
-
-      const Delaunay::Cell_handle cell = triangulation.locate(point_position);
+      const Delaunay::Cell_handle cell =
+          triangulation.locate(EigenToCGAL(point.position));
 
       // If the point is outside the current hull, then extend the hull.
       if (triangulation.is_infinite(cell)) {
-        triangulation.insert(point_position);
-        continue;
+        return true;
       }
 
       // Project point and located cell vertices to all visible images and
       // determine reprojection error.
 
-      bool insert_point = false;
-
       for (const auto& image_idx : visible_image_idxs) {
         const auto& image = images[image_idx];
         const auto& camera = cameras.at(image.camera_id);
@@ -378,15 +1161,13 @@ class DelaunayMeshingInput {
 
           // Ensure that both points are infront of camera.
           if (point_local.z() <= 0 || cell_point_local.z() <= 0) {
-            insert_point = true;
-            break;
+            return true;
           }
 
           // Check depth ratio between the two points.
           const float depth_ratio = point_local.z() / cell_point_local.z();
           if (depth_ratio < min_depth_ratio || depth_ratio > max_depth_ratio) {
-            insert_point = true;
-            break;
+            return true;
           }
 
           // Check reprojection error between the two points.
@@ -399,19 +1180,59 @@ class DelaunayMeshingInput {
           const float squared_proj_dist =
               (point_proj - cell_point_proj).squaredNorm();
           if (squared_proj_dist > max_squared_proj_dist) {
-            insert_point = true;
-            break;
+            return true;
           }
         }
+      }
 
-        if (insert_point) {
-          break;
-        }
+      return false;
+    };
+
+    const size_t kMinBatchSize = 1024;
+    const size_t kBatchSizeDivisor = 8;
+    const size_t kMinNumPointsPerChunk = 64;
+
+    std::vector<char> insert_points;
+    std::vector<K::Point_3> batch_points;
+    size_t batch_begin = 0;
+    while (batch_begin < point_idxs.size()) {
+      // Insert point into triangulation until there is one cell.
+      if (triangulation.number_of_vertices() < 4) {
+        triangulation.insert(
+            EigenToCGAL(points[point_idxs[batch_begin]].position));
+        batch_begin += 1;
+        continue;
       }
 
-      if (insert_point) {
-        triangulation.insert(point_position);
+      const size_t batch_size =
+          std::max(kMinBatchSize,
+                   triangulation.number_of_vertices() / kBatchSizeDivisor);
+      const size_t batch_end =
+          std::min(point_idxs.size(), batch_begin + batch_size);
+
+      insert_points.resize(batch_end - batch_begin);
+      ParallelForChunks(thread_pool,
+                        insert_points.size(),
+                        kMinNumPointsPerChunk,
+                        [&](const size_t begin, const size_t end) {
+                          for (size_t i = begin; i < end; ++i) {
+                            insert_points[i] = ShouldInsertPoint(
+                                point_idxs[batch_begin + i]);
+                          }
+                        });
+
+      batch_points.clear();
+      for (size_t i = 0; i < insert_points.size(); ++i) {
+        if (insert_points[i]) {
+          batch_points.push_back(
+              EigenToCGAL(points[point_idxs[batch_begin + i]].position));
+        }
       }
+
+      // The range insertion spatially sorts the points for faster location.
+      triangulation.insert(batch_points.begin(), batch_points.end());
+
+      batch_begin = batch_end;
     }
 
     LOG(INFO) << StringPrintf("Triangulation has %d using %d points.",
@@ -701,10 +1522,16 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
                         const DelaunayMeshingInput& input_data) {
   THROW_CHECK(options.Check());
 
+  const int num_threads = GetEffectiveNumThreads(options.num_threads);
+  ThreadPool thread_pool(num_threads);
+
   // Create a delaunay triangulation of all input points.
   LOG(INFO) << "Triangulating points...";
   const auto triangulation = input_data.CreateSubSampledDelaunayTriangulation(
-      options.max_proj_dist, options.max_depth_dist);
+      options.max_proj_dist, options.max_depth_dist, &thread_pool);
+  SetMemoryUsage("delaunay_triangulation",
+                 triangulation.number_of_vertices() * sizeof(Delaunay::Vertex) +
+                     triangulation.number_of_cells() * sizeof(Delaunay::Cell));
 
   // Helper class to efficiently trace rays through the triangulation.
   LOG(INFO) << "Initializing ray tracer...";
@@ -728,10 +1555,10 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
        ++it) {
     cell_graph_data.emplace(it, DelaunayCellData(cell_graph_data.size()));
   }
+  SetMemoryUsage("delaunay_cell_graph", EstimateNumBytes(cell_graph_data));
+  LogMemoryUsage();
 
-  // Spawn threads for parallelized integration of images.
-  const int num_threads = GetEffectiveNumThreads(options.num_threads);
-  ThreadPool thread_pool(num_threads);
+  // Parallelized integration of images.
   JobQueue<CellGraphData> result_queue(num_threads);
 
   // Function that accumulates edge weights in the s-t graph for a single image.
@@ -877,47 +1704,74 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
 
   // Each oriented facet in the Delaunay triangulation corresponds to a directed
   // edge and each cell corresponds to a node in the graph.
-  MinSTGraphCut<size_t, float> graph_cut(cell_graph_data.size());
-
-  // Iterate all cells in the triangulation.
-  for (auto& cell_data : cell_graph_data) {
-    graph_cut.AddNode(cell_data.second.index,
-                      cell_data.second.source_weight,
-                      cell_data.second.sink_weight);
+  std::vector<const CellGraphData::value_type*> cells(cell_graph_data.size());
+  for (const auto& cell_data : cell_graph_data) {
+    cells[cell_data.second.index] = &cell_data;
+  }
 
-    // Iterate all facets of the current cell to accumulate edge weight.
-    for (int i = 0; i < 4; ++i) {
-      // Compose the current facet.
-      const Delaunay::Facet facet = std::make_pair(cell_data.first, i);
+  struct CellEdge {
+    int mirror_cell_index = -1;
+    float forward_weight = 0;
+    float backward_weight = 0;
+  };
 
-      // Extract the mirrored facet of the current cell (opposite orientation).
-      const Delaunay::Facet mirror_facet = triangulation.mirror_facet(facet);
-      const auto& mirror_cell_data = cell_graph_data.at(mirror_facet.first);
+  // The edge weights of the cells are independent and computed in parallel.
+  std::vector<std::array<CellEdge, 4>> cell_edges(cells.size());
+  auto ComputeCellEdges = [&](const size_t begin, const size_t end) {
+    for (size_t cell_idx = begin; cell_idx < end; ++cell_idx) {
+      const auto& cell_data = *cells[cell_idx];
+
+      // Iterate all facets of the current cell to accumulate edge weight.
+      for (int i = 0; i < 4; ++i) {
+        // Compose the current facet.
+        const Delaunay::Facet facet = std::make_pair(cell_data.first, i);
+
+        // Extract the mirrored facet of the current cell (opposite
+        // orientation).
+        const Delaunay::Facet mirror_facet = triangulation.mirror_facet(facet);
+        const auto& mirror_cell_data = cell_graph_data.at(mirror_facet.first);
+
+        // Avoid duplicate edges in graph.
+        if (cell_data.second.index < mirror_cell_data.index) {
+          continue;
+        }
 
-      // Avoid duplicate edges in graph.
-      if (cell_data.second.index < mirror_cell_data.index) {
-        continue;
+        // Implementation of geometry visualized in Figure 9 in P. Labatut,
+        // J‐P. Pons, and R. Keriven. "Robust and efficient surface
+        // reconstruction from range data." Computer graphics forum, 2009.
+        const double edge_shape_weight =
+            options.quality_regularization *
+            (1.0 -
+             std::min(ComputeCosFacetCellAngle(triangulation, facet),
+                      ComputeCosFacetCellAngle(triangulation, mirror_facet)));
+
+        CellEdge& edge = cell_edges[cell_idx][i];
+        edge.mirror_cell_index = mirror_cell_data.index;
+        edge.forward_weight =
+            cell_data.second.edge_weights[facet.second] + edge_shape_weight;
+        edge.backward_weight =
+            mirror_cell_data.edge_weights[mirror_facet.second] +
+            edge_shape_weight;
       }
+    }
+  };
 
-      // Implementation of geometry visualized in Figure 9 in P. Labatut, J‐P.
-      // Pons, and R. Keriven. "Robust and efficient surface reconstruction from
-      // range data." Computer graphics forum, 2009.
-      const double edge_shape_weight =
-          options.quality_regularization *
-          (1.0 -
-           std::min(ComputeCosFacetCellAngle(triangulation, facet),
-                    ComputeCosFacetCellAngle(triangulation, mirror_facet)));
-
-      const float forward_edge_weight =
-          cell_data.second.edge_weights[facet.second] + edge_shape_weight;
-      const float backward_edge_weight =
-          mirror_cell_data.edge_weights[mirror_facet.second] +
-          edge_shape_weight;
-
-      graph_cut.AddEdge(cell_data.second.index,
-                        mirror_cell_data.index,
-                        forward_edge_weight,
-                        backward_edge_weight);
+  const size_t kMinNumCellsPerChunk = 1024;
+  ParallelForChunks(
+      &thread_pool, cells.size(), kMinNumCellsPerChunk, ComputeCellEdges);
+
+  MinSTGraphCut<size_t, float> graph_cut(cells.size());
+  for (size_t cell_idx = 0; cell_idx < cells.size(); ++cell_idx) {
+    graph_cut.AddNode(cell_idx,
+                      cells[cell_idx]->second.source_weight,
+                      cells[cell_idx]->second.sink_weight);
+    for (const CellEdge& edge : cell_edges[cell_idx]) {
+      if (edge.mirror_cell_index >= 0) {
+        graph_cut.AddEdge(cell_idx,
+                          edge.mirror_cell_index,
+                          edge.forward_weight,
+                          edge.backward_weight);
+      }
     }
   }
 
@@ -925,6 +1779,7 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
 
   LOG(INFO) << "Running graph-cut optimization...";
   graph_cut.Compute();
+  LogMemoryUsage();
 
   LOG(INFO) << "Extracting surface as min-cut...";
 
@@ -1038,7 +1893,8 @@ void DenseDelaunayMeshing(const DelaunayMeshingOptions& options,
   timer.Start();
 
   DelaunayMeshingInput input_data;
-  input_data.ReadDenseReconstruction(input_path);
+  input_data.ReadDenseReconstruction(
+      input_path, options.voxel_size, options.num_threads);
 
   const auto mesh = DelaunayMeshing(options, input_data);
 
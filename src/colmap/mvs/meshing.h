@@ -30,10 +30,36 @@
 #pragma once
 
 #include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
 
 namespace colmap {
 namespace mvs {
 
+struct PointCloudDownsamplingOptions {
+  // Edge length of the voxels of the grid, by which the points are merged.
+  // All points in the same voxel are merged into a single point at their mean
+  // position with their mean normal and color, which is visible in the union
+  // of the images observing the merged points.
+  double voxel_size = 0.01;
+
+  // The number of threads to merge the points.
+  int num_threads = -1;
+
+  bool Check() const;
+};
+
+// Downsample the PLY point cloud at input_path by merging the points on a
+// voxel grid into output_path. If the visibility of the input points exists
+// in "<input_path>.vis", the merged visibility is written to
+// "<output_path>.vis". The input is streamed in batches, which are merged by
+// all threads in parallel, such that the memory only scales with the number
+// of occupied voxels instead of the number of input points.
+void DownsamplePointCloud(const PointCloudDownsamplingOptions& options,
+                          const std::string& input_path,
+                          const std::string& output_path);
+
 struct PoissonMeshingOptions {
   // This floating point value specifies the importance that interpolation of
   // the point samples is given in the formulation of the screened Poisson
@@ -61,6 +87,22 @@ struct PoissonMeshingOptions {
   // The number of threads used for the Poisson reconstruction.
   int num_threads = -1;
 
+  // If positive, the input points are partitioned by an octree into blocks of
+  // at most this number of points, which are reconstructed and trimmed one
+  // after another and stitched into a single mesh. The memory then scales
+  // with the size of the blocks instead of the size of the scene.
+  int max_num_block_points = -1;
+
+  // Overlap of the points of neighboring blocks relative to the block size.
+  // The meshes of the blocks are cropped to their blocks before stitching,
+  // such that the seams are not affected by the missing points at the border.
+  double block_overlap = 0.1;
+
+  // If positive, the input points are first merged on a voxel grid of this
+  // size, see DownsamplePointCloud, which avoids meshing points that are far
+  // denser than the resolution of the mesh.
+  double voxel_size = -1;
+
   bool Check() const;
 };
 
@@ -96,6 +138,11 @@ struct DelaunayMeshingOptions {
   // The number of threads to use for reconstruction. Default is all threads.
   int num_threads = -1;
 
+  // If positive, the fused points of dense input are first merged on a voxel
+  // grid of this size together with their visibility, see
+  // DownsamplePointCloud, before they are inserted into the triangulation.
+  double voxel_size = -1;
+
   bool Check() const;
 };
 
@@ -104,6 +151,29 @@ bool PoissonMeshing(const PoissonMeshingOptions& options,
                     const std::string& input_path,
                     const std::string& output_path);
 
+namespace internal {
+
+struct PoissonMeshingBlock {
+  // Depth of the block in the octree, where the root has depth zero.
+  int depth = 0;
+  // Number of points inside the block.
+  size_t num_points = 0;
+  // Box of the block, which is unbounded at the border of the root, such that
+  // the boxes of all blocks partition the space.
+  Eigen::AlignedBox3f box;
+  // Box of the points used for the reconstruction of the block, which is the
+  // bounded box of the block extended by the overlap.
+  Eigen::AlignedBox3f extended_box;
+};
+
+// Partition the points of the PLY file by an octree into blocks of at most
+// the given number of points, unless the maximum depth of the octree is
+// reached. Empty blocks are omitted.
+std::vector<PoissonMeshingBlock> ComputePoissonMeshingBlocks(
+    const std::string& path, int max_num_points, double overlap);
+
+}  // namespace internal
+
 #if defined(COLMAP_CGAL_ENABLED)
 
 // Delaunay meshing of sparse and dense COLMAP reconstructions. This is an
@@ -0,0 +1,183 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/meshing.h"
+
+#include "colmap/mvs/fusion.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/ply.h"
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+// Points on a regular grid in the unit cube with the given number of points
+// along every axis.
+std::vector<PlyPoint> CreateGridPoints(const int num_points_per_axis) {
+  std::vector<PlyPoint> points;
+  for (int x = 0; x < num_points_per_axis; ++x) {
+    for (int y = 0; y < num_points_per_axis; ++y) {
+      for (int z = 0; z < num_points_per_axis; ++z) {
+        PlyPoint& point = points.emplace_back();
+        point.x = static_cast<float>(x) / (num_points_per_axis - 1);
+        point.y = static_cast<float>(y) / (num_points_per_axis - 1);
+        point.z = static_cast<float>(z) / (num_points_per_axis - 1);
+      }
+    }
+  }
+  return points;
+}
+
+bool IsInsideHalfOpenBox(const Eigen::AlignedBox3f& box,
+                         const PlyPoint& point) {
+  const Eigen::Vector3f xyz(point.x, point.y, point.z);
+  return (xyz.array() >= box.min().array()).all() &&
+         (xyz.array() < box.max().array()).all();
+}
+
+TEST(DownsamplePointCloud, Nominal) {
+  const std::string test_dir = CreateTestDir();
+  const std::string input_path = test_dir + "/points.ply";
+  const std::string output_path = test_dir + "/downsampled.ply";
+
+  std::vector<PlyPoint> points(3);
+  points[0].x = 0.1f;
+  points[0].y = 0.1f;
+  points[0].z = 0.1f;
+  points[0].nz = 1;
+  points[0].r = 10;
+  points[1].x = 0.2f;
+  points[1].y = 0.3f;
+  points[1].z = 0.1f;
+  points[1].nz = 1;
+  points[1].r = 20;
+  points[2].x = 0.9f;
+  points[2].y = 0.9f;
+  points[2].z = 0.9f;
+  points[2].nx = 1;
+  WriteBinaryPlyPoints(input_path, points);
+  WritePointsVisibility(input_path + ".vis", {{0, 1}, {2, 1}, {3}});
+
+  PointCloudDownsamplingOptions options;
+  options.voxel_size = 0.5;
+  DownsamplePointCloud(options, input_path, output_path);
+
+  const std::vector<PlyPoint> downsampled_points = ReadPly(output_path);
+  ASSERT_EQ(downsampled_points.size(), 2);
+  EXPECT_NEAR(downsampled_points[0].x, 0.15f, 1e-6);
+  EXPECT_NEAR(downsampled_points[0].y, 0.2f, 1e-6);
+  EXPECT_NEAR(downsampled_points[0].z, 0.1f, 1e-6);
+  EXPECT_EQ(downsampled_points[0].nz, 1);
+  EXPECT_EQ(downsampled_points[0].r, 15);
+  EXPECT_EQ(downsampled_points[1].x, 0.9f);
+  EXPECT_EQ(downsampled_points[1].nx, 1);
+
+  PointsVisibilityReader visibility_reader(output_path + ".vis");
+  ASSERT_EQ(visibility_reader.NumPoints(), 2);
+  std::vector<int> visibility;
+  ASSERT_TRUE(visibility_reader.Next(&visibility));
+  EXPECT_EQ(visibility, (std::vector<int>{0, 1, 2}));
+  ASSERT_TRUE(visibility_reader.Next(&visibility));
+  EXPECT_EQ(visibility, std::vector<int>{3});
+  EXPECT_FALSE(visibility_reader.Next(&visibility));
+}
+
+TEST(DownsamplePointCloud, WithoutVisibility) {
+  const std::string test_dir = CreateTestDir();
+  const std::string input_path = test_dir + "/points.ply";
+  const std::string output_path = test_dir + "/downsampled.ply";
+  WriteBinaryPlyPoints(input_path, CreateGridPoints(10));
+
+  // The coordinates i/9 fall into 5, 4, and 1 voxels per axis.
+  PointCloudDownsamplingOptions options;
+  options.voxel_size = 0.5;
+  options.num_threads = 3;
+  DownsamplePointCloud(options, input_path, output_path);
+  EXPECT_EQ(ReadPly(output_path).size(), 27);
+  EXPECT_FALSE(ExistsFile(output_path + ".vis"));
+}
+
+TEST(ComputePoissonMeshingBlocks, Empty) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  WriteBinaryPlyPoints(path, {});
+  EXPECT_TRUE(internal::ComputePoissonMeshingBlocks(path, 10, 0.1).empty());
+}
+
+TEST(ComputePoissonMeshingBlocks, SingleBlock) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  const std::vector<PlyPoint> points = CreateGridPoints(5);
+  WriteBinaryPlyPoints(path, points);
+  const std::vector<internal::PoissonMeshingBlock> blocks =
+      internal::ComputePoissonMeshingBlocks(path, points.size(), 0.1);
+  ASSERT_EQ(blocks.size(), 1);
+  EXPECT_EQ(blocks[0].depth, 0);
+  EXPECT_EQ(blocks[0].num_points, points.size());
+  EXPECT_TRUE((blocks[0].box.min().array() < -1e6).all());
+  EXPECT_TRUE((blocks[0].box.max().array() > 1e6).all());
+  EXPECT_TRUE(blocks[0].extended_box.contains(Eigen::Vector3f(-0.05, 0, 0)));
+  EXPECT_FALSE(blocks[0].extended_box.contains(Eigen::Vector3f(-0.2, 0, 0)));
+}
+
+TEST(ComputePoissonMeshingBlocks, MultipleBlocks) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  const std::vector<PlyPoint> points = CreateGridPoints(10);
+  WriteBinaryPlyPoints(path, points);
+  const int kMaxNumPoints = 200;
+  const std::vector<internal::PoissonMeshingBlock> blocks =
+      internal::ComputePoissonMeshingBlocks(path, kMaxNumPoints, 0.1);
+  EXPECT_EQ(blocks.size(), 8);
+
+  size_t num_points = 0;
+  for (const auto& block : blocks) {
+    EXPECT_EQ(block.depth, 1);
+    EXPECT_LE(block.num_points, kMaxNumPoints);
+    num_points += block.num_points;
+  }
+  EXPECT_EQ(num_points, points.size());
+
+  // Every point is inside exactly one block and in the extended box of it.
+  for (const auto& point : points) {
+    int num_blocks = 0;
+    for (const auto& block : blocks) {
+      if (IsInsideHalfOpenBox(block.box, point)) {
+        num_blocks += 1;
+        EXPECT_TRUE(block.extended_box.contains(
+            Eigen::Vector3f(point.x, point.y, point.z)));
+      }
+    }
+    EXPECT_EQ(num_blocks, 1);
+  }
+}
+
+}  // namespace
+}  // namespace mvs
+}  // namespace colmap
@@ -31,8 +31,10 @@
 
 #include "colmap/geometry/pose.h"
 #include "colmap/geometry/triangulation.h"
+#include "colmap/image/undistortion.h"
 #include "colmap/scene/projection.h"
 #include "colmap/scene/reconstruction.h"
+#include "colmap/scene/reconstruction_io.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/misc.h"
 
@@ -57,7 +59,18 @@ void Model::ReadFromCOLMAP(const std::string& path,
   Reconstruction reconstruction;
   reconstruction.Read(JoinPaths(path, sparse_path));
 
+  // The distorted cameras share the identifiers of the undistorted cameras.
+  Reconstruction distorted_reconstruction;
+  const std::string distorted_cameras_path =
+      JoinPaths(path, sparse_path, kDistortedCamerasFileName);
+  const bool has_distorted_images = ExistsFile(distorted_cameras_path);
+  if (has_distorted_images) {
+    ReadCamerasBinary(distorted_reconstruction, distorted_cameras_path);
+  }
+
   images.reserve(reconstruction.NumRegImages());
+  distorted_cameras.clear();
+  undistorted_cameras.clear();
   std::unordered_map<image_t, size_t> image_id_to_idx;
   for (size_t i = 0; i < reconstruction.NumRegImages(); ++i) {
     const auto image_id = reconstruction.RegImageIds()[i];
@@ -73,6 +86,11 @@ void Model::ReadFromCOLMAP(const std::string& path,
 
     images.emplace_back(
         image_path, camera.width, camera.height, K.data(), R.data(), T.data());
+    if (has_distorted_images) {
+      distorted_cameras.push_back(
+          distorted_reconstruction.Camera(image.CameraId()));
+      undistorted_cameras.push_back(camera);
+    }
     image_id_to_idx.emplace(image_id, i);
     image_names_.push_back(image.Name());
     image_name_to_idx_.emplace(image.Name(), i);
@@ -32,6 +32,7 @@
 #include "colmap/mvs/depth_map.h"
 #include "colmap/mvs/image.h"
 #include "colmap/mvs/normal_map.h"
+#include "colmap/scene/camera.h"
 
 #include <cstdint>
 #include <fstream>
@@ -91,6 +92,12 @@ struct Model {
   std::vector<Image> images;
   std::vector<Point> points;
 
+  // The distorted and undistorted cameras of the images, in case the
+  // workspace holds the distorted original images, which must be undistorted
+  // when read. Otherwise, both are empty.
+  std::vector<Camera> distorted_cameras;
+  std::vector<Camera> undistorted_cameras;
+
  private:
   bool ReadFromBundlerPMVS(const std::string& path);
   bool ReadFromRawPMVS(const std::string& path);
@@ -31,9 +31,15 @@
 
 #include "colmap/math/math.h"
 #include "colmap/mvs/consistency_graph.h"
+#include "colmap/mvs/gpu_image_cache.h"
 #include "colmap/mvs/patch_match_cuda.h"
+#include "colmap/mvs/patch_match_init.h"
 #include "colmap/mvs/workspace.h"
+#include "colmap/util/cuda.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
+#include "colmap/util/timer.h"
 
 #include <numeric>
 #include <unordered_set>
@@ -43,6 +49,48 @@
 namespace colmap {
 namespace mvs {
 
+namespace {
+
+// Upsample the map of a coarser pyramid level with nearest neighbor
+// interpolation, which does not blend the hypotheses across depth
+// discontinuities.
+void UpsampleMap(const Mat<float>& map, Mat<float>* upsampled_map) {
+  const float scale_x =
+      map.GetWidth() / static_cast<float>(upsampled_map->GetWidth());
+  const float scale_y =
+      map.GetHeight() / static_cast<float>(upsampled_map->GetHeight());
+  for (size_t row = 0; row < upsampled_map->GetHeight(); ++row) {
+    const size_t map_row = std::min(static_cast<size_t>(row * scale_y),
+                                    map.GetHeight() - 1);
+    for (size_t col = 0; col < upsampled_map->GetWidth(); ++col) {
+      const size_t map_col = std::min(static_cast<size_t>(col * scale_x),
+                                      map.GetWidth() - 1);
+      for (size_t slice = 0; slice < map.GetDepth(); ++slice) {
+        upsampled_map->Set(row, col, slice, map.Get(map_row, map_col, slice));
+      }
+    }
+  }
+}
+
+DepthMap UpsampleDepthMap(const DepthMap& depth_map,
+                          const size_t width,
+                          const size_t height) {
+  DepthMap upsampled_depth_map(
+      width, height, depth_map.GetDepthMin(), depth_map.GetDepthMax());
+  UpsampleMap(depth_map, &upsampled_depth_map);
+  return upsampled_depth_map;
+}
+
+NormalMap UpsampleNormalMap(const NormalMap& normal_map,
+                            const size_t width,
+                            const size_t height) {
+  NormalMap upsampled_normal_map(width, height);
+  UpsampleMap(normal_map, &upsampled_normal_map);
+  return upsampled_normal_map;
+}
+
+}  // namespace
+
 PatchMatch::PatchMatch(const PatchMatchOptions& options, const Problem& problem)
     : options_(options), problem_(problem) {}
 
@@ -63,6 +111,11 @@ void PatchMatchOptions::Print() const {
   PrintOption(min_triangulation_angle);
   PrintOption(incident_angle_sigma);
   PrintOption(num_iterations);
+  PrintOption(num_pyramid_levels);
+  PrintOption(num_pyramid_iterations);
+  PrintOption(init_from_sparse_points);
+  PrintOption(init_from_src_maps);
+  PrintOption(init_radius);
   PrintOption(geom_consistency);
   PrintOption(geom_consistency_regularizer);
   PrintOption(geom_consistency_max_cost);
@@ -72,7 +125,12 @@ void PatchMatchOptions::Print() const {
   PrintOption(filter_min_num_consistent);
   PrintOption(filter_geom_consistency_max_cost);
   PrintOption(write_consistency_graph);
+  PrintOption(map_file_format);
   PrintOption(allow_missing_files);
+  PrintOption(bitmap_decoder);
+  PrintOption(num_problems_per_gpu);
+  PrintOption(gpu_cache_size);
+  PrintOption(num_prefetch_problems);
 }
 
 void PatchMatch::Problem::Print() const {
@@ -142,6 +200,16 @@ void PatchMatch::Check() const {
     }
   }
 
+  if (problem_.init_depth_map != nullptr) {
+    const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+    THROW_CHECK_NOTNULL(problem_.init_normal_map);
+    THROW_CHECK_EQ(ref_image.GetWidth(), problem_.init_depth_map->GetWidth());
+    THROW_CHECK_EQ(ref_image.GetHeight(), problem_.init_depth_map->GetHeight());
+    THROW_CHECK_EQ(ref_image.GetWidth(), problem_.init_normal_map->GetWidth());
+    THROW_CHECK_EQ(ref_image.GetHeight(),
+                   problem_.init_normal_map->GetHeight());
+  }
+
   if (options_.geom_consistency) {
     const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
     const NormalMap& ref_normal_map =
@@ -152,11 +220,87 @@ void PatchMatch::Check() const {
 }
 
 void PatchMatch::Run() {
+  COLMAP_PROFILE_SCOPE("PatchMatch::Run");
   PrintHeading2("PatchMatch::Run");
 
   Check();
 
-  patch_match_cuda_ = std::make_unique<PatchMatchCuda>(options_, problem_);
+  if (options_.num_pyramid_levels == 0 || options_.geom_consistency) {
+    patch_match_cuda_ = std::make_unique<PatchMatchCuda>(options_, problem_);
+    patch_match_cuda_->Run();
+    return;
+  }
+
+  std::unordered_set<int> problem_image_idxs(problem_.src_image_idxs.begin(),
+                                             problem_.src_image_idxs.end());
+  problem_image_idxs.insert(problem_.ref_image_idx);
+
+  DepthMap init_depth_map;
+  NormalMap init_normal_map;
+  for (int level = options_.num_pyramid_levels; level > 0; --level) {
+    LOG(INFO) << StringPrintf("Pyramid level %d", level);
+
+    const float factor = 1.0f / (1 << level);
+    std::vector<Image> level_images;
+    level_images.reserve(problem_.images->size());
+    for (size_t image_idx = 0; image_idx < problem_.images->size();
+         ++image_idx) {
+      // Only the images of the problem have a bitmap, which is rescaled.
+      if (problem_image_idxs.count(image_idx) > 0) {
+        level_images.push_back(problem_.images->at(image_idx));
+      } else {
+        const Image& image = problem_.images->at(image_idx);
+        level_images.emplace_back(image.GetPath(),
+                                  image.GetWidth(),
+                                  image.GetHeight(),
+                                  image.GetK(),
+                                  image.GetR(),
+                                  image.GetT());
+      }
+      level_images.back().Rescale(factor);
+    }
+
+    // The filter would invalidate the pixels, from which the next finer
+    // level continues the optimization.
+    PatchMatchOptions level_options = options_;
+    level_options.num_iterations = options_.num_pyramid_iterations;
+    level_options.filter = false;
+
+    // The cached images on the GPU are only valid at the full resolution.
+    Problem level_problem = problem_;
+    level_problem.images = &level_images;
+    level_problem.gpu_image_cache = nullptr;
+    level_problem.init_depth_map = nullptr;
+    level_problem.init_normal_map = nullptr;
+
+    const Image& level_ref_image = level_images.at(problem_.ref_image_idx);
+    if (init_depth_map.GetWidth() > 0) {
+      init_depth_map = UpsampleDepthMap(init_depth_map,
+                                        level_ref_image.GetWidth(),
+                                        level_ref_image.GetHeight());
+      init_normal_map = UpsampleNormalMap(init_normal_map,
+                                          level_ref_image.GetWidth(),
+                                          level_ref_image.GetHeight());
+    }
+
+    PatchMatchCuda patch_match_cuda(
+        level_options,
+        level_problem,
+        init_depth_map.GetWidth() > 0 ? &init_depth_map : nullptr,
+        init_normal_map.GetWidth() > 0 ? &init_normal_map : nullptr);
+    patch_match_cuda.Run();
+    init_depth_map = patch_match_cuda.GetDepthMap();
+    init_normal_map = patch_match_cuda.GetNormalMap();
+  }
+
+  LOG(INFO) << "Pyramid level 0";
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+  init_depth_map = UpsampleDepthMap(
+      init_depth_map, ref_image.GetWidth(), ref_image.GetHeight());
+  init_normal_map = UpsampleNormalMap(
+      init_normal_map, ref_image.GetWidth(), ref_image.GetHeight());
+  patch_match_cuda_ = std::make_unique<PatchMatchCuda>(
+      options_, problem_, &init_depth_map, &init_normal_map);
   patch_match_cuda_->Run();
 }
 
@@ -193,6 +337,7 @@ PatchMatchController::PatchMatchController(const PatchMatchOptions& options,
 }
 
 void PatchMatchController::Run() {
+  COLMAP_PROFILE_SCOPE("PatchMatchController::Run");
   Timer run_timer;
   run_timer.Start();
   ReadWorkspace();
@@ -202,34 +347,45 @@ void PatchMatchController::Run() {
   thread_pool_ = std::make_unique<ThreadPool>(gpu_indices_.size());
 
   // If geometric consistency is enabled, then photometric output must be
-  // computed first for all images without filtering.
+  // computed first without filtering for the reference and source images of a
+  // problem. The geometric problems are scheduled by the finished photometric
+  // problems and take precedence over the remaining photometric problems, such
+  // that their inputs are likely still cached.
   if (options_.geom_consistency) {
     auto photometric_options = options_;
     photometric_options.geom_consistency = false;
     photometric_options.filter = false;
 
+    SchedulePhotometricDependencies();
+
     for (size_t problem_idx = 0; problem_idx < problems_.size();
          ++problem_idx) {
-      thread_pool_->AddTask(&PatchMatchController::ProcessProblem,
-                            this,
-                            photometric_options,
-                            problem_idx);
+      thread_pool_->AddTask([this, photometric_options, problem_idx]() {
+        ProcessProblem(photometric_options, problem_idx);
+        FinishPhotometricProblem(problem_idx);
+      });
+    }
+  } else {
+    for (size_t problem_idx = 0; problem_idx < problems_.size();
+         ++problem_idx) {
+      thread_pool_->AddTask(
+          &PatchMatchController::ProcessProblem, this, options_, problem_idx);
     }
-
-    thread_pool_->Wait();
-  }
-
-  for (size_t problem_idx = 0; problem_idx < problems_.size(); ++problem_idx) {
-    thread_pool_->AddTask(
-        &PatchMatchController::ProcessProblem, this, options_, problem_idx);
   }
 
   thread_pool_->Wait();
+  workspace_->WaitForPrefetch();
+
+  // Release the GPU memory of the cached images.
+  for (auto& gpu_image_cache : gpu_image_caches_) {
+    gpu_image_cache.second.reset();
+  }
 
   run_timer.PrintMinutes();
 }
 
 void PatchMatchController::ReadWorkspace() {
+  COLMAP_PROFILE_SCOPE("PatchMatchController::ReadWorkspace");
   LOG(INFO) << "Reading workspace...";
 
   Workspace::Options workspace_options;
@@ -243,6 +399,7 @@ void PatchMatchController::ReadWorkspace() {
 
   workspace_options.max_image_size = options_.max_image_size;
   workspace_options.image_as_rgb = false;
+  workspace_options.bitmap_decoder = options_.bitmap_decoder;
   workspace_options.cache_size = options_.cache_size;
   workspace_options.workspace_path = workspace_path_;
   workspace_options.workspace_format = workspace_format_;
@@ -257,9 +414,20 @@ void PatchMatchController::ReadWorkspace() {
   }
 
   depth_ranges_ = workspace_->GetModel().ComputeDepthRanges();
+
+  if (options_.init_from_sparse_points) {
+    const Model& model = workspace_->GetModel();
+    image_point_idxs_.resize(model.images.size());
+    for (size_t point_idx = 0; point_idx < model.points.size(); ++point_idx) {
+      for (const int image_idx : model.points[point_idx].track) {
+        image_point_idxs_.at(image_idx).push_back(point_idx);
+      }
+    }
+  }
 }
 
 void PatchMatchController::ReadProblems() {
+  COLMAP_PROFILE_SCOPE("PatchMatchController::ReadProblems");
   LOG(INFO) << "Reading configuration...";
 
   problems_.clear();
@@ -273,12 +441,6 @@ void PatchMatchController::ReadProblems() {
                            : config_path_;
   std::vector<std::string> config = ReadTextFileLines(config_path);
 
-  std::vector<std::map<int, int>> shared_num_points;
-  std::vector<std::map<int, float>> triangulation_angles;
-
-  const float min_triangulation_angle_rad =
-      DegToRad(options_.min_triangulation_angle);
-
   std::string ref_image_name;
   std::unordered_set<int> ref_image_idxs;
 
@@ -332,48 +494,13 @@ void PatchMatchController::ReadProblems() {
       // will be sorted based on the number of shared points to the reference
       // image and the top ranked images are selected. Note that images are only
       // selected if some points have a sufficient triangulation angle.
-
-      if (shared_num_points.empty()) {
-        shared_num_points = model.ComputeSharedPoints();
-      }
-      if (triangulation_angles.empty()) {
-        const float kTriangulationAnglePercentile = 75;
-        triangulation_angles =
-            model.ComputeTriangulationAngles(kTriangulationAnglePercentile);
-      }
-
       const size_t max_num_src_images =
           std::stoll(problem_config.src_image_names[1]);
-
-      const auto& overlapping_images =
-          shared_num_points.at(problem.ref_image_idx);
-      const auto& overlapping_triangulation_angles =
-          triangulation_angles.at(problem.ref_image_idx);
-
-      std::vector<std::pair<int, int>> src_images;
-      src_images.reserve(overlapping_images.size());
-      for (const auto& image : overlapping_images) {
-        if (overlapping_triangulation_angles.at(image.first) >=
-            min_triangulation_angle_rad) {
-          src_images.emplace_back(image.first, image.second);
-        }
-      }
-
-      const size_t eff_max_num_src_images =
-          std::min(src_images.size(), max_num_src_images);
-
-      std::partial_sort(src_images.begin(),
-                        src_images.begin() + eff_max_num_src_images,
-                        src_images.end(),
-                        [](const std::pair<int, int>& image1,
-                           const std::pair<int, int>& image2) {
-                          return image1.second > image2.second;
-                        });
-
-      problem.src_image_idxs.reserve(eff_max_num_src_images);
-      for (size_t i = 0; i < eff_max_num_src_images; ++i) {
-        problem.src_image_idxs.push_back(src_images[i].first);
-      }
+      problem.src_image_idxs =
+          workspace_->GetViewSelectionIndex().SelectImages(
+              problem.ref_image_idx,
+              max_num_src_images,
+              options_.min_triangulation_angle);
     } else {
       problem.src_image_idxs.reserve(problem_config.src_image_names.size());
       for (const auto& src_image_name : problem_config.src_image_names) {
@@ -403,10 +530,133 @@ void PatchMatchController::ReadGpuIndices() {
     gpu_indices_.resize(num_cuda_devices);
     std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
   }
+
+  // Assign each GPU to multiple threads in interleaved order, such that
+  // consecutive problems are distributed over all GPUs.
+  const std::vector<int> gpu_indices = gpu_indices_;
+  gpu_indices_.clear();
+  for (int i = 0; i < options_.num_problems_per_gpu; ++i) {
+    gpu_indices_.insert(
+        gpu_indices_.end(), gpu_indices.begin(), gpu_indices.end());
+  }
+
+  for (const int gpu_index : gpu_indices_) {
+    if (gpu_mutexes_.count(gpu_index) == 0) {
+      gpu_mutexes_.emplace(gpu_index, std::make_unique<std::mutex>());
+      gpu_image_caches_.emplace(gpu_index, nullptr);
+    }
+  }
+}
+
+void PatchMatchController::SchedulePhotometricDependencies() {
+  std::unordered_map<int, std::vector<size_t>> photometric_problem_idxs;
+  for (size_t problem_idx = 0; problem_idx < problems_.size(); ++problem_idx) {
+    photometric_problem_idxs[problems_[problem_idx].ref_image_idx].push_back(
+        problem_idx);
+  }
+
+  // The outputs of images without photometric problems must already exist.
+  num_pending_photometric_problems_.assign(problems_.size(), 0);
+  geometric_problem_idxs_.assign(problems_.size(), {});
+  for (size_t problem_idx = 0; problem_idx < problems_.size(); ++problem_idx) {
+    const auto& problem = problems_[problem_idx];
+    std::unordered_set<int> used_image_idxs(problem.src_image_idxs.begin(),
+                                            problem.src_image_idxs.end());
+    used_image_idxs.insert(problem.ref_image_idx);
+    for (const int image_idx : used_image_idxs) {
+      const auto it = photometric_problem_idxs.find(image_idx);
+      if (it == photometric_problem_idxs.end()) {
+        continue;
+      }
+      for (const size_t photometric_problem_idx : it->second) {
+        geometric_problem_idxs_[photometric_problem_idx].push_back(problem_idx);
+        num_pending_photometric_problems_[problem_idx] += 1;
+      }
+    }
+  }
+}
+
+void PatchMatchController::FinishPhotometricProblem(const size_t problem_idx) {
+  std::unique_lock<std::mutex> lock(schedule_mutex_);
+  finished_photometric_image_idxs_.insert(problems_[problem_idx].ref_image_idx);
+  for (const size_t geometric_problem_idx :
+       geometric_problem_idxs_[problem_idx]) {
+    if (--num_pending_photometric_problems_[geometric_problem_idx] == 0) {
+      thread_pool_->AddTaskWithPriority(ThreadPool::Priority::HIGH,
+                                        &PatchMatchController::ProcessProblem,
+                                        this,
+                                        options_,
+                                        geometric_problem_idx);
+    }
+  }
+}
+
+void PatchMatchController::ComputeInitMaps(const PatchMatchOptions& options,
+                                           const PatchMatch::Problem& problem,
+                                           DepthMap* init_depth_map,
+                                           NormalMap* init_normal_map) {
+  const Model& model = workspace_->GetModel();
+  const Image& ref_image = problem.images->at(problem.ref_image_idx);
+  *init_depth_map = DepthMap(ref_image.GetWidth(),
+                             ref_image.GetHeight(),
+                             options.depth_min,
+                             options.depth_max);
+  *init_normal_map = NormalMap(ref_image.GetWidth(), ref_image.GetHeight());
+
+  if (options.init_from_sparse_points) {
+    std::vector<Eigen::Vector3f> points;
+    for (const int point_idx : image_point_idxs_.at(problem.ref_image_idx)) {
+      const Model::Point& point = model.points[point_idx];
+      points.emplace_back(point.x, point.y, point.z);
+    }
+    SplatPointsIntoDepthMap(ref_image,
+                            points,
+                            /*normals=*/{},
+                            options.init_radius,
+                            init_depth_map,
+                            init_normal_map);
+  }
+
+  // The photometric maps of the source images are only available in the
+  // workspace, if they are used for the geometric pass.
+  if (options.init_from_src_maps &&
+      workspace_->GetOptions().input_type == "photometric") {
+    std::vector<Eigen::Vector3f> points;
+    std::vector<Eigen::Vector3f> normals;
+    for (const int src_image_idx : problem.src_image_idxs) {
+      {
+        std::unique_lock<std::mutex> lock(schedule_mutex_);
+        if (finished_photometric_image_idxs_.count(src_image_idx) == 0) {
+          continue;
+        }
+      }
+      {
+        std::unique_lock<std::mutex> lock(workspace_mutex_);
+        if (!workspace_->HasDepthMap(src_image_idx) ||
+            !workspace_->HasNormalMap(src_image_idx)) {
+          continue;
+        }
+        // Sample the source maps about as densely as the splatted windows.
+        BackProjectDepthMap(model.images.at(src_image_idx),
+                            workspace_->GetDepthMap(src_image_idx),
+                            workspace_->GetNormalMap(src_image_idx),
+                            options.init_radius + 1,
+                            &points,
+                            &normals);
+      }
+      SplatPointsIntoDepthMap(ref_image,
+                              points,
+                              normals,
+                              options.init_radius,
+                              init_depth_map,
+                              init_normal_map);
+    }
+  }
 }
 
 void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
                                           const size_t problem_idx) {
+  COLMAP_PROFILE_SCOPE("PatchMatchController::ProcessProblem");
   if (CheckIfStopped()) {
     return;
   }
@@ -436,6 +686,12 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
     return;
   }
 
+  // Read the inputs of the next problems on CPU threads while the GPU
+  // processes the current problem.
+  for (int i = 1; i <= options.num_prefetch_problems; ++i) {
+    PrefetchProblem(options, problem_idx + i);
+  }
+
   PrintHeading1(StringPrintf("Processing view %d / %d for %s",
                              problem_idx + 1,
                              problems_.size(),
@@ -482,6 +738,10 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
         std::min(static_cast<int>(used_image_idxs.size()) - 1,
                  patch_match_options.filter_min_num_consistent);
 
+    // Inputs that are still being prefetched must not be read twice.
+    workspace_->WaitForPrefetch(
+        {used_image_idxs.begin(), used_image_idxs.end()});
+
     // Only access workspace from one thread at a time and only spawn resample
     // threads from one master thread at a time.
     std::unique_lock<std::mutex> lock(workspace_mutex_);
@@ -523,22 +783,107 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
     problem.src_image_idxs = src_image_idxs;
   }
 
+  DepthMap init_depth_map;
+  NormalMap init_normal_map;
+  problem.init_depth_map = nullptr;
+  problem.init_normal_map = nullptr;
+  if (!options.geom_consistency && (options.init_from_sparse_points ||
+                                    options.init_from_src_maps)) {
+    ComputeInitMaps(
+        patch_match_options, problem, &init_depth_map, &init_normal_map);
+    problem.init_depth_map = &init_depth_map;
+    problem.init_normal_map = &init_normal_map;
+  }
+
   problem.Print();
   patch_match_options.Print();
 
-  PatchMatch patch_match(patch_match_options, problem);
-  patch_match.Run();
+  DepthMap depth_map;
+  NormalMap normal_map;
+  ConsistencyGraph consistency_graph;
+  {
+    // The kernels keep the reference calibration in the constant memory of
+    // the device and synchronize the entire device, such that only one
+    // problem per GPU runs at a time. The other problems of the same GPU
+    // read their inputs and write their outputs in the meantime.
+    std::unique_lock<std::mutex> lock(*gpu_mutexes_.at(gpu_index));
+    Timer gpu_timer;
+    gpu_timer.Start();
+    if (options.gpu_cache_size != 0) {
+      auto& gpu_image_cache = gpu_image_caches_.at(gpu_index);
+      if (!gpu_image_cache) {
+        SetBestCudaDevice(gpu_index);
+        gpu_image_cache =
+            std::make_shared<GpuImageCache>(options.gpu_cache_size);
+      }
+      problem.gpu_image_cache = gpu_image_cache.get();
+    }
+    PatchMatch patch_match(patch_match_options, problem);
+    patch_match.Run();
+    depth_map = patch_match.GetDepthMap();
+    normal_map = patch_match.GetNormalMap();
+    if (options.write_consistency_graph) {
+      consistency_graph = patch_match.GetConsistencyGraph();
+    }
+    // The utilization of the GPU is the rate of its busy time.
+    MetricsRegistry::Instance()
+        .Counter("colmap_patch_match_gpu_busy_seconds_total",
+                 "Time the GPU was used by PatchMatch",
+                 {{"gpu", std::to_string(gpu_index)}})
+        ->Increment(gpu_timer.ElapsedSeconds());
+  }
 
   LOG(INFO) << std::endl
             << StringPrintf("Writing %s output for %s",
                             output_type.c_str(),
                             image_name.c_str());
 
-  patch_match.GetDepthMap().Write(depth_map_path);
-  patch_match.GetNormalMap().Write(normal_map_path);
+  const MatFileFormat map_file_format =
+      MatFileFormatFromString(options.map_file_format);
+  depth_map.Write(depth_map_path, map_file_format);
+  normal_map.Write(normal_map_path, map_file_format);
   if (options.write_consistency_graph) {
-    patch_match.GetConsistencyGraph().Write(consistency_graph_path);
+    consistency_graph.Write(consistency_graph_path);
+  }
+
+  // The photometric maps are kept in the workspace for the geometric pass, if
+  // they are stored lossless, such that they are not read back from disk.
+  if (options_.geom_consistency && !options.geom_consistency &&
+      map_file_format == MatFileFormat::FLOAT) {
+    std::unique_lock<std::mutex> lock(workspace_mutex_);
+    workspace_->InsertMaps(
+        problem.ref_image_idx, std::move(depth_map), std::move(normal_map));
+  }
+
+  MetricsRegistry::Instance()
+      .Counter("colmap_patch_match_problems_total",
+               "Number of processed PatchMatch problems",
+               {{"type", output_type}})
+      ->Increment();
+}
+
+void PatchMatchController::PrefetchProblem(const PatchMatchOptions& options,
+                                           const size_t problem_idx) {
+  if (problem_idx >= problems_.size()) {
+    return;
+  }
+
+  // The photometric maps of geometric problems, which are not yet scheduled,
+  // may not have been written yet.
+  if (options.geom_consistency) {
+    std::unique_lock<std::mutex> lock(schedule_mutex_);
+    if (num_pending_photometric_problems_.at(problem_idx) > 0) {
+      return;
+    }
+  }
+
+  // The source images of a problem are pruned while it is being processed.
+  std::unique_lock<std::mutex> lock(workspace_mutex_);
+  const auto& problem = problems_[problem_idx];
+  for (const int image_idx : problem.src_image_idxs) {
+    workspace_->Prefetch(image_idx, options.geom_consistency);
   }
+  workspace_->Prefetch(problem.ref_image_idx, options.geom_consistency);
 }
 
 }  // namespace mvs
@@ -40,6 +40,9 @@
 
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace colmap {
@@ -53,6 +56,8 @@ const static size_t kMaxPatchMatchWindowRadius = 32;
 class ConsistencyGraph;
 class PatchMatchCuda;
 class Workspace;
+class CachedWorkspace;
+class GpuImageCache;
 
 struct PatchMatchOptions {
   // Maximum image size in either dimension.
@@ -62,6 +67,12 @@ struct PatchMatchOptions {
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
   std::string gpu_index = "-1";
 
+  // Number of problems that are processed concurrently for each GPU. While
+  // one of them runs on the GPU, the others read their inputs and write
+  // their outputs, such that the GPU does not idle between problems. The GPU
+  // memory is only held by the running problem.
+  int num_problems_per_gpu = 1;
+
   // Depth range in which to randomly sample depth hypotheses.
   double depth_min = -1.0f;
   double depth_max = -1.0f;
@@ -96,6 +107,33 @@ struct PatchMatchOptions {
   // of four sweeps from left to right, top to bottom, and vice versa.
   int num_iterations = 5;
 
+  // Number of coarser pyramid levels, on which patch match runs before the
+  // full resolution, where each level halves the resolution of the next
+  // finer level. The depth and normal maps of a level are upsampled to
+  // initialize the next finer level, such that fewer iterations suffice at
+  // the finer levels. Only used without geometric consistency, since the
+  // geometric pass is initialized with the photometric depth and normal maps.
+  int num_pyramid_levels = 0;
+
+  // Number of coordinate descent iterations at the coarser pyramid levels.
+  int num_pyramid_iterations = 3;
+
+  // Whether to initialize the depth and normal hypotheses of the photometric
+  // pass at the projections of the sparse 3D points observed by the reference
+  // image instead of randomly, such that fewer iterations are spent on
+  // finding the surface. The sparse normals face the camera.
+  bool init_from_sparse_points = false;
+
+  // Whether to additionally initialize the hypotheses from the photometric
+  // depth and normal maps of source images that were already computed. Only
+  // used with geometric consistency, which keeps these maps in the workspace.
+  bool init_from_src_maps = false;
+
+  // Radius of the window in pixels that is initialized around every
+  // projected point. Both initializations are only used for the finest level
+  // at the full resolution, i.e., without pyramid levels.
+  int init_radius = 2;
+
   // Whether to add a regularized geometric consistency term to the cost
   // function. If true, the `depth_maps` and `normal_maps` must not be null.
   bool geom_consistency = true;
@@ -132,12 +170,32 @@ struct PatchMatchOptions {
   // of memory, if the consistency graph is dense.
   double cache_size = 32.0;
 
+  // Cache size in gigabytes for the source images and depth maps that are
+  // kept in GPU memory across problems, such that the source images shared
+  // by neighboring problems are not uploaded again. If negative, a quarter of
+  // the free memory of each GPU is used. Set to 0 to disable the cache.
+  double gpu_cache_size = -1.0;
+
   // Whether to tolerate missing images/maps in the problem setup
   bool allow_missing_files = false;
 
   // Whether to write the consistency graph.
   bool write_consistency_graph = false;
 
+  // The file format of the output depth and normal maps, i.e., float, half,
+  // or half_lz4, see MatFileFormat. The half precision formats reduce the
+  // size of the stereo folder by half or more and are read transparently by
+  // all consumers of the depth and normal maps.
+  std::string map_file_format = "float";
+
+  // The backend used to decode the images, see ImageReaderOptions.
+  std::string bitmap_decoder = "freeimage";
+
+  // Number of upcoming problems, whose images and depth/normal maps are read
+  // and decoded into the cache on CPU threads while the GPU processes the
+  // current problem. Set to 0 to read all inputs on demand.
+  int num_prefetch_problems = 2;
+
   void Print() const;
   bool Check() const {
     if (depth_min != -1.0f || depth_max != -1.0f) {
@@ -156,6 +214,9 @@ struct PatchMatchOptions {
     CHECK_OPTION_LT(min_triangulation_angle, 180.0f);
     CHECK_OPTION_GT(incident_angle_sigma, 0.0f);
     CHECK_OPTION_GT(num_iterations, 0);
+    CHECK_OPTION_GE(num_pyramid_levels, 0);
+    CHECK_OPTION_GT(num_pyramid_iterations, 0);
+    CHECK_OPTION_GE(init_radius, 0);
     CHECK_OPTION_GE(geom_consistency_regularizer, 0.0f);
     CHECK_OPTION_GE(geom_consistency_max_cost, 0.0f);
     CHECK_OPTION_GE(filter_min_ncc, -1.0f);
@@ -165,6 +226,10 @@ struct PatchMatchOptions {
     CHECK_OPTION_GE(filter_min_num_consistent, 0);
     CHECK_OPTION_GE(filter_geom_consistency_max_cost, 0.0f);
     CHECK_OPTION_GT(cache_size, 0);
+    CHECK_OPTION(map_file_format == "float" || map_file_format == "half" ||
+                 map_file_format == "half_lz4");
+    CHECK_OPTION_GT(num_problems_per_gpu, 0);
+    CHECK_OPTION_GE(num_prefetch_problems, 0);
     return true;
   }
 };
@@ -190,6 +255,15 @@ class PatchMatch {
     // Input normal maps for the geometric consistency term.
     std::vector<NormalMap>* normal_maps = nullptr;
 
+    // Optional cache of source images and depth maps on the GPU of the
+    // problem, which must not be accessed concurrently by other problems.
+    GpuImageCache* gpu_image_cache = nullptr;
+
+    // Optional sparse initial depth and normal map of the reference image.
+    // The pixels with positive depth replace the random initialization.
+    const DepthMap* init_depth_map = nullptr;
+    const NormalMap* init_normal_map = nullptr;
+
     // Print the configuration to stdout.
     void Print() const;
   };
@@ -259,7 +333,20 @@ class PatchMatchController : public BaseController {
   void ReadWorkspace();
   void ReadProblems();
   void ReadGpuIndices();
+  // Compute the sparse initial depth and normal map of the problem.
+  void ComputeInitMaps(const PatchMatchOptions& options,
+                       const PatchMatch::Problem& problem,
+                       DepthMap* init_depth_map,
+                       NormalMap* init_normal_map);
   void ProcessProblem(const PatchMatchOptions& options, size_t problem_idx);
+  // Asynchronously read the inputs of the given problem into the workspace.
+  void PrefetchProblem(const PatchMatchOptions& options, size_t problem_idx);
+
+  // With geometric consistency, the geometric pass of a problem starts as
+  // soon as the photometric pass of all problems of its reference and source
+  // images finished, instead of after the photometric pass of all problems.
+  void SchedulePhotometricDependencies();
+  void FinishPhotometricProblem(size_t problem_idx);
 
   const PatchMatchOptions options_;
   const std::string workspace_path_;
@@ -269,10 +356,24 @@ class PatchMatchController : public BaseController {
 
   std::unique_ptr<ThreadPool> thread_pool_;
   std::mutex workspace_mutex_;
-  std::unique_ptr<Workspace> workspace_;
+  std::unique_ptr<CachedWorkspace> workspace_;
   std::vector<PatchMatch::Problem> problems_;
   std::vector<int> gpu_indices_;
+  std::unordered_map<int, std::unique_ptr<std::mutex>> gpu_mutexes_;
+  std::unordered_map<int, std::shared_ptr<GpuImageCache>> gpu_image_caches_;
   std::vector<std::pair<float, float>> depth_ranges_;
+
+  // The indices of the sparse 3D points observed by every image.
+  std::vector<std::vector<int>> image_point_idxs_;
+
+  // The number of unfinished photometric problems each geometric problem
+  // depends on and the geometric problems depending on each photometric one.
+  std::mutex schedule_mutex_;
+  std::vector<size_t> num_pending_photometric_problems_;
+  std::vector<std::vector<size_t>> geometric_problem_idxs_;
+
+  // The reference images whose photometric problems finished.
+  std::unordered_set<int> finished_photometric_image_idxs_;
 };
 
 #endif
@@ -30,6 +30,8 @@
 #define _USE_MATH_DEFINES
 
 #include "colmap/mvs/patch_match_cuda.h"
+
+#include "colmap/mvs/gpu_image_cache.h"
 #include "colmap/util/cuda.h"
 #include "colmap/util/cudacc.h"
 #include "colmap/util/logging.h"
@@ -819,6 +821,25 @@ __global__ void RotateNormalMap(GpuMat<float> normal_map) {
   }
 }
 
+// Replace the depths and normals by the sparse initial hypotheses at pixels
+// with a positive initial depth.
+__global__ void InitFromSparseMaps(GpuMat<float> depth_map,
+                                   GpuMat<float> normal_map,
+                                   const GpuMat<float> sparse_depth_map,
+                                   const GpuMat<float> sparse_normal_map) {
+  const int row = blockDim.y * blockIdx.y + threadIdx.y;
+  const int col = blockDim.x * blockIdx.x + threadIdx.x;
+  if (col < depth_map.GetWidth() && row < depth_map.GetHeight()) {
+    const float depth = sparse_depth_map.Get(row, col);
+    if (depth > 0) {
+      depth_map.Set(row, col, depth);
+      float normal[3];
+      sparse_normal_map.GetSlice(row, col, normal);
+      normal_map.SetSlice(row, col, normal);
+    }
+  }
+}
+
 template <int kWindowSize, int kWindowStep>
 __global__ void ComputeInitialCost(GpuMat<float> cost_map,
                                    const GpuMat<float> depth_map,
@@ -886,6 +907,10 @@ struct SweepOptions {
   float filter_min_triangulation_angle = 3.0f;
   int filter_min_num_consistent = 2;
   float filter_geom_consistency_max_cost = 1.0f;
+  // Whether to record the consistent images of each pixel in the consistency
+  // mask. Otherwise, the mask is not allocated and the filtering only counts
+  // the consistent images.
+  bool write_consistency_mask = false;
 };
 
 template <int kWindowSize,
@@ -1191,7 +1216,9 @@ __global__ void SweepFromTopToBottom(
 
         if (!kFilterGeomConsistency) {
           if (sel_prob_map.Get(row, col, image_idx) >= min_ncc_prob) {
-            consistency_mask.Set(row, col, image_idx, 1);
+            if (options.write_consistency_mask) {
+              consistency_mask.Set(row, col, image_idx, 1);
+            }
             num_consistent += 1;
           }
         } else if (!kFilterPhotoConsistency) {
@@ -1203,7 +1230,9 @@ __global__ void SweepFromTopToBottom(
                                          image_idx,
                                          options.geom_consistency_max_cost) <=
               options.filter_geom_consistency_max_cost) {
-            consistency_mask.Set(row, col, image_idx, 1);
+            if (options.write_consistency_mask) {
+              consistency_mask.Set(row, col, image_idx, 1);
+            }
             num_consistent += 1;
           }
         } else {
@@ -1216,7 +1245,9 @@ __global__ void SweepFromTopToBottom(
                                          image_idx,
                                          options.geom_consistency_max_cost) <=
                   options.filter_geom_consistency_max_cost) {
-            consistency_mask.Set(row, col, image_idx, 1);
+            if (options.write_consistency_mask) {
+              consistency_mask.Set(row, col, image_idx, 1);
+            }
             num_consistent += 1;
           }
         }
@@ -1227,8 +1258,11 @@ __global__ void SweepFromTopToBottom(
         normal_map.Set(row, col, 0, 0.0f);
         normal_map.Set(row, col, 1, 0.0f);
         normal_map.Set(row, col, 2, 0.0f);
-        for (int image_idx = 0; image_idx < cost_map.GetDepth(); ++image_idx) {
-          consistency_mask.Set(row, col, image_idx, 0);
+        if (options.write_consistency_mask) {
+          for (int image_idx = 0; image_idx < cost_map.GetDepth();
+               ++image_idx) {
+            consistency_mask.Set(row, col, image_idx, 0);
+          }
         }
       }
     }
@@ -1245,8 +1279,38 @@ __global__ void SweepFromTopToBottom(
   }
 }
 
+namespace {
+
+cudaTextureDesc CreateSrcImagesTextureDesc() {
+  cudaTextureDesc texture_desc;
+  memset(&texture_desc, 0, sizeof(texture_desc));
+  texture_desc.addressMode[0] = cudaAddressModeBorder;
+  texture_desc.addressMode[1] = cudaAddressModeBorder;
+  texture_desc.addressMode[2] = cudaAddressModeBorder;
+  texture_desc.filterMode = cudaFilterModeLinear;
+  texture_desc.readMode = cudaReadModeNormalizedFloat;
+  texture_desc.normalizedCoords = false;
+  return texture_desc;
+}
+
+cudaTextureDesc CreateSrcDepthMapsTextureDesc() {
+  cudaTextureDesc texture_desc;
+  memset(&texture_desc, 0, sizeof(texture_desc));
+  texture_desc.addressMode[0] = cudaAddressModeBorder;
+  texture_desc.addressMode[1] = cudaAddressModeBorder;
+  texture_desc.addressMode[2] = cudaAddressModeBorder;
+  texture_desc.filterMode = cudaFilterModePoint;
+  texture_desc.readMode = cudaReadModeElementType;
+  texture_desc.normalizedCoords = false;
+  return texture_desc;
+}
+
+}  // namespace
+
 PatchMatchCuda::PatchMatchCuda(const PatchMatchOptions& options,
-                               const PatchMatch::Problem& problem)
+                               const PatchMatch::Problem& problem,
+                               const DepthMap* init_depth_map,
+                               const NormalMap* init_normal_map)
     : options_(options),
       problem_(problem),
       ref_width_(0),
@@ -1256,7 +1320,7 @@ PatchMatchCuda::PatchMatchCuda(const PatchMatchOptions& options,
   InitRefImage();
   InitSourceImages();
   InitTransforms();
-  InitWorkspaceMemory();
+  InitWorkspaceMemory(init_depth_map, init_normal_map);
 }
 
 void PatchMatchCuda::Run() {
@@ -1393,6 +1457,8 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
   sweep_options.filter_min_num_consistent = options_.filter_min_num_consistent;
   sweep_options.filter_geom_consistency_max_cost =
       options_.filter_geom_consistency_max_cost;
+  sweep_options.write_consistency_mask =
+      options_.filter && options_.write_consistency_graph;
 
   for (int iter = 0; iter < options_.num_iterations; ++iter) {
     CudaTimer iter_timer;
@@ -1435,7 +1501,7 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
           sweep_options);
 
       if (last_sweep) {
-        if (options_.filter) {
+        if (sweep_options.write_consistency_mask) {
           consistency_mask_.reset(new GpuMat<uint8_t>(cost_map_->GetWidth(),
                                                       cost_map_->GetHeight(),
                                                       cost_map_->GetDepth()));
@@ -1483,7 +1549,7 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
       Rotate();
 
       // Rotate selected image map.
-      if (last_sweep && options_.filter) {
+      if (last_sweep && sweep_options.write_consistency_mask) {
         std::unique_ptr<GpuMat<uint8_t>> rot_consistency_mask_(
             new GpuMat<uint8_t>(cost_map_->GetWidth(),
                                 cost_map_->GetHeight(),
@@ -1565,7 +1631,12 @@ void PatchMatchCuda::InitSourceImages() {
   }
 
   // Upload source images to device.
-  {
+  if (problem_.gpu_image_cache != nullptr) {
+    src_images_texture_ = CudaArrayLayeredTexture<uint8_t>::FromGpuMat(
+        CreateSrcImagesTextureDesc(),
+        *problem_.gpu_image_cache->StackImages(
+            problem_.src_image_idxs, *problem_.images, max_width, max_height));
+  } else {
     // Copy source images to contiguous memory block.
     const uint8_t kDefaultValue = 0;
     std::vector<uint8_t> src_images_host_data(
@@ -1582,17 +1653,8 @@ void PatchMatchCuda::InitSourceImages() {
       }
     }
 
-    // Create source images texture.
-    cudaTextureDesc texture_desc;
-    memset(&texture_desc, 0, sizeof(texture_desc));
-    texture_desc.addressMode[0] = cudaAddressModeBorder;
-    texture_desc.addressMode[1] = cudaAddressModeBorder;
-    texture_desc.addressMode[2] = cudaAddressModeBorder;
-    texture_desc.filterMode = cudaFilterModeLinear;
-    texture_desc.readMode = cudaReadModeNormalizedFloat;
-    texture_desc.normalizedCoords = false;
     src_images_texture_ = CudaArrayLayeredTexture<uint8_t>::FromHostArray(
-        texture_desc,
+        CreateSrcImagesTextureDesc(),
         max_width,
         max_height,
         problem_.src_image_idxs.size(),
@@ -1600,7 +1662,14 @@ void PatchMatchCuda::InitSourceImages() {
   }
 
   // Upload source depth maps to device.
-  if (options_.geom_consistency) {
+  if (options_.geom_consistency && problem_.gpu_image_cache != nullptr) {
+    src_depth_maps_texture_ = CudaArrayLayeredTexture<float>::FromGpuMat(
+        CreateSrcDepthMapsTextureDesc(),
+        *problem_.gpu_image_cache->StackDepthMaps(problem_.src_image_idxs,
+                                                  *problem_.depth_maps,
+                                                  max_width,
+                                                  max_height));
+  } else if (options_.geom_consistency) {
     const float kDefaultValue = 0.0f;
     std::vector<float> src_depth_maps_host_data(
         static_cast<size_t>(max_width * max_height *
@@ -1619,17 +1688,8 @@ void PatchMatchCuda::InitSourceImages() {
       }
     }
 
-    // Create source depth maps texture.
-    cudaTextureDesc texture_desc;
-    memset(&texture_desc, 0, sizeof(texture_desc));
-    texture_desc.addressMode[0] = cudaAddressModeBorder;
-    texture_desc.addressMode[1] = cudaAddressModeBorder;
-    texture_desc.addressMode[2] = cudaAddressModeBorder;
-    texture_desc.filterMode = cudaFilterModePoint;
-    texture_desc.readMode = cudaReadModeElementType;
-    texture_desc.normalizedCoords = false;
     src_depth_maps_texture_ = CudaArrayLayeredTexture<float>::FromHostArray(
-        texture_desc,
+        CreateSrcDepthMapsTextureDesc(),
         max_width,
         max_height,
         problem_.src_image_idxs.size(),
@@ -1753,15 +1813,23 @@ void PatchMatchCuda::InitTransforms() {
   }
 }
 
-void PatchMatchCuda::InitWorkspaceMemory() {
+void PatchMatchCuda::InitWorkspaceMemory(const DepthMap* init_depth_map,
+                                         const NormalMap* init_normal_map) {
+  if (init_depth_map == nullptr && options_.geom_consistency) {
+    init_depth_map = &problem_.depth_maps->at(problem_.ref_image_idx);
+  }
+  if (init_normal_map == nullptr && options_.geom_consistency) {
+    init_normal_map = &problem_.normal_maps->at(problem_.ref_image_idx);
+  }
+
   rand_state_map_.reset(new GpuMatPRNG(ref_width_, ref_height_));
 
   depth_map_.reset(new GpuMat<float>(ref_width_, ref_height_));
-  if (options_.geom_consistency) {
-    const DepthMap& init_depth_map =
-        problem_.depth_maps->at(problem_.ref_image_idx);
-    depth_map_->CopyToDevice(init_depth_map.GetPtr(),
-                             init_depth_map.GetWidth() * sizeof(float));
+  if (init_depth_map != nullptr) {
+    THROW_CHECK_EQ(init_depth_map->GetWidth(), ref_width_);
+    THROW_CHECK_EQ(init_depth_map->GetHeight(), ref_height_);
+    depth_map_->CopyToDevice(init_depth_map->GetPtr(),
+                             init_depth_map->GetWidth() * sizeof(float));
   } else {
     depth_map_->FillWithRandomNumbers(
         options_.depth_min, options_.depth_max, *rand_state_map_);
@@ -1791,15 +1859,36 @@ void PatchMatchCuda::InitWorkspaceMemory() {
 
   ComputeCudaConfig();
 
-  if (options_.geom_consistency) {
-    const NormalMap& init_normal_map =
-        problem_.normal_maps->at(problem_.ref_image_idx);
-    normal_map_->CopyToDevice(init_normal_map.GetPtr(),
-                              init_normal_map.GetWidth() * sizeof(float));
+  if (init_normal_map != nullptr) {
+    THROW_CHECK_EQ(init_normal_map->GetWidth(), ref_width_);
+    THROW_CHECK_EQ(init_normal_map->GetHeight(), ref_height_);
+    normal_map_->CopyToDevice(init_normal_map->GetPtr(),
+                              init_normal_map->GetWidth() * sizeof(float));
   } else {
     InitNormalMap<<<elem_wise_grid_size_, elem_wise_block_size_>>>(
         *normal_map_, *rand_state_map_);
   }
+
+  // Sparse hypotheses only seed the otherwise random initialization.
+  if (init_depth_map == nullptr && init_normal_map == nullptr &&
+      problem_.init_depth_map != nullptr) {
+    THROW_CHECK_NOTNULL(problem_.init_normal_map);
+    THROW_CHECK_EQ(problem_.init_depth_map->GetWidth(), ref_width_);
+    THROW_CHECK_EQ(problem_.init_depth_map->GetHeight(), ref_height_);
+    THROW_CHECK_EQ(problem_.init_normal_map->GetWidth(), ref_width_);
+    THROW_CHECK_EQ(problem_.init_normal_map->GetHeight(), ref_height_);
+    GpuMat<float> sparse_depth_map(ref_width_, ref_height_);
+    sparse_depth_map.CopyToDevice(
+        problem_.init_depth_map->GetPtr(),
+        problem_.init_depth_map->GetWidth() * sizeof(float));
+    GpuMat<float> sparse_normal_map(ref_width_, ref_height_, 3);
+    sparse_normal_map.CopyToDevice(
+        problem_.init_normal_map->GetPtr(),
+        problem_.init_normal_map->GetWidth() * sizeof(float));
+    InitFromSparseMaps<<<elem_wise_grid_size_, elem_wise_block_size_>>>(
+        *depth_map_, *normal_map_, sparse_depth_map, sparse_normal_map);
+    CUDA_SYNC_AND_CHECK();
+  }
 }
 
 void PatchMatchCuda::Rotate() {
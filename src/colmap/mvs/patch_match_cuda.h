@@ -49,8 +49,12 @@ namespace mvs {
 
 class PatchMatchCuda {
  public:
+  // The optional depth and normal maps initialize the optimization instead
+  // of the random initialization, e.g., from a coarser pyramid level.
   PatchMatchCuda(const PatchMatchOptions& options,
-                 const PatchMatch::Problem& problem);
+                 const PatchMatch::Problem& problem,
+                 const DepthMap* init_depth_map = nullptr,
+                 const NormalMap* init_normal_map = nullptr);
 
   void Run();
 
@@ -70,7 +74,8 @@ class PatchMatchCuda {
   void InitRefImage();
   void InitSourceImages();
   void InitTransforms();
-  void InitWorkspaceMemory();
+  void InitWorkspaceMemory(const DepthMap* init_depth_map,
+                           const NormalMap* init_normal_map);
 
   // Rotate reference image by 90 degrees in counter-clockwise direction.
   void Rotate();
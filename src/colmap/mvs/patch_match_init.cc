@@ -0,0 +1,152 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/mvs/patch_match_init.h"
+
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/LU>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+typedef Eigen::Map<const Eigen::Matrix<float, 3, 3, Eigen::RowMajor>>
+    ConstMatrix3fMap;
+
+}  // namespace
+
+void SplatPointsIntoDepthMap(const Image& image,
+                             const std::vector<Eigen::Vector3f>& points,
+                             const std::vector<Eigen::Vector3f>& normals,
+                             const int radius,
+                             DepthMap* depth_map,
+                             NormalMap* normal_map) {
+  THROW_CHECK_NOTNULL(depth_map);
+  THROW_CHECK_NOTNULL(normal_map);
+  THROW_CHECK_GE(radius, 0);
+  THROW_CHECK(normals.empty() || normals.size() == points.size());
+  THROW_CHECK_EQ(depth_map->GetWidth(), image.GetWidth());
+  THROW_CHECK_EQ(depth_map->GetHeight(), image.GetHeight());
+  THROW_CHECK_EQ(normal_map->GetWidth(), image.GetWidth());
+  THROW_CHECK_EQ(normal_map->GetHeight(), image.GetHeight());
+
+  const ConstMatrix3fMap K(image.GetK());
+  const ConstMatrix3fMap R(image.GetR());
+  const Eigen::Map<const Eigen::Vector3f> T(image.GetT());
+  const int width = static_cast<int>(image.GetWidth());
+  const int height = static_cast<int>(image.GetHeight());
+
+  for (size_t i = 0; i < points.size(); ++i) {
+    const Eigen::Vector3f point_in_cam = R * points[i] + T;
+    const float depth = point_in_cam.z();
+    if (depth <= 0 || depth < depth_map->GetDepthMin() ||
+        depth > depth_map->GetDepthMax()) {
+      continue;
+    }
+
+    // The pixel coordinates of PatchMatch are not shifted by half a pixel.
+    const Eigen::Vector3f proj = K * point_in_cam;
+    const int col = static_cast<int>(std::round(proj.x() / proj.z()));
+    const int row = static_cast<int>(std::round(proj.y() / proj.z()));
+    if (col + radius < 0 || col - radius >= width || row + radius < 0 ||
+        row - radius >= height) {
+      continue;
+    }
+
+    Eigen::Vector3f normal =
+        normals.empty() ? Eigen::Vector3f(-point_in_cam) : R * normals[i];
+    normal.normalize();
+    if (normal.dot(point_in_cam) > 0) {
+      normal = -normal;
+    }
+
+    for (int r = std::max(0, row - radius);
+         r <= std::min(height - 1, row + radius);
+         ++r) {
+      for (int c = std::max(0, col - radius);
+           c <= std::min(width - 1, col + radius);
+           ++c) {
+        const float prev_depth = depth_map->Get(r, c);
+        if (prev_depth > 0 && prev_depth <= depth) {
+          continue;
+        }
+        depth_map->Set(r, c, depth);
+        for (int d = 0; d < 3; ++d) {
+          normal_map->Set(r, c, d, normal(d));
+        }
+      }
+    }
+  }
+}
+
+void BackProjectDepthMap(const Image& image,
+                         const DepthMap& depth_map,
+                         const NormalMap& normal_map,
+                         const int step,
+                         std::vector<Eigen::Vector3f>* points,
+                         std::vector<Eigen::Vector3f>* normals) {
+  THROW_CHECK_NOTNULL(points);
+  THROW_CHECK_NOTNULL(normals);
+  THROW_CHECK_GT(step, 0);
+  THROW_CHECK_EQ(depth_map.GetWidth(), image.GetWidth());
+  THROW_CHECK_EQ(depth_map.GetHeight(), image.GetHeight());
+  THROW_CHECK_EQ(normal_map.GetWidth(), image.GetWidth());
+  THROW_CHECK_EQ(normal_map.GetHeight(), image.GetHeight());
+
+  const ConstMatrix3fMap K(image.GetK());
+  const ConstMatrix3fMap R(image.GetR());
+  const Eigen::Map<const Eigen::Vector3f> T(image.GetT());
+  const Eigen::Matrix3f inv_K = K.inverse();
+
+  points->clear();
+  normals->clear();
+  for (size_t row = 0; row < depth_map.GetHeight(); row += step) {
+    for (size_t col = 0; col < depth_map.GetWidth(); col += step) {
+      const float depth = depth_map.Get(row, col);
+      if (depth <= 0) {
+        continue;
+      }
+      const Eigen::Vector3f point_in_cam =
+          depth * (inv_K * Eigen::Vector3f(col, row, 1));
+      points->push_back(R.transpose() * (point_in_cam - T));
+      normals->push_back(R.transpose() *
+                         Eigen::Vector3f(normal_map.Get(row, col, 0),
+                                         normal_map.Get(row, col, 1),
+                                         normal_map.Get(row, col, 2)));
+    }
+  }
+}
+
+}  // namespace mvs
+}  // namespace colmap
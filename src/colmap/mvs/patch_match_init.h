@@ -0,0 +1,69 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/mvs/depth_map.h"
+#include "colmap/mvs/image.h"
+#include "colmap/mvs/normal_map.h"
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace mvs {
+
+// Splat 3D points in world coordinates into the depth and normal map of the
+// image, e.g., to initialize the PatchMatch hypotheses with the sparse model.
+// Every point covers a square window of the given radius around its
+// projection, in which the nearest point wins. The normals are given in world
+// coordinates and are flipped to face the camera. Without normals, the
+// splatted normals face the camera. Points outside of the depth range of the
+// depth map are ignored and pixels not covered by any point keep their values.
+void SplatPointsIntoDepthMap(const Image& image,
+                             const std::vector<Eigen::Vector3f>& points,
+                             const std::vector<Eigen::Vector3f>& normals,
+                             int radius,
+                             DepthMap* depth_map,
+                             NormalMap* normal_map);
+
+// Back-project every step-th row and column of the depth and normal map of the
+// image with positive depth into 3D points and normals in world coordinates,
+// e.g., to splat them into the depth and normal map of another image.
+void BackProjectDepthMap(const Image& image,
+                         const DepthMap& depth_map,
+                         const NormalMap& normal_map,
+                         int step,
+                         std::vector<Eigen::Vector3f>* points,
+                         std::vector<Eigen::Vector3f>* normals);
+
+}  // namespace mvs
+}  // namespace colmap
@@ -0,0 +1,143 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/mvs/patch_match_init.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+Image CreateTestImage(const float tx = 0) {
+  const float K[9] = {10, 0, 5, 0, 10, 5, 0, 0, 1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  const float T[3] = {tx, 0, 0};
+  return Image("", 11, 11, K, R, T);
+}
+
+TEST(SplatPointsIntoDepthMap, Nominal) {
+  const Image image = CreateTestImage();
+  DepthMap depth_map(11, 11, 0.1, 10);
+  NormalMap normal_map(11, 11);
+  const std::vector<Eigen::Vector3f> points = {
+      Eigen::Vector3f(0, 0, 2),
+      // Occluded by the first point.
+      Eigen::Vector3f(0, 0, 4),
+      Eigen::Vector3f(0.4, 0.4, 2),
+      // Outside of the depth range.
+      Eigen::Vector3f(-0.4, -0.4, 20),
+      // Behind the camera.
+      Eigen::Vector3f(0, 0, -2)};
+  SplatPointsIntoDepthMap(image,
+                          points,
+                          /*normals=*/{},
+                          /*radius=*/1,
+                          &depth_map,
+                          &normal_map);
+
+  for (size_t row = 0; row < 11; ++row) {
+    for (size_t col = 0; col < 11; ++col) {
+      const bool is_covered = (row >= 4 && row <= 6 && col >= 4 && col <= 6) ||
+                              (row >= 6 && row <= 8 && col >= 6 && col <= 8);
+      EXPECT_EQ(depth_map.Get(row, col), is_covered ? 2 : 0);
+    }
+  }
+  EXPECT_EQ(normal_map.Get(5, 5, 0), 0);
+  EXPECT_EQ(normal_map.Get(5, 5, 1), 0);
+  EXPECT_EQ(normal_map.Get(5, 5, 2), -1);
+  EXPECT_LT(normal_map.Get(7, 7, 0), 0);
+  EXPECT_LT(normal_map.Get(7, 7, 1), 0);
+  EXPECT_NEAR(Eigen::Vector3f(normal_map.Get(7, 7, 0),
+                              normal_map.Get(7, 7, 1),
+                              normal_map.Get(7, 7, 2))
+                  .norm(),
+              1,
+              1e-6);
+}
+
+TEST(SplatPointsIntoDepthMap, Normals) {
+  const Image image = CreateTestImage();
+  DepthMap depth_map(11, 11, 0.1, 10);
+  NormalMap normal_map(11, 11);
+  SplatPointsIntoDepthMap(image,
+                          {Eigen::Vector3f(0, 0, 2)},
+                          {Eigen::Vector3f(0, 0, 2)},
+                          /*radius=*/0,
+                          &depth_map,
+                          &normal_map);
+  EXPECT_EQ(depth_map.Get(5, 5), 2);
+  EXPECT_EQ(depth_map.Get(5, 6), 0);
+  // The normal is normalized and flipped to face the camera.
+  EXPECT_EQ(normal_map.Get(5, 5, 2), -1);
+}
+
+TEST(BackProjectDepthMap, SplatIntoOtherImage) {
+  const Image image1 = CreateTestImage();
+  DepthMap depth_map1(11, 11, 0.1, 10);
+  NormalMap normal_map1(11, 11);
+  depth_map1.Fill(2);
+  normal_map1.Fill(0);
+  for (size_t row = 0; row < 11; ++row) {
+    for (size_t col = 0; col < 11; ++col) {
+      normal_map1.Set(row, col, 2, -1);
+    }
+  }
+  depth_map1.Set(0, 0, 0);
+
+  std::vector<Eigen::Vector3f> points;
+  std::vector<Eigen::Vector3f> normals;
+  BackProjectDepthMap(image1, depth_map1, normal_map1, 1, &points, &normals);
+  EXPECT_EQ(points.size(), 11 * 11 - 1);
+  ASSERT_EQ(normals.size(), points.size());
+  EXPECT_TRUE(points[0].isApprox(Eigen::Vector3f(-0.8, -1, 2)));
+  EXPECT_EQ(normals[0], Eigen::Vector3f(0, 0, -1));
+
+  std::vector<Eigen::Vector3f> sub_points;
+  std::vector<Eigen::Vector3f> sub_normals;
+  BackProjectDepthMap(
+      image1, depth_map1, normal_map1, 2, &sub_points, &sub_normals);
+  EXPECT_EQ(sub_points.size(), 6 * 6 - 1);
+
+  // The projections into the second image are shifted by one pixel.
+  const Image image2 = CreateTestImage(/*tx=*/0.2);
+  DepthMap depth_map2(11, 11, 0.1, 10);
+  NormalMap normal_map2(11, 11);
+  SplatPointsIntoDepthMap(
+      image2, points, normals, /*radius=*/0, &depth_map2, &normal_map2);
+  EXPECT_NEAR(depth_map2.Get(5, 5), 2, 1e-6);
+  EXPECT_EQ(depth_map2.Get(5, 0), 0);
+  EXPECT_EQ(depth_map2.Get(0, 1), 0);
+  EXPECT_EQ(normal_map2.Get(5, 5, 2), -1);
+}
+
+}  // namespace
+}  // namespace mvs
+}  // namespace colmap
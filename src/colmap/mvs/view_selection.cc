@@ -0,0 +1,259 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/view_selection.h"
+
+#include "colmap/geometry/triangulation.h"
+#include "colmap/math/math.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+#include "colmap/util/timer.h"
+
+#include <fstream>
+#include <unordered_map>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+// Incremented whenever the computation or the file format changes.
+constexpr uint64_t kViewSelectionIndexVersion = 1;
+
+constexpr double kTriangulationAnglePercentile = 75;
+
+// FNV-1a hash of the image names and the point tracks of the model, which
+// detects most changes of the model between the MVS stages.
+uint64_t HashModel(const Model& model) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto HashBytes = [&hash](const void* data, const size_t num_bytes) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < num_bytes; ++i) {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  };
+  auto HashValue = [&HashBytes](const uint64_t value) {
+    HashBytes(&value, sizeof(value));
+  };
+
+  HashValue(kViewSelectionIndexVersion);
+  HashValue(model.images.size());
+  for (size_t image_idx = 0; image_idx < model.images.size(); ++image_idx) {
+    const std::string image_name = model.GetImageName(image_idx);
+    HashValue(image_name.size());
+    HashBytes(image_name.data(), image_name.size());
+  }
+  HashValue(model.points.size());
+  for (const auto& point : model.points) {
+    HashValue(point.track.size());
+    HashBytes(point.track.data(), point.track.size() * sizeof(int));
+  }
+  return hash;
+}
+
+}  // namespace
+
+ViewSelectionIndex ViewSelectionIndex::Compute(const Model& model,
+                                               const int num_threads) {
+  const size_t num_images = model.images.size();
+
+  std::vector<Eigen::Vector3d> proj_centers(num_images);
+  for (size_t image_idx = 0; image_idx < num_images; ++image_idx) {
+    const auto& image = model.images[image_idx];
+    Eigen::Vector3f C;
+    ComputeProjectionCenter(image.GetR(), image.GetT(), C.data());
+    proj_centers[image_idx] = C.cast<double>();
+  }
+
+  // Points observed by every image, where points with multiple observations
+  // in the same image are listed multiple times, as in
+  // Model::ComputeSharedPoints.
+  std::vector<std::vector<int>> image_point_idxs(num_images);
+  for (size_t point_idx = 0; point_idx < model.points.size(); ++point_idx) {
+    for (const int image_idx : model.points[point_idx].track) {
+      image_point_idxs.at(image_idx).push_back(point_idx);
+    }
+  }
+
+  ViewSelectionIndex index;
+  index.model_hash_ = HashModel(model);
+  index.neighbors_.resize(num_images);
+
+  // Every image only writes its own neighbors, such that the images are
+  // processed independently at the cost of computing the triangulation angle
+  // of every shared point for both images of a pair.
+  auto ComputeNeighbors = [&](const size_t begin, const size_t end) {
+    std::unordered_map<int, std::vector<float>> triangulation_angles;
+    for (size_t image_idx1 = begin; image_idx1 < end; ++image_idx1) {
+      triangulation_angles.clear();
+      for (const int point_idx : image_point_idxs[image_idx1]) {
+        const auto& point = model.points[point_idx];
+        const Eigen::Vector3d xyz(point.x, point.y, point.z);
+        for (const int image_idx2 : point.track) {
+          if (image_idx2 != static_cast<int>(image_idx1)) {
+            triangulation_angles[image_idx2].push_back(
+                CalculateTriangulationAngle(proj_centers[image_idx1],
+                                            proj_centers[image_idx2],
+                                            xyz));
+          }
+        }
+      }
+
+      std::vector<Neighbor>& neighbors = index.neighbors_[image_idx1];
+      neighbors.reserve(triangulation_angles.size());
+      for (const auto& [image_idx2, angles] : triangulation_angles) {
+        Neighbor& neighbor = neighbors.emplace_back();
+        neighbor.image_idx = image_idx2;
+        neighbor.num_shared_points = angles.size();
+        neighbor.triangulation_angle =
+            Percentile(angles, kTriangulationAnglePercentile);
+      }
+      std::sort(neighbors.begin(),
+                neighbors.end(),
+                [](const Neighbor& neighbor1, const Neighbor& neighbor2) {
+                  if (neighbor1.num_shared_points !=
+                      neighbor2.num_shared_points) {
+                    return neighbor1.num_shared_points >
+                           neighbor2.num_shared_points;
+                  }
+                  return neighbor1.image_idx < neighbor2.image_idx;
+                });
+    }
+  };
+
+  ParallelForChunks(
+      num_threads, num_images, /*min_chunk_size=*/1, ComputeNeighbors);
+
+  return index;
+}
+
+std::vector<int> ViewSelectionIndex::SelectImages(
+    const int image_idx,
+    const size_t max_num_images,
+    const double min_triangulation_angle) const {
+  const float min_triangulation_angle_rad = DegToRad(min_triangulation_angle);
+  std::vector<int> image_idxs;
+  for (const auto& neighbor : neighbors_.at(image_idx)) {
+    if (image_idxs.size() >= max_num_images) {
+      break;
+    }
+    if (neighbor.triangulation_angle >= min_triangulation_angle_rad) {
+      image_idxs.push_back(neighbor.image_idx);
+    }
+  }
+  return image_idxs;
+}
+
+std::vector<std::vector<int>> ViewSelectionIndex::SelectImages(
+    const size_t max_num_images, const double min_triangulation_angle) const {
+  std::vector<std::vector<int>> image_idxs(neighbors_.size());
+  for (size_t image_idx = 0; image_idx < neighbors_.size(); ++image_idx) {
+    image_idxs[image_idx] =
+        SelectImages(image_idx, max_num_images, min_triangulation_angle);
+  }
+  return image_idxs;
+}
+
+bool ViewSelectionIndex::IsComputedFor(const Model& model) const {
+  return neighbors_.size() == model.images.size() &&
+         model_hash_ == HashModel(model);
+}
+
+void ViewSelectionIndex::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  model_hash_ = ReadBinaryLittleEndian<uint64_t>(&file);
+  neighbors_.resize(ReadBinaryLittleEndian<uint64_t>(&file));
+  for (auto& neighbors : neighbors_) {
+    neighbors.resize(ReadBinaryLittleEndian<uint64_t>(&file));
+    for (auto& neighbor : neighbors) {
+      neighbor.image_idx = ReadBinaryLittleEndian<int32_t>(&file);
+      neighbor.num_shared_points = ReadBinaryLittleEndian<int32_t>(&file);
+      neighbor.triangulation_angle = ReadBinaryLittleEndian<float>(&file);
+    }
+  }
+  THROW_CHECK(file) << "Truncated view selection index: " << path;
+}
+
+void ViewSelectionIndex::Write(const std::string& path) const {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  WriteBinaryLittleEndian<uint64_t>(&file, model_hash_);
+  WriteBinaryLittleEndian<uint64_t>(&file, neighbors_.size());
+  for (const auto& neighbors : neighbors_) {
+    WriteBinaryLittleEndian<uint64_t>(&file, neighbors.size());
+    for (const auto& neighbor : neighbors) {
+      WriteBinaryLittleEndian<int32_t>(&file, neighbor.image_idx);
+      WriteBinaryLittleEndian<int32_t>(&file, neighbor.num_shared_points);
+      WriteBinaryLittleEndian<float>(&file, neighbor.triangulation_angle);
+    }
+  }
+}
+
+ViewSelectionIndex ReadOrComputeViewSelectionIndex(const Model& model,
+                                                   const std::string& path,
+                                                   const int num_threads) {
+  ViewSelectionIndex index;
+  if (ExistsFile(path)) {
+    // An index that was only partially written, e.g., by a canceled run, is
+    // recomputed just like an outdated index.
+    bool is_valid = false;
+    try {
+      index.Read(path);
+      is_valid = index.IsComputedFor(model);
+    } catch (const std::exception& error) {
+      LOG(WARNING) << "Failed to read view selection index: " << error.what();
+    }
+    if (is_valid) {
+      LOG(INFO) << "Read view selection index from " << path;
+      return index;
+    }
+    LOG(INFO) << "Recomputing outdated view selection index";
+  }
+
+  Timer timer;
+  timer.Start();
+  LOG(INFO) << "Computing view selection index...";
+  index = ViewSelectionIndex::Compute(model, num_threads);
+  timer.PrintSeconds();
+
+  if (ExistsDir(GetParentDir(path))) {
+    index.Write(path);
+  }
+
+  return index;
+}
+
+}  // namespace mvs
+}  // namespace colmap
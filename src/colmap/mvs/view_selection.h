@@ -0,0 +1,105 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/mvs/model.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace colmap {
+namespace mvs {
+
+// Index of the overlapping images of a model, which is used to select the
+// source images in patch match stereo and the neighboring images in stereo
+// fusion. For every pair of overlapping images, it stores the number of
+// shared points and the percentile of the triangulation angles of the shared
+// points. The index is computed once in parallel over the images and can be
+// persisted in the workspace, such that it is reused by all MVS stages.
+class ViewSelectionIndex {
+ public:
+  struct Neighbor {
+    int image_idx = -1;
+    int num_shared_points = 0;
+    // The 75th percentile of the triangulation angles in radians.
+    float triangulation_angle = 0;
+  };
+
+  // Compute the index for the given model.
+  static ViewSelectionIndex Compute(const Model& model, int num_threads = -1);
+
+  inline size_t NumImages() const;
+
+  // The overlapping images of an image sorted by decreasing number of shared
+  // points and by increasing image index for equal number of shared points.
+  inline const std::vector<Neighbor>& GetNeighbors(int image_idx) const;
+
+  // Select the maximally overlapping images of an image with a triangulation
+  // angle of at least the given minimum in degrees.
+  std::vector<int> SelectImages(int image_idx,
+                                size_t max_num_images,
+                                double min_triangulation_angle) const;
+
+  // Same as above for all images, see Model::GetMaxOverlappingImages.
+  std::vector<std::vector<int>> SelectImages(
+      size_t max_num_images, double min_triangulation_angle) const;
+
+  // Whether the index was computed for the images and points of the model.
+  bool IsComputedFor(const Model& model) const;
+
+  void Read(const std::string& path);
+  void Write(const std::string& path) const;
+
+ private:
+  uint64_t model_hash_ = 0;
+  std::vector<std::vector<Neighbor>> neighbors_;
+};
+
+// Read the index from the given path, if it was computed for the model.
+// Otherwise, compute the index and write it to the path, if its directory
+// exists.
+ViewSelectionIndex ReadOrComputeViewSelectionIndex(const Model& model,
+                                                   const std::string& path,
+                                                   int num_threads = -1);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+size_t ViewSelectionIndex::NumImages() const { return neighbors_.size(); }
+
+const std::vector<ViewSelectionIndex::Neighbor>&
+ViewSelectionIndex::GetNeighbors(const int image_idx) const {
+  return neighbors_.at(image_idx);
+}
+
+}  // namespace mvs
+}  // namespace colmap
@@ -0,0 +1,150 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/view_selection.h"
+
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <set>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+Model CreateModel(const std::string& test_dir, const int num_images) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_options;
+  synthetic_options.num_cameras = 1;
+  synthetic_options.num_images = num_images;
+  synthetic_options.num_points3D = 100;
+  SynthesizeDataset(synthetic_options, &reconstruction);
+  CreateDirIfNotExists(JoinPaths(test_dir, "sparse"), /*recursive=*/true);
+  reconstruction.Write(JoinPaths(test_dir, "sparse"));
+  Model model;
+  model.ReadFromCOLMAP(test_dir);
+  return model;
+}
+
+TEST(ViewSelectionIndex, Compute) {
+  const std::string test_dir = CreateTestDir();
+  const Model model = CreateModel(test_dir, /*num_images=*/10);
+  const auto shared_num_points = model.ComputeSharedPoints();
+  const auto triangulation_angles = model.ComputeTriangulationAngles(75);
+
+  for (const int num_threads : {1, 4}) {
+    const ViewSelectionIndex index =
+        ViewSelectionIndex::Compute(model, num_threads);
+    ASSERT_EQ(index.NumImages(), model.images.size());
+    for (size_t image_idx = 0; image_idx < model.images.size(); ++image_idx) {
+      const auto& neighbors = index.GetNeighbors(image_idx);
+      ASSERT_EQ(neighbors.size(), shared_num_points[image_idx].size());
+      for (size_t i = 0; i < neighbors.size(); ++i) {
+        const auto& neighbor = neighbors[i];
+        EXPECT_EQ(neighbor.num_shared_points,
+                  shared_num_points[image_idx].at(neighbor.image_idx));
+        EXPECT_EQ(neighbor.triangulation_angle,
+                  triangulation_angles[image_idx].at(neighbor.image_idx));
+        if (i > 0) {
+          EXPECT_GE(neighbors[i - 1].num_shared_points,
+                    neighbor.num_shared_points);
+        }
+      }
+    }
+  }
+}
+
+TEST(ViewSelectionIndex, SelectImages) {
+  const std::string test_dir = CreateTestDir();
+  const Model model = CreateModel(test_dir, /*num_images=*/10);
+  const ViewSelectionIndex index = ViewSelectionIndex::Compute(model);
+
+  for (const double min_triangulation_angle : {0.0, 1.0, 180.0}) {
+    const auto overlapping_images =
+        model.GetMaxOverlappingImages(3, min_triangulation_angle);
+    const auto selected_images = index.SelectImages(3, min_triangulation_angle);
+    ASSERT_EQ(selected_images.size(), overlapping_images.size());
+    for (size_t image_idx = 0; image_idx < model.images.size(); ++image_idx) {
+      EXPECT_EQ(selected_images[image_idx],
+                index.SelectImages(image_idx, 3, min_triangulation_angle));
+      // The order of images with equal overlap is not defined by the model.
+      ASSERT_EQ(selected_images[image_idx].size(),
+                overlapping_images[image_idx].size());
+      const auto& neighbors = index.GetNeighbors(image_idx);
+      auto NumSharedPoints = [&neighbors](const int other_image_idx) {
+        for (const auto& neighbor : neighbors) {
+          if (neighbor.image_idx == other_image_idx) {
+            return neighbor.num_shared_points;
+          }
+        }
+        return 0;
+      };
+      for (size_t i = 0; i < selected_images[image_idx].size(); ++i) {
+        EXPECT_EQ(NumSharedPoints(selected_images[image_idx][i]),
+                  NumSharedPoints(overlapping_images[image_idx][i]));
+      }
+    }
+  }
+}
+
+TEST(ViewSelectionIndex, ReadWrite) {
+  const std::string test_dir = CreateTestDir();
+  const Model model = CreateModel(test_dir, /*num_images=*/5);
+  const Model other_model =
+      CreateModel(JoinPaths(test_dir, "other"), /*num_images=*/6);
+  const std::string path = JoinPaths(test_dir, "view-selection.bin");
+
+  const ViewSelectionIndex index =
+      ReadOrComputeViewSelectionIndex(model, path);
+  EXPECT_TRUE(index.IsComputedFor(model));
+  EXPECT_FALSE(index.IsComputedFor(other_model));
+  ASSERT_TRUE(ExistsFile(path));
+
+  ViewSelectionIndex read_index;
+  read_index.Read(path);
+  EXPECT_TRUE(read_index.IsComputedFor(model));
+  ASSERT_EQ(read_index.NumImages(), index.NumImages());
+  for (size_t image_idx = 0; image_idx < index.NumImages(); ++image_idx) {
+    EXPECT_EQ(read_index.SelectImages(image_idx, 10, 0),
+              index.SelectImages(image_idx, 10, 0));
+  }
+
+  const ViewSelectionIndex other_index =
+      ReadOrComputeViewSelectionIndex(other_model, path);
+  EXPECT_TRUE(other_index.IsComputedFor(other_model));
+  read_index.Read(path);
+  EXPECT_TRUE(read_index.IsComputedFor(other_model));
+}
+
+}  // namespace
+}  // namespace mvs
+}  // namespace colmap
@@ -29,6 +29,7 @@
 
 #include "colmap/mvs/workspace.h"
 
+#include "colmap/util/metrics.h"
 #include "colmap/util/threading.h"
 
 #include <numeric>
@@ -36,7 +37,18 @@
 namespace colmap {
 namespace mvs {
 
-Workspace::Workspace(const Options& options) : options_(options) {
+namespace {
+
+// The images of a workspace are typically captured by few cameras, while each
+// warp table takes 8 bytes per pixel.
+constexpr size_t kMaxNumCachedWarpTables = 8;
+
+}  // namespace
+
+Workspace::Workspace(const Options& options)
+    : options_(options),
+      bitmap_decoder_(CreateBitmapDecoder(options_.bitmap_decoder)),
+      undistort_cache_(UndistortCameraOptions(), kMaxNumCachedWarpTables) {
   StringToLower(&options_.input_type);
   model_.Read(options_.workspace_path, options_.workspace_format);
   if (options_.max_image_size > 0) {
@@ -59,8 +71,11 @@ std::string Workspace::GetFileName(const int image_idx) const {
 
 void Workspace::Load(const std::vector<std::string>& image_names) {
   const size_t num_images = model_.images.size();
+  bitmaps_.clear();
   bitmaps_.resize(num_images);
+  depth_maps_.clear();
   depth_maps_.resize(num_images);
+  normal_maps_.clear();
   normal_maps_.resize(num_images);
 
   auto LoadWorkspaceData = [&, this](const int image_idx) {
@@ -68,11 +83,7 @@ void Workspace::Load(const std::vector<std::string>& image_names) {
     const size_t height = model_.images.at(image_idx).GetHeight();
 
     // Read and rescale bitmap
-    bitmaps_[image_idx] = std::make_unique<Bitmap>();
-    bitmaps_[image_idx]->Read(GetBitmapPath(image_idx), options_.image_as_rgb);
-    if (options_.max_image_size > 0) {
-      bitmaps_[image_idx]->Rescale((int)width, (int)height);
-    }
+    bitmaps_[image_idx] = ReadBitmap(image_idx);
 
     // Read and rescale depth map
     depth_maps_[image_idx] = std::make_unique<DepthMap>();
@@ -110,6 +121,19 @@ void Workspace::Load(const std::vector<std::string>& image_names) {
   timer.PrintMinutes();
 }
 
+const ViewSelectionIndex& Workspace::GetViewSelectionIndex() {
+  if (!view_selection_index_) {
+    view_selection_index_ = std::make_unique<ViewSelectionIndex>(
+        ReadOrComputeViewSelectionIndex(
+            model_,
+            JoinPaths(options_.workspace_path,
+                      options_.stereo_folder,
+                      "view-selection.bin"),
+            options_.num_threads));
+  }
+  return *view_selection_index_;
+}
+
 const Bitmap& Workspace::GetBitmap(const int image_idx) {
   return *bitmaps_[image_idx];
 }
@@ -134,6 +158,35 @@ std::string Workspace::GetNormalMapPath(const int image_idx) const {
   return normal_map_path_ + GetFileName(image_idx);
 }
 
+std::unique_ptr<Bitmap> Workspace::ReadBitmap(const int image_idx) const {
+  auto bitmap = std::make_unique<Bitmap>();
+  bitmap_decoder_->Decode(GetBitmapPath(image_idx),
+                          options_.image_as_rgb,
+                          /*min_image_size=*/-1,
+                          bitmap.get());
+  if (!model_.distorted_cameras.empty()) {
+    const Camera& distorted_camera = model_.distorted_cameras.at(image_idx);
+    const Camera& undistorted_camera = model_.undistorted_cameras.at(image_idx);
+    // Images of undistorted cameras were copied as is by the undistorter.
+    if (distorted_camera.model_id != undistorted_camera.model_id ||
+        distorted_camera.width != undistorted_camera.width ||
+        distorted_camera.height != undistorted_camera.height ||
+        distorted_camera.params != undistorted_camera.params) {
+      auto undistorted_bitmap = std::make_unique<Bitmap>();
+      undistort_cache_.Undistort(*bitmap,
+                                 distorted_camera,
+                                 undistorted_camera,
+                                 undistorted_bitmap.get());
+      bitmap = std::move(undistorted_bitmap);
+    }
+  }
+  if (options_.max_image_size > 0) {
+    bitmap->Rescale(model_.images.at(image_idx).GetWidth(),
+                    model_.images.at(image_idx).GetHeight());
+  }
+  return bitmap;
+}
+
 bool Workspace::HasBitmap(const int image_idx) const {
   return ExistsFile(GetBitmapPath(image_idx));
 }
@@ -170,14 +223,15 @@ CachedWorkspace::CachedWorkspace(const Options& options)
              [](const int) { return CachedImage(); }) {}
 
 const Bitmap& CachedWorkspace::GetBitmap(const int image_idx) {
+  static const CacheMetrics metrics = GetCacheMetrics("workspace_bitmaps");
+  metrics.lookups->Increment();
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.bitmap) {
-    cached_image.bitmap = std::make_unique<Bitmap>();
-    cached_image.bitmap->Read(GetBitmapPath(image_idx), options_.image_as_rgb);
-    if (options_.max_image_size > 0) {
-      cached_image.bitmap->Rescale(model_.images.at(image_idx).GetWidth(),
-                                   model_.images.at(image_idx).GetHeight());
-    }
+    InsertPrefetched(image_idx);
+  }
+  if (!cached_image.bitmap) {
+    metrics.misses->Increment();
+    cached_image.bitmap = ReadBitmap(image_idx);
     cached_image.num_bytes += cached_image.bitmap->NumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
@@ -185,14 +239,15 @@ const Bitmap& CachedWorkspace::GetBitmap(const int image_idx) {
 }
 
 const DepthMap& CachedWorkspace::GetDepthMap(const int image_idx) {
+  static const CacheMetrics metrics = GetCacheMetrics("workspace_depth_maps");
+  metrics.lookups->Increment();
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.depth_map) {
-    cached_image.depth_map = std::make_unique<DepthMap>();
-    cached_image.depth_map->Read(GetDepthMapPath(image_idx));
-    if (options_.max_image_size > 0) {
-      cached_image.depth_map->Downsize(model_.images.at(image_idx).GetWidth(),
-                                       model_.images.at(image_idx).GetHeight());
-    }
+    InsertPrefetched(image_idx);
+  }
+  if (!cached_image.depth_map) {
+    metrics.misses->Increment();
+    cached_image.depth_map = ReadDepthMap(image_idx);
     cached_image.num_bytes += cached_image.depth_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
@@ -200,21 +255,189 @@ const DepthMap& CachedWorkspace::GetDepthMap(const int image_idx) {
 }
 
 const NormalMap& CachedWorkspace::GetNormalMap(const int image_idx) {
+  static const CacheMetrics metrics = GetCacheMetrics("workspace_normal_maps");
+  metrics.lookups->Increment();
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.normal_map) {
-    cached_image.normal_map = std::make_unique<NormalMap>();
-    cached_image.normal_map->Read(GetNormalMapPath(image_idx));
-    if (options_.max_image_size > 0) {
-      cached_image.normal_map->Downsize(
-          model_.images.at(image_idx).GetWidth(),
-          model_.images.at(image_idx).GetHeight());
-    }
+    InsertPrefetched(image_idx);
+  }
+  if (!cached_image.normal_map) {
+    metrics.misses->Increment();
+    cached_image.normal_map = ReadNormalMap(image_idx);
     cached_image.num_bytes += cached_image.normal_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
   return *cached_image.normal_map;
 }
 
+void CachedWorkspace::Prefetch(const int image_idx, const bool prefetch_maps) {
+  bool prefetch_bitmap = true;
+  bool prefetch_depth_map = prefetch_maps;
+  bool prefetch_normal_map = prefetch_maps;
+  if (cache_.Exists(image_idx)) {
+    const auto& cached_image = cache_.GetMutable(image_idx);
+    prefetch_bitmap = cached_image.bitmap == nullptr;
+    prefetch_depth_map &= cached_image.depth_map == nullptr;
+    prefetch_normal_map &= cached_image.normal_map == nullptr;
+  }
+
+  if (!prefetch_bitmap && !prefetch_depth_map && !prefetch_normal_map) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(prefetch_mutex_);
+  if (prefetched_images_.count(image_idx) > 0) {
+    return;
+  }
+
+  if (!prefetch_thread_pool_) {
+    prefetch_thread_pool_ = std::make_unique<ThreadPool>(options_.num_threads);
+  }
+
+  // The existence of the files is also checked on the prefetch threads, since
+  // it is slow on network storage.
+  PrefetchedImage& prefetched_image = prefetched_images_[image_idx];
+  prefetched_image.image = std::make_shared<CachedImage>();
+  prefetched_image.future =
+      prefetch_thread_pool_
+          ->AddTask([this,
+                     image_idx,
+                     prefetch_bitmap,
+                     prefetch_depth_map,
+                     prefetch_normal_map,
+                     image = prefetched_image.image]() {
+            if (prefetch_bitmap && HasBitmap(image_idx)) {
+              image->bitmap = ReadBitmap(image_idx);
+            }
+            if (prefetch_depth_map && HasDepthMap(image_idx)) {
+              image->depth_map = ReadDepthMap(image_idx);
+            }
+            if (prefetch_normal_map && HasNormalMap(image_idx)) {
+              image->normal_map = ReadNormalMap(image_idx);
+            }
+          })
+          .share();
+}
+
+void CachedWorkspace::WaitForPrefetch(const std::vector<int>& image_idxs) {
+  std::vector<std::shared_future<void>> futures;
+  {
+    std::unique_lock<std::mutex> lock(prefetch_mutex_);
+    for (const int image_idx : image_idxs) {
+      const auto it = prefetched_images_.find(image_idx);
+      if (it != prefetched_images_.end()) {
+        futures.push_back(it->second.future);
+      }
+    }
+  }
+
+  for (auto& future : futures) {
+    future.wait();
+  }
+}
+
+void CachedWorkspace::WaitForPrefetch() {
+  std::vector<int> image_idxs;
+  {
+    std::unique_lock<std::mutex> lock(prefetch_mutex_);
+    image_idxs.reserve(prefetched_images_.size());
+    for (const auto& prefetched_image : prefetched_images_) {
+      image_idxs.push_back(prefetched_image.first);
+    }
+  }
+  WaitForPrefetch(image_idxs);
+}
+
+void CachedWorkspace::InsertPrefetched() {
+  std::vector<int> image_idxs;
+  {
+    std::unique_lock<std::mutex> lock(prefetch_mutex_);
+    for (const auto& prefetched_image : prefetched_images_) {
+      if (prefetched_image.second.future.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+        image_idxs.push_back(prefetched_image.first);
+      }
+    }
+  }
+
+  for (const int image_idx : image_idxs) {
+    InsertPrefetched(image_idx);
+  }
+}
+
+void CachedWorkspace::InsertPrefetched(const int image_idx) {
+  PrefetchedImage prefetched_image;
+  {
+    std::unique_lock<std::mutex> lock(prefetch_mutex_);
+    const auto it = prefetched_images_.find(image_idx);
+    if (it == prefetched_images_.end()) {
+      return;
+    }
+    prefetched_image = std::move(it->second);
+    prefetched_images_.erase(it);
+  }
+
+  // Rethrows the errors of the prefetch thread, as if the data was read now.
+  prefetched_image.future.get();
+
+  // The data may have been read in the meantime, in which case the
+  // prefetched data is discarded.
+  CachedImage& image = *prefetched_image.image;
+  auto& cached_image = cache_.GetMutable(image_idx);
+  if (image.bitmap && !cached_image.bitmap) {
+    cached_image.num_bytes += image.bitmap->NumBytes();
+    cached_image.bitmap = std::move(image.bitmap);
+  }
+  if (image.depth_map && !cached_image.depth_map) {
+    cached_image.num_bytes += image.depth_map->GetNumBytes();
+    cached_image.depth_map = std::move(image.depth_map);
+  }
+  if (image.normal_map && !cached_image.normal_map) {
+    cached_image.num_bytes += image.normal_map->GetNumBytes();
+    cached_image.normal_map = std::move(image.normal_map);
+  }
+  cache_.UpdateNumBytes(image_idx);
+}
+
+void CachedWorkspace::InsertMaps(const int image_idx,
+                                 DepthMap depth_map,
+                                 NormalMap normal_map) {
+  auto& cached_image = cache_.GetMutable(image_idx);
+  if (cached_image.depth_map) {
+    cached_image.num_bytes -= cached_image.depth_map->GetNumBytes();
+  }
+  if (cached_image.normal_map) {
+    cached_image.num_bytes -= cached_image.normal_map->GetNumBytes();
+  }
+  cached_image.depth_map = std::make_unique<DepthMap>(std::move(depth_map));
+  cached_image.normal_map = std::make_unique<NormalMap>(std::move(normal_map));
+  cached_image.num_bytes += cached_image.depth_map->GetNumBytes() +
+                            cached_image.normal_map->GetNumBytes();
+  cache_.UpdateNumBytes(image_idx);
+}
+
+std::unique_ptr<DepthMap> CachedWorkspace::ReadDepthMap(
+    const int image_idx) const {
+  auto depth_map = std::make_unique<DepthMap>();
+  depth_map->Read(GetDepthMapPath(image_idx));
+  if (options_.max_image_size > 0) {
+    depth_map->Downsize(model_.images.at(image_idx).GetWidth(),
+                        model_.images.at(image_idx).GetHeight());
+  }
+  return depth_map;
+}
+
+std::unique_ptr<NormalMap> CachedWorkspace::ReadNormalMap(
+    const int image_idx) const {
+  auto normal_map = std::make_unique<NormalMap>();
+  normal_map->Read(GetNormalMapPath(image_idx));
+  if (options_.max_image_size > 0) {
+    normal_map->Downsize(model_.images.at(image_idx).GetWidth(),
+                         model_.images.at(image_idx).GetHeight());
+  }
+  return normal_map;
+}
+
 void ImportPMVSWorkspace(const Workspace& workspace,
                          const std::string& option_name) {
   const std::string& workspace_path = workspace.GetOptions().workspace_path;
@@ -29,15 +29,22 @@
 
 #pragma once
 
+#include "colmap/image/undistortion.h"
 #include "colmap/mvs/consistency_graph.h"
 #include "colmap/mvs/depth_map.h"
 #include "colmap/mvs/model.h"
 #include "colmap/mvs/normal_map.h"
+#include "colmap/mvs/view_selection.h"
 #include "colmap/sensor/bitmap.h"
+#include "colmap/sensor/bitmap_decoder.h"
 #include "colmap/util/cache.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
 
+#include <future>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace colmap {
 namespace mvs {
@@ -57,6 +64,9 @@ class Workspace {
     // Whether to read image as RGB or gray scale.
     bool image_as_rgb = true;
 
+    // The backend used to decode the images, see ImageReaderOptions.
+    std::string bitmap_decoder = "freeimage";
+
     // Location and type of workspace.
     std::string workspace_path;
     std::string workspace_format;
@@ -67,13 +77,18 @@ class Workspace {
   explicit Workspace(const Options& options);
   virtual ~Workspace() = default;
 
-  // Do nothing when we use a cache. Data is loaded as needed.
+  // Load the data of the given images and release the data of all other
+  // images. Do nothing when we use a cache. Data is loaded as needed.
   virtual void Load(const std::vector<std::string>& image_names);
 
   inline const Options& GetOptions() const { return options_; }
 
   inline const Model& GetModel() const { return model_; }
 
+  // The view selection index of the model, which is read from the stereo
+  // folder or computed and written there on first access. Not thread-safe.
+  const ViewSelectionIndex& GetViewSelectionIndex();
+
   virtual const Bitmap& GetBitmap(int image_idx);
   virtual const DepthMap& GetDepthMap(int image_idx);
   virtual const NormalMap& GetNormalMap(int image_idx);
@@ -91,12 +106,21 @@ class Workspace {
  protected:
   std::string GetFileName(int image_idx) const;
 
+  // Decode the bitmap of an image and, in case the workspace holds the
+  // distorted original images, undistort it to the camera of the model.
+  std::unique_ptr<Bitmap> ReadBitmap(int image_idx) const;
+
   Options options_;
   Model model_;
+  std::unique_ptr<BitmapDecoder> bitmap_decoder_;
+  // Warp tables of the distorted cameras, which are shared by all images of
+  // the same camera.
+  mutable UndistortImageCache undistort_cache_;
 
  private:
   std::string depth_map_path_;
   std::string normal_map_path_;
+  std::unique_ptr<ViewSelectionIndex> view_selection_index_;
   std::vector<std::unique_ptr<Bitmap>> bitmaps_;
   std::vector<std::unique_ptr<DepthMap>> depth_maps_;
   std::vector<std::unique_ptr<NormalMap>> normal_maps_;
@@ -110,11 +134,44 @@ class CachedWorkspace : public Workspace {
 
   inline void ClearCache() { cache_.Clear(); }
 
+  // Memory of the cached images and maps in bytes, excluding the data of
+  // prefetches that are not yet inserted.
+  inline size_t NumBytes() const { return cache_.NumBytes(); }
+
   const Bitmap& GetBitmap(int image_idx) override;
   const DepthMap& GetDepthMap(int image_idx) override;
   const NormalMap& GetNormalMap(int image_idx) override;
 
+  // Asynchronously read the bitmap and optionally the depth and normal map of
+  // an image on the prefetch threads, unless they are already cached or
+  // being prefetched. The prefetch threads never modify the cache. Instead,
+  // the data is moved into the cache by the next access of the image or by
+  // InsertPrefetched. Like the other methods, this method must not be called
+  // concurrently, while WaitForPrefetch is thread-safe.
+  void Prefetch(int image_idx, bool prefetch_maps);
+
+  // Wait for the pending prefetches of the given images, e.g., before
+  // acquiring the lock that serializes the access to the workspace.
+  void WaitForPrefetch(const std::vector<int>& image_idxs);
+  // Wait for all pending prefetches.
+  void WaitForPrefetch();
+
+  // Move the data of all finished prefetches into the cache, which may evict
+  // the data returned by previous calls to the Get methods.
+  void InsertPrefetched();
+
+  // Insert the depth and normal map of an image, e.g., just computed by
+  // PatchMatch and written to disk, into the cache, such that subsequent
+  // accesses do not read them back from disk. Replaces any cached maps.
+  void InsertMaps(int image_idx, DepthMap depth_map, NormalMap normal_map);
+
  private:
+  std::unique_ptr<DepthMap> ReadDepthMap(int image_idx) const;
+  std::unique_ptr<NormalMap> ReadNormalMap(int image_idx) const;
+
+  // Move the prefetched data of the image into the cache, if there is any.
+  void InsertPrefetched(int image_idx);
+
   class CachedImage {
    public:
     CachedImage() {}
@@ -131,6 +188,17 @@ class CachedWorkspace : public Workspace {
   };
 
   MemoryConstrainedLRUCache<int, CachedImage> cache_;
+
+  struct PrefetchedImage {
+    std::shared_future<void> future;
+    // Only accessed by the prefetch thread until the future is ready.
+    std::shared_ptr<CachedImage> image;
+  };
+
+  std::mutex prefetch_mutex_;
+  std::unordered_map<int, PrefetchedImage> prefetched_images_;
+  // Destroyed first, such that no prefetch accesses the other members.
+  std::unique_ptr<ThreadPool> prefetch_thread_pool_;
 };
 
 // Import a PMVS workspace into the COLMAP workspace format. Only images in the
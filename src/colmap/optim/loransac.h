@@ -71,6 +71,11 @@ class LORANSAC : public RANSAC<Estimator, SupportMeasurer, Sampler> {
   using RANSAC<Estimator, SupportMeasurer, Sampler>::support_measurer;
 
  private:
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::InitializeSPRT;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::VerifySPRT;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::UpdateSPRT;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::CreateThreadPool;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::EstimateBatch;
   using RANSAC<Estimator, SupportMeasurer, Sampler>::options_;
 };
 
@@ -127,100 +132,162 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
 
   sampler.Initialize(num_samples);
 
+  // The randomized verification depends on the order of the evaluated models
+  // and is only used for sequential evaluation.
+  std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool();
+  const bool use_sprt = options_.use_sprt && !thread_pool;
+  if (use_sprt) {
+    InitializeSPRT(X, Y);
+  }
+
   size_t max_num_trials =
       std::min<size_t>(options_.max_num_trials, sampler.MaxNumSamples());
   size_t dyn_max_num_trials = max_num_trials;
   const size_t min_num_trials = options_.min_num_trials;
 
-  for (report.num_trials = 0; report.num_trials < max_num_trials;
-       ++report.num_trials) {
-    if (abort) {
-      report.num_trials += 1;
-      break;
-    }
-
-    sampler.SampleXY(X, Y, &X_rand, &Y_rand);
-
-    // Estimate model for current subset.
-    estimator.Estimate(X_rand, Y_rand, &sample_models);
-
-    // Iterate through all estimated models
-    for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
-
-      // Do local optimization if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
-        best_support = support;
-        best_model = sample_model;
-        best_model_is_local = false;
-
-        // Estimate locally optimized model from inliers.
-        if (support.num_inliers > Estimator::kMinNumSamples &&
-            support.num_inliers >= LocalEstimator::kMinNumSamples) {
-          // Recursive local optimization to expand inlier set.
-          const size_t kMaxNumLocalTrials = 10;
-          for (size_t local_num_trials = 0;
-               local_num_trials < kMaxNumLocalTrials;
-               ++local_num_trials) {
-            X_inlier.clear();
-            Y_inlier.clear();
-            X_inlier.reserve(num_samples);
-            Y_inlier.reserve(num_samples);
-            for (size_t i = 0; i < residuals.size(); ++i) {
-              if (residuals[i] <= max_residual) {
-                X_inlier.push_back(X[i]);
-                Y_inlier.push_back(Y[i]);
-              }
+  // Update the best model with the model, whose residuals were computed.
+  const auto evaluate_model = [&](const typename Estimator::M_t& sample_model) {
+    THROW_CHECK_EQ(residuals.size(), num_samples);
+
+    const auto support = support_measurer.Evaluate(residuals, max_residual);
+
+    // Do local optimization if better than all previous subsets.
+    if (support_measurer.Compare(support, best_support)) {
+      best_support = support;
+      best_model = sample_model;
+      best_model_is_local = false;
+
+      // Estimate locally optimized model from inliers.
+      if (support.num_inliers > Estimator::kMinNumSamples &&
+          support.num_inliers >= LocalEstimator::kMinNumSamples) {
+        // Recursive local optimization to expand inlier set.
+        const size_t kMaxNumLocalTrials = 10;
+        for (size_t local_num_trials = 0; local_num_trials < kMaxNumLocalTrials;
+             ++local_num_trials) {
+          X_inlier.clear();
+          Y_inlier.clear();
+          X_inlier.reserve(num_samples);
+          Y_inlier.reserve(num_samples);
+          for (size_t i = 0; i < residuals.size(); ++i) {
+            if (residuals[i] <= max_residual) {
+              X_inlier.push_back(X[i]);
+              Y_inlier.push_back(Y[i]);
             }
+          }
 
-            local_estimator.Estimate(X_inlier, Y_inlier, &local_models);
-
-            const size_t prev_best_num_inliers = best_support.num_inliers;
+          local_estimator.Estimate(X_inlier, Y_inlier, &local_models);
 
-            for (const auto& local_model : local_models) {
-              local_estimator.Residuals(X, Y, local_model, &residuals);
-              THROW_CHECK_EQ(residuals.size(), num_samples);
+          const size_t prev_best_num_inliers = best_support.num_inliers;
 
-              const auto local_support =
-                  support_measurer.Evaluate(residuals, max_residual);
+          for (const auto& local_model : local_models) {
+            local_estimator.Residuals(X, Y, local_model, &residuals);
+            THROW_CHECK_EQ(residuals.size(), num_samples);
 
-              // Check if locally optimized model is better.
-              if (support_measurer.Compare(local_support, best_support)) {
-                best_support = local_support;
-                best_model = local_model;
-                best_model_is_local = true;
-                std::swap(residuals, best_local_residuals);
-              }
-            }
+            const auto local_support =
+                support_measurer.Evaluate(residuals, max_residual);
 
-            // Only continue recursive local optimization, if the inlier set
-            // size increased and we thus have a chance to further improve.
-            if (best_support.num_inliers <= prev_best_num_inliers) {
-              break;
+            // Check if locally optimized model is better.
+            if (support_measurer.Compare(local_support, best_support)) {
+              best_support = local_support;
+              best_model = local_model;
+              best_model_is_local = true;
+              std::swap(residuals, best_local_residuals);
             }
+          }
 
-            // Swap back the residuals, so we can extract the best inlier
-            // set in the next recursion of local optimization.
-            std::swap(residuals, best_local_residuals);
+          // Only continue recursive local optimization, if the inlier set
+          // size increased and we thus have a chance to further improve.
+          if (best_support.num_inliers <= prev_best_num_inliers) {
+            break;
           }
+
+          // Swap back the residuals, so we can extract the best inlier
+          // set in the next recursion of local optimization.
+          std::swap(residuals, best_local_residuals);
         }
+      }
 
-        dyn_max_num_trials =
-            RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
-                best_support.num_inliers,
-                num_samples,
-                options_.confidence,
-                options_.dyn_num_trials_multiplier);
+      if (use_sprt) {
+        UpdateSPRT(best_support.num_inliers, num_samples);
       }
 
-      if (report.num_trials >= dyn_max_num_trials &&
-          report.num_trials >= min_num_trials) {
-        abort = true;
+      dyn_max_num_trials =
+          RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
+              best_support.num_inliers,
+              num_samples,
+              options_.confidence,
+              options_.dyn_num_trials_multiplier);
+    }
+  };
+
+  if (thread_pool) {
+    // The models are evaluated in the same order as in the sequential case,
+    // but their residuals are computed ahead in parallel for a batch of trials.
+    const size_t max_num_batch_trials = 4 * thread_pool->NumThreads();
+    std::vector<typename Estimator::M_t> batch_models;
+    std::vector<size_t> batch_model_trial_idxs;
+    std::vector<std::vector<double>> batch_residuals;
+    while (report.num_trials < max_num_trials && !abort) {
+      const size_t num_batch_trials =
+          std::min(max_num_batch_trials, max_num_trials - report.num_trials);
+      EstimateBatch(X,
+                    Y,
+                    num_batch_trials,
+                    thread_pool.get(),
+                    &batch_models,
+                    &batch_model_trial_idxs,
+                    &batch_residuals);
+      size_t model_idx = 0;
+      for (size_t trial_idx = 0; trial_idx < num_batch_trials; ++trial_idx) {
+        for (; model_idx < batch_models.size() &&
+               batch_model_trial_idxs[model_idx] == trial_idx;
+             ++model_idx) {
+          std::swap(residuals, batch_residuals[model_idx]);
+          evaluate_model(batch_models[model_idx]);
+          if (report.num_trials >= dyn_max_num_trials &&
+              report.num_trials >= min_num_trials) {
+            abort = true;
+            break;
+          }
+        }
+        report.num_trials += 1;
+        if (abort) {
+          // Same count as for the sequential iteration.
+          if (report.num_trials < max_num_trials) {
+            report.num_trials += 1;
+          }
+          break;
+        }
+      }
+    }
+  } else {
+    for (report.num_trials = 0; report.num_trials < max_num_trials;
+         ++report.num_trials) {
+      if (abort) {
+        report.num_trials += 1;
         break;
       }
+
+      sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+
+      // Estimate model for current subset.
+      estimator.Estimate(X_rand, Y_rand, &sample_models);
+
+      // Iterate through all estimated models
+      for (const auto& sample_model : sample_models) {
+        // Models rejected by the randomized verification are unlikely to be
+        // better than the best model.
+        if (!use_sprt || VerifySPRT(sample_model, max_residual)) {
+          estimator.Residuals(X, Y, sample_model, &residuals);
+          evaluate_model(sample_model);
+        }
+
+        if (report.num_trials >= dyn_max_num_trials &&
+            report.num_trials >= min_num_trials) {
+          abort = true;
+          break;
+        }
+      }
     }
   }
 
@@ -52,11 +52,11 @@ TEST(LORANSAC, Report) {
   EXPECT_EQ(report.inlier_mask.size(), 0);
 }
 
-TEST(LORANSAC, SimilarityTransform) {
+RANSAC<SimilarityTransformEstimator<3>>::Report TestSimilarityTransform(
+    const size_t num_outliers, const bool use_sprt, const int num_threads = 1) {
   SetPRNGSeed(0);
 
   const size_t num_samples = 1000;
-  const size_t num_outliers = 400;
 
   // Create some arbitrary transformation.
   const Sim3d expectedTgtFromSrc(
@@ -80,6 +80,9 @@ TEST(LORANSAC, SimilarityTransform) {
   // Robustly estimate transformation using RANSAC.
   RANSACOptions options;
   options.max_error = 10;
+  options.min_inlier_ratio = 0.05;
+  options.use_sprt = use_sprt;
+  options.num_threads = num_threads;
   LORANSAC<SimilarityTransformEstimator<3>, SimilarityTransformEstimator<3>>
       ransac(options);
   const auto report = ransac.Estimate(src, tgt);
@@ -101,6 +104,28 @@ TEST(LORANSAC, SimilarityTransform) {
   const double matrix_diff =
       (expectedTgtFromSrc.ToMatrix() - report.model).norm();
   EXPECT_LT(matrix_diff, 1e-6);
+
+  return report;
+}
+
+TEST(LORANSAC, SimilarityTransform) {
+  TestSimilarityTransform(/*num_outliers=*/400, /*use_sprt=*/false);
+}
+
+TEST(LORANSAC, SimilarityTransformSPRT) {
+  TestSimilarityTransform(/*num_outliers=*/400, /*use_sprt=*/true);
+  TestSimilarityTransform(/*num_outliers=*/900, /*use_sprt=*/true);
+}
+
+TEST(LORANSAC, SimilarityTransformMultiThreaded) {
+  // The models are evaluated in the same order as for a single thread.
+  const auto report =
+      TestSimilarityTransform(/*num_outliers=*/400, /*use_sprt=*/false);
+  const auto parallel_report = TestSimilarityTransform(
+      /*num_outliers=*/400, /*use_sprt=*/false, /*num_threads=*/4);
+  EXPECT_EQ(parallel_report.num_trials, report.num_trials);
+  EXPECT_EQ(parallel_report.support.residual_sum, report.support.residual_sum);
+  EXPECT_EQ(parallel_report.model, report.model);
 }
 
 }  // namespace
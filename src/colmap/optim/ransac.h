@@ -29,11 +29,17 @@
 
 #pragma once
 
+#include "colmap/math/random.h"
 #include "colmap/optim/random_sampler.h"
+#include "colmap/optim/sprt.h"
 #include "colmap/optim/support_measurement.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
+#include <algorithm>
 #include <cfloat>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <stdexcept>
 #include <vector>
@@ -61,6 +67,23 @@ struct RANSACOptions {
   int min_num_trials = 0;
   int max_num_trials = std::numeric_limits<int>::max();
 
+  // Whether to verify the models randomly with the sequential probability
+  // ratio test (SPRT), which rejects bad models after evaluating the
+  // residuals of a few random samples instead of all samples. The parameters
+  // of the test are adapted online to the inlier ratio of the best model and
+  // the fraction of consistent samples of the rejected models. This is most
+  // effective for a low inlier ratio and many samples.
+  bool use_sprt = false;
+
+  // Number of threads to compute the residuals of the models in parallel,
+  // where -1 uses all cores. With more than one thread, the models of a batch
+  // of trials are sampled and estimated sequentially with the same random
+  // sequence as for a single thread and then evaluated in parallel, such that
+  // the result does not depend on the number of threads. This requires the
+  // residuals of the estimator to be thread-safe and the randomized
+  // verification is not used. Only worthwhile for many samples and trials.
+  int num_threads = 1;
+
   void Check() const {
     THROW_CHECK_GT(max_error, 0);
     THROW_CHECK_GE(min_inlier_ratio, 0);
@@ -68,6 +91,7 @@ struct RANSACOptions {
     THROW_CHECK_GE(confidence, 0);
     THROW_CHECK_LE(confidence, 1);
     THROW_CHECK_LE(min_num_trials, max_num_trials);
+    THROW_CHECK(num_threads == -1 || num_threads > 0);
   }
 };
 
@@ -128,7 +152,41 @@ class RANSAC {
   SupportMeasurer support_measurer;
 
  protected:
+  // Prepare the randomized verification of the models, which evaluates the
+  // residuals of the samples in random order in chunks of samples.
+  void InitializeSPRT(const std::vector<typename Estimator::X_t>& X,
+                      const std::vector<typename Estimator::Y_t>& Y);
+
+  // Whether the model passes the randomized verification, in which case the
+  // caller computes its support from the residuals of all samples.
+  bool VerifySPRT(const typename Estimator::M_t& model, double max_residual);
+
+  // Adapt the test to the inlier ratio of a new best model.
+  void UpdateSPRT(size_t num_inliers, size_t num_samples);
+
+  // Thread pool for the parallel evaluation of the models or null, if the
+  // models are evaluated sequentially.
+  std::unique_ptr<ThreadPool> CreateThreadPool() const;
+
+  // Sample and estimate the models of the next trials and compute their
+  // residuals in parallel. Each model has the index of its trial in the batch.
+  void EstimateBatch(const std::vector<typename Estimator::X_t>& X,
+                     const std::vector<typename Estimator::Y_t>& Y,
+                     size_t num_trials,
+                     ThreadPool* thread_pool,
+                     std::vector<typename Estimator::M_t>* models,
+                     std::vector<size_t>* model_trial_idxs,
+                     std::vector<std::vector<double>>* residuals);
+
   RANSACOptions options_;
+
+ private:
+  std::unique_ptr<SPRT> sprt_;
+  std::vector<std::vector<typename Estimator::X_t>> sprt_X_chunks_;
+  std::vector<std::vector<typename Estimator::Y_t>> sprt_Y_chunks_;
+  std::vector<double> sprt_residuals_;
+  size_t sprt_num_rejected_models_ = 0;
+  double sprt_sum_rejected_inlier_ratios_ = 0;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -178,6 +236,144 @@ size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
       std::ceil(std::log(nom) / std::log(denom) * num_trials_multiplier));
 }
 
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::InitializeSPRT(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) {
+  // The samples are evaluated in random order, as assumed by the test, but
+  // copied once into chunks, such that the estimator can compute the residuals
+  // of a chunk at once. Sampling the models from the original order keeps
+  // working for order-dependent samplers, e.g., PROSAC.
+  constexpr size_t kChunkSize = 32;
+  std::vector<size_t> sample_idxs(X.size());
+  std::iota(sample_idxs.begin(), sample_idxs.end(), 0);
+  Shuffle(static_cast<uint32_t>(sample_idxs.size()), &sample_idxs);
+  const size_t num_chunks = (sample_idxs.size() + kChunkSize - 1) / kChunkSize;
+  sprt_X_chunks_.resize(num_chunks);
+  sprt_Y_chunks_.resize(num_chunks);
+  for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+    const size_t begin = chunk_idx * kChunkSize;
+    const size_t end = std::min(begin + kChunkSize, sample_idxs.size());
+    sprt_X_chunks_[chunk_idx].clear();
+    sprt_Y_chunks_[chunk_idx].clear();
+    for (size_t i = begin; i < end; ++i) {
+      sprt_X_chunks_[chunk_idx].push_back(X[sample_idxs[i]]);
+      sprt_Y_chunks_[chunk_idx].push_back(Y[sample_idxs[i]]);
+    }
+  }
+
+  // The test starts from the a priori assumed minimum inlier ratio.
+  SPRT::Options sprt_options;
+  sprt_options.epsilon = std::max(options_.min_inlier_ratio, 0.05);
+  sprt_options.delta = std::min(sprt_options.delta, 0.5 * sprt_options.epsilon);
+  sprt_ = std::make_unique<SPRT>(sprt_options);
+  sprt_num_rejected_models_ = 0;
+  sprt_sum_rejected_inlier_ratios_ = 0;
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+bool RANSAC<Estimator, SupportMeasurer, Sampler>::VerifySPRT(
+    const typename Estimator::M_t& model, const double max_residual) {
+  double likelihood_ratio = 1;
+  size_t num_inliers = 0;
+  size_t num_eval_samples = 0;
+  for (size_t chunk_idx = 0; chunk_idx < sprt_X_chunks_.size(); ++chunk_idx) {
+    estimator.Residuals(sprt_X_chunks_[chunk_idx],
+                        sprt_Y_chunks_[chunk_idx],
+                        model,
+                        &sprt_residuals_);
+    if (!sprt_->Evaluate(sprt_residuals_,
+                         max_residual,
+                         &likelihood_ratio,
+                         &num_inliers,
+                         &num_eval_samples)) {
+      // Estimate the probability that a sample is consistent with a bad model
+      // from the rejected models and adapt the test, if it changed notably.
+      sprt_num_rejected_models_ += 1;
+      sprt_sum_rejected_inlier_ratios_ +=
+          static_cast<double>(num_inliers) / num_eval_samples;
+      SPRT::Options sprt_options = sprt_->GetOptions();
+      const double delta = std::clamp(
+          sprt_sum_rejected_inlier_ratios_ / sprt_num_rejected_models_,
+          1e-4,
+          0.5 * sprt_options.epsilon);
+      if (std::abs(delta - sprt_options.delta) > 0.05 * sprt_options.delta) {
+        sprt_options.delta = delta;
+        sprt_->Update(sprt_options);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::UpdateSPRT(
+    const size_t num_inliers, const size_t num_samples) {
+  SPRT::Options sprt_options = sprt_->GetOptions();
+  const double epsilon = static_cast<double>(num_inliers) / num_samples;
+  if (epsilon <= sprt_options.epsilon) {
+    return;
+  }
+  // Models with a smaller inlier ratio cannot become the best model.
+  sprt_options.epsilon = std::min(epsilon, 0.99);
+  sprt_options.delta = std::min(sprt_options.delta, 0.5 * sprt_options.epsilon);
+  sprt_->Update(sprt_options);
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+std::unique_ptr<ThreadPool>
+RANSAC<Estimator, SupportMeasurer, Sampler>::CreateThreadPool() const {
+  if (GetEffectiveNumThreads(options_.num_threads) <= 1) {
+    return nullptr;
+  }
+  return std::make_unique<ThreadPool>(options_.num_threads);
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::EstimateBatch(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    const size_t num_trials,
+    ThreadPool* thread_pool,
+    std::vector<typename Estimator::M_t>* models,
+    std::vector<size_t>* model_trial_idxs,
+    std::vector<std::vector<double>>* residuals) {
+  std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
+  std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
+  std::vector<typename Estimator::M_t> sample_models;
+
+  models->clear();
+  model_trial_idxs->clear();
+  for (size_t trial_idx = 0; trial_idx < num_trials; ++trial_idx) {
+    sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+    estimator.Estimate(X_rand, Y_rand, &sample_models);
+    for (const auto& sample_model : sample_models) {
+      models->push_back(sample_model);
+      model_trial_idxs->push_back(trial_idx);
+    }
+  }
+
+  if (residuals->size() < models->size()) {
+    residuals->resize(models->size());
+  }
+
+  const size_t num_tasks =
+      std::min(thread_pool->NumThreads(), models->size());
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_tasks);
+  for (size_t task_idx = 0; task_idx < num_tasks; ++task_idx) {
+    futures.push_back(thread_pool->AddTask([&, task_idx]() {
+      for (size_t i = task_idx; i < models->size(); i += num_tasks) {
+        estimator.Residuals(X, Y, (*models)[i], &(*residuals)[i]);
+      }
+    }));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
 template <typename Estimator, typename SupportMeasurer, typename Sampler>
 typename RANSAC<Estimator, SupportMeasurer, Sampler>::Report
 RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
@@ -206,51 +402,116 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
 
   std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
   std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
+  // The estimators clear and refill the models, such that the storage is only
+  // allocated in the first trials.
   std::vector<typename Estimator::M_t> sample_models;
 
   sampler.Initialize(num_samples);
 
+  // The randomized verification depends on the order of the evaluated models
+  // and is only used for sequential evaluation.
+  std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool();
+  const bool use_sprt = options_.use_sprt && !thread_pool;
+  if (use_sprt) {
+    InitializeSPRT(X, Y);
+  }
+
   size_t max_num_trials =
       std::min<size_t>(options_.max_num_trials, sampler.MaxNumSamples());
   size_t dyn_max_num_trials = max_num_trials;
   const size_t min_num_trials = options_.min_num_trials;
 
-  for (report.num_trials = 0; report.num_trials < max_num_trials;
-       ++report.num_trials) {
-    if (abort) {
-      report.num_trials += 1;
-      break;
-    }
+  // Update the best model with the model, whose residuals were computed.
+  const auto evaluate_model = [&](const typename Estimator::M_t& model) {
+    THROW_CHECK_EQ(residuals.size(), num_samples);
 
-    sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+    const auto support = support_measurer.Evaluate(residuals, max_residual);
 
-    // Estimate model for current subset.
-    estimator.Estimate(X_rand, Y_rand, &sample_models);
-
-    // Iterate through all estimated models.
-    for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
+    // Save as best subset if better than all previous subsets.
+    if (support_measurer.Compare(support, best_support)) {
+      best_support = support;
+      best_model = model;
 
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
+      if (use_sprt) {
+        UpdateSPRT(best_support.num_inliers, num_samples);
+      }
 
-      // Save as best subset if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
-        best_support = support;
-        best_model = sample_model;
+      dyn_max_num_trials =
+          ComputeNumTrials(best_support.num_inliers,
+                           num_samples,
+                           options_.confidence,
+                           options_.dyn_num_trials_multiplier);
+    }
+  };
 
-        dyn_max_num_trials =
-            ComputeNumTrials(best_support.num_inliers,
-                             num_samples,
-                             options_.confidence,
-                             options_.dyn_num_trials_multiplier);
+  if (thread_pool) {
+    // The models are evaluated in the same order as in the sequential case,
+    // but their residuals are computed ahead in parallel for a batch of trials.
+    const size_t max_num_batch_trials = 4 * thread_pool->NumThreads();
+    std::vector<typename Estimator::M_t> batch_models;
+    std::vector<size_t> batch_model_trial_idxs;
+    std::vector<std::vector<double>> batch_residuals;
+    while (report.num_trials < max_num_trials && !abort) {
+      const size_t num_batch_trials =
+          std::min(max_num_batch_trials, max_num_trials - report.num_trials);
+      EstimateBatch(X,
+                    Y,
+                    num_batch_trials,
+                    thread_pool.get(),
+                    &batch_models,
+                    &batch_model_trial_idxs,
+                    &batch_residuals);
+      size_t model_idx = 0;
+      for (size_t trial_idx = 0; trial_idx < num_batch_trials; ++trial_idx) {
+        for (; model_idx < batch_models.size() &&
+               batch_model_trial_idxs[model_idx] == trial_idx;
+             ++model_idx) {
+          std::swap(residuals, batch_residuals[model_idx]);
+          evaluate_model(batch_models[model_idx]);
+          if (report.num_trials >= dyn_max_num_trials &&
+              report.num_trials >= min_num_trials) {
+            abort = true;
+            break;
+          }
+        }
+        report.num_trials += 1;
+        if (abort) {
+          // Same count as for the sequential iteration.
+          if (report.num_trials < max_num_trials) {
+            report.num_trials += 1;
+          }
+          break;
+        }
       }
-
-      if (report.num_trials >= dyn_max_num_trials &&
-          report.num_trials >= min_num_trials) {
-        abort = true;
+    }
+  } else {
+    for (report.num_trials = 0; report.num_trials < max_num_trials;
+         ++report.num_trials) {
+      if (abort) {
+        report.num_trials += 1;
         break;
       }
+
+      sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+
+      // Estimate model for current subset.
+      estimator.Estimate(X_rand, Y_rand, &sample_models);
+
+      // Iterate through all estimated models.
+      for (const auto& sample_model : sample_models) {
+        // Models rejected by the randomized verification are unlikely to be
+        // better than the best model.
+        if (!use_sprt || VerifySPRT(sample_model, max_residual)) {
+          estimator.Residuals(X, Y, sample_model, &residuals);
+          evaluate_model(sample_model);
+        }
+
+        if (report.num_trials >= dyn_max_num_trials &&
+            report.num_trials >= min_num_trials) {
+          abort = true;
+          break;
+        }
+      }
     }
   }
 
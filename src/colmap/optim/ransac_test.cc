@@ -84,11 +84,11 @@ TEST(RANSAC, NumTrials) {
             1);
 }
 
-TEST(RANSAC, SimilarityTransform) {
+RANSAC<SimilarityTransformEstimator<3>>::Report TestSimilarityTransform(
+    const size_t num_outliers, const bool use_sprt, const int num_threads = 1) {
   SetPRNGSeed(0);
 
   const size_t num_samples = 1000;
-  const size_t num_outliers = 400;
 
   // Create some arbitrary transformation.
   const Sim3d expectedTgtFromSrc(
@@ -112,6 +112,9 @@ TEST(RANSAC, SimilarityTransform) {
   // Robustly estimate transformation using RANSAC.
   RANSACOptions options;
   options.max_error = 10;
+  options.min_inlier_ratio = 0.05;
+  options.use_sprt = use_sprt;
+  options.num_threads = num_threads;
   RANSAC<SimilarityTransformEstimator<3>> ransac(options);
   const auto report = ransac.Estimate(src, tgt);
 
@@ -132,6 +135,28 @@ TEST(RANSAC, SimilarityTransform) {
   const double matrix_diff =
       (expectedTgtFromSrc.ToMatrix() - report.model).norm();
   EXPECT_LT(matrix_diff, 1e-6);
+
+  return report;
+}
+
+TEST(RANSAC, SimilarityTransform) {
+  TestSimilarityTransform(/*num_outliers=*/400, /*use_sprt=*/false);
+}
+
+TEST(RANSAC, SimilarityTransformSPRT) {
+  TestSimilarityTransform(/*num_outliers=*/400, /*use_sprt=*/true);
+  TestSimilarityTransform(/*num_outliers=*/900, /*use_sprt=*/true);
+}
+
+TEST(RANSAC, SimilarityTransformMultiThreaded) {
+  // The models are evaluated in the same order as for a single thread.
+  const auto report =
+      TestSimilarityTransform(/*num_outliers=*/400, /*use_sprt=*/false);
+  const auto parallel_report = TestSimilarityTransform(
+      /*num_outliers=*/400, /*use_sprt=*/false, /*num_threads=*/4);
+  EXPECT_EQ(parallel_report.num_trials, report.num_trials);
+  EXPECT_EQ(parallel_report.support.residual_sum, report.support.residual_sum);
+  EXPECT_EQ(parallel_report.model, report.model);
 }
 
 }  // namespace
@@ -63,11 +63,24 @@ class SPRT {
 
   void Update(const Options& options);
 
+  const Options& GetOptions() const;
+
   bool Evaluate(const std::vector<double>& residuals,
                 double max_residual,
                 size_t* num_inliers,
                 size_t* num_eval_samples);
 
+  // Continue the evaluation of a model with the next residuals, e.g., to
+  // evaluate the residuals in chunks. The likelihood ratio, the number of
+  // inliers, and the number of evaluated samples are accumulated over the
+  // calls and must be initialized to 1, 0, and 0 for a new model. Returns
+  // false, if the model is rejected.
+  bool Evaluate(const std::vector<double>& residuals,
+                double max_residual,
+                double* likelihood_ratio,
+                size_t* num_inliers,
+                size_t* num_eval_samples) const;
+
  private:
   void UpdateDecisionThreshold();
 
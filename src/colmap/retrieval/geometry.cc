@@ -84,5 +84,20 @@ float FeatureGeometry::GetAreaUnderTransform(const Eigen::Matrix2f& A) const {
   return 1.0f / std::sqrt(4.0f * N(0, 0) * N(1, 1) - B * B);
 }
 
+CompactFeatureGeometry::CompactFeatureGeometry(const FeatureGeometry& geometry)
+    : x(geometry.x),
+      y(geometry.y),
+      scale(geometry.scale),
+      orientation(geometry.orientation) {}
+
+FeatureGeometry CompactFeatureGeometry::Decode() const {
+  FeatureGeometry geometry;
+  geometry.x = static_cast<float>(x);
+  geometry.y = static_cast<float>(y);
+  geometry.scale = static_cast<float>(scale);
+  geometry.orientation = static_cast<float>(orientation);
+  return geometry;
+}
+
 }  // namespace retrieval
 }  // namespace colmap
@@ -65,6 +65,22 @@ struct FeatureGeometry {
   float orientation = 0.0f;
 };
 
+// Feature geometry with half-precision values, which is used to compactly
+// store the geometry of the features in a visual index. The relative error of
+// about 1e-3 (i.e., a few pixels for large image coordinates) is far below the
+// tolerances of spatial verification.
+struct CompactFeatureGeometry {
+  CompactFeatureGeometry() = default;
+  explicit CompactFeatureGeometry(const FeatureGeometry& geometry);
+
+  FeatureGeometry Decode() const;
+
+  Eigen::half x = Eigen::half(0.0f);
+  Eigen::half y = Eigen::half(0.0f);
+  Eigen::half scale = Eigen::half(0.0f);
+  Eigen::half orientation = Eigen::half(0.0f);
+};
+
 // 1-to-M feature geometry match.
 struct FeatureGeometryMatch {
   FeatureGeometry geometry1;
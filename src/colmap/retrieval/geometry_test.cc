@@ -138,6 +138,23 @@ TEST(FeatureGeometry, Orientation) {
   }
 }
 
+TEST(CompactFeatureGeometry, Nominal) {
+  FeatureGeometry geometry;
+  geometry.x = 4000.3f;
+  geometry.y = 12.34f;
+  geometry.scale = 2.5f;
+  geometry.orientation = -3.1f;
+  const FeatureGeometry decoded_geometry =
+      CompactFeatureGeometry(geometry).Decode();
+  EXPECT_NEAR(decoded_geometry.x, geometry.x, 1e-3 * geometry.x);
+  EXPECT_NEAR(decoded_geometry.y, geometry.y, 1e-3 * geometry.y);
+  EXPECT_EQ(decoded_geometry.scale, geometry.scale);
+  EXPECT_NEAR(decoded_geometry.orientation, geometry.orientation, 1e-3);
+  EXPECT_EQ(CompactFeatureGeometry(decoded_geometry).Decode().x,
+            decoded_geometry.x);
+  EXPECT_EQ(sizeof(CompactFeatureGeometry), 8);
+}
+
 }  // namespace
 }  // namespace retrieval
 }  // namespace colmap
@@ -0,0 +1,192 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/hamming_kernels.h"
+
+#include "colmap/util/logging.h"
+
+#if defined(COLMAP_SIMD_ENABLED) && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define COLMAP_HAMMING_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+typedef void (*HammingDistancesFunc)(const uint64_t* query,
+                                     const uint64_t* codes,
+                                     int num_words,
+                                     int num_codes,
+                                     int* distances);
+
+// Without a target attribute, the compiler falls back to a software popcount,
+// unless the whole binary is compiled for a CPU with a popcount instruction.
+void ComputeHammingDistancesScalar(const uint64_t* query,
+                                   const uint64_t* codes,
+                                   const int num_words,
+                                   const int num_codes,
+                                   int* distances) {
+  for (int i = 0; i < num_codes; ++i) {
+    const uint64_t* code = codes + i * num_words;
+    int distance = 0;
+    for (int w = 0; w < num_words; ++w) {
+      distance += __builtin_popcountll(query[w] ^ code[w]);
+    }
+    distances[i] = distance;
+  }
+}
+
+#if defined(COLMAP_HAMMING_KERNELS_X86)
+
+__attribute__((target("popcnt"))) void ComputeHammingDistancesPOPCNT(
+    const uint64_t* query,
+    const uint64_t* codes,
+    const int num_words,
+    const int num_codes,
+    int* distances) {
+  if (num_words == 1) {
+    const uint64_t query0 = query[0];
+    for (int i = 0; i < num_codes; ++i) {
+      distances[i] = __builtin_popcountll(query0 ^ codes[i]);
+    }
+    return;
+  }
+
+  for (int i = 0; i < num_codes; ++i) {
+    const uint64_t* code = codes + i * num_words;
+    int distance = 0;
+    for (int w = 0; w < num_words; ++w) {
+      distance += __builtin_popcountll(query[w] ^ code[w]);
+    }
+    distances[i] = distance;
+  }
+}
+
+// Computes the distances of eight single-word codes at once. Longer codes are
+// rare in practice and use the POPCNT kernel.
+__attribute__((target("popcnt,avx512f,avx512vpopcntdq"))) void
+ComputeHammingDistancesAVX512VPOPCNTDQ(const uint64_t* query,
+                                       const uint64_t* codes,
+                                       const int num_words,
+                                       const int num_codes,
+                                       int* distances) {
+  if (num_words != 1) {
+    ComputeHammingDistancesPOPCNT(
+        query, codes, num_words, num_codes, distances);
+    return;
+  }
+
+  const __m512i query8 = _mm512_set1_epi64(static_cast<long long>(query[0]));
+  int i = 0;
+  for (; i + 8 <= num_codes; i += 8) {
+    const __m512i codes8 = _mm512_loadu_si512(codes + i);
+    const __m512i counts8 =
+        _mm512_popcnt_epi64(_mm512_xor_si512(query8, codes8));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(distances + i),
+                        _mm512_cvtepi64_epi32(counts8));
+  }
+  for (; i < num_codes; ++i) {
+    distances[i] = __builtin_popcountll(query[0] ^ codes[i]);
+  }
+}
+
+#endif  // COLMAP_HAMMING_KERNELS_X86
+
+HammingDistancesFunc GetHammingDistancesFunc(const HammingKernelISA isa) {
+  THROW_CHECK(IsHammingKernelISASupported(isa))
+      << HammingKernelISAToString(isa) << " not supported";
+  switch (isa) {
+#if defined(COLMAP_HAMMING_KERNELS_X86)
+    case HammingKernelISA::POPCNT:
+      return &ComputeHammingDistancesPOPCNT;
+    case HammingKernelISA::AVX512_VPOPCNTDQ:
+      return &ComputeHammingDistancesAVX512VPOPCNTDQ;
+#endif  // COLMAP_HAMMING_KERNELS_X86
+    default:
+      return &ComputeHammingDistancesScalar;
+  }
+}
+
+}  // namespace
+
+std::string HammingKernelISAToString(const HammingKernelISA isa) {
+  switch (isa) {
+    case HammingKernelISA::SCALAR:
+      return "SCALAR";
+    case HammingKernelISA::POPCNT:
+      return "POPCNT";
+    case HammingKernelISA::AVX512_VPOPCNTDQ:
+      return "AVX512_VPOPCNTDQ";
+  }
+  return "UNKNOWN";
+}
+
+bool IsHammingKernelISASupported(const HammingKernelISA isa) {
+  switch (isa) {
+    case HammingKernelISA::SCALAR:
+      return true;
+#if defined(COLMAP_HAMMING_KERNELS_X86)
+    case HammingKernelISA::POPCNT:
+      return __builtin_cpu_supports("popcnt");
+    case HammingKernelISA::AVX512_VPOPCNTDQ:
+      return __builtin_cpu_supports("popcnt") &&
+             __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512vpopcntdq");
+#endif  // COLMAP_HAMMING_KERNELS_X86
+    default:
+      return false;
+  }
+}
+
+HammingKernelISA GetBestHammingKernelISA() {
+  static const HammingKernelISA kBestISA = []() {
+    for (const HammingKernelISA isa : {HammingKernelISA::AVX512_VPOPCNTDQ,
+                                       HammingKernelISA::POPCNT}) {
+      if (IsHammingKernelISASupported(isa)) {
+        return isa;
+      }
+    }
+    return HammingKernelISA::SCALAR;
+  }();
+  return kBestISA;
+}
+
+void ComputeHammingDistances(const uint64_t* query,
+                             const uint64_t* codes,
+                             const int num_words,
+                             const int num_codes,
+                             int* distances,
+                             const HammingKernelISA isa) {
+  GetHammingDistancesFunc(isa)(query, codes, num_words, num_codes, distances);
+}
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,67 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace colmap {
+namespace retrieval {
+
+// Instruction sets for which specialized Hamming distance kernels exist. The
+// best supported instruction set is determined once at runtime, so the same
+// binary can be deployed on machines with different CPU generations.
+enum class HammingKernelISA {
+  SCALAR,
+  POPCNT,
+  AVX512_VPOPCNTDQ,
+};
+
+// Name of the instruction set, e.g. for logging.
+std::string HammingKernelISAToString(HammingKernelISA isa);
+
+// Whether the given instruction set can be used on the current CPU and was
+// compiled into the binary.
+bool IsHammingKernelISASupported(HammingKernelISA isa);
+
+// Best instruction set supported by the current CPU. Evaluated only once.
+HammingKernelISA GetBestHammingKernelISA();
+
+// Computes the Hamming distances of a binary query code against num_codes
+// consecutive binary codes. Each code is packed into num_words 64-bit words.
+void ComputeHammingDistances(const uint64_t* query,
+                             const uint64_t* codes,
+                             int num_words,
+                             int num_codes,
+                             int* distances,
+                             HammingKernelISA isa = GetBestHammingKernelISA());
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,105 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/hamming_kernels.h"
+
+#include <bitset>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+std::vector<HammingKernelISA> GetSupportedISAs() {
+  std::vector<HammingKernelISA> isas;
+  for (const HammingKernelISA isa : {HammingKernelISA::SCALAR,
+                                     HammingKernelISA::POPCNT,
+                                     HammingKernelISA::AVX512_VPOPCNTDQ}) {
+    if (IsHammingKernelISASupported(isa)) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+std::vector<uint64_t> CreateRandomCodes(const int num_codes,
+                                        std::mt19937_64* prng) {
+  std::vector<uint64_t> codes(num_codes);
+  for (uint64_t& code : codes) {
+    code = (*prng)();
+  }
+  return codes;
+}
+
+TEST(GetBestHammingKernelISA, Nominal) {
+  EXPECT_TRUE(IsHammingKernelISASupported(HammingKernelISA::SCALAR));
+  EXPECT_TRUE(IsHammingKernelISASupported(GetBestHammingKernelISA()));
+}
+
+TEST(ComputeHammingDistances, Nominal) {
+  std::mt19937_64 prng(42);
+  for (const int num_words : {1, 2}) {
+    const std::vector<uint64_t> query = CreateRandomCodes(num_words, &prng);
+    // Not a multiple of the vector width to cover the remainder loops.
+    const int num_codes = 37;
+    std::vector<uint64_t> codes =
+        CreateRandomCodes(num_codes * num_words, &prng);
+    codes[0] = query[0];
+    codes[num_words] = ~query[0];
+    for (const HammingKernelISA isa : GetSupportedISAs()) {
+      std::vector<int> distances(num_codes);
+      ComputeHammingDistances(query.data(),
+                              codes.data(),
+                              num_words,
+                              num_codes,
+                              distances.data(),
+                              isa);
+      for (int i = 0; i < num_codes; ++i) {
+        int expected_distance = 0;
+        for (int w = 0; w < num_words; ++w) {
+          expected_distance +=
+              std::bitset<64>(query[w] ^ codes[i * num_words + w]).count();
+        }
+        EXPECT_EQ(distances[i], expected_distance)
+            << HammingKernelISAToString(isa);
+      }
+      if (num_words == 1) {
+        EXPECT_EQ(distances[0], 0);
+        EXPECT_EQ(distances[1], 64);
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
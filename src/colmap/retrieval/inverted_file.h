@@ -31,6 +31,7 @@
 
 #include "colmap/math/math.h"
 #include "colmap/retrieval/geometry.h"
+#include "colmap/retrieval/hamming_kernels.h"
 #include "colmap/retrieval/inverted_file_entry.h"
 #include "colmap/retrieval/utils.h"
 #include "colmap/util/eigen_alignment.h"
@@ -39,6 +40,7 @@
 #include <algorithm>
 #include <bitset>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <unordered_map>
 #include <unordered_set>
@@ -49,6 +51,82 @@
 namespace colmap {
 namespace retrieval {
 
+// Non-owning view of the data of an inverted file that is required for
+// scoring. Inverted files are scored through views, such that the same code
+// is used for inverted files in memory and for packed inverted files that are
+// used in-place from a memory-mapped visual index.
+template <int kEmbeddingDim>
+struct InvertedFileView {
+  typedef Eigen::VectorXf DescType;
+  typedef InvertedFileEntry<kEmbeddingDim> EntryType;
+
+  // The number of 64-bit words of a packed binary descriptor.
+  static constexpr int kNumCodeWords = (kEmbeddingDim + 63) / 64;
+
+  // Whether the inverted file is usable for scoring.
+  bool usable = false;
+
+  // The inverse document frequency weight of the inverted file.
+  float idf_weight = 0.0f;
+
+  // The kEmbeddingDim thresholds used for Hamming embedding.
+  const float* thresholds = nullptr;
+
+  // The entries of the inverted file sorted by image identifiers.
+  const EntryType* entries = nullptr;
+  size_t num_entries = 0;
+
+  // The binary descriptors of the entries in the same order, each packed into
+  // kNumCodeWords 64-bit words. Scoring only streams through these codes and
+  // touches the much larger entries only for features within the maximum
+  // Hamming distance.
+  const uint64_t* codes = nullptr;
+
+  const EntryType* begin() const { return entries; }
+  const EntryType* end() const { return entries + num_entries; }
+
+  void ConvertToBinaryDescriptor(
+      const DescType& descriptor,
+      std::bitset<kEmbeddingDim>* binary_descriptor) const;
+
+  void ScoreFeature(const DescType& descriptor,
+                    std::vector<ImageScore>* image_scores) const;
+
+  // Same as above but passes the score of each image to the given function
+  // instead of collecting the scores in a vector.
+  template <typename AddImageScoreFunc>
+  void ScoreFeature(const DescType& descriptor,
+                    AddImageScoreFunc&& add_image_score) const;
+
+  void GetImageIds(std::unordered_set<int>* ids) const;
+
+  void ComputeImageSelfSimilarities(
+      std::unordered_map<int, double>* self_similarities) const;
+
+  // Pack the bits of a binary descriptor into 64-bit words.
+  static void PackBinaryDescriptor(
+      const std::bitset<kEmbeddingDim>& binary_descriptor, uint64_t* code);
+
+ private:
+  // The functor to derive a voting weight from a Hamming distance.
+  static const HammingDistWeightFunctor<kEmbeddingDim>
+      hamming_dist_weight_functor_;
+};
+
+// Inverted file in the packed format of memory-mapped visual indices. The
+// entries and the packed binary descriptors of all inverted files are stored
+// contiguously in two separate arrays and each inverted file references the
+// range of its entries in both arrays.
+template <int kEmbeddingDim>
+struct PackedInvertedFile {
+  uint8_t status;
+  uint8_t reserved[3];
+  float idf_weight;
+  uint64_t entries_begin;
+  uint64_t num_entries;
+  float thresholds[kEmbeddingDim];
+};
+
 // Implements an inverted file, including the ability to compute image scores
 // and matches. The template parameter is the length of the binary vectors
 // in the Hamming Embedding.
@@ -135,11 +213,25 @@ class InvertedFile {
   void ComputeImageSelfSimilarities(
       std::unordered_map<int, double>* self_similarities) const;
 
+  // View of the inverted file, which is valid until the file is modified.
+  InvertedFileView<kEmbeddingDim> View() const;
+
+  // Convert the inverted file from/to the packed format, where the entries and
+  // their packed binary descriptors are stored separately starting at the
+  // given index into the packed entries.
+  PackedInvertedFile<kEmbeddingDim> Pack(uint64_t entries_begin) const;
+  void Unpack(const PackedInvertedFile<kEmbeddingDim>& packed_file,
+              const EntryType* entries,
+              const uint64_t* codes);
+
   // Read/write the inverted file from/to a binary file.
   void Read(std::ifstream* ifs);
   void Write(std::ofstream* ofs) const;
 
  private:
+  // Repack the binary descriptors of all entries.
+  void UpdateCodes();
+
   // Whether the inverted file is initialized.
   uint8_t status_;
 
@@ -149,12 +241,12 @@ class InvertedFile {
   // The entries of the inverted file system.
   std::vector<EntryType> entries_;
 
+  // The packed binary descriptors of the entries, which are kept in the same
+  // order as the entries.
+  std::vector<uint64_t> codes_;
+
   // The thresholds used for Hamming embedding.
   DescType thresholds_;
-
-  // The functor to derive a voting weight from a Hamming distance.
-  static const HammingDistWeightFunctor<kEmbeddingDim>
-      hamming_dist_weight_functor_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -163,7 +255,135 @@ class InvertedFile {
 
 template <int kEmbeddingDim>
 const HammingDistWeightFunctor<kEmbeddingDim>
-    InvertedFile<kEmbeddingDim>::hamming_dist_weight_functor_;
+    InvertedFileView<kEmbeddingDim>::hamming_dist_weight_functor_;
+
+template <int kEmbeddingDim>
+void InvertedFileView<kEmbeddingDim>::ConvertToBinaryDescriptor(
+    const DescType& descriptor,
+    std::bitset<kEmbeddingDim>* binary_descriptor) const {
+  THROW_CHECK_EQ(descriptor.size(), kEmbeddingDim);
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    (*binary_descriptor)[i] = descriptor[i] > thresholds[i];
+  }
+}
+
+template <int kEmbeddingDim>
+void InvertedFileView<kEmbeddingDim>::ScoreFeature(
+    const DescType& descriptor, std::vector<ImageScore>* image_scores) const {
+  image_scores->clear();
+  ScoreFeature(descriptor, [image_scores](const ImageScore& image_score) {
+    image_scores->push_back(image_score);
+  });
+}
+
+template <int kEmbeddingDim>
+template <typename AddImageScoreFunc>
+void InvertedFileView<kEmbeddingDim>::ScoreFeature(
+    const DescType& descriptor, AddImageScoreFunc&& add_image_score) const {
+  THROW_CHECK_EQ(descriptor.size(), kEmbeddingDim);
+
+  if (!usable) {
+    return;
+  }
+
+  if (num_entries == 0) {
+    return;
+  }
+
+  const float squared_idf_weight = idf_weight * idf_weight;
+
+  std::bitset<kEmbeddingDim> bin_descriptor;
+  ConvertToBinaryDescriptor(descriptor, &bin_descriptor);
+  uint64_t query_code[kNumCodeWords];
+  PackBinaryDescriptor(bin_descriptor, query_code);
+
+  ImageScore image_score;
+  image_score.image_id = entries[0].image_id;
+  image_score.score = 0.0f;
+  int num_image_votes = 0;
+
+  // The Hamming distances are computed for blocks of entries at once and only
+  // the entries within the maximum Hamming distance contribute to the scores.
+  // Note that this assumes that the entries are sorted using SortEntries
+  // according to their image identifiers.
+  constexpr size_t kBlockSize = 256;
+  int hamming_dists[kBlockSize];
+  for (size_t block_begin = 0; block_begin < num_entries;
+       block_begin += kBlockSize) {
+    const size_t block_size = std::min(kBlockSize, num_entries - block_begin);
+    ComputeHammingDistances(query_code,
+                            codes + block_begin * kNumCodeWords,
+                            kNumCodeWords,
+                            static_cast<int>(block_size),
+                            hamming_dists);
+
+    for (size_t i = 0; i < block_size; ++i) {
+      const int hamming_dist = hamming_dists[i];
+      if (hamming_dist > hamming_dist_weight_functor_.kMaxHammingDistance) {
+        continue;
+      }
+
+      const int image_id = entries[block_begin + i].image_id;
+      if (image_score.image_id < image_id) {
+        if (num_image_votes > 0) {
+          // Finalizes the voting since we now know how many features from
+          // the database image match the current image feature. This is
+          // required to perform burstiness normalization (cf. Eqn. 2 in
+          // Arandjelovic, Zisserman: Scalable descriptor
+          // distinctiveness for location recognition. ACCV 2014).
+          // Notice that the weight from the descriptor matching is already
+          // accumulated in image_score.score, i.e., we only need
+          // to apply the burstiness weighting.
+          image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
+          image_score.score *= squared_idf_weight;
+          add_image_score(image_score);
+        }
+
+        image_score.image_id = image_id;
+        image_score.score = 0.0f;
+        num_image_votes = 0;
+      }
+
+      image_score.score += hamming_dist_weight_functor_(hamming_dist);
+      num_image_votes += 1;
+    }
+  }
+
+  // Add the voting for the largest image_id in the entries.
+  if (num_image_votes > 0) {
+    image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
+    image_score.score *= squared_idf_weight;
+    add_image_score(image_score);
+  }
+}
+
+template <int kEmbeddingDim>
+void InvertedFileView<kEmbeddingDim>::GetImageIds(
+    std::unordered_set<int>* ids) const {
+  for (const EntryType& entry : *this) {
+    ids->insert(entry.image_id);
+  }
+}
+
+template <int kEmbeddingDim>
+void InvertedFileView<kEmbeddingDim>::ComputeImageSelfSimilarities(
+    std::unordered_map<int, double>* self_similarities) const {
+  const double squared_idf_weight = idf_weight * idf_weight;
+  for (const auto& entry : *this) {
+    (*self_similarities)[entry.image_id] += squared_idf_weight;
+  }
+}
+
+template <int kEmbeddingDim>
+void InvertedFileView<kEmbeddingDim>::PackBinaryDescriptor(
+    const std::bitset<kEmbeddingDim>& binary_descriptor, uint64_t* code) {
+  std::fill(code, code + kNumCodeWords, 0);
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    if (binary_descriptor[i]) {
+      code[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+}
 
 template <int kEmbeddingDim>
 InvertedFile<kEmbeddingDim>::InvertedFile()
@@ -214,9 +434,14 @@ void InvertedFile<kEmbeddingDim>::AddEntry(const int image_id,
   EntryType entry;
   entry.image_id = image_id;
   entry.feature_idx = feature_idx;
-  entry.geometry = geometry;
+  entry.geometry = CompactFeatureGeometry(geometry);
   ConvertToBinaryDescriptor(descriptor, &entry.descriptor);
   entries_.push_back(entry);
+  codes_.resize(codes_.size() + InvertedFileView<kEmbeddingDim>::kNumCodeWords);
+  InvertedFileView<kEmbeddingDim>::PackBinaryDescriptor(
+      entry.descriptor,
+      codes_.data() + codes_.size() -
+          InvertedFileView<kEmbeddingDim>::kNumCodeWords);
   status_ &= ~ENTRIES_SORTED;
 }
 
@@ -227,12 +452,14 @@ void InvertedFile<kEmbeddingDim>::SortEntries() {
             [](const EntryType& entry1, const EntryType& entry2) {
               return entry1.image_id < entry2.image_id;
             });
+  UpdateCodes();
   status_ |= ENTRIES_SORTED;
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ClearEntries() {
   entries_.clear();
+  codes_.clear();
   status_ &= ~ENTRIES_SORTED;
 }
 
@@ -241,6 +468,7 @@ void InvertedFile<kEmbeddingDim>::Reset() {
   status_ = UNUSABLE;
   idf_weight_ = 0.0f;
   entries_.clear();
+  codes_.clear();
   thresholds_.setZero();
 }
 
@@ -248,10 +476,7 @@ template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ConvertToBinaryDescriptor(
     const DescType& descriptor,
     std::bitset<kEmbeddingDim>* binary_descriptor) const {
-  THROW_CHECK_EQ(descriptor.size(), kEmbeddingDim);
-  for (int i = 0; i < kEmbeddingDim; ++i) {
-    (*binary_descriptor)[i] = descriptor[i] > thresholds_[i];
-  }
+  View().ConvertToBinaryDescriptor(descriptor, binary_descriptor);
 }
 
 template <int kEmbeddingDim>
@@ -294,81 +519,61 @@ void InvertedFile<kEmbeddingDim>::ComputeHammingEmbedding(
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ScoreFeature(
     const DescType& descriptor, std::vector<ImageScore>* image_scores) const {
-  THROW_CHECK_EQ(descriptor.size(), kEmbeddingDim);
-
-  image_scores->clear();
-
-  if (!IsUsable()) {
-    return;
-  }
-
-  if (entries_.size() == 0) {
-    return;
-  }
-
-  const float squared_idf_weight = idf_weight_ * idf_weight_;
-
-  std::bitset<kEmbeddingDim> bin_descriptor;
-  ConvertToBinaryDescriptor(descriptor, &bin_descriptor);
-
-  ImageScore image_score;
-  image_score.image_id = entries_.front().image_id;
-  image_score.score = 0.0f;
-  int num_image_votes = 0;
-
-  // Note that this assumes that the entries are sorted using SortEntries
-  // according to their image identifiers.
-  for (const auto& entry : entries_) {
-    if (image_score.image_id < entry.image_id) {
-      if (num_image_votes > 0) {
-        // Finalizes the voting since we now know how many features from
-        // the database image match the current image feature. This is
-        // required to perform burstiness normalization (cf. Eqn. 2 in
-        // Arandjelovic, Zisserman: Scalable descriptor
-        // distinctiveness for location recognition. ACCV 2014).
-        // Notice that the weight from the descriptor matching is already
-        // accumulated in image_score.score, i.e., we only need
-        // to apply the burstiness weighting.
-        image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
-        image_score.score *= squared_idf_weight;
-        image_scores->push_back(image_score);
-      }
-
-      image_score.image_id = entry.image_id;
-      image_score.score = 0.0f;
-      num_image_votes = 0;
-    }
-
-    const size_t hamming_dist = (bin_descriptor ^ entry.descriptor).count();
-
-    if (hamming_dist <= hamming_dist_weight_functor_.kMaxHammingDistance) {
-      image_score.score += hamming_dist_weight_functor_(hamming_dist);
-      num_image_votes += 1;
-    }
-  }
-
-  // Add the voting for the largest image_id in the entries.
-  if (num_image_votes > 0) {
-    image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
-    image_score.score *= squared_idf_weight;
-    image_scores->push_back(image_score);
-  }
+  View().ScoreFeature(descriptor, image_scores);
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::GetImageIds(
     std::unordered_set<int>* ids) const {
-  for (const EntryType& entry : entries_) {
-    ids->insert(entry.image_id);
-  }
+  View().GetImageIds(ids);
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ComputeImageSelfSimilarities(
     std::unordered_map<int, double>* self_similarities) const {
-  const double squared_idf_weight = idf_weight_ * idf_weight_;
-  for (const auto& entry : entries_) {
-    (*self_similarities)[entry.image_id] += squared_idf_weight;
+  View().ComputeImageSelfSimilarities(self_similarities);
+}
+
+template <int kEmbeddingDim>
+InvertedFileView<kEmbeddingDim> InvertedFile<kEmbeddingDim>::View() const {
+  InvertedFileView<kEmbeddingDim> view;
+  view.usable = IsUsable();
+  view.idf_weight = idf_weight_;
+  view.thresholds = thresholds_.data();
+  view.entries = entries_.data();
+  view.num_entries = entries_.size();
+  view.codes = codes_.data();
+  return view;
+}
+
+template <int kEmbeddingDim>
+PackedInvertedFile<kEmbeddingDim> InvertedFile<kEmbeddingDim>::Pack(
+    const uint64_t entries_begin) const {
+  PackedInvertedFile<kEmbeddingDim> packed_file;
+  std::memset(&packed_file, 0, sizeof(packed_file));
+  packed_file.status = status_;
+  packed_file.idf_weight = idf_weight_;
+  packed_file.entries_begin = entries_begin;
+  packed_file.num_entries = entries_.size();
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    packed_file.thresholds[i] = thresholds_[i];
+  }
+  return packed_file;
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::Unpack(
+    const PackedInvertedFile<kEmbeddingDim>& packed_file,
+    const EntryType* entries,
+    const uint64_t* codes) {
+  status_ = packed_file.status;
+  idf_weight_ = packed_file.idf_weight;
+  entries_.assign(entries, entries + packed_file.num_entries);
+  codes_.assign(codes,
+                codes + packed_file.num_entries *
+                            InvertedFileView<kEmbeddingDim>::kNumCodeWords);
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    thresholds_[i] = packed_file.thresholds[i];
   }
 }
 
@@ -390,6 +595,8 @@ void InvertedFile<kEmbeddingDim>::Read(std::ifstream* ifs) {
   for (uint32_t i = 0; i < num_entries; ++i) {
     entries_[i].Read(ifs);
   }
+
+  UpdateCodes();
 }
 
 template <int kEmbeddingDim>
@@ -411,5 +618,15 @@ void InvertedFile<kEmbeddingDim>::Write(std::ofstream* ofs) const {
   }
 }
 
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::UpdateCodes() {
+  constexpr int kNumCodeWords = InvertedFileView<kEmbeddingDim>::kNumCodeWords;
+  codes_.resize(entries_.size() * kNumCodeWords);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    InvertedFileView<kEmbeddingDim>::PackBinaryDescriptor(
+        entries_[i].descriptor, codes_.data() + i * kNumCodeWords);
+  }
+}
+
 }  // namespace retrieval
 }  // namespace colmap
@@ -52,7 +52,7 @@ struct InvertedFileEntry {
   int feature_idx = -1;
 
   // The geometry of the feature, used for spatial verification.
-  FeatureGeometry geometry;
+  CompactFeatureGeometry geometry;
 
   // The binary signature in the Hamming embedding.
   std::bitset<N> descriptor;
@@ -68,6 +68,8 @@ void InvertedFileEntry<N>::Read(std::istream* ifs) {
   static_assert(sizeof(unsigned long long) >= 8,
                 "Expected unsigned long to be at least 8 byte");
   static_assert(sizeof(FeatureGeometry) == 16, "Geometry type size mismatch");
+  static_assert(sizeof(CompactFeatureGeometry) == 8,
+                "Compact geometry type size mismatch");
 
   int32_t image_id_data = 0;
   ifs->read(reinterpret_cast<char*>(&image_id_data), sizeof(int32_t));
@@ -77,7 +79,10 @@ void InvertedFileEntry<N>::Read(std::istream* ifs) {
   ifs->read(reinterpret_cast<char*>(&feature_idx_data), sizeof(int32_t));
   feature_idx = static_cast<int>(feature_idx_data);
 
-  ifs->read(reinterpret_cast<char*>(&geometry), sizeof(FeatureGeometry));
+  // The geometry is stored in full precision for compatibility.
+  FeatureGeometry geometry_data;
+  ifs->read(reinterpret_cast<char*>(&geometry_data), sizeof(FeatureGeometry));
+  geometry = CompactFeatureGeometry(geometry_data);
 
   uint64_t descriptor_data = 0;
   ifs->read(reinterpret_cast<char*>(&descriptor_data), sizeof(uint64_t));
@@ -90,6 +95,8 @@ void InvertedFileEntry<N>::Write(std::ostream* ofs) const {
   static_assert(sizeof(unsigned long long) >= 8,
                 "Expected unsigned long to be at least 8 byte");
   static_assert(sizeof(FeatureGeometry) == 16, "Geometry type size mismatch");
+  static_assert(sizeof(CompactFeatureGeometry) == 8,
+                "Compact geometry type size mismatch");
 
   const int32_t image_id_data = image_id;
   ofs->write(reinterpret_cast<const char*>(&image_id_data), sizeof(int32_t));
@@ -97,7 +104,9 @@ void InvertedFileEntry<N>::Write(std::ostream* ofs) const {
   const int32_t feature_idx_data = feature_idx;
   ofs->write(reinterpret_cast<const char*>(&feature_idx_data), sizeof(int32_t));
 
-  ofs->write(reinterpret_cast<const char*>(&geometry), sizeof(FeatureGeometry));
+  const FeatureGeometry geometry_data = geometry.Decode();
+  ofs->write(reinterpret_cast<const char*>(&geometry_data),
+             sizeof(FeatureGeometry));
 
   const uint64_t descriptor_data =
       static_cast<uint64_t>(descriptor.to_ullong());
@@ -39,10 +39,10 @@ TEST(InvertedFileEntry, Empty) {
   InvertedFileEntry<10> entry;
   EXPECT_EQ(entry.image_id, -1);
   EXPECT_EQ(entry.feature_idx, -1);
-  EXPECT_EQ(entry.geometry.x, 0);
-  EXPECT_EQ(entry.geometry.y, 0);
-  EXPECT_EQ(entry.geometry.scale, 0);
-  EXPECT_EQ(entry.geometry.orientation, 0);
+  EXPECT_EQ(entry.geometry.Decode().x, 0);
+  EXPECT_EQ(entry.geometry.Decode().y, 0);
+  EXPECT_EQ(entry.geometry.Decode().scale, 0);
+  EXPECT_EQ(entry.geometry.Decode().orientation, 0);
   EXPECT_EQ(entry.descriptor.size(), 10);
 }
 
@@ -50,10 +50,12 @@ TEST(InvertedFileEntry, ReadWrite) {
   InvertedFileEntry<10> entry;
   entry.image_id = 99;
   entry.feature_idx = 100;
-  entry.geometry.x = 0.123;
-  entry.geometry.y = 0.456;
-  entry.geometry.scale = 0.789;
-  entry.geometry.orientation = -0.1;
+  FeatureGeometry geometry;
+  geometry.x = 0.123;
+  geometry.y = 0.456;
+  geometry.scale = 0.789;
+  geometry.orientation = -0.1;
+  entry.geometry = CompactFeatureGeometry(geometry);
   for (size_t i = 0; i < entry.descriptor.size(); ++i) {
     entry.descriptor[i] = (i % 2) == 0;
   }
@@ -64,10 +66,11 @@ TEST(InvertedFileEntry, ReadWrite) {
   read_entry.Read(&file);
   EXPECT_EQ(entry.image_id, read_entry.image_id);
   EXPECT_EQ(entry.feature_idx, read_entry.feature_idx);
-  EXPECT_EQ(entry.geometry.x, read_entry.geometry.x);
-  EXPECT_EQ(entry.geometry.y, read_entry.geometry.y);
-  EXPECT_EQ(entry.geometry.scale, read_entry.geometry.scale);
-  EXPECT_EQ(entry.geometry.orientation, read_entry.geometry.orientation);
+  const FeatureGeometry read_geometry = read_entry.geometry.Decode();
+  EXPECT_EQ(entry.geometry.Decode().x, read_geometry.x);
+  EXPECT_EQ(entry.geometry.Decode().y, read_geometry.y);
+  EXPECT_EQ(entry.geometry.Decode().scale, read_geometry.scale);
+  EXPECT_EQ(entry.geometry.Decode().orientation, read_geometry.orientation);
   for (size_t i = 0; i < entry.descriptor.size(); ++i) {
     EXPECT_EQ(entry.descriptor[i], read_entry.descriptor[i]);
   }
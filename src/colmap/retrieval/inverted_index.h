@@ -32,11 +32,16 @@
 #include "colmap/math/random.h"
 #include "colmap/retrieval/inverted_file.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/mapped_file.h"
 
 #include <algorithm>
 #include <bitset>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -47,6 +52,54 @@
 namespace colmap {
 namespace retrieval {
 
+namespace internal {
+
+// Alignment of the arrays in memory-mapped visual indices.
+constexpr uint64_t kMappedAlignment = 64;
+
+// Pad the file to the next multiple of the alignment of mapped arrays.
+inline void WriteMappedPadding(std::ostream* stream) {
+  const uint64_t offset = stream->tellp();
+  const uint64_t num_padding_bytes =
+      (kMappedAlignment - offset % kMappedAlignment) % kMappedAlignment;
+  const char padding[kMappedAlignment] = {0};
+  stream->write(padding, num_padding_bytes);
+}
+
+// Check that an array of the given size fits into the mapped file and that it
+// starts at a multiple of the alignment.
+inline void CheckMappedArray(const MappedFile& mapped_file,
+                             const uint64_t offset,
+                             const uint64_t num_bytes) {
+  THROW_CHECK_EQ(offset % kMappedAlignment, 0)
+      << "Invalid visual index " << mapped_file.Path();
+  THROW_CHECK_LE(offset + num_bytes, mapped_file.NumBytes())
+      << "Truncated visual index " << mapped_file.Path();
+}
+
+// Header of the inverted index in memory-mapped visual indices. All offsets
+// are relative to the start of the file.
+struct MappedInvertedIndexHeader {
+  uint32_t num_words;
+  uint32_t desc_dim;
+  uint32_t embedding_dim;
+  uint32_t entry_size;
+  uint64_t num_entries;
+  uint64_t num_images;
+  uint64_t proj_matrix_offset;
+  uint64_t files_offset;
+  uint64_t entries_offset;
+  uint64_t codes_offset;
+  uint64_t normalization_constants_offset;
+};
+
+struct MappedNormalizationConstant {
+  int32_t image_id;
+  float value;
+};
+
+}  // namespace internal
+
 // Implements an inverted index system. The template parameter is the length of
 // the binary vectors in the Hamming Embedding.
 // This class is based on an original implementation by Torsten Sattler.
@@ -117,9 +170,32 @@ class InvertedIndex {
   void Read(std::ifstream* ifs);
   void Write(std::ofstream* ofs) const;
 
+  // Write the inverted index in the packed format at the current position of
+  // the file, which must be a multiple of the alignment of mapped arrays.
+  // The inverted files and their entries are written as contiguous arrays,
+  // such that the index can be used in-place after mapping the file.
+  void WritePacked(std::ostream* stream) const;
+
+  // Use the inverted index written by WritePacked at the given offset in-place
+  // from the mapped file. The mapped index is read-only and it is copied into
+  // memory on the first modification.
+  void Map(std::shared_ptr<const MappedFile> mapped_file, uint64_t offset);
+
+  // Whether the inverted files are used in-place from a mapped file.
+  bool IsMapped() const;
+
  private:
   void ComputeWeightsAndNormalizationConstants();
 
+  // Update the largest image identifier in the normalization constants.
+  void UpdateMaxImageId();
+
+  // View of the inverted file in memory or in the mapped file.
+  InvertedFileView<kEmbeddingDim> FileView(int word_id) const;
+
+  // Copy the inverted files from the mapped file into memory.
+  void Unmap();
+
   // The individual inverted indices.
   std::vector<InvertedFile<kEmbeddingDim>,
               Eigen::aligned_allocator<InvertedFile<kEmbeddingDim>>>
@@ -129,8 +205,19 @@ class InvertedIndex {
   // normalize the votes.
   std::unordered_map<int, float> normalization_constants_;
 
+  // The largest identifier of the images in the normalization constants.
+  int max_image_id_ = -1;
+
   // The projection matrix used to project SIFT descriptors.
   ProjMatrixType proj_matrix_;
+
+  // The packed inverted files and their entries, if the index is mapped.
+  std::shared_ptr<const MappedFile> mapped_file_;
+  const PackedInvertedFile<kEmbeddingDim>* packed_files_ = nullptr;
+  const EntryType* packed_entries_ = nullptr;
+  const uint64_t* packed_codes_ = nullptr;
+  int num_packed_files_ = 0;
+  uint64_t num_packed_entries_ = 0;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -149,6 +236,9 @@ InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::InvertedIndex() {
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 int InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::NumVisualWords() const {
+  if (IsMapped()) {
+    return num_packed_files_;
+  }
   return static_cast<int>(inverted_files_.size());
 }
 
@@ -156,6 +246,12 @@ template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Initialize(
     const int num_words) {
   THROW_CHECK_GT(num_words, 0);
+  mapped_file_.reset();
+  packed_files_ = nullptr;
+  packed_entries_ = nullptr;
+  packed_codes_ = nullptr;
+  num_packed_files_ = 0;
+  num_packed_entries_ = 0;
   inverted_files_.resize(num_words);
   for (auto& inverted_file : inverted_files_) {
     inverted_file.Reset();
@@ -166,6 +262,8 @@ template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Finalize() {
   THROW_CHECK_GT(NumVisualWords(), 0);
 
+  Unmap();
+
   for (auto& inverted_file : inverted_files_) {
     inverted_file.SortEntries();
   }
@@ -190,6 +288,8 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ComputeHammingEmbedding(
   THROW_CHECK_EQ(descriptors.rows(), word_ids.rows());
   THROW_CHECK_EQ(descriptors.cols(), kDescDim);
 
+  Unmap();
+
   // Skip every inverted file with less than kMinEntries entries.
   const size_t kMinEntries = 5;
 
@@ -227,6 +327,7 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::AddEntry(
     const DescType& descriptor,
     const GeomType& geometry) {
   THROW_CHECK_EQ(descriptor.size(), kDescDim);
+  Unmap();
   const ProjDescType proj_desc =
       proj_matrix_ * descriptor.transpose().template cast<float>();
   inverted_files_.at(word_id).AddEntry(
@@ -235,6 +336,7 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::AddEntry(
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ClearEntries() {
+  Unmap();
   for (auto& inverted_file : inverted_files_) {
     inverted_file.ClearEntries();
   }
@@ -256,33 +358,46 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     normalization_weight = 1.0f / std::sqrt(self_similarity);
   }
 
+  // The scores of the inverted files are accumulated per image. Image
+  // identifiers are usually dense, such that the position of an image in the
+  // scores is looked up in an array instead of a hash map.
+  const int64_t num_images = normalization_constants_.size();
+  const bool dense_image_ids = max_image_id_ < 4 * num_images + 1024;
+  std::vector<int> dense_score_idxs(dense_image_ids ? max_image_id_ + 1 : 0,
+                                    -1);
   std::unordered_map<int, int> score_map;
-  std::vector<ImageScore> inverted_file_scores;
+  const auto add_image_score = [&](const ImageScore& score) {
+    int* score_idx = nullptr;
+    if (score.image_id <= max_image_id_ && dense_image_ids) {
+      score_idx = &dense_score_idxs[score.image_id];
+    } else {
+      score_idx = &score_map.emplace(score.image_id, -1).first->second;
+    }
+    if (*score_idx == -1) {
+      // Image not found in another inverted file.
+      *score_idx = static_cast<int>(image_scores->size());
+      image_scores->push_back(score);
+    } else {
+      // Image already found in another inverted file, so accumulate.
+      (*image_scores)[*score_idx].score += score.score;
+    }
+  };
 
+  // Project all descriptors at once, which is much faster than projecting the
+  // descriptors one by one.
+  const Eigen::MatrixXf proj_descriptors =
+      proj_matrix_ * descriptors.transpose().template cast<float>();
+
+  ProjDescType proj_descriptor;
   for (typename DescType::Index i = 0; i < descriptors.rows(); ++i) {
-    const ProjDescType proj_descriptor =
-        proj_matrix_ * descriptors.row(i).transpose().template cast<float>();
+    proj_descriptor = proj_descriptors.col(i);
     for (Eigen::MatrixXi::Index n = 0; n < word_ids.cols(); ++n) {
       const int word_id = word_ids(i, n);
       if (word_id == kInvalidWordId) {
         continue;
       }
 
-      inverted_files_.at(word_id).ScoreFeature(proj_descriptor,
-                                               &inverted_file_scores);
-
-      for (const ImageScore& score : inverted_file_scores) {
-        const auto score_map_it = score_map.find(score.image_id);
-        if (score_map_it == score_map.end()) {
-          // Image not found in another inverted file.
-          score_map.emplace(score.image_id,
-                            static_cast<int>(image_scores->size()));
-          image_scores->push_back(score);
-        } else {
-          // Image already found in another inverted file, so accumulate.
-          (*image_scores).at(score_map_it->second).score += score.score;
-        }
-      }
+      FileView(word_id).ScoreFeature(proj_descriptor, add_image_score);
     }
   }
 
@@ -301,14 +416,13 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::
         std::bitset<kEmbeddingDim>* binary_descriptor) const {
   const ProjDescType proj_desc =
       proj_matrix_ * descriptor.transpose().template cast<float>();
-  inverted_files_.at(word_id).ConvertToBinaryDescriptor(proj_desc,
-                                                        binary_descriptor);
+  FileView(word_id).ConvertToBinaryDescriptor(proj_desc, binary_descriptor);
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 float InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::GetIDFWeight(
     const int word_id) const {
-  return inverted_files_.at(word_id).IDFWeight();
+  return FileView(word_id).idf_weight;
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -317,8 +431,7 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::FindMatches(
     const std::unordered_set<int>& image_ids,
     std::vector<const EntryType*>* matches) const {
   matches->clear();
-  const auto& entries = inverted_files_.at(word_id).GetEntries();
-  for (const auto& entry : entries) {
+  for (const auto& entry : FileView(word_id)) {
     if (image_ids.count(entry.image_id)) {
       matches->emplace_back(&entry);
     }
@@ -332,8 +445,8 @@ float InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ComputeSelfSimilarity(
   for (Eigen::MatrixXi::Index i = 0; i < word_ids.size(); ++i) {
     const int word_id = word_ids(i);
     if (word_id != kInvalidWordId) {
-      const auto& inverted_file = inverted_files_.at(word_id);
-      self_similarity += inverted_file.IDFWeight() * inverted_file.IDFWeight();
+      const float idf_weight = FileView(word_id).idf_weight;
+      self_similarity += idf_weight * idf_weight;
     }
   }
   return static_cast<float>(self_similarity);
@@ -342,8 +455,8 @@ float InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ComputeSelfSimilarity(
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::GetImageIds(
     std::unordered_set<int>* image_ids) const {
-  for (const auto& inverted_file : inverted_files_) {
-    inverted_file.GetImageIds(image_ids);
+  for (int word_id = 0; word_id < NumVisualWords(); ++word_id) {
+    FileView(word_id).GetImageIds(image_ids);
   }
 }
 
@@ -387,6 +500,8 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
     ifs->read(reinterpret_cast<char*>(&value), sizeof(float));
     normalization_constants_[image_id] = value;
   }
+
+  UpdateMaxImageId();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -408,8 +523,17 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
     }
   }
 
-  for (const auto& inverted_file : inverted_files_) {
-    inverted_file.Write(ofs);
+  if (IsMapped()) {
+    InvertedFile<kEmbeddingDim> inverted_file;
+    for (int word_id = 0; word_id < num_packed_files_; ++word_id) {
+      const InvertedFileView<kEmbeddingDim> view = FileView(word_id);
+      inverted_file.Unpack(packed_files_[word_id], view.entries, view.codes);
+      inverted_file.Write(ofs);
+    }
+  } else {
+    for (const auto& inverted_file : inverted_files_) {
+      inverted_file.Write(ofs);
+    }
   }
 
   const int32_t num_images = normalization_constants_.size();
@@ -421,6 +545,229 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
   }
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::WritePacked(
+    std::ostream* stream) const {
+  // The arrays are used in-place, so the file is always in native byte order.
+  static_assert(std::is_trivially_copyable<EntryType>::value,
+                "Entries must be trivially copyable");
+  THROW_CHECK(IsLittleEndian())
+      << "Mapped visual indices are only supported on little-endian platforms";
+  THROW_CHECK_GT(NumVisualWords(), 0);
+
+  const uint64_t header_offset = stream->tellp();
+  THROW_CHECK_EQ(header_offset % internal::kMappedAlignment, 0);
+
+  internal::MappedInvertedIndexHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.num_words = NumVisualWords();
+  header.desc_dim = kDescDim;
+  header.embedding_dim = kEmbeddingDim;
+  header.entry_size = sizeof(EntryType);
+  header.num_images = normalization_constants_.size();
+
+  // The header is rewritten once all offsets are known.
+  stream->write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  internal::WriteMappedPadding(stream);
+  header.proj_matrix_offset = stream->tellp();
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    for (int j = 0; j < kDescDim; ++j) {
+      const float value = proj_matrix_(i, j);
+      stream->write(reinterpret_cast<const char*>(&value), sizeof(float));
+    }
+  }
+
+  internal::WriteMappedPadding(stream);
+  header.files_offset = stream->tellp();
+  for (int word_id = 0; word_id < NumVisualWords(); ++word_id) {
+    const InvertedFileView<kEmbeddingDim> view = FileView(word_id);
+    PackedInvertedFile<kEmbeddingDim> packed_file;
+    if (IsMapped()) {
+      packed_file = packed_files_[word_id];
+    } else {
+      packed_file = inverted_files_[word_id].Pack(header.num_entries);
+    }
+    packed_file.entries_begin = header.num_entries;
+    stream->write(reinterpret_cast<const char*>(&packed_file),
+                  sizeof(packed_file));
+    header.num_entries += view.num_entries;
+  }
+
+  internal::WriteMappedPadding(stream);
+  header.entries_offset = stream->tellp();
+  for (int word_id = 0; word_id < NumVisualWords(); ++word_id) {
+    const InvertedFileView<kEmbeddingDim> view = FileView(word_id);
+    stream->write(reinterpret_cast<const char*>(view.entries),
+                  view.num_entries * sizeof(EntryType));
+  }
+
+  internal::WriteMappedPadding(stream);
+  header.codes_offset = stream->tellp();
+  for (int word_id = 0; word_id < NumVisualWords(); ++word_id) {
+    const InvertedFileView<kEmbeddingDim> view = FileView(word_id);
+    stream->write(reinterpret_cast<const char*>(view.codes),
+                  view.num_entries *
+                      InvertedFileView<kEmbeddingDim>::kNumCodeWords *
+                      sizeof(uint64_t));
+  }
+
+  // Sorted by image identifier for reproducible files.
+  std::vector<internal::MappedNormalizationConstant> normalization_constants;
+  normalization_constants.reserve(normalization_constants_.size());
+  for (const auto& constant : normalization_constants_) {
+    normalization_constants.push_back({constant.first, constant.second});
+  }
+  std::sort(normalization_constants.begin(),
+            normalization_constants.end(),
+            [](const internal::MappedNormalizationConstant& constant1,
+               const internal::MappedNormalizationConstant& constant2) {
+              return constant1.image_id < constant2.image_id;
+            });
+
+  internal::WriteMappedPadding(stream);
+  header.normalization_constants_offset = stream->tellp();
+  stream->write(reinterpret_cast<const char*>(normalization_constants.data()),
+                normalization_constants.size() *
+                    sizeof(internal::MappedNormalizationConstant));
+
+  const uint64_t end_offset = stream->tellp();
+  stream->seekp(header_offset);
+  stream->write(reinterpret_cast<const char*>(&header), sizeof(header));
+  stream->seekp(end_offset);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Map(
+    std::shared_ptr<const MappedFile> mapped_file, const uint64_t offset) {
+  THROW_CHECK_NOTNULL(mapped_file);
+  THROW_CHECK(IsLittleEndian())
+      << "Mapped visual indices are only supported on little-endian platforms";
+
+  const char* data = mapped_file->Data();
+
+  internal::CheckMappedArray(
+      *mapped_file, offset, sizeof(internal::MappedInvertedIndexHeader));
+  const auto* header =
+      reinterpret_cast<const internal::MappedInvertedIndexHeader*>(data +
+                                                                   offset);
+  THROW_CHECK_GT(header->num_words, 0);
+  THROW_CHECK_EQ(header->desc_dim, kDescDim)
+      << "The descriptor dimension should be " << kDescDim << " but is "
+      << header->desc_dim << ". The indices are not compatible!";
+  THROW_CHECK_EQ(header->embedding_dim, kEmbeddingDim)
+      << "The length of the binary strings should be " << kEmbeddingDim
+      << " but is " << header->embedding_dim
+      << ". The indices are not compatible!";
+  THROW_CHECK_EQ(header->entry_size, sizeof(EntryType))
+      << "The visual index was written on an incompatible platform";
+
+  internal::CheckMappedArray(*mapped_file,
+                             header->proj_matrix_offset,
+                             kEmbeddingDim * kDescDim * sizeof(float));
+  internal::CheckMappedArray(
+      *mapped_file,
+      header->files_offset,
+      header->num_words * sizeof(PackedInvertedFile<kEmbeddingDim>));
+  internal::CheckMappedArray(*mapped_file,
+                             header->entries_offset,
+                             header->num_entries * sizeof(EntryType));
+  internal::CheckMappedArray(
+      *mapped_file,
+      header->codes_offset,
+      header->num_entries * InvertedFileView<kEmbeddingDim>::kNumCodeWords *
+          sizeof(uint64_t));
+  internal::CheckMappedArray(
+      *mapped_file,
+      header->normalization_constants_offset,
+      header->num_images * sizeof(internal::MappedNormalizationConstant));
+
+  inverted_files_.clear();
+  inverted_files_.shrink_to_fit();
+
+  const float* proj_matrix_data =
+      reinterpret_cast<const float*>(data + header->proj_matrix_offset);
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    for (int j = 0; j < kDescDim; ++j) {
+      proj_matrix_(i, j) = proj_matrix_data[i * kDescDim + j];
+    }
+  }
+
+  const auto* normalization_constants =
+      reinterpret_cast<const internal::MappedNormalizationConstant*>(
+          data + header->normalization_constants_offset);
+  normalization_constants_.clear();
+  normalization_constants_.reserve(header->num_images);
+  for (uint64_t i = 0; i < header->num_images; ++i) {
+    normalization_constants_[normalization_constants[i].image_id] =
+        normalization_constants[i].value;
+  }
+  UpdateMaxImageId();
+
+  packed_files_ = reinterpret_cast<const PackedInvertedFile<kEmbeddingDim>*>(
+      data + header->files_offset);
+  packed_entries_ =
+      reinterpret_cast<const EntryType*>(data + header->entries_offset);
+  packed_codes_ =
+      reinterpret_cast<const uint64_t*>(data + header->codes_offset);
+  num_packed_files_ = header->num_words;
+  num_packed_entries_ = header->num_entries;
+  mapped_file_ = std::move(mapped_file);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+bool InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::IsMapped() const {
+  return mapped_file_ != nullptr;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+InvertedFileView<kEmbeddingDim>
+InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::FileView(
+    const int word_id) const {
+  if (!IsMapped()) {
+    return inverted_files_.at(word_id).View();
+  }
+
+  THROW_CHECK_GE(word_id, 0);
+  THROW_CHECK_LT(word_id, num_packed_files_);
+  const PackedInvertedFile<kEmbeddingDim>& packed_file = packed_files_[word_id];
+  THROW_CHECK_LE(packed_file.entries_begin + packed_file.num_entries,
+                 num_packed_entries_)
+      << "Invalid visual index " << mapped_file_->Path();
+
+  InvertedFileView<kEmbeddingDim> view;
+  view.usable = packed_file.status & InvertedFile<kEmbeddingDim>::USABLE;
+  view.idf_weight = packed_file.idf_weight;
+  view.thresholds = packed_file.thresholds;
+  view.entries = packed_entries_ + packed_file.entries_begin;
+  view.num_entries = packed_file.num_entries;
+  view.codes =
+      packed_codes_ + packed_file.entries_begin *
+                          InvertedFileView<kEmbeddingDim>::kNumCodeWords;
+  return view;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Unmap() {
+  if (!IsMapped()) {
+    return;
+  }
+
+  inverted_files_.resize(num_packed_files_);
+  for (int word_id = 0; word_id < num_packed_files_; ++word_id) {
+    const InvertedFileView<kEmbeddingDim> view = FileView(word_id);
+    inverted_files_[word_id].Unpack(
+        packed_files_[word_id], view.entries, view.codes);
+  }
+
+  mapped_file_.reset();
+  packed_files_ = nullptr;
+  packed_entries_ = nullptr;
+  packed_codes_ = nullptr;
+  num_packed_files_ = 0;
+  num_packed_entries_ = 0;
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::
     ComputeWeightsAndNormalizationConstants() {
@@ -446,6 +793,16 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::
       normalization_constants_[self_similarity.first] = 0.0f;
     }
   }
+
+  UpdateMaxImageId();
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::UpdateMaxImageId() {
+  max_image_id_ = -1;
+  for (const auto& constant : normalization_constants_) {
+    max_image_id_ = std::max(max_image_id_, constant.first);
+  }
 }
 
 }  // namespace retrieval
@@ -0,0 +1,160 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "colmap/retrieval/ivf_index.h"
+
+#include "colmap/retrieval/kmeans.h"
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace colmap {
+namespace retrieval {
+
+size_t IVFIndex::NumImages() const { return image_ids_.size(); }
+
+int IVFIndex::NumLists() const { return centroids_.rows(); }
+
+void IVFIndex::Build(const BuildOptions& options,
+                     const std::vector<int>& image_ids,
+                     const DescType& descriptors) {
+  THROW_CHECK_EQ(image_ids.size(), static_cast<size_t>(descriptors.rows()));
+  THROW_CHECK_GT(descriptors.rows(), 0);
+  THROW_CHECK_GT(descriptors.cols(), 0);
+
+  const int num_lists =
+      options.num_lists > 0
+          ? options.num_lists
+          : static_cast<int>(std::ceil(std::sqrt(descriptors.rows())));
+
+  if (num_lists == 1) {
+    centroids_ = descriptors.colwise().mean();
+  } else {
+    // A single level of the hierarchical k-means is a flat k-means.
+    HierarchicalKMeansOptions kmeans_options;
+    kmeans_options.num_clusters = num_lists;
+    kmeans_options.branching = num_lists;
+    kmeans_options.num_iterations = options.num_iterations;
+    kmeans_options.max_num_descriptors_per_cluster =
+        options.max_num_descriptors_per_list;
+    kmeans_options.num_threads = options.num_threads;
+    kmeans_options.random_seed = options.random_seed;
+    centroids_ =
+        HierarchicalKMeans<float, Eigen::Dynamic>(kmeans_options, descriptors);
+  }
+
+  // Assign each descriptor to the list with the nearest centroid.
+  const Eigen::VectorXf squared_centroid_norms =
+      centroids_.rowwise().squaredNorm();
+  const DescType dots = descriptors * centroids_.transpose();
+  std::vector<int> list_ids(descriptors.rows());
+  list_offsets_.assign(centroids_.rows() + 1, 0);
+  for (Eigen::Index i = 0; i < descriptors.rows(); ++i) {
+    Eigen::Index list_id;
+    (squared_centroid_norms - 2 * dots.row(i).transpose()).minCoeff(&list_id);
+    list_ids[i] = list_id;
+    list_offsets_[list_id + 1] += 1;
+  }
+  std::partial_sum(
+      list_offsets_.begin(), list_offsets_.end(), list_offsets_.begin());
+
+  std::vector<Eigen::Index> next_rows(list_offsets_.begin(),
+                                      list_offsets_.end() - 1);
+  descriptors_.resize(descriptors.rows(), descriptors.cols());
+  image_ids_.resize(image_ids.size());
+  for (Eigen::Index i = 0; i < descriptors.rows(); ++i) {
+    const Eigen::Index row = next_rows[list_ids[i]]++;
+    descriptors_.row(row) = descriptors.row(i);
+    image_ids_[row] = image_ids[i];
+  }
+}
+
+void IVFIndex::Query(const Eigen::VectorXf& descriptor,
+                     const int num_probes,
+                     const int max_num_images,
+                     std::vector<ImageScore>* image_scores) const {
+  THROW_CHECK_NOTNULL(image_scores);
+  THROW_CHECK_GT(num_probes, 0);
+  THROW_CHECK_EQ(descriptor.size(), centroids_.cols());
+
+  image_scores->clear();
+
+  // The lists with the nearest centroids in terms of L2 distance.
+  const Eigen::VectorXf list_dists =
+      centroids_.rowwise().squaredNorm() - 2 * centroids_ * descriptor;
+  std::vector<int> list_ids(centroids_.rows());
+  std::iota(list_ids.begin(), list_ids.end(), 0);
+  const size_t num_probed_lists =
+      std::min(list_ids.size(), static_cast<size_t>(num_probes));
+  std::partial_sort(list_ids.begin(),
+                    list_ids.begin() + num_probed_lists,
+                    list_ids.end(),
+                    [&list_dists](const int list_id1, const int list_id2) {
+                      return list_dists(list_id1) < list_dists(list_id2);
+                    });
+
+  for (size_t i = 0; i < num_probed_lists; ++i) {
+    const Eigen::Index begin = list_offsets_[list_ids[i]];
+    const Eigen::Index size = list_offsets_[list_ids[i] + 1] - begin;
+    if (size == 0) {
+      continue;
+    }
+    const Eigen::VectorXf scores =
+        descriptors_.middleRows(begin, size) * descriptor;
+    for (Eigen::Index j = 0; j < size; ++j) {
+      ImageScore image_score;
+      image_score.image_id = image_ids_[begin + j];
+      image_score.score = scores(j);
+      image_scores->push_back(image_score);
+    }
+  }
+
+  auto SortFunc = [](const ImageScore& score1, const ImageScore& score2) {
+    return score1.score > score2.score;
+  };
+
+  size_t num_images = image_scores->size();
+  if (max_num_images > 0) {
+    num_images = std::min(num_images, static_cast<size_t>(max_num_images));
+  }
+
+  if (num_images == image_scores->size()) {
+    std::sort(image_scores->begin(), image_scores->end(), SortFunc);
+  } else {
+    std::partial_sort(image_scores->begin(),
+                      image_scores->begin() + num_images,
+                      image_scores->end(),
+                      SortFunc);
+    image_scores->resize(num_images);
+  }
+}
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,107 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "colmap/retrieval/utils.h"
+#include "colmap/util/threading.h"
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace retrieval {
+
+// Inverted file index for the approximate nearest neighbor search of global
+// image descriptors by their inner product, as described in:
+//
+//    Jégou, Douze, Schmid. "Product quantization for nearest neighbor
+//    search". PAMI 2011.
+//
+// The descriptors are partitioned into lists by k-means clustering and a
+// query is only compared against the descriptors in the lists with the
+// most similar centroids. The descriptors are expected to be L2-normalized,
+// such that the inner product equals the cosine similarity.
+class IVFIndex {
+ public:
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      DescType;
+
+  struct BuildOptions {
+    // The number of lists, i.e. the number of k-means clusters of the
+    // descriptors. If not positive, the square root of the number of
+    // images is used.
+    int num_lists = -1;
+
+    // The number of iterations of the mini-batch k-means clustering.
+    int num_iterations = 5;
+
+    // The maximum number of training descriptors per list.
+    int max_num_descriptors_per_list = 64;
+
+    // The number of threads used in the clustering.
+    int num_threads = ThreadPool::kMaxNumThreads;
+
+    // The seed of the clustering, which is deterministic for a fixed seed.
+    unsigned random_seed = 0;
+  };
+
+  size_t NumImages() const;
+  int NumLists() const;
+
+  // Build the index over the descriptors of the given images, where each row
+  // of the descriptors matrix corresponds to one image.
+  void Build(const BuildOptions& options,
+             const std::vector<int>& image_ids,
+             const DescType& descriptors);
+
+  // Query for the most similar images in the num_probes lists with the most
+  // similar centroids. The image scores are sorted by decreasing similarity
+  // and contain at most max_num_images images, or all probed images, if
+  // max_num_images is not positive.
+  void Query(const Eigen::VectorXf& descriptor,
+             int num_probes,
+             int max_num_images,
+             std::vector<ImageScore>* image_scores) const;
+
+ private:
+  // The centroids of the lists.
+  DescType centroids_;
+
+  // The descriptors and image identifiers of all images, ordered by list.
+  DescType descriptors_;
+  std::vector<int> image_ids_;
+
+  // The rows of list i are in the range [list_offsets_[i],
+  // list_offsets_[i + 1]).
+  std::vector<Eigen::Index> list_offsets_;
+};
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,136 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "colmap/retrieval/ivf_index.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+IVFIndex::DescType CreateNormalizedDescriptors(const int num_descriptors,
+                                               const int num_dims) {
+  std::mt19937 prng(42);
+  std::normal_distribution<float> distribution;
+  IVFIndex::DescType descriptors(num_descriptors, num_dims);
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = distribution(prng);
+  }
+  descriptors.rowwise().normalize();
+  return descriptors;
+}
+
+std::vector<int> CreateImageIds(const int num_images) {
+  std::vector<int> image_ids(num_images);
+  std::iota(image_ids.begin(), image_ids.end(), 100);
+  return image_ids;
+}
+
+TEST(IVFIndex, ExhaustiveProbes) {
+  const IVFIndex::DescType descriptors = CreateNormalizedDescriptors(200, 16);
+  const std::vector<int> image_ids = CreateImageIds(200);
+  IVFIndex index;
+  IVFIndex::BuildOptions options;
+  options.num_lists = 8;
+  options.num_threads = 1;
+  index.Build(options, image_ids, descriptors);
+  EXPECT_EQ(index.NumImages(), 200);
+  EXPECT_EQ(index.NumLists(), 8);
+
+  // Probing all lists is equivalent to a brute-force search.
+  const Eigen::VectorXf query = descriptors.row(7);
+  const Eigen::VectorXf scores = descriptors * query;
+  std::vector<int> expected_rows(200);
+  std::iota(expected_rows.begin(), expected_rows.end(), 0);
+  std::sort(expected_rows.begin(),
+            expected_rows.end(),
+            [&scores](const int row1, const int row2) {
+              return scores(row1) > scores(row2);
+            });
+
+  std::vector<ImageScore> image_scores;
+  index.Query(query, /*num_probes=*/8, /*max_num_images=*/10, &image_scores);
+  ASSERT_EQ(image_scores.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(image_scores[i].image_id, image_ids[expected_rows[i]]);
+    EXPECT_NEAR(image_scores[i].score, scores(expected_rows[i]), 1e-5);
+  }
+
+  index.Query(query, /*num_probes=*/8, /*max_num_images=*/-1, &image_scores);
+  EXPECT_EQ(image_scores.size(), 200);
+}
+
+TEST(IVFIndex, SelfRetrieval) {
+  const IVFIndex::DescType descriptors = CreateNormalizedDescriptors(300, 16);
+  const std::vector<int> image_ids = CreateImageIds(300);
+  IVFIndex index;
+  IVFIndex::BuildOptions options;
+  index.Build(options, image_ids, descriptors);
+  EXPECT_EQ(index.NumLists(), 18);
+
+  // The list of a descriptor is always probed first.
+  std::vector<ImageScore> image_scores;
+  for (int i = 0; i < descriptors.rows(); ++i) {
+    index.Query(descriptors.row(i),
+                /*num_probes=*/1,
+                /*max_num_images=*/5,
+                &image_scores);
+    ASSERT_FALSE(image_scores.empty());
+    EXPECT_LE(image_scores.size(), 5);
+    EXPECT_EQ(image_scores[0].image_id, image_ids[i]);
+    EXPECT_NEAR(image_scores[0].score, 1, 1e-5);
+    for (size_t j = 1; j < image_scores.size(); ++j) {
+      EXPECT_LE(image_scores[j].score, image_scores[j - 1].score);
+    }
+  }
+}
+
+TEST(IVFIndex, SingleList) {
+  const IVFIndex::DescType descriptors = CreateNormalizedDescriptors(20, 8);
+  IVFIndex index;
+  IVFIndex::BuildOptions options;
+  options.num_lists = 1;
+  index.Build(options, CreateImageIds(20), descriptors);
+  EXPECT_EQ(index.NumLists(), 1);
+  std::vector<ImageScore> image_scores;
+  index.Query(descriptors.row(3),
+              /*num_probes=*/1,
+              /*max_num_images=*/-1,
+              &image_scores);
+  EXPECT_EQ(image_scores.size(), 20);
+  EXPECT_EQ(image_scores[0].image_id, 103);
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,419 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace retrieval {
+
+struct HierarchicalKMeansOptions {
+  // The desired number of leaf clusters. Note that the actual number of
+  // clusters might be less.
+  int num_clusters = 256 * 256;
+
+  // The branching factor of the hierarchical k-means tree.
+  int branching = 256;
+
+  // The number of passes of mini-batch updates over the training descriptors
+  // of each node.
+  int num_iterations = 11;
+
+  // The number of descriptors in each mini-batch update.
+  int batch_size = 4096;
+
+  // The maximum number of training descriptors per cluster of a node. Nodes
+  // with more descriptors are trained on a random subset, while all of their
+  // descriptors are assigned to the trained clusters.
+  int max_num_descriptors_per_cluster = 256;
+
+  // The number of threads for the clustering.
+  int num_threads = ThreadPool::kMaxNumThreads;
+
+  // The seed of the random number generator. The clustering only depends on
+  // the seed and not on the number of threads.
+  unsigned random_seed = 0;
+};
+
+// Hierarchical k-means clustering with mini-batch updates, as proposed in:
+//
+//    D. Sculley. Web-scale k-means clustering. WWW 2010.
+//
+// The tree is built level by level, where every node is split into branching
+// clusters until the desired number of leaf clusters is reached. The nodes of
+// the last level are split into fewer clusters in proportion to their number
+// of descriptors. Returns the centers of the leaf clusters.
+template <typename kDescType, int kDescDim>
+Eigen::Matrix<float, Eigen::Dynamic, kDescDim, Eigen::RowMajor>
+HierarchicalKMeans(
+    const HierarchicalKMeansOptions& options,
+    const Eigen::Matrix<kDescType, Eigen::Dynamic, kDescDim, Eigen::RowMajor>&
+        descriptors);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+namespace internal {
+
+template <int kDescDim>
+using KMeansCenters =
+    Eigen::Matrix<float, Eigen::Dynamic, kDescDim, Eigen::RowMajor>;
+
+// Minimum number of items per parallel chunk to avoid the scheduling overhead
+// for small problems.
+const size_t kMinKMeansChunkSize = 256;
+
+// Assigns the descriptors with the given indices to their nearest centers.
+// The distances are computed as ||c||^2 - 2 x^T c through matrix products on
+// blocks of descriptors, where the constant ||x||^2 is omitted.
+template <typename kDescType, int kDescDim>
+void FindNearestKMeansCenters(
+    const Eigen::Matrix<kDescType, Eigen::Dynamic, kDescDim, Eigen::RowMajor>&
+        descriptors,
+    const uint32_t* indices,
+    const size_t num_indices,
+    const KMeansCenters<kDescDim>& centers,
+    ThreadPool* thread_pool,
+    int* nearest_centers) {
+  const Eigen::VectorXf squared_center_norms =
+      centers.rowwise().squaredNorm();
+
+  auto FindNearest = [&](const size_t begin, const size_t end) {
+    const size_t kBlockSize = 256;
+    KMeansCenters<kDescDim> block;
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> dots;
+    for (size_t block_begin = begin; block_begin < end;
+         block_begin += kBlockSize) {
+      const size_t block_size = std::min(kBlockSize, end - block_begin);
+      block.resize(block_size, descriptors.cols());
+      for (size_t i = 0; i < block_size; ++i) {
+        block.row(i) =
+            descriptors.row(indices[block_begin + i]).template cast<float>();
+      }
+      dots.noalias() = block * centers.transpose();
+      for (size_t i = 0; i < block_size; ++i) {
+        int nearest_center = 0;
+        float min_dist = std::numeric_limits<float>::max();
+        for (Eigen::Index c = 0; c < centers.rows(); ++c) {
+          const float dist = squared_center_norms(c) - 2 * dots(i, c);
+          if (dist < min_dist) {
+            min_dist = dist;
+            nearest_center = c;
+          }
+        }
+        nearest_centers[block_begin + i] = nearest_center;
+      }
+    }
+  };
+
+  ParallelForChunks(
+      thread_pool, num_indices, kMinKMeansChunkSize, FindNearest);
+}
+
+// Splits the descriptors of a node into at most num_clusters clusters. The
+// clusters are initialized with k-means++ on a random subset of the node's
+// descriptors and then refined with mini-batch updates on the same subset.
+// Finally, all descriptors of the node are assigned to their nearest cluster
+// and the cluster centers are set to the mean of their descriptors. Empty
+// clusters are discarded.
+template <typename kDescType, int kDescDim>
+void SplitKMeansNode(
+    const HierarchicalKMeansOptions& options,
+    const Eigen::Matrix<kDescType, Eigen::Dynamic, kDescDim, Eigen::RowMajor>&
+        descriptors,
+    const std::vector<uint32_t>& indices,
+    const int num_clusters,
+    std::mt19937* prng,
+    ThreadPool* thread_pool,
+    KMeansCenters<kDescDim>* centers,
+    std::vector<std::vector<uint32_t>>* cluster_indices) {
+  const Eigen::Index num_dims = descriptors.cols();
+
+  // Draw the random subset of training descriptors.
+  std::vector<uint32_t> sample_indices = indices;
+  const size_t max_num_samples =
+      static_cast<size_t>(num_clusters) *
+      static_cast<size_t>(options.max_num_descriptors_per_cluster);
+  const size_t num_samples = std::min(indices.size(), max_num_samples);
+  for (size_t i = 0; i < num_samples; ++i) {
+    std::uniform_int_distribution<size_t> distribution(
+        i, sample_indices.size() - 1);
+    std::swap(sample_indices[i], sample_indices[distribution(*prng)]);
+  }
+  sample_indices.resize(num_samples);
+
+  KMeansCenters<kDescDim> samples(num_samples, num_dims);
+  for (size_t i = 0; i < num_samples; ++i) {
+    samples.row(i) =
+        descriptors.row(sample_indices[i]).template cast<float>();
+  }
+
+  // k-means++ initialization, which stops early if there are fewer distinct
+  // descriptors than clusters.
+  centers->resize(num_clusters, num_dims);
+  std::vector<float> min_dists(num_samples, std::numeric_limits<float>::max());
+  std::uniform_int_distribution<size_t> sample_distribution(0,
+                                                            num_samples - 1);
+  centers->row(0) = samples.row(sample_distribution(*prng));
+  int num_centers = 1;
+  while (num_centers < num_clusters) {
+    auto UpdateMinDists = [&](const size_t begin, const size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        min_dists[i] = std::min(
+            min_dists[i],
+            (samples.row(i) - centers->row(num_centers - 1)).squaredNorm());
+      }
+    };
+    ParallelForChunks(
+        thread_pool, num_samples, kMinKMeansChunkSize, UpdateMinDists);
+
+    const double sum_min_dists =
+        std::accumulate(min_dists.begin(), min_dists.end(), 0.0);
+    if (sum_min_dists <= 0) {
+      break;
+    }
+
+    const double threshold =
+        std::uniform_real_distribution<double>(0, sum_min_dists)(*prng);
+    double cumulative_min_dist = 0;
+    size_t next_center_idx = num_samples - 1;
+    for (size_t i = 0; i < num_samples; ++i) {
+      cumulative_min_dist += min_dists[i];
+      if (cumulative_min_dist >= threshold && min_dists[i] > 0) {
+        next_center_idx = i;
+        break;
+      }
+    }
+    centers->row(num_centers) = samples.row(next_center_idx);
+    num_centers += 1;
+  }
+  centers->conservativeResize(num_centers, num_dims);
+
+  // Mini-batch updates with a per-center learning rate, which decreases with
+  // the number of descriptors assigned to the center so far.
+  if (num_centers > 1) {
+    const size_t batch_size =
+        std::min(num_samples, static_cast<size_t>(options.batch_size));
+    const size_t num_batches =
+        options.num_iterations *
+        ((num_samples + batch_size - 1) / batch_size);
+    std::vector<uint32_t> batch_indices(batch_size);
+    std::vector<int> nearest_centers(batch_size);
+    std::vector<int> center_counts(num_centers, 0);
+    for (size_t batch = 0; batch < num_batches; ++batch) {
+      for (size_t i = 0; i < batch_size; ++i) {
+        batch_indices[i] = sample_distribution(*prng);
+      }
+      FindNearestKMeansCenters(samples,
+                               batch_indices.data(),
+                               batch_size,
+                               *centers,
+                               thread_pool,
+                               nearest_centers.data());
+      for (size_t i = 0; i < batch_size; ++i) {
+        const int center_idx = nearest_centers[i];
+        center_counts[center_idx] += 1;
+        const float learning_rate = 1.0f / center_counts[center_idx];
+        centers->row(center_idx) +=
+            learning_rate *
+            (samples.row(batch_indices[i]) - centers->row(center_idx));
+      }
+    }
+  }
+
+  // Assign all descriptors of the node and recompute the centers.
+  std::vector<int> nearest_centers(indices.size());
+  FindNearestKMeansCenters(descriptors,
+                           indices.data(),
+                           indices.size(),
+                           *centers,
+                           thread_pool,
+                           nearest_centers.data());
+
+  Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> sums(
+      num_centers, num_dims);
+  sums.setZero();
+  std::vector<std::vector<uint32_t>> center_indices(num_centers);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    sums.row(nearest_centers[i]) +=
+        descriptors.row(indices[i]).template cast<double>();
+    center_indices[nearest_centers[i]].push_back(indices[i]);
+  }
+
+  cluster_indices->clear();
+  int num_non_empty_centers = 0;
+  for (int c = 0; c < num_centers; ++c) {
+    if (center_indices[c].empty()) {
+      continue;
+    }
+    centers->row(num_non_empty_centers) =
+        (sums.row(c) / center_indices[c].size()).template cast<float>();
+    cluster_indices->push_back(std::move(center_indices[c]));
+    num_non_empty_centers += 1;
+  }
+  centers->conservativeResize(num_non_empty_centers, num_dims);
+}
+
+}  // namespace internal
+
+template <typename kDescType, int kDescDim>
+Eigen::Matrix<float, Eigen::Dynamic, kDescDim, Eigen::RowMajor>
+HierarchicalKMeans(
+    const HierarchicalKMeansOptions& options,
+    const Eigen::Matrix<kDescType, Eigen::Dynamic, kDescDim, Eigen::RowMajor>&
+        descriptors) {
+  THROW_CHECK_GT(options.num_clusters, 0);
+  THROW_CHECK_GT(options.branching, 1);
+  THROW_CHECK_GT(options.num_iterations, 0);
+  THROW_CHECK_GT(options.batch_size, 0);
+  THROW_CHECK_GT(options.max_num_descriptors_per_cluster, 0);
+  THROW_CHECK_GT(descriptors.rows(), 0);
+  THROW_CHECK_LE(descriptors.rows(), std::numeric_limits<uint32_t>::max());
+
+  ThreadPool thread_pool(GetEffectiveNumThreads(options.num_threads));
+
+  // The nodes of the current level of the tree, starting with the root node.
+  std::vector<std::vector<uint32_t>> node_indices(1);
+  node_indices[0].resize(descriptors.rows());
+  std::iota(node_indices[0].begin(), node_indices[0].end(), 0);
+  internal::KMeansCenters<kDescDim> node_centers =
+      descriptors.template cast<float>().colwise().mean();
+
+  for (int level = 0;; ++level) {
+    const size_t num_nodes = node_indices.size();
+    const bool last_level =
+        num_nodes * options.branching >=
+        static_cast<size_t>(options.num_clusters);
+
+    // The number of clusters per node, which cannot exceed the branching
+    // factor and the number of descriptors of the node.
+    std::vector<int> num_node_clusters(num_nodes);
+    size_t num_clusters = 0;
+    for (size_t i = 0; i < num_nodes; ++i) {
+      const size_t num_node_descriptors = node_indices[i].size();
+      size_t num_clusters_i = options.branching;
+      if (last_level) {
+        num_clusters_i = std::min(num_clusters_i,
+                                  options.num_clusters * num_node_descriptors /
+                                      descriptors.rows());
+      }
+      num_node_clusters[i] = std::max<size_t>(
+          1, std::min(num_clusters_i, num_node_descriptors));
+      num_clusters += num_node_clusters[i];
+    }
+
+    if (num_clusters == num_nodes) {
+      break;
+    }
+
+    // Nodes are split in parallel, unless there are too few of them, in which
+    // case each node is split in parallel. Every node uses its own random
+    // number generator, so the result does not depend on the scheduling.
+    std::vector<internal::KMeansCenters<kDescDim>> cluster_centers(num_nodes);
+    std::vector<std::vector<std::vector<uint32_t>>> cluster_indices(num_nodes);
+    const bool parallel_nodes = num_nodes >= thread_pool.NumThreads();
+    auto SplitNode = [&](const size_t node_idx) {
+      if (num_node_clusters[node_idx] == 1) {
+        cluster_centers[node_idx] = node_centers.row(node_idx);
+        cluster_indices[node_idx].push_back(std::move(node_indices[node_idx]));
+        return;
+      }
+      std::seed_seq seed{options.random_seed,
+                         static_cast<unsigned>(level),
+                         static_cast<unsigned>(node_idx)};
+      std::mt19937 prng(seed);
+      internal::SplitKMeansNode(options,
+                                descriptors,
+                                node_indices[node_idx],
+                                num_node_clusters[node_idx],
+                                &prng,
+                                parallel_nodes ? nullptr : &thread_pool,
+                                &cluster_centers[node_idx],
+                                &cluster_indices[node_idx]);
+      node_indices[node_idx] = std::vector<uint32_t>();
+    };
+
+    if (parallel_nodes) {
+      std::vector<std::future<void>> futures;
+      futures.reserve(num_nodes);
+      for (size_t node_idx = 0; node_idx < num_nodes; ++node_idx) {
+        futures.push_back(thread_pool.AddTask(SplitNode, node_idx));
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    } else {
+      for (size_t node_idx = 0; node_idx < num_nodes; ++node_idx) {
+        SplitNode(node_idx);
+      }
+    }
+
+    // The clusters become the nodes of the next level.
+    size_t num_next_nodes = 0;
+    for (const auto& centers : cluster_centers) {
+      num_next_nodes += centers.rows();
+    }
+    node_centers.resize(num_next_nodes, descriptors.cols());
+    node_indices.clear();
+    node_indices.reserve(num_next_nodes);
+    for (size_t node_idx = 0; node_idx < num_nodes; ++node_idx) {
+      node_centers.middleRows(node_indices.size(),
+                              cluster_centers[node_idx].rows()) =
+          cluster_centers[node_idx];
+      for (auto& indices : cluster_indices[node_idx]) {
+        node_indices.push_back(std::move(indices));
+      }
+    }
+
+    // Stop if no node could be split, because the descriptors of every node
+    // are identical.
+    if (last_level || node_indices.size() == num_nodes) {
+      break;
+    }
+  }
+
+  return node_centers;
+}
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,141 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/kmeans.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, 32, Eigen::RowMajor> DescType;
+
+// Creates descriptors around well separated random blob centers, which are
+// grouped around a smaller number of even further separated group centers.
+DescType CreateBlobDescriptors(const int num_groups,
+                               const int num_blobs_per_group,
+                               const int num_descriptors_per_blob,
+                               DescType* blob_centers) {
+  std::mt19937 prng(42);
+  std::uniform_int_distribution<int> group_distribution(32, 223);
+  std::uniform_int_distribution<int> blob_distribution(-24, 24);
+  std::uniform_int_distribution<int> noise_distribution(-2, 2);
+  const int num_blobs = num_groups * num_blobs_per_group;
+  blob_centers->resize(num_blobs, 32);
+  for (int i = 0; i < num_groups; ++i) {
+    for (int j = 0; j < 32; ++j) {
+      const int group_center = group_distribution(prng);
+      for (int k = 0; k < num_blobs_per_group; ++k) {
+        (*blob_centers)(i * num_blobs_per_group + k, j) =
+            static_cast<uint8_t>(group_center + blob_distribution(prng));
+      }
+    }
+  }
+  DescType descriptors(num_blobs * num_descriptors_per_blob, 32);
+  for (int i = 0; i < descriptors.rows(); ++i) {
+    for (int j = 0; j < descriptors.cols(); ++j) {
+      const int value =
+          (*blob_centers)(i % num_blobs, j) + noise_distribution(prng);
+      descriptors(i, j) = static_cast<uint8_t>(std::clamp(value, 0, 255));
+    }
+  }
+  return descriptors;
+}
+
+TEST(HierarchicalKMeans, Nominal) {
+  DescType blob_centers;
+  const DescType descriptors =
+      CreateBlobDescriptors(/*num_groups=*/4,
+                            /*num_blobs_per_group=*/4,
+                            /*num_descriptors_per_blob=*/100,
+                            &blob_centers);
+  HierarchicalKMeansOptions options;
+  options.num_clusters = 16;
+  options.branching = 4;
+  options.batch_size = 64;
+  const Eigen::Matrix<float, Eigen::Dynamic, 32, Eigen::RowMajor> centers =
+      HierarchicalKMeans(options, descriptors);
+  EXPECT_EQ(centers.rows(), 16);
+  EXPECT_EQ(centers.cols(), 32);
+
+  // Every blob is recovered by exactly one cluster.
+  std::vector<int> num_blob_clusters(blob_centers.rows(), 0);
+  for (int i = 0; i < centers.rows(); ++i) {
+    Eigen::Index nearest_blob;
+    const float min_dist = (blob_centers.cast<float>().rowwise() -
+                            centers.row(i))
+                               .rowwise()
+                               .norm()
+                               .minCoeff(&nearest_blob);
+    EXPECT_LT(min_dist, 5);
+    num_blob_clusters[nearest_blob] += 1;
+  }
+  for (const int num_clusters : num_blob_clusters) {
+    EXPECT_EQ(num_clusters, 1);
+  }
+}
+
+TEST(HierarchicalKMeans, IndependentOfNumThreads) {
+  DescType blob_centers;
+  const DescType descriptors =
+      CreateBlobDescriptors(/*num_groups=*/10,
+                            /*num_blobs_per_group=*/5,
+                            /*num_descriptors_per_blob=*/40,
+                            &blob_centers);
+  HierarchicalKMeansOptions options;
+  options.num_clusters = 100;
+  options.branching = 10;
+  options.batch_size = 128;
+  options.max_num_descriptors_per_cluster = 16;
+  options.num_threads = 1;
+  const auto centers1 = HierarchicalKMeans(options, descriptors);
+  options.num_threads = 4;
+  const auto centers4 = HierarchicalKMeans(options, descriptors);
+  EXPECT_GT(centers1.rows(), 50);
+  EXPECT_LE(centers1.rows(), 100);
+  EXPECT_EQ(centers1, centers4);
+}
+
+TEST(HierarchicalKMeans, IdenticalDescriptors) {
+  DescType descriptors(100, 32);
+  descriptors.setConstant(7);
+  HierarchicalKMeansOptions options;
+  options.num_clusters = 16;
+  options.branching = 4;
+  const auto centers = HierarchicalKMeans(options, descriptors);
+  ASSERT_EQ(centers.rows(), 1);
+  EXPECT_EQ(centers, descriptors.topRows(1).cast<float>());
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,251 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include "colmap/retrieval/utils.h"
+#include "colmap/retrieval/visual_index.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace colmap {
+namespace retrieval {
+
+// The shard of an image, if the images are split into shards of consecutive
+// image identifier ranges with num_images_per_shard identifiers each.
+inline int ImageIdToShardIdx(const int image_id,
+                             const int num_images_per_shard) {
+  THROW_CHECK_GE(image_id, 0);
+  THROW_CHECK_GT(num_images_per_shard, 0);
+  return image_id / num_images_per_shard;
+}
+
+// Merge the image scores of multiple shards into the most similar images of
+// all shards sorted by decreasing score. All images are kept, if
+// max_num_images is negative. This can also be used to merge the results of
+// shards that were queried in different processes or on different machines.
+inline void MergeImageScores(
+    const std::vector<std::vector<ImageScore>>& shard_image_scores,
+    const int max_num_images,
+    std::vector<ImageScore>* image_scores) {
+  THROW_CHECK_NOTNULL(image_scores);
+
+  image_scores->clear();
+  for (const auto& scores : shard_image_scores) {
+    image_scores->insert(image_scores->end(), scores.begin(), scores.end());
+  }
+
+  auto SortFunc = [](const ImageScore& score1, const ImageScore& score2) {
+    return score1.score > score2.score;
+  };
+
+  size_t num_images = image_scores->size();
+  if (max_num_images >= 0) {
+    num_images = std::min<size_t>(image_scores->size(), max_num_images);
+  }
+
+  if (num_images == image_scores->size()) {
+    std::sort(image_scores->begin(), image_scores->end(), SortFunc);
+  } else {
+    std::partial_sort(image_scores->begin(),
+                      image_scores->begin() + num_images,
+                      image_scores->end(),
+                      SortFunc);
+    image_scores->resize(num_images);
+  }
+}
+
+// Visual index that is split into multiple shards with disjoint sets of
+// images, e.g. by image identifier range, such that the individual shards
+// can be built, stored, and memory-mapped independently of each other. The
+// visual words of a query are found once and then all shards are queried
+// independently before their image scores are merged.
+//
+// All shards must be built from the same vocabulary tree, so that they share
+// the visual words and the Hamming embedding. Each shard weights the visual
+// words by the inverse document frequency of its own images, which closely
+// approximates the weights of a single index, if the shards have many images
+// of similar content.
+template <typename kDescType = uint8_t,
+          int kDescDim = 128,
+          int kEmbeddingDim = 64>
+class ShardedVisualIndex {
+ public:
+  static const int kMaxNumThreads = -1;
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+  typedef typename VisualIndexType::QueryOptions QueryOptions;
+  typedef typename VisualIndexType::GeomType GeomType;
+  typedef typename VisualIndexType::DescType DescType;
+
+  // The shards of a query are queried in parallel with the given number of
+  // threads. If the index is queried from multiple threads, a single thread
+  // usually suffices.
+  explicit ShardedVisualIndex(int num_threads = 1);
+
+  size_t NumShards() const;
+
+  // Add a prepared shard to the index. The shard must not be modified while
+  // the index is queried.
+  void AddShard(std::shared_ptr<const VisualIndexType> shard);
+
+  const VisualIndexType& Shard(size_t shard_idx) const;
+
+  // Check if an image has been indexed in any of the shards.
+  bool ImageIndexed(int image_id) const;
+
+  // Query for most similar images in all shards. Each shard retrieves and
+  // verifies its own most similar images according to the query options,
+  // before the results of the shards are merged.
+  void Query(const QueryOptions& options,
+             const DescType& descriptors,
+             std::vector<ImageScore>* image_scores) const;
+  void Query(const QueryOptions& options,
+             const GeomType& geometries,
+             const DescType& descriptors,
+             std::vector<ImageScore>* image_scores) const;
+
+ private:
+  std::vector<std::shared_ptr<const VisualIndexType>> shards_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::ShardedVisualIndex(
+    const int num_threads) {
+  if (GetEffectiveNumThreads(num_threads) > 1) {
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads);
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+size_t ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::NumShards()
+    const {
+  return shards_.size();
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::AddShard(
+    std::shared_ptr<const VisualIndexType> shard) {
+  THROW_CHECK_NOTNULL(shard);
+  if (!shards_.empty()) {
+    THROW_CHECK_EQ(shard->NumVisualWords(), shards_[0]->NumVisualWords())
+        << "All shards must be built from the same vocabulary tree";
+  }
+  shards_.push_back(std::move(shard));
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+const typename ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::
+    VisualIndexType&
+    ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::Shard(
+        const size_t shard_idx) const {
+  return *shards_.at(shard_idx);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+bool ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::ImageIndexed(
+    const int image_id) const {
+  for (const auto& shard : shards_) {
+    if (shard->ImageIndexed(image_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
+    const QueryOptions& options,
+    const DescType& descriptors,
+    std::vector<ImageScore>* image_scores) const {
+  const GeomType geometries;
+  Query(options, geometries, descriptors, image_scores);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void ShardedVisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
+    const QueryOptions& options,
+    const GeomType& geometries,
+    const DescType& descriptors,
+    std::vector<ImageScore>* image_scores) const {
+  THROW_CHECK_NOTNULL(image_scores);
+  THROW_CHECK(!shards_.empty());
+
+  if (descriptors.rows() == 0) {
+    image_scores->clear();
+    return;
+  }
+
+  // The shards share the vocabulary, so the visual words are only found once.
+  const Eigen::MatrixXi word_ids =
+      shards_[0]->FindWordIds(descriptors,
+                              options.num_neighbors,
+                              options.num_checks,
+                              options.num_threads);
+
+  std::vector<std::vector<ImageScore>> shard_image_scores(shards_.size());
+  auto QueryShard = [&](const size_t shard_idx) {
+    shards_[shard_idx]->Query(options,
+                              geometries,
+                              descriptors,
+                              word_ids,
+                              &shard_image_scores[shard_idx]);
+  };
+
+  if (thread_pool_ != nullptr && shards_.size() > 1) {
+    std::vector<std::future<void>> futures;
+    futures.reserve(shards_.size());
+    for (size_t shard_idx = 0; shard_idx < shards_.size(); ++shard_idx) {
+      futures.push_back(thread_pool_->AddTask(QueryShard, shard_idx));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  } else {
+    for (size_t shard_idx = 0; shard_idx < shards_.size(); ++shard_idx) {
+      QueryShard(shard_idx);
+    }
+  }
+
+  const int max_num_images = options.num_images_after_verification > 0
+                                 ? options.num_images_after_verification
+                                 : options.max_num_images;
+  MergeImageScores(shard_image_scores, max_num_images, image_scores);
+}
+
+}  // namespace retrieval
+}  // namespace colmap
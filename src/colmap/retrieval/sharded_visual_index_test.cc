@@ -0,0 +1,171 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "colmap/retrieval/sharded_visual_index.h"
+
+#include "colmap/math/random.h"
+#include "colmap/util/testing.h"
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+typedef VisualIndex<uint8_t, 32, 16> VisualIndexType;
+typedef ShardedVisualIndex<uint8_t, 32, 16> ShardedVisualIndexType;
+
+TEST(ImageIdToShardIdx, Nominal) {
+  EXPECT_EQ(ImageIdToShardIdx(0, 10), 0);
+  EXPECT_EQ(ImageIdToShardIdx(9, 10), 0);
+  EXPECT_EQ(ImageIdToShardIdx(10, 10), 1);
+  EXPECT_EQ(ImageIdToShardIdx(25, 10), 2);
+}
+
+TEST(MergeImageScores, Nominal) {
+  std::vector<std::vector<ImageScore>> shard_image_scores(3);
+  shard_image_scores[0] = {{1, 0.5f}, {2, 0.1f}};
+  shard_image_scores[2] = {{3, 0.7f}, {4, 0.3f}};
+  std::vector<ImageScore> image_scores;
+  MergeImageScores(shard_image_scores, /*max_num_images=*/-1, &image_scores);
+  ASSERT_EQ(image_scores.size(), 4);
+  EXPECT_EQ(image_scores[0].image_id, 3);
+  EXPECT_EQ(image_scores[1].image_id, 1);
+  EXPECT_EQ(image_scores[2].image_id, 4);
+  EXPECT_EQ(image_scores[3].image_id, 2);
+  MergeImageScores(shard_image_scores, /*max_num_images=*/2, &image_scores);
+  ASSERT_EQ(image_scores.size(), 2);
+  EXPECT_EQ(image_scores[0].image_id, 3);
+  EXPECT_EQ(image_scores[1].image_id, 1);
+  MergeImageScores({}, /*max_num_images=*/2, &image_scores);
+  EXPECT_TRUE(image_scores.empty());
+}
+
+TEST(ShardedVisualIndex, Nominal) {
+  SetPRNGSeed(0);
+
+  // All shards are created from the same vocabulary tree.
+  VisualIndexType vocab_tree;
+  VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+  vocab_tree.Build(build_options, VisualIndexType::DescType::Random(1000, 32));
+  const std::string vocab_tree_path = CreateTestDir() + "/vocab_tree.bin";
+  vocab_tree.Write(vocab_tree_path);
+
+  const int kNumImages = 6;
+  const int kNumImagesPerShard = 2;
+  std::vector<VisualIndexType::DescType> descriptors;
+  std::vector<std::shared_ptr<VisualIndexType>> shards;
+  for (int image_id = 0; image_id < kNumImages; ++image_id) {
+    descriptors.push_back(VisualIndexType::DescType::Random(50, 32));
+    const int shard_idx = ImageIdToShardIdx(image_id, kNumImagesPerShard);
+    if (shard_idx == static_cast<int>(shards.size())) {
+      shards.push_back(std::make_shared<VisualIndexType>());
+      shards.back()->Read(vocab_tree_path);
+    }
+    shards[shard_idx]->Add(VisualIndexType::IndexOptions(),
+                           image_id,
+                           VisualIndexType::GeomType(50),
+                           descriptors.back());
+  }
+
+  ShardedVisualIndexType sharded_index(/*num_threads=*/2);
+  EXPECT_EQ(sharded_index.NumShards(), 0);
+  for (auto& shard : shards) {
+    shard->Prepare();
+    sharded_index.AddShard(shard);
+  }
+  EXPECT_EQ(sharded_index.NumShards(), 3);
+  EXPECT_EQ(&sharded_index.Shard(1), shards[1].get());
+  for (int image_id = 0; image_id < kNumImages; ++image_id) {
+    EXPECT_TRUE(sharded_index.ImageIndexed(image_id));
+  }
+  EXPECT_FALSE(sharded_index.ImageIndexed(kNumImages));
+
+  VisualIndexType::QueryOptions query_options;
+  std::vector<ImageScore> image_scores;
+  for (int image_id = 0; image_id < kNumImages; ++image_id) {
+    sharded_index.Query(query_options, descriptors[image_id], &image_scores);
+    ASSERT_EQ(image_scores.size(), kNumImages);
+    for (size_t i = 1; i < image_scores.size(); ++i) {
+      EXPECT_GE(image_scores[i - 1].score, image_scores[i].score);
+    }
+
+    // The merged scores are the scores of the individual shards.
+    for (const auto& shard : shards) {
+      std::vector<ImageScore> shard_image_scores;
+      shard->Query(query_options, descriptors[image_id], &shard_image_scores);
+      ASSERT_EQ(shard_image_scores.size(), kNumImagesPerShard);
+      for (const auto& shard_image_score : shard_image_scores) {
+        const auto it =
+            std::find_if(image_scores.begin(),
+                         image_scores.end(),
+                         [&](const ImageScore& image_score) {
+                           return image_score.image_id ==
+                                  shard_image_score.image_id;
+                         });
+        ASSERT_NE(it, image_scores.end());
+        EXPECT_EQ(it->score, shard_image_score.score);
+      }
+    }
+  }
+
+  const std::vector<ImageScore> all_image_scores = image_scores;
+  query_options.max_num_images = 2;
+  sharded_index.Query(
+      query_options, descriptors[kNumImages - 1], &image_scores);
+  ASSERT_EQ(image_scores.size(), 2);
+  EXPECT_EQ(image_scores[0].image_id, all_image_scores[0].image_id);
+  EXPECT_EQ(image_scores[1].image_id, all_image_scores[1].image_id);
+
+  sharded_index.Query(
+      query_options, VisualIndexType::DescType(0, 32), &image_scores);
+  EXPECT_TRUE(image_scores.empty());
+}
+
+TEST(ShardedVisualIndex, DifferentVocabularies) {
+  SetPRNGSeed(0);
+  VisualIndexType::BuildOptions build_options;
+  build_options.branching = 5;
+  auto shard1 = std::make_shared<VisualIndexType>();
+  build_options.num_visual_words = 5;
+  shard1->Build(build_options, VisualIndexType::DescType::Random(50, 32));
+  auto shard2 = std::make_shared<VisualIndexType>();
+  build_options.num_visual_words = 10;
+  shard2->Build(build_options, VisualIndexType::DescType::Random(50, 32));
+  ShardedVisualIndexType sharded_index;
+  sharded_index.AddShard(shard1);
+  EXPECT_ANY_THROW(sharded_index.AddShard(shard2));
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
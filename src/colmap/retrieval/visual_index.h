@@ -33,12 +33,17 @@
 #include "colmap/math/math.h"
 #include "colmap/retrieval/inverted_file.h"
 #include "colmap/retrieval/inverted_index.h"
+#include "colmap/retrieval/kmeans.h"
 #include "colmap/retrieval/vote_and_verify.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/misc.h"
 
+#include <cstring>
+#include <memory>
+
 #include <Eigen/Core>
 #include <boost/heap/fibonacci_heap.hpp>
 #include <flann/flann.hpp>
@@ -46,6 +51,32 @@
 namespace colmap {
 namespace retrieval {
 
+namespace internal {
+
+// Header of memory-mapped visual indices. All offsets are relative to the
+// start of the file.
+struct MappedVisualIndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t desc_type_size;
+  uint32_t desc_type_is_float;
+  uint32_t desc_dim;
+  uint32_t embedding_dim;
+  uint64_t num_visual_words;
+  uint64_t visual_words_offset;
+  uint64_t inverted_index_offset;
+  uint64_t visual_word_index_offset;
+  uint64_t reserved[2];
+};
+
+constexpr char kMappedVisualIndexMagic[8] = {
+    'C', 'O', 'L', 'M', 'A', 'P', 'V', 'I'};
+constexpr uint32_t kMappedVisualIndexVersion = 3;
+constexpr uint32_t kMappedVisualIndexPreparedFlag = 1;
+
+}  // namespace internal
+
 // Visual index for image retrieval using a vocabulary tree with Hamming
 // embedding, based on the papers:
 //
@@ -106,6 +137,20 @@ class VisualIndex {
     // The number of iterations for the clustering.
     int num_iterations = 11;
 
+    // Whether to quantize the descriptor space with the native hierarchical
+    // k-means instead of FLANN. It runs in parallel, trains every node of the
+    // tree with mini-batch updates on a random subset of its descriptors, and
+    // is much faster for large numbers of training descriptors.
+    bool native_kmeans = false;
+
+    // The number of descriptors in each mini-batch update of the native
+    // hierarchical k-means.
+    int kmeans_batch_size = 4096;
+
+    // The maximum number of training descriptors per cluster of each node in
+    // the native hierarchical k-means.
+    int kmeans_max_num_descriptors_per_cluster = 256;
+
     // The target precision of the visual word search index.
     double target_precision = 0.95;
 
@@ -121,6 +166,9 @@ class VisualIndex {
 
   size_t NumVisualWords() const;
 
+  // The centroids of the visual words with one visual word per row.
+  DescType VisualWords() const;
+
   // Add image to the visual index.
   void Add(const IndexOptions& options,
            int image_id,
@@ -141,6 +189,22 @@ class VisualIndex {
              const DescType& descriptors,
              std::vector<ImageScore>* image_scores) const;
 
+  // Query for most similar images in the visual index using the nearest
+  // neighbor visual words of the descriptors as returned by `FindWordIds`.
+  // The visual words can be found once for multiple indices with the same
+  // vocabulary, e.g. the shards of a sharded index.
+  void Query(const QueryOptions& options,
+             const GeomType& geometries,
+             const DescType& descriptors,
+             const Eigen::MatrixXi& word_ids,
+             std::vector<ImageScore>* image_scores) const;
+
+  // Find the nearest neighbor visual words for the given descriptors.
+  Eigen::MatrixXi FindWordIds(const DescType& descriptors,
+                              int num_neighbors,
+                              int num_checks,
+                              int num_threads) const;
+
   // Prepare the index after adding images and before querying.
   void Prepare();
 
@@ -149,32 +213,41 @@ class VisualIndex {
   void Build(const BuildOptions& options, const DescType& descriptors);
 
   // Read and write the visual index. This can be done for an index with and
-  // without indexed images.
+  // without indexed images. Indices in the packed format are detected on read
+  // and the visual words and inverted files are then used in-place from the
+  // memory-mapped file, such that the index is loaded lazily and shared
+  // through the page cache between the processes reading the same file.
   void Read(const std::string& path);
   void Write(const std::string& path);
+  void WritePacked(const std::string& path);
+
+  // Whether the index is used in-place from a memory-mapped file.
+  bool IsMapped() const;
 
  private:
   // Quantize the descriptor space into visual words.
   void Quantize(const BuildOptions& options, const DescType& descriptors);
 
-  // Query for nearest neighbor images and return nearest neighbor visual word
-  // identifiers for each descriptor.
-  void QueryAndFindWordIds(const QueryOptions& options,
-                           const DescType& descriptors,
-                           std::vector<ImageScore>* image_scores,
-                           Eigen::MatrixXi* word_ids) const;
+  // Query for nearest neighbor images using the given nearest neighbor visual
+  // word identifiers for each descriptor.
+  void QueryWordIds(const QueryOptions& options,
+                    const DescType& descriptors,
+                    const Eigen::MatrixXi& word_ids,
+                    std::vector<ImageScore>* image_scores) const;
 
-  // Find the nearest neighbor visual words for the given descriptors.
-  Eigen::MatrixXi FindWordIds(const DescType& descriptors,
-                              int num_neighbors,
-                              int num_checks,
-                              int num_threads) const;
+  // Read the visual index in the packed format.
+  void ReadPacked(const std::string& path);
+
+  // Release the visual words, if they are owned by the index.
+  void ReleaseVisualWords();
 
   // The search structure on the quantized descriptor space.
   flann::AutotunedIndex<flann::L2<kDescType>> visual_word_index_;
 
-  // The centroids of the visual words.
+  // The centroids of the visual words, which point into the mapped file for
+  // indices in the packed format.
   flann::Matrix<kDescType> visual_words_;
+  std::shared_ptr<const MappedFile> mapped_file_;
 
   // The inverted index of the database.
   InvertedIndexType inverted_index_;
@@ -196,9 +269,7 @@ VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VisualIndex()
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 VisualIndex<kDescType, kDescDim, kEmbeddingDim>::~VisualIndex() {
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
+  ReleaseVisualWords();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -206,6 +277,16 @@ size_t VisualIndex<kDescType, kDescDim, kEmbeddingDim>::NumVisualWords() const {
   return visual_words_.rows;
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+typename VisualIndex<kDescType, kDescDim, kEmbeddingDim>::DescType
+VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VisualWords() const {
+  if (visual_words_.ptr() == nullptr) {
+    return DescType(0, kDescDim);
+  }
+  return Eigen::Map<const DescType>(
+      visual_words_.ptr(), visual_words_.rows, visual_words_.cols);
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
     const IndexOptions& options,
@@ -271,8 +352,28 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     const GeomType& geometries,
     const DescType& descriptors,
     std::vector<ImageScore>* image_scores) const {
-  Eigen::MatrixXi word_ids;
-  QueryAndFindWordIds(options, descriptors, image_scores, &word_ids);
+  THROW_CHECK(prepared_);
+
+  if (descriptors.rows() == 0) {
+    image_scores->clear();
+    return;
+  }
+
+  const Eigen::MatrixXi word_ids = FindWordIds(descriptors,
+                                               options.num_neighbors,
+                                               options.num_checks,
+                                               options.num_threads);
+  Query(options, geometries, descriptors, word_ids, image_scores);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
+    const QueryOptions& options,
+    const GeomType& geometries,
+    const DescType& descriptors,
+    const Eigen::MatrixXi& word_ids,
+    std::vector<ImageScore>* image_scores) const {
+  QueryWordIds(options, descriptors, word_ids, image_scores);
 
   if (options.num_images_after_verification <= 0) {
     return;
@@ -311,10 +412,12 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
 
     EntryType query_entry;
     query_entry.feature_idx = i;
-    query_entry.geometry.x = geometries[i].x;
-    query_entry.geometry.y = geometries[i].y;
-    query_entry.geometry.scale = geometries[i].ComputeScale();
-    query_entry.geometry.orientation = geometries[i].ComputeOrientation();
+    FeatureGeometry query_geometry;
+    query_geometry.x = geometries[i].x;
+    query_geometry.y = geometries[i].y;
+    query_geometry.scale = geometries[i].ComputeScale();
+    query_geometry.orientation = geometries[i].ComputeOrientation();
+    query_entry.geometry = CompactFeatureGeometry(query_geometry);
     query_entries.push_back(query_entry);
 
     // For each db feature, keep track of the lowest distance (if db features
@@ -461,8 +564,8 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
             if (!match_found) {
               match_found = true;
               FeatureGeometryMatch match;
-              match.geometry1 = entry2.second.first->geometry;
-              match.geometry2 = entry2.second.second->geometry;
+              match.geometry1 = entry2.second.first->geometry.Decode();
+              match.geometry2 = entry2.second.second->geometry.Decode();
               matches.push_back(match);
 
               handles2.erase(idx2);
@@ -522,6 +625,9 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Prepare() {
+  if (prepared_) {
+    return;
+  }
   inverted_index_.Finalize();
   prepared_ = true;
 }
@@ -543,6 +649,8 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Build(
   // Initialize a new inverted index.
   inverted_index_ = InvertedIndexType();
   inverted_index_.Initialize(NumVisualWords());
+  image_ids_.clear();
+  prepared_ = false;
 
   // Generate descriptor projection matrix.
   inverted_index_.GenerateHammingEmbeddingProjection();
@@ -557,14 +665,26 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Build(
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
     const std::string& path) {
+  {
+    std::ifstream file(path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, path);
+    char magic[sizeof(internal::kMappedVisualIndexMagic)] = {0};
+    file.read(magic, sizeof(magic));
+    if (file.good() && std::memcmp(magic,
+                                   internal::kMappedVisualIndexMagic,
+                                   sizeof(magic)) == 0) {
+      file.close();
+      ReadPacked(path);
+      return;
+    }
+  }
+
   long int file_offset = 0;
 
   // Read the visual words.
 
   {
-    if (visual_words_.ptr() != nullptr) {
-      delete[] visual_words_.ptr();
-    }
+    ReleaseVisualWords();
 
     std::ifstream file(path, std::ios::binary);
     THROW_CHECK_FILE_OPEN(file, path);
@@ -608,6 +728,7 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
 
   image_ids_.clear();
   inverted_index_.GetImageIds(&image_ids_);
+  prepared_ = false;
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -649,6 +770,149 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
   }
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::WritePacked(
+    const std::string& path) {
+  THROW_CHECK_NOTNULL(visual_words_.ptr());
+  THROW_CHECK(IsLittleEndian())
+      << "Mapped visual indices are only supported on little-endian platforms";
+
+  internal::MappedVisualIndexHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic,
+              internal::kMappedVisualIndexMagic,
+              sizeof(internal::kMappedVisualIndexMagic));
+  header.version = internal::kMappedVisualIndexVersion;
+  if (prepared_) {
+    header.flags |= internal::kMappedVisualIndexPreparedFlag;
+  }
+  header.desc_type_size = sizeof(kDescType);
+  header.desc_type_is_float = std::is_floating_point<kDescType>::value;
+  header.desc_dim = kDescDim;
+  header.embedding_dim = kEmbeddingDim;
+  header.num_visual_words = visual_words_.rows;
+
+  // Write the visual words and the inverted index.
+
+  {
+    std::ofstream file(path, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, path);
+
+    // The header is rewritten once all offsets are known.
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    internal::WriteMappedPadding(&file);
+    header.visual_words_offset = file.tellp();
+    file.write(reinterpret_cast<const char*>(visual_words_.ptr()),
+               visual_words_.rows * visual_words_.cols * sizeof(kDescType));
+
+    internal::WriteMappedPadding(&file);
+    header.inverted_index_offset = file.tellp();
+    inverted_index_.WritePacked(&file);
+
+    // The search index is appended at the end of the file.
+    internal::WriteMappedPadding(&file);
+    header.visual_word_index_offset = file.tellp();
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    THROW_CHECK(file.good()) << "Failed to write visual index " << path;
+  }
+
+  // Write the visual words search index. Its tree cannot be used in-place and
+  // is rebuilt from the serialized nodes on read.
+
+  {
+    FILE* fout = nullptr;
+#ifdef _MSC_VER
+    THROW_CHECK_EQ(fopen_s(&fout, path.c_str(), "ab"), 0);
+#else
+    fout = fopen(path.c_str(), "ab");
+#endif
+    THROW_CHECK_NOTNULL(fout);
+    visual_word_index_.saveIndex(fout);
+    fclose(fout);
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+bool VisualIndex<kDescType, kDescDim, kEmbeddingDim>::IsMapped() const {
+  return mapped_file_ != nullptr;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ReadPacked(
+    const std::string& path) {
+  THROW_CHECK(IsLittleEndian())
+      << "Mapped visual indices are only supported on little-endian platforms";
+
+  auto mapped_file = std::make_shared<const MappedFile>(path);
+  internal::CheckMappedArray(
+      *mapped_file, 0, sizeof(internal::MappedVisualIndexHeader));
+  const auto* header =
+      reinterpret_cast<const internal::MappedVisualIndexHeader*>(
+          mapped_file->Data());
+  THROW_CHECK_EQ(header->version, internal::kMappedVisualIndexVersion)
+      << "Unsupported visual index version in " << path;
+  THROW_CHECK(header->desc_type_size == sizeof(kDescType) &&
+              header->desc_type_is_float ==
+                  std::is_floating_point<kDescType>::value &&
+              header->desc_dim == kDescDim &&
+              header->embedding_dim == kEmbeddingDim)
+      << "The visual index " << path << " has an incompatible descriptor type";
+  THROW_CHECK_GT(header->num_visual_words, 0);
+  internal::CheckMappedArray(
+      *mapped_file,
+      header->visual_words_offset,
+      header->num_visual_words * kDescDim * sizeof(kDescType));
+  internal::CheckMappedArray(*mapped_file, header->visual_word_index_offset, 0);
+
+  // Use the visual words in-place.
+
+  ReleaseVisualWords();
+  visual_words_ = flann::Matrix<kDescType>(
+      reinterpret_cast<kDescType*>(
+          const_cast<char*>(mapped_file->Data()) + header->visual_words_offset),
+      header->num_visual_words,
+      kDescDim);
+  mapped_file_ = mapped_file;
+
+  // Read the visual words search index.
+
+  visual_word_index_ =
+      flann::AutotunedIndex<flann::L2<kDescType>>(visual_words_);
+
+  {
+    FILE* fin = nullptr;
+#ifdef _MSC_VER
+    THROW_CHECK_EQ(fopen_s(&fin, path.c_str(), "rb"), 0);
+#else
+    fin = fopen(path.c_str(), "rb");
+#endif
+    THROW_CHECK_NOTNULL(fin);
+    fseek(fin, header->visual_word_index_offset, SEEK_SET);
+    visual_word_index_.loadIndex(fin);
+    fclose(fin);
+  }
+
+  // Use the inverted index in-place.
+
+  inverted_index_.Map(mapped_file, header->inverted_index_offset);
+
+  image_ids_.clear();
+  inverted_index_.GetImageIds(&image_ids_);
+  prepared_ = header->flags & internal::kMappedVisualIndexPreparedFlag;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ReleaseVisualWords() {
+  if (mapped_file_ == nullptr && visual_words_.ptr() != nullptr) {
+    delete[] visual_words_.ptr();
+  }
+  visual_words_ = flann::Matrix<kDescType>();
+  mapped_file_.reset();
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
     const BuildOptions& options, const DescType& descriptors) {
@@ -657,6 +921,34 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
   THROW_CHECK_GE(options.num_visual_words, options.branching);
   THROW_CHECK_GE(descriptors.rows(), options.num_visual_words);
 
+  if (options.native_kmeans) {
+    HierarchicalKMeansOptions kmeans_options;
+    kmeans_options.num_clusters = options.num_visual_words;
+    kmeans_options.branching = options.branching;
+    kmeans_options.num_iterations = options.num_iterations;
+    kmeans_options.batch_size = options.kmeans_batch_size;
+    kmeans_options.max_num_descriptors_per_cluster =
+        options.kmeans_max_num_descriptors_per_cluster;
+    kmeans_options.num_threads = options.num_threads;
+    const Eigen::Matrix<float, Eigen::Dynamic, kDescDim, Eigen::RowMajor>
+        centers = HierarchicalKMeans(kmeans_options, descriptors);
+
+    kDescType* visual_words_data = new kDescType[centers.size()];
+    for (Eigen::Index i = 0; i < centers.size(); ++i) {
+      if (std::is_integral<kDescType>::value) {
+        visual_words_data[i] = std::round(centers.data()[i]);
+      } else {
+        visual_words_data[i] = centers.data()[i];
+      }
+    }
+
+    ReleaseVisualWords();
+
+    visual_words_ = flann::Matrix<kDescType>(
+        visual_words_data, centers.rows(), descriptors.cols());
+    return;
+  }
+
   const flann::Matrix<kDescType> descriptor_matrix(
       const_cast<kDescType*>(descriptors.data()),
       descriptors.rows(),
@@ -687,32 +979,27 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
     }
   }
 
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
+  ReleaseVisualWords();
 
   visual_words_ = flann::Matrix<kDescType>(
       visual_words_data, num_centers, descriptors.cols());
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
-void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryAndFindWordIds(
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryWordIds(
     const QueryOptions& options,
     const DescType& descriptors,
-    std::vector<ImageScore>* image_scores,
-    Eigen::MatrixXi* word_ids) const {
+    const Eigen::MatrixXi& word_ids,
+    std::vector<ImageScore>* image_scores) const {
   THROW_CHECK(prepared_);
+  THROW_CHECK_EQ(word_ids.rows(), descriptors.rows());
 
   if (descriptors.rows() == 0) {
     image_scores->clear();
     return;
   }
 
-  *word_ids = FindWordIds(descriptors,
-                          options.num_neighbors,
-                          options.num_checks,
-                          options.num_threads);
-  inverted_index_.Query(descriptors, *word_ids, image_scores);
+  inverted_index_.Query(descriptors, word_ids, image_scores);
 
   auto SortFunc = [](const ImageScore& score1, const ImageScore& score2) {
     return score1.score > score2.score;
@@ -29,6 +29,8 @@
 
 #include "colmap/retrieval/visual_index.h"
 
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -44,6 +46,7 @@ void TestVocabTreeType() {
   {
     VisualIndexType visual_index;
     EXPECT_EQ(visual_index.NumVisualWords(), 0);
+    EXPECT_EQ(visual_index.VisualWords().rows(), 0);
   }
 
   {
@@ -58,6 +61,19 @@ void TestVocabTreeType() {
     EXPECT_EQ(visual_index.NumVisualWords(), 5);
   }
 
+  {
+    typename VisualIndexType::DescType descriptors =
+        VisualIndexType::DescType::Random(50, kDescDim);
+    VisualIndexType visual_index;
+    typename VisualIndexType::BuildOptions build_options;
+    build_options.num_visual_words = 5;
+    build_options.branching = 5;
+    build_options.native_kmeans = true;
+    visual_index.Build(build_options, descriptors);
+    EXPECT_EQ(visual_index.NumVisualWords(), 5);
+    EXPECT_EQ(visual_index.VisualWords().rows(), 5);
+  }
+
   {
     typename VisualIndexType::DescType descriptors =
         VisualIndexType::DescType::Random(1000, kDescDim);
@@ -99,6 +115,53 @@ void TestVocabTreeType() {
     EXPECT_EQ(image_scores[0].image_id, 1);
     EXPECT_EQ(image_scores[1].image_id, 2);
     EXPECT_GT(image_scores[0].score, image_scores[1].score);
+
+    const std::string test_dir = CreateTestDir();
+    const std::string packed_path = test_dir + "/packed_index.bin";
+    visual_index.WritePacked(packed_path);
+    EXPECT_FALSE(visual_index.IsMapped());
+
+    VisualIndexType packed_visual_index;
+    packed_visual_index.Read(packed_path);
+    EXPECT_TRUE(packed_visual_index.IsMapped());
+    EXPECT_EQ(packed_visual_index.NumVisualWords(), 100);
+    EXPECT_TRUE(packed_visual_index.ImageIndexed(1));
+    EXPECT_TRUE(packed_visual_index.ImageIndexed(2));
+    packed_visual_index.Prepare();
+    std::vector<ImageScore> packed_image_scores;
+    packed_visual_index.Query(
+        query_options, descriptors1, &packed_image_scores);
+    ASSERT_EQ(packed_image_scores.size(), image_scores.size());
+    for (size_t i = 0; i < image_scores.size(); ++i) {
+      EXPECT_EQ(packed_image_scores[i].image_id, image_scores[i].image_id);
+      EXPECT_EQ(packed_image_scores[i].score, image_scores[i].score);
+    }
+
+    // Writing a mapped index in the original format copies the mapped data.
+    const std::string path = test_dir + "/index.bin";
+    packed_visual_index.Write(path);
+    VisualIndexType read_visual_index;
+    read_visual_index.Read(path);
+    EXPECT_FALSE(read_visual_index.IsMapped());
+    EXPECT_EQ(read_visual_index.NumVisualWords(), 100);
+    read_visual_index.Prepare();
+    read_visual_index.Query(query_options, descriptors1, &packed_image_scores);
+    ASSERT_EQ(packed_image_scores.size(), image_scores.size());
+    for (size_t i = 0; i < image_scores.size(); ++i) {
+      EXPECT_EQ(packed_image_scores[i].image_id, image_scores[i].image_id);
+      EXPECT_NEAR(packed_image_scores[i].score, image_scores[i].score, 1e-6);
+    }
+
+    // Adding images to a mapped index copies the inverted files into memory.
+    typename VisualIndexType::GeomType keypoints3(50);
+    typename VisualIndexType::DescType descriptors3 =
+        VisualIndexType::DescType::Random(50, kDescDim);
+    packed_visual_index.Add(index_options, 3, keypoints3, descriptors3);
+    packed_visual_index.Prepare();
+    packed_visual_index.Query(
+        query_options, descriptors3, &packed_image_scores);
+    EXPECT_EQ(packed_image_scores.size(), 3);
+    EXPECT_EQ(packed_image_scores[0].image_id, 3);
   }
 }
 
@@ -0,0 +1,108 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "colmap/retrieval/vlad.h"
+
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace colmap {
+namespace retrieval {
+
+VLADEncoder::VLADEncoder(CodebookType codebook)
+    : codebook_(std::move(codebook)) {
+  THROW_CHECK_GT(codebook_.rows(), 0);
+  THROW_CHECK_GT(codebook_.cols(), 0);
+  squared_codebook_norms_ = codebook_.rowwise().squaredNorm();
+}
+
+int VLADEncoder::NumClusters() const { return codebook_.rows(); }
+
+int VLADEncoder::NumDims() const { return codebook_.size(); }
+
+const VLADEncoder::CodebookType& VLADEncoder::Codebook() const {
+  return codebook_;
+}
+
+Eigen::VectorXf VLADEncoder::Encode(const DescType& descriptors) const {
+  THROW_CHECK_GT(codebook_.size(), 0);
+  THROW_CHECK_EQ(descriptors.cols(), codebook_.cols());
+
+  CodebookType residual_sums(codebook_.rows(), codebook_.cols());
+  residual_sums.setZero();
+
+  // The nearest centers are found through matrix products on blocks of
+  // descriptors using ||x - c||^2 = ||x||^2 - 2 x^T c + ||c||^2, where the
+  // constant ||x||^2 is omitted.
+  const Eigen::Index kBlockSize = 256;
+  CodebookType block;
+  CodebookType dots;
+  for (Eigen::Index block_begin = 0; block_begin < descriptors.rows();
+       block_begin += kBlockSize) {
+    const Eigen::Index block_size =
+        std::min(kBlockSize, descriptors.rows() - block_begin);
+    block = descriptors.middleRows(block_begin, block_size).cast<float>();
+    dots.noalias() = block * codebook_.transpose();
+    for (Eigen::Index i = 0; i < block_size; ++i) {
+      Eigen::Index nearest_center = 0;
+      float min_dist = std::numeric_limits<float>::max();
+      for (Eigen::Index c = 0; c < codebook_.rows(); ++c) {
+        const float dist = squared_codebook_norms_(c) - 2 * dots(i, c);
+        if (dist < min_dist) {
+          min_dist = dist;
+          nearest_center = c;
+        }
+      }
+      residual_sums.row(nearest_center) +=
+          block.row(i) - codebook_.row(nearest_center);
+    }
+  }
+
+  // Intra-normalization reduces the influence of bursty features, which
+  // contribute many similar residuals to the same center.
+  for (Eigen::Index c = 0; c < residual_sums.rows(); ++c) {
+    const float norm = residual_sums.row(c).norm();
+    if (norm > 0) {
+      residual_sums.row(c) /= norm;
+    }
+  }
+
+  Eigen::VectorXf vlad =
+      Eigen::Map<const Eigen::VectorXf>(residual_sums.data(),
+                                        residual_sums.size());
+  const float norm = vlad.norm();
+  if (norm > 0) {
+    vlad /= norm;
+  }
+  return vlad;
+}
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,80 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <cstdint>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace retrieval {
+
+// Aggregates the local descriptors of an image into a single global VLAD
+// descriptor (vector of locally aggregated descriptors), as described in:
+//
+//    Jégou, Douze, Schmid, Pérez. "Aggregating local descriptors into a
+//    compact image representation". CVPR 2010.
+//
+//    Arandjelovic, Zisserman. "All about VLAD". CVPR 2013.
+//
+// Every descriptor is assigned to its nearest codebook center and the
+// residuals to the center are summed up per center. The sums are
+// intra-normalized and concatenated, so that the inner product of two
+// L2-normalized VLAD descriptors measures the similarity of two images.
+class VLADEncoder {
+ public:
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      CodebookType;
+  typedef Eigen::
+      Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+          DescType;
+
+  VLADEncoder() = default;
+  explicit VLADEncoder(CodebookType codebook);
+
+  // The number of codebook centers.
+  int NumClusters() const;
+
+  // The dimension of the VLAD descriptors.
+  int NumDims() const;
+
+  const CodebookType& Codebook() const;
+
+  // Encode the local descriptors of an image, which must have the same
+  // dimension as the codebook centers. An image without descriptors is
+  // encoded as a zero vector.
+  Eigen::VectorXf Encode(const DescType& descriptors) const;
+
+ private:
+  CodebookType codebook_;
+  Eigen::VectorXf squared_codebook_norms_;
+};
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,78 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "colmap/retrieval/vlad.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+TEST(VLADEncoder, Empty) {
+  VLADEncoder::CodebookType codebook(2, 2);
+  codebook << 0, 0, 10, 10;
+  const VLADEncoder encoder(codebook);
+  EXPECT_EQ(encoder.NumClusters(), 2);
+  EXPECT_EQ(encoder.NumDims(), 4);
+  EXPECT_EQ(encoder.Codebook(), codebook);
+  EXPECT_EQ(encoder.Encode(VLADEncoder::DescType(0, 2)),
+            Eigen::VectorXf::Zero(4));
+}
+
+TEST(VLADEncoder, Nominal) {
+  VLADEncoder::CodebookType codebook(2, 2);
+  codebook << 0, 0, 10, 10;
+  const VLADEncoder encoder(codebook);
+  VLADEncoder::DescType descriptors(3, 2);
+  descriptors << 1, 0, 0, 1, 10, 12;
+  const Eigen::VectorXf vlad = encoder.Encode(descriptors);
+  ASSERT_EQ(vlad.size(), 4);
+  EXPECT_NEAR(vlad(0), 0.5, 1e-6);
+  EXPECT_NEAR(vlad(1), 0.5, 1e-6);
+  EXPECT_NEAR(vlad(2), 0, 1e-6);
+  EXPECT_NEAR(vlad(3), std::sqrt(0.5), 1e-6);
+  EXPECT_NEAR(vlad.norm(), 1, 1e-6);
+}
+
+TEST(VLADEncoder, Burstiness) {
+  VLADEncoder::CodebookType codebook(2, 2);
+  codebook << 0, 0, 10, 10;
+  const VLADEncoder encoder(codebook);
+  VLADEncoder::DescType descriptors1(2, 2);
+  descriptors1 << 1, 0, 10, 11;
+  // Repeated features of the same center do not dominate the descriptor.
+  VLADEncoder::DescType descriptors2(4, 2);
+  descriptors2 << 1, 0, 1, 0, 1, 0, 10, 11;
+  EXPECT_TRUE(encoder.Encode(descriptors1)
+                  .isApprox(encoder.Encode(descriptors2), 1e-6));
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
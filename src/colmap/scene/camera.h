@@ -136,6 +136,15 @@ struct Camera {
   // api: 投影像素点到相机归一化平面坐标系
   inline Eigen::Vector2d ImgFromCam(const Eigen::Vector2d& cam_point) const;
 
+  // Batched versions of the above, which only dispatch on the camera model
+  // once for all points. The image points are transformed to camera rays
+  // (u, v, 1) and the camera points must be in front of the camera. The input
+  // and output must have the same size.
+  inline void CamFromImg(span<const Eigen::Vector2d> image_points,
+                         span<Eigen::Vector3d> cam_rays) const;
+  inline void ImgFromCam(span<const Eigen::Vector3d> cam_points,
+                         span<Eigen::Vector2d> image_points) const;
+
   // Rescale camera dimensions and accordingly the focal length and
   // and the principal point.
   void Rescale(double scale);
@@ -253,4 +262,14 @@ Eigen::Vector2d Camera::ImgFromCam(const Eigen::Vector2d& cam_point) const {
   return CameraModelImgFromCam(model_id, params, cam_point.homogeneous());
 }
 
+void Camera::CamFromImg(const span<const Eigen::Vector2d> image_points,
+                        span<Eigen::Vector3d> cam_rays) const {
+  CameraModelCamFromImg(model_id, params, image_points, cam_rays);
+}
+
+void Camera::ImgFromCam(const span<const Eigen::Vector3d> cam_points,
+                        span<Eigen::Vector2d> image_points) const {
+  CameraModelImgFromCam(model_id, params, cam_points, image_points);
+}
+
 }  // namespace colmap
@@ -276,6 +276,28 @@ TEST(Camera, ImgFromCam) {
   EXPECT_EQ(camera.ImgFromCam(Eigen::Vector2d(-0.5, -0.5))(1), 0.0);
 }
 
+TEST(Camera, BatchedCamFromImgImgFromCam) {
+  const Camera camera =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 2.0, 10, 10);
+  const std::vector<Eigen::Vector2d> image_points = {
+      Eigen::Vector2d(0.0, 0.0),
+      Eigen::Vector2d(5.0, 5.0),
+      Eigen::Vector2d(8.5, 1.5)};
+  std::vector<Eigen::Vector3d> cam_rays(image_points.size());
+  camera.CamFromImg({image_points.data(), image_points.size()},
+                    {cam_rays.data(), cam_rays.size()});
+  std::vector<Eigen::Vector2d> image_points2(image_points.size());
+  camera.ImgFromCam({cam_rays.data(), cam_rays.size()},
+                    {image_points2.data(), image_points2.size()});
+  for (size_t i = 0; i < image_points.size(); ++i) {
+    EXPECT_EQ(cam_rays[i].hnormalized(), camera.CamFromImg(image_points[i]));
+    EXPECT_NEAR((image_points2[i] - image_points[i]).norm(), 0, 1e-6);
+  }
+  EXPECT_THROW(camera.ImgFromCam({cam_rays.data(), cam_rays.size()},
+                                 {image_points2.data(), 1}),
+               std::invalid_argument);
+}
+
 TEST(Camera, Rescale) {
   Camera camera = Camera::CreateFromModelName(1, "SIMPLE_PINHOLE", 1.0, 1, 1);
   camera.Rescale(2.0);
@@ -30,10 +30,16 @@
 #include "colmap/scene/correspondence_graph.h"
 
 #include "colmap/geometry/pose.h"
+#include "colmap/util/memory.h"
 #include "colmap/util/string.h"
+#include "colmap/util/threading.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <map>
 #include <set>
+#include <unordered_set>
 
 namespace colmap {
 
@@ -48,48 +54,206 @@ CorrespondenceGraph::NumCorrespondencesBetweenImages() const {
   return num_corrs_between_images;
 }
 
+size_t CorrespondenceGraph::NumBytes() const {
+  size_t num_bytes = EstimateNumBytes(images_) + EstimateNumBytes(image_pairs_);
+  for (const auto& image : images_) {
+    num_bytes += EstimateNumBytes(image.second.corrs);
+    for (const auto& point_corrs : image.second.corrs) {
+      num_bytes += EstimateNumBytes(point_corrs);
+    }
+  }
+  num_bytes += EstimateNumBytes(flat_images_) +
+               EstimateNumBytes(flat_image_idxs_) +
+               EstimateNumBytes(flat_corrs_) +
+               EstimateNumBytes(flat_corr_begs_) +
+               EstimateNumBytes(point_track_idxs_) +
+               EstimateNumBytes(track_begs_) + EstimateNumBytes(track_corrs_);
+  return num_bytes;
+}
+
 void CorrespondenceGraph::Finalize() {
   THROW_CHECK(!finalized_);
   finalized_ = true;
 
-  // Flatten all correspondences, remove images without observations.
+  // Count correspondences and observations, remove images without
+  // observations.
+  size_t num_total_corrs = 0;
+  size_t num_total_points2D = 0;
   for (auto it = images_.begin(); it != images_.end();) {
-    // Count number of correspondences and observations.
     it->second.num_observations = 0;
-    size_t num_total_corrs = 0;
+    size_t num_image_corrs = 0;
     for (auto& corr : it->second.corrs) {
-      num_total_corrs += corr.size();
+      num_image_corrs += corr.size();
       if (!corr.empty()) {
         it->second.num_observations += 1;
       }
     }
 
     // Erase image without observations.
-    if (num_total_corrs == 0) {
+    if (num_image_corrs == 0) {
       images_.erase(it++);
       continue;
     }
 
-    // Reshuffle correspondences into flattened vector.
-    const point2D_t num_points2D = it->second.corrs.size();
-    it->second.flat_corrs.reserve(num_total_corrs);
-    it->second.flat_corr_begs.resize(num_points2D + 1);
-    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D; ++point2D_idx) {
-      it->second.flat_corr_begs[point2D_idx] = it->second.flat_corrs.size();
-      std::vector<Correspondence>& corrs = it->second.corrs[point2D_idx];
-      it->second.flat_corrs.insert(
-          it->second.flat_corrs.end(), corrs.begin(), corrs.end());
+    num_total_corrs += num_image_corrs;
+    num_total_points2D += it->second.corrs.size() + 1;
+    ++it;
+  }
+
+  // Reshuffle correspondences into the flattened arrays.
+  flat_images_.reserve(images_.size());
+  flat_corrs_.reserve(num_total_corrs);
+  flat_corr_begs_.reserve(num_total_points2D);
+  for (auto& image : images_) {
+    image.second.flat_image_idx = flat_images_.size();
+    FlattenImage(&image.second, &flat_images_.emplace_back());
+  }
+
+  // Ensure we reserved enough space before insertion.
+  THROW_CHECK_EQ(flat_corrs_.size(), num_total_corrs);
+  THROW_CHECK_EQ(flat_corr_begs_.size(), num_total_points2D);
+
+  UpdateFlatImageIdxs();
+}
+
+void CorrespondenceGraph::Extend(
+    const std::vector<std::pair<image_t, size_t>>& new_images,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<const FeatureMatches*>& matches,
+    const int num_threads) {
+  THROW_CHECK(finalized_);
+  THROW_CHECK_EQ(image_pairs.size(), matches.size());
+
+  std::unordered_set<image_t> new_image_ids;
+  std::vector<image_t> changed_image_ids;
+  new_image_ids.reserve(new_images.size());
+  changed_image_ids.reserve(new_images.size());
+  for (const auto& [image_id, num_points2D] : new_images) {
+    THROW_CHECK(!ExistsImage(image_id));
+    images_[image_id].corrs.resize(num_points2D);
+    new_image_ids.insert(image_id);
+    changed_image_ids.push_back(image_id);
+  }
+
+  // The existing images are only unflattened, if they gain correspondences.
+  std::unordered_set<image_t> unflattened_image_ids;
+  for (const auto& [image_id1, image_id2] : image_pairs) {
+    THROW_CHECK(new_image_ids.count(image_id1) > 0 ||
+                new_image_ids.count(image_id2) > 0)
+        << "Image pair " << image_id1 << ", " << image_id2
+        << " has no new image";
+    for (const image_t image_id : {image_id1, image_id2}) {
+      if (new_image_ids.count(image_id) == 0 &&
+          unflattened_image_ids.insert(image_id).second) {
+        UnflattenImage(&images_.at(image_id));
+        changed_image_ids.push_back(image_id);
+      }
     }
-    it->second.flat_corr_begs[num_points2D] = it->second.flat_corrs.size();
+  }
 
-    // Ensure we reserved enough space before insertion.
-    THROW_CHECK_EQ(it->second.flat_corrs.size(), num_total_corrs);
+  AddCorrespondencesBatch(image_pairs, matches, num_threads);
+
+  // The correspondences of the changed images are appended to the end of the
+  // flattened arrays and new images without observations are erased.
+  for (const image_t image_id : changed_image_ids) {
+    const auto it = images_.find(image_id);
+    struct Image& image = it->second;
+    image.num_observations = 0;
+    for (const auto& corrs : image.corrs) {
+      if (!corrs.empty()) {
+        image.num_observations += 1;
+      }
+    }
+    if (image.num_observations == 0) {
+      images_.erase(it);
+      continue;
+    }
+    if (new_image_ids.count(image_id) > 0) {
+      image.flat_image_idx = flat_images_.size();
+      flat_images_.emplace_back();
+    }
+    FlattenImage(&image, &flat_images_[image.flat_image_idx]);
+  }
 
-    // Deallocate original data.
-    it->second.corrs.clear();
-    it->second.corrs.shrink_to_fit();
+  if (num_garbage_corrs_ > flat_corrs_.size() / 2) {
+    CompactFlatImages();
+  }
 
-    ++it;
+  UpdateFlatImageIdxs();
+
+  if (has_tracks_) {
+    ComputeTracks(num_threads);
+  }
+}
+
+void CorrespondenceGraph::FlattenImage(struct Image* image,
+                                       FlatImage* flat_image) {
+  flat_image->corrs_beg = flat_corrs_.size();
+  flat_image->points2D_beg = flat_corr_begs_.size();
+  flat_image->num_points2D = image->corrs.size();
+  for (std::vector<Correspondence>& corrs : image->corrs) {
+    flat_corr_begs_.push_back(flat_corrs_.size() - flat_image->corrs_beg);
+    flat_corrs_.insert(flat_corrs_.end(), corrs.begin(), corrs.end());
+  }
+  flat_corr_begs_.push_back(flat_corrs_.size() - flat_image->corrs_beg);
+
+  // Deallocate original data.
+  image->corrs.clear();
+  image->corrs.shrink_to_fit();
+}
+
+void CorrespondenceGraph::UnflattenImage(struct Image* image) {
+  const FlatImage& flat_image = flat_images_[image->flat_image_idx];
+  const point2D_t* corr_begs = flat_corr_begs_.data() + flat_image.points2D_beg;
+  const Correspondence* corrs = flat_corrs_.data() + flat_image.corrs_beg;
+  image->corrs.resize(flat_image.num_points2D);
+  for (point2D_t point2D_idx = 0; point2D_idx < flat_image.num_points2D;
+       ++point2D_idx) {
+    image->corrs[point2D_idx].assign(corrs + corr_begs[point2D_idx],
+                                     corrs + corr_begs[point2D_idx + 1]);
+  }
+  num_garbage_corrs_ += corr_begs[flat_image.num_points2D];
+  num_garbage_corr_begs_ += flat_image.num_points2D + 1;
+}
+
+void CorrespondenceGraph::CompactFlatImages() {
+  std::vector<Correspondence> flat_corrs;
+  std::vector<point2D_t> flat_corr_begs;
+  flat_corrs.reserve(flat_corrs_.size() - num_garbage_corrs_);
+  flat_corr_begs.reserve(flat_corr_begs_.size() - num_garbage_corr_begs_);
+  for (FlatImage& flat_image : flat_images_) {
+    const auto corr_begs = flat_corr_begs_.begin() + flat_image.points2D_beg;
+    const auto corrs = flat_corrs_.begin() + flat_image.corrs_beg;
+    const size_t num_corrs = corr_begs[flat_image.num_points2D];
+    flat_image.corrs_beg = flat_corrs.size();
+    flat_image.points2D_beg = flat_corr_begs.size();
+    flat_corrs.insert(flat_corrs.end(), corrs, corrs + num_corrs);
+    flat_corr_begs.insert(flat_corr_begs.end(),
+                          corr_begs,
+                          corr_begs + flat_image.num_points2D + 1);
+  }
+  flat_corrs_ = std::move(flat_corrs);
+  flat_corr_begs_ = std::move(flat_corr_begs);
+  num_garbage_corrs_ = 0;
+  num_garbage_corr_begs_ = 0;
+}
+
+void CorrespondenceGraph::UpdateFlatImageIdxs() {
+  // Image identifiers are usually consecutive, in which case the index of an
+  // image is found with a single lookup instead of hashing.
+  constexpr size_t kMaxSparsity = 4;
+  image_t max_image_id = 0;
+  for (const auto& image : images_) {
+    max_image_id = std::max(max_image_id, image.first);
+  }
+  flat_image_idxs_.clear();
+  if (!images_.empty() &&
+      max_image_id < kMaxSparsity * images_.size() + 1024) {
+    flat_image_idxs_.resize(static_cast<size_t>(max_image_id) + 1,
+                            std::numeric_limits<uint32_t>::max());
+    for (const auto& image : images_) {
+      flat_image_idxs_[image.first] = image.second.flat_image_idx;
+    }
   }
 }
 
@@ -185,17 +349,156 @@ void CorrespondenceGraph::AddCorrespondences(const image_t image_id1,
   }
 }
 
-CorrespondenceGraph::CorrespondenceRange
-CorrespondenceGraph::FindCorrespondences(const image_t image_id,
-                                         const point2D_t point2D_idx) const {
-  THROW_CHECK(finalized_);
-  const point2D_t next_point2D_idx = point2D_idx + 1;
-  const Image& image = images_.at(image_id);
-  const Correspondence* beg =
-      image.flat_corrs.data() + image.flat_corr_begs.at(point2D_idx);
-  const Correspondence* end =
-      image.flat_corrs.data() + image.flat_corr_begs.at(next_point2D_idx);
-  return CorrespondenceRange{beg, end};
+void CorrespondenceGraph::AddCorrespondencesBatch(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<const FeatureMatches*>& matches,
+    const int num_threads) {
+  THROW_CHECK_EQ(image_pairs.size(), matches.size());
+
+  const size_t num_image_pairs = image_pairs.size();
+  std::vector<struct Image*> images1(num_image_pairs, nullptr);
+  std::vector<struct Image*> images2(num_image_pairs, nullptr);
+  std::unordered_set<image_pair_t> pair_ids;
+  pair_ids.reserve(num_image_pairs);
+  for (size_t i = 0; i < num_image_pairs; ++i) {
+    const image_t image_id1 = image_pairs[i].first;
+    const image_t image_id2 = image_pairs[i].second;
+    if (image_id1 == image_id2) {
+      LOG(WARNING) << "Cannot use self-matches for image_id=" << image_id1;
+      continue;
+    }
+    THROW_CHECK(
+        pair_ids.insert(Database::ImagePairToPairId(image_id1, image_id2))
+            .second)
+        << "Duplicate image pair " << image_id1 << ", " << image_id2;
+    images1[i] = &images_.at(image_id1);
+    images2[i] = &images_.at(image_id2);
+  }
+
+  ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
+  const size_t num_workers = thread_pool.NumThreads();
+
+  // Validate the matches of all image pairs in parallel. Since each image pair
+  // occurs only once, duplicate correspondences can only come from the matches
+  // of the same image pair and the check does not depend on other pairs.
+  std::vector<FeatureMatches> valid_matches(num_image_pairs);
+  auto ValidateMatches = [&](const size_t begin, const size_t end) {
+    std::vector<bool> used1;
+    std::vector<bool> used2;
+    for (size_t i = begin; i < end; ++i) {
+      if (images1[i] == nullptr) {
+        continue;
+      }
+      const image_t image_id1 = image_pairs[i].first;
+      const image_t image_id2 = image_pairs[i].second;
+      const size_t num_points2D1 = images1[i]->corrs.size();
+      const size_t num_points2D2 = images2[i]->corrs.size();
+      if (used1.size() < num_points2D1) {
+        used1.resize(num_points2D1, false);
+      }
+      if (used2.size() < num_points2D2) {
+        used2.resize(num_points2D2, false);
+      }
+      valid_matches[i].reserve(matches[i]->size());
+      for (const auto& match : *matches[i]) {
+        const bool valid_idx1 = match.point2D_idx1 < num_points2D1;
+        const bool valid_idx2 = match.point2D_idx2 < num_points2D2;
+        if (valid_idx1 && valid_idx2) {
+          if (used1[match.point2D_idx1] || used2[match.point2D_idx2]) {
+            LOG(WARNING) << StringPrintf(
+                "Duplicate correspondence between "
+                "point2D_idx=%d in image_id=%d and point2D_idx=%d in "
+                "image_id=%d",
+                match.point2D_idx1,
+                image_id1,
+                match.point2D_idx2,
+                image_id2);
+          } else {
+            used1[match.point2D_idx1] = true;
+            used2[match.point2D_idx2] = true;
+            valid_matches[i].push_back(match);
+          }
+        } else {
+          if (!valid_idx1) {
+            LOG(WARNING) << StringPrintf(
+                "point2D_idx=%d in image_id=%d does not exist",
+                match.point2D_idx1,
+                image_id1);
+          }
+          if (!valid_idx2) {
+            LOG(WARNING) << StringPrintf(
+                "point2D_idx=%d in image_id=%d does not exist",
+                match.point2D_idx2,
+                image_id2);
+          }
+        }
+      }
+      // Only reset the used flags for the next image pair.
+      for (const auto& match : valid_matches[i]) {
+        used1[match.point2D_idx1] = false;
+        used2[match.point2D_idx2] = false;
+      }
+    }
+  };
+
+  const size_t chunk_size =
+      std::max<size_t>(1, (num_image_pairs + num_workers - 1) / num_workers);
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_workers);
+  for (size_t begin = 0; begin < num_image_pairs; begin += chunk_size) {
+    futures.push_back(thread_pool.AddTask(
+        ValidateMatches,
+        begin,
+        std::min(begin + chunk_size, num_image_pairs)));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+  futures.clear();
+
+  // Append the correspondences in parallel, where each worker exclusively owns
+  // a subset of the images. Visiting the image pairs in order preserves the
+  // order of the correspondences of the sequential version.
+  auto AppendCorrespondences = [&](const size_t worker_idx) {
+    for (size_t i = 0; i < num_image_pairs; ++i) {
+      if (images1[i] == nullptr) {
+        continue;
+      }
+      const image_t image_id1 = image_pairs[i].first;
+      const image_t image_id2 = image_pairs[i].second;
+      if (image_id1 % num_workers == worker_idx) {
+        for (const auto& match : valid_matches[i]) {
+          images1[i]->corrs[match.point2D_idx1].emplace_back(
+              image_id2, match.point2D_idx2);
+        }
+      }
+      if (image_id2 % num_workers == worker_idx) {
+        for (const auto& match : valid_matches[i]) {
+          images2[i]->corrs[match.point2D_idx2].emplace_back(
+              image_id1, match.point2D_idx1);
+        }
+      }
+    }
+  };
+
+  for (size_t worker_idx = 0; worker_idx < num_workers; ++worker_idx) {
+    futures.push_back(thread_pool.AddTask(AppendCorrespondences, worker_idx));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  for (size_t i = 0; i < num_image_pairs; ++i) {
+    if (images1[i] == nullptr) {
+      continue;
+    }
+    const point2D_t num_correspondences = valid_matches[i].size();
+    images1[i]->num_correspondences += num_correspondences;
+    images2[i]->num_correspondences += num_correspondences;
+    const image_pair_t pair_id =
+        Database::ImagePairToPairId(image_pairs[i].first, image_pairs[i].second);
+    image_pairs_[pair_id].num_correspondences += num_correspondences;
+  }
 }
 
 void CorrespondenceGraph::ExtractCorrespondences(
@@ -270,6 +573,223 @@ void CorrespondenceGraph::ExtractTransitiveCorrespondences(
   corrs->pop_back();
 }
 
+void CorrespondenceGraph::ComputeTracks(const int num_threads) {
+  THROW_CHECK(finalized_);
+
+  const size_t num_flat_points = flat_corr_begs_.size();
+  std::vector<const FlatImage*> flat_images;
+  flat_images.reserve(images_.size());
+  for (const auto& image : images_) {
+    flat_images.push_back(&flat_images_[image.second.flat_image_idx]);
+  }
+
+  ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
+  const size_t num_workers = thread_pool.NumThreads();
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_workers);
+  auto ParallelFor = [&](const size_t num_items,
+                         const std::function<void(size_t, size_t)>& func) {
+    const size_t chunk_size =
+        std::max<size_t>(1, (num_items + num_workers - 1) / num_workers);
+    for (size_t begin = 0; begin < num_items; begin += chunk_size) {
+      futures.push_back(thread_pool.AddTask(
+          func, begin, std::min(begin + chunk_size, num_items)));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+    futures.clear();
+  };
+
+  // Concurrent union-find, in which roots are always linked to smaller roots,
+  // such that concurrent links cannot create cycles.
+  std::vector<std::atomic<size_t>> parents(num_flat_points);
+  ParallelFor(num_flat_points, [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      parents[i].store(i, std::memory_order_relaxed);
+    }
+  });
+
+  auto FindRoot = [&parents](size_t idx) {
+    while (true) {
+      size_t parent = parents[idx].load(std::memory_order_relaxed);
+      if (parent == idx) {
+        return idx;
+      }
+      const size_t grandparent = parents[parent].load(std::memory_order_relaxed);
+      if (grandparent != parent) {
+        // Path halving, which is harmless, if another thread relinked.
+        parents[idx].compare_exchange_weak(
+            parent, grandparent, std::memory_order_relaxed);
+      }
+      idx = grandparent;
+    }
+  };
+
+  auto Union = [&parents, &FindRoot](size_t idx1, size_t idx2) {
+    while (true) {
+      idx1 = FindRoot(idx1);
+      idx2 = FindRoot(idx2);
+      if (idx1 == idx2) {
+        return;
+      }
+      if (idx1 < idx2) {
+        std::swap(idx1, idx2);
+      }
+      size_t expected = idx1;
+      if (parents[idx1].compare_exchange_strong(
+              expected, idx2, std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  };
+
+  ParallelFor(flat_images.size(), [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const FlatImage& image = *flat_images[i];
+      const point2D_t* corr_begs = flat_corr_begs_.data() + image.points2D_beg;
+      const Correspondence* corrs = flat_corrs_.data() + image.corrs_beg;
+      for (point2D_t point2D_idx = 0; point2D_idx < image.num_points2D;
+           ++point2D_idx) {
+        const size_t flat_point_idx = image.points2D_beg + point2D_idx;
+        for (const Correspondence* corr = corrs + corr_begs[point2D_idx];
+             corr < corrs + corr_begs[point2D_idx + 1];
+             ++corr) {
+          const size_t corr_flat_point_idx =
+              GetFlatPointIdx(corr->image_id, corr->point2D_idx);
+          // Every correspondence is stored for both points.
+          if (corr_flat_point_idx > flat_point_idx) {
+            Union(flat_point_idx, corr_flat_point_idx);
+          }
+        }
+      }
+    }
+  });
+
+  // Number the tracks in the order of their roots and count their points.
+  // Points without correspondences are their own roots and have no track.
+  std::vector<size_t> roots(num_flat_points);
+  ParallelFor(num_flat_points, [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      roots[i] = FindRoot(i);
+    }
+  });
+  std::vector<std::atomic<size_t>>().swap(parents);
+
+  std::vector<bool> has_corrs(num_flat_points, false);
+  for (const FlatImage* image : flat_images) {
+    const point2D_t* corr_begs = flat_corr_begs_.data() + image->points2D_beg;
+    for (point2D_t point2D_idx = 0; point2D_idx < image->num_points2D;
+         ++point2D_idx) {
+      has_corrs[image->points2D_beg + point2D_idx] =
+          corr_begs[point2D_idx + 1] > corr_begs[point2D_idx];
+    }
+  }
+
+  point_track_idxs_.assign(num_flat_points, kNoTrackIdx);
+  std::vector<uint32_t> root_track_idxs(num_flat_points, kNoTrackIdx);
+  track_begs_.assign(1, 0);
+  for (size_t i = 0; i < num_flat_points; ++i) {
+    if (!has_corrs[i]) {
+      continue;
+    }
+    uint32_t& track_idx = root_track_idxs[roots[i]];
+    if (track_idx == kNoTrackIdx) {
+      THROW_CHECK_LT(track_begs_.size(), kConflictingTrackIdx);
+      track_idx = track_begs_.size() - 1;
+      track_begs_.push_back(0);
+    }
+    point_track_idxs_[i] = track_idx;
+    track_begs_[track_idx + 1] += 1;
+  }
+  roots = {};
+  root_track_idxs = {};
+  const size_t num_tracks = track_begs_.size() - 1;
+  for (size_t track_idx = 0; track_idx < num_tracks; ++track_idx) {
+    track_begs_[track_idx + 1] += track_begs_[track_idx];
+  }
+
+  // Fill the observations of the tracks in the order of the images.
+  track_corrs_.resize(track_begs_.back());
+  std::vector<size_t> track_ends(track_begs_.begin(), track_begs_.end() - 1);
+  for (const auto& [image_id, image] : images_) {
+    const FlatImage& flat_image = flat_images_[image.flat_image_idx];
+    for (point2D_t point2D_idx = 0; point2D_idx < flat_image.num_points2D;
+         ++point2D_idx) {
+      const uint32_t track_idx =
+          point_track_idxs_[flat_image.points2D_beg + point2D_idx];
+      if (track_idx != kNoTrackIdx) {
+        track_corrs_[track_ends[track_idx]++] =
+            Correspondence(image_id, point2D_idx);
+      }
+    }
+  }
+
+  // Tracks with multiple points in the same image are marked as conflicting.
+  std::vector<char> is_conflicting(num_tracks, false);
+  ParallelFor(num_tracks, [&](const size_t begin, const size_t end) {
+    std::vector<image_t> image_ids;
+    for (size_t track_idx = begin; track_idx < end; ++track_idx) {
+      image_ids.clear();
+      for (size_t i = track_begs_[track_idx]; i < track_begs_[track_idx + 1];
+           ++i) {
+        image_ids.push_back(track_corrs_[i].image_id);
+      }
+      std::sort(image_ids.begin(), image_ids.end());
+      is_conflicting[track_idx] =
+          std::adjacent_find(image_ids.begin(), image_ids.end()) !=
+          image_ids.end();
+    }
+  });
+
+  size_t num_conflicting_tracks = 0;
+  for (size_t track_idx = 0; track_idx < num_tracks; ++track_idx) {
+    if (is_conflicting[track_idx]) {
+      num_conflicting_tracks += 1;
+      for (size_t i = track_begs_[track_idx]; i < track_begs_[track_idx + 1];
+           ++i) {
+        point_track_idxs_[GetFlatPointIdx(track_corrs_[i].image_id,
+                                          track_corrs_[i].point2D_idx)] =
+            kConflictingTrackIdx;
+      }
+    }
+  }
+
+  has_tracks_ = true;
+
+  VLOG(2) << StringPrintf("Computed %d tracks, of which %d are conflicting",
+                          static_cast<int>(num_tracks),
+                          static_cast<int>(num_conflicting_tracks));
+}
+
+bool CorrespondenceGraph::ExtractTrack(
+    const image_t image_id,
+    const point2D_t point2D_idx,
+    std::vector<Correspondence>* corrs) const {
+  if (!has_tracks_) {
+    return false;
+  }
+
+  corrs->clear();
+  const uint32_t track_idx =
+      point_track_idxs_[GetFlatPointIdx(image_id, point2D_idx)];
+  if (track_idx == kConflictingTrackIdx) {
+    return false;
+  } else if (track_idx == kNoTrackIdx) {
+    return true;
+  }
+
+  corrs->reserve(track_begs_[track_idx + 1] - track_begs_[track_idx] - 1);
+  for (size_t i = track_begs_[track_idx]; i < track_begs_[track_idx + 1];
+       ++i) {
+    const Correspondence& corr = track_corrs_[i];
+    if (corr.image_id != image_id) {
+      corrs->push_back(corr);
+    }
+  }
+  return true;
+}
+
 FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
     const image_t image_id1, const image_t image_id2) const {
   const point2D_t num_correspondences =
@@ -281,8 +801,7 @@ FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
   FeatureMatches corrs;
   corrs.reserve(num_correspondences);
 
-  const point2D_t num_points2D1 =
-      images_.at(image_id1).flat_corr_begs.size() - 1;
+  const point2D_t num_points2D1 = GetFlatImage(image_id1).num_points2D;
   for (point2D_t point2D_idx1 = 0; point2D_idx1 < num_points2D1;
        ++point2D_idx1) {
     const CorrespondenceRange range =
@@ -30,8 +30,10 @@
 #pragma once
 
 #include "colmap/scene/database.h"
+#include "colmap/util/logging.h"
 #include "colmap/util/types.h"
 
+#include <limits>
 #include <unordered_map>
 #include <vector>
 
@@ -68,9 +70,15 @@ class CorrespondenceGraph {
   // Number of added images.
   inline size_t NumImagePairs() const;
 
+  // Estimated memory usage of the correspondences and tracks in bytes.
+  size_t NumBytes() const;
+
   // Check whether image exists.
   inline bool ExistsImage(image_t image_id) const;
 
+  // Get the number of image points with which an image was added.
+  inline point2D_t NumPoints2DForImage(image_t image_id) const;
+
   // Get the number of observations in an image. An observation is an image
   // point that has at least one correspondence.
   inline point2D_t NumObservationsForImage(image_t image_id) const;
@@ -105,9 +113,28 @@ class CorrespondenceGraph {
                           image_t image_id2,
                           const FeatureMatches& matches);
 
+  // Add correspondences between many image pairs using multiple threads. The
+  // result is identical to calling `AddCorrespondences` for each image pair in
+  // the given order. Each image pair must occur at most once.
+  void AddCorrespondencesBatch(
+      const std::vector<std::pair<image_t, image_t>>& image_pairs,
+      const std::vector<const FeatureMatches*>& matches,
+      int num_threads = -1);
+
+  // Extend the finalized graph by new images with their number of points and
+  // the correspondences of image pairs, of which at least one image must be
+  // new, e.g., when images are matched while the reconstruction is running.
+  // Only the correspondences of the affected images are flattened again and
+  // new images without observations are discarded as in Finalize(). All
+  // correspondence ranges found before are invalidated.
+  void Extend(const std::vector<std::pair<image_t, size_t>>& new_images,
+              const std::vector<std::pair<image_t, image_t>>& image_pairs,
+              const std::vector<const FeatureMatches*>& matches,
+              int num_threads = -1);
+
   // Find range of correspondences of an image observation to all other images.
-  CorrespondenceRange FindCorrespondences(image_t image_id,
-                                          point2D_t point2D_idx) const;
+  inline CorrespondenceRange FindCorrespondences(image_t image_id,
+                                                 point2D_t point2D_idx) const;
 
   // Helper method to extract found correspondences into a vector.
   void ExtractCorrespondences(image_t image_id,
@@ -128,6 +155,25 @@ class CorrespondenceGraph {
       size_t transitivity,
       std::vector<Correspondence>* corrs) const;
 
+  // Precompute the tracks of the finalized graph using multiple threads, i.e.
+  // the connected components of the image points with correspondences. The
+  // components are found by a concurrent union-find over all correspondences.
+  // Components with multiple points in the same image are conflicting and are
+  // not stored, such that their points fall back to the transitive search.
+  // The tracks are recomputed by Extend().
+  void ComputeTracks(int num_threads = -1);
+
+  // Check whether the tracks were computed.
+  inline bool HasTracks() const;
+
+  // Extract the other observations in the track of the given observation and
+  // return true, or return false, if the tracks were not computed or the track
+  // is conflicting. In contrast to ExtractTransitiveCorrespondences, the
+  // transitivity is not limited and the given observation is not contained.
+  bool ExtractTrack(image_t image_id,
+                    point2D_t point2D_idx,
+                    std::vector<Correspondence>* corrs) const;
+
   // Find all correspondences between two images.
   FeatureMatches FindCorrespondencesBetweenImages(image_t image_id1,
                                                   image_t image_id2) const;
@@ -152,13 +198,19 @@ class CorrespondenceGraph {
     // Correspondences to other images per image point.
     // Added correspondences before Finalize().
     std::vector<std::vector<Correspondence>> corrs;
-    // Flattened correspondences after Finalize().
-    std::vector<Correspondence> flat_corrs;
-    // For each point, determines the beginning of the correspondences in the
-    // flat_corrs vector. The end of point i is determined by the beginning of
-    // the next point. The length of this vector is num_points2D + 1, where the
-    // last element is equivalent to the size of flat_corrs.
-    std::vector<point2D_t> flat_corr_begs;
+
+    // Index into flat_images_ after Finalize().
+    size_t flat_image_idx = 0;
+  };
+
+  // Compressed sparse row layout of the correspondences after Finalize(). The
+  // correspondences of all images are stored in one contiguous array.
+  struct FlatImage {
+    // Beginning of the correspondences of the image in flat_corrs_.
+    size_t corrs_beg = 0;
+    // Beginning of the points of the image in flat_corr_begs_.
+    size_t points2D_beg = 0;
+    point2D_t num_points2D = 0;
   };
 
   struct ImagePair {
@@ -166,9 +218,51 @@ class CorrespondenceGraph {
     point2D_t num_correspondences = 0;
   };
 
+  inline const FlatImage& GetFlatImage(image_t image_id) const;
+
+  // Index of the image point into flat_corr_begs_ and point_track_idxs_.
+  inline size_t GetFlatPointIdx(image_t image_id, point2D_t point2D_idx) const;
+
+  // Append the correspondences of the image to the flattened arrays.
+  void FlattenImage(struct Image* image, FlatImage* flat_image);
+  // Move the flattened correspondences of the image back into its vectors.
+  void UnflattenImage(struct Image* image);
+  // Remove the correspondences of unflattened images from the arrays.
+  void CompactFlatImages();
+  void UpdateFlatImageIdxs();
+
   bool finalized_ = false;
   std::unordered_map<image_t, Image> images_;
   std::unordered_map<image_pair_t, ImagePair> image_pairs_;
+
+  std::vector<FlatImage> flat_images_;
+  // Dense mapping from image identifiers to indices into flat_images_. Only
+  // used if the image identifiers are not too sparse, otherwise the index is
+  // looked up in images_.
+  std::vector<uint32_t> flat_image_idxs_;
+  std::vector<Correspondence> flat_corrs_;
+  // For each point, determines the beginning of its correspondences relative to
+  // the beginning of the correspondences of its image. The end of point i is
+  // determined by the beginning of the next point, so each image stores
+  // num_points2D + 1 entries.
+  std::vector<point2D_t> flat_corr_begs_;
+  // The entries of flat_corrs_ and flat_corr_begs_ that are no longer
+  // referenced after the images were flattened again by Extend().
+  size_t num_garbage_corrs_ = 0;
+  size_t num_garbage_corr_begs_ = 0;
+
+  // Marks points in point_track_idxs_ without track or with a conflicting
+  // track.
+  static constexpr uint32_t kNoTrackIdx = std::numeric_limits<uint32_t>::max();
+  static constexpr uint32_t kConflictingTrackIdx = kNoTrackIdx - 1;
+
+  // Tracks after ComputeTracks() in compressed sparse row layout. Each entry
+  // of flat_corr_begs_ has the index of its track, whose observations are
+  // stored in track_corrs_ from track_begs_[idx] to track_begs_[idx + 1].
+  bool has_tracks_ = false;
+  std::vector<uint32_t> point_track_idxs_;
+  std::vector<size_t> track_begs_;
+  std::vector<Correspondence> track_corrs_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -185,6 +279,14 @@ bool CorrespondenceGraph::ExistsImage(const image_t image_id) const {
   return images_.find(image_id) != images_.end();
 }
 
+point2D_t CorrespondenceGraph::NumPoints2DForImage(
+    const image_t image_id) const {
+  if (finalized_) {
+    return GetFlatImage(image_id).num_points2D;
+  }
+  return images_.at(image_id).corrs.size();
+}
+
 point2D_t CorrespondenceGraph::NumObservationsForImage(
     const image_t image_id) const {
   return images_.at(image_id).num_observations;
@@ -207,6 +309,39 @@ point2D_t CorrespondenceGraph::NumCorrespondencesBetweenImages(
   }
 }
 
+CorrespondenceGraph::CorrespondenceRange
+CorrespondenceGraph::FindCorrespondences(const image_t image_id,
+                                         const point2D_t point2D_idx) const {
+  THROW_CHECK(finalized_);
+  const FlatImage& image = GetFlatImage(image_id);
+  THROW_CHECK_LT(point2D_idx, image.num_points2D);
+  const point2D_t* corr_begs = flat_corr_begs_.data() + image.points2D_beg;
+  const Correspondence* corrs = flat_corrs_.data() + image.corrs_beg;
+  return CorrespondenceRange{corrs + corr_begs[point2D_idx],
+                             corrs + corr_begs[point2D_idx + 1]};
+}
+
+const CorrespondenceGraph::FlatImage& CorrespondenceGraph::GetFlatImage(
+    const image_t image_id) const {
+  if (flat_image_idxs_.empty()) {
+    return flat_images_[images_.at(image_id).flat_image_idx];
+  }
+  THROW_CHECK_LT(image_id, flat_image_idxs_.size());
+  const uint32_t flat_image_idx = flat_image_idxs_[image_id];
+  THROW_CHECK_NE(flat_image_idx, std::numeric_limits<uint32_t>::max())
+      << "Image " << image_id << " does not exist";
+  return flat_images_[flat_image_idx];
+}
+
+size_t CorrespondenceGraph::GetFlatPointIdx(const image_t image_id,
+                                            const point2D_t point2D_idx) const {
+  const FlatImage& image = GetFlatImage(image_id);
+  THROW_CHECK_LT(point2D_idx, image.num_points2D);
+  return image.points2D_beg + point2D_idx;
+}
+
+bool CorrespondenceGraph::HasTracks() const { return has_tracks_; }
+
 bool CorrespondenceGraph::HasCorrespondences(
     const image_t image_id, const point2D_t point2D_idx) const {
   const CorrespondenceRange range = FindCorrespondences(image_id, point2D_idx);
@@ -29,6 +29,8 @@
 
 #include "colmap/scene/correspondence_graph.h"
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -51,6 +53,17 @@ TEST(CorrespondenceGraph, Empty) {
   EXPECT_EQ(correspondence_graph.NumCorrespondencesBetweenImages().size(), 0);
 }
 
+TEST(CorrespondenceGraph, NumBytes) {
+  CorrespondenceGraph correspondence_graph;
+  const size_t empty_num_bytes = correspondence_graph.NumBytes();
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddCorrespondences(0, 1, {{0, 0}, {1, 2}, {3, 7}});
+  correspondence_graph.Finalize();
+  EXPECT_GE(correspondence_graph.NumBytes(),
+            empty_num_bytes + 6 * sizeof(CorrespondenceGraph::Correspondence));
+}
+
 TEST(CorrespondenceGraph, TwoView) {
   CorrespondenceGraph correspondence_graph;
   correspondence_graph.AddImage(0, 10);
@@ -278,5 +291,260 @@ TEST(CorrespondenceGraph, Duplicate) {
             3);
 }
 
+TEST(CorrespondenceGraph, AddCorrespondencesBatch) {
+  constexpr int kNumImages = 20;
+  constexpr int kNumPoints2D = 50;
+  std::srand(0);
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> matches;
+  for (image_t image_id1 = 0; image_id1 < kNumImages; ++image_id1) {
+    for (image_t image_id2 = image_id1 + 1; image_id2 < kNumImages;
+         image_id2 += 3) {
+      image_pairs.emplace_back(image_id1, image_id2);
+      FeatureMatches& pair_matches = matches.emplace_back();
+      for (int i = 0; i < 40; ++i) {
+        // Includes duplicate and out-of-bounds matches.
+        pair_matches.emplace_back(std::rand() % (kNumPoints2D + 2),
+                                  std::rand() % (kNumPoints2D + 2));
+      }
+    }
+  }
+  image_pairs.emplace_back(3, 3);
+  matches.emplace_back(FeatureMatches{{0, 1}});
+
+  std::vector<const FeatureMatches*> matches_ptrs;
+  for (const auto& pair_matches : matches) {
+    matches_ptrs.push_back(&pair_matches);
+  }
+
+  CorrespondenceGraph graph;
+  CorrespondenceGraph batch_graph;
+  for (image_t image_id = 0; image_id < kNumImages; ++image_id) {
+    graph.AddImage(image_id, kNumPoints2D);
+    batch_graph.AddImage(image_id, kNumPoints2D);
+  }
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    graph.AddCorrespondences(
+        image_pairs[i].first, image_pairs[i].second, matches[i]);
+  }
+  batch_graph.AddCorrespondencesBatch(image_pairs, matches_ptrs, 4);
+  graph.Finalize();
+  batch_graph.Finalize();
+
+  EXPECT_EQ(graph.NumImages(), batch_graph.NumImages());
+  EXPECT_EQ(graph.NumImagePairs(), batch_graph.NumImagePairs());
+  EXPECT_EQ(graph.NumCorrespondencesBetweenImages(),
+            batch_graph.NumCorrespondencesBetweenImages());
+  for (image_t image_id = 0; image_id < kNumImages; ++image_id) {
+    ASSERT_EQ(graph.ExistsImage(image_id), batch_graph.ExistsImage(image_id));
+    if (!graph.ExistsImage(image_id)) {
+      continue;
+    }
+    EXPECT_EQ(graph.NumObservationsForImage(image_id),
+              batch_graph.NumObservationsForImage(image_id));
+    EXPECT_EQ(graph.NumCorrespondencesForImage(image_id),
+              batch_graph.NumCorrespondencesForImage(image_id));
+    for (point2D_t point2D_idx = 0; point2D_idx < kNumPoints2D;
+         ++point2D_idx) {
+      std::vector<CorrespondenceGraph::Correspondence> corrs;
+      std::vector<CorrespondenceGraph::Correspondence> batch_corrs;
+      graph.ExtractCorrespondences(image_id, point2D_idx, &corrs);
+      batch_graph.ExtractCorrespondences(image_id, point2D_idx, &batch_corrs);
+      ASSERT_EQ(corrs.size(), batch_corrs.size());
+      for (size_t i = 0; i < corrs.size(); ++i) {
+        EXPECT_EQ(corrs[i].image_id, batch_corrs[i].image_id);
+        EXPECT_EQ(corrs[i].point2D_idx, batch_corrs[i].point2D_idx);
+      }
+    }
+  }
+}
+
+TEST(CorrespondenceGraph, Extend) {
+  constexpr int kNumImages = 20;
+  constexpr int kNumPoints2D = 50;
+  std::srand(0);
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> matches;
+  for (image_t image_id1 = 0; image_id1 < kNumImages; ++image_id1) {
+    for (image_t image_id2 = image_id1 + 1; image_id2 < kNumImages;
+         image_id2 += 3) {
+      image_pairs.emplace_back(image_id1, image_id2);
+      FeatureMatches& pair_matches = matches.emplace_back();
+      for (int i = 0; i < 40; ++i) {
+        pair_matches.emplace_back(std::rand() % (kNumPoints2D + 2),
+                                  std::rand() % (kNumPoints2D + 2));
+      }
+    }
+  }
+
+  CorrespondenceGraph graph;
+  for (image_t image_id = 0; image_id < kNumImages; ++image_id) {
+    graph.AddImage(image_id, kNumPoints2D);
+  }
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    graph.AddCorrespondences(
+        image_pairs[i].first, image_pairs[i].second, matches[i]);
+  }
+  graph.Finalize();
+
+  // The images are added in three steps, where the image pairs are added in
+  // the step of their later image. The last image has no correspondences.
+  const std::vector<image_t> step_image_ids = {0, 10, 15, kNumImages + 1};
+  CorrespondenceGraph extended_graph;
+  for (size_t step = 0; step + 1 < step_image_ids.size(); ++step) {
+    std::vector<std::pair<image_t, size_t>> new_images;
+    for (image_t image_id = step_image_ids[step];
+         image_id < step_image_ids[step + 1];
+         ++image_id) {
+      new_images.emplace_back(image_id, kNumPoints2D);
+    }
+    std::vector<std::pair<image_t, image_t>> step_image_pairs;
+    std::vector<const FeatureMatches*> step_matches;
+    for (size_t i = 0; i < image_pairs.size(); ++i) {
+      const image_t image_id2 = image_pairs[i].second;
+      if (image_id2 >= step_image_ids[step] &&
+          image_id2 < step_image_ids[step + 1]) {
+        step_image_pairs.push_back(image_pairs[i]);
+        step_matches.push_back(&matches[i]);
+      }
+    }
+    if (step == 0) {
+      for (const auto& [image_id, num_points2D] : new_images) {
+        extended_graph.AddImage(image_id, num_points2D);
+      }
+      extended_graph.AddCorrespondencesBatch(step_image_pairs, step_matches);
+      extended_graph.Finalize();
+    } else {
+      extended_graph.Extend(new_images, step_image_pairs, step_matches);
+    }
+  }
+
+  EXPECT_FALSE(extended_graph.ExistsImage(kNumImages));
+  EXPECT_EQ(graph.NumImages(), extended_graph.NumImages());
+  EXPECT_EQ(graph.NumImagePairs(), extended_graph.NumImagePairs());
+  EXPECT_EQ(graph.NumCorrespondencesBetweenImages(),
+            extended_graph.NumCorrespondencesBetweenImages());
+  for (image_t image_id = 0; image_id < kNumImages; ++image_id) {
+    ASSERT_EQ(graph.ExistsImage(image_id),
+              extended_graph.ExistsImage(image_id));
+    if (!graph.ExistsImage(image_id)) {
+      continue;
+    }
+    EXPECT_EQ(graph.NumPoints2DForImage(image_id),
+              extended_graph.NumPoints2DForImage(image_id));
+    EXPECT_EQ(graph.NumObservationsForImage(image_id),
+              extended_graph.NumObservationsForImage(image_id));
+    EXPECT_EQ(graph.NumCorrespondencesForImage(image_id),
+              extended_graph.NumCorrespondencesForImage(image_id));
+    for (point2D_t point2D_idx = 0; point2D_idx < kNumPoints2D;
+         ++point2D_idx) {
+      std::vector<CorrespondenceGraph::Correspondence> corrs;
+      std::vector<CorrespondenceGraph::Correspondence> extended_corrs;
+      graph.ExtractCorrespondences(image_id, point2D_idx, &corrs);
+      extended_graph.ExtractCorrespondences(
+          image_id, point2D_idx, &extended_corrs);
+      ASSERT_EQ(corrs.size(), extended_corrs.size());
+      for (size_t i = 0; i < corrs.size(); ++i) {
+        EXPECT_EQ(corrs[i].image_id, extended_corrs[i].image_id);
+        EXPECT_EQ(corrs[i].point2D_idx, extended_corrs[i].point2D_idx);
+      }
+    }
+  }
+
+  // Image pairs between existing images cannot be added.
+  const FeatureMatches existing_matches = {{0, 0}};
+  EXPECT_ANY_THROW(
+      extended_graph.Extend({}, {{0, 1}}, {&existing_matches}));
+}
+
+TEST(CorrespondenceGraph, Tracks) {
+  CorrespondenceGraph correspondence_graph;
+  for (image_t image_id = 0; image_id < 4; ++image_id) {
+    correspondence_graph.AddImage(image_id, 10);
+  }
+  // A chain of correspondences through all images and a conflicting track,
+  // which contains two points of the first image.
+  const FeatureMatches matches01 = {{0, 0}, {1, 1}};
+  correspondence_graph.AddCorrespondences(0, 1, matches01);
+  const FeatureMatches matches12 = {{0, 0}, {1, 1}};
+  correspondence_graph.AddCorrespondences(1, 2, matches12);
+  const FeatureMatches matches23 = {{0, 0}};
+  correspondence_graph.AddCorrespondences(2, 3, matches23);
+  const FeatureMatches matches20 = {{1, 2}};
+  correspondence_graph.AddCorrespondences(2, 0, matches20);
+  correspondence_graph.Finalize();
+
+  std::vector<CorrespondenceGraph::Correspondence> corrs;
+  EXPECT_FALSE(correspondence_graph.HasTracks());
+  EXPECT_FALSE(correspondence_graph.ExtractTrack(0, 0, &corrs));
+
+  correspondence_graph.ComputeTracks();
+  EXPECT_TRUE(correspondence_graph.HasTracks());
+
+  auto ExpectTrack = [&](const image_t image_id,
+                         const point2D_t point2D_idx,
+                         const std::vector<image_t>& expected_image_ids) {
+    ASSERT_TRUE(
+        correspondence_graph.ExtractTrack(image_id, point2D_idx, &corrs));
+    std::vector<image_t> image_ids;
+    for (const auto& corr : corrs) {
+      EXPECT_EQ(corr.point2D_idx, 0);
+      image_ids.push_back(corr.image_id);
+    }
+    std::sort(image_ids.begin(), image_ids.end());
+    EXPECT_EQ(image_ids, expected_image_ids);
+  };
+
+  ExpectTrack(0, 0, {1, 2, 3});
+  ExpectTrack(3, 0, {0, 1, 2});
+  EXPECT_EQ(CountNumTransitiveCorrespondences(correspondence_graph, 0, 0, 2),
+            2);
+
+  EXPECT_FALSE(correspondence_graph.ExtractTrack(0, 1, &corrs));
+  EXPECT_FALSE(correspondence_graph.ExtractTrack(1, 1, &corrs));
+  EXPECT_FALSE(correspondence_graph.ExtractTrack(0, 2, &corrs));
+
+  EXPECT_TRUE(correspondence_graph.ExtractTrack(0, 5, &corrs));
+  EXPECT_TRUE(corrs.empty());
+
+  // The tracks are recomputed when the graph is extended.
+  const FeatureMatches matches34 = {{0, 0}};
+  correspondence_graph.Extend({{4, 10}}, {{3, 4}}, {&matches34});
+  EXPECT_TRUE(correspondence_graph.HasTracks());
+  ExpectTrack(0, 0, {1, 2, 3, 4});
+  ExpectTrack(4, 0, {0, 1, 2, 3});
+}
+
 }  // namespace
+TEST(CorrespondenceGraph, SparseImageIds) {
+  // Sparse image identifiers fall back to hashed lookups after Finalize().
+  for (const image_t image_id_offset : {0, 1000000}) {
+    const image_t image_id1 = image_id_offset + 1;
+    const image_t image_id2 = image_id_offset + 5;
+    const image_t image_id3 = 2 * image_id_offset + 7;
+    CorrespondenceGraph correspondence_graph;
+    correspondence_graph.AddImage(image_id1, 3);
+    correspondence_graph.AddImage(image_id2, 2);
+    correspondence_graph.AddImage(image_id3, 1);
+    FeatureMatches matches(2);
+    matches[0].point2D_idx1 = 0;
+    matches[0].point2D_idx2 = 1;
+    matches[1].point2D_idx1 = 2;
+    matches[1].point2D_idx2 = 0;
+    correspondence_graph.AddCorrespondences(image_id1, image_id2, matches);
+    correspondence_graph.Finalize();
+    EXPECT_FALSE(correspondence_graph.ExistsImage(image_id3));
+    EXPECT_FALSE(correspondence_graph.HasCorrespondences(image_id1, 1));
+    EXPECT_TRUE(correspondence_graph.HasCorrespondences(image_id1, 2));
+    const auto range = correspondence_graph.FindCorrespondences(image_id2, 1);
+    ASSERT_EQ(range.end - range.beg, 1);
+    EXPECT_EQ(range.beg->image_id, image_id1);
+    EXPECT_EQ(range.beg->point2D_idx, 0);
+    EXPECT_ANY_THROW(correspondence_graph.FindCorrespondences(image_id1, 3));
+    EXPECT_ANY_THROW(correspondence_graph.FindCorrespondences(image_id3, 0));
+    EXPECT_ANY_THROW(
+        correspondence_graph.FindCorrespondences(image_id3 + 1000, 0));
+  }
+}
+
 }  // namespace colmap
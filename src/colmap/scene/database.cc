@@ -31,14 +31,184 @@
 
 #include "colmap/util/sqlite3_utils.h"
 #include "colmap/util/string.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/version.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <memory>
 
+#include <lz4.h>
+
 namespace colmap {
 namespace {
 
+// Blobs of descriptors and matches can optionally be compressed. Uncompressed
+// blobs contain the raw matrix data. Compressed blobs are always smaller than
+// the raw data, which identifies them, and start with a versioned header
+// followed by the LZ4 compressed and possibly transformed matrix data.
+struct CompressedBlobHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t transform;
+  uint16_t reserved;
+  uint64_t num_transformed_bytes;
+};
+
+constexpr uint32_t kCompressedBlobMagic = 0x5A4C4243;  // "CBLZ"
+constexpr uint8_t kCompressedBlobVersion = 1;
+
+// The matches are stored column by column instead of row by row.
+constexpr uint8_t kTransformColumnMajor = 1;
+// The first column of the matches is sorted and delta encoded.
+constexpr uint8_t kTransformDelta = 2;
+// All (delta encoded) match indices are stored as 16-bit integers.
+constexpr uint8_t kTransformUInt16 = 4;
+
+template <typename MatrixType>
+uint8_t TransformMatrixBlob(const MatrixType& matrix, std::string* bytes) {
+  const size_t num_bytes = matrix.size() * sizeof(typename MatrixType::Scalar);
+  bytes->resize(num_bytes);
+  std::memcpy(bytes->data(), matrix.data(), num_bytes);
+  return 0;
+}
+
+// Matches are mostly sorted by the first index and the indices are often
+// small, so storing them by column with delta encoding and 16-bit integers
+// makes the data much smaller and more compressible.
+uint8_t TransformMatrixBlob(const FeatureMatchesBlob& matches,
+                            std::string* bytes) {
+  const Eigen::Index num_matches = matches.rows();
+  uint8_t transform = kTransformColumnMajor;
+  bool sorted = true;
+  for (Eigen::Index i = 1; i < num_matches && sorted; ++i) {
+    sorted = matches(i, 0) >= matches(i - 1, 0);
+  }
+  if (sorted) {
+    transform |= kTransformDelta;
+  }
+
+  std::vector<point2D_t> values(2 * num_matches);
+  point2D_t max_value = 0;
+  for (Eigen::Index i = 0; i < num_matches; ++i) {
+    values[i] = (sorted && i > 0) ? matches(i, 0) - matches(i - 1, 0)
+                                  : matches(i, 0);
+    values[num_matches + i] = matches(i, 1);
+    max_value = std::max(max_value, std::max(values[i], matches(i, 1)));
+  }
+
+  if (max_value <= std::numeric_limits<uint16_t>::max()) {
+    transform |= kTransformUInt16;
+    bytes->resize(values.size() * sizeof(uint16_t));
+    uint16_t* values16 = reinterpret_cast<uint16_t*>(bytes->data());
+    for (size_t i = 0; i < values.size(); ++i) {
+      values16[i] = static_cast<uint16_t>(values[i]);
+    }
+  } else {
+    bytes->resize(values.size() * sizeof(point2D_t));
+    std::memcpy(bytes->data(), values.data(), bytes->size());
+  }
+
+  return transform;
+}
+
+template <typename MatrixType>
+void InverseTransformMatrixBlob(const uint8_t transform,
+                                const std::string& bytes,
+                                MatrixType* matrix) {
+  THROW_CHECK_EQ(transform, 0) << "Unsupported blob transform";
+  THROW_CHECK_EQ(bytes.size(),
+                 matrix->size() * sizeof(typename MatrixType::Scalar));
+  std::memcpy(matrix->data(), bytes.data(), bytes.size());
+}
+
+void InverseTransformMatrixBlob(const uint8_t transform,
+                                const std::string& bytes,
+                                FeatureMatchesBlob* matches) {
+  THROW_CHECK(transform & kTransformColumnMajor)
+      << "Unsupported blob transform";
+  const Eigen::Index num_matches = matches->rows();
+  std::vector<point2D_t> values(2 * num_matches);
+  if (transform & kTransformUInt16) {
+    THROW_CHECK_EQ(bytes.size(), values.size() * sizeof(uint16_t));
+    const uint16_t* values16 = reinterpret_cast<const uint16_t*>(bytes.data());
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = values16[i];
+    }
+  } else {
+    THROW_CHECK_EQ(bytes.size(), values.size() * sizeof(point2D_t));
+    std::memcpy(values.data(), bytes.data(), bytes.size());
+  }
+
+  for (Eigen::Index i = 0; i < num_matches; ++i) {
+    (*matches)(i, 0) = ((transform & kTransformDelta) && i > 0)
+                           ? (*matches)(i - 1, 0) + values[i]
+                           : values[i];
+    (*matches)(i, 1) = values[num_matches + i];
+  }
+}
+
+// Returns false if the compressed blob would not be smaller than the raw data,
+// in which case the raw data must be stored.
+template <typename MatrixType>
+bool CompressMatrixBlob(const MatrixType& matrix, std::string* blob) {
+  const size_t num_raw_bytes =
+      matrix.size() * sizeof(typename MatrixType::Scalar);
+  if (num_raw_bytes <= sizeof(CompressedBlobHeader)) {
+    return false;
+  }
+
+  std::string bytes;
+  CompressedBlobHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kCompressedBlobMagic;
+  header.version = kCompressedBlobVersion;
+  header.transform = TransformMatrixBlob(matrix, &bytes);
+  header.num_transformed_bytes = bytes.size();
+  if (bytes.size() > LZ4_MAX_INPUT_SIZE) {
+    return false;
+  }
+
+  blob->resize(sizeof(header) + LZ4_compressBound(bytes.size()));
+  std::memcpy(blob->data(), &header, sizeof(header));
+  const int num_bytes = LZ4_compress_default(bytes.data(),
+                                             blob->data() + sizeof(header),
+                                             bytes.size(),
+                                             blob->size() - sizeof(header));
+  if (num_bytes <= 0 || sizeof(header) + num_bytes >= num_raw_bytes) {
+    return false;
+  }
+  blob->resize(sizeof(header) + num_bytes);
+  return true;
+}
+
+template <typename MatrixType>
+void DecompressMatrixBlob(const char* blob,
+                          const size_t num_bytes,
+                          MatrixType* matrix) {
+  CompressedBlobHeader header;
+  THROW_CHECK_GE(num_bytes, sizeof(header)) << "Corrupt blob";
+  std::memcpy(&header, blob, sizeof(header));
+  THROW_CHECK_EQ(header.magic, kCompressedBlobMagic) << "Corrupt blob";
+  THROW_CHECK_LE(header.version, kCompressedBlobVersion)
+      << "Blob was written by a newer version of COLMAP";
+  THROW_CHECK_LE(header.num_transformed_bytes, LZ4_MAX_INPUT_SIZE);
+
+  std::string bytes(header.num_transformed_bytes, '\0');
+  const int num_transformed_bytes =
+      LZ4_decompress_safe(blob + sizeof(header),
+                          bytes.data(),
+                          num_bytes - sizeof(header),
+                          header.num_transformed_bytes);
+  THROW_CHECK_EQ(num_transformed_bytes,
+                 static_cast<int>(header.num_transformed_bytes))
+      << "Corrupt blob";
+  InverseTransformMatrixBlob(header.transform, bytes, matrix);
+}
+
 void SwapFeatureMatchesBlob(FeatureMatchesBlob* matches) {
   matches->col(0).swap(matches->col(1));
 }
@@ -151,12 +321,16 @@ MatrixType ReadDynamicMatrixBlob(sqlite3_stmt* sql_stmt,
 
     const size_t num_bytes =
         static_cast<size_t>(sqlite3_column_bytes(sql_stmt, col + 2));
-    THROW_CHECK_EQ(matrix.size() * sizeof(typename MatrixType::Scalar),
-                   num_bytes);
-
-    memcpy(reinterpret_cast<char*>(matrix.data()),
-           sqlite3_column_blob(sql_stmt, col + 2),
-           num_bytes);
+    const size_t num_raw_bytes =
+        matrix.size() * sizeof(typename MatrixType::Scalar);
+    const char* blob =
+        static_cast<const char*>(sqlite3_column_blob(sql_stmt, col + 2));
+    if (num_bytes == num_raw_bytes) {
+      memcpy(reinterpret_cast<char*>(matrix.data()), blob, num_bytes);
+    } else {
+      THROW_CHECK_LT(num_bytes, num_raw_bytes);
+      DecompressMatrixBlob(blob, num_bytes, &matrix);
+    }
   } else {
     const typename MatrixType::Index rows =
         (MatrixType::RowsAtCompileTime == Eigen::Dynamic)
@@ -189,14 +363,26 @@ void WriteStaticMatrixBlob(sqlite3_stmt* sql_stmt,
 template <typename MatrixType>
 void WriteDynamicMatrixBlob(sqlite3_stmt* sql_stmt,
                             const MatrixType& matrix,
-                            const int col) {
+                            const int col,
+                            const bool compress = false) {
   THROW_CHECK_GE(matrix.rows(), 0);
   THROW_CHECK_GE(matrix.cols(), 0);
   THROW_CHECK_GE(col, 0);
 
-  const size_t num_bytes = matrix.size() * sizeof(typename MatrixType::Scalar);
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 0, matrix.rows()));
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 1, matrix.cols()));
+
+  std::string compressed_blob;
+  if (compress && CompressMatrixBlob(matrix, &compressed_blob)) {
+    SQLITE3_CALL(sqlite3_bind_blob(sql_stmt,
+                                   col + 2,
+                                   compressed_blob.data(),
+                                   static_cast<int>(compressed_blob.size()),
+                                   SQLITE_TRANSIENT));
+    return;
+  }
+
+  const size_t num_bytes = matrix.size() * sizeof(typename MatrixType::Scalar);
   SQLITE3_CALL(sqlite3_bind_blob(sql_stmt,
                                  col + 2,
                                  reinterpret_cast<const char*>(matrix.data()),
@@ -237,6 +423,151 @@ Image ReadImageRow(sqlite3_stmt* sql_stmt) {
   return image;
 }
 
+// Undecoded rows of a table, whose first column is the image or pair id.
+struct RawTableRows {
+  struct ValueDeleter {
+    void operator()(sqlite3_value* value) const { sqlite3_value_free(value); }
+  };
+
+  size_t NumRows() const {
+    return num_columns == 0 ? 0 : values.size() / num_columns;
+  }
+  sqlite3_value* Value(const size_t row, const int col) const {
+    return values[row * num_columns + col].get();
+  }
+
+  int num_columns = 0;
+  std::vector<std::unique_ptr<sqlite3_value, ValueDeleter>> values;
+};
+
+// Tables that are copied row by row when merging databases. If the rows must
+// be decoded, e.g., to compress their blobs, they are copied through the typed
+// interface of the database instead.
+struct MergeImageTable {
+  const char* name;
+  const char* columns;
+  void (*copy_decoded)(const Database& database,
+                       image_t image_id,
+                       image_t new_image_id,
+                       Database* merged_database);
+};
+
+struct MergePairTable {
+  const char* name;
+  const char* columns;
+  void (*copy_decoded)(const Database& database,
+                       image_t image_id1,
+                       image_t image_id2,
+                       image_t new_image_id1,
+                       image_t new_image_id2,
+                       Database* merged_database);
+};
+
+const MergeImageTable kMergeImageTables[] = {
+    {"pose_priors", "image_id, position, coordinate_system", nullptr},
+    {"image_signatures",
+     "image_id, file_size, modification_time, hash",
+     nullptr},
+    {"global_descriptors", "image_id, rows, cols, data", nullptr},
+    {"keypoints", "image_id, rows, cols, data", nullptr},
+    {"descriptors",
+     "image_id, rows, cols, data, type",
+     [](const Database& database,
+        const image_t image_id,
+        const image_t new_image_id,
+        Database* merged_database) {
+       merged_database->WriteDescriptors(
+           new_image_id,
+           database.ReadDescriptors(image_id),
+           database.ReadDescriptorsType(image_id));
+     }},
+};
+
+const MergePairTable kMergePairTables[] = {
+    {"matches",
+     "pair_id, rows, cols, data",
+     [](const Database& database,
+        const image_t image_id1,
+        const image_t image_id2,
+        const image_t new_image_id1,
+        const image_t new_image_id2,
+        Database* merged_database) {
+       merged_database->WriteMatches(
+           new_image_id1,
+           new_image_id2,
+           database.ReadMatches(image_id1, image_id2));
+     }},
+    {"two_view_geometries",
+     "pair_id, rows, cols, data, config, F, E, H, qvec, tvec",
+     [](const Database& database,
+        const image_t image_id1,
+        const image_t image_id2,
+        const image_t new_image_id1,
+        const image_t new_image_id2,
+        Database* merged_database) {
+       merged_database->WriteTwoViewGeometry(
+           new_image_id1,
+           new_image_id2,
+           database.ReadTwoViewGeometry(image_id1, image_id2));
+     }},
+};
+
+RawTableRows ReadRawTableRows(sqlite3* database,
+                              const char* table,
+                              const char* columns) {
+  const std::string sql = StringPrintf("SELECT %s FROM %s;", columns, table);
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database, sql.c_str(), -1, &sql_stmt, 0));
+
+  RawTableRows rows;
+  rows.num_columns = sqlite3_column_count(sql_stmt);
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+    for (int col = 0; col < rows.num_columns; ++col) {
+      sqlite3_value* value =
+          sqlite3_value_dup(sqlite3_column_value(sql_stmt, col));
+      THROW_CHECK_NOTNULL(value);
+      rows.values.emplace_back(value);
+    }
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return rows;
+}
+
+struct StatementFinalizer {
+  void operator()(sqlite3_stmt* sql_stmt) const { sqlite3_finalize(sql_stmt); }
+};
+
+std::unique_ptr<sqlite3_stmt, StatementFinalizer> PrepareRawTableInsert(
+    sqlite3* database, const char* table, const char* columns) {
+  const int num_columns =
+      std::count(columns, columns + std::strlen(columns), ',') + 1;
+  std::string placeholders = "?";
+  for (int col = 1; col < num_columns; ++col) {
+    placeholders += ", ?";
+  }
+  const std::string sql = StringPrintf("INSERT INTO %s (%s) VALUES (%s);",
+                                       table,
+                                       columns,
+                                       placeholders.c_str());
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database, sql.c_str(), -1, &sql_stmt, 0));
+  return std::unique_ptr<sqlite3_stmt, StatementFinalizer>(sql_stmt);
+}
+
+void WriteRawTableRow(sqlite3_stmt* sql_stmt,
+                      const RawTableRows& rows,
+                      const size_t row,
+                      const sqlite3_int64 id) {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, id));
+  for (int col = 1; col < rows.num_columns; ++col) {
+    SQLITE3_CALL(sqlite3_bind_value(sql_stmt, col + 1, rows.Value(row, col)));
+  }
+  SQLITE3_CALL(sqlite3_step(sql_stmt));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt));
+}
+
 }  // namespace
 
 const size_t Database::kMaxNumImages =
@@ -297,6 +628,28 @@ void Database::Close() {
   }
 }
 
+void Database::SetProfile(const Profile profile) const {
+  switch (profile) {
+    case Profile::DEFAULT:
+      // The default values of SQLite.
+      SQLITE3_EXEC(database_, "PRAGMA cache_size=-2000", nullptr);
+      SQLITE3_EXEC(database_, "PRAGMA mmap_size=0", nullptr);
+      SQLITE3_EXEC(database_, "PRAGMA wal_autocheckpoint=1000", nullptr);
+      break;
+    case Profile::BULK:
+      // Use 256MB of page cache, memory map up to 1GB of the database, and
+      // only checkpoint the write-ahead log after 64MB of 4KB pages.
+      SQLITE3_EXEC(database_, "PRAGMA cache_size=-262144", nullptr);
+      SQLITE3_EXEC(database_, "PRAGMA mmap_size=1073741824", nullptr);
+      SQLITE3_EXEC(database_, "PRAGMA wal_autocheckpoint=16384", nullptr);
+      break;
+  }
+}
+
+void Database::SetBlobCompression(const bool compress) {
+  compress_blobs_ = compress;
+}
+
 bool Database::ExistsCamera(const camera_t camera_id) const {
   return ExistsRowId(sql_stmt_exists_camera_, camera_id);
 }
@@ -313,6 +666,14 @@ bool Database::ExistsPosePrior(const image_t image_id) const {
   return ExistsRowId(sql_stmt_exists_pose_prior_, image_id);
 }
 
+bool Database::ExistsImageSignature(const image_t image_id) const {
+  return ExistsRowId(sql_stmt_exists_image_signature_, image_id);
+}
+
+bool Database::ExistsGlobalDescriptor(const image_t image_id) const {
+  return ExistsRowId(sql_stmt_exists_global_descriptor_, image_id);
+}
+
 bool Database::ExistsKeypoints(const image_t image_id) const {
   return ExistsRowId(sql_stmt_exists_keypoints_, image_id);
 }
@@ -339,6 +700,14 @@ size_t Database::NumImages() const { return CountRows("images"); }
 
 size_t Database::NumPosePriors() const { return CountRows("pose_priors"); }
 
+size_t Database::NumImageSignatures() const {
+  return CountRows("image_signatures");
+}
+
+size_t Database::NumGlobalDescriptors() const {
+  return CountRows("global_descriptors");
+}
+
 size_t Database::NumKeypoints() const { return SumColumn("rows", "keypoints"); }
 
 size_t Database::MaxNumKeypoints() const {
@@ -367,6 +736,12 @@ size_t Database::NumInlierMatches() const {
   return SumColumn("rows", "two_view_geometries");
 }
 
+size_t Database::NumInlierMatchesForImagePair(const image_t image_id1,
+                                              const image_t image_id2) const {
+  return CountRowsForEntry(sql_stmt_num_inlier_matches_,
+                           ImagePairToPairId(image_id1, image_id2));
+}
+
 size_t Database::NumMatchedImagePairs() const { return CountRows("matches"); }
 
 size_t Database::NumVerifiedImagePairs() const {
@@ -400,6 +775,25 @@ std::vector<Camera> Database::ReadAllCameras() const {
   return cameras;
 }
 
+std::vector<Camera> Database::ReadCamerasPage(
+    const size_t offset, const size_t max_num_cameras) const {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_cameras_page_,
+                                  1,
+                                  static_cast<sqlite3_int64>(max_num_cameras)));
+  SQLITE3_CALL(sqlite3_bind_int64(
+      sql_stmt_read_cameras_page_, 2, static_cast<sqlite3_int64>(offset)));
+
+  std::vector<Camera> cameras;
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt_read_cameras_page_)) ==
+         SQLITE_ROW) {
+    cameras.push_back(ReadCameraRow(sql_stmt_read_cameras_page_));
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_cameras_page_));
+
+  return cameras;
+}
+
 Image Database::ReadImage(const image_t image_id) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_image_id_, 1, image_id));
 
@@ -447,6 +841,25 @@ std::vector<Image> Database::ReadAllImages() const {
   return images;
 }
 
+std::vector<Image> Database::ReadImagesPage(
+    const size_t offset, const size_t max_num_images) const {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_images_page_,
+                                  1,
+                                  static_cast<sqlite3_int64>(max_num_images)));
+  SQLITE3_CALL(sqlite3_bind_int64(
+      sql_stmt_read_images_page_, 2, static_cast<sqlite3_int64>(offset)));
+
+  std::vector<Image> images;
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt_read_images_page_)) ==
+         SQLITE_ROW) {
+    images.push_back(ReadImageRow(sql_stmt_read_images_page_));
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_images_page_));
+
+  return images;
+}
+
 PosePrior Database::ReadPosePrior(const image_t image_id) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_pose_prior_, 1, image_id));
   PosePrior prior;
@@ -461,6 +874,35 @@ PosePrior Database::ReadPosePrior(const image_t image_id) const {
   return prior;
 }
 
+FileSignature Database::ReadImageSignature(const image_t image_id) const {
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_read_image_signature_, 1, image_id));
+  FileSignature signature;
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_image_signature_));
+  if (rc == SQLITE_ROW) {
+    signature.size = static_cast<uint64_t>(
+        sqlite3_column_int64(sql_stmt_read_image_signature_, 1));
+    signature.modification_time = static_cast<int64_t>(
+        sqlite3_column_int64(sql_stmt_read_image_signature_, 2));
+    signature.hash = static_cast<uint64_t>(
+        sqlite3_column_int64(sql_stmt_read_image_signature_, 3));
+  }
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_image_signature_));
+  return signature;
+}
+
+Eigen::VectorXf Database::ReadGlobalDescriptor(const image_t image_id) const {
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_read_global_descriptor_, 1, image_id));
+
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_global_descriptor_));
+  Eigen::VectorXf descriptor = ReadDynamicMatrixBlob<Eigen::VectorXf>(
+      sql_stmt_read_global_descriptor_, rc, 0);
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_global_descriptor_));
+  return descriptor;
+}
+
 FeatureKeypointsBlob Database::ReadKeypointsBlob(const image_t image_id) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_keypoints_, 1, image_id));
 
@@ -488,6 +930,23 @@ FeatureDescriptors Database::ReadDescriptors(const image_t image_id) const {
   return descriptors;
 }
 
+FeatureDescriptorType Database::ReadDescriptorsType(
+    const image_t image_id) const {
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_read_descriptors_type_, 1, image_id));
+
+  FeatureDescriptorType type = FeatureDescriptorType::SIFT;
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_descriptors_type_));
+  if (rc == SQLITE_ROW) {
+    type = static_cast<FeatureDescriptorType>(
+        sqlite3_column_int(sql_stmt_read_descriptors_type_, 0));
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_descriptors_type_));
+
+  return type;
+}
+
 FeatureMatchesBlob Database::ReadMatchesBlob(image_t image_id1,
                                              image_t image_id2) const {
   const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
@@ -513,20 +972,66 @@ FeatureMatches Database::ReadMatches(image_t image_id1,
 std::vector<std::pair<image_pair_t, FeatureMatches>> Database::ReadAllMatches()
     const {
   std::vector<std::pair<image_pair_t, FeatureMatches>> all_matches;
+  VisitMatches(nullptr,
+               [&all_matches](const image_pair_t pair_id,
+                              FeatureMatches&& matches) {
+                 all_matches.emplace_back(pair_id, std::move(matches));
+               });
+  return all_matches;
+}
 
-  int rc;
-  while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_matches_all_))) ==
-         SQLITE_ROW) {
-    const image_pair_t pair_id = static_cast<image_pair_t>(
-        sqlite3_column_int64(sql_stmt_read_matches_all_, 0));
-    const FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-        sql_stmt_read_matches_all_, rc, 1);
-    all_matches.emplace_back(pair_id, FeatureMatchesFromBlob(blob));
-  }
+void Database::VisitMatches(
+    const ImagePairFilter& filter,
+    const std::function<void(image_pair_t, FeatureMatches&&)>& visitor) const {
+  VisitMatchesRows(sql_stmt_read_matches_all_,
+                   filter,
+                   [&](const image_pair_t pair_id, FeatureMatchesBlob&& blob) {
+                     visitor(pair_id, FeatureMatchesFromBlob(blob));
+                   });
+}
 
-  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_matches_all_));
+std::vector<std::pair<image_pair_t, FeatureMatchesBlob>>
+Database::ReadMatchesChunk(const image_pair_t prev_pair_id,
+                           const size_t max_num_pairs) const {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_matches_chunk_,
+                                  1,
+                                  static_cast<sqlite3_int64>(prev_pair_id)));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_matches_chunk_,
+                                  2,
+                                  static_cast<sqlite3_int64>(max_num_pairs)));
+  std::vector<std::pair<image_pair_t, FeatureMatchesBlob>> chunk;
+  VisitMatchesRows(sql_stmt_read_matches_chunk_,
+                   nullptr,
+                   [&](const image_pair_t pair_id, FeatureMatchesBlob&& blob) {
+                     chunk.emplace_back(pair_id, std::move(blob));
+                   });
+  return chunk;
+}
+
+void Database::VisitMatchesRows(
+    sqlite3_stmt* sql_stmt,
+    const ImagePairFilter& filter,
+    const std::function<void(image_pair_t, FeatureMatchesBlob&&)>& visitor)
+    const {
+  try {
+    int rc;
+    while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt))) == SQLITE_ROW) {
+      const image_pair_t pair_id =
+          static_cast<image_pair_t>(sqlite3_column_int64(sql_stmt, 0));
+      const size_t num_matches =
+          static_cast<size_t>(sqlite3_column_int64(sql_stmt, 1));
+      if (filter && !filter(pair_id, num_matches)) {
+        continue;
+      }
+      visitor(pair_id,
+              ReadDynamicMatrixBlob<FeatureMatchesBlob>(sql_stmt, rc, 1));
+    }
+  } catch (...) {
+    sqlite3_reset(sql_stmt);
+    throw;
+  }
 
-  return all_matches;
+  SQLITE3_CALL(sqlite3_reset(sql_stmt));
 }
 
 TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
@@ -576,44 +1081,101 @@ TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
 void Database::ReadTwoViewGeometries(
     std::vector<image_pair_t>* image_pair_ids,
     std::vector<TwoViewGeometry>* two_view_geometries) const {
-  int rc;
-  while ((rc = SQLITE3_CALL(sqlite3_step(
-              sql_stmt_read_two_view_geometries_))) == SQLITE_ROW) {
-    const image_pair_t pair_id = static_cast<image_pair_t>(
-        sqlite3_column_int64(sql_stmt_read_two_view_geometries_, 0));
-    image_pair_ids->push_back(pair_id);
-
-    TwoViewGeometry two_view_geometry;
-
-    const FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-        sql_stmt_read_two_view_geometries_, rc, 1);
-    two_view_geometry.inlier_matches = FeatureMatchesFromBlob(blob);
+  VisitTwoViewGeometries(
+      nullptr,
+      [&](const image_pair_t pair_id, TwoViewGeometry&& two_view_geometry) {
+        image_pair_ids->push_back(pair_id);
+        two_view_geometries->push_back(std::move(two_view_geometry));
+      });
+}
 
-    two_view_geometry.config = static_cast<int>(
-        sqlite3_column_int64(sql_stmt_read_two_view_geometries_, 4));
+void Database::VisitTwoViewGeometries(
+    const ImagePairFilter& filter,
+    const std::function<void(image_pair_t, TwoViewGeometry&&)>& visitor)
+    const {
+  VisitTwoViewGeometriesRows(
+      sql_stmt_read_two_view_geometries_, filter, visitor);
+}
 
-    two_view_geometry.F = ReadStaticMatrixBlob<Eigen::Matrix3d>(
-        sql_stmt_read_two_view_geometries_, rc, 5);
-    two_view_geometry.E = ReadStaticMatrixBlob<Eigen::Matrix3d>(
-        sql_stmt_read_two_view_geometries_, rc, 6);
-    two_view_geometry.H = ReadStaticMatrixBlob<Eigen::Matrix3d>(
-        sql_stmt_read_two_view_geometries_, rc, 7);
-    const Eigen::Vector4d quat_wxyz = ReadStaticMatrixBlob<Eigen::Vector4d>(
-        sql_stmt_read_two_view_geometries_, rc, 8);
-    two_view_geometry.cam2_from_cam1.rotation = Eigen::Quaterniond(
-        quat_wxyz(0), quat_wxyz(1), quat_wxyz(2), quat_wxyz(3));
-    two_view_geometry.cam2_from_cam1.translation =
-        ReadStaticMatrixBlob<Eigen::Vector3d>(
-            sql_stmt_read_two_view_geometries_, rc, 9);
+std::vector<std::pair<image_pair_t, TwoViewGeometry>>
+Database::ReadTwoViewGeometriesChunk(const image_pair_t prev_pair_id,
+                                     const size_t max_num_pairs) const {
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_read_two_view_geometries_chunk_,
+                         1,
+                         static_cast<sqlite3_int64>(prev_pair_id)));
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_read_two_view_geometries_chunk_,
+                         2,
+                         static_cast<sqlite3_int64>(max_num_pairs)));
+  std::vector<std::pair<image_pair_t, TwoViewGeometry>> chunk;
+  VisitTwoViewGeometriesRows(
+      sql_stmt_read_two_view_geometries_chunk_,
+      nullptr,
+      [&](const image_pair_t pair_id, TwoViewGeometry&& two_view_geometry) {
+        chunk.emplace_back(pair_id, std::move(two_view_geometry));
+      });
+  return chunk;
+}
+
+void Database::VisitTwoViewGeometriesRows(
+    sqlite3_stmt* sql_stmt,
+    const ImagePairFilter& filter,
+    const std::function<void(image_pair_t, TwoViewGeometry&&)>& visitor)
+    const {
+  try {
+    int rc;
+    while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt))) == SQLITE_ROW) {
+      const image_pair_t pair_id =
+          static_cast<image_pair_t>(sqlite3_column_int64(sql_stmt, 0));
+      const size_t num_inliers =
+          static_cast<size_t>(sqlite3_column_int64(sql_stmt, 1));
+      if (filter && !filter(pair_id, num_inliers)) {
+        continue;
+      }
+
+      TwoViewGeometry two_view_geometry;
+
+      const FeatureMatchesBlob blob =
+          ReadDynamicMatrixBlob<FeatureMatchesBlob>(sql_stmt, rc, 1);
+      two_view_geometry.inlier_matches = FeatureMatchesFromBlob(blob);
+
+      two_view_geometry.config =
+          static_cast<int>(sqlite3_column_int64(sql_stmt, 4));
+
+      two_view_geometry.F =
+          ReadStaticMatrixBlob<Eigen::Matrix3d>(sql_stmt, rc, 5);
+      two_view_geometry.E =
+          ReadStaticMatrixBlob<Eigen::Matrix3d>(sql_stmt, rc, 6);
+      two_view_geometry.H =
+          ReadStaticMatrixBlob<Eigen::Matrix3d>(sql_stmt, rc, 7);
+      const Eigen::Vector4d quat_wxyz =
+          ReadStaticMatrixBlob<Eigen::Vector4d>(sql_stmt, rc, 8);
+      two_view_geometry.cam2_from_cam1.rotation = Eigen::Quaterniond(
+          quat_wxyz(0), quat_wxyz(1), quat_wxyz(2), quat_wxyz(3));
+      two_view_geometry.cam2_from_cam1.translation =
+          ReadStaticMatrixBlob<Eigen::Vector3d>(sql_stmt, rc, 9);
+
+      two_view_geometry.F.transposeInPlace();
+      two_view_geometry.E.transposeInPlace();
+      two_view_geometry.H.transposeInPlace();
+
+      visitor(pair_id, std::move(two_view_geometry));
+    }
+  } catch (...) {
+    sqlite3_reset(sql_stmt);
+    throw;
+  }
 
-    two_view_geometry.F.transposeInPlace();
-    two_view_geometry.E.transposeInPlace();
-    two_view_geometry.H.transposeInPlace();
+  SQLITE3_CALL(sqlite3_reset(sql_stmt));
+}
 
-    two_view_geometries->push_back(two_view_geometry);
-  }
+std::vector<image_pair_t> Database::ReadAllMatchedImagePairIds() const {
+  return ReadAllPairIds("matches");
+}
 
-  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometries_));
+std::vector<image_pair_t> Database::ReadAllVerifiedImagePairIds() const {
+  return ReadAllPairIds("two_view_geometries");
 }
 
 void Database::ReadTwoViewGeometryNumInliers(
@@ -638,6 +1200,53 @@ void Database::ReadTwoViewGeometryNumInliers(
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometry_num_inliers_));
 }
 
+void Database::ReadNumMatchesForImage(const image_t image_id,
+                                      std::vector<image_t>* other_image_ids,
+                                      std::vector<int>* num_matches) const {
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_read_image_num_matches_, 1, kMaxNumImages));
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_read_image_num_matches_, 2, image_id));
+
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt_read_image_num_matches_)) ==
+         SQLITE_ROW) {
+    const image_pair_t pair_id = static_cast<image_pair_t>(
+        sqlite3_column_int64(sql_stmt_read_image_num_matches_, 0));
+    const auto image_pair = PairIdToImagePair(pair_id);
+    other_image_ids->push_back(image_pair.first == image_id
+                                   ? image_pair.second
+                                   : image_pair.first);
+    num_matches->push_back(static_cast<int>(
+        sqlite3_column_int64(sql_stmt_read_image_num_matches_, 1)));
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_image_num_matches_));
+}
+
+void Database::ReadTwoViewGeometryNumInliersForImage(
+    const image_t image_id,
+    std::vector<image_t>* other_image_ids,
+    std::vector<int>* num_inliers,
+    std::vector<int>* configs) const {
+  sqlite3_stmt* sql_stmt = sql_stmt_read_image_two_view_geometry_num_inliers_;
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, kMaxNumImages));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 2, image_id));
+
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+    const image_pair_t pair_id =
+        static_cast<image_pair_t>(sqlite3_column_int64(sql_stmt, 0));
+    const auto image_pair = PairIdToImagePair(pair_id);
+    other_image_ids->push_back(image_pair.first == image_id
+                                   ? image_pair.second
+                                   : image_pair.first);
+    num_inliers->push_back(
+        static_cast<int>(sqlite3_column_int64(sql_stmt, 1)));
+    configs->push_back(static_cast<int>(sqlite3_column_int64(sql_stmt, 2)));
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt));
+}
+
 camera_t Database::WriteCamera(const Camera& camera,
                                const bool use_camera_id) const {
   if (use_camera_id) {
@@ -704,6 +1313,34 @@ void Database::WritePosePrior(const image_t image_id,
   SQLITE3_CALL(sqlite3_reset(sql_stmt_write_pose_prior_));
 }
 
+void Database::WriteImageSignature(const image_t image_id,
+                                   const FileSignature& signature) const {
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_write_image_signature_, 1, image_id));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_image_signature_,
+                                  2,
+                                  static_cast<sqlite3_int64>(signature.size)));
+  SQLITE3_CALL(sqlite3_bind_int64(
+      sql_stmt_write_image_signature_,
+      3,
+      static_cast<sqlite3_int64>(signature.modification_time)));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_image_signature_,
+                                  4,
+                                  static_cast<sqlite3_int64>(signature.hash)));
+  SQLITE3_CALL(sqlite3_step(sql_stmt_write_image_signature_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_write_image_signature_));
+}
+
+void Database::WriteGlobalDescriptor(const image_t image_id,
+                                     const Eigen::VectorXf& descriptor) const {
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_write_global_descriptor_, 1, image_id));
+  WriteDynamicMatrixBlob(sql_stmt_write_global_descriptor_, descriptor, 2);
+
+  SQLITE3_CALL(sqlite3_step(sql_stmt_write_global_descriptor_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_write_global_descriptor_));
+}
+
 void Database::WriteKeypoints(const image_t image_id,
                               const FeatureKeypoints& keypoints) const {
   WriteKeypoints(image_id, FeatureKeypointsToBlob(keypoints));
@@ -719,9 +1356,13 @@ void Database::WriteKeypoints(const image_t image_id,
 }
 
 void Database::WriteDescriptors(const image_t image_id,
-                                const FeatureDescriptors& descriptors) const {
+                                const FeatureDescriptors& descriptors,
+                                const FeatureDescriptorType type) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_descriptors_, 1, image_id));
-  WriteDynamicMatrixBlob(sql_stmt_write_descriptors_, descriptors, 2);
+  WriteDynamicMatrixBlob(
+      sql_stmt_write_descriptors_, descriptors, 2, compress_blobs_);
+  SQLITE3_CALL(sqlite3_bind_int(
+      sql_stmt_write_descriptors_, 5, static_cast<int>(type)));
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_descriptors_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_write_descriptors_));
@@ -744,9 +1385,10 @@ void Database::WriteMatches(const image_t image_id1,
   if (SwapImagePair(image_id1, image_id2)) {
     swapped_blob = blob;
     SwapFeatureMatchesBlob(&swapped_blob);
-    WriteDynamicMatrixBlob(sql_stmt_write_matches_, swapped_blob, 2);
+    WriteDynamicMatrixBlob(
+        sql_stmt_write_matches_, swapped_blob, 2, compress_blobs_);
   } else {
-    WriteDynamicMatrixBlob(sql_stmt_write_matches_, blob, 2);
+    WriteDynamicMatrixBlob(sql_stmt_write_matches_, blob, 2, compress_blobs_);
   }
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_matches_));
@@ -774,7 +1416,8 @@ void Database::WriteTwoViewGeometry(
 
   const FeatureMatchesBlob inlier_matches =
       FeatureMatchesToBlob(two_view_geometry_ptr->inlier_matches);
-  WriteDynamicMatrixBlob(sql_stmt_write_two_view_geometry_, inlier_matches, 2);
+  WriteDynamicMatrixBlob(
+      sql_stmt_write_two_view_geometry_, inlier_matches, 2, compress_blobs_);
 
   SQLITE3_CALL(sqlite3_bind_int64(
       sql_stmt_write_two_view_geometry_, 5, two_view_geometry_ptr->config));
@@ -875,12 +1518,32 @@ void Database::DeleteInlierMatches(const image_t image_id1,
   database_cleared_ = true;
 }
 
+void Database::DeleteImageFeatures(const image_t image_id) const {
+  for (sqlite3_stmt* sql_stmt : {sql_stmt_delete_image_keypoints_,
+                                 sql_stmt_delete_image_descriptors_,
+                                 sql_stmt_delete_image_global_descriptor_}) {
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, image_id));
+    SQLITE3_CALL(sqlite3_step(sql_stmt));
+    SQLITE3_CALL(sqlite3_reset(sql_stmt));
+  }
+  for (sqlite3_stmt* sql_stmt : {sql_stmt_delete_image_matches_,
+                                 sql_stmt_delete_image_two_view_geometries_}) {
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, kMaxNumImages));
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 2, image_id));
+    SQLITE3_CALL(sqlite3_step(sql_stmt));
+    SQLITE3_CALL(sqlite3_reset(sql_stmt));
+  }
+  database_cleared_ = true;
+}
+
 void Database::ClearAllTables() const {
   ClearMatches();
   ClearTwoViewGeometries();
   ClearDescriptors();
   ClearKeypoints();
   ClearPosePriors();
+  ClearImageSignatures();
+  ClearGlobalDescriptors();
   ClearImages();
   ClearCameras();
 }
@@ -903,6 +1566,18 @@ void Database::ClearPosePriors() const {
   database_cleared_ = true;
 }
 
+void Database::ClearImageSignatures() const {
+  SQLITE3_CALL(sqlite3_step(sql_stmt_clear_image_signatures_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_image_signatures_));
+  database_cleared_ = true;
+}
+
+void Database::ClearGlobalDescriptors() const {
+  SQLITE3_CALL(sqlite3_step(sql_stmt_clear_global_descriptors_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_global_descriptors_));
+  database_cleared_ = true;
+}
+
 void Database::ClearDescriptors() const {
   SQLITE3_CALL(sqlite3_step(sql_stmt_clear_descriptors_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_descriptors_));
@@ -930,111 +1605,143 @@ void Database::ClearTwoViewGeometries() const {
 void Database::Merge(const Database& database1,
                      const Database& database2,
                      Database* merged_database) {
-  // Merge the cameras.
-
-  std::unordered_map<camera_t, camera_t> new_camera_ids1;
-  for (const auto& camera : database1.ReadAllCameras()) {
-    const camera_t new_camera_id = merged_database->WriteCamera(camera);
-    new_camera_ids1.emplace(camera.camera_id, new_camera_id);
-  }
-
-  std::unordered_map<camera_t, camera_t> new_camera_ids2;
-  for (const auto& camera : database2.ReadAllCameras()) {
-    const camera_t new_camera_id = merged_database->WriteCamera(camera);
-    new_camera_ids2.emplace(camera.camera_id, new_camera_id);
-  }
-
-  // Merge the images.
-
-  std::unordered_map<image_t, image_t> new_image_ids1;
-  for (auto& image : database1.ReadAllImages()) {
-    image.SetCameraId(new_camera_ids1.at(image.CameraId()));
-    THROW_CHECK(!merged_database->ExistsImageWithName(image.Name()))
-        << "The two databases must not contain images with the same name, but "
-           "the there are images with name "
-        << image.Name() << " in both databases";
-    const image_t new_image_id = merged_database->WriteImage(image);
-    new_image_ids1.emplace(image.ImageId(), new_image_id);
-    const auto keypoints = database1.ReadKeypoints(image.ImageId());
-    const auto descriptors = database1.ReadDescriptors(image.ImageId());
-    merged_database->WriteKeypoints(new_image_id, keypoints);
-    merged_database->WriteDescriptors(new_image_id, descriptors);
-    if (database1.ExistsPosePrior(image.ImageId())) {
-      merged_database->WritePosePrior(new_image_id,
-                                      database1.ReadPosePrior(image.ImageId()));
+  Merge({&database1, &database2}, merged_database);
+}
+
+void Database::Merge(const std::vector<const Database*>& databases,
+                     Database* merged_database,
+                     const int num_threads,
+                     const bool preserve_image_ids) {
+  THROW_CHECK_NOTNULL(merged_database);
+
+  struct DatabaseRows {
+    std::vector<Camera> cameras;
+    std::vector<Image> images;
+    std::vector<RawTableRows> image_tables;
+    std::vector<RawTableRows> pair_tables;
+  };
+
+  auto read_database = [](const Database* database) {
+    DatabaseRows rows;
+    rows.cameras = database->ReadAllCameras();
+    rows.images = database->ReadAllImages();
+    for (const auto& table : kMergeImageTables) {
+      rows.image_tables.push_back(
+          ReadRawTableRows(database->database_, table.name, table.columns));
     }
-  }
-
-  std::unordered_map<image_t, image_t> new_image_ids2;
-  for (auto& image : database2.ReadAllImages()) {
-    image.SetCameraId(new_camera_ids2.at(image.CameraId()));
-    THROW_CHECK(!merged_database->ExistsImageWithName(image.Name()))
-        << "The two databases must not contain images with the same name, but "
-           "the there are images with name "
-        << image.Name() << " in both databases";
-    const image_t new_image_id = merged_database->WriteImage(image);
-    new_image_ids2.emplace(image.ImageId(), new_image_id);
-    const auto keypoints = database2.ReadKeypoints(image.ImageId());
-    const auto descriptors = database2.ReadDescriptors(image.ImageId());
-    merged_database->WriteKeypoints(new_image_id, keypoints);
-    merged_database->WriteDescriptors(new_image_id, descriptors);
-    if (database2.ExistsPosePrior(image.ImageId())) {
-      merged_database->WritePosePrior(new_image_id,
-                                      database2.ReadPosePrior(image.ImageId()));
+    for (const auto& table : kMergePairTables) {
+      rows.pair_tables.push_back(
+          ReadRawTableRows(database->database_, table.name, table.columns));
     }
-  }
-
-  // Merge the matches.
-
-  for (const auto& matches : database1.ReadAllMatches()) {
-    const auto image_pair = Database::PairIdToImagePair(matches.first);
-
-    const image_t new_image_id1 = new_image_ids1.at(image_pair.first);
-    const image_t new_image_id2 = new_image_ids1.at(image_pair.second);
+    return rows;
+  };
+
+  // Read ahead of the writer with a bounded number of databases in memory.
+  ThreadPool thread_pool(
+      std::min(GetEffectiveNumThreads(num_threads),
+               std::max(1, static_cast<int>(databases.size()))));
+  const size_t num_read_ahead = 2 * thread_pool.NumThreads();
+  std::vector<std::future<DatabaseRows>> futures(databases.size());
+  size_t num_scheduled = 0;
+  auto schedule_reads = [&](const size_t num_written) {
+    while (num_scheduled < databases.size() &&
+           num_scheduled < num_written + num_read_ahead) {
+      THROW_CHECK_NOTNULL(databases[num_scheduled]);
+      futures[num_scheduled] =
+          thread_pool.AddTask(read_database, databases[num_scheduled]);
+      ++num_scheduled;
+    }
+  };
 
-    merged_database->WriteMatches(new_image_id1, new_image_id2, matches.second);
+  std::vector<std::unique_ptr<sqlite3_stmt, StatementFinalizer>>
+      image_table_inserts;
+  for (const auto& table : kMergeImageTables) {
+    image_table_inserts.push_back(PrepareRawTableInsert(
+        merged_database->database_, table.name, table.columns));
   }
-
-  for (const auto& matches : database2.ReadAllMatches()) {
-    const auto image_pair = Database::PairIdToImagePair(matches.first);
-
-    const image_t new_image_id1 = new_image_ids2.at(image_pair.first);
-    const image_t new_image_id2 = new_image_ids2.at(image_pair.second);
-
-    merged_database->WriteMatches(new_image_id1, new_image_id2, matches.second);
+  std::vector<std::unique_ptr<sqlite3_stmt, StatementFinalizer>>
+      pair_table_inserts;
+  for (const auto& table : kMergePairTables) {
+    pair_table_inserts.push_back(PrepareRawTableInsert(
+        merged_database->database_, table.name, table.columns));
   }
 
-  // Merge the two-view geometries.
-
-  {
-    std::vector<image_pair_t> image_pair_ids;
-    std::vector<TwoViewGeometry> two_view_geometries;
-    database1.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
-
-    for (size_t i = 0; i < two_view_geometries.size(); ++i) {
-      const auto image_pair = Database::PairIdToImagePair(image_pair_ids[i]);
+  // Write everything in one transaction instead of one per query.
+  DatabaseTransaction database_transaction(merged_database);
 
-      const image_t new_image_id1 = new_image_ids1.at(image_pair.first);
-      const image_t new_image_id2 = new_image_ids1.at(image_pair.second);
+  for (size_t i = 0; i < databases.size(); ++i) {
+    schedule_reads(i);
+    DatabaseRows rows = futures[i].get();
+    const Database& database = *databases[i];
 
-      merged_database->WriteTwoViewGeometry(
-          new_image_id1, new_image_id2, two_view_geometries[i]);
+    std::unordered_map<camera_t, camera_t> new_camera_ids;
+    for (const auto& camera : rows.cameras) {
+      new_camera_ids.emplace(camera.camera_id,
+                             merged_database->WriteCamera(camera));
     }
-  }
-
-  {
-    std::vector<image_pair_t> image_pair_ids;
-    std::vector<TwoViewGeometry> two_view_geometries;
-    database2.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
 
-    for (size_t i = 0; i < two_view_geometries.size(); ++i) {
-      const auto image_pair = Database::PairIdToImagePair(image_pair_ids[i]);
+    std::unordered_map<image_t, image_t> new_image_ids;
+    for (auto& image : rows.images) {
+      image.SetCameraId(new_camera_ids.at(image.CameraId()));
+      THROW_CHECK(!merged_database->ExistsImageWithName(image.Name()))
+          << "The databases must not contain images with the same name, but "
+             "there are multiple images with name "
+          << image.Name();
+      if (preserve_image_ids) {
+        THROW_CHECK(!merged_database->ExistsImage(image.ImageId()))
+            << "The databases must not contain images with the same "
+               "identifier, but there are multiple images with identifier "
+            << image.ImageId();
+      }
+      new_image_ids.emplace(
+          image.ImageId(),
+          merged_database->WriteImage(image, preserve_image_ids));
+    }
 
-      const image_t new_image_id1 = new_image_ids2.at(image_pair.first);
-      const image_t new_image_id2 = new_image_ids2.at(image_pair.second);
+    for (size_t t = 0; t < rows.image_tables.size(); ++t) {
+      const MergeImageTable& table = kMergeImageTables[t];
+      const RawTableRows& table_rows = rows.image_tables[t];
+      const bool decode = merged_database->compress_blobs_ &&
+                          table.copy_decoded != nullptr;
+      for (size_t row = 0; row < table_rows.NumRows(); ++row) {
+        const image_t image_id = static_cast<image_t>(
+            sqlite3_value_int64(table_rows.Value(row, 0)));
+        const image_t new_image_id = new_image_ids.at(image_id);
+        if (decode) {
+          table.copy_decoded(database, image_id, new_image_id, merged_database);
+        } else {
+          WriteRawTableRow(
+              image_table_inserts[t].get(), table_rows, row, new_image_id);
+        }
+      }
+    }
 
-      merged_database->WriteTwoViewGeometry(
-          new_image_id1, new_image_id2, two_view_geometries[i]);
+    for (size_t t = 0; t < rows.pair_tables.size(); ++t) {
+      const MergePairTable& table = kMergePairTables[t];
+      const RawTableRows& table_rows = rows.pair_tables[t];
+      for (size_t row = 0; row < table_rows.NumRows(); ++row) {
+        const auto [image_id1, image_id2] =
+            PairIdToImagePair(static_cast<image_pair_t>(
+                sqlite3_value_int64(table_rows.Value(row, 0))));
+        const image_t new_image_id1 = new_image_ids.at(image_id1);
+        const image_t new_image_id2 = new_image_ids.at(image_id2);
+        // Swapped image pairs must also swap the matches and invert the
+        // geometry, which requires decoding the row.
+        if (merged_database->compress_blobs_ ||
+            SwapImagePair(new_image_id1, new_image_id2)) {
+          table.copy_decoded(database,
+                             image_id1,
+                             image_id2,
+                             new_image_id1,
+                             new_image_id2,
+                             merged_database);
+        } else {
+          WriteRawTableRow(pair_table_inserts[t].get(),
+                           table_rows,
+                           row,
+                           ImagePairToPairId(new_image_id1, new_image_id2));
+        }
+      }
     }
   }
 }
@@ -1065,6 +1772,11 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_num_descriptors_, 0));
   sql_stmts_.push_back(sql_stmt_num_descriptors_);
 
+  sql = "SELECT rows FROM two_view_geometries WHERE pair_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_num_inlier_matches_, 0));
+  sql_stmts_.push_back(sql_stmt_num_inlier_matches_);
+
   //////////////////////////////////////////////////////////////////////////////
   // exists_*
   //////////////////////////////////////////////////////////////////////////////
@@ -1088,6 +1800,16 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_exists_pose_prior_, 0));
   sql_stmts_.push_back(sql_stmt_exists_pose_prior_);
 
+  sql = "SELECT 1 FROM image_signatures WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_exists_image_signature_, 0));
+  sql_stmts_.push_back(sql_stmt_exists_image_signature_);
+
+  sql = "SELECT 1 FROM global_descriptors WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_exists_global_descriptor_, 0));
+  sql_stmts_.push_back(sql_stmt_exists_global_descriptor_);
+
   sql = "SELECT 1 FROM keypoints WHERE image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_exists_keypoints_, 0));
@@ -1151,6 +1873,11 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_read_cameras_, 0));
   sql_stmts_.push_back(sql_stmt_read_cameras_);
 
+  sql = "SELECT * FROM cameras ORDER BY camera_id LIMIT ? OFFSET ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_cameras_page_, 0));
+  sql_stmts_.push_back(sql_stmt_read_cameras_page_);
+
   sql = "SELECT * FROM images WHERE image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_image_id_, 0));
@@ -1166,11 +1893,26 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_read_images_, 0));
   sql_stmts_.push_back(sql_stmt_read_images_);
 
+  sql = "SELECT * FROM images ORDER BY image_id LIMIT ? OFFSET ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_images_page_, 0));
+  sql_stmts_.push_back(sql_stmt_read_images_page_);
+
   sql = "SELECT * FROM pose_priors WHERE image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_pose_prior_, 0));
   sql_stmts_.push_back(sql_stmt_read_pose_prior_);
 
+  sql = "SELECT * FROM image_signatures WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_image_signature_, 0));
+  sql_stmts_.push_back(sql_stmt_read_image_signature_);
+
+  sql = "SELECT rows, cols, data FROM global_descriptors WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_global_descriptor_, 0));
+  sql_stmts_.push_back(sql_stmt_read_global_descriptor_);
+
   sql = "SELECT rows, cols, data FROM keypoints WHERE image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_keypoints_, 0));
@@ -1181,16 +1923,28 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_read_descriptors_, 0));
   sql_stmts_.push_back(sql_stmt_read_descriptors_);
 
+  sql = "SELECT type FROM descriptors WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_descriptors_type_, 0));
+  sql_stmts_.push_back(sql_stmt_read_descriptors_type_);
+
   sql = "SELECT rows, cols, data FROM matches WHERE pair_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_matches_, 0));
   sql_stmts_.push_back(sql_stmt_read_matches_);
 
-  sql = "SELECT * FROM matches WHERE rows > 0;";
+  sql = "SELECT * FROM matches WHERE rows > 0 ORDER BY pair_id;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_matches_all_, 0));
   sql_stmts_.push_back(sql_stmt_read_matches_all_);
 
+  sql =
+      "SELECT * FROM matches WHERE rows > 0 AND pair_id > ? ORDER BY pair_id "
+      "LIMIT ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_matches_chunk_, 0));
+  sql_stmts_.push_back(sql_stmt_read_matches_chunk_);
+
   sql =
       "SELECT rows, cols, data, config, F, E, H, qvec, tvec FROM "
       "two_view_geometries WHERE pair_id = ?;";
@@ -1198,11 +1952,22 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_read_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometry_);
 
-  sql = "SELECT * FROM two_view_geometries WHERE rows > 0;";
+  sql =
+      "SELECT * FROM two_view_geometries WHERE rows > 0 ORDER BY pair_id;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_two_view_geometries_, 0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometries_);
 
+  sql =
+      "SELECT * FROM two_view_geometries WHERE rows > 0 AND pair_id > ? "
+      "ORDER BY pair_id LIMIT ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(database_,
+                                  sql.c_str(),
+                                  -1,
+                                  &sql_stmt_read_two_view_geometries_chunk_,
+                                  0));
+  sql_stmts_.push_back(sql_stmt_read_two_view_geometries_chunk_);
+
   sql = "SELECT pair_id, rows FROM two_view_geometries WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_,
                                   sql.c_str(),
@@ -1211,6 +1976,28 @@ void Database::PrepareSQLStatements() {
                                   0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometry_num_inliers_);
 
+  // The image identifiers of a pair are encoded as the quotient and remainder
+  // of the pair identifier, see ImagePairToPairId.
+  sql =
+      "SELECT pair_id, rows FROM matches "
+      "WHERE rows > 0 AND (pair_id / ?1 = ?2 OR pair_id % ?1 = ?2) "
+      "ORDER BY pair_id;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_image_num_matches_, 0));
+  sql_stmts_.push_back(sql_stmt_read_image_num_matches_);
+
+  sql =
+      "SELECT pair_id, rows, config FROM two_view_geometries "
+      "WHERE rows > 0 AND (pair_id / ?1 = ?2 OR pair_id % ?1 = ?2) "
+      "ORDER BY pair_id;";
+  SQLITE3_CALL(
+      sqlite3_prepare_v2(database_,
+                         sql.c_str(),
+                         -1,
+                         &sql_stmt_read_image_two_view_geometry_num_inliers_,
+                         0));
+  sql_stmts_.push_back(sql_stmt_read_image_two_view_geometry_num_inliers_);
+
   //////////////////////////////////////////////////////////////////////////////
   // write_*
   //////////////////////////////////////////////////////////////////////////////
@@ -1221,13 +2008,28 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_write_pose_prior_, 0));
   sql_stmts_.push_back(sql_stmt_write_pose_prior_);
 
+  sql =
+      "INSERT OR REPLACE INTO image_signatures(image_id, file_size, "
+      "modification_time, hash) VALUES(?, ?, ?, ?);";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_write_image_signature_, 0));
+  sql_stmts_.push_back(sql_stmt_write_image_signature_);
+
+  sql =
+      "INSERT OR REPLACE INTO global_descriptors(image_id, rows, cols, data) "
+      "VALUES(?, ?, ?, ?);";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_write_global_descriptor_, 0));
+  sql_stmts_.push_back(sql_stmt_write_global_descriptor_);
+
   sql = "INSERT INTO keypoints(image_id, rows, cols, data) VALUES(?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_write_keypoints_, 0));
   sql_stmts_.push_back(sql_stmt_write_keypoints_);
 
   sql =
-      "INSERT INTO descriptors(image_id, rows, cols, data) VALUES(?, ?, ?, ?);";
+      "INSERT INTO descriptors(image_id, rows, cols, data, type) "
+      "VALUES(?, ?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_write_descriptors_, 0));
   sql_stmts_.push_back(sql_stmt_write_descriptors_);
@@ -1257,6 +2059,42 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_delete_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_delete_two_view_geometry_);
 
+  sql = "DELETE FROM keypoints WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_delete_image_keypoints_, 0));
+  sql_stmts_.push_back(sql_stmt_delete_image_keypoints_);
+
+  sql = "DELETE FROM descriptors WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_delete_image_descriptors_, 0));
+  sql_stmts_.push_back(sql_stmt_delete_image_descriptors_);
+
+  sql = "DELETE FROM global_descriptors WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(database_,
+                                  sql.c_str(),
+                                  -1,
+                                  &sql_stmt_delete_image_global_descriptor_,
+                                  0));
+  sql_stmts_.push_back(sql_stmt_delete_image_global_descriptor_);
+
+  // The image identifiers of a pair are encoded as the quotient and remainder
+  // of the pair identifier, see ImagePairToPairId.
+  sql =
+      "DELETE FROM matches WHERE pair_id / ?1 = ?2 OR pair_id % ?1 = ?2;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_delete_image_matches_, 0));
+  sql_stmts_.push_back(sql_stmt_delete_image_matches_);
+
+  sql =
+      "DELETE FROM two_view_geometries "
+      "WHERE pair_id / ?1 = ?2 OR pair_id % ?1 = ?2;";
+  SQLITE3_CALL(sqlite3_prepare_v2(database_,
+                                  sql.c_str(),
+                                  -1,
+                                  &sql_stmt_delete_image_two_view_geometries_,
+                                  0));
+  sql_stmts_.push_back(sql_stmt_delete_image_two_view_geometries_);
+
   //////////////////////////////////////////////////////////////////////////////
   // clear_*
   //////////////////////////////////////////////////////////////////////////////
@@ -1275,6 +2113,16 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_clear_pose_priors_, 0));
   sql_stmts_.push_back(sql_stmt_clear_pose_priors_);
 
+  sql = "DELETE FROM image_signatures;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_clear_image_signatures_, 0));
+  sql_stmts_.push_back(sql_stmt_clear_image_signatures_);
+
+  sql = "DELETE FROM global_descriptors;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_clear_global_descriptors_, 0));
+  sql_stmts_.push_back(sql_stmt_clear_global_descriptors_);
+
   sql = "DELETE FROM descriptors;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_clear_descriptors_, 0));
@@ -1306,6 +2154,8 @@ void Database::CreateTables() const {
   CreateCameraTable();
   CreateImageTable();
   CreatePosePriorTable();
+  CreateImageSignatureTable();
+  CreateGlobalDescriptorsTable();
   CreateKeypointsTable();
   CreateDescriptorsTable();
   CreateMatchesTable();
@@ -1350,6 +2200,30 @@ void Database::CreatePosePriorTable() const {
   SQLITE3_EXEC(database_, sql.c_str(), nullptr);
 }
 
+void Database::CreateImageSignatureTable() const {
+  const std::string sql =
+      "CREATE TABLE IF NOT EXISTS image_signatures"
+      "   (image_id           INTEGER  PRIMARY KEY  NOT NULL,"
+      "    file_size          INTEGER               NOT NULL,"
+      "    modification_time  INTEGER               NOT NULL,"
+      "    hash               INTEGER               NOT NULL,"
+      "FOREIGN KEY(image_id) REFERENCES images(image_id) ON DELETE CASCADE);";
+
+  SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+}
+
+void Database::CreateGlobalDescriptorsTable() const {
+  const std::string sql =
+      "CREATE TABLE IF NOT EXISTS global_descriptors"
+      "   (image_id  INTEGER  PRIMARY KEY  NOT NULL,"
+      "    rows      INTEGER               NOT NULL,"
+      "    cols      INTEGER               NOT NULL,"
+      "    data      BLOB,"
+      "FOREIGN KEY(image_id) REFERENCES images(image_id) ON DELETE CASCADE);";
+
+  SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+}
+
 void Database::CreateKeypointsTable() const {
   const std::string sql =
       "CREATE TABLE IF NOT EXISTS keypoints"
@@ -1369,6 +2243,7 @@ void Database::CreateDescriptorsTable() const {
       "    rows      INTEGER               NOT NULL,"
       "    cols      INTEGER               NOT NULL,"
       "    data      BLOB,"
+      "    type      INTEGER  DEFAULT 0    NOT NULL,"
       "FOREIGN KEY(image_id) REFERENCES images(image_id) ON DELETE CASCADE);";
 
   SQLITE3_EXEC(database_, sql.c_str(), nullptr);
@@ -1408,6 +2283,13 @@ void Database::CreateTwoViewGeometriesTable() const {
 }
 
 void Database::UpdateSchema() const {
+  if (!ExistsColumn("descriptors", "type")) {
+    SQLITE3_EXEC(database_,
+                 "ALTER TABLE descriptors ADD COLUMN type INTEGER DEFAULT 0 "
+                 "NOT NULL;",
+                 nullptr);
+  }
+
   if (!ExistsColumn("two_view_geometries", "F")) {
     SQLITE3_EXEC(database_,
                  "ALTER TABLE two_view_geometries ADD COLUMN F BLOB;",
@@ -1533,6 +2415,28 @@ size_t Database::CountRows(const std::string& table) const {
   return count;
 }
 
+std::vector<image_pair_t> Database::ReadAllPairIds(
+    const std::string& table) const {
+  // The pair identifier is the primary key, so the identifiers are read from
+  // the index in ascending order.
+  const std::string sql =
+      StringPrintf("SELECT pair_id FROM %s ORDER BY pair_id;", table.c_str());
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+
+  std::vector<image_pair_t> pair_ids;
+  pair_ids.reserve(CountRows(table));
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+    pair_ids.push_back(
+        static_cast<image_pair_t>(sqlite3_column_int64(sql_stmt, 0)));
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return pair_ids;
+}
+
 size_t Database::CountRowsForEntry(sqlite3_stmt* sql_stmt,
                                    const sqlite3_int64 row_id) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, row_id));
@@ -35,8 +35,10 @@
 #include "colmap/scene/image.h"
 #include "colmap/scene/two_view_geometry.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/types.h"
 
+#include <functional>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -80,12 +82,31 @@ class Database {
   void Open(const std::string& path);
   void Close();
 
+  // Performance profiles of the database connection. The bulk profile uses a
+  // larger page cache, memory-mapped I/O and less frequent WAL checkpoints,
+  // which speeds up phases that read or write many large blobs, such as
+  // feature extraction, matching or merging databases. Must be set after
+  // opening the database.
+  enum class Profile {
+    DEFAULT,
+    BULK,
+  };
+  void SetProfile(Profile profile) const;
+
+  // Whether to LZ4 compress newly written descriptors and matches. Matches
+  // are additionally delta and 16-bit encoded where possible. Reading
+  // transparently handles both compressed and uncompressed blobs, but other
+  // tools reading the database directly only understand uncompressed blobs.
+  void SetBlobCompression(bool compress);
+
   // Check if entry already exists in database. For image pairs, the order of
   // `image_id1` and `image_id2` does not matter.
   bool ExistsCamera(camera_t camera_id) const;
   bool ExistsImage(image_t image_id) const;
   bool ExistsImageWithName(const std::string& name) const;
   bool ExistsPosePrior(image_t image_id) const;
+  bool ExistsImageSignature(image_t image_id) const;
+  bool ExistsGlobalDescriptor(image_t image_id) const;
   bool ExistsKeypoints(image_t image_id) const;
   bool ExistsDescriptors(image_t image_id) const;
   bool ExistsMatches(image_t image_id1, image_t image_id2) const;
@@ -100,6 +121,12 @@ class Database {
   //  Number of rows in `pose_priors` table.
   size_t NumPosePriors() const;
 
+  //  Number of rows in `image_signatures` table.
+  size_t NumImageSignatures() const;
+
+  //  Number of rows in `global_descriptors` table.
+  size_t NumGlobalDescriptors() const;
+
   // Sum of `rows` column in `keypoints` table, i.e. number of total keypoints.
   size_t NumKeypoints() const;
 
@@ -126,6 +153,11 @@ class Database {
   // i.e. number of total inlier matches.
   size_t NumInlierMatches() const;
 
+  // Number of inlier matches for specific image pair, which is zero, if the
+  // image pair has no entry in the `two_view_geometries` table.
+  size_t NumInlierMatchesForImagePair(image_t image_id1,
+                                      image_t image_id2) const;
+
   // Number of rows in `matches` table.
   size_t NumMatchedImagePairs() const;
 
@@ -157,11 +189,25 @@ class Database {
   Image ReadImageWithName(const std::string& name) const;
   std::vector<Image> ReadAllImages() const;
 
+  // Read at most max_num_cameras/images in the order of their identifiers,
+  // skipping the first offset entries, so that large tables can be shown page
+  // by page without reading them entirely.
+  std::vector<Camera> ReadCamerasPage(size_t offset,
+                                      size_t max_num_cameras) const;
+  std::vector<Image> ReadImagesPage(size_t offset, size_t max_num_images) const;
+
   PosePrior ReadPosePrior(image_t image_id) const;
 
+  FileSignature ReadImageSignature(image_t image_id) const;
+
+  Eigen::VectorXf ReadGlobalDescriptor(image_t image_id) const;
+
   FeatureKeypointsBlob ReadKeypointsBlob(image_t image_id) const;
   FeatureKeypoints ReadKeypoints(image_t image_id) const;
   FeatureDescriptors ReadDescriptors(image_t image_id) const;
+  // Type of the stored descriptors of the image, which is SIFT for databases
+  // created before the type was recorded.
+  FeatureDescriptorType ReadDescriptorsType(image_t image_id) const;
 
   FeatureMatchesBlob ReadMatchesBlob(image_t image_id1,
                                      image_t image_id2) const;
@@ -174,12 +220,60 @@ class Database {
       std::vector<image_pair_t>* image_pair_ids,
       std::vector<TwoViewGeometry>* two_view_geometries) const;
 
+  // Stream the matches or two-view geometries of all image pairs with
+  // (inlier) matches in the order of their pair identifiers. The filter is
+  // called with the pair identifier and the number of (inlier) matches before
+  // reading the blob, so that rejected pairs are never decoded. An empty
+  // filter accepts all pairs. Every accepted pair is passed to the visitor
+  // and not retained. The visitor must not start another traversal of the
+  // same table.
+  typedef std::function<bool(image_pair_t pair_id, size_t num_matches)>
+      ImagePairFilter;
+  void VisitMatches(
+      const ImagePairFilter& filter,
+      const std::function<void(image_pair_t, FeatureMatches&&)>& visitor)
+      const;
+  void VisitTwoViewGeometries(
+      const ImagePairFilter& filter,
+      const std::function<void(image_pair_t, TwoViewGeometry&&)>& visitor)
+      const;
+
+  // Read the matches or two-view geometries of at most max_num_pairs image
+  // pairs with (inlier) matches and a pair identifier greater than
+  // prev_pair_id in the order of their pair identifiers. Paging through all
+  // pairs by passing the last pair identifier of the previous chunk, starting
+  // from 0, bounds the memory by the chunk size and, unlike the traversals
+  // above, allows other queries between the chunks.
+  std::vector<std::pair<image_pair_t, FeatureMatchesBlob>> ReadMatchesChunk(
+      image_pair_t prev_pair_id, size_t max_num_pairs) const;
+  std::vector<std::pair<image_pair_t, TwoViewGeometry>>
+  ReadTwoViewGeometriesChunk(image_pair_t prev_pair_id,
+                             size_t max_num_pairs) const;
+
+  // Read the identifiers of all image pairs that have an entry in the
+  // `matches` or `two_view_geometries` table in ascending order, without
+  // reading the blobs of the entries.
+  std::vector<image_pair_t> ReadAllMatchedImagePairIds() const;
+  std::vector<image_pair_t> ReadAllVerifiedImagePairIds() const;
+
   // Read all image pairs that have an entry in the `NumVerifiedImagePairs`
   // table with at least one inlier match and their number of inlier matches.
   void ReadTwoViewGeometryNumInliers(
       std::vector<std::pair<image_t, image_t>>* image_pairs,
       std::vector<int>* num_inliers) const;
 
+  // Read the other images of all image pairs of the given image with at least
+  // one (inlier) match, their number of (inlier) matches and, for two-view
+  // geometries, their configuration in one query without reading the blobs.
+  void ReadNumMatchesForImage(image_t image_id,
+                              std::vector<image_t>* other_image_ids,
+                              std::vector<int>* num_matches) const;
+  void ReadTwoViewGeometryNumInliersForImage(
+      image_t image_id,
+      std::vector<image_t>* other_image_ids,
+      std::vector<int>* num_inliers,
+      std::vector<int>* configs) const;
+
   // Add new camera and return its database identifier. If `use_camera_id`
   // is false a new identifier is automatically generated.
   camera_t WriteCamera(const Camera& camera, bool use_camera_id = false) const;
@@ -195,14 +289,27 @@ class Database {
   // api: 写先验pose
   void WritePosePrior(image_t image_id, const PosePrior& pose_prior) const;
 
+  // Write the signature of the image file from which the features were
+  // extracted. In contrast to the other entries, an existing signature of the
+  // image is replaced.
+  void WriteImageSignature(image_t image_id,
+                           const FileSignature& signature) const;
+
+  // Write the global descriptor of the image that summarizes all its features
+  // for image retrieval. An existing descriptor of the image is replaced.
+  void WriteGlobalDescriptor(image_t image_id,
+                             const Eigen::VectorXf& descriptor) const;
+
   // api: 写keypoints
   void WriteKeypoints(image_t image_id,
                       const FeatureKeypoints& keypoints) const;
   void WriteKeypoints(image_t image_id, const FeatureKeypointsBlob& blob) const;
 
   // api: 写desc.
-  void WriteDescriptors(image_t image_id,
-                        const FeatureDescriptors& descriptors) const;
+  void WriteDescriptors(
+      image_t image_id,
+      const FeatureDescriptors& descriptors,
+      FeatureDescriptorType type = FeatureDescriptorType::SIFT) const;
   void WriteMatches(image_t image_id1,
                     image_t image_id2,
                     const FeatureMatches& matches) const;
@@ -227,6 +334,11 @@ class Database {
   // Delete inlier matches of an image pair.
   void DeleteInlierMatches(image_t image_id1, image_t image_id2) const;
 
+  // Delete the keypoints and descriptors of an image, and the matches and
+  // inlier matches of all image pairs with the image, e.g., to re-extract the
+  // features of a changed image.
+  void DeleteImageFeatures(image_t image_id) const;
+
   // Clear all database tables
   void ClearAllTables() const;
 
@@ -239,6 +351,12 @@ class Database {
   // Clear the entire pose_priors table
   void ClearPosePriors() const;
 
+  // Clear the entire image_signatures table
+  void ClearImageSignatures() const;
+
+  // Clear the entire global_descriptors table
+  void ClearGlobalDescriptors() const;
+
   // Clear the entire descriptors table
   void ClearDescriptors() const;
 
@@ -256,6 +374,18 @@ class Database {
                     const Database& database2,
                     Database* merged_database);
 
+  // Merge any number of databases into a single, new database. The databases
+  // are read in parallel and written in one transaction in the given order.
+  // Feature and match blobs are copied as is without decoding them, unless
+  // the merged database compresses blobs. Images must have unique names. If
+  // preserve_image_ids, the images keep their identifiers, which must then be
+  // unique across the databases, e.g., for the per-shard databases of a
+  // sharded feature extraction, see ImageReaderOptions::num_shards.
+  static void Merge(const std::vector<const Database*>& databases,
+                    Database* merged_database,
+                    int num_threads = -1,
+                    bool preserve_image_ids = false);
+
  private:
   // note: 友元类 DatabaseTransaction 可用 Database 私有数据
   friend class DatabaseTransaction;
@@ -278,6 +408,8 @@ class Database {
   void CreateCameraTable() const;
   void CreateImageTable() const;
   void CreatePosePriorTable() const;
+  void CreateImageSignatureTable() const;
+  void CreateGlobalDescriptorsTable() const;
   void CreateKeypointsTable() const;
   void CreateDescriptorsTable() const;
   void CreateMatchesTable() const;
@@ -293,7 +425,21 @@ class Database {
   bool ExistsRowString(sqlite3_stmt* sql_stmt,
                        const std::string& row_entry) const;
 
+  // Step through the rows of a matches or two-view geometries query, see
+  // VisitMatches and VisitTwoViewGeometries, and reset the statement.
+  void VisitMatchesRows(
+      sqlite3_stmt* sql_stmt,
+      const ImagePairFilter& filter,
+      const std::function<void(image_pair_t, FeatureMatchesBlob&&)>& visitor)
+      const;
+  void VisitTwoViewGeometriesRows(
+      sqlite3_stmt* sql_stmt,
+      const ImagePairFilter& filter,
+      const std::function<void(image_pair_t, TwoViewGeometry&&)>& visitor)
+      const;
+
   size_t CountRows(const std::string& table) const;
+  std::vector<image_pair_t> ReadAllPairIds(const std::string& table) const;
   size_t CountRowsForEntry(sqlite3_stmt* sql_stmt, sqlite3_int64 row_id) const;
   size_t SumColumn(const std::string& column, const std::string& table) const;
   size_t MaxColumn(const std::string& column, const std::string& table) const;
@@ -304,6 +450,9 @@ class Database {
   // the VACUUM command in such case
   mutable bool database_cleared_ = false;
 
+  // Whether to compress newly written descriptor and match blobs.
+  bool compress_blobs_ = false;
+
   // Ensure that only one database object at a time updates the schema of a
   // database. Since the schema is updated every time a database is opened, this
   // is to ensure that there are no race conditions ("database locked" error
@@ -320,12 +469,15 @@ class Database {
   // num_*
   sqlite3_stmt* sql_stmt_num_keypoints_ = nullptr;
   sqlite3_stmt* sql_stmt_num_descriptors_ = nullptr;
+  sqlite3_stmt* sql_stmt_num_inlier_matches_ = nullptr;
 
   // exists_*
   sqlite3_stmt* sql_stmt_exists_camera_ = nullptr;
   sqlite3_stmt* sql_stmt_exists_image_id_ = nullptr;
   sqlite3_stmt* sql_stmt_exists_image_name_ = nullptr;
   sqlite3_stmt* sql_stmt_exists_pose_prior_ = nullptr;
+  sqlite3_stmt* sql_stmt_exists_image_signature_ = nullptr;
+  sqlite3_stmt* sql_stmt_exists_global_descriptor_ = nullptr;
   sqlite3_stmt* sql_stmt_exists_keypoints_ = nullptr;
   sqlite3_stmt* sql_stmt_exists_descriptors_ = nullptr;
   sqlite3_stmt* sql_stmt_exists_matches_ = nullptr;
@@ -342,20 +494,31 @@ class Database {
   // read_*
   sqlite3_stmt* sql_stmt_read_camera_ = nullptr;
   sqlite3_stmt* sql_stmt_read_cameras_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_cameras_page_ = nullptr;
   sqlite3_stmt* sql_stmt_read_image_id_ = nullptr;
   sqlite3_stmt* sql_stmt_read_image_name_ = nullptr;
   sqlite3_stmt* sql_stmt_read_images_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_images_page_ = nullptr;
   sqlite3_stmt* sql_stmt_read_pose_prior_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_image_signature_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_global_descriptor_ = nullptr;
   sqlite3_stmt* sql_stmt_read_keypoints_ = nullptr;
   sqlite3_stmt* sql_stmt_read_descriptors_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_descriptors_type_ = nullptr;
   sqlite3_stmt* sql_stmt_read_matches_ = nullptr;
   sqlite3_stmt* sql_stmt_read_matches_all_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_matches_chunk_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometry_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometries_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_two_view_geometries_chunk_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometry_num_inliers_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_image_num_matches_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_image_two_view_geometry_num_inliers_ = nullptr;
 
   // write_*
   sqlite3_stmt* sql_stmt_write_pose_prior_ = nullptr;
+  sqlite3_stmt* sql_stmt_write_image_signature_ = nullptr;
+  sqlite3_stmt* sql_stmt_write_global_descriptor_ = nullptr;
   sqlite3_stmt* sql_stmt_write_keypoints_ = nullptr;
   sqlite3_stmt* sql_stmt_write_descriptors_ = nullptr;
   sqlite3_stmt* sql_stmt_write_matches_ = nullptr;
@@ -364,11 +527,18 @@ class Database {
   // delete_*
   sqlite3_stmt* sql_stmt_delete_matches_ = nullptr;
   sqlite3_stmt* sql_stmt_delete_two_view_geometry_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_image_keypoints_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_image_descriptors_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_image_global_descriptor_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_image_matches_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_image_two_view_geometries_ = nullptr;
 
   // clear_*
   sqlite3_stmt* sql_stmt_clear_cameras_ = nullptr;
   sqlite3_stmt* sql_stmt_clear_images_ = nullptr;
   sqlite3_stmt* sql_stmt_clear_pose_priors_ = nullptr;
+  sqlite3_stmt* sql_stmt_clear_image_signatures_ = nullptr;
+  sqlite3_stmt* sql_stmt_clear_global_descriptors_ = nullptr;
   sqlite3_stmt* sql_stmt_clear_descriptors_ = nullptr;
   sqlite3_stmt* sql_stmt_clear_keypoints_ = nullptr;
   sqlite3_stmt* sql_stmt_clear_matches_ = nullptr;
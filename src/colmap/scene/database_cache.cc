@@ -29,9 +29,12 @@
 
 #include "colmap/scene/database_cache.h"
 
+#include "colmap/util/memory.h"
 #include "colmap/util/string.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
 
+#include <algorithm>
 #include <unordered_set>
 
 namespace colmap {
@@ -46,15 +49,328 @@ std::vector<Eigen::Vector2d> FeatureKeypointsToPointsVector(
   return points;
 }
 
+// Read the inlier matches of the given image pairs and keep the pairs that
+// pass the same checks as in DatabaseCache::Create.
+void ReadInlierMatches(
+    const Database& database,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::vector<std::pair<image_t, image_t>>& candidate_image_pairs,
+    std::vector<std::pair<image_t, image_t>>* image_pairs,
+    std::vector<FeatureMatches>* inlier_matches) {
+  image_pairs->reserve(candidate_image_pairs.size());
+  inlier_matches->reserve(candidate_image_pairs.size());
+  for (const auto& [image_id1, image_id2] : candidate_image_pairs) {
+    TwoViewGeometry two_view_geometry =
+        database.ReadTwoViewGeometry(image_id1, image_id2);
+    if (two_view_geometry.inlier_matches.size() < min_num_matches ||
+        (ignore_watermarks &&
+         two_view_geometry.config == TwoViewGeometry::WATERMARK)) {
+      continue;
+    }
+    image_pairs->emplace_back(image_id1, image_id2);
+    inlier_matches->push_back(std::move(two_view_geometry.inlier_matches));
+  }
+}
+
+// Read the valid pose priors of the given images, if the database has any.
+void ReadPosePriors(const Database& database,
+                    const std::vector<image_t>& image_ids,
+                    std::unordered_map<image_t, PosePrior>* pose_priors) {
+  if (database.NumPosePriors() == 0) {
+    return;
+  }
+  for (const image_t image_id : image_ids) {
+    if (!database.ExistsPosePrior(image_id)) {
+      continue;
+    }
+    PosePrior pose_prior = database.ReadPosePrior(image_id);
+    if (pose_prior.IsValid()) {
+      pose_priors->emplace(image_id, std::move(pose_prior));
+    }
+  }
+}
+
+std::vector<const FeatureMatches*> GetMatchesPtrs(
+    const std::vector<FeatureMatches>& matches) {
+  std::vector<const FeatureMatches*> matches_ptrs;
+  matches_ptrs.reserve(matches.size());
+  for (const FeatureMatches& pair_matches : matches) {
+    matches_ptrs.push_back(&pair_matches);
+  }
+  return matches_ptrs;
+}
+
+std::vector<Eigen::Vector2f> ReadCompactPoints2D(
+    const Database& database,
+    const FeatureStore* feature_store,
+    const image_t image_id) {
+  std::vector<Eigen::Vector2f> points;
+  if (feature_store != nullptr && feature_store->ExistsKeypoints(image_id)) {
+    const FeatureStore::KeypointsView keypoints =
+        feature_store->KeypointsData(image_id);
+    points.resize(keypoints.size);
+    for (size_t i = 0; i < keypoints.size; ++i) {
+      points[i] = Eigen::Vector2f(keypoints.data[i].x, keypoints.data[i].y);
+    }
+  } else {
+    const FeatureKeypoints keypoints = database.ReadKeypoints(image_id);
+    points.resize(keypoints.size());
+    for (size_t i = 0; i < keypoints.size(); ++i) {
+      points[i] = Eigen::Vector2f(keypoints[i].x, keypoints[i].y);
+    }
+  }
+  return points;
+}
+
 }  // namespace
 
 std::shared_ptr<DatabaseCache> DatabaseCache::Create(
     const Database& database,
     const size_t min_num_matches,
     const bool ignore_watermarks,
-    const std::unordered_set<std::string>& image_names) {
+    const std::unordered_set<std::string>& image_names,
+    const FeatureStore* feature_store) {
+  auto cache = std::make_shared<DatabaseCache>();
+  cache->Load(database,
+              min_num_matches,
+              ignore_watermarks,
+              image_names,
+              feature_store,
+              /*load_points2D=*/true);
+  return cache;
+}
+
+std::shared_ptr<DatabaseCache> DatabaseCache::CreateLazy(
+    const std::string& database_path,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::unordered_set<std::string>& image_names,
+    std::shared_ptr<const FeatureStore> feature_store,
+    const size_t max_points2D_num_bytes) {
+  auto cache = std::make_shared<DatabaseCache>();
+  cache->database_ = std::make_unique<Database>(database_path);
+  cache->feature_store_ = std::move(feature_store);
+  // The points are always read under the lock, since the database connection
+  // must not be used concurrently.
+  cache->points2D_cache_ =
+      std::make_unique<MemoryConstrainedLRUCache<image_t, CachedPoints2D>>(
+          max_points2D_num_bytes,
+          [cache = cache.get()](const image_t image_id) {
+            CachedPoints2D cached;
+            if (cache->feature_store_ != nullptr &&
+                cache->feature_store_->ExistsKeypoints(image_id)) {
+              const FeatureStore::KeypointsView keypoints =
+                  cache->feature_store_->KeypointsData(image_id);
+              auto points =
+                  std::make_shared<std::vector<Eigen::Vector2d>>(keypoints.size);
+              for (size_t i = 0; i < keypoints.size; ++i) {
+                (*points)[i] =
+                    Eigen::Vector2d(keypoints.data[i].x, keypoints.data[i].y);
+              }
+              cached.points = std::move(points);
+            } else {
+              cached.points =
+                  std::make_shared<std::vector<Eigen::Vector2d>>(
+                      FeatureKeypointsToPointsVector(
+                          cache->database_->ReadKeypoints(image_id)));
+            }
+            return cached;
+          });
+  cache->Load(*cache->database_,
+              min_num_matches,
+              ignore_watermarks,
+              image_names,
+              cache->feature_store_.get(),
+              /*load_points2D=*/false);
+  return cache;
+}
+
+std::shared_ptr<DatabaseCache> DatabaseCache::CreateCompact(
+    const Database& database,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::unordered_set<std::string>& image_names,
+    const FeatureStore* feature_store) {
   auto cache = std::make_shared<DatabaseCache>();
+  cache->Load(database,
+              min_num_matches,
+              ignore_watermarks,
+              image_names,
+              feature_store,
+              /*load_points2D=*/false);
+  cache->compact_ = true;
+  cache->compact_points2D_.reserve(cache->images_.size());
+  for (const auto& [image_id, _] : cache->images_) {
+    cache->compact_points2D_.emplace(
+        image_id, ReadCompactPoints2D(database, feature_store, image_id));
+  }
+  return cache;
+}
 
+std::shared_ptr<DatabaseCache> DatabaseCache::CreateNeighborhood(
+    const Database& database,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::unordered_set<image_t>& image_ids,
+    const FeatureStore* feature_store) {
+  std::vector<std::pair<image_t, image_t>> num_inliers_image_pairs;
+  std::vector<int> num_inliers;
+  database.ReadTwoViewGeometryNumInliers(&num_inliers_image_pairs,
+                                         &num_inliers);
+
+  std::unordered_set<image_t> neighborhood_image_ids = image_ids;
+  for (size_t i = 0; i < num_inliers_image_pairs.size(); ++i) {
+    if (static_cast<size_t>(num_inliers[i]) < min_num_matches) {
+      continue;
+    }
+    const auto [image_id1, image_id2] = num_inliers_image_pairs[i];
+    if (image_ids.count(image_id1) > 0) {
+      neighborhood_image_ids.insert(image_id2);
+    }
+    if (image_ids.count(image_id2) > 0) {
+      neighborhood_image_ids.insert(image_id1);
+    }
+  }
+
+  std::vector<std::pair<image_t, image_t>> candidate_image_pairs;
+  for (size_t i = 0; i < num_inliers_image_pairs.size(); ++i) {
+    const auto [image_id1, image_id2] = num_inliers_image_pairs[i];
+    if (static_cast<size_t>(num_inliers[i]) >= min_num_matches &&
+        neighborhood_image_ids.count(image_id1) > 0 &&
+        neighborhood_image_ids.count(image_id2) > 0) {
+      candidate_image_pairs.emplace_back(image_id1, image_id2);
+    }
+  }
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> inlier_matches;
+  ReadInlierMatches(database,
+                    min_num_matches,
+                    ignore_watermarks,
+                    candidate_image_pairs,
+                    &image_pairs,
+                    &inlier_matches);
+
+  std::unordered_set<image_t> connected_image_ids;
+  for (const auto& [image_id1, image_id2] : image_pairs) {
+    connected_image_ids.insert(image_id1);
+    connected_image_ids.insert(image_id2);
+  }
+
+  auto cache = std::make_shared<DatabaseCache>();
+  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
+  for (const image_t image_id : connected_image_ids) {
+    class Image image = database.ReadImage(image_id);
+    if (!cache->ExistsCamera(image.CameraId())) {
+      cache->cameras_.emplace(image.CameraId(),
+                              database.ReadCamera(image.CameraId()));
+    }
+    if (feature_store != nullptr && feature_store->ExistsKeypoints(image_id)) {
+      const FeatureStore::KeypointsView keypoints =
+          feature_store->KeypointsData(image_id);
+      std::vector<Eigen::Vector2d> points(keypoints.size);
+      for (size_t i = 0; i < keypoints.size; ++i) {
+        points[i] = Eigen::Vector2d(keypoints.data[i].x, keypoints.data[i].y);
+      }
+      image.SetPoints2D(points);
+    } else {
+      image.SetPoints2D(
+          FeatureKeypointsToPointsVector(database.ReadKeypoints(image_id)));
+    }
+    cache->correspondence_graph_->AddImage(image_id, image.NumPoints2D());
+    cache->images_.emplace(image_id, std::move(image));
+  }
+
+  cache->correspondence_graph_->AddCorrespondencesBatch(
+      image_pairs, GetMatchesPtrs(inlier_matches));
+  cache->correspondence_graph_->Finalize();
+
+  ReadPosePriors(database,
+                 std::vector<image_t>(connected_image_ids.begin(),
+                                      connected_image_ids.end()),
+                 &cache->pose_priors_);
+
+  LOG(INFO) << StringPrintf("Loaded %d images in the neighborhood of %d images",
+                            cache->NumImages(),
+                            image_ids.size());
+
+  return cache;
+}
+
+std::shared_ptr<DatabaseCache> DatabaseCache::CreateSubset(
+    std::shared_ptr<const DatabaseCache> database_cache,
+    const std::unordered_set<image_t>& image_ids) {
+  THROW_CHECK_NOTNULL(database_cache);
+
+  auto cache = std::make_shared<DatabaseCache>();
+  cache->parent_ = std::move(database_cache);
+  const DatabaseCache& parent = *cache->parent_;
+  const class CorrespondenceGraph& parent_correspondence_graph =
+      *parent.CorrespondenceGraph();
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> matches;
+  std::unordered_set<image_t> connected_image_ids;
+  for (const auto& [pair_id, num_correspondences] :
+       parent_correspondence_graph.NumCorrespondencesBetweenImages()) {
+    const auto [image_id1, image_id2] = Database::PairIdToImagePair(pair_id);
+    if (num_correspondences == 0 || image_ids.count(image_id1) == 0 ||
+        image_ids.count(image_id2) == 0) {
+      continue;
+    }
+    image_pairs.emplace_back(image_id1, image_id2);
+    matches.push_back(parent_correspondence_graph
+                          .FindCorrespondencesBetweenImages(image_id1,
+                                                            image_id2));
+    connected_image_ids.insert(image_id1);
+    connected_image_ids.insert(image_id2);
+  }
+
+  // The images are copied without their 2D points, which are only read on
+  // demand from the parent cache.
+  for (const image_t image_id : connected_image_ids) {
+    const class Image& parent_image = parent.Image(image_id);
+    class Image image;
+    image.SetImageId(image_id);
+    image.SetName(parent_image.Name());
+    image.SetCameraId(parent_image.CameraId());
+    image.CamFromWorld() = parent_image.CamFromWorld();
+    cache->images_.emplace(image_id, std::move(image));
+    cache->num_points2D_.emplace(image_id,
+                                 parent.NumPoints2DForImage(image_id));
+    if (!cache->ExistsCamera(parent_image.CameraId())) {
+      cache->cameras_.emplace(parent_image.CameraId(),
+                              parent.Camera(parent_image.CameraId()));
+    }
+    if (parent.ExistsPosePrior(image_id)) {
+      cache->pose_priors_.emplace(image_id, parent.PosePrior(image_id));
+    }
+  }
+
+  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
+  for (const auto& [image_id, _] : cache->images_) {
+    cache->correspondence_graph_->AddImage(image_id,
+                                           cache->num_points2D_.at(image_id));
+  }
+  std::vector<const FeatureMatches*> matches_ptrs;
+  matches_ptrs.reserve(matches.size());
+  for (const FeatureMatches& pair_matches : matches) {
+    matches_ptrs.push_back(&pair_matches);
+  }
+  cache->correspondence_graph_->AddCorrespondencesBatch(image_pairs,
+                                                        matches_ptrs);
+  cache->correspondence_graph_->Finalize();
+
+  return cache;
+}
+
+void DatabaseCache::Load(const Database& database,
+                         const size_t min_num_matches,
+                         const bool ignore_watermarks,
+                         const std::unordered_set<std::string>& image_names,
+                         const FeatureStore* feature_store,
+                         const bool load_points2D) {
   //////////////////////////////////////////////////////////////////////////////
   // Load cameras
   //////////////////////////////////////////////////////////////////////////////
@@ -66,14 +382,14 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
 
   {
     std::vector<struct Camera> cameras = database.ReadAllCameras();
-    cache->cameras_.reserve(cameras.size());
+    cameras_.reserve(cameras.size());
     for (auto& camera : cameras) {
-      cache->cameras_.emplace(camera.camera_id, std::move(camera));
+      cameras_.emplace(camera.camera_id, std::move(camera));
     }
   }
 
   LOG(INFO) << StringPrintf(
-      " %d in %.3fs", cache->cameras_.size(), timer.ElapsedSeconds());
+      " %d in %.3fs", cameras_.size(), timer.ElapsedSeconds());
 
   //////////////////////////////////////////////////////////////////////////////
   // Load matches
@@ -82,20 +398,51 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
   timer.Restart();
   LOG(INFO) << "Loading matches...";
 
-  std::vector<image_pair_t> image_pair_ids;
-  std::vector<TwoViewGeometry> two_view_geometries;
-  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  std::unordered_set<image_t> image_ids;
+  std::vector<class Image> images = database.ReadAllImages();
+  const size_t num_images = images.size();
 
-  LOG(INFO) << StringPrintf(
-      " %d in %.3fs", image_pair_ids.size(), timer.ElapsedSeconds());
+  // Determines for which images data should be loaded.
+  if (image_names.empty()) {
+    for (const auto& image : images) {
+      image_ids.insert(image.ImageId());
+    }
+  } else {
+    for (const auto& image : images) {
+      if (image_names.count(image.Name()) > 0) {
+        image_ids.insert(image.ImageId());
+      }
+    }
+  }
 
-  auto UseInlierMatchesCheck = [min_num_matches, ignore_watermarks](
-                                   const TwoViewGeometry& two_view_geometry) {
-    return static_cast<size_t>(two_view_geometry.inlier_matches.size()) >=
-               min_num_matches &&
-           (!ignore_watermarks ||
-            two_view_geometry.config != TwoViewGeometry::WATERMARK);
-  };
+  // Only decode the inlier matches of pairs within the selected images, so
+  // that loading a subset of a large database does not read all matches.
+  size_t num_ignored_image_pairs = 0;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> inlier_matches;
+  database.VisitTwoViewGeometries(
+      [&](const image_pair_t pair_id, const size_t num_inliers) {
+        const auto [image_id1, image_id2] =
+            Database::PairIdToImagePair(pair_id);
+        if (num_inliers < min_num_matches || image_ids.count(image_id1) == 0 ||
+            image_ids.count(image_id2) == 0) {
+          num_ignored_image_pairs += 1;
+          return false;
+        }
+        return true;
+      },
+      [&](const image_pair_t pair_id, TwoViewGeometry&& two_view_geometry) {
+        if (ignore_watermarks &&
+            two_view_geometry.config == TwoViewGeometry::WATERMARK) {
+          num_ignored_image_pairs += 1;
+          return;
+        }
+        image_pairs.push_back(Database::PairIdToImagePair(pair_id));
+        inlier_matches.push_back(std::move(two_view_geometry.inlier_matches));
+      });
+
+  LOG(INFO) << StringPrintf(
+      " %d in %.3fs", image_pairs.size(), timer.ElapsedSeconds());
 
   //////////////////////////////////////////////////////////////////////////////
   // Load images
@@ -104,54 +451,81 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
   timer.Restart();
   LOG(INFO) << "Loading images...";
 
-  std::unordered_set<image_t> image_ids;
-
   {
-    std::vector<class Image> images = database.ReadAllImages();
-    const size_t num_images = images.size();
-
-    // Determines for which images data should be loaded.
-    if (image_names.empty()) {
-      for (const auto& image : images) {
-        image_ids.insert(image.ImageId());
-      }
-    } else {
-      for (const auto& image : images) {
-        if (image_names.count(image.Name()) > 0) {
-          image_ids.insert(image.ImageId());
-        }
-      }
-    }
-
     // Collect all images that are connected in the correspondence graph.
     std::unordered_set<image_t> connected_image_ids;
     connected_image_ids.reserve(image_ids.size());
-    for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-      if (UseInlierMatchesCheck(two_view_geometries[i])) {
-        image_t image_id1;
-        image_t image_id2;
-        std::tie(image_id1, image_id2) =
-            Database::PairIdToImagePair(image_pair_ids[i]);
-        if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
-          connected_image_ids.insert(image_id1);
-          connected_image_ids.insert(image_id2);
-        }
-      }
+    for (const auto& [image_id1, image_id2] : image_pairs) {
+      connected_image_ids.insert(image_id1);
+      connected_image_ids.insert(image_id2);
     }
 
     // Load images with correspondences and discard images without
     // correspondences, as those images are useless for SfM.
-    cache->images_.reserve(connected_image_ids.size());
+    std::vector<class Image*> store_images;
+    std::vector<class Image*> database_images;
     for (auto& image : images) {
       const image_t image_id = image.ImageId();
       if (image_ids.count(image_id) > 0 &&
           connected_image_ids.count(image_id) > 0) {
-        image.SetPoints2D(
-            FeatureKeypointsToPointsVector(database.ReadKeypoints(image_id)));
-        cache->images_.emplace(image_id, std::move(image));
+        if (!load_points2D) {
+          // Only the number of points is needed to build the graph.
+          if (feature_store != nullptr &&
+              feature_store->ExistsKeypoints(image_id)) {
+            num_points2D_.emplace(image_id,
+                                  feature_store->KeypointsData(image_id).size);
+          } else {
+            num_points2D_.emplace(image_id,
+                                  database.NumKeypointsForImage(image_id));
+          }
+          images_.emplace(image_id, std::move(image));
+        } else if (feature_store != nullptr &&
+            feature_store->ExistsKeypoints(image_id)) {
+          store_images.push_back(&image);
+        } else {
+          database_images.push_back(&image);
+        }
+      }
+    }
+
+    // The keypoints in the memory-mapped feature store can be read in
+    // parallel, whereas the database connection can only be used by a single
+    // thread at a time.
+    if (!store_images.empty()) {
+      ThreadPool thread_pool;
+      std::vector<std::future<void>> futures;
+      futures.reserve(store_images.size());
+      for (class Image* image : store_images) {
+        futures.push_back(thread_pool.AddTask([feature_store, image]() {
+          const FeatureStore::KeypointsView keypoints =
+              feature_store->KeypointsData(image->ImageId());
+          std::vector<Eigen::Vector2d> points(keypoints.size);
+          for (size_t i = 0; i < keypoints.size; ++i) {
+            points[i] =
+                Eigen::Vector2d(keypoints.data[i].x, keypoints.data[i].y);
+          }
+          image->SetPoints2D(points);
+        }));
+      }
+      for (auto& future : futures) {
+        future.get();
       }
     }
 
+    for (class Image* image : database_images) {
+      image->SetPoints2D(FeatureKeypointsToPointsVector(
+          database.ReadKeypoints(image->ImageId())));
+    }
+
+    images_.reserve(images_.size() + store_images.size() +
+                    database_images.size());
+    for (class Image* image : store_images) {
+      images_.emplace(image->ImageId(), std::move(*image));
+    }
+    for (class Image* image : database_images) {
+      images_.emplace(image->ImageId(), std::move(*image));
+    }
+
     LOG(INFO) << StringPrintf(" %d in %.3fs (connected %d)",
                               num_images,
                               timer.ElapsedSeconds(),
@@ -165,38 +539,182 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
   timer.Restart();
   LOG(INFO) << "Building correspondence graph...";
 
-  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
+  correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
 
-  for (const auto& image : cache->images_) {
-    cache->correspondence_graph_->AddImage(image.first,
-                                           image.second.NumPoints2D());
+  for (const auto& image : images_) {
+    correspondence_graph_->AddImage(image.first,
+                                    NumPoints2DForImage(image.first));
   }
 
-  size_t num_ignored_image_pairs = 0;
-  for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-    if (UseInlierMatchesCheck(two_view_geometries[i])) {
-      image_t image_id1;
-      image_t image_id2;
-      std::tie(image_id1, image_id2) =
-          Database::PairIdToImagePair(image_pair_ids[i]);
-      if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
-        cache->correspondence_graph_->AddCorrespondences(
-            image_id1, image_id2, two_view_geometries[i].inlier_matches);
-      } else {
-        num_ignored_image_pairs += 1;
+  correspondence_graph_->AddCorrespondencesBatch(
+      image_pairs, GetMatchesPtrs(inlier_matches));
+  correspondence_graph_->Finalize();
+
+  LOG(INFO) << StringPrintf(" in %.3fs (ignored %d)",
+                            timer.ElapsedSeconds(),
+                            num_ignored_image_pairs);
+
+  std::vector<image_t> loaded_image_ids;
+  loaded_image_ids.reserve(images_.size());
+  for (const auto& image : images_) {
+    loaded_image_ids.push_back(image.first);
+  }
+  ReadPosePriors(database, loaded_image_ids, &pose_priors_);
+}
+
+void DatabaseCache::ComputeTracks(const int num_threads) {
+  correspondence_graph_->ComputeTracks(num_threads);
+}
+
+std::vector<image_t> DatabaseCache::AddNewImages(
+    const Database& database,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::unordered_set<std::string>& image_names) {
+  THROW_CHECK(parent_ == nullptr) << "Cannot add images to a subset";
+  THROW_CHECK_NOTNULL(correspondence_graph_);
+
+  std::unordered_map<image_t, class Image> new_images;
+  for (auto& image : database.ReadAllImages()) {
+    if (!ExistsImage(image.ImageId()) &&
+        (image_names.empty() || image_names.count(image.Name()) > 0)) {
+      new_images.emplace(image.ImageId(), std::move(image));
+    }
+  }
+  if (new_images.empty()) {
+    return {};
+  }
+
+  // Only the two-view geometries of the image pairs with a new image are read.
+  std::vector<std::pair<image_t, image_t>> num_inliers_image_pairs;
+  std::vector<int> num_inliers;
+  database.ReadTwoViewGeometryNumInliers(&num_inliers_image_pairs,
+                                         &num_inliers);
+
+  std::vector<std::pair<image_t, image_t>> candidate_image_pairs;
+  for (size_t i = 0; i < num_inliers_image_pairs.size(); ++i) {
+    if (static_cast<size_t>(num_inliers[i]) < min_num_matches) {
+      continue;
+    }
+    const auto [image_id1, image_id2] = num_inliers_image_pairs[i];
+    const bool is_new1 = new_images.count(image_id1) > 0;
+    const bool is_new2 = new_images.count(image_id2) > 0;
+    if ((is_new1 || is_new2) &&
+        (is_new1 || correspondence_graph_->ExistsImage(image_id1)) &&
+        (is_new2 || correspondence_graph_->ExistsImage(image_id2))) {
+      candidate_image_pairs.emplace_back(image_id1, image_id2);
+    }
+  }
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<FeatureMatches> inlier_matches;
+  ReadInlierMatches(database,
+                    min_num_matches,
+                    ignore_watermarks,
+                    candidate_image_pairs,
+                    &image_pairs,
+                    &inlier_matches);
+
+  std::unordered_set<image_t> connected_image_ids;
+  for (const auto& [image_id1, image_id2] : image_pairs) {
+    for (const image_t image_id : {image_id1, image_id2}) {
+      if (new_images.count(image_id) > 0) {
+        connected_image_ids.insert(image_id);
       }
+    }
+  }
+
+  std::vector<image_t> added_image_ids(connected_image_ids.begin(),
+                                       connected_image_ids.end());
+  std::sort(added_image_ids.begin(), added_image_ids.end());
+
+  std::vector<std::pair<image_t, size_t>> graph_images;
+  graph_images.reserve(added_image_ids.size());
+  for (const image_t image_id : added_image_ids) {
+    class Image& image = new_images.at(image_id);
+    if (!ExistsCamera(image.CameraId())) {
+      cameras_.emplace(image.CameraId(), database.ReadCamera(image.CameraId()));
+    }
+    if (compact_) {
+      std::vector<Eigen::Vector2f> points =
+          ReadCompactPoints2D(database, /*feature_store=*/nullptr, image_id);
+      num_points2D_.emplace(image_id, points.size());
+      compact_points2D_.emplace(image_id, std::move(points));
+    } else if (IsLazy()) {
+      num_points2D_.emplace(image_id, database.NumKeypointsForImage(image_id));
     } else {
-      num_ignored_image_pairs += 1;
+      image.SetPoints2D(
+          FeatureKeypointsToPointsVector(database.ReadKeypoints(image_id)));
     }
+    images_.emplace(image_id, std::move(image));
+    graph_images.emplace_back(image_id, NumPoints2DForImage(image_id));
   }
 
-  cache->correspondence_graph_->Finalize();
+  correspondence_graph_->Extend(
+      graph_images, image_pairs, GetMatchesPtrs(inlier_matches));
+  ReadPosePriors(database, added_image_ids, &pose_priors_);
 
-  LOG(INFO) << StringPrintf(" in %.3fs (ignored %d)",
-                            timer.ElapsedSeconds(),
-                            num_ignored_image_pairs);
+  return added_image_ids;
+}
 
-  return cache;
+size_t DatabaseCache::NumBytes() const {
+  size_t num_bytes = EstimateNumBytes(cameras_) + EstimateNumBytes(images_) +
+                     EstimateNumBytes(pose_priors_) +
+                     EstimateNumBytes(compact_points2D_) +
+                     EstimateNumBytes(num_points2D_);
+  for (const auto& camera : cameras_) {
+    num_bytes += EstimateNumBytes(camera.second.params);
+  }
+  for (const auto& image : images_) {
+    num_bytes += EstimateNumBytes(image.second.Points2D()) +
+                 image.second.Name().capacity();
+  }
+  for (const auto& points2D : compact_points2D_) {
+    num_bytes += EstimateNumBytes(points2D.second);
+  }
+  {
+    std::lock_guard<std::mutex> lock(points2D_mutex_);
+    if (points2D_cache_) {
+      num_bytes += points2D_cache_->NumBytes();
+    }
+  }
+  return num_bytes;
+}
+
+point2D_t DatabaseCache::NumPoints2DForImage(const image_t image_id) const {
+  if (IsLazy()) {
+    return num_points2D_.at(image_id);
+  }
+  return images_.at(image_id).NumPoints2D();
+}
+
+std::shared_ptr<const std::vector<Eigen::Vector2d>> DatabaseCache::Points2D(
+    const image_t image_id) const {
+  if (!IsLazy()) {
+    const class Image& image = images_.at(image_id);
+    auto points = std::make_shared<std::vector<Eigen::Vector2d>>();
+    points->reserve(image.NumPoints2D());
+    for (const auto& point2D : image.Points2D()) {
+      points->push_back(point2D.xy);
+    }
+    return points;
+  }
+  THROW_CHECK(ExistsImage(image_id));
+  if (parent_ != nullptr) {
+    return parent_->Points2D(image_id);
+  }
+  if (compact_) {
+    const std::vector<Eigen::Vector2f>& compact_points =
+        compact_points2D_.at(image_id);
+    auto points =
+        std::make_shared<std::vector<Eigen::Vector2d>>(compact_points.size());
+    for (size_t i = 0; i < compact_points.size(); ++i) {
+      (*points)[i] = compact_points[i].cast<double>();
+    }
+    return points;
+  }
+  std::lock_guard<std::mutex> lock(points2D_mutex_);
+  return points2D_cache_->Get(image_id).points;
 }
 
 const class Image* DatabaseCache::FindImageWithName(
@@ -30,14 +30,18 @@
 #pragma once
 
 #include "colmap/scene/camera.h"
+#include "colmap/geometry/gps.h"
 #include "colmap/scene/correspondence_graph.h"
 #include "colmap/scene/database.h"
+#include "colmap/scene/feature_store.h"
 #include "colmap/scene/image.h"
 #include "colmap/sensor/models.h"
+#include "colmap/util/cache.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -51,7 +55,7 @@ namespace colmap {
 // create new reconstruction instances when multiple models are reconstructed.
 class DatabaseCache {
  public:
-  // Load cameras, images, features, and matches from database.
+  // Load cameras, images, pose priors, features, and matches from database.
   //
   // @param database              Source database from which to load data.
   // @param min_num_matches       Only load image pairs with a minimum number
@@ -59,16 +63,88 @@ class DatabaseCache {
   // @param ignore_watermarks     Whether to ignore watermark image pairs.
   // @param image_names           Whether to use only load the data for a subset
   //                              of the images. All images are used if empty.
+  // @param feature_store         Optional store from which to read keypoints
+  //                              instead of the database.
   static std::shared_ptr<DatabaseCache> Create(
+      const Database& database,
+      size_t min_num_matches,
+      bool ignore_watermarks,
+      const std::unordered_set<std::string>& image_names,
+      const FeatureStore* feature_store = nullptr);
+
+  // Same as Create, but the 2D points of the images are not loaded up front.
+  // Instead, they are read on demand through Points2D from a separate
+  // connection to the database at the given path or from the feature store.
+  // Recently used 2D points are kept in memory up to the given number of bytes.
+  static std::shared_ptr<DatabaseCache> CreateLazy(
+      const std::string& database_path,
+      size_t min_num_matches,
+      bool ignore_watermarks,
+      const std::unordered_set<std::string>& image_names,
+      std::shared_ptr<const FeatureStore> feature_store,
+      size_t max_points2D_num_bytes);
+
+  // Same as Create, but the 2D points of the images are kept in a compact
+  // per-image array of single-precision coordinates instead of the cached
+  // images, which reduces their memory by a factor of three. The keypoints are
+  // stored in single precision, such that no accuracy is lost. The cache is
+  // lazy and Points2D converts the coordinates of an image on demand.
+  static std::shared_ptr<DatabaseCache> CreateCompact(
+      const Database& database,
+      size_t min_num_matches,
+      bool ignore_watermarks,
+      const std::unordered_set<std::string>& image_names,
+      const FeatureStore* feature_store = nullptr);
+
+  // Load only the given images, the images matched to them, and the image
+  // pairs between all of these images, e.g., to register a few new images to
+  // a large reconstruction. In contrast to Create, only the number of inlier
+  // matches is read for the other image pairs and the data of the other
+  // images is not read at all.
+  static std::shared_ptr<DatabaseCache> CreateNeighborhood(
+      const Database& database,
+      size_t min_num_matches,
+      bool ignore_watermarks,
+      const std::unordered_set<image_t>& image_ids,
+      const FeatureStore* feature_store = nullptr);
+
+  // Create a lightweight view on a subset of the images of another cache
+  // without reading the database again, e.g., for the clusters of the
+  // hierarchical mapper. The correspondence graph is restricted to the pairs
+  // with both images in the subset and images without correspondences in the
+  // subset are discarded. The view is lazy and reads the 2D points on demand
+  // from the given cache, which must not be modified during its life-time.
+  static std::shared_ptr<DatabaseCache> CreateSubset(
+      std::shared_ptr<const DatabaseCache> database_cache,
+      const std::unordered_set<image_t>& image_ids);
+
+  // Add the images that were written to the database after the cache was
+  // loaded, together with their cameras, features, and the matches of their
+  // image pairs, without reading the already cached images again. As in
+  // Create, only images with correspondences are added. The matches between
+  // already cached images are not updated. The correspondence graph is
+  // extended in place, such that the cache must not be used concurrently.
+  // Returns the identifiers of the added images.
+  std::vector<image_t> AddNewImages(
       const Database& database,
       size_t min_num_matches,
       bool ignore_watermarks,
       const std::unordered_set<std::string>& image_names);
 
+  // Precompute the tracks of the correspondence graph, see
+  // `CorrespondenceGraph::ComputeTracks`. The tracks are kept up to date by
+  // AddNewImages. Must not be called concurrently with other accessors.
+  void ComputeTracks(int num_threads = -1);
+
   // Get number of objects.
   inline size_t NumCameras() const;
   inline size_t NumImages() const;
 
+  // Estimated memory usage of the cached cameras, images, and 2D points in
+  // bytes. The memory of the correspondence graph, see
+  // `CorrespondenceGraph::NumBytes`, and of a parent cache is excluded.
+  size_t NumBytes() const;
+
   // Get specific objects.
   inline struct Camera& Camera(camera_t camera_id);
   inline const struct Camera& Camera(camera_t camera_id) const;
@@ -83,6 +159,23 @@ class DatabaseCache {
   inline bool ExistsCamera(camera_t camera_id) const;
   inline bool ExistsImage(image_t image_id) const;
 
+  // Get the valid pose prior of an image, if the database contains one.
+  inline bool ExistsPosePrior(image_t image_id) const;
+  inline const struct PosePrior& PosePrior(image_t image_id) const;
+
+  // Whether the 2D points of the images are loaded on demand, in which case
+  // the cached images do not contain any 2D points.
+  inline bool IsLazy() const;
+
+  // Get the number of 2D points of an image, also if they are not loaded.
+  point2D_t NumPoints2DForImage(image_t image_id) const;
+
+  // Get the 2D point coordinates of an image. In lazy mode, they are read from
+  // the database, the feature store, or the cache of a subset, if they are not
+  // in memory. This method is thread-safe.
+  std::shared_ptr<const std::vector<Eigen::Vector2d>> Points2D(
+      image_t image_id) const;
+
   // Get reference to const correspondence graph.
   inline std::shared_ptr<const class CorrespondenceGraph> CorrespondenceGraph()
       const;
@@ -91,10 +184,38 @@ class DatabaseCache {
   const class Image* FindImageWithName(const std::string& name) const;
 
  private:
+  void Load(const Database& database,
+            size_t min_num_matches,
+            bool ignore_watermarks,
+            const std::unordered_set<std::string>& image_names,
+            const FeatureStore* feature_store,
+            bool load_points2D);
+
   std::shared_ptr<class CorrespondenceGraph> correspondence_graph_;
 
   std::unordered_map<camera_t, struct Camera> cameras_;
   std::unordered_map<image_t, class Image> images_;
+  std::unordered_map<image_t, struct PosePrior> pose_priors_;
+
+  // Only used in lazy mode.
+  struct CachedPoints2D {
+    std::shared_ptr<const std::vector<Eigen::Vector2d>> points;
+    size_t NumBytes() const {
+      return points == nullptr ? 0 : points->size() * sizeof(Eigen::Vector2d);
+    }
+  };
+
+  std::unique_ptr<Database> database_;
+  std::shared_ptr<const FeatureStore> feature_store_;
+  // Only used for subsets of another cache.
+  std::shared_ptr<const DatabaseCache> parent_;
+  // Only used in compact mode.
+  bool compact_ = false;
+  std::unordered_map<image_t, std::vector<Eigen::Vector2f>> compact_points2D_;
+  std::unordered_map<image_t, point2D_t> num_points2D_;
+  mutable std::mutex points2D_mutex_;
+  mutable std::unique_ptr<MemoryConstrainedLRUCache<image_t, CachedPoints2D>>
+      points2D_cache_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -137,6 +258,18 @@ bool DatabaseCache::ExistsImage(const image_t image_id) const {
   return images_.find(image_id) != images_.end();
 }
 
+bool DatabaseCache::ExistsPosePrior(const image_t image_id) const {
+  return pose_priors_.find(image_id) != pose_priors_.end();
+}
+
+const struct PosePrior& DatabaseCache::PosePrior(const image_t image_id) const {
+  return pose_priors_.at(image_id);
+}
+
+bool DatabaseCache::IsLazy() const {
+  return points2D_cache_ != nullptr || parent_ != nullptr || compact_;
+}
+
 std::shared_ptr<const class CorrespondenceGraph>
 DatabaseCache::CorrespondenceGraph() const {
   return correspondence_graph_;
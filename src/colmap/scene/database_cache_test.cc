@@ -29,6 +29,8 @@
 
 #include "colmap/scene/database_cache.h"
 
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -90,5 +92,352 @@ TEST(DatabaseCache, Nominal) {
             1);
 }
 
+TEST(DatabaseCache, PosePriors) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  Image image1;
+  image1.SetName("image1");
+  image1.SetCameraId(camera_id);
+  Image image2;
+  image2.SetName("image2");
+  image2.SetCameraId(camera_id);
+  const image_t image_id1 = database.WriteImage(image1);
+  const image_t image_id2 = database.WriteImage(image2);
+  database.WriteKeypoints(image_id1, FeatureKeypoints(10));
+  database.WriteKeypoints(image_id2, FeatureKeypoints(5));
+  database.WritePosePrior(
+      image_id1,
+      PosePrior(Eigen::Vector3d(1, 2, 3),
+                PosePrior::CoordinateSystem::CARTESIAN));
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{0, 1}};
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  auto cache = DatabaseCache::Create(database,
+                                     /*min_num_matches=*/0,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{});
+  EXPECT_TRUE(cache->ExistsPosePrior(image_id1));
+  EXPECT_FALSE(cache->ExistsPosePrior(image_id2));
+  EXPECT_EQ(cache->PosePrior(image_id1).position, Eigen::Vector3d(1, 2, 3));
+  EXPECT_EQ(cache->PosePrior(image_id1).coordinate_system,
+            PosePrior::CoordinateSystem::CARTESIAN);
+  auto subset = DatabaseCache::CreateSubset(cache, {image_id1, image_id2});
+  EXPECT_TRUE(subset->ExistsPosePrior(image_id1));
+  EXPECT_FALSE(subset->ExistsPosePrior(image_id2));
+}
+
+TEST(DatabaseCache, Lazy) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+  Database database(database_path);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  Image image1;
+  image1.SetName("image1");
+  image1.SetCameraId(camera_id);
+  Image image2;
+  image2.SetName("image2");
+  image2.SetCameraId(camera_id);
+  const image_t image_id1 = database.WriteImage(image1);
+  const image_t image_id2 = database.WriteImage(image2);
+  FeatureKeypoints keypoints1(10);
+  for (size_t i = 0; i < keypoints1.size(); ++i) {
+    keypoints1[i].x = i;
+    keypoints1[i].y = 2 * i;
+  }
+  database.WriteKeypoints(image_id1, keypoints1);
+  database.WriteKeypoints(image_id2, FeatureKeypoints(5));
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{0, 1}};
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+
+  // Only keep a single image in memory.
+  auto cache = DatabaseCache::CreateLazy(database_path,
+                                         /*min_num_matches=*/0,
+                                         /*ignore_watermarks=*/false,
+                                         /*image_names=*/{},
+                                         /*feature_store=*/nullptr,
+                                         /*max_points2D_num_bytes=*/1);
+  EXPECT_TRUE(cache->IsLazy());
+  EXPECT_EQ(cache->NumImages(), 2);
+  EXPECT_EQ(cache->Image(image_id1).NumPoints2D(), 0);
+  EXPECT_EQ(cache->Image(image_id2).NumPoints2D(), 0);
+  EXPECT_EQ(cache->NumPoints2DForImage(image_id1), 10);
+  EXPECT_EQ(cache->NumPoints2DForImage(image_id2), 5);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumPoints2DForImage(image_id1), 10);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumPoints2DForImage(image_id2), 5);
+  for (int i = 0; i < 2; ++i) {
+    const auto points1 = cache->Points2D(image_id1);
+    ASSERT_EQ(points1->size(), 10);
+    for (size_t j = 0; j < points1->size(); ++j) {
+      EXPECT_EQ((*points1)[j], Eigen::Vector2d(j, 2 * j));
+    }
+    EXPECT_EQ(cache->Points2D(image_id2)->size(), 5);
+  }
+  EXPECT_ANY_THROW(cache->Points2D(image_id2 + 1));
+
+  auto eager_cache = DatabaseCache::Create(database,
+                                           /*min_num_matches=*/0,
+                                           /*ignore_watermarks=*/false,
+                                           /*image_names=*/{});
+  EXPECT_FALSE(eager_cache->IsLazy());
+  EXPECT_EQ(eager_cache->NumPoints2DForImage(image_id1), 10);
+  EXPECT_EQ(*eager_cache->Points2D(image_id1), *cache->Points2D(image_id1));
+}
+
+TEST(DatabaseCache, Compact) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  Image image1;
+  image1.SetName("image1");
+  image1.SetCameraId(camera_id);
+  Image image2;
+  image2.SetName("image2");
+  image2.SetCameraId(camera_id);
+  const image_t image_id1 = database.WriteImage(image1);
+  const image_t image_id2 = database.WriteImage(image2);
+  FeatureKeypoints keypoints1(10);
+  for (size_t i = 0; i < keypoints1.size(); ++i) {
+    keypoints1[i].x = i + 0.25f;
+    keypoints1[i].y = 2 * i + 0.5f;
+  }
+  database.WriteKeypoints(image_id1, keypoints1);
+  database.WriteKeypoints(image_id2, FeatureKeypoints(5));
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{0, 1}};
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+
+  auto cache = DatabaseCache::CreateCompact(database,
+                                            /*min_num_matches=*/0,
+                                            /*ignore_watermarks=*/false,
+                                            /*image_names=*/{});
+  EXPECT_TRUE(cache->IsLazy());
+  EXPECT_EQ(cache->NumImages(), 2);
+  EXPECT_EQ(cache->Image(image_id1).NumPoints2D(), 0);
+  EXPECT_EQ(cache->NumPoints2DForImage(image_id1), 10);
+  EXPECT_EQ(cache->NumPoints2DForImage(image_id2), 5);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumPoints2DForImage(image_id1), 10);
+
+  auto eager_cache = DatabaseCache::Create(database,
+                                           /*min_num_matches=*/0,
+                                           /*ignore_watermarks=*/false,
+                                           /*image_names=*/{});
+  EXPECT_EQ(*eager_cache->Points2D(image_id1), *cache->Points2D(image_id1));
+  EXPECT_EQ(*eager_cache->Points2D(image_id2), *cache->Points2D(image_id2));
+  EXPECT_ANY_THROW(cache->Points2D(image_id2 + 1));
+
+  auto subset = DatabaseCache::CreateSubset(cache, {image_id1, image_id2});
+  EXPECT_EQ(*subset->Points2D(image_id1), *cache->Points2D(image_id1));
+
+  Image image3;
+  image3.SetName("image3");
+  image3.SetCameraId(camera_id);
+  const image_t image_id3 = database.WriteImage(image3);
+  database.WriteKeypoints(image_id3, FeatureKeypoints(3));
+  database.WriteTwoViewGeometry(image_id1, image_id3, two_view_geometry);
+  EXPECT_EQ(cache->AddNewImages(database,
+                                /*min_num_matches=*/0,
+                                /*ignore_watermarks=*/false,
+                                /*image_names=*/{}),
+            std::vector<image_t>{image_id3});
+  EXPECT_EQ(cache->NumPoints2DForImage(image_id3), 3);
+  EXPECT_EQ(cache->Points2D(image_id3)->size(), 3);
+}
+
+TEST(DatabaseCache, Subset) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 3; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    FeatureKeypoints keypoints(10 + i);
+    for (size_t j = 0; j < keypoints.size(); ++j) {
+      keypoints[j].x = i;
+      keypoints[j].y = j;
+    }
+    database.WriteKeypoints(image_ids.back(), keypoints);
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{0, 1}, {2, 3}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+  two_view_geometry.inlier_matches = {{4, 5}};
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+  auto cache = DatabaseCache::Create(database,
+                                     /*min_num_matches=*/0,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{});
+  ASSERT_EQ(cache->NumImages(), 3);
+
+  auto subset =
+      DatabaseCache::CreateSubset(cache, {image_ids[0], image_ids[1]});
+  EXPECT_TRUE(subset->IsLazy());
+  EXPECT_EQ(subset->NumCameras(), 1);
+  EXPECT_TRUE(subset->ExistsCamera(camera_id));
+  EXPECT_EQ(subset->NumImages(), 2);
+  EXPECT_TRUE(subset->ExistsImage(image_ids[0]));
+  EXPECT_TRUE(subset->ExistsImage(image_ids[1]));
+  EXPECT_FALSE(subset->ExistsImage(image_ids[2]));
+  EXPECT_EQ(subset->Image(image_ids[0]).Name(), "image0");
+  EXPECT_EQ(subset->Image(image_ids[0]).NumPoints2D(), 0);
+  EXPECT_EQ(subset->NumPoints2DForImage(image_ids[0]), 10);
+  EXPECT_EQ(subset->NumPoints2DForImage(image_ids[1]), 11);
+  EXPECT_EQ(*subset->Points2D(image_ids[1]), *cache->Points2D(image_ids[1]));
+  EXPECT_ANY_THROW(subset->Points2D(image_ids[2]));
+  const auto correspondence_graph = subset->CorrespondenceGraph();
+  EXPECT_EQ(correspondence_graph->NumImages(), 2);
+  EXPECT_EQ(correspondence_graph->NumCorrespondencesBetweenImages(
+                image_ids[0], image_ids[1]),
+            2);
+  EXPECT_EQ(correspondence_graph->NumCorrespondencesForImage(image_ids[1]), 2);
+  EXPECT_FALSE(correspondence_graph->ExistsImage(image_ids[2]));
+
+  // Images without correspondences in the subset are discarded.
+  auto disconnected_subset =
+      DatabaseCache::CreateSubset(cache, {image_ids[0], image_ids[2]});
+  EXPECT_EQ(disconnected_subset->NumImages(), 0);
+  EXPECT_EQ(disconnected_subset->NumCameras(), 0);
+}
+
+TEST(DatabaseCache, Neighborhood) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 4; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(database.WriteCamera(camera));
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10 + i));
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{0, 1}, {2, 3}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+  two_view_geometry.inlier_matches = {{4, 5}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[2], two_view_geometry);
+  database.WriteTwoViewGeometry(image_ids[2], image_ids[3], two_view_geometry);
+
+  // The pairs between the neighbors are loaded, too.
+  auto cache = DatabaseCache::CreateNeighborhood(database,
+                                                 /*min_num_matches=*/0,
+                                                 /*ignore_watermarks=*/false,
+                                                 /*image_ids=*/{image_ids[0]});
+  EXPECT_FALSE(cache->IsLazy());
+  EXPECT_EQ(cache->NumImages(), 3);
+  EXPECT_EQ(cache->NumCameras(), 3);
+  EXPECT_FALSE(cache->ExistsImage(image_ids[3]));
+  EXPECT_FALSE(
+      cache->ExistsCamera(database.ReadImage(image_ids[3]).CameraId()));
+  EXPECT_EQ(cache->Image(image_ids[1]).Name(), "image1");
+  EXPECT_EQ(cache->Image(image_ids[1]).NumPoints2D(), 11);
+  auto correspondence_graph = cache->CorrespondenceGraph();
+  EXPECT_EQ(correspondence_graph->NumImagePairs(), 3);
+  EXPECT_EQ(correspondence_graph->NumCorrespondencesBetweenImages(image_ids[1],
+                                                                  image_ids[2]),
+            2);
+
+  // Image pairs with too few matches do not extend the neighborhood.
+  cache = DatabaseCache::CreateNeighborhood(database,
+                                            /*min_num_matches=*/2,
+                                            /*ignore_watermarks=*/false,
+                                            /*image_ids=*/{image_ids[3]});
+  EXPECT_EQ(cache->NumImages(), 0);
+  cache = DatabaseCache::CreateNeighborhood(database,
+                                            /*min_num_matches=*/1,
+                                            /*ignore_watermarks=*/false,
+                                            /*image_ids=*/{image_ids[3]});
+  EXPECT_EQ(cache->NumImages(), 2);
+  EXPECT_TRUE(cache->ExistsImage(image_ids[2]));
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumImagePairs(), 1);
+}
+
+TEST(DatabaseCache, AddNewImages) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  auto WriteImage = [&database](const std::string& name,
+                                const camera_t camera_id,
+                                const size_t num_points2D) {
+    Image image;
+    image.SetName(name);
+    image.SetCameraId(camera_id);
+    const image_t image_id = database.WriteImage(image);
+    database.WriteKeypoints(image_id, FeatureKeypoints(num_points2D));
+    return image_id;
+  };
+  const image_t image_id1 = WriteImage("image1", camera_id, 10);
+  const image_t image_id2 = WriteImage("image2", camera_id, 5);
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = {{0, 1}};
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  auto cache = DatabaseCache::Create(database,
+                                     /*min_num_matches=*/0,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{});
+  ASSERT_EQ(cache->NumImages(), 2);
+  EXPECT_TRUE(cache->AddNewImages(database,
+                                  /*min_num_matches=*/0,
+                                  /*ignore_watermarks=*/false,
+                                  /*image_names=*/{})
+                  .empty());
+
+  // The new image matched to an existing image is added with its new camera,
+  // whereas the new image without matches is ignored.
+  const camera_t new_camera_id = database.WriteCamera(camera);
+  const image_t image_id3 = WriteImage("image3", new_camera_id, 7);
+  const image_t image_id4 = WriteImage("image4", camera_id, 3);
+  two_view_geometry.inlier_matches = {{2, 3}, {4, 5}};
+  database.WriteTwoViewGeometry(image_id1, image_id3, two_view_geometry);
+  EXPECT_EQ(cache->AddNewImages(database,
+                                /*min_num_matches=*/0,
+                                /*ignore_watermarks=*/false,
+                                /*image_names=*/{}),
+            std::vector<image_t>({image_id3}));
+  EXPECT_EQ(cache->NumCameras(), 2);
+  EXPECT_TRUE(cache->ExistsCamera(new_camera_id));
+  EXPECT_EQ(cache->NumImages(), 3);
+  EXPECT_FALSE(cache->ExistsImage(image_id4));
+  EXPECT_EQ(cache->Image(image_id3).NumPoints2D(), 7);
+  const auto correspondence_graph = cache->CorrespondenceGraph();
+  EXPECT_EQ(correspondence_graph->NumImages(), 3);
+  EXPECT_EQ(correspondence_graph->NumCorrespondencesForImage(image_id1), 3);
+  EXPECT_EQ(correspondence_graph->NumObservationsForImage(image_id1), 3);
+  EXPECT_EQ(correspondence_graph->NumCorrespondencesBetweenImages(image_id1,
+                                                                  image_id3),
+            2);
+  const auto range = correspondence_graph->FindCorrespondences(image_id3, 5);
+  ASSERT_EQ(range.end - range.beg, 1);
+  EXPECT_EQ(range.beg->image_id, image_id1);
+  EXPECT_EQ(range.beg->point2D_idx, 4);
+
+  // Image pairs with too few matches are ignored.
+  two_view_geometry.inlier_matches = {{0, 0}};
+  database.WriteTwoViewGeometry(image_id2, image_id4, two_view_geometry);
+  EXPECT_TRUE(cache->AddNewImages(database,
+                                  /*min_num_matches=*/2,
+                                  /*ignore_watermarks=*/false,
+                                  /*image_names=*/{})
+                  .empty());
+  EXPECT_EQ(cache->AddNewImages(database,
+                                /*min_num_matches=*/1,
+                                /*ignore_watermarks=*/false,
+                                /*image_names=*/{}),
+            std::vector<image_t>({image_id4}));
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumCorrespondencesForImage(image_id2),
+            2);
+}
+
 }  // namespace
 }  // namespace colmap
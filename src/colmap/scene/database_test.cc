@@ -32,9 +32,11 @@
 #include "colmap/geometry/pose.h"
 #include "colmap/util/eigen_alignment.h"
 
+#include <memory>
 #include <thread>
 
 #include <Eigen/Geometry>
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -54,6 +56,17 @@ TEST(Database, Transaction) {
   DatabaseTransaction database_transaction(&database);
 }
 
+TEST(Database, Profile) {
+  Database database(Database::kInMemoryDatabasePath);
+  database.SetProfile(Database::Profile::BULK);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+  camera.camera_id = database.WriteCamera(camera);
+  EXPECT_EQ(database.ReadCamera(camera.camera_id).params, camera.params);
+  database.SetProfile(Database::Profile::DEFAULT);
+  EXPECT_EQ(database.ReadCamera(camera.camera_id).params, camera.params);
+}
+
 TEST(Database, TransactionMultiThreaded) {
   Database database(Database::kInMemoryDatabasePath);
 
@@ -200,6 +213,95 @@ TEST(Database, PosePrior) {
   EXPECT_EQ(database.NumPosePriors(), 0);
 }
 
+TEST(Database, ImageSignature) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  Image image;
+  image.SetName("test");
+  image.SetCameraId(camera.camera_id);
+  image.SetImageId(database.WriteImage(image));
+  EXPECT_EQ(database.NumImageSignatures(), 0);
+  EXPECT_FALSE(database.ExistsImageSignature(image.ImageId()));
+  FileSignature signature;
+  signature.size = 1234;
+  signature.modification_time = 1700000000;
+  signature.hash = 0xcbf29ce484222325;
+  database.WriteImageSignature(image.ImageId(), signature);
+  EXPECT_EQ(database.NumImageSignatures(), 1);
+  EXPECT_TRUE(database.ExistsImageSignature(image.ImageId()));
+  EXPECT_EQ(database.ReadImageSignature(image.ImageId()), signature);
+  signature.hash += 1;
+  database.WriteImageSignature(image.ImageId(), signature);
+  EXPECT_EQ(database.NumImageSignatures(), 1);
+  EXPECT_EQ(database.ReadImageSignature(image.ImageId()), signature);
+  database.ClearImageSignatures();
+  EXPECT_EQ(database.NumImageSignatures(), 0);
+}
+
+TEST(Database, GlobalDescriptor) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  Image image;
+  image.SetName("test");
+  image.SetCameraId(camera.camera_id);
+  image.SetImageId(database.WriteImage(image));
+  EXPECT_EQ(database.NumGlobalDescriptors(), 0);
+  EXPECT_FALSE(database.ExistsGlobalDescriptor(image.ImageId()));
+  EXPECT_EQ(database.ReadGlobalDescriptor(image.ImageId()).size(), 0);
+  Eigen::VectorXf descriptor = Eigen::VectorXf::Random(64);
+  database.WriteGlobalDescriptor(image.ImageId(), descriptor);
+  EXPECT_EQ(database.NumGlobalDescriptors(), 1);
+  EXPECT_TRUE(database.ExistsGlobalDescriptor(image.ImageId()));
+  EXPECT_EQ(database.ReadGlobalDescriptor(image.ImageId()), descriptor);
+  descriptor = Eigen::VectorXf::Random(32);
+  database.WriteGlobalDescriptor(image.ImageId(), descriptor);
+  EXPECT_EQ(database.NumGlobalDescriptors(), 1);
+  EXPECT_EQ(database.ReadGlobalDescriptor(image.ImageId()), descriptor);
+  database.DeleteImageFeatures(image.ImageId());
+  EXPECT_FALSE(database.ExistsGlobalDescriptor(image.ImageId()));
+  database.WriteGlobalDescriptor(image.ImageId(), descriptor);
+  database.ClearGlobalDescriptors();
+  EXPECT_EQ(database.NumGlobalDescriptors(), 0);
+}
+
+TEST(Database, DeleteImageFeatures) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 3; ++i) {
+    Image image;
+    image.SetName(std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10));
+    database.WriteDescriptors(image_ids.back(), FeatureDescriptors(10, 128));
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches.resize(5);
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      database.WriteMatches(image_ids[i], image_ids[j], FeatureMatches(5));
+      database.WriteTwoViewGeometry(
+          image_ids[i], image_ids[j], two_view_geometry);
+    }
+  }
+  EXPECT_EQ(database.NumMatchedImagePairs(), 3);
+  EXPECT_EQ(database.NumVerifiedImagePairs(), 3);
+  database.DeleteImageFeatures(image_ids[1]);
+  EXPECT_EQ(database.NumImages(), 3);
+  EXPECT_TRUE(database.ExistsKeypoints(image_ids[0]));
+  EXPECT_FALSE(database.ExistsKeypoints(image_ids[1]));
+  EXPECT_FALSE(database.ExistsDescriptors(image_ids[1]));
+  EXPECT_TRUE(database.ExistsDescriptors(image_ids[2]));
+  EXPECT_EQ(database.NumMatchedImagePairs(), 1);
+  EXPECT_EQ(database.NumVerifiedImagePairs(), 1);
+  EXPECT_TRUE(database.ExistsMatches(image_ids[0], image_ids[2]));
+  EXPECT_TRUE(database.ExistsInlierMatches(image_ids[2], image_ids[0]));
+}
+
 TEST(Database, Keypoints) {
   Database database(Database::kInMemoryDatabasePath);
   Camera camera;
@@ -270,12 +372,80 @@ TEST(Database, Descriptors) {
   EXPECT_EQ(database.NumDescriptors(), 30);
   EXPECT_EQ(database.MaxNumDescriptors(), 20);
   EXPECT_EQ(database.NumDescriptorsForImage(image.ImageId()), 20);
+  EXPECT_EQ(database.ReadDescriptorsType(image.ImageId()),
+            FeatureDescriptorType::SIFT);
+  const FeatureDescriptors descriptors3 = FeatureDescriptors::Random(5, 32);
+  image.SetName("test3");
+  image.SetImageId(database.WriteImage(image));
+  database.WriteDescriptors(
+      image.ImageId(), descriptors3, FeatureDescriptorType::BINARY);
+  EXPECT_EQ(database.ReadDescriptors(image.ImageId()), descriptors3);
+  EXPECT_EQ(database.ReadDescriptorsType(image.ImageId()),
+            FeatureDescriptorType::BINARY);
+  EXPECT_EQ(database.NumDescriptors(), 35);
   database.ClearDescriptors();
   EXPECT_EQ(database.NumDescriptors(), 0);
   EXPECT_EQ(database.MaxNumDescriptors(), 0);
   EXPECT_EQ(database.NumDescriptorsForImage(image.ImageId()), 0);
 }
 
+TEST(Database, CompressedBlobs) {
+  Database database(Database::kInMemoryDatabasePath);
+  database.SetBlobCompression(true);
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  Image image;
+  image.SetName("test");
+  image.SetCameraId(camera.camera_id);
+  image.SetImageId(database.WriteImage(image));
+  FeatureDescriptors descriptors(100, 128);
+  for (FeatureDescriptors::Index r = 0; r < descriptors.rows(); ++r) {
+    descriptors.row(r).setConstant(r % 8);
+  }
+  database.WriteDescriptors(image.ImageId(), descriptors);
+  EXPECT_EQ(database.ReadDescriptors(image.ImageId()), descriptors);
+  EXPECT_EQ(database.NumDescriptorsForImage(image.ImageId()), 100);
+
+  // Sorted and small, unsorted, and large indices use different encodings.
+  std::vector<FeatureMatches> all_matches(3, FeatureMatches(1000));
+  for (size_t i = 0; i < 1000; ++i) {
+    all_matches[0][i] = FeatureMatch(2 * i, 1000 - i);
+    all_matches[1][i] = FeatureMatch((i * 7) % 1000, i);
+    all_matches[2][i] = FeatureMatch(100000 + i, 200000 + 3 * i);
+  }
+  for (size_t i = 0; i < all_matches.size(); ++i) {
+    const image_t image_id1 = 1;
+    const image_t image_id2 = 2 + i;
+    database.WriteMatches(image_id1, image_id2, all_matches[i]);
+    const FeatureMatches matches12 =
+        database.ReadMatches(image_id1, image_id2);
+    ASSERT_EQ(matches12.size(), all_matches[i].size());
+    for (size_t j = 0; j < matches12.size(); ++j) {
+      EXPECT_EQ(matches12[j].point2D_idx1, all_matches[i][j].point2D_idx1);
+      EXPECT_EQ(matches12[j].point2D_idx2, all_matches[i][j].point2D_idx2);
+    }
+
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.inlier_matches = all_matches[i];
+    database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+    const FeatureMatches inlier_matches =
+        database.ReadTwoViewGeometry(image_id1, image_id2).inlier_matches;
+    ASSERT_EQ(inlier_matches.size(), all_matches[i].size());
+    for (size_t j = 0; j < inlier_matches.size(); ++j) {
+      EXPECT_EQ(inlier_matches[j].point2D_idx1,
+                all_matches[i][j].point2D_idx1);
+      EXPECT_EQ(inlier_matches[j].point2D_idx2,
+                all_matches[i][j].point2D_idx2);
+    }
+  }
+
+  // Blobs written before enabling compression remain readable.
+  database.SetBlobCompression(false);
+  database.WriteMatches(1, 10, all_matches[0]);
+  database.SetBlobCompression(true);
+  EXPECT_EQ(database.ReadMatches(1, 10).size(), all_matches[0].size());
+}
+
 TEST(Database, Matches) {
   Database database(Database::kInMemoryDatabasePath);
   const image_t image_id1 = 1;
@@ -320,6 +490,9 @@ TEST(Database, Matches) {
   EXPECT_EQ(database.ReadAllMatches()[0].first,
             Database::ImagePairToPairId(image_id1, image_id2));
   EXPECT_EQ(database.NumMatches(), kNumMatches);
+  EXPECT_THAT(database.ReadAllMatchedImagePairIds(),
+              testing::ElementsAre(
+                  Database::ImagePairToPairId(image_id1, image_id2)));
   database.DeleteMatches(image_id1, image_id2);
   EXPECT_EQ(database.NumMatches(), 0);
   database.WriteMatches(image_id1, image_id2, matches12);
@@ -328,6 +501,121 @@ TEST(Database, Matches) {
   EXPECT_EQ(database.NumMatches(), 0);
 }
 
+TEST(Database, ReadChunks) {
+  Database database(Database::kInMemoryDatabasePath);
+  constexpr int kNumImages = 6;
+  std::vector<image_pair_t> pair_ids;
+  for (image_t image_id1 = 1; image_id1 <= kNumImages; ++image_id1) {
+    for (image_t image_id2 = image_id1 + 1; image_id2 <= kNumImages;
+         ++image_id2) {
+      const FeatureMatches matches(image_id1 + image_id2);
+      database.WriteMatches(image_id1, image_id2, matches);
+      TwoViewGeometry two_view_geometry;
+      two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+      two_view_geometry.inlier_matches = matches;
+      database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+      pair_ids.push_back(Database::ImagePairToPairId(image_id1, image_id2));
+    }
+  }
+  // Pairs without matches are skipped.
+  database.WriteMatches(1, kNumImages + 1, FeatureMatches());
+  std::sort(pair_ids.begin(), pair_ids.end());
+
+  std::vector<image_pair_t> matches_pair_ids;
+  image_pair_t prev_pair_id = 0;
+  while (true) {
+    const auto chunk =
+        database.ReadMatchesChunk(prev_pair_id, /*max_num_pairs=*/4);
+    for (const auto& [pair_id, matches] : chunk) {
+      const auto [image_id1, image_id2] = Database::PairIdToImagePair(pair_id);
+      EXPECT_EQ(matches.rows(), image_id1 + image_id2);
+      matches_pair_ids.push_back(pair_id);
+    }
+    if (chunk.size() < 4) {
+      break;
+    }
+    prev_pair_id = chunk.back().first;
+    // Other queries are allowed between the chunks.
+    EXPECT_EQ(database.ReadMatches(1, 2).size(), 3);
+  }
+  EXPECT_EQ(matches_pair_ids, pair_ids);
+
+  std::vector<image_pair_t> two_view_geometries_pair_ids;
+  prev_pair_id = 0;
+  while (true) {
+    const auto chunk =
+        database.ReadTwoViewGeometriesChunk(prev_pair_id, /*max_num_pairs=*/5);
+    for (const auto& [pair_id, two_view_geometry] : chunk) {
+      EXPECT_EQ(two_view_geometry.config,
+                TwoViewGeometry::ConfigurationType::CALIBRATED);
+      two_view_geometries_pair_ids.push_back(pair_id);
+    }
+    if (chunk.empty()) {
+      break;
+    }
+    prev_pair_id = chunk.back().first;
+  }
+  EXPECT_EQ(two_view_geometries_pair_ids, pair_ids);
+}
+
+TEST(Database, ReadPages) {
+  Database database(Database::kInMemoryDatabasePath);
+  constexpr int kNumImages = 5;
+  for (int i = 0; i < kNumImages; ++i) {
+    Camera camera = Camera::CreateFromModelName(
+        kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(database.WriteCamera(camera));
+    database.WriteImage(image);
+  }
+
+  std::vector<image_t> image_ids;
+  for (size_t offset = 0; offset < kNumImages; offset += 2) {
+    const std::vector<Image> images =
+        database.ReadImagesPage(offset, /*max_num_images=*/2);
+    EXPECT_EQ(images.size(), std::min<size_t>(2, kNumImages - offset));
+    for (const Image& image : images) {
+      image_ids.push_back(image.ImageId());
+    }
+  }
+  EXPECT_THAT(image_ids, testing::ElementsAre(1, 2, 3, 4, 5));
+  EXPECT_TRUE(database.ReadImagesPage(kNumImages, 2).empty());
+
+  const std::vector<Camera> cameras =
+      database.ReadCamerasPage(/*offset=*/3, /*max_num_cameras=*/10);
+  ASSERT_EQ(cameras.size(), 2);
+  EXPECT_EQ(cameras[0].camera_id, 4);
+  EXPECT_EQ(cameras[1].camera_id, 5);
+
+  database.WriteMatches(1, 2, FeatureMatches(3));
+  database.WriteMatches(3, 2, FeatureMatches(4));
+  database.WriteMatches(3, 4, FeatureMatches(5));
+  // Pairs without matches are skipped.
+  database.WriteMatches(2, 5, FeatureMatches());
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::PLANAR;
+  two_view_geometry.inlier_matches = FeatureMatches(2);
+  database.WriteTwoViewGeometry(2, 3, two_view_geometry);
+
+  std::vector<image_t> other_image_ids;
+  std::vector<int> num_matches;
+  database.ReadNumMatchesForImage(2, &other_image_ids, &num_matches);
+  EXPECT_THAT(other_image_ids, testing::ElementsAre(1, 3));
+  EXPECT_THAT(num_matches, testing::ElementsAre(3, 4));
+
+  other_image_ids.clear();
+  std::vector<int> num_inliers;
+  std::vector<int> configs;
+  database.ReadTwoViewGeometryNumInliersForImage(
+      3, &other_image_ids, &num_inliers, &configs);
+  EXPECT_THAT(other_image_ids, testing::ElementsAre(2));
+  EXPECT_THAT(num_inliers, testing::ElementsAre(2));
+  EXPECT_THAT(configs,
+              testing::ElementsAre(static_cast<int>(
+                  TwoViewGeometry::ConfigurationType::PLANAR)));
+}
+
 TEST(Database, TwoViewGeometry) {
   Database database(Database::kInMemoryDatabasePath);
   const image_t image_id1 = 1;
@@ -403,11 +691,46 @@ TEST(Database, TwoViewGeometry) {
   std::vector<std::pair<image_t, image_t>> image_pairs;
   std::vector<int> num_inliers;
   database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
+  EXPECT_EQ(database.NumInlierMatchesForImagePair(image_id2, image_id1),
+            two_view_geometry.inlier_matches.size());
+  EXPECT_EQ(database.NumInlierMatchesForImagePair(image_id1, image_id1 + 10),
+            0);
+  EXPECT_THAT(database.ReadAllVerifiedImagePairIds(),
+              testing::ElementsAre(
+                  Database::ImagePairToPairId(image_id1, image_id2)));
   EXPECT_EQ(image_pairs.size(), 1);
   EXPECT_EQ(num_inliers.size(), 1);
   EXPECT_EQ(image_pairs[0].first, image_id1);
   EXPECT_EQ(image_pairs[0].second, image_id2);
   EXPECT_EQ(num_inliers[0], two_view_geometry.inlier_matches.size());
+
+  TwoViewGeometry two_view_geometry_small;
+  two_view_geometry_small.inlier_matches = FeatureMatches(10);
+  database.WriteTwoViewGeometry(image_id1, 3, two_view_geometry_small);
+  std::vector<image_pair_t> visited_pair_ids;
+  database.VisitTwoViewGeometries(
+      [](const image_pair_t, const size_t num_inliers) {
+        return num_inliers >= 100;
+      },
+      [&](const image_pair_t pair_id, TwoViewGeometry&& visited) {
+        visited_pair_ids.push_back(pair_id);
+        EXPECT_EQ(visited.inlier_matches.size(),
+                  two_view_geometry.inlier_matches.size());
+      });
+  EXPECT_THAT(visited_pair_ids,
+              testing::ElementsAre(
+                  Database::ImagePairToPairId(image_id1, image_id2)));
+  visited_pair_ids.clear();
+  database.VisitTwoViewGeometries(
+      nullptr, [&](const image_pair_t pair_id, TwoViewGeometry&&) {
+        visited_pair_ids.push_back(pair_id);
+      });
+  EXPECT_THAT(visited_pair_ids,
+              testing::ElementsAre(
+                  Database::ImagePairToPairId(image_id1, image_id2),
+                  Database::ImagePairToPairId(image_id1, 3)));
+  database.DeleteInlierMatches(image_id1, 3);
+
   EXPECT_EQ(database.NumInlierMatches(), 1000);
   database.DeleteInlierMatches(image_id1, image_id2);
   EXPECT_EQ(database.NumInlierMatches(), 0);
@@ -455,7 +778,7 @@ TEST(Database, Merge) {
   const auto descriptors1 = FeatureDescriptors::Random(10, 128);
   const auto descriptors2 = FeatureDescriptors::Random(20, 128);
   const auto descriptors3 = FeatureDescriptors::Random(30, 128);
-  const auto descriptors4 = FeatureDescriptors::Random(40, 128);
+  const auto descriptors4 = FeatureDescriptors::Random(40, 32);
 
   database1.WriteKeypoints(image_id1, keypoints1);
   database1.WriteKeypoints(image_id2, keypoints2);
@@ -464,7 +787,8 @@ TEST(Database, Merge) {
   database1.WriteDescriptors(image_id1, descriptors1);
   database1.WriteDescriptors(image_id2, descriptors2);
   database2.WriteDescriptors(image_id3, descriptors3);
-  database2.WriteDescriptors(image_id4, descriptors4);
+  database2.WriteDescriptors(
+      image_id4, descriptors4, FeatureDescriptorType::BINARY);
   database1.WriteMatches(image_id1, image_id2, FeatureMatches(10));
   database2.WriteMatches(image_id3, image_id4, FeatureMatches(10));
   database1.WriteTwoViewGeometry(image_id1, image_id2, TwoViewGeometry());
@@ -499,6 +823,10 @@ TEST(Database, Merge) {
   EXPECT_EQ(merged_database.ReadDescriptors(2).size(), descriptors2.size());
   EXPECT_EQ(merged_database.ReadDescriptors(3).size(), descriptors3.size());
   EXPECT_EQ(merged_database.ReadDescriptors(4).size(), descriptors4.size());
+  EXPECT_EQ(merged_database.ReadDescriptorsType(3),
+            FeatureDescriptorType::SIFT);
+  EXPECT_EQ(merged_database.ReadDescriptorsType(4),
+            FeatureDescriptorType::BINARY);
   EXPECT_TRUE(merged_database.ExistsMatches(1, 2));
   EXPECT_FALSE(merged_database.ExistsMatches(2, 3));
   EXPECT_FALSE(merged_database.ExistsMatches(2, 4));
@@ -512,5 +840,123 @@ TEST(Database, Merge) {
   EXPECT_EQ(merged_database.NumMatches(), 0);
 }
 
+TEST(Database, MergeMany) {
+  constexpr int kNumDatabases = 5;
+  std::vector<std::unique_ptr<Database>> databases;
+  for (int i = 0; i < kNumDatabases; ++i) {
+    databases.push_back(
+        std::make_unique<Database>(Database::kInMemoryDatabasePath));
+    Database& database = *databases.back();
+    Camera camera = Camera::CreateFromModelName(
+        kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+    camera.camera_id = database.WriteCamera(camera);
+    Image image;
+    image.SetCameraId(camera.camera_id);
+    image.SetName("test" + std::to_string(2 * i));
+    const image_t image_id1 = database.WriteImage(image);
+    image.SetName("test" + std::to_string(2 * i + 1));
+    const image_t image_id2 = database.WriteImage(image);
+    database.WriteKeypoints(image_id1, FeatureKeypoints(10 + i));
+    database.WriteKeypoints(image_id2, FeatureKeypoints(20 + i));
+    database.WriteDescriptors(image_id1,
+                              FeatureDescriptors::Random(10 + i, 128));
+    database.WriteDescriptors(image_id2,
+                              FeatureDescriptors::Random(20 + i, 128));
+    FeatureMatches matches(5 + i);
+    for (int j = 0; j < 5 + i; ++j) {
+      matches[j].point2D_idx1 = j;
+      matches[j].point2D_idx2 = 2 * j;
+    }
+    database.WriteMatches(image_id1, image_id2, matches);
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+    two_view_geometry.inlier_matches = matches;
+    two_view_geometry.E = Eigen::Matrix3d::Random();
+    database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  }
+
+  for (const bool compress_blobs : {false, true}) {
+    Database merged_database(Database::kInMemoryDatabasePath);
+    merged_database.SetBlobCompression(compress_blobs);
+    std::vector<const Database*> database_ptrs;
+    for (const auto& database : databases) {
+      database_ptrs.push_back(database.get());
+    }
+    Database::Merge(database_ptrs, &merged_database, /*num_threads=*/2);
+    EXPECT_EQ(merged_database.NumCameras(), kNumDatabases);
+    EXPECT_EQ(merged_database.NumImages(), 2 * kNumDatabases);
+    EXPECT_EQ(merged_database.NumVerifiedImagePairs(), kNumDatabases);
+    for (int i = 0; i < kNumDatabases; ++i) {
+      const image_t image_id1 = 2 * i + 1;
+      const image_t image_id2 = 2 * i + 2;
+      EXPECT_EQ(merged_database.ReadImage(image_id1).Name(),
+                "test" + std::to_string(2 * i));
+      EXPECT_EQ(merged_database.ReadImage(image_id1).CameraId(), i + 1);
+      EXPECT_EQ(merged_database.ReadKeypoints(image_id2).size(), 20 + i);
+      EXPECT_EQ(merged_database.ReadDescriptors(image_id2),
+                databases[i]->ReadDescriptors(2));
+      const FeatureMatches matches =
+          merged_database.ReadMatches(image_id1, image_id2);
+      ASSERT_EQ(matches.size(), 5 + i);
+      EXPECT_EQ(matches.back().point2D_idx2, 2 * (4 + i));
+      const TwoViewGeometry two_view_geometry =
+          merged_database.ReadTwoViewGeometry(image_id1, image_id2);
+      EXPECT_EQ(two_view_geometry.config,
+                TwoViewGeometry::ConfigurationType::CALIBRATED);
+      EXPECT_EQ(two_view_geometry.inlier_matches.size(), 5 + i);
+      EXPECT_EQ(two_view_geometry.E,
+                databases[i]->ReadTwoViewGeometry(1, 2).E);
+    }
+  }
+}
+
+TEST(Database, MergePreserveImageIds) {
+  Database database1(Database::kInMemoryDatabasePath);
+  Database database2(Database::kInMemoryDatabasePath);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+  camera.camera_id = database1.WriteCamera(camera);
+  camera.camera_id = database2.WriteCamera(camera);
+
+  Image image;
+  image.SetCameraId(camera.camera_id);
+  image.SetName("test3");
+  image.SetImageId(3);
+  database2.WriteImage(image, /*use_image_id=*/true);
+  image.SetName("test1");
+  image.SetImageId(1);
+  database1.WriteImage(image, /*use_image_id=*/true);
+  image.SetName("test2");
+  image.SetImageId(2);
+  database2.WriteImage(image, /*use_image_id=*/true);
+  database2.WriteKeypoints(3, FeatureKeypoints(30));
+  database2.WriteMatches(2, 3, FeatureMatches(5));
+
+  Database merged_database(Database::kInMemoryDatabasePath);
+  Database::Merge({&database2, &database1},
+                  &merged_database,
+                  /*num_threads=*/1,
+                  /*preserve_image_ids=*/true);
+  EXPECT_EQ(merged_database.NumImages(), 3);
+  for (const image_t image_id : {1, 2, 3}) {
+    EXPECT_EQ(merged_database.ReadImage(image_id).Name(),
+              "test" + std::to_string(image_id));
+  }
+  EXPECT_EQ(merged_database.ReadKeypoints(3).size(), 30);
+  EXPECT_EQ(merged_database.ReadMatches(2, 3).size(), 5);
+
+  Database database3(Database::kInMemoryDatabasePath);
+  camera.camera_id = database3.WriteCamera(camera);
+  image.SetCameraId(camera.camera_id);
+  image.SetName("test4");
+  image.SetImageId(1);
+  database3.WriteImage(image, /*use_image_id=*/true);
+  Database conflicting_database(Database::kInMemoryDatabasePath);
+  EXPECT_ANY_THROW(Database::Merge({&database1, &database3},
+                                   &conflicting_database,
+                                   /*num_threads=*/1,
+                                   /*preserve_image_ids=*/true));
+}
+
 }  // namespace
 }  // namespace colmap
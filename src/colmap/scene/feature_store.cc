@@ -0,0 +1,284 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/feature_store.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace colmap {
+
+// All offsets are relative to the start of the file and all arrays start at a
+// multiple of the alignment, such that they can be used in-place.
+struct FeatureStore::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_images;
+  uint64_t num_keypoints;
+  uint64_t num_descriptors;
+  uint64_t entries_offset;
+  uint64_t reserved[3];
+};
+
+struct FeatureStore::Entry {
+  uint32_t image_id;
+  uint32_t flags;
+  uint32_t num_keypoints;
+  uint32_t num_descriptors;
+  uint32_t descriptor_dim;
+  uint32_t reserved;
+  uint64_t keypoints_offset;
+  uint64_t descriptors_offset;
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'O', 'L', 'M', 'A', 'P', 'F', 'S'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kAlignment = 64;
+
+constexpr uint32_t kHasKeypointsFlag = 1;
+constexpr uint32_t kHasDescriptorsFlag = 2;
+
+static_assert(sizeof(FeatureKeypoint) == 6 * sizeof(float),
+              "Invalid keypoint format");
+
+void WritePadding(std::ofstream* file) {
+  const uint64_t offset = file->tellp();
+  const uint64_t num_padding_bytes =
+      (kAlignment - offset % kAlignment) % kAlignment;
+  const char padding[kAlignment] = {0};
+  file->write(padding, num_padding_bytes);
+}
+
+}  // namespace
+
+void FeatureStore::Write(const Database& database, const std::string& path) {
+  // The arrays are used in-place, so the file is always in native byte order.
+  THROW_CHECK(IsLittleEndian())
+      << "Feature stores are only supported on little-endian platforms";
+
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+
+  // The header is rewritten once all entries are known.
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::vector<Image> images = database.ReadAllImages();
+  std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) {
+    return a.ImageId() < b.ImageId();
+  });
+
+  std::vector<Entry> entries;
+  entries.reserve(images.size());
+  for (const Image& image : images) {
+    Entry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.image_id = image.ImageId();
+
+    if (database.ExistsKeypoints(image.ImageId())) {
+      const FeatureKeypoints keypoints =
+          database.ReadKeypoints(image.ImageId());
+      WritePadding(&file);
+      entry.flags |= kHasKeypointsFlag;
+      entry.num_keypoints = keypoints.size();
+      entry.keypoints_offset = file.tellp();
+      file.write(reinterpret_cast<const char*>(keypoints.data()),
+                 keypoints.size() * sizeof(FeatureKeypoint));
+      header.num_keypoints += keypoints.size();
+    }
+
+    if (database.ExistsDescriptors(image.ImageId())) {
+      const FeatureDescriptors descriptors =
+          database.ReadDescriptors(image.ImageId());
+      WritePadding(&file);
+      entry.flags |= kHasDescriptorsFlag;
+      entry.num_descriptors = descriptors.rows();
+      entry.descriptor_dim = descriptors.cols();
+      entry.descriptors_offset = file.tellp();
+      file.write(reinterpret_cast<const char*>(descriptors.data()),
+                 descriptors.size());
+      header.num_descriptors += descriptors.rows();
+    }
+
+    entries.push_back(entry);
+  }
+
+  WritePadding(&file);
+  header.num_images = entries.size();
+  header.entries_offset = file.tellp();
+  file.write(reinterpret_cast<const char*>(entries.data()),
+             entries.size() * sizeof(Entry));
+
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  THROW_CHECK(file.good()) << "Failed to write feature store " << path;
+}
+
+std::string FeatureStore::DefaultPath(const std::string& database_path) {
+  return database_path + ".features";
+}
+
+std::shared_ptr<const FeatureStore> FeatureStore::OpenForDatabase(
+    const std::string& database_path, const Database& database) {
+  const std::string path = DefaultPath(database_path);
+  if (!ExistsFile(path)) {
+    return nullptr;
+  }
+  auto feature_store = std::make_shared<const FeatureStore>(path);
+  if (!feature_store->IsConsistent(database)) {
+    LOG(WARNING) << "Ignoring feature store " << path
+                 << ", because it is out of date with the database. Export "
+                    "the features again to use it.";
+    return nullptr;
+  }
+  LOG(INFO) << "Reading features from " << path;
+  return feature_store;
+}
+
+FeatureStore::FeatureStore(const std::string& path)
+    : mapped_file_(path),
+      data_(mapped_file_.Data()),
+      num_bytes_(mapped_file_.NumBytes()),
+      header_(nullptr),
+      entries_(nullptr) {
+  THROW_CHECK(IsLittleEndian())
+      << "Feature stores are only supported on little-endian platforms";
+  THROW_CHECK_GE(num_bytes_, sizeof(Header))
+      << "Invalid feature store " << path;
+
+  header_ = reinterpret_cast<const Header*>(data_);
+  THROW_CHECK_EQ(std::memcmp(header_->magic, kMagic, sizeof(kMagic)), 0)
+      << "Invalid feature store " << path;
+  THROW_CHECK_EQ(header_->version, kVersion)
+      << "Unsupported feature store version in " << path;
+  THROW_CHECK_EQ(header_->entries_offset % kAlignment, 0);
+  THROW_CHECK_LE(header_->entries_offset +
+                     static_cast<uint64_t>(header_->num_images) * sizeof(Entry),
+                 num_bytes_)
+      << "Truncated feature store " << path;
+  entries_ = reinterpret_cast<const Entry*>(data_ + header_->entries_offset);
+}
+
+FeatureStore::~FeatureStore() = default;
+
+size_t FeatureStore::NumImages() const { return header_->num_images; }
+
+size_t FeatureStore::NumKeypoints() const { return header_->num_keypoints; }
+
+size_t FeatureStore::NumDescriptors() const {
+  return header_->num_descriptors;
+}
+
+bool FeatureStore::IsConsistent(const Database& database) const {
+  return NumImages() == database.NumImages() &&
+         NumKeypoints() == database.NumKeypoints() &&
+         NumDescriptors() == database.NumDescriptors();
+}
+
+bool FeatureStore::ExistsKeypoints(const image_t image_id) const {
+  const Entry* entry = FindEntry(image_id);
+  return entry != nullptr && (entry->flags & kHasKeypointsFlag);
+}
+
+bool FeatureStore::ExistsDescriptors(const image_t image_id) const {
+  const Entry* entry = FindEntry(image_id);
+  return entry != nullptr && (entry->flags & kHasDescriptorsFlag);
+}
+
+FeatureStore::KeypointsView FeatureStore::KeypointsData(
+    const image_t image_id) const {
+  KeypointsView view;
+  const Entry* entry = FindEntry(image_id);
+  if (entry == nullptr || !(entry->flags & kHasKeypointsFlag)) {
+    return view;
+  }
+  THROW_CHECK_LE(entry->keypoints_offset +
+                     static_cast<uint64_t>(entry->num_keypoints) *
+                         sizeof(FeatureKeypoint),
+                 num_bytes_)
+      << "Truncated feature store " << mapped_file_.Path();
+  view.data =
+      reinterpret_cast<const FeatureKeypoint*>(data_ + entry->keypoints_offset);
+  view.size = entry->num_keypoints;
+  return view;
+}
+
+Eigen::Map<const FeatureDescriptors> FeatureStore::DescriptorsData(
+    const image_t image_id) const {
+  const Entry* entry = FindEntry(image_id);
+  if (entry == nullptr || !(entry->flags & kHasDescriptorsFlag)) {
+    return Eigen::Map<const FeatureDescriptors>(nullptr, 0, 0);
+  }
+  THROW_CHECK_LE(entry->descriptors_offset +
+                     static_cast<uint64_t>(entry->num_descriptors) *
+                         entry->descriptor_dim,
+                 num_bytes_)
+      << "Truncated feature store " << mapped_file_.Path();
+  return Eigen::Map<const FeatureDescriptors>(
+      reinterpret_cast<const uint8_t*>(data_ + entry->descriptors_offset),
+      entry->num_descriptors,
+      entry->descriptor_dim);
+}
+
+FeatureKeypoints FeatureStore::ReadKeypoints(const image_t image_id) const {
+  const KeypointsView view = KeypointsData(image_id);
+  return FeatureKeypoints(view.data, view.data + view.size);
+}
+
+FeatureDescriptors FeatureStore::ReadDescriptors(
+    const image_t image_id) const {
+  return DescriptorsData(image_id);
+}
+
+const FeatureStore::Entry* FeatureStore::FindEntry(
+    const image_t image_id) const {
+  const Entry* entries_end = entries_ + header_->num_images;
+  const Entry* entry = std::lower_bound(
+      entries_, entries_end, image_id, [](const Entry& entry, image_t id) {
+        return entry.image_id < id;
+      });
+  if (entry == entries_end || entry->image_id != image_id) {
+    return nullptr;
+  }
+  return entry;
+}
+
+}  // namespace colmap
@@ -0,0 +1,114 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/feature/types.h"
+#include "colmap/scene/database.h"
+#include "colmap/util/mapped_file.h"
+#include "colmap/util/types.h"
+
+#include <memory>
+#include <string>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+// Read-only store of the keypoints and descriptors of all images in a
+// database, which is exported to a flat file and memory-mapped on load. The
+// file consists of a header, a table of per-image entries sorted by image
+// identifier, and the contiguous keypoint and descriptor arrays of the images.
+// Reading features from the store avoids querying SQLite and copying BLOBs on
+// every cache miss and the views into the mapped file are zero-copy.
+//
+// The store is not updated together with the database. Use `IsConsistent` to
+// check that the store was exported from the current state of the database.
+class FeatureStore {
+ public:
+  // Zero-copy view of the keypoints of one image.
+  struct KeypointsView {
+    const FeatureKeypoint* data = nullptr;
+    size_t size = 0;
+  };
+
+  // Export the features of all images in the database to the given path.
+  static void Write(const Database& database, const std::string& path);
+
+  // Path of the store next to the database, which is used by default.
+  static std::string DefaultPath(const std::string& database_path);
+
+  // Open the store at the default path of the database, if it exists and is
+  // consistent with the database. Otherwise, returns null.
+  static std::shared_ptr<const FeatureStore> OpenForDatabase(
+      const std::string& database_path, const Database& database);
+
+  // Memory-map the store at the given path.
+  explicit FeatureStore(const std::string& path);
+  ~FeatureStore();
+
+  NON_COPYABLE(FeatureStore)
+  NON_MOVABLE(FeatureStore)
+
+  size_t NumImages() const;
+  size_t NumKeypoints() const;
+  size_t NumDescriptors() const;
+
+  // Check whether the number of images, keypoints, and descriptors match the
+  // database. This is a cheap check to detect stores that are out of date.
+  bool IsConsistent(const Database& database) const;
+
+  bool ExistsKeypoints(image_t image_id) const;
+  bool ExistsDescriptors(image_t image_id) const;
+
+  // Views into the mapped file, which are valid for the lifetime of the store.
+  // The views are empty, if the image has no features.
+  KeypointsView KeypointsData(image_t image_id) const;
+  Eigen::Map<const FeatureDescriptors> DescriptorsData(image_t image_id) const;
+
+  // Copies of the features with the same semantics as the equivalent methods
+  // in `Database`.
+  FeatureKeypoints ReadKeypoints(image_t image_id) const;
+  FeatureDescriptors ReadDescriptors(image_t image_id) const;
+
+ private:
+  struct Header;
+  struct Entry;
+
+  const Entry* FindEntry(image_t image_id) const;
+
+  MappedFile mapped_file_;
+  const char* data_;
+  size_t num_bytes_;
+  const Header* header_;
+  const Entry* entries_;
+};
+
+}  // namespace colmap
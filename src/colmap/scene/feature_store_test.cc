@@ -0,0 +1,140 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/feature_store.h"
+
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+void WriteTestDatabase(Database* database,
+                       image_t* image_id1,
+                       image_t* image_id2,
+                       image_t* image_id3) {
+  Camera camera;
+  camera.camera_id = database->WriteCamera(camera);
+  Image image;
+  image.SetCameraId(camera.camera_id);
+  image.SetName("image1");
+  *image_id1 = database->WriteImage(image);
+  image.SetName("image2");
+  *image_id2 = database->WriteImage(image);
+  image.SetName("image3");
+  *image_id3 = database->WriteImage(image);
+
+  FeatureKeypoints keypoints1(10);
+  for (size_t i = 0; i < keypoints1.size(); ++i) {
+    keypoints1[i] = FeatureKeypoint(i, 2 * i, 1, 2, 3, 4);
+  }
+  database->WriteKeypoints(*image_id1, keypoints1);
+  database->WriteDescriptors(*image_id1, FeatureDescriptors::Random(10, 128));
+  database->WriteKeypoints(*image_id2, FeatureKeypoints(5));
+}
+
+TEST(FeatureStore, Nominal) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+  Database database(database_path);
+  image_t image_id1, image_id2, image_id3;
+  WriteTestDatabase(&database, &image_id1, &image_id2, &image_id3);
+
+  const std::string path = FeatureStore::DefaultPath(database_path);
+  FeatureStore::Write(database, path);
+
+  FeatureStore feature_store(path);
+  EXPECT_EQ(feature_store.NumImages(), 3);
+  EXPECT_EQ(feature_store.NumKeypoints(), 15);
+  EXPECT_EQ(feature_store.NumDescriptors(), 10);
+  EXPECT_TRUE(feature_store.IsConsistent(database));
+
+  EXPECT_TRUE(feature_store.ExistsKeypoints(image_id1));
+  EXPECT_TRUE(feature_store.ExistsDescriptors(image_id1));
+  EXPECT_TRUE(feature_store.ExistsKeypoints(image_id2));
+  EXPECT_FALSE(feature_store.ExistsDescriptors(image_id2));
+  EXPECT_FALSE(feature_store.ExistsKeypoints(image_id3));
+  EXPECT_FALSE(feature_store.ExistsDescriptors(image_id3));
+  EXPECT_FALSE(feature_store.ExistsKeypoints(image_id3 + 1));
+
+  const FeatureKeypoints keypoints = database.ReadKeypoints(image_id1);
+  const FeatureStore::KeypointsView keypoints_view =
+      feature_store.KeypointsData(image_id1);
+  ASSERT_EQ(keypoints_view.size, keypoints.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    EXPECT_EQ(keypoints_view.data[i].x, keypoints[i].x);
+    EXPECT_EQ(keypoints_view.data[i].y, keypoints[i].y);
+    EXPECT_EQ(keypoints_view.data[i].a11, keypoints[i].a11);
+    EXPECT_EQ(keypoints_view.data[i].a12, keypoints[i].a12);
+    EXPECT_EQ(keypoints_view.data[i].a21, keypoints[i].a21);
+    EXPECT_EQ(keypoints_view.data[i].a22, keypoints[i].a22);
+  }
+  EXPECT_EQ(feature_store.ReadKeypoints(image_id1).size(), keypoints.size());
+  EXPECT_EQ(feature_store.ReadKeypoints(image_id2).size(), 5);
+  EXPECT_EQ(feature_store.ReadKeypoints(image_id3).size(), 0);
+
+  const FeatureDescriptors descriptors = database.ReadDescriptors(image_id1);
+  EXPECT_EQ(feature_store.DescriptorsData(image_id1), descriptors);
+  EXPECT_EQ(feature_store.ReadDescriptors(image_id1), descriptors);
+  EXPECT_EQ(feature_store.ReadDescriptors(image_id2).size(), 0);
+
+  database.WriteDescriptors(image_id2, FeatureDescriptors::Random(5, 128));
+  EXPECT_FALSE(feature_store.IsConsistent(database));
+  EXPECT_EQ(FeatureStore::OpenForDatabase(database_path, database), nullptr);
+}
+
+TEST(FeatureStore, OpenForDatabase) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+  Database database(database_path);
+  image_t image_id1, image_id2, image_id3;
+  WriteTestDatabase(&database, &image_id1, &image_id2, &image_id3);
+  EXPECT_EQ(FeatureStore::OpenForDatabase(database_path, database), nullptr);
+  FeatureStore::Write(database, FeatureStore::DefaultPath(database_path));
+  const auto feature_store =
+      FeatureStore::OpenForDatabase(database_path, database);
+  ASSERT_NE(feature_store, nullptr);
+  EXPECT_EQ(feature_store->NumImages(), 3);
+}
+
+TEST(FeatureStore, Empty) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+  Database database(database_path);
+  const std::string path = FeatureStore::DefaultPath(database_path);
+  FeatureStore::Write(database, path);
+  FeatureStore feature_store(path);
+  EXPECT_EQ(feature_store.NumImages(), 0);
+  EXPECT_TRUE(feature_store.IsConsistent(database));
+  EXPECT_FALSE(feature_store.ExistsKeypoints(1));
+  EXPECT_EQ(feature_store.KeypointsData(1).size, 0);
+  EXPECT_EQ(feature_store.DescriptorsData(1).size(), 0);
+}
+
+}  // namespace
+}  // namespace colmap
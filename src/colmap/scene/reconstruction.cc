@@ -34,12 +34,73 @@
 #include "colmap/geometry/triangulation.h"
 #include "colmap/scene/database_cache.h"
 #include "colmap/scene/projection.h"
+#include "colmap/scene/reconstruction_chunked_io.h"
 #include "colmap/scene/reconstruction_io.h"
 #include "colmap/sensor/bitmap.h"
+#include "colmap/util/memory.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/ply.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <mutex>
 
 namespace colmap {
+namespace {
+
+// Robust bounding box between the p0 and p1 percentiles of the coordinates and
+// the mean of the coordinates in between. The percentiles are selected in
+// linear time instead of sorting all coordinates, which are reordered.
+void ComputeRobustBoundsAndCentroid(const double p0,
+                                    const double p1,
+                                    std::vector<float>* coords_x,
+                                    std::vector<float>* coords_y,
+                                    std::vector<float>* coords_z,
+                                    Eigen::Vector3d* bbox_min,
+                                    Eigen::Vector3d* bbox_max,
+                                    Eigen::Vector3d* centroid) {
+  THROW_CHECK_GE(p0, 0);
+  THROW_CHECK_LE(p0, 1);
+  THROW_CHECK_GE(p1, 0);
+  THROW_CHECK_LE(p1, 1);
+  THROW_CHECK_LE(p0, p1);
+
+  const size_t num_coords = coords_x->size();
+  if (num_coords == 0) {
+    bbox_min->setZero();
+    bbox_max->setZero();
+    centroid->setZero();
+    return;
+  }
+
+  const size_t P0 =
+      static_cast<size_t>((num_coords > 3) ? p0 * (num_coords - 1) : 0);
+  const size_t P1 = static_cast<size_t>(
+      (num_coords > 3) ? p1 * (num_coords - 1) : num_coords - 1);
+
+  std::vector<float>* coords[3] = {coords_x, coords_y, coords_z};
+  for (int d = 0; d < 3; ++d) {
+    // Afterwards, the elements in [P0, P1] are the order statistics in the
+    // same range, as if the coordinates were sorted.
+    std::vector<float>& dim_coords = *coords[d];
+    std::nth_element(
+        dim_coords.begin(), dim_coords.begin() + P0, dim_coords.end());
+    if (P1 > P0) {
+      std::nth_element(dim_coords.begin() + P0 + 1,
+                       dim_coords.begin() + P1,
+                       dim_coords.end());
+    }
+    (*bbox_min)(d) = dim_coords[P0];
+    (*bbox_max)(d) = dim_coords[P1];
+    double coord_sum = 0;
+    for (size_t i = P0; i <= P1; ++i) {
+      coord_sum += dim_coords[i];
+    }
+    (*centroid)(d) = coord_sum / (P1 - P0 + 1);
+  }
+}
+
+}  // namespace
 
 Reconstruction::Reconstruction() : max_point3D_id_(0) {}
 
@@ -304,20 +365,6 @@ std::tuple<Eigen::Vector3d, Eigen::Vector3d, Eigen::Vector3d>
 Reconstruction::ComputeBoundsAndCentroid(const double p0,
                                          const double p1,
                                          const bool use_images) const {
-  THROW_CHECK_GE(p0, 0);
-  THROW_CHECK_LE(p0, 1);
-  THROW_CHECK_GE(p1, 0);
-  THROW_CHECK_LE(p1, 1);
-  THROW_CHECK_LE(p0, p1);
-
-  const size_t num_elements =
-      use_images ? reg_image_ids_.size() : points3D_.size();
-  if (num_elements == 0) {
-    return std::make_tuple(Eigen::Vector3d(0, 0, 0),
-                           Eigen::Vector3d(0, 0, 0),
-                           Eigen::Vector3d(0, 0, 0));
-  }
-
   // Coordinates of image centers or point locations.
   std::vector<float> coords_x;
   std::vector<float> coords_y;
@@ -343,29 +390,18 @@ Reconstruction::ComputeBoundsAndCentroid(const double p0,
     }
   }
 
-  // Determine robust bounding box and mean.
-
-  std::sort(coords_x.begin(), coords_x.end());
-  std::sort(coords_y.begin(), coords_y.end());
-  std::sort(coords_z.begin(), coords_z.end());
-
-  const size_t P0 = static_cast<size_t>(
-      (coords_x.size() > 3) ? p0 * (coords_x.size() - 1) : 0);
-  const size_t P1 = static_cast<size_t>(
-      (coords_x.size() > 3) ? p1 * (coords_x.size() - 1) : coords_x.size() - 1);
-
-  const Eigen::Vector3d bbox_min(coords_x[P0], coords_y[P0], coords_z[P0]);
-  const Eigen::Vector3d bbox_max(coords_x[P1], coords_y[P1], coords_z[P1]);
-
-  Eigen::Vector3d mean_coord(0, 0, 0);
-  for (size_t i = P0; i <= P1; ++i) {
-    mean_coord(0) += coords_x[i];
-    mean_coord(1) += coords_y[i];
-    mean_coord(2) += coords_z[i];
-  }
-  mean_coord /= P1 - P0 + 1;
-
-  return std::make_tuple(bbox_min, bbox_max, mean_coord);
+  Eigen::Vector3d bbox_min;
+  Eigen::Vector3d bbox_max;
+  Eigen::Vector3d centroid;
+  ComputeRobustBoundsAndCentroid(p0,
+                                 p1,
+                                 &coords_x,
+                                 &coords_y,
+                                 &coords_z,
+                                 &bbox_min,
+                                 &bbox_max,
+                                 &centroid);
+  return std::make_tuple(bbox_min, bbox_max, centroid);
 }
 
 void Reconstruction::Transform(const Sim3d& new_from_old_world) {
@@ -466,6 +502,25 @@ void Reconstruction::TranscribeImageIdsToDatabase(const Database& database) {
   }
 }
 
+size_t Reconstruction::NumBytes() const {
+  size_t num_bytes = EstimateNumBytes(cameras_) + EstimateNumBytes(images_) +
+                     points3D_.NumBytes() + EstimateNumBytes(reg_image_ids_);
+  for (const auto& camera : cameras_) {
+    num_bytes += EstimateNumBytes(camera.second.params);
+  }
+  for (const auto& image : images_) {
+    num_bytes += EstimateNumBytes(image.second.Points2D()) +
+                 image.second.Name().capacity();
+  }
+  for (const auto& point3D : points3D_) {
+    const TrackElements& elements = point3D.second.track.Elements();
+    if (elements.capacity() > TrackElements::kNumInlineElements) {
+      num_bytes += elements.capacity() * sizeof(TrackElement);
+    }
+  }
+  return num_bytes;
+}
+
 size_t Reconstruction::ComputeNumObservations() const {
   size_t num_obs = 0;
   for (const image_t image_id : reg_image_ids_) {
@@ -508,29 +563,118 @@ double Reconstruction::ComputeMeanReprojectionError() const {
   }
 }
 
+ReconstructionStatistics Reconstruction::ComputeStatistics(
+    const double p0, const double p1) const {
+  ReconstructionStatistics statistics;
+  for (const image_t image_id : reg_image_ids_) {
+    statistics.num_observations += Image(image_id).NumPoints3D();
+  }
+  if (!points3D_.empty()) {
+    statistics.mean_track_length =
+        statistics.num_observations / static_cast<double>(points3D_.size());
+  }
+  if (!reg_image_ids_.empty()) {
+    statistics.mean_observations_per_reg_image =
+        statistics.num_observations /
+        static_cast<double>(reg_image_ids_.size());
+  }
+
+  std::vector<const struct Point3D*> points3D;
+  points3D.reserve(points3D_.size());
+  for (const auto& point3D : points3D_) {
+    points3D.push_back(&point3D.second);
+  }
+
+  // Each chunk writes the coordinates of its points and accumulates the errors
+  // locally, so that the chunks only synchronize once at their end.
+  std::vector<float> coords_x(points3D.size());
+  std::vector<float> coords_y(points3D.size());
+  std::vector<float> coords_z(points3D.size());
+  std::mutex error_mutex;
+  double error_sum = 0;
+  size_t num_valid_errors = 0;
+  auto AccumulatePoints = [&](const size_t begin, const size_t end) {
+    double chunk_error_sum = 0;
+    size_t chunk_num_valid_errors = 0;
+    for (size_t idx = begin; idx < end; ++idx) {
+      const struct Point3D& point3D = *points3D[idx];
+      coords_x[idx] = static_cast<float>(point3D.xyz(0));
+      coords_y[idx] = static_cast<float>(point3D.xyz(1));
+      coords_z[idx] = static_cast<float>(point3D.xyz(2));
+      if (point3D.HasError()) {
+        chunk_error_sum += point3D.error;
+        chunk_num_valid_errors += 1;
+      }
+    }
+    std::lock_guard<std::mutex> lock(error_mutex);
+    error_sum += chunk_error_sum;
+    num_valid_errors += chunk_num_valid_errors;
+  };
+
+  const size_t kMinNumPoints3DPerChunk = 16384;
+  ParallelForChunks(ThreadPool::kMaxNumThreads,
+                    points3D.size(),
+                    kMinNumPoints3DPerChunk,
+                    AccumulatePoints);
+
+  if (num_valid_errors > 0) {
+    statistics.mean_reprojection_error = error_sum / num_valid_errors;
+  }
+
+  ComputeRobustBoundsAndCentroid(p0,
+                                 p1,
+                                 &coords_x,
+                                 &coords_y,
+                                 &coords_z,
+                                 &statistics.bbox_min,
+                                 &statistics.bbox_max,
+                                 &statistics.centroid);
+
+  return statistics;
+}
+
 void Reconstruction::UpdatePoint3DErrors() {
+  std::vector<struct Point3D*> points3D;
+  points3D.reserve(points3D_.size());
   for (auto& point3D : points3D_) {
-    // step: 1 没有track_elements则跳过
-    if (point3D.second.track.Length() == 0) {
-      point3D.second.error = 0;
-      continue;
-    }
+    points3D.push_back(&point3D.second);
+  }
+
+  auto UpdateErrors = [&](const size_t begin, const size_t end) {
+    for (size_t idx = begin; idx < end; ++idx) {
+      struct Point3D& point3D = *points3D[idx];
+
+      // step: 1 没有track_elements则跳过
+      if (point3D.track.Length() == 0) {
+        point3D.error = 0;
+        continue;
+      }
 
-    // step: 2 逐个计算element的误差并累计取平均值
-    point3D.second.error = 0;
-    for (const auto& track_el : point3D.second.track.Elements()) {
-      const auto& image = Image(track_el.image_id);
-      const auto& point2D = image.Point2D(track_el.point2D_idx);
-      const auto& camera = Camera(image.CameraId());
-      point3D.second.error += std::sqrt(CalculateSquaredReprojectionError(
-          point2D.xy, point3D.second.xyz, image.CamFromWorld(), camera));
+      // step: 2 逐个计算element的误差并累计取平均值
+      point3D.error = 0;
+      for (const auto& track_el : point3D.track.Elements()) {
+        const auto& image = Image(track_el.image_id);
+        const auto& point2D = image.Point2D(track_el.point2D_idx);
+        const auto& camera = Camera(image.CameraId());
+        point3D.error += std::sqrt(CalculateSquaredReprojectionError(
+            point2D.xy, point3D.xyz, image.CamFromWorld(), camera));
+      }
+      point3D.error /= point3D.track.Length();
     }
-    point3D.second.error /= point3D.second.track.Length();
-  }
+  };
+
+  // The errors of the points are independent and can be updated in parallel.
+  const size_t kMinNumPoints3DPerChunk = 1024;
+  ParallelForChunks(ThreadPool::kMaxNumThreads,
+                    points3D.size(),
+                    kMinNumPoints3DPerChunk,
+                    UpdateErrors);
 }
 
 void Reconstruction::Read(const std::string& path) {
-  if (ExistsFile(JoinPaths(path, "cameras.bin")) &&
+  if (ExistsFile(JoinPaths(path, kChunkedReconstructionFileName))) {
+    ReadChunked(path);
+  } else if (ExistsFile(JoinPaths(path, "cameras.bin")) &&
       ExistsFile(JoinPaths(path, "images.bin")) &&
       ExistsFile(JoinPaths(path, "points3D.bin"))) {
     ReadBinary(path);
@@ -564,6 +708,15 @@ void Reconstruction::ReadBinary(const std::string& path) {
   ReadPoints3DBinary(*this, JoinPaths(path, "points3D.bin"));
 }
 
+void Reconstruction::ReadChunked(const std::string& path,
+                                 const std::unordered_set<image_t>& image_ids) {
+  cameras_.clear();
+  images_.clear();
+  points3D_.clear();
+  ReadReconstructionChunked(
+      *this, JoinPaths(path, kChunkedReconstructionFileName), image_ids);
+}
+
 void Reconstruction::WriteText(const std::string& path) const {
   THROW_CHECK_DIR_EXISTS(path);
   WriteCamerasText(*this, JoinPaths(path, "cameras.txt"));
@@ -578,6 +731,12 @@ void Reconstruction::WriteBinary(const std::string& path) const {
   WritePoints3DBinary(*this, JoinPaths(path, "points3D.bin"));
 }
 
+void Reconstruction::WriteChunked(const std::string& path) const {
+  THROW_CHECK_DIR_EXISTS(path);
+  WriteReconstructionChunked(*this,
+                             JoinPaths(path, kChunkedReconstructionFileName));
+}
+
 std::vector<PlyPoint> Reconstruction::ConvertToPLY() const {
   std::vector<PlyPoint> ply_points;
   ply_points.reserve(points3D_.size());
@@ -648,41 +807,89 @@ bool Reconstruction::ExtractColorsForImage(const image_t image_id,
   return true;
 }
 
-void Reconstruction::ExtractColorsForAllImages(const std::string& path) {
-  std::unordered_map<point3D_t, Eigen::Vector3d> color_sums;
-  std::unordered_map<point3D_t, size_t> color_counts;
-
-  for (size_t i = 0; i < reg_image_ids_.size(); ++i) {
-    const class Image& image = Image(reg_image_ids_[i]);
+void Reconstruction::ExtractColorsForAllImages(const std::string& path,
+                                               const int num_threads,
+                                               const int min_image_size) {
+  // The colors of the observations of an image, which are sampled in parallel
+  // and accumulated in the order of the images for deterministic results.
+  typedef std::vector<std::pair<point3D_t, Eigen::Vector3d>> ImageColors;
+  auto ExtractImageColors = [&path, min_image_size](const class Image& image) {
+    ImageColors colors;
     const std::string image_path = JoinPaths(path, image.Name());
 
     Bitmap bitmap;
-    if (!bitmap.Read(image_path)) {
+    if (!bitmap.Read(image_path, /*as_rgb=*/true, min_image_size)) {
       LOG(WARNING) << StringPrintf("Could not read image %s at path %s.",
                                    image.Name().c_str(),
                                    image_path.c_str())
                    << std::endl;
-      continue;
+      return colors;
     }
 
+    // Map the points to the reduced resolution, if the image was decoded at
+    // a lower resolution.
+    double scale_x = 1.0;
+    double scale_y = 1.0;
+    int original_width = 0;
+    int original_height = 0;
+    if (bitmap.OriginalSize(&original_width, &original_height)) {
+      scale_x = static_cast<double>(bitmap.Width()) / original_width;
+      scale_y = static_cast<double>(bitmap.Height()) / original_height;
+    }
+
+    // Sample the colors of all observations at once.
+    std::vector<point3D_t> point3D_ids;
+    std::vector<Eigen::Vector2d> xy;
+    point3D_ids.reserve(image.NumPoints3D());
+    xy.reserve(image.NumPoints3D());
     for (const Point2D& point2D : image.Points2D()) {
       if (point2D.HasPoint3D()) {
-        BitmapColor<float> color;
+        point3D_ids.push_back(point2D.point3D_id);
         // COLMAP assumes that the upper left pixel center is (0.5, 0.5).
-        if (bitmap.InterpolateBilinear(
-                point2D.xy(0) - 0.5, point2D.xy(1) - 0.5, &color)) {
-          if (color_sums.count(point2D.point3D_id)) {
-            Eigen::Vector3d& color_sum = color_sums[point2D.point3D_id];
-            color_sum(0) += color.r;
-            color_sum(1) += color.g;
-            color_sum(2) += color.b;
-            color_counts[point2D.point3D_id] += 1;
-          } else {
-            color_sums.emplace(point2D.point3D_id,
-                               Eigen::Vector3d(color.r, color.g, color.b));
-            color_counts.emplace(point2D.point3D_id, 1);
-          }
-        }
+        xy.emplace_back(scale_x * point2D.xy(0) - 0.5,
+                        scale_y * point2D.xy(1) - 0.5);
+      }
+    }
+    std::vector<BitmapColor<float>> bitmap_colors(xy.size());
+    std::vector<char> mask(xy.size());
+    bitmap.InterpolateBilinear({xy.data(), xy.size()},
+                               {bitmap_colors.data(), bitmap_colors.size()},
+                               {mask.data(), mask.size()});
+
+    colors.reserve(xy.size());
+    for (size_t i = 0; i < xy.size(); ++i) {
+      if (mask[i]) {
+        const BitmapColor<float>& color = bitmap_colors[i];
+        colors.emplace_back(point3D_ids[i],
+                            Eigen::Vector3d(color.r, color.g, color.b));
+      }
+    }
+    return colors;
+  };
+
+  ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
+  std::vector<std::future<ImageColors>> futures;
+  futures.reserve(reg_image_ids_.size());
+  for (const image_t image_id : reg_image_ids_) {
+    futures.push_back(thread_pool.AddTask(
+        [this, &ExtractImageColors, image_id]() {
+          return ExtractImageColors(Image(image_id));
+        }));
+  }
+
+  std::unordered_map<point3D_t, Eigen::Vector3d> color_sums;
+  std::unordered_map<point3D_t, size_t> color_counts;
+  color_sums.reserve(points3D_.size());
+  color_counts.reserve(points3D_.size());
+  for (auto& future : futures) {
+    for (const auto& [point3D_id, color] : future.get()) {
+      auto it = color_sums.find(point3D_id);
+      if (it == color_sums.end()) {
+        color_sums.emplace(point3D_id, color);
+        color_counts.emplace(point3D_id, 1);
+      } else {
+        it->second += color;
+        color_counts[point3D_id] += 1;
       }
     }
   }
@@ -37,6 +37,7 @@
 #include "colmap/scene/point3d.h"
 #include "colmap/scene/track.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/slot_map.h"
 #include "colmap/util/types.h"
 
 #include <memory>
@@ -52,6 +53,21 @@ namespace colmap {
 struct PlyPoint;
 class DatabaseCache;
 
+// Summary statistics of a reconstruction, which are computed together by
+// Reconstruction::ComputeStatistics.
+struct ReconstructionStatistics {
+  size_t num_observations = 0;
+  double mean_track_length = 0;
+  double mean_observations_per_reg_image = 0;
+  double mean_reprojection_error = 0;
+
+  // Robust bounding box and centroid of the 3D points between the given
+  // percentiles of their coordinates.
+  Eigen::Vector3d bbox_min = Eigen::Vector3d::Zero();
+  Eigen::Vector3d bbox_max = Eigen::Vector3d::Zero();
+  Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+};
+
 // Reconstruction class holds all information about a single reconstructed
 // model. It is used by the mapping and bundle adjustment classes and can be
 // written to and read from disk.
@@ -79,7 +95,7 @@ class Reconstruction {
   inline const std::unordered_map<camera_t, struct Camera>& Cameras() const;
   inline const std::unordered_map<image_t, class Image>& Images() const;
   inline const std::vector<image_t>& RegImageIds() const;
-  inline const std::unordered_map<point3D_t, struct Point3D>& Points3D() const;
+  inline const SlotMap<point3D_t, struct Point3D>& Points3D() const;
 
   // Identifiers of all 3D points.
   std::unordered_set<point3D_t> Point3DIds() const;
@@ -186,17 +202,27 @@ class Reconstruction {
   // the names of the images.
   void TranscribeImageIdsToDatabase(const Database& database);
 
+  // Estimated memory usage of the cameras, images, and 3D points in bytes.
+  size_t NumBytes() const;
+
   // Compute statistics for scene.
   size_t ComputeNumObservations() const;
   double ComputeMeanTrackLength() const;
   double ComputeMeanObservationsPerRegImage() const;
   double ComputeMeanReprojectionError() const;
 
+  // Compute all of the above statistics and the bounding box and centroid of
+  // the 3D points between the percentiles p0 and p1 in one parallel pass over
+  // the points, which is faster than computing them separately.
+  ReconstructionStatistics ComputeStatistics(double p0 = 0.0,
+                                             double p1 = 1.0) const;
+
   // Updates mean reprojection errors for all 3D points.
   // api: 更新3d点的平均重投影误差
   void UpdatePoint3DErrors();
 
-  // Read data from text or binary file. Prefer binary data if it exists.
+  // Read data from chunked, binary, or text file. Prefer chunked and then
+  // binary data if it exists.
   void Read(const std::string& path);
   void Write(const std::string& path) const;
 
@@ -204,10 +230,19 @@ class Reconstruction {
   void ReadText(const std::string& path);
   void ReadBinary(const std::string& path);
 
+  // Read data from the chunked binary file in the given directory. If image
+  // identifiers are given, only these images and the 3D points observed by
+  // them are read, see `ReadReconstructionChunked`.
+  void ReadChunked(const std::string& path,
+                   const std::unordered_set<image_t>& image_ids = {});
+
   // Write data from binary/text file.
   void WriteText(const std::string& path) const;
   void WriteBinary(const std::string& path) const;
 
+  // Write data to a compressed, chunked binary file in the given directory.
+  void WriteChunked(const std::string& path) const;
+
   // Convert 3D points in reconstruction to PLY point cloud.
   std::vector<PlyPoint> ConvertToPLY() const;
 
@@ -232,7 +267,14 @@ class Reconstruction {
   // @param path          Absolute or relative path to root folder of image.
   //                      The image path is determined by concatenating the
   //                      root path and the name of the image.
-  void ExtractColorsForAllImages(const std::string& path);
+  // @param num_threads   Number of threads to read the images in parallel.
+  // @param min_image_size  If positive, JPEG images are decoded at the lowest
+  //                      reduced resolution whose maximum dimension is at
+  //                      least the given size, see Bitmap::Read, and the
+  //                      2D points are sampled at their scaled coordinates.
+  void ExtractColorsForAllImages(const std::string& path,
+                                 int num_threads = -1,
+                                 int min_image_size = -1);
 
   // Create all image sub-directories in the given path.
   void CreateImageDirs(const std::string& path) const;
@@ -243,7 +285,9 @@ class Reconstruction {
 
   std::unordered_map<camera_t, struct Camera> cameras_;
   std::unordered_map<image_t, class Image> images_;
-  std::unordered_map<point3D_t, struct Point3D> points3D_;
+  // The 3D points are stored densely, so that passes over the entire model
+  // iterate over contiguous memory.
+  SlotMap<point3D_t, struct Point3D> points3D_;
 
   // { image_id, ... } where `images_.at(image_id).registered == true`.
   std::vector<image_t> reg_image_ids_;
@@ -301,7 +345,7 @@ const std::vector<image_t>& Reconstruction::RegImageIds() const {
   return reg_image_ids_;
 }
 
-const std::unordered_map<point3D_t, Point3D>& Reconstruction::Points3D() const {
+const SlotMap<point3D_t, Point3D>& Reconstruction::Points3D() const {
   return points3D_;
 }
 
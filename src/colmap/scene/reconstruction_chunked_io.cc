@@ -0,0 +1,673 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/reconstruction_chunked_io.h"
+
+#include "colmap/geometry/rigid3.h"
+#include "colmap/scene/camera.h"
+#include "colmap/scene/image.h"
+#include "colmap/scene/point2d.h"
+#include "colmap/scene/point3d.h"
+#include "colmap/scene/track.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <lz4.h>
+
+namespace colmap {
+namespace {
+
+constexpr char kMagic[8] = {'C', 'O', 'L', 'M', 'A', 'P', 'R', 'C'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kAlignment = 64;
+
+enum Table { kCamerasTable = 0, kImagesTable = 1, kPoints3DTable = 2 };
+constexpr int kNumTables = 3;
+
+constexpr uint32_t kUncompressed = 0;
+constexpr uint32_t kLZ4Compressed = 1;
+
+constexpr int kNumCamerasPerChunk = 1024;
+
+// All offsets are relative to the start of the file. The header and the index
+// of every table start at a multiple of the alignment, such that they can be
+// used in-place.
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t num_records[kNumTables];
+  uint64_t num_chunks[kNumTables];
+  uint64_t index_offset[kNumTables];
+};
+
+// Entry of a chunk in the index of a table. The records of a chunk have
+// identifiers in the closed range [first_id, last_id].
+struct ChunkEntry {
+  uint64_t offset;
+  uint64_t num_bytes;
+  uint64_t num_raw_bytes;
+  uint64_t first_id;
+  uint64_t last_id;
+  uint32_t num_records;
+  uint32_t compression;
+};
+
+void WritePadding(std::ofstream* file) {
+  const uint64_t offset = file->tellp();
+  const uint64_t num_padding_bytes =
+      (kAlignment - offset % kAlignment) % kAlignment;
+  const char padding[kAlignment] = {0};
+  file->write(padding, num_padding_bytes);
+}
+
+// Serializes the columns of a chunk into one contiguous buffer.
+class ChunkWriter {
+ public:
+  template <typename T>
+  void Write(const std::vector<T>& column) {
+    const size_t num_bytes = column.size() * sizeof(T);
+    const size_t offset = data_.size();
+    data_.resize(offset + num_bytes);
+    if (num_bytes > 0) {
+      std::memcpy(&data_[offset], column.data(), num_bytes);
+    }
+  }
+
+  void Write(const std::string& data) { data_ += data; }
+
+  const std::string& Data() const { return data_; }
+
+ private:
+  std::string data_;
+};
+
+// Reads the columns of a chunk in the order they were written.
+class ChunkReader {
+ public:
+  ChunkReader(const char* data, const size_t num_bytes, const std::string& path)
+      : data_(data), num_bytes_(num_bytes), offset_(0), path_(path) {}
+
+  template <typename T>
+  std::vector<T> Read(const size_t size) {
+    std::vector<T> column(size);
+    const char* data = Advance(size * sizeof(T));
+    if (size > 0) {
+      std::memcpy(column.data(), data, size * sizeof(T));
+    }
+    return column;
+  }
+
+  std::string ReadString(const size_t size) {
+    return std::string(Advance(size), size);
+  }
+
+ private:
+  const char* Advance(const size_t num_bytes) {
+    THROW_CHECK_LE(offset_ + num_bytes, num_bytes_)
+        << "Truncated chunk in reconstruction " << path_;
+    const char* data = data_ + offset_;
+    offset_ += num_bytes;
+    return data;
+  }
+
+  const char* data_;
+  const size_t num_bytes_;
+  size_t offset_;
+  const std::string& path_;
+};
+
+template <typename T>
+uint64_t Sum(const std::vector<T>& values) {
+  uint64_t sum = 0;
+  for (const T value : values) {
+    sum += value;
+  }
+  return sum;
+}
+
+class ChunkedFileWriter {
+ public:
+  ChunkedFileWriter(const std::string& path, const bool compress)
+      : file_(path, std::ios::trunc | std::ios::binary),
+        path_(path),
+        compress_(compress) {
+    THROW_CHECK_FILE_OPEN(file_, path);
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, kMagic, sizeof(kMagic));
+    header_.version = kVersion;
+    // The header is rewritten once all chunks are known.
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+  }
+
+  void WriteChunk(const Table table,
+                  const std::vector<uint64_t>& ids,
+                  const std::string& data) {
+    THROW_CHECK(!ids.empty());
+    ChunkEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.offset = file_.tellp();
+    entry.num_raw_bytes = data.size();
+    entry.first_id = ids.front();
+    entry.last_id = ids.back();
+    entry.num_records = ids.size();
+    entry.compression = kUncompressed;
+
+    if (compress_ && data.size() <= LZ4_MAX_INPUT_SIZE) {
+      buffer_.resize(LZ4_compressBound(data.size()));
+      const int num_bytes = LZ4_compress_default(
+          data.data(), buffer_.data(), data.size(), buffer_.size());
+      if (num_bytes > 0 && static_cast<size_t>(num_bytes) < data.size()) {
+        entry.compression = kLZ4Compressed;
+        entry.num_bytes = num_bytes;
+        file_.write(buffer_.data(), num_bytes);
+      }
+    }
+
+    if (entry.compression == kUncompressed) {
+      entry.num_bytes = data.size();
+      file_.write(data.data(), data.size());
+    }
+
+    header_.num_records[table] += ids.size();
+    entries_[table].push_back(entry);
+  }
+
+  void Close() {
+    for (int table = 0; table < kNumTables; ++table) {
+      WritePadding(&file_);
+      header_.num_chunks[table] = entries_[table].size();
+      header_.index_offset[table] = file_.tellp();
+      file_.write(reinterpret_cast<const char*>(entries_[table].data()),
+                  entries_[table].size() * sizeof(ChunkEntry));
+    }
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    THROW_CHECK(file_.good()) << "Failed to write reconstruction " << path_;
+  }
+
+ private:
+  std::ofstream file_;
+  const std::string path_;
+  const bool compress_;
+  Header header_;
+  std::vector<ChunkEntry> entries_[kNumTables];
+  std::vector<char> buffer_;
+};
+
+class ChunkedFileReader {
+ public:
+  explicit ChunkedFileReader(const std::string& path)
+      : mapped_file_(path), header_(nullptr) {
+    THROW_CHECK_GE(mapped_file_.NumBytes(), sizeof(Header))
+        << "Invalid reconstruction " << path;
+    header_ = reinterpret_cast<const Header*>(mapped_file_.Data());
+    THROW_CHECK_EQ(std::memcmp(header_->magic, kMagic, sizeof(kMagic)), 0)
+        << "Invalid reconstruction " << path;
+    THROW_CHECK_EQ(header_->version, kVersion)
+        << "Unsupported reconstruction version in " << path;
+    for (int table = 0; table < kNumTables; ++table) {
+      THROW_CHECK_EQ(header_->index_offset[table] % kAlignment, 0);
+      THROW_CHECK_LE(header_->index_offset[table] +
+                         header_->num_chunks[table] * sizeof(ChunkEntry),
+                     mapped_file_.NumBytes())
+          << "Truncated reconstruction " << path;
+    }
+  }
+
+  const std::string& Path() const { return mapped_file_.Path(); }
+
+  size_t NumChunks(const Table table) const {
+    return header_->num_chunks[table];
+  }
+
+  const ChunkEntry& Entry(const Table table, const size_t chunk_idx) const {
+    return reinterpret_cast<const ChunkEntry*>(
+        mapped_file_.Data() + header_->index_offset[table])[chunk_idx];
+  }
+
+  // Reader of the decoded columns of a chunk. Uncompressed chunks are read
+  // directly from the mapped file, while compressed chunks are decoded into
+  // the buffer of the file reader, which remains valid until the next call.
+  ChunkReader Chunk(const Table table, const size_t chunk_idx) {
+    const ChunkEntry& entry = Entry(table, chunk_idx);
+    THROW_CHECK_LE(entry.offset + entry.num_bytes, mapped_file_.NumBytes())
+        << "Truncated reconstruction " << Path();
+    const char* data = mapped_file_.Data() + entry.offset;
+    if (entry.compression == kUncompressed) {
+      THROW_CHECK_EQ(entry.num_bytes, entry.num_raw_bytes);
+      return ChunkReader(data, entry.num_bytes, Path());
+    }
+    THROW_CHECK_EQ(entry.compression, kLZ4Compressed)
+        << "Unsupported compression in reconstruction " << Path();
+    THROW_CHECK_LE(entry.num_raw_bytes, LZ4_MAX_INPUT_SIZE);
+    buffer_.resize(entry.num_raw_bytes);
+    const int num_raw_bytes = LZ4_decompress_safe(
+        data, buffer_.data(), entry.num_bytes, entry.num_raw_bytes);
+    THROW_CHECK_EQ(num_raw_bytes, static_cast<int>(entry.num_raw_bytes))
+        << "Corrupt chunk in reconstruction " << Path();
+    return ChunkReader(buffer_.data(), buffer_.size(), Path());
+  }
+
+  // Whether any identifier of the sorted list is in the id range of the chunk.
+  template <typename T>
+  bool ChunkContainsAny(const Table table,
+                        const size_t chunk_idx,
+                        const std::vector<T>& sorted_ids) const {
+    const ChunkEntry& entry = Entry(table, chunk_idx);
+    const auto it = std::lower_bound(
+        sorted_ids.begin(), sorted_ids.end(), entry.first_id);
+    return it != sorted_ids.end() && *it <= entry.last_id;
+  }
+
+ private:
+  MappedFile mapped_file_;
+  const Header* header_;
+  std::vector<char> buffer_;
+};
+
+template <typename T>
+std::vector<uint64_t> ToIds(const std::vector<T>& ids) {
+  return std::vector<uint64_t>(ids.begin(), ids.end());
+}
+
+void WriteCameras(const Reconstruction& reconstruction,
+                  ChunkedFileWriter* writer) {
+  std::vector<camera_t> camera_ids;
+  camera_ids.reserve(reconstruction.NumCameras());
+  for (const auto& [camera_id, _] : reconstruction.Cameras()) {
+    camera_ids.push_back(camera_id);
+  }
+  std::sort(camera_ids.begin(), camera_ids.end());
+
+  for (size_t begin = 0; begin < camera_ids.size();
+       begin += kNumCamerasPerChunk) {
+    const size_t end =
+        std::min(camera_ids.size(), begin + kNumCamerasPerChunk);
+    const std::vector<camera_t> chunk_ids(camera_ids.begin() + begin,
+                                          camera_ids.begin() + end);
+    std::vector<int32_t> model_ids;
+    std::vector<uint64_t> widths;
+    std::vector<uint64_t> heights;
+    std::vector<uint32_t> num_params;
+    std::vector<double> params;
+    for (const camera_t camera_id : chunk_ids) {
+      const Camera& camera = reconstruction.Camera(camera_id);
+      model_ids.push_back(static_cast<int32_t>(camera.model_id));
+      widths.push_back(camera.width);
+      heights.push_back(camera.height);
+      num_params.push_back(camera.params.size());
+      params.insert(params.end(), camera.params.begin(), camera.params.end());
+    }
+    ChunkWriter chunk;
+    chunk.Write(chunk_ids);
+    chunk.Write(model_ids);
+    chunk.Write(widths);
+    chunk.Write(heights);
+    chunk.Write(num_params);
+    chunk.Write(params);
+    writer->WriteChunk(kCamerasTable, ToIds(chunk_ids), chunk.Data());
+  }
+}
+
+void WriteImages(const Reconstruction& reconstruction,
+                 const int num_images_per_chunk,
+                 ChunkedFileWriter* writer) {
+  std::vector<image_t> image_ids = reconstruction.RegImageIds();
+  std::sort(image_ids.begin(), image_ids.end());
+
+  for (size_t begin = 0; begin < image_ids.size();
+       begin += num_images_per_chunk) {
+    const size_t end =
+        std::min(image_ids.size(), begin + num_images_per_chunk);
+    const std::vector<image_t> chunk_ids(image_ids.begin() + begin,
+                                         image_ids.begin() + end);
+    std::vector<camera_t> camera_ids;
+    std::vector<double> rotations;
+    std::vector<double> translations;
+    std::vector<uint32_t> name_lengths;
+    std::string names;
+    std::vector<uint32_t> num_points2D;
+    std::vector<double> xys;
+    std::vector<point3D_t> point3D_ids;
+    for (const image_t image_id : chunk_ids) {
+      const Image& image = reconstruction.Image(image_id);
+      camera_ids.push_back(image.CameraId());
+      const Rigid3d& cam_from_world = image.CamFromWorld();
+      rotations.insert(rotations.end(),
+                       cam_from_world.rotation.coeffs().data(),
+                       cam_from_world.rotation.coeffs().data() + 4);
+      translations.insert(translations.end(),
+                          cam_from_world.translation.data(),
+                          cam_from_world.translation.data() + 3);
+      name_lengths.push_back(image.Name().size());
+      names += image.Name();
+      num_points2D.push_back(image.NumPoints2D());
+      for (const Point2D& point2D : image.Points2D()) {
+        xys.push_back(point2D.xy(0));
+        xys.push_back(point2D.xy(1));
+        point3D_ids.push_back(point2D.point3D_id);
+      }
+    }
+    ChunkWriter chunk;
+    chunk.Write(chunk_ids);
+    chunk.Write(camera_ids);
+    chunk.Write(rotations);
+    chunk.Write(translations);
+    chunk.Write(name_lengths);
+    chunk.Write(names);
+    chunk.Write(num_points2D);
+    chunk.Write(xys);
+    chunk.Write(point3D_ids);
+    writer->WriteChunk(kImagesTable, ToIds(chunk_ids), chunk.Data());
+  }
+}
+
+void WritePoints3D(const Reconstruction& reconstruction,
+                   const int num_points3D_per_chunk,
+                   ChunkedFileWriter* writer) {
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(reconstruction.NumPoints3D());
+  for (const auto& [point3D_id, _] : reconstruction.Points3D()) {
+    point3D_ids.push_back(point3D_id);
+  }
+  std::sort(point3D_ids.begin(), point3D_ids.end());
+
+  for (size_t begin = 0; begin < point3D_ids.size();
+       begin += num_points3D_per_chunk) {
+    const size_t end =
+        std::min(point3D_ids.size(), begin + num_points3D_per_chunk);
+    const std::vector<point3D_t> chunk_ids(point3D_ids.begin() + begin,
+                                           point3D_ids.begin() + end);
+    std::vector<double> xyzs;
+    std::vector<uint8_t> colors;
+    std::vector<double> errors;
+    std::vector<uint32_t> track_lengths;
+    std::vector<image_t> track_image_ids;
+    std::vector<point2D_t> track_point2D_idxs;
+    for (const point3D_t point3D_id : chunk_ids) {
+      const Point3D& point3D = reconstruction.Point3D(point3D_id);
+      xyzs.insert(xyzs.end(), point3D.xyz.data(), point3D.xyz.data() + 3);
+      colors.insert(
+          colors.end(), point3D.color.data(), point3D.color.data() + 3);
+      errors.push_back(point3D.error);
+      track_lengths.push_back(point3D.track.Length());
+      for (const TrackElement& track_el : point3D.track.Elements()) {
+        track_image_ids.push_back(track_el.image_id);
+        track_point2D_idxs.push_back(track_el.point2D_idx);
+      }
+    }
+    ChunkWriter chunk;
+    chunk.Write(chunk_ids);
+    chunk.Write(xyzs);
+    chunk.Write(colors);
+    chunk.Write(errors);
+    chunk.Write(track_lengths);
+    chunk.Write(track_image_ids);
+    chunk.Write(track_point2D_idxs);
+    writer->WriteChunk(kPoints3DTable, chunk_ids, chunk.Data());
+  }
+}
+
+// Read the registered images of all chunks or only the given sorted subset.
+void ReadImages(ChunkedFileReader* reader,
+                const std::vector<image_t>& sorted_image_ids,
+                Reconstruction& reconstruction) {
+  const bool read_all = sorted_image_ids.empty();
+  for (size_t chunk_idx = 0; chunk_idx < reader->NumChunks(kImagesTable);
+       ++chunk_idx) {
+    if (!read_all &&
+        !reader->ChunkContainsAny(kImagesTable, chunk_idx, sorted_image_ids)) {
+      continue;
+    }
+    const size_t num_images =
+        reader->Entry(kImagesTable, chunk_idx).num_records;
+    ChunkReader chunk = reader->Chunk(kImagesTable, chunk_idx);
+    const std::vector<image_t> image_ids = chunk.Read<image_t>(num_images);
+    const std::vector<camera_t> camera_ids = chunk.Read<camera_t>(num_images);
+    const std::vector<double> rotations = chunk.Read<double>(4 * num_images);
+    const std::vector<double> translations =
+        chunk.Read<double>(3 * num_images);
+    const std::vector<uint32_t> name_lengths =
+        chunk.Read<uint32_t>(num_images);
+    const std::string names = chunk.ReadString(Sum(name_lengths));
+    const std::vector<uint32_t> num_points2D =
+        chunk.Read<uint32_t>(num_images);
+    const size_t total_num_points2D = Sum(num_points2D);
+    const std::vector<double> xys = chunk.Read<double>(2 * total_num_points2D);
+    const std::vector<point3D_t> point3D_ids =
+        chunk.Read<point3D_t>(total_num_points2D);
+
+    size_t name_offset = 0;
+    size_t point2D_offset = 0;
+    for (size_t i = 0; i < num_images; ++i) {
+      const size_t prev_name_offset = name_offset;
+      const size_t prev_point2D_offset = point2D_offset;
+      name_offset += name_lengths[i];
+      point2D_offset += num_points2D[i];
+      if (!read_all && !std::binary_search(sorted_image_ids.begin(),
+                                           sorted_image_ids.end(),
+                                           image_ids[i])) {
+        continue;
+      }
+
+      class Image image;
+      image.SetImageId(image_ids[i]);
+      image.SetCameraId(camera_ids[i]);
+      image.SetName(names.substr(prev_name_offset, name_lengths[i]));
+      Rigid3d& cam_from_world = image.CamFromWorld();
+      cam_from_world.rotation.coeffs() =
+          Eigen::Map<const Eigen::Vector4d>(&rotations[4 * i]);
+      cam_from_world.rotation.normalize();
+      cam_from_world.translation =
+          Eigen::Map<const Eigen::Vector3d>(&translations[3 * i]);
+
+      std::vector<struct Point2D> points2D(num_points2D[i]);
+      for (size_t j = 0; j < points2D.size(); ++j) {
+        const size_t point2D_idx = prev_point2D_offset + j;
+        points2D[j].xy =
+            Eigen::Map<const Eigen::Vector2d>(&xys[2 * point2D_idx]);
+        points2D[j].point3D_id = point3D_ids[point2D_idx];
+      }
+      image.SetPoints2D(points2D);
+
+      image.SetRegistered(true);
+      reconstruction.AddImage(std::move(image));
+    }
+  }
+}
+
+// Read the cameras of all chunks or only the given sorted subset.
+void ReadCameras(ChunkedFileReader* reader,
+                 const std::vector<camera_t>& sorted_camera_ids,
+                 const bool read_all,
+                 Reconstruction& reconstruction) {
+  for (size_t chunk_idx = 0; chunk_idx < reader->NumChunks(kCamerasTable);
+       ++chunk_idx) {
+    if (!read_all && !reader->ChunkContainsAny(
+                         kCamerasTable, chunk_idx, sorted_camera_ids)) {
+      continue;
+    }
+    const size_t num_cameras =
+        reader->Entry(kCamerasTable, chunk_idx).num_records;
+    ChunkReader chunk = reader->Chunk(kCamerasTable, chunk_idx);
+    const std::vector<camera_t> camera_ids = chunk.Read<camera_t>(num_cameras);
+    const std::vector<int32_t> model_ids = chunk.Read<int32_t>(num_cameras);
+    const std::vector<uint64_t> widths = chunk.Read<uint64_t>(num_cameras);
+    const std::vector<uint64_t> heights = chunk.Read<uint64_t>(num_cameras);
+    const std::vector<uint32_t> num_params = chunk.Read<uint32_t>(num_cameras);
+    const std::vector<double> params = chunk.Read<double>(Sum(num_params));
+
+    size_t params_offset = 0;
+    for (size_t i = 0; i < num_cameras; ++i) {
+      const size_t prev_params_offset = params_offset;
+      params_offset += num_params[i];
+      if (!read_all && !std::binary_search(sorted_camera_ids.begin(),
+                                           sorted_camera_ids.end(),
+                                           camera_ids[i])) {
+        continue;
+      }
+      struct Camera camera;
+      camera.camera_id = camera_ids[i];
+      camera.model_id = static_cast<CameraModelId>(model_ids[i]);
+      camera.width = widths[i];
+      camera.height = heights[i];
+      camera.params.assign(params.begin() + prev_params_offset,
+                           params.begin() + params_offset);
+      THROW_CHECK(camera.VerifyParams());
+      reconstruction.AddCamera(std::move(camera));
+    }
+  }
+}
+
+// Read the 3D points of all chunks or only the given sorted subset, whose
+// tracks are restricted to the images in the reconstruction.
+void ReadPoints3D(ChunkedFileReader* reader,
+                  const std::vector<point3D_t>& sorted_point3D_ids,
+                  const bool read_all,
+                  Reconstruction& reconstruction) {
+  for (size_t chunk_idx = 0; chunk_idx < reader->NumChunks(kPoints3DTable);
+       ++chunk_idx) {
+    if (!read_all && !reader->ChunkContainsAny(
+                         kPoints3DTable, chunk_idx, sorted_point3D_ids)) {
+      continue;
+    }
+    const size_t num_points3D =
+        reader->Entry(kPoints3DTable, chunk_idx).num_records;
+    ChunkReader chunk = reader->Chunk(kPoints3DTable, chunk_idx);
+    const std::vector<point3D_t> point3D_ids =
+        chunk.Read<point3D_t>(num_points3D);
+    const std::vector<double> xyzs = chunk.Read<double>(3 * num_points3D);
+    const std::vector<uint8_t> colors = chunk.Read<uint8_t>(3 * num_points3D);
+    const std::vector<double> errors = chunk.Read<double>(num_points3D);
+    const std::vector<uint32_t> track_lengths =
+        chunk.Read<uint32_t>(num_points3D);
+    const size_t total_track_length = Sum(track_lengths);
+    const std::vector<image_t> track_image_ids =
+        chunk.Read<image_t>(total_track_length);
+    const std::vector<point2D_t> track_point2D_idxs =
+        chunk.Read<point2D_t>(total_track_length);
+
+    size_t track_offset = 0;
+    for (size_t i = 0; i < num_points3D; ++i) {
+      const size_t prev_track_offset = track_offset;
+      track_offset += track_lengths[i];
+      if (!read_all && !std::binary_search(sorted_point3D_ids.begin(),
+                                           sorted_point3D_ids.end(),
+                                           point3D_ids[i])) {
+        continue;
+      }
+      struct Point3D point3D;
+      point3D.xyz = Eigen::Map<const Eigen::Vector3d>(&xyzs[3 * i]);
+      point3D.color = Eigen::Map<const Eigen::Vector3ub>(&colors[3 * i]);
+      point3D.error = errors[i];
+      point3D.track.Reserve(track_lengths[i]);
+      for (size_t j = prev_track_offset; j < track_offset; ++j) {
+        if (read_all || reconstruction.ExistsImage(track_image_ids[j])) {
+          point3D.track.AddElement(track_image_ids[j], track_point2D_idxs[j]);
+        }
+      }
+      reconstruction.AddPoint3D(point3D_ids[i], std::move(point3D));
+    }
+  }
+}
+
+}  // namespace
+
+bool ChunkedReconstructionOptions::Check() const {
+  CHECK_OPTION_GT(num_images_per_chunk, 0);
+  CHECK_OPTION_GT(num_points3D_per_chunk, 0);
+  return true;
+}
+
+void WriteReconstructionChunked(const Reconstruction& reconstruction,
+                                const std::string& path,
+                                const ChunkedReconstructionOptions& options) {
+  THROW_CHECK(options.Check());
+  // The index is used in-place, so the file is always in native byte order.
+  THROW_CHECK(IsLittleEndian())
+      << "Chunked reconstructions are only supported on little-endian "
+         "platforms";
+
+  ChunkedFileWriter writer(path, options.compress);
+  WriteCameras(reconstruction, &writer);
+  WriteImages(reconstruction, options.num_images_per_chunk, &writer);
+  WritePoints3D(reconstruction, options.num_points3D_per_chunk, &writer);
+  writer.Close();
+}
+
+void ReadReconstructionChunked(Reconstruction& reconstruction,
+                               const std::string& path,
+                               const std::unordered_set<image_t>& image_ids) {
+  THROW_CHECK(IsLittleEndian())
+      << "Chunked reconstructions are only supported on little-endian "
+         "platforms";
+
+  ChunkedFileReader reader(path);
+
+  const bool read_all = image_ids.empty();
+  std::vector<image_t> sorted_image_ids(image_ids.begin(), image_ids.end());
+  std::sort(sorted_image_ids.begin(), sorted_image_ids.end());
+  ReadImages(&reader, sorted_image_ids, reconstruction);
+
+  // For partial reads, only the cameras and 3D points of the read images are
+  // needed, such that the other chunks can be skipped.
+  std::vector<camera_t> sorted_camera_ids;
+  std::vector<point3D_t> sorted_point3D_ids;
+  if (!read_all) {
+    for (const auto& [_, image] : reconstruction.Images()) {
+      sorted_camera_ids.push_back(image.CameraId());
+      for (const Point2D& point2D : image.Points2D()) {
+        if (point2D.HasPoint3D()) {
+          sorted_point3D_ids.push_back(point2D.point3D_id);
+        }
+      }
+    }
+    std::sort(sorted_camera_ids.begin(), sorted_camera_ids.end());
+    sorted_camera_ids.erase(
+        std::unique(sorted_camera_ids.begin(), sorted_camera_ids.end()),
+        sorted_camera_ids.end());
+    std::sort(sorted_point3D_ids.begin(), sorted_point3D_ids.end());
+    sorted_point3D_ids.erase(
+        std::unique(sorted_point3D_ids.begin(), sorted_point3D_ids.end()),
+        sorted_point3D_ids.end());
+  }
+
+  ReadCameras(&reader, sorted_camera_ids, read_all, reconstruction);
+  ReadPoints3D(&reader, sorted_point3D_ids, read_all, reconstruction);
+}
+
+}  // namespace colmap
@@ -0,0 +1,78 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/scene/reconstruction.h"
+#include "colmap/util/types.h"
+
+#include <string>
+#include <unordered_set>
+
+namespace colmap {
+
+// File name of the chunked binary format in a reconstruction directory.
+inline constexpr char kChunkedReconstructionFileName[] = "reconstruction.cbin";
+
+struct ChunkedReconstructionOptions {
+  // The maximum number of registered images and 3D points per chunk. Smaller
+  // chunks reduce the amount of data decoded for partial reads at the cost of
+  // a lower compression ratio.
+  int num_images_per_chunk = 256;
+  int num_points3D_per_chunk = 65536;
+
+  // Whether to compress the chunks with LZ4. Chunks that do not shrink are
+  // stored uncompressed.
+  bool compress = true;
+
+  bool Check() const;
+};
+
+// Write the cameras, registered images, and 3D points to a single file. In
+// contrast to the legacy binary format, every table is split into chunks of
+// consecutive records sorted by identifier, the columns of a chunk are stored
+// as contiguous arrays, and an index of the chunks and their identifier ranges
+// is stored at the end of the file.
+void WriteReconstructionChunked(const Reconstruction& reconstruction,
+                                const std::string& path,
+                                const ChunkedReconstructionOptions& options =
+                                    ChunkedReconstructionOptions());
+
+// Read a reconstruction in the chunked format through a memory mapping of the
+// file. If image identifiers are given, only these registered images, their
+// cameras, and the 3D points observed by them are read and the tracks of the
+// 3D points are restricted to these images. Only the chunks that contain
+// requested records are decoded.
+void ReadReconstructionChunked(
+    Reconstruction& reconstruction,
+    const std::string& path,
+    const std::unordered_set<image_t>& image_ids = {});
+
+}  // namespace colmap
@@ -0,0 +1,201 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/reconstruction_chunked_io.h"
+
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+void ExpectEqualReconstructions(const Reconstruction& reconstruction1,
+                                const Reconstruction& reconstruction2) {
+  EXPECT_EQ(reconstruction1.NumCameras(), reconstruction2.NumCameras());
+  for (const auto& [camera_id, camera] : reconstruction1.Cameras()) {
+    const Camera& other_camera = reconstruction2.Camera(camera_id);
+    EXPECT_EQ(camera.model_id, other_camera.model_id);
+    EXPECT_EQ(camera.width, other_camera.width);
+    EXPECT_EQ(camera.height, other_camera.height);
+    EXPECT_EQ(camera.params, other_camera.params);
+  }
+
+  EXPECT_EQ(reconstruction1.NumRegImages(), reconstruction2.NumRegImages());
+  for (const image_t image_id : reconstruction1.RegImageIds()) {
+    const Image& image = reconstruction1.Image(image_id);
+    const Image& other_image = reconstruction2.Image(image_id);
+    EXPECT_TRUE(other_image.IsRegistered());
+    EXPECT_EQ(image.Name(), other_image.Name());
+    EXPECT_EQ(image.CameraId(), other_image.CameraId());
+    EXPECT_LT(image.CamFromWorld().rotation.angularDistance(
+                  other_image.CamFromWorld().rotation),
+              1e-12);
+    EXPECT_EQ(image.CamFromWorld().translation,
+              other_image.CamFromWorld().translation);
+    EXPECT_EQ(image.NumPoints3D(), other_image.NumPoints3D());
+    ASSERT_EQ(image.NumPoints2D(), other_image.NumPoints2D());
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      EXPECT_EQ(image.Point2D(point2D_idx).xy,
+                other_image.Point2D(point2D_idx).xy);
+      EXPECT_EQ(image.Point2D(point2D_idx).point3D_id,
+                other_image.Point2D(point2D_idx).point3D_id);
+    }
+  }
+
+  EXPECT_EQ(reconstruction1.NumPoints3D(), reconstruction2.NumPoints3D());
+  for (const auto& [point3D_id, point3D] : reconstruction1.Points3D()) {
+    const Point3D& other_point3D = reconstruction2.Point3D(point3D_id);
+    EXPECT_EQ(point3D.xyz, other_point3D.xyz);
+    EXPECT_EQ(point3D.color, other_point3D.color);
+    EXPECT_EQ(point3D.error, other_point3D.error);
+    ASSERT_EQ(point3D.track.Length(), other_point3D.track.Length());
+    for (size_t i = 0; i < point3D.track.Length(); ++i) {
+      EXPECT_EQ(point3D.track.Element(i).image_id,
+                other_point3D.track.Element(i).image_id);
+      EXPECT_EQ(point3D.track.Element(i).point2D_idx,
+                other_point3D.track.Element(i).point2D_idx);
+    }
+  }
+}
+
+class ParameterizedChunkedReconstructionTests
+    : public ::testing::TestWithParam<bool> {};
+
+TEST_P(ParameterizedChunkedReconstructionTests, ReadWrite) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_options;
+  synthetic_options.num_cameras = 3;
+  synthetic_options.num_images = 7;
+  SynthesizeDataset(synthetic_options, &reconstruction);
+
+  ChunkedReconstructionOptions options;
+  options.num_images_per_chunk = 2;
+  options.num_points3D_per_chunk = 30;
+  options.compress = GetParam();
+  const std::string path = CreateTestDir() + "/reconstruction.cbin";
+  WriteReconstructionChunked(reconstruction, path, options);
+
+  Reconstruction read_reconstruction;
+  ReadReconstructionChunked(read_reconstruction, path);
+  ExpectEqualReconstructions(reconstruction, read_reconstruction);
+}
+
+TEST_P(ParameterizedChunkedReconstructionTests, ReadImageSubset) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_options;
+  synthetic_options.num_cameras = 3;
+  synthetic_options.num_images = 7;
+  SynthesizeDataset(synthetic_options, &reconstruction);
+
+  ChunkedReconstructionOptions options;
+  options.num_images_per_chunk = 2;
+  options.num_points3D_per_chunk = 30;
+  options.compress = GetParam();
+  const std::string path = CreateTestDir() + "/reconstruction.cbin";
+  WriteReconstructionChunked(reconstruction, path, options);
+
+  const std::vector<image_t>& reg_image_ids = reconstruction.RegImageIds();
+  const std::unordered_set<image_t> image_ids = {reg_image_ids[1],
+                                                 reg_image_ids[4]};
+  Reconstruction read_reconstruction;
+  ReadReconstructionChunked(read_reconstruction, path, image_ids);
+
+  EXPECT_EQ(read_reconstruction.NumRegImages(), image_ids.size());
+  std::unordered_set<camera_t> camera_ids;
+  std::unordered_set<point3D_t> point3D_ids;
+  for (const image_t image_id : image_ids) {
+    const Image& image = reconstruction.Image(image_id);
+    const Image& read_image = read_reconstruction.Image(image_id);
+    EXPECT_EQ(read_image.Name(), image.Name());
+    EXPECT_EQ(read_image.NumPoints2D(), image.NumPoints2D());
+    EXPECT_EQ(read_image.NumPoints3D(), image.NumPoints3D());
+    camera_ids.insert(image.CameraId());
+    for (const Point2D& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D()) {
+        point3D_ids.insert(point2D.point3D_id);
+      }
+    }
+  }
+
+  EXPECT_EQ(read_reconstruction.NumCameras(), camera_ids.size());
+  for (const camera_t camera_id : camera_ids) {
+    EXPECT_TRUE(read_reconstruction.ExistsCamera(camera_id));
+  }
+
+  EXPECT_EQ(read_reconstruction.NumPoints3D(), point3D_ids.size());
+  for (const point3D_t point3D_id : point3D_ids) {
+    const Point3D& point3D = reconstruction.Point3D(point3D_id);
+    const Point3D& read_point3D = read_reconstruction.Point3D(point3D_id);
+    EXPECT_EQ(read_point3D.xyz, point3D.xyz);
+    size_t num_track_elements = 0;
+    for (const TrackElement& track_el : point3D.track.Elements()) {
+      num_track_elements += image_ids.count(track_el.image_id);
+    }
+    EXPECT_EQ(read_point3D.track.Length(), num_track_elements);
+    for (const TrackElement& track_el : read_point3D.track.Elements()) {
+      EXPECT_EQ(image_ids.count(track_el.image_id), 1);
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(ChunkedReconstructionTests,
+                         ParameterizedChunkedReconstructionTests,
+                         ::testing::Values(false, true));
+
+TEST(ChunkedReconstruction, ReadPrefersChunked) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_options;
+  SynthesizeDataset(synthetic_options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  reconstruction.WriteChunked(test_dir);
+  EXPECT_TRUE(ExistsFile(JoinPaths(test_dir, kChunkedReconstructionFileName)));
+
+  Reconstruction read_reconstruction;
+  read_reconstruction.Read(test_dir);
+  ExpectEqualReconstructions(reconstruction, read_reconstruction);
+}
+
+TEST(ChunkedReconstruction, Empty) {
+  const std::string path = CreateTestDir() + "/reconstruction.cbin";
+  WriteReconstructionChunked(Reconstruction(), path);
+  Reconstruction reconstruction;
+  ReadReconstructionChunked(reconstruction, path);
+  EXPECT_EQ(reconstruction.NumCameras(), 0);
+  EXPECT_EQ(reconstruction.NumImages(), 0);
+  EXPECT_EQ(reconstruction.NumPoints3D(), 0);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -36,13 +36,298 @@
 #include "colmap/scene/point3d.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/scene/track.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/ply.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/types.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace colmap {
+namespace {
+
+// Number of consecutive records that are decoded or serialized by one task.
+constexpr size_t kNumRecordsPerChunk = 4096;
+
+// Maximum number of serialized chunks that are buffered before being written,
+// which bounds the memory overhead of writing large files.
+constexpr size_t kMaxNumBufferedChunks = 256;
+
+// Decodes little-endian values from a contiguous buffer.
+class BinaryBufferReader {
+ public:
+  BinaryBufferReader(const char* data,
+                     const size_t num_bytes,
+                     const std::string& path)
+      : data_(data), num_bytes_(num_bytes), offset_(0), path_(path) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    std::memcpy(&value, Advance(sizeof(T)), sizeof(T));
+    return LittleEndianToNative(value);
+  }
+
+  std::string ReadString() {
+    const char* begin = data_ + offset_;
+    const void* end = std::memchr(begin, '\0', num_bytes_ - offset_);
+    THROW_CHECK(end != nullptr) << "Truncated file " << path_;
+    const size_t length = static_cast<const char*>(end) - begin;
+    Advance(length + 1);
+    return std::string(begin, length);
+  }
+
+  void Skip(const size_t num_bytes) { Advance(num_bytes); }
+
+  size_t Offset() const { return offset_; }
+
+ private:
+  const char* Advance(const size_t num_bytes) {
+    THROW_CHECK_LE(num_bytes, num_bytes_ - offset_)
+        << "Truncated file " << path_;
+    const char* data = data_ + offset_;
+    offset_ += num_bytes;
+    return data;
+  }
+
+  const char* data_;
+  const size_t num_bytes_;
+  size_t offset_;
+  const std::string& path_;
+};
+
+// Encodes little-endian values into a contiguous buffer.
+class BinaryBufferWriter {
+ public:
+  template <typename T>
+  void Write(const T value) {
+    const T little_endian_value = NativeToLittleEndian(value);
+    data_.append(reinterpret_cast<const char*>(&little_endian_value),
+                 sizeof(T));
+  }
+
+  void WriteString(const std::string& value) {
+    data_ += value;
+    data_ += '\0';
+  }
+
+  std::string& Data() { return data_; }
+
+ private:
+  std::string data_;
+};
+
+// Decode the records at the given offsets of the buffer in parallel, where the
+// last offset is the end of the last record.
+template <typename T, typename DecodeFunc>
+std::vector<T> DecodeRecords(const char* data,
+                             const size_t num_bytes,
+                             const std::vector<size_t>& offsets,
+                             const std::string& path,
+                             const int num_threads,
+                             const DecodeFunc& decode) {
+  std::vector<T> records(offsets.size() - 1);
+  ParallelForChunks(num_threads,
+                    records.size(),
+                    kNumRecordsPerChunk,
+                    [&](const size_t begin, const size_t end) {
+                      for (size_t i = begin; i < end; ++i) {
+                        BinaryBufferReader reader(data + offsets[i],
+                                                  num_bytes - offsets[i],
+                                                  path);
+                        decode(&reader, &records[i]);
+                      }
+                    });
+  return records;
+}
+
+// Serialize the records in parallel into chunks of consecutive records and
+// write the chunks in order.
+template <typename T, typename SerializeFunc>
+void WriteRecords(const std::vector<T>& records,
+                  const int num_threads,
+                  std::ostream* stream,
+                  const SerializeFunc& serialize) {
+  const size_t num_chunks =
+      (records.size() + kNumRecordsPerChunk - 1) / kNumRecordsPerChunk;
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_eff_threads > 1 && num_chunks > 1) {
+    thread_pool = std::make_unique<ThreadPool>(num_eff_threads);
+  }
+
+  std::vector<std::string> buffers;
+  for (size_t batch_begin = 0; batch_begin < num_chunks;
+       batch_begin += kMaxNumBufferedChunks) {
+    const size_t batch_end =
+        std::min(batch_begin + kMaxNumBufferedChunks, num_chunks);
+    buffers.resize(batch_end - batch_begin);
+    ParallelForChunks(
+        thread_pool.get(),
+        buffers.size(),
+        1,
+        [&](const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const size_t chunk_idx = batch_begin + i;
+            const size_t records_end = std::min(
+                (chunk_idx + 1) * kNumRecordsPerChunk, records.size());
+            BinaryBufferWriter writer;
+            for (size_t j = chunk_idx * kNumRecordsPerChunk; j < records_end;
+                 ++j) {
+              serialize(records[j], &writer);
+            }
+            buffers[i] = std::move(writer.Data());
+          }
+        });
+    for (const std::string& buffer : buffers) {
+      stream->write(buffer.data(), buffer.size());
+    }
+  }
+}
+
+// Offsets of the records in a binary images file. The end of the last record
+// is appended as an additional offset.
+std::vector<size_t> IndexImagesBinary(const MappedFile& file) {
+  BinaryBufferReader reader(file.Data(), file.NumBytes(), file.Path());
+  const size_t num_reg_images = reader.Read<uint64_t>();
+  std::vector<size_t> offsets;
+  offsets.reserve(num_reg_images + 1);
+  for (size_t i = 0; i < num_reg_images; ++i) {
+    offsets.push_back(reader.Offset());
+    reader.Skip(sizeof(image_t) + 7 * sizeof(double) + sizeof(camera_t));
+    reader.ReadString();
+    const size_t num_points2D = reader.Read<uint64_t>();
+    THROW_CHECK_LE(num_points2D, file.NumBytes())
+        << "Truncated file " << file.Path();
+    reader.Skip(num_points2D * (2 * sizeof(double) + sizeof(point3D_t)));
+  }
+  offsets.push_back(reader.Offset());
+  return offsets;
+}
+
+// Offsets of the records in a binary 3D points file. The end of the last
+// record is appended as an additional offset.
+std::vector<size_t> IndexPoints3DBinary(const MappedFile& file) {
+  BinaryBufferReader reader(file.Data(), file.NumBytes(), file.Path());
+  const size_t num_points3D = reader.Read<uint64_t>();
+  std::vector<size_t> offsets;
+  offsets.reserve(num_points3D + 1);
+  for (size_t i = 0; i < num_points3D; ++i) {
+    offsets.push_back(reader.Offset());
+    reader.Skip(sizeof(point3D_t) + 4 * sizeof(double) + 3 * sizeof(uint8_t));
+    const size_t track_length = reader.Read<uint64_t>();
+    THROW_CHECK_LE(track_length, file.NumBytes())
+        << "Truncated file " << file.Path();
+    reader.Skip(track_length * (sizeof(image_t) + sizeof(point2D_t)));
+  }
+  offsets.push_back(reader.Offset());
+  return offsets;
+}
+
+// Uniform grid over the union of the bounding boxes, in which every cell lists
+// the overlapping bounding boxes, such that the bounding boxes containing a
+// point are found without testing all of them.
+class BoundingBoxGrid {
+ public:
+  explicit BoundingBoxGrid(
+      const std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>>& bboxes)
+      : bboxes_(bboxes) {
+    THROW_CHECK(!bboxes_.empty());
+    min_ = bboxes_[0].first;
+    max_ = bboxes_[0].second;
+    Eigen::Vector3d mean_extent = Eigen::Vector3d::Zero();
+    for (const auto& bbox : bboxes_) {
+      min_ = min_.cwiseMin(bbox.first);
+      max_ = max_.cwiseMax(bbox.second);
+      mean_extent += bbox.second - bbox.first;
+    }
+    mean_extent /= bboxes_.size();
+
+    // The cells have about the mean size of the bounding boxes, such that a
+    // regular tiling maps to one cell per tile.
+    const Eigen::Vector3d extent = max_ - min_;
+    for (int d = 0; d < 3; ++d) {
+      num_cells_(d) = 1;
+      cell_size_(d) = 0;
+      if (std::isfinite(extent(d)) && extent(d) > 0 && mean_extent(d) > 0) {
+        num_cells_(d) = static_cast<int>(std::min<double>(
+            std::ceil(extent(d) / mean_extent(d)), kMaxNumCellsPerDim));
+        cell_size_(d) = extent(d) / num_cells_(d);
+      }
+    }
+
+    cells_.resize(num_cells_.prod());
+    for (size_t bbox_idx = 0; bbox_idx < bboxes_.size(); ++bbox_idx) {
+      const Eigen::Vector3i min_cell = CellIndex(bboxes_[bbox_idx].first);
+      const Eigen::Vector3i max_cell = CellIndex(bboxes_[bbox_idx].second);
+      for (int z = min_cell(2); z <= max_cell(2); ++z) {
+        for (int y = min_cell(1); y <= max_cell(1); ++y) {
+          for (int x = min_cell(0); x <= max_cell(0); ++x) {
+            cells_[LinearIndex(Eigen::Vector3i(x, y, z))].push_back(bbox_idx);
+          }
+        }
+      }
+    }
+  }
+
+  // Find the indices of the bounding boxes that contain the point.
+  void Find(const Eigen::Vector3d& xyz, std::vector<int>* bbox_idxs) const {
+    bbox_idxs->clear();
+    if (!IsInside(xyz, min_, max_)) {
+      return;
+    }
+    for (const int bbox_idx : cells_[LinearIndex(CellIndex(xyz))]) {
+      const auto& bbox = bboxes_[bbox_idx];
+      if (IsInside(xyz, bbox.first, bbox.second)) {
+        bbox_idxs->push_back(bbox_idx);
+      }
+    }
+  }
+
+ private:
+  static constexpr int kMaxNumCellsPerDim = 64;
+
+  static bool IsInside(const Eigen::Vector3d& xyz,
+                       const Eigen::Vector3d& min,
+                       const Eigen::Vector3d& max) {
+    return (xyz.array() >= min.array()).all() &&
+           (xyz.array() <= max.array()).all();
+  }
+
+  Eigen::Vector3i CellIndex(const Eigen::Vector3d& xyz) const {
+    Eigen::Vector3i cell = Eigen::Vector3i::Zero();
+    for (int d = 0; d < 3; ++d) {
+      if (cell_size_(d) > 0) {
+        cell(d) = std::clamp(
+            static_cast<int>((xyz(d) - min_(d)) / cell_size_(d)),
+            0,
+            num_cells_(d) - 1);
+      }
+    }
+    return cell;
+  }
+
+  size_t LinearIndex(const Eigen::Vector3i& cell) const {
+    return (static_cast<size_t>(cell(2)) * num_cells_(1) + cell(1)) *
+               num_cells_(0) +
+           cell(0);
+  }
+
+  const std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>>& bboxes_;
+  Eigen::Vector3d min_;
+  Eigen::Vector3d max_;
+  Eigen::Vector3d cell_size_;
+  Eigen::Vector3i num_cells_;
+  std::vector<std::vector<int>> cells_;
+};
+
+}  // namespace
 
 void ReadCamerasText(Reconstruction& reconstruction, const std::string& path) {
   std::ifstream file(path);
@@ -282,90 +567,91 @@ void ReadCamerasBinary(Reconstruction& reconstruction,
   }
 }
 
-void ReadImagesBinary(Reconstruction& reconstruction, const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
-
-  const size_t num_reg_images = ReadBinaryLittleEndian<uint64_t>(&file);
-  for (size_t i = 0; i < num_reg_images; ++i) {
-    class Image image;
-
-    image.SetImageId(ReadBinaryLittleEndian<image_t>(&file));
-
-    Rigid3d& cam_from_world = image.CamFromWorld();
-    cam_from_world.rotation.w() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.x() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.y() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.z() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.normalize();
-    cam_from_world.translation.x() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.translation.y() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.translation.z() = ReadBinaryLittleEndian<double>(&file);
-
-    image.SetCameraId(ReadBinaryLittleEndian<camera_t>(&file));
-
-    char name_char;
-    do {
-      file.read(&name_char, 1);
-      if (name_char != '\0') {
-        image.Name() += name_char;
-      }
-    } while (name_char != '\0');
-
-    const size_t num_points2D = ReadBinaryLittleEndian<uint64_t>(&file);
-
-    std::vector<Eigen::Vector2d> points2D;
-    points2D.reserve(num_points2D);
-    std::vector<point3D_t> point3D_ids;
-    point3D_ids.reserve(num_points2D);
-    for (size_t j = 0; j < num_points2D; ++j) {
-      const double x = ReadBinaryLittleEndian<double>(&file);
-      const double y = ReadBinaryLittleEndian<double>(&file);
-      points2D.emplace_back(x, y);
-      point3D_ids.push_back(ReadBinaryLittleEndian<point3D_t>(&file));
-    }
-
-    image.SetPoints2D(points2D);
+void ReadImagesBinary(Reconstruction& reconstruction,
+                      const std::string& path,
+                      const int num_threads) {
+  const MappedFile file(path);
+
+  // Index the record boundaries before decoding the records in parallel.
+  const std::vector<size_t> offsets = IndexImagesBinary(file);
+
+  std::vector<class Image> images = DecodeRecords<class Image>(
+      file.Data(),
+      file.NumBytes(),
+      offsets,
+      path,
+      num_threads,
+      [](BinaryBufferReader* reader, class Image* image) {
+        image->SetImageId(reader->Read<image_t>());
+
+        Rigid3d& cam_from_world = image->CamFromWorld();
+        cam_from_world.rotation.w() = reader->Read<double>();
+        cam_from_world.rotation.x() = reader->Read<double>();
+        cam_from_world.rotation.y() = reader->Read<double>();
+        cam_from_world.rotation.z() = reader->Read<double>();
+        cam_from_world.rotation.normalize();
+        cam_from_world.translation.x() = reader->Read<double>();
+        cam_from_world.translation.y() = reader->Read<double>();
+        cam_from_world.translation.z() = reader->Read<double>();
+
+        image->SetCameraId(reader->Read<camera_t>());
+        image->SetName(reader->ReadString());
+
+        const size_t num_points2D = reader->Read<uint64_t>();
+        std::vector<struct Point2D> points2D(num_points2D);
+        for (struct Point2D& point2D : points2D) {
+          point2D.xy.x() = reader->Read<double>();
+          point2D.xy.y() = reader->Read<double>();
+          point2D.point3D_id = reader->Read<point3D_t>();
+        }
+        image->SetPoints2D(points2D);
 
-    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
-         ++point2D_idx) {
-      if (point3D_ids[point2D_idx] != kInvalidPoint3DId) {
-        image.SetPoint3DForPoint2D(point2D_idx, point3D_ids[point2D_idx]);
-      }
-    }
+        image->SetRegistered(true);
+      });
 
-    image.SetRegistered(true);
+  for (class Image& image : images) {
     reconstruction.AddImage(std::move(image));
   }
 }
 
 void ReadPoints3DBinary(Reconstruction& reconstruction,
-                        const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
-
-  const size_t num_points3D = ReadBinaryLittleEndian<uint64_t>(&file);
-  for (size_t i = 0; i < num_points3D; ++i) {
-    struct Point3D point3D;
-
-    const point3D_t point3D_id = ReadBinaryLittleEndian<point3D_t>(&file);
-
-    point3D.xyz(0) = ReadBinaryLittleEndian<double>(&file);
-    point3D.xyz(1) = ReadBinaryLittleEndian<double>(&file);
-    point3D.xyz(2) = ReadBinaryLittleEndian<double>(&file);
-    point3D.color(0) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.color(1) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.color(2) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.error = ReadBinaryLittleEndian<double>(&file);
-
-    const size_t track_length = ReadBinaryLittleEndian<uint64_t>(&file);
-    for (size_t j = 0; j < track_length; ++j) {
-      const image_t image_id = ReadBinaryLittleEndian<image_t>(&file);
-      const point2D_t point2D_idx = ReadBinaryLittleEndian<point2D_t>(&file);
-      point3D.track.AddElement(image_id, point2D_idx);
-    }
-    point3D.track.Compress();
-
+                        const std::string& path,
+                        const int num_threads) {
+  const MappedFile file(path);
+
+  // Index the record boundaries before decoding the records in parallel.
+  const std::vector<size_t> offsets = IndexPoints3DBinary(file);
+
+  std::vector<std::pair<point3D_t, struct Point3D>> points3D =
+      DecodeRecords<std::pair<point3D_t, struct Point3D>>(
+          file.Data(),
+          file.NumBytes(),
+          offsets,
+          path,
+          num_threads,
+          [](BinaryBufferReader* reader,
+             std::pair<point3D_t, struct Point3D>* record) {
+            record->first = reader->Read<point3D_t>();
+
+            struct Point3D& point3D = record->second;
+            point3D.xyz(0) = reader->Read<double>();
+            point3D.xyz(1) = reader->Read<double>();
+            point3D.xyz(2) = reader->Read<double>();
+            point3D.color(0) = reader->Read<uint8_t>();
+            point3D.color(1) = reader->Read<uint8_t>();
+            point3D.color(2) = reader->Read<uint8_t>();
+            point3D.error = reader->Read<double>();
+
+            const size_t track_length = reader->Read<uint64_t>();
+            point3D.track.Reserve(track_length);
+            for (size_t j = 0; j < track_length; ++j) {
+              const image_t image_id = reader->Read<image_t>();
+              const point2D_t point2D_idx = reader->Read<point2D_t>();
+              point3D.track.AddElement(image_id, point2D_idx);
+            }
+          });
+
+  for (auto& [point3D_id, point3D] : points3D) {
     reconstruction.AddPoint3D(point3D_id, std::move(point3D));
   }
 }
@@ -525,65 +811,391 @@ void WriteCamerasBinary(const Reconstruction& reconstruction,
 }
 
 void WriteImagesBinary(const Reconstruction& reconstruction,
-                       const std::string& path) {
+                       const std::string& path,
+                       const int num_threads) {
   std::ofstream file(path, std::ios::trunc | std::ios::binary);
   THROW_CHECK_FILE_OPEN(file, path);
 
   WriteBinaryLittleEndian<uint64_t>(&file, reconstruction.NumRegImages());
 
+  std::vector<const class Image*> images;
+  images.reserve(reconstruction.NumRegImages());
   for (const auto& image : reconstruction.Images()) {
-    if (!image.second.IsRegistered()) {
-      continue;
+    if (image.second.IsRegistered()) {
+      images.push_back(&image.second);
     }
+  }
 
-    WriteBinaryLittleEndian<image_t>(&file, image.first);
-
-    const Rigid3d& cam_from_world = image.second.CamFromWorld();
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.w());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.x());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.y());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.z());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.translation.x());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.translation.y());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.translation.z());
-
-    WriteBinaryLittleEndian<camera_t>(&file, image.second.CameraId());
-
-    const std::string name = image.second.Name() + '\0';
-    file.write(name.c_str(), name.size());
+  WriteRecords(
+      images,
+      num_threads,
+      &file,
+      [](const class Image* image, BinaryBufferWriter* writer) {
+        writer->Write<image_t>(image->ImageId());
+
+        const Rigid3d& cam_from_world = image->CamFromWorld();
+        writer->Write<double>(cam_from_world.rotation.w());
+        writer->Write<double>(cam_from_world.rotation.x());
+        writer->Write<double>(cam_from_world.rotation.y());
+        writer->Write<double>(cam_from_world.rotation.z());
+        writer->Write<double>(cam_from_world.translation.x());
+        writer->Write<double>(cam_from_world.translation.y());
+        writer->Write<double>(cam_from_world.translation.z());
+
+        writer->Write<camera_t>(image->CameraId());
+        writer->WriteString(image->Name());
+
+        writer->Write<uint64_t>(image->NumPoints2D());
+        for (const Point2D& point2D : image->Points2D()) {
+          writer->Write<double>(point2D.xy(0));
+          writer->Write<double>(point2D.xy(1));
+          writer->Write<point3D_t>(point2D.point3D_id);
+        }
+      });
 
-    WriteBinaryLittleEndian<uint64_t>(&file, image.second.NumPoints2D());
-    for (const Point2D& point2D : image.second.Points2D()) {
-      WriteBinaryLittleEndian<double>(&file, point2D.xy(0));
-      WriteBinaryLittleEndian<double>(&file, point2D.xy(1));
-      WriteBinaryLittleEndian<point3D_t>(&file, point2D.point3D_id);
-    }
-  }
+  THROW_CHECK(file.good()) << "Failed to write " << path;
 }
 
 void WritePoints3DBinary(const Reconstruction& reconstruction,
-                         const std::string& path) {
+                         const std::string& path,
+                         const int num_threads) {
   std::ofstream file(path, std::ios::trunc | std::ios::binary);
   THROW_CHECK_FILE_OPEN(file, path);
 
   WriteBinaryLittleEndian<uint64_t>(&file, reconstruction.NumPoints3D());
 
+  std::vector<std::pair<point3D_t, const struct Point3D*>> points3D;
+  points3D.reserve(reconstruction.NumPoints3D());
   for (const auto& point3D : reconstruction.Points3D()) {
-    WriteBinaryLittleEndian<point3D_t>(&file, point3D.first);
-    WriteBinaryLittleEndian<double>(&file, point3D.second.xyz(0));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.xyz(1));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.xyz(2));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.color(0));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.color(1));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.color(2));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.error);
-
-    WriteBinaryLittleEndian<uint64_t>(&file, point3D.second.track.Length());
-    for (const auto& track_el : point3D.second.track.Elements()) {
-      WriteBinaryLittleEndian<image_t>(&file, track_el.image_id);
-      WriteBinaryLittleEndian<point2D_t>(&file, track_el.point2D_idx);
+    points3D.emplace_back(point3D.first, &point3D.second);
+  }
+
+  WriteRecords(
+      points3D,
+      num_threads,
+      &file,
+      [](const std::pair<point3D_t, const struct Point3D*>& record,
+         BinaryBufferWriter* writer) {
+        const struct Point3D& point3D = *record.second;
+        writer->Write<point3D_t>(record.first);
+        writer->Write<double>(point3D.xyz(0));
+        writer->Write<double>(point3D.xyz(1));
+        writer->Write<double>(point3D.xyz(2));
+        writer->Write<uint8_t>(point3D.color(0));
+        writer->Write<uint8_t>(point3D.color(1));
+        writer->Write<uint8_t>(point3D.color(2));
+        writer->Write<double>(point3D.error);
+
+        writer->Write<uint64_t>(point3D.track.Length());
+        for (const auto& track_el : point3D.track.Elements()) {
+          writer->Write<image_t>(track_el.image_id);
+          writer->Write<point2D_t>(track_el.point2D_idx);
+        }
+      });
+
+  THROW_CHECK(file.good()) << "Failed to write " << path;
+}
+
+std::pair<Eigen::Vector3d, Eigen::Vector3d> ComputePoints3DBoundingBoxBinary(
+    const std::string& path,
+    const double p0,
+    const double p1,
+    const int num_threads) {
+  THROW_CHECK_GE(p0, 0);
+  THROW_CHECK_LE(p0, 1);
+  THROW_CHECK_GE(p1, 0);
+  THROW_CHECK_LE(p1, 1);
+  THROW_CHECK_LE(p0, p1);
+
+  const MappedFile file(path);
+  const std::vector<size_t> offsets = IndexPoints3DBinary(file);
+  const size_t num_points3D = offsets.size() - 1;
+  if (num_points3D == 0) {
+    return std::make_pair(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  }
+
+  std::vector<float> coords[3];
+  for (int d = 0; d < 3; ++d) {
+    coords[d].resize(num_points3D);
+  }
+  ParallelForChunks(num_threads,
+                    num_points3D,
+                    kNumRecordsPerChunk,
+                    [&](const size_t begin, const size_t end) {
+                      for (size_t i = begin; i < end; ++i) {
+                        BinaryBufferReader reader(file.Data() + offsets[i],
+                                                  offsets[i + 1] - offsets[i],
+                                                  path);
+                        reader.Skip(sizeof(point3D_t));
+                        for (int d = 0; d < 3; ++d) {
+                          coords[d][i] = reader.Read<double>();
+                        }
+                      }
+                    });
+
+  const size_t P0 =
+      static_cast<size_t>((num_points3D > 3) ? p0 * (num_points3D - 1) : 0);
+  const size_t P1 = static_cast<size_t>(
+      (num_points3D > 3) ? p1 * (num_points3D - 1) : num_points3D - 1);
+
+  std::pair<Eigen::Vector3d, Eigen::Vector3d> bbox;
+  for (int d = 0; d < 3; ++d) {
+    std::nth_element(
+        coords[d].begin(), coords[d].begin() + P0, coords[d].end());
+    if (P1 > P0) {
+      std::nth_element(
+          coords[d].begin() + P0 + 1, coords[d].begin() + P1, coords[d].end());
     }
+    bbox.first(d) = coords[d][P0];
+    bbox.second(d) = coords[d][P1];
   }
+  return bbox;
+}
+
+std::vector<CroppedReconstructionSummary> CropReconstructionBinary(
+    const std::string& input_path,
+    const std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>>& bboxes,
+    const std::vector<std::string>& output_paths,
+    const int num_threads) {
+  THROW_CHECK_EQ(bboxes.size(), output_paths.size());
+  const size_t num_bboxes = bboxes.size();
+  std::vector<CroppedReconstructionSummary> summaries(num_bboxes);
+  if (num_bboxes == 0) {
+    return summaries;
+  }
+
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_eff_threads > 1) {
+    thread_pool = std::make_unique<ThreadPool>(num_eff_threads);
+  }
+
+  // The sorted identifiers of the cropped 3D points and the identifiers of
+  // the images observing them, which are registered in the cropped
+  // reconstructions.
+  std::vector<std::vector<point3D_t>> point3D_ids(num_bboxes);
+  std::vector<std::unordered_set<image_t>> image_ids(num_bboxes);
+
+  {
+    const std::string path = JoinPaths(input_path, "points3D.bin");
+    const MappedFile file(path);
+    const std::vector<size_t> offsets = IndexPoints3DBinary(file);
+    const size_t num_points3D = offsets.size() - 1;
+
+    std::vector<std::string> output_points3D_paths(num_bboxes);
+    for (size_t bbox_idx = 0; bbox_idx < num_bboxes; ++bbox_idx) {
+      output_points3D_paths[bbox_idx] =
+          JoinPaths(output_paths[bbox_idx], "points3D.bin");
+      std::ofstream output(output_points3D_paths[bbox_idx],
+                           std::ios::trunc | std::ios::binary);
+      THROW_CHECK_FILE_OPEN(output, output_points3D_paths[bbox_idx]);
+      // The number of 3D points is updated after streaming all 3D points.
+      WriteBinaryLittleEndian<uint64_t>(&output, 0);
+    }
+
+    const BoundingBoxGrid grid(bboxes);
+
+    // The 3D points are processed in batches, which bounds the memory of the
+    // bucketed records independent of the size of the reconstruction.
+    const size_t num_points3D_per_batch =
+        kMaxNumBufferedChunks * kNumRecordsPerChunk;
+    std::vector<std::vector<std::pair<int, size_t>>> chunk_records;
+    std::vector<std::vector<size_t>> bbox_records(num_bboxes);
+    for (size_t batch_begin = 0; batch_begin < num_points3D;
+         batch_begin += num_points3D_per_batch) {
+      const size_t batch_end =
+          std::min(batch_begin + num_points3D_per_batch, num_points3D);
+
+      // Bucket the 3D points into the bounding boxes in parallel.
+      chunk_records.resize((batch_end - batch_begin + kNumRecordsPerChunk - 1) /
+                           kNumRecordsPerChunk);
+      ParallelForChunks(
+          thread_pool.get(),
+          chunk_records.size(),
+          1,
+          [&](const size_t begin, const size_t end) {
+            std::vector<int> bbox_idxs;
+            for (size_t chunk_idx = begin; chunk_idx < end; ++chunk_idx) {
+              std::vector<std::pair<int, size_t>>& records =
+                  chunk_records[chunk_idx];
+              records.clear();
+              const size_t records_begin =
+                  batch_begin + chunk_idx * kNumRecordsPerChunk;
+              const size_t records_end =
+                  std::min(records_begin + kNumRecordsPerChunk, batch_end);
+              for (size_t i = records_begin; i < records_end; ++i) {
+                BinaryBufferReader reader(file.Data() + offsets[i],
+                                          offsets[i + 1] - offsets[i],
+                                          path);
+                reader.Skip(sizeof(point3D_t));
+                Eigen::Vector3d xyz;
+                xyz(0) = reader.Read<double>();
+                xyz(1) = reader.Read<double>();
+                xyz(2) = reader.Read<double>();
+                grid.Find(xyz, &bbox_idxs);
+                for (const int bbox_idx : bbox_idxs) {
+                  records.emplace_back(bbox_idx, i);
+                }
+              }
+            }
+          });
+
+      for (std::vector<size_t>& records : bbox_records) {
+        records.clear();
+      }
+      for (const auto& records : chunk_records) {
+        for (const auto& [bbox_idx, i] : records) {
+          bbox_records[bbox_idx].push_back(i);
+        }
+      }
+
+      // Append the records to the output files of the bounding boxes in
+      // parallel, where every output file is written by a single task.
+      ParallelForChunks(
+          thread_pool.get(),
+          num_bboxes,
+          1,
+          [&](const size_t begin, const size_t end) {
+            for (size_t bbox_idx = begin; bbox_idx < end; ++bbox_idx) {
+              if (bbox_records[bbox_idx].empty()) {
+                continue;
+              }
+              const std::string& output_path = output_points3D_paths[bbox_idx];
+              std::ofstream output(output_path,
+                                   std::ios::app | std::ios::binary);
+              THROW_CHECK_FILE_OPEN(output, output_path);
+              CroppedReconstructionSummary& summary = summaries[bbox_idx];
+              for (const size_t i : bbox_records[bbox_idx]) {
+                const size_t num_bytes = offsets[i + 1] - offsets[i];
+                output.write(file.Data() + offsets[i], num_bytes);
+
+                BinaryBufferReader reader(
+                    file.Data() + offsets[i], num_bytes, path);
+                point3D_ids[bbox_idx].push_back(reader.Read<point3D_t>());
+                Eigen::Vector3d xyz;
+                xyz(0) = reader.Read<double>();
+                xyz(1) = reader.Read<double>();
+                xyz(2) = reader.Read<double>();
+                reader.Skip(3 * sizeof(uint8_t) + sizeof(double));
+                const size_t track_length = reader.Read<uint64_t>();
+                for (size_t j = 0; j < track_length; ++j) {
+                  image_ids[bbox_idx].insert(reader.Read<image_t>());
+                  reader.Skip(sizeof(point2D_t));
+                }
+
+                if (summary.num_points3D == 0) {
+                  summary.bbox = std::make_pair(xyz, xyz);
+                } else {
+                  summary.bbox.first = summary.bbox.first.cwiseMin(xyz);
+                  summary.bbox.second = summary.bbox.second.cwiseMax(xyz);
+                }
+                ++summary.num_points3D;
+              }
+              THROW_CHECK(output.good()) << "Failed to write " << output_path;
+            }
+          });
+    }
+
+    ParallelForChunks(
+        thread_pool.get(),
+        num_bboxes,
+        1,
+        [&](const size_t begin, const size_t end) {
+          for (size_t bbox_idx = begin; bbox_idx < end; ++bbox_idx) {
+            std::sort(point3D_ids[bbox_idx].begin(),
+                      point3D_ids[bbox_idx].end());
+            summaries[bbox_idx].num_reg_images = image_ids[bbox_idx].size();
+            const std::string& output_path = output_points3D_paths[bbox_idx];
+            std::fstream output(
+                output_path, std::ios::in | std::ios::out | std::ios::binary);
+            THROW_CHECK_FILE_OPEN(output, output_path);
+            output.seekp(0);
+            WriteBinaryLittleEndian<uint64_t>(
+                &output, summaries[bbox_idx].num_points3D);
+            THROW_CHECK(output.good()) << "Failed to write " << output_path;
+          }
+        });
+  }
+
+  {
+    const std::string path = JoinPaths(input_path, "images.bin");
+    const MappedFile file(path);
+    const std::vector<size_t> offsets = IndexImagesBinary(file);
+    const size_t num_images = offsets.size() - 1;
+
+    std::unordered_map<image_t, std::vector<int>> image_bbox_idxs;
+    for (size_t bbox_idx = 0; bbox_idx < num_bboxes; ++bbox_idx) {
+      for (const image_t image_id : image_ids[bbox_idx]) {
+        image_bbox_idxs[image_id].push_back(bbox_idx);
+      }
+    }
+
+    std::vector<std::vector<size_t>> bbox_records(num_bboxes);
+    for (size_t i = 0; i < num_images; ++i) {
+      BinaryBufferReader reader(
+          file.Data() + offsets[i], offsets[i + 1] - offsets[i], path);
+      const auto it = image_bbox_idxs.find(reader.Read<image_t>());
+      if (it != image_bbox_idxs.end()) {
+        for (const int bbox_idx : it->second) {
+          bbox_records[bbox_idx].push_back(i);
+        }
+      }
+    }
+
+    // Write the images of every bounding box in parallel, where observations
+    // of 3D points outside of the bounding box are reset.
+    ParallelForChunks(
+        thread_pool.get(),
+        num_bboxes,
+        1,
+        [&](const size_t begin, const size_t end) {
+          for (size_t bbox_idx = begin; bbox_idx < end; ++bbox_idx) {
+            const std::string output_path =
+                JoinPaths(output_paths[bbox_idx], "images.bin");
+            std::ofstream output(output_path,
+                                 std::ios::trunc | std::ios::binary);
+            THROW_CHECK_FILE_OPEN(output, output_path);
+            WriteBinaryLittleEndian<uint64_t>(&output,
+                                              bbox_records[bbox_idx].size());
+
+            const std::vector<point3D_t>& bbox_point3D_ids =
+                point3D_ids[bbox_idx];
+            BinaryBufferWriter writer;
+            for (const size_t i : bbox_records[bbox_idx]) {
+              const char* data = file.Data() + offsets[i];
+              BinaryBufferReader reader(
+                  data, offsets[i + 1] - offsets[i], path);
+              reader.Skip(sizeof(image_t) + 7 * sizeof(double) +
+                          sizeof(camera_t));
+              reader.ReadString();
+              const size_t num_points2D = reader.Read<uint64_t>();
+              writer.Data().assign(data, reader.Offset());
+              for (size_t j = 0; j < num_points2D; ++j) {
+                writer.Data().append(data + reader.Offset(),
+                                     2 * sizeof(double));
+                reader.Skip(2 * sizeof(double));
+                const point3D_t point3D_id = reader.Read<point3D_t>();
+                writer.Write<point3D_t>(
+                    std::binary_search(bbox_point3D_ids.begin(),
+                                       bbox_point3D_ids.end(),
+                                       point3D_id)
+                        ? point3D_id
+                        : kInvalidPoint3DId);
+              }
+              output.write(writer.Data().data(), writer.Data().size());
+            }
+            THROW_CHECK(output.good()) << "Failed to write " << output_path;
+          }
+        });
+  }
+
+  // All cameras are kept, as in Reconstruction::Crop.
+  const std::string cameras_path = JoinPaths(input_path, "cameras.bin");
+  for (size_t bbox_idx = 0; bbox_idx < num_bboxes; ++bbox_idx) {
+    FileCopy(cameras_path, JoinPaths(output_paths[bbox_idx], "cameras.bin"));
+  }
+
+  return summaries;
 }
 
 bool ExportNVM(const Reconstruction& reconstruction,
@@ -964,6 +1576,27 @@ void ExportPLY(const Reconstruction& reconstruction, const std::string& path) {
   WriteBinaryPlyPoints(path, ply_points, kWriteNormal, kWriteRGB);
 }
 
+void ExportPLYOctree(const Reconstruction& reconstruction,
+                     const std::string& path,
+                     PlyOctreeOptions options) {
+  options.write_normal = false;
+  WritePlyOctree(
+      [&reconstruction](const std::function<void(const PlyPoint&)>& callback) {
+        for (const auto& point3D : reconstruction.Points3D()) {
+          PlyPoint ply_point;
+          ply_point.x = point3D.second.xyz(0);
+          ply_point.y = point3D.second.xyz(1);
+          ply_point.z = point3D.second.xyz(2);
+          ply_point.r = point3D.second.color(0);
+          ply_point.g = point3D.second.color(1);
+          ply_point.b = point3D.second.color(2);
+          callback(ply_point);
+        }
+      },
+      path,
+      options);
+}
+
 void ExportVRML(const Reconstruction& reconstruction,
                 const std::string& images_path,
                 const std::string& points3D_path,
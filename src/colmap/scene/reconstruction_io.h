@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/scene/reconstruction.h"
+#include "colmap/util/ply_octree.h"
 
 #include <Eigen/Core>
 
@@ -43,10 +44,16 @@ void ReadPoints3DText(Reconstruction& reconstruction, const std::string& path);
 
 void ReadCamerasBinary(Reconstruction& reconstruction, const std::string& path);
 
-void ReadImagesBinary(Reconstruction& reconstruction, const std::string& path);
+// The binary images and 3D points are read through a memory mapping of the
+// file. The record boundaries are indexed in a first pass and the records are
+// decoded in parallel using the given number of threads.
+void ReadImagesBinary(Reconstruction& reconstruction,
+                      const std::string& path,
+                      int num_threads = -1);
 
 void ReadPoints3DBinary(Reconstruction& reconstruction,
-                        const std::string& path);
+                        const std::string& path,
+                        int num_threads = -1);
 
 void WriteCamerasText(const Reconstruction& reconstruction,
                       const std::string& path);
@@ -60,11 +67,49 @@ void WritePoints3DText(const Reconstruction& reconstruction,
 void WriteCamerasBinary(const Reconstruction& reconstruction,
                         const std::string& path);
 
+// The binary images and 3D points are serialized in parallel into buffers of
+// consecutive records, which are written in order, such that the files are
+// identical for any number of threads.
 void WriteImagesBinary(const Reconstruction& reconstruction,
-                       const std::string& path);
+                       const std::string& path,
+                       int num_threads = -1);
 
 void WritePoints3DBinary(const Reconstruction& reconstruction,
-                         const std::string& path);
+                         const std::string& path,
+                         int num_threads = -1);
+
+// Compute the bounding box of the 3D points in a binary points3D file as in
+// Reconstruction::ComputeBoundingBox, decoding only their positions.
+std::pair<Eigen::Vector3d, Eigen::Vector3d> ComputePoints3DBoundingBoxBinary(
+    const std::string& path,
+    double p0 = 0.0,
+    double p1 = 1.0,
+    int num_threads = -1);
+
+struct CroppedReconstructionSummary {
+  size_t num_reg_images = 0;
+  size_t num_points3D = 0;
+  // Bounding box of the 3D points in the cropped reconstruction, which is
+  // zero if it has no 3D points.
+  std::pair<Eigen::Vector3d, Eigen::Vector3d> bbox =
+      std::make_pair(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+};
+
+// Crop the binary reconstruction in the input directory to each of the
+// bounding boxes and write the cropped reconstructions in the binary format to
+// the corresponding, existing output directories. The result is the same as
+// for Reconstruction::Crop followed by Write, except that the identifiers and
+// errors of the 3D points are preserved. Instead of loading the reconstruction,
+// the 3D points are streamed once through a memory mapping, bucketed into the
+// bounding boxes on a uniform grid, and appended to the output files of the
+// bounding boxes in parallel. Afterwards, the images are streamed once and the
+// observations of cropped 3D points are reset. Memory is proportional to the
+// number of cropped 3D points instead of the size of the reconstruction.
+std::vector<CroppedReconstructionSummary> CropReconstructionBinary(
+    const std::string& input_path,
+    const std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>>& bboxes,
+    const std::vector<std::string>& output_paths,
+    int num_threads = -1);
 
 // Exports in NVM format http://ccwu.me/vsfm/doc.html#nvm. Only supports
 // SIMPLE_RADIAL camera model when exporting distortion parameters. When
@@ -140,6 +185,12 @@ bool ExportBundler(const Reconstruction& reconstruction,
 // Exports 3D points only in PLY format.
 void ExportPLY(const Reconstruction& reconstruction, const std::string& path);
 
+// Exports 3D points only as a level-of-detail octree of PLY files to the given
+// directory, see `WritePlyOctree`.
+void ExportPLYOctree(const Reconstruction& reconstruction,
+                     const std::string& path,
+                     PlyOctreeOptions options = PlyOctreeOptions());
+
 // Exports in VRML format https://en.wikipedia.org/wiki/VRML.
 void ExportVRML(const Reconstruction& reconstruction,
                 const std::string& images_path,
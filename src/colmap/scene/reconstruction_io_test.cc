@@ -0,0 +1,203 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/reconstruction_io.h"
+
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/testing.h"
+
+#include <fstream>
+#include <iterator>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+std::string ReadFileContents(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+TEST(ReconstructionIO, ReadWriteBinaryParallel) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_options;
+  synthetic_options.num_images = 5;
+  synthetic_options.num_points3D = 10000;
+  SynthesizeDataset(synthetic_options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string images_path1 = test_dir + "/images1.bin";
+  const std::string images_path4 = test_dir + "/images4.bin";
+  const std::string points3D_path1 = test_dir + "/points3D1.bin";
+  const std::string points3D_path4 = test_dir + "/points3D4.bin";
+  WriteImagesBinary(reconstruction, images_path1, /*num_threads=*/1);
+  WriteImagesBinary(reconstruction, images_path4, /*num_threads=*/4);
+  WritePoints3DBinary(reconstruction, points3D_path1, /*num_threads=*/1);
+  WritePoints3DBinary(reconstruction, points3D_path4, /*num_threads=*/4);
+  EXPECT_EQ(ReadFileContents(images_path1), ReadFileContents(images_path4));
+  EXPECT_EQ(ReadFileContents(points3D_path1),
+            ReadFileContents(points3D_path4));
+
+  for (const int num_threads : {1, 4}) {
+    Reconstruction read_reconstruction;
+    for (const auto& camera : reconstruction.Cameras()) {
+      read_reconstruction.AddCamera(camera.second);
+    }
+    ReadImagesBinary(read_reconstruction, images_path1, num_threads);
+    ReadPoints3DBinary(read_reconstruction, points3D_path1, num_threads);
+
+    EXPECT_EQ(read_reconstruction.NumRegImages(),
+              reconstruction.NumRegImages());
+    for (const auto& [image_id, image] : reconstruction.Images()) {
+      const Image& read_image = read_reconstruction.Image(image_id);
+      EXPECT_EQ(read_image.Name(), image.Name());
+      EXPECT_EQ(read_image.CameraId(), image.CameraId());
+      EXPECT_EQ(read_image.CamFromWorld().translation,
+                image.CamFromWorld().translation);
+      EXPECT_EQ(read_image.NumPoints3D(), image.NumPoints3D());
+      ASSERT_EQ(read_image.NumPoints2D(), image.NumPoints2D());
+      for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+           ++point2D_idx) {
+        EXPECT_EQ(read_image.Point2D(point2D_idx).xy,
+                  image.Point2D(point2D_idx).xy);
+        EXPECT_EQ(read_image.Point2D(point2D_idx).point3D_id,
+                  image.Point2D(point2D_idx).point3D_id);
+      }
+    }
+
+    EXPECT_EQ(read_reconstruction.NumPoints3D(), reconstruction.NumPoints3D());
+    for (const auto& [point3D_id, point3D] : reconstruction.Points3D()) {
+      const Point3D& read_point3D = read_reconstruction.Point3D(point3D_id);
+      EXPECT_EQ(read_point3D.xyz, point3D.xyz);
+      EXPECT_EQ(read_point3D.color, point3D.color);
+      EXPECT_EQ(read_point3D.error, point3D.error);
+      EXPECT_EQ(read_point3D.track.Length(), point3D.track.Length());
+    }
+  }
+}
+
+TEST(ReconstructionIO, ReadTruncatedBinary) {
+  Reconstruction reconstruction;
+  SynthesizeDataset(SyntheticDatasetOptions(), &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string path = test_dir + "/points3D.bin";
+  WritePoints3DBinary(reconstruction, path);
+  const std::string contents = ReadFileContents(path);
+  const std::string truncated_path = test_dir + "/points3D_truncated.bin";
+  std::ofstream(truncated_path, std::ios::binary)
+      << contents.substr(0, contents.size() - 1);
+
+  Reconstruction read_reconstruction;
+  EXPECT_ANY_THROW(ReadPoints3DBinary(read_reconstruction, truncated_path));
+}
+
+TEST(ReconstructionIO, ComputePoints3DBoundingBoxBinary) {
+  Reconstruction reconstruction;
+  SynthesizeDataset(SyntheticDatasetOptions(), &reconstruction);
+
+  const std::string path = CreateTestDir() + "/points3D.bin";
+  WritePoints3DBinary(reconstruction, path);
+  EXPECT_EQ(ComputePoints3DBoundingBoxBinary(path),
+            reconstruction.ComputeBoundingBox());
+  EXPECT_EQ(ComputePoints3DBoundingBoxBinary(path, 0.1, 0.9),
+            reconstruction.ComputeBoundingBox(0.1, 0.9));
+}
+
+TEST(ReconstructionIO, CropReconstructionBinary) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_options;
+  synthetic_options.num_images = 10;
+  synthetic_options.num_points3D = 2000;
+  SynthesizeDataset(synthetic_options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string input_path = test_dir + "/input";
+  CreateDirIfNotExists(input_path);
+  reconstruction.WriteBinary(input_path);
+
+  // Two overlapping halves and one box without any 3D points.
+  const auto bbox = reconstruction.ComputeBoundingBox();
+  const double center_x = 0.5 * (bbox.first.x() + bbox.second.x());
+  const double overlap = 0.1 * (bbox.second.x() - bbox.first.x());
+  Eigen::Vector3d max1 = bbox.second;
+  max1.x() = center_x + overlap;
+  Eigen::Vector3d min2 = bbox.first;
+  min2.x() = center_x - overlap;
+  const std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> bboxes = {
+      {bbox.first, max1},
+      {min2, bbox.second},
+      {bbox.second + Eigen::Vector3d::Ones(),
+       bbox.second + 2 * Eigen::Vector3d::Ones()}};
+  std::vector<std::string> output_paths;
+  for (size_t i = 0; i < bboxes.size(); ++i) {
+    output_paths.push_back(test_dir + "/output" + std::to_string(i));
+    CreateDirIfNotExists(output_paths.back());
+  }
+
+  const std::vector<CroppedReconstructionSummary> summaries =
+      CropReconstructionBinary(
+          input_path, bboxes, output_paths, /*num_threads=*/4);
+  ASSERT_EQ(summaries.size(), bboxes.size());
+
+  for (size_t i = 0; i < bboxes.size(); ++i) {
+    const Reconstruction expected = reconstruction.Crop(bboxes[i]);
+    Reconstruction cropped;
+    cropped.ReadBinary(output_paths[i]);
+    EXPECT_EQ(summaries[i].num_reg_images, expected.NumRegImages());
+    EXPECT_EQ(summaries[i].num_points3D, expected.NumPoints3D());
+    EXPECT_EQ(cropped.NumCameras(), expected.NumCameras());
+    EXPECT_EQ(cropped.NumRegImages(), expected.NumRegImages());
+    EXPECT_EQ(cropped.NumPoints3D(), expected.NumPoints3D());
+    if (expected.NumPoints3D() > 0) {
+      EXPECT_TRUE(summaries[i].bbox.first.isApprox(
+          expected.ComputeBoundingBox().first, 1e-6));
+      EXPECT_TRUE(summaries[i].bbox.second.isApprox(
+          expected.ComputeBoundingBox().second, 1e-6));
+    }
+    for (const auto& [point3D_id, point3D] : cropped.Points3D()) {
+      EXPECT_EQ(point3D.xyz, reconstruction.Point3D(point3D_id).xyz);
+      EXPECT_EQ(point3D.track.Length(),
+                reconstruction.Point3D(point3D_id).track.Length());
+    }
+    for (const image_t image_id : cropped.RegImageIds()) {
+      EXPECT_EQ(cropped.Image(image_id).NumPoints3D(),
+                expected.Image(image_id).NumPoints3D());
+    }
+  }
+  EXPECT_GT(summaries[0].num_points3D, 0);
+  EXPECT_GT(summaries[1].num_points3D, 0);
+  EXPECT_EQ(summaries[2].num_points3D, 0);
+}
+
+}  // namespace
+}  // namespace colmap
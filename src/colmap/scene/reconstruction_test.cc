@@ -31,7 +31,12 @@
 
 #include "colmap/geometry/pose.h"
 #include "colmap/geometry/sim3.h"
+#include "colmap/sensor/bitmap.h"
 #include "colmap/sensor/models.h"
+#include "colmap/util/testing.h"
+
+#include <numeric>
+#include <random>
 
 #include <gtest/gtest.h>
 
@@ -112,6 +117,20 @@ TEST(Reconstruction, AddPoint3D) {
   EXPECT_EQ(reconstruction.Point3DIds().count(point3D_id), 1);
 }
 
+TEST(Reconstruction, NumBytes) {
+  Reconstruction reconstruction;
+  const size_t empty_num_bytes = reconstruction.NumBytes();
+  GenerateReconstruction(3, &reconstruction);
+  const size_t num_bytes = reconstruction.NumBytes();
+  EXPECT_GT(num_bytes, empty_num_bytes);
+  Track track;
+  for (image_t image_id = 1; image_id <= 3; ++image_id) {
+    track.AddElement(image_id, 0);
+  }
+  reconstruction.AddPoint3D(Eigen::Vector3d::Random(), track);
+  EXPECT_GE(reconstruction.NumBytes(), num_bytes + 3 * sizeof(TrackElement));
+}
+
 TEST(Reconstruction, AddObservation) {
   Reconstruction reconstruction;
   GenerateReconstruction(3, &reconstruction);
@@ -304,6 +323,53 @@ TEST(Reconstruction, ComputeBoundsAndCentroid) {
   EXPECT_LT(std::abs(bbox.second(2) - 3.0), 1e-6);
 }
 
+TEST(Reconstruction, ComputeStatistics) {
+  Reconstruction reconstruction;
+  ReconstructionStatistics statistics = reconstruction.ComputeStatistics();
+  EXPECT_EQ(statistics.num_observations, 0);
+  EXPECT_EQ(statistics.mean_track_length, 0);
+  EXPECT_EQ(statistics.mean_reprojection_error, 0);
+  EXPECT_EQ(statistics.centroid, Eigen::Vector3d::Zero());
+
+  // Enough points for multiple chunks in a shuffled order.
+  GenerateReconstruction(2, &reconstruction);
+  const int kNumPoints3D = 100000;
+  std::vector<int> order(kNumPoints3D);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(42));
+  for (const int i : order) {
+    const point3D_t point3D_id =
+        reconstruction.AddPoint3D(Eigen::Vector3d(i, -i, 2 * i), Track());
+    if (i < 10) {
+      reconstruction.AddObservation(point3D_id, TrackElement(1, i));
+      reconstruction.AddObservation(point3D_id, TrackElement(2, i));
+      reconstruction.Point3D(point3D_id).error = i;
+    }
+  }
+
+  statistics = reconstruction.ComputeStatistics(0.1, 0.9);
+  EXPECT_EQ(statistics.num_observations,
+            reconstruction.ComputeNumObservations());
+  EXPECT_EQ(statistics.mean_track_length,
+            reconstruction.ComputeMeanTrackLength());
+  EXPECT_EQ(statistics.mean_observations_per_reg_image,
+            reconstruction.ComputeMeanObservationsPerRegImage());
+  EXPECT_NEAR(statistics.mean_reprojection_error,
+              reconstruction.ComputeMeanReprojectionError(),
+              1e-12);
+
+  // The percentiles match those of the sorted coordinates.
+  const int P0 = static_cast<int>(0.1 * (kNumPoints3D - 1));
+  const int P1 = static_cast<int>(0.9 * (kNumPoints3D - 1));
+  EXPECT_EQ(statistics.bbox_min, Eigen::Vector3d(P0, -P1, 2 * P0));
+  EXPECT_EQ(statistics.bbox_max, Eigen::Vector3d(P1, -P0, 2 * P1));
+  const double mean = 0.5 * (P0 + P1);
+  EXPECT_TRUE(statistics.centroid.isApprox(
+      Eigen::Vector3d(mean, -mean, 2 * mean), 1e-9));
+  EXPECT_TRUE(statistics.centroid.isApprox(
+      reconstruction.ComputeCentroid(0.1, 0.9), 1e-9));
+}
+
 TEST(Reconstruction, Crop) {
   Reconstruction reconstruction;
   GenerateReconstruction(3, &reconstruction);
@@ -467,5 +533,33 @@ TEST(Reconstruction, UpdatePoint3DErrors) {
   EXPECT_EQ(reconstruction.Point3D(point3D_id).error, 1);
 }
 
+TEST(Reconstruction, ExtractColorsForAllImages) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, &reconstruction);
+  const std::string test_dir = CreateTestDir();
+  for (image_t image_id = 1; image_id <= 2; ++image_id) {
+    Bitmap bitmap;
+    bitmap.Allocate(8, 8, /*as_rgb=*/true);
+    const uint8_t value = 100 * image_id;
+    bitmap.Fill(BitmapColor<uint8_t>(value, value, value));
+    class Image& image = reconstruction.Image(image_id);
+    image.SetName(image.Name() + ".png");
+    ASSERT_TRUE(bitmap.Write(JoinPaths(test_dir, image.Name())));
+    image.Point2D(0).xy = Eigen::Vector2d(4, 4);
+  }
+  Track track;
+  track.AddElement(1, 0);
+  track.AddElement(2, 0);
+  const point3D_t point3D_id1 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(0, 0, 1), track);
+  const point3D_t point3D_id2 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(0, 0, 1), Track());
+  reconstruction.ExtractColorsForAllImages(test_dir, /*num_threads=*/2);
+  EXPECT_EQ(reconstruction.Point3D(point3D_id1).color,
+            Eigen::Vector3ub(150, 150, 150));
+  EXPECT_EQ(reconstruction.Point3D(point3D_id2).color,
+            Eigen::Vector3ub::Zero());
+}
+
 }  // namespace
 }  // namespace colmap
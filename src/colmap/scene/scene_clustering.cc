@@ -31,14 +31,50 @@
 
 #include "colmap/math/graph_cut.h"
 #include "colmap/math/random.h"
+#include "colmap/util/threading.h"
 
 #include <set>
 
 namespace colmap {
+namespace {
+
+// Select the images of other clusters with the most inlier matches to the
+// images of the cluster with the given label.
+std::set<int> SelectOverlappingImageIds(
+    std::vector<std::pair<std::pair<int, int>, int>>* overlapping_edges,
+    const std::unordered_map<int, int>& labels,
+    const int label,
+    const size_t max_num_images) {
+  // Sort the overlapping edges by the number of inlier matches, such
+  // that we add overlapping images with many common observations.
+  std::sort(overlapping_edges->begin(),
+            overlapping_edges->end(),
+            [](const std::pair<std::pair<int, int>, int>& edge1,
+               const std::pair<std::pair<int, int>, int>& edge2) {
+              return edge1.second > edge2.second;
+            });
+
+  std::set<int> overlapping_image_ids;
+  for (const auto& edge : *overlapping_edges) {
+    if (overlapping_image_ids.size() >= max_num_images) {
+      break;
+    }
+    if (labels.at(edge.first.first) == label) {
+      overlapping_image_ids.insert(edge.first.second);
+    } else {
+      overlapping_image_ids.insert(edge.first.first);
+    }
+  }
+
+  return overlapping_image_ids;
+}
+
+}  // namespace
 
 bool SceneClustering::Options::Check() const {
   CHECK_OPTION_GT(branching, 0);
   CHECK_OPTION_GE(image_overlap, 0);
+  CHECK_OPTION_GT(leaf_max_num_images, 0);
   return true;
 }
 
@@ -65,7 +101,11 @@ void SceneClustering::Partition(
   root_cluster_->image_ids.insert(
       root_cluster_->image_ids.end(), image_ids.begin(), image_ids.end());
   if (options_.is_hierarchical) {
-    PartitionHierarchicalCluster(edges, num_inliers, root_cluster_.get());
+    if (options_.partitioner == Partitioner::MULTILEVEL) {
+      PartitionMultilevelCluster(edges, num_inliers);
+    } else {
+      PartitionHierarchicalCluster(edges, num_inliers, root_cluster_.get());
+    }
   } else {
     PartitionFlatCluster(edges, num_inliers);
   }
@@ -152,28 +192,11 @@ void SceneClustering::PartitionHierarchicalCluster(
 
   if (options_.image_overlap > 0) {
     for (int i = 0; i < options_.branching; ++i) {
-      // Sort the overlapping edges by the number of inlier matches, such
-      // that we add overlapping images with many common observations.
-      std::sort(overlapping_edges[i].begin(),
-                overlapping_edges[i].end(),
-                [](const std::pair<std::pair<int, int>, int>& edge1,
-                   const std::pair<std::pair<int, int>, int>& edge2) {
-                  return edge1.second > edge2.second;
-                });
-
-      // Select overlapping edges at random and add image to cluster.
-      std::set<int> overlapping_image_ids;
-      for (const auto& edge : overlapping_edges[i]) {
-        if (labels.at(edge.first.first) == i) {
-          overlapping_image_ids.insert(edge.first.second);
-        } else {
-          overlapping_image_ids.insert(edge.first.first);
-        }
-        if (overlapping_image_ids.size() >=
-            static_cast<size_t>(options_.image_overlap)) {
-          break;
-        }
-      }
+      const std::set<int> overlapping_image_ids =
+          SelectOverlappingImageIds(&overlapping_edges[i],
+                                    labels,
+                                    i,
+                                    options_.image_overlap);
 
       // Recursively append the overlapping images to cluster and its children.
       std::function<void(Cluster*)> InsertOverlappingImageIds =
@@ -191,14 +214,77 @@ void SceneClustering::PartitionHierarchicalCluster(
   }
 }
 
+void SceneClustering::PartitionMultilevelCluster(
+    const std::vector<std::pair<int, int>>& edges,
+    const std::vector<int>& weights) {
+  THROW_CHECK_EQ(edges.size(), weights.size());
+
+  const int num_parts =
+      (root_cluster_->image_ids.size() + options_.leaf_max_num_images - 1) /
+      options_.leaf_max_num_images;
+  if (edges.empty() || num_parts <= 1) {
+    return;
+  }
+
+  // Partition the scene graph directly into the leaf clusters.
+  const auto labels = ComputeLabels(edges, weights, num_parts);
+
+  root_cluster_->child_clusters.resize(num_parts);
+  for (const auto image_id : root_cluster_->image_ids) {
+    root_cluster_->child_clusters.at(labels.at(image_id))
+        .image_ids.push_back(image_id);
+  }
+
+  if (options_.image_overlap > 0) {
+    std::vector<std::vector<std::pair<std::pair<int, int>, int>>>
+        overlapping_edges(num_parts);
+    for (size_t i = 0; i < edges.size(); ++i) {
+      const int label1 = labels.at(edges[i].first);
+      const int label2 = labels.at(edges[i].second);
+      if (label1 != label2) {
+        overlapping_edges[label1].emplace_back(edges[i], weights[i]);
+        overlapping_edges[label2].emplace_back(edges[i], weights[i]);
+      }
+    }
+
+    // The overlapping images of every cluster are independent of the other
+    // clusters and selected in parallel.
+    ParallelForChunks(
+        options_.num_threads,
+        num_parts,
+        /*min_chunk_size=*/1,
+        [&](const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const std::set<int> overlapping_image_ids =
+                SelectOverlappingImageIds(&overlapping_edges[i],
+                                          labels,
+                                          i,
+                                          options_.image_overlap);
+            auto& image_ids = root_cluster_->child_clusters[i].image_ids;
+            image_ids.insert(image_ids.end(),
+                             overlapping_image_ids.begin(),
+                             overlapping_image_ids.end());
+          }
+        });
+  }
+
+  // Remove empty clusters.
+  root_cluster_->child_clusters.erase(
+      std::remove_if(root_cluster_->child_clusters.begin(),
+                     root_cluster_->child_clusters.end(),
+                     [](const Cluster& child_cluster) {
+                       return child_cluster.image_ids.empty();
+                     }),
+      root_cluster_->child_clusters.end());
+}
+
 void SceneClustering::PartitionFlatCluster(
     const std::vector<std::pair<int, int>>& edges,
     const std::vector<int>& weights) {
   THROW_CHECK_EQ(edges.size(), weights.size());
 
   // Partition the cluster using a normalized cut on the scene graph.
-  const auto labels =
-      ComputeNormalizedMinGraphCut(edges, weights, options_.branching);
+  const auto labels = ComputeLabels(edges, weights, options_.branching);
 
   // Assign the images to the clustered child clusters.
   root_cluster_->child_clusters.resize(options_.branching);
@@ -274,6 +360,21 @@ void SceneClustering::PartitionFlatCluster(
   }
 }
 
+std::unordered_map<int, int> SceneClustering::ComputeLabels(
+    const std::vector<std::pair<int, int>>& edges,
+    const std::vector<int>& weights,
+    const int num_parts) const {
+  switch (options_.partitioner) {
+    case Partitioner::NORMALIZED_CUT:
+      return ComputeNormalizedMinGraphCut(edges, weights, num_parts);
+    case Partitioner::MULTILEVEL:
+      return ComputeMultilevelGraphPartition(
+          edges, weights, num_parts, options_.num_threads);
+  }
+  LOG(FATAL_THROW) << "Unknown partitioner";
+  return {};
+}
+
 const SceneClustering::Cluster* SceneClustering::GetRootCluster() const {
   return root_cluster_.get();
 }
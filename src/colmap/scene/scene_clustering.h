@@ -33,6 +33,7 @@
 #include "colmap/util/types.h"
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace colmap {
@@ -42,6 +43,14 @@ namespace colmap {
 // number of images is in a leaf node.
 class SceneClustering {
  public:
+  enum class Partitioner {
+    // Recursive normalized cuts with the given branching factor using Metis.
+    NORMALIZED_CUT,
+    // A single parallel multilevel partition of the scene graph directly into
+    // the leaf clusters, which is much faster for large scene graphs.
+    MULTILEVEL,
+  };
+
   struct Options {
     // Flag for hierarchical vs flat clustering
     bool is_hierarchical = true;
@@ -61,6 +70,14 @@ class SceneClustering {
     // overlap` images to satisfy the overlap constraint.
     int leaf_max_num_images = 500;
 
+    // The graph partitioning method. For hierarchical clustering with the
+    // multilevel partitioner, the leaf clusters are the direct children of the
+    // root cluster and their overlapping images are selected in parallel.
+    Partitioner partitioner = Partitioner::NORMALIZED_CUT;
+
+    // The number of threads for the multilevel partitioner.
+    int num_threads = -1;
+
     bool Check() const;
   };
 
@@ -86,9 +103,18 @@ class SceneClustering {
       const std::vector<int>& weights,
       Cluster* cluster);
 
+  void PartitionMultilevelCluster(
+      const std::vector<std::pair<int, int>>& edges,
+      const std::vector<int>& weights);
+
   void PartitionFlatCluster(const std::vector<std::pair<int, int>>& edges,
                             const std::vector<int>& weights);
 
+  std::unordered_map<int, int> ComputeLabels(
+      const std::vector<std::pair<int, int>>& edges,
+      const std::vector<int>& weights,
+      int num_parts) const;
+
   const Options options_;
   std::unique_ptr<Cluster> root_cluster_;
 };
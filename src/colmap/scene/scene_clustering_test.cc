@@ -158,5 +158,29 @@ TEST(SceneClustering, ThreeFlatClustersTwoOverlap) {
   EXPECT_TRUE(image_ids2.count(5));
 }
 
+TEST(SceneClustering, ThreeMultilevelClustersTwoOverlap) {
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {0, 1}, {2, 3}, {4, 5}, {1, 2}, {3, 4}, {5, 0}, {0, 3}, {2, 5}, {4, 1}};
+  const std::vector<int> num_inliers = {100, 100, 100, 10, 10, 10, 1, 1, 1};
+  SceneClustering::Options options;
+  options.image_overlap = 2;
+  options.leaf_max_num_images = 2;
+  options.partitioner = SceneClustering::Partitioner::MULTILEVEL;
+  SceneClustering scene_clustering(options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+  EXPECT_EQ(scene_clustering.GetRootCluster()->image_ids.size(), 6);
+  EXPECT_EQ(scene_clustering.GetRootCluster()->child_clusters.size(), 3);
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+  ASSERT_EQ(leaf_clusters.size(), 3);
+  std::set<std::set<image_t>> leaf_image_ids;
+  for (const auto* leaf_cluster : leaf_clusters) {
+    leaf_image_ids.emplace(leaf_cluster->image_ids.begin(),
+                           leaf_cluster->image_ids.end());
+  }
+  const std::set<std::set<image_t>> expected_leaf_image_ids = {
+      {0, 1, 2, 5}, {1, 2, 3, 4}, {0, 3, 4, 5}};
+  EXPECT_EQ(leaf_image_ids, expected_leaf_image_ids);
+}
+
 }  // namespace
 }  // namespace colmap
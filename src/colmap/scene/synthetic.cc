@@ -31,9 +31,18 @@
 
 #include "colmap/geometry/essential_matrix.h"
 #include "colmap/geometry/pose.h"
+#include "colmap/math/math.h"
 #include "colmap/math/random.h"
 #include "colmap/scene/projection.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <random>
 
 #include <Eigen/Geometry>
 
@@ -43,14 +52,15 @@ namespace {
 void AddOutlierMatches(double inlier_ratio,
                        int num_points2D1,
                        int num_points2D2,
+                       std::mt19937& prng,
                        FeatureMatches* matches) {
   const int num_outliers = matches->size() * (1.0 - inlier_ratio);
   for (int i = 0; i < num_outliers; ++i) {
     matches->emplace_back(
-        RandomUniformInteger<point2D_t>(0, num_points2D1 - 1),
-        RandomUniformInteger<point2D_t>(0, num_points2D2 - 2));
+        std::uniform_int_distribution<point2D_t>(0, num_points2D1 - 1)(prng),
+        std::uniform_int_distribution<point2D_t>(0, num_points2D2 - 2)(prng));
   }
-  std::shuffle(matches->begin(), matches->end(), *PRNG);
+  std::shuffle(matches->begin(), matches->end(), prng);
 }
 
 void SynthesizeExhaustiveMatches(double inlier_match_ratio,
@@ -95,7 +105,7 @@ void SynthesizeExhaustiveMatches(double inlier_match_ratio,
 
       FeatureMatches matches = two_view_geometry.inlier_matches;
       AddOutlierMatches(
-          inlier_match_ratio, num_points2D1, num_points2D2, &matches);
+          inlier_match_ratio, num_points2D1, num_points2D2, *PRNG, &matches);
 
       database->WriteMatches(image1.ImageId(), image2.ImageId(), matches);
       database->WriteTwoViewGeometry(
@@ -109,7 +119,9 @@ void SynthesizeChainedMatches(double inlier_match_ratio,
                               Database* database) {
   std::unordered_map<image_pair_t, TwoViewGeometry> two_view_geometries;
   for (const auto& point3D : reconstruction->Points3D()) {
-    std::vector<TrackElement> track_elements = point3D.second.track.Elements();
+    std::vector<TrackElement> track_elements(
+        point3D.second.track.Elements().begin(),
+        point3D.second.track.Elements().end());
     std::shuffle(track_elements.begin(), track_elements.end(), *PRNG);
     for (size_t i = 1; i < track_elements.size(); ++i) {
       const auto& prev_track_el = track_elements[i - 1];
@@ -148,6 +160,7 @@ void SynthesizeChainedMatches(double inlier_match_ratio,
     AddOutlierMatches(inlier_match_ratio,
                       image1.NumPoints2D(),
                       image2.NumPoints2D(),
+                      *PRNG,
                       &matches);
 
     database->WriteMatches(image1.ImageId(), image2.ImageId(), matches);
@@ -156,6 +169,516 @@ void SynthesizeChainedMatches(double inlier_match_ratio,
   }
 }
 
+// Independent generator for one part of a streamed dataset, e.g., the 3D
+// points of an image, so that the part does not depend on the thread or on
+// the order in which it is synthesized.
+std::mt19937 StreamingPRNG(const unsigned seed,
+                           const uint64_t idx,
+                           const unsigned salt) {
+  std::seed_seq seed_seq{seed,
+                         static_cast<unsigned>(idx),
+                         static_cast<unsigned>(idx >> 32),
+                         salt};
+  return std::mt19937(seed_seq);
+}
+
+constexpr unsigned kStreamingLayoutSalt = 1;
+constexpr unsigned kStreamingPoseSalt = 2;
+constexpr unsigned kStreamingPoints3DSalt = 3;
+constexpr unsigned kStreamingPoints2DSalt = 4;
+constexpr unsigned kStreamingMatchesSalt = 5;
+
+struct StreamingPoint3D {
+  Eigen::Vector3d xyz;
+  Eigen::Vector3ub color;
+};
+
+struct StreamingImageObservations {
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<point3D_t> point3D_ids;
+  // The observed 3D points with their 2D point index sorted by 3D point id.
+  std::vector<std::pair<point3D_t, point2D_t>> sorted_points3D;
+};
+
+// Data of an image in the streaming window. The 3D points owned by the image
+// are synthesized once they are observed by the first image in the window.
+struct StreamingImage {
+  std::unique_ptr<std::vector<StreamingPoint3D>> points3D;
+  std::unique_ptr<StreamingImageObservations> observations;
+};
+
+// Scene of images at unit altitude looking down onto the terrain around zero
+// height. Every image owns the 3D points synthesized in its view, which are
+// regenerated on demand for the observations in the overlapping images.
+class StreamingScene {
+ public:
+  explicit StreamingScene(const StreamingSyntheticDatasetOptions& options)
+      : options_(options) {
+    for (int camera_idx = 0; camera_idx < options_.num_cameras; ++camera_idx) {
+      Camera camera;
+      camera.width = options_.camera_width;
+      camera.height = options_.camera_height;
+      camera.model_id = options_.camera_model_id;
+      camera.params = options_.camera_params;
+      THROW_CHECK(camera.VerifyParams());
+      camera.camera_id = camera_idx + 1;
+      cameras_.push_back(std::move(camera));
+    }
+    SynthesizeLayout();
+  }
+
+  std::vector<Camera>& Cameras() { return cameras_; }
+
+  const Camera& ImageCamera(const int image_idx) const {
+    return cameras_[image_idx % cameras_.size()];
+  }
+
+  const Rigid3d& CamFromWorld(const int image_idx) const {
+    return cams_from_world_[image_idx];
+  }
+
+  // Images whose views may overlap with the given image in ascending order.
+  const std::vector<int>& NeighborIdxs(const int image_idx) const {
+    return neighbor_idxs_[image_idx];
+  }
+
+  // Largest index of the given image and its neighbors.
+  int MaxNeighborIdx(const int image_idx) const {
+    return neighbor_idxs_[image_idx].empty()
+               ? image_idx
+               : std::max(image_idx, neighbor_idxs_[image_idx].back());
+  }
+
+  point3D_t Point3DId(const int image_idx, const int point3D_idx) const {
+    return static_cast<point3D_t>(image_idx) * options_.num_points3D_per_image +
+           point3D_idx + 1;
+  }
+
+  bool ProjectPoint(const int image_idx,
+                    const Eigen::Vector3d& xyz,
+                    Eigen::Vector2d* xy) const {
+    const Eigen::Vector3d point_in_cam = cams_from_world_[image_idx] * xyz;
+    if (point_in_cam.z() < std::numeric_limits<double>::epsilon()) {
+      return false;
+    }
+    const Camera& camera = ImageCamera(image_idx);
+    *xy = camera.ImgFromCam(point_in_cam.hnormalized());
+    return (*xy)(0) >= 0 && (*xy)(1) >= 0 && (*xy)(0) <= camera.width &&
+           (*xy)(1) <= camera.height;
+  }
+
+  // Synthesize the 3D points on the terrain in the view of the image.
+  std::vector<StreamingPoint3D> Points3D(const int image_idx) const {
+    std::mt19937 prng =
+        StreamingPRNG(options_.seed, image_idx, kStreamingPoints3DSalt);
+    const Camera& camera = ImageCamera(image_idx);
+    const Rigid3d world_from_cam = Inverse(cams_from_world_[image_idx]);
+    std::uniform_real_distribution<double> x_distribution(0, camera.width);
+    std::uniform_real_distribution<double> y_distribution(0, camera.height);
+    std::normal_distribution<double> height_distribution(
+        0, options_.terrain_height_stddev);
+    std::uniform_int_distribution<int> color_distribution(0, 255);
+    const double max_height = kMaxTerrainHeightStddevs *
+                               options_.terrain_height_stddev;
+
+    std::vector<StreamingPoint3D> points3D(options_.num_points3D_per_image);
+    for (auto& point3D : points3D) {
+      const Eigen::Vector2d xy(x_distribution(prng), y_distribution(prng));
+      const Eigen::Vector3d ray =
+          world_from_cam.rotation * camera.CamFromImg(xy).homogeneous();
+      const double height = std::clamp(
+          options_.terrain_height_stddev > 0 ? height_distribution(prng) : 0.0,
+          -max_height,
+          max_height);
+      point3D.xyz = world_from_cam.translation +
+                    (height - world_from_cam.translation.z()) / ray.z() * ray;
+      for (int i = 0; i < 3; ++i) {
+        point3D.color(i) = color_distribution(prng);
+      }
+    }
+    return points3D;
+  }
+
+  // Synthesize the 2D points of the image, which observe the 3D points of the
+  // image and of its neighbors. The 3D points that are not observed by any
+  // other image are kept as 2D points without 3D point.
+  // The 3D points of the image and its neighbors must be in the window.
+  StreamingImageObservations Observations(
+      const int image_idx, const std::vector<StreamingImage>& images) const {
+    std::mt19937 prng =
+        StreamingPRNG(options_.seed, image_idx, kStreamingPoints2DSalt);
+    std::normal_distribution<double> noise_distribution(
+        0, options_.point2D_stddev);
+
+    const std::vector<int>& neighbor_idxs = neighbor_idxs_[image_idx];
+    std::vector<int> owner_idxs = neighbor_idxs;
+    owner_idxs.insert(
+        std::upper_bound(owner_idxs.begin(), owner_idxs.end(), image_idx),
+        image_idx);
+
+    StreamingImageObservations observations;
+    Eigen::Vector2d xy;
+    Eigen::Vector2d neighbor_xy;
+    for (const int owner_idx : owner_idxs) {
+      const std::vector<StreamingPoint3D>& points3D =
+          *THROW_CHECK_NOTNULL(images[owner_idx].points3D);
+      for (size_t i = 0; i < points3D.size(); ++i) {
+        if (!ProjectPoint(image_idx, points3D[i].xyz, &xy)) {
+          continue;
+        }
+        bool has_track = owner_idx != image_idx;
+        for (size_t j = 0; !has_track && j < neighbor_idxs.size(); ++j) {
+          has_track =
+              ProjectPoint(neighbor_idxs[j], points3D[i].xyz, &neighbor_xy);
+        }
+        if (options_.point2D_stddev > 0) {
+          xy += Eigen::Vector2d(noise_distribution(prng),
+                                noise_distribution(prng));
+        }
+        observations.points2D.push_back(xy);
+        observations.point3D_ids.push_back(
+            has_track ? Point3DId(owner_idx, i) : kInvalidPoint3DId);
+      }
+    }
+
+    const Camera& camera = ImageCamera(image_idx);
+    std::uniform_real_distribution<double> x_distribution(0, camera.width);
+    std::uniform_real_distribution<double> y_distribution(0, camera.height);
+    for (int i = 0; i < options_.num_points2D_without_point3D; ++i) {
+      observations.points2D.emplace_back(x_distribution(prng),
+                                         y_distribution(prng));
+      observations.point3D_ids.push_back(kInvalidPoint3DId);
+    }
+
+    // Shuffle 2D points, so each image has another order of observed 3D points.
+    std::vector<point2D_t> order(observations.points2D.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), prng);
+    std::vector<Eigen::Vector2d> points2D(order.size());
+    std::vector<point3D_t> point3D_ids(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      points2D[i] = observations.points2D[order[i]];
+      point3D_ids[i] = observations.point3D_ids[order[i]];
+      if (point3D_ids[i] != kInvalidPoint3DId) {
+        observations.sorted_points3D.emplace_back(point3D_ids[i], i);
+      }
+    }
+    observations.points2D = std::move(points2D);
+    observations.point3D_ids = std::move(point3D_ids);
+    std::sort(observations.sorted_points3D.begin(),
+              observations.sorted_points3D.end());
+
+    return observations;
+  }
+
+ private:
+  // The terrain heights are clamped to stay clear of the images.
+  static constexpr double kMaxTerrainHeightStddevs = 3;
+
+  void SynthesizeLayout() {
+    const int num_images = options_.num_images;
+    const Camera& camera = cameras_[0];
+
+    // Extent of the view on the ground at zero height without tilt.
+    double max_x = 0;
+    double max_y = 0;
+    for (const auto& corner : {Eigen::Vector2d(0, 0),
+                               Eigen::Vector2d(camera.width, 0),
+                               Eigen::Vector2d(0, camera.height),
+                               Eigen::Vector2d(camera.width, camera.height)}) {
+      const Eigen::Vector2d cam_point = camera.CamFromImg(corner);
+      max_x = std::max(max_x, std::abs(cam_point.x()));
+      max_y = std::max(max_y, std::abs(cam_point.y()));
+    }
+    const double spacing_x = (1 - options_.view_overlap) * 2 * max_x;
+    const double spacing_y = (1 - options_.view_overlap) * 2 * max_y;
+
+    std::vector<Eigen::Vector2d> positions(num_images);
+    const int num_cols = std::ceil(std::sqrt(num_images));
+    const int num_rows = (num_images + num_cols - 1) / num_cols;
+    switch (options_.match_graph) {
+      case StreamingSyntheticDatasetOptions::MatchGraph::SEQUENTIAL:
+        for (int i = 0; i < num_images; ++i) {
+          positions[i] = Eigen::Vector2d(i * spacing_x, 0);
+        }
+        break;
+      case StreamingSyntheticDatasetOptions::MatchGraph::GRID:
+        for (int i = 0; i < num_images; ++i) {
+          const int row = i / num_cols;
+          const int col =
+              (row % 2 == 0) ? i % num_cols : num_cols - 1 - i % num_cols;
+          positions[i] = Eigen::Vector2d(col * spacing_x, row * spacing_y);
+        }
+        break;
+      case StreamingSyntheticDatasetOptions::MatchGraph::RANDOM: {
+        std::mt19937 prng =
+            StreamingPRNG(options_.seed, 0, kStreamingLayoutSalt);
+        std::uniform_real_distribution<double> x_distribution(
+            0, num_cols * spacing_x);
+        std::uniform_real_distribution<double> y_distribution(
+            0, num_rows * spacing_y);
+        for (auto& position : positions) {
+          position =
+              Eigen::Vector2d(x_distribution(prng), y_distribution(prng));
+        }
+        // Order the images in rows, so that overlapping images have close
+        // indices and leave the streaming window soon.
+        std::sort(positions.begin(),
+                  positions.end(),
+                  [spacing_y](const Eigen::Vector2d& position1,
+                              const Eigen::Vector2d& position2) {
+                    const int row1 = std::floor(position1.y() / spacing_y);
+                    const int row2 = std::floor(position2.y() / spacing_y);
+                    return row1 < row2 ||
+                           (row1 == row2 && position1.x() < position2.x());
+                  });
+        break;
+      }
+      default:
+        LOG(FATAL_THROW) << "Invalid MatchGraph specified";
+    }
+
+    // The cameras look down with the image x-axis along the world x-axis.
+    const Eigen::Quaterniond nadir_from_world(
+        Eigen::Vector3d(1, -1, -1).asDiagonal().toDenseMatrix());
+    const double max_tilt = DegToRad(options_.max_tilt_deg);
+    cams_from_world_.resize(num_images);
+    for (int i = 0; i < num_images; ++i) {
+      std::mt19937 prng = StreamingPRNG(options_.seed, i, kStreamingPoseSalt);
+      const double tilt_dir =
+          std::uniform_real_distribution<double>(0, 2 * M_PI)(prng);
+      const double tilt =
+          std::uniform_real_distribution<double>(0, max_tilt)(prng);
+      Rigid3d& cam_from_world = cams_from_world_[i];
+      cam_from_world.rotation =
+          nadir_from_world *
+          Eigen::Quaterniond(Eigen::AngleAxisd(
+              tilt,
+              Eigen::Vector3d(std::cos(tilt_dir), std::sin(tilt_dir), 0)));
+      cam_from_world.translation =
+          cam_from_world.rotation *
+          -Eigen::Vector3d(positions[i].x(), positions[i].y(), 1);
+    }
+
+    // Images can only overlap within the extent of the views at the lowest
+    // terrain with the maximum tilt.
+    const double max_depth =
+        1 + kMaxTerrainHeightStddevs * options_.terrain_height_stddev;
+    const double max_dist_x =
+        2 * max_depth * std::tan(std::atan(max_x) + max_tilt);
+    const double max_dist_y =
+        2 * max_depth * std::tan(std::atan(max_y) + max_tilt);
+    auto CellIdx = [&](const int image_idx) {
+      return std::make_pair(
+          static_cast<int>(std::floor(positions[image_idx].x() / max_dist_x)),
+          static_cast<int>(std::floor(positions[image_idx].y() / max_dist_y)));
+    };
+    std::map<std::pair<int, int>, std::vector<int>> cells;
+    for (int i = 0; i < num_images; ++i) {
+      cells[CellIdx(i)].push_back(i);
+    }
+
+    neighbor_idxs_.resize(num_images);
+    ParallelForChunks(
+        options_.num_threads,
+        num_images,
+        /*min_chunk_size=*/256,
+        [&](const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const auto [cell_x, cell_y] = CellIdx(i);
+            for (int dx = -1; dx <= 1; ++dx) {
+              for (int dy = -1; dy <= 1; ++dy) {
+                const auto cell = cells.find({cell_x + dx, cell_y + dy});
+                if (cell == cells.end()) {
+                  continue;
+                }
+                for (const int j : cell->second) {
+                  const Eigen::Vector2d diff = positions[j] - positions[i];
+                  if (j != static_cast<int>(i) &&
+                      std::abs(diff.x()) <= max_dist_x &&
+                      std::abs(diff.y()) <= max_dist_y) {
+                    neighbor_idxs_[i].push_back(j);
+                  }
+                }
+              }
+            }
+            std::sort(neighbor_idxs_[i].begin(), neighbor_idxs_[i].end());
+          }
+        });
+  }
+
+  const StreamingSyntheticDatasetOptions& options_;
+  std::vector<Camera> cameras_;
+  std::vector<Rigid3d> cams_from_world_;
+  std::vector<std::vector<int>> neighbor_idxs_;
+};
+
+template <typename T>
+void AppendBinaryLittleEndian(std::string* buffer, const T value) {
+  const T little_endian_value = NativeToLittleEndian(value);
+  buffer->append(reinterpret_cast<const char*>(&little_endian_value),
+                 sizeof(T));
+}
+
+// Serialize the image in the format of images.bin.
+void AppendImageRecord(const image_t image_id,
+                       const camera_t camera_id,
+                       const std::string& name,
+                       const Rigid3d& cam_from_world,
+                       const StreamingImageObservations& observations,
+                       std::string* buffer) {
+  AppendBinaryLittleEndian<image_t>(buffer, image_id);
+  AppendBinaryLittleEndian<double>(buffer, cam_from_world.rotation.w());
+  AppendBinaryLittleEndian<double>(buffer, cam_from_world.rotation.x());
+  AppendBinaryLittleEndian<double>(buffer, cam_from_world.rotation.y());
+  AppendBinaryLittleEndian<double>(buffer, cam_from_world.rotation.z());
+  AppendBinaryLittleEndian<double>(buffer, cam_from_world.translation.x());
+  AppendBinaryLittleEndian<double>(buffer, cam_from_world.translation.y());
+  AppendBinaryLittleEndian<double>(buffer, cam_from_world.translation.z());
+  AppendBinaryLittleEndian<camera_t>(buffer, camera_id);
+  buffer->append(name);
+  buffer->push_back('\0');
+  AppendBinaryLittleEndian<uint64_t>(buffer, observations.points2D.size());
+  for (size_t i = 0; i < observations.points2D.size(); ++i) {
+    AppendBinaryLittleEndian<double>(buffer, observations.points2D[i].x());
+    AppendBinaryLittleEndian<double>(buffer, observations.points2D[i].y());
+    AppendBinaryLittleEndian<point3D_t>(buffer, observations.point3D_ids[i]);
+  }
+}
+
+// Serialize the 3D points owned by the image in the format of points3D.bin
+// and return the number of serialized points. All images observing the
+// points must have their observations in the given window.
+size_t AppendPoints3DRecords(
+    const StreamingScene& scene,
+    const int image_idx,
+    const std::vector<image_t>& image_ids,
+    const std::vector<StreamingImage>& images,
+    std::string* buffer) {
+  const std::vector<StreamingPoint3D>& points3D =
+      *THROW_CHECK_NOTNULL(images[image_idx].points3D);
+  const point3D_t min_point3D_id = scene.Point3DId(image_idx, 0);
+
+  std::vector<std::vector<TrackElement>> tracks(points3D.size());
+  std::vector<double> sum_errors(points3D.size(), 0);
+  std::vector<int> observer_idxs = scene.NeighborIdxs(image_idx);
+  observer_idxs.push_back(image_idx);
+  Eigen::Vector2d xy;
+  for (const int observer_idx : observer_idxs) {
+    const StreamingImageObservations& observer =
+        *THROW_CHECK_NOTNULL(images[observer_idx].observations);
+    for (auto it =
+             std::lower_bound(observer.sorted_points3D.begin(),
+                              observer.sorted_points3D.end(),
+                              std::make_pair(min_point3D_id, point2D_t(0)));
+         it != observer.sorted_points3D.end() &&
+         it->first < min_point3D_id + points3D.size();
+         ++it) {
+      const size_t point3D_idx = it->first - min_point3D_id;
+      tracks[point3D_idx].emplace_back(image_ids[observer_idx], it->second);
+      scene.ProjectPoint(observer_idx, points3D[point3D_idx].xyz, &xy);
+      sum_errors[point3D_idx] += (observer.points2D[it->second] - xy).norm();
+    }
+  }
+
+  size_t num_points3D = 0;
+  for (size_t i = 0; i < points3D.size(); ++i) {
+    if (tracks[i].size() < 2) {
+      continue;
+    }
+    num_points3D += 1;
+    AppendBinaryLittleEndian<point3D_t>(buffer, min_point3D_id + i);
+    AppendBinaryLittleEndian<double>(buffer, points3D[i].xyz(0));
+    AppendBinaryLittleEndian<double>(buffer, points3D[i].xyz(1));
+    AppendBinaryLittleEndian<double>(buffer, points3D[i].xyz(2));
+    AppendBinaryLittleEndian<uint8_t>(buffer, points3D[i].color(0));
+    AppendBinaryLittleEndian<uint8_t>(buffer, points3D[i].color(1));
+    AppendBinaryLittleEndian<uint8_t>(buffer, points3D[i].color(2));
+    AppendBinaryLittleEndian<double>(buffer, sum_errors[i] / tracks[i].size());
+    AppendBinaryLittleEndian<uint64_t>(buffer, tracks[i].size());
+    for (const auto& track_el : tracks[i]) {
+      AppendBinaryLittleEndian<image_t>(buffer, track_el.image_id);
+      AppendBinaryLittleEndian<point2D_t>(buffer, track_el.point2D_idx);
+    }
+  }
+  return num_points3D;
+}
+
+struct StreamingImagePair {
+  int image_idx1 = -1;
+  FeatureMatches matches;
+  TwoViewGeometry two_view_geometry;
+};
+
+// Synthesize the matches of the image with its neighbors of lower index.
+std::vector<StreamingImagePair> SynthesizeStreamingMatches(
+    const StreamingSyntheticDatasetOptions& options,
+    const StreamingScene& scene,
+    const int image_idx2,
+    const std::vector<image_t>& image_ids,
+    const std::vector<StreamingImage>& images) {
+  const StreamingImageObservations& observations2 =
+      *THROW_CHECK_NOTNULL(images[image_idx2].observations);
+  const Eigen::Matrix3d K2 = scene.ImageCamera(image_idx2).CalibrationMatrix();
+
+  std::vector<StreamingImagePair> image_pairs;
+  for (const int image_idx1 : scene.NeighborIdxs(image_idx2)) {
+    if (image_idx1 >= image_idx2) {
+      break;
+    }
+    const StreamingImageObservations& observations1 =
+        *THROW_CHECK_NOTNULL(images[image_idx1].observations);
+
+    StreamingImagePair image_pair;
+    image_pair.image_idx1 = image_idx1;
+    TwoViewGeometry& two_view_geometry = image_pair.two_view_geometry;
+    auto it1 = observations1.sorted_points3D.begin();
+    auto it2 = observations2.sorted_points3D.begin();
+    while (it1 != observations1.sorted_points3D.end() &&
+           it2 != observations2.sorted_points3D.end()) {
+      if (it1->first < it2->first) {
+        ++it1;
+      } else if (it2->first < it1->first) {
+        ++it2;
+      } else {
+        two_view_geometry.inlier_matches.emplace_back(it1->second,
+                                                      it2->second);
+        ++it1;
+        ++it2;
+      }
+    }
+    if (two_view_geometry.inlier_matches.empty()) {
+      continue;
+    }
+
+    two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+    two_view_geometry.cam2_from_cam1 =
+        scene.CamFromWorld(image_idx2) *
+        Inverse(scene.CamFromWorld(image_idx1));
+    two_view_geometry.E =
+        EssentialMatrixFromPose(two_view_geometry.cam2_from_cam1);
+    two_view_geometry.F = FundamentalFromEssentialMatrix(
+        K2,
+        two_view_geometry.E,
+        scene.ImageCamera(image_idx1).CalibrationMatrix());
+
+    image_pair.matches = two_view_geometry.inlier_matches;
+    std::mt19937 prng = StreamingPRNG(
+        options.seed,
+        Database::ImagePairToPairId(image_ids[image_idx1],
+                                    image_ids[image_idx2]),
+        kStreamingMatchesSalt);
+    AddOutlierMatches(options.inlier_match_ratio,
+                      observations1.points2D.size(),
+                      observations2.points2D.size(),
+                      prng,
+                      &image_pair.matches);
+
+    image_pairs.push_back(std::move(image_pair));
+  }
+  return image_pairs;
+}
+
 }  // namespace
 
 void SynthesizeDataset(const SyntheticDatasetOptions& options,
@@ -287,4 +810,254 @@ void SynthesizeDataset(const SyntheticDatasetOptions& options,
   reconstruction->UpdatePoint3DErrors();
 }
 
+void SynthesizeStreamingDataset(const StreamingSyntheticDatasetOptions& options,
+                                Database* database,
+                                const std::string& sparse_path) {
+  THROW_CHECK_GT(options.num_cameras, 0);
+  THROW_CHECK_GT(options.num_images, 0);
+  THROW_CHECK_LE(options.num_cameras, options.num_images);
+  THROW_CHECK_GE(options.num_points3D_per_image, 0);
+  THROW_CHECK_GE(options.num_points2D_without_point3D, 0);
+  THROW_CHECK_GE(options.point2D_stddev, 0);
+  THROW_CHECK_GE(options.view_overlap, 0);
+  THROW_CHECK_LT(options.view_overlap, 1);
+  THROW_CHECK_GE(options.max_tilt_deg, 0);
+  THROW_CHECK_LT(options.max_tilt_deg, 45);
+  THROW_CHECK_GE(options.terrain_height_stddev, 0);
+  THROW_CHECK_LT(options.terrain_height_stddev, 0.25);
+  THROW_CHECK_GT(options.num_images_per_batch, 0);
+
+  StreamingScene scene(options);
+
+  // The ids are assigned by the database, so the images are written upfront.
+  std::vector<camera_t> camera_ids(options.num_cameras);
+  std::vector<image_t> image_ids(options.num_images);
+  std::vector<std::string> image_names(options.num_images);
+  {
+    std::unique_ptr<DatabaseTransaction> database_transaction;
+    if (database != nullptr) {
+      database_transaction = std::make_unique<DatabaseTransaction>(database);
+    }
+    for (int camera_idx = 0; camera_idx < options.num_cameras; ++camera_idx) {
+      Camera& camera = scene.Cameras()[camera_idx];
+      camera_ids[camera_idx] = (database == nullptr)
+                                   ? camera_idx + 1
+                                   : database->WriteCamera(camera);
+      camera.camera_id = camera_ids[camera_idx];
+    }
+    const int existing_num_images =
+        (database == nullptr) ? 0 : database->NumImages();
+    for (int image_idx = 0; image_idx < options.num_images; ++image_idx) {
+      image_names[image_idx] =
+          "image" + std::to_string(existing_num_images + image_idx);
+      Image image;
+      image.SetName(image_names[image_idx]);
+      image.SetCameraId(camera_ids[image_idx % options.num_cameras]);
+      image_ids[image_idx] =
+          (database == nullptr) ? image_idx + 1 : database->WriteImage(image);
+    }
+  }
+
+  std::ofstream images_file;
+  std::ofstream points3D_file;
+  if (!sparse_path.empty()) {
+    THROW_CHECK_DIR_EXISTS(sparse_path);
+    const std::string cameras_path = JoinPaths(sparse_path, "cameras.bin");
+    std::ofstream cameras_file(cameras_path,
+                               std::ios::trunc | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(cameras_file, cameras_path);
+    WriteBinaryLittleEndian<uint64_t>(&cameras_file, scene.Cameras().size());
+    for (const Camera& camera : scene.Cameras()) {
+      WriteBinaryLittleEndian<camera_t>(&cameras_file, camera.camera_id);
+      WriteBinaryLittleEndian<int>(&cameras_file,
+                                   static_cast<int>(camera.model_id));
+      WriteBinaryLittleEndian<uint64_t>(&cameras_file, camera.width);
+      WriteBinaryLittleEndian<uint64_t>(&cameras_file, camera.height);
+      for (const double param : camera.params) {
+        WriteBinaryLittleEndian<double>(&cameras_file, param);
+      }
+    }
+
+    const std::string images_path = JoinPaths(sparse_path, "images.bin");
+    images_file.open(images_path, std::ios::trunc | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(images_file, images_path);
+    WriteBinaryLittleEndian<uint64_t>(&images_file, options.num_images);
+
+    // The number of 3D points is only known at the end.
+    const std::string points3D_path = JoinPaths(sparse_path, "points3D.bin");
+    points3D_file.open(points3D_path, std::ios::trunc | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(points3D_file, points3D_path);
+    WriteBinaryLittleEndian<uint64_t>(&points3D_file, 0);
+  }
+
+  ThreadPool thread_pool(options.num_threads);
+
+  // Window of the images whose matches or 3D points are not yet written.
+  std::vector<StreamingImage> images(options.num_images);
+  std::vector<int> window_image_idxs;
+
+  // The 3D points are written in the order of their owning images, once all
+  // images observing them are synthesized.
+  int num_written_owners = 0;
+  uint64_t num_points3D = 0;
+
+  for (int batch_begin = 0; batch_begin < options.num_images;
+       batch_begin += options.num_images_per_batch) {
+    const int batch_end = std::min(
+        batch_begin + options.num_images_per_batch, options.num_images);
+    const int batch_size = batch_end - batch_begin;
+
+    // Synthesize the 3D points observed in the batch that are not yet in the
+    // window, since the images of the batch may observe the same points.
+    std::vector<int> owner_idxs;
+    for (int image_idx = batch_begin; image_idx < batch_end; ++image_idx) {
+      if (images[image_idx].points3D == nullptr) {
+        owner_idxs.push_back(image_idx);
+      }
+      for (const int neighbor_idx : scene.NeighborIdxs(image_idx)) {
+        if (images[neighbor_idx].points3D == nullptr) {
+          owner_idxs.push_back(neighbor_idx);
+        }
+      }
+    }
+    std::sort(owner_idxs.begin(), owner_idxs.end());
+    owner_idxs.erase(std::unique(owner_idxs.begin(), owner_idxs.end()),
+                     owner_idxs.end());
+    ParallelForChunks(&thread_pool,
+                      owner_idxs.size(),
+                      /*min_chunk_size=*/1,
+                      [&](const size_t begin, const size_t end) {
+                        for (size_t i = begin; i < end; ++i) {
+                          images[owner_idxs[i]].points3D =
+                              std::make_unique<std::vector<StreamingPoint3D>>(
+                                  scene.Points3D(owner_idxs[i]));
+                        }
+                      });
+
+    std::vector<std::string> image_records(batch_size);
+    ParallelForChunks(
+        &thread_pool,
+        batch_size,
+        /*min_chunk_size=*/1,
+        [&](const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const int image_idx = batch_begin + i;
+            images[image_idx].observations =
+                std::make_unique<StreamingImageObservations>(
+                    scene.Observations(image_idx, images));
+            if (images_file.is_open()) {
+              AppendImageRecord(
+                  image_ids[image_idx],
+                  camera_ids[image_idx % options.num_cameras],
+                  image_names[image_idx],
+                  scene.CamFromWorld(image_idx),
+                  *images[image_idx].observations,
+                  &image_records[i]);
+            }
+          }
+        });
+    for (int image_idx = batch_begin; image_idx < batch_end; ++image_idx) {
+      window_image_idxs.push_back(image_idx);
+    }
+
+    std::vector<std::vector<StreamingImagePair>> image_pairs(batch_size);
+    if (database != nullptr) {
+      ParallelForChunks(&thread_pool,
+                        batch_size,
+                        /*min_chunk_size=*/1,
+                        [&](const size_t begin, const size_t end) {
+                          for (size_t i = begin; i < end; ++i) {
+                            image_pairs[i] = SynthesizeStreamingMatches(
+                                options,
+                                scene,
+                                batch_begin + i,
+                                image_ids,
+                                images);
+                          }
+                        });
+    }
+
+    int owners_end = num_written_owners;
+    while (owners_end < batch_end &&
+           scene.MaxNeighborIdx(owners_end) < batch_end) {
+      ++owners_end;
+    }
+    std::vector<std::string> points3D_records(owners_end - num_written_owners);
+    std::vector<size_t> num_owner_points3D(points3D_records.size(), 0);
+    if (points3D_file.is_open()) {
+      ParallelForChunks(&thread_pool,
+                        points3D_records.size(),
+                        /*min_chunk_size=*/1,
+                        [&](const size_t begin, const size_t end) {
+                          for (size_t i = begin; i < end; ++i) {
+                            num_owner_points3D[i] = AppendPoints3DRecords(
+                                scene,
+                                num_written_owners + i,
+                                image_ids,
+                                images,
+                                &points3D_records[i]);
+                          }
+                        });
+    }
+    num_written_owners = owners_end;
+
+    if (database != nullptr) {
+      DatabaseTransaction database_transaction(database);
+      for (int i = 0; i < batch_size; ++i) {
+        const int image_idx = batch_begin + i;
+        const StreamingImageObservations& observations =
+            *images[image_idx].observations;
+        FeatureKeypoints keypoints;
+        keypoints.reserve(observations.points2D.size());
+        for (const auto& point2D : observations.points2D) {
+          keypoints.emplace_back(point2D.x(), point2D.y());
+        }
+        database->WriteKeypoints(image_ids[image_idx], keypoints);
+        for (const auto& image_pair : image_pairs[i]) {
+          database->WriteMatches(image_ids[image_pair.image_idx1],
+                                 image_ids[image_idx],
+                                 image_pair.matches);
+          database->WriteTwoViewGeometry(image_ids[image_pair.image_idx1],
+                                         image_ids[image_idx],
+                                         image_pair.two_view_geometry);
+        }
+      }
+    }
+
+    for (const std::string& image_record : image_records) {
+      images_file.write(image_record.data(), image_record.size());
+    }
+    for (size_t i = 0; i < points3D_records.size(); ++i) {
+      points3D_file.write(points3D_records[i].data(),
+                          points3D_records[i].size());
+      num_points3D += num_owner_points3D[i];
+    }
+
+    // Release the images, once the 3D points of all their neighbors are
+    // written, which implies that all their matches are written.
+    window_image_idxs.erase(
+        std::remove_if(window_image_idxs.begin(),
+                       window_image_idxs.end(),
+                       [&](const int image_idx) {
+                         if (scene.MaxNeighborIdx(image_idx) <
+                             num_written_owners) {
+                           images[image_idx] = StreamingImage();
+                           return true;
+                         }
+                         return false;
+                       }),
+        window_image_idxs.end());
+  }
+
+  THROW_CHECK_EQ(num_written_owners, options.num_images);
+  THROW_CHECK(window_image_idxs.empty());
+
+  if (!sparse_path.empty()) {
+    THROW_CHECK(images_file.good()) << "Failed to write images.bin";
+    points3D_file.seekp(0);
+    WriteBinaryLittleEndian<uint64_t>(&points3D_file, num_points3D);
+    THROW_CHECK(points3D_file.good()) << "Failed to write points3D.bin";
+  }
+}
+
 }  // namespace colmap
@@ -64,4 +64,61 @@ void SynthesizeDataset(const SyntheticDatasetOptions& options,
                        Reconstruction* reconstruction,
                        Database* database = nullptr);
 
+// Options to synthesize large datasets, e.g., as shared inputs for
+// benchmarks. The images look down onto a terrain from a common altitude and
+// their layout determines the topology of the match graph.
+struct StreamingSyntheticDatasetOptions {
+  int num_cameras = 1;
+  int num_images = 1000;
+  // Number of 3D points synthesized in the view of every image.
+  int num_points3D_per_image = 500;
+
+  int camera_width = 1024;
+  int camera_height = 768;
+  CameraModelId camera_model_id = SimpleRadialCameraModel::model_id;
+  std::vector<double> camera_params = {1280, 512, 384, 0.05};
+
+  int num_points2D_without_point3D = 10;
+  double point2D_stddev = 0.0;
+
+  double inlier_match_ratio = 1.0;
+
+  enum class MatchGraph {
+    // Images along a line, matched with the images before and after.
+    SEQUENTIAL = 1,
+    // Images on a regular grid in serpentine order, matched with the
+    // surrounding images.
+    GRID = 2,
+    // Images at uniform random positions, matched with the overlapping images.
+    RANDOM = 3,
+  };
+  MatchGraph match_graph = MatchGraph::SEQUENTIAL;
+
+  // Overlap of the views of adjacent images in the layout as a fraction of
+  // the view extent, which determines the number of image pairs per image.
+  double view_overlap = 0.8;
+
+  // Maximum tilt of the viewing directions from the vertical in degrees.
+  double max_tilt_deg = 5.0;
+
+  // Standard deviation of the terrain height relative to the altitude.
+  double terrain_height_stddev = 0.1;
+
+  // The images are synthesized in parallel in batches of this size.
+  int num_images_per_batch = 256;
+  int num_threads = -1;
+
+  // Every image is synthesized from its own generator seeded with this seed
+  // and its index, so that the dataset does not depend on the threading.
+  unsigned seed = 0;
+};
+
+// Synthesize a dataset by streaming it to the database and to a binary sparse
+// model in sparse_path, which are skipped if the database is null or the path
+// is empty, respectively. In contrast to SynthesizeDataset, only the images
+// whose matches or 3D points are not yet written are held in memory.
+void SynthesizeStreamingDataset(const StreamingSyntheticDatasetOptions& options,
+                                Database* database,
+                                const std::string& sparse_path);
+
 }  // namespace colmap
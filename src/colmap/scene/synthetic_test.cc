@@ -185,5 +185,108 @@ TEST(SynthesizeDataset, NoDatabase) {
   SynthesizeDataset(options, &reconstruction);
 }
 
+class ParameterizedSynthesizeStreamingDatasetTests
+    : public ::testing::TestWithParam<
+          StreamingSyntheticDatasetOptions::MatchGraph> {};
+
+TEST_P(ParameterizedSynthesizeStreamingDatasetTests, Nominal) {
+  Database database(Database::kInMemoryDatabasePath);
+  StreamingSyntheticDatasetOptions options;
+  options.num_images = 50;
+  options.num_points3D_per_image = 50;
+  options.match_graph = GetParam();
+  options.num_images_per_batch = 7;
+  const std::string sparse_path = CreateTestDir();
+  SynthesizeStreamingDataset(options, &database, sparse_path);
+
+  Reconstruction reconstruction;
+  reconstruction.Read(sparse_path);
+
+  EXPECT_EQ(database.NumCameras(), options.num_cameras);
+  EXPECT_EQ(reconstruction.NumCameras(), options.num_cameras);
+  EXPECT_EQ(database.NumImages(), options.num_images);
+  EXPECT_EQ(reconstruction.NumImages(), options.num_images);
+  for (const auto& image : reconstruction.Images()) {
+    EXPECT_EQ(image.second.Name(), database.ReadImage(image.first).Name());
+    EXPECT_EQ(image.second.NumPoints2D(),
+              database.ReadKeypoints(image.first).size());
+    EXPECT_GT(image.second.NumPoints3D(), 0);
+  }
+
+  EXPECT_GT(reconstruction.NumPoints3D(), 0);
+  EXPECT_NEAR(reconstruction.ComputeMeanReprojectionError(), 0, 1e-6);
+  for (const auto& point3D : reconstruction.Points3D()) {
+    EXPECT_GE(point3D.second.track.Length(), 2);
+    EXPECT_NEAR(point3D.second.error, 0, 1e-6);
+  }
+
+  // The inlier matches correspond to the tracks of the 3D points.
+  std::vector<image_pair_t> pair_ids;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  database.ReadTwoViewGeometries(&pair_ids, &two_view_geometries);
+  EXPECT_GE(two_view_geometries.size(), options.num_images - 1);
+  EXPECT_EQ(database.NumMatchedImagePairs(), two_view_geometries.size());
+  for (size_t i = 0; i < pair_ids.size(); ++i) {
+    const TwoViewGeometry& two_view_geometry = two_view_geometries[i];
+    const auto [image_id1, image_id2] =
+        Database::PairIdToImagePair(pair_ids[i]);
+    const Image& image1 = reconstruction.Image(image_id1);
+    const Image& image2 = reconstruction.Image(image_id2);
+    EXPECT_FALSE(two_view_geometry.inlier_matches.empty());
+    for (const auto& match : two_view_geometry.inlier_matches) {
+      EXPECT_TRUE(image1.Point2D(match.point2D_idx1).HasPoint3D());
+      EXPECT_EQ(image1.Point2D(match.point2D_idx1).point3D_id,
+                image2.Point2D(match.point2D_idx2).point3D_id);
+    }
+  }
+}
+
+TEST_P(ParameterizedSynthesizeStreamingDatasetTests, IndependentOfBatching) {
+  StreamingSyntheticDatasetOptions options;
+  options.num_images = 30;
+  options.num_points3D_per_image = 20;
+  options.point2D_stddev = 1;
+  options.inlier_match_ratio = 0.8;
+  options.match_graph = GetParam();
+
+  Database database1(Database::kInMemoryDatabasePath);
+  const std::string sparse_path1 = CreateTestDir() + "/sparse1";
+  CreateDirIfNotExists(sparse_path1);
+  options.num_images_per_batch = 1;
+  options.num_threads = 1;
+  SynthesizeStreamingDataset(options, &database1, sparse_path1);
+
+  Database database2(Database::kInMemoryDatabasePath);
+  const std::string sparse_path2 = CreateTestDir() + "/sparse2";
+  CreateDirIfNotExists(sparse_path2);
+  options.num_images_per_batch = 256;
+  options.num_threads = 3;
+  SynthesizeStreamingDataset(options, &database2, sparse_path2);
+
+  for (const std::string name : {"cameras.bin", "images.bin", "points3D.bin"}) {
+    std::vector<char> data1;
+    std::vector<char> data2;
+    ReadBinaryBlob(JoinPaths(sparse_path1, name), &data1);
+    ReadBinaryBlob(JoinPaths(sparse_path2, name), &data2);
+    EXPECT_EQ(data1, data2) << name;
+  }
+  EXPECT_EQ(database1.NumMatches(), database2.NumMatches());
+  EXPECT_EQ(database1.NumInlierMatches(), database2.NumInlierMatches());
+  EXPECT_GT(database1.NumMatches(), database1.NumInlierMatches());
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    SynthesizeStreamingDataset,
+    ParameterizedSynthesizeStreamingDatasetTests,
+    ::testing::Values(StreamingSyntheticDatasetOptions::MatchGraph::SEQUENTIAL,
+                      StreamingSyntheticDatasetOptions::MatchGraph::GRID,
+                      StreamingSyntheticDatasetOptions::MatchGraph::RANDOM));
+
+TEST(SynthesizeStreamingDataset, NoDatabaseOrModel) {
+  StreamingSyntheticDatasetOptions options;
+  options.num_images = 20;
+  SynthesizeStreamingDataset(options, /*database=*/nullptr, "");
+}
+
 }  // namespace
 }  // namespace colmap
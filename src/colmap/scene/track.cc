@@ -29,8 +29,94 @@
 
 #include "colmap/scene/track.h"
 
+#include <cstring>
+#include <memory>
+
 namespace colmap {
 
+TrackElements::TrackElements(const TrackElements& other) {
+  if (other.size_ > kNumInlineElements) {
+    Reallocate(other.size_);
+  }
+  std::memcpy(data(), other.data(), other.size_ * sizeof(TrackElement));
+  size_ = other.size_;
+}
+
+TrackElements::TrackElements(TrackElements&& other) noexcept {
+  *this = std::move(other);
+}
+
+TrackElements::~TrackElements() {
+  if (!IsInline()) {
+    std::allocator<TrackElement>().deallocate(heap_elements_, capacity_);
+  }
+}
+
+TrackElements& TrackElements::operator=(const TrackElements& other) {
+  if (this != &other) {
+    clear();
+    reserve(other.size_);
+    std::memcpy(data(), other.data(), other.size_ * sizeof(TrackElement));
+    size_ = other.size_;
+  }
+  return *this;
+}
+
+TrackElements& TrackElements::operator=(TrackElements&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  if (!IsInline()) {
+    std::allocator<TrackElement>().deallocate(heap_elements_, capacity_);
+  }
+  if (other.IsInline()) {
+    std::memcpy(inline_elements_,
+                other.inline_elements_,
+                other.size_ * sizeof(TrackElement));
+  } else {
+    heap_elements_ = other.heap_elements_;
+  }
+  size_ = other.size_;
+  capacity_ = other.capacity_;
+  other.size_ = 0;
+  other.capacity_ = kNumInlineElements;
+  return *this;
+}
+
+void TrackElements::shrink_to_fit() {
+  if (!IsInline() && size_ < capacity_) {
+    Reallocate(size_);
+  }
+}
+
+void TrackElements::Reallocate(const size_t capacity) {
+  THROW_CHECK_GE(capacity, size_);
+  const size_t new_capacity =
+      std::max(capacity, static_cast<size_t>(kNumInlineElements));
+  if (new_capacity == capacity_) {
+    return;
+  }
+  // The heap pointer shares its memory with the inline elements.
+  TrackElement* old_heap_elements = IsInline() ? nullptr : heap_elements_;
+  const TrackElement* old_elements = data();
+  const size_t old_capacity = capacity_;
+  if (new_capacity <= kNumInlineElements) {
+    TrackElement elements[kNumInlineElements];
+    std::memcpy(elements, old_elements, size_ * sizeof(TrackElement));
+    std::memcpy(inline_elements_, elements, size_ * sizeof(TrackElement));
+  } else {
+    TrackElement* new_elements =
+        std::allocator<TrackElement>().allocate(new_capacity);
+    std::memcpy(new_elements, old_elements, size_ * sizeof(TrackElement));
+    heap_elements_ = new_elements;
+  }
+  capacity_ = static_cast<uint32_t>(new_capacity);
+  if (old_heap_elements != nullptr) {
+    std::allocator<TrackElement>().deallocate(old_heap_elements,
+                                              old_capacity);
+  }
+}
+
 Track::Track() {}
 
 TrackElement::TrackElement()
@@ -32,6 +32,10 @@
 #include "colmap/util/logging.h"
 #include "colmap/util/types.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
 #include <vector>
 
 namespace colmap {
@@ -46,6 +50,74 @@ struct TrackElement {
   point2D_t point2D_idx;
 };
 
+static_assert(std::is_trivially_copyable<TrackElement>::value,
+              "TrackElements copies elements as raw memory");
+
+// Contiguous storage of the elements of a track with the subset of the
+// std::vector interface used by the reconstruction. Tracks with up to
+// kNumInlineElements elements are stored inline in place of the heap pointer,
+// such that the common short tracks do not require any heap allocation, while
+// the container uses the same amount of memory as a std::vector.
+class TrackElements {
+ public:
+  static constexpr uint32_t kNumInlineElements = 2;
+
+  typedef TrackElement value_type;
+  typedef TrackElement* iterator;
+  typedef const TrackElement* const_iterator;
+
+  TrackElements() = default;
+  TrackElements(const TrackElements& other);
+  TrackElements(TrackElements&& other) noexcept;
+  ~TrackElements();
+
+  TrackElements& operator=(const TrackElements& other);
+  TrackElements& operator=(TrackElements&& other) noexcept;
+
+  inline size_t size() const;
+  inline bool empty() const;
+  inline size_t capacity() const;
+
+  inline TrackElement* data();
+  inline const TrackElement* data() const;
+
+  inline iterator begin();
+  inline iterator end();
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+
+  inline TrackElement& operator[](size_t idx);
+  inline const TrackElement& operator[](size_t idx) const;
+  inline TrackElement& back();
+  inline const TrackElement& back() const;
+
+  inline void push_back(const TrackElement& element);
+  inline void emplace_back(image_t image_id, point2D_t point2D_idx);
+  template <typename InputIt>
+  void append(InputIt first, InputIt last);
+
+  inline iterator erase(iterator pos);
+  inline iterator erase(iterator first, iterator last);
+  inline void clear();
+
+  inline void reserve(size_t num_elements);
+  void shrink_to_fit();
+
+ private:
+  inline bool IsInline() const;
+  // Move the elements to inline storage, if the capacity fits, or to a new
+  // heap allocation with the given capacity otherwise.
+  void Reallocate(size_t capacity);
+
+  union {
+    TrackElement* heap_elements_;
+    alignas(TrackElement) unsigned char
+        inline_elements_[kNumInlineElements * sizeof(TrackElement)];
+  };
+  uint32_t size_ = 0;
+  uint32_t capacity_ = kNumInlineElements;
+};
+
 class Track {
  public:
   Track();
@@ -54,9 +126,9 @@ class Track {
   inline size_t Length() const;
 
   // Access all elements.
-  inline const std::vector<TrackElement>& Elements() const;
-  inline std::vector<TrackElement>& Elements();
-  inline void SetElements(std::vector<TrackElement> elements);
+  inline const TrackElements& Elements() const;
+  inline TrackElements& Elements();
+  inline void SetElements(const std::vector<TrackElement>& elements);
 
   // Access specific elements.
   inline const TrackElement& Element(size_t idx) const;
@@ -67,6 +139,7 @@ class Track {
   inline void AddElement(const TrackElement& element);
   inline void AddElement(image_t image_id, point2D_t point2D_idx);
   inline void AddElements(const std::vector<TrackElement>& elements);
+  inline void AddElements(const TrackElements& elements);
 
   // Delete existing element.
   inline void DeleteElement(size_t idx);
@@ -76,36 +149,127 @@ class Track {
   // specified number of elements.
   inline void Reserve(size_t num_elements);
 
-  // Shrink the capacity of track vector to fit its size to save memory.
+  // Shrink the capacity of track vector to fit its size to save memory. Short
+  // tracks are moved back to inline storage.
   inline void Compress();
 
  private:
-  std::vector<TrackElement> elements_;
+  TrackElements elements_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
+size_t TrackElements::size() const { return size_; }
+
+bool TrackElements::empty() const { return size_ == 0; }
+
+size_t TrackElements::capacity() const { return capacity_; }
+
+bool TrackElements::IsInline() const {
+  return capacity_ <= kNumInlineElements;
+}
+
+TrackElement* TrackElements::data() {
+  return IsInline() ? reinterpret_cast<TrackElement*>(inline_elements_)
+                    : heap_elements_;
+}
+
+const TrackElement* TrackElements::data() const {
+  return IsInline() ? reinterpret_cast<const TrackElement*>(inline_elements_)
+                    : heap_elements_;
+}
+
+TrackElements::iterator TrackElements::begin() { return data(); }
+
+TrackElements::iterator TrackElements::end() { return data() + size_; }
+
+TrackElements::const_iterator TrackElements::begin() const { return data(); }
+
+TrackElements::const_iterator TrackElements::end() const {
+  return data() + size_;
+}
+
+TrackElement& TrackElements::operator[](const size_t idx) {
+  return data()[idx];
+}
+
+const TrackElement& TrackElements::operator[](const size_t idx) const {
+  return data()[idx];
+}
+
+TrackElement& TrackElements::back() { return data()[size_ - 1]; }
+
+const TrackElement& TrackElements::back() const { return data()[size_ - 1]; }
+
+void TrackElements::push_back(const TrackElement& element) {
+  if (size_ == capacity_) {
+    Reallocate(2 * static_cast<size_t>(capacity_));
+  }
+  data()[size_] = element;
+  ++size_;
+}
+
+void TrackElements::emplace_back(const image_t image_id,
+                                 const point2D_t point2D_idx) {
+  push_back(TrackElement(image_id, point2D_idx));
+}
+
+template <typename InputIt>
+void TrackElements::append(InputIt first, InputIt last) {
+  const size_t num_elements =
+      size_ + static_cast<size_t>(std::distance(first, last));
+  if (num_elements > capacity_) {
+    Reallocate(std::max(num_elements, 2 * static_cast<size_t>(capacity_)));
+  }
+  std::copy(first, last, end());
+  size_ = static_cast<uint32_t>(num_elements);
+}
+
+TrackElements::iterator TrackElements::erase(iterator pos) {
+  return erase(pos, pos + 1);
+}
+
+TrackElements::iterator TrackElements::erase(iterator first, iterator last) {
+  const iterator new_end = std::copy(last, end(), first);
+  size_ = static_cast<uint32_t>(new_end - begin());
+  return first;
+}
+
+void TrackElements::clear() { size_ = 0; }
+
+void TrackElements::reserve(const size_t num_elements) {
+  if (num_elements > capacity_) {
+    Reallocate(num_elements);
+  }
+}
+
 size_t Track::Length() const { return elements_.size(); }
 
-const std::vector<TrackElement>& Track::Elements() const { return elements_; }
+const TrackElements& Track::Elements() const { return elements_; }
 
-std::vector<TrackElement>& Track::Elements() { return elements_; }
+TrackElements& Track::Elements() { return elements_; }
 
-void Track::SetElements(std::vector<TrackElement> elements) {
-  elements_ = std::move(elements);
+void Track::SetElements(const std::vector<TrackElement>& elements) {
+  elements_.clear();
+  elements_.append(elements.begin(), elements.end());
 }
 
 // Access specific elements.
 const TrackElement& Track::Element(const size_t idx) const {
-  return elements_.at(idx);
+  THROW_CHECK_LT(idx, elements_.size());
+  return elements_[idx];
 }
 
-TrackElement& Track::Element(const size_t idx) { return elements_.at(idx); }
+TrackElement& Track::Element(const size_t idx) {
+  THROW_CHECK_LT(idx, elements_.size());
+  return elements_[idx];
+}
 
 void Track::SetElement(const size_t idx, const TrackElement& element) {
-  elements_.at(idx) = element;
+  THROW_CHECK_LT(idx, elements_.size());
+  elements_[idx] = element;
 }
 
 void Track::AddElement(const TrackElement& element) {
@@ -117,7 +281,11 @@ void Track::AddElement(const image_t image_id, const point2D_t point2D_idx) {
 }
 
 void Track::AddElements(const std::vector<TrackElement>& elements) {
-  elements_.insert(elements_.end(), elements.begin(), elements.end());
+  elements_.append(elements.begin(), elements.end());
+}
+
+void Track::AddElements(const TrackElements& elements) {
+  elements_.append(elements.begin(), elements.end());
 }
 
 void Track::DeleteElement(const size_t idx) {
@@ -40,6 +40,46 @@ TEST(TrackElement, Empty) {
   EXPECT_EQ(track_el.point2D_idx, kInvalidPoint2DIdx);
 }
 
+TEST(TrackElements, InlineAndHeap) {
+  TrackElements elements;
+  EXPECT_TRUE(elements.empty());
+  EXPECT_EQ(elements.capacity(), TrackElements::kNumInlineElements);
+  for (size_t i = 0; i < 5; ++i) {
+    elements.emplace_back(i, 2 * i);
+  }
+  EXPECT_EQ(elements.size(), 5);
+  EXPECT_GE(elements.capacity(), 5);
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ(elements[i].image_id, i);
+    EXPECT_EQ(elements[i].point2D_idx, 2 * i);
+  }
+  elements.erase(elements.begin() + 1, elements.end() - 1);
+  ASSERT_EQ(elements.size(), 2);
+  EXPECT_EQ(elements[1].image_id, 4);
+  elements.shrink_to_fit();
+  EXPECT_EQ(elements.capacity(), TrackElements::kNumInlineElements);
+  EXPECT_EQ(elements[0].image_id, 0);
+  EXPECT_EQ(elements[1].image_id, 4);
+}
+
+TEST(TrackElements, CopyAndMove) {
+  for (const size_t num_elements : {1, 10}) {
+    TrackElements elements;
+    for (size_t i = 0; i < num_elements; ++i) {
+      elements.emplace_back(i, i);
+    }
+    TrackElements copy = elements;
+    ASSERT_EQ(copy.size(), num_elements);
+    EXPECT_EQ(copy.back().image_id, num_elements - 1);
+    TrackElements moved = std::move(elements);
+    ASSERT_EQ(moved.size(), num_elements);
+    EXPECT_EQ(moved.back().image_id, num_elements - 1);
+    copy = std::move(moved);
+    ASSERT_EQ(copy.size(), num_elements);
+    EXPECT_EQ(copy.back().point2D_idx, num_elements - 1);
+  }
+}
+
 TEST(Track, Default) {
   Track track;
   EXPECT_EQ(track.Length(), 0);
@@ -39,58 +39,85 @@ VisibilityPyramid::VisibilityPyramid() : VisibilityPyramid(0, 0, 0) {}
 VisibilityPyramid::VisibilityPyramid(const size_t num_levels,
                                      const size_t width,
                                      const size_t height)
-    : width_(width), height_(height), score_(0), max_score_(0) {
-  pyramid_.resize(num_levels);
+    : width_(width),
+      height_(height),
+      score_(0),
+      max_score_(0),
+      num_levels_(num_levels) {
+  child_counts_offsets_.resize(num_levels);
+  size_t num_child_counts = 0;
   for (size_t level = 0; level < num_levels; ++level) {
     const size_t level_plus_one = level + 1;
-    const int dim = 1 << level_plus_one;
-    pyramid_[level].setZero(dim, dim);
+    const size_t dim = static_cast<size_t>(1) << level_plus_one;
     max_score_ += dim * dim * dim * dim;
+    if (level + 1 < num_levels) {
+      child_counts_offsets_[level] = num_child_counts;
+      num_child_counts += dim * dim;
+    } else {
+      point_counts_.resize(dim * dim, 0);
+    }
   }
+  child_counts_.resize(num_child_counts, 0);
 }
 
 void VisibilityPyramid::SetPoint(const double x, const double y) {
-  THROW_CHECK_GT(pyramid_.size(), 0);
+  THROW_CHECK_GT(num_levels_, 0);
 
   size_t cx = 0;
   size_t cy = 0;
   CellForPoint(x, y, &cx, &cy);
 
-  for (int i = static_cast<int>(pyramid_.size() - 1); i >= 0; --i) {
-    auto& level = pyramid_[i];
-
-    level(cy, cx) += 1;
-    if (level(cy, cx) == 1) {
-      score_ += level.size();
-    }
+  size_t dim = static_cast<size_t>(1) << num_levels_;
+  if (point_counts_[cy * dim + cx]++ != 0) {
+    return;
+  }
+  score_ += dim * dim;
 
+  // Propagate the newly populated cell to the coarser levels until reaching
+  // a cell that was already populated.
+  for (int level = static_cast<int>(num_levels_) - 2; level >= 0; --level) {
     cx = cx >> 1;
     cy = cy >> 1;
+    dim = dim >> 1;
+    uint8_t& child_count = child_counts_[child_counts_offsets_[level] +
+                                         cy * dim + cx];
+    if (child_count++ != 0) {
+      break;
+    }
+    score_ += dim * dim;
   }
 
   THROW_CHECK_LE(score_, max_score_);
 }
 
 void VisibilityPyramid::ResetPoint(const double x, const double y) {
-  THROW_CHECK_GT(pyramid_.size(), 0);
+  THROW_CHECK_GT(num_levels_, 0);
 
   size_t cx = 0;
   size_t cy = 0;
   CellForPoint(x, y, &cx, &cy);
 
-  for (int i = static_cast<int>(pyramid_.size() - 1); i >= 0; --i) {
-    auto& level = pyramid_[i];
-
-    level(cy, cx) -= 1;
-    if (level(cy, cx) == 0) {
-      score_ -= level.size();
-    }
+  size_t dim = static_cast<size_t>(1) << num_levels_;
+  uint32_t& point_count = point_counts_[cy * dim + cx];
+  THROW_CHECK_GT(point_count, 0);
+  if (--point_count != 0) {
+    return;
+  }
+  score_ -= dim * dim;
 
+  // Propagate the newly empty cell to the coarser levels until reaching a
+  // cell that remains populated.
+  for (int level = static_cast<int>(num_levels_) - 2; level >= 0; --level) {
     cx = cx >> 1;
     cy = cy >> 1;
+    dim = dim >> 1;
+    uint8_t& child_count = child_counts_[child_counts_offsets_[level] +
+                                         cy * dim + cx];
+    if (--child_count != 0) {
+      break;
+    }
+    score_ -= dim * dim;
   }
-
-  THROW_CHECK_LE(score_, max_score_);
 }
 
 void VisibilityPyramid::CellForPoint(const double x,
@@ -99,7 +126,7 @@ void VisibilityPyramid::CellForPoint(const double x,
                                      size_t* cy) const {
   THROW_CHECK_GT(width_, 0);
   THROW_CHECK_GT(height_, 0);
-  const int max_dim = 1 << pyramid_.size();
+  const int max_dim = 1 << num_levels_;
   *cx = Clamp<size_t>(max_dim * x / width_, 0, max_dim - 1);
   *cy = Clamp<size_t>(max_dim * y / height_, 0, max_dim - 1);
 }
@@ -29,12 +29,10 @@
 
 #pragma once
 
-#include "colmap/util/eigen_alignment.h"
-
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
-#include <Eigen/Core>
-
 namespace colmap {
 
 // A class that captures the distribution of points in a 2D grid.
@@ -48,6 +46,11 @@ namespace colmap {
 // populated by at least one point and the contributed score is according
 // to its resolution in the pyramid. A cell in a higher resolution level
 // contributes a higher score to the overall score.
+//
+// Only the finest level counts the points in its cells, while the cells of the
+// coarser levels count their populated child cells. An update thus only visits
+// the levels whose cells change between empty and populated, which in most
+// cases is only the finest level.
 class VisibilityPyramid {
  public:
   VisibilityPyramid();
@@ -76,15 +79,22 @@ class VisibilityPyramid {
   // The maximum score when all cells are populated.
   size_t max_score_;
 
-  // The visibilty pyramid with multiple levels.
-  std::vector<Eigen::MatrixXi> pyramid_;
+  size_t num_levels_;
+
+  // The number of points in each cell of the finest level in row-major order.
+  std::vector<uint32_t> point_counts_;
+
+  // The number of populated child cells of each cell in the coarser levels,
+  // stored level by level in row-major order, starting at the given offsets.
+  std::vector<uint8_t> child_counts_;
+  std::vector<size_t> child_counts_offsets_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
-size_t VisibilityPyramid::NumLevels() const { return pyramid_.size(); }
+size_t VisibilityPyramid::NumLevels() const { return num_levels_; }
 
 size_t VisibilityPyramid::Width() const { return width_; }
 
@@ -29,6 +29,7 @@
 
 #include "colmap/scene/visibility_pyramid.h"
 
+#include <Eigen/Core>
 #include <gtest/gtest.h>
 
 namespace colmap {
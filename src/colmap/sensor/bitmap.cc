@@ -173,16 +173,11 @@ unsigned int Bitmap::BitsPerPixel() const {
 unsigned int Bitmap::Pitch() const { return FreeImage_GetPitch(handle_.ptr); }
 
 std::vector<uint8_t> Bitmap::ConvertToRowMajorArray() const {
-  std::vector<uint8_t> array(width_ * height_ * channels_);
-  size_t i = 0;
+  const size_t row_size = static_cast<size_t>(width_) * channels_;
+  std::vector<uint8_t> array(row_size * height_);
   for (int y = 0; y < height_; ++y) {
     const uint8_t* line = FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
-    for (int x = 0; x < width_; ++x) {
-      for (int d = 0; d < channels_; ++d) {
-        array[i] = line[x * channels_ + d];
-        i += 1;
-      }
-    }
+    std::copy(line, line + row_size, array.data() + y * row_size);
   }
   return array;
 }
@@ -284,6 +279,20 @@ const uint8_t* Bitmap::GetScanline(const int y) const {
   return FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
 }
 
+uint8_t* Bitmap::GetScanline(const int y) {
+  THROW_CHECK_GE(y, 0);
+  THROW_CHECK_LT(y, height_);
+  return FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
+}
+
+span<const uint8_t> Bitmap::GetRow(const int y) const {
+  return {GetScanline(y), static_cast<size_t>(width_) * channels_};
+}
+
+span<uint8_t> Bitmap::GetRow(const int y) {
+  return {GetScanline(y), static_cast<size_t>(width_) * channels_};
+}
+
 void Bitmap::Fill(const BitmapColor<uint8_t>& color) {
   for (int y = 0; y < height_; ++y) {
     uint8_t* line = FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
@@ -366,6 +375,68 @@ bool Bitmap::InterpolateBilinear(const double x,
   return false;
 }
 
+void Bitmap::InterpolateBilinear(const span<const Eigen::Vector2d> xy,
+                                 span<BitmapColor<float>> colors,
+                                 span<char> mask) const {
+  THROW_CHECK_EQ(xy.size(), colors.size());
+  THROW_CHECK_EQ(xy.size(), mask.size());
+
+  // The scanlines are consecutive with the pitch as stride, such that the
+  // pixels are addressed without a FreeImage call per position.
+  const uint8_t* bits = FreeImage_GetBits(handle_.ptr);
+  const size_t pitch = Pitch();
+  const bool is_grey = IsGrey();
+  const bool is_rgb = IsRGB();
+
+  for (size_t i = 0; i < xy.size(); ++i) {
+    colors[i] = BitmapColor<float>(0);
+    mask[i] = false;
+
+    // FreeImage's coordinate system origin is in the lower left of the image.
+    const double x = xy[i].x();
+    const double inv_y = height_ - 1 - xy[i].y();
+
+    const int x0 = static_cast<int>(std::floor(x));
+    const int x1 = x0 + 1;
+    const int y0 = static_cast<int>(std::floor(inv_y));
+    const int y1 = y0 + 1;
+
+    if (x0 < 0 || x1 >= width_ || y0 < 0 || y1 >= height_) {
+      continue;
+    }
+
+    const double dx = x - x0;
+    const double dy = inv_y - y0;
+    const double dx_1 = 1 - dx;
+    const double dy_1 = 1 - dy;
+
+    const uint8_t* line0 = bits + y0 * pitch;
+    const uint8_t* line1 = bits + y1 * pitch;
+
+    if (is_grey) {
+      const double v0 = dx_1 * line0[x0] + dx * line0[x1];
+      const double v1 = dx_1 * line1[x0] + dx * line1[x1];
+      colors[i] = BitmapColor<float>(dy_1 * v0 + dy * v1);
+      mask[i] = true;
+    } else if (is_rgb) {
+      const uint8_t* p00 = &line0[3 * x0];
+      const uint8_t* p01 = &line0[3 * x1];
+      const uint8_t* p10 = &line1[3 * x0];
+      const uint8_t* p11 = &line1[3 * x1];
+      const double v0_r = dx_1 * p00[FI_RGBA_RED] + dx * p01[FI_RGBA_RED];
+      const double v0_g = dx_1 * p00[FI_RGBA_GREEN] + dx * p01[FI_RGBA_GREEN];
+      const double v0_b = dx_1 * p00[FI_RGBA_BLUE] + dx * p01[FI_RGBA_BLUE];
+      const double v1_r = dx_1 * p10[FI_RGBA_RED] + dx * p11[FI_RGBA_RED];
+      const double v1_g = dx_1 * p10[FI_RGBA_GREEN] + dx * p11[FI_RGBA_GREEN];
+      const double v1_b = dx_1 * p10[FI_RGBA_BLUE] + dx * p11[FI_RGBA_BLUE];
+      colors[i] = BitmapColor<float>(dy_1 * v0_r + dy * v1_r,
+                                     dy_1 * v0_g + dy * v1_g,
+                                     dy_1 * v0_b + dy * v1_b);
+      mask[i] = true;
+    }
+  }
+}
+
 bool Bitmap::ExifCameraModel(std::string* camera_model) const {
   // Read camera make and model
   std::string make_str;
@@ -558,7 +629,9 @@ bool Bitmap::ExifAltitude(double* altitude) const {
   return false;
 }
 
-bool Bitmap::Read(const std::string& path, const bool as_rgb) {
+bool Bitmap::Read(const std::string& path,
+                  const bool as_rgb,
+                  const int min_image_size) {
   if (!ExistsFile(path)) {
     return false;
   }
@@ -569,7 +642,15 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
     return false;
   }
 
-  handle_ = FreeImageHandle(FreeImage_Load(format, path.c_str()));
+  // The JPEG plugin decodes at a reduced resolution, if the requested size is
+  // passed in the upper 16 bits of the flags, and stores the original size in
+  // the comments metadata.
+  int flags = 0;
+  if (format == FIF_JPEG && min_image_size > 0) {
+    flags = std::min(min_image_size, 0xFFFF) << 16;
+  }
+
+  handle_ = FreeImageHandle(FreeImage_Load(format, path.c_str(), flags));
   if (handle_.ptr == nullptr) {
     return false;
   }
@@ -594,6 +675,51 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
   return true;
 }
 
+bool Bitmap::ReadHeader(const std::string& path) {
+  if (!ExistsFile(path)) {
+    return false;
+  }
+
+  const FREE_IMAGE_FORMAT format = FreeImage_GetFileType(path.c_str(), 0);
+
+  if (format == FIF_UNKNOWN) {
+    return false;
+  }
+
+  // Plugins without header-only support ignore the flag and decode the pixels.
+  handle_ =
+      FreeImageHandle(FreeImage_Load(format, path.c_str(), FIF_LOAD_NOPIXELS));
+  if (handle_.ptr == nullptr) {
+    return false;
+  }
+
+  width_ = FreeImage_GetWidth(handle_.ptr);
+  height_ = FreeImage_GetHeight(handle_.ptr);
+  channels_ = IsPtrGrey(handle_.ptr) ? 1 : 3;
+
+  return true;
+}
+
+bool Bitmap::HasPixels() const {
+  return handle_.ptr != nullptr && FreeImage_HasPixels(handle_.ptr);
+}
+
+bool Bitmap::OriginalSize(int* width, int* height) const {
+  THROW_CHECK_NOTNULL(width);
+  THROW_CHECK_NOTNULL(height);
+  std::string width_str;
+  std::string height_str;
+  if (handle_.ptr == nullptr ||
+      !ReadExifTag(handle_.ptr, FIMD_COMMENTS, "OriginalJPEGWidth", &width_str) ||
+      !ReadExifTag(
+          handle_.ptr, FIMD_COMMENTS, "OriginalJPEGHeight", &height_str)) {
+    return false;
+  }
+  *width = std::stoi(width_str);
+  *height = std::stoi(height_str);
+  return true;
+}
+
 bool Bitmap::Write(const std::string& path, const int flags) const {
   FREE_IMAGE_FORMAT save_format = FreeImage_GetFIFFromFilename(path.c_str());
   if (save_format == FIF_UNKNOWN) {
@@ -618,6 +744,25 @@ bool Bitmap::Write(const std::string& path, const int flags) const {
   return success;
 }
 
+bool Bitmap::Write(const std::string& path,
+                   const int jpeg_quality,
+                   const int png_compression_level) const {
+  const FREE_IMAGE_FORMAT save_format =
+      FreeImage_GetFIFFromFilename(path.c_str());
+  int flags = 0;
+  if (save_format == FIF_JPEG && jpeg_quality > 0) {
+    THROW_CHECK_LE(jpeg_quality, 100);
+    flags = jpeg_quality;
+  } else if ((save_format == FIF_PNG || save_format == FIF_UNKNOWN) &&
+             png_compression_level >= 0) {
+    THROW_CHECK_LE(png_compression_level, 9);
+    // A zero flag selects the default compression level.
+    flags = png_compression_level == 0 ? PNG_Z_NO_COMPRESSION
+                                       : png_compression_level;
+  }
+  return Write(path, flags);
+}
+
 void Bitmap::Smooth(const float sigma_x, const float sigma_y) {
   std::vector<float> array(width_ * height_);
   std::vector<float> array_smoothed(width_ * height_);
@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/util/string.h"
+#include "colmap/util/types.h"
 
 #include <algorithm>
 #include <cmath>
@@ -39,6 +40,8 @@
 #include <string>
 #include <vector>
 
+#include <Eigen/Core>
+
 struct FIBITMAP;
 
 namespace colmap {
@@ -129,6 +132,13 @@ class Bitmap {
 
   // Get pointer to y-th scanline, where the 0-th scanline is at the top.
   const uint8_t* GetScanline(int y) const;
+  uint8_t* GetScanline(int y);
+
+  // View of the Width() * Channels() pixel values of the y-th scanline without
+  // copying them, where the 0-th scanline is at the top. The values are in the
+  // channel order of FreeImage, i.e., BGR on little-endian platforms.
+  span<const uint8_t> GetRow(int y) const;
+  span<uint8_t> GetRow(int y);
 
   // Fill entire bitmap with uniform color. For grayscale images, the first
   // element of the vector is used.
@@ -140,6 +150,14 @@ class Bitmap {
                                   BitmapColor<uint8_t>* color) const;
   bool InterpolateBilinear(double x, double y, BitmapColor<float>* color) const;
 
+  // Interpolate the colors at many floating point positions at once, which
+  // gives the same colors as InterpolateBilinear but only resolves the pixel
+  // layout once. The mask is false for positions outside of the image, whose
+  // colors are zero. For grayscale images, all elements are the gray value.
+  void InterpolateBilinear(span<const Eigen::Vector2d> xy,
+                           span<BitmapColor<float>> colors,
+                           span<char> mask) const;
+
   // Extract EXIF information from bitmap. Returns false if no EXIF information
   // is embedded in the bitmap.
   bool ExifCameraModel(std::string* camera_model) const;
@@ -148,13 +166,40 @@ class Bitmap {
   bool ExifLongitude(double* longitude) const;
   bool ExifAltitude(double* altitude) const;
 
-  // Read bitmap at given path and convert to grey- or colorscale.
-  bool Read(const std::string& path, bool as_rgb = true);
+  // Read bitmap at given path and convert to grey- or colorscale. If
+  // min_image_size is positive, JPEG images are decoded at the lowest
+  // resolution of 1/2, 1/4, or 1/8 in the DCT domain, for which the maximum
+  // dimension is still at least min_image_size. This is much faster than
+  // decoding the full resolution and then down-sampling the image.
+  bool Read(const std::string& path,
+            bool as_rgb = true,
+            int min_image_size = -1);
+
+  // Read only the header of the image at the given path, i.e., its dimensions
+  // and EXIF metadata, without decoding the pixels. This is much faster than
+  // Read, if no pixel data is needed, e.g., to assign cameras. Afterwards,
+  // HasPixels is false and no pixel data must be accessed.
+  bool ReadHeader(const std::string& path);
+
+  // Whether the bitmap holds pixel data, i.e., it was not read by ReadHeader.
+  bool HasPixels() const;
+
+  // Dimensions of the image at full resolution, if it was decoded at a
+  // reduced resolution by Read. Returns false otherwise.
+  bool OriginalSize(int* width, int* height) const;
 
   // Write image to file. Flags can be used to set e.g. the JPEG quality.
   // Consult the FreeImage documentation for all available flags.
   bool Write(const std::string& path, int flags = 0) const;
 
+  // Write image to file with the given JPEG quality in the range [1, 100] or
+  // zlib compression level of PNG images in the range [0, 9], depending on
+  // the format of the path. Negative values use the defaults of Write. Lower
+  // quality and compression levels are much faster to encode.
+  bool Write(const std::string& path,
+             int jpeg_quality,
+             int png_compression_level) const;
+
   // Smooth the image using a Gaussian kernel.
   void Smooth(float sigma_x, float sigma_y);
 
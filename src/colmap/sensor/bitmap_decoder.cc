@@ -0,0 +1,687 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/sensor/bitmap_decoder.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/string.h"
+
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+#include <FreeImage.h>
+
+#if defined(COLMAP_JPEG_ENABLED)
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+#endif
+
+#if defined(COLMAP_NVJPEG_ENABLED)
+#include <cuda_runtime.h>
+#include <nvjpeg.h>
+#endif
+
+namespace colmap {
+namespace {
+
+// FreeImage stores color pixels in BGR order on little-endian machines.
+constexpr bool kBitmapIsBGR = FI_RGBA_RED == 2;
+
+bool ReadFileBytes(const std::string& path, std::vector<uint8_t>* data) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    return false;
+  }
+  const std::streamsize num_bytes = file.tellg();
+  if (num_bytes <= 0) {
+    return false;
+  }
+  data->resize(num_bytes);
+  file.seekg(0, std::ios::beg);
+  return static_cast<bool>(
+      file.read(reinterpret_cast<char*>(data->data()), num_bytes));
+}
+
+// Check for the start of image marker of JPEG files.
+bool IsJPEGData(const std::vector<uint8_t>& data) {
+  return data.size() > 3 && data[0] == 0xFF && data[1] == 0xD8 &&
+         data[2] == 0xFF;
+}
+
+// Pixel data decoded without FreeImage lacks the EXIF metadata, which is
+// needed to extract the camera intrinsics. Only read the metadata from the
+// file header without decoding the pixels again.
+void ReadJPEGMetadata(const std::string& path, Bitmap* bitmap) {
+#ifdef FIF_LOAD_NOPIXELS
+  FIBITMAP* header = FreeImage_Load(FIF_JPEG, path.c_str(), FIF_LOAD_NOPIXELS);
+  if (header != nullptr) {
+    FreeImage_CloneMetadata(bitmap->Data(), header);
+    FreeImage_Unload(header);
+  }
+#else
+  Bitmap header;
+  if (header.Read(path, bitmap->IsRGB())) {
+    header.CloneMetadata(bitmap);
+  }
+#endif
+}
+
+// Store the full resolution of a JPEG decoded at a reduced resolution in the
+// same way as FreeImage, see Bitmap::OriginalSize.
+void SetOriginalSize(const int width, const int height, Bitmap* bitmap) {
+  for (const auto& [key, value] :
+       {std::make_pair("OriginalJPEGWidth", std::to_string(width)),
+        std::make_pair("OriginalJPEGHeight", std::to_string(height))}) {
+    FITAG* tag = FreeImage_CreateTag();
+    if (tag == nullptr) {
+      continue;
+    }
+    FreeImage_SetTagKey(tag, key);
+    FreeImage_SetTagLength(tag, value.size() + 1);
+    FreeImage_SetTagCount(tag, value.size() + 1);
+    FreeImage_SetTagType(tag, FIDT_ASCII);
+    FreeImage_SetTagValue(tag, value.c_str());
+    FreeImage_SetMetadata(FIMD_COMMENTS, bitmap->Data(), key, tag);
+    FreeImage_DeleteTag(tag);
+  }
+}
+
+// Copy the pixels of a bitmap into a top-down, tightly packed RGB buffer.
+bool CopyBitmapToBuffer(const Bitmap& bitmap,
+                        const DecodedImageAllocator& allocator,
+                        DecodedImage* image) {
+  image->width = bitmap.Width();
+  image->height = bitmap.Height();
+  image->channels = bitmap.Channels();
+  image->pitch = static_cast<size_t>(image->width) * image->channels;
+  image->data = allocator(image->pitch * image->height);
+  if (image->data == nullptr) {
+    return false;
+  }
+  for (int y = 0; y < image->height; ++y) {
+    const uint8_t* line = bitmap.GetScanline(y);
+    uint8_t* row = image->data + y * image->pitch;
+    if (image->channels == 1) {
+      std::memcpy(row, line, image->pitch);
+    } else {
+      for (int x = 0; x < image->width; ++x) {
+        row[3 * x] = line[3 * x + FI_RGBA_RED];
+        row[3 * x + 1] = line[3 * x + FI_RGBA_GREEN];
+        row[3 * x + 2] = line[3 * x + FI_RGBA_BLUE];
+      }
+    }
+  }
+  return true;
+}
+
+class FreeImageBitmapDecoder : public BitmapDecoder {
+ public:
+  bool Decode(const std::string& path,
+              bool as_rgb,
+              int min_image_size,
+              Bitmap* bitmap) override {
+    return bitmap->Read(path, as_rgb, min_image_size);
+  }
+};
+
+#if defined(COLMAP_JPEG_ENABLED)
+
+struct JPEGErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf setjmp_buffer;
+};
+
+void JPEGErrorExit(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JPEGErrorManager*>(cinfo->err)->setjmp_buffer, 1);
+}
+
+// Warnings about corrupt data are reported through the return value.
+void JPEGOutputMessage(j_common_ptr) {}
+
+// Decode JPEG data, where prepare is called with the image and output
+// dimensions before decoding and row_ptr returns the destination of the y-th
+// row from the top. If min_image_size is positive, the image is decoded at the
+// same reduced resolution as chosen by FreeImage in Bitmap::Read. Note that no
+// objects with non-trivial destructors may live in this function due to the
+// longjmp error handling of libjpeg.
+bool DecodeJPEG(const std::vector<uint8_t>& data,
+                const bool as_rgb,
+                const bool as_bgr,
+                const int min_image_size,
+                const std::function<bool(int, int, int, int)>& prepare,
+                const std::function<uint8_t*(int)>& row_ptr) {
+  jpeg_decompress_struct cinfo;
+  JPEGErrorManager error_manager;
+  cinfo.err = jpeg_std_error(&error_manager.pub);
+  error_manager.pub.error_exit = JPEGErrorExit;
+  error_manager.pub.output_message = JPEGOutputMessage;
+  if (setjmp(error_manager.setjmp_buffer)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo,
+               const_cast<unsigned char*>(data.data()),
+               static_cast<unsigned long>(data.size()));
+  if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  bool swap_red_blue = false;
+  if (as_rgb) {
+#ifdef JCS_EXTENSIONS
+    cinfo.out_color_space = as_bgr ? JCS_EXT_BGR : JCS_RGB;
+#else
+    cinfo.out_color_space = JCS_RGB;
+    swap_red_blue = as_bgr;
+#endif
+  } else {
+    cinfo.out_color_space = JCS_GRAYSCALE;
+  }
+
+  if (min_image_size > 0) {
+    const double scale =
+        static_cast<double>(std::max(cinfo.image_width, cinfo.image_height)) /
+        min_image_size;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale >= 8 ? 8 : (scale >= 4 ? 4 : (scale >= 2 ? 2 : 1));
+  }
+
+  jpeg_start_decompress(&cinfo);
+  if (!prepare(cinfo.image_width,
+               cinfo.image_height,
+               cinfo.output_width,
+               cinfo.output_height)) {
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = row_ptr(cinfo.output_scanline);
+    jpeg_read_scanlines(&cinfo, &row, 1);
+    if (swap_red_blue) {
+      for (JDIMENSION x = 0; x < cinfo.output_width; ++x) {
+        std::swap(row[3 * x], row[3 * x + 2]);
+      }
+    }
+  }
+
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+// Decodes JPEG images with libjpeg(-turbo) directly into the memory of the
+// bitmap, which avoids the intermediate FreeImage bitmap and the subsequent
+// 24 bit or grayscale conversion.
+class LibJPEGBitmapDecoder : public BitmapDecoder {
+ public:
+  bool Decode(const std::string& path,
+              bool as_rgb,
+              int min_image_size,
+              Bitmap* bitmap) override {
+    std::vector<uint8_t> data;
+    if (!ReadFileBytes(path, &data)) {
+      return false;
+    }
+    if (!IsJPEGData(data)) {
+      return bitmap->Read(path, as_rgb, min_image_size);
+    }
+
+    int width = 0;
+    int height = 0;
+    int output_height = 0;
+    const bool success = DecodeJPEG(
+        data,
+        as_rgb,
+        kBitmapIsBGR,
+        min_image_size,
+        [&](const int image_width,
+            const int image_height,
+            const int output_width,
+            const int decoded_height) {
+          width = image_width;
+          height = image_height;
+          output_height = decoded_height;
+          return bitmap->Allocate(output_width, output_height, as_rgb);
+        },
+        [&](const int y) {
+          return FreeImage_GetScanLine(bitmap->Data(), output_height - 1 - y);
+        });
+    if (!success) {
+      // Unsupported JPEG variants, e.g., CMYK, are decoded by FreeImage.
+      return bitmap->Read(path, as_rgb, min_image_size);
+    }
+
+    ReadJPEGMetadata(path, bitmap);
+    if (bitmap->Width() != width || bitmap->Height() != height) {
+      SetOriginalSize(width, height, bitmap);
+    }
+    return true;
+  }
+
+  bool DecodeToBuffer(const std::string& path,
+                      bool as_rgb,
+                      const DecodedImageAllocator& allocator,
+                      DecodedImage* image) override {
+    std::vector<uint8_t> data;
+    if (!ReadFileBytes(path, &data)) {
+      return false;
+    }
+    if (!IsJPEGData(data)) {
+      return BitmapDecoder::DecodeToBuffer(path, as_rgb, allocator, image);
+    }
+
+    const int channels = as_rgb ? 3 : 1;
+    const bool success = DecodeJPEG(
+        data,
+        as_rgb,
+        /*as_bgr=*/false,
+        /*min_image_size=*/-1,
+        [&](int, int, const int width, const int height) {
+          image->width = width;
+          image->height = height;
+          image->channels = channels;
+          image->pitch = static_cast<size_t>(width) * channels;
+          image->data = allocator(image->pitch * height);
+          return image->data != nullptr;
+        },
+        [&](const int y) { return image->data + y * image->pitch; });
+    if (!success && image->data == nullptr) {
+      return BitmapDecoder::DecodeToBuffer(path, as_rgb, allocator, image);
+    }
+    return success;
+  }
+};
+
+#endif  // COLMAP_JPEG_ENABLED
+
+#if defined(COLMAP_NVJPEG_ENABLED)
+
+#define NVJPEG_SAFE_CALL(call) THROW_CHECK_EQ((call), NVJPEG_STATUS_SUCCESS)
+#define NVJPEG_CUDA_SAFE_CALL(call) THROW_CHECK_EQ((call), cudaSuccess)
+
+// Decodes batches of JPEG images on the GPU with nvJPEG. Images that nvJPEG
+// cannot decode are decoded on the CPU with FreeImage.
+class NvJPEGBitmapDecoder : public BitmapDecoder {
+ public:
+  NvJPEGBitmapDecoder() {
+    NVJPEG_SAFE_CALL(nvjpegCreateSimple(&handle_));
+    NVJPEG_SAFE_CALL(nvjpegJpegStateCreate(handle_, &state_));
+    NVJPEG_CUDA_SAFE_CALL(
+        cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking));
+  }
+
+  ~NvJPEGBitmapDecoder() {
+    cudaStreamDestroy(stream_);
+    nvjpegJpegStateDestroy(state_);
+    nvjpegDestroy(handle_);
+  }
+
+  bool Decode(const std::string& path,
+              bool as_rgb,
+              int min_image_size,
+              Bitmap* bitmap) override {
+    std::vector<Bitmap> bitmaps;
+    const bool success =
+        DecodeBatch({path}, as_rgb, min_image_size, &bitmaps).front();
+    *bitmap = std::move(bitmaps.front());
+    return success;
+  }
+
+  // nvJPEG cannot decode at a reduced resolution, so min_image_size is only
+  // used for images that are decoded on the CPU.
+  std::vector<bool> DecodeBatch(const std::vector<std::string>& paths,
+                                bool as_rgb,
+                                int min_image_size,
+                                std::vector<Bitmap>* bitmaps) override {
+    const int channels = as_rgb ? 3 : 1;
+    bitmaps->clear();
+    bitmaps->resize(paths.size());
+    std::vector<bool> success(paths.size(), false);
+
+    // Collect the images that can be decoded on the GPU.
+    std::vector<size_t> gpu_idxs;
+    std::vector<std::vector<uint8_t>> gpu_data;
+    std::vector<int> gpu_widths;
+    std::vector<int> gpu_heights;
+    for (size_t i = 0; i < paths.size(); ++i) {
+      std::vector<uint8_t> data;
+      if (!ReadFileBytes(paths[i], &data)) {
+        continue;
+      }
+      int num_components;
+      nvjpegChromaSubsampling_t subsampling;
+      int widths[NVJPEG_MAX_COMPONENT];
+      int heights[NVJPEG_MAX_COMPONENT];
+      if (!IsJPEGData(data) ||
+          nvjpegGetImageInfo(handle_,
+                             data.data(),
+                             data.size(),
+                             &num_components,
+                             &subsampling,
+                             widths,
+                             heights) != NVJPEG_STATUS_SUCCESS ||
+          subsampling == NVJPEG_CSS_UNKNOWN) {
+        success[i] = (*bitmaps)[i].Read(paths[i], as_rgb, min_image_size);
+        continue;
+      }
+      gpu_idxs.push_back(i);
+      gpu_data.push_back(std::move(data));
+      gpu_widths.push_back(widths[0]);
+      gpu_heights.push_back(heights[0]);
+    }
+
+    if (gpu_idxs.empty()) {
+      return success;
+    }
+
+    const int batch_size = gpu_idxs.size();
+    std::vector<const unsigned char*> data_ptrs(batch_size);
+    std::vector<size_t> data_sizes(batch_size);
+    std::vector<nvjpegImage_t> outputs(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+      data_ptrs[i] = gpu_data[i].data();
+      data_sizes[i] = gpu_data[i].size();
+      std::memset(&outputs[i], 0, sizeof(nvjpegImage_t));
+      outputs[i].pitch[0] = static_cast<unsigned int>(gpu_widths[i] * channels);
+      NVJPEG_CUDA_SAFE_CALL(
+          cudaMalloc(reinterpret_cast<void**>(&outputs[i].channel[0]),
+                     outputs[i].pitch[0] * gpu_heights[i]));
+    }
+
+    const nvjpegOutputFormat_t output_format =
+        as_rgb ? (kBitmapIsBGR ? NVJPEG_OUTPUT_BGRI : NVJPEG_OUTPUT_RGBI)
+               : NVJPEG_OUTPUT_Y;
+
+    bool batch_success = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      batch_success =
+          nvjpegDecodeBatchedInitialize(handle_,
+                                        state_,
+                                        batch_size,
+                                        /*max_cpu_threads=*/1,
+                                        output_format) ==
+              NVJPEG_STATUS_SUCCESS &&
+          nvjpegDecodeBatched(handle_,
+                              state_,
+                              data_ptrs.data(),
+                              data_sizes.data(),
+                              outputs.data(),
+                              stream_) == NVJPEG_STATUS_SUCCESS &&
+          cudaStreamSynchronize(stream_) == cudaSuccess;
+    }
+
+    std::vector<uint8_t> host_buffer;
+    for (int i = 0; i < batch_size; ++i) {
+      const size_t idx = gpu_idxs[i];
+      Bitmap& bitmap = (*bitmaps)[idx];
+      const int width = gpu_widths[i];
+      const int height = gpu_heights[i];
+      const size_t pitch = outputs[i].pitch[0];
+      host_buffer.resize(pitch * height);
+      if (batch_success && bitmap.Allocate(width, height, as_rgb) &&
+          cudaMemcpy(host_buffer.data(),
+                     outputs[i].channel[0],
+                     host_buffer.size(),
+                     cudaMemcpyDeviceToHost) == cudaSuccess) {
+        // Bitmap rows are stored bottom-up, so copy them one by one.
+        for (int y = 0; y < height; ++y) {
+          std::memcpy(FreeImage_GetScanLine(bitmap.Data(), height - 1 - y),
+                      host_buffer.data() + y * pitch,
+                      pitch);
+        }
+        ReadJPEGMetadata(paths[idx], &bitmap);
+        success[idx] = true;
+      } else {
+        success[idx] = bitmap.Read(paths[idx], as_rgb, min_image_size);
+      }
+      cudaFree(outputs[i].channel[0]);
+    }
+
+    return success;
+  }
+
+  bool DecodeToBuffer(const std::string& path,
+                      bool as_rgb,
+                      const DecodedImageAllocator& allocator,
+                      DecodedImage* image) override {
+    std::vector<uint8_t> data;
+    if (!ReadFileBytes(path, &data)) {
+      return false;
+    }
+
+    const int channels = as_rgb ? 3 : 1;
+    int num_components;
+    nvjpegChromaSubsampling_t subsampling;
+    int widths[NVJPEG_MAX_COMPONENT];
+    int heights[NVJPEG_MAX_COMPONENT];
+    if (IsJPEGData(data) &&
+        nvjpegGetImageInfo(handle_,
+                           data.data(),
+                           data.size(),
+                           &num_components,
+                           &subsampling,
+                           widths,
+                           heights) == NVJPEG_STATUS_SUCCESS &&
+        subsampling != NVJPEG_CSS_UNKNOWN) {
+      image->width = widths[0];
+      image->height = heights[0];
+      image->channels = channels;
+      image->pitch = static_cast<size_t>(image->width) * channels;
+      image->data = allocator(image->pitch * image->height);
+      if (image->data == nullptr) {
+        return false;
+      }
+      nvjpegImage_t output;
+      std::memset(&output, 0, sizeof(nvjpegImage_t));
+      output.channel[0] = image->data;
+      output.pitch[0] = static_cast<unsigned int>(image->pitch);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (nvjpegDecode(handle_,
+                       state_,
+                       data.data(),
+                       data.size(),
+                       as_rgb ? NVJPEG_OUTPUT_RGBI : NVJPEG_OUTPUT_Y,
+                       &output,
+                       stream_) == NVJPEG_STATUS_SUCCESS &&
+          cudaStreamSynchronize(stream_) == cudaSuccess) {
+        return true;
+      }
+    }
+
+    // Decode on the CPU and upload the pixels into the device buffer.
+    std::vector<uint8_t> host_buffer;
+    DecodedImage host_image;
+    if (!BitmapDecoder::DecodeToBuffer(
+            path,
+            as_rgb,
+            [&host_buffer](const size_t num_bytes) {
+              host_buffer.resize(num_bytes);
+              return host_buffer.data();
+            },
+            &host_image)) {
+      return false;
+    }
+    if (image->data == nullptr) {
+      image->data = allocator(host_buffer.size());
+      if (image->data == nullptr) {
+        return false;
+      }
+    }
+    image->width = host_image.width;
+    image->height = host_image.height;
+    image->channels = host_image.channels;
+    image->pitch = host_image.pitch;
+    return cudaMemcpy(image->data,
+                      host_buffer.data(),
+                      host_buffer.size(),
+                      cudaMemcpyHostToDevice) == cudaSuccess;
+  }
+
+  bool OutputsDeviceMemory() const override { return true; }
+
+ private:
+  nvjpegHandle_t handle_;
+  nvjpegJpegState_t state_;
+  cudaStream_t stream_;
+  // The decoder state can only be used by one thread at a time.
+  std::mutex mutex_;
+};
+
+#endif  // COLMAP_NVJPEG_ENABLED
+
+}  // namespace
+
+std::string BitmapDecoderTypeToString(const BitmapDecoderType type) {
+  switch (type) {
+    case BitmapDecoderType::FREEIMAGE:
+      return "freeimage";
+    case BitmapDecoderType::LIBJPEG:
+      return "libjpeg";
+    case BitmapDecoderType::NVJPEG:
+      return "nvjpeg";
+  }
+  return "";
+}
+
+BitmapDecoderType BitmapDecoderTypeFromString(const std::string& name) {
+  std::string lower_name = name;
+  StringToLower(&lower_name);
+  for (const BitmapDecoderType type : {BitmapDecoderType::FREEIMAGE,
+                                       BitmapDecoderType::LIBJPEG,
+                                       BitmapDecoderType::NVJPEG}) {
+    if (lower_name == BitmapDecoderTypeToString(type)) {
+      return type;
+    }
+  }
+  throw std::invalid_argument(
+      StringPrintf("Unknown bitmap decoder: %s", name.c_str()));
+}
+
+bool ExistsBitmapDecoderWithName(const std::string& name) {
+  try {
+    BitmapDecoderTypeFromString(name);
+    return true;
+  } catch (const std::invalid_argument&) {
+    return false;
+  }
+}
+
+bool IsBitmapDecoderAvailable(const BitmapDecoderType type) {
+  switch (type) {
+    case BitmapDecoderType::FREEIMAGE:
+      return true;
+    case BitmapDecoderType::LIBJPEG:
+#if defined(COLMAP_JPEG_ENABLED)
+      return true;
+#else
+      return false;
+#endif
+    case BitmapDecoderType::NVJPEG: {
+#if defined(COLMAP_NVJPEG_ENABLED)
+      int num_devices = 0;
+      return cudaGetDeviceCount(&num_devices) == cudaSuccess &&
+             num_devices > 0;
+#else
+      return false;
+#endif
+    }
+  }
+  return false;
+}
+
+std::vector<bool> BitmapDecoder::DecodeBatch(
+    const std::vector<std::string>& paths,
+    const bool as_rgb,
+    const int min_image_size,
+    std::vector<Bitmap>* bitmaps) {
+  THROW_CHECK_NOTNULL(bitmaps);
+  bitmaps->clear();
+  bitmaps->resize(paths.size());
+  std::vector<bool> success(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    success[i] = Decode(paths[i], as_rgb, min_image_size, &(*bitmaps)[i]);
+  }
+  return success;
+}
+
+bool BitmapDecoder::DecodeToBuffer(const std::string& path,
+                                   const bool as_rgb,
+                                   const DecodedImageAllocator& allocator,
+                                   DecodedImage* image) {
+  THROW_CHECK_NOTNULL(image);
+  Bitmap bitmap;
+  if (!bitmap.Read(path, as_rgb)) {
+    return false;
+  }
+  return CopyBitmapToBuffer(bitmap, allocator, image);
+}
+
+std::unique_ptr<BitmapDecoder> CreateBitmapDecoder(
+    const BitmapDecoderType type) {
+  THROW_CHECK(IsBitmapDecoderAvailable(type))
+      << "Bitmap decoder " << BitmapDecoderTypeToString(type)
+      << " is not available";
+  switch (type) {
+    case BitmapDecoderType::FREEIMAGE:
+      return std::make_unique<FreeImageBitmapDecoder>();
+#if defined(COLMAP_JPEG_ENABLED)
+    case BitmapDecoderType::LIBJPEG:
+      return std::make_unique<LibJPEGBitmapDecoder>();
+#endif
+#if defined(COLMAP_NVJPEG_ENABLED)
+    case BitmapDecoderType::NVJPEG:
+      return std::make_unique<NvJPEGBitmapDecoder>();
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+std::unique_ptr<BitmapDecoder> CreateBitmapDecoder(const std::string& name) {
+  return CreateBitmapDecoder(BitmapDecoderTypeFromString(name));
+}
+
+}  // namespace colmap
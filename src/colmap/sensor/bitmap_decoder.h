@@ -0,0 +1,121 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/sensor/bitmap.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// The available image decoding backends. FreeImage supports all image formats
+// and is always available, while the other backends only decode JPEG images
+// and fall back to FreeImage for all other formats.
+enum class BitmapDecoderType {
+  // Decode all images with FreeImage, as in Bitmap::Read.
+  FREEIMAGE,
+  // Decode JPEG images with libjpeg(-turbo) straight into the bitmap memory.
+  LIBJPEG,
+  // Decode JPEG images on the GPU with nvJPEG.
+  NVJPEG,
+};
+
+// Convert the decoder type to/from its lower-case name, e.g., "libjpeg".
+std::string BitmapDecoderTypeToString(BitmapDecoderType type);
+BitmapDecoderType BitmapDecoderTypeFromString(const std::string& name);
+
+// Whether there exists a decoder with the given name.
+bool ExistsBitmapDecoderWithName(const std::string& name);
+
+// Whether the decoder was compiled in and can be used on this machine.
+bool IsBitmapDecoderAvailable(BitmapDecoderType type);
+
+// Decoded pixels in a buffer that was allocated by the caller. The rows are
+// stored top to bottom with the pixels interleaved in RGB order for color and
+// as a single channel for grayscale images.
+struct DecodedImage {
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  // Number of bytes between the start of two consecutive rows.
+  size_t pitch = 0;
+  uint8_t* data = nullptr;
+};
+
+// Allocate a buffer with the given number of bytes for the decoded pixels,
+// e.g., in pinned host memory through cudaMallocHost or in device memory
+// through cudaMalloc. The buffer is owned by the caller.
+using DecodedImageAllocator = std::function<uint8_t*(size_t num_bytes)>;
+
+// Interface of the image decoding backends. All methods are thread-safe, such
+// that a single decoder can be shared by concurrent readers.
+class BitmapDecoder {
+ public:
+  virtual ~BitmapDecoder() = default;
+
+  // Decode the image at the given path into the bitmap and convert it to
+  // grey- or colorscale, analogous to Bitmap::Read. EXIF metadata is preserved.
+  // Note that the JPEG decoders return the luma channel as grayscale, which
+  // slightly differs from the grayscale conversion of FreeImage. If
+  // min_image_size is positive, JPEG images may be decoded at a reduced
+  // resolution, see Bitmap::Read and Bitmap::OriginalSize.
+  virtual bool Decode(const std::string& path,
+                      bool as_rgb,
+                      int min_image_size,
+                      Bitmap* bitmap) = 0;
+
+  // Decode multiple images at once. Backends that benefit from batching, e.g.,
+  // on the GPU, override this method. Returns whether each image succeeded.
+  virtual std::vector<bool> DecodeBatch(const std::vector<std::string>& paths,
+                                        bool as_rgb,
+                                        int min_image_size,
+                                        std::vector<Bitmap>* bitmaps);
+
+  // Decode the pixels of an image into a buffer from the given allocator
+  // without going through a bitmap. EXIF metadata is not decoded. If
+  // OutputsDeviceMemory is true, the allocator must return device memory.
+  virtual bool DecodeToBuffer(const std::string& path,
+                              bool as_rgb,
+                              const DecodedImageAllocator& allocator,
+                              DecodedImage* image);
+
+  // Whether DecodeToBuffer writes to device instead of host memory.
+  virtual bool OutputsDeviceMemory() const { return false; }
+};
+
+// Create the decoder of the given type. Throws if the decoder is unavailable.
+std::unique_ptr<BitmapDecoder> CreateBitmapDecoder(BitmapDecoderType type);
+std::unique_ptr<BitmapDecoder> CreateBitmapDecoder(const std::string& name);
+
+}  // namespace colmap
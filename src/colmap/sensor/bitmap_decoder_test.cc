@@ -0,0 +1,216 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/sensor/bitmap_decoder.h"
+
+#include "colmap/util/testing.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+// The JPEG decoders return the luma channel for grayscale, which differs from
+// the grayscale conversion of color images by FreeImage, so the grayscale
+// tests use grayscale images.
+Bitmap CreateTestBitmap(const bool as_rgb) {
+  Bitmap bitmap;
+  bitmap.Allocate(64, 48, as_rgb);
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    for (int x = 0; x < bitmap.Width(); ++x) {
+      bitmap.SetPixel(x, y, BitmapColor<uint8_t>(4 * x, 5 * y, 2 * (x + y)));
+    }
+  }
+  return bitmap;
+}
+
+void ExpectEqualBitmaps(const Bitmap& bitmap1,
+                        const Bitmap& bitmap2,
+                        const int max_diff) {
+  ASSERT_EQ(bitmap1.Width(), bitmap2.Width());
+  ASSERT_EQ(bitmap1.Height(), bitmap2.Height());
+  ASSERT_EQ(bitmap1.Channels(), bitmap2.Channels());
+  const std::vector<uint8_t> array1 = bitmap1.ConvertToRowMajorArray();
+  const std::vector<uint8_t> array2 = bitmap2.ConvertToRowMajorArray();
+  for (size_t i = 0; i < array1.size(); ++i) {
+    EXPECT_LE(std::abs(array1[i] - array2[i]), max_diff);
+  }
+}
+
+TEST(BitmapDecoder, TypeToFromString) {
+  for (const BitmapDecoderType type : {BitmapDecoderType::FREEIMAGE,
+                                       BitmapDecoderType::LIBJPEG,
+                                       BitmapDecoderType::NVJPEG}) {
+    EXPECT_EQ(BitmapDecoderTypeFromString(BitmapDecoderTypeToString(type)),
+              type);
+  }
+  EXPECT_EQ(BitmapDecoderTypeFromString("LibJPEG"),
+            BitmapDecoderType::LIBJPEG);
+  EXPECT_TRUE(ExistsBitmapDecoderWithName("freeimage"));
+  EXPECT_FALSE(ExistsBitmapDecoderWithName("invalid"));
+  EXPECT_ANY_THROW(BitmapDecoderTypeFromString("invalid"));
+  EXPECT_TRUE(IsBitmapDecoderAvailable(BitmapDecoderType::FREEIMAGE));
+}
+
+TEST(BitmapDecoder, Decode) {
+  const std::string test_dir = CreateTestDir();
+
+  for (const BitmapDecoderType type : {BitmapDecoderType::FREEIMAGE,
+                                       BitmapDecoderType::LIBJPEG,
+                                       BitmapDecoderType::NVJPEG}) {
+    if (!IsBitmapDecoderAvailable(type)) {
+      continue;
+    }
+    std::unique_ptr<BitmapDecoder> decoder = CreateBitmapDecoder(type);
+    for (const bool as_rgb : {true, false}) {
+      const std::string png_path = test_dir + "/bitmap.png";
+      const std::string jpg_path = test_dir + "/bitmap.jpg";
+      const Bitmap bitmap = CreateTestBitmap(as_rgb);
+      ASSERT_TRUE(bitmap.Write(png_path));
+      ASSERT_TRUE(bitmap.Write(jpg_path));
+
+      Bitmap ref_png_bitmap;
+      ASSERT_TRUE(ref_png_bitmap.Read(png_path, as_rgb));
+      Bitmap ref_jpg_bitmap;
+      ASSERT_TRUE(ref_jpg_bitmap.Read(jpg_path, as_rgb));
+
+      // Other formats than JPEG fall back to FreeImage.
+      Bitmap png_bitmap;
+      EXPECT_TRUE(decoder->Decode(png_path, as_rgb, -1, &png_bitmap));
+      ExpectEqualBitmaps(png_bitmap, ref_png_bitmap, /*max_diff=*/0);
+
+      // The IDCT implementations may differ slightly across the decoders.
+      Bitmap jpg_bitmap;
+      EXPECT_TRUE(decoder->Decode(jpg_path, as_rgb, -1, &jpg_bitmap));
+      ExpectEqualBitmaps(jpg_bitmap, ref_jpg_bitmap, /*max_diff=*/2);
+
+      std::vector<Bitmap> bitmaps;
+      const std::vector<bool> success =
+          decoder->DecodeBatch({png_path, test_dir + "/missing.jpg", jpg_path},
+                               as_rgb,
+                               -1,
+                               &bitmaps);
+      ASSERT_EQ(success.size(), 3);
+      ASSERT_EQ(bitmaps.size(), 3);
+      EXPECT_TRUE(success[0]);
+      EXPECT_FALSE(success[1]);
+      EXPECT_TRUE(success[2]);
+      ExpectEqualBitmaps(bitmaps[0], ref_png_bitmap, /*max_diff=*/0);
+      ExpectEqualBitmaps(bitmaps[2], ref_jpg_bitmap, /*max_diff=*/2);
+    }
+  }
+}
+
+TEST(BitmapDecoder, DecodeAtReducedSize) {
+  const std::string test_dir = CreateTestDir();
+  const std::string jpg_path = test_dir + "/bitmap.jpg";
+  ASSERT_TRUE(CreateTestBitmap(/*as_rgb=*/true).Write(jpg_path));
+
+  // The CPU decoders reduce the resolution in the same way.
+  for (const BitmapDecoderType type :
+       {BitmapDecoderType::FREEIMAGE, BitmapDecoderType::LIBJPEG}) {
+    if (!IsBitmapDecoderAvailable(type)) {
+      continue;
+    }
+    std::unique_ptr<BitmapDecoder> decoder = CreateBitmapDecoder(type);
+    for (const int min_image_size : {8, 16, 20, 32, 48}) {
+      Bitmap ref_bitmap;
+      ASSERT_TRUE(ref_bitmap.Read(jpg_path, /*as_rgb=*/true, min_image_size));
+      Bitmap bitmap;
+      ASSERT_TRUE(
+          decoder->Decode(jpg_path, /*as_rgb=*/true, min_image_size, &bitmap));
+      EXPECT_GE(std::max(bitmap.Width(), bitmap.Height()), min_image_size);
+      EXPECT_EQ(bitmap.Width(), ref_bitmap.Width());
+      EXPECT_EQ(bitmap.Height(), ref_bitmap.Height());
+      int original_width = 0;
+      int original_height = 0;
+      EXPECT_EQ(bitmap.OriginalSize(&original_width, &original_height),
+                bitmap.Width() != 64);
+      if (bitmap.Width() != 64) {
+        EXPECT_EQ(original_width, 64);
+        EXPECT_EQ(original_height, 48);
+      }
+    }
+  }
+}
+
+TEST(BitmapDecoder, DecodeToBuffer) {
+  const std::string test_dir = CreateTestDir();
+
+  for (const BitmapDecoderType type :
+       {BitmapDecoderType::FREEIMAGE, BitmapDecoderType::LIBJPEG}) {
+    if (!IsBitmapDecoderAvailable(type)) {
+      continue;
+    }
+    std::unique_ptr<BitmapDecoder> decoder = CreateBitmapDecoder(type);
+    EXPECT_FALSE(decoder->OutputsDeviceMemory());
+    for (const bool as_rgb : {true, false}) {
+      const std::string jpg_path = test_dir + "/bitmap.jpg";
+      ASSERT_TRUE(CreateTestBitmap(as_rgb).Write(jpg_path));
+
+      Bitmap ref_bitmap;
+      ASSERT_TRUE(ref_bitmap.Read(jpg_path, as_rgb));
+
+      std::vector<uint8_t> buffer;
+      DecodedImage image;
+      ASSERT_TRUE(decoder->DecodeToBuffer(
+          jpg_path,
+          as_rgb,
+          [&buffer](const size_t num_bytes) {
+            buffer.resize(num_bytes);
+            return buffer.data();
+          },
+          &image));
+      EXPECT_EQ(image.data, buffer.data());
+      EXPECT_EQ(image.width, ref_bitmap.Width());
+      EXPECT_EQ(image.height, ref_bitmap.Height());
+      EXPECT_EQ(image.channels, ref_bitmap.Channels());
+      EXPECT_EQ(image.pitch, image.width * image.channels);
+      for (int y = 0; y < image.height; ++y) {
+        for (int x = 0; x < image.width; ++x) {
+          BitmapColor<uint8_t> color;
+          ASSERT_TRUE(ref_bitmap.GetPixel(x, y, &color));
+          const uint8_t* pixel =
+              image.data + y * image.pitch + x * image.channels;
+          EXPECT_LE(std::abs(pixel[0] - color.r), 2);
+          if (as_rgb) {
+            EXPECT_LE(std::abs(pixel[1] - color.g), 2);
+            EXPECT_LE(std::abs(pixel[2] - color.b), 2);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace colmap
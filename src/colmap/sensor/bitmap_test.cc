@@ -32,6 +32,7 @@
 #include "colmap/util/testing.h"
 
 #include <FreeImage.h>
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -336,6 +337,28 @@ TEST(Bitmap, GetScanlineGrey) {
   }
 }
 
+TEST(Bitmap, GetRow) {
+  Bitmap bitmap;
+  bitmap.Allocate(5, 3, true);
+  bitmap.Fill(BitmapColor<uint8_t>(0));
+  bitmap.SetPixel(4, 1, BitmapColor<uint8_t>(1, 2, 3));
+  const Bitmap& const_bitmap = bitmap;
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    const span<const uint8_t> row = const_bitmap.GetRow(y);
+    EXPECT_EQ(row.size(), 15);
+    EXPECT_EQ(row.begin(), const_bitmap.GetScanline(y));
+  }
+  const span<const uint8_t> row = const_bitmap.GetRow(1);
+  EXPECT_EQ(row[4 * 3 + FI_RGBA_RED], 1);
+  EXPECT_EQ(row[4 * 3 + FI_RGBA_GREEN], 2);
+  EXPECT_EQ(row[4 * 3 + FI_RGBA_BLUE], 3);
+  span<uint8_t> mutable_row = bitmap.GetRow(2);
+  mutable_row[FI_RGBA_BLUE] = 7;
+  BitmapColor<uint8_t> color;
+  EXPECT_TRUE(bitmap.GetPixel(0, 2, &color));
+  EXPECT_EQ(color, BitmapColor<uint8_t>(0, 0, 7));
+}
+
 TEST(Bitmap, Fill) {
   Bitmap bitmap;
   bitmap.Allocate(100, 100, true);
@@ -379,6 +402,46 @@ TEST(Bitmap, InterpolateBilinear) {
   EXPECT_EQ(color, BitmapColor<float>(0.25, 0.5, 0.75));
 }
 
+TEST(Bitmap, InterpolateBilinearBatch) {
+  for (const bool as_rgb : {true, false}) {
+    Bitmap bitmap;
+    bitmap.Allocate(11, 7, as_rgb);
+    for (int y = 0; y < bitmap.Height(); ++y) {
+      for (int x = 0; x < bitmap.Width(); ++x) {
+        bitmap.SetPixel(x, y, BitmapColor<uint8_t>(x + y, 2 * x, 3 * y));
+      }
+    }
+    const std::vector<Eigen::Vector2d> xy = {{5, 5},
+                                             {5.5, 2.25},
+                                             {0.1, 0.9},
+                                             {9.75, 5.5},
+                                             {-0.5, 1},
+                                             {10, 1},
+                                             {1, 6.5}};
+    std::vector<BitmapColor<float>> colors(xy.size());
+    std::vector<char> mask(xy.size());
+    bitmap.InterpolateBilinear({xy.data(), xy.size()},
+                               {colors.data(), colors.size()},
+                               {mask.data(), mask.size()});
+    for (size_t i = 0; i < xy.size(); ++i) {
+      BitmapColor<float> color;
+      const bool valid =
+          bitmap.InterpolateBilinear(xy[i].x(), xy[i].y(), &color);
+      EXPECT_EQ(mask[i], valid);
+      if (!valid) {
+        EXPECT_EQ(colors[i], BitmapColor<float>(0));
+      } else if (as_rgb) {
+        EXPECT_EQ(colors[i], color);
+      } else {
+        EXPECT_EQ(colors[i], BitmapColor<float>(color.r));
+      }
+    }
+    EXPECT_THAT(
+        mask,
+        testing::ElementsAre(true, true, true, true, false, false, false));
+  }
+}
+
 TEST(Bitmap, SmoothRGB) {
   Bitmap bitmap;
   bitmap.Allocate(50, 50, true);
@@ -551,5 +614,72 @@ TEST(Bitmap, ReadWriteAsGrey) {
             bitmap.ConvertToRowMajorArray());
 }
 
+TEST(Bitmap, ReadAtReducedSize) {
+  Bitmap bitmap;
+  bitmap.Allocate(100, 60, true);
+  bitmap.Fill(BitmapColor<uint8_t>(10, 20, 30));
+
+  const std::string test_dir = CreateTestDir();
+  const std::string jpg_path = test_dir + "/bitmap.jpg";
+  const std::string png_path = test_dir + "/bitmap.png";
+  EXPECT_TRUE(bitmap.Write(jpg_path));
+  EXPECT_TRUE(bitmap.Write(png_path));
+
+  int original_width;
+  int original_height;
+  Bitmap read_bitmap;
+  EXPECT_TRUE(read_bitmap.Read(jpg_path));
+  EXPECT_EQ(read_bitmap.Width(), 100);
+  EXPECT_EQ(read_bitmap.Height(), 60);
+  EXPECT_FALSE(read_bitmap.OriginalSize(&original_width, &original_height));
+
+  // Decoding at the lowest resolution which is still at least the given size.
+  EXPECT_TRUE(read_bitmap.Read(jpg_path, /*as_rgb=*/true, 30));
+  EXPECT_EQ(read_bitmap.Width(), 50);
+  EXPECT_EQ(read_bitmap.Height(), 30);
+  EXPECT_TRUE(read_bitmap.OriginalSize(&original_width, &original_height));
+  EXPECT_EQ(original_width, 100);
+  EXPECT_EQ(original_height, 60);
+
+  EXPECT_TRUE(read_bitmap.Read(jpg_path, /*as_rgb=*/false, 12));
+  EXPECT_EQ(read_bitmap.Width(), 13);
+  EXPECT_EQ(read_bitmap.Height(), 8);
+  EXPECT_TRUE(read_bitmap.OriginalSize(&original_width, &original_height));
+  EXPECT_EQ(original_width, 100);
+  EXPECT_EQ(original_height, 60);
+
+  // Other formats are always decoded at full resolution.
+  EXPECT_TRUE(read_bitmap.Read(png_path, /*as_rgb=*/true, 30));
+  EXPECT_EQ(read_bitmap.Width(), 100);
+  EXPECT_EQ(read_bitmap.Height(), 60);
+  EXPECT_FALSE(read_bitmap.OriginalSize(&original_width, &original_height));
+}
+
+TEST(Bitmap, ReadHeader) {
+  Bitmap bitmap;
+  bitmap.Allocate(100, 60, true);
+  bitmap.Fill(BitmapColor<uint8_t>(10, 20, 30));
+  EXPECT_TRUE(bitmap.HasPixels());
+
+  const std::string test_dir = CreateTestDir();
+  const std::string jpg_path = test_dir + "/bitmap.jpg";
+  const std::string png_path = test_dir + "/bitmap.png";
+  EXPECT_TRUE(bitmap.Write(jpg_path));
+  EXPECT_TRUE(bitmap.Write(png_path));
+
+  for (const auto& path : {jpg_path, png_path}) {
+    Bitmap header;
+    EXPECT_TRUE(header.ReadHeader(path));
+    EXPECT_EQ(header.Width(), 100);
+    EXPECT_EQ(header.Height(), 60);
+    EXPECT_TRUE(header.IsRGB());
+  }
+
+  Bitmap header;
+  EXPECT_TRUE(header.ReadHeader(jpg_path));
+  EXPECT_FALSE(header.HasPixels());
+  EXPECT_FALSE(header.ReadHeader(test_dir + "/missing.jpg"));
+}
+
 }  // namespace
 }  // namespace colmap
@@ -34,6 +34,7 @@
 
 #include <array>
 #include <cfloat>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -191,6 +192,15 @@ struct BaseCameraModel {
 
   template <typename T>
   static inline void IterativeUndistortion(const T* params, T* u, T* v);
+
+  // Transform all points with the model, whose functions are inlined into the
+  // loop, such that the compiler can vectorize it.
+  static inline void ImgFromCamBatch(const double* params,
+                                     span<const Eigen::Vector3d> uvw,
+                                     span<Eigen::Vector2d> xy);
+  static inline void CamFromImgBatch(const double* params,
+                                     span<const Eigen::Vector2d> xy,
+                                     span<Eigen::Vector3d> uvw);
 };
 
 // Simple Pinhole camera model.
@@ -473,6 +483,18 @@ inline Eigen::Vector3d CameraModelCamFromImg(CameraModelId model_id,
                                              const std::vector<double>& params,
                                              const Eigen::Vector2d& xy);
 
+// Batched versions of `CameraModelImgFromCam` and `CameraModelCamFromImg`,
+// which only dispatch on the camera model once for all points. The input and
+// output must have the same size.
+inline void CameraModelImgFromCam(CameraModelId model_id,
+                                  const std::vector<double>& params,
+                                  span<const Eigen::Vector3d> uvw,
+                                  span<Eigen::Vector2d> xy);
+inline void CameraModelCamFromImg(CameraModelId model_id,
+                                  const std::vector<double>& params,
+                                  span<const Eigen::Vector2d> xy,
+                                  span<Eigen::Vector3d> uvw);
+
 // Convert pixel threshold in image plane to camera space by dividing
 // the threshold through the mean focal length.
 //
@@ -569,37 +591,35 @@ template <typename T>
 void BaseCameraModel<CameraModel>::IterativeUndistortion(const T* params,
                                                          T* u,
                                                          T* v) {
-  // Parameters for Newton iteration using numerical differentiation with
-  // central differences, 100 iterations should be enough even for complex
-  // camera models with higher order terms.
+  // Parameters for Newton iteration. The Jacobian of the distortion is
+  // computed analytically using dual numbers, such that the iteration
+  // converges quadratically and usually terminates after a few steps. The
+  // maximum number of iterations only triggers for degenerate inputs.
   const size_t kNumIterations = 100;
   const double kMaxStepNorm = 1e-10;
-  const double kRelStepSize = 1e-6;
 
-  Eigen::Matrix2d J;
-  const Eigen::Vector2d x0(*u, *v);
-  Eigen::Vector2d x(*u, *v);
-  Eigen::Vector2d dx;
-  Eigen::Vector2d dx_0b;
-  Eigen::Vector2d dx_0f;
-  Eigen::Vector2d dx_1b;
-  Eigen::Vector2d dx_1f;
+  typedef ceres::Jet<T, 2> JetT;
+  JetT extra_params[CameraModel::num_extra_params];
+  for (size_t i = 0; i < CameraModel::num_extra_params; ++i) {
+    extra_params[i] = JetT(params[i]);
+  }
+
+  Eigen::Matrix<T, 2, 2> J;
+  const Eigen::Matrix<T, 2, 1> x0(*u, *v);
+  Eigen::Matrix<T, 2, 1> x(*u, *v);
+  JetT du;
+  JetT dv;
 
   for (size_t i = 0; i < kNumIterations; ++i) {
-    const double step0 = std::max(std::numeric_limits<double>::epsilon(),
-                                  std::abs(kRelStepSize * x(0)));
-    const double step1 = std::max(std::numeric_limits<double>::epsilon(),
-                                  std::abs(kRelStepSize * x(1)));
-    CameraModel::Distortion(params, x(0), x(1), &dx(0), &dx(1));
-    CameraModel::Distortion(params, x(0) - step0, x(1), &dx_0b(0), &dx_0b(1));
-    CameraModel::Distortion(params, x(0) + step0, x(1), &dx_0f(0), &dx_0f(1));
-    CameraModel::Distortion(params, x(0), x(1) - step1, &dx_1b(0), &dx_1b(1));
-    CameraModel::Distortion(params, x(0), x(1) + step1, &dx_1f(0), &dx_1f(1));
-    J(0, 0) = 1 + (dx_0f(0) - dx_0b(0)) / (2 * step0);
-    J(0, 1) = (dx_1f(0) - dx_1b(0)) / (2 * step1);
-    J(1, 0) = (dx_0f(1) - dx_0b(1)) / (2 * step0);
-    J(1, 1) = 1 + (dx_1f(1) - dx_1b(1)) / (2 * step1);
-    const Eigen::Vector2d step_x = J.partialPivLu().solve(x + dx - x0);
+    CameraModel::Distortion(
+        extra_params, JetT(x(0), 0), JetT(x(1), 1), &du, &dv);
+    J(0, 0) = T(1) + du.v[0];
+    J(0, 1) = du.v[1];
+    J(1, 0) = dv.v[0];
+    J(1, 1) = T(1) + dv.v[1];
+    const Eigen::Matrix<T, 2, 1> residual(x(0) + du.a - x0(0),
+                                          x(1) + dv.a - x0(1));
+    const Eigen::Matrix<T, 2, 1> step_x = J.inverse() * residual;
     x -= step_x;
     if (step_x.squaredNorm() < kMaxStepNorm) {
       break;
@@ -610,6 +630,28 @@ void BaseCameraModel<CameraModel>::IterativeUndistortion(const T* params,
   *v = x(1);
 }
 
+template <typename CameraModel>
+void BaseCameraModel<CameraModel>::ImgFromCamBatch(
+    const double* params,
+    const span<const Eigen::Vector3d> uvw,
+    span<Eigen::Vector2d> xy) {
+  for (size_t i = 0; i < uvw.size(); ++i) {
+    CameraModel::ImgFromCam(
+        params, uvw[i].x(), uvw[i].y(), uvw[i].z(), &xy[i].x(), &xy[i].y());
+  }
+}
+
+template <typename CameraModel>
+void BaseCameraModel<CameraModel>::CamFromImgBatch(
+    const double* params,
+    const span<const Eigen::Vector2d> xy,
+    span<Eigen::Vector3d> uvw) {
+  for (size_t i = 0; i < xy.size(); ++i) {
+    CameraModel::CamFromImg(
+        params, xy[i].x(), xy[i].y(), &uvw[i].x(), &uvw[i].y(), &uvw[i].z());
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // SimplePinholeCameraModel
 
@@ -1576,6 +1618,44 @@ Eigen::Vector3d CameraModelCamFromImg(const CameraModelId model_id,
   return uvw;
 }
 
+void CameraModelImgFromCam(const CameraModelId model_id,
+                           const std::vector<double>& params,
+                           const span<const Eigen::Vector3d> uvw,
+                           span<Eigen::Vector2d> xy) {
+  if (uvw.size() != xy.size()) {
+    throw std::invalid_argument("Number of input and output points differ");
+  }
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                     \
+  case CameraModel::model_id:                              \
+    CameraModel::ImgFromCamBatch(params.data(), uvw, xy); \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+void CameraModelCamFromImg(const CameraModelId model_id,
+                           const std::vector<double>& params,
+                           const span<const Eigen::Vector2d> xy,
+                           span<Eigen::Vector3d> uvw) {
+  if (xy.size() != uvw.size()) {
+    throw std::invalid_argument("Number of input and output points differ");
+  }
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                     \
+  case CameraModel::model_id:                              \
+    CameraModel::CamFromImgBatch(params.data(), xy, uvw); \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
 double CameraModelCamFromImgThreshold(const CameraModelId model_id,
                                       const std::vector<double>& params,
                                       const double threshold) {
@@ -66,6 +66,44 @@ void TestCamFromImgToImg(const std::vector<double>& params,
   EXPECT_NEAR(y, y0, 1e-6);
 }
 
+template <typename CameraModel>
+void TestBatch(const std::vector<double>& params) {
+  std::vector<Eigen::Vector3d> uvw;
+  // NOLINTNEXTLINE(clang-analyzer-security.FloatLoopCounter)
+  for (double u = -0.5; u <= 0.5; u += 0.25) {
+    // NOLINTNEXTLINE(clang-analyzer-security.FloatLoopCounter)
+    for (double v = -0.5; v <= 0.5; v += 0.25) {
+      uvw.emplace_back(u, v, 2);
+    }
+  }
+
+  std::vector<Eigen::Vector2d> xy(uvw.size());
+  CameraModelImgFromCam(CameraModel::model_id,
+                        params,
+                        {uvw.data(), uvw.size()},
+                        {xy.data(), xy.size()});
+  for (size_t i = 0; i < uvw.size(); ++i) {
+    EXPECT_EQ(xy[i],
+              CameraModelImgFromCam(CameraModel::model_id, params, uvw[i]));
+  }
+
+  std::vector<Eigen::Vector3d> uvw_from_xy(xy.size());
+  CameraModelCamFromImg(CameraModel::model_id,
+                        params,
+                        {xy.data(), xy.size()},
+                        {uvw_from_xy.data(), uvw_from_xy.size()});
+  for (size_t i = 0; i < xy.size(); ++i) {
+    EXPECT_EQ(uvw_from_xy[i],
+              CameraModelCamFromImg(CameraModel::model_id, params, xy[i]));
+  }
+
+  EXPECT_THROW(CameraModelImgFromCam(CameraModel::model_id,
+                                     params,
+                                     {uvw.data(), uvw.size()},
+                                     {xy.data(), xy.size() - 1}),
+               std::invalid_argument);
+}
+
 template <typename CameraModel>
 void TestModel(const std::vector<double>& params) {
   EXPECT_TRUE(CameraModelVerifyParams(CameraModel::model_id, params));
@@ -143,6 +181,8 @@ void TestModel(const std::vector<double>& params) {
   const auto pp_idxs = CameraModel::principal_point_idxs;
   TestCamFromImgToImg<CameraModel>(
       params, params[pp_idxs.at(0)], params[pp_idxs.at(1)]);
+
+  TestBatch<CameraModel>(params);
 }
 
 TEST(SimplePinhole, Nominal) {
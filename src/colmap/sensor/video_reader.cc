@@ -0,0 +1,311 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/sensor/video_reader.h"
+
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(COLMAP_FFMPEG_ENABLED)
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+#include <FreeImage.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+namespace colmap {
+
+#if defined(COLMAP_FFMPEG_ENABLED)
+
+struct VideoReader::Impl {
+  ~Impl() {
+    sws_freeContext(sws_ctx);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codec_ctx);
+    avformat_close_input(&format_ctx);
+  }
+
+  void Open(const std::string& path) {
+    THROW_CHECK_EQ(
+        avformat_open_input(&format_ctx, path.c_str(), nullptr, nullptr), 0)
+        << "Failed to open video: " << path;
+    THROW_CHECK_GE(avformat_find_stream_info(format_ctx, nullptr), 0)
+        << "Failed to read stream info: " << path;
+
+    stream_idx = av_find_best_stream(
+        format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    THROW_CHECK_GE(stream_idx, 0) << "No video stream: " << path;
+    const AVCodecParameters* codec_params =
+        format_ctx->streams[stream_idx]->codecpar;
+    const AVCodec* codec = avcodec_find_decoder(codec_params->codec_id);
+    THROW_CHECK_NOTNULL(codec);
+
+    codec_ctx = avcodec_alloc_context3(codec);
+    THROW_CHECK_NOTNULL(codec_ctx);
+    THROW_CHECK_GE(avcodec_parameters_to_context(codec_ctx, codec_params), 0);
+    // The frames of a video can only be decoded sequentially, so let the
+    // decoder use as many threads as it supports.
+    codec_ctx->thread_count = 0;
+    THROW_CHECK_EQ(avcodec_open2(codec_ctx, codec, nullptr), 0)
+        << "Failed to open decoder: " << path;
+
+    packet = av_packet_alloc();
+    frame = av_frame_alloc();
+    THROW_CHECK_NOTNULL(packet);
+    THROW_CHECK_NOTNULL(frame);
+
+    // Index all frames by demuxing the packets without decoding them. The
+    // packets are stored in decoding order, which differs from the
+    // presentation order for bidirectionally predicted frames.
+    std::vector<std::pair<int64_t, bool>> frames;
+    while (av_read_frame(format_ctx, packet) >= 0) {
+      if (packet->stream_index == stream_idx) {
+        const int64_t pts =
+            packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        THROW_CHECK_NE(pts, AV_NOPTS_VALUE)
+            << "Video packets without timestamps are not supported: " << path;
+        frames.emplace_back(pts, (packet->flags & AV_PKT_FLAG_KEY) != 0);
+      }
+      av_packet_unref(packet);
+    }
+    std::sort(frames.begin(), frames.end());
+
+    frame_pts.reserve(frames.size());
+    key_frames.reserve(frames.size());
+    for (const auto& [pts, is_key_frame] : frames) {
+      frame_pts.push_back(pts);
+      key_frames.push_back(is_key_frame);
+    }
+    // The first frame can always be decoded after seeking to the start.
+    if (!key_frames.empty()) {
+      key_frames[0] = true;
+      THROW_CHECK(Seek(0)) << "Failed to rewind video: " << path;
+    }
+  }
+
+  size_t PrecedingKeyFrame(size_t frame_idx) const {
+    while (frame_idx > 0 && !key_frames[frame_idx]) {
+      frame_idx -= 1;
+    }
+    return frame_idx;
+  }
+
+  bool Seek(const size_t key_frame_idx) {
+    if (av_seek_frame(format_ctx,
+                      stream_idx,
+                      frame_pts[key_frame_idx],
+                      AVSEEK_FLAG_BACKWARD) < 0) {
+      return false;
+    }
+    avcodec_flush_buffers(codec_ctx);
+    flushing = false;
+    decoded_frame_idx = static_cast<int64_t>(key_frame_idx) - 1;
+    return true;
+  }
+
+  // Decodes the next frame and determines its index from its timestamp.
+  bool DecodeNextFrame() {
+    while (true) {
+      const int ret = avcodec_receive_frame(codec_ctx, frame);
+      if (ret == 0) {
+        const int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE
+                                ? frame->best_effort_timestamp
+                                : frame->pts;
+        decoded_frame_idx =
+            std::lower_bound(frame_pts.begin(), frame_pts.end(), pts) -
+            frame_pts.begin();
+        return true;
+      } else if (ret != AVERROR(EAGAIN) || flushing) {
+        return false;
+      }
+
+      if (av_read_frame(format_ctx, packet) < 0) {
+        // Drain the frames buffered in the decoder at the end of the stream.
+        flushing = true;
+        avcodec_send_packet(codec_ctx, nullptr);
+        continue;
+      }
+
+      const int send_ret = packet->stream_index == stream_idx
+                               ? avcodec_send_packet(codec_ctx, packet)
+                               : 0;
+      av_packet_unref(packet);
+      if (send_ret < 0) {
+        return false;
+      }
+    }
+  }
+
+  bool ConvertFrame(const bool as_rgb, Bitmap* bitmap) {
+    const int width = frame->width;
+    const int height = frame->height;
+    const int channels = as_rgb ? 3 : 1;
+    // FreeImage stores the color channels in BGR order on little endian.
+    const AVPixelFormat dst_format =
+        as_rgb ? (FI_RGBA_RED == 2 ? AV_PIX_FMT_BGR24 : AV_PIX_FMT_RGB24)
+               : AV_PIX_FMT_GRAY8;
+    sws_ctx = sws_getCachedContext(sws_ctx,
+                                   width,
+                                   height,
+                                   static_cast<AVPixelFormat>(frame->format),
+                                   width,
+                                   height,
+                                   dst_format,
+                                   SWS_BILINEAR,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr);
+    if (sws_ctx == nullptr) {
+      return false;
+    }
+
+    const int stride = (width * channels + 31) / 32 * 32;
+    buffer.resize(static_cast<size_t>(stride) * height);
+    uint8_t* dst_data[4] = {buffer.data(), nullptr, nullptr, nullptr};
+    int dst_linesize[4] = {stride, 0, 0, 0};
+    sws_scale(sws_ctx,
+              frame->data,
+              frame->linesize,
+              0,
+              height,
+              dst_data,
+              dst_linesize);
+
+    if (!bitmap->Allocate(width, height, as_rgb)) {
+      return false;
+    }
+    for (int y = 0; y < height; ++y) {
+      std::memcpy(FreeImage_GetScanLine(bitmap->Data(), height - 1 - y),
+                  buffer.data() + static_cast<size_t>(y) * stride,
+                  width * channels);
+    }
+    return true;
+  }
+
+  bool ReadFrame(const size_t frame_idx, const bool as_rgb, Bitmap* bitmap) {
+    // Seek if the frame lies behind the decoder or if a keyframe lies between
+    // the decoder position and the frame, which avoids decoding the frames in
+    // between, e.g., when reading only keyframes.
+    const size_t key_frame_idx = PrecedingKeyFrame(frame_idx);
+    if ((decoded_frame_idx >= static_cast<int64_t>(frame_idx) ||
+         decoded_frame_idx + 1 < static_cast<int64_t>(key_frame_idx)) &&
+        !Seek(key_frame_idx)) {
+      return false;
+    }
+
+    while (DecodeNextFrame()) {
+      if (decoded_frame_idx == static_cast<int64_t>(frame_idx)) {
+        return ConvertFrame(as_rgb, bitmap);
+      } else if (decoded_frame_idx > static_cast<int64_t>(frame_idx)) {
+        // The frame could not be decoded, e.g., due to a corrupt packet.
+        return false;
+      }
+    }
+    return false;
+  }
+
+  AVFormatContext* format_ctx = nullptr;
+  AVCodecContext* codec_ctx = nullptr;
+  SwsContext* sws_ctx = nullptr;
+  AVPacket* packet = nullptr;
+  AVFrame* frame = nullptr;
+  int stream_idx = -1;
+  bool flushing = false;
+
+  // Timestamps and keyframe flags of all frames in presentation order.
+  std::vector<int64_t> frame_pts;
+  std::vector<bool> key_frames;
+
+  // Index of the last decoded frame.
+  int64_t decoded_frame_idx = -1;
+
+  std::vector<uint8_t> buffer;
+};
+
+VideoReader::VideoReader(const std::string& path)
+    : impl_(std::make_unique<Impl>()) {
+  impl_->Open(path);
+}
+
+bool VideoReader::IsAvailable() { return true; }
+
+size_t VideoReader::NumFrames() const { return impl_->frame_pts.size(); }
+
+bool VideoReader::IsKeyFrame(const size_t frame_idx) const {
+  return impl_->key_frames.at(frame_idx);
+}
+
+bool VideoReader::ReadFrame(const size_t frame_idx,
+                            const bool as_rgb,
+                            Bitmap* bitmap) {
+  THROW_CHECK_LT(frame_idx, NumFrames());
+  THROW_CHECK_NOTNULL(bitmap);
+  return impl_->ReadFrame(frame_idx, as_rgb, bitmap);
+}
+
+#else
+
+struct VideoReader::Impl {};
+
+VideoReader::VideoReader(const std::string& path) {
+  LOG(FATAL_THROW) << "Cannot read video " << path
+                   << " without FFmpeg support.";
+}
+
+bool VideoReader::IsAvailable() { return false; }
+
+size_t VideoReader::NumFrames() const { return 0; }
+
+bool VideoReader::IsKeyFrame(const size_t frame_idx) const { return false; }
+
+bool VideoReader::ReadFrame(const size_t frame_idx,
+                            const bool as_rgb,
+                            Bitmap* bitmap) {
+  return false;
+}
+
+#endif  // COLMAP_FFMPEG_ENABLED
+
+VideoReader::~VideoReader() = default;
+
+}  // namespace colmap
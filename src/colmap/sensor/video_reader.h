@@ -0,0 +1,70 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/sensor/bitmap.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace colmap {
+
+// Reads the frames of a video file with FFmpeg. The frames are indexed in
+// presentation order. Reading frames in increasing order decodes the video
+// sequentially and skips ahead to the closest preceding keyframe, whereas
+// reading an earlier frame seeks back to its closest preceding keyframe.
+// The reader is not thread-safe.
+class VideoReader {
+ public:
+  // Opens the video and indexes its frames by demuxing all packets of the
+  // best video stream without decoding them. Throws if the video cannot be
+  // opened or if COLMAP was built without FFmpeg.
+  explicit VideoReader(const std::string& path);
+  ~VideoReader();
+
+  // Whether COLMAP was built with FFmpeg support.
+  static bool IsAvailable();
+
+  size_t NumFrames() const;
+
+  // Whether the frame is a keyframe, which can be decoded without decoding any
+  // of the preceding frames.
+  bool IsKeyFrame(size_t frame_idx) const;
+
+  // Decode the frame as a grey-scale or RGB bitmap.
+  bool ReadFrame(size_t frame_idx, bool as_rgb, Bitmap* bitmap);
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace colmap
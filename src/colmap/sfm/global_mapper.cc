@@ -0,0 +1,377 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/sfm/global_mapper.h"
+
+#include "colmap/estimators/bundle_adjustment.h"
+#include "colmap/estimators/cost_functions.h"
+#include "colmap/estimators/manifold.h"
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/math/math.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+
+#include <queue>
+#include <unordered_set>
+
+#include <ceres/ceres.h>
+
+namespace colmap {
+namespace {
+
+ceres::Solver::Options CreateSolverOptions(
+    const GlobalMapper::Options& options) {
+  ceres::Solver::Options solver_options;
+  solver_options.max_num_iterations = options.max_num_iterations;
+  solver_options.logging_type = ceres::LoggingType::SILENT;
+  solver_options.num_threads = GetEffectiveNumThreads(options.num_threads);
+#if CERES_VERSION_MAJOR < 2
+  solver_options.num_linear_solver_threads = solver_options.num_threads;
+#endif  // CERES_VERSION_MAJOR
+  // The averaging problems are very sparse, since every pair only couples the
+  // parameters of two images.
+  if (solver_options.sparse_linear_algebra_library_type != ceres::NO_SPARSE) {
+    solver_options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+  } else {
+    solver_options.linear_solver_type = ceres::CGNR;
+  }
+  return solver_options;
+}
+
+}  // namespace
+
+bool GlobalMapper::Options::Check() const {
+  CHECK_OPTION_GE(min_num_inliers, 0);
+  CHECK_OPTION_GE(min_tri_angle, 0);
+  CHECK_OPTION_GT(rotation_loss_scale, 0);
+  CHECK_OPTION_GT(max_rotation_error, 0);
+  CHECK_OPTION_GT(position_loss_scale, 0);
+  CHECK_OPTION_GT(max_num_iterations, 0);
+  CHECK_OPTION_GE(num_threads, -1);
+  return true;
+}
+
+GlobalMapper::GlobalMapper(std::shared_ptr<const DatabaseCache> database_cache)
+    : database_cache_(std::move(THROW_CHECK_NOTNULL(database_cache))) {}
+
+size_t GlobalMapper::SetUpViewGraph(
+    const Options& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<TwoViewGeometry>& two_view_geometries) {
+  THROW_CHECK(options.Check());
+  THROW_CHECK_EQ(image_pairs.size(), two_view_geometries.size());
+
+  image_pairs_.clear();
+  rotations_.clear();
+  positions_.clear();
+
+  std::vector<size_t> candidate_idxs;
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    if (database_cache_->ExistsImage(image_pairs[i].first) &&
+        database_cache_->ExistsImage(image_pairs[i].second) &&
+        two_view_geometries[i].inlier_matches.size() >=
+            static_cast<size_t>(options.min_num_inliers)) {
+      candidate_idxs.push_back(i);
+    }
+  }
+
+  // Estimate the relative poses with the decomposition of the stored essential
+  // matrices or homographies, which also yields the triangulation angles.
+  std::vector<ImagePair> candidate_pairs(candidate_idxs.size());
+  const size_t kMinNumPairsPerChunk = 16;
+  ParallelForChunks(
+      options.num_threads,
+      candidate_idxs.size(),
+      kMinNumPairsPerChunk,
+      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const auto& [image_id1, image_id2] = image_pairs[candidate_idxs[i]];
+          const Image& image1 = database_cache_->Image(image_id1);
+          const Image& image2 = database_cache_->Image(image_id2);
+          const std::shared_ptr<const std::vector<Eigen::Vector2d>> points1 =
+              database_cache_->Points2D(image_id1);
+          const std::shared_ptr<const std::vector<Eigen::Vector2d>> points2 =
+              database_cache_->Points2D(image_id2);
+          TwoViewGeometry two_view_geometry =
+              two_view_geometries[candidate_idxs[i]];
+          if (!EstimateTwoViewGeometryPose(
+                  database_cache_->Camera(image1.CameraId()),
+                  *points1,
+                  database_cache_->Camera(image2.CameraId()),
+                  *points2,
+                  &two_view_geometry)) {
+            continue;
+          }
+          ImagePair& image_pair = candidate_pairs[i];
+          image_pair.image_id1 = image_id1;
+          image_pair.image_id2 = image_id2;
+          image_pair.cam2_from_cam1 = two_view_geometry.cam2_from_cam1;
+          image_pair.tri_angle = two_view_geometry.tri_angle;
+          image_pair.num_inliers = two_view_geometry.inlier_matches.size();
+        }
+      });
+
+  for (ImagePair& image_pair : candidate_pairs) {
+    if (image_pair.image_id1 != kInvalidImageId) {
+      image_pairs_.push_back(std::move(image_pair));
+    }
+  }
+
+  return image_pairs_.size();
+}
+
+bool GlobalMapper::EstimateGlobalRotations(const Options& options) {
+  THROW_CHECK(options.Check());
+
+  rotations_.clear();
+  positions_.clear();
+
+  std::vector<const ImagePair*> image_pairs;
+  image_pairs.reserve(image_pairs_.size());
+  for (const ImagePair& image_pair : image_pairs_) {
+    image_pairs.push_back(&image_pair);
+  }
+
+  const std::vector<image_t> image_ids =
+      FindLargestConnectedComponent(image_pairs);
+  if (image_ids.size() < 2) {
+    return false;
+  }
+
+  std::unordered_map<image_t, std::vector<const ImagePair*>> adjacent_pairs;
+  for (const ImagePair* image_pair : image_pairs) {
+    adjacent_pairs[image_pair->image_id1].push_back(image_pair);
+    adjacent_pairs[image_pair->image_id2].push_back(image_pair);
+  }
+
+  // Initialize the rotations by chaining the relative rotations along the
+  // maximum spanning tree of the number of inliers.
+  const image_t root_image_id = image_ids.front();
+  rotations_.emplace(root_image_id, Eigen::Quaterniond::Identity());
+  std::priority_queue<std::pair<size_t, const ImagePair*>> candidates;
+  for (const ImagePair* image_pair : adjacent_pairs.at(root_image_id)) {
+    candidates.emplace(image_pair->num_inliers, image_pair);
+  }
+  while (!candidates.empty()) {
+    const ImagePair* image_pair = candidates.top().second;
+    candidates.pop();
+    const bool has_rotation1 = rotations_.count(image_pair->image_id1) > 0;
+    const bool has_rotation2 = rotations_.count(image_pair->image_id2) > 0;
+    if (has_rotation1 && has_rotation2) {
+      continue;
+    }
+    image_t image_id;
+    if (has_rotation1) {
+      image_id = image_pair->image_id2;
+      rotations_.emplace(image_id,
+                         image_pair->cam2_from_cam1.rotation *
+                             rotations_.at(image_pair->image_id1));
+    } else {
+      image_id = image_pair->image_id1;
+      rotations_.emplace(image_id,
+                         image_pair->cam2_from_cam1.rotation.inverse() *
+                             rotations_.at(image_pair->image_id2));
+    }
+    for (const ImagePair* adjacent_pair : adjacent_pairs.at(image_id)) {
+      candidates.emplace(adjacent_pair->num_inliers, adjacent_pair);
+    }
+  }
+
+  // Refine the rotations over all pairs of the connected component.
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+  ceres::SoftLOneLoss loss_function(DegToRad(options.rotation_loss_scale));
+  for (const ImagePair* image_pair : image_pairs) {
+    const auto rotation1 = rotations_.find(image_pair->image_id1);
+    if (rotation1 == rotations_.end()) {
+      continue;
+    }
+    Eigen::Quaterniond& rotation2 = rotations_.at(image_pair->image_id2);
+    problem.AddResidualBlock(RelativeRotationErrorCostFunction::Create(
+                                 image_pair->cam2_from_cam1.rotation),
+                             &loss_function,
+                             rotation1->second.coeffs().data(),
+                             rotation2.coeffs().data());
+  }
+  for (auto& [_, rotation] : rotations_) {
+    SetQuaternionManifold(&problem, rotation.coeffs().data());
+  }
+  problem.SetParameterBlockConstant(
+      rotations_.at(root_image_id).coeffs().data());
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(CreateSolverOptions(options), &problem, &summary);
+
+  if (VLOG_IS_ON(1)) {
+    PrintSolverSummary(summary, "Rotation averaging report");
+  }
+
+  return summary.IsSolutionUsable();
+}
+
+bool GlobalMapper::EstimateGlobalPositions(const Options& options) {
+  THROW_CHECK(options.Check());
+
+  positions_.clear();
+
+  // Only use the pairs with consistent rotations and sufficient baseline,
+  // since the translation directions of the others are unreliable.
+  const double min_tri_angle = DegToRad(options.min_tri_angle);
+  const double max_rotation_error = DegToRad(options.max_rotation_error);
+  std::vector<const ImagePair*> image_pairs;
+  for (const ImagePair& image_pair : image_pairs_) {
+    const auto rotation1 = rotations_.find(image_pair.image_id1);
+    const auto rotation2 = rotations_.find(image_pair.image_id2);
+    if (rotation1 == rotations_.end() || rotation2 == rotations_.end() ||
+        image_pair.tri_angle < min_tri_angle ||
+        image_pair.cam2_from_cam1.translation.norm() == 0) {
+      continue;
+    }
+    const double rotation_error =
+        image_pair.cam2_from_cam1.rotation.angularDistance(
+            rotation2->second * rotation1->second.inverse());
+    if (rotation_error <= max_rotation_error) {
+      image_pairs.push_back(&image_pair);
+    }
+  }
+
+  const std::vector<image_t> image_ids =
+      FindLargestConnectedComponent(image_pairs);
+  if (image_ids.size() < 2) {
+    return false;
+  }
+
+  for (const image_t image_id : image_ids) {
+    positions_.emplace(image_id, Eigen::Vector3d::Zero());
+  }
+
+  // The distances between the cameras are bounded below by 1 instead of
+  // normalizing the directions, such that the problem remains convex.
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+  ceres::HuberLoss loss_function(options.position_loss_scale);
+  std::vector<double> distances;
+  distances.reserve(image_pairs.size());
+  for (const ImagePair* image_pair : image_pairs) {
+    const auto position1 = positions_.find(image_pair->image_id1);
+    if (position1 == positions_.end()) {
+      continue;
+    }
+    Eigen::Vector3d& position2 = positions_.at(image_pair->image_id2);
+    // The direction from the first to the second camera in the world frame.
+    const Eigen::Vector3d direction =
+        -(rotations_.at(image_pair->image_id2).inverse() *
+          image_pair->cam2_from_cam1.translation)
+             .normalized();
+    double& distance = distances.emplace_back(1);
+    problem.AddResidualBlock(
+        PairwiseDirectionErrorCostFunction::Create(direction),
+        &loss_function,
+        position1->second.data(),
+        position2.data(),
+        &distance);
+    problem.SetParameterLowerBound(&distance, 0, 1);
+  }
+  problem.SetParameterBlockConstant(positions_.at(image_ids.front()).data());
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(CreateSolverOptions(options), &problem, &summary);
+
+  if (VLOG_IS_ON(1)) {
+    PrintSolverSummary(summary, "Translation averaging report");
+  }
+
+  if (!summary.IsSolutionUsable()) {
+    positions_.clear();
+    return false;
+  }
+
+  return true;
+}
+
+void GlobalMapper::RegisterImages(Reconstruction* reconstruction) const {
+  THROW_CHECK_NOTNULL(reconstruction);
+  for (const auto& [image_id, position] : positions_) {
+    Image& image = reconstruction->Image(image_id);
+    const Eigen::Quaterniond& rotation = rotations_.at(image_id);
+    image.CamFromWorld() = Rigid3d(rotation, -(rotation * position));
+    reconstruction->RegisterImage(image_id);
+  }
+}
+
+const std::vector<GlobalMapper::ImagePair>& GlobalMapper::ImagePairs() const {
+  return image_pairs_;
+}
+
+const std::unordered_map<image_t, Eigen::Quaterniond>& GlobalMapper::Rotations()
+    const {
+  return rotations_;
+}
+
+const std::unordered_map<image_t, Eigen::Vector3d>& GlobalMapper::Positions()
+    const {
+  return positions_;
+}
+
+std::vector<image_t> GlobalMapper::FindLargestConnectedComponent(
+    const std::vector<const ImagePair*>& image_pairs) const {
+  std::unordered_map<image_t, std::vector<image_t>> adjacent_image_ids;
+  for (const ImagePair* image_pair : image_pairs) {
+    adjacent_image_ids[image_pair->image_id1].push_back(image_pair->image_id2);
+    adjacent_image_ids[image_pair->image_id2].push_back(image_pair->image_id1);
+  }
+
+  std::unordered_set<image_t> visited_image_ids;
+  std::vector<image_t> largest_component;
+  for (const auto& [image_id, _] : adjacent_image_ids) {
+    if (!visited_image_ids.insert(image_id).second) {
+      continue;
+    }
+    std::vector<image_t> component = {image_id};
+    for (size_t i = 0; i < component.size(); ++i) {
+      for (const image_t adjacent_image_id :
+           adjacent_image_ids.at(component[i])) {
+        if (visited_image_ids.insert(adjacent_image_id).second) {
+          component.push_back(adjacent_image_id);
+        }
+      }
+    }
+    if (component.size() > largest_component.size()) {
+      largest_component = std::move(component);
+    }
+  }
+
+  std::sort(largest_component.begin(), largest_component.end());
+  return largest_component;
+}
+
+}  // namespace colmap
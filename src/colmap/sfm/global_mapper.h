@@ -0,0 +1,149 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/geometry/rigid3.h"
+#include "colmap/scene/database_cache.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/scene/two_view_geometry.h"
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/types.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace colmap {
+
+// Class that estimates the poses of all images at once from the relative poses
+// of the image pairs in the view graph, in contrast to the incremental
+// registration of `IncrementalMapper`. The rotations and positions are
+// estimated by rotation and translation averaging, such that the images can
+// be triangulated and refined by a single global bundle adjustment. Example
+// usage:
+//
+//  GlobalMapper mapper(database_cache);
+//  mapper.SetUpViewGraph(options, image_pairs, two_view_geometries);
+//  THROW_CHECK(mapper.EstimateGlobalRotations(options));
+//  THROW_CHECK(mapper.EstimateGlobalPositions(options));
+//  mapper.RegisterImages(&reconstruction);
+//
+class GlobalMapper {
+ public:
+  struct Options {
+    // Minimum number of inlier matches of the image pairs in the view graph.
+    int min_num_inliers = 30;
+
+    // Minimum median triangulation angle in degrees of the image pairs used
+    // for translation averaging. Pairs with smaller baselines only constrain
+    // the rotations.
+    double min_tri_angle = 1.0;
+
+    // Scale of the robust loss in degrees for rotation averaging.
+    double rotation_loss_scale = 2.0;
+
+    // Maximum angular error in degrees between the measured and the averaged
+    // relative rotations. Pairs exceeding it are considered as outliers in
+    // translation averaging.
+    double max_rotation_error = 5.0;
+
+    // Scale of the robust loss for translation averaging, relative to the
+    // minimum distance of 1 between two camera positions.
+    double position_loss_scale = 0.1;
+
+    // Maximum number of solver iterations of the averaging problems.
+    int max_num_iterations = 200;
+
+    // The number of threads, -1 for all available threads.
+    int num_threads = -1;
+
+    bool Check() const;
+  };
+
+  // Relative pose of an image pair in the view graph.
+  struct ImagePair {
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    Rigid3d cam2_from_cam1;
+    // Median triangulation angle in radians of the inlier matches.
+    double tri_angle = 0;
+    size_t num_inliers = 0;
+  };
+
+  // Create global mapper. The database cache must live for the entire
+  // life-time of the global mapper.
+  explicit GlobalMapper(std::shared_ptr<const DatabaseCache> database_cache);
+
+  // Set up the view graph from the two-view geometries of the given image
+  // pairs. Pairs of images that are not in the database cache or that have
+  // too few inliers are ignored. The relative poses are estimated in parallel
+  // from the inlier matches. Returns the number of pairs in the view graph.
+  size_t SetUpViewGraph(
+      const Options& options,
+      const std::vector<std::pair<image_t, image_t>>& image_pairs,
+      const std::vector<TwoViewGeometry>& two_view_geometries);
+
+  // Estimate the rotations of the largest connected component of the view
+  // graph. The rotations are initialized on the maximum spanning tree of the
+  // number of inliers and then refined with a robust loss over all pairs.
+  bool EstimateGlobalRotations(const Options& options);
+
+  // Estimate the positions of the images with rotations, using the pairs
+  // with consistent rotations and sufficient triangulation angle. Only the
+  // largest connected component of these pairs is positioned.
+  bool EstimateGlobalPositions(const Options& options);
+
+  // Set the poses of the positioned images and register them in the
+  // reconstruction, which must be loaded from the database cache. The images
+  // are not yet triangulated.
+  void RegisterImages(Reconstruction* reconstruction) const;
+
+  const std::vector<ImagePair>& ImagePairs() const;
+  const std::unordered_map<image_t, Eigen::Quaterniond>& Rotations() const;
+  const std::unordered_map<image_t, Eigen::Vector3d>& Positions() const;
+
+ private:
+  // Find the largest connected component of the images in the given pairs.
+  std::vector<image_t> FindLargestConnectedComponent(
+      const std::vector<const ImagePair*>& image_pairs) const;
+
+  const std::shared_ptr<const DatabaseCache> database_cache_;
+
+  std::vector<ImagePair> image_pairs_;
+
+  // The estimated cam_from_world rotations and camera positions in the world.
+  std::unordered_map<image_t, Eigen::Quaterniond> rotations_;
+  std::unordered_map<image_t, Eigen::Vector3d> positions_;
+};
+
+}  // namespace colmap
@@ -29,34 +29,49 @@
 
 #include "colmap/sfm/incremental_mapper.h"
 
+#include "colmap/estimators/generalized_pose.h"
 #include "colmap/estimators/pose.h"
+#include "colmap/estimators/similarity_transform.h"
 #include "colmap/estimators/two_view_geometry.h"
+#include "colmap/geometry/gps.h"
 #include "colmap/geometry/triangulation.h"
+#include "colmap/math/random.h"
+#include "colmap/optim/loransac.h"
 #include "colmap/scene/projection.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
+#include "colmap/util/threading.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <fstream>
+#include <future>
+#include <limits>
+#include <memory>
 
 namespace colmap {
 namespace {
 
-void SortAndAppendNextImages(std::vector<std::pair<image_t, float>> image_ranks,
-                             std::vector<image_t>* sorted_images_ids) {
-  std::sort(image_ranks.begin(),
-            image_ranks.end(),
-            [](const std::pair<image_t, float>& image1,
-               const std::pair<image_t, float>& image2) {
-              return image1.second > image2.second;
-            });
-
-  sorted_images_ids->reserve(sorted_images_ids->size() + image_ranks.size());
-  for (const auto& image : image_ranks) {
-    sorted_images_ids->push_back(image.first);
+// Position of a prior in a Cartesian coordinate system, i.e., GPS positions
+// are converted to Earth-centered, Earth-fixed coordinates.
+Eigen::Vector3d CartesianPositionPrior(const PosePrior& pose_prior) {
+  if (pose_prior.coordinate_system == PosePrior::CoordinateSystem::WGS84) {
+    return GPSTransform(GPSTransform::WGS84).EllToXYZ({pose_prior.position})[0];
   }
+  return pose_prior.position;
+}
 
-  image_ranks.clear();
+// Rotation that best maps the given source to the destination directions in
+// the least squares sense, see Kabsch's algorithm.
+Eigen::Matrix3d RotationFromDirections(const Eigen::Matrix3d& src,
+                                       const Eigen::Matrix3d& dst) {
+  const Eigen::JacobiSVD<Eigen::Matrix3d> svd(
+      dst * src.transpose(), Eigen::ComputeFullU | Eigen::ComputeFullV);
+  Eigen::Matrix3d correction = Eigen::Matrix3d::Identity();
+  correction(2, 2) = (svd.matrixU() * svd.matrixV().transpose()).determinant();
+  return svd.matrixU() * correction * svd.matrixV().transpose();
 }
 
 float RankNextImageMaxVisiblePointsNum(
@@ -75,8 +90,84 @@ float RankNextImageMinUncertainty(const image_t image_id,
   return static_cast<float>(obs_manager.Point3DVisibilityScore(image_id));
 }
 
+// Project the 3D points of all observations in the given images. Points
+// behind the camera are projected to NaN.
+std::vector<Eigen::Vector2d> ProjectObservations(
+    const Reconstruction& reconstruction,
+    const std::vector<image_t>& image_ids) {
+  std::vector<Eigen::Vector2d> projections;
+  for (const image_t image_id : image_ids) {
+    const Image& image = reconstruction.Image(image_id);
+    const Camera& camera = reconstruction.Camera(image.CameraId());
+    for (const Point2D& point2D : image.Points2D()) {
+      if (!point2D.HasPoint3D()) {
+        continue;
+      }
+      const Eigen::Vector3d point3D_in_cam =
+          image.CamFromWorld() *
+          reconstruction.Point3D(point2D.point3D_id).xyz;
+      if (point3D_in_cam.z() < std::numeric_limits<double>::epsilon()) {
+        projections.emplace_back(std::numeric_limits<double>::quiet_NaN(),
+                                 std::numeric_limits<double>::quiet_NaN());
+      } else {
+        projections.push_back(camera.ImgFromCam(point3D_in_cam.hnormalized()));
+      }
+    }
+  }
+  return projections;
+}
+
+double MeanProjectionDisplacement(const std::vector<Eigen::Vector2d>& before,
+                                  const std::vector<Eigen::Vector2d>& after) {
+  if (before.size() != after.size()) {
+    return 0;
+  }
+  double sum_displacement = 0;
+  size_t num_displacements = 0;
+  for (size_t i = 0; i < before.size(); ++i) {
+    const double displacement = (after[i] - before[i]).norm();
+    if (std::isfinite(displacement)) {
+      sum_displacement += displacement;
+      num_displacements += 1;
+    }
+  }
+  return num_displacements == 0 ? 0 : sum_displacement / num_displacements;
+}
+
 }  // namespace
 
+IncrementalMapperImageRegistry::IncrementalMapperImageRegistry(
+    const DatabaseCache& database_cache)
+    : num_claimed_images_(0) {
+  claimed_.reserve(database_cache.NumImages());
+  for (const auto& image : database_cache.Images()) {
+    claimed_[image.first].store(false);
+  }
+}
+
+bool IncrementalMapperImageRegistry::Claim(const image_t image_id) {
+  bool expected = false;
+  if (!claimed_.at(image_id).compare_exchange_strong(expected, true)) {
+    return false;
+  }
+  num_claimed_images_ += 1;
+  return true;
+}
+
+void IncrementalMapperImageRegistry::Release(const image_t image_id) {
+  if (claimed_.at(image_id).exchange(false)) {
+    num_claimed_images_ -= 1;
+  }
+}
+
+bool IncrementalMapperImageRegistry::IsClaimed(const image_t image_id) const {
+  return claimed_.at(image_id).load();
+}
+
+size_t IncrementalMapperImageRegistry::NumClaimedImages() const {
+  return num_claimed_images_.load();
+}
+
 bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GT(init_min_num_inliers, 0);
   CHECK_OPTION_GT(init_max_error, 0.0);
@@ -88,6 +179,7 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GT(abs_pose_min_num_inliers, 0);
   CHECK_OPTION_GE(abs_pose_min_inlier_ratio, 0.0);
   CHECK_OPTION_LE(abs_pose_min_inlier_ratio, 1.0);
+  CHECK_OPTION_GT(abs_pose_position_prior_max_error, 0.0);
   CHECK_OPTION_GE(local_ba_num_images, 2);
   CHECK_OPTION_GE(local_ba_min_tri_angle, 0.0);
   CHECK_OPTION_GE(min_focal_length_ratio, 0.0);
@@ -113,11 +205,18 @@ void IncrementalMapper::BeginReconstruction(
   THROW_CHECK(reconstruction_ == nullptr);
   reconstruction_ = reconstruction;
   reconstruction_->Load(*database_cache_);
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    LoadPoints2DForImageAndNeighbors(image_id);
+  }
   // reconstruction_->SetUp();
   obs_manager_ = std::make_shared<class ObservationManager>(
       *reconstruction_, database_cache_->CorrespondenceGraph());
   triangulator_ = std::make_shared<IncrementalTriangulator>(
       database_cache_->CorrespondenceGraph(), *reconstruction_, obs_manager_);
+  local_ba_cost_function_pool_ =
+      std::make_unique<BundleAdjustmentCostFunctionPool>();
+  global_ba_marginalization_cache_ =
+      std::make_unique<BundleAdjustmentMarginalizationCache>();
 
   num_shared_reg_images_ = 0;
   num_reg_images_per_camera_.clear();
@@ -131,6 +230,130 @@ void IncrementalMapper::BeginReconstruction(
 
   filtered_images_.clear();
   num_reg_trials_.clear();
+
+  next_image_ranks_valid_ = false;
+  local_ba_drift_ = 0;
+  local_ba_drift_image_ids_.clear();
+
+  position_prior_alignment_valid_ = false;
+  position_prior_alignment_num_reg_images_ = 0;
+}
+
+void IncrementalMapper::AddImages(const std::vector<image_t>& image_ids) {
+  THROW_CHECK_NOTNULL(reconstruction_);
+
+  std::vector<image_t> new_image_ids;
+  new_image_ids.reserve(image_ids.size());
+  for (const image_t image_id : image_ids) {
+    if (reconstruction_->ExistsImage(image_id)) {
+      continue;
+    }
+    const Image& image = database_cache_->Image(image_id);
+    if (!reconstruction_->ExistsCamera(image.CameraId())) {
+      reconstruction_->AddCamera(database_cache_->Camera(image.CameraId()));
+    }
+    reconstruction_->AddImage(image);
+    new_image_ids.push_back(image_id);
+  }
+
+  // The observation manager updates the 2D points of the new images, whenever
+  // the points of their registered neighbors are triangulated.
+  if (database_cache_->IsLazy()) {
+    const std::shared_ptr<const class CorrespondenceGraph>
+        correspondence_graph = database_cache_->CorrespondenceGraph();
+    auto HasRegisteredNeighbor = [&](const image_t image_id) {
+      const point2D_t num_points2D =
+          correspondence_graph->NumPoints2DForImage(image_id);
+      for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+           ++point2D_idx) {
+        const auto corr_range =
+            correspondence_graph->FindCorrespondences(image_id, point2D_idx);
+        for (const auto* corr = corr_range.beg; corr < corr_range.end;
+             ++corr) {
+          if (reconstruction_->Image(corr->image_id).IsRegistered()) {
+            return true;
+          }
+        }
+      }
+      return false;
+    };
+    for (const image_t image_id : new_image_ids) {
+      if (correspondence_graph->ExistsImage(image_id) &&
+          HasRegisteredNeighbor(image_id)) {
+        reconstruction_->Image(image_id).SetPoints2D(
+            *database_cache_->Points2D(image_id));
+      }
+    }
+  }
+
+  obs_manager_->AddImages(new_image_ids);
+  next_image_ranks_valid_ = false;
+}
+
+void IncrementalMapper::SetImageRegistry(
+    std::shared_ptr<IncrementalMapperImageRegistry> image_registry) {
+  THROW_CHECK(reconstruction_ == nullptr);
+  image_registry_ = std::move(image_registry);
+}
+
+const std::shared_ptr<IncrementalMapperImageRegistry>&
+IncrementalMapper::ImageRegistry() const {
+  return image_registry_;
+}
+
+void IncrementalMapper::SetCameraRigs(std::vector<CameraRig> camera_rigs) {
+  THROW_CHECK(reconstruction_ == nullptr);
+  camera_rigs_ = std::move(camera_rigs);
+  rig_snapshot_idxs_.clear();
+  for (size_t rig_idx = 0; rig_idx < camera_rigs_.size(); ++rig_idx) {
+    const auto& snapshots = camera_rigs_[rig_idx].Snapshots();
+    for (size_t snapshot_idx = 0; snapshot_idx < snapshots.size();
+         ++snapshot_idx) {
+      for (const image_t image_id : snapshots[snapshot_idx]) {
+        THROW_CHECK(rig_snapshot_idxs_
+                        .emplace(image_id, std::make_pair(rig_idx, snapshot_idx))
+                        .second)
+            << "Image cannot be part of multiple snapshots";
+      }
+    }
+  }
+}
+
+const std::vector<CameraRig>& IncrementalMapper::CameraRigs() const {
+  return camera_rigs_;
+}
+
+bool IncrementalMapper::IsRigSnapshotImage(const image_t image_id) const {
+  return rig_snapshot_idxs_.count(image_id) > 0;
+}
+
+IncrementalMapper::State IncrementalMapper::GetState() const {
+  State state;
+  state.num_total_reg_images = num_total_reg_images_;
+  state.num_shared_reg_images = num_shared_reg_images_;
+  state.init_num_reg_trials = init_num_reg_trials_;
+  state.init_image_pairs = init_image_pairs_;
+  state.num_registrations = num_registrations_;
+  state.filtered_images = filtered_images_;
+  state.num_reg_trials = num_reg_trials_;
+  state.existing_image_ids = existing_image_ids_;
+  state.local_ba_drift = local_ba_drift_;
+  state.local_ba_drift_image_ids = local_ba_drift_image_ids_;
+  return state;
+}
+
+void IncrementalMapper::SetState(State state) {
+  num_total_reg_images_ = state.num_total_reg_images;
+  num_shared_reg_images_ = state.num_shared_reg_images;
+  init_num_reg_trials_ = std::move(state.init_num_reg_trials);
+  init_image_pairs_ = std::move(state.init_image_pairs);
+  num_registrations_ = std::move(state.num_registrations);
+  filtered_images_ = std::move(state.filtered_images);
+  num_reg_trials_ = std::move(state.num_reg_trials);
+  existing_image_ids_ = std::move(state.existing_image_ids);
+  local_ba_drift_ = state.local_ba_drift;
+  local_ba_drift_image_ids_ = std::move(state.local_ba_drift_image_ids);
+  next_image_ranks_valid_ = false;
 }
 
 void IncrementalMapper::EndReconstruction(const bool discard) {
@@ -146,12 +369,23 @@ void IncrementalMapper::EndReconstruction(const bool discard) {
   reconstruction_ = nullptr;
   obs_manager_.reset();
   triangulator_.reset();
+  local_ba_cost_function_pool_.reset();
+  global_ba_marginalization_cache_.reset();
+
+  next_image_ranks_valid_ = false;
+  next_image_ranks_.clear();
+  sorted_next_image_ranks_.clear();
+  modified_next_image_ids_.clear();
+
+  position_prior_alignment_valid_ = false;
+  position_prior_alignment_num_reg_images_ = 0;
 }
 
 bool IncrementalMapper::FindInitialImagePair(const Options& options,
                                              TwoViewGeometry& two_view_geometry,
                                              image_t& image_id1,
                                              image_t& image_id2) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::FindInitialImagePair");
   THROW_CHECK(options.Check());
 
   std::vector<image_t> image_ids1;
@@ -172,31 +406,80 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
     image_ids1 = FindFirstInitialImage(options);
   }
 
+  // The candidate pairs are evaluated in batches, which are processed in
+  // parallel if multiple threads are used. The first pair in the ranked order
+  // that passes the checks is selected, as if evaluated one by one.
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (GetEffectiveNumThreads(options.num_threads) > 1) {
+    thread_pool = std::make_unique<ThreadPool>(options.num_threads);
+  }
+  const size_t batch_size = thread_pool ? thread_pool->NumThreads() : 1;
+
   // Try to find good initial pair.
   for (size_t i1 = 0; i1 < image_ids1.size(); ++i1) {
     image_id1 = image_ids1[i1];
 
-    const std::vector<image_t> image_ids2 =
-        FindSecondInitialImage(options, image_id1);
-
-    for (size_t i2 = 0; i2 < image_ids2.size(); ++i2) {
-      image_id2 = image_ids2[i2];
-
-      const image_pair_t pair_id =
-          Database::ImagePairToPairId(image_id1, image_id2);
+    // Concurrent reconstructions start from disjoint initial images.
+    if (image_registry_ && !image_registry_->Claim(image_id1)) {
+      continue;
+    }
 
-      // Try every pair only once.
-      if (init_image_pairs_.count(pair_id) > 0) {
-        continue;
+    // Try every pair only once.
+    std::vector<image_t> image_ids2;
+    for (const image_t other_image_id : FindSecondInitialImage(options,
+                                                               image_id1)) {
+      if (init_image_pairs_.count(
+              Database::ImagePairToPairId(image_id1, other_image_id)) == 0) {
+        image_ids2.push_back(other_image_id);
       }
+    }
 
-      init_image_pairs_.insert(pair_id);
+    for (size_t begin = 0; begin < image_ids2.size(); begin += batch_size) {
+      const size_t end = std::min(begin + batch_size, image_ids2.size());
+
+      std::vector<TwoViewGeometry> two_view_geometries(end - begin);
+      std::vector<char> success(end - begin, false);
+      if (thread_pool) {
+        auto EstimatePair = [&](const size_t idx) {
+          const image_pair_t pair_id =
+              Database::ImagePairToPairId(image_id1, image_ids2[idx]);
+          // Seed each pair separately, so that the estimates do not depend on
+          // the order in which the pairs are processed by the threads.
+          SetPRNGSeed(static_cast<unsigned>(kDefaultPRNGSeed + pair_id));
+          success[idx - begin] =
+              EstimateInitialTwoViewGeometry(options,
+                                             two_view_geometries[idx - begin],
+                                             image_id1,
+                                             image_ids2[idx]);
+        };
+        std::vector<std::future<void>> futures;
+        futures.reserve(end - begin);
+        for (size_t idx = begin; idx < end; ++idx) {
+          futures.push_back(thread_pool->AddTask(EstimatePair, idx));
+        }
+        for (auto& future : futures) {
+          future.get();
+        }
+      } else {
+        success[0] = EstimateInitialTwoViewGeometry(
+            options, two_view_geometries[0], image_id1, image_ids2[begin]);
+      }
 
-      if (EstimateInitialTwoViewGeometry(
-              options, two_view_geometry, image_id1, image_id2)) {
-        return true;
+      for (size_t idx = begin; idx < end; ++idx) {
+        image_id2 = image_ids2[idx];
+        init_image_pairs_.insert(
+            Database::ImagePairToPairId(image_id1, image_id2));
+        if (success[idx - begin] &&
+            (!image_registry_ || image_registry_->Claim(image_id2))) {
+          two_view_geometry = std::move(two_view_geometries[idx - begin]);
+          return true;
+        }
       }
     }
+
+    if (image_registry_) {
+      image_registry_->Release(image_id1);
+    }
   }
 
   // No suitable pair found in entire dataset.
@@ -207,58 +490,51 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
 }
 
 std::vector<image_t> IncrementalMapper::FindNextImages(const Options& options) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::FindNextImages");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK(options.Check());
 
-  std::function<float(image_t, const class ObservationManager&)>
-      rank_image_func;
-  switch (options.image_selection_method) {
-    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_NUM:
-      rank_image_func = RankNextImageMaxVisiblePointsNum;
-      break;
-    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_RATIO:
-      rank_image_func = RankNextImageMaxVisiblePointsRatio;
-      break;
-    case Options::ImageSelectionMethod::MIN_UNCERTAINTY:
-      rank_image_func = RankNextImageMinUncertainty;
-      break;
-  }
+  UpdateNextImageRanks(options);
 
-  std::vector<std::pair<image_t, float>> image_ranks;
-  std::vector<std::pair<image_t, float>> other_image_ranks;
+  std::vector<image_t> ranked_images_ids;
+  std::vector<image_t> other_ranked_images_ids;
 
   // Append images that have not failed to register before.
-  for (const auto& image : reconstruction_->Images()) {
-    // Skip images that are already registered.
-    if (image.second.IsRegistered()) {
-      continue;
-    }
+  for (const auto& rank_and_image_id : sorted_next_image_ranks_) {
+    const image_t image_id = rank_and_image_id.second;
 
     // Only consider images with a sufficient number of visible points.
-    if (obs_manager_->NumVisiblePoints3D(image.first) <
+    if (obs_manager_->NumVisiblePoints3D(image_id) <
         static_cast<size_t>(options.abs_pose_min_num_inliers)) {
       continue;
     }
 
+    // Skip images that were registered by a concurrent reconstruction.
+    if (image_registry_ && image_registry_->IsClaimed(image_id)) {
+      continue;
+    }
+
     // Only try registration for a certain maximum number of times.
-    const size_t num_reg_trials = num_reg_trials_[image.first];
+    const auto num_reg_trials_it = num_reg_trials_.find(image_id);
+    const size_t num_reg_trials =
+        num_reg_trials_it == num_reg_trials_.end() ? 0
+                                                   : num_reg_trials_it->second;
     if (num_reg_trials >= static_cast<size_t>(options.max_reg_trials)) {
       continue;
     }
 
     // If image has been filtered or failed to register, place it in the
     // second bucket and prefer images that have not been tried before.
-    const float rank = rank_image_func(image.first, *obs_manager_);
-    if (filtered_images_.count(image.first) == 0 && num_reg_trials == 0) {
-      image_ranks.emplace_back(image.first, rank);
+    if (filtered_images_.count(image_id) == 0 && num_reg_trials == 0) {
+      ranked_images_ids.push_back(image_id);
     } else {
-      other_image_ranks.emplace_back(image.first, rank);
+      other_ranked_images_ids.push_back(image_id);
     }
   }
 
-  std::vector<image_t> ranked_images_ids;
-  SortAndAppendNextImages(image_ranks, &ranked_images_ids);
-  SortAndAppendNextImages(other_image_ranks, &ranked_images_ids);
+  ranked_images_ids.insert(ranked_images_ids.end(),
+                           other_ranked_images_ids.begin(),
+                           other_ranked_images_ids.end());
 
   return ranked_images_ids;
 }
@@ -268,6 +544,7 @@ void IncrementalMapper::RegisterInitialImagePair(
     const TwoViewGeometry& two_view_geometry,
     const image_t image_id1,
     const image_t image_id2) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::RegisterInitialImagePair");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK_EQ(reconstruction_->NumRegImages(), 0);
@@ -283,6 +560,9 @@ void IncrementalMapper::RegisterInitialImagePair(
       Database::ImagePairToPairId(image_id1, image_id2);
   init_image_pairs_.insert(pair_id);
 
+  LoadPoints2DForImageAndNeighbors(image_id1);
+  LoadPoints2DForImageAndNeighbors(image_id2);
+
   Image& image1 = reconstruction_->Image(image_id1);
   const Camera& camera1 = reconstruction_->Camera(image1.CameraId());
 
@@ -344,33 +624,355 @@ void IncrementalMapper::RegisterInitialImagePair(
 
 bool IncrementalMapper::RegisterNextImage(const Options& options,
                                           const image_t image_id) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::RegisterNextImage");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK_GE(reconstruction_->NumRegImages(), 2);
 
   THROW_CHECK(options.Check());
 
-  Image& image = reconstruction_->Image(image_id);
-  Camera& camera = reconstruction_->Camera(image.CameraId());
-
-  THROW_CHECK(!image.IsRegistered())
+  THROW_CHECK(!reconstruction_->Image(image_id).IsRegistered())
       << "Image cannot be registered multiple times";
 
+  if (image_registry_ && !image_registry_->Claim(image_id)) {
+    return false;
+  }
+
+  LoadPoints2DForImageAndNeighbors(image_id);
+
   num_reg_trials_[image_id] += 1;
 
-  // Check if enough 2D-3D correspondences.
-  if (obs_manager_->NumVisiblePoints3D(image_id) <
+  if (!EstimateAndRegisterNextImage(options, image_id)) {
+    if (image_registry_) {
+      image_registry_->Release(image_id);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+bool IncrementalMapper::RegisterNextRigSnapshot(
+    const Options& options,
+    const image_t image_id,
+    std::vector<image_t>* reg_image_ids) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::RegisterNextRigSnapshot");
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_NOTNULL(obs_manager_);
+  THROW_CHECK_NOTNULL(reg_image_ids);
+  THROW_CHECK_GE(reconstruction_->NumRegImages(), 2);
+
+  THROW_CHECK(options.Check());
+
+  reg_image_ids->clear();
+
+  const auto rig_snapshot_idx = rig_snapshot_idxs_.find(image_id);
+  if (rig_snapshot_idx == rig_snapshot_idxs_.end()) {
+    if (!RegisterNextImage(options, image_id)) {
+      return false;
+    }
+    reg_image_ids->push_back(image_id);
+    return true;
+  }
+
+  THROW_CHECK(!reconstruction_->Image(image_id).IsRegistered())
+      << "Image cannot be registered multiple times";
+
+  const CameraRig& camera_rig = camera_rigs_[rig_snapshot_idx->second.first];
+  const std::vector<image_t>& snapshot =
+      camera_rig.Snapshots()[rig_snapshot_idx->second.second];
+
+  // Collect the unregistered images of the snapshot, whose cameras have known
+  // intrinsics, since the generalized absolute pose is estimated from rays.
+  std::vector<image_t> snapshot_image_ids;
+  std::vector<Camera> cameras;
+  std::vector<Rigid3d> cams_from_rig;
+  for (const image_t snapshot_image_id : snapshot) {
+    if (!reconstruction_->ExistsImage(snapshot_image_id)) {
+      continue;
+    }
+    const Image& image = reconstruction_->Image(snapshot_image_id);
+    if (image.IsRegistered()) {
+      continue;
+    }
+
+    Camera camera = reconstruction_->Camera(image.CameraId());
+    const auto num_reg_images_per_camera =
+        num_reg_images_per_camera_.find(image.CameraId());
+    if (num_reg_images_per_camera == num_reg_images_per_camera_.end() ||
+        num_reg_images_per_camera->second == 0) {
+      camera.params = database_cache_->Camera(image.CameraId()).params;
+      if (!camera.has_prior_focal_length) {
+        continue;
+      }
+    } else if (camera.HasBogusParams(options.min_focal_length_ratio,
+                                     options.max_focal_length_ratio,
+                                     options.max_extra_param)) {
+      continue;
+    }
+
+    if (image_registry_ && !image_registry_->Claim(snapshot_image_id)) {
+      continue;
+    }
+
+    snapshot_image_ids.push_back(snapshot_image_id);
+    cameras.push_back(std::move(camera));
+    cams_from_rig.push_back(camera_rig.CamFromRig(image.CameraId()));
+  }
+
+  auto ReleaseSnapshotImages = [&]() {
+    if (image_registry_) {
+      for (const image_t snapshot_image_id : snapshot_image_ids) {
+        image_registry_->Release(snapshot_image_id);
+      }
+    }
+  };
+
+  // The image itself cannot be registered without known intrinsics.
+  if (std::find(snapshot_image_ids.begin(),
+                snapshot_image_ids.end(),
+                image_id) == snapshot_image_ids.end()) {
+    ReleaseSnapshotImages();
+    return false;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Search for 2D-3D correspondences of all images in the snapshot
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::vector<std::vector<std::pair<point2D_t, point3D_t>>> tri_corrs(
+      snapshot_image_ids.size());
+  std::vector<Eigen::Vector2d> tri_points2D;
+  std::vector<Eigen::Vector3d> tri_points3D;
+  std::vector<size_t> tri_camera_idxs;
+  for (size_t camera_idx = 0; camera_idx < snapshot_image_ids.size();
+       ++camera_idx) {
+    const image_t snapshot_image_id = snapshot_image_ids[camera_idx];
+    LoadPoints2DForImageAndNeighbors(snapshot_image_id);
+    num_reg_trials_[snapshot_image_id] += 1;
+    FindNextImageCorrespondences(options,
+                                 snapshot_image_id,
+                                 &tri_corrs[camera_idx],
+                                 &tri_points2D,
+                                 &tri_points3D);
+    tri_camera_idxs.resize(tri_points2D.size(), camera_idx);
+  }
+
+  if (tri_points2D.size() <
       static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    ReleaseSnapshotImages();
     return false;
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // Search for 2D-3D correspondences
+  // Generalized 2D-3D estimation and refinement
   //////////////////////////////////////////////////////////////////////////////
 
+  RANSACOptions ransac_options;
+  ransac_options.max_error = options.abs_pose_max_error;
+  ransac_options.min_inlier_ratio = options.abs_pose_min_inlier_ratio;
+  ransac_options.min_num_trials = 100;
+  ransac_options.max_num_trials = 10000;
+  ransac_options.confidence = 0.99999;
+
+  Rigid3d rig_from_world;
+  size_t num_inliers;
+  std::vector<char> inlier_mask;
+  if (!EstimateGeneralizedAbsolutePose(ransac_options,
+                                       tri_points2D,
+                                       tri_points3D,
+                                       tri_camera_idxs,
+                                       cams_from_rig,
+                                       cameras,
+                                       &rig_from_world,
+                                       &num_inliers,
+                                       &inlier_mask) ||
+      num_inliers < static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    ReleaseSnapshotImages();
+    return false;
+  }
+
+  // The intrinsics are not refined, since they are either already refined
+  // from other images or only known from their priors.
+  AbsolutePoseRefinementOptions abs_pose_refinement_options;
+  abs_pose_refinement_options.refine_focal_length = false;
+  abs_pose_refinement_options.refine_extra_params = false;
+  if (!RefineGeneralizedAbsolutePose(abs_pose_refinement_options,
+                                     inlier_mask,
+                                     tri_points2D,
+                                     tri_points3D,
+                                     tri_camera_idxs,
+                                     cams_from_rig,
+                                     &rig_from_world,
+                                     &cameras)) {
+    ReleaseSnapshotImages();
+    return false;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register the images of the snapshot with inliers
+  //////////////////////////////////////////////////////////////////////////////
+
+  size_t corr_begin = 0;
+  for (size_t camera_idx = 0; camera_idx < snapshot_image_ids.size();
+       ++camera_idx) {
+    const image_t snapshot_image_id = snapshot_image_ids[camera_idx];
+    const size_t corr_end = corr_begin + tri_corrs[camera_idx].size();
+    const std::vector<char> image_inlier_mask(
+        inlier_mask.begin() + corr_begin, inlier_mask.begin() + corr_end);
+    corr_begin = corr_end;
+
+    if (std::find(image_inlier_mask.begin(), image_inlier_mask.end(), true) ==
+        image_inlier_mask.end()) {
+      if (image_registry_) {
+        image_registry_->Release(snapshot_image_id);
+      }
+      continue;
+    }
+
+    Image& image = reconstruction_->Image(snapshot_image_id);
+    image.CamFromWorld() = cams_from_rig[camera_idx] * rig_from_world;
+    reconstruction_->Camera(image.CameraId()) = cameras[camera_idx];
+    ContinueNextImageTracks(
+        snapshot_image_id, tri_corrs[camera_idx], image_inlier_mask);
+    reg_image_ids->push_back(snapshot_image_id);
+  }
+
+  return true;
+}
+
+std::vector<IncrementalMapper::NextImagePose>
+IncrementalMapper::EstimateNextImagePoses(
+    const Options& options, const std::vector<image_t>& image_ids) {
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_NOTNULL(obs_manager_);
+  THROW_CHECK_GE(reconstruction_->NumRegImages(), 2);
+
+  THROW_CHECK(options.Check());
+
+  for (const image_t image_id : image_ids) {
+    THROW_CHECK(!reconstruction_->Image(image_id).IsRegistered())
+        << "Image cannot be registered multiple times";
+    LoadPoints2DForImageAndNeighbors(image_id);
+    num_reg_trials_[image_id] += 1;
+  }
+
+  std::vector<NextImagePose> poses(image_ids.size());
+  auto EstimatePose = [&](const size_t idx) {
+    // Seed each image separately, so that the estimates do not depend on the
+    // order in which the images are processed by the threads.
+    SetPRNGSeed(static_cast<unsigned>(kDefaultPRNGSeed + image_ids[idx]));
+    poses[idx].success =
+        EstimateNextImagePose(options, image_ids[idx], &poses[idx]);
+  };
+
+  ThreadPool thread_pool(std::min<int>(
+      GetEffectiveNumThreads(options.num_threads), image_ids.size()));
+  std::vector<std::future<void>> futures;
+  futures.reserve(image_ids.size());
+  for (size_t idx = 0; idx < image_ids.size(); ++idx) {
+    futures.push_back(thread_pool.AddTask(EstimatePose, idx));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  return poses;
+}
+
+bool IncrementalMapper::RegisterNextImage(const Options& options,
+                                          const NextImagePose& pose) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::RegisterNextImage");
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_NOTNULL(obs_manager_);
+
+  THROW_CHECK(options.Check());
+
+  if (!pose.success) {
+    return false;
+  }
+
+  THROW_CHECK(!reconstruction_->Image(pose.image_id).IsRegistered())
+      << "Image cannot be registered multiple times";
+
+  if (image_registry_ && !image_registry_->Claim(pose.image_id)) {
+    return false;
+  }
+
+  if (!RegisterEstimatedNextImage(options, pose)) {
+    if (image_registry_) {
+      image_registry_->Release(pose.image_id);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+bool IncrementalMapper::RegisterEstimatedNextImage(const Options& options,
+                                                   const NextImagePose& pose) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::RegisterEstimatedNextImage");
+  Image& image = reconstruction_->Image(pose.image_id);
+  Camera& camera = reconstruction_->Camera(image.CameraId());
+
+  // The estimated camera parameters are discarded, if another image has since
+  // been registered with the same camera. Otherwise, the current parameters
+  // are used, which might have been refined since the estimation.
+  if (pose.estimated_camera &&
+      num_reg_images_per_camera_[image.CameraId()] > 0) {
+    return EstimateAndRegisterNextImage(options, pose.image_id);
+  }
+
   std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
   std::vector<Eigen::Vector2d> tri_points2D;
   std::vector<Eigen::Vector3d> tri_points3D;
+  FindNextImageCorrespondences(
+      options, pose.image_id, &tri_corrs, &tri_points2D, &tri_points3D);
+
+  // Re-validate the estimated pose against the current 3D points.
+  Camera validation_camera = pose.estimated_camera ? pose.camera : camera;
+  const double max_squared_error =
+      options.abs_pose_max_error * options.abs_pose_max_error;
+  std::vector<char> inlier_mask(tri_corrs.size(), false);
+  size_t num_inliers = 0;
+  for (size_t i = 0; i < tri_corrs.size(); ++i) {
+    if (CalculateSquaredReprojectionError(tri_points2D[i],
+                                          tri_points3D[i],
+                                          pose.cam_from_world,
+                                          validation_camera) <=
+        max_squared_error) {
+      inlier_mask[i] = true;
+      num_inliers += 1;
+    }
+  }
+
+  if (num_inliers < static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return EstimateAndRegisterNextImage(options, pose.image_id);
+  }
+
+  image.CamFromWorld() = pose.cam_from_world;
+  if (!RefineAbsolutePose(pose.refinement_options,
+                          inlier_mask,
+                          tri_points2D,
+                          tri_points3D,
+                          &image.CamFromWorld(),
+                          &validation_camera)) {
+    return false;
+  }
+
+  camera = validation_camera;
+  ContinueNextImageTracks(pose.image_id, tri_corrs, inlier_mask);
+
+  return true;
+}
+
+void IncrementalMapper::FindNextImageCorrespondences(
+    const Options& options,
+    const image_t image_id,
+    std::vector<std::pair<point2D_t, point3D_t>>* tri_corrs,
+    std::vector<Eigen::Vector2d>* tri_points2D,
+    std::vector<Eigen::Vector3d>* tri_points3D) const {
+  const Image& image = reconstruction_->Image(image_id);
 
   const std::shared_ptr<const CorrespondenceGraph> correspondence_graph =
       database_cache_->CorrespondenceGraph();
@@ -412,82 +1014,209 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
       const Point3D& point3D =
           reconstruction_->Point3D(corr_point2D.point3D_id);
 
-      tri_corrs.emplace_back(point2D_idx, corr_point2D.point3D_id);
+      tri_corrs->emplace_back(point2D_idx, corr_point2D.point3D_id);
       corr_point3D_ids.insert(corr_point2D.point3D_id);
-      tri_points2D.push_back(point2D.xy);
-      tri_points3D.push_back(point3D.xyz);
+      tri_points2D->push_back(point2D.xy);
+      tri_points3D->push_back(point3D.xyz);
     }
   }
+}
 
-  // The size of `next_image.num_tri_obs` and `tri_corrs_point2D_idxs.size()`
-  // can only differ, when there are images with bogus camera parameters, and
-  // hence we skip some of the 2D-3D correspondences.
-  if (tri_points2D.size() <
-      static_cast<size_t>(options.abs_pose_min_num_inliers)) {
-    return false;
-  }
-
-  //////////////////////////////////////////////////////////////////////////////
-  // 2D-3D estimation
-  //////////////////////////////////////////////////////////////////////////////
-
+bool IncrementalMapper::SetUpNextImagePoseEstimation(
+    const Options& options,
+    const Image& image,
+    Camera* camera,
+    AbsolutePoseEstimationOptions* abs_pose_options,
+    AbsolutePoseRefinementOptions* abs_pose_refinement_options) const {
   // Only refine / estimate focal length, if no focal length was specified
   // (manually or through EXIF) and if it was not already estimated previously
   // from another image (when multiple images share the same camera
   // parameters)
 
-  AbsolutePoseEstimationOptions abs_pose_options;
-  abs_pose_options.num_threads = options.num_threads;
-  abs_pose_options.num_focal_length_samples = 30;
-  abs_pose_options.min_focal_length_ratio = options.min_focal_length_ratio;
-  abs_pose_options.max_focal_length_ratio = options.max_focal_length_ratio;
-  abs_pose_options.ransac_options.max_error = options.abs_pose_max_error;
-  abs_pose_options.ransac_options.min_inlier_ratio =
+  abs_pose_options->num_threads = options.num_threads;
+  abs_pose_options->num_focal_length_samples = 30;
+  abs_pose_options->min_focal_length_ratio = options.min_focal_length_ratio;
+  abs_pose_options->max_focal_length_ratio = options.max_focal_length_ratio;
+  abs_pose_options->ransac_options.max_error = options.abs_pose_max_error;
+  abs_pose_options->ransac_options.min_inlier_ratio =
       options.abs_pose_min_inlier_ratio;
   // Use high confidence to avoid preemptive termination of P3P RANSAC
   // - too early termination may lead to bad registration.
-  abs_pose_options.ransac_options.min_num_trials = 100;
-  abs_pose_options.ransac_options.max_num_trials = 10000;
-  abs_pose_options.ransac_options.confidence = 0.99999;
-
-  AbsolutePoseRefinementOptions abs_pose_refinement_options;
-  if (num_reg_images_per_camera_[image.CameraId()] > 0) {
+  abs_pose_options->ransac_options.min_num_trials = 100;
+  abs_pose_options->ransac_options.max_num_trials = 10000;
+  abs_pose_options->ransac_options.confidence = 0.99999;
+
+  bool estimate_camera = false;
+  const auto num_reg_images_per_camera =
+      num_reg_images_per_camera_.find(image.CameraId());
+  if (num_reg_images_per_camera != num_reg_images_per_camera_.end() &&
+      num_reg_images_per_camera->second > 0) {
     // Camera already refined from another image with the same camera.
-    if (camera.HasBogusParams(options.min_focal_length_ratio,
-                              options.max_focal_length_ratio,
-                              options.max_extra_param)) {
+    if (camera->HasBogusParams(options.min_focal_length_ratio,
+                               options.max_focal_length_ratio,
+                               options.max_extra_param)) {
       // Previously refined camera has bogus parameters,
       // so reset parameters and try to re-estimage.
-      camera.params = database_cache_->Camera(image.CameraId()).params;
-      abs_pose_options.estimate_focal_length = !camera.has_prior_focal_length;
-      abs_pose_refinement_options.refine_focal_length = true;
-      abs_pose_refinement_options.refine_extra_params = true;
+      estimate_camera = true;
     } else {
-      abs_pose_options.estimate_focal_length = false;
-      abs_pose_refinement_options.refine_focal_length = false;
-      abs_pose_refinement_options.refine_extra_params = false;
+      abs_pose_options->estimate_focal_length = false;
+      abs_pose_refinement_options->refine_focal_length = false;
+      abs_pose_refinement_options->refine_extra_params = false;
     }
   } else {
     // Camera not refined before. Note that the camera parameters might have
     // been changed before but the image was filtered, so we explicitly reset
     // the camera parameters and try to re-estimate them.
-    camera.params = database_cache_->Camera(image.CameraId()).params;
-    abs_pose_options.estimate_focal_length = !camera.has_prior_focal_length;
-    abs_pose_refinement_options.refine_focal_length = true;
-    abs_pose_refinement_options.refine_extra_params = true;
+    estimate_camera = true;
+  }
+
+  if (estimate_camera) {
+    camera->params = database_cache_->Camera(image.CameraId()).params;
+    abs_pose_options->estimate_focal_length = !camera->has_prior_focal_length;
+    abs_pose_refinement_options->refine_focal_length = true;
+    abs_pose_refinement_options->refine_extra_params = true;
   }
 
   if (!options.abs_pose_refine_focal_length) {
-    abs_pose_options.estimate_focal_length = false;
-    abs_pose_refinement_options.refine_focal_length = false;
+    abs_pose_options->estimate_focal_length = false;
+    abs_pose_refinement_options->refine_focal_length = false;
   }
 
   if (!options.abs_pose_refine_extra_params) {
-    abs_pose_refinement_options.refine_extra_params = false;
+    abs_pose_refinement_options->refine_extra_params = false;
+  }
+
+  return estimate_camera;
+}
+
+bool IncrementalMapper::EstimateNextImagePose(const Options& options,
+                                              const image_t image_id,
+                                              NextImagePose* pose) const {
+  const Image& image = reconstruction_->Image(image_id);
+  pose->image_id = image_id;
+
+  // Check if enough 2D-3D correspondences.
+  if (obs_manager_->NumVisiblePoints3D(image_id) <
+      static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return false;
   }
 
+  std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+  std::vector<Eigen::Vector2d> tri_points2D;
+  std::vector<Eigen::Vector3d> tri_points3D;
+  FindNextImageCorrespondences(
+      options, image_id, &tri_corrs, &tri_points2D, &tri_points3D);
+  if (tri_points2D.size() <
+      static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return false;
+  }
+
+  pose->cam_from_world = image.CamFromWorld();
+  pose->camera = reconstruction_->Camera(image.CameraId());
+  AbsolutePoseEstimationOptions abs_pose_options;
+  pose->estimated_camera = SetUpNextImagePoseEstimation(options,
+                                                        image,
+                                                        &pose->camera,
+                                                        &abs_pose_options,
+                                                        &pose->refinement_options);
+  // The poses of multiple images are estimated in parallel.
+  abs_pose_options.num_threads = 1;
+
   size_t num_inliers;
   std::vector<char> inlier_mask;
+  if (!EstimateAbsolutePose(abs_pose_options,
+                            tri_points2D,
+                            tri_points3D,
+                            &pose->cam_from_world,
+                            &pose->camera,
+                            &num_inliers,
+                            &inlier_mask)) {
+    return false;
+  }
+
+  if (num_inliers < static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return false;
+  }
+
+  return RefineAbsolutePose(pose->refinement_options,
+                            inlier_mask,
+                            tri_points2D,
+                            tri_points3D,
+                            &pose->cam_from_world,
+                            &pose->camera);
+}
+
+bool IncrementalMapper::EstimateAndRegisterNextImage(const Options& options,
+                                                     const image_t image_id) {
+  Image& image = reconstruction_->Image(image_id);
+  Camera& camera = reconstruction_->Camera(image.CameraId());
+
+  // Check if enough 2D-3D correspondences.
+  if (obs_manager_->NumVisiblePoints3D(image_id) <
+      static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return false;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Search for 2D-3D correspondences
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+  std::vector<Eigen::Vector2d> tri_points2D;
+  std::vector<Eigen::Vector3d> tri_points3D;
+  FindNextImageCorrespondences(
+      options, image_id, &tri_corrs, &tri_points2D, &tri_points3D);
+
+  // The size of `next_image.num_tri_obs` and `tri_corrs_point2D_idxs.size()`
+  // can only differ, when there are images with bogus camera parameters, and
+  // hence we skip some of the 2D-3D correspondences.
+  if (tri_points2D.size() <
+      static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return false;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // 2D-3D estimation
+  //////////////////////////////////////////////////////////////////////////////
+
+  AbsolutePoseEstimationOptions abs_pose_options;
+  AbsolutePoseRefinementOptions abs_pose_refinement_options;
+  SetUpNextImagePoseEstimation(options,
+                               image,
+                               &camera,
+                               &abs_pose_options,
+                               &abs_pose_refinement_options);
+
+  size_t num_inliers;
+  std::vector<char> inlier_mask;
+
+  // The pose seeded from the position prior is only refined, if it has enough
+  // inliers. Otherwise, the pose is estimated by the full RANSAC. The seeding
+  // requires known intrinsics, so it is not used to estimate the focal length.
+  if (options.abs_pose_use_position_prior &&
+      !abs_pose_options.estimate_focal_length) {
+    const Camera prior_camera = camera;
+    Rigid3d prior_cam_from_world;
+    if (EstimateNextImagePoseFromPositionPrior(options,
+                                               image_id,
+                                               camera,
+                                               tri_points2D,
+                                               tri_points3D,
+                                               &prior_cam_from_world,
+                                               &num_inliers,
+                                               &inlier_mask) &&
+        RefineAbsolutePose(abs_pose_refinement_options,
+                           inlier_mask,
+                           tri_points2D,
+                           tri_points3D,
+                           &prior_cam_from_world,
+                           &camera)) {
+      image.CamFromWorld() = prior_cam_from_world;
+      ContinueNextImageTracks(image_id, tri_corrs, inlier_mask);
+      return true;
+    }
+    camera = prior_camera;
+  }
 
   if (!EstimateAbsolutePose(abs_pose_options,
                             tri_points2D,
@@ -516,6 +1245,146 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
     return false;
   }
 
+  ContinueNextImageTracks(image_id, tri_corrs, inlier_mask);
+
+  return true;
+}
+
+bool IncrementalMapper::UpdatePositionPriorAlignment(const Options& options) {
+  // The alignment is re-estimated, once the reconstruction has grown by 10%.
+  const size_t num_reg_images = reconstruction_->NumRegImages();
+  if (position_prior_alignment_num_reg_images_ > 0 &&
+      10 * num_reg_images < 11 * position_prior_alignment_num_reg_images_) {
+    return position_prior_alignment_valid_;
+  }
+
+  position_prior_alignment_valid_ = false;
+  position_prior_alignment_num_reg_images_ = num_reg_images;
+
+  std::vector<Eigen::Vector3d> proj_centers;
+  std::vector<Eigen::Vector3d> prior_positions;
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    if (database_cache_->ExistsPosePrior(image_id)) {
+      proj_centers.push_back(
+          reconstruction_->Image(image_id).ProjectionCenter());
+      prior_positions.push_back(
+          CartesianPositionPrior(database_cache_->PosePrior(image_id)));
+    }
+  }
+
+  const size_t kMinNumAlignmentImages = 3;
+  if (proj_centers.size() < kMinNumAlignmentImages) {
+    return false;
+  }
+
+  // The errors of the alignment are measured in the prior coordinate system.
+  RANSACOptions ransac_options;
+  ransac_options.max_error = options.abs_pose_position_prior_max_error;
+  LORANSAC<SimilarityTransformEstimator<3, true>,
+           SimilarityTransformEstimator<3, true>>
+      ransac(ransac_options);
+  const auto report = ransac.Estimate(proj_centers, prior_positions);
+  if (!report.success || report.support.num_inliers < kMinNumAlignmentImages) {
+    return false;
+  }
+
+  reconstruction_from_position_prior_ =
+      Inverse(Sim3d::FromMatrix(report.model));
+  position_prior_alignment_valid_ = true;
+
+  return true;
+}
+
+bool IncrementalMapper::EstimateNextImagePoseFromPositionPrior(
+    const Options& options,
+    const image_t image_id,
+    const Camera& camera,
+    const std::vector<Eigen::Vector2d>& tri_points2D,
+    const std::vector<Eigen::Vector3d>& tri_points3D,
+    Rigid3d* cam_from_world,
+    size_t* num_inliers,
+    std::vector<char>* inlier_mask) {
+  if (!database_cache_->ExistsPosePrior(image_id) ||
+      !UpdatePositionPriorAlignment(options)) {
+    return false;
+  }
+
+  const Eigen::Vector3d proj_center =
+      reconstruction_from_position_prior_ *
+      CartesianPositionPrior(database_cache_->PosePrior(image_id));
+
+  // With a known projection center, the rotation is determined by the
+  // directions to two 3D points, which are matched to their viewing rays.
+  const size_t num_corrs = tri_points2D.size();
+  std::vector<Eigen::Vector3d> cam_rays(num_corrs);
+  std::vector<Eigen::Vector3d> world_rays(num_corrs);
+  for (size_t i = 0; i < num_corrs; ++i) {
+    cam_rays[i] = camera.CamFromImg(tri_points2D[i]).homogeneous().normalized();
+    world_rays[i] = (tri_points3D[i] - proj_center).normalized();
+  }
+
+  const double max_squared_error =
+      options.abs_pose_max_error * options.abs_pose_max_error;
+  auto CountInliers = [&](const Rigid3d& candidate_cam_from_world,
+                          std::vector<char>* candidate_inlier_mask) {
+    candidate_inlier_mask->assign(num_corrs, false);
+    size_t num_candidate_inliers = 0;
+    for (size_t i = 0; i < num_corrs; ++i) {
+      if (CalculateSquaredReprojectionError(tri_points2D[i],
+                                            tri_points3D[i],
+                                            candidate_cam_from_world,
+                                            camera) <= max_squared_error) {
+        (*candidate_inlier_mask)[i] = true;
+        num_candidate_inliers += 1;
+      }
+    }
+    return num_candidate_inliers;
+  };
+
+  // The two-point samples are much cheaper than the P3P samples of the full
+  // RANSAC, such that a small fixed number of trials suffices.
+  const int kNumTrials = 100;
+  const double kMinSinRayAngle = 0.01;
+  *num_inliers = 0;
+  std::vector<char> candidate_inlier_mask;
+  for (int trial = 0; trial < kNumTrials; ++trial) {
+    const size_t idx1 = RandomUniformInteger<size_t>(0, num_corrs - 1);
+    const size_t idx2 = RandomUniformInteger<size_t>(0, num_corrs - 1);
+    const Eigen::Vector3d world_normal =
+        world_rays[idx1].cross(world_rays[idx2]);
+    const Eigen::Vector3d cam_normal = cam_rays[idx1].cross(cam_rays[idx2]);
+    if (world_normal.norm() < kMinSinRayAngle ||
+        cam_normal.norm() < kMinSinRayAngle) {
+      continue;
+    }
+
+    Eigen::Matrix3d world_dirs;
+    world_dirs << world_rays[idx1], world_rays[idx2], world_normal.normalized();
+    Eigen::Matrix3d cam_dirs;
+    cam_dirs << cam_rays[idx1], cam_rays[idx2], cam_normal.normalized();
+    const Eigen::Quaterniond cam_from_world_rotation(
+        RotationFromDirections(world_dirs, cam_dirs));
+    const Rigid3d candidate_cam_from_world(
+        cam_from_world_rotation, -(cam_from_world_rotation * proj_center));
+
+    const size_t num_candidate_inliers =
+        CountInliers(candidate_cam_from_world, &candidate_inlier_mask);
+    if (num_candidate_inliers > *num_inliers) {
+      *num_inliers = num_candidate_inliers;
+      *cam_from_world = candidate_cam_from_world;
+      std::swap(*inlier_mask, candidate_inlier_mask);
+    }
+  }
+
+  return *num_inliers >=
+             static_cast<size_t>(options.abs_pose_min_num_inliers) &&
+         *num_inliers >= options.abs_pose_min_inlier_ratio * num_corrs;
+}
+
+void IncrementalMapper::ContinueNextImageTracks(
+    const image_t image_id,
+    const std::vector<std::pair<point2D_t, point3D_t>>& tri_corrs,
+    const std::vector<char>& inlier_mask) {
   //////////////////////////////////////////////////////////////////////////////
   // Continue tracks
   //////////////////////////////////////////////////////////////////////////////
@@ -523,6 +1392,7 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   reconstruction_->RegisterImage(image_id);
   RegisterImageEvent(image_id);
 
+  const Image& image = reconstruction_->Image(image_id);
   for (size_t i = 0; i < inlier_mask.size(); ++i) {
     if (inlier_mask[i]) {
       const point2D_t point2D_idx = tri_corrs[i].first;
@@ -535,13 +1405,12 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
       }
     }
   }
-
-  return true;
 }
 
 size_t IncrementalMapper::TriangulateImage(
     const IncrementalTriangulator::Options& tri_options,
     const image_t image_id) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::TriangulateImage");
   THROW_CHECK_NOTNULL(reconstruction_);
   VLOG(1) << "=> Continued observations: "
           << reconstruction_->Image(image_id).NumPoints3D();
@@ -553,18 +1422,21 @@ size_t IncrementalMapper::TriangulateImage(
 
 size_t IncrementalMapper::Retriangulate(
     const IncrementalTriangulator::Options& tri_options) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::Retriangulate");
   THROW_CHECK_NOTNULL(reconstruction_);
   return triangulator_->Retriangulate(tri_options);
 }
 
 size_t IncrementalMapper::CompleteTracks(
     const IncrementalTriangulator::Options& tri_options) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::CompleteTracks");
   THROW_CHECK_NOTNULL(reconstruction_);
   return triangulator_->CompleteAllTracks(tri_options);
 }
 
 size_t IncrementalMapper::MergeTracks(
     const IncrementalTriangulator::Options& tri_options) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::MergeTracks");
   THROW_CHECK_NOTNULL(reconstruction_);
   return triangulator_->MergeAllTracks(tri_options);
 }
@@ -585,6 +1457,7 @@ IncrementalMapper::AdjustLocalBundle(
     const IncrementalTriangulator::Options& tri_options,
     const image_t image_id,
     const std::unordered_set<point3D_t>& point3D_ids) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::AdjustLocalBundle");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK(options.Check());
@@ -656,12 +1529,26 @@ IncrementalMapper::AdjustLocalBundle(
       }
     }
 
-    // Adjust the local bundle.
+    // Adjust the local bundle and measure the drift of its observations.
+    const std::vector<image_t> adjusted_image_ids(ba_config.Images().begin(),
+                                                  ba_config.Images().end());
+    const std::vector<Eigen::Vector2d> projections_before =
+        ProjectObservations(*reconstruction_, adjusted_image_ids);
+
+    // The windows of consecutive local bundle adjustments mostly overlap,
+    // such that most of their cost functions can be reused.
     BundleAdjuster bundle_adjuster(ba_options, ba_config);
+    bundle_adjuster.SetCostFunctionPool(local_ba_cost_function_pool_.get());
     bundle_adjuster.Solve(reconstruction_.get());
 
     report.num_adjusted_observations =
         bundle_adjuster.Summary().num_residuals / 2;
+    report.mean_reproj_drift = MeanProjectionDisplacement(
+        projections_before,
+        ProjectObservations(*reconstruction_, adjusted_image_ids));
+    local_ba_drift_ += report.mean_reproj_drift;
+    local_ba_drift_image_ids_.insert(adjusted_image_ids.begin(),
+                                     adjusted_image_ids.end());
 
     // Merge refined tracks with other existing points.
     report.num_merged_observations =
@@ -697,6 +1584,7 @@ IncrementalMapper::AdjustLocalBundle(
 
 bool IncrementalMapper::AdjustGlobalBundle(
     const Options& options, const BundleAdjustmentOptions& ba_options) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::AdjustGlobalBundle");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
 
@@ -742,8 +1630,76 @@ bool IncrementalMapper::AdjustGlobalBundle(
     ba_config.SetConstantCamPositions(reg_image_ids[1], {0});
   }
 
+  local_ba_drift_ = 0;
+  local_ba_drift_image_ids_.clear();
+
   // Run bundle adjustment.
   BundleAdjuster bundle_adjuster(ba_options_tmp, ba_config);
+  if (ba_options_tmp.marginalize_constant_pose_points) {
+    bundle_adjuster.SetMarginalizationCache(
+        global_ba_marginalization_cache_.get());
+  }
+  return bundle_adjuster.Solve(reconstruction_.get());
+}
+
+bool IncrementalMapper::AdjustPartialGlobalBundle(
+    const Options& options,
+    const BundleAdjustmentOptions& ba_options,
+    const std::unordered_set<image_t>& image_ids) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::AdjustPartialGlobalBundle");
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_NOTNULL(obs_manager_);
+
+  // Avoid degeneracies in bundle adjustment.
+  obs_manager_->FilterObservationsWithNegativeDepth();
+
+  BundleAdjustmentConfig ba_config;
+  std::unordered_map<camera_t, size_t> num_images_per_camera;
+  for (const image_t image_id : image_ids) {
+    const Image& image = reconstruction_->Image(image_id);
+    if (!image.IsRegistered()) {
+      continue;
+    }
+    ba_config.AddImage(image_id);
+    num_images_per_camera[image.CameraId()] += 1;
+    if (options.fix_existing_images && existing_image_ids_.count(image_id)) {
+      ba_config.SetConstantCamPose(image_id);
+    }
+    // Add the observations of the other images as constant residuals.
+    for (const Point2D& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D()) {
+        ba_config.AddVariablePoint(point2D.point3D_id);
+      }
+    }
+  }
+
+  if (ba_config.NumImages() == 0) {
+    return false;
+  }
+
+  // As in local bundle adjustment, only refine the cameras whose registered
+  // images are all part of the adjustment.
+  for (const auto& [camera_id, num_images] : num_images_per_camera) {
+    if (num_images < num_reg_images_per_camera_.at(camera_id)) {
+      ba_config.SetConstantCamIntrinsics(camera_id);
+    }
+  }
+
+  // Fix 7-DOFs of the bundle adjustment problem, if no constant images
+  // outside of the adjusted images fix the gauge.
+  if (ba_config.NumImages() == reconstruction_->NumRegImages()) {
+    const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
+    ba_config.SetConstantCamPose(reg_image_ids[0]);
+    if (!options.fix_existing_images ||
+        !existing_image_ids_.count(reg_image_ids[1])) {
+      ba_config.SetConstantCamPositions(reg_image_ids[1], {0});
+    }
+  }
+
+  local_ba_drift_ = 0;
+  local_ba_drift_image_ids_.clear();
+
+  BundleAdjuster bundle_adjuster(ba_options, ba_config);
   return bundle_adjuster.Solve(reconstruction_.get());
 }
 
@@ -789,7 +1745,11 @@ void IncrementalMapper::IterativeGlobalRefinement(
     const bool normalize_reconstruction) {
   CompleteAndMergeTracks(tri_options);
   VLOG(1) << "=> Retriangulated observations: " << Retriangulate(tri_options);
-  for (int i = 0; i < max_num_refinements; ++i) {
+  // Outliers rejected during the solve already converge within a single
+  // adjustment, which makes the repeated adjustments and filtering redundant.
+  const int num_refinements =
+      ba_options.outlier_max_reproj_error > 0 ? 1 : max_num_refinements;
+  for (int i = 0; i < num_refinements; ++i) {
     const size_t num_observations = reconstruction_->ComputeNumObservations();
     AdjustGlobalBundle(options, ba_options);
     if (normalize_reconstruction) {
@@ -811,6 +1771,7 @@ void IncrementalMapper::IterativeGlobalRefinement(
 }
 
 size_t IncrementalMapper::FilterImages(const Options& options) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::FilterImages");
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK(options.Check());
@@ -839,6 +1800,7 @@ size_t IncrementalMapper::FilterImages(const Options& options) {
 }
 
 size_t IncrementalMapper::FilterPoints(const Options& options) {
+  COLMAP_PROFILE_SCOPE("IncrementalMapper::FilterPoints");
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK(options.Check());
   const size_t num_filtered_observations = obs_manager_->FilterAllPoints3D(
@@ -875,7 +1837,17 @@ IncrementalMapper::NumRegImagesPerCamera() const {
   return num_reg_images_per_camera_;
 }
 
+double IncrementalMapper::LocalBundleDrift() const { return local_ba_drift_; }
+
+const std::unordered_set<image_t>& IncrementalMapper::LocalBundleDriftImageIds()
+    const {
+  return local_ba_drift_image_ids_;
+}
+
 size_t IncrementalMapper::NumTotalRegImages() const {
+  if (image_registry_) {
+    return image_registry_->NumClaimedImages();
+  }
   return num_total_reg_images_;
 }
 
@@ -921,8 +1893,9 @@ std::vector<image_t> IncrementalMapper::FindFirstInitialImage(
 
     // Only use images for initialization that are not registered in any
     // of the other reconstructions.
-    if (num_registrations_.count(image.first) > 0 &&
-        num_registrations_.at(image.first) > 0) {
+    if ((num_registrations_.count(image.first) > 0 &&
+         num_registrations_.at(image.first) > 0) ||
+        (image_registry_ && image_registry_->IsClaimed(image.first))) {
       continue;
     }
 
@@ -976,8 +1949,9 @@ std::vector<image_t> IncrementalMapper::FindSecondInitialImage(
     const auto corr_range =
         correspondence_graph->FindCorrespondences(image_id1, point2D_idx);
     for (const auto* corr = corr_range.beg; corr < corr_range.end; ++corr) {
-      if (num_registrations_.count(corr->image_id) == 0 ||
-          num_registrations_.at(corr->image_id) == 0) {
+      if ((num_registrations_.count(corr->image_id) == 0 ||
+           num_registrations_.at(corr->image_id) == 0) &&
+          (!image_registry_ || !image_registry_->IsClaimed(corr->image_id))) {
         num_correspondences[corr->image_id] += 1;
       }
     }
@@ -1043,9 +2017,10 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
   THROW_CHECK(image.IsRegistered());
 
   // Extract all images that have at least one 3D point with the query image
-  // in common, and simultaneously count the number of common 3D points.
+  // in common and the number of common 3D points from the covisibility graph.
 
-  std::unordered_map<image_t, size_t> shared_observations;
+  const std::unordered_map<image_t, size_t>& shared_observations =
+      obs_manager_->CovisibleImages(image_id);
 
   std::unordered_set<point3D_t> point3D_ids;
   point3D_ids.reserve(image.NumPoints3D());
@@ -1053,12 +2028,6 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
   for (const Point2D& point2D : image.Points2D()) {
     if (point2D.HasPoint3D()) {
       point3D_ids.insert(point2D.point3D_id);
-      const Point3D& point3D = reconstruction_->Point3D(point2D.point3D_id);
-      for (const TrackElement& track_el : point3D.track.Elements()) {
-        if (track_el.image_id != image_id) {
-          shared_observations[track_el.image_id] += 1;
-        }
-      }
     }
   }
 
@@ -1211,6 +2180,8 @@ void IncrementalMapper::RegisterImageEvent(const image_t image_id) {
       num_reg_images_per_camera_[image.CameraId()];
   num_reg_images_for_camera += 1;
 
+  modified_next_image_ids_.insert(image_id);
+
   size_t& num_regs_for_image = num_registrations_[image_id];
   num_regs_for_image += 1;
   if (num_regs_for_image == 1) {
@@ -1227,6 +2198,8 @@ void IncrementalMapper::DeRegisterImageEvent(const image_t image_id) {
   THROW_CHECK_GT(num_reg_images_for_camera, 0);
   num_reg_images_for_camera -= 1;
 
+  modified_next_image_ids_.insert(image_id);
+
   size_t& num_regs_for_image = num_registrations_[image_id];
   num_regs_for_image -= 1;
   if (num_regs_for_image == 0) {
@@ -1234,6 +2207,100 @@ void IncrementalMapper::DeRegisterImageEvent(const image_t image_id) {
   } else if (num_regs_for_image > 0) {
     num_shared_reg_images_ -= 1;
   }
+
+  if (image_registry_) {
+    image_registry_->Release(image_id);
+  }
+}
+
+void IncrementalMapper::UpdateNextImageRanks(const Options& options) {
+  std::function<float(image_t, const class ObservationManager&)>
+      rank_image_func;
+  switch (options.image_selection_method) {
+    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_NUM:
+      rank_image_func = RankNextImageMaxVisiblePointsNum;
+      break;
+    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_RATIO:
+      rank_image_func = RankNextImageMaxVisiblePointsRatio;
+      break;
+    case Options::ImageSelectionMethod::MIN_UNCERTAINTY:
+      rank_image_func = RankNextImageMinUncertainty;
+      break;
+  }
+
+  auto UpdateNextImageRank = [&](const image_t image_id) {
+    const auto rank_it = next_image_ranks_.find(image_id);
+    if (rank_it != next_image_ranks_.end()) {
+      sorted_next_image_ranks_.erase({-rank_it->second, image_id});
+      next_image_ranks_.erase(rank_it);
+    }
+
+    // Registered images and images without any observations are never
+    // candidates for the next image.
+    if (reconstruction_->Image(image_id).IsRegistered() ||
+        obs_manager_->NumObservations(image_id) == 0) {
+      return;
+    }
+
+    const float rank = rank_image_func(image_id, *obs_manager_);
+    next_image_ranks_.emplace(image_id, rank);
+    sorted_next_image_ranks_.emplace(-rank, image_id);
+  };
+
+  if (!next_image_ranks_valid_ ||
+      next_image_selection_method_ != options.image_selection_method) {
+    next_image_ranks_.clear();
+    sorted_next_image_ranks_.clear();
+    for (const auto& image : reconstruction_->Images()) {
+      UpdateNextImageRank(image.first);
+    }
+    next_image_ranks_valid_ = true;
+    next_image_selection_method_ = options.image_selection_method;
+  } else {
+    for (const image_t image_id : obs_manager_->GetModifiedImages()) {
+      UpdateNextImageRank(image_id);
+    }
+    for (const image_t image_id : modified_next_image_ids_) {
+      UpdateNextImageRank(image_id);
+    }
+  }
+
+  obs_manager_->ClearModifiedImages();
+  modified_next_image_ids_.clear();
+}
+
+void IncrementalMapper::LoadPoints2DForImageAndNeighbors(
+    const image_t image_id) {
+  if (!database_cache_->IsLazy()) {
+    return;
+  }
+
+  const std::shared_ptr<const class CorrespondenceGraph> correspondence_graph =
+      database_cache_->CorrespondenceGraph();
+
+  std::unordered_set<image_t> load_image_ids = {image_id};
+  if (correspondence_graph->ExistsImage(image_id)) {
+    const point2D_t num_points2D =
+        correspondence_graph->NumPoints2DForImage(image_id);
+    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+         ++point2D_idx) {
+      const auto corr_range =
+          correspondence_graph->FindCorrespondences(image_id, point2D_idx);
+      for (const auto* corr = corr_range.beg; corr < corr_range.end; ++corr) {
+        load_image_ids.insert(corr->image_id);
+      }
+    }
+  }
+
+  for (const image_t load_image_id : load_image_ids) {
+    if (!database_cache_->ExistsImage(load_image_id)) {
+      continue;
+    }
+    Image& image = reconstruction_->Image(load_image_id);
+    if (image.NumPoints2D() == 0) {
+      image.SetPoints2D(*database_cache_->Points2D(load_image_id));
+    }
+  }
 }
 
 bool IncrementalMapper::EstimateInitialTwoViewGeometry(
@@ -1251,17 +2318,10 @@ bool IncrementalMapper::EstimateInitialTwoViewGeometry(
       database_cache_->CorrespondenceGraph()->FindCorrespondencesBetweenImages(
           image_id1, image_id2);
 
-  std::vector<Eigen::Vector2d> points1;
-  points1.reserve(image1.NumPoints2D());
-  for (const auto& point : image1.Points2D()) {
-    points1.push_back(point.xy);
-  }
-
-  std::vector<Eigen::Vector2d> points2;
-  points2.reserve(image2.NumPoints2D());
-  for (const auto& point : image2.Points2D()) {
-    points2.push_back(point.xy);
-  }
+  const std::vector<Eigen::Vector2d> points1 =
+      *database_cache_->Points2D(image_id1);
+  const std::vector<Eigen::Vector2d> points2 =
+      *database_cache_->Points2D(image_id2);
 
   TwoViewGeometryOptions two_view_geometry_options;
   two_view_geometry_options.ransac_options.min_num_trials = 30;
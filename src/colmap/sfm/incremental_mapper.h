@@ -30,14 +30,44 @@
 #pragma once
 
 #include "colmap/estimators/bundle_adjustment.h"
+#include "colmap/estimators/pose.h"
+#include "colmap/geometry/sim3.h"
+#include "colmap/scene/camera_rig.h"
 #include "colmap/scene/database.h"
 #include "colmap/scene/database_cache.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sfm/incremental_triangulator.h"
 #include "colmap/sfm/observation_manager.h"
 
+#include <atomic>
+#include <set>
+
 namespace colmap {
 
+// Registry of the images that are registered in any of the reconstructions,
+// which multiple mappers reconstruct concurrently from the same database
+// cache. Each image can only be claimed by one of the mappers at a time, such
+// that the concurrent reconstructions do not share any images. Thread-safe.
+class IncrementalMapperImageRegistry {
+ public:
+  explicit IncrementalMapperImageRegistry(const DatabaseCache& database_cache);
+
+  // Claim the image for registration. Returns false, if it is already claimed.
+  bool Claim(image_t image_id);
+
+  // Release the claim of an image that is no longer registered.
+  void Release(image_t image_id);
+
+  bool IsClaimed(image_t image_id) const;
+
+  // Number of currently claimed images.
+  size_t NumClaimedImages() const;
+
+ private:
+  std::unordered_map<image_t, std::atomic<bool>> claimed_;
+  std::atomic<size_t> num_claimed_images_;
+};
+
 // Class that provides all functionality for the incremental reconstruction
 // procedure. Example usage:
 //
@@ -94,6 +124,18 @@ class IncrementalMapper {
     // Whether to estimate the extra parameters in absolute pose estimation.
     bool abs_pose_refine_extra_params = true;
 
+    // Whether to seed the absolute pose estimation from the position priors
+    // in the database, once the reconstruction can be aligned to the priors
+    // of its registered images. Only the rotation is then sampled from pairs
+    // of 2D-3D correspondences and the full RANSAC is only used as fallback,
+    // if the seeded pose has too few inliers or the focal length is unknown.
+    bool abs_pose_use_position_prior = false;
+
+    // Maximum distance between the aligned projection centers and the position
+    // priors of the registered images, in the unit of the priors, e.g., meters
+    // for GPS in the WGS84 coordinate system.
+    double abs_pose_position_prior_max_error = 1.0;
+
     // Number of images to optimize in local bundle adjustment.
     int local_ba_num_images = 6;
 
@@ -138,6 +180,42 @@ class IncrementalMapper {
     size_t num_completed_observations = 0;
     size_t num_filtered_observations = 0;
     size_t num_adjusted_observations = 0;
+    // Mean displacement in pixels of the projections of the adjusted
+    // observations, as a measure of how much the local bundle drifted.
+    double mean_reproj_drift = 0;
+  };
+
+  // The pose of a next image that was estimated without modifying the
+  // reconstruction, see `EstimateNextImagePoses`.
+  struct NextImagePose {
+    image_t image_id = kInvalidImageId;
+
+    // Whether the pose was successfully estimated.
+    bool success = false;
+
+    // The estimated pose and camera with the (re-)estimated parameters.
+    Rigid3d cam_from_world;
+    Camera camera;
+
+    // Whether the camera parameters were (re-)estimated from this image.
+    bool estimated_camera = false;
+
+    AbsolutePoseRefinementOptions refinement_options;
+  };
+
+  // The state of the mapper that is not contained in the reconstructions,
+  // e.g., to resume an interrupted reconstruction from a checkpoint.
+  struct State {
+    size_t num_total_reg_images = 0;
+    size_t num_shared_reg_images = 0;
+    std::unordered_map<image_t, size_t> init_num_reg_trials;
+    std::unordered_set<image_pair_t> init_image_pairs;
+    std::unordered_map<image_t, size_t> num_registrations;
+    std::unordered_set<image_t> filtered_images;
+    std::unordered_map<image_t, size_t> num_reg_trials;
+    std::unordered_set<image_t> existing_image_ids;
+    double local_ba_drift = 0;
+    std::unordered_set<image_t> local_ba_drift_image_ids;
   };
 
   // Create incremental mapper. The database cache must live for the entire
@@ -156,9 +234,29 @@ class IncrementalMapper {
   // be updated accordingly.
   void EndReconstruction(bool discard);
 
+  // Add images that were added to the database cache after the beginning of
+  // the reconstruction, e.g., by `DatabaseCache::AddNewImages`, to the current
+  // reconstruction, such that they are considered by `FindNextImages`.
+  void AddImages(const std::vector<image_t>& image_ids);
+
+  // Get and restore the state of the mapper. When resuming a reconstruction,
+  // the state must be restored after `BeginReconstruction`, which otherwise
+  // counts the registered images of the reconstruction as new registrations.
+  State GetState() const;
+  void SetState(State state);
+
+  // Share the registered images with other mappers, which reconstruct
+  // concurrently from the same database cache. Images that are claimed by
+  // any of the mappers are no longer considered for initialization and
+  // registration by the others. Must be set before `BeginReconstruction`.
+  void SetImageRegistry(
+      std::shared_ptr<IncrementalMapperImageRegistry> image_registry);
+  const std::shared_ptr<IncrementalMapperImageRegistry>& ImageRegistry() const;
+
   // Find initial image pair to seed the incremental reconstruction. The image
   // pairs should be passed to `RegisterInitialImagePair`. This function
   // automatically ignores image pairs that failed to register previously.
+  // With an image registry, the returned images are claimed by the mapper.
   bool FindInitialImagePair(const Options& options,
                             TwoViewGeometry& two_view_geometry,
                             image_t& image_id1,
@@ -179,6 +277,39 @@ class IncrementalMapper {
   // a previous call to `RegisterInitialImagePair` was successful.
   bool RegisterNextImage(const Options& options, image_t image_id);
 
+  // Estimate the poses of multiple next images in parallel, without modifying
+  // the reconstruction. Each image counts as a registration trial. The poses
+  // are returned in the order of the given images and the successful ones
+  // should be passed to `RegisterNextImage` one after the other.
+  std::vector<NextImagePose> EstimateNextImagePoses(
+      const Options& options, const std::vector<image_t>& image_ids);
+
+  // Register a next image with a pose from `EstimateNextImagePoses`. Since the
+  // reconstruction may have changed after the estimation, the pose is first
+  // re-validated against the current 3D points and then refined. If the pose
+  // is no longer valid, the pose is estimated again as in `RegisterNextImage`.
+  bool RegisterNextImage(const Options& options, const NextImagePose& pose);
+
+  // Set the camera rigs, whose snapshots are registered jointly by
+  // `RegisterNextRigSnapshot`. The relative poses of the cameras in the rigs
+  // must be known. Must be set before `BeginReconstruction`.
+  void SetCameraRigs(std::vector<CameraRig> camera_rigs);
+  const std::vector<CameraRig>& CameraRigs() const;
+
+  // Whether the image is part of a snapshot of any of the camera rigs.
+  bool IsRigSnapshotImage(image_t image_id) const;
+
+  // Attempt to register all unregistered images of the rig snapshot of the
+  // given image with a single generalized absolute pose estimation of the rig
+  // from the 2D-3D correspondences of all its images. Each image counts as a
+  // registration trial. Only images of cameras with known intrinsics take part
+  // in the estimation and the images without any inliers are not registered.
+  // Falls back to `RegisterNextImage`, if the image is not part of a snapshot.
+  // The registered images are returned in `reg_image_ids`.
+  bool RegisterNextRigSnapshot(const Options& options,
+                               image_t image_id,
+                               std::vector<image_t>* reg_image_ids);
+
   // Triangulate observations of image.
   size_t TriangulateImage(const IncrementalTriangulator::Options& tri_options,
                           image_t image_id);
@@ -221,6 +352,13 @@ class IncrementalMapper {
   bool AdjustGlobalBundle(const Options& options,
                           const BundleAdjustmentOptions& ba_options);
 
+  // Partial global bundle adjustment of the given registered images and all
+  // their 3D points. The other registered images observing these points are
+  // kept constant and fix the gauge of the problem.
+  bool AdjustPartialGlobalBundle(const Options& options,
+                                 const BundleAdjustmentOptions& ba_options,
+                                 const std::unordered_set<image_t>& image_ids);
+
   // Perform multiple rounds of local bundle adjustment.
   void IterativeLocalRefinement(
       int max_num_refinements,
@@ -251,13 +389,19 @@ class IncrementalMapper {
   const std::unordered_set<image_t>& ExistingImageIds() const;
   const std::unordered_map<camera_t, size_t>& NumRegImagesPerCamera() const;
 
-  // Number of images that are registered in at least on reconstruction.
+  // Number of images that are registered in at least on reconstruction,
+  // including the concurrent reconstructions sharing the image registry.
   size_t NumTotalRegImages() const;
 
   // Number of shared images between current reconstruction and all other
   // previous reconstructions.
   size_t NumSharedRegImages() const;
 
+  // Accumulated drift of all local bundle adjustments and the images they
+  // adjusted since the last (partial) global bundle adjustment.
+  double LocalBundleDrift() const;
+  const std::unordered_set<image_t>& LocalBundleDriftImageIds() const;
+
   // Get changed 3D points, since the last call to `ClearModifiedPoints3D`.
   const std::unordered_set<point3D_t>& GetModifiedPoints3D();
 
@@ -289,11 +433,79 @@ class IncrementalMapper {
   std::vector<image_t> FindSecondInitialImage(const Options& options,
                                               image_t image_id1) const;
 
+  // Find the 2D-3D correspondences of an image to the 3D points observed by
+  // the registered images.
+  void FindNextImageCorrespondences(
+      const Options& options,
+      image_t image_id,
+      std::vector<std::pair<point2D_t, point3D_t>>* tri_corrs,
+      std::vector<Eigen::Vector2d>* tri_points2D,
+      std::vector<Eigen::Vector3d>* tri_points3D) const;
+
+  // Set up the absolute pose estimation and refinement of an image, which
+  // resets the given camera, if its parameters must be (re-)estimated. Returns
+  // whether the camera parameters are (re-)estimated.
+  bool SetUpNextImagePoseEstimation(
+      const Options& options,
+      const Image& image,
+      Camera* camera,
+      AbsolutePoseEstimationOptions* abs_pose_options,
+      AbsolutePoseRefinementOptions* abs_pose_refinement_options) const;
+
+  // Estimate the pose of a next image without modifying the reconstruction.
+  bool EstimateNextImagePose(const Options& options,
+                             image_t image_id,
+                             NextImagePose* pose) const;
+
+  // Estimate the pose of a next image and register it, without counting a
+  // registration trial.
+  bool EstimateAndRegisterNextImage(const Options& options, image_t image_id);
+
+  // Align the position priors of the registered images to the reconstruction,
+  // if the alignment is missing or outdated. Returns whether it is valid.
+  bool UpdatePositionPriorAlignment(const Options& options);
+
+  // Estimate the pose of a next image with the projection center seeded from
+  // its position prior, see `abs_pose_use_position_prior`. Only the rotation
+  // is sampled from pairs of 2D-3D correspondences.
+  bool EstimateNextImagePoseFromPositionPrior(
+      const Options& options,
+      image_t image_id,
+      const Camera& camera,
+      const std::vector<Eigen::Vector2d>& tri_points2D,
+      const std::vector<Eigen::Vector3d>& tri_points3D,
+      Rigid3d* cam_from_world,
+      size_t* num_inliers,
+      std::vector<char>* inlier_mask);
+
+  // Register a next image with a previously estimated pose, see the public
+  // `RegisterNextImage`.
+  bool RegisterEstimatedNextImage(const Options& options,
+                                  const NextImagePose& pose);
+
+  // Register the image with its estimated pose and continue the tracks of the
+  // inlier 2D-3D correspondences.
+  void ContinueNextImageTracks(
+      image_t image_id,
+      const std::vector<std::pair<point2D_t, point3D_t>>& tri_corrs,
+      const std::vector<char>& inlier_mask);
+
   // Register / De-register image in current reconstruction and update
   // the number of shared images between all reconstructions.
   void RegisterImageEvent(image_t image_id);
   void DeRegisterImageEvent(image_t image_id);
 
+  // Load the 2D points of the image and of all images with correspondences to
+  // it into the reconstruction, if the database cache loads them lazily. The
+  // observation manager and triangulator only access the 2D points of these
+  // images, once the image is registered.
+  void LoadPoints2DForImageAndNeighbors(image_t image_id);
+
+  // Update the cached ranks of the next image candidates. Only images whose
+  // visible 3D points or registration status changed since the last call are
+  // re-ranked, unless the image selection method changed.
+  void UpdateNextImageRanks(const Options& options);
+
   // Class that holds all necessary data from database in memory.
   const std::shared_ptr<const DatabaseCache> database_cache_;
 
@@ -306,6 +518,21 @@ class IncrementalMapper {
   // Class that is responsible for incremental triangulation.
   std::shared_ptr<IncrementalTriangulator> triangulator_;
 
+  // Reusable cost functions of the local bundle adjustments.
+  std::unique_ptr<BundleAdjustmentCostFunctionPool> local_ba_cost_function_pool_;
+
+  // Reusable priors of the marginalized points of the global bundle
+  // adjustments, e.g., the points only observed by fixed existing images.
+  std::unique_ptr<BundleAdjustmentMarginalizationCache>
+      global_ba_marginalization_cache_;
+
+  // Camera rigs and the rig and snapshot index of each of their images.
+  std::vector<CameraRig> camera_rigs_;
+  std::unordered_map<image_t, std::pair<size_t, size_t>> rig_snapshot_idxs_;
+
+  // Registry of the images claimed by concurrent reconstructions, if any.
+  std::shared_ptr<IncrementalMapperImageRegistry> image_registry_;
+
   // Number of images that are registered in at least on reconstruction.
   size_t num_total_reg_images_;
 
@@ -338,6 +565,30 @@ class IncrementalMapper {
   // This image list will be non-empty, if the reconstruction is continued from
   // an existing reconstruction.
   std::unordered_set<image_t> existing_image_ids_;
+
+  // Alignment from the coordinate system of the position priors to the
+  // reconstruction and the number of registered images when it was estimated.
+  // The alignment is re-estimated as the reconstruction grows.
+  bool position_prior_alignment_valid_ = false;
+  size_t position_prior_alignment_num_reg_images_ = 0;
+  Sim3d reconstruction_from_position_prior_;
+
+  // Ranks of the unregistered images used to select the next image. The set
+  // is ordered by decreasing rank and increasing image identifier, i.e. the
+  // rank is stored negated.
+  bool next_image_ranks_valid_ = false;
+  Options::ImageSelectionMethod next_image_selection_method_;
+  std::unordered_map<image_t, float> next_image_ranks_;
+  std::set<std::pair<float, image_t>> sorted_next_image_ranks_;
+
+  // Images that were registered or de-registered since the last update of
+  // the next image ranks.
+  std::unordered_set<image_t> modified_next_image_ids_;
+
+  // Accumulated drift of the local bundle adjustments, which is reset by
+  // global bundle adjustment.
+  double local_ba_drift_ = 0;
+  std::unordered_set<image_t> local_ba_drift_image_ids_;
 };
 
 }  // namespace colmap
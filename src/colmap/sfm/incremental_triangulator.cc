@@ -30,12 +30,28 @@
 #include "colmap/sfm/incremental_triangulator.h"
 
 #include "colmap/estimators/triangulation.h"
+#include "colmap/math/math.h"
 #include "colmap/scene/projection.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <limits>
 
 namespace colmap {
 namespace {
 
+// Minimum number of 3D points per chunk when completing or merging tracks in
+// parallel.
+const size_t kMinNumPoints3DPerChunk = 256;
+
+// Maximum track length for which all pairs of observations are sampled when
+// estimating a triangulation.
+const int kMaxExhaustiveTrackLength = 15;
+
+const size_t kInvalidTrackIdx = std::numeric_limits<size_t>::max();
+
 bool TriangulateTrack(
     const EstimateTriangulationOptions& options,
     const std::vector<IncrementalTriangulator::CorrData>& corrs_data,
@@ -54,15 +70,24 @@ bool TriangulateTrack(
     cameras[i] = corr_data.camera;
   }
 
-  // Enforce exhaustive sampling for small track lengths.
-  EstimateTriangulationOptions options_(options);
-  const size_t kExhaustiveSamplingThreshold = 15;
-  if (points.size() <= kExhaustiveSamplingThreshold) {
-    options_.ransac_options.min_num_trials = NChooseK(points.size(), 2);
-  }
-
   return EstimateTriangulation(
-      options_, points, cams_from_world, cameras, &inlier_mask, &xyz);
+      options, points, cams_from_world, cameras, &inlier_mask, &xyz);
+}
+
+EstimateTriangulationOptions CreateTriangulationOptions(
+    const IncrementalTriangulator::Options& options) {
+  EstimateTriangulationOptions tri_options;
+  tri_options.min_tri_angle = DegToRad(options.min_angle);
+  tri_options.residual_type =
+      TriangulationEstimator::ResidualType::ANGULAR_ERROR;
+  tri_options.ransac_options.max_error =
+      DegToRad(options.create_max_angle_error);
+  tri_options.ransac_options.confidence = 0.9999;
+  tri_options.ransac_options.min_inlier_ratio = 0.02;
+  tri_options.ransac_options.max_num_trials = 10000;
+  // Enforce exhaustive sampling for small track lengths.
+  tri_options.max_exhaustive_track_length = kMaxExhaustiveTrackLength;
+  return tri_options;
 }
 
 }  // namespace
@@ -78,6 +103,7 @@ bool IncrementalTriangulator::Options::Check() const {
   CHECK_OPTION_GE(re_min_ratio, 0);
   CHECK_OPTION_LE(re_min_ratio, 1);
   CHECK_OPTION_GE(re_max_trials, 0);
+  CHECK_OPTION_GE(re_min_pose_change, 0);
   CHECK_OPTION_GT(min_angle, 0);
   return true;
 }
@@ -97,6 +123,7 @@ IncrementalTriangulator::IncrementalTriangulator(
 
 size_t IncrementalTriangulator::TriangulateImage(const Options& options,
                                                  const image_t image_id) {
+  COLMAP_PROFILE_SCOPE("IncrementalTriangulator::TriangulateImage");
   THROW_CHECK(options.Check());
 
   size_t num_tris = 0;
@@ -124,15 +151,111 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
   // Container for correspondences from reference observation to other images.
   std::vector<CorrData> corrs_data;
 
+  // With multiple threads, the correspondences of all observations are found
+  // first and the new tracks are estimated ahead in a batch. The observations
+  // are then triangulated in order as in the sequential case, where estimates
+  // are discarded if their correspondences were triangulated in the meantime.
+  const int num_eff_threads = GetEffectiveNumThreads(options.num_threads);
+  const bool estimate_ahead = num_eff_threads > 1;
+  std::vector<CorrData> all_corrs_data;
+  std::vector<size_t> corrs_offsets;
+  std::vector<size_t> track_idxs;
+  std::vector<size_t> track_offsets;
+  std::vector<char> track_success;
+  std::vector<char> track_inlier_mask;
+  std::vector<Eigen::Vector3d> track_xyzs;
+  if (estimate_ahead) {
+    TriangulationBatch batch;
+    corrs_offsets.reserve(image.NumPoints2D() + 1);
+    corrs_offsets.push_back(0);
+    track_idxs.resize(image.NumPoints2D(), kInvalidTrackIdx);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      Find(options,
+           image_id,
+           point2D_idx,
+           static_cast<size_t>(options.max_transitivity),
+           &corrs_data);
+      all_corrs_data.insert(
+          all_corrs_data.end(), corrs_data.begin(), corrs_data.end());
+      corrs_offsets.push_back(all_corrs_data.size());
+      if (corrs_data.empty()) {
+        continue;
+      }
+
+      // Same correspondences as selected by Create() in the current state.
+      ref_corr_data.point2D_idx = point2D_idx;
+      ref_corr_data.point2D = &image.Point2D(point2D_idx);
+      corrs_data.push_back(ref_corr_data);
+      const size_t track_offset = batch.NumObservations();
+      const CorrData* first_corr_data = nullptr;
+      for (const CorrData& corr_data : corrs_data) {
+        if (!corr_data.point2D->HasPoint3D()) {
+          batch.AddObservation(corr_data.point2D->xy,
+                               &corr_data.image->CamFromWorld(),
+                               corr_data.camera);
+          if (first_corr_data == nullptr) {
+            first_corr_data = &corr_data;
+          }
+        }
+      }
+
+      const size_t num_create_corrs = batch.NumObservations() - track_offset;
+      if (num_create_corrs < 2 ||
+          (options.ignore_two_view_tracks && num_create_corrs == 2 &&
+           correspondence_graph_->IsTwoViewObservation(
+               first_corr_data->image_id, first_corr_data->point2D_idx))) {
+        batch.points.resize(track_offset);
+        batch.cams_from_world.resize(track_offset);
+        batch.cameras.resize(track_offset);
+        continue;
+      }
+
+      track_idxs[point2D_idx] = batch.NumTracks();
+      batch.FinishTrack();
+    }
+
+    ThreadPool thread_pool(num_eff_threads);
+    EstimateTriangulations(CreateTriangulationOptions(options),
+                           batch,
+                           &thread_pool,
+                           &track_success,
+                           &track_inlier_mask,
+                           &track_xyzs);
+    track_offsets = std::move(batch.track_offsets);
+  }
+
   // Try to triangulate all image observations.
   for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
        ++point2D_idx) {
-    const size_t num_triangulated =
-        Find(options,
-             image_id,
-             point2D_idx,
-             static_cast<size_t>(options.max_transitivity),
-             &corrs_data);
+    size_t num_triangulated = 0;
+    CreateEstimate estimate;
+    const CreateEstimate* estimate_ptr = nullptr;
+    if (estimate_ahead) {
+      corrs_data.assign(all_corrs_data.begin() + corrs_offsets[point2D_idx],
+                        all_corrs_data.begin() + corrs_offsets[point2D_idx + 1]);
+      for (const CorrData& corr_data : corrs_data) {
+        if (corr_data.point2D->HasPoint3D()) {
+          num_triangulated += 1;
+        }
+      }
+      const size_t track_idx = track_idxs[point2D_idx];
+      if (track_idx != kInvalidTrackIdx) {
+        const size_t track_offset = track_offsets[track_idx];
+        estimate.num_corrs = track_offsets[track_idx + 1] - track_offset;
+        estimate.success = track_success[track_idx];
+        estimate.xyz = track_xyzs[track_idx];
+        estimate.inlier_mask = track_inlier_mask.data() + track_offset;
+        estimate_ptr = &estimate;
+      }
+    } else {
+      num_triangulated =
+          Find(options,
+               image_id,
+               point2D_idx,
+               static_cast<size_t>(options.max_transitivity),
+               &corrs_data);
+    }
     if (corrs_data.empty()) {
       continue;
     }
@@ -143,13 +266,13 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
 
     if (num_triangulated == 0) {
       corrs_data.push_back(ref_corr_data);
-      num_tris += Create(options, corrs_data);
+      num_tris += Create(options, corrs_data, estimate_ptr);
     } else {
       // Continue correspondences to existing 3D points.
       num_tris += Continue(options, ref_corr_data, corrs_data);
       // Create points from correspondences that are not continued.
       corrs_data.push_back(ref_corr_data);
-      num_tris += Create(options, corrs_data);
+      num_tris += Create(options, corrs_data, estimate_ptr);
     }
   }
 
@@ -158,6 +281,7 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
 
 size_t IncrementalTriangulator::CompleteImage(const Options& options,
                                               const image_t image_id) {
+  COLMAP_PROFILE_SCOPE("IncrementalTriangulator::CompleteImage");
   THROW_CHECK(options.Check());
 
   size_t num_tris = 0;
@@ -183,6 +307,7 @@ size_t IncrementalTriangulator::CompleteImage(const Options& options,
   tri_options.ransac_options.confidence = 0.9999;
   tri_options.ransac_options.min_inlier_ratio = 0.02;
   tri_options.ransac_options.max_num_trials = 10000;
+  tri_options.max_exhaustive_track_length = kMaxExhaustiveTrackLength;
 
   // Correspondence data for reference observation in given image. We iterate
   // over all observations of the image and each observation once becomes
@@ -252,61 +377,48 @@ size_t IncrementalTriangulator::CompleteTracks(
     const Options& options, const std::unordered_set<point3D_t>& point3D_ids) {
   THROW_CHECK(options.Check());
 
-  size_t num_completed = 0;
-
   ClearCaches();
 
-  for (const point3D_t point3D_id : point3D_ids) {
-    num_completed += Complete(options, point3D_id);
-  }
-
-  return num_completed;
+  return Complete(
+      options, std::vector<point3D_t>(point3D_ids.begin(), point3D_ids.end()));
 }
 
 size_t IncrementalTriangulator::CompleteAllTracks(const Options& options) {
+  COLMAP_PROFILE_SCOPE("IncrementalTriangulator::CompleteAllTracks");
   THROW_CHECK(options.Check());
 
-  size_t num_completed = 0;
-
   ClearCaches();
 
-  for (const point3D_t point3D_id : reconstruction_.Point3DIds()) {
-    num_completed += Complete(options, point3D_id);
-  }
-
-  return num_completed;
+  const std::unordered_set<point3D_t> point3D_ids =
+      reconstruction_.Point3DIds();
+  return Complete(
+      options, std::vector<point3D_t>(point3D_ids.begin(), point3D_ids.end()));
 }
 
 size_t IncrementalTriangulator::MergeTracks(
     const Options& options, const std::unordered_set<point3D_t>& point3D_ids) {
   THROW_CHECK(options.Check());
 
-  size_t num_merged = 0;
-
   ClearCaches();
 
-  for (const point3D_t point3D_id : point3D_ids) {
-    num_merged += Merge(options, point3D_id);
-  }
-
-  return num_merged;
+  return Merge(
+      options, std::vector<point3D_t>(point3D_ids.begin(), point3D_ids.end()));
 }
 
 size_t IncrementalTriangulator::MergeAllTracks(const Options& options) {
+  COLMAP_PROFILE_SCOPE("IncrementalTriangulator::MergeAllTracks");
   THROW_CHECK(options.Check());
 
-  size_t num_merged = 0;
-
   ClearCaches();
 
-  for (const point3D_t point3D_id : reconstruction_.Point3DIds()) {
-    num_merged += Merge(options, point3D_id);
-  }
-
-  return num_merged;
+  const std::unordered_set<point3D_t> point3D_ids =
+      reconstruction_.Point3DIds();
+  return Merge(
+      options, std::vector<point3D_t>(point3D_ids.begin(), point3D_ids.end()));
 }
 
 size_t IncrementalTriangulator::Retriangulate(const Options& options) {
+  COLMAP_PROFILE_SCOPE("IncrementalTriangulator::Retriangulate");
   THROW_CHECK(options.Check());
 
   size_t num_tris = 0;
@@ -316,39 +428,77 @@ size_t IncrementalTriangulator::Retriangulate(const Options& options) {
   Options re_options = options;
   re_options.continue_max_angle_error = options.re_max_angle_error;
 
-  for (const auto& image_pair : obs_manager_->ImagePairs()) {
-    // Only perform retriangulation for under-reconstructed image pairs.
-    const double tri_ratio =
-        static_cast<double>(image_pair.second.num_tri_corrs) /
-        static_cast<double>(image_pair.second.num_total_corrs);
-    if (tri_ratio >= options.re_min_ratio) {
-      continue;
+  const auto& image_pairs = obs_manager_->ImagePairs();
+
+  // Only perform retriangulation for under-reconstructed image pairs.
+  auto IsUnderReconstructed =
+      [&options](const ObservationManager::ImagePairStat& image_pair_stat) {
+        const double tri_ratio =
+            static_cast<double>(image_pair_stat.num_tri_corrs) /
+            static_cast<double>(image_pair_stat.num_total_corrs);
+        return tri_ratio < options.re_min_ratio;
+      };
+
+  std::vector<image_pair_t> pair_ids;
+  for (const auto& image_pair : image_pairs) {
+    if (IsUnderReconstructed(image_pair.second)) {
+      pair_ids.push_back(image_pair.first);
     }
+  }
 
-    // Check if images are registered yet.
-
-    image_t image_id1;
-    image_t image_id2;
-    std::tie(image_id1, image_id2) =
-        Database::PairIdToImagePair(image_pair.first);
+  // Select the image pairs of registered images that changed since their last
+  // trial in parallel, which avoids revisiting the correspondences of image
+  // pairs that were already retriangulated in the current state.
+  std::vector<char> is_dirty(pair_ids.size(), false);
+  const size_t kMinNumPairsPerChunk = 256;
+  ParallelForChunks(
+      options.num_threads,
+      pair_ids.size(),
+      kMinNumPairsPerChunk,
+      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const auto [image_id1, image_id2] =
+              Database::PairIdToImagePair(pair_ids[i]);
+          const Image& image1 = reconstruction_.Image(image_id1);
+          const Image& image2 = reconstruction_.Image(image_id2);
+          if (!image1.IsRegistered() || !image2.IsRegistered()) {
+            continue;
+          }
+          is_dirty[i] = IsRetriangulationDirty(
+              options,
+              pair_ids[i],
+              image_pairs.at(pair_ids[i]),
+              image2.CamFromWorld() * Inverse(image1.CamFromWorld()));
+        }
+      });
 
-    const Image& image1 = reconstruction_.Image(image_id1);
-    if (!image1.IsRegistered()) {
+  for (size_t i = 0; i < pair_ids.size(); ++i) {
+    if (!is_dirty[i]) {
       continue;
     }
 
-    const Image& image2 = reconstruction_.Image(image_id2);
-    if (!image2.IsRegistered()) {
+    // Previously retriangulated image pairs may have completed this pair.
+    const image_pair_t pair_id = pair_ids[i];
+    if (!IsUnderReconstructed(image_pairs.at(pair_id))) {
       continue;
     }
 
+    image_t image_id1;
+    image_t image_id2;
+    std::tie(image_id1, image_id2) = Database::PairIdToImagePair(pair_id);
+    const Image& image1 = reconstruction_.Image(image_id1);
+    const Image& image2 = reconstruction_.Image(image_id2);
+
     // Only perform retriangulation for a maximum number of trials.
 
-    int& num_re_trials = re_num_trials_[image_pair.first];
-    if (num_re_trials >= options.re_max_trials) {
+    RetriangulationState& re_state = re_states_[pair_id];
+    if (re_state.num_trials >= options.re_max_trials) {
       continue;
     }
-    num_re_trials += 1;
+    re_state.num_trials += 1;
+    re_state.cam2_from_cam1 =
+        image2.CamFromWorld() * Inverse(image1.CamFromWorld());
+    re_state.num_tri_corrs = image_pairs.at(pair_id).num_tri_corrs;
 
     const Camera& camera1 = reconstruction_.Camera(image1.CameraId());
     const Camera& camera2 = reconstruction_.Camera(image2.CameraId());
@@ -405,11 +555,43 @@ size_t IncrementalTriangulator::Retriangulate(const Options& options) {
       // Else both points have a 3D point, but we do not want to
       // merge points in retriangulation.
     }
+
+    re_state.num_tri_corrs = image_pairs.at(pair_id).num_tri_corrs;
   }
 
   return num_tris;
 }
 
+bool IncrementalTriangulator::IsRetriangulationDirty(
+    const Options& options,
+    const image_pair_t pair_id,
+    const ObservationManager::ImagePairStat& image_pair_stat,
+    const Rigid3d& cam2_from_cam1) const {
+  const auto it = re_states_.find(pair_id);
+  if (it == re_states_.end()) {
+    return true;
+  }
+  const RetriangulationState& re_state = it->second;
+  if (re_state.num_trials >= options.re_max_trials) {
+    return false;
+  }
+  if (image_pair_stat.num_tri_corrs != re_state.num_tri_corrs) {
+    return true;
+  }
+  // The direction of the translation is compared, as the scale of the
+  // reconstruction changes with its normalization.
+  const double rotation_change = RadToDeg(
+      cam2_from_cam1.rotation.angularDistance(
+          re_state.cam2_from_cam1.rotation));
+  const double cos_translation_change =
+      cam2_from_cam1.translation.normalized().dot(
+          re_state.cam2_from_cam1.translation.normalized());
+  const double translation_change =
+      RadToDeg(std::acos(std::clamp(cos_translation_change, -1.0, 1.0)));
+  return rotation_change > options.re_min_pose_change ||
+         translation_change > options.re_min_pose_change;
+}
+
 void IncrementalTriangulator::AddModifiedPoint3D(const point3D_t point3D_id) {
   modified_point3D_ids_.insert(point3D_id);
 }
@@ -443,8 +625,13 @@ size_t IncrementalTriangulator::Find(const Options& options,
                                      const point2D_t point2D_idx,
                                      const size_t transitivity,
                                      std::vector<CorrData>* corrs_data) {
-  correspondence_graph_->ExtractTransitiveCorrespondences(
-      image_id, point2D_idx, transitivity, &found_corrs_);
+  // Precomputed tracks replace the repeated transitive search, unless only
+  // the direct correspondences are requested.
+  if (transitivity <= 1 || !correspondence_graph_->ExtractTrack(
+                               image_id, point2D_idx, &found_corrs_)) {
+    correspondence_graph_->ExtractTransitiveCorrespondences(
+        image_id, point2D_idx, transitivity, &found_corrs_);
+  }
 
   corrs_data->clear();
   corrs_data->reserve(found_corrs_.size());
@@ -479,8 +666,9 @@ size_t IncrementalTriangulator::Find(const Options& options,
   return num_triangulated;
 }
 
-size_t IncrementalTriangulator::Create(
-    const Options& options, const std::vector<CorrData>& corrs_data) {
+size_t IncrementalTriangulator::Create(const Options& options,
+                                       const std::vector<CorrData>& corrs_data,
+                                       const CreateEstimate* estimate) {
   // Extract correspondences without an existing triangulated observation.
   std::vector<CorrData> create_corrs_data;
   create_corrs_data.reserve(corrs_data.size());
@@ -501,21 +689,23 @@ size_t IncrementalTriangulator::Create(
     }
   }
 
-  // Setup estimation options.
-  EstimateTriangulationOptions tri_options;
-  tri_options.min_tri_angle = DegToRad(options.min_angle);
-  tri_options.residual_type =
-      TriangulationEstimator::ResidualType::ANGULAR_ERROR;
-  tri_options.ransac_options.max_error =
-      DegToRad(options.create_max_angle_error);
-  tri_options.ransac_options.confidence = 0.9999;
-  tri_options.ransac_options.min_inlier_ratio = 0.02;
-  tri_options.ransac_options.max_num_trials = 10000;
-
-  // Estimate triangulation.
+  // Estimate triangulation, unless it was estimated ahead from the same
+  // correspondences. Observations are only ever added to 3D points, so the
+  // correspondences are the same if none of them was triangulated since.
   Eigen::Vector3d xyz;
   std::vector<char> inlier_mask;
-  if (!TriangulateTrack(tri_options, create_corrs_data, inlier_mask, xyz)) {
+  if (estimate != nullptr &&
+      estimate->num_corrs == create_corrs_data.size()) {
+    if (!estimate->success) {
+      return 0;
+    }
+    xyz = estimate->xyz;
+    inlier_mask.assign(estimate->inlier_mask,
+                       estimate->inlier_mask + estimate->num_corrs);
+  } else if (!TriangulateTrack(CreateTriangulationOptions(options),
+                               create_corrs_data,
+                               inlier_mask,
+                               xyz)) {
     return 0;
   }
 
@@ -679,6 +869,198 @@ size_t IncrementalTriangulator::Merge(const Options& options,
   return 0;
 }
 
+size_t IncrementalTriangulator::Merge(
+    const Options& options, const std::vector<point3D_t>& point3D_ids) {
+  size_t num_merged = 0;
+
+  const int num_eff_threads = GetEffectiveNumThreads(options.num_threads);
+  if (num_eff_threads <= 1 ||
+      point3D_ids.size() < 2 * kMinNumPoints3DPerChunk) {
+    for (const point3D_t point3D_id : point3D_ids) {
+      num_merged += Merge(options, point3D_id);
+    }
+    return num_merged;
+  }
+
+  struct MergeCandidate {
+    std::vector<point3D_t> visited_point3D_ids;
+    std::vector<point3D_t> tested_point3D_ids;
+    bool success = false;
+  };
+
+  CacheCamerasBogusParams(options);
+
+  std::vector<MergeCandidate> candidates(point3D_ids.size());
+  ParallelForChunks(num_eff_threads,
+                    point3D_ids.size(),
+                    kMinNumPoints3DPerChunk,
+                    [&](const size_t begin, const size_t end) {
+                      for (size_t i = begin; i < end; ++i) {
+                        FindMergeCandidate(options,
+                                           point3D_ids[i],
+                                           &candidates[i].visited_point3D_ids,
+                                           &candidates[i].tested_point3D_ids,
+                                           &candidates[i].success);
+                      }
+                    });
+
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    const point3D_t point3D_id = point3D_ids[i];
+    if (!reconstruction_.ExistsPoint3D(point3D_id)) {
+      continue;
+    }
+
+    // The candidate is only valid, if none of the visited 3D points was
+    // merged by a previous 3D point and if the tested 3D points were not
+    // tried by any of them.
+    const MergeCandidate& candidate = candidates[i];
+    bool is_valid_candidate = true;
+    for (const point3D_t visited_point3D_id : candidate.visited_point3D_ids) {
+      if (!reconstruction_.ExistsPoint3D(visited_point3D_id)) {
+        is_valid_candidate = false;
+        break;
+      }
+    }
+    if (is_valid_candidate) {
+      const auto merge_trials = merge_trials_.find(point3D_id);
+      if (merge_trials != merge_trials_.end()) {
+        for (const point3D_t tested_point3D_id : candidate.tested_point3D_ids) {
+          if (merge_trials->second.count(tested_point3D_id) > 0) {
+            is_valid_candidate = false;
+            break;
+          }
+        }
+      }
+    }
+
+    if (!is_valid_candidate) {
+      num_merged += Merge(options, point3D_id);
+      continue;
+    }
+
+    for (const point3D_t tested_point3D_id : candidate.tested_point3D_ids) {
+      merge_trials_[point3D_id].insert(tested_point3D_id);
+      merge_trials_[tested_point3D_id].insert(point3D_id);
+    }
+
+    if (!candidate.success) {
+      continue;
+    }
+
+    const point3D_t corr_point3D_id = candidate.tested_point3D_ids.back();
+    const size_t num_merged_point3D =
+        reconstruction_.Point3D(point3D_id).track.Length() +
+        reconstruction_.Point3D(corr_point3D_id).track.Length();
+
+    const point3D_t merged_point3D_id =
+        obs_manager_->MergePoints3D(point3D_id, corr_point3D_id);
+
+    modified_point3D_ids_.erase(point3D_id);
+    modified_point3D_ids_.erase(corr_point3D_id);
+    modified_point3D_ids_.insert(merged_point3D_id);
+
+    // Merge merged 3D point, as in the sequential merge.
+    const size_t num_merged_recursive = Merge(options, merged_point3D_id);
+    if (num_merged_recursive > 0) {
+      num_merged += num_merged_recursive;
+    } else {
+      num_merged += num_merged_point3D;
+    }
+  }
+
+  return num_merged;
+}
+
+void IncrementalTriangulator::FindMergeCandidate(
+    const Options& options,
+    const point3D_t point3D_id,
+    std::vector<point3D_t>* visited_point3D_ids,
+    std::vector<point3D_t>* tested_point3D_ids,
+    bool* merge_success) const {
+  *merge_success = false;
+
+  const auto point3D_it = reconstruction_.Points3D().find(point3D_id);
+  if (point3D_it == reconstruction_.Points3D().end()) {
+    return;
+  }
+
+  const double max_squared_reproj_error =
+      options.merge_max_reproj_error * options.merge_max_reproj_error;
+
+  const Point3D& point3D = point3D_it->second;
+
+  const auto merge_trials = merge_trials_.find(point3D_id);
+  std::unordered_set<point3D_t> tested_point3D_ids_set;
+
+  for (const auto& track_el : point3D.track.Elements()) {
+    const auto corr_range = correspondence_graph_->FindCorrespondences(
+        track_el.image_id, track_el.point2D_idx);
+    for (const auto* corr = corr_range.beg; corr < corr_range.end; ++corr) {
+      const auto& image = reconstruction_.Image(corr->image_id);
+      if (!image.IsRegistered()) {
+        continue;
+      }
+
+      const Point2D& corr_point2D = image.Point2D(corr->point2D_idx);
+      if (!corr_point2D.HasPoint3D() || corr_point2D.point3D_id == point3D_id) {
+        continue;
+      }
+
+      visited_point3D_ids->push_back(corr_point2D.point3D_id);
+
+      if ((merge_trials != merge_trials_.end() &&
+           merge_trials->second.count(corr_point2D.point3D_id) > 0) ||
+          tested_point3D_ids_set.count(corr_point2D.point3D_id) > 0) {
+        continue;
+      }
+
+      // Try to merge the two 3D points.
+
+      const Point3D& corr_point3D =
+          reconstruction_.Point3D(corr_point2D.point3D_id);
+
+      tested_point3D_ids->push_back(corr_point2D.point3D_id);
+      tested_point3D_ids_set.insert(corr_point2D.point3D_id);
+
+      // Weighted average of point locations, depending on track length.
+      const Eigen::Vector3d merged_xyz =
+          (point3D.track.Length() * point3D.xyz +
+           corr_point3D.track.Length() * corr_point3D.xyz) /
+          (point3D.track.Length() + corr_point3D.track.Length());
+
+      // Count number of inlier track elements of the merged track.
+      bool merge_success_point3D = true;
+      for (const Track* track : {&point3D.track, &corr_point3D.track}) {
+        for (const auto test_track_el : track->Elements()) {
+          const Image& test_image =
+              reconstruction_.Image(test_track_el.image_id);
+          const Camera& test_camera =
+              reconstruction_.Camera(test_image.CameraId());
+          const Point2D& test_point2D =
+              test_image.Point2D(test_track_el.point2D_idx);
+          if (CalculateSquaredReprojectionError(test_point2D.xy,
+                                                merged_xyz,
+                                                test_image.CamFromWorld(),
+                                                test_camera) >
+              max_squared_reproj_error) {
+            merge_success_point3D = false;
+            break;
+          }
+        }
+        if (!merge_success_point3D) {
+          break;
+        }
+      }
+
+      // Only accept merge if all track elements are inliers.
+      if (merge_success_point3D) {
+        *merge_success = true;
+        return;
+      }
+    }
+  }
+}
+
 size_t IncrementalTriangulator::Complete(const Options& options,
                                          const point3D_t point3D_id) {
   size_t num_completed = 0;
@@ -692,7 +1074,8 @@ size_t IncrementalTriangulator::Complete(const Options& options,
 
   const Point3D& point3D = reconstruction_.Point3D(point3D_id);
 
-  std::vector<TrackElement> queue = point3D.track.Elements();
+  std::vector<TrackElement> queue(point3D.track.Elements().begin(),
+                                  point3D.track.Elements().end());
 
   const int max_transitivity = options.complete_max_transitivity;
   for (int transitivity = 0; transitivity < max_transitivity; ++transitivity) {
@@ -746,6 +1129,137 @@ size_t IncrementalTriangulator::Complete(const Options& options,
   return num_completed;
 }
 
+size_t IncrementalTriangulator::Complete(
+    const Options& options, const std::vector<point3D_t>& point3D_ids) {
+  size_t num_completed = 0;
+
+  const int num_eff_threads = GetEffectiveNumThreads(options.num_threads);
+  if (num_eff_threads <= 1 ||
+      point3D_ids.size() < 2 * kMinNumPoints3DPerChunk) {
+    for (const point3D_t point3D_id : point3D_ids) {
+      num_completed += Complete(options, point3D_id);
+    }
+    return num_completed;
+  }
+
+  CacheCamerasBogusParams(options);
+
+  std::vector<std::vector<TrackElement>> completions(point3D_ids.size());
+  ParallelForChunks(
+      num_eff_threads,
+      point3D_ids.size(),
+      kMinNumPoints3DPerChunk,
+      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          FindTrackCompletion(options, point3D_ids[i], &completions[i]);
+        }
+      });
+
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    const point3D_t point3D_id = point3D_ids[i];
+    const std::vector<TrackElement>& track_els = completions[i];
+    if (track_els.empty()) {
+      continue;
+    }
+
+    // The completion is only valid, if none of its observations was claimed
+    // by the completion of a previous 3D point.
+    bool is_valid_completion = true;
+    for (const auto& track_el : track_els) {
+      if (reconstruction_.Image(track_el.image_id)
+              .Point2D(track_el.point2D_idx)
+              .HasPoint3D()) {
+        is_valid_completion = false;
+        break;
+      }
+    }
+
+    if (!is_valid_completion) {
+      num_completed += Complete(options, point3D_id);
+      continue;
+    }
+
+    for (const auto& track_el : track_els) {
+      obs_manager_->AddObservation(point3D_id, track_el);
+    }
+    modified_point3D_ids_.insert(point3D_id);
+    num_completed += track_els.size();
+  }
+
+  return num_completed;
+}
+
+void IncrementalTriangulator::FindTrackCompletion(
+    const Options& options,
+    const point3D_t point3D_id,
+    std::vector<TrackElement>* track_els) const {
+  const auto point3D_it = reconstruction_.Points3D().find(point3D_id);
+  if (point3D_it == reconstruction_.Points3D().end()) {
+    return;
+  }
+
+  const double max_squared_reproj_error =
+      options.complete_max_reproj_error * options.complete_max_reproj_error;
+
+  const Point3D& point3D = point3D_it->second;
+
+  // Observations that were added by this completion, which a sequential
+  // completion would see as triangulated.
+  std::unordered_set<image_pair_t> added_track_els;
+
+  std::vector<TrackElement> queue(point3D.track.Elements().begin(),
+                                  point3D.track.Elements().end());
+
+  const int max_transitivity = options.complete_max_transitivity;
+  for (int transitivity = 0; transitivity < max_transitivity; ++transitivity) {
+    if (queue.empty()) {
+      break;
+    }
+
+    const std::vector<TrackElement> prev_queue = queue;
+    queue.clear();
+
+    for (const TrackElement& queue_elem : prev_queue) {
+      const auto corr_range = correspondence_graph_->FindCorrespondences(
+          queue_elem.image_id, queue_elem.point2D_idx);
+      for (const auto* corr = corr_range.beg; corr < corr_range.end; ++corr) {
+        const Image& image = reconstruction_.Image(corr->image_id);
+        if (!image.IsRegistered()) {
+          continue;
+        }
+
+        const Point2D& point2D = image.Point2D(corr->point2D_idx);
+        const image_pair_t track_el_key =
+            (static_cast<image_pair_t>(corr->image_id) << 32) +
+            corr->point2D_idx;
+        if (point2D.HasPoint3D() || added_track_els.count(track_el_key) > 0) {
+          continue;
+        }
+
+        const Camera& camera = reconstruction_.Camera(image.CameraId());
+        if (camera_has_bogus_params_.at(camera.camera_id)) {
+          continue;
+        }
+
+        if (CalculateSquaredReprojectionError(
+                point2D.xy, point3D.xyz, image.CamFromWorld(), camera) >
+            max_squared_reproj_error) {
+          continue;
+        }
+
+        // Success, add observation to point track.
+        track_els->emplace_back(corr->image_id, corr->point2D_idx);
+        added_track_els.insert(track_el_key);
+
+        // Recursively complete track for this new correspondence.
+        if (transitivity < max_transitivity - 1) {
+          queue.emplace_back(corr->image_id, corr->point2D_idx);
+        }
+      }
+    }
+  }
+}
+
 bool IncrementalTriangulator::HasCameraBogusParams(const Options& options,
                                                    const Camera& camera) {
   const auto it = camera_has_bogus_params_.find(camera.camera_id);
@@ -761,4 +1275,10 @@ bool IncrementalTriangulator::HasCameraBogusParams(const Options& options,
   }
 }
 
+void IncrementalTriangulator::CacheCamerasBogusParams(const Options& options) {
+  for (const auto& camera : reconstruction_.Cameras()) {
+    HasCameraBogusParams(options, camera.second);
+  }
+}
+
 }  // namespace colmap
@@ -71,6 +71,13 @@ class IncrementalTriangulator {
     // Maximum number of trials to re-triangulate an image pair.
     int re_max_trials = 1;
 
+    // Minimum change in degrees of the relative rotation or the direction of
+    // the relative translation of an image pair since its last trial to
+    // re-triangulate it again. Image pairs whose relative pose changed less
+    // and whose number of triangulated correspondences did not change are
+    // skipped without counting as a trial.
+    double re_min_pose_change = 0.1;
+
     // Minimum pairwise triangulation angle for a stable triangulation.
     double min_angle = 1.5;
 
@@ -83,6 +90,13 @@ class IncrementalTriangulator {
     double max_focal_length_ratio = 10.0;
     double max_extra_param = 1.0;
 
+    // The number of threads used to triangulate the observations of an image
+    // and to complete and merge the tracks of many 3D points. The new tracks,
+    // candidate completions, and merges are estimated in parallel and applied
+    // sequentially, such that the results do not depend on the number of
+    // threads.
+    int num_threads = 1;
+
     bool Check() const;
   };
 
@@ -133,7 +147,9 @@ class IncrementalTriangulator {
   //
   // Image pairs are under-reconstructed if less than `Options::tri_re_min_ratio
   // > tri_ratio`, where `tri_ratio` is the number of triangulated matches over
-  // inlier matches between the image pair.
+  // inlier matches between the image pair. Only the image pairs that changed
+  // since their last trial, see `Options::re_min_pose_change`, are
+  // re-triangulated, which are selected in parallel.
   size_t Retriangulate(const Options& options);
 
   // Indicate that a 3D point has been modified.
@@ -160,16 +176,30 @@ class IncrementalTriangulator {
   // Clear cache of bogus camera parameters and merge trials.
   void ClearCaches();
 
-  // Find (transitive) correspondences to other images.
+  // Find (transitive) correspondences to other images. For a transitivity
+  // above one, the precomputed tracks of the correspondence graph are used
+  // instead of the transitive search, where available.
   size_t Find(const Options& options,
               image_t image_id,
               point2D_t point2D_idx,
               size_t transitivity,
               std::vector<CorrData>* corrs_data);
 
-  // Try to create a new 3D point from the given correspondences.
+  // Triangulation of a new 3D point that was estimated ahead from the
+  // correspondences, which were not yet triangulated at the time.
+  struct CreateEstimate {
+    size_t num_corrs = 0;
+    bool success = false;
+    Eigen::Vector3d xyz;
+    const char* inlier_mask = nullptr;
+  };
+
+  // Try to create a new 3D point from the given correspondences. The optional
+  // estimate is used instead of triangulating the correspondences again, if
+  // it was estimated from the same correspondences.
   size_t Create(const Options& options,
-                const std::vector<CorrData>& corrs_data);
+                const std::vector<CorrData>& corrs_data,
+                const CreateEstimate* estimate = nullptr);
 
   // Try to continue the 3D point with the given correspondences.
   size_t Continue(const Options& options,
@@ -179,12 +209,44 @@ class IncrementalTriangulator {
   // Try to merge 3D point with any of its corresponding 3D points.
   size_t Merge(const Options& options, point3D_t point3D_id);
 
+  // Try to merge the given 3D points in the given order. The merge candidates
+  // are searched in parallel and then applied sequentially. A candidate is
+  // re-evaluated sequentially, if one of the 3D points it depends on was
+  // merged before, so that the result equals sequential merging.
+  size_t Merge(const Options& options,
+               const std::vector<point3D_t>& point3D_ids);
+
+  // Find the 3D points that a sequential merge of the given 3D point would
+  // visit and test without modifying the reconstruction, see `Merge`.
+  void FindMergeCandidate(const Options& options,
+                          point3D_t point3D_id,
+                          std::vector<point3D_t>* visited_point3D_ids,
+                          std::vector<point3D_t>* tested_point3D_ids,
+                          bool* merge_success) const;
+
   // Try to transitively complete the track of a 3D point.
   size_t Complete(const Options& options, point3D_t point3D_id);
 
+  // Try to complete the given 3D points in the given order. The completions
+  // are searched in parallel and then applied sequentially. A completion is
+  // re-evaluated sequentially, if one of its observations was claimed by a
+  // previous 3D point, so that the result equals sequential completion.
+  size_t Complete(const Options& options,
+                  const std::vector<point3D_t>& point3D_ids);
+
+  // Find the observations that a sequential completion of the given 3D point
+  // would add without modifying the reconstruction, see `Complete`.
+  void FindTrackCompletion(const Options& options,
+                           point3D_t point3D_id,
+                           std::vector<TrackElement>* track_els) const;
+
   // Check if camera has bogus parameters and cache the result.
   bool HasCameraBogusParams(const Options& options, const Camera& camera);
 
+  // Cache the bogus parameter check for all cameras, so that the cache can be
+  // read concurrently afterwards.
+  void CacheCamerasBogusParams(const Options& options);
+
   // Database cache for the reconstruction. Used to retrieve correspondence
   // information for triangulation.
   const std::shared_ptr<const CorrespondenceGraph> correspondence_graph_;
@@ -204,8 +266,22 @@ class IncrementalTriangulator {
   // Cache for found correspondences in the graph.
   std::vector<CorrespondenceGraph::Correspondence> found_corrs_;
 
-  // Number of trials to retriangulate image pair.
-  std::unordered_map<image_pair_t, int> re_num_trials_;
+  // State of an image pair at its last retriangulation trial.
+  struct RetriangulationState {
+    int num_trials = 0;
+    Rigid3d cam2_from_cam1;
+    size_t num_tri_corrs = 0;
+  };
+
+  // Whether the image pair changed since its last retriangulation trial.
+  bool IsRetriangulationDirty(
+      const Options& options,
+      image_pair_t pair_id,
+      const ObservationManager::ImagePairStat& image_pair_stat,
+      const Rigid3d& cam2_from_cam1) const;
+
+  // Retriangulation state of the image pairs.
+  std::unordered_map<image_pair_t, RetriangulationState> re_states_;
 
   // Changed 3D points, i.e. if a 3D point is modified (created, continued,
   // deleted, merged, etc.). Cleared once `ModifiedPoints3D` is called.
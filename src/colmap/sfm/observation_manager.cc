@@ -35,6 +35,7 @@
 #include "colmap/scene/projection.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
 
 namespace colmap {
 
@@ -52,6 +53,13 @@ bool MergeAndFilterReconstructions(const double max_reproj_error,
 
 const int ObservationManager::kNumPoint3DVisibilityPyramidLevels = 6;
 
+namespace {
+
+// Minimum number of 3D points per chunk when evaluating points in parallel.
+const size_t kMinNumPoints3DPerChunk = 1024;
+
+}  // namespace
+
 ObservationManager::ObservationManager(
     Reconstruction& reconstruction,
     std::shared_ptr<const CorrespondenceGraph> correspondence_graph)
@@ -71,20 +79,11 @@ ObservationManager::ObservationManager(
   // Add image stats.
   image_stats_.reserve(reconstruction_.NumImages());
   for (const auto& id_image : reconstruction_.Images()) {
-    const Image& image = id_image.second;
-    const Camera& camera = reconstruction_.Camera(image.CameraId());
-    ImageStat image_stat;
-    image_stat.point3D_visibility_pyramid = VisibilityPyramid(
-        kNumPoint3DVisibilityPyramidLevels, camera.width, camera.height);
-    image_stat.num_correspondences_have_point3D.resize(image.NumPoints2D(), 0);
-    image_stat.num_visible_points3D = 0;
-    if (correspondence_graph_) {
-      image_stat.num_observations =
-          correspondence_graph_->NumObservationsForImage(id_image.first);
-      image_stat.num_correspondences =
-          correspondence_graph_->NumCorrespondencesForImage(id_image.first);
-    }
-    image_stats_.emplace(id_image.first, image_stat);
+    image_stats_.emplace(id_image.first, CreateImageStat(id_image.first));
+  }
+
+  for (const auto& point3D : reconstruction_.Points3D()) {
+    UpdateCovisibility(point3D.second.track, /*add=*/true);
   }
 
   // If an existing model was loaded from disk and there were already images
@@ -102,6 +101,83 @@ ObservationManager::ObservationManager(
   }
 }
 
+ObservationManager::ImageStat ObservationManager::CreateImageStat(
+    const image_t image_id) const {
+  const Image& image = reconstruction_.Image(image_id);
+  const Camera& camera = reconstruction_.Camera(image.CameraId());
+  ImageStat image_stat;
+  image_stat.point3D_visibility_pyramid = VisibilityPyramid(
+      kNumPoint3DVisibilityPyramidLevels, camera.width, camera.height);
+  image_stat.num_visible_points3D = 0;
+  // The 2D points of unregistered images may not be loaded yet, if they are
+  // read lazily from the database cache.
+  point2D_t num_points2D = image.NumPoints2D();
+  if (correspondence_graph_ && num_points2D == 0 &&
+      correspondence_graph_->ExistsImage(image_id)) {
+    num_points2D = correspondence_graph_->NumPoints2DForImage(image_id);
+  }
+  image_stat.num_correspondences_have_point3D.resize(num_points2D, 0);
+  if (correspondence_graph_) {
+    image_stat.num_observations =
+        correspondence_graph_->NumObservationsForImage(image_id);
+    image_stat.num_correspondences =
+        correspondence_graph_->NumCorrespondencesForImage(image_id);
+  }
+  return image_stat;
+}
+
+void ObservationManager::AddImages(const std::vector<image_t>& image_ids) {
+  std::unordered_set<image_t> new_image_ids(image_ids.begin(),
+                                            image_ids.end());
+  std::unordered_set<image_t> neighbor_image_ids;
+  for (const image_t image_id : image_ids) {
+    THROW_CHECK(image_stats_.emplace(image_id, CreateImageStat(image_id))
+                    .second);
+    if (!correspondence_graph_ ||
+        !correspondence_graph_->ExistsImage(image_id)) {
+      continue;
+    }
+
+    const point2D_t num_points2D =
+        correspondence_graph_->NumPoints2DForImage(image_id);
+    std::unordered_set<image_t> corr_image_ids;
+    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+         ++point2D_idx) {
+      const auto corr_range =
+          correspondence_graph_->FindCorrespondences(image_id, point2D_idx);
+      for (const auto* corr = corr_range.beg; corr < corr_range.end; ++corr) {
+        if (corr_image_ids.insert(corr->image_id).second) {
+          image_pair_stats_[Database::ImagePairToPairId(image_id,
+                                                        corr->image_id)]
+              .num_total_corrs =
+              correspondence_graph_->NumCorrespondencesBetweenImages(
+                  image_id, corr->image_id);
+        }
+        const Image& corr_image = reconstruction_.Image(corr->image_id);
+        if (corr_image.IsRegistered() &&
+            corr_image.Point2D(corr->point2D_idx).HasPoint3D()) {
+          IncrementCorrespondenceHasPoint3D(image_id, point2D_idx);
+        }
+      }
+    }
+    for (const image_t corr_image_id : corr_image_ids) {
+      if (new_image_ids.count(corr_image_id) == 0) {
+        neighbor_image_ids.insert(corr_image_id);
+      }
+    }
+  }
+
+  // The existing neighbors gained correspondences to the new images.
+  for (const image_t image_id : neighbor_image_ids) {
+    ImageStat& image_stat = image_stats_.at(image_id);
+    image_stat.num_observations =
+        correspondence_graph_->NumObservationsForImage(image_id);
+    image_stat.num_correspondences =
+        correspondence_graph_->NumCorrespondencesForImage(image_id);
+    modified_image_ids_.insert(image_id);
+  }
+}
+
 void ObservationManager::IncrementCorrespondenceHasPoint3D(
     const image_t image_id, const point2D_t point2D_idx) {
   const Image& image = reconstruction_.Image(image_id);
@@ -114,6 +190,7 @@ void ObservationManager::IncrementCorrespondenceHasPoint3D(
   }
 
   stats.point3D_visibility_pyramid.SetPoint(point2D.xy(0), point2D.xy(1));
+  modified_image_ids_.insert(image_id);
 
   assert(stats.num_visible_points3D <= stats.num_observations);
 }
@@ -130,6 +207,7 @@ void ObservationManager::DecrementCorrespondenceHasPoint3D(
   }
 
   stats.point3D_visibility_pyramid.ResetPoint(point2D.xy(0), point2D.xy(1));
+  modified_image_ids_.insert(image_id);
 
   assert(stats.num_visible_points3D <= stats.num_observations);
 }
@@ -198,10 +276,70 @@ void ObservationManager::ResetTriObservations(const image_t image_id,
   }
 }
 
+void ObservationManager::UpdateCovisibility(const image_t image_id1,
+                                            const image_t image_id2,
+                                            const bool add) {
+  if (add) {
+    covisibility_[image_id1][image_id2] += 1;
+    return;
+  }
+  // Points that were added to the reconstruction directly, and not through
+  // the observation manager, were never counted.
+  const auto image_it = covisibility_.find(image_id1);
+  if (image_it == covisibility_.end()) {
+    return;
+  }
+  const auto count_it = image_it->second.find(image_id2);
+  if (count_it == image_it->second.end()) {
+    return;
+  }
+  if (--count_it->second == 0) {
+    image_it->second.erase(count_it);
+    if (image_it->second.empty()) {
+      covisibility_.erase(image_it);
+    }
+  }
+}
+
+void ObservationManager::UpdateCovisibility(const Track& track,
+                                            const TrackElement& track_el,
+                                            const bool add) {
+  for (const auto& other_track_el : track.Elements()) {
+    if (other_track_el.image_id != track_el.image_id) {
+      UpdateCovisibility(track_el.image_id, other_track_el.image_id, add);
+      UpdateCovisibility(other_track_el.image_id, track_el.image_id, add);
+    }
+  }
+}
+
+void ObservationManager::UpdateCovisibility(const Track& track,
+                                            const bool add) {
+  // Every pair of elements is visited from both sides, which updates the
+  // counts in both directions.
+  for (const auto& track_el1 : track.Elements()) {
+    for (const auto& track_el2 : track.Elements()) {
+      if (track_el1.image_id != track_el2.image_id) {
+        UpdateCovisibility(track_el1.image_id, track_el2.image_id, add);
+      }
+    }
+  }
+}
+
+const std::unordered_map<image_t, size_t>& ObservationManager::CovisibleImages(
+    const image_t image_id) const {
+  static const std::unordered_map<image_t, size_t> kNoCovisibleImages;
+  const auto it = covisibility_.find(image_id);
+  if (it == covisibility_.end()) {
+    return kNoCovisibleImages;
+  }
+  return it->second;
+}
+
 point3D_t ObservationManager::AddPoint3D(const Eigen::Vector3d& xyz,
                                          const Track& track,
                                          const Eigen::Vector3ub& color) {
   const point3D_t point3D_id = reconstruction_.AddPoint3D(xyz, track, color);
+  UpdateCovisibility(track, /*add=*/true);
 
   const bool kIsContinuedPoint3D = false;
   for (const auto& track_el : track.Elements()) {
@@ -214,6 +352,8 @@ point3D_t ObservationManager::AddPoint3D(const Eigen::Vector3d& xyz,
 
 void ObservationManager::AddObservation(const point3D_t point3D_id,
                                         const TrackElement& track_el) {
+  UpdateCovisibility(
+      reconstruction_.Point3D(point3D_id).track, track_el, /*add=*/true);
   reconstruction_.AddObservation(point3D_id, track_el);
   const bool kIsContinuedPoint3D = true;
   SetObservationAsTriangulated(
@@ -229,6 +369,7 @@ void ObservationManager::DeletePoint3D(const point3D_t point3D_id) {
     ResetTriObservations(
         track_el.image_id, track_el.point2D_idx, kIsDeletedPoint3D);
   }
+  UpdateCovisibility(track, /*add=*/false);
 
   reconstruction_.DeletePoint3D(point3D_id);
 }
@@ -248,6 +389,8 @@ void ObservationManager::DeleteObservation(const image_t image_id,
 
   const bool kIsDeletedPoint3D = false;
   ResetTriObservations(image_id, point2D_idx, kIsDeletedPoint3D);
+  UpdateCovisibility(
+      point3D.track, TrackElement(image_id, point2D_idx), /*add=*/false);
   reconstruction_.DeleteObservation(image_id, point2D_idx);
 }
 
@@ -259,16 +402,19 @@ point3D_t ObservationManager::MergePoints3D(const point3D_t point3D_id1,
     ResetTriObservations(
         track_el.image_id, track_el.point2D_idx, kIsDeletedPoint3D);
   }
+  UpdateCovisibility(track1, /*add=*/false);
   const Track& track2 = reconstruction_.Point3D(point3D_id2).track;
   for (const auto& track_el : track2.Elements()) {
     ResetTriObservations(
         track_el.image_id, track_el.point2D_idx, kIsDeletedPoint3D);
   }
+  UpdateCovisibility(track2, /*add=*/false);
 
   point3D_t merged_point3D_id =
       reconstruction_.MergePoints3D(point3D_id1, point3D_id2);
 
   const Track track = reconstruction_.Point3D(merged_point3D_id).track;
+  UpdateCovisibility(track, /*add=*/true);
   const bool kIsContinuedPoint3D = false;
   for (const auto& track_el : track.Elements()) {
     SetObservationAsTriangulated(
@@ -352,51 +498,75 @@ size_t ObservationManager::FilterPoints3DWithSmallTriangulationAngle(
 
   // Cache for image projection centers.
   std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  proj_centers.reserve(reconstruction_.NumRegImages());
+  for (const image_t image_id : reconstruction_.RegImageIds()) {
+    proj_centers.emplace(image_id,
+                         reconstruction_.Image(image_id).ProjectionCenter());
+  }
 
-  for (const auto point3D_id : point3D_ids) {
-    if (!reconstruction_.ExistsPoint3D(point3D_id)) {
-      continue;
+  auto ProjectionCenter = [&](const image_t image_id) -> Eigen::Vector3d {
+    const auto proj_center = proj_centers.find(image_id);
+    if (proj_center == proj_centers.end()) {
+      return reconstruction_.Image(image_id).ProjectionCenter();
     }
-
-    const struct Point3D& point3D = reconstruction_.Point3D(point3D_id);
-
-    // Calculate triangulation angle for all pairwise combinations of image
-    // poses in the track. Only delete point if none of the combinations
-    // has a sufficient triangulation angle.
-    bool keep_point = false;
-    for (size_t i1 = 0; i1 < point3D.track.Length(); ++i1) {
-      const image_t image_id1 = point3D.track.Element(i1).image_id;
-
-      Eigen::Vector3d proj_center1;
-      if (proj_centers.count(image_id1) == 0) {
-        const Image& image1 = reconstruction_.Image(image_id1);
-        proj_center1 = image1.ProjectionCenter();
-        proj_centers.emplace(image_id1, proj_center1);
-      } else {
-        proj_center1 = proj_centers.at(image_id1);
+    return proj_center->second;
+  };
+
+  const std::vector<point3D_t> point3D_ids_vec(point3D_ids.begin(),
+                                               point3D_ids.end());
+
+  // Evaluate the points in parallel and delete them afterwards in the same
+  // order as a sequential evaluation.
+  std::vector<char> keep_points(point3D_ids_vec.size(), true);
+  auto EvaluatePoints = [&](const size_t begin, const size_t end) {
+    for (size_t idx = begin; idx < end; ++idx) {
+      const auto point3D_it =
+          reconstruction_.Points3D().find(point3D_ids_vec[idx]);
+      if (point3D_it == reconstruction_.Points3D().end()) {
+        continue;
       }
 
-      for (size_t i2 = 0; i2 < i1; ++i2) {
-        const image_t image_id2 = point3D.track.Element(i2).image_id;
-        const Eigen::Vector3d proj_center2 = proj_centers.at(image_id2);
+      const struct Point3D& point3D = point3D_it->second;
+
+      // Calculate triangulation angle for all pairwise combinations of image
+      // poses in the track. Only delete point if none of the combinations
+      // has a sufficient triangulation angle.
+      bool keep_point = false;
+      for (size_t i1 = 0; i1 < point3D.track.Length(); ++i1) {
+        const Eigen::Vector3d proj_center1 =
+            ProjectionCenter(point3D.track.Element(i1).image_id);
+
+        for (size_t i2 = 0; i2 < i1; ++i2) {
+          const Eigen::Vector3d proj_center2 =
+              ProjectionCenter(point3D.track.Element(i2).image_id);
+
+          const double tri_angle = CalculateTriangulationAngle(
+              proj_center1, proj_center2, point3D.xyz);
 
-        const double tri_angle = CalculateTriangulationAngle(
-            proj_center1, proj_center2, point3D.xyz);
+          if (tri_angle >= min_tri_angle_rad) {
+            keep_point = true;
+            break;
+          }
+        }
 
-        if (tri_angle >= min_tri_angle_rad) {
-          keep_point = true;
+        if (keep_point) {
           break;
         }
       }
 
-      if (keep_point) {
-        break;
-      }
+      keep_points[idx] = keep_point;
     }
+  };
+
+  ParallelForChunks(ThreadPool::kMaxNumThreads,
+                    point3D_ids_vec.size(),
+                    kMinNumPoints3DPerChunk,
+                    EvaluatePoints);
 
-    if (!keep_point) {
+  for (size_t idx = 0; idx < point3D_ids_vec.size(); ++idx) {
+    if (!keep_points[idx]) {
       num_filtered += 1;
-      DeletePoint3D(point3D_id);
+      DeletePoint3D(point3D_ids_vec[idx]);
     }
   }
 
@@ -411,45 +581,79 @@ size_t ObservationManager::FilterPoints3DWithLargeReprojectionError(
   // Number of filtered points.
   size_t num_filtered = 0;
 
-  for (const auto point3D_id : point3D_ids) {
-    if (!reconstruction_.ExistsPoint3D(point3D_id)) {
-      continue;
-    }
+  const std::vector<point3D_t> point3D_ids_vec(point3D_ids.begin(),
+                                               point3D_ids.end());
 
-    struct Point3D& point3D = reconstruction_.Point3D(point3D_id);
+  struct Point3DEvaluation {
+    bool exists = false;
+    bool delete_point = false;
+    double reproj_error_sum = 0.0;
+    std::vector<TrackElement> track_els_to_delete;
+  };
+
+  // Evaluate the points in parallel and delete the points and observations
+  // afterwards in the same order as a sequential evaluation.
+  std::vector<Point3DEvaluation> evaluations(point3D_ids_vec.size());
+  auto EvaluatePoints = [&](const size_t begin, const size_t end) {
+    for (size_t idx = begin; idx < end; ++idx) {
+      const auto point3D_it =
+          reconstruction_.Points3D().find(point3D_ids_vec[idx]);
+      if (point3D_it == reconstruction_.Points3D().end()) {
+        continue;
+      }
 
-    if (point3D.track.Length() < 2) {
-      num_filtered += point3D.track.Length();
-      DeletePoint3D(point3D_id);
-      continue;
-    }
+      const struct Point3D& point3D = point3D_it->second;
+      Point3DEvaluation& evaluation = evaluations[idx];
+      evaluation.exists = true;
 
-    double reproj_error_sum = 0.0;
+      if (point3D.track.Length() < 2) {
+        evaluation.delete_point = true;
+        continue;
+      }
 
-    std::vector<TrackElement> track_els_to_delete;
+      for (const auto& track_el : point3D.track.Elements()) {
+        const Image& image = reconstruction_.Image(track_el.image_id);
+        const struct Camera& camera = reconstruction_.Camera(image.CameraId());
+        const Point2D& point2D = image.Point2D(track_el.point2D_idx);
+        const double squared_reproj_error = CalculateSquaredReprojectionError(
+            point2D.xy, point3D.xyz, image.CamFromWorld(), camera);
+        if (squared_reproj_error > max_squared_reproj_error) {
+          evaluation.track_els_to_delete.push_back(track_el);
+        } else {
+          evaluation.reproj_error_sum += std::sqrt(squared_reproj_error);
+        }
+      }
 
-    for (const auto& track_el : point3D.track.Elements()) {
-      const Image& image = reconstruction_.Image(track_el.image_id);
-      const struct Camera& camera = reconstruction_.Camera(image.CameraId());
-      const Point2D& point2D = image.Point2D(track_el.point2D_idx);
-      const double squared_reproj_error = CalculateSquaredReprojectionError(
-          point2D.xy, point3D.xyz, image.CamFromWorld(), camera);
-      if (squared_reproj_error > max_squared_reproj_error) {
-        track_els_to_delete.push_back(track_el);
-      } else {
-        reproj_error_sum += std::sqrt(squared_reproj_error);
+      if (evaluation.track_els_to_delete.size() >=
+          point3D.track.Length() - 1) {
+        evaluation.delete_point = true;
       }
     }
+  };
+
+  ParallelForChunks(ThreadPool::kMaxNumThreads,
+                    point3D_ids_vec.size(),
+                    kMinNumPoints3DPerChunk,
+                    EvaluatePoints);
+
+  for (size_t idx = 0; idx < point3D_ids_vec.size(); ++idx) {
+    const Point3DEvaluation& evaluation = evaluations[idx];
+    if (!evaluation.exists) {
+      continue;
+    }
+
+    const point3D_t point3D_id = point3D_ids_vec[idx];
+    struct Point3D& point3D = reconstruction_.Point3D(point3D_id);
 
-    if (track_els_to_delete.size() >= point3D.track.Length() - 1) {
+    if (evaluation.delete_point) {
       num_filtered += point3D.track.Length();
       DeletePoint3D(point3D_id);
     } else {
-      num_filtered += track_els_to_delete.size();
-      for (const auto& track_el : track_els_to_delete) {
+      num_filtered += evaluation.track_els_to_delete.size();
+      for (const auto& track_el : evaluation.track_els_to_delete) {
         DeleteObservation(track_el.image_id, track_el.point2D_idx);
       }
-      point3D.error = reproj_error_sum / point3D.track.Length();
+      point3D.error = evaluation.reproj_error_sum / point3D.track.Length();
     }
   }
 
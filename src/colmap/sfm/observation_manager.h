@@ -57,6 +57,13 @@ class ObservationManager {
   inline const std::unordered_map<image_pair_t, ImagePairStat>& ImagePairs()
       const;
 
+  // Add the statistics of images that were added to the reconstruction and
+  // the correspondence graph after construction, e.g., while the
+  // reconstruction is running. The correspondences of the new images to the
+  // triangulated points of registered images are counted, such that the 2D
+  // points of new images with registered neighbors must be loaded.
+  void AddImages(const std::vector<image_t>& image_ids);
+
   // Add new 3D object, and return its unique ID.
   point3D_t AddPoint3D(
       const Eigen::Vector3d& xyz,
@@ -147,6 +154,21 @@ class ObservationManager {
   void DecrementCorrespondenceHasPoint3D(image_t image_id,
                                          point2D_t point2D_idx);
 
+  // Get the images that share 3D points with the given image and the number
+  // of shared observations, i.e. per observation of a 3D point in the given
+  // image the number of observations of the same point in the other image.
+  // The graph is updated incrementally and only reflects the changes to the
+  // 3D points made through the observation manager.
+  const std::unordered_map<image_t, size_t>& CovisibleImages(
+      image_t image_id) const;
+
+  // Get images whose visible 3D points changed, since the last call to
+  // `ClearModifiedImages`.
+  inline const std::unordered_set<image_t>& GetModifiedImages() const;
+
+  // Clear the collection of images with changed visible 3D points.
+  inline void ClearModifiedImages();
+
  private:
   void SetObservationAsTriangulated(image_t image_id,
                                     point2D_t point2D_idx,
@@ -155,6 +177,17 @@ class ObservationManager {
                             point2D_t point2D_idx,
                             bool is_deleted_point3D);
 
+  // Add or remove one shared observation of the first with the second image
+  // in the covisibility graph.
+  void UpdateCovisibility(image_t image_id1, image_t image_id2, bool add);
+  // Add or remove the shared observations between the track element and the
+  // other elements of the track in the covisibility graph.
+  void UpdateCovisibility(const Track& track,
+                          const TrackElement& track_el,
+                          bool add);
+  // Add or remove the shared observations between all elements of the track.
+  void UpdateCovisibility(const Track& track, bool add);
+
   struct ImageStat {
     // The number of image points that have at least one correspondence to
     // another image.
@@ -176,10 +209,18 @@ class ObservationManager {
     VisibilityPyramid point3D_visibility_pyramid;
   };
 
+  ImageStat CreateImageStat(image_t image_id) const;
+
   Reconstruction& reconstruction_;
   const std::shared_ptr<const CorrespondenceGraph> correspondence_graph_;
   std::unordered_map<image_pair_t, ImagePairStat> image_pair_stats_;
   std::unordered_map<image_t, ImageStat> image_stats_;
+  std::unordered_map<image_t, std::unordered_map<image_t, size_t>>
+      covisibility_;
+
+  // Images whose number or distribution of visible 3D points changed, i.e.
+  // whose next image rank must be updated.
+  std::unordered_set<image_t> modified_image_ids_;
 };
 
 const std::unordered_map<image_pair_t, ObservationManager::ImagePairStat>&
@@ -204,4 +245,11 @@ size_t ObservationManager::Point3DVisibilityScore(
   return image_stats_.at(image_id).point3D_visibility_pyramid.Score();
 }
 
+const std::unordered_set<image_t>& ObservationManager::GetModifiedImages()
+    const {
+  return modified_image_ids_;
+}
+
+void ObservationManager::ClearModifiedImages() { modified_image_ids_.clear(); }
+
 }  // namespace colmap
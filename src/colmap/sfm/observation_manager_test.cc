@@ -251,6 +251,145 @@ TEST(ObservationManager, NumVisiblePoints3D) {
   EXPECT_EQ(obs_manager.NumVisiblePoints3D(kImageId1), 0);
 }
 
+TEST(ObservationManager, ModifiedImages) {
+  Reconstruction reconstruction;
+  const image_t kImageId1 = 1;
+  const image_t kImageId2 = 2;
+  const camera_t kCameraId = 1;
+  const Camera camera = Camera::CreateFromModelId(kCameraId,
+                                                  CameraModelId::kPinhole,
+                                                  /*focal_length=*/10,
+                                                  /*width=*/10,
+                                                  /*height=*/10);
+  reconstruction.AddCamera(camera);
+  Image image;
+  image.SetImageId(kImageId1);
+  image.SetCameraId(kCameraId);
+  image.SetPoints2D(std::vector<Eigen::Vector2d>(10));
+  reconstruction.AddImage(image);
+  image.SetImageId(kImageId2);
+  reconstruction.AddImage(image);
+  auto correspondence_graph = std::make_shared<CorrespondenceGraph>();
+  correspondence_graph->AddImage(kImageId1, 10);
+  correspondence_graph->AddImage(kImageId2, 10);
+  FeatureMatches matches;
+  for (size_t i = 0; i < 10; ++i) {
+    matches.emplace_back(i, i);
+  }
+  correspondence_graph->AddCorrespondences(kImageId1, kImageId2, matches);
+  correspondence_graph->Finalize();
+  ObservationManager obs_manager(reconstruction, correspondence_graph);
+
+  EXPECT_TRUE(obs_manager.GetModifiedImages().empty());
+  obs_manager.IncrementCorrespondenceHasPoint3D(kImageId1, 0);
+  EXPECT_EQ(obs_manager.GetModifiedImages(),
+            std::unordered_set<image_t>({kImageId1}));
+  obs_manager.ClearModifiedImages();
+  EXPECT_TRUE(obs_manager.GetModifiedImages().empty());
+  obs_manager.DecrementCorrespondenceHasPoint3D(kImageId1, 0);
+  obs_manager.IncrementCorrespondenceHasPoint3D(kImageId2, 1);
+  EXPECT_EQ(obs_manager.GetModifiedImages(),
+            std::unordered_set<image_t>({kImageId1, kImageId2}));
+}
+
+TEST(ObservationManager, CovisibleImages) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(3, reconstruction);
+  ObservationManager obs_manager(reconstruction);
+  using CovisibleImages = std::unordered_map<image_t, size_t>;
+  EXPECT_TRUE(obs_manager.CovisibleImages(1).empty());
+
+  Track track;
+  track.AddElement(1, 0);
+  track.AddElement(2, 0);
+  const point3D_t point3D_id1 =
+      obs_manager.AddPoint3D(Eigen::Vector3d::Random(), track);
+  EXPECT_EQ(obs_manager.CovisibleImages(1), CovisibleImages({{2, 1}}));
+  EXPECT_EQ(obs_manager.CovisibleImages(2), CovisibleImages({{1, 1}}));
+
+  obs_manager.AddObservation(point3D_id1, TrackElement(3, 0));
+  EXPECT_EQ(obs_manager.CovisibleImages(1), CovisibleImages({{2, 1}, {3, 1}}));
+  EXPECT_EQ(obs_manager.CovisibleImages(3), CovisibleImages({{1, 1}, {2, 1}}));
+
+  track.SetElements({TrackElement(1, 1), TrackElement(2, 1)});
+  const point3D_t point3D_id2 =
+      obs_manager.AddPoint3D(Eigen::Vector3d::Random(), track);
+  EXPECT_EQ(obs_manager.CovisibleImages(1), CovisibleImages({{2, 2}, {3, 1}}));
+
+  obs_manager.DeleteObservation(2, 0);
+  EXPECT_EQ(obs_manager.CovisibleImages(1), CovisibleImages({{2, 1}, {3, 1}}));
+  EXPECT_EQ(obs_manager.CovisibleImages(2), CovisibleImages({{1, 1}}));
+  EXPECT_EQ(obs_manager.CovisibleImages(3), CovisibleImages({{1, 1}}));
+
+  obs_manager.DeletePoint3D(point3D_id2);
+  EXPECT_EQ(obs_manager.CovisibleImages(1), CovisibleImages({{3, 1}}));
+  EXPECT_TRUE(obs_manager.CovisibleImages(2).empty());
+
+  // The graph is initialized from the existing 3D points.
+  ObservationManager new_obs_manager(reconstruction);
+  EXPECT_EQ(new_obs_manager.CovisibleImages(1), CovisibleImages({{3, 1}}));
+}
+
+TEST(ObservationManager, AddImages) {
+  Reconstruction reconstruction;
+  const image_t kImageId1 = 1;
+  const image_t kImageId2 = 2;
+  const image_t kImageId3 = 3;
+  const camera_t kCameraId = 1;
+  const Camera camera = Camera::CreateFromModelId(kCameraId,
+                                                  CameraModelId::kPinhole,
+                                                  /*focal_length=*/10,
+                                                  /*width=*/10,
+                                                  /*height=*/10);
+  reconstruction.AddCamera(camera);
+  Image image;
+  image.SetImageId(kImageId1);
+  image.SetCameraId(kCameraId);
+  image.SetPoints2D(std::vector<Eigen::Vector2d>(10));
+  image.SetRegistered(true);
+  reconstruction.AddImage(image);
+  image.SetImageId(kImageId2);
+  reconstruction.AddImage(image);
+  auto correspondence_graph = std::make_shared<CorrespondenceGraph>();
+  correspondence_graph->AddImage(kImageId1, 10);
+  correspondence_graph->AddImage(kImageId2, 10);
+  FeatureMatches matches;
+  for (size_t i = 0; i < 10; ++i) {
+    matches.emplace_back(i, i);
+  }
+  correspondence_graph->AddCorrespondences(kImageId1, kImageId2, matches);
+  correspondence_graph->Finalize();
+  ObservationManager obs_manager(reconstruction, correspondence_graph);
+  Track track;
+  track.AddElement(kImageId1, 0);
+  track.AddElement(kImageId2, 0);
+  obs_manager.AddPoint3D(Eigen::Vector3d::Random(), track);
+  obs_manager.ClearModifiedImages();
+
+  // The new image sees the triangulated point through the first image.
+  image.SetImageId(kImageId3);
+  image.SetRegistered(false);
+  reconstruction.AddImage(image);
+  const FeatureMatches new_matches = {{0, 0}, {1, 1}};
+  correspondence_graph->Extend(
+      {{kImageId3, 10}}, {{kImageId1, kImageId3}}, {&new_matches});
+  obs_manager.AddImages({kImageId3});
+
+  EXPECT_EQ(obs_manager.NumObservations(kImageId3), 2);
+  EXPECT_EQ(obs_manager.NumCorrespondences(kImageId3), 2);
+  EXPECT_EQ(obs_manager.NumVisiblePoints3D(kImageId3), 1);
+  EXPECT_EQ(obs_manager.NumObservations(kImageId1), 10);
+  EXPECT_EQ(obs_manager.NumCorrespondences(kImageId1), 12);
+  EXPECT_EQ(obs_manager.NumVisiblePoints3D(kImageId1), 1);
+  const ObservationManager::ImagePairStat& image_pair_stat =
+      obs_manager.ImagePairs().at(
+          Database::ImagePairToPairId(kImageId1, kImageId3));
+  EXPECT_EQ(image_pair_stat.num_total_corrs, 2);
+  EXPECT_EQ(image_pair_stat.num_tri_corrs, 0);
+  EXPECT_EQ(obs_manager.GetModifiedImages(),
+            std::unordered_set<image_t>({kImageId1, kImageId3}));
+}
+
 TEST(ObservationManager, Point3DVisibilityScore) {
   Reconstruction reconstruction;
   const image_t kImageId1 = 1;
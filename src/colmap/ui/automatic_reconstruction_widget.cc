@@ -81,6 +81,7 @@ AutomaticReconstructionWidget::AutomaticReconstructionWidget(
                 "Shared intrinsics per sub-folder");
   AddOptionBool(&options_.sparse, "Sparse model");
   AddOptionBool(&options_.dense, "Dense model");
+  AddOptionBool(&options_.streaming, "Overlap stages");
 
   QLabel* mesher_label = new QLabel(tr("Mesher"), this);
   mesher_label->setFont(font());
@@ -75,6 +75,16 @@ BundleAdjustmentWidget::BundleAdjustmentWidget(MainWindow* main_window,
   AddOptionBool(&options->bundle_adjustment->refine_extrinsics,
                 "refine_extrinsics");
 
+  AddOptionBool(&options->bundle_adjustment->use_float_jacobians,
+                "use_float_jacobians");
+  AddOptionBool(
+      &options->bundle_adjustment->marginalize_constant_pose_points,
+      "marginalize_constant_pose_points");
+  AddOptionInt(&options->partitioned_bundle_adjustment->max_num_images,
+               "partition_max_num_images");
+  AddOptionInt(&options->partitioned_bundle_adjustment->max_num_iterations,
+               "partition_max_num_iterations");
+
   QPushButton* run_button = new QPushButton(tr("Run"), this);
   grid_layout_->addWidget(run_button, grid_layout_->rowCount(), 1);
   connect(
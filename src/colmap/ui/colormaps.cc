@@ -67,7 +67,7 @@ float PointColormapBase::AdjustScale(const float gray) {
 void PointColormapPhotometric::Prepare(
     std::unordered_map<camera_t, Camera>& cameras,
     std::unordered_map<image_t, Image>& images,
-    std::unordered_map<point3D_t, Point3D>& points3D,
+    SlotMap<point3D_t, Point3D>& points3D,
     std::vector<image_t>& reg_image_ids) {}
 
 Eigen::Vector4f PointColormapPhotometric::ComputeColor(
@@ -81,7 +81,7 @@ Eigen::Vector4f PointColormapPhotometric::ComputeColor(
 void PointColormapError::Prepare(
     std::unordered_map<camera_t, Camera>& cameras,
     std::unordered_map<image_t, Image>& images,
-    std::unordered_map<point3D_t, Point3D>& points3D,
+    SlotMap<point3D_t, Point3D>& points3D,
     std::vector<image_t>& reg_image_ids) {
   std::vector<float> errors;
   errors.reserve(points3D.size());
@@ -105,7 +105,7 @@ Eigen::Vector4f PointColormapError::ComputeColor(const point3D_t point3D_id,
 void PointColormapTrackLen::Prepare(
     std::unordered_map<camera_t, Camera>& cameras,
     std::unordered_map<image_t, Image>& images,
-    std::unordered_map<point3D_t, Point3D>& points3D,
+    SlotMap<point3D_t, Point3D>& points3D,
     std::vector<image_t>& reg_image_ids) {
   std::vector<float> track_lengths;
   track_lengths.reserve(points3D.size());
@@ -129,7 +129,7 @@ Eigen::Vector4f PointColormapTrackLen::ComputeColor(const point3D_t point3D_id,
 void PointColormapGroundResolution::Prepare(
     std::unordered_map<camera_t, Camera>& cameras,
     std::unordered_map<image_t, Image>& images,
-    std::unordered_map<point3D_t, Point3D>& points3D,
+    SlotMap<point3D_t, Point3D>& points3D,
     std::vector<image_t>& reg_image_ids) {
   std::vector<float> resolutions;
   resolutions.reserve(points3D.size());
@@ -219,7 +219,7 @@ ImageColormapBase::ImageColormapBase() {}
 void ImageColormapUniform::Prepare(
     std::unordered_map<camera_t, Camera>& cameras,
     std::unordered_map<image_t, Image>& images,
-    std::unordered_map<point3D_t, Point3D>& points3D,
+    SlotMap<point3D_t, Point3D>& points3D,
     std::vector<image_t>& reg_image_ids) {}
 
 void ImageColormapUniform::ComputeColor(const Image& image,
@@ -232,7 +232,7 @@ void ImageColormapUniform::ComputeColor(const Image& image,
 void ImageColormapNameFilter::Prepare(
     std::unordered_map<camera_t, Camera>& cameras,
     std::unordered_map<image_t, Image>& images,
-    std::unordered_map<point3D_t, Point3D>& points3D,
+    SlotMap<point3D_t, Point3D>& points3D,
     std::vector<image_t>& reg_image_ids) {}
 
 void ImageColormapNameFilter::AddColorForWord(
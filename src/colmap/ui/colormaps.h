@@ -45,7 +45,7 @@ class PointColormapBase {
 
   virtual void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                        std::unordered_map<image_t, Image>& images,
-                       std::unordered_map<point3D_t, Point3D>& points3D,
+                       SlotMap<point3D_t, Point3D>& points3D,
                        std::vector<image_t>& reg_image_ids) = 0;
 
   virtual Eigen::Vector4f ComputeColor(point3D_t point3D_id,
@@ -67,7 +67,7 @@ class PointColormapPhotometric : public PointColormapBase {
  public:
   void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                std::unordered_map<image_t, Image>& images,
-               std::unordered_map<point3D_t, Point3D>& points3D,
+               SlotMap<point3D_t, Point3D>& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(point3D_t point3D_id,
@@ -79,7 +79,7 @@ class PointColormapError : public PointColormapBase {
  public:
   void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                std::unordered_map<image_t, Image>& images,
-               std::unordered_map<point3D_t, Point3D>& points3D,
+               SlotMap<point3D_t, Point3D>& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(point3D_t point3D_id,
@@ -91,7 +91,7 @@ class PointColormapTrackLen : public PointColormapBase {
  public:
   void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                std::unordered_map<image_t, Image>& images,
-               std::unordered_map<point3D_t, Point3D>& points3D,
+               SlotMap<point3D_t, Point3D>& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(point3D_t point3D_id,
@@ -103,7 +103,7 @@ class PointColormapGroundResolution : public PointColormapBase {
  public:
   void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                std::unordered_map<image_t, Image>& images,
-               std::unordered_map<point3D_t, Point3D>& points3D,
+               SlotMap<point3D_t, Point3D>& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   Eigen::Vector4f ComputeColor(point3D_t point3D_id,
@@ -121,7 +121,7 @@ class ImageColormapBase {
 
   virtual void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                        std::unordered_map<image_t, Image>& images,
-                       std::unordered_map<point3D_t, Point3D>& points3D,
+                       SlotMap<point3D_t, Point3D>& points3D,
                        std::vector<image_t>& reg_image_ids) = 0;
 
   virtual void ComputeColor(const Image& image,
@@ -137,7 +137,7 @@ class ImageColormapUniform : public ImageColormapBase {
  public:
   void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                std::unordered_map<image_t, Image>& images,
-               std::unordered_map<point3D_t, Point3D>& points3D,
+               SlotMap<point3D_t, Point3D>& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   void ComputeColor(const Image& image,
@@ -153,7 +153,7 @@ class ImageColormapNameFilter : public ImageColormapBase {
  public:
   void Prepare(std::unordered_map<camera_t, Camera>& cameras,
                std::unordered_map<image_t, Image>& images,
-               std::unordered_map<point3D_t, Point3D>& points3D,
+               SlotMap<point3D_t, Point3D>& points3D,
                std::vector<image_t>& reg_image_ids) override;
 
   void AddColorForWord(const std::string& word,
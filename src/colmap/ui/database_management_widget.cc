@@ -43,7 +43,8 @@ TwoViewInfoTab::TwoViewInfoTab(QWidget* parent,
 
 void TwoViewInfoTab::Clear() {
   table_widget_->clearContents();
-  matches_.clear();
+  other_image_ids_.clear();
+  num_matches_.clear();
   configs_.clear();
   sorted_matches_idxs_.clear();
 }
@@ -89,48 +90,49 @@ void TwoViewInfoTab::ShowMatches() {
 
   const size_t idx =
       sorted_matches_idxs_[select->selectedRows().begin()->row()];
-  const auto& selection = matches_[idx];
-  const std::string path1 = JoinPaths(*options_->image_path, image_->Name());
-  const std::string path2 =
-      JoinPaths(*options_->image_path, selection.first->Name());
-  const auto keypoints1 = database_->ReadKeypoints(image_->ImageId());
-  const auto keypoints2 = database_->ReadKeypoints(selection.first->ImageId());
+  const image_t other_image_id = other_image_ids_[idx];
+  const std::string path1 = JoinPaths(*options_->image_path,
+                                      database_->ReadImage(image_id_).Name());
+  const std::string path2 = JoinPaths(
+      *options_->image_path, database_->ReadImage(other_image_id).Name());
+  const auto keypoints1 = database_->ReadKeypoints(image_id_);
+  const auto keypoints2 = database_->ReadKeypoints(other_image_id);
 
   matches_viewer_widget_->setWindowTitle(QString::fromStdString(
-      "Matches for image pair " + std::to_string(image_->ImageId()) + " - " +
-      std::to_string(selection.first->ImageId())));
+      "Matches for image pair " + std::to_string(image_id_) + " - " +
+      std::to_string(other_image_id)));
   matches_viewer_widget_->ReadAndShowWithMatches(
-      path1, path2, keypoints1, keypoints2, selection.second);
+      path1, path2, keypoints1, keypoints2, ReadMatches(other_image_id));
 }
 
 void TwoViewInfoTab::FillTable() {
   // Sort the matched pairs according to number of matches in descending order.
-  sorted_matches_idxs_.resize(matches_.size());
+  sorted_matches_idxs_.resize(other_image_ids_.size());
   std::iota(sorted_matches_idxs_.begin(), sorted_matches_idxs_.end(), 0);
 
   std::sort(sorted_matches_idxs_.begin(),
             sorted_matches_idxs_.end(),
             [&](const size_t idx1, const size_t idx2) {
-              return matches_[idx1].second.size() >
-                     matches_[idx2].second.size();
+              return num_matches_[idx1] > num_matches_[idx2];
             });
 
   QString info;
-  info += QString("Matched images: ") + QString::number(matches_.size());
+  info +=
+      QString("Matched images: ") + QString::number(other_image_ids_.size());
   info_label_->setText(info);
 
   table_widget_->clearContents();
-  table_widget_->setRowCount(matches_.size());
+  table_widget_->setRowCount(other_image_ids_.size());
 
   for (size_t i = 0; i < sorted_matches_idxs_.size(); ++i) {
     const size_t idx = sorted_matches_idxs_[i];
 
     QTableWidgetItem* image_id_item =
-        new QTableWidgetItem(QString::number(matches_[idx].first->ImageId()));
+        new QTableWidgetItem(QString::number(other_image_ids_[idx]));
     table_widget_->setItem(i, 0, image_id_item);
 
     QTableWidgetItem* num_matches_item =
-        new QTableWidgetItem(QString::number(matches_[idx].second.size()));
+        new QTableWidgetItem(QString::number(num_matches_[idx]));
     table_widget_->setItem(i, 1, num_matches_item);
 
     // config for inlier matches tab
@@ -154,30 +156,21 @@ MatchesTab::MatchesTab(QWidget* parent,
   InitializeTable(table_header);
 }
 
-void MatchesTab::Reload(const std::vector<Image>& images,
-                        const image_t image_id) {
-  matches_.clear();
+void MatchesTab::Reload(const image_t image_id) {
+  Clear();
 
-  // Find all matched images
-
-  for (const auto& image : images) {
-    if (image.ImageId() == image_id) {
-      image_ = &image;
-      continue;
-    }
-
-    if (database_->ExistsMatches(image_id, image.ImageId())) {
-      const auto matches = database_->ReadMatches(image_id, image.ImageId());
-
-      if (matches.size() > 0) {
-        matches_.emplace_back(&image, matches);
-      }
-    }
-  }
+  // Find all matched images without reading their matches.
+  image_id_ = image_id;
+  database_->ReadNumMatchesForImage(
+      image_id, &other_image_ids_, &num_matches_);
 
   FillTable();
 }
 
+FeatureMatches MatchesTab::ReadMatches(const image_t other_image_id) const {
+  return database_->ReadMatches(image_id_, other_image_id);
+}
+
 TwoViewGeometriesTab::TwoViewGeometriesTab(QWidget* parent,
                                            OptionManager* options,
                                            Database* database)
@@ -189,33 +182,23 @@ TwoViewGeometriesTab::TwoViewGeometriesTab(QWidget* parent,
   InitializeTable(table_header);
 }
 
-void TwoViewGeometriesTab::Reload(const std::vector<Image>& images,
-                                  const image_t image_id) {
-  matches_.clear();
-  configs_.clear();
-
-  // Find all matched images.
+void TwoViewGeometriesTab::Reload(const image_t image_id) {
+  Clear();
 
-  for (const auto& image : images) {
-    if (image.ImageId() == image_id) {
-      image_ = &image;
-      continue;
-    }
-
-    if (database_->ExistsInlierMatches(image_id, image.ImageId())) {
-      const auto two_view_geometry =
-          database_->ReadTwoViewGeometry(image_id, image.ImageId());
-
-      if (two_view_geometry.inlier_matches.size() > 0) {
-        matches_.emplace_back(&image, two_view_geometry.inlier_matches);
-        configs_.push_back(two_view_geometry.config);
-      }
-    }
-  }
+  // Find all matched images without reading their inlier matches.
+  image_id_ = image_id;
+  database_->ReadTwoViewGeometryNumInliersForImage(
+      image_id, &other_image_ids_, &num_matches_, &configs_);
 
   FillTable();
 }
 
+FeatureMatches TwoViewGeometriesTab::ReadMatches(
+    const image_t other_image_id) const {
+  return database_->ReadTwoViewGeometry(image_id_, other_image_id)
+      .inlier_matches;
+}
+
 OverlappingImagesWidget::OverlappingImagesWidget(QWidget* parent,
                                                  OptionManager* options,
                                                  Database* database)
@@ -245,15 +228,14 @@ OverlappingImagesWidget::OverlappingImagesWidget(QWidget* parent,
   grid->addWidget(close_button, 1, 0, Qt::AlignRight);
 }
 
-void OverlappingImagesWidget::ShowMatches(const std::vector<Image>& images,
-                                          const image_t image_id) {
+void OverlappingImagesWidget::ShowMatches(const image_t image_id) {
   parent_->setDisabled(true);
 
   setWindowTitle(
       QString::fromStdString("Matches for image " + std::to_string(image_id)));
 
-  matches_tab_->Reload(images, image_id);
-  two_view_geometries_tab_->Reload(images, image_id);
+  matches_tab_->Reload(image_id);
+  two_view_geometries_tab_->Reload(image_id);
 }
 
 void OverlappingImagesWidget::closeEvent(QCloseEvent*) {
@@ -262,6 +244,161 @@ void OverlappingImagesWidget::closeEvent(QCloseEvent*) {
   parent_->setEnabled(true);
 }
 
+CameraTableModel::CameraTableModel(QWidget* parent, Database* database)
+    : DatabaseTableModel<Camera>(parent,
+                                 database,
+                                 QStringList() << "camera_id"
+                                               << "model"
+                                               << "width"
+                                               << "height"
+                                               << "params"
+                                               << "prior_focal_length") {}
+
+QVariant CameraTableModel::data(const QModelIndex& index,
+                                const int role) const {
+  if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)) {
+    return QVariant();
+  }
+
+  const Camera& camera = Row(index.row());
+  switch (index.column()) {
+    case 0:
+      return QString::number(camera.camera_id);
+    case 1:
+      return QString::fromStdString(camera.ModelName());
+    case 2:
+      return QString::number(camera.width);
+    case 3:
+      return QString::number(camera.height);
+    case 4:
+      return QString::fromStdString(VectorToCSV(camera.params));
+    case 5:
+      return QString::number(camera.has_prior_focal_length);
+    default:
+      return QVariant();
+  }
+}
+
+bool CameraTableModel::setData(const QModelIndex& index,
+                               const QVariant& value,
+                               const int role) {
+  if (!index.isValid() || role != Qt::EditRole) {
+    return false;
+  }
+
+  Camera& camera = Row(index.row());
+
+  switch (index.column()) {
+    // case 0: never change the camera ID
+    // case 1: never change the camera model
+    case 2:
+      camera.width = static_cast<size_t>(value.toInt());
+      break;
+    case 3:
+      camera.height = static_cast<size_t>(value.toInt());
+      break;
+    case 4:
+      if (!camera.SetParamsFromString(value.toString().toUtf8().constData())) {
+        QMessageBox::critical(parent_, "", tr("Invalid camera parameters."));
+        return false;
+      }
+      break;
+    case 5:
+      camera.has_prior_focal_length = static_cast<bool>(value.toInt());
+      break;
+    default:
+      return false;
+  }
+
+  database_->UpdateCamera(camera);
+  RowChanged(index.row());
+
+  return true;
+}
+
+Qt::ItemFlags CameraTableModel::flags(const QModelIndex& index) const {
+  if (index.column() <= 1) {
+    return Qt::ItemIsSelectable;
+  }
+  return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+std::vector<Camera> CameraTableModel::ReadPage(const size_t offset,
+                                               const size_t num_rows) const {
+  return database_->ReadCamerasPage(offset, num_rows);
+}
+
+ImageTableModel::ImageTableModel(QWidget* parent, Database* database)
+    : DatabaseTableModel<Image>(parent,
+                                database,
+                                QStringList() << "image_id"
+                                              << "name"
+                                              << "camera_id") {}
+
+QVariant ImageTableModel::data(const QModelIndex& index,
+                               const int role) const {
+  if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)) {
+    return QVariant();
+  }
+
+  const Image& image = Row(index.row());
+  switch (index.column()) {
+    case 0:
+      return QString::number(image.ImageId());
+    case 1:
+      return QString::fromStdString(image.Name());
+    case 2:
+      return QString::number(image.CameraId());
+    default:
+      return QVariant();
+  }
+}
+
+bool ImageTableModel::setData(const QModelIndex& index,
+                              const QVariant& value,
+                              const int role) {
+  if (!index.isValid() || role != Qt::EditRole) {
+    return false;
+  }
+
+  Image& image = Row(index.row());
+  camera_t camera_id = kInvalidCameraId;
+
+  switch (index.column()) {
+    // case 0: never change the image ID
+    case 1:
+      image.SetName(value.toString().toUtf8().constData());
+      break;
+    case 2:
+      camera_id = static_cast<camera_t>(value.toInt());
+      if (!database_->ExistsCamera(camera_id)) {
+        QMessageBox::critical(parent_, "", tr("camera_id does not exist."));
+        return false;
+      }
+      image.SetCameraId(camera_id);
+      break;
+    default:
+      return false;
+  }
+
+  database_->UpdateImage(image);
+  RowChanged(index.row());
+
+  return true;
+}
+
+Qt::ItemFlags ImageTableModel::flags(const QModelIndex& index) const {
+  if (index.column() == 0) {
+    return Qt::ItemIsSelectable;
+  }
+  return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+std::vector<Image> ImageTableModel::ReadPage(const size_t offset,
+                                             const size_t num_rows) const {
+  return database_->ReadImagesPage(offset, num_rows);
+}
+
 CameraTab::CameraTab(QWidget* parent, Database* database)
     : QWidget(parent), database_(database) {
   QGridLayout* grid = new QGridLayout(this);
@@ -277,118 +414,35 @@ CameraTab::CameraTab(QWidget* parent, Database* database)
   connect(set_model_button, &QPushButton::released, this, &CameraTab::SetModel);
   grid->addWidget(set_model_button, 0, 2, Qt::AlignRight);
 
-  table_widget_ = new QTableWidget(this);
-  table_widget_->setColumnCount(6);
+  table_model_ = new CameraTableModel(this, database_);
 
-  QStringList table_header;
-  table_header << "camera_id"
-               << "model"
-               << "width"
-               << "height"
-               << "params"
-               << "prior_focal_length";
-  table_widget_->setHorizontalHeaderLabels(table_header);
+  table_view_ = new QTableView(this);
+  table_view_->setModel(table_model_);
 
-  table_widget_->setShowGrid(true);
-  table_widget_->setSelectionBehavior(QAbstractItemView::SelectRows);
-  table_widget_->horizontalHeader()->setStretchLastSection(true);
-  table_widget_->verticalHeader()->setVisible(false);
-  table_widget_->verticalHeader()->setDefaultSectionSize(20);
+  table_view_->setShowGrid(true);
+  table_view_->setSelectionBehavior(QAbstractItemView::SelectRows);
+  table_view_->horizontalHeader()->setStretchLastSection(true);
+  table_view_->verticalHeader()->setVisible(false);
+  table_view_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  table_view_->verticalHeader()->setDefaultSectionSize(20);
 
-  connect(
-      table_widget_, &QTableWidget::itemChanged, this, &CameraTab::itemChanged);
-
-  grid->addWidget(table_widget_, 1, 0, 1, 3);
+  grid->addWidget(table_view_, 1, 0, 1, 3);
 
   grid->setColumnStretch(0, 1);
 }
 
 void CameraTab::Reload() {
+  const size_t num_cameras = database_->NumCameras();
+
   QString info;
-  info += QString("Cameras: ") + QString::number(database_->NumCameras());
+  info += QString("Cameras: ") + QString::number(num_cameras);
   info_label_->setText(info);
 
-  cameras_ = database_->ReadAllCameras();
-
-  // Make sure, itemChanged is not invoked, while setting up the table.
-  table_widget_->blockSignals(true);
-
-  table_widget_->clearContents();
-  table_widget_->setRowCount(cameras_.size());
-
-  std::sort(cameras_.begin(),
-            cameras_.end(),
-            [](const Camera& camera1, const Camera& camera2) {
-              return camera1.camera_id < camera2.camera_id;
-            });
-
-  for (size_t i = 0; i < cameras_.size(); ++i) {
-    const Camera& camera = cameras_[i];
-    QTableWidgetItem* id_item =
-        new QTableWidgetItem(QString::number(camera.camera_id));
-    id_item->setFlags(Qt::ItemIsSelectable);
-    table_widget_->setItem(i, 0, id_item);
-
-    QTableWidgetItem* model_item =
-        new QTableWidgetItem(QString::fromStdString(camera.ModelName()));
-    model_item->setFlags(Qt::ItemIsSelectable);
-    table_widget_->setItem(i, 1, model_item);
-
-    table_widget_->setItem(
-        i, 2, new QTableWidgetItem(QString::number(camera.width)));
-    table_widget_->setItem(
-        i, 3, new QTableWidgetItem(QString::number(camera.height)));
-
-    table_widget_->setItem(i,
-                           4,
-                           new QTableWidgetItem(QString::fromStdString(
-                               VectorToCSV(camera.params))));
-    table_widget_->setItem(
-        i,
-        5,
-        new QTableWidgetItem(QString::number(camera.has_prior_focal_length)));
-  }
-  table_widget_->resizeColumnsToContents();
-
-  table_widget_->blockSignals(false);
+  table_model_->Reload(num_cameras);
+  table_view_->resizeColumnsToContents();
 }
 
-void CameraTab::Clear() {
-  cameras_.clear();
-  table_widget_->clearContents();
-}
-
-void CameraTab::itemChanged(QTableWidgetItem* item) {
-  Camera& camera = cameras_.at(item->row());
-  const std::vector<double> prev_params = camera.params;
-
-  switch (item->column()) {
-    // case 0: never change the camera ID
-    // case 1: never change the camera model
-    case 2:
-      camera.width = static_cast<size_t>(item->data(Qt::DisplayRole).toInt());
-      break;
-    case 3:
-      camera.height = static_cast<size_t>(item->data(Qt::DisplayRole).toInt());
-      break;
-    case 4:
-      if (!camera.SetParamsFromString(item->text().toUtf8().constData())) {
-        QMessageBox::critical(this, "", tr("Invalid camera parameters."));
-        table_widget_->blockSignals(true);
-        item->setText(QString::fromStdString(VectorToCSV(prev_params)));
-        table_widget_->blockSignals(false);
-      }
-      break;
-    case 5:
-      camera.has_prior_focal_length =
-          static_cast<bool>(item->data(Qt::DisplayRole).toInt());
-      break;
-    default:
-      break;
-  }
-
-  database_->UpdateCamera(camera);
-}
+void CameraTab::Clear() { table_model_->Clear(); }
 
 void CameraTab::Add() {
   QStringList camera_models;
@@ -419,12 +473,13 @@ void CameraTab::Add() {
   // Reload all cameras
   Reload();
 
-  // Highlight new camera
-  table_widget_->selectRow(cameras_.size() - 1);
+  // Highlight new camera, which has the largest identifier.
+  table_view_->selectRow(table_model_->rowCount() - 1);
+  table_view_->scrollToBottom();
 }
 
 void CameraTab::SetModel() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No camera selected."));
@@ -444,23 +499,16 @@ void CameraTab::SetModel() {
     return;
   }
 
-  // Make sure, itemChanged is not invoked, while updating up the table
-  table_widget_->blockSignals(true);
-
-  for (QModelIndex& index : select->selectedRows()) {
-    LOG(INFO) << index.row();
-    auto& camera = cameras_.at(index.row());
+  for (const QModelIndex& index : select->selectedRows()) {
+    Camera& camera = table_model_->Row(index.row());
     camera = Camera::CreateFromModelName(camera.camera_id,
                                          camera_model.toUtf8().constData(),
                                          camera.MeanFocalLength(),
                                          camera.width,
                                          camera.height);
     database_->UpdateCamera(camera);
+    table_model_->RowChanged(index.row());
   }
-
-  table_widget_->blockSignals(false);
-
-  Reload();
 }
 
 ImageTab::ImageTab(QWidget* parent,
@@ -501,25 +549,19 @@ ImageTab::ImageTab(QWidget* parent,
           &ImageTab::ShowMatches);
   grid->addWidget(overlapping_images_button, 0, 4, Qt::AlignRight);
 
-  table_widget_ = new QTableWidget(this);
-  table_widget_->setColumnCount(3);
+  table_model_ = new ImageTableModel(this, database_);
 
-  QStringList table_header;
-  table_header << "image_id"
-               << "name"
-               << "camera_id";
-  table_widget_->setHorizontalHeaderLabels(table_header);
+  table_view_ = new QTableView(this);
+  table_view_->setModel(table_model_);
 
-  table_widget_->setShowGrid(true);
-  table_widget_->setSelectionBehavior(QAbstractItemView::SelectRows);
-  table_widget_->horizontalHeader()->setStretchLastSection(true);
-  table_widget_->verticalHeader()->setVisible(false);
-  table_widget_->verticalHeader()->setDefaultSectionSize(20);
-
-  connect(
-      table_widget_, &QTableWidget::itemChanged, this, &ImageTab::itemChanged);
+  table_view_->setShowGrid(true);
+  table_view_->setSelectionBehavior(QAbstractItemView::SelectRows);
+  table_view_->horizontalHeader()->setStretchLastSection(true);
+  table_view_->verticalHeader()->setVisible(false);
+  table_view_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  table_view_->verticalHeader()->setDefaultSectionSize(20);
 
-  grid->addWidget(table_widget_, 1, 0, 1, 5);
+  grid->addWidget(table_view_, 1, 0, 1, 5);
 
   grid->setColumnStretch(0, 3);
 
@@ -529,70 +571,22 @@ ImageTab::ImageTab(QWidget* parent,
 }
 
 void ImageTab::Reload() {
+  const size_t num_images = database_->NumImages();
+
   QString info;
-  info += QString("Images: ") + QString::number(database_->NumImages());
+  info += QString("Images: ") + QString::number(num_images);
   info += QString("\n");
   info += QString("Features: ") + QString::number(database_->NumKeypoints());
   info_label_->setText(info);
 
-  images_ = database_->ReadAllImages();
-
-  // Make sure, itemChanged is not invoked, while setting up the table
-  table_widget_->blockSignals(true);
-
-  table_widget_->clearContents();
-  table_widget_->setRowCount(images_.size());
-
-  for (size_t i = 0; i < images_.size(); ++i) {
-    const auto& image = images_[i];
-    QTableWidgetItem* id_item =
-        new QTableWidgetItem(QString::number(image.ImageId()));
-    id_item->setFlags(Qt::ItemIsSelectable);
-    table_widget_->setItem(i, 0, id_item);
-    table_widget_->setItem(
-        i, 1, new QTableWidgetItem(QString::fromStdString(image.Name())));
-    table_widget_->setItem(
-        i, 2, new QTableWidgetItem(QString::number(image.CameraId())));
-  }
-  table_widget_->resizeColumnsToContents();
-
-  table_widget_->blockSignals(false);
+  table_model_->Reload(num_images);
+  table_view_->resizeColumnsToContents();
 }
 
-void ImageTab::Clear() {
-  images_.clear();
-  table_widget_->clearContents();
-}
-
-void ImageTab::itemChanged(QTableWidgetItem* item) {
-  Image& image = images_.at(item->row());
-  camera_t camera_id = kInvalidCameraId;
-
-  switch (item->column()) {
-    // case 0: never change the image ID
-    case 1:
-      image.SetName(item->text().toUtf8().constData());
-      break;
-    case 2:
-      camera_id = static_cast<camera_t>(item->data(Qt::DisplayRole).toInt());
-      if (!database_->ExistsCamera(camera_id)) {
-        QMessageBox::critical(this, "", tr("camera_id does not exist."));
-        table_widget_->blockSignals(true);
-        item->setText(QString::number(image.CameraId()));
-        table_widget_->blockSignals(false);
-      } else {
-        image.SetCameraId(camera_id);
-      }
-      break;
-    default:
-      break;
-  }
-
-  database_->UpdateImage(image);
-}
+void ImageTab::Clear() { table_model_->Clear(); }
 
 void ImageTab::ShowImage() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -604,7 +598,7 @@ void ImageTab::ShowImage() {
     return;
   }
 
-  const auto& image = images_[select->selectedRows().begin()->row()];
+  const Image image = table_model_->Row(select->selectedRows().begin()->row());
 
   const auto keypoints = database_->ReadKeypoints(image.ImageId());
   const std::vector<char> tri_mask(keypoints.size(), false);
@@ -616,7 +610,7 @@ void ImageTab::ShowImage() {
 }
 
 void ImageTab::ShowMatches() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -628,15 +622,16 @@ void ImageTab::ShowMatches() {
     return;
   }
 
-  const auto& image = images_[select->selectedRows().begin()->row()];
+  const image_t image_id =
+      table_model_->Row(select->selectedRows().begin()->row()).ImageId();
 
-  overlapping_images_widget_->ShowMatches(images_, image.ImageId());
+  overlapping_images_widget_->ShowMatches(image_id);
   overlapping_images_widget_->show();
   overlapping_images_widget_->raise();
 }
 
 void ImageTab::SetCamera() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -655,22 +650,16 @@ void ImageTab::SetCamera() {
     return;
   }
 
-  // Make sure, itemChanged is not invoked, while updating up the table
-  table_widget_->blockSignals(true);
-
-  for (QModelIndex& index : select->selectedRows()) {
-    table_widget_->setItem(
-        index.row(), 2, new QTableWidgetItem(QString::number(camera_id)));
-    auto& image = images_[index.row()];
+  for (const QModelIndex& index : select->selectedRows()) {
+    Image& image = table_model_->Row(index.row());
     image.SetCameraId(camera_id);
     database_->UpdateImage(image);
+    table_model_->RowChanged(index.row());
   }
-
-  table_widget_->blockSignals(false);
 }
 
 void ImageTab::SplitCamera() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -691,21 +680,14 @@ void ImageTab::SplitCamera() {
 
   const auto camera = database_->ReadCamera(camera_id);
 
-  // Make sure, itemChanged is not invoked, while updating up the table
-  table_widget_->blockSignals(true);
-
-  for (QModelIndex& index : select->selectedRows()) {
-    auto& image = images_[index.row()];
-    image.SetCameraId(database_->WriteCamera(camera));
+  for (const QModelIndex& index : select->selectedRows()) {
+    const camera_t new_camera_id = database_->WriteCamera(camera);
+    Image& image = table_model_->Row(index.row());
+    image.SetCameraId(new_camera_id);
     database_->UpdateImage(image);
-    table_widget_->setItem(
-        index.row(),
-        2,
-        new QTableWidgetItem(QString::number(image.CameraId())));
+    table_model_->RowChanged(index.row());
   }
 
-  table_widget_->blockSignals(false);
-
   camera_tab_->Reload();
 }
 
@@ -34,9 +34,11 @@
 #include "colmap/ui/image_viewer_widget.h"
 #include "colmap/util/misc.h"
 
+#include <list>
+#include <unordered_map>
+
 #include <QtCore>
 #include <QtWidgets>
-#include <unordered_map>
 
 namespace colmap {
 
@@ -56,11 +58,16 @@ class TwoViewInfoTab : public QWidget {
   void ShowMatches();
   void FillTable();
 
+  // Read the matches of the selected image with the other image, which are
+  // only read when they are shown.
+  virtual FeatureMatches ReadMatches(image_t other_image_id) const = 0;
+
   OptionManager* options_;
   Database* database_;
 
-  const Image* image_;
-  std::vector<std::pair<const Image*, FeatureMatches>> matches_;
+  image_t image_id_ = kInvalidImageId;
+  std::vector<image_t> other_image_ids_;
+  std::vector<int> num_matches_;
   std::vector<int> configs_;
   std::vector<size_t> sorted_matches_idxs_;
 
@@ -73,7 +80,10 @@ class MatchesTab : public TwoViewInfoTab {
  public:
   MatchesTab(QWidget* parent, OptionManager* options, Database* database);
 
-  void Reload(const std::vector<Image>& images, image_t image_id);
+  void Reload(image_t image_id);
+
+ protected:
+  FeatureMatches ReadMatches(image_t other_image_id) const override;
 };
 
 class TwoViewGeometriesTab : public TwoViewInfoTab {
@@ -82,7 +92,10 @@ class TwoViewGeometriesTab : public TwoViewInfoTab {
                        OptionManager* options,
                        Database* database);
 
-  void Reload(const std::vector<Image>& images, image_t image_id);
+  void Reload(image_t image_id);
+
+ protected:
+  FeatureMatches ReadMatches(image_t other_image_id) const override;
 };
 
 class OverlappingImagesWidget : public QWidget {
@@ -91,7 +104,7 @@ class OverlappingImagesWidget : public QWidget {
                           OptionManager* options,
                           Database* database);
 
-  void ShowMatches(const std::vector<Image>& images, image_t image_id);
+  void ShowMatches(image_t image_id);
 
  private:
   void closeEvent(QCloseEvent* event);
@@ -109,6 +122,87 @@ class OverlappingImagesWidget : public QWidget {
 // Images, Cameras
 ////////////////////////////////////////////////////////////////////////////////
 
+// Table model of the rows of a database table in the order of their
+// identifiers. The rows are read page by page when they are first shown and
+// only the most recently shown pages are kept, so that the tables of large
+// databases are shown without reading them entirely.
+template <typename T>
+class DatabaseTableModel : public QAbstractTableModel {
+ public:
+  DatabaseTableModel(QWidget* parent,
+                     Database* database,
+                     const QStringList& header);
+
+  // Reset the model to the given number of rows and drop the read pages.
+  void Reload(size_t num_rows);
+  void Clear();
+
+  // Access the row, whose page is read if it is not kept. The reference is
+  // only valid until the next access.
+  T& Row(int row) const;
+
+  // Notify the views that the row was changed through its reference.
+  void RowChanged(int row);
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+  QVariant headerData(int section,
+                      Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+ protected:
+  virtual std::vector<T> ReadPage(size_t offset, size_t num_rows) const = 0;
+
+  QWidget* parent_;
+  Database* database_;
+
+ private:
+  static const size_t kPageSize = 512;
+  static const size_t kMaxNumPages = 16;
+
+  struct Page {
+    std::vector<T> rows;
+    std::list<size_t>::iterator lru_it;
+  };
+
+  QStringList header_;
+  size_t num_rows_ = 0;
+
+  // Read pages by their index with the least recently accessed page first.
+  mutable std::unordered_map<size_t, Page> pages_;
+  mutable std::list<size_t> pages_lru_;
+};
+
+class CameraTableModel : public DatabaseTableModel<Camera> {
+ public:
+  CameraTableModel(QWidget* parent, Database* database);
+
+  QVariant data(const QModelIndex& index,
+                int role = Qt::DisplayRole) const override;
+  bool setData(const QModelIndex& index,
+               const QVariant& value,
+               int role = Qt::EditRole) override;
+  Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+ protected:
+  std::vector<Camera> ReadPage(size_t offset, size_t num_rows) const override;
+};
+
+class ImageTableModel : public DatabaseTableModel<Image> {
+ public:
+  ImageTableModel(QWidget* parent, Database* database);
+
+  QVariant data(const QModelIndex& index,
+                int role = Qt::DisplayRole) const override;
+  bool setData(const QModelIndex& index,
+               const QVariant& value,
+               int role = Qt::EditRole) override;
+  Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+ protected:
+  std::vector<Image> ReadPage(size_t offset, size_t num_rows) const override;
+};
+
 class CameraTab : public QWidget {
  public:
   CameraTab(QWidget* parent, Database* database);
@@ -117,15 +211,13 @@ class CameraTab : public QWidget {
   void Clear();
 
  private:
-  void itemChanged(QTableWidgetItem* item);
   void Add();
   void SetModel();
 
   Database* database_;
 
-  std::vector<Camera> cameras_;
-
-  QTableWidget* table_widget_;
+  CameraTableModel* table_model_;
+  QTableView* table_view_;
   QLabel* info_label_;
 };
 
@@ -140,8 +232,6 @@ class ImageTab : public QWidget {
   void Clear();
 
  private:
-  void itemChanged(QTableWidgetItem* item);
-
   void ShowImage();
   void ShowMatches();
   void SetCamera();
@@ -152,9 +242,8 @@ class ImageTab : public QWidget {
   OptionManager* options_;
   Database* database_;
 
-  std::vector<Image> images_;
-
-  QTableWidget* table_widget_;
+  ImageTableModel* table_model_;
+  QTableView* table_view_;
   QLabel* info_label_;
 
   OverlappingImagesWidget* overlapping_images_widget_;
@@ -183,4 +272,76 @@ class DatabaseManagementWidget : public QWidget {
   CameraTab* camera_tab_;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+DatabaseTableModel<T>::DatabaseTableModel(QWidget* parent,
+                                          Database* database,
+                                          const QStringList& header)
+    : QAbstractTableModel(parent),
+      parent_(parent),
+      database_(database),
+      header_(header) {}
+
+template <typename T>
+void DatabaseTableModel<T>::Reload(const size_t num_rows) {
+  beginResetModel();
+  num_rows_ = num_rows;
+  pages_.clear();
+  pages_lru_.clear();
+  endResetModel();
+}
+
+template <typename T>
+void DatabaseTableModel<T>::Clear() {
+  Reload(0);
+}
+
+template <typename T>
+T& DatabaseTableModel<T>::Row(const int row) const {
+  const size_t page_idx = row / kPageSize;
+  auto it = pages_.find(page_idx);
+  if (it == pages_.end()) {
+    if (pages_.size() >= kMaxNumPages) {
+      pages_.erase(pages_lru_.front());
+      pages_lru_.pop_front();
+    }
+    it = pages_
+             .emplace(page_idx,
+                      Page{ReadPage(page_idx * kPageSize, kPageSize),
+                           pages_lru_.insert(pages_lru_.end(), page_idx)})
+             .first;
+  } else {
+    pages_lru_.splice(pages_lru_.end(), pages_lru_, it->second.lru_it);
+  }
+  return it->second.rows.at(row % kPageSize);
+}
+
+template <typename T>
+void DatabaseTableModel<T>::RowChanged(const int row) {
+  emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+template <typename T>
+int DatabaseTableModel<T>::rowCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(num_rows_);
+}
+
+template <typename T>
+int DatabaseTableModel<T>::columnCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : header_.size();
+}
+
+template <typename T>
+QVariant DatabaseTableModel<T>::headerData(const int section,
+                                           const Qt::Orientation orientation,
+                                           const int role) const {
+  if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
+    return header_.at(section);
+  }
+  return QVariant();
+}
+
 }  // namespace colmap
@@ -70,6 +70,15 @@ class StereoOptionsTab : public OptionsWidget {
                     "incident_angle_sigma");
     AddOptionInt(&options->patch_match_stereo->num_iterations,
                  "num_iterations");
+    AddOptionInt(&options->patch_match_stereo->num_pyramid_levels,
+                 "num_pyramid_levels");
+    AddOptionInt(&options->patch_match_stereo->num_pyramid_iterations,
+                 "num_pyramid_iterations");
+    AddOptionBool(&options->patch_match_stereo->init_from_sparse_points,
+                  "init_from_sparse_points");
+    AddOptionBool(&options->patch_match_stereo->init_from_src_maps,
+                  "init_from_src_maps");
+    AddOptionInt(&options->patch_match_stereo->init_radius, "init_radius", 0);
     AddOptionBool(&options->patch_match_stereo->geom_consistency,
                   "geom_consistency");
     AddOptionDouble(&options->patch_match_stereo->geom_consistency_regularizer,
@@ -93,8 +102,23 @@ class StereoOptionsTab : public OptionsWidget {
                     std::numeric_limits<double>::max(),
                     0.1,
                     1);
+    AddOptionDouble(&options->patch_match_stereo->gpu_cache_size,
+                    "gpu_cache_size [gigabytes]",
+                    -1,
+                    std::numeric_limits<double>::max(),
+                    0.1,
+                    1);
     AddOptionBool(&options->patch_match_stereo->write_consistency_graph,
                   "write_consistency_graph");
+    AddOptionText(&options->patch_match_stereo->map_file_format,
+                  "map_file_format");
+    AddOptionText(&options->patch_match_stereo->bitmap_decoder,
+                  "bitmap_decoder");
+    AddOptionInt(&options->patch_match_stereo->num_problems_per_gpu,
+                 "num_problems_per_gpu",
+                 1);
+    AddOptionInt(&options->patch_match_stereo->num_prefetch_problems,
+                 "num_prefetch_problems");
   }
 };
 
@@ -126,6 +150,9 @@ class FusionOptionsTab : public OptionsWidget {
                     0.1,
                     1);
     AddOptionBool(&options->stereo_fusion->use_cache, "use_cache");
+    AddOptionText(&options->stereo_fusion->bitmap_decoder, "bitmap_decoder");
+    AddOptionBool(&options->stereo_fusion->use_gpu, "use_gpu");
+    AddOptionText(&options->stereo_fusion->gpu_index, "gpu_index");
   }
 };
 
@@ -139,6 +166,13 @@ class MeshingOptionsTab : public OptionsWidget {
     AddOptionDouble(&options->poisson_meshing->color, "color", 0);
     AddOptionDouble(&options->poisson_meshing->trim, "trim", 0);
     AddOptionInt(&options->poisson_meshing->num_threads, "num_threads", -1);
+    AddOptionInt(&options->poisson_meshing->max_num_block_points,
+                 "max_num_block_points",
+                 -1);
+    AddOptionDouble(
+        &options->poisson_meshing->block_overlap, "block_overlap", 0);
+    AddOptionDouble(
+        &options->poisson_meshing->voxel_size, "voxel_size", -1, 1e7, 1e-4, 4);
 
     AddSection("Delaunay Meshing");
     AddOptionDouble(
@@ -158,6 +192,8 @@ class MeshingOptionsTab : public OptionsWidget {
                     "max_side_length_percentile",
                     0);
     AddOptionInt(&options->delaunay_meshing->num_threads, "num_threads", -1);
+    AddOptionDouble(
+        &options->delaunay_meshing->voxel_size, "voxel_size", -1, 1e7, 1e-4, 4);
   }
 };
 
@@ -76,9 +76,31 @@ SIFTExtractionWidget::SIFTExtractionWidget(QWidget* parent,
   AddOptionDirPath(&options->image_reader->mask_path, "mask_path");
   AddOptionFilePath(&options->image_reader->camera_mask_path,
                     "camera_mask_path");
+  AddOptionInt(&options->image_reader->num_threads, "reader_num_threads", -1);
+  AddOptionInt(
+      &options->image_reader->max_image_size, "reader_max_image_size", -1);
+  AddOptionText(&options->image_reader->bitmap_decoder, "bitmap_decoder");
+  AddOptionFilePath(&options->image_reader->video_path, "video_path");
+  AddOptionInt(
+      &options->image_reader->video_frame_step, "video_frame_step", 1);
+  AddOptionBool(&options->image_reader->video_keyframes_only,
+                "video_keyframes_only");
+  AddOptionBool(&options->image_reader->detect_changed_images,
+                "detect_changed_images");
 
   AddOptionInt(&options->sift_extraction->max_image_size, "max_image_size");
+  AddOptionBool(&options->sift_extraction->gpu_downsample, "gpu_downsample");
+  AddOptionInt(&options->sift_extraction->gpu_num_threads_per_device,
+               "gpu_num_threads_per_device",
+               1);
+  AddOptionInt(&options->sift_extraction->gpu_pyramid_bucket_size,
+               "gpu_pyramid_bucket_size",
+               0);
   AddOptionInt(&options->sift_extraction->max_num_features, "max_num_features");
+  AddOptionInt(&options->sift_extraction->tile_size, "tile_size", -1);
+  AddOptionInt(&options->sift_extraction->tile_overlap, "tile_overlap", 0);
+  AddOptionInt(
+      &options->sift_extraction->tile_num_threads, "tile_num_threads", -1);
   AddOptionInt(&options->sift_extraction->first_octave, "first_octave", -5);
   AddOptionInt(&options->sift_extraction->num_octaves, "num_octaves");
   AddOptionInt(&options->sift_extraction->octave_resolution,
@@ -110,6 +132,14 @@ SIFTExtractionWidget::SIFTExtractionWidget(QWidget* parent,
                   0.00001,
                   5);
   AddOptionInt(&options->sift_extraction->dsp_num_scales, "dsp_num_scales", 1);
+  AddOptionInt(&options->sift_extraction->max_num_images_per_transaction,
+               "max_num_images_per_transaction",
+               1);
+  AddOptionDouble(&options->sift_extraction->max_transaction_duration,
+                  "max_transaction_duration",
+                  0);
+  AddOptionDirPath(&options->sift_extraction->feature_cache_path,
+                   "feature_cache_path");
 
   AddOptionInt(&options->sift_extraction->num_threads, "num_threads", -1);
   AddOptionBool(&options->sift_extraction->use_gpu, "use_gpu");
@@ -68,6 +68,12 @@ class VocabTreeMatchingTab : public FeatureMatchingTab {
   void Run() override;
 };
 
+class VLADMatchingTab : public FeatureMatchingTab {
+ public:
+  VLADMatchingTab(QWidget* parent, OptionManager* options);
+  void Run() override;
+};
+
 class SpatialMatchingTab : public FeatureMatchingTab {
  public:
   SpatialMatchingTab(QWidget* parent, OptionManager* options);
@@ -118,6 +124,40 @@ void FeatureMatchingTab::CreateGeneralOptions() {
                                 "max_num_matches");
   options_widget_->AddOptionBool(&options_->sift_matching->guided_matching,
                                  "guided_matching");
+  options_widget_->AddOptionBool(&options_->sift_matching->vote_and_verify,
+                                 "vote_and_verify");
+  options_widget_->AddOptionInt(
+      &options_->sift_matching->vote_and_verify_min_num_inliers,
+      "vote_and_verify_min_num_inliers",
+      0);
+  options_widget_->AddOptionInt(
+      &options_->sift_matching->coarse_num_features, "coarse_num_features", 0);
+  options_widget_->AddOptionInt(
+      &options_->sift_matching->coarse_min_num_inliers,
+      "coarse_min_num_inliers",
+      0);
+  options_widget_->AddOptionDouble(
+      &options_->sift_matching->prediction_max_error,
+      "prediction_max_error",
+      0);
+  options_widget_->AddOptionInt(
+      &options_->sift_matching->batch_size, "batch_size", 1);
+  options_widget_->AddOptionInt(
+      &options_->sift_matching->max_num_pairs_per_transaction,
+      "max_num_pairs_per_transaction",
+      1);
+  options_widget_->AddOptionDouble(
+      &options_->sift_matching->max_transaction_duration,
+      "max_transaction_duration",
+      0);
+  options_widget_->AddOptionBool(&options_->sift_matching->numa_affinity,
+                                 "numa_affinity");
+  options_widget_->AddOptionBool(&options_->sift_matching->gpu_tiled_matching,
+                                 "gpu_tiled_matching");
+  options_widget_->AddOptionDouble(
+      &options_->sift_matching->gpu_descriptor_cache_size,
+      "gpu_descriptor_cache_size [gigabytes]",
+      0);
   options_widget_->AddOptionDouble(
       &options_->two_view_geometry->ransac_options.max_error, "max_error");
   options_widget_->AddOptionDouble(
@@ -137,6 +177,12 @@ void FeatureMatchingTab::CreateGeneralOptions() {
       1,
       0.001,
       3);
+  options_widget_->AddOptionBool(
+      &options_->two_view_geometry->ransac_options.use_sprt, "use_sprt");
+  options_widget_->AddOptionBool(&options_->two_view_geometry->use_gpu,
+                                 "verification_use_gpu");
+  options_widget_->AddOptionText(&options_->two_view_geometry->gpu_index,
+                                 "verification_gpu_index");
   options_widget_->AddOptionInt(&options_->two_view_geometry->min_num_inliers,
                                 "min_num_inliers");
   options_widget_->AddOptionBool(&options_->two_view_geometry->multiple_models,
@@ -179,6 +225,8 @@ SequentialMatchingTab::SequentialMatchingTab(QWidget* parent,
                                 "overlap");
   options_widget_->AddOptionBool(
       &options_->sequential_matching->quadratic_overlap, "quadratic_overlap");
+  options_widget_->AddOptionBool(
+      &options_->sequential_matching->motion_prediction, "motion_prediction");
   options_widget_->AddOptionBool(&options_->sequential_matching->loop_detection,
                                  "loop_detection");
   options_widget_->AddOptionInt(
@@ -203,6 +251,9 @@ SequentialMatchingTab::SequentialMatchingTab(QWidget* parent,
       &options_->sequential_matching->loop_detection_max_num_features,
       "loop_detection_max_num_features",
       -1);
+  options_widget_->AddOptionBool(
+      &options_->sequential_matching->loop_detection_incremental,
+      "loop_detection_incremental");
   options_widget_->AddOptionFilePath(
       &options_->sequential_matching->vocab_tree_path, "vocab_tree_path");
 
@@ -243,6 +294,22 @@ VocabTreeMatchingTab::VocabTreeMatchingTab(QWidget* parent,
       &options_->vocab_tree_matching->max_num_features, "max_num_features", -1);
   options_widget_->AddOptionFilePath(
       &options_->vocab_tree_matching->vocab_tree_path, "vocab_tree_path");
+  options_widget_->AddOptionFilePath(
+      &options_->vocab_tree_matching->index_path, "index_path");
+  options_widget_->AddOptionText(
+      &options_->vocab_tree_matching->index_shard_paths, "index_shard_paths");
+  options_widget_->AddOptionDouble(
+      &options_->vocab_tree_matching->spatial_max_distance,
+      "spatial_max_distance",
+      -1);
+  options_widget_->AddOptionBool(&options_->vocab_tree_matching->spatial_union,
+                                 "spatial_union");
+  options_widget_->AddOptionInt(
+      &options_->vocab_tree_matching->spatial_max_num_neighbors,
+      "spatial_max_num_neighbors",
+      1);
+  options_widget_->AddOptionBool(
+      &options_->vocab_tree_matching->spatial_ignore_z, "spatial_ignore_z");
 
   CreateGeneralOptions();
 }
@@ -262,6 +329,34 @@ void VocabTreeMatchingTab::Run() {
   thread_control_widget_->StartThread("Matching...", true, std::move(matcher));
 }
 
+VLADMatchingTab::VLADMatchingTab(QWidget* parent, OptionManager* options)
+    : FeatureMatchingTab(parent, options) {
+  options_widget_->AddOptionInt(&options_->vlad_matching->num_images,
+                                "num_images");
+  options_widget_->AddOptionInt(
+      &options_->vlad_matching->num_clusters, "num_clusters", 2);
+  options_widget_->AddOptionInt(
+      &options_->vlad_matching->num_lists, "num_lists", -1);
+  options_widget_->AddOptionInt(
+      &options_->vlad_matching->num_probes, "num_probes", 1);
+  options_widget_->AddOptionInt(
+      &options_->vlad_matching->max_num_features, "max_num_features", -1);
+  options_widget_->AddOptionFilePath(&options_->vlad_matching->vocab_tree_path,
+                                     "vocab_tree_path");
+
+  CreateGeneralOptions();
+}
+
+void VLADMatchingTab::Run() {
+  options_widget_->WriteOptions();
+
+  auto matcher = CreateVLADFeatureMatcher(*options_->vlad_matching,
+                                          *options_->sift_matching,
+                                          *options_->two_view_geometry,
+                                          *options_->database_path);
+  thread_control_widget_->StartThread("Matching...", true, std::move(matcher));
+}
+
 SpatialMatchingTab::SpatialMatchingTab(QWidget* parent, OptionManager* options)
     : FeatureMatchingTab(parent, options) {
   options_widget_->AddOptionBool(&options_->spatial_matching->ignore_z,
@@ -316,6 +411,9 @@ CustomMatchingTab::CustomMatchingTab(QWidget* parent, OptionManager* options)
   options_widget_->AddOptionFilePath(&match_list_path_, "match_list_path");
   options_widget_->AddOptionInt(
       &options_->image_pairs_matching->block_size, "block_size", 2);
+  options_widget_->AddOptionBool(
+      &options_->image_pairs_matching->lazy_image_loading,
+      "lazy_image_loading");
 
   CreateGeneralOptions();
 }
@@ -332,6 +430,8 @@ void CustomMatchingTab::Run() {
   if (match_type_cb_->currentIndex() == 0) {
     ImagePairsMatchingOptions matcher_options;
     matcher_options.match_list_path = match_list_path_;
+    matcher_options.lazy_image_loading =
+        options_->image_pairs_matching->lazy_image_loading;
     matcher = CreateImagePairsFeatureMatcher(matcher_options,
                                              *options_->sift_matching,
                                              *options_->two_view_geometry,
@@ -370,6 +470,7 @@ FeatureMatchingWidget::FeatureMatchingWidget(QWidget* parent,
   tab_widget_->addTab(new SequentialMatchingTab(this, options),
                       tr("Sequential"));
   tab_widget_->addTab(new VocabTreeMatchingTab(this, options), tr("VocabTree"));
+  tab_widget_->addTab(new VLADMatchingTab(this, options), tr("VLAD"));
   tab_widget_->addTab(new SpatialMatchingTab(this, options), tr("Spatial"));
   tab_widget_->addTab(new TransitiveMatchingTab(this, options),
                       tr("Transitive"));
@@ -63,16 +63,16 @@ class ImageViewerWidget : public QWidget {
  private:
   static const double kZoomFactor;
 
-  ImageViewerGraphicsScene graphics_scene_;
-  QGraphicsView* graphics_view_;
-
  protected:
   void resizeEvent(QResizeEvent* event);
   void closeEvent(QCloseEvent* event);
-  void ZoomIn();
-  void ZoomOut();
+  virtual void ZoomIn();
+  virtual void ZoomOut();
   void Save();
 
+  ImageViewerGraphicsScene graphics_scene_;
+  QGraphicsView* graphics_view_;
+
   QGridLayout* grid_layout_;
   QHBoxLayout* button_layout_;
 };
@@ -437,7 +437,7 @@ void MainWindow::CreateActions() {
           &QAction::triggered,
           this,
           &MainWindow::Render,
-          Qt::BlockingQueuedConnection);
+          Qt::QueuedConnection);
 
   action_render_now_ = new QAction(tr("Render now"), this);
   render_options_widget_->action_render_now = action_render_now_;
@@ -610,6 +610,8 @@ void MainWindow::CreateControllers() {
     mapper_controller_->Wait();
   }
 
+  render_snapshot_timer_.Start();
+
   mapper_controller_ =
       std::make_unique<ControllerThread<IncrementalMapperController>>(
           std::make_shared<IncrementalMapperController>(
@@ -625,7 +627,7 @@ void MainWindow::CreateControllers() {
       });
   mapper_controller_->GetController()->AddCallback(
       IncrementalMapperController::NEXT_IMAGE_REG_CALLBACK, [this]() {
-        if (!mapper_controller_->IsStopped()) {
+        if (!mapper_controller_->IsStopped() && PublishRenderSnapshot()) {
           action_render_->trigger();
         }
       });
@@ -1145,17 +1147,21 @@ void MainWindow::DenseReconstruction() {
   }
 }
 
-void MainWindow::Render() {
+bool MainWindow::PublishRenderSnapshot() {
+  // Minimum time between two snapshots to bound the copying overhead.
+  constexpr double kMinRenderSnapshotIntervalSec = 0.5;
+
   if (reconstruction_manager_->Size() == 0) {
-    return;
+    return false;
   }
 
+  const size_t reconstruction_idx = reconstruction_manager_->Size() - 1;
+  const std::shared_ptr<Reconstruction> reconstruction =
+      reconstruction_manager_->Get(reconstruction_idx);
+
   int refresh_rate;
   if (options_.render->adapt_refresh_rate) {
-    const auto num_reg_images =
-        reconstruction_manager_->Get(SelectedReconstructionIdx())
-            ->NumRegImages();
-    refresh_rate = static_cast<int>(num_reg_images / 50 + 1);
+    refresh_rate = static_cast<int>(reconstruction->NumRegImages() / 50 + 1);
   } else {
     refresh_rate = options_.render->refresh_rate;
   }
@@ -1163,15 +1169,63 @@ void MainWindow::Render() {
   if (!render_options_widget_->automatic_update ||
       render_options_widget_->counter % refresh_rate != 0) {
     render_options_widget_->counter += 1;
-    return;
+    return false;
+  }
+
+  if (render_snapshot_timer_.ElapsedSeconds() < kMinRenderSnapshotIntervalSec) {
+    return false;
   }
 
   render_options_widget_->counter += 1;
+  render_snapshot_timer_.Restart();
+
+  auto render_snapshot = std::make_unique<RenderSnapshot>();
+  render_snapshot->reconstruction = ReconstructionSnapshot(reconstruction);
+  render_snapshot->reconstruction_idx = reconstruction_idx;
+  for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+    render_snapshot->num_images_points.emplace_back(
+        reconstruction_manager_->Get(i)->NumRegImages(),
+        reconstruction_manager_->Get(i)->NumPoints3D());
+  }
 
-  RenderNow();
+  {
+    std::lock_guard<std::mutex> lock(render_snapshot_mutex_);
+    std::swap(render_snapshot_, render_snapshot);
+  }
+
+  // Only trigger rendering if the previous snapshot was already rendered.
+  return render_snapshot == nullptr;
+}
+
+void MainWindow::Render() {
+  std::unique_ptr<RenderSnapshot> render_snapshot;
+  {
+    std::lock_guard<std::mutex> lock(render_snapshot_mutex_);
+    std::swap(render_snapshot_, render_snapshot);
+  }
+
+  if (render_snapshot == nullptr) {
+    return;
+  }
+
+  reconstruction_manager_widget_->Update(render_snapshot->num_images_points);
+
+  const size_t selected_idx =
+      reconstruction_manager_widget_->SelectedReconstructionIdx();
+  if (selected_idx == ReconstructionManagerWidget::kNewestReconstructionIdx ||
+      selected_idx == render_snapshot->reconstruction_idx) {
+    model_viewer_widget_->LoadSnapshot(
+        std::move(render_snapshot->reconstruction));
+  }
 }
 
 void MainWindow::RenderNow() {
+  // Pending snapshots are older than the current state.
+  {
+    std::lock_guard<std::mutex> lock(render_snapshot_mutex_);
+    render_snapshot_.reset();
+  }
+
   reconstruction_manager_widget_->Update();
   RenderSelectedReconstruction();
 }
@@ -1189,6 +1243,11 @@ void MainWindow::RenderSelectedReconstruction() {
 }
 
 void MainWindow::RenderClear() {
+  {
+    std::lock_guard<std::mutex> lock(render_snapshot_mutex_);
+    render_snapshot_.reset();
+  }
+
   reconstruction_manager_widget_->SelectReconstruction(
       ReconstructionManagerWidget::kNewestReconstructionIdx);
   model_viewer_widget_->ClearReconstruction();
@@ -1371,7 +1430,7 @@ void MainWindow::RenderToggle() {
   } else {
     render_options_widget_->automatic_update = true;
     render_options_widget_->counter = 0;
-    Render();
+    RenderNow();
     action_render_toggle_->setIcon(QIcon(":/media/render-enabled.png"));
     action_render_toggle_->setText(tr("Disable rendering"));
   }
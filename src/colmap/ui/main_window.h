@@ -49,11 +49,13 @@
 #include "colmap/ui/render_options_widget.h"
 #include "colmap/ui/undistortion_widget.h"
 #include "colmap/util/controller_thread.h"
+#include "colmap/util/timer.h"
 
 #include <QtCore>
 #include <QtGui>
 #include <QtWidgets>
 #include <memory>
+#include <mutex>
 
 namespace colmap {
 
@@ -108,6 +110,11 @@ class MainWindow : public QMainWindow {
   void BundleAdjustment();
   void DenseReconstruction();
 
+  // Publish a snapshot of the newest reconstruction for rendering at a
+  // bounded rate. Called by the mapper thread, which then continues without
+  // waiting for the snapshot to be rendered by `Render`.
+  bool PublishRenderSnapshot();
+
   void Render();
   void RenderNow();
   void RenderToggle();
@@ -233,6 +240,19 @@ class MainWindow : public QMainWindow {
 
   std::vector<QAction*> blocking_actions_;
 
+  struct RenderSnapshot {
+    ReconstructionSnapshot reconstruction;
+    size_t reconstruction_idx = 0;
+    // Number of registered images and points of all reconstructions.
+    std::vector<std::pair<size_t, size_t>> num_images_points;
+  };
+
+  // The latest published snapshot that was not yet rendered. Newer snapshots
+  // replace older ones, so that the mapper never waits for the GUI.
+  std::mutex render_snapshot_mutex_;
+  std::unique_ptr<RenderSnapshot> render_snapshot_;
+  Timer render_snapshot_timer_;
+
   // Necessary for OS X to avoid duplicate closeEvents.
   bool window_closed_;
 };
@@ -30,13 +30,69 @@
 #include "colmap/ui/match_matrix_widget.h"
 
 namespace colmap {
+namespace {
+
+uint64_t SpreadBits(const uint32_t value) {
+  uint64_t bits = value;
+  bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFull;
+  bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FFull;
+  bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0Full;
+  bits = (bits | (bits << 2)) & 0x3333333333333333ull;
+  bits = (bits | (bits << 1)) & 0x5555555555555555ull;
+  return bits;
+}
+
+uint32_t CompactBits(uint64_t bits) {
+  bits &= 0x5555555555555555ull;
+  bits = (bits | (bits >> 1)) & 0x3333333333333333ull;
+  bits = (bits | (bits >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+  bits = (bits | (bits >> 4)) & 0x00FF00FF00FF00FFull;
+  bits = (bits | (bits >> 8)) & 0x0000FFFF0000FFFFull;
+  bits = (bits | (bits >> 16)) & 0x00000000FFFFFFFFull;
+  return static_cast<uint32_t>(bits);
+}
+
+// Interleave the bits of the row and column, such that the cells of aligned,
+// square blocks with a power of two size are contiguous in the code order and
+// dropping the two lowest bits yields the code of the cell in the next level.
+uint64_t EncodeMortonCode(const uint32_t row, const uint32_t col) {
+  return SpreadBits(col) | (SpreadBits(row) << 1);
+}
+
+void DecodeMortonCode(const uint64_t code, uint32_t* row, uint32_t* col) {
+  *row = CompactBits(code >> 1);
+  *col = CompactBits(code);
+}
+
+uint64_t TileKey(const int level, const size_t tile_x, const size_t tile_y) {
+  return (static_cast<uint64_t>(level) << 56) |
+         (static_cast<uint64_t>(tile_y) << 28) | static_cast<uint64_t>(tile_x);
+}
+
+}  // namespace
+
+const size_t MatchMatrixWidget::kOverviewSize = 1024;
+const size_t MatchMatrixWidget::kTileSize = 256;
+const size_t MatchMatrixWidget::kMaxNumTiles = 256;
 
 MatchMatrixWidget::MatchMatrixWidget(QWidget* parent, OptionManager* options)
     : ImageViewerWidget(parent), options_(options) {
   setWindowTitle("Match matrix");
+
+  connect(graphics_view_->horizontalScrollBar(),
+          &QScrollBar::valueChanged,
+          this,
+          [this](const int) { UpdateTiles(); });
+  connect(graphics_view_->verticalScrollBar(),
+          &QScrollBar::valueChanged,
+          this,
+          [this](const int) { UpdateTiles(); });
 }
 
 void MatchMatrixWidget::Show() {
+  ClearTiles();
+  levels_.clear();
+
   Database database(*options_->database_path);
 
   if (database.NumImages() == 0) {
@@ -51,38 +107,231 @@ void MatchMatrixWidget::Show() {
               return image1.Name() < image2.Name();
             });
 
-  // Allocate the match matrix image.
-  Bitmap match_matrix;
-  match_matrix.Allocate(images.size(), images.size(), true);
-  match_matrix.Fill(BitmapColor<uint8_t>(255));
-
   // Map image identifiers to match matrix locations.
   std::unordered_map<image_t, size_t> image_id_to_idx;
   for (size_t idx = 0; idx < images.size(); ++idx) {
     image_id_to_idx.emplace(images[idx].ImageId(), idx);
   }
 
+  num_images_ = images.size();
+
   std::vector<std::pair<image_t, image_t>> image_pairs;
   std::vector<int> num_inliers;
   database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
 
-  // Fill the match matrix.
+  max_value_ = 0;
   if (!num_inliers.empty()) {
-    const double max_value =
+    max_value_ =
         std::log1p(*std::max_element(num_inliers.begin(), num_inliers.end()));
-    for (size_t i = 0; i < image_pairs.size(); ++i) {
-      const double value = std::log1p(num_inliers[i]) / max_value;
-      const size_t idx1 = image_id_to_idx.at(image_pairs[i].first);
-      const size_t idx2 = image_id_to_idx.at(image_pairs[i].second);
-      const BitmapColor<float> color(255 * JetColormap::Red(value),
-                                     255 * JetColormap::Green(value),
-                                     255 * JetColormap::Blue(value));
-      match_matrix.SetPixel(idx1, idx2, color.Cast<uint8_t>());
-      match_matrix.SetPixel(idx2, idx1, color.Cast<uint8_t>());
+  }
+
+  // Build the finest level with the symmetric cells of all image pairs.
+  std::vector<std::pair<uint64_t, int>> cells;
+  cells.reserve(2 * image_pairs.size());
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    const uint32_t idx1 = image_id_to_idx.at(image_pairs[i].first);
+    const uint32_t idx2 = image_id_to_idx.at(image_pairs[i].second);
+    cells.emplace_back(EncodeMortonCode(idx1, idx2), num_inliers[i]);
+    cells.emplace_back(EncodeMortonCode(idx2, idx1), num_inliers[i]);
+  }
+  std::sort(cells.begin(), cells.end());
+  levels_.push_back(std::move(cells));
+
+  // Build the coarser levels until the match matrix fits into the overview.
+  // Since the codes of the merged cells are contiguous, the levels remain
+  // sorted without sorting them again.
+  while (LevelSize(levels_.size() - 1) > kOverviewSize) {
+    std::vector<std::pair<uint64_t, int>> coarse_cells;
+    for (const auto& cell : levels_.back()) {
+      const uint64_t code = cell.first >> 2;
+      if (!coarse_cells.empty() && coarse_cells.back().first == code) {
+        coarse_cells.back().second =
+            std::max(coarse_cells.back().second, cell.second);
+      } else {
+        coarse_cells.emplace_back(code, cell.second);
+      }
     }
+    levels_.push_back(std::move(coarse_cells));
+  }
+
+  // Render the overview from the coarsest level.
+  const int overview_level = levels_.size() - 1;
+  const size_t overview_size = LevelSize(overview_level);
+  Bitmap overview;
+  overview.Allocate(overview_size, overview_size, true);
+  overview.Fill(BitmapColor<uint8_t>(255));
+  for (const auto& cell : levels_[overview_level]) {
+    uint32_t row;
+    uint32_t col;
+    DecodeMortonCode(cell.first, &row, &col);
+    overview.SetPixel(col, row, NumInliersToColor(cell.second));
   }
 
-  ShowBitmap(match_matrix);
+  QGraphicsPixmapItem* overview_item = graphics_scene_.ImagePixmapItem();
+  overview_item->setPixmap(QPixmap::fromImage(BitmapToQImageRGB(overview)));
+  overview_item->setScale(1 << overview_level);
+  graphics_scene_.setSceneRect(0, 0, num_images_, num_images_);
+
+  show();
+  graphics_view_->fitInView(graphics_scene_.sceneRect(), Qt::KeepAspectRatio);
+
+  raise();
+
+  UpdateTiles();
+}
+
+void MatchMatrixWidget::resizeEvent(QResizeEvent* event) {
+  ImageViewerWidget::resizeEvent(event);
+  UpdateTiles();
+}
+
+void MatchMatrixWidget::closeEvent(QCloseEvent* event) {
+  ImageViewerWidget::closeEvent(event);
+  ClearTiles();
+  levels_.clear();
+}
+
+void MatchMatrixWidget::ZoomIn() {
+  ImageViewerWidget::ZoomIn();
+  UpdateTiles();
+}
+
+void MatchMatrixWidget::ZoomOut() {
+  ImageViewerWidget::ZoomOut();
+  UpdateTiles();
+}
+
+size_t MatchMatrixWidget::LevelSize(const int level) const {
+  return (num_images_ + (size_t(1) << level) - 1) >> level;
+}
+
+BitmapColor<uint8_t> MatchMatrixWidget::NumInliersToColor(
+    const int num_inliers) const {
+  const double value =
+      max_value_ > 0 ? std::log1p(num_inliers) / max_value_ : 0;
+  const BitmapColor<float> color(255 * JetColormap::Red(value),
+                                 255 * JetColormap::Green(value),
+                                 255 * JetColormap::Blue(value));
+  return color.Cast<uint8_t>();
+}
+
+QPixmap MatchMatrixWidget::RenderTile(const int level,
+                                      const size_t tile_x,
+                                      const size_t tile_y) const {
+  const size_t level_size = LevelSize(level);
+  const size_t col_offset = tile_x * kTileSize;
+  const size_t row_offset = tile_y * kTileSize;
+
+  Bitmap tile;
+  tile.Allocate(std::min(kTileSize, level_size - col_offset),
+                std::min(kTileSize, level_size - row_offset),
+                true);
+  tile.Fill(BitmapColor<uint8_t>(255));
+
+  // The cells of the tile are contiguous in the Morton code order.
+  const auto& cells = levels_[level];
+  const uint64_t begin_code = EncodeMortonCode(row_offset, col_offset);
+  const uint64_t end_code = begin_code + kTileSize * kTileSize;
+  auto it = std::lower_bound(
+      cells.begin(),
+      cells.end(),
+      begin_code,
+      [](const std::pair<uint64_t, int>& cell, const uint64_t code) {
+        return cell.first < code;
+      });
+  for (; it != cells.end() && it->first < end_code; ++it) {
+    uint32_t row;
+    uint32_t col;
+    DecodeMortonCode(it->first, &row, &col);
+    tile.SetPixel(
+        col - col_offset, row - row_offset, NumInliersToColor(it->second));
+  }
+
+  return QPixmap::fromImage(BitmapToQImageRGB(tile));
+}
+
+void MatchMatrixWidget::UpdateTiles() {
+  if (levels_.size() <= 1) {
+    return;
+  }
+
+  for (auto& tile : tiles_) {
+    tile.second.item->setVisible(false);
+  }
+
+  const double view_scale = graphics_view_->transform().m11();
+  int level = levels_.size() - 1;
+  while (level > 0 && (1 << (level - 1)) * view_scale >= 1) {
+    level -= 1;
+  }
+
+  // The overview suffices if its pixels are not smaller than the view pixels.
+  if (level == static_cast<int>(levels_.size()) - 1) {
+    return;
+  }
+
+  const QRectF visible_rect =
+      graphics_view_->mapToScene(graphics_view_->viewport()->rect())
+          .boundingRect()
+          .intersected(graphics_scene_.sceneRect());
+  if (visible_rect.isEmpty()) {
+    return;
+  }
+
+  const size_t num_tiles = (LevelSize(level) + kTileSize - 1) / kTileSize;
+  const double tile_extent = static_cast<double>(kTileSize << level);
+  const auto ToTileIdx = [&](const double coord) {
+    return std::min(
+        static_cast<size_t>(std::max(0.0, coord) / tile_extent),
+        num_tiles - 1);
+  };
+
+  for (size_t tile_y = ToTileIdx(visible_rect.top());
+       tile_y <= ToTileIdx(visible_rect.bottom());
+       ++tile_y) {
+    for (size_t tile_x = ToTileIdx(visible_rect.left());
+         tile_x <= ToTileIdx(visible_rect.right());
+         ++tile_x) {
+      const uint64_t key = TileKey(level, tile_x, tile_y);
+      auto it = tiles_.find(key);
+      if (it == tiles_.end()) {
+        QGraphicsPixmapItem* item =
+            graphics_scene_.addPixmap(RenderTile(level, tile_x, tile_y));
+        item->setPos(tile_x * tile_extent, tile_y * tile_extent);
+        item->setScale(1 << level);
+        it = tiles_
+                 .emplace(key,
+                          TileItem{item,
+                                   tiles_lru_.insert(tiles_lru_.end(), key)})
+                 .first;
+      } else {
+        tiles_lru_.splice(tiles_lru_.end(), tiles_lru_, it->second.lru_it);
+      }
+      it->second.item->setVisible(true);
+    }
+  }
+
+  // Evict the least recently shown tiles, which are all hidden unless more
+  // tiles are visible than are kept.
+  while (tiles_.size() > kMaxNumTiles) {
+    const auto it = tiles_.find(tiles_lru_.front());
+    if (it->second.item->isVisible()) {
+      break;
+    }
+    graphics_scene_.removeItem(it->second.item);
+    delete it->second.item;
+    tiles_.erase(it);
+    tiles_lru_.pop_front();
+  }
+}
+
+void MatchMatrixWidget::ClearTiles() {
+  for (auto& tile : tiles_) {
+    graphics_scene_.removeItem(tile.second.item);
+    delete tile.second.item;
+  }
+  tiles_.clear();
+  tiles_lru_.clear();
 }
 
 }  // namespace colmap
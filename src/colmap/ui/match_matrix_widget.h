@@ -32,17 +32,65 @@
 #include "colmap/controllers/option_manager.h"
 #include "colmap/ui/image_viewer_widget.h"
 
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace colmap {
 
-// Widget to visualize match matrix.
+// Widget to visualize match matrix. The numbers of inliers of the image pairs
+// are stored in a sparse quadtree, whose levels halve the resolution and keep
+// the maximum of the finer cells. The coarsest level is shown as a dense
+// overview and tiles of the finer levels are only rendered for the visible
+// region when zooming in, so that match matrices of many images can be shown.
 class MatchMatrixWidget : public ImageViewerWidget {
  public:
   MatchMatrixWidget(QWidget* parent, OptionManager* options);
 
   void Show();
 
+ protected:
+  void resizeEvent(QResizeEvent* event) override;
+  void closeEvent(QCloseEvent* event) override;
+  void ZoomIn() override;
+  void ZoomOut() override;
+
  private:
+  // Maximum size of the overview in pixels.
+  static const size_t kOverviewSize;
+  // Size of the tiles in pixels, which must be a power of two.
+  static const size_t kTileSize;
+  // Maximum number of rendered tiles kept in the scene.
+  static const size_t kMaxNumTiles;
+
+  size_t LevelSize(int level) const;
+  BitmapColor<uint8_t> NumInliersToColor(int num_inliers) const;
+  QPixmap RenderTile(int level, size_t tile_x, size_t tile_y) const;
+
+  // Show the tiles of the finest level, whose pixels are not smaller than the
+  // pixels of the view, in the visible region.
+  void UpdateTiles();
+  void ClearTiles();
+
   OptionManager* options_;
+
+  size_t num_images_ = 0;
+  double max_value_ = 0;
+
+  // Non-empty cells of each level sorted by their Morton codes together with
+  // the maximum number of inliers in the cell. The first level has one cell
+  // per image pair and the last level is shown as the overview.
+  std::vector<std::vector<std::pair<uint64_t, int>>> levels_;
+
+  struct TileItem {
+    QGraphicsPixmapItem* item;
+    std::list<uint64_t>::iterator lru_it;
+  };
+
+  // Rendered tiles by their key with the least recently shown tile first.
+  std::unordered_map<uint64_t, TileItem> tiles_;
+  std::list<uint64_t> tiles_lru_;
 };
 
 }  // namespace colmap
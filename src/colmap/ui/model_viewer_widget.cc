@@ -31,6 +31,9 @@
 
 #include "colmap/ui/main_window.h"
 
+#include <algorithm>
+#include <cstring>
+
 #define SELECTION_BUFFER_IMAGE_IDX 0
 #define SELECTION_BUFFER_POINT_IDX 1
 
@@ -284,6 +287,7 @@ ModelViewerWidget::ModelViewerWidget(QWidget* parent, OptionManager* options)
       image_viewer_widget_(
           new DatabaseImageViewerWidget(parent, this, options)),
       movie_grabber_widget_(new MovieGrabberWidget(parent, this)),
+      point_data_reconstruction_(nullptr),
       mouse_is_pressed_(false),
       focus_distance_(kInitFocusDistance),
       selected_image_id_(kInvalidImageId),
@@ -367,19 +371,32 @@ void ModelViewerWidget::resizeGL(int width, int height) {
   UploadCoordinateGridData();
 }
 
+ReconstructionSnapshot::ReconstructionSnapshot(
+    std::shared_ptr<Reconstruction> reconstruction)
+    : reconstruction(std::move(reconstruction)) {
+  cameras = this->reconstruction->Cameras();
+  points3D = this->reconstruction->Points3D();
+  reg_image_ids = this->reconstruction->RegImageIds();
+  images.reserve(reg_image_ids.size());
+  for (const image_t image_id : reg_image_ids) {
+    images.emplace(image_id, this->reconstruction->Image(image_id));
+  }
+}
+
 void ModelViewerWidget::ReloadReconstruction() {
   if (reconstruction == nullptr) {
     return;
   }
 
-  cameras = reconstruction->Cameras();
-  points3D = reconstruction->Points3D();
-  reg_image_ids = reconstruction->RegImageIds();
+  LoadSnapshot(ReconstructionSnapshot(reconstruction));
+}
 
-  images.clear();
-  for (const image_t image_id : reg_image_ids) {
-    images[image_id] = reconstruction->Image(image_id);
-  }
+void ModelViewerWidget::LoadSnapshot(ReconstructionSnapshot&& snapshot) {
+  reconstruction = std::move(snapshot.reconstruction);
+  cameras = std::move(snapshot.cameras);
+  images = std::move(snapshot.images);
+  points3D = std::move(snapshot.points3D);
+  reg_image_ids = std::move(snapshot.reg_image_ids);
 
   statusbar_status_label->setText(
       QString().asprintf("%d Images - %d Points",
@@ -909,82 +926,102 @@ void ModelViewerWidget::UploadCoordinateGridData() {
 void ModelViewerWidget::UploadPointData(const bool selection_mode) {
   makeCurrent();
 
-  std::vector<PointPainter::Data> data;
+  point_painter_.SetMaxNumPoints(
+      static_cast<size_t>(options_->render->max_num_points));
+
+  // Start over for a different reconstruction or once many of the uploaded
+  // points are hidden, since hidden points keep their index.
+  const size_t num_hidden_points = std::count_if(
+      point_data_.begin(),
+      point_data_.end(),
+      [](const PointPainter::Data& point) { return point.a == 0; });
+  if (point_data_reconstruction_ != reconstruction ||
+      num_hidden_points > point_data_.size() / 4) {
+    point_data_.clear();
+    point_data_idxs_.clear();
+    point_data_reconstruction_ = reconstruction;
+  }
 
-  // Assume we want to display the majority of points
-  data.reserve(points3D.size());
+  const size_t num_prev_points = point_data_.size();
+  std::vector<bool> is_prev_point_uploaded(num_prev_points, false);
+  std::vector<size_t> changed_idxs;
 
   const size_t min_track_len =
       static_cast<size_t>(options_->render->min_track_len);
 
-  if (selected_image_id_ == kInvalidImageId &&
-      images.count(selected_image_id_) == 0) {
-    for (const auto& point3D : points3D) {
-      if (point3D.second.error <= options_->render->max_error &&
-          point3D.second.track.Length() >= min_track_len) {
-        PointPainter::Data painter_point;
-
-        painter_point.x = static_cast<float>(point3D.second.xyz(0));
-        painter_point.y = static_cast<float>(point3D.second.xyz(1));
-        painter_point.z = static_cast<float>(point3D.second.xyz(2));
-
-        Eigen::Vector4f color;
-        if (selection_mode) {
-          const size_t index = selection_buffer_.size();
-          selection_buffer_.push_back(
-              std::make_pair(point3D.first, SELECTION_BUFFER_POINT_IDX));
-          color = IndexToRGB(index);
-
-        } else if (point3D.first == selected_point3D_id_) {
-          color = kSelectedPointColor;
-        } else {
-          color = point_colormap_->ComputeColor(point3D.first, point3D.second);
-        }
+  const Image* selected_image = nullptr;
+  if (selected_image_id_ != kInvalidImageId ||
+      images.count(selected_image_id_) != 0) {
+    selected_image = &images[selected_image_id_];
+  }
 
-        painter_point.r = color(0);
-        painter_point.g = color(1);
-        painter_point.b = color(2);
-        painter_point.a = color(3);
+  for (const auto& point3D : points3D) {
+    const bool is_visible =
+        point3D.second.error <= options_->render->max_error &&
+        point3D.second.track.Length() >= min_track_len;
+    const auto idx_it = point_data_idxs_.find(point3D.first);
+    if (!is_visible && idx_it == point_data_idxs_.end()) {
+      continue;
+    }
 
-        data.push_back(painter_point);
+    PointPainter::Data painter_point;
+    if (is_visible) {
+      painter_point.x = static_cast<float>(point3D.second.xyz(0));
+      painter_point.y = static_cast<float>(point3D.second.xyz(1));
+      painter_point.z = static_cast<float>(point3D.second.xyz(2));
+
+      Eigen::Vector4f color;
+      if (selection_mode) {
+        const size_t index = selection_buffer_.size();
+        selection_buffer_.push_back(
+            std::make_pair(point3D.first, SELECTION_BUFFER_POINT_IDX));
+        color = IndexToRGB(index);
+      } else if (selected_image != nullptr &&
+                 selected_image->HasPoint3D(point3D.first)) {
+        color = kSelectedImagePlaneColor;
+      } else if (point3D.first == selected_point3D_id_) {
+        color = kSelectedPointColor;
+      } else {
+        color = point_colormap_->ComputeColor(point3D.first, point3D.second);
       }
-    }
-  } else {  // Image selected
-    const auto& selected_image = images[selected_image_id_];
-    for (const auto& point3D : points3D) {
-      if (point3D.second.error <= options_->render->max_error &&
-          point3D.second.track.Length() >= min_track_len) {
-        PointPainter::Data painter_point;
-
-        painter_point.x = static_cast<float>(point3D.second.xyz(0));
-        painter_point.y = static_cast<float>(point3D.second.xyz(1));
-        painter_point.z = static_cast<float>(point3D.second.xyz(2));
-
-        Eigen::Vector4f color;
-        if (selection_mode) {
-          const size_t index = selection_buffer_.size();
-          selection_buffer_.push_back(
-              std::make_pair(point3D.first, SELECTION_BUFFER_POINT_IDX));
-          color = IndexToRGB(index);
-        } else if (selected_image.HasPoint3D(point3D.first)) {
-          color = kSelectedImagePlaneColor;
-        } else if (point3D.first == selected_point3D_id_) {
-          color = kSelectedPointColor;
-        } else {
-          color = point_colormap_->ComputeColor(point3D.first, point3D.second);
-        }
 
-        painter_point.r = color(0);
-        painter_point.g = color(1);
-        painter_point.b = color(2);
-        painter_point.a = color(3);
+      painter_point.r = color(0);
+      painter_point.g = color(1);
+      painter_point.b = color(2);
+      painter_point.a = color(3);
+    } else {
+      painter_point = point_data_[idx_it->second];
+      painter_point.a = 0;
+    }
 
-        data.push_back(painter_point);
+    if (idx_it == point_data_idxs_.end()) {
+      point_data_idxs_.emplace(point3D.first, point_data_.size());
+      point_data_.push_back(painter_point);
+    } else {
+      const size_t idx = idx_it->second;
+      is_prev_point_uploaded[idx] = true;
+      if (std::memcmp(&point_data_[idx],
+                      &painter_point,
+                      sizeof(PointPainter::Data)) != 0) {
+        point_data_[idx] = painter_point;
+        changed_idxs.push_back(idx);
       }
     }
   }
 
-  point_painter_.Upload(data);
+  // Hide the points that were removed from the reconstruction.
+  for (size_t idx = 0; idx < num_prev_points; ++idx) {
+    if (!is_prev_point_uploaded[idx] && point_data_[idx].a != 0) {
+      point_data_[idx].a = 0;
+      changed_idxs.push_back(idx);
+    }
+  }
+
+  if (num_prev_points == 0) {
+    point_painter_.Upload(point_data_);
+  } else {
+    point_painter_.Update(point_data_, changed_idxs);
+  }
 }
 
 void ModelViewerWidget::UploadPointConnectionData() {
@@ -47,6 +47,21 @@
 
 namespace colmap {
 
+// Copy of the rendered parts of a reconstruction, which can be created by the
+// thread that modifies the reconstruction and then rendered by the GUI thread
+// without synchronizing with the modifying thread.
+struct ReconstructionSnapshot {
+  ReconstructionSnapshot() = default;
+  explicit ReconstructionSnapshot(
+      std::shared_ptr<Reconstruction> reconstruction);
+
+  std::shared_ptr<Reconstruction> reconstruction;
+  std::unordered_map<camera_t, Camera> cameras;
+  std::unordered_map<image_t, Image> images;
+  SlotMap<point3D_t, Point3D> points3D;
+  std::vector<image_t> reg_image_ids;
+};
+
 class ModelViewerWidget : public QOpenGLWidget,
                           protected QOpenGLFunctions_3_2_Core {
  public:
@@ -73,6 +88,8 @@ class ModelViewerWidget : public QOpenGLWidget,
   ModelViewerWidget(QWidget* parent, OptionManager* options);
 
   void ReloadReconstruction();
+  // Render the reconstruction of the snapshot, whose data is moved.
+  void LoadSnapshot(ReconstructionSnapshot&& snapshot);
   void ClearReconstruction();
 
   int GetProjectionType() const;
@@ -119,7 +136,7 @@ class ModelViewerWidget : public QOpenGLWidget,
   std::shared_ptr<Reconstruction> reconstruction;
   std::unordered_map<camera_t, Camera> cameras;
   std::unordered_map<image_t, Image> images;
-  std::unordered_map<point3D_t, Point3D> points3D;
+  SlotMap<point3D_t, Point3D> points3D;
   std::vector<image_t> reg_image_ids;
 
   QLabel* statusbar_status_label;
@@ -165,6 +182,13 @@ class ModelViewerWidget : public QOpenGLWidget,
   PointPainter point_painter_;
   LinePainter point_connection_painter_;
 
+  // The last uploaded points, where each 3D point keeps its index across
+  // uploads, so that only changed points must be re-uploaded. Removed or
+  // filtered points are hidden until the indices are compacted.
+  std::vector<PointPainter::Data> point_data_;
+  std::unordered_map<point3D_t, size_t> point_data_idxs_;
+  const Reconstruction* point_data_reconstruction_;
+
   LinePainter image_line_painter_;
   TrianglePainter image_triangle_painter_;
   LinePainter image_connection_painter_;
@@ -31,9 +31,127 @@
 
 #include "colmap/util/opengl_utils.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
 namespace colmap {
+namespace {
+
+// Maximum number of points in an octree leaf node.
+constexpr size_t kMaxNumPointsPerNode = 1 << 16;
+// Maximum depth of the octree, e.g., for many points at the same position.
+constexpr int kMaxOctreeDepth = 20;
+
+void ComputeBounds(const std::vector<PointPainter::Data>& data,
+                   const std::vector<uint32_t>::iterator begin,
+                   const std::vector<uint32_t>::iterator end,
+                   float min_bound[3],
+                   float max_bound[3]) {
+  for (int d = 0; d < 3; ++d) {
+    min_bound[d] = std::numeric_limits<float>::max();
+    max_bound[d] = std::numeric_limits<float>::lowest();
+  }
+  for (auto it = begin; it != end; ++it) {
+    const float* xyz = &data[*it].x;
+    for (int d = 0; d < 3; ++d) {
+      min_bound[d] = std::min(min_bound[d], xyz[d]);
+      max_bound[d] = std::max(max_bound[d], xyz[d]);
+    }
+  }
+}
+
+// Recursively splits the points into octants until the leaf nodes are small
+// enough. The points within a leaf are shuffled, such that any prefix of the
+// leaf is a uniform subsample of its points for the level of detail.
+void BuildOctree(const std::vector<PointPainter::Data>& data,
+                 const std::vector<uint32_t>::iterator begin,
+                 const std::vector<uint32_t>::iterator end,
+                 const std::vector<uint32_t>::iterator order_begin,
+                 const int depth,
+                 std::mt19937* prng,
+                 std::vector<std::array<float, 6>>* bounds,
+                 std::vector<std::pair<size_t, size_t>>* ranges) {
+  if (begin == end) {
+    return;
+  }
 
-PointPainter::PointPainter() : num_geoms_(0) {}
+  float min_bound[3];
+  float max_bound[3];
+  ComputeBounds(data, begin, end, min_bound, max_bound);
+
+  const size_t num_points = std::distance(begin, end);
+  if (num_points <= kMaxNumPointsPerNode || depth == kMaxOctreeDepth) {
+    std::shuffle(begin, end, *prng);
+    bounds->push_back({min_bound[0],
+                       min_bound[1],
+                       min_bound[2],
+                       max_bound[0],
+                       max_bound[1],
+                       max_bound[2]});
+    ranges->emplace_back(std::distance(order_begin, begin),
+                         std::distance(order_begin, end));
+    return;
+  }
+
+  // Partition the points into the eight octants around the center.
+  std::array<std::vector<uint32_t>::iterator, 9> octants;
+  octants[0] = begin;
+  octants[8] = end;
+  auto partition = [&data](const std::vector<uint32_t>::iterator first,
+                           const std::vector<uint32_t>::iterator last,
+                           const int d,
+                           const float center) {
+    return std::partition(first, last, [&](const uint32_t idx) {
+      return (&data[idx].x)[d] < center;
+    });
+  };
+  float center[3];
+  for (int d = 0; d < 3; ++d) {
+    center[d] = 0.5f * (min_bound[d] + max_bound[d]);
+  }
+  octants[4] = partition(octants[0], octants[8], 0, center[0]);
+  for (int i = 0; i < 8; i += 4) {
+    octants[i + 2] = partition(octants[i], octants[i + 4], 1, center[1]);
+  }
+  for (int i = 0; i < 8; i += 2) {
+    octants[i + 1] = partition(octants[i], octants[i + 2], 2, center[2]);
+  }
+
+  for (int i = 0; i < 8; ++i) {
+    BuildOctree(data,
+                octants[i],
+                octants[i + 1],
+                order_begin,
+                depth + 1,
+                prng,
+                bounds,
+                ranges);
+  }
+}
+
+bool IsInFrustum(const std::array<QVector4D, 6>& planes,
+                 const float min_bound[3],
+                 const float max_bound[3]) {
+  for (const QVector4D& plane : planes) {
+    // Test the corner of the box that is furthest along the plane normal.
+    const float x = plane.x() > 0 ? max_bound[0] : min_bound[0];
+    const float y = plane.y() > 0 ? max_bound[1] : min_bound[1];
+    const float z = plane.z() > 0 ? max_bound[2] : min_bound[2];
+    if (plane.x() * x + plane.y() * y + plane.z() * z + plane.w() < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+PointPainter::PointPainter()
+    : num_geoms_(0), capacity_(0), max_num_points_(0) {}
 
 PointPainter::~PointPainter() {
   vao_.destroy();
@@ -58,6 +176,11 @@ void PointPainter::Setup() {
   vao_.create();
   vbo_.create();
 
+  num_geoms_ = 0;
+  capacity_ = 0;
+  slots_.clear();
+  nodes_.clear();
+
 #if DEBUG
   glDebugLog();
 #endif
@@ -65,37 +188,113 @@ void PointPainter::Setup() {
 
 void PointPainter::Upload(const std::vector<PointPainter::Data>& data) {
   num_geoms_ = data.size();
+  slots_.clear();
+  nodes_.clear();
   if (num_geoms_ == 0) {
     return;
   }
 
-  vao_.bind();
-  vbo_.bind();
+  std::vector<uint32_t> order(num_geoms_);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 prng(0);
+  std::vector<std::array<float, 6>> bounds;
+  std::vector<std::pair<size_t, size_t>> ranges;
+  BuildOctree(data,
+              order.begin(),
+              order.end(),
+              order.begin(),
+              /*depth=*/0,
+              &prng,
+              &bounds,
+              &ranges);
 
-  // Upload data array to GPU
-  vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
-  vbo_.allocate(data.data(),
-                static_cast<int>(data.size() * sizeof(PointPainter::Data)));
+  nodes_.resize(ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    std::copy(bounds[i].begin(), bounds[i].begin() + 3, nodes_[i].min_bound);
+    std::copy(bounds[i].begin() + 3, bounds[i].end(), nodes_[i].max_bound);
+    nodes_[i].begin = ranges[i].first;
+    nodes_[i].end = ranges[i].second;
+  }
 
-  // in_position
-  shader_program_.enableAttributeArray("a_position");
-  shader_program_.setAttributeBuffer(
-      "a_position", GL_FLOAT, 0, 3, sizeof(PointPainter::Data));
+  slots_.resize(num_geoms_);
+  std::vector<PointPainter::Data> sorted_data(num_geoms_);
+  for (size_t slot = 0; slot < num_geoms_; ++slot) {
+    slots_[order[slot]] = static_cast<uint32_t>(slot);
+    sorted_data[slot] = data[order[slot]];
+  }
 
-  // in_color
-  shader_program_.enableAttributeArray("a_color");
-  shader_program_.setAttributeBuffer(
-      "a_color", GL_FLOAT, 3 * sizeof(GLfloat), 4, sizeof(PointPainter::Data));
+  // Leave room for points appended by subsequent updates.
+  Allocate(num_geoms_ + num_geoms_ / 2);
 
-  // Make sure they are not changed from the outside
+  vbo_.bind();
+  vbo_.write(0,
+             sorted_data.data(),
+             static_cast<int>(num_geoms_ * sizeof(PointPainter::Data)));
   vbo_.release();
-  vao_.release();
 
 #if DEBUG
   glDebugLog();
 #endif
 }
 
+void PointPainter::Update(const std::vector<PointPainter::Data>& data,
+                          const std::vector<size_t>& changed_idxs) {
+  // Rebuild the octree instead of degrading it with too many appended points.
+  const size_t num_octree_geoms = slots_.size();
+  if (num_octree_geoms == 0 || data.size() < num_geoms_ ||
+      data.size() > capacity_ ||
+      data.size() - num_octree_geoms > num_octree_geoms / 4) {
+    Upload(data);
+    return;
+  }
+
+  for (const size_t idx : changed_idxs) {
+    if (idx < num_octree_geoms) {
+      GrowNodeBounds(slots_[idx], data[idx]);
+    }
+  }
+
+  const size_t num_prev_geoms = num_geoms_;
+  num_geoms_ = data.size();
+
+  // Rewriting the entire buffer is faster than many scattered writes.
+  if (changed_idxs.size() > num_prev_geoms / 2) {
+    std::vector<PointPainter::Data> sorted_data(num_geoms_);
+    for (size_t idx = 0; idx < num_geoms_; ++idx) {
+      sorted_data[idx < num_octree_geoms ? slots_[idx] : idx] = data[idx];
+    }
+    vbo_.bind();
+    vbo_.write(0,
+               sorted_data.data(),
+               static_cast<int>(num_geoms_ * sizeof(PointPainter::Data)));
+    vbo_.release();
+    return;
+  }
+
+  std::vector<std::pair<size_t, size_t>> slot_idxs;
+  slot_idxs.reserve(changed_idxs.size() + num_geoms_ - num_prev_geoms);
+  for (const size_t idx : changed_idxs) {
+    if (idx < num_prev_geoms) {
+      slot_idxs.emplace_back(idx < num_octree_geoms ? slots_[idx] : idx, idx);
+    }
+  }
+
+  // Appended points are stored in order after the points in the octree.
+  for (size_t idx = num_prev_geoms; idx < num_geoms_; ++idx) {
+    slot_idxs.emplace_back(idx, idx);
+  }
+
+  WriteSlots(data, std::move(slot_idxs));
+
+#if DEBUG
+  glDebugLog();
+#endif
+}
+
+void PointPainter::SetMaxNumPoints(const size_t max_num_points) {
+  max_num_points_ = max_num_points;
+}
+
 void PointPainter::Render(const QMatrix4x4& pmv_matrix,
                           const float point_size) {
   if (num_geoms_ == 0) {
@@ -108,8 +307,63 @@ void PointPainter::Render(const QMatrix4x4& pmv_matrix,
   shader_program_.setUniformValue("u_pmv_matrix", pmv_matrix);
   shader_program_.setUniformValue("u_point_size", point_size);
 
+  // Clipping planes of the view frustum in world coordinates.
+  const std::array<QVector4D, 6> planes = {
+      pmv_matrix.row(3) + pmv_matrix.row(0),
+      pmv_matrix.row(3) - pmv_matrix.row(0),
+      pmv_matrix.row(3) + pmv_matrix.row(1),
+      pmv_matrix.row(3) - pmv_matrix.row(1),
+      pmv_matrix.row(3) + pmv_matrix.row(2),
+      pmv_matrix.row(3) - pmv_matrix.row(2),
+  };
+
+  std::vector<const Node*> visible_nodes;
+  size_t num_visible_geoms = 0;
+  for (const Node& node : nodes_) {
+    if (IsInFrustum(planes, node.min_bound, node.max_bound)) {
+      visible_nodes.push_back(&node);
+      num_visible_geoms += node.end - node.begin;
+    }
+  }
+
+  const size_t num_appended_geoms = num_geoms_ - slots_.size();
+  double lod_fraction = 1.0;
+  if (max_num_points_ > 0 &&
+      num_visible_geoms + num_appended_geoms > max_num_points_) {
+    lod_fraction = static_cast<double>(max_num_points_) /
+                   (num_visible_geoms + num_appended_geoms);
+  }
+
   QOpenGLFunctions* gl_funcs = QOpenGLContext::currentContext()->functions();
-  gl_funcs->glDrawArrays(GL_POINTS, 0, (GLsizei)num_geoms_);
+
+  // Draw a prefix of each visible node and merge adjacent fully drawn nodes.
+  size_t draw_begin = 0;
+  size_t draw_end = 0;
+  for (const Node* node : visible_nodes) {
+    const size_t num_node_geoms = node->end - node->begin;
+    const size_t num_draw_geoms = std::max<size_t>(
+        1, static_cast<size_t>(std::ceil(lod_fraction * num_node_geoms)));
+    if (node->begin != draw_end || num_draw_geoms != num_node_geoms) {
+      if (draw_end > draw_begin) {
+        gl_funcs->glDrawArrays(
+            GL_POINTS, (GLint)draw_begin, (GLsizei)(draw_end - draw_begin));
+      }
+      draw_begin = node->begin;
+    }
+    draw_end = node->begin + num_draw_geoms;
+  }
+  if (draw_end > draw_begin) {
+    gl_funcs->glDrawArrays(
+        GL_POINTS, (GLint)draw_begin, (GLsizei)(draw_end - draw_begin));
+  }
+
+  // Appended points are not part of the octree and always drawn.
+  if (num_appended_geoms > 0) {
+    const size_t num_draw_geoms = static_cast<size_t>(
+        std::ceil(lod_fraction * num_appended_geoms));
+    gl_funcs->glDrawArrays(
+        GL_POINTS, (GLint)slots_.size(), (GLsizei)num_draw_geoms);
+  }
 
   // Make sure the VAO is not changed from the outside
   vao_.release();
@@ -119,4 +373,78 @@ void PointPainter::Render(const QMatrix4x4& pmv_matrix,
 #endif
 }
 
+void PointPainter::Allocate(const size_t capacity) {
+  capacity_ = capacity;
+
+  vao_.bind();
+  vbo_.bind();
+
+  vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  vbo_.allocate(static_cast<int>(capacity_ * sizeof(PointPainter::Data)));
+
+  // in_position
+  shader_program_.enableAttributeArray("a_position");
+  shader_program_.setAttributeBuffer(
+      "a_position", GL_FLOAT, 0, 3, sizeof(PointPainter::Data));
+
+  // in_color
+  shader_program_.enableAttributeArray("a_color");
+  shader_program_.setAttributeBuffer(
+      "a_color", GL_FLOAT, 3 * sizeof(GLfloat), 4, sizeof(PointPainter::Data));
+
+  // Make sure they are not changed from the outside
+  vbo_.release();
+  vao_.release();
+}
+
+void PointPainter::WriteSlots(
+    const std::vector<PointPainter::Data>& data,
+    std::vector<std::pair<size_t, size_t>> slot_idxs) {
+  if (slot_idxs.empty()) {
+    return;
+  }
+
+  std::sort(slot_idxs.begin(), slot_idxs.end());
+
+  vbo_.bind();
+
+  // Write runs of consecutive slots at once.
+  std::vector<PointPainter::Data> run_data;
+  size_t run_begin = slot_idxs[0].first;
+  for (size_t i = 0; i <= slot_idxs.size(); ++i) {
+    if (i == slot_idxs.size() ||
+        slot_idxs[i].first != run_begin + run_data.size()) {
+      vbo_.write(
+          static_cast<int>(run_begin * sizeof(PointPainter::Data)),
+          run_data.data(),
+          static_cast<int>(run_data.size() * sizeof(PointPainter::Data)));
+      if (i == slot_idxs.size()) {
+        break;
+      }
+      run_data.clear();
+      run_begin = slot_idxs[i].first;
+    }
+    run_data.push_back(data[slot_idxs[i].second]);
+  }
+
+  vbo_.release();
+}
+
+void PointPainter::GrowNodeBounds(const size_t slot,
+                                  const PointPainter::Data& point) {
+  // Keep the bounds conservative for the frustum culling of moved points.
+  Node& node = *(std::upper_bound(nodes_.begin(),
+                                  nodes_.end(),
+                                  slot,
+                                  [](const size_t value, const Node& other) {
+                                    return value < other.begin;
+                                  }) -
+                 1);
+  const float* xyz = &point.x;
+  for (int d = 0; d < 3; ++d) {
+    node.min_bound[d] = std::min(node.min_bound[d], xyz[d]);
+    node.max_bound[d] = std::max(node.max_bound[d], xyz[d]);
+  }
+}
+
 }  // namespace colmap
@@ -34,6 +34,11 @@
 
 namespace colmap {
 
+// Renders points from a persistent GPU buffer. The points are arranged in an
+// octree, whose nodes are culled against the view frustum and drawn with a
+// level of detail that respects a maximum number of rendered points. Changed
+// and appended points can be uploaded incrementally without rebuilding the
+// octree or re-uploading unchanged points.
 class PointPainter {
  public:
   PointPainter();
@@ -55,15 +60,51 @@ class PointPainter {
   };
 
   void Setup();
+
+  // Upload all points and rebuild the octree. Points with zero alpha are not
+  // rendered, which allows to hide points without changing the indices of the
+  // other points for subsequent calls to `Update`.
   void Upload(const std::vector<PointPainter::Data>& data);
+
+  // Upload only the changed points, given by their indices into the data of
+  // the previous upload, and append the points beyond the previously uploaded
+  // points. Falls back to a full upload, if too many points were appended.
+  void Update(const std::vector<PointPainter::Data>& data,
+              const std::vector<size_t>& changed_idxs);
+
+  // The maximum number of rendered points, where a value of zero renders all
+  // points. If more points are visible, each visible octree node is thinned
+  // out uniformly.
+  void SetMaxNumPoints(size_t max_num_points);
+
   void Render(const QMatrix4x4& pmv_matrix, float point_size);
 
  private:
+  struct Node {
+    float min_bound[3];
+    float max_bound[3];
+    size_t begin;
+    size_t end;
+  };
+
+  void Allocate(size_t capacity);
+  void WriteSlots(const std::vector<PointPainter::Data>& data,
+                  std::vector<std::pair<size_t, size_t>> slot_idxs);
+  void GrowNodeBounds(size_t slot, const PointPainter::Data& point);
+
   QOpenGLShaderProgram shader_program_;
   QOpenGLVertexArrayObject vao_;
   QOpenGLBuffer vbo_;
 
+  // Buffer slot of the points in the octree, indexed by the point index. The
+  // points appended by `Update` follow the octree points in the buffer.
+  std::vector<uint32_t> slots_;
+  // Octree leaf nodes that partition the first slots_.size() buffer slots.
+  std::vector<Node> nodes_;
+
   size_t num_geoms_;
+  size_t capacity_;
+  size_t max_num_points_;
 };
 
 }  // namespace colmap
@@ -45,6 +45,18 @@ ReconstructionManagerWidget::ReconstructionManagerWidget(
 }
 
 void ReconstructionManagerWidget::Update() {
+  std::vector<std::pair<size_t, size_t>> num_images_points;
+  num_images_points.reserve(reconstruction_manager_->Size());
+  for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+    num_images_points.emplace_back(
+        reconstruction_manager_->Get(i)->NumRegImages(),
+        reconstruction_manager_->Get(i)->NumPoints3D());
+  }
+  Update(num_images_points);
+}
+
+void ReconstructionManagerWidget::Update(
+    const std::vector<std::pair<size_t, size_t>>& num_images_points) {
   if (view()->isVisible()) {
     return;
   }
@@ -58,12 +70,12 @@ void ReconstructionManagerWidget::Update() {
   addItem("Newest model");
 
   int max_width = 0;
-  for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
-    const QString item = QString().asprintf(
-        "Model %d (%d images, %d points)",
-        static_cast<int>(i + 1),
-        static_cast<int>(reconstruction_manager_->Get(i)->NumRegImages()),
-        static_cast<int>(reconstruction_manager_->Get(i)->NumPoints3D()));
+  for (size_t i = 0; i < num_images_points.size(); ++i) {
+    const QString item =
+        QString().asprintf("Model %d (%d images, %d points)",
+                           static_cast<int>(i + 1),
+                           static_cast<int>(num_images_points[i].first),
+                           static_cast<int>(num_images_points[i].second));
     QFontMetrics font_metrics(view()->font());
 #if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
     const auto width = font_metrics.horizontalAdvance(item);
@@ -76,10 +88,10 @@ void ReconstructionManagerWidget::Update() {
 
   view()->setMinimumWidth(max_width);
 
-  if (reconstruction_manager_->Size() == 0) {
+  if (num_images_points.empty()) {
     setCurrentIndex(0);
   } else {
-    const int max_idx = static_cast<int>(reconstruction_manager_->Size());
+    const int max_idx = static_cast<int>(num_images_points.size());
     if (prev_idx <= max_idx) {
       setCurrentIndex(prev_idx);
     } else {
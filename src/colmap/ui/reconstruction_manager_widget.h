@@ -44,6 +44,9 @@ class ReconstructionManagerWidget : public QComboBox {
       std::shared_ptr<const ReconstructionManager> reconstruction_manager);
 
   void Update();
+  // Update from the given number of registered images and points of each
+  // reconstruction instead of reading them from the reconstruction manager.
+  void Update(const std::vector<std::pair<size_t, size_t>>& num_images_points);
 
   size_t SelectedReconstructionIdx() const;
   void SelectReconstruction(size_t idx);
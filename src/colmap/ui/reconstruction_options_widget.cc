@@ -44,9 +44,23 @@ MapperGeneralOptionsWidget::MapperGeneralOptionsWidget(QWidget* parent,
   AddOptionInt(&options->mapper->num_threads, "num_threads", -1);
   AddOptionInt(&options->mapper->min_num_matches, "min_num_matches");
   AddOptionBool(&options->mapper->ignore_watermarks, "ignore_watermarks");
+  AddOptionBool(&options->mapper->lazy_load_points2D, "lazy_load_points2D");
+  AddOptionDouble(&options->mapper->lazy_points2D_cache_size,
+                  "lazy_points2D_cache_size [GB]");
+  AddOptionBool(&options->mapper->compact_points2D, "compact_points2D");
+  AddOptionBool(&options->mapper->precompute_tracks, "precompute_tracks");
   AddOptionDirPath(&options->mapper->snapshot_path, "snapshot_path");
   AddOptionInt(
       &options->mapper->snapshot_images_freq, "snapshot_images_freq", 0);
+  AddOptionDirPath(&options->mapper->checkpoint_path, "checkpoint_path");
+  AddOptionInt(
+      &options->mapper->checkpoint_images_freq, "checkpoint_images_freq", 1);
+  AddOptionFilePath(&options->mapper->ba_telemetry_path, "ba_telemetry_path");
+  AddOptionBool(&options->mapper->stream_new_images, "stream_new_images");
+  AddOptionDouble(&options->mapper->stream_poll_interval,
+                  "stream_poll_interval [s]");
+  AddOptionDouble(&options->mapper->stream_max_idle_time,
+                  "stream_max_idle_time [s]");
 }
 
 MapperTriangulationOptionsWidget::MapperTriangulationOptionsWidget(
@@ -64,6 +78,8 @@ MapperTriangulationOptionsWidget::MapperTriangulationOptionsWidget(
                   "re_max_angle_error [deg]");
   AddOptionDouble(&options->mapper->triangulation.re_min_ratio, "re_min_ratio");
   AddOptionInt(&options->mapper->triangulation.re_max_trials, "re_max_trials");
+  AddOptionDouble(&options->mapper->triangulation.re_min_pose_change,
+                  "re_min_pose_change [deg]");
   AddOptionDouble(&options->mapper->triangulation.complete_max_reproj_error,
                   "complete_max_reproj_error [px]");
   AddOptionInt(&options->mapper->triangulation.complete_max_transitivity,
@@ -83,6 +99,10 @@ MapperRegistrationOptionsWidget::MapperRegistrationOptionsWidget(
                "abs_pose_min_num_inliers");
   AddOptionDouble(&options->mapper->mapper.abs_pose_min_inlier_ratio,
                   "abs_pose_min_inlier_ratio");
+  AddOptionBool(&options->mapper->mapper.abs_pose_use_position_prior,
+                "abs_pose_use_position_prior");
+  AddOptionDouble(&options->mapper->mapper.abs_pose_position_prior_max_error,
+                  "abs_pose_position_prior_max_error");
   AddOptionInt(&options->mapper->mapper.max_reg_trials, "max_reg_trials", 1);
 }
 
@@ -92,6 +112,9 @@ MapperInitializationOptionsWidget::MapperInitializationOptionsWidget(
   AddOptionInt(&options->mapper->init_image_id1, "init_image_id1", -1);
   AddOptionInt(&options->mapper->init_image_id2, "init_image_id2", -1);
   AddOptionInt(&options->mapper->init_num_trials, "init_num_trials");
+  AddOptionInt(&options->mapper->num_parallel_models, "num_parallel_models");
+  AddOptionInt(&options->mapper->num_parallel_reg_images,
+               "num_parallel_reg_images");
   AddOptionInt(&options->mapper->mapper.init_min_num_inliers,
                "init_min_num_inliers");
   AddOptionDouble(&options->mapper->mapper.init_max_error, "init_max_error");
@@ -136,6 +159,11 @@ MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
   AddOptionInt(&options->mapper->ba_global_images_freq, "images_freq");
   AddOptionDouble(&options->mapper->ba_global_points_ratio, "points_ratio");
   AddOptionInt(&options->mapper->ba_global_points_freq, "points_freq");
+  AddOptionDouble(&options->mapper->ba_global_max_drift, "max_drift [px]");
+  AddOptionDouble(&options->mapper->ba_global_partial_max_images_ratio,
+                  "partial_max_images_ratio",
+                  0,
+                  1);
   AddOptionInt(&options->mapper->ba_global_max_num_iterations,
                "max_num_iterations");
   AddOptionInt(
@@ -146,6 +174,16 @@ MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
                   1,
                   1e-6,
                   6);
+  AddOptionBool(&options->mapper->ba_use_gpu, "use_gpu");
+  AddOptionText(&options->mapper->ba_gpu_index, "gpu_index");
+  AddOptionInt(&options->mapper->ba_min_num_images_gpu_solver,
+               "min_num_images_gpu_solver");
+  AddOptionBool(&options->mapper->ba_global_marginalize_constant_pose_points,
+                "marginalize_constant_pose_points");
+  AddOptionBool(&options->mapper->ba_global_reject_outliers_in_solver,
+                "reject_outliers_in_solver");
+  AddOptionBool(&options->mapper->ba_use_float_jacobians,
+                "use_float_jacobians");
 }
 
 MapperFilteringOptionsWidget::MapperFilteringOptionsWidget(
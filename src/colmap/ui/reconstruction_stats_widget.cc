@@ -58,15 +58,15 @@ void ReconstructionStatsWidget::Show(const Reconstruction& reconstruction) {
   AddStatistic("Registered images",
                QString::number(reconstruction.NumRegImages()));
   AddStatistic("Points", QString::number(reconstruction.NumPoints3D()));
-  AddStatistic("Observations",
-               QString::number(reconstruction.ComputeNumObservations()));
+  const ReconstructionStatistics statistics =
+      reconstruction.ComputeStatistics();
+  AddStatistic("Observations", QString::number(statistics.num_observations));
   AddStatistic("Mean track length",
-               QString::number(reconstruction.ComputeMeanTrackLength()));
-  AddStatistic(
-      "Mean observations per image",
-      QString::number(reconstruction.ComputeMeanObservationsPerRegImage()));
+               QString::number(statistics.mean_track_length));
+  AddStatistic("Mean observations per image",
+               QString::number(statistics.mean_observations_per_reg_image));
   AddStatistic("Mean reprojection error",
-               QString::number(reconstruction.ComputeMeanReprojectionError()));
+               QString::number(statistics.mean_reprojection_error));
 }
 
 void ReconstructionStatsWidget::AddStatistic(const QString& header,
@@ -47,6 +47,10 @@ struct RenderOptions {
   // Maximum error for a point to be rendered.
   double max_error = 2;
 
+  // Maximum number of rendered points. Larger models are rendered with a
+  // reduced level of detail to stay interactive. Zero renders all points.
+  int max_num_points = 10000000;
+
   // The rate of registered images at which to refresh.
   int refresh_rate = 1;
 
@@ -63,6 +67,7 @@ struct RenderOptions {
   inline bool Check() const {
     CHECK_OPTION_GE(min_track_len, 0);
     CHECK_OPTION_GE(max_error, 0);
+    CHECK_OPTION_GE(max_num_points, 0);
     CHECK_OPTION_GT(refresh_rate, 0);
     CHECK_OPTION(projection_type == ProjectionType::PERSPECTIVE ||
                  projection_type == ProjectionType::ORTHOGRAPHIC);
@@ -58,6 +58,11 @@ UndistortionWidget::UndistortionWidget(QWidget* parent,
   AddOptionDouble(&undistortion_options_.roi_min_y, "roi_min_y", 0.0, 1.0);
   AddOptionDouble(&undistortion_options_.roi_max_x, "roi_max_x", 0.0, 1.0);
   AddOptionDouble(&undistortion_options_.roi_max_y, "roi_max_y", 0.0, 1.0);
+  AddOptionInt(&undistortion_options_.jpeg_quality, "jpeg_quality", -1, 100);
+  AddOptionInt(&undistortion_options_.png_compression_level,
+               "png_compression_level",
+               -1,
+               9);
   AddOptionDirPath(&output_path_, "output_path");
 
   AddSpacer();
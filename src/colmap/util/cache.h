@@ -31,11 +31,18 @@
 
 #include "colmap/util/logging.h"
 
+#include <algorithm>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <unordered_map>
+#include <vector>
 
 namespace colmap {
 
@@ -68,6 +75,11 @@ class LRUCache {
   // Clear all elements from cache.
   virtual void Clear();
 
+  // Call func(key, value) for all elements from the most to the least recently
+  // used element without changing their order.
+  template <typename func_t>
+  void ForEach(const func_t& func) const;
+
  protected:
   typedef typename std::pair<key_t, value_t> key_value_pair_t;
   typedef typename std::list<key_value_pair_t>::iterator list_iterator_t;
@@ -117,6 +129,66 @@ class MemoryConstrainedLRUCache : public LRUCache<key_t, value_t> {
   std::unordered_map<key_t, size_t> elems_num_bytes_;
 };
 
+// Thread-safe Least Recently Used cache implementation. The elements are
+// distributed over independently locked shards by the hash of their key, such
+// that threads accessing different shards do not contend. Every shard evicts
+// its own least recently used element, once it exceeds its share of the
+// maximum number of elements. The values are computed outside of the lock and
+// concurrent misses for the same key compute the value only once, while the
+// other threads wait for it. The values are returned by copy, such that they
+// remain valid after eviction, e.g., by storing them as shared pointers.
+template <typename key_t, typename value_t>
+class ThreadSafeLRUCache {
+ public:
+  static constexpr size_t kDefaultNumShards = 16;
+
+  ThreadSafeLRUCache(size_t max_num_elems,
+                     const std::function<value_t(const key_t&)>& getter_func,
+                     size_t num_shards = kDefaultNumShards);
+
+  // The number of elements in the cache.
+  size_t NumElems() const;
+  size_t MaxNumElems() const;
+  size_t NumShards() const;
+
+  // Check whether the element with the given key exists.
+  bool Exists(const key_t& key) const;
+
+  // Get the value of an element either from the cache or compute the new value.
+  value_t Get(const key_t& key);
+
+  // Manually set the value of an element.
+  void Set(const key_t& key, value_t value);
+
+  // Clear all elements from cache. Values that are currently computed are
+  // still inserted once they are computed.
+  void Clear();
+
+  // Call func(key, value) for all cached elements while their shard is locked,
+  // e.g., to sum up the memory of the values.
+  template <typename func_t>
+  void ForEach(const func_t& func) const;
+
+ private:
+  struct Shard {
+    Shard(size_t max_num_elems,
+          const std::function<value_t(const key_t&)>& getter_func)
+        : cache(max_num_elems, getter_func) {}
+    mutable std::mutex mutex;
+    // The values are always set explicitly, such that the getter of the
+    // shard's cache is never called.
+    LRUCache<key_t, value_t> cache;
+    // The values that are currently computed by some thread.
+    std::unordered_map<key_t, std::shared_future<value_t>> pending;
+  };
+
+  Shard& GetShard(const key_t& key) const;
+
+  const size_t max_num_elems_;
+  const std::function<value_t(const key_t&)> getter_func_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -192,6 +264,14 @@ void LRUCache<key_t, value_t>::Clear() {
   elems_map_.clear();
 }
 
+template <typename key_t, typename value_t>
+template <typename func_t>
+void LRUCache<key_t, value_t>::ForEach(const func_t& func) const {
+  for (const auto& elem : elems_list_) {
+    func(elem.first, elem.second);
+  }
+}
+
 template <typename key_t, typename value_t>
 MemoryConstrainedLRUCache<key_t, value_t>::MemoryConstrainedLRUCache(
     const size_t max_num_bytes,
@@ -266,4 +346,120 @@ void MemoryConstrainedLRUCache<key_t, value_t>::Clear() {
   elems_num_bytes_.clear();
 }
 
+template <typename key_t, typename value_t>
+ThreadSafeLRUCache<key_t, value_t>::ThreadSafeLRUCache(
+    const size_t max_num_elems,
+    const std::function<value_t(const key_t&)>& getter_func,
+    const size_t num_shards)
+    : max_num_elems_(max_num_elems), getter_func_(getter_func) {
+  THROW_CHECK(getter_func);
+  THROW_CHECK_GT(max_num_elems, 0);
+  THROW_CHECK_GT(num_shards, 0);
+  const size_t num_eff_shards = std::min(num_shards, max_num_elems);
+  const size_t max_num_shard_elems =
+      (max_num_elems + num_eff_shards - 1) / num_eff_shards;
+  const auto shard_getter_func = [](const key_t&) -> value_t {
+    throw std::logic_error("Value not cached in shard");
+  };
+  shards_.reserve(num_eff_shards);
+  for (size_t i = 0; i < num_eff_shards; ++i) {
+    shards_.push_back(
+        std::make_unique<Shard>(max_num_shard_elems, shard_getter_func));
+  }
+}
+
+template <typename key_t, typename value_t>
+size_t ThreadSafeLRUCache<key_t, value_t>::NumElems() const {
+  size_t num_elems = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    num_elems += shard->cache.NumElems();
+  }
+  return num_elems;
+}
+
+template <typename key_t, typename value_t>
+size_t ThreadSafeLRUCache<key_t, value_t>::MaxNumElems() const {
+  return max_num_elems_;
+}
+
+template <typename key_t, typename value_t>
+size_t ThreadSafeLRUCache<key_t, value_t>::NumShards() const {
+  return shards_.size();
+}
+
+template <typename key_t, typename value_t>
+bool ThreadSafeLRUCache<key_t, value_t>::Exists(const key_t& key) const {
+  const Shard& shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.cache.Exists(key);
+}
+
+template <typename key_t, typename value_t>
+value_t ThreadSafeLRUCache<key_t, value_t>::Get(const key_t& key) {
+  Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  if (shard.cache.Exists(key)) {
+    return shard.cache.Get(key);
+  }
+
+  // Another thread is already computing the value, so wait for it.
+  const auto pending_it = shard.pending.find(key);
+  if (pending_it != shard.pending.end()) {
+    const std::shared_future<value_t> pending_value = pending_it->second;
+    lock.unlock();
+    return pending_value.get();
+  }
+
+  std::promise<value_t> promise;
+  shard.pending.emplace(key, promise.get_future().share());
+  lock.unlock();
+
+  std::optional<value_t> value;
+  try {
+    value.emplace(getter_func_(key));
+  } catch (...) {
+    lock.lock();
+    promise.set_exception(std::current_exception());
+    shard.pending.erase(key);
+    throw;
+  }
+
+  lock.lock();
+  shard.cache.Set(key, *value);
+  promise.set_value(*value);
+  shard.pending.erase(key);
+  return std::move(*value);
+}
+
+template <typename key_t, typename value_t>
+void ThreadSafeLRUCache<key_t, value_t>::Set(const key_t& key, value_t value) {
+  Shard& shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.cache.Set(key, std::move(value));
+}
+
+template <typename key_t, typename value_t>
+void ThreadSafeLRUCache<key_t, value_t>::Clear() {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->cache.Clear();
+  }
+}
+
+template <typename key_t, typename value_t>
+template <typename func_t>
+void ThreadSafeLRUCache<key_t, value_t>::ForEach(const func_t& func) const {
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->cache.ForEach(func);
+  }
+}
+
+template <typename key_t, typename value_t>
+typename ThreadSafeLRUCache<key_t, value_t>::Shard&
+ThreadSafeLRUCache<key_t, value_t>::GetShard(const key_t& key) const {
+  return *shards_[std::hash<key_t>{}(key) % shards_.size()];
+}
+
 }  // namespace colmap
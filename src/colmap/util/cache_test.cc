@@ -29,6 +29,11 @@
 
 #include "colmap/util/cache.h"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -165,6 +170,18 @@ TEST(LRUCache, Clear) {
   EXPECT_TRUE(cache.Exists(0));
 }
 
+TEST(LRUCache, ForEach) {
+  LRUCache<int, int> cache(5, [](const int key) { return 2 * key; });
+  for (int i = 0; i < 3; ++i) {
+    cache.Get(i);
+  }
+  std::vector<std::pair<int, int>> elems;
+  cache.ForEach([&elems](const int key, const int value) {
+    elems.emplace_back(key, value);
+  });
+  EXPECT_EQ(elems, (std::vector<std::pair<int, int>>{{2, 4}, {1, 2}, {0, 0}}));
+}
+
 struct SizedElem {
   explicit SizedElem(const size_t num_bytes_) : num_bytes(num_bytes_) {}
   size_t NumBytes() const { return num_bytes; }
@@ -270,5 +287,122 @@ TEST(MemoryConstrainedLRUCache, UpdateNumBytes) {
   EXPECT_EQ(cache.NumBytes(), 2);
 }
 
+TEST(ThreadSafeLRUCache, Empty) {
+  ThreadSafeLRUCache<int, int> cache(5, [](const int key) { return key; });
+  EXPECT_EQ(cache.NumElems(), 0);
+  EXPECT_EQ(cache.MaxNumElems(), 5);
+  EXPECT_EQ(cache.NumShards(), 5);
+}
+
+TEST(ThreadSafeLRUCache, Get) {
+  ThreadSafeLRUCache<int, int> cache(
+      5, [](const int key) { return key; }, /*num_shards=*/1);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(cache.Get(i), i);
+    EXPECT_EQ(cache.NumElems(), i + 1);
+    EXPECT_TRUE(cache.Exists(i));
+  }
+
+  EXPECT_EQ(cache.Get(0), 0);
+  EXPECT_EQ(cache.Get(5), 5);
+  EXPECT_EQ(cache.NumElems(), 5);
+  EXPECT_TRUE(cache.Exists(0));
+  EXPECT_FALSE(cache.Exists(1));
+  EXPECT_TRUE(cache.Exists(5));
+}
+
+TEST(ThreadSafeLRUCache, Shards) {
+  ThreadSafeLRUCache<int, int> cache(
+      8, [](const int key) { return 2 * key; }, /*num_shards=*/4);
+  EXPECT_EQ(cache.NumShards(), 4);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(cache.Get(i), 2 * i);
+  }
+  EXPECT_EQ(cache.NumElems(), 8);
+  for (int i = 92; i < 100; ++i) {
+    EXPECT_TRUE(cache.Exists(i));
+  }
+}
+
+TEST(ThreadSafeLRUCache, Set) {
+  ThreadSafeLRUCache<int, int> cache(5, [](const int key) { return key; });
+  cache.Set(0, 10);
+  EXPECT_EQ(cache.NumElems(), 1);
+  EXPECT_EQ(cache.Get(0), 10);
+  cache.Set(0, 20);
+  EXPECT_EQ(cache.NumElems(), 1);
+  EXPECT_EQ(cache.Get(0), 20);
+}
+
+TEST(ThreadSafeLRUCache, Clear) {
+  ThreadSafeLRUCache<int, int> cache(5, [](const int key) { return key; });
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(cache.Get(i), i);
+  }
+  cache.Clear();
+  EXPECT_EQ(cache.NumElems(), 0);
+  EXPECT_FALSE(cache.Exists(0));
+  EXPECT_EQ(cache.Get(0), 0);
+  EXPECT_EQ(cache.NumElems(), 1);
+}
+
+TEST(ThreadSafeLRUCache, ForEach) {
+  ThreadSafeLRUCache<int, int> cache(10, [](const int key) { return key; });
+  int sum = 0;
+  for (int i = 0; i < 5; ++i) {
+    sum += cache.Get(i);
+  }
+  int num_elems = 0;
+  int value_sum = 0;
+  cache.ForEach([&](const int key, const int value) {
+    EXPECT_EQ(key, value);
+    num_elems += 1;
+    value_sum += value;
+  });
+  EXPECT_EQ(num_elems, 5);
+  EXPECT_EQ(value_sum, sum);
+}
+
+TEST(ThreadSafeLRUCache, GetThrows) {
+  int num_calls = 0;
+  ThreadSafeLRUCache<int, int> cache(5, [&num_calls](const int key) {
+    num_calls += 1;
+    if (num_calls == 1) {
+      throw std::runtime_error("Failed");
+    }
+    return key;
+  });
+  EXPECT_THROW(cache.Get(1), std::runtime_error);
+  EXPECT_FALSE(cache.Exists(1));
+  EXPECT_EQ(cache.Get(1), 1);
+  EXPECT_EQ(num_calls, 2);
+}
+
+TEST(ThreadSafeLRUCache, ConcurrentMissesComputeOnce) {
+  constexpr int kNumThreads = 16;
+  constexpr int kNumKeys = 4;
+  std::atomic<int> num_calls(0);
+  ThreadSafeLRUCache<int, int> cache(kNumKeys, [&num_calls](const int key) {
+    num_calls += 1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return key;
+  });
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&cache, i]() {
+      for (int key = 0; key < kNumKeys; ++key) {
+        EXPECT_EQ(cache.Get((key + i) % kNumKeys), (key + i) % kNumKeys);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(num_calls, kNumKeys);
+  EXPECT_EQ(cache.NumElems(), kNumKeys);
+}
+
 }  // namespace
 }  // namespace colmap
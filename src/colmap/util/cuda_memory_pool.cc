@@ -0,0 +1,207 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/cuda_memory_pool.h"
+
+#include "colmap/util/cudacc.h"
+#include "colmap/util/logging.h"
+
+namespace colmap {
+namespace {
+
+// Size classes of pitched allocations.
+const size_t kPitchedWidthGranularity = 512;
+const size_t kPitchedHeightGranularity = 64;
+
+size_t RoundUp(const size_t value, const size_t granularity) {
+  return (value + granularity - 1) / granularity * granularity;
+}
+
+int GetCurrentDevice() {
+  int device = 0;
+  CUDA_SAFE_CALL(cudaGetDevice(&device));
+  return device;
+}
+
+}  // namespace
+
+CudaMemoryPool& CudaMemoryPool::Get() {
+  // Intentionally leaked, since the CUDA runtime may already be shut down when
+  // static objects are destroyed at exit. The driver frees all device memory
+  // of the process at exit anyway.
+  static CudaMemoryPool* pool = new CudaMemoryPool();
+  return *pool;
+}
+
+std::shared_ptr<void> CudaMemoryPool::AllocatePitched(
+    const size_t width_in_bytes, const size_t height, size_t* pitch) {
+  THROW_CHECK_NOTNULL(pitch);
+
+  const int device = GetCurrentDevice();
+  const size_t block_width = RoundUp(width_in_bytes, kPitchedWidthGranularity);
+  const size_t block_height = RoundUp(height, kPitchedHeightGranularity);
+  const BlockKey key(device, 0, 0, 0, 0, 0, block_width, block_height, 0);
+
+  Block block;
+  if (!PopBlock(key, &block)) {
+    cudaError_t error =
+        cudaMallocPitch(&block.ptr, &block.pitch, block_width, block_height);
+    if (error == cudaErrorMemoryAllocation) {
+      // Reset the error and retry after releasing the cached blocks.
+      cudaGetLastError();
+      Clear();
+      error =
+          cudaMallocPitch(&block.ptr, &block.pitch, block_width, block_height);
+    }
+    CUDA_SAFE_CALL(error);
+    block.num_bytes = block.pitch * block_height;
+  }
+
+  *pitch = block.pitch;
+  return std::shared_ptr<void>(
+      block.ptr, [key, block](void*) { Get().PushBlock(key, block); });
+}
+
+std::shared_ptr<cudaArray> CudaMemoryPool::AllocateLayeredArray(
+    const cudaChannelFormatDesc& format,
+    const size_t width,
+    const size_t height,
+    const size_t depth) {
+  const int device = GetCurrentDevice();
+  const BlockKey key(device,
+                     static_cast<int>(format.f),
+                     format.x,
+                     format.y,
+                     format.z,
+                     format.w,
+                     width,
+                     height,
+                     depth);
+
+  Block block;
+  if (!PopBlock(key, &block)) {
+    const cudaExtent extent = make_cudaExtent(width, height, depth);
+    cudaError_t error =
+        cudaMalloc3DArray(&block.array, &format, extent, cudaArrayLayered);
+    if (error == cudaErrorMemoryAllocation) {
+      cudaGetLastError();
+      Clear();
+      error =
+          cudaMalloc3DArray(&block.array, &format, extent, cudaArrayLayered);
+    }
+    CUDA_SAFE_CALL(error);
+    const size_t element_num_bytes =
+        (format.x + format.y + format.z + format.w) / 8;
+    block.num_bytes = element_num_bytes * width * height * depth;
+  }
+
+  return std::shared_ptr<cudaArray>(
+      block.array, [key, block](cudaArray*) { Get().PushBlock(key, block); });
+}
+
+void CudaMemoryPool::SetMaxCachedBytes(const size_t max_cached_bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_cached_bytes_ = max_cached_bytes;
+  }
+  Clear();
+}
+
+size_t CudaMemoryPool::MaxCachedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return max_cached_bytes_;
+}
+
+size_t CudaMemoryPool::NumCachedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num_cached_bytes = 0;
+  for (const auto& device_num_bytes : num_cached_bytes_) {
+    num_cached_bytes += device_num_bytes.second;
+  }
+  return num_cached_bytes;
+}
+
+void CudaMemoryPool::Clear() {
+  std::map<BlockKey, std::vector<Block>> blocks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks.swap(blocks_);
+    num_cached_bytes_.clear();
+  }
+  for (const auto& key_blocks : blocks) {
+    for (const auto& block : key_blocks.second) {
+      FreeBlock(std::get<0>(key_blocks.first), block);
+    }
+  }
+}
+
+bool CudaMemoryPool::PopBlock(const BlockKey& key, Block* block) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = blocks_.find(key);
+  if (it == blocks_.end()) {
+    return false;
+  }
+  *block = it->second.back();
+  it->second.pop_back();
+  if (it->second.empty()) {
+    blocks_.erase(it);
+  }
+  num_cached_bytes_[std::get<0>(key)] -= block->num_bytes;
+  return true;
+}
+
+void CudaMemoryPool::PushBlock(const BlockKey& key, const Block& block) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t& num_cached_bytes = num_cached_bytes_[std::get<0>(key)];
+    if (num_cached_bytes + block.num_bytes <= max_cached_bytes_) {
+      num_cached_bytes += block.num_bytes;
+      blocks_[key].push_back(block);
+      return;
+    }
+  }
+  FreeBlock(std::get<0>(key), block);
+}
+
+void CudaMemoryPool::FreeBlock(const int device, const Block& block) {
+  const int current_device = GetCurrentDevice();
+  if (device != current_device) {
+    CUDA_SAFE_CALL(cudaSetDevice(device));
+  }
+  if (block.array != nullptr) {
+    CUDA_SAFE_CALL(cudaFreeArray(block.array));
+  } else {
+    CUDA_SAFE_CALL(cudaFree(block.ptr));
+  }
+  if (device != current_device) {
+    CUDA_SAFE_CALL(cudaSetDevice(current_device));
+  }
+}
+
+}  // namespace colmap
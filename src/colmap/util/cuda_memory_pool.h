@@ -0,0 +1,115 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+namespace colmap {
+
+// Process-wide pool of CUDA device memory. Released allocations are kept in
+// the pool and handed out again to later allocations of the same size class
+// on the same device, which avoids cudaMalloc/cudaFree calls that synchronize
+// the device and fragment its memory. Allocations are returned to the pool
+// when the last owner of the returned shared pointer releases it.
+//
+// Pitched allocations are rounded up to size classes, so that similarly sized
+// matrices share cached blocks. Arrays are only reused for identical formats
+// and extents, because their extent determines the texture addressing.
+//
+// Cached blocks are handed out without synchronization, which is safe as long
+// as all work is issued on the legacy default stream, e.g., in PatchMatch.
+class CudaMemoryPool {
+ public:
+  static const size_t kDefaultMaxCachedBytes = 2ull << 30;
+
+  // The pool shared by all threads of the process.
+  static CudaMemoryPool& Get();
+
+  // Allocate a pitched block of height rows with at least width_in_bytes
+  // bytes per row on the current device, as in cudaMallocPitch.
+  std::shared_ptr<void> AllocatePitched(size_t width_in_bytes,
+                                        size_t height,
+                                        size_t* pitch);
+
+  // Allocate a layered array on the current device, as in cudaMalloc3DArray
+  // with the cudaArrayLayered flag.
+  std::shared_ptr<cudaArray> AllocateLayeredArray(
+      const cudaChannelFormatDesc& format,
+      size_t width,
+      size_t height,
+      size_t depth);
+
+  // Maximum number of bytes cached per device. Released blocks beyond this
+  // limit are freed immediately.
+  void SetMaxCachedBytes(size_t max_cached_bytes);
+  size_t MaxCachedBytes() const;
+
+  // Number of bytes currently cached on all devices.
+  size_t NumCachedBytes() const;
+
+  // Free all cached blocks.
+  void Clear();
+
+ private:
+  CudaMemoryPool() = default;
+
+  // Device, channel format, width, height, and depth of a cached block. For
+  // pitched blocks, the format is zero-initialized and the width is in bytes.
+  typedef std::tuple<int, int, int, int, int, int, size_t, size_t, size_t>
+      BlockKey;
+
+  struct Block {
+    void* ptr = nullptr;
+    cudaArray_t array = nullptr;
+    size_t pitch = 0;
+    size_t num_bytes = 0;
+  };
+
+  // Pop a cached block or return false, if there is none.
+  bool PopBlock(const BlockKey& key, Block* block);
+  // Cache the block or free it, if the cache of the device is full.
+  void PushBlock(const BlockKey& key, const Block& block);
+
+  static void FreeBlock(int device, const Block& block);
+
+  mutable std::mutex mutex_;
+  size_t max_cached_bytes_ = kDefaultMaxCachedBytes;
+  std::map<int, size_t> num_cached_bytes_;
+  std::map<BlockKey, std::vector<Block>> blocks_;
+};
+
+}  // namespace colmap
@@ -29,7 +29,164 @@
 
 #include "colmap/util/logging.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace colmap {
+namespace {
+
+#if defined(GLOG_VERSION_MAJOR) && \
+    (GLOG_VERSION_MAJOR > 0 || GLOG_VERSION_MINOR >= 7)
+using LogTimestamp = std::chrono::system_clock::time_point;
+#define COLMAP_LOG_TIMESTAMP_ARG const LogTimestamp&
+#else
+using LogTimestamp = time_t;
+#define COLMAP_LOG_TIMESTAMP_ARG LogTimestamp
+#endif
+
+#if defined(GLOG_VERSION_MAJOR) && \
+    (GLOG_VERSION_MAJOR > 0 || GLOG_VERSION_MINOR >= 6)
+using LogMessageLength = size_t;
+#else
+using LogMessageLength = int;
+#endif
+
+class AsyncLogger : public google::base::Logger {
+ public:
+  AsyncLogger(google::base::Logger* logger,
+              const double flush_interval,
+              const size_t max_buffer_size)
+      : logger_(logger),
+        flush_interval_(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::duration<double>(flush_interval))),
+        max_buffer_size_(max_buffer_size),
+        thread_(&AsyncLogger::Run, this) {}
+
+  // The logger is deleted by glog on shutdown, whereas the wrapped logger is
+  // owned by glog and must not be deleted.
+  ~AsyncLogger() override { Stop(); }
+
+  void Write(bool force_flush,
+             COLMAP_LOG_TIMESTAMP_ARG timestamp,
+             const char* message,
+             LogMessageLength message_len) override {
+    if (!force_flush) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      buffer_full_condition_.wait(lock, [this]() {
+        return stopped_ || buffer_size_ < max_buffer_size_;
+      });
+      if (!stopped_) {
+        buffer_.push_back({timestamp, std::string(message, message_len)});
+        buffer_size_ += message_len;
+        if (buffer_size_ >= max_buffer_size_ / 2) {
+          flush_condition_.notify_one();
+        }
+        return;
+      }
+    }
+
+    // Preserve the order of the messages by first writing the buffered ones.
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    WriteBuffer();
+    logger_->Write(force_flush, timestamp, message, message_len);
+  }
+
+  void Flush() override {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    WriteBuffer();
+    logger_->Flush();
+  }
+
+  uint32_t LogSize() override { return logger_->LogSize(); }
+
+  // Stop the background thread and write the buffered messages. Subsequent
+  // messages are written synchronously.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopped_) {
+        return;
+      }
+      stopped_ = true;
+    }
+    flush_condition_.notify_one();
+    buffer_full_condition_.notify_all();
+    thread_.join();
+    Flush();
+  }
+
+ private:
+  struct Message {
+    LogTimestamp timestamp;
+    std::string text;
+  };
+
+  void Run() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        flush_condition_.wait_for(lock, flush_interval_, [this]() {
+          return stopped_ || buffer_size_ >= max_buffer_size_ / 2;
+        });
+        if (stopped_) {
+          return;
+        }
+      }
+      Flush();
+    }
+  }
+
+  // Must be called with the write mutex held.
+  void WriteBuffer() {
+    std::vector<Message> messages;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      messages.swap(buffer_);
+      buffer_size_ = 0;
+    }
+    buffer_full_condition_.notify_all();
+    for (const Message& message : messages) {
+      logger_->Write(/*force_flush=*/false,
+                     message.timestamp,
+                     message.text.data(),
+                     static_cast<LogMessageLength>(message.text.size()));
+    }
+  }
+
+  google::base::Logger* const logger_;
+  const std::chrono::milliseconds flush_interval_;
+  const size_t max_buffer_size_;
+
+  // Protects the buffer and is only held to append or swap the messages.
+  std::mutex mutex_;
+  std::condition_variable flush_condition_;
+  std::condition_variable buffer_full_condition_;
+  std::vector<Message> buffer_;
+  size_t buffer_size_ = 0;
+  bool stopped_ = false;
+
+  // Serializes the writes to the wrapped logger.
+  std::mutex write_mutex_;
+
+  std::thread thread_;
+};
+
+void StopAsyncLoggers() {
+  for (int severity = 0; severity < google::NUM_SEVERITIES; ++severity) {
+    auto* logger =
+        dynamic_cast<AsyncLogger*>(google::base::GetLogger(severity));
+    if (logger != nullptr) {
+      logger->Stop();
+    }
+  }
+}
+
+}  // namespace
 
 void InitializeGlog(char** argv) {
 #ifndef _MSC_VER  // Broken in MSVC
@@ -38,6 +195,45 @@ void InitializeGlog(char** argv) {
   google::InitGoogleLogging(argv[0]);
 }
 
+void InstallAsyncFileLogging(const double flush_interval,
+                             const size_t max_buffer_size) {
+  THROW_CHECK_GT(flush_interval, 0);
+  THROW_CHECK_GT(max_buffer_size, 0);
+  static std::once_flag install_once;
+  std::call_once(install_once, [&]() {
+    for (int severity = 0; severity < google::NUM_SEVERITIES; ++severity) {
+      google::base::SetLogger(
+          severity,
+          new AsyncLogger(google::base::GetLogger(severity),
+                          flush_interval,
+                          max_buffer_size));
+    }
+    // The background threads must be stopped before the wrapped loggers are
+    // destroyed at exit.
+    std::atexit(&StopAsyncLoggers);
+  });
+}
+
+LogRateLimiter::LogRateLimiter(const double min_interval)
+    : min_interval_ns_(static_cast<int64_t>(min_interval * 1e9)),
+      next_time_ns_(0) {}
+
+bool LogRateLimiter::Allow() {
+  const int64_t time_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+  int64_t next_time_ns = next_time_ns_.load(std::memory_order_relaxed);
+  while (time_ns >= next_time_ns) {
+    if (next_time_ns_.compare_exchange_weak(next_time_ns,
+                                            time_ns + min_interval_ns_,
+                                            std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 const char* __GetConstFileBaseName(const char* file) {
   const char* base = strrchr(file, '/');
   if (!base) {
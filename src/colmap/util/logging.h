@@ -31,6 +31,8 @@
 
 #include "colmap/util/string.h"
 
+#include <atomic>
+#include <cstdint>
 #include <exception>
 #include <iostream>
 
@@ -99,6 +101,32 @@ namespace colmap {
 // Initialize glog at the beginning of the program.
 void InitializeGlog(char** argv);
 
+// Replace the glog file loggers by asynchronous loggers, such that the logging
+// threads only append their messages to an in-memory buffer, which a
+// background thread writes to the log files every flush interval or once the
+// buffer is half full. The logging threads only block on a full buffer.
+// Messages that glog flushes immediately, i.e. warnings and errors with the
+// default buffering level, are still written synchronously after the buffered
+// messages. The messages written to stderr are not affected. Only the first
+// call installs the loggers, which are flushed at exit.
+void InstallAsyncFileLogging(double flush_interval = 1.0,
+                             size_t max_buffer_size = 4 * 1024 * 1024);
+
+// Limits the rate of repetitive log messages, e.g., the per-image progress
+// messages of many worker threads. This class is thread-safe and lock-free.
+class LogRateLimiter {
+ public:
+  explicit LogRateLimiter(double min_interval);
+
+  // Whether to log a message now, i.e. whether at least the minimum interval
+  // in seconds has passed since the last allowed message.
+  bool Allow();
+
+ private:
+  const int64_t min_interval_ns_;
+  std::atomic<int64_t> next_time_ns_;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -29,6 +29,8 @@
 
 #include "colmap/util/logging.h"
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -65,5 +67,20 @@ TEST(ExceptionLogging, Nested) {
                std::invalid_argument);
 }
 
+TEST(LogRateLimiter, Nominal) {
+  LogRateLimiter limiter(/*min_interval=*/0.05);
+  EXPECT_TRUE(limiter.Allow());
+  EXPECT_FALSE(limiter.Allow());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_TRUE(limiter.Allow());
+  EXPECT_FALSE(limiter.Allow());
+}
+
+TEST(LogRateLimiter, ZeroInterval) {
+  LogRateLimiter limiter(/*min_interval=*/0);
+  EXPECT_TRUE(limiter.Allow());
+  EXPECT_TRUE(limiter.Allow());
+}
+
 }  // namespace
 }  // namespace colmap
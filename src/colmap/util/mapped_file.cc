@@ -0,0 +1,111 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/mapped_file.h"
+
+#include "colmap/util/logging.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace colmap {
+
+MappedFile::MappedFile(const std::string& path)
+    : path_(path), data_(nullptr), num_bytes_(0) {
+#ifdef _WIN32
+  mapping_handle_ = nullptr;
+  file_handle_ = CreateFileA(path.c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+  THROW_CHECK(file_handle_ != INVALID_HANDLE_VALUE)
+      << "Failed to open file " << path;
+  LARGE_INTEGER file_size;
+  THROW_CHECK(GetFileSizeEx(file_handle_, &file_size));
+  num_bytes_ = static_cast<size_t>(file_size.QuadPart);
+  if (num_bytes_ == 0) {
+    return;
+  }
+  mapping_handle_ =
+      CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  THROW_CHECK_NOTNULL(mapping_handle_);
+  data_ = static_cast<const char*>(
+      MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  THROW_CHECK_NOTNULL(data_);
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  THROW_CHECK_GE(fd, 0) << "Failed to open file " << path;
+  struct stat file_stat;
+  THROW_CHECK_EQ(fstat(fd, &file_stat), 0);
+  num_bytes_ = static_cast<size_t>(file_stat.st_size);
+  if (num_bytes_ == 0) {
+    close(fd);
+    return;
+  }
+  void* data = mmap(nullptr, num_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  THROW_CHECK(data != MAP_FAILED) << "Failed to map file " << path;
+  data_ = static_cast<const char*>(data);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_ != nullptr) {
+    CloseHandle(mapping_handle_);
+  }
+  CloseHandle(file_handle_);
+#else
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), num_bytes_);
+  }
+#endif
+}
+
+const std::string& MappedFile::Path() const { return path_; }
+
+const char* MappedFile::Data() const { return data_; }
+
+size_t MappedFile::NumBytes() const { return num_bytes_; }
+
+}  // namespace colmap
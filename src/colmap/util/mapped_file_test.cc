@@ -0,0 +1,70 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/mapped_file.h"
+
+#include "colmap/util/testing.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(MappedFile, Nominal) {
+  const std::string path = CreateTestDir() + "/file.bin";
+  const std::string data = "0123456789";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << data;
+  }
+  MappedFile mapped_file(path);
+  EXPECT_EQ(mapped_file.Path(), path);
+  EXPECT_EQ(mapped_file.NumBytes(), data.size());
+  ASSERT_NE(mapped_file.Data(), nullptr);
+  EXPECT_EQ(std::memcmp(mapped_file.Data(), data.data(), data.size()), 0);
+}
+
+TEST(MappedFile, Empty) {
+  const std::string path = CreateTestDir() + "/file.bin";
+  { std::ofstream file(path, std::ios::binary); }
+  MappedFile mapped_file(path);
+  EXPECT_EQ(mapped_file.NumBytes(), 0);
+  EXPECT_EQ(mapped_file.Data(), nullptr);
+}
+
+TEST(MappedFile, Missing) {
+  EXPECT_ANY_THROW(MappedFile(CreateTestDir() + "/missing.bin"));
+}
+
+}  // namespace
+}  // namespace colmap
@@ -0,0 +1,136 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/memory.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/metrics.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace colmap {
+namespace {
+
+// Read the value in kilobytes of the given field of /proc/self/status, e.g.,
+// "VmRSS" for the current and "VmHWM" for the peak resident set size.
+size_t ReadProcStatusBytes(const std::string& field) {
+  std::ifstream file("/proc/self/status");
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.compare(0, field.size() + 1, field + ":") == 0) {
+      std::istringstream stream(line.substr(field.size() + 1));
+      size_t num_kilobytes = 0;
+      if (stream >> num_kilobytes) {
+        return num_kilobytes * 1024;
+      }
+    }
+  }
+  return 0;
+}
+
+std::string FormatNumBytes(const double num_bytes) {
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(3)
+         << num_bytes / (1024.0 * 1024.0 * 1024.0) << "GB";
+  return stream.str();
+}
+
+}  // namespace
+
+size_t GetCurrentResidentBytes() {
+#if defined(__linux__)
+  return ReadProcStatusBytes("VmRSS");
+#else
+  return 0;
+#endif
+}
+
+size_t GetPeakResidentBytes() {
+#if defined(__linux__)
+  const size_t num_bytes = ReadProcStatusBytes("VmHWM");
+  if (num_bytes > 0) {
+    return num_bytes;
+  }
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    // The maximum resident set size is in bytes on macOS and in kilobytes on
+    // Linux.
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
+void SetMemoryUsage(const std::string& subsystem, const size_t num_bytes) {
+  MetricsRegistry::Instance()
+      .Gauge("colmap_memory_bytes",
+             "Estimated memory usage of the subsystem in bytes",
+             {{"subsystem", subsystem}})
+      ->Set(num_bytes);
+}
+
+void LogMemoryUsage() {
+  MetricsRegistry& registry = MetricsRegistry::Instance();
+  const size_t current_num_bytes = GetCurrentResidentBytes();
+  const size_t peak_num_bytes = GetPeakResidentBytes();
+  registry
+      .Gauge("colmap_process_resident_bytes",
+             "Current resident set size of the process in bytes")
+      ->Set(current_num_bytes);
+  registry
+      .Gauge("colmap_process_peak_resident_bytes",
+             "Peak resident set size of the process in bytes")
+      ->Set(peak_num_bytes);
+
+  std::ostringstream stream;
+  stream << "Memory usage: resident=" << FormatNumBytes(current_num_bytes)
+         << ", peak=" << FormatNumBytes(peak_num_bytes);
+  for (const auto& [labels, num_bytes] :
+       registry.GaugeValues("colmap_memory_bytes")) {
+    const auto subsystem = labels.find("subsystem");
+    if (subsystem != labels.end()) {
+      stream << ", " << subsystem->second << "=" << FormatNumBytes(num_bytes);
+    }
+  }
+  LOG(INFO) << stream.str();
+}
+
+}  // namespace colmap
@@ -0,0 +1,99 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace colmap {
+
+// Current and peak resident set size of the process in bytes, or 0 if it
+// cannot be determined on this platform.
+size_t GetCurrentResidentBytes();
+size_t GetPeakResidentBytes();
+
+// Set the estimated memory usage of a subsystem, e.g., "reconstruction" or
+// "fusion", which is exported as the gauge colmap_memory_bytes with the label
+// subsystem in the library metrics registry.
+void SetMemoryUsage(const std::string& subsystem, size_t num_bytes);
+
+// Update the gauges of the current and peak resident set size of the process
+// and log them together with the estimated memory usage of all subsystems.
+void LogMemoryUsage();
+
+// Approximations of the heap memory allocated by standard containers, which
+// assume one node allocation per element in hash containers. The memory owned
+// by the elements themselves is not included.
+template <typename T, typename Alloc>
+size_t EstimateNumBytes(const std::vector<T, Alloc>& vector);
+template <typename key_t, typename value_t, typename... Args>
+size_t EstimateNumBytes(
+    const std::unordered_map<key_t, value_t, Args...>& map);
+template <typename key_t, typename... Args>
+size_t EstimateNumBytes(const std::unordered_set<key_t, Args...>& set);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+namespace internal {
+
+// Size of a node of a hash container with the given value type, which stores
+// the value and the pointer to the next node.
+template <typename value_t>
+constexpr size_t HashNodeNumBytes() {
+  return sizeof(value_t) + sizeof(void*) + sizeof(size_t);
+}
+
+}  // namespace internal
+
+template <typename T, typename Alloc>
+size_t EstimateNumBytes(const std::vector<T, Alloc>& vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+template <typename key_t, typename value_t, typename... Args>
+size_t EstimateNumBytes(
+    const std::unordered_map<key_t, value_t, Args...>& map) {
+  return map.size() *
+             internal::HashNodeNumBytes<std::pair<const key_t, value_t>>() +
+         map.bucket_count() * sizeof(void*);
+}
+
+template <typename key_t, typename... Args>
+size_t EstimateNumBytes(const std::unordered_set<key_t, Args...>& set) {
+  return set.size() * internal::HashNodeNumBytes<key_t>() +
+         set.bucket_count() * sizeof(void*);
+}
+
+}  // namespace colmap
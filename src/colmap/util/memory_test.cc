@@ -0,0 +1,82 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/memory.h"
+
+#include "colmap/util/metrics.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(GetResidentBytes, Nominal) {
+#if defined(__linux__)
+  EXPECT_GT(GetCurrentResidentBytes(), 0);
+  EXPECT_GT(GetPeakResidentBytes(), 0);
+#endif
+  EXPECT_GE(GetPeakResidentBytes(), GetCurrentResidentBytes());
+}
+
+TEST(SetMemoryUsage, Nominal) {
+  SetMemoryUsage("test_subsystem", 123);
+  EXPECT_EQ(MetricsRegistry::Instance()
+                .GaugeValues("colmap_memory_bytes")
+                .at({{"subsystem", "test_subsystem"}}),
+            123);
+  LogMemoryUsage();
+  EXPECT_GT(MetricsRegistry::Instance()
+                .GaugeValues("colmap_process_peak_resident_bytes")
+                .size(),
+            0);
+}
+
+TEST(EstimateNumBytes, Vector) {
+  std::vector<double> vector;
+  EXPECT_EQ(EstimateNumBytes(vector), 0);
+  vector.reserve(10);
+  EXPECT_EQ(EstimateNumBytes(vector), 10 * sizeof(double));
+}
+
+TEST(EstimateNumBytes, HashContainers) {
+  std::unordered_map<int, double> map;
+  std::unordered_set<int> set;
+  const size_t empty_map_num_bytes = EstimateNumBytes(map);
+  const size_t empty_set_num_bytes = EstimateNumBytes(set);
+  for (int i = 0; i < 100; ++i) {
+    map.emplace(i, i);
+    set.insert(i);
+  }
+  EXPECT_GE(EstimateNumBytes(map),
+            empty_map_num_bytes + 100 * (sizeof(int) + sizeof(double)));
+  EXPECT_GE(EstimateNumBytes(set), empty_set_num_bytes + 100 * sizeof(int));
+}
+
+}  // namespace
+}  // namespace colmap
@@ -0,0 +1,351 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/metrics.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/memory.h"
+#include "colmap/util/string.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace colmap {
+namespace {
+
+void AtomicAdd(std::atomic<double>* value, const double increment) {
+  double prev_value = value->load(std::memory_order_relaxed);
+  while (!value->compare_exchange_weak(prev_value,
+                                       prev_value + increment,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+std::string FormatValue(const double value) {
+  return StringPrintf("%.17g", value);
+}
+
+std::string FormatLabels(const MetricLabels& labels,
+                         const std::string& extra_label = "") {
+  if (labels.empty() && extra_label.empty()) {
+    return "";
+  }
+  std::ostringstream stream;
+  stream << "{";
+  bool first_label = true;
+  for (const auto& label : labels) {
+    if (!first_label) {
+      stream << ",";
+    }
+    first_label = false;
+    stream << label.first << "=\"";
+    for (const char c : label.second) {
+      if (c == '\\' || c == '"') {
+        stream << '\\' << c;
+      } else if (c == '\n') {
+        stream << "\\n";
+      } else {
+        stream << c;
+      }
+    }
+    stream << "\"";
+  }
+  if (!extra_label.empty()) {
+    if (!first_label) {
+      stream << ",";
+    }
+    stream << extra_label;
+  }
+  stream << "}";
+  return stream.str();
+}
+
+}  // namespace
+
+std::vector<double> ExponentialMetricBuckets(const double start,
+                                             const double factor,
+                                             const int num_buckets) {
+  THROW_CHECK_GT(start, 0);
+  THROW_CHECK_GT(factor, 1);
+  THROW_CHECK_GT(num_buckets, 0);
+  std::vector<double> bucket_bounds(num_buckets);
+  bucket_bounds[0] = start;
+  for (int i = 1; i < num_buckets; ++i) {
+    bucket_bounds[i] = bucket_bounds[i - 1] * factor;
+  }
+  return bucket_bounds;
+}
+
+void MetricCounter::Increment(const double value) {
+  THROW_CHECK_GE(value, 0);
+  AtomicAdd(&value_, value);
+}
+
+double MetricCounter::Value() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+void MetricGauge::Set(const double value) {
+  value_.store(value, std::memory_order_relaxed);
+}
+
+void MetricGauge::Increment(const double value) { AtomicAdd(&value_, value); }
+
+double MetricGauge::Value() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+MetricHistogram::MetricHistogram(std::vector<double> bucket_bounds)
+    : bucket_bounds_(std::move(bucket_bounds)),
+      bucket_counts_(bucket_bounds_.size() + 1, 0),
+      count_(0),
+      sum_(0) {
+  THROW_CHECK(std::is_sorted(bucket_bounds_.begin(), bucket_bounds_.end()));
+}
+
+void MetricHistogram::Observe(const double value) {
+  const size_t bucket_idx =
+      std::lower_bound(bucket_bounds_.begin(), bucket_bounds_.end(), value) -
+      bucket_bounds_.begin();
+  std::lock_guard<std::mutex> lock(mutex_);
+  bucket_counts_[bucket_idx] += 1;
+  count_ += 1;
+  sum_ += value;
+}
+
+const std::vector<double>& MetricHistogram::BucketBounds() const {
+  return bucket_bounds_;
+}
+
+std::vector<size_t> MetricHistogram::BucketCounts() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bucket_counts_;
+}
+
+size_t MetricHistogram::Count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return count_;
+}
+
+double MetricHistogram::Sum() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sum_;
+}
+
+MetricsRegistry& MetricsRegistry::Instance() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::~MetricsRegistry() { StopFileDump(); }
+
+MetricsRegistry::Family& MetricsRegistry::GetFamily(const std::string& name,
+                                                    const MetricType type,
+                                                    const std::string& help) {
+  THROW_CHECK(!name.empty());
+  auto family_it = families_.find(name);
+  if (family_it == families_.end()) {
+    Family& family = families_[name];
+    family.type = type;
+    family.help = help;
+    return family;
+  }
+  THROW_CHECK(family_it->second.type == type)
+      << "Metric " << name << " is registered with a different type";
+  return family_it->second;
+}
+
+MetricCounter* MetricsRegistry::Counter(const std::string& name,
+                                        const std::string& help,
+                                        const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& counter =
+      GetFamily(name, MetricType::COUNTER, help).counters[labels];
+  if (!counter) {
+    counter = std::make_unique<MetricCounter>();
+  }
+  return counter.get();
+}
+
+MetricGauge* MetricsRegistry::Gauge(const std::string& name,
+                                    const std::string& help,
+                                    const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& gauge = GetFamily(name, MetricType::GAUGE, help).gauges[labels];
+  if (!gauge) {
+    gauge = std::make_unique<MetricGauge>();
+  }
+  return gauge.get();
+}
+
+MetricHistogram* MetricsRegistry::Histogram(
+    const std::string& name,
+    const std::string& help,
+    const std::vector<double>& bucket_bounds,
+    const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Family& family = GetFamily(name, MetricType::HISTOGRAM, help);
+  if (family.histograms.empty()) {
+    family.bucket_bounds = bucket_bounds;
+  }
+  auto& histogram = family.histograms[labels];
+  if (!histogram) {
+    histogram = std::make_unique<MetricHistogram>(family.bucket_bounds);
+  }
+  return histogram.get();
+}
+
+std::map<MetricLabels, double> MetricsRegistry::GaugeValues(
+    const std::string& name) const {
+  std::map<MetricLabels, double> values;
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto family = families_.find(name);
+  if (family != families_.end()) {
+    for (const auto& [labels, gauge] : family->second.gauges) {
+      values.emplace(labels, gauge->Value());
+    }
+  }
+  return values;
+}
+
+std::string MetricsRegistry::ExportPrometheus() const {
+  std::ostringstream stream;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& [name, family] : families_) {
+    if (!family.help.empty()) {
+      stream << "# HELP " << name << " " << family.help << "\n";
+    }
+    switch (family.type) {
+      case MetricType::COUNTER:
+        stream << "# TYPE " << name << " counter\n";
+        for (const auto& [labels, counter] : family.counters) {
+          stream << name << FormatLabels(labels) << " "
+                 << FormatValue(counter->Value()) << "\n";
+        }
+        break;
+      case MetricType::GAUGE:
+        stream << "# TYPE " << name << " gauge\n";
+        for (const auto& [labels, gauge] : family.gauges) {
+          stream << name << FormatLabels(labels) << " "
+                 << FormatValue(gauge->Value()) << "\n";
+        }
+        break;
+      case MetricType::HISTOGRAM:
+        stream << "# TYPE " << name << " histogram\n";
+        for (const auto& [labels, histogram] : family.histograms) {
+          const std::vector<size_t> bucket_counts = histogram->BucketCounts();
+          size_t cumulative_count = 0;
+          for (size_t i = 0; i < bucket_counts.size(); ++i) {
+            cumulative_count += bucket_counts[i];
+            const std::string bound =
+                i < histogram->BucketBounds().size()
+                    ? FormatValue(histogram->BucketBounds()[i])
+                    : "+Inf";
+            stream << name << "_bucket"
+                   << FormatLabels(labels, "le=\"" + bound + "\"") << " "
+                   << cumulative_count << "\n";
+          }
+          stream << name << "_sum" << FormatLabels(labels) << " "
+                 << FormatValue(histogram->Sum()) << "\n";
+          stream << name << "_count" << FormatLabels(labels) << " "
+                 << cumulative_count << "\n";
+        }
+        break;
+    }
+  }
+  return stream.str();
+}
+
+void MetricsRegistry::WritePrometheus(const std::string& path) const {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
+    file << ExportPrometheus();
+  }
+  THROW_CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0)
+      << "Failed to write metrics to " << path;
+}
+
+void MetricsRegistry::StartFileDump(const std::string& path,
+                                    const double interval_seconds) {
+  THROW_CHECK(!path.empty());
+  THROW_CHECK_GT(interval_seconds, 0);
+  StopFileDump();
+
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  dump_stopped_ = false;
+  dump_path_ = path;
+  dump_thread_ = std::thread([this, interval_seconds]() {
+    const auto interval = std::chrono::duration<double>(interval_seconds);
+    std::unique_lock<std::mutex> lock(dump_mutex_);
+    bool stopped = false;
+    while (!stopped) {
+      stopped = dump_condition_.wait_for(
+          lock, interval, [this]() { return dump_stopped_; });
+      Gauge("colmap_process_resident_bytes",
+            "Current resident set size of the process in bytes")
+          ->Set(GetCurrentResidentBytes());
+      Gauge("colmap_process_peak_resident_bytes",
+            "Peak resident set size of the process in bytes")
+          ->Set(GetPeakResidentBytes());
+      try {
+        WritePrometheus(dump_path_);
+      } catch (const std::exception& exc) {
+        LOG(ERROR) << exc.what();
+      }
+    }
+  });
+}
+
+void MetricsRegistry::StopFileDump() {
+  {
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    dump_stopped_ = true;
+  }
+  dump_condition_.notify_all();
+  if (dump_thread_.joinable()) {
+    dump_thread_.join();
+  }
+}
+
+CacheMetrics GetCacheMetrics(const std::string& cache_name) {
+  const MetricLabels labels = {{"cache", cache_name}};
+  CacheMetrics metrics;
+  metrics.lookups = MetricsRegistry::Instance().Counter(
+      "colmap_cache_lookups_total", "Number of cache lookups", labels);
+  metrics.misses = MetricsRegistry::Instance().Counter(
+      "colmap_cache_misses_total", "Number of cache misses", labels);
+  return metrics;
+}
+
+}  // namespace colmap
@@ -0,0 +1,177 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace colmap {
+
+// Labels that distinguish the metrics of the same name, e.g., {"gpu", "0"}.
+typedef std::map<std::string, std::string> MetricLabels;
+
+// Monotonically increasing value, e.g., the number of processed image pairs.
+class MetricCounter {
+ public:
+  void Increment(double value = 1);
+  double Value() const;
+
+ private:
+  std::atomic<double> value_{0};
+};
+
+// Value that can go up and down, e.g., the number of cached images.
+class MetricGauge {
+ public:
+  void Set(double value);
+  void Increment(double value = 1);
+  double Value() const;
+
+ private:
+  std::atomic<double> value_{0};
+};
+
+// Distribution of observed values over buckets with the given upper bounds,
+// e.g., of the times of bundle adjustment.
+class MetricHistogram {
+ public:
+  explicit MetricHistogram(std::vector<double> bucket_bounds);
+
+  void Observe(double value);
+
+  const std::vector<double>& BucketBounds() const;
+  // The number of observed values in each bucket (not cumulative) and in the
+  // last overflow bucket for values above the largest bound.
+  std::vector<size_t> BucketCounts() const;
+  size_t Count() const;
+  double Sum() const;
+
+ private:
+  const std::vector<double> bucket_bounds_;
+  mutable std::mutex mutex_;
+  std::vector<size_t> bucket_counts_;
+  size_t count_;
+  double sum_;
+};
+
+// Bucket bounds start, start * factor, ..., start * factor^(num_buckets-1).
+std::vector<double> ExponentialMetricBuckets(double start,
+                                             double factor,
+                                             int num_buckets);
+
+// Process-wide registry of metrics, which can be exported in the Prometheus
+// text format, e.g.:
+//
+//    MetricCounter* counter = MetricsRegistry::Instance().Counter(
+//        "colmap_matcher_pairs_total", "Number of matched image pairs");
+//    counter->Increment();
+//
+// The returned metrics remain valid for the lifetime of the process, so
+// callers can look them up once and then update them without locking.
+class MetricsRegistry {
+ public:
+  MetricsRegistry() = default;
+  ~MetricsRegistry();
+
+  // The registry fed by the library.
+  static MetricsRegistry& Instance();
+
+  // Get or create the metric with the given name and labels. The help text
+  // and bucket bounds are only used when the metric family is created. Throws
+  // if the name is already registered with a different type.
+  MetricCounter* Counter(const std::string& name,
+                         const std::string& help = "",
+                         const MetricLabels& labels = {});
+  MetricGauge* Gauge(const std::string& name,
+                     const std::string& help = "",
+                     const MetricLabels& labels = {});
+  MetricHistogram* Histogram(const std::string& name,
+                             const std::string& help,
+                             const std::vector<double>& bucket_bounds,
+                             const MetricLabels& labels = {});
+
+  // The values of all gauges of the given name by their labels.
+  std::map<MetricLabels, double> GaugeValues(const std::string& name) const;
+
+  // Export all metrics in the Prometheus text exposition format.
+  std::string ExportPrometheus() const;
+
+  // Atomically replace the file with the exported metrics, such that
+  // monitoring agents never read a partially written file.
+  void WritePrometheus(const std::string& path) const;
+
+  // Periodically write the metrics to the given file on a background thread
+  // until StopFileDump, which writes them a last time. The resident set size
+  // of the process is updated before every write. Called when parsing the
+  // `metrics_path` option.
+  void StartFileDump(const std::string& path, double interval_seconds);
+  void StopFileDump();
+
+ private:
+  enum class MetricType { COUNTER, GAUGE, HISTOGRAM };
+
+  struct Family {
+    MetricType type;
+    std::string help;
+    std::vector<double> bucket_bounds;
+    std::map<MetricLabels, std::unique_ptr<MetricCounter>> counters;
+    std::map<MetricLabels, std::unique_ptr<MetricGauge>> gauges;
+    std::map<MetricLabels, std::unique_ptr<MetricHistogram>> histograms;
+  };
+
+  Family& GetFamily(const std::string& name,
+                    MetricType type,
+                    const std::string& help);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+
+  std::mutex dump_mutex_;
+  std::condition_variable dump_condition_;
+  bool dump_stopped_ = true;
+  std::string dump_path_;
+  std::thread dump_thread_;
+};
+
+// Counters of the lookups and misses of the named cache in the library
+// registry, from which monitoring computes the hit rate as 1 - misses/lookups.
+struct CacheMetrics {
+  MetricCounter* lookups = nullptr;
+  MetricCounter* misses = nullptr;
+};
+CacheMetrics GetCacheMetrics(const std::string& cache_name);
+
+}  // namespace colmap
@@ -0,0 +1,169 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/metrics.h"
+
+#include "colmap/util/testing.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(MetricCounter, Nominal) {
+  MetricCounter counter;
+  EXPECT_EQ(counter.Value(), 0);
+  counter.Increment();
+  counter.Increment(2.5);
+  EXPECT_EQ(counter.Value(), 3.5);
+  EXPECT_ANY_THROW(counter.Increment(-1));
+}
+
+TEST(MetricCounter, MultipleThreads) {
+  MetricCounter counter;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&counter]() {
+      for (int j = 0; j < 1000; ++j) {
+        counter.Increment();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter.Value(), 4000);
+}
+
+TEST(MetricGauge, Nominal) {
+  MetricGauge gauge;
+  EXPECT_EQ(gauge.Value(), 0);
+  gauge.Set(2);
+  EXPECT_EQ(gauge.Value(), 2);
+  gauge.Increment(-3);
+  EXPECT_EQ(gauge.Value(), -1);
+}
+
+TEST(MetricHistogram, Nominal) {
+  MetricHistogram histogram({1, 10});
+  histogram.Observe(0.5);
+  histogram.Observe(1);
+  histogram.Observe(5);
+  histogram.Observe(100);
+  EXPECT_EQ(histogram.Count(), 4);
+  EXPECT_EQ(histogram.Sum(), 106.5);
+  EXPECT_EQ(histogram.BucketCounts(), std::vector<size_t>({2, 1, 1}));
+  EXPECT_ANY_THROW(MetricHistogram({10, 1}));
+}
+
+TEST(ExponentialMetricBuckets, Nominal) {
+  EXPECT_EQ(ExponentialMetricBuckets(0.5, 2, 4),
+            std::vector<double>({0.5, 1, 2, 4}));
+  EXPECT_ANY_THROW(ExponentialMetricBuckets(0, 2, 4));
+  EXPECT_ANY_THROW(ExponentialMetricBuckets(1, 1, 4));
+}
+
+TEST(MetricsRegistry, GetOrCreate) {
+  MetricsRegistry registry;
+  MetricCounter* counter = registry.Counter("test_get_or_create_total");
+  EXPECT_EQ(registry.Counter("test_get_or_create_total"), counter);
+  EXPECT_NE(registry.Counter("test_get_or_create_total", "", {{"a", "b"}}),
+            counter);
+  EXPECT_ANY_THROW(registry.Gauge("test_get_or_create_total"));
+}
+
+TEST(MetricsRegistry, ExportPrometheus) {
+  MetricsRegistry registry;
+  registry.Counter("test_export_total", "Test counter", {{"gpu", "0"}})
+      ->Increment(3);
+  registry.Gauge("test_export_gauge")->Set(0.5);
+  MetricHistogram* histogram =
+      registry.Histogram("test_export_seconds", "Test histogram", {1, 10});
+  histogram->Observe(0.5);
+  histogram->Observe(20);
+
+  const std::string metrics = registry.ExportPrometheus();
+  EXPECT_NE(metrics.find("# HELP test_export_total Test counter\n"
+                         "# TYPE test_export_total counter\n"
+                         "test_export_total{gpu=\"0\"} 3\n"),
+            std::string::npos);
+  EXPECT_NE(metrics.find("# TYPE test_export_gauge gauge\n"
+                         "test_export_gauge 0.5\n"),
+            std::string::npos);
+  EXPECT_NE(metrics.find("test_export_seconds_bucket{le=\"1\"} 1\n"
+                         "test_export_seconds_bucket{le=\"10\"} 1\n"
+                         "test_export_seconds_bucket{le=\"+Inf\"} 2\n"
+                         "test_export_seconds_sum 20.5\n"
+                         "test_export_seconds_count 2\n"),
+            std::string::npos);
+}
+
+TEST(MetricsRegistry, GaugeValues) {
+  MetricsRegistry registry;
+  EXPECT_TRUE(registry.GaugeValues("test_gauge_values").empty());
+  registry.Gauge("test_gauge_values", "", {{"a", "1"}})->Set(1);
+  registry.Gauge("test_gauge_values", "", {{"a", "2"}})->Set(2);
+  const std::map<MetricLabels, double> values =
+      registry.GaugeValues("test_gauge_values");
+  ASSERT_EQ(values.size(), 2);
+  EXPECT_EQ(values.at({{"a", "1"}}), 1);
+  EXPECT_EQ(values.at({{"a", "2"}}), 2);
+}
+
+TEST(MetricsRegistry, FileDump) {
+  MetricsRegistry registry;
+  const std::string path = CreateTestDir() + "/metrics.prom";
+  registry.StartFileDump(path, 100);
+  registry.Counter("test_file_dump_total")->Increment();
+  registry.StopFileDump();
+
+  std::ifstream file(path);
+  std::stringstream metrics;
+  metrics << file.rdbuf();
+  EXPECT_NE(metrics.str().find("test_file_dump_total 1\n"), std::string::npos);
+  EXPECT_NE(metrics.str().find("colmap_process_peak_resident_bytes"),
+            std::string::npos);
+}
+
+TEST(GetCacheMetrics, Nominal) {
+  const CacheMetrics metrics1 = GetCacheMetrics("test_cache1");
+  const CacheMetrics metrics2 = GetCacheMetrics("test_cache2");
+  EXPECT_NE(metrics1.lookups, nullptr);
+  EXPECT_NE(metrics1.misses, nullptr);
+  EXPECT_NE(metrics1.lookups, metrics1.misses);
+  EXPECT_NE(metrics1.lookups, metrics2.lookups);
+  EXPECT_EQ(GetCacheMetrics("test_cache1").lookups, metrics1.lookups);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -29,6 +29,7 @@
 
 #include "colmap/util/misc.h"
 
+#include <algorithm>
 #include <cstdarg>
 
 namespace colmap {
@@ -95,6 +96,10 @@ void FileCopy(const std::string& src_path,
   }
 }
 
+void RenameFile(const std::string& src_path, const std::string& dst_path) {
+  boost::filesystem::rename(src_path, dst_path);
+}
+
 bool ExistsFile(const std::string& path) {
   return boost::filesystem::is_regular_file(path);
 }
@@ -190,6 +195,68 @@ size_t GetFileSize(const std::string& path) {
   return file.tellg();
 }
 
+FileSignature ComputeFileSignature(const std::string& path,
+                                   const bool compute_hash) {
+  FileSignature signature;
+  signature.size = boost::filesystem::file_size(path);
+  signature.modification_time =
+      static_cast<int64_t>(boost::filesystem::last_write_time(path));
+  if (!compute_hash) {
+    return signature;
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  // Hash the head and tail of the file, which overlap for small files.
+  constexpr uint64_t kNumBlockBytes = 1 << 16;
+  const uint64_t num_head_bytes = std::min(signature.size, kNumBlockBytes);
+  const uint64_t num_tail_bytes =
+      std::min(signature.size - num_head_bytes, kNumBlockBytes);
+  std::vector<char> data(num_head_bytes + num_tail_bytes);
+  file.read(data.data(), num_head_bytes);
+  if (num_tail_bytes > 0) {
+    file.seekg(signature.size - num_tail_bytes);
+    file.read(data.data() + num_head_bytes, num_tail_bytes);
+  }
+  THROW_CHECK(file.good()) << "Failed to read " << path;
+
+  signature.hash = ComputeFNV1aHash(data.data(), data.size());
+
+  return signature;
+}
+
+uint64_t ComputeFNV1aHash(const void* data,
+                          const size_t num_bytes,
+                          uint64_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < num_bytes; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t ComputeFileContentHash(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  constexpr size_t kNumBlockBytes = 1 << 20;
+  std::vector<char> block(kNumBlockBytes);
+  uint64_t hash = ComputeFNV1aHash(nullptr, 0);
+  uint64_t num_bytes = 0;
+  while (file) {
+    file.read(block.data(), kNumBlockBytes);
+    const size_t num_read_bytes = static_cast<size_t>(file.gcount());
+    hash = ComputeFNV1aHash(block.data(), num_read_bytes, hash);
+    num_bytes += num_read_bytes;
+  }
+  THROW_CHECK(file.eof()) << "Failed to read " << path;
+
+  // Mix in the size, so that files of different sizes rarely collide.
+  return ComputeFNV1aHash(&num_bytes, sizeof(num_bytes), hash);
+}
+
 void PrintHeading1(const std::string& heading) {
   std::ostringstream log;
   log << "\n" << std::string(78, '=') << "\n";
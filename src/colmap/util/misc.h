@@ -33,6 +33,7 @@
 #include "colmap/util/logging.h"
 #include "colmap/util/string.h"
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -87,6 +88,10 @@ void FileCopy(const std::string& src_path,
               const std::string& dst_path,
               CopyType type = CopyType::COPY);
 
+// Rename file and replace the destination file, if it exists. Processes that
+// opened or memory-mapped the replaced file keep accessing its old contents.
+void RenameFile(const std::string& src_path, const std::string& dst_path);
+
 // Check if the path points to an existing directory.
 bool ExistsFile(const std::string& path);
 
@@ -125,6 +130,37 @@ std::vector<std::string> GetRecursiveDirList(const std::string& path);
 // Get the size in bytes of a file.
 size_t GetFileSize(const std::string& path);
 
+// Cheap signature of the content of a file to detect changes between runs
+// without reading the entire file. The hash covers only the head and tail of
+// the file, which together with the size and modification time reliably
+// detects replaced or re-encoded images.
+struct FileSignature {
+  uint64_t size = 0;
+  // Last modification time in seconds since epoch.
+  int64_t modification_time = 0;
+  // 64-bit FNV-1a hash of the first and last bytes of the file.
+  uint64_t hash = 0;
+
+  inline bool operator==(const FileSignature& other) const;
+  inline bool operator!=(const FileSignature& other) const;
+};
+
+// Compute the signature of a file, where the hash is only computed if
+// requested, e.g., to confirm a change of the modification time.
+FileSignature ComputeFileSignature(const std::string& path,
+                                   bool compute_hash = true);
+
+// 64-bit FNV-1a hash of the given bytes. The hash of a previous call can be
+// passed to continue hashing, e.g., to hash multiple buffers in sequence.
+uint64_t ComputeFNV1aHash(const void* data,
+                          size_t num_bytes,
+                          uint64_t hash = 14695981039346656037ull);
+
+// Hash of the entire content of a file, which identifies identical files
+// independent of their path and modification time. In contrast to the
+// signature, this reads the entire file.
+uint64_t ComputeFileContentHash(const std::string& path);
+
 // Log first-order heading with over- and underscores.
 void PrintHeading1(const std::string& heading);
 
@@ -165,6 +201,15 @@ void RemoveCommandLineArgument(const std::string& arg, int* argc, char** argv);
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
+bool FileSignature::operator==(const FileSignature& other) const {
+  return size == other.size && modification_time == other.modification_time &&
+         hash == other.hash;
+}
+
+bool FileSignature::operator!=(const FileSignature& other) const {
+  return !(*this == other);
+}
+
 template <typename... T>
 std::string JoinPaths(T const&... paths) {
   boost::filesystem::path result;
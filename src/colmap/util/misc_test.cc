@@ -29,6 +29,8 @@
 
 #include "colmap/util/misc.h"
 
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -137,6 +139,72 @@ TEST(JoinPaths, Nominal) {
             "/test1/test2/test3.ext");
 }
 
+TEST(RenameFile, Nominal) {
+  const std::string test_dir = CreateTestDir();
+  const std::string src_path = test_dir + "/src.bin";
+  const std::string dst_path = test_dir + "/dst.bin";
+  WriteBinaryBlob(src_path, std::vector<uint8_t>(10));
+  WriteBinaryBlob(dst_path, std::vector<uint8_t>(20));
+  RenameFile(src_path, dst_path);
+  EXPECT_FALSE(ExistsFile(src_path));
+  EXPECT_EQ(GetFileSize(dst_path), 10);
+}
+
+TEST(ComputeFileSignature, Nominal) {
+  const std::string path = CreateTestDir() + "/file.bin";
+  std::vector<uint8_t> data(200000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i % 251);
+  }
+  WriteBinaryBlob(path, data);
+  const FileSignature signature = ComputeFileSignature(path);
+  EXPECT_EQ(signature.size, data.size());
+  EXPECT_EQ(signature, ComputeFileSignature(path));
+  EXPECT_EQ(ComputeFileSignature(path, /*compute_hash=*/false).hash, 0);
+
+  // Changes in the tail of the file are detected.
+  data.back() += 1;
+  WriteBinaryBlob(path, data);
+  EXPECT_NE(signature.hash, ComputeFileSignature(path).hash);
+
+  // Changes in the middle of large files are not part of the hash.
+  data.back() -= 1;
+  data[data.size() / 2] += 1;
+  WriteBinaryBlob(path, data);
+  EXPECT_EQ(signature.hash, ComputeFileSignature(path).hash);
+
+  // Small files are hashed entirely.
+  data.resize(100);
+  WriteBinaryBlob(path, data);
+  const FileSignature small_signature = ComputeFileSignature(path);
+  EXPECT_EQ(small_signature.size, 100);
+  data[50] += 1;
+  WriteBinaryBlob(path, data);
+  EXPECT_NE(small_signature.hash, ComputeFileSignature(path).hash);
+}
+
+TEST(ComputeFileContentHash, Nominal) {
+  const std::string test_dir = CreateTestDir();
+  const std::string path = test_dir + "/file.bin";
+  std::vector<uint8_t> data(3000000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i % 251);
+  }
+  WriteBinaryBlob(path, data);
+  const uint64_t hash = ComputeFileContentHash(path);
+  EXPECT_EQ(hash, ComputeFileContentHash(path));
+
+  // In contrast to the signature, changes in the middle are detected.
+  data[data.size() / 2] += 1;
+  WriteBinaryBlob(path, data);
+  EXPECT_NE(hash, ComputeFileContentHash(path));
+
+  // Identical content in another file has the same hash.
+  const std::string other_path = test_dir + "/other_file.bin";
+  WriteBinaryBlob(other_path, data);
+  EXPECT_EQ(ComputeFileContentHash(path), ComputeFileContentHash(other_path));
+}
+
 TEST(VectorContainsValue, Nominal) {
   EXPECT_TRUE(VectorContainsValue<int>({1, 2, 3}, 1));
   EXPECT_FALSE(VectorContainsValue<int>({2, 3}, 1));
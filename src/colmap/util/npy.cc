@@ -0,0 +1,240 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/npy.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/string.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+namespace colmap {
+namespace {
+
+const char kNpyMagic[] = "\x93NUMPY";
+const size_t kNpyMagicSize = 6;
+
+// Returns the value of the given key in the header dictionary.
+std::string NpyHeaderValue(const std::string& header, const std::string& key) {
+  const size_t key_pos = header.find("'" + key + "'");
+  THROW_CHECK_NE(key_pos, std::string::npos)
+      << "Missing key " << key << " in .npy header";
+  const size_t colon_pos = header.find(':', key_pos);
+  THROW_CHECK_NE(colon_pos, std::string::npos);
+  const size_t begin = header.find_first_not_of(' ', colon_pos + 1);
+  THROW_CHECK_NE(begin, std::string::npos);
+  size_t end = std::string::npos;
+  if (header[begin] == '(') {
+    end = header.find(')', begin) + 1;
+  } else if (header[begin] == '\'') {
+    end = header.find('\'', begin + 1) + 1;
+  } else {
+    end = header.find_first_of(",}", begin);
+  }
+  THROW_CHECK_NE(end, std::string::npos);
+  return header.substr(begin, end - begin);
+}
+
+template <typename T, typename S>
+void ConvertNpyData(const std::vector<char>& bytes, std::vector<T>* data) {
+  const size_t num_elements = bytes.size() / sizeof(S);
+  data->resize(num_elements);
+  for (size_t i = 0; i < num_elements; ++i) {
+    S value;
+    std::memcpy(&value, bytes.data() + i * sizeof(S), sizeof(S));
+    (*data)[i] = static_cast<T>(LittleEndianToNative(value));
+  }
+}
+
+template <typename T>
+struct NpyDescr;
+
+template <>
+struct NpyDescr<float> {
+  static constexpr const char* value = "<f4";
+};
+
+template <>
+struct NpyDescr<double> {
+  static constexpr const char* value = "<f8";
+};
+
+template <>
+struct NpyDescr<uint8_t> {
+  static constexpr const char* value = "|u1";
+};
+
+template <>
+struct NpyDescr<int32_t> {
+  static constexpr const char* value = "<i4";
+};
+
+template <>
+struct NpyDescr<uint32_t> {
+  static constexpr const char* value = "<u4";
+};
+
+template <>
+struct NpyDescr<int64_t> {
+  static constexpr const char* value = "<i8";
+};
+
+}  // namespace
+
+template <typename T>
+NpyArray<T> ReadNpyArray(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  char magic[kNpyMagicSize];
+  file.read(magic, kNpyMagicSize);
+  THROW_CHECK(file && std::memcmp(magic, kNpyMagic, kNpyMagicSize) == 0)
+      << "Invalid .npy file " << path;
+  const uint8_t major_version = ReadBinaryLittleEndian<uint8_t>(&file);
+  ReadBinaryLittleEndian<uint8_t>(&file);
+  THROW_CHECK_GE(major_version, 1);
+  THROW_CHECK_LE(major_version, 3);
+  const size_t header_size =
+      major_version == 1 ? ReadBinaryLittleEndian<uint16_t>(&file)
+                         : ReadBinaryLittleEndian<uint32_t>(&file);
+  std::string header(header_size, ' ');
+  file.read(header.data(), header_size);
+  THROW_CHECK(file) << "Truncated .npy header in " << path;
+
+  THROW_CHECK_EQ(NpyHeaderValue(header, "fortran_order"), "False")
+      << "Arrays in Fortran order are not supported";
+
+  NpyArray<T> array;
+  const std::string shape = NpyHeaderValue(header, "shape");
+  for (const std::string& dim :
+       StringSplit(shape.substr(1, shape.size() - 2), ",")) {
+    const std::string trimmed_dim = StringReplace(dim, " ", "");
+    if (!trimmed_dim.empty()) {
+      array.shape.push_back(std::stoull(trimmed_dim));
+    }
+  }
+  const size_t num_elements = std::accumulate(array.shape.begin(),
+                                              array.shape.end(),
+                                              static_cast<size_t>(1),
+                                              std::multiplies<size_t>());
+
+  std::string descr = NpyHeaderValue(header, "descr");
+  descr = descr.substr(1, descr.size() - 2);
+  THROW_CHECK_EQ(descr.size(), 3) << "Unsupported .npy type " << descr;
+  THROW_CHECK(descr[0] == '<' || descr[0] == '|')
+      << "Unsupported byte order of .npy type " << descr;
+  const char kind = descr[1];
+  const size_t num_bytes = descr[2] - '0';
+
+  std::vector<char> bytes(num_elements * num_bytes);
+  file.read(bytes.data(), bytes.size());
+  THROW_CHECK(file) << "Truncated .npy data in " << path;
+
+  if (kind == 'f' && num_bytes == 4) {
+    ConvertNpyData<T, float>(bytes, &array.data);
+  } else if (kind == 'f' && num_bytes == 8) {
+    ConvertNpyData<T, double>(bytes, &array.data);
+  } else if ((kind == 'u' || kind == 'b') && num_bytes == 1) {
+    ConvertNpyData<T, uint8_t>(bytes, &array.data);
+  } else if (kind == 'u' && num_bytes == 2) {
+    ConvertNpyData<T, uint16_t>(bytes, &array.data);
+  } else if (kind == 'u' && num_bytes == 4) {
+    ConvertNpyData<T, uint32_t>(bytes, &array.data);
+  } else if (kind == 'u' && num_bytes == 8) {
+    ConvertNpyData<T, uint64_t>(bytes, &array.data);
+  } else if (kind == 'i' && num_bytes == 1) {
+    ConvertNpyData<T, int8_t>(bytes, &array.data);
+  } else if (kind == 'i' && num_bytes == 2) {
+    ConvertNpyData<T, int16_t>(bytes, &array.data);
+  } else if (kind == 'i' && num_bytes == 4) {
+    ConvertNpyData<T, int32_t>(bytes, &array.data);
+  } else if (kind == 'i' && num_bytes == 8) {
+    ConvertNpyData<T, int64_t>(bytes, &array.data);
+  } else {
+    LOG(FATAL_THROW) << "Unsupported .npy type " << descr;
+  }
+
+  return array;
+}
+
+template <typename T>
+void WriteNpyArray(const std::string& path, const NpyArray<T>& array) {
+  THROW_CHECK_EQ(std::accumulate(array.shape.begin(),
+                                 array.shape.end(),
+                                 static_cast<size_t>(1),
+                                 std::multiplies<size_t>()),
+                 array.data.size());
+
+  std::string shape = "(";
+  for (const size_t dim : array.shape) {
+    shape += std::to_string(dim) + ", ";
+  }
+  if (array.shape.size() > 1) {
+    shape.resize(shape.size() - 2);
+  } else if (array.shape.size() == 1) {
+    shape.resize(shape.size() - 1);
+  }
+  shape += ")";
+
+  std::string header = std::string("{'descr': '") + NpyDescr<T>::value +
+                       "', 'fortran_order': False, 'shape': " + shape + ", }";
+  // The total header size must be a multiple of 64 bytes, terminated by a
+  // newline character.
+  const size_t kPrefixSize = kNpyMagicSize + 2 + sizeof(uint16_t);
+  header.append(63 - (kPrefixSize + header.size()) % 64, ' ');
+  header += '\n';
+
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  file.write(kNpyMagic, kNpyMagicSize);
+  WriteBinaryLittleEndian<uint8_t>(&file, 1);
+  WriteBinaryLittleEndian<uint8_t>(&file, 0);
+  WriteBinaryLittleEndian<uint16_t>(&file, header.size());
+  file.write(header.data(), header.size());
+  WriteBinaryLittleEndian<T>(&file, array.data);
+}
+
+#define COLMAP_INSTANTIATE_NPY(T)                             \
+  template NpyArray<T> ReadNpyArray<T>(const std::string&); \
+  template void WriteNpyArray<T>(const std::string&, const NpyArray<T>&);
+
+COLMAP_INSTANTIATE_NPY(float)
+COLMAP_INSTANTIATE_NPY(double)
+COLMAP_INSTANTIATE_NPY(uint8_t)
+COLMAP_INSTANTIATE_NPY(int32_t)
+COLMAP_INSTANTIATE_NPY(uint32_t)
+COLMAP_INSTANTIATE_NPY(int64_t)
+
+#undef COLMAP_INSTANTIATE_NPY
+
+}  // namespace colmap
@@ -0,0 +1,100 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/npy.h"
+
+#include "colmap/util/testing.h"
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(Npy, WriteRead) {
+  const std::string path = CreateTestDir() + "/array.npy";
+  NpyArray<float> array;
+  array.shape = {2, 3};
+  array.data = {1, 2, 3, 4, 5, 6};
+  WriteNpyArray(path, array);
+  const NpyArray<float> read_array = ReadNpyArray<float>(path);
+  EXPECT_EQ(read_array.shape, array.shape);
+  EXPECT_EQ(read_array.data, array.data);
+  // Elements are converted to the requested type.
+  const NpyArray<double> read_array_double = ReadNpyArray<double>(path);
+  EXPECT_EQ(read_array_double.shape, array.shape);
+  EXPECT_EQ(read_array_double.data,
+            std::vector<double>(array.data.begin(), array.data.end()));
+}
+
+TEST(Npy, WriteReadVector) {
+  const std::string path = CreateTestDir() + "/array.npy";
+  NpyArray<uint8_t> array;
+  array.shape = {4};
+  array.data = {0, 1, 128, 255};
+  WriteNpyArray(path, array);
+  const NpyArray<uint8_t> read_array = ReadNpyArray<uint8_t>(path);
+  EXPECT_EQ(read_array.shape, array.shape);
+  EXPECT_EQ(read_array.data, array.data);
+}
+
+TEST(Npy, ReadNumPyFile) {
+  // Output of numpy.save("array.npy", numpy.array([[1, -2]], dtype=int64)).
+  const std::string path = CreateTestDir() + "/array.npy";
+  std::string header =
+      "{'descr': '<i8', 'fortran_order': False, 'shape': (1, 2), }";
+  header.append(63 - (10 + header.size()) % 64, ' ');
+  header += '\n';
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write("\x93NUMPY\x01\x00", 8);
+    const uint16_t header_size = header.size();
+    file.write(reinterpret_cast<const char*>(&header_size), 2);
+    file << header;
+    const int64_t data[2] = {1, -2};
+    file.write(reinterpret_cast<const char*>(data), sizeof(data));
+  }
+  const NpyArray<int32_t> array = ReadNpyArray<int32_t>(path);
+  EXPECT_EQ(array.shape, std::vector<size_t>({1, 2}));
+  EXPECT_EQ(array.data, std::vector<int32_t>({1, -2}));
+}
+
+TEST(Npy, ReadInvalid) {
+  const std::string path = CreateTestDir() + "/array.npy";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "not a numpy file";
+  }
+  EXPECT_ANY_THROW(ReadNpyArray<float>(path));
+  EXPECT_ANY_THROW(ReadNpyArray<float>(path + ".missing"));
+}
+
+}  // namespace
+}  // namespace colmap
@@ -33,58 +33,50 @@
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 
+#include <cstring>
 #include <fstream>
 
 #include <Eigen/Core>
 
 namespace colmap {
 
-std::vector<PlyPoint> ReadPly(const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
+namespace {
 
-  std::vector<PlyPoint> points;
+float ReadBinaryPlyProperty(const char* data,
+                            const bool is_double,
+                            const bool is_little_endian) {
+  if (is_double) {
+    double value;
+    std::memcpy(&value, data, sizeof(double));
+    return is_little_endian ? LittleEndianToNative(value)
+                            : BigEndianToNative(value);
+  } else {
+    float value;
+    std::memcpy(&value, data, sizeof(float));
+    return is_little_endian ? LittleEndianToNative(value)
+                            : BigEndianToNative(value);
+  }
+}
 
-  std::string line;
+}  // namespace
 
-  // The index of the property for ASCII PLY files.
-  int X_index = -1;
-  int Y_index = -1;
-  int Z_index = -1;
-  int NX_index = -1;
-  int NY_index = -1;
-  int NZ_index = -1;
-  int R_index = -1;
-  int G_index = -1;
-  int B_index = -1;
-
-  // The position in number of bytes of the property for binary PLY files.
-  int X_byte_pos = -1;
-  int Y_byte_pos = -1;
-  int Z_byte_pos = -1;
-  int NX_byte_pos = -1;
-  int NY_byte_pos = -1;
-  int NZ_byte_pos = -1;
-  int R_byte_pos = -1;
-  int G_byte_pos = -1;
-  int B_byte_pos = -1;
-
-  // Flag to use double precision in binary PLY files
-  bool X_double = false;
-  bool Y_double = false;
-  bool Z_double = false;
-  bool NX_double = false;
-  bool NY_double = false;
-  bool NZ_double = false;
+PlyPointReader::PlyPointReader(const std::string& path)
+    : file_(path, std::ios::binary),
+      is_binary_(false),
+      is_little_endian_(false),
+      is_normal_missing_(true),
+      is_rgb_missing_(true),
+      num_bytes_per_line_(0),
+      num_vertices_(0),
+      num_read_vertices_(0) {
+  THROW_CHECK_FILE_OPEN(file_, path);
+
+  std::string line;
 
   bool in_vertex_section = false;
-  bool is_binary = false;
-  bool is_little_endian = false;
-  size_t num_bytes_per_line = 0;
-  size_t num_vertices = 0;
 
   int index = 0;
-  while (std::getline(file, line)) {
+  while (std::getline(file_, line)) {
     StringTrim(&line);
 
     if (line.empty()) {
@@ -97,13 +89,13 @@ std::vector<PlyPoint> ReadPly(const std::string& path) {
 
     if (line.size() >= 6 && line.substr(0, 6) == "format") {
       if (line == "format ascii 1.0") {
-        is_binary = false;
+        is_binary_ = false;
       } else if (line == "format binary_little_endian 1.0") {
-        is_binary = true;
-        is_little_endian = true;
+        is_binary_ = true;
+        is_little_endian_ = true;
       } else if (line == "format binary_big_endian 1.0") {
-        is_binary = true;
-        is_little_endian = false;
+        is_binary_ = true;
+        is_little_endian_ = false;
       }
     }
 
@@ -112,7 +104,7 @@ std::vector<PlyPoint> ReadPly(const std::string& path) {
     if (line_elems.size() >= 3 && line_elems[0] == "element") {
       in_vertex_section = false;
       if (line_elems[1] == "vertex") {
-        num_vertices = std::stoll(line_elems[2]);
+        num_vertices_ = std::stoll(line_elems[2]);
         in_vertex_section = true;
       } else if (std::stoll(line_elems[2]) > 0) {
         LOG(WARNING) << "Only vertex elements supported; ignoring "
@@ -132,188 +124,155 @@ std::vector<PlyPoint> ReadPly(const std::string& path) {
                   line_elems[1] == "uchar")
           << "PLY import only supports float, double, and uchar data types";
 
+      Property* property = nullptr;
       if (line == "property float x" || line == "property float32 x" ||
           line == "property double x" || line == "property float64 x") {
-        X_index = index;
-        X_byte_pos = num_bytes_per_line;
-        X_double = (line_elems[1] == "double" || line_elems[1] == "float64");
+        property = &x_;
       } else if (line == "property float y" || line == "property float32 y" ||
                  line == "property double y" || line == "property float64 y") {
-        Y_index = index;
-        Y_byte_pos = num_bytes_per_line;
-        Y_double = (line_elems[1] == "double" || line_elems[1] == "float64");
+        property = &y_;
       } else if (line == "property float z" || line == "property float32 z" ||
                  line == "property double z" || line == "property float64 z") {
-        Z_index = index;
-        Z_byte_pos = num_bytes_per_line;
-        Z_double = (line_elems[1] == "double" || line_elems[1] == "float64");
+        property = &z_;
       } else if (line == "property float nx" || line == "property float32 nx" ||
                  line == "property double nx" ||
                  line == "property float64 nx") {
-        NX_index = index;
-        NX_byte_pos = num_bytes_per_line;
-        NX_double = (line_elems[1] == "double" || line_elems[1] == "float64");
+        property = &nx_;
       } else if (line == "property float ny" || line == "property float32 ny" ||
                  line == "property double ny" ||
                  line == "property float64 ny") {
-        NY_index = index;
-        NY_byte_pos = num_bytes_per_line;
-        NY_double = (line_elems[1] == "double" || line_elems[1] == "float64");
+        property = &ny_;
       } else if (line == "property float nz" || line == "property float32 nz" ||
                  line == "property double nz" ||
                  line == "property float64 nz") {
-        NZ_index = index;
-        NZ_byte_pos = num_bytes_per_line;
-        NZ_double = (line_elems[1] == "double" || line_elems[1] == "float64");
+        property = &nz_;
       } else if (line == "property uchar r" || line == "property uchar red" ||
                  line == "property uchar diffuse_red" ||
                  line == "property uchar ambient_red" ||
                  line == "property uchar specular_red") {
-        R_index = index;
-        R_byte_pos = num_bytes_per_line;
+        property = &r_;
       } else if (line == "property uchar g" || line == "property uchar green" ||
                  line == "property uchar diffuse_green" ||
                  line == "property uchar ambient_green" ||
                  line == "property uchar specular_green") {
-        G_index = index;
-        G_byte_pos = num_bytes_per_line;
+        property = &g_;
       } else if (line == "property uchar b" || line == "property uchar blue" ||
                  line == "property uchar diffuse_blue" ||
                  line == "property uchar ambient_blue" ||
                  line == "property uchar specular_blue") {
-        B_index = index;
-        B_byte_pos = num_bytes_per_line;
+        property = &b_;
+      }
+
+      if (property != nullptr) {
+        property->index = index;
+        property->byte_pos = num_bytes_per_line_;
+        property->is_double =
+            (line_elems[1] == "double" || line_elems[1] == "float64");
       }
 
       index += 1;
       if (line_elems[1] == "float" || line_elems[1] == "float32") {
-        num_bytes_per_line += 4;
+        num_bytes_per_line_ += 4;
       } else if (line_elems[1] == "double" || line_elems[1] == "float64") {
-        num_bytes_per_line += 8;
+        num_bytes_per_line_ += 8;
       } else if (line_elems[1] == "uchar") {
-        num_bytes_per_line += 1;
+        num_bytes_per_line_ += 1;
       } else {
         LOG(FATAL_THROW) << "Invalid data type: " << line_elems[1];
       }
     }
   }
 
-  const bool is_normal_missing =
-      (NX_index == -1) || (NY_index == -1) || (NZ_index == -1);
-  const bool is_rgb_missing =
-      (R_index == -1) || (G_index == -1) || (B_index == -1);
+  is_normal_missing_ =
+      (nx_.index == -1) || (ny_.index == -1) || (nz_.index == -1);
+  is_rgb_missing_ = (r_.index == -1) || (g_.index == -1) || (b_.index == -1);
 
-  THROW_CHECK(X_index != -1 && Y_index != -1 && Z_index != -1)
+  THROW_CHECK(x_.index != -1 && y_.index != -1 && z_.index != -1)
       << "Invalid PLY file format: x, y, z properties missing";
 
-  points.reserve(num_vertices);
-
-  if (is_binary) {
-    std::vector<char> buffer(num_bytes_per_line);
-    for (size_t i = 0; i < num_vertices; ++i) {
-      file.read(buffer.data(), num_bytes_per_line);
-
-      PlyPoint point;
-
-      if (is_little_endian) {
-        point.x = LittleEndianToNative(
-            X_double ? *reinterpret_cast<double*>(&buffer[X_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[X_byte_pos]));
-        point.y = LittleEndianToNative(
-            Y_double ? *reinterpret_cast<double*>(&buffer[Y_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Y_byte_pos]));
-        point.z = LittleEndianToNative(
-            Z_double ? *reinterpret_cast<double*>(&buffer[Z_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Z_byte_pos]));
-
-        if (!is_normal_missing) {
-          point.nx = LittleEndianToNative(
-              NX_double ? *reinterpret_cast<double*>(&buffer[NX_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NX_byte_pos]));
-          point.ny = LittleEndianToNative(
-              NY_double ? *reinterpret_cast<double*>(&buffer[NY_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NY_byte_pos]));
-          point.nz = LittleEndianToNative(
-              NZ_double ? *reinterpret_cast<double*>(&buffer[NZ_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NZ_byte_pos]));
-        }
-
-        if (!is_rgb_missing) {
-          point.r = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[R_byte_pos]));
-          point.g = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[G_byte_pos]));
-          point.b = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[B_byte_pos]));
-        }
-      } else {
-        point.x = BigEndianToNative(
-            X_double ? *reinterpret_cast<double*>(&buffer[X_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[X_byte_pos]));
-        point.y = BigEndianToNative(
-            Y_double ? *reinterpret_cast<double*>(&buffer[Y_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Y_byte_pos]));
-        point.z = BigEndianToNative(
-            Z_double ? *reinterpret_cast<double*>(&buffer[Z_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Z_byte_pos]));
-
-        if (!is_normal_missing) {
-          point.nx = BigEndianToNative(
-              NX_double ? *reinterpret_cast<double*>(&buffer[NX_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NX_byte_pos]));
-          point.ny = BigEndianToNative(
-              NY_double ? *reinterpret_cast<double*>(&buffer[NY_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NY_byte_pos]));
-          point.nz = BigEndianToNative(
-              NZ_double ? *reinterpret_cast<double*>(&buffer[NZ_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NZ_byte_pos]));
-        }
-
-        if (!is_rgb_missing) {
-          point.r = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[R_byte_pos]));
-          point.g = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[G_byte_pos]));
-          point.b = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[B_byte_pos]));
-        }
-      }
+  buffer_.resize(num_bytes_per_line_);
+}
+
+size_t PlyPointReader::NumPoints() const { return num_vertices_; }
 
-      points.push_back(point);
+bool PlyPointReader::Next(PlyPoint* point) {
+  *point = PlyPoint();
+
+  if (is_binary_) {
+    if (num_read_vertices_ >= num_vertices_) {
+      return false;
     }
-  } else {
-    while (std::getline(file, line)) {
-      StringTrim(&line);
-      std::stringstream line_stream(line);
-
-      std::string item;
-      std::vector<std::string> items;
-      while (!line_stream.eof()) {
-        std::getline(line_stream, item, ' ');
-        StringTrim(&item);
-        items.push_back(item);
-      }
+    num_read_vertices_ += 1;
 
-      PlyPoint point;
+    file_.read(buffer_.data(), num_bytes_per_line_);
 
-      point.x = std::stold(items.at(X_index));
-      point.y = std::stold(items.at(Y_index));
-      point.z = std::stold(items.at(Z_index));
+    const auto read_property = [this](const Property& property) {
+      return ReadBinaryPlyProperty(
+          &buffer_[property.byte_pos], property.is_double, is_little_endian_);
+    };
 
-      if (!is_normal_missing) {
-        point.nx = std::stold(items.at(NX_index));
-        point.ny = std::stold(items.at(NY_index));
-        point.nz = std::stold(items.at(NZ_index));
-      }
+    point->x = read_property(x_);
+    point->y = read_property(y_);
+    point->z = read_property(z_);
 
-      if (!is_rgb_missing) {
-        point.r = std::stoi(items.at(R_index));
-        point.g = std::stoi(items.at(G_index));
-        point.b = std::stoi(items.at(B_index));
-      }
+    if (!is_normal_missing_) {
+      point->nx = read_property(nx_);
+      point->ny = read_property(ny_);
+      point->nz = read_property(nz_);
+    }
+
+    if (!is_rgb_missing_) {
+      point->r = static_cast<uint8_t>(buffer_[r_.byte_pos]);
+      point->g = static_cast<uint8_t>(buffer_[g_.byte_pos]);
+      point->b = static_cast<uint8_t>(buffer_[b_.byte_pos]);
+    }
+  } else {
+    std::string line;
+    if (!std::getline(file_, line)) {
+      return false;
+    }
+    num_read_vertices_ += 1;
 
-      points.push_back(point);
+    StringTrim(&line);
+    std::stringstream line_stream(line);
+
+    std::string item;
+    std::vector<std::string> items;
+    while (!line_stream.eof()) {
+      std::getline(line_stream, item, ' ');
+      StringTrim(&item);
+      items.push_back(item);
     }
+
+    point->x = std::stold(items.at(x_.index));
+    point->y = std::stold(items.at(y_.index));
+    point->z = std::stold(items.at(z_.index));
+
+    if (!is_normal_missing_) {
+      point->nx = std::stold(items.at(nx_.index));
+      point->ny = std::stold(items.at(ny_.index));
+      point->nz = std::stold(items.at(nz_.index));
+    }
+
+    if (!is_rgb_missing_) {
+      point->r = std::stoi(items.at(r_.index));
+      point->g = std::stoi(items.at(g_.index));
+      point->b = std::stoi(items.at(b_.index));
+    }
+  }
+
+  return true;
+}
+
+std::vector<PlyPoint> ReadPly(const std::string& path) {
+  PlyPointReader reader(path);
+
+  std::vector<PlyPoint> points;
+  points.reserve(reader.NumPoints());
+
+  PlyPoint point;
+  while (reader.Next(&point)) {
+    points.push_back(point);
   }
 
   return points;
@@ -366,59 +325,91 @@ void WriteTextPlyPoints(const std::string& path,
   file.close();
 }
 
-void WriteBinaryPlyPoints(const std::string& path,
-                          const std::vector<PlyPoint>& points,
-                          const bool write_normal,
-                          const bool write_rgb) {
-  std::fstream text_file(path, std::ios::out);
-  THROW_CHECK_FILE_OPEN(text_file, path);
+namespace {
 
-  text_file << "ply" << std::endl;
-  text_file << "format binary_little_endian 1.0" << std::endl;
-  text_file << "element vertex " << points.size() << std::endl;
+// Width of the number of points in the header, which is padded with spaces,
+// such that it can be overwritten in place for any number of points.
+constexpr int kPlyNumPointsWidth = 20;
 
-  text_file << "property float x" << std::endl;
-  text_file << "property float y" << std::endl;
-  text_file << "property float z" << std::endl;
+}  // namespace
+
+PlyPointWriter::PlyPointWriter(const std::string& path,
+                               const bool write_normal,
+                               const bool write_rgb)
+    : path_(path),
+      write_normal_(write_normal),
+      write_rgb_(write_rgb),
+      file_(path, std::ios::out | std::ios::binary),
+      num_points_(0) {
+  THROW_CHECK_FILE_OPEN(file_, path);
+
+  file_ << "ply\n";
+  file_ << "format binary_little_endian 1.0\n";
+  file_ << "element vertex ";
+  num_points_pos_ = file_.tellp();
+  file_ << std::string(kPlyNumPointsWidth, ' ') << "\n";
+
+  file_ << "property float x\n";
+  file_ << "property float y\n";
+  file_ << "property float z\n";
 
   if (write_normal) {
-    text_file << "property float nx" << std::endl;
-    text_file << "property float ny" << std::endl;
-    text_file << "property float nz" << std::endl;
+    file_ << "property float nx\n";
+    file_ << "property float ny\n";
+    file_ << "property float nz\n";
   }
 
   if (write_rgb) {
-    text_file << "property uchar red" << std::endl;
-    text_file << "property uchar green" << std::endl;
-    text_file << "property uchar blue" << std::endl;
+    file_ << "property uchar red\n";
+    file_ << "property uchar green\n";
+    file_ << "property uchar blue\n";
   }
 
-  text_file << "end_header" << std::endl;
-  text_file.close();
+  file_ << "end_header\n";
+}
 
-  std::fstream binary_file(path,
-                           std::ios::out | std::ios::binary | std::ios::app);
-  THROW_CHECK_FILE_OPEN(binary_file, path);
+size_t PlyPointWriter::NumPoints() const { return num_points_; }
 
-  for (const auto& point : points) {
-    WriteBinaryLittleEndian<float>(&binary_file, point.x);
-    WriteBinaryLittleEndian<float>(&binary_file, point.y);
-    WriteBinaryLittleEndian<float>(&binary_file, point.z);
+void PlyPointWriter::Write(const PlyPoint& point) {
+  num_points_ += 1;
 
-    if (write_normal) {
-      WriteBinaryLittleEndian<float>(&binary_file, point.nx);
-      WriteBinaryLittleEndian<float>(&binary_file, point.ny);
-      WriteBinaryLittleEndian<float>(&binary_file, point.nz);
-    }
+  WriteBinaryLittleEndian<float>(&file_, point.x);
+  WriteBinaryLittleEndian<float>(&file_, point.y);
+  WriteBinaryLittleEndian<float>(&file_, point.z);
 
-    if (write_rgb) {
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.r);
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.g);
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.b);
-    }
+  if (write_normal_) {
+    WriteBinaryLittleEndian<float>(&file_, point.nx);
+    WriteBinaryLittleEndian<float>(&file_, point.ny);
+    WriteBinaryLittleEndian<float>(&file_, point.nz);
   }
 
-  binary_file.close();
+  if (write_rgb_) {
+    WriteBinaryLittleEndian<uint8_t>(&file_, point.r);
+    WriteBinaryLittleEndian<uint8_t>(&file_, point.g);
+    WriteBinaryLittleEndian<uint8_t>(&file_, point.b);
+  }
+}
+
+void PlyPointWriter::Write(const std::vector<PlyPoint>& points) {
+  for (const auto& point : points) {
+    Write(point);
+  }
+}
+
+void PlyPointWriter::Close() {
+  file_.seekp(num_points_pos_);
+  file_ << num_points_;
+  file_.close();
+  THROW_CHECK(!file_.fail()) << "Failed to write PLY file: " << path_;
+}
+
+void WriteBinaryPlyPoints(const std::string& path,
+                          const std::vector<PlyPoint>& points,
+                          const bool write_normal,
+                          const bool write_rgb) {
+  PlyPointWriter writer(path, write_normal, write_rgb);
+  writer.Write(points);
+  writer.Close();
 }
 
 void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh) {
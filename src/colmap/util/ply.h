@@ -31,6 +31,7 @@
 
 #include "colmap/util/types.h"
 
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -77,6 +78,76 @@ struct PlyMesh {
   std::vector<PlyMeshFace> faces;
 };
 
+// Streaming reader of PLY point clouds in text or binary format, which reads
+// one point at a time, such that arbitrarily large files can be processed
+// with constant memory.
+class PlyPointReader {
+ public:
+  explicit PlyPointReader(const std::string& path);
+
+  // Number of points declared in the header.
+  size_t NumPoints() const;
+
+  // Read the next point. Returns false if all points were read.
+  bool Next(PlyPoint* point);
+
+ private:
+  struct Property {
+    // Index of the property for ASCII PLY files.
+    int index = -1;
+    // Position in number of bytes of the property for binary PLY files.
+    int byte_pos = -1;
+    // Flag to use double precision in binary PLY files.
+    bool is_double = false;
+  };
+
+  std::ifstream file_;
+  Property x_;
+  Property y_;
+  Property z_;
+  Property nx_;
+  Property ny_;
+  Property nz_;
+  Property r_;
+  Property g_;
+  Property b_;
+  bool is_binary_;
+  bool is_little_endian_;
+  bool is_normal_missing_;
+  bool is_rgb_missing_;
+  size_t num_bytes_per_line_;
+  size_t num_vertices_;
+  size_t num_read_vertices_;
+  std::vector<char> buffer_;
+};
+
+// Streaming writer of binary PLY point clouds, which appends one point at a
+// time, such that the points never have to be in memory at once. The number
+// of points in the header is a placeholder until the file is closed.
+class PlyPointWriter {
+ public:
+  explicit PlyPointWriter(const std::string& path,
+                          bool write_normal = true,
+                          bool write_rgb = true);
+
+  size_t NumPoints() const;
+
+  // Append the next point(s).
+  void Write(const PlyPoint& point);
+  void Write(const std::vector<PlyPoint>& points);
+
+  // Write the number of points into the header and close the file.
+  void Close();
+
+ private:
+  const std::string path_;
+  const bool write_normal_;
+  const bool write_rgb_;
+  std::fstream file_;
+  std::streampos num_points_pos_;
+  size_t num_points_;
+};
+
 // Read PLY point cloud from text or binary file.
 std::vector<PlyPoint> ReadPly(const std::string& path);
 
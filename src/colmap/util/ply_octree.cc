@@ -0,0 +1,516 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/ply_octree.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace {
+
+// Depth of the grid that counts the points to partition them into subtrees.
+constexpr int kMaxCountingDepth = 7;
+
+// Maximum number of points that are buffered per subtree before they are
+// appended to its temporary file.
+constexpr size_t kMaxNumBufferedPointsPerSubtree = 4096;
+
+struct OctreeNode {
+  std::string name;
+  int depth = 0;
+  size_t num_points = 0;
+  Eigen::Vector3d min = Eigen::Vector3d::Zero();
+  double size = 0;
+};
+
+class PlyOctreeBuilder {
+ public:
+  PlyOctreeBuilder(const PlyOctreeOptions& options, const std::string& path)
+      : options_(options), path_(path) {}
+
+  void Build(const PlyPointSource& point_source) {
+    ComputeBounds(point_source);
+    PartitionSubtrees(point_source);
+    SpillSubtrees(point_source);
+
+    std::vector<PlyPoint> root_points = BuildNode(0, Eigen::Vector3i::Zero());
+    WriteNode("r", 0, Eigen::Vector3i::Zero(), root_points);
+    WriteHierarchy();
+  }
+
+ private:
+  void ComputeBounds(const PlyPointSource& point_source) {
+    Eigen::Vector3d min =
+        Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Vector3d max =
+        Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+    num_points_ = 0;
+    point_source([&](const PlyPoint& point) {
+      const Eigen::Vector3d xyz(point.x, point.y, point.z);
+      min = min.cwiseMin(xyz);
+      max = max.cwiseMax(xyz);
+      num_points_ += 1;
+    });
+    if (num_points_ == 0) {
+      min_.setZero();
+      size_ = 1;
+      return;
+    }
+    // The nodes are cubes, such that the sampling grids are isotropic. The
+    // cube is slightly enlarged to contain the maximum coordinates.
+    min_ = min;
+    size_ = std::max((max - min).maxCoeff(), 1e-6) * (1 + 1e-6);
+  }
+
+  // Integer coordinates of the node at the given depth that contains the
+  // point. All nodes are derived from these coordinates, such that the
+  // partitioning is consistent across all passes.
+  Eigen::Vector3i NodeCoords(const PlyPoint& point, const int depth) const {
+    const int num_cells = 1 << depth;
+    const Eigen::Vector3d rel =
+        (Eigen::Vector3d(point.x, point.y, point.z) - min_) / size_;
+    return (rel * num_cells)
+        .array()
+        .floor()
+        .cast<int>()
+        .max(0)
+        .min(num_cells - 1)
+        .matrix();
+  }
+
+  static size_t CellIndex(const Eigen::Vector3i& coords, const int depth) {
+    const size_t num_cells = size_t(1) << depth;
+    return (static_cast<size_t>(coords.x()) * num_cells + coords.y()) *
+               num_cells +
+           coords.z();
+  }
+
+  // Count the points in a coarse grid and split the octree top-down until
+  // every subtree contains at most the maximum number of points in memory.
+  void PartitionSubtrees(const PlyPointSource& point_source) {
+    counting_depth_ = std::min(kMaxCountingDepth, options_.max_depth);
+    const size_t num_cells = size_t(1) << (3 * counting_depth_);
+    std::vector<std::vector<uint64_t>> counts(counting_depth_ + 1);
+    counts[counting_depth_].resize(num_cells, 0);
+    point_source([&](const PlyPoint& point) {
+      counts[counting_depth_][CellIndex(NodeCoords(point, counting_depth_),
+                                        counting_depth_)] += 1;
+    });
+    for (int depth = counting_depth_ - 1; depth >= 0; --depth) {
+      const int num_depth_cells = 1 << depth;
+      counts[depth].resize(size_t(1) << (3 * depth), 0);
+      for (int x = 0; x < 2 * num_depth_cells; ++x) {
+        for (int y = 0; y < 2 * num_depth_cells; ++y) {
+          for (int z = 0; z < 2 * num_depth_cells; ++z) {
+            counts[depth][CellIndex(Eigen::Vector3i(x / 2, y / 2, z / 2),
+                                    depth)] +=
+                counts[depth + 1][CellIndex(Eigen::Vector3i(x, y, z),
+                                            depth + 1)];
+          }
+        }
+      }
+    }
+
+    subtree_idxs_.assign(num_cells, -1);
+    PartitionSubtree(counts, 0, Eigen::Vector3i::Zero());
+  }
+
+  void PartitionSubtree(const std::vector<std::vector<uint64_t>>& counts,
+                        const int depth,
+                        const Eigen::Vector3i& coords) {
+    const uint64_t count = counts[depth][CellIndex(coords, depth)];
+    if (count == 0) {
+      return;
+    }
+    if (count <= static_cast<uint64_t>(options_.max_num_points_in_memory) ||
+        depth == counting_depth_) {
+      const int subtree_idx = subtrees_.size();
+      subtrees_.push_back({depth, coords});
+      subtree_node_idxs_.emplace(NodeKey(depth, coords), subtree_idx);
+      // Map all counting cells of the subtree to the subtree.
+      const int num_sub_cells = 1 << (counting_depth_ - depth);
+      const Eigen::Vector3i begin = coords * num_sub_cells;
+      for (int x = 0; x < num_sub_cells; ++x) {
+        for (int y = 0; y < num_sub_cells; ++y) {
+          for (int z = 0; z < num_sub_cells; ++z) {
+            subtree_idxs_[CellIndex(begin + Eigen::Vector3i(x, y, z),
+                                    counting_depth_)] = subtree_idx;
+          }
+        }
+      }
+      return;
+    }
+    upper_node_keys_.insert(NodeKey(depth, coords));
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      PartitionSubtree(counts, depth + 1, ChildCoords(coords, child_idx));
+    }
+  }
+
+  // Unique key of the node at the given depth and coordinates.
+  static uint64_t NodeKey(const int depth, const Eigen::Vector3i& coords) {
+    return (static_cast<uint64_t>(depth) << 32) | CellIndex(coords, depth);
+  }
+
+  // Distribute the points to the temporary files of their subtrees.
+  void SpillSubtrees(const PlyPointSource& point_source) {
+    const size_t max_num_buffered_points = std::max<size_t>(
+        1,
+        std::min(kMaxNumBufferedPointsPerSubtree,
+                 options_.max_num_points_in_memory /
+                     std::max<size_t>(1, subtrees_.size())));
+    std::vector<std::vector<PlyPoint>> buffers(subtrees_.size());
+    for (size_t i = 0; i < subtrees_.size(); ++i) {
+      // Truncate files of previous runs.
+      std::ofstream file(SubtreePath(i), std::ios::trunc | std::ios::binary);
+      THROW_CHECK_FILE_OPEN(file, SubtreePath(i));
+    }
+    point_source([&](const PlyPoint& point) {
+      const int subtree_idx = subtree_idxs_[CellIndex(
+          NodeCoords(point, counting_depth_), counting_depth_)];
+      std::vector<PlyPoint>& buffer = buffers[subtree_idx];
+      buffer.push_back(point);
+      if (buffer.size() >= max_num_buffered_points) {
+        AppendSubtreePoints(subtree_idx, &buffer);
+      }
+    });
+    for (size_t i = 0; i < subtrees_.size(); ++i) {
+      AppendSubtreePoints(i, &buffers[i]);
+    }
+  }
+
+  std::string SubtreePath(const size_t subtree_idx) const {
+    return JoinPaths(path_, "subtree" + std::to_string(subtree_idx) + ".tmp");
+  }
+
+  void AppendSubtreePoints(const size_t subtree_idx,
+                           std::vector<PlyPoint>* points) {
+    if (points->empty()) {
+      return;
+    }
+    const std::string subtree_path = SubtreePath(subtree_idx);
+    std::ofstream file(subtree_path, std::ios::app | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, subtree_path);
+    file.write(reinterpret_cast<const char*>(points->data()),
+               points->size() * sizeof(PlyPoint));
+    THROW_CHECK(file.good()) << "Failed to write " << subtree_path;
+    points->clear();
+  }
+
+  std::vector<PlyPoint> ReadSubtreePoints(const size_t subtree_idx) {
+    const std::string subtree_path = SubtreePath(subtree_idx);
+    std::vector<PlyPoint> points;
+    {
+      std::ifstream file(subtree_path, std::ios::binary);
+      THROW_CHECK_FILE_OPEN(file, subtree_path);
+      points.resize(GetFileSize(subtree_path) / sizeof(PlyPoint));
+      file.read(reinterpret_cast<char*>(points.data()),
+                points.size() * sizeof(PlyPoint));
+      THROW_CHECK(file.good()) << "Failed to read " << subtree_path;
+    }
+    std::remove(subtree_path.c_str());
+    return points;
+  }
+
+  static Eigen::Vector3i ChildCoords(const Eigen::Vector3i& coords,
+                                     const int child_idx) {
+    return 2 * coords + Eigen::Vector3i((child_idx >> 2) & 1,
+                                        (child_idx >> 1) & 1,
+                                        child_idx & 1);
+  }
+
+  static std::string ChildName(const std::string& name, const int child_idx) {
+    return name + std::to_string(child_idx);
+  }
+
+  // Build the nodes above the subtrees from the subsampled points of the
+  // subtree roots, which are returned by the recursion.
+  std::vector<PlyPoint> BuildNode(const int depth,
+                                  const Eigen::Vector3i& coords,
+                                  const std::string& name = "r") {
+    const uint64_t node_key = NodeKey(depth, coords);
+    const auto subtree_it = subtree_node_idxs_.find(node_key);
+    if (subtree_it != subtree_node_idxs_.end()) {
+      return BuildNode(
+          depth, coords, name, ReadSubtreePoints(subtree_it->second));
+    }
+    if (upper_node_keys_.count(node_key) == 0) {
+      return {};
+    }
+
+    std::vector<std::vector<PlyPoint>> children_points(8);
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      children_points[child_idx] = BuildNode(depth + 1,
+                                             ChildCoords(coords, child_idx),
+                                             ChildName(name, child_idx));
+    }
+    return SubsampleChildren(depth, coords, name, &children_points);
+  }
+
+  // Build the nodes of a subtree, whose points are in memory.
+  std::vector<PlyPoint> BuildNode(const int depth,
+                                  const Eigen::Vector3i& coords,
+                                  const std::string& name,
+                                  std::vector<PlyPoint> points) {
+    if (points.size() <=
+            static_cast<size_t>(options_.max_num_points_per_node) ||
+        depth == options_.max_depth) {
+      return points;
+    }
+
+    std::vector<std::vector<PlyPoint>> children_points(8);
+    for (const PlyPoint& point : points) {
+      const Eigen::Vector3i child_coords = NodeCoords(point, depth + 1);
+      const Eigen::Vector3i offset = child_coords - 2 * coords;
+      children_points[(offset.x() << 2) | (offset.y() << 1) | offset.z()]
+          .push_back(point);
+    }
+    points.clear();
+    points.shrink_to_fit();
+
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      if (!children_points[child_idx].empty()) {
+        children_points[child_idx] =
+            BuildNode(depth + 1,
+                      ChildCoords(coords, child_idx),
+                      ChildName(name, child_idx),
+                      std::move(children_points[child_idx]));
+      }
+    }
+
+    return SubsampleChildren(depth, coords, name, &children_points);
+  }
+
+  // Move the point closest to the center of every occupied cell of the
+  // sampling grid from the children to the node and write the children.
+  std::vector<PlyPoint> SubsampleChildren(
+      const int depth,
+      const Eigen::Vector3i& coords,
+      const std::string& name,
+      std::vector<std::vector<PlyPoint>>* children_points) {
+    const int grid_size = options_.grid_size;
+    const double cell_size = size_ / (1 << depth) / grid_size;
+    const Eigen::Vector3d node_min =
+        min_ + coords.cast<double>() * (size_ / (1 << depth));
+
+    struct Sample {
+      int child_idx;
+      size_t point_idx;
+      double sq_dist;
+    };
+    std::unordered_map<size_t, Sample> samples;
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      const std::vector<PlyPoint>& points = (*children_points)[child_idx];
+      for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+        const PlyPoint& point = points[point_idx];
+        const Eigen::Vector3d rel =
+            (Eigen::Vector3d(point.x, point.y, point.z) - node_min) /
+            cell_size;
+        const Eigen::Vector3i cell = rel.array()
+                                         .floor()
+                                         .cast<int>()
+                                         .max(0)
+                                         .min(grid_size - 1)
+                                         .matrix();
+        const double sq_dist =
+            (rel - cell.cast<double>() - Eigen::Vector3d::Constant(0.5))
+                .squaredNorm();
+        const size_t cell_idx =
+            (static_cast<size_t>(cell.x()) * grid_size + cell.y()) *
+                grid_size +
+            cell.z();
+        const auto it = samples.find(cell_idx);
+        if (it == samples.end()) {
+          samples.emplace(cell_idx, Sample{child_idx, point_idx, sq_dist});
+        } else if (sq_dist < it->second.sq_dist) {
+          it->second = Sample{child_idx, point_idx, sq_dist};
+        }
+      }
+    }
+
+    std::vector<std::vector<bool>> is_sampled(8);
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      is_sampled[child_idx].resize((*children_points)[child_idx].size(), false);
+    }
+    for (const auto& [_, sample] : samples) {
+      is_sampled[sample.child_idx][sample.point_idx] = true;
+    }
+
+    std::vector<PlyPoint> points;
+    points.reserve(samples.size());
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      std::vector<PlyPoint>& child_points = (*children_points)[child_idx];
+      if (child_points.empty()) {
+        continue;
+      }
+      std::vector<PlyPoint> remaining_points;
+      remaining_points.reserve(child_points.size());
+      for (size_t point_idx = 0; point_idx < child_points.size();
+           ++point_idx) {
+        if (is_sampled[child_idx][point_idx]) {
+          points.push_back(child_points[point_idx]);
+        } else {
+          remaining_points.push_back(child_points[point_idx]);
+        }
+      }
+      child_points.clear();
+      child_points.shrink_to_fit();
+      WriteNode(ChildName(name, child_idx),
+                depth + 1,
+                ChildCoords(coords, child_idx),
+                remaining_points);
+    }
+
+    return points;
+  }
+
+  void WriteNode(const std::string& name,
+                 const int depth,
+                 const Eigen::Vector3i& coords,
+                 const std::vector<PlyPoint>& points) {
+    WriteBinaryPlyPoints(JoinPaths(path_, name + ".ply"),
+                         points,
+                         options_.write_normal,
+                         /*write_rgb=*/true);
+    OctreeNode node;
+    node.name = name;
+    node.depth = depth;
+    node.num_points = points.size();
+    node.size = size_ / (1 << depth);
+    node.min = min_ + coords.cast<double>() * node.size;
+    nodes_.push_back(node);
+  }
+
+  void WriteHierarchy() const {
+    std::vector<OctreeNode> nodes = nodes_;
+    std::sort(nodes.begin(),
+              nodes.end(),
+              [](const OctreeNode& node1, const OctreeNode& node2) {
+                if (node1.depth != node2.depth) {
+                  return node1.depth < node2.depth;
+                }
+                return node1.name < node2.name;
+              });
+
+    const std::string hierarchy_path = JoinPaths(path_, "hierarchy.txt");
+    std::ofstream file(hierarchy_path, std::ios::trunc);
+    THROW_CHECK_FILE_OPEN(file, hierarchy_path);
+
+    // Ensure that we don't loose any precision by storing in text.
+    file.precision(17);
+
+    file << "# Octree node list with one line of data per node:" << std::endl;
+    file << "#   NAME, DEPTH, NUM_POINTS, MIN_X, MIN_Y, MIN_Z, SIZE"
+         << std::endl;
+    file << "# Number of nodes: " << nodes.size()
+         << ", number of points: " << num_points_ << std::endl;
+    for (const OctreeNode& node : nodes) {
+      file << node.name << " " << node.depth << " " << node.num_points << " "
+           << node.min.x() << " " << node.min.y() << " " << node.min.z()
+           << " " << node.size << std::endl;
+    }
+  }
+
+  struct Subtree {
+    int depth;
+    Eigen::Vector3i coords;
+  };
+
+  const PlyOctreeOptions options_;
+  const std::string path_;
+  size_t num_points_ = 0;
+  Eigen::Vector3d min_ = Eigen::Vector3d::Zero();
+  double size_ = 1;
+  int counting_depth_ = 0;
+  std::vector<Subtree> subtrees_;
+  std::vector<int> subtree_idxs_;
+  std::unordered_map<uint64_t, int> subtree_node_idxs_;
+  std::unordered_set<uint64_t> upper_node_keys_;
+  std::vector<OctreeNode> nodes_;
+};
+
+}  // namespace
+
+bool PlyOctreeOptions::Check() const {
+  CHECK_OPTION_GT(max_num_points_per_node, 0);
+  CHECK_OPTION_GT(grid_size, 0);
+  CHECK_OPTION_GE(max_depth, 0);
+  CHECK_OPTION_LE(max_depth, 20);
+  CHECK_OPTION_GE(max_num_points_in_memory, max_num_points_per_node);
+  return true;
+}
+
+void WritePlyOctree(const PlyPointSource& point_source,
+                    const std::string& path,
+                    const PlyOctreeOptions& options) {
+  THROW_CHECK(options.Check());
+  THROW_CHECK_DIR_EXISTS(path);
+  PlyOctreeBuilder builder(options, path);
+  builder.Build(point_source);
+}
+
+void WritePlyOctree(const std::string& ply_path,
+                    const std::string& path,
+                    const PlyOctreeOptions& options) {
+  WritePlyOctree(
+      [&ply_path](const std::function<void(const PlyPoint&)>& callback) {
+        PlyPointReader reader(ply_path);
+        PlyPoint point;
+        while (reader.Next(&point)) {
+          callback(point);
+        }
+      },
+      path,
+      options);
+}
+
+void WritePlyOctree(const std::vector<PlyPoint>& points,
+                    const std::string& path,
+                    const PlyOctreeOptions& options) {
+  WritePlyOctree(
+      [&points](const std::function<void(const PlyPoint&)>& callback) {
+        for (const PlyPoint& point : points) {
+          callback(point);
+        }
+      },
+      path,
+      options);
+}
+
+}  // namespace colmap
@@ -0,0 +1,95 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/util/ply.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+struct PlyOctreeOptions {
+  // Nodes with more points are split into eight children, unless the maximum
+  // depth is reached.
+  int max_num_points_per_node = 20000;
+
+  // Resolution of the sampling grid of inner nodes along every axis. Inner
+  // nodes keep the point closest to the center of every occupied grid cell of
+  // their children, such that every level is a spatially uniform subsample of
+  // the next finer level.
+  int grid_size = 128;
+
+  // Maximum depth of the octree, where the root has depth zero.
+  int max_depth = 20;
+
+  // Maximum number of points that are held in memory. The points are first
+  // partitioned into subtrees of at most this many points, which are spilled
+  // to temporary files and built one at a time.
+  int max_num_points_in_memory = 10000000;
+
+  // Whether to write the normals of the points to the node files.
+  bool write_normal = true;
+
+  bool Check() const;
+};
+
+// Level-of-detail export of point clouds for viewers that stream large point
+// clouds. The output directory contains one binary PLY file per octree node
+// and a hierarchy index `hierarchy.txt`. Nodes are named by the path from the
+// root "r" followed by the child indices (x << 2) | (y << 1) | z, e.g., "r05"
+// is the child 5 of the child 0 of the root. The points of the node files are
+// disjoint and the union of a node with all its ancestors is the level of
+// detail at the depth of the node.
+//
+// The point source is called repeatedly and must pass the same points to its
+// callback every time, such that the points never need to be in memory at
+// once.
+using PlyPointSource =
+    std::function<void(const std::function<void(const PlyPoint&)>&)>;
+
+void WritePlyOctree(const PlyPointSource& point_source,
+                    const std::string& path,
+                    const PlyOctreeOptions& options = PlyOctreeOptions());
+
+// Same as above for the points of a text or binary PLY file, which is
+// streamed from disk.
+void WritePlyOctree(const std::string& ply_path,
+                    const std::string& path,
+                    const PlyOctreeOptions& options = PlyOctreeOptions());
+
+// Same as above for points in memory.
+void WritePlyOctree(const std::vector<PlyPoint>& points,
+                    const std::string& path,
+                    const PlyOctreeOptions& options = PlyOctreeOptions());
+
+}  // namespace colmap
@@ -0,0 +1,194 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/ply_octree.h"
+
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+struct HierarchyNode {
+  int depth = 0;
+  size_t num_points = 0;
+  Eigen::Vector3d min;
+  double size = 0;
+};
+
+std::unordered_map<std::string, HierarchyNode> ReadHierarchy(
+    const std::string& path) {
+  std::unordered_map<std::string, HierarchyNode> nodes;
+  for (const std::string& line :
+       ReadTextFileLines(JoinPaths(path, "hierarchy.txt"))) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream line_stream(line);
+    std::string name;
+    HierarchyNode node;
+    line_stream >> name >> node.depth >> node.num_points >> node.min.x() >>
+        node.min.y() >> node.min.z() >> node.size;
+    nodes.emplace(name, node);
+  }
+  return nodes;
+}
+
+std::vector<PlyPoint> GenerateRandomPoints(const size_t num_points) {
+  std::vector<PlyPoint> points(num_points);
+  for (size_t i = 0; i < num_points; ++i) {
+    const Eigen::Vector3f xyz = Eigen::Vector3f::Random();
+    points[i].x = xyz.x();
+    // Points on a thin slab, such that the octree is unbalanced.
+    points[i].y = 0.1f * xyz.y();
+    points[i].z = xyz.z() + 5;
+    points[i].r = i % 256;
+  }
+  return points;
+}
+
+void ExpectValidOctree(const std::string& path,
+                       const std::vector<PlyPoint>& points,
+                       const PlyOctreeOptions& options) {
+  const std::unordered_map<std::string, HierarchyNode> nodes =
+      ReadHierarchy(path);
+  ASSERT_GT(nodes.count("r"), 0);
+
+  std::vector<PlyPoint> octree_points;
+  for (const auto& [name, node] : nodes) {
+    EXPECT_EQ(node.depth, name.size() - 1);
+    EXPECT_LE(node.depth, options.max_depth);
+    if (name != "r") {
+      EXPECT_GT(nodes.count(name.substr(0, name.size() - 1)), 0);
+    }
+
+    const std::vector<PlyPoint> node_points =
+        ReadPly(JoinPaths(path, name + ".ply"));
+    EXPECT_EQ(node_points.size(), node.num_points);
+    const bool is_leaf = std::none_of(
+        nodes.begin(), nodes.end(), [&name = name](const auto& other) {
+          return other.first.size() == name.size() + 1 &&
+                 other.first.compare(0, name.size(), name) == 0;
+        });
+    if (is_leaf) {
+      EXPECT_LE(node_points.size(), options.max_num_points_per_node);
+    } else {
+      EXPECT_LE(node_points.size(),
+                static_cast<size_t>(options.grid_size) * options.grid_size *
+                    options.grid_size);
+    }
+    for (const PlyPoint& point : node_points) {
+      const Eigen::Vector3d xyz(point.x, point.y, point.z);
+      EXPECT_TRUE((xyz.array() >= node.min.array() - 1e-6).all());
+      EXPECT_TRUE((xyz.array() <= node.min.array() + node.size + 1e-6).all());
+      octree_points.push_back(point);
+    }
+  }
+
+  // The nodes partition the input points.
+  const auto point_less = [](const PlyPoint& point1, const PlyPoint& point2) {
+    return std::make_tuple(point1.x, point1.y, point1.z) <
+           std::make_tuple(point2.x, point2.y, point2.z);
+  };
+  std::vector<PlyPoint> sorted_points = points;
+  std::sort(sorted_points.begin(), sorted_points.end(), point_less);
+  std::sort(octree_points.begin(), octree_points.end(), point_less);
+  ASSERT_EQ(octree_points.size(), sorted_points.size());
+  for (size_t i = 0; i < sorted_points.size(); ++i) {
+    EXPECT_EQ(octree_points[i].x, sorted_points[i].x);
+    EXPECT_EQ(octree_points[i].y, sorted_points[i].y);
+    EXPECT_EQ(octree_points[i].z, sorted_points[i].z);
+    EXPECT_EQ(octree_points[i].r, sorted_points[i].r);
+  }
+}
+
+TEST(WritePlyOctree, Nominal) {
+  const std::vector<PlyPoint> points = GenerateRandomPoints(20000);
+  PlyOctreeOptions options;
+  options.max_num_points_per_node = 500;
+  options.grid_size = 8;
+  options.max_num_points_in_memory = 2000;
+  const std::string path = CreateTestDir();
+  WritePlyOctree(points, path, options);
+  ExpectValidOctree(path, points, options);
+  // The temporary files of the subtrees are removed.
+  for (const std::string& file : GetFileList(path)) {
+    EXPECT_TRUE(HasFileExtension(file, ".ply") ||
+                HasFileExtension(file, ".txt"));
+  }
+}
+
+TEST(WritePlyOctree, FromPlyFile) {
+  const std::vector<PlyPoint> points = GenerateRandomPoints(5000);
+  const std::string test_dir = CreateTestDir();
+  const std::string ply_path = JoinPaths(test_dir, "points.ply");
+  WriteBinaryPlyPoints(ply_path, points);
+  const std::string path = JoinPaths(test_dir, "octree");
+  CreateDirIfNotExists(path);
+  PlyOctreeOptions options;
+  options.max_num_points_per_node = 200;
+  options.grid_size = 4;
+  options.max_num_points_in_memory = 1000;
+  WritePlyOctree(ply_path, path, options);
+  ExpectValidOctree(path, points, options);
+}
+
+TEST(WritePlyOctree, MaxDepth) {
+  // Duplicate points cannot be split and end up in the leaf at maximum depth.
+  std::vector<PlyPoint> points(100);
+  points.push_back(PlyPoint());
+  points.back().x = 1;
+  PlyOctreeOptions options;
+  options.max_num_points_per_node = 10;
+  options.max_depth = 3;
+  const std::string path = CreateTestDir();
+  WritePlyOctree(points, path, options);
+  const auto nodes = ReadHierarchy(path);
+  EXPECT_EQ(nodes.at("r").num_points, 2);
+  EXPECT_EQ(nodes.at("r000").num_points, 99);
+}
+
+TEST(WritePlyOctree, Empty) {
+  const std::string path = CreateTestDir();
+  WritePlyOctree(std::vector<PlyPoint>(), path);
+  const auto nodes = ReadHierarchy(path);
+  ASSERT_EQ(nodes.size(), 1);
+  EXPECT_EQ(nodes.at("r").num_points, 0);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -0,0 +1,234 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/profiler.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/string.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <unordered_map>
+
+namespace colmap {
+namespace {
+
+void WriteJSONString(const char* str, std::ostream& stream) {
+  stream << '"';
+  for (const char* c = str; *c != '\0'; ++c) {
+    switch (*c) {
+      case '"':
+        stream << "\\\"";
+        break;
+      case '\\':
+        stream << "\\\\";
+        break;
+      case '\n':
+        stream << "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(*c) < 0x20) {
+          stream << "\\u00" << std::hex << std::setw(2) << std::setfill('0')
+                 << static_cast<int>(*c) << std::dec;
+        } else {
+          stream << *c;
+        }
+    }
+  }
+  stream << '"';
+}
+
+}  // namespace
+
+struct Profiler::ThreadBuffer {
+  int thread_idx = -1;
+  // Only locked by the owning thread and when reading the regions.
+  std::mutex mutex;
+  std::vector<Region> open_regions;
+  std::vector<Region> finished_regions;
+};
+
+Profiler& Profiler::Instance() {
+  static Profiler profiler;
+  return profiler;
+}
+
+Profiler::Profiler()
+    : enabled_(false), start_time_(std::chrono::steady_clock::now()) {}
+
+void Profiler::SetEnabled(const bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::Start(const std::string& trace_path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trace_path_ = trace_path;
+  }
+  SetEnabled(true);
+}
+
+void Profiler::Finish() {
+  SetEnabled(false);
+  std::string trace_path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trace_path = trace_path_;
+  }
+  if (trace_path.empty()) {
+    return;
+  }
+  WriteChromeTrace(trace_path);
+  LOG(INFO) << "Wrote profile to " << trace_path;
+  for (const auto& summary : Summary()) {
+    LOG(INFO) << StringPrintf("%s: %d calls, %.3fs total, %.3fs max",
+                              summary.name.c_str(),
+                              static_cast<int>(summary.num_calls),
+                              summary.total_seconds,
+                              summary.max_seconds);
+  }
+}
+
+void Profiler::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> buffer_lock(thread_buffer->mutex);
+    thread_buffer->finished_regions.clear();
+  }
+}
+
+std::vector<Profiler::Region> Profiler::Regions() const {
+  std::vector<Region> regions;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> buffer_lock(thread_buffer->mutex);
+    const size_t num_prev_regions = regions.size();
+    regions.insert(regions.end(),
+                   thread_buffer->finished_regions.begin(),
+                   thread_buffer->finished_regions.end());
+    // The regions are finished inside-out, so the nested regions come first.
+    std::sort(regions.begin() + num_prev_regions,
+              regions.end(),
+              [](const Region& region1, const Region& region2) {
+                if (region1.begin_us == region2.begin_us) {
+                  return region1.depth < region2.depth;
+                }
+                return region1.begin_us < region2.begin_us;
+              });
+  }
+  return regions;
+}
+
+std::vector<Profiler::RegionSummary> Profiler::Summary() const {
+  std::unordered_map<std::string, RegionSummary> summaries;
+  for (const auto& region : Regions()) {
+    RegionSummary& summary = summaries[region.name];
+    summary.name = region.name;
+    summary.num_calls += 1;
+    const double seconds = (region.end_us - region.begin_us) / 1e6;
+    summary.total_seconds += seconds;
+    summary.max_seconds = std::max(summary.max_seconds, seconds);
+  }
+
+  std::vector<RegionSummary> sorted_summaries;
+  sorted_summaries.reserve(summaries.size());
+  for (auto& summary : summaries) {
+    sorted_summaries.push_back(std::move(summary.second));
+  }
+  std::sort(sorted_summaries.begin(),
+            sorted_summaries.end(),
+            [](const RegionSummary& summary1, const RegionSummary& summary2) {
+              return summary1.total_seconds > summary2.total_seconds;
+            });
+  return sorted_summaries;
+}
+
+void Profiler::WriteChromeTrace(const std::string& path) const {
+  std::ofstream file(path, std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first_event = true;
+  for (const auto& region : Regions()) {
+    if (!first_event) {
+      file << ",";
+    }
+    first_event = false;
+    file << "\n{\"name\":";
+    WriteJSONString(region.name, file);
+    file << ",\"cat\":\"colmap\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+         << region.thread_idx << ",\"ts\":" << region.begin_us
+         << ",\"dur\":" << region.end_us - region.begin_us << "}";
+  }
+  file << "\n]}\n";
+}
+
+void Profiler::BeginRegion(const char* name) {
+  ThreadBuffer* thread_buffer = GetThreadBuffer();
+  Region region;
+  region.name = name;
+  region.thread_idx = thread_buffer->thread_idx;
+  region.begin_us = NowMicroSeconds();
+  std::lock_guard<std::mutex> lock(thread_buffer->mutex);
+  region.depth = static_cast<int>(thread_buffer->open_regions.size());
+  thread_buffer->open_regions.push_back(region);
+}
+
+void Profiler::EndRegion() {
+  ThreadBuffer* thread_buffer = GetThreadBuffer();
+  const int64_t end_us = NowMicroSeconds();
+  std::lock_guard<std::mutex> lock(thread_buffer->mutex);
+  THROW_CHECK(!thread_buffer->open_regions.empty());
+  Region& region = thread_buffer->open_regions.back();
+  region.end_us = end_us;
+  thread_buffer->finished_regions.push_back(region);
+  thread_buffer->open_regions.pop_back();
+}
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer() {
+  // The buffers are owned by the profiler, such that the regions of finished
+  // threads remain available.
+  thread_local ThreadBuffer* thread_buffer = nullptr;
+  if (thread_buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_buffers_.push_back(std::make_unique<ThreadBuffer>());
+    thread_buffer = thread_buffers_.back().get();
+    thread_buffer->thread_idx = static_cast<int>(thread_buffers_.size()) - 1;
+  }
+  return thread_buffer;
+}
+
+int64_t Profiler::NowMicroSeconds() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start_time_)
+      .count();
+}
+
+}  // namespace colmap
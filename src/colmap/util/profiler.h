@@ -0,0 +1,163 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Records nested, named time regions of all threads, e.g.:
+//
+//    void Reconstruct() {
+//      COLMAP_PROFILE_SCOPE("Reconstruct");
+//      for (...) {
+//        COLMAP_PROFILE_SCOPE("RegisterNextImage");
+//      }
+//    }
+//
+// The regions are recorded into per-thread buffers, which are only locked by
+// the owning thread and when exporting the regions, so the threads do not
+// contend with each other. If the profiler is disabled (the default), a scope
+// only costs the check of an atomic flag. The recorded regions can be exported
+// as a Chrome trace, which can be opened in chrome://tracing or Perfetto.
+class Profiler {
+ public:
+  struct Region {
+    // Static name of the region, e.g., a string literal.
+    const char* name = nullptr;
+    // Index of the recording thread in the order of their first region.
+    int thread_idx = -1;
+    // Nesting depth of the region in the thread, starting from zero.
+    int depth = 0;
+    // Begin and end of the region in microseconds since the profiler start.
+    int64_t begin_us = 0;
+    int64_t end_us = 0;
+  };
+
+  struct RegionSummary {
+    std::string name;
+    size_t num_calls = 0;
+    double total_seconds = 0;
+    double max_seconds = 0;
+  };
+
+  static Profiler& Instance();
+
+  inline bool IsEnabled() const;
+  void SetEnabled(bool enabled);
+
+  // Enable the profiler and write the trace to the given path in Finish, if
+  // the path is not empty. Called when parsing the `profile_path` option.
+  void Start(const std::string& trace_path);
+  // Disable the profiler and write the recorded regions, if started with a
+  // trace path. Called by the command-line interface after each command.
+  void Finish();
+
+  // Remove all recorded regions.
+  void Clear();
+
+  // All finished regions of all threads, ordered by thread and begin time.
+  std::vector<Region> Regions() const;
+
+  // Accumulated times of the finished regions by name in descending order of
+  // the total time.
+  std::vector<RegionSummary> Summary() const;
+
+  // Write the finished regions in the Chrome trace event format.
+  void WriteChromeTrace(const std::string& path) const;
+
+  // Begin and end a region of the current thread. Prefer COLMAP_PROFILE_SCOPE.
+  void BeginRegion(const char* name);
+  void EndRegion();
+
+ private:
+  struct ThreadBuffer;
+
+  Profiler();
+
+  ThreadBuffer* GetThreadBuffer();
+  int64_t NowMicroSeconds() const;
+
+  std::atomic<bool> enabled_;
+  const std::chrono::steady_clock::time_point start_time_;
+  std::string trace_path_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> thread_buffers_;
+};
+
+// Records the region from its construction to its destruction, if the
+// profiler was enabled on construction.
+class ScopedProfile {
+ public:
+  explicit ScopedProfile(const char* name);
+  ~ScopedProfile();
+
+  ScopedProfile(const ScopedProfile&) = delete;
+  ScopedProfile& operator=(const ScopedProfile&) = delete;
+
+ private:
+  bool active_;
+};
+
+#define COLMAP_PROFILE_CONCAT_IMPL(a, b) a##b
+#define COLMAP_PROFILE_CONCAT(a, b) COLMAP_PROFILE_CONCAT_IMPL(a, b)
+#define COLMAP_PROFILE_SCOPE(name)       \
+  const ::colmap::ScopedProfile         \
+  COLMAP_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool Profiler::IsEnabled() const {
+  return enabled_.load(std::memory_order_relaxed);
+}
+
+inline ScopedProfile::ScopedProfile(const char* name)
+    : active_(Profiler::Instance().IsEnabled()) {
+  if (active_) {
+    Profiler::Instance().BeginRegion(name);
+  }
+}
+
+inline ScopedProfile::~ScopedProfile() {
+  if (active_) {
+    Profiler::Instance().EndRegion();
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,140 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/util/profiler.h"
+
+#include "colmap/util/testing.h"
+
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+class ProfilerTest : public ::testing::Test {
+ protected:
+  void SetUp() override { Profiler::Instance().Clear(); }
+
+  void TearDown() override {
+    Profiler::Instance().SetEnabled(false);
+    Profiler::Instance().Clear();
+  }
+};
+
+TEST_F(ProfilerTest, Disabled) {
+  EXPECT_FALSE(Profiler::Instance().IsEnabled());
+  { COLMAP_PROFILE_SCOPE("Disabled"); }
+  EXPECT_TRUE(Profiler::Instance().Regions().empty());
+}
+
+TEST_F(ProfilerTest, Nested) {
+  Profiler::Instance().SetEnabled(true);
+  {
+    COLMAP_PROFILE_SCOPE("Outer");
+    for (int i = 0; i < 2; ++i) {
+      COLMAP_PROFILE_SCOPE("Inner");
+    }
+  }
+  Profiler::Instance().SetEnabled(false);
+  { COLMAP_PROFILE_SCOPE("Disabled"); }
+
+  const std::vector<Profiler::Region> regions = Profiler::Instance().Regions();
+  ASSERT_EQ(regions.size(), 3);
+  EXPECT_STREQ(regions[0].name, "Outer");
+  EXPECT_EQ(regions[0].depth, 0);
+  for (int i = 1; i < 3; ++i) {
+    EXPECT_STREQ(regions[i].name, "Inner");
+    EXPECT_EQ(regions[i].depth, 1);
+    EXPECT_EQ(regions[i].thread_idx, regions[0].thread_idx);
+    EXPECT_GE(regions[i].begin_us, regions[0].begin_us);
+    EXPECT_LE(regions[i].end_us, regions[0].end_us);
+    EXPECT_LE(regions[i].begin_us, regions[i].end_us);
+  }
+
+  const std::vector<Profiler::RegionSummary> summary =
+      Profiler::Instance().Summary();
+  ASSERT_EQ(summary.size(), 2);
+  EXPECT_EQ(summary[0].name, "Outer");
+  EXPECT_EQ(summary[0].num_calls, 1);
+  EXPECT_EQ(summary[1].name, "Inner");
+  EXPECT_EQ(summary[1].num_calls, 2);
+  EXPECT_GE(summary[0].total_seconds, summary[1].total_seconds);
+
+  Profiler::Instance().Clear();
+  EXPECT_TRUE(Profiler::Instance().Regions().empty());
+}
+
+TEST_F(ProfilerTest, MultipleThreads) {
+  Profiler::Instance().SetEnabled(true);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 100; ++j) {
+        COLMAP_PROFILE_SCOPE("Thread");
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  const std::vector<Profiler::Region> regions = Profiler::Instance().Regions();
+  EXPECT_EQ(regions.size(), 400);
+  std::set<int> thread_idxs;
+  for (const auto& region : regions) {
+    thread_idxs.insert(region.thread_idx);
+  }
+  EXPECT_EQ(thread_idxs.size(), 4);
+}
+
+TEST_F(ProfilerTest, WriteChromeTrace) {
+  Profiler::Instance().SetEnabled(true);
+  {
+    COLMAP_PROFILE_SCOPE("Outer");
+    { COLMAP_PROFILE_SCOPE("In\"ner"); }
+  }
+
+  const std::string path = CreateTestDir() + "/trace.json";
+  Profiler::Instance().WriteChromeTrace(path);
+
+  std::ifstream file(path);
+  std::stringstream trace;
+  trace << file.rdbuf();
+  EXPECT_NE(trace.str().find("\"traceEvents\":["), std::string::npos);
+  EXPECT_NE(trace.str().find("\"name\":\"Outer\""), std::string::npos);
+  EXPECT_NE(trace.str().find("\"name\":\"In\\\"ner\""), std::string::npos);
+  EXPECT_NE(trace.str().find("\"ph\":\"X\""), std::string::npos);
+}
+
+}  // namespace
+}  // namespace colmap
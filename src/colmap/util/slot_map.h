@@ -0,0 +1,357 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/util/logging.h"
+#include "colmap/util/memory.h"
+
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace colmap {
+
+// Associative container with an `std::unordered_map`-like interface that
+// stores its elements densely in fixed-size chunks of slots. Iterating over
+// all elements touches contiguous memory instead of chasing the nodes of a
+// hash map, while lookups by key go through a separate key to slot index.
+//
+// The address of an element is stable until it is erased, i.e. insertions and
+// erasures of other elements do not invalidate references to it. Slots of
+// erased elements are reused by later insertions. The iteration order is the
+// order of the slots and not the insertion order.
+template <typename key_t, typename value_t>
+class SlotMap {
+ public:
+  using key_type = key_t;
+  using mapped_type = value_t;
+  using value_type = std::pair<const key_t, value_t>;
+  using size_type = size_t;
+
+  // Number of slots per chunk.
+  static constexpr size_t kChunkSize = 1024;
+
+  template <bool kIsConst>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = SlotMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer =
+        std::conditional_t<kIsConst, const value_type*, value_type*>;
+    using reference =
+        std::conditional_t<kIsConst, const value_type&, value_type&>;
+    using map_pointer =
+        std::conditional_t<kIsConst, const SlotMap*, SlotMap*>;
+
+    Iterator() = default;
+    Iterator(map_pointer map, size_t slot_idx)
+        : map_(map), slot_idx_(slot_idx) {
+      SkipEmptySlots();
+    }
+
+    // Allow conversion from mutable to const iterators.
+    template <bool kOtherIsConst,
+              typename = std::enable_if_t<kIsConst || !kOtherIsConst>>
+    Iterator(const Iterator<kOtherIsConst>& other)  // NOLINT
+        : map_(other.map_), slot_idx_(other.slot_idx_) {}
+
+    reference operator*() const { return *map_->Slot(slot_idx_); }
+    pointer operator->() const { return &*map_->Slot(slot_idx_); }
+
+    Iterator& operator++() {
+      slot_idx_ += 1;
+      SkipEmptySlots();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    template <bool kOtherIsConst>
+    bool operator==(const Iterator<kOtherIsConst>& other) const {
+      return slot_idx_ == other.slot_idx_;
+    }
+
+    template <bool kOtherIsConst>
+    bool operator!=(const Iterator<kOtherIsConst>& other) const {
+      return slot_idx_ != other.slot_idx_;
+    }
+
+   private:
+    friend class SlotMap;
+    template <bool>
+    friend class Iterator;
+
+    void SkipEmptySlots() {
+      while (slot_idx_ < map_->num_slots_ &&
+             !map_->Slot(slot_idx_).has_value()) {
+        slot_idx_ += 1;
+      }
+    }
+
+    map_pointer map_ = nullptr;
+    size_t slot_idx_ = 0;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  SlotMap() = default;
+  SlotMap(const SlotMap& other) = default;
+  SlotMap(SlotMap&& other) noexcept = default;
+  SlotMap& operator=(const SlotMap& other);
+  SlotMap& operator=(SlotMap&& other) noexcept = default;
+
+  inline size_t size() const;
+  inline bool empty() const;
+
+  // Estimated memory of the slots and the index, excluding the heap memory
+  // owned by the values.
+  inline size_t NumBytes() const;
+
+  inline iterator begin();
+  inline iterator end();
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+
+  inline iterator find(const key_t& key);
+  inline const_iterator find(const key_t& key) const;
+  inline size_t count(const key_t& key) const;
+
+  // Access an existing element, throws if the key does not exist.
+  inline value_t& at(const key_t& key);
+  inline const value_t& at(const key_t& key) const;
+
+  // Access an element and default-construct it, if the key does not exist.
+  value_t& operator[](const key_t& key);
+
+  // Construct a new element in place, if the key does not exist yet.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const key_t& key, Args&&... args);
+
+  size_t erase(const key_t& key);
+  iterator erase(const_iterator it);
+
+  void clear();
+  void reserve(size_t num_elems);
+
+ private:
+  using slot_t = std::optional<value_type>;
+
+  inline slot_t& Slot(size_t slot_idx);
+  inline const slot_t& Slot(size_t slot_idx) const;
+
+  // Each chunk is allocated with `kChunkSize` slots and never resized, so
+  // that elements do not move when chunks are added.
+  std::vector<std::vector<slot_t>> chunks_;
+  size_t num_slots_ = 0;
+  std::vector<size_t> free_slot_idxs_;
+  std::unordered_map<key_t, size_t> slot_idxs_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename key_t, typename value_t>
+SlotMap<key_t, value_t>& SlotMap<key_t, value_t>::operator=(
+    const SlotMap& other) {
+  // The slots hold constant keys and cannot be copy-assigned in place.
+  if (this != &other) {
+    *this = SlotMap(other);
+  }
+  return *this;
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::size() const {
+  return slot_idxs_.size();
+}
+
+template <typename key_t, typename value_t>
+bool SlotMap<key_t, value_t>::empty() const {
+  return slot_idxs_.empty();
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::NumBytes() const {
+  return chunks_.size() * kChunkSize * sizeof(slot_t) +
+         EstimateNumBytes(chunks_) + EstimateNumBytes(free_slot_idxs_) +
+         EstimateNumBytes(slot_idxs_);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::iterator SlotMap<key_t, value_t>::begin() {
+  return iterator(this, 0);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::iterator SlotMap<key_t, value_t>::end() {
+  return iterator(this, num_slots_);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::const_iterator
+SlotMap<key_t, value_t>::begin() const {
+  return const_iterator(this, 0);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::const_iterator SlotMap<key_t, value_t>::end()
+    const {
+  return const_iterator(this, num_slots_);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::iterator SlotMap<key_t, value_t>::find(
+    const key_t& key) {
+  const auto it = slot_idxs_.find(key);
+  if (it == slot_idxs_.end()) {
+    return end();
+  }
+  return iterator(this, it->second);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::const_iterator SlotMap<key_t, value_t>::find(
+    const key_t& key) const {
+  const auto it = slot_idxs_.find(key);
+  if (it == slot_idxs_.end()) {
+    return end();
+  }
+  return const_iterator(this, it->second);
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::count(const key_t& key) const {
+  return slot_idxs_.count(key);
+}
+
+template <typename key_t, typename value_t>
+value_t& SlotMap<key_t, value_t>::at(const key_t& key) {
+  return Slot(slot_idxs_.at(key))->second;
+}
+
+template <typename key_t, typename value_t>
+const value_t& SlotMap<key_t, value_t>::at(const key_t& key) const {
+  return Slot(slot_idxs_.at(key))->second;
+}
+
+template <typename key_t, typename value_t>
+value_t& SlotMap<key_t, value_t>::operator[](const key_t& key) {
+  return emplace(key).first->second;
+}
+
+template <typename key_t, typename value_t>
+template <typename... Args>
+std::pair<typename SlotMap<key_t, value_t>::iterator, bool>
+SlotMap<key_t, value_t>::emplace(const key_t& key, Args&&... args) {
+  const auto it = slot_idxs_.find(key);
+  if (it != slot_idxs_.end()) {
+    return {iterator(this, it->second), false};
+  }
+
+  size_t slot_idx;
+  if (free_slot_idxs_.empty()) {
+    if (num_slots_ == chunks_.size() * kChunkSize) {
+      chunks_.emplace_back(kChunkSize);
+    }
+    slot_idx = num_slots_;
+    num_slots_ += 1;
+  } else {
+    slot_idx = free_slot_idxs_.back();
+    free_slot_idxs_.pop_back();
+  }
+
+  Slot(slot_idx).emplace(std::piecewise_construct,
+                         std::forward_as_tuple(key),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+  slot_idxs_.emplace(key, slot_idx);
+  return {iterator(this, slot_idx), true};
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::erase(const key_t& key) {
+  const auto it = slot_idxs_.find(key);
+  if (it == slot_idxs_.end()) {
+    return 0;
+  }
+  Slot(it->second).reset();
+  free_slot_idxs_.push_back(it->second);
+  slot_idxs_.erase(it);
+  return 1;
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::iterator SlotMap<key_t, value_t>::erase(
+    const const_iterator it) {
+  const size_t slot_idx = it.slot_idx_;
+  THROW_CHECK_LT(slot_idx, num_slots_);
+  erase(it->first);
+  return iterator(this, slot_idx + 1);
+}
+
+template <typename key_t, typename value_t>
+void SlotMap<key_t, value_t>::clear() {
+  chunks_.clear();
+  num_slots_ = 0;
+  free_slot_idxs_.clear();
+  slot_idxs_.clear();
+}
+
+template <typename key_t, typename value_t>
+void SlotMap<key_t, value_t>::reserve(const size_t num_elems) {
+  const size_t num_chunks = (num_elems + kChunkSize - 1) / kChunkSize;
+  chunks_.reserve(num_chunks);
+  slot_idxs_.reserve(num_elems);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::slot_t& SlotMap<key_t, value_t>::Slot(
+    const size_t slot_idx) {
+  return chunks_[slot_idx / kChunkSize][slot_idx % kChunkSize];
+}
+
+template <typename key_t, typename value_t>
+const typename SlotMap<key_t, value_t>::slot_t& SlotMap<key_t, value_t>::Slot(
+    const size_t slot_idx) const {
+  return chunks_[slot_idx / kChunkSize][slot_idx % kChunkSize];
+}
+
+}  // namespace colmap
@@ -0,0 +1,167 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/slot_map.h"
+
+#include <string>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(SlotMap, Empty) {
+  SlotMap<int, std::string> map;
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+  EXPECT_EQ(map.find(0), map.end());
+  EXPECT_EQ(map.count(0), 0);
+  EXPECT_ANY_THROW(map.at(0));
+}
+
+TEST(SlotMap, EmplaceAndFind) {
+  SlotMap<int, std::string> map;
+  EXPECT_TRUE(map.emplace(1, "a").second);
+  EXPECT_TRUE(map.emplace(2, "b").second);
+  EXPECT_FALSE(map.emplace(1, "c").second);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_FALSE(map.empty());
+  EXPECT_EQ(map.at(1), "a");
+  EXPECT_EQ(map.at(2), "b");
+  EXPECT_EQ(map.find(2)->first, 2);
+  EXPECT_EQ(map.find(2)->second, "b");
+  EXPECT_EQ(map.count(1), 1);
+  EXPECT_EQ(map.count(3), 0);
+  map[3] = "c";
+  EXPECT_EQ(map.at(3), "c");
+  EXPECT_EQ(map[3], "c");
+  EXPECT_EQ(map.size(), 3);
+}
+
+TEST(SlotMap, Erase) {
+  SlotMap<int, int> map;
+  for (int i = 0; i < 10; ++i) {
+    map.emplace(i, 10 * i);
+  }
+  EXPECT_EQ(map.erase(3), 1);
+  EXPECT_EQ(map.erase(3), 0);
+  EXPECT_EQ(map.size(), 9);
+  EXPECT_EQ(map.find(3), map.end());
+  auto it = map.erase(map.find(4));
+  EXPECT_EQ(it->first, 5);
+  EXPECT_EQ(map.size(), 8);
+  it = map.erase(map.find(9));
+  EXPECT_EQ(it, map.end());
+  for (int i = 0; i < 10; ++i) {
+    if (i == 3 || i == 4 || i == 9) {
+      EXPECT_EQ(map.count(i), 0);
+    } else {
+      EXPECT_EQ(map.at(i), 10 * i);
+    }
+  }
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(SlotMap, Iterate) {
+  SlotMap<int, int> map;
+  const int kNumElems = 3 * SlotMap<int, int>::kChunkSize + 1;
+  map.reserve(kNumElems);
+  for (int i = 0; i < kNumElems; ++i) {
+    map.emplace(i, i);
+  }
+  for (int i = 0; i < kNumElems; i += 2) {
+    map.erase(i);
+  }
+
+  std::unordered_set<int> keys;
+  for (const auto& elem : map) {
+    EXPECT_EQ(elem.first, elem.second);
+    EXPECT_EQ(elem.first % 2, 1);
+    keys.insert(elem.first);
+  }
+  EXPECT_EQ(keys.size(), map.size());
+
+  for (auto& elem : map) {
+    elem.second = -elem.first;
+  }
+  for (const auto& elem : map) {
+    EXPECT_EQ(elem.second, -elem.first);
+  }
+}
+
+TEST(SlotMap, StableReferences) {
+  SlotMap<int, int> map;
+  map.emplace(0, 0);
+  const int* value0 = &map.at(0);
+  for (int i = 1; i < 4 * static_cast<int>(SlotMap<int, int>::kChunkSize);
+       ++i) {
+    map.emplace(i, i);
+    if (i % 2 == 0) {
+      map.erase(i - 1);
+    }
+  }
+  EXPECT_EQ(value0, &map.at(0));
+}
+
+TEST(SlotMap, ReuseSlots) {
+  SlotMap<int, int> map;
+  map.emplace(1, 1);
+  map.emplace(2, 2);
+  const int* value1 = &map.at(1);
+  map.erase(1);
+  map.emplace(3, 3);
+  EXPECT_EQ(value1, &map.at(3));
+  EXPECT_EQ(map.size(), 2);
+}
+
+TEST(SlotMap, Copy) {
+  SlotMap<int, std::string> map;
+  map.emplace(1, "a");
+  map.emplace(2, "b");
+  map.erase(1);
+  SlotMap<int, std::string> map_copy(map);
+  EXPECT_EQ(map_copy.size(), 1);
+  EXPECT_EQ(map_copy.at(2), "b");
+  map_copy.emplace(3, "c");
+  EXPECT_EQ(map.count(3), 0);
+  map = map_copy;
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.at(3), "c");
+  SlotMap<int, std::string> map_moved(std::move(map_copy));
+  EXPECT_EQ(map_moved.size(), 2);
+  EXPECT_EQ(map_moved.at(2), "b");
+}
+
+}  // namespace
+}  // namespace colmap
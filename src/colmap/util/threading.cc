@@ -31,7 +31,84 @@
 
 #include "colmap/util/logging.h"
 
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace colmap {
+namespace {
+
+// Parse a list of CPUs or nodes in the format of the Linux sysfs, e.g.,
+// "0-3,8,10-11".
+std::vector<int> ParseSysfsList(const std::string& list) {
+  std::vector<int> values;
+  std::stringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    const size_t dash_pos = range.find('-');
+    const int first = std::stoi(range.substr(0, dash_pos));
+    const int last = dash_pos == std::string::npos
+                         ? first
+                         : std::stoi(range.substr(dash_pos + 1));
+    for (int value = first; value <= last; ++value) {
+      values.push_back(value);
+    }
+  }
+  return values;
+}
+
+bool ReadSysfsList(const std::string& path, std::vector<int>* values) {
+  std::ifstream file(path);
+  std::string list;
+  if (!file.is_open() || !std::getline(file, list)) {
+    return false;
+  }
+  try {
+    *values = ParseSysfsList(list);
+  } catch (const std::exception&) {
+    return false;
+  }
+  return !values->empty();
+}
+
+// The CPUs of the NUMA nodes with CPUs. Nodes without CPUs, e.g., of memory
+// expanders, are skipped. Without NUMA topology, all CPUs form one node.
+const std::vector<std::vector<int>>& GetNumaTopology() {
+  static const std::vector<std::vector<int>> topology = []() {
+    std::vector<std::vector<int>> node_cpus;
+#if defined(__linux__)
+    std::vector<int> nodes;
+    if (ReadSysfsList("/sys/devices/system/node/online", &nodes)) {
+      for (const int node : nodes) {
+        std::vector<int> cpus;
+        if (ReadSysfsList("/sys/devices/system/node/node" +
+                              std::to_string(node) + "/cpulist",
+                          &cpus)) {
+          node_cpus.push_back(std::move(cpus));
+        }
+      }
+    }
+#endif
+    if (node_cpus.empty()) {
+      std::vector<int> cpus(GetEffectiveNumThreads(-1));
+      for (size_t i = 0; i < cpus.size(); ++i) {
+        cpus[i] = static_cast<int>(i);
+      }
+      node_cpus.push_back(std::move(cpus));
+    }
+    return node_cpus;
+  }();
+  return topology;
+}
+
+}  // namespace
 
 Thread::Thread()
     : started_(false),
@@ -40,7 +117,8 @@ Thread::Thread()
       pausing_(false),
       finished_(false),
       setup_(false),
-      setup_valid_(false) {
+      setup_valid_(false),
+      numa_node_(-1) {
   RegisterCallback(STARTED_CALLBACK);
   RegisterCallback(FINISHED_CALLBACK);
 }
@@ -151,6 +229,11 @@ void Thread::SignalInvalidSetup() {
 
 const class Timer& Thread::GetTimer() const { return timer_; }
 
+void Thread::SetNumaNode(const int numa_node) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  numa_node_ = numa_node;
+}
+
 void Thread::BlockIfPaused() {
   std::unique_lock<std::mutex> lock(mutex_);
   if (paused_) {
@@ -171,6 +254,14 @@ bool Thread::CheckValidSetup() {
 }
 
 void Thread::RunFunc() {
+  int numa_node;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    numa_node = numa_node_;
+  }
+  if (numa_node >= 0 && !SetCurrentThreadNumaNode(numa_node)) {
+    VLOG(2) << "Failed to pin thread to NUMA node " << numa_node;
+  }
   Callback(STARTED_CALLBACK);
   Run();
   {
@@ -181,12 +272,28 @@ void Thread::RunFunc() {
   Callback(FINISHED_CALLBACK);
 }
 
-ThreadPool::ThreadPool(const int num_threads)
-    : stopped_(false), num_active_workers_(0) {
+thread_local const ThreadPool* ThreadPool::thread_pool_ = nullptr;
+thread_local int ThreadPool::thread_index_ = -1;
+
+ThreadPool::ThreadPool(const int num_threads, const bool pin_to_numa_nodes)
+    : next_queue_idx_(0),
+      stopped_(false),
+      num_pending_tasks_(0),
+      num_active_workers_(0),
+      num_sleeping_workers_(0) {
   const int num_effective_threads = GetEffectiveNumThreads(num_threads);
+  queues_.reserve(num_effective_threads);
+  for (int index = 0; index < num_effective_threads; ++index) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+  // Consecutive workers are placed on the same node, such that the workers
+  // first steal the tasks of the neighboring workers on the same node.
   for (int index = 0; index < num_effective_threads; ++index) {
+    const int numa_node =
+        pin_to_numa_nodes ? GetNumaNodeOfThread(index, num_effective_threads)
+                          : -1;
     std::function<void(void)> worker =
-        std::bind(&ThreadPool::WorkerFunc, this, index);
+        std::bind(&ThreadPool::WorkerFunc, this, index, numa_node);
     workers_.emplace_back(worker);
   }
 }
@@ -202,12 +309,21 @@ void ThreadPool::Stop() {
     }
 
     stopped_ = true;
+  }
 
-    std::queue<std::function<void()>> empty_tasks;
-    std::swap(tasks_, empty_tasks);
+  for (auto& queue : queues_) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for (int priority = 0; priority < kNumPriorities; ++priority) {
+      num_pending_tasks_ -= static_cast<int>(queue->tasks[priority].size());
+      queue->num_tasks[priority] = 0;
+      queue->tasks[priority].clear();
+    }
   }
 
-  task_condition_.notify_all();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_condition_.notify_all();
+  }
 
   for (auto& worker : workers_) {
     worker.join();
@@ -218,40 +334,100 @@ void ThreadPool::Stop() {
 
 void ThreadPool::Wait() {
   std::unique_lock<std::mutex> lock(mutex_);
-  if (!tasks_.empty() || num_active_workers_ > 0) {
-    finished_condition_.wait(
-        lock, [this]() { return tasks_.empty() && num_active_workers_ == 0; });
+  finished_condition_.wait(lock, [this]() {
+    return num_pending_tasks_ <= 0 && num_active_workers_ == 0;
+  });
+}
+
+void ThreadPool::PushTask(const Priority priority,
+                          std::unique_ptr<TaskBase> task) {
+  if (stopped_) {
+    throw std::runtime_error("Cannot add task to stopped thread pool.");
+  }
+
+  // Workers add their tasks to their own queue.
+  const int priority_idx = static_cast<int>(priority);
+  const size_t queue_idx =
+      thread_pool_ == this
+          ? thread_index_
+          : next_queue_idx_.fetch_add(1, std::memory_order_relaxed) %
+                queues_.size();
+  WorkerQueue& queue = *queues_[queue_idx];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks[priority_idx].push_back(std::move(task));
+    queue.num_tasks[priority_idx] += 1;
+  }
+
+  // The sleeping workers count the pending tasks under the lock, such that
+  // they are either woken up or see the new task.
+  num_pending_tasks_ += 1;
+  if (num_sleeping_workers_ > 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_condition_.notify_one();
+  }
+}
+
+bool ThreadPool::PopTask(const int index, std::unique_ptr<TaskBase>* task) {
+  for (int priority_idx = kNumPriorities - 1; priority_idx >= 0;
+       --priority_idx) {
+    for (size_t i = 0; i < queues_.size(); ++i) {
+      WorkerQueue& queue = *queues_[(index + i) % queues_.size()];
+      if (queue.num_tasks[priority_idx] == 0) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      auto& tasks = queue.tasks[priority_idx];
+      if (tasks.empty()) {
+        continue;
+      }
+      *task = std::move(tasks.front());
+      tasks.pop_front();
+      queue.num_tasks[priority_idx] -= 1;
+      // The task is active before it is no longer pending, such that Wait
+      // does not return in between.
+      num_active_workers_ += 1;
+      num_pending_tasks_ -= 1;
+      return true;
+    }
   }
+  return false;
 }
 
-void ThreadPool::WorkerFunc(const int index) {
+void ThreadPool::WorkerFunc(const int index, const int numa_node) {
+  if (numa_node >= 0 && !SetCurrentThreadNumaNode(numa_node)) {
+    VLOG(2) << "Failed to pin thread pool worker to NUMA node " << numa_node;
+  }
+
   {
     std::lock_guard<std::mutex> lock(mutex_);
     thread_id_to_index_.emplace(GetThreadId(), index);
   }
 
+  thread_pool_ = this;
+  thread_index_ = index;
+
+  std::unique_ptr<TaskBase> task;
   while (true) {
-    std::function<void()> task;
-    {
+    if (!PopTask(index, &task)) {
       std::unique_lock<std::mutex> lock(mutex_);
-      task_condition_.wait(lock,
-                           [this] { return stopped_ || !tasks_.empty(); });
-      if (stopped_ && tasks_.empty()) {
+      num_sleeping_workers_ += 1;
+      task_condition_.wait(
+          lock, [this] { return stopped_ || num_pending_tasks_ > 0; });
+      num_sleeping_workers_ -= 1;
+      if (stopped_ && num_pending_tasks_ <= 0) {
         return;
       }
-      task = std::move(tasks_.front());
-      tasks_.pop();
-      num_active_workers_ += 1;
+      continue;
     }
 
-    task();
+    task->Run();
+    task.reset();
 
-    {
+    if (--num_active_workers_ == 0 && num_pending_tasks_ <= 0) {
       std::unique_lock<std::mutex> lock(mutex_);
-      num_active_workers_ -= 1;
+      finished_condition_.notify_all();
     }
-
-    finished_condition_.notify_all();
   }
 }
 
@@ -260,6 +436,9 @@ std::thread::id ThreadPool::GetThreadId() const {
 }
 
 int ThreadPool::GetThreadIndex() {
+  if (thread_pool_ == this) {
+    return thread_index_;
+  }
   std::unique_lock<std::mutex> lock(mutex_);
   return thread_id_to_index_.at(GetThreadId());
 }
@@ -277,4 +456,37 @@ int GetEffectiveNumThreads(const int num_threads) {
   return num_effective_threads;
 }
 
+int GetNumNumaNodes() { return static_cast<int>(GetNumaTopology().size()); }
+
+std::vector<int> GetNumaNodeCpus(const int numa_node) {
+  const auto& topology = GetNumaTopology();
+  THROW_CHECK_GE(numa_node, 0);
+  THROW_CHECK_LT(numa_node, static_cast<int>(topology.size()));
+  return topology[numa_node];
+}
+
+int GetNumaNodeOfThread(const int index, const int num_threads) {
+  THROW_CHECK_GE(index, 0);
+  THROW_CHECK_LT(index, num_threads);
+  return static_cast<int>(static_cast<int64_t>(index) * GetNumNumaNodes() /
+                          num_threads);
+}
+
+bool SetCurrentThreadNumaNode(const int numa_node) {
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu : GetNumaNodeCpus(numa_node)) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) ==
+         0;
+#else
+  (void)numa_node;
+  return false;
+#endif
+}
+
 }  // namespace colmap
@@ -31,15 +31,22 @@
 
 #include "colmap/util/timer.h"
 
+#include <algorithm>
 #include <atomic>
 #include <climits>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <thread>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 namespace colmap {
 
@@ -135,6 +142,11 @@ class Thread {
   // Get timing information of the thread, properly accounting for pause times.
   const Timer& GetTimer() const;
 
+  // Pin the thread to the CPUs of the given NUMA node, once it is started, such
+  // that the memory it allocates and first touches is local to the node. A
+  // negative node disables the pinning, see `SetCurrentThreadNumaNode`.
+  void SetNumaNode(int numa_node);
+
  protected:
   // This is the main run function to be implemented by the child class. If you
   // are looping over data and want to support the pause operation, call
@@ -175,6 +187,7 @@ class Thread {
   bool finished_;
   bool setup_;
   bool setup_valid_;
+  int numa_node_;
 
   std::unordered_map<int, std::list<std::function<void()>>> callbacks_;
 };
@@ -190,10 +203,21 @@ class Thread {
 //    }
 //    thread_pool.Wait();
 //
+// Every worker has its own queue of tasks. Tasks added from outside of the
+// pool are distributed over the queues in turn, while tasks added by a worker
+// are added to its own queue. Workers without pending tasks steal the tasks of
+// other workers, such that the tasks are started approximately in the order in
+// which they were added. Tasks of high priority are started before all pending
+// tasks of normal priority.
 class ThreadPool {
  public:
   static const int kMaxNumThreads = -1;
 
+  enum class Priority {
+    NORMAL = 0,
+    HIGH = 1,
+  };
+
   template <class func_t, class... args_t>
 #ifdef __cpp_lib_is_invocable
   using result_of_t = std::invoke_result_t<func_t, args_t...>;
@@ -201,7 +225,10 @@ class ThreadPool {
   using result_of_t = typename std::result_of<func_t(args_t...)>::type;
 #endif
 
-  explicit ThreadPool(int num_threads = kMaxNumThreads);
+  // If pin_to_numa_nodes is true, the workers are distributed over the NUMA
+  // nodes in consecutive blocks and pinned to the CPUs of their node.
+  explicit ThreadPool(int num_threads = kMaxNumThreads,
+                      bool pin_to_numa_nodes = false);
   ~ThreadPool();
 
   inline size_t NumThreads() const;
@@ -211,6 +238,11 @@ class ThreadPool {
   auto AddTask(func_t&& f, args_t&&... args)
       -> std::future<result_of_t<func_t, args_t...>>;
 
+  // Add new task of the given priority to the thread pool.
+  template <class func_t, class... args_t>
+  auto AddTaskWithPriority(Priority priority, func_t&& f, args_t&&... args)
+      -> std::future<result_of_t<func_t, args_t...>>;
+
   // Stop the execution of all workers.
   void Stop();
 
@@ -226,19 +258,60 @@ class ThreadPool {
   int GetThreadIndex();
 
  private:
-  void WorkerFunc(int index);
+  // Type-erased task, which takes ownership of move-only functors, such that
+  // a task and its future only require a single allocation each.
+  class TaskBase {
+   public:
+    virtual ~TaskBase() = default;
+    virtual void Run() = 0;
+  };
+
+  template <typename func_t>
+  class Task : public TaskBase {
+   public:
+    explicit Task(func_t func) : func_(std::move(func)) {}
+    void Run() override { func_(); }
+
+   private:
+    func_t func_;
+  };
+
+  static constexpr int kNumPriorities = 2;
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<std::unique_ptr<TaskBase>> tasks[kNumPriorities];
+    // The number of tasks of every priority, which can be read without
+    // locking the queue to skip empty queues.
+    std::atomic<int> num_tasks[kNumPriorities] = {};
+  };
+
+  void PushTask(Priority priority, std::unique_ptr<TaskBase> task);
+  // Pop the next task from the worker's own queue or steal it from the queue
+  // of another worker.
+  bool PopTask(int index, std::unique_ptr<TaskBase>* task);
+  void WorkerFunc(int index, int numa_node);
 
   std::vector<std::thread> workers_;
-  std::queue<std::function<void()>> tasks_;
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::atomic<size_t> next_queue_idx_;
 
   std::mutex mutex_;
   std::condition_variable task_condition_;
   std::condition_variable finished_condition_;
 
-  bool stopped_;
-  int num_active_workers_;
+  std::atomic<bool> stopped_;
+  // The number of pending tasks can be temporarily negative, if a task is
+  // popped before it is counted.
+  std::atomic<int> num_pending_tasks_;
+  std::atomic<int> num_active_workers_;
+  std::atomic<int> num_sleeping_workers_;
 
   std::unordered_map<std::thread::id, int> thread_id_to_index_;
+
+  // The pool and index of the current thread, if it is a worker.
+  static thread_local const ThreadPool* thread_pool_;
+  static thread_local int thread_index_;
 };
 
 // A job queue class for the producer-consumer paradigm.
@@ -314,10 +387,130 @@ class JobQueue {
   std::condition_variable empty_condition_;
 };
 
+// Lock-free bounded job queue for multiple producers and consumers with the
+// same interface and stop/clear semantics as JobQueue. The jobs are stored in
+// a ring buffer, whose capacity is the maximum number of jobs rounded up to
+// the next power of two. Pushing and popping jobs do not lock, unless the
+// queue is full or empty, respectively, in which case the calling thread
+// waits until it is notified. Batches of jobs only notify the waiting threads
+// once. The job type must be default constructible and move assignable.
+template <typename T>
+class LockFreeJobQueue {
+ public:
+  using Job = typename JobQueue<T>::Job;
+
+  static constexpr size_t kDefaultMaxNumJobs = 4096;
+
+  explicit LockFreeJobQueue(size_t max_num_jobs = kDefaultMaxNumJobs);
+  ~LockFreeJobQueue();
+
+  // The number of pushed and not popped jobs in the queue.
+  size_t Size() const;
+  size_t MaxNumJobs() const;
+
+  // Push a new job to the queue. Waits if the number of jobs is exceeded.
+  bool Push(T data);
+
+  // Push the jobs in the given order. Waits whenever the number of jobs is
+  // exceeded. Returns false, if the queue was stopped before all jobs were
+  // pushed.
+  bool PushBatch(std::vector<T> data);
+
+  // Pop a job from the queue. Waits if there is no job in the queue.
+  Job Pop();
+
+  // Pop at least one and at most the given number of jobs from the queue.
+  // Waits if there is no job in the queue. Returns no jobs, if the queue was
+  // stopped.
+  std::vector<T> PopBatch(size_t max_num_jobs);
+
+  // Wait for all jobs to be popped and then stop the queue.
+  void Wait();
+
+  // Stop the queue and return from all push/pop calls with false.
+  void Stop();
+
+  // Clear all pushed and not popped jobs from the queue.
+  void Clear();
+
+ private:
+  struct Cell {
+    // The position of the next push into this cell, if the cell is empty, and
+    // the position plus one, if the cell holds the job of that position.
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  bool TryPush(T* data);
+  bool TryPop(T* data);
+
+  // Wait on the condition until the queue is stopped or the predicate holds.
+  template <typename pred_t>
+  void WaitUntil(std::condition_variable* condition,
+                 std::atomic<int>* num_waiting,
+                 bool stop_waiting,
+                 const pred_t& pred);
+  void Notify(std::condition_variable* condition,
+              const std::atomic<int>& num_waiting,
+              bool notify_all);
+  void NotifyPopped(bool notify_all);
+
+  const size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  // Producers and consumers update different cache lines.
+  alignas(64) std::atomic<size_t> push_pos_;
+  alignas(64) std::atomic<size_t> pop_pos_;
+
+  alignas(64) std::atomic<bool> stop_;
+  std::mutex mutex_;
+  std::condition_variable push_condition_;
+  std::condition_variable pop_condition_;
+  std::condition_variable empty_condition_;
+  std::atomic<int> num_waiting_pushers_;
+  std::atomic<int> num_waiting_poppers_;
+  std::atomic<int> num_waiting_empty_;
+};
+
 // Return the number of logical CPU cores if num_threads <= 0,
 // otherwise return the input value of num_threads.
 int GetEffectiveNumThreads(int num_threads);
 
+// Number of NUMA nodes of the system, which is 1 if the system has no NUMA
+// topology or it cannot be determined. The topology is read once on Linux.
+int GetNumNumaNodes();
+
+// Logical CPUs of the given NUMA node.
+std::vector<int> GetNumaNodeCpus(int numa_node);
+
+// NUMA node of the index-th of num_threads threads, such that consecutive
+// threads share the same node and the nodes get the same number of threads.
+int GetNumaNodeOfThread(int index, int num_threads);
+
+// Restrict the current thread to the CPUs of the given NUMA node. Memory is
+// allocated on the node of the thread that first touches it, so the buffers
+// and caches allocated by the thread afterwards are usually node-local.
+// Returns false, if thread affinity is not supported or could not be set.
+bool SetCurrentThreadNumaNode(int numa_node);
+
+// Call func(begin, end) for consecutive chunks of the items in the thread pool
+// and wait for all chunks to finish. If there is no thread pool or too few
+// items to fill two chunks of min_chunk_size, func is called once for all
+// items in the calling thread.
+template <typename func_t>
+void ParallelForChunks(ThreadPool* thread_pool,
+                       size_t num_items,
+                       size_t min_chunk_size,
+                       const func_t& func);
+
+// Same as above with a temporary thread pool of num_threads that is only
+// created if there are enough items to fill multiple chunks.
+template <typename func_t>
+void ParallelForChunks(int num_threads,
+                       size_t num_items,
+                       size_t min_chunk_size,
+                       const func_t& func);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -327,22 +520,26 @@ size_t ThreadPool::NumThreads() const { return workers_.size(); }
 template <class func_t, class... args_t>
 auto ThreadPool::AddTask(func_t&& f, args_t&&... args)
     -> std::future<result_of_t<func_t, args_t...>> {
+  return AddTaskWithPriority(Priority::NORMAL,
+                             std::forward<func_t>(f),
+                             std::forward<args_t>(args)...);
+}
+
+template <class func_t, class... args_t>
+auto ThreadPool::AddTaskWithPriority(const Priority priority,
+                                     func_t&& f,
+                                     args_t&&... args)
+    -> std::future<result_of_t<func_t, args_t...>> {
   typedef result_of_t<func_t, args_t...> return_t;
 
-  auto task = std::make_shared<std::packaged_task<return_t()>>(
+  std::packaged_task<return_t()> task(
       std::bind(std::forward<func_t>(f), std::forward<args_t>(args)...));
 
-  std::future<return_t> result = task->get_future();
+  std::future<return_t> result = task.get_future();
 
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (stopped_) {
-      throw std::runtime_error("Cannot add task to stopped thread pool.");
-    }
-    tasks_.emplace([task]() { (*task)(); });
-  }
-
-  task_condition_.notify_one();
+  PushTask(priority,
+           std::make_unique<Task<std::packaged_task<return_t()>>>(
+               std::move(task)));
 
   return result;
 }
@@ -421,4 +618,268 @@ void JobQueue<T>::Clear() {
   std::swap(jobs_, empty_jobs);
 }
 
+template <typename T>
+LockFreeJobQueue<T>::LockFreeJobQueue(const size_t max_num_jobs)
+    : mask_([max_num_jobs]() {
+        size_t num_cells = 2;
+        while (num_cells < max_num_jobs) {
+          num_cells *= 2;
+        }
+        return num_cells - 1;
+      }()),
+      cells_(new Cell[mask_ + 1]),
+      push_pos_(0),
+      pop_pos_(0),
+      stop_(false),
+      num_waiting_pushers_(0),
+      num_waiting_poppers_(0),
+      num_waiting_empty_(0) {
+  for (size_t i = 0; i <= mask_; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+LockFreeJobQueue<T>::~LockFreeJobQueue() {
+  Stop();
+}
+
+template <typename T>
+size_t LockFreeJobQueue<T>::Size() const {
+  // The consumers never overtake the producers, so the pop position is read
+  // first.
+  const size_t pop_pos = pop_pos_.load();
+  const size_t push_pos = push_pos_.load();
+  return push_pos - pop_pos;
+}
+
+template <typename T>
+size_t LockFreeJobQueue<T>::MaxNumJobs() const {
+  return mask_ + 1;
+}
+
+template <typename T>
+bool LockFreeJobQueue<T>::TryPush(T* data) {
+  size_t pos = push_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells_[pos & mask_];
+    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence == pos) {
+      if (push_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        cell.data = std::move(*data);
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (static_cast<std::ptrdiff_t>(sequence - pos) < 0) {
+      // The cell still holds the job of the previous round.
+      return false;
+    } else {
+      pos = push_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+bool LockFreeJobQueue<T>::TryPop(T* data) {
+  size_t pos = pop_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells_[pos & mask_];
+    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence == pos + 1) {
+      if (pop_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        *data = std::move(cell.data);
+        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (static_cast<std::ptrdiff_t>(sequence - (pos + 1)) < 0) {
+      // The job of this position is not yet pushed.
+      return false;
+    } else {
+      pos = pop_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+template <typename pred_t>
+void LockFreeJobQueue<T>::WaitUntil(std::condition_variable* condition,
+                                    std::atomic<int>* num_waiting,
+                                    const bool stop_waiting,
+                                    const pred_t& pred) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The waiting threads are counted before the predicate is checked, such
+  // that the notifying threads either see them or they see the change.
+  *num_waiting += 1;
+  condition->wait(lock, [&]() { return (stop_waiting && stop_) || pred(); });
+  *num_waiting -= 1;
+}
+
+template <typename T>
+void LockFreeJobQueue<T>::Notify(std::condition_variable* condition,
+                                 const std::atomic<int>& num_waiting,
+                                 const bool notify_all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_waiting > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (notify_all) {
+      condition->notify_all();
+    } else {
+      condition->notify_one();
+    }
+  }
+}
+
+template <typename T>
+void LockFreeJobQueue<T>::NotifyPopped(const bool notify_all) {
+  Notify(&push_condition_, num_waiting_pushers_, notify_all);
+  if (Size() == 0) {
+    Notify(&empty_condition_, num_waiting_empty_, /*notify_all=*/true);
+  }
+}
+
+template <typename T>
+bool LockFreeJobQueue<T>::Push(T data) {
+  while (!stop_) {
+    if (TryPush(&data)) {
+      Notify(&pop_condition_, num_waiting_poppers_, /*notify_all=*/false);
+      return true;
+    }
+    WaitUntil(&push_condition_,
+              &num_waiting_pushers_,
+              /*stop_waiting=*/true,
+              [this]() { return Size() < MaxNumJobs(); });
+  }
+  return false;
+}
+
+template <typename T>
+bool LockFreeJobQueue<T>::PushBatch(std::vector<T> data) {
+  size_t num_pushed = 0;
+  while (num_pushed < data.size()) {
+    if (stop_) {
+      return false;
+    }
+    const size_t num_prev_pushed = num_pushed;
+    while (num_pushed < data.size() && TryPush(&data[num_pushed])) {
+      num_pushed += 1;
+    }
+    if (num_pushed > num_prev_pushed) {
+      Notify(&pop_condition_, num_waiting_poppers_, /*notify_all=*/true);
+    }
+    if (num_pushed < data.size()) {
+      WaitUntil(&push_condition_,
+                &num_waiting_pushers_,
+                /*stop_waiting=*/true,
+                [this]() { return Size() < MaxNumJobs(); });
+    }
+  }
+  return !stop_;
+}
+
+template <typename T>
+typename LockFreeJobQueue<T>::Job LockFreeJobQueue<T>::Pop() {
+  T data;
+  while (!stop_) {
+    if (TryPop(&data)) {
+      NotifyPopped(/*notify_all=*/false);
+      return Job(std::move(data));
+    }
+    WaitUntil(&pop_condition_,
+              &num_waiting_poppers_,
+              /*stop_waiting=*/true,
+              [this]() { return Size() > 0; });
+  }
+  return Job();
+}
+
+template <typename T>
+std::vector<T> LockFreeJobQueue<T>::PopBatch(const size_t max_num_jobs) {
+  std::vector<T> jobs;
+  T data;
+  while (!stop_) {
+    while (jobs.size() < max_num_jobs && TryPop(&data)) {
+      jobs.push_back(std::move(data));
+    }
+    if (!jobs.empty()) {
+      NotifyPopped(/*notify_all=*/true);
+      return jobs;
+    }
+    WaitUntil(&pop_condition_,
+              &num_waiting_poppers_,
+              /*stop_waiting=*/true,
+              [this]() { return Size() > 0; });
+  }
+  return jobs;
+}
+
+template <typename T>
+void LockFreeJobQueue<T>::Wait() {
+  WaitUntil(&empty_condition_,
+            &num_waiting_empty_,
+            /*stop_waiting=*/false,
+            [this]() { return Size() == 0; });
+}
+
+template <typename T>
+void LockFreeJobQueue<T>::Stop() {
+  stop_ = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  push_condition_.notify_all();
+  pop_condition_.notify_all();
+}
+
+template <typename T>
+void LockFreeJobQueue<T>::Clear() {
+  T data;
+  while (TryPop(&data)) {
+  }
+  NotifyPopped(/*notify_all=*/true);
+}
+
+template <typename func_t>
+void ParallelForChunks(ThreadPool* thread_pool,
+                       const size_t num_items,
+                       const size_t min_chunk_size,
+                       const func_t& func) {
+  if (thread_pool == nullptr || thread_pool->NumThreads() <= 1 ||
+      num_items < 2 * std::max<size_t>(min_chunk_size, 1)) {
+    func(0, num_items);
+    return;
+  }
+
+  const size_t num_chunks =
+      std::min(4 * thread_pool->NumThreads(),
+               num_items / std::max<size_t>(min_chunk_size, 1));
+  const size_t chunk_size = (num_items + num_chunks - 1) / num_chunks;
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_chunks);
+  for (size_t begin = 0; begin < num_items; begin += chunk_size) {
+    const size_t end = std::min(begin + chunk_size, num_items);
+    // The caller waits for the chunks, so they precede independent tasks.
+    futures.push_back(thread_pool->AddTaskWithPriority(
+        ThreadPool::Priority::HIGH, func, begin, end));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+template <typename func_t>
+void ParallelForChunks(const int num_threads,
+                       const size_t num_items,
+                       const size_t min_chunk_size,
+                       const func_t& func) {
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  if (num_eff_threads <= 1 ||
+      num_items < 2 * std::max<size_t>(min_chunk_size, 1)) {
+    func(0, num_items);
+    return;
+  }
+
+  ThreadPool thread_pool(num_eff_threads);
+  ParallelForChunks(&thread_pool, num_items, min_chunk_size, func);
+}
+
 }  // namespace colmap
@@ -31,6 +31,8 @@
 
 #include "colmap/util/logging.h"
 
+#include <set>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -69,6 +71,65 @@ class Barrier {
   size_t generation_;
 };
 
+TEST(NumaTopology, Nominal) {
+  const int num_numa_nodes = GetNumNumaNodes();
+  EXPECT_GE(num_numa_nodes, 1);
+  std::set<int> cpus;
+  for (int numa_node = 0; numa_node < num_numa_nodes; ++numa_node) {
+    const std::vector<int> numa_node_cpus = GetNumaNodeCpus(numa_node);
+    EXPECT_FALSE(numa_node_cpus.empty());
+    for (const int cpu : numa_node_cpus) {
+      EXPECT_TRUE(cpus.insert(cpu).second);
+    }
+  }
+  EXPECT_ANY_THROW(GetNumaNodeCpus(num_numa_nodes));
+}
+
+TEST(GetNumaNodeOfThread, Nominal) {
+  const int num_numa_nodes = GetNumNumaNodes();
+  const int num_threads = 4 * num_numa_nodes;
+  std::vector<int> num_threads_per_node(num_numa_nodes, 0);
+  int prev_numa_node = 0;
+  for (int index = 0; index < num_threads; ++index) {
+    const int numa_node = GetNumaNodeOfThread(index, num_threads);
+    EXPECT_GE(numa_node, prev_numa_node);
+    num_threads_per_node.at(numa_node) += 1;
+    prev_numa_node = numa_node;
+  }
+  for (const int num_node_threads : num_threads_per_node) {
+    EXPECT_EQ(num_node_threads, 4);
+  }
+  EXPECT_EQ(GetNumaNodeOfThread(0, 1), 0);
+}
+
+TEST(ThreadPool, PinToNumaNodes) {
+  ThreadPool pool(4, /*pin_to_numa_nodes=*/true);
+  std::vector<int> results(100, 0);
+  for (size_t i = 0; i < results.size(); ++i) {
+    pool.AddTask([&results, i]() { results[i] = i; });
+  }
+  pool.Wait();
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results[i], i);
+  }
+}
+
+TEST(Thread, SetNumaNode) {
+  class TestThread : public Thread {
+   public:
+    std::atomic<bool> ran{false};
+
+   private:
+    void Run() override { ran = true; }
+  };
+
+  TestThread thread;
+  thread.SetNumaNode(0);
+  thread.Start();
+  thread.Wait();
+  EXPECT_TRUE(thread.ran);
+}
+
 }  // namespace
 
 // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
@@ -640,6 +701,58 @@ TEST(ThreadPool, GetThreadIndex) {
   }
 }
 
+TEST(ThreadPool, Priority) {
+  ThreadPool pool(1);
+
+  // Block the only worker until all tasks are added.
+  std::promise<void> unblock;
+  std::shared_future<void> unblocked = unblock.get_future().share();
+  pool.AddTask([unblocked]() { unblocked.wait(); });
+
+  std::mutex mutex;
+  std::vector<int> order;
+  const auto Func = [&](const int num) {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(num);
+  };
+  pool.AddTask(Func, 0);
+  pool.AddTask(Func, 1);
+  pool.AddTaskWithPriority(ThreadPool::Priority::HIGH, Func, 2);
+  pool.AddTaskWithPriority(ThreadPool::Priority::HIGH, Func, 3);
+  unblock.set_value();
+  pool.Wait();
+
+  EXPECT_EQ(order, std::vector<int>({2, 3, 0, 1}));
+}
+
+TEST(ThreadPool, NestedTasks) {
+  ThreadPool pool(4);
+
+  std::atomic<int> num_tasks(0);
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < 4; ++i) {
+    futures.push_back(pool.AddTask([&]() {
+      // The nested tasks are added to the worker's own queue and stolen by
+      // the other workers.
+      for (int j = 0; j < 100; ++j) {
+        pool.AddTask([&]() { num_tasks += 1; });
+      }
+    }));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+  pool.Wait();
+
+  EXPECT_EQ(num_tasks, 400);
+}
+
+TEST(ThreadPool, AddTaskAfterStop) {
+  ThreadPool pool(2);
+  pool.Stop();
+  EXPECT_THROW(pool.AddTask([]() {}), std::runtime_error);
+}
+
 TEST(JobQueue, SingleProducerSingleConsumer) {
   JobQueue<int> job_queue;
 
@@ -887,6 +1000,219 @@ TEST(JobQueue, Clear) {
   EXPECT_EQ(job_queue.Size(), 0);
 }
 
+TEST(LockFreeJobQueue, MaxNumJobs) {
+  EXPECT_EQ(LockFreeJobQueue<int>(0).MaxNumJobs(), 2);
+  EXPECT_EQ(LockFreeJobQueue<int>(1).MaxNumJobs(), 2);
+  EXPECT_EQ(LockFreeJobQueue<int>(2).MaxNumJobs(), 2);
+  EXPECT_EQ(LockFreeJobQueue<int>(3).MaxNumJobs(), 4);
+  EXPECT_EQ(LockFreeJobQueue<int>(100).MaxNumJobs(), 128);
+  EXPECT_EQ(LockFreeJobQueue<int>().MaxNumJobs(),
+            LockFreeJobQueue<int>::kDefaultMaxNumJobs);
+}
+
+TEST(LockFreeJobQueue, SingleProducerSingleConsumer) {
+  LockFreeJobQueue<int> job_queue(2);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  std::thread producer_thread([&job_queue]() {
+    for (int i = 0; i < 100; ++i) {
+      CHECK(job_queue.Push(i));
+    }
+  });
+
+  std::thread consumer_thread([&job_queue]() {
+    for (int i = 0; i < 100; ++i) {
+      CHECK_LE(job_queue.Size(), 2);
+      const auto job = job_queue.Pop();
+      CHECK(job.IsValid());
+      CHECK_EQ(job.Data(), i);
+    }
+  });
+
+  producer_thread.join();
+  consumer_thread.join();
+}
+
+TEST(LockFreeJobQueue, MultipleProducerMultipleConsumer) {
+  LockFreeJobQueue<int> job_queue(2);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  constexpr int kNumThreads = 4;
+  constexpr int kNumJobsPerThread = 1000;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&job_queue, t]() {
+      for (int i = 0; i < kNumJobsPerThread; ++i) {
+        CHECK(job_queue.Push(t * kNumJobsPerThread + i));
+      }
+    });
+  }
+
+  std::vector<std::vector<int>> popped(kNumThreads);
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&job_queue, &popped, t]() {
+      for (int i = 0; i < kNumJobsPerThread; ++i) {
+        const auto job = job_queue.Pop();
+        CHECK(job.IsValid());
+        popped[t].push_back(job.Data());
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<int> all_popped;
+  for (const auto& thread_popped : popped) {
+    all_popped.insert(
+        all_popped.end(), thread_popped.begin(), thread_popped.end());
+  }
+  std::sort(all_popped.begin(), all_popped.end());
+  ASSERT_EQ(all_popped.size(), kNumThreads * kNumJobsPerThread);
+  for (size_t i = 0; i < all_popped.size(); ++i) {
+    EXPECT_EQ(all_popped[i], i);
+  }
+  EXPECT_EQ(job_queue.Size(), 0);
+}
+
+TEST(LockFreeJobQueue, Batch) {
+  LockFreeJobQueue<int> job_queue(4);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  std::thread producer_thread([&job_queue]() {
+    std::vector<int> batch(100);
+    for (int i = 0; i < 100; ++i) {
+      batch[i] = i;
+    }
+    CHECK(job_queue.PushBatch(std::move(batch)));
+  });
+
+  std::thread consumer_thread([&job_queue]() {
+    int next = 0;
+    while (next < 100) {
+      const std::vector<int> jobs = job_queue.PopBatch(3);
+      CHECK_GE(jobs.size(), 1);
+      CHECK_LE(jobs.size(), 3);
+      for (const int job : jobs) {
+        CHECK_EQ(job, next);
+        next += 1;
+      }
+    }
+  });
+
+  producer_thread.join();
+  consumer_thread.join();
+
+  EXPECT_TRUE(job_queue.PushBatch({}));
+  EXPECT_EQ(job_queue.Size(), 0);
+}
+
+TEST(LockFreeJobQueue, Wait) {
+  LockFreeJobQueue<int> job_queue(16);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  for (int i = 0; i < 10; ++i) {
+    CHECK(job_queue.Push(i));
+  }
+
+  std::thread consumer_thread([&job_queue]() {
+    CHECK_EQ(job_queue.Size(), 10);
+    for (int i = 0; i < 10; ++i) {
+      const auto job = job_queue.Pop();
+      CHECK(job.IsValid());
+      CHECK_EQ(job.Data(), i);
+    }
+  });
+
+  job_queue.Wait();
+
+  EXPECT_EQ(job_queue.Size(), 0);
+  EXPECT_TRUE(job_queue.Push(0));
+  EXPECT_TRUE(job_queue.Pop().IsValid());
+
+  consumer_thread.join();
+}
+
+TEST(LockFreeJobQueue, StopProducer) {
+  LockFreeJobQueue<int> job_queue(2);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  Barrier stopBarrier;
+  std::thread producer_thread([&job_queue, &stopBarrier]() {
+    CHECK(job_queue.Push(0));
+    CHECK(job_queue.Push(1));
+    stopBarrier.Wait();
+    CHECK(!job_queue.Push(2));
+    CHECK(!job_queue.PushBatch({3, 4}));
+  });
+
+  stopBarrier.Wait();
+  EXPECT_EQ(job_queue.Size(), 2);
+
+  job_queue.Stop();
+  producer_thread.join();
+
+  EXPECT_FALSE(job_queue.Push(0));
+  EXPECT_FALSE(job_queue.Pop().IsValid());
+  EXPECT_TRUE(job_queue.PopBatch(2).empty());
+}
+
+TEST(LockFreeJobQueue, StopConsumer) {
+  LockFreeJobQueue<int> job_queue(2);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  EXPECT_TRUE(job_queue.Push(0));
+
+  Barrier popBarrier;
+  std::thread consumer_thread([&job_queue, &popBarrier]() {
+    const auto job = job_queue.Pop();
+    CHECK(job.IsValid());
+    CHECK_EQ(job.Data(), 0);
+    popBarrier.Wait();
+    CHECK(!job_queue.Pop().IsValid());
+    CHECK(job_queue.PopBatch(2).empty());
+  });
+
+  popBarrier.Wait();
+  EXPECT_EQ(job_queue.Size(), 0);
+
+  job_queue.Stop();
+  consumer_thread.join();
+
+  EXPECT_FALSE(job_queue.Push(0));
+  EXPECT_FALSE(job_queue.Pop().IsValid());
+}
+
+TEST(LockFreeJobQueue, Clear) {
+  LockFreeJobQueue<int> job_queue(2);
+
+  EXPECT_TRUE(job_queue.Push(0));
+  EXPECT_TRUE(job_queue.Push(1));
+  EXPECT_EQ(job_queue.Size(), 2);
+
+  job_queue.Clear();
+  EXPECT_EQ(job_queue.Size(), 0);
+
+  EXPECT_TRUE(job_queue.Push(2));
+  const auto job = job_queue.Pop();
+  EXPECT_TRUE(job.IsValid());
+  EXPECT_EQ(job.Data(), 2);
+}
+
 TEST(GetEffectiveNumThreads, Nominal) {
   EXPECT_GT(GetEffectiveNumThreads(-2), 0);
   EXPECT_GT(GetEffectiveNumThreads(-1), 0);
@@ -896,5 +1222,51 @@ TEST(GetEffectiveNumThreads, Nominal) {
   EXPECT_EQ(GetEffectiveNumThreads(3), 3);
 }
 
+TEST(ParallelForChunks, Nominal) {
+  ThreadPool thread_pool(4);
+  for (ThreadPool* pool : {static_cast<ThreadPool*>(nullptr), &thread_pool}) {
+    for (const size_t num_items : {0, 1, 10, 99, 1000}) {
+      std::vector<int> counts(num_items, 0);
+      std::mutex mutex;
+      size_t num_chunks = 0;
+      ParallelForChunks(
+          pool, num_items, 10, [&](const size_t begin, const size_t end) {
+            EXPECT_LE(begin, end);
+            EXPECT_LE(end, num_items);
+            for (size_t i = begin; i < end; ++i) {
+              counts[i] += 1;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            num_chunks += 1;
+          });
+      for (const int count : counts) {
+        EXPECT_EQ(count, 1);
+      }
+      if (pool == nullptr || num_items < 20) {
+        EXPECT_EQ(num_chunks, 1);
+      } else {
+        EXPECT_GT(num_chunks, 1);
+      }
+    }
+  }
+}
+
+TEST(ParallelForChunks, NumThreads) {
+  for (const int num_threads : {-1, 1, 4}) {
+    std::vector<int> counts(1000, 0);
+    ParallelForChunks(num_threads,
+                      counts.size(),
+                      10,
+                      [&](const size_t begin, const size_t end) {
+                        for (size_t i = begin; i < end; ++i) {
+                          counts[i] += 1;
+                        }
+                      });
+    for (const int count : counts) {
+      EXPECT_EQ(count, 1);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace colmap
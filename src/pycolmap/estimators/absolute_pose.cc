@@ -3,11 +3,15 @@
 #include "colmap/math/random.h"
 #include "colmap/scene/camera.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
 #include "pycolmap/helpers.h"
 #include "pycolmap/pybind11_extension.h"
 #include "pycolmap/utils.h"
 
+#include <future>
+#include <vector>
+
 #include <pybind11/eigen.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -16,6 +20,54 @@ using namespace colmap;
 using namespace pybind11::literals;
 namespace py = pybind11;
 
+namespace {
+
+struct AbsolutePoseEstimate {
+  Rigid3d cam_from_world;
+  Camera camera;
+  size_t num_inliers = 0;
+  std::vector<char> inlier_mask;
+  Eigen::Matrix<double, 6, 6> covariance;
+};
+
+// Can be called without holding the GIL.
+bool EstimateAndRefineAbsolutePose(
+    const std::vector<Eigen::Vector2d>& points2D,
+    const std::vector<Eigen::Vector3d>& points3D,
+    const AbsolutePoseEstimationOptions& estimation_options,
+    const AbsolutePoseRefinementOptions& refinement_options,
+    const bool return_covariance,
+    AbsolutePoseEstimate* estimate) {
+  if (!EstimateAbsolutePose(estimation_options,
+                            points2D,
+                            points3D,
+                            &estimate->cam_from_world,
+                            &estimate->camera,
+                            &estimate->num_inliers,
+                            &estimate->inlier_mask)) {
+    return false;
+  }
+  return RefineAbsolutePose(
+      refinement_options,
+      estimate->inlier_mask,
+      points2D,
+      points3D,
+      &estimate->cam_from_world,
+      &estimate->camera,
+      return_covariance ? &estimate->covariance : nullptr);
+}
+
+py::dict AbsolutePoseEstimateToDict(const AbsolutePoseEstimate& estimate,
+                                    const bool return_covariance) {
+  py::dict success_dict("cam_from_world"_a = estimate.cam_from_world,
+                        "num_inliers"_a = estimate.num_inliers,
+                        "inliers"_a = ToPythonMask(estimate.inlier_mask));
+  if (return_covariance) success_dict["covariance"] = estimate.covariance;
+  return success_dict;
+}
+
+}  // namespace
+
 py::object PyEstimateAndRefineAbsolutePose(
     const std::vector<Eigen::Vector2d>& points2D,
     const std::vector<Eigen::Vector3d>& points3D,
@@ -24,38 +76,68 @@ py::object PyEstimateAndRefineAbsolutePose(
     const AbsolutePoseRefinementOptions& refinement_options,
     const bool return_covariance) {
   py::gil_scoped_release release;
-  Rigid3d cam_from_world;
-  size_t num_inliers;
-  std::vector<char> inlier_mask;
-  if (!EstimateAbsolutePose(estimation_options,
-                            points2D,
-                            points3D,
-                            &cam_from_world,
-                            &camera,
-                            &num_inliers,
-                            &inlier_mask)) {
-    py::gil_scoped_acquire acquire;
+  AbsolutePoseEstimate estimate;
+  estimate.camera = camera;
+  const bool success = EstimateAndRefineAbsolutePose(points2D,
+                                                     points3D,
+                                                     estimation_options,
+                                                     refinement_options,
+                                                     return_covariance,
+                                                     &estimate);
+  py::gil_scoped_acquire acquire;
+  camera = estimate.camera;
+  if (!success) {
     return py::none();
   }
+  return AbsolutePoseEstimateToDict(estimate, return_covariance);
+}
 
-  Eigen::Matrix<double, 6, 6> covariance;
-  if (!RefineAbsolutePose(refinement_options,
-                          inlier_mask,
-                          points2D,
-                          points3D,
-                          &cam_from_world,
-                          &camera,
-                          return_covariance ? &covariance : nullptr)) {
-    py::gil_scoped_acquire acquire;
-    return py::none();
+py::list PyEstimateAndRefineAbsolutePoseBatch(
+    const std::vector<std::vector<Eigen::Vector2d>>& points2D,
+    const std::vector<std::vector<Eigen::Vector3d>>& points3D,
+    const std::vector<Camera>& cameras,
+    const AbsolutePoseEstimationOptions& estimation_options,
+    const AbsolutePoseRefinementOptions& refinement_options,
+    const bool return_covariance,
+    const int num_threads) {
+  THROW_CHECK_EQ(points2D.size(), cameras.size());
+  THROW_CHECK_EQ(points3D.size(), cameras.size());
+  const size_t num_problems = cameras.size();
+  std::vector<AbsolutePoseEstimate> estimates(num_problems);
+  std::vector<char> successes(num_problems, false);
+  {
+    py::gil_scoped_release release;
+    ThreadPool thread_pool(num_threads);
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_problems);
+    for (size_t i = 0; i < num_problems; ++i) {
+      futures.push_back(thread_pool.AddTask([&, i]() {
+        estimates[i].camera = cameras[i];
+        successes[i] = EstimateAndRefineAbsolutePose(points2D[i],
+                                                     points3D[i],
+                                                     estimation_options,
+                                                     refinement_options,
+                                                     return_covariance,
+                                                     &estimates[i]);
+      }));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
   }
 
-  py::gil_scoped_acquire acquire;
-  py::dict success_dict("cam_from_world"_a = cam_from_world,
-                        "num_inliers"_a = num_inliers,
-                        "inliers"_a = ToPythonMask(inlier_mask));
-  if (return_covariance) success_dict["covariance"] = covariance;
-  return success_dict;
+  py::list results;
+  for (size_t i = 0; i < num_problems; ++i) {
+    if (successes[i]) {
+      py::dict success_dict =
+          AbsolutePoseEstimateToDict(estimates[i], return_covariance);
+      success_dict["camera"] = estimates[i].camera;
+      results.append(std::move(success_dict));
+    } else {
+      results.append(py::none());
+    }
+  }
+  return results;
 }
 
 py::object PyRefineAbsolutePose(
@@ -144,6 +226,19 @@ void BindAbsolutePoseEstimator(py::module& m) {
         "return_covariance"_a = false,
         "Absolute pose estimation with non-linear refinement.");
 
+  m.def("absolute_pose_estimation_batch",
+        &PyEstimateAndRefineAbsolutePoseBatch,
+        "points2D"_a,
+        "points3D"_a,
+        "cameras"_a,
+        "estimation_options"_a = est_options,
+        "refinement_options"_a = ref_options,
+        "return_covariance"_a = false,
+        "num_threads"_a = -1,
+        "Absolute pose estimation with non-linear refinement for a list of "
+        "problems in parallel. Returns a list with None for failed problems "
+        "and otherwise the result dict including the refined camera.");
+
   m.def("pose_refinement",
         &PyRefineAbsolutePose,
         "cam_from_world"_a,
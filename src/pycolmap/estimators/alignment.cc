@@ -33,11 +33,17 @@ void BindAlignmentEstimator(py::module& m) {
          const double min_inlier_observations,
          const double max_reproj_error) -> py::object {
         Sim3d tgt_from_src;
-        if (!AlignReconstructionsViaReprojections(src_reconstruction,
-                                                  tgt_reconstruction,
-                                                  min_inlier_observations,
-                                                  max_reproj_error,
-                                                  &tgt_from_src)) {
+        bool success;
+        {
+          py::gil_scoped_release release;
+          success = AlignReconstructionsViaReprojections(
+              src_reconstruction,
+              tgt_reconstruction,
+              min_inlier_observations,
+              max_reproj_error,
+              &tgt_from_src);
+        }
+        if (!success) {
           return py::none();
         }
         return py::cast(tgt_from_src);
@@ -53,10 +59,15 @@ void BindAlignmentEstimator(py::module& m) {
          const Reconstruction& tgt_reconstruction,
          const double max_proj_center_error) -> py::object {
         Sim3d tgt_from_src;
-        if (!AlignReconstructionsViaProjCenters(src_reconstruction,
-                                                tgt_reconstruction,
-                                                max_proj_center_error,
-                                                &tgt_from_src)) {
+        bool success;
+        {
+          py::gil_scoped_release release;
+          success = AlignReconstructionsViaProjCenters(src_reconstruction,
+                                                       tgt_reconstruction,
+                                                       max_proj_center_error,
+                                                       &tgt_from_src);
+        }
+        if (!success) {
           return py::none();
         }
         return py::cast(tgt_from_src);
@@ -73,12 +84,17 @@ void BindAlignmentEstimator(py::module& m) {
          const double max_error,
          const double min_inlier_ratio) -> py::object {
         Sim3d tgt_from_src;
-        if (!AlignReconstructionsViaPoints(src_reconstruction,
-                                           tgt_reconstruction,
-                                           min_common_observations,
-                                           max_error,
-                                           min_inlier_ratio,
-                                           &tgt_from_src)) {
+        bool success;
+        {
+          py::gil_scoped_release release;
+          success = AlignReconstructionsViaPoints(src_reconstruction,
+                                                  tgt_reconstruction,
+                                                  min_common_observations,
+                                                  max_error,
+                                                  min_inlier_ratio,
+                                                  &tgt_from_src);
+        }
+        if (!success) {
           return py::none();
         }
         return py::cast(tgt_from_src);
@@ -89,6 +105,36 @@ void BindAlignmentEstimator(py::module& m) {
       "max_error"_a = 0.005,
       "min_inlier_ratio"_a = 0.9);
 
+  m.def(
+      "refine_reconstruction_alignment_via_nearest_points",
+      [](const Reconstruction& src_reconstruction,
+         const Reconstruction& tgt_reconstruction,
+         Sim3d tgt_from_src,
+         const double max_distance,
+         const int max_num_iterations) -> py::object {
+        bool success;
+        {
+          py::gil_scoped_release release;
+          success =
+              RefineReconstructionAlignmentViaNearestPoints(src_reconstruction,
+                                                            tgt_reconstruction,
+                                                            max_distance,
+                                                            max_num_iterations,
+                                                            &tgt_from_src);
+        }
+        if (!success) {
+          return py::none();
+        }
+        return py::cast(tgt_from_src);
+      },
+      "src_reconstruction"_a,
+      "tgt_reconstruction"_a,
+      "tgt_from_src"_a,
+      "max_distance"_a,
+      "max_num_iterations"_a = 50,
+      "Refine an initial alignment by iteratively associating the 3D points "
+      "with their nearest neighbors.");
+
   m.def(
       "align_reconstrution_to_locations",
       [](const Reconstruction& src,
@@ -97,12 +143,17 @@ void BindAlignmentEstimator(py::module& m) {
          const int min_common_images,
          const RANSACOptions& ransac_options) -> py::object {
         Sim3d locations_from_src;
-        if (!AlignReconstructionToLocations(src,
-                                            image_names,
-                                            locations,
-                                            min_common_images,
-                                            ransac_options,
-                                            &locations_from_src)) {
+        bool success;
+        {
+          py::gil_scoped_release release;
+          success = AlignReconstructionToLocations(src,
+                                                   image_names,
+                                                   locations,
+                                                   min_common_images,
+                                                   ransac_options,
+                                                   &locations_from_src);
+        }
+        if (!success) {
           return py::none();
         }
         return py::cast(locations_from_src);
@@ -123,14 +174,19 @@ void BindAlignmentEstimator(py::module& m) {
          double max_proj_center_error) -> py::object {
         std::vector<ImageAlignmentError> errors;
         Sim3d rec2_from_rec1;
-        if (!CompareModels(reconstruction1,
-                           reconstruction2,
-                           alignment_error,
-                           min_inlier_observations,
-                           max_reproj_error,
-                           max_proj_center_error,
-                           errors,
-                           rec2_from_rec1)) {
+        bool success;
+        {
+          py::gil_scoped_release release;
+          success = CompareModels(reconstruction1,
+                                  reconstruction2,
+                                  alignment_error,
+                                  min_inlier_observations,
+                                  max_reproj_error,
+                                  max_proj_center_error,
+                                  errors,
+                                  rec2_from_rec1);
+        }
+        if (!success) {
           return py::none();
         }
         return py::dict("rec2_from_rec1"_a = rec2_from_rec1,
@@ -65,6 +65,45 @@ void BindBundleAdjuster(py::module& m) {
           "constant_cam_positions", &BACfg::ConstantCamPositions, "image_id"_a);
   MakeDataclass(PyBundleAdjustmentConfig);
 
+  using BATelemetry = BundleAdjustmentTelemetry;
+  py::class_<BATelemetry::Iteration>(m, "BundleAdjustmentTelemetryIteration")
+      .def(py::init<>())
+      .def_readonly("error", &BATelemetry::Iteration::error)
+      .def_readonly("time", &BATelemetry::Iteration::time)
+      .def_readonly("linear_solver_time",
+                    &BATelemetry::Iteration::linear_solver_time)
+      .def_readonly("num_linear_solver_iterations",
+                    &BATelemetry::Iteration::num_linear_solver_iterations)
+      .def_readonly("successful", &BATelemetry::Iteration::successful);
+
+  py::class_<BATelemetry>(m, "BundleAdjustmentTelemetry")
+      .def(py::init<>())
+      .def_readonly("label", &BATelemetry::label)
+      .def_readonly("setup_time", &BATelemetry::setup_time)
+      .def_readonly("preprocessor_time", &BATelemetry::preprocessor_time)
+      .def_readonly("residual_evaluation_time",
+                    &BATelemetry::residual_evaluation_time)
+      .def_readonly("jacobian_evaluation_time",
+                    &BATelemetry::jacobian_evaluation_time)
+      .def_readonly("linear_solver_time", &BATelemetry::linear_solver_time)
+      .def_readonly("minimizer_time", &BATelemetry::minimizer_time)
+      .def_readonly("total_time", &BATelemetry::total_time)
+      .def_readonly("num_images", &BATelemetry::num_images)
+      .def_readonly("num_points", &BATelemetry::num_points)
+      .def_readonly("num_residuals", &BATelemetry::num_residuals)
+      .def_readonly("num_residual_blocks", &BATelemetry::num_residual_blocks)
+      .def_readonly("num_parameters", &BATelemetry::num_parameters)
+      .def_readonly("num_parameter_blocks", &BATelemetry::num_parameter_blocks)
+      .def_readonly("num_threads", &BATelemetry::num_threads)
+      .def_readonly("num_iterations", &BATelemetry::num_iterations)
+      .def_readonly("num_successful_iterations",
+                    &BATelemetry::num_successful_iterations)
+      .def_readonly("initial_error", &BATelemetry::initial_error)
+      .def_readonly("final_error", &BATelemetry::final_error)
+      .def_readonly("termination", &BATelemetry::termination)
+      .def_readonly("iterations", &BATelemetry::iterations)
+      .def("to_json", &BATelemetry::ToJson);
+
   py::class_<BundleAdjuster>(m, "BundleAdjuster")
       .def(py::init<const BundleAdjustmentOptions&,
                     const BundleAdjustmentConfig&>())
@@ -83,5 +122,41 @@ void BindBundleAdjuster(py::module& m) {
       .def_property_readonly("config", &BundleAdjuster::Config)
       .def_property_readonly("summary",
                              &BundleAdjuster::Summary,
+                             py::return_value_policy::reference_internal)
+      .def_property_readonly("telemetry",
+                             &BundleAdjuster::Telemetry,
                              py::return_value_policy::reference_internal);
+
+  using PBAOpts = PartitionedBundleAdjustmentOptions;
+  auto PyPartitionedBundleAdjustmentOptions =
+      py::class_<PBAOpts>(m, "PartitionedBundleAdjustmentOptions")
+          .def(py::init<>())
+          .def_readwrite("max_num_images",
+                         &PBAOpts::max_num_images,
+                         "Maximum number of images per partition. "
+                         "Partitioning is disabled if zero.")
+          .def_readwrite("max_num_iterations",
+                         &PBAOpts::max_num_iterations,
+                         "Maximum number of consensus iterations.")
+          .def_readwrite("consensus_weight",
+                         &PBAOpts::consensus_weight,
+                         "Weight of the consensus penalty on the shared "
+                         "parameters.")
+          .def_readwrite("consensus_tolerance",
+                         &PBAOpts::consensus_tolerance,
+                         "Mean deviation in pixels of the shared 3D points "
+                         "from their consensus to stop iterating.")
+          .def_readwrite("num_threads", &PBAOpts::num_threads);
+  MakeDataclass(PyPartitionedBundleAdjustmentOptions);
+
+  py::class_<PartitionedBundleAdjuster>(m, "PartitionedBundleAdjuster")
+      .def(py::init<const PartitionedBundleAdjustmentOptions&,
+                    const BundleAdjustmentOptions&,
+                    const BundleAdjustmentConfig&>(),
+           "options"_a,
+           "ba_options"_a,
+           "config"_a)
+      .def("solve", &PartitionedBundleAdjuster::Solve, "reconstruction"_a)
+      .def_property_readonly("partitions",
+                             &PartitionedBundleAdjuster::Partitions);
 }
@@ -60,7 +60,11 @@ void BindTriangulationEstimator(py::module& m) {
                      "Minimum triangulation angle in radians.")
       .def_readwrite(
           "residual_type", &Options::residual_type, "Employed residual type.")
-      .def_readwrite("ransac", &Options::ransac_options, "RANSAC options.");
+      .def_readwrite("ransac", &Options::ransac_options, "RANSAC options.")
+      .def_readwrite("max_exhaustive_track_length",
+                     &Options::max_exhaustive_track_length,
+                     "Evaluate all pairs of observations for tracks with at "
+                     "most this number of observations.");
   MakeDataclass(PyTriangulationOptions);
   auto triangulation_options = PyTriangulationOptions().cast<Options>();
 
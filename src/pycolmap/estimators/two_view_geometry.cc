@@ -4,11 +4,15 @@
 #include "colmap/scene/camera.h"
 #include "colmap/scene/two_view_geometry.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
 #include "pycolmap/helpers.h"
 #include "pycolmap/pybind11_extension.h"
 #include "pycolmap/utils.h"
 
+#include <future>
+#include <vector>
+
 #include <pybind11/eigen.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -40,6 +44,10 @@ void BindTwoViewGeometryEstimator(py::module& m) {
                      &TwoViewGeometryOptions::compute_relative_pose)
       .def_readwrite("multiple_models",
                      &TwoViewGeometryOptions::multiple_models)
+      .def_readwrite("parallel_estimation",
+                     &TwoViewGeometryOptions::parallel_estimation)
+      .def_readwrite("use_gpu", &TwoViewGeometryOptions::use_gpu)
+      .def_readwrite("gpu_index", &TwoViewGeometryOptions::gpu_index)
       .def_readwrite("ransac", &TwoViewGeometryOptions::ransac_options);
   MakeDataclass(PyTwoViewGeometryOptions);
   auto tvg_options = PyTwoViewGeometryOptions().cast<TwoViewGeometryOptions>();
@@ -133,13 +141,59 @@ void BindTwoViewGeometryEstimator(py::module& m) {
       "matches"_a = py::none(),
       "options"_a = tvg_options);
 
+  m.def(
+      "estimate_two_view_geometry_batch",
+      [](const std::vector<Camera>& cameras1,
+         const std::vector<std::vector<Eigen::Vector2d>>& points1,
+         const std::vector<Camera>& cameras2,
+         const std::vector<std::vector<Eigen::Vector2d>>& points2,
+         const std::vector<PyFeatureMatches>& matches,
+         const TwoViewGeometryOptions& options,
+         const int num_threads) {
+        py::gil_scoped_release release;
+        const size_t num_problems = matches.size();
+        THROW_CHECK_EQ(cameras1.size(), num_problems);
+        THROW_CHECK_EQ(points1.size(), num_problems);
+        THROW_CHECK_EQ(cameras2.size(), num_problems);
+        THROW_CHECK_EQ(points2.size(), num_problems);
+        std::vector<TwoViewGeometry> geometries(num_problems);
+        ThreadPool thread_pool(num_threads);
+        std::vector<std::future<void>> futures;
+        futures.reserve(num_problems);
+        for (size_t i = 0; i < num_problems; ++i) {
+          futures.push_back(thread_pool.AddTask([&, i]() {
+            geometries[i] =
+                EstimateTwoViewGeometry(cameras1[i],
+                                        points1[i],
+                                        cameras2[i],
+                                        points2[i],
+                                        FeatureMatchesFromMatrix(matches[i]),
+                                        options);
+          }));
+        }
+        for (auto& future : futures) {
+          future.get();
+        }
+        return geometries;
+      },
+      "cameras1"_a,
+      "points1"_a,
+      "cameras2"_a,
+      "points2"_a,
+      "matches"_a,
+      "options"_a = tvg_options,
+      "num_threads"_a = -1,
+      "Estimate the two-view geometries of a list of image pairs in "
+      "parallel.");
+
   m.def("estimate_two_view_geometry_pose",
         &EstimateTwoViewGeometryPose,
         "camera1"_a,
         "points1"_a,
         "camera2"_a,
         "points2"_a,
-        "geometry"_a);
+        "geometry"_a,
+        py::call_guard<py::gil_scoped_release>());
 
   m.def(
       "squared_sampson_error",
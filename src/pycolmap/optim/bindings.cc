@@ -25,6 +25,14 @@ void BindOptim(py::module& m) {
           .def_readwrite("dyn_num_trials_multiplier",
                          &RANSACOptions::dyn_num_trials_multiplier)
           .def_readwrite("min_num_trials", &RANSACOptions::min_num_trials)
-          .def_readwrite("max_num_trials", &RANSACOptions::max_num_trials);
+          .def_readwrite("max_num_trials", &RANSACOptions::max_num_trials)
+          .def_readwrite("use_sprt",
+                         &RANSACOptions::use_sprt,
+                         "Whether to reject bad models early with the "
+                         "randomized SPRT verification.")
+          .def_readwrite("num_threads",
+                         &RANSACOptions::num_threads,
+                         "Number of threads to evaluate hypotheses with, "
+                         "where -1 uses all cores.");
   MakeDataclass(PyRANSACOptions);
 }
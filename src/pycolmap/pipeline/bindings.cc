@@ -4,6 +4,7 @@ namespace py = pybind11;
 
 void BindExtractFeatures(py::module& m);
 void BindImages(py::module& m);
+void BindLocalization(py::module& m);
 void BindMatchFeatures(py::module& m);
 void BindMeshing(py::module& m);
 void BindMVS(py::module& m);
@@ -14,6 +15,7 @@ void BindPipeline(py::module& m) {
   BindExtractFeatures(m);
   BindMatchFeatures(m);
   BindSfM(m);
+  BindLocalization(m);
   BindMVS(m);
   BindMeshing(m);
 }
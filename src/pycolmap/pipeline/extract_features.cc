@@ -67,6 +67,17 @@ void BindExtractFeatures(py::module& m) {
           .value(
               "L2", SEOpts::Normalization::L2, "Each vector is L2-normalized.");
   AddStringToEnumConstructor(PyNormalization);
+  auto PyFeatureDescriptorType =
+      py::enum_<FeatureDescriptorType>(m, "FeatureDescriptorType")
+          .value("SIFT", FeatureDescriptorType::SIFT)
+          .value("BINARY",
+                 FeatureDescriptorType::BINARY,
+                 "256-bit ORB-like descriptors matched by their Hamming "
+                 "distance.")
+          .value("SIFT_PCA",
+                 FeatureDescriptorType::SIFT_PCA,
+                 "SIFT descriptors reduced by a learned PCA projection.");
+  AddStringToEnumConstructor(PyFeatureDescriptorType);
   auto PySiftExtractionOptions =
       py::class_<SEOpts>(m, "SiftExtractionOptions")
           .def(py::init<>())
@@ -83,10 +94,37 @@ void BindExtractFeatures(py::module& m) {
               "max_image_size",
               &SEOpts::max_image_size,
               "Maximum image size, otherwise image will be down-scaled.")
+          .def_readwrite("gpu_downsample",
+                         &SEOpts::gpu_downsample,
+                         "Whether to upload images at full resolution and let "
+                         "SiftGPU down-scale them on the GPU instead of "
+                         "resizing them on the CPU. SiftGPU down-scales by "
+                         "powers of two. Only used for GPU extraction.")
+          .def_readwrite("gpu_num_threads_per_device",
+                         &SEOpts::gpu_num_threads_per_device,
+                         "Number of extraction threads per GPU, each with its "
+                         "own SiftGPU context. Two threads overlap the GPU "
+                         "work of one image with the CPU work of another.")
+          .def_readwrite("gpu_pyramid_bucket_size",
+                         &SEOpts::gpu_pyramid_bucket_size,
+                         "Granularity in pixels of the SiftGPU pyramid "
+                         "allocation, so that images of similar sizes reuse "
+                         "the allocated pyramid. Disabled if <= 0.")
           .def_readwrite("max_num_features",
                          &SEOpts::max_num_features,
                          "Maximum number of features to detect, keeping "
                          "larger-scale features.")
+          .def_readwrite("tile_size",
+                         &SEOpts::tile_size,
+                         "Split images larger than tile_size into "
+                         "overlapping tiles that are processed in parallel "
+                         "by the CPU extractor. Disabled if <= 0.")
+          .def_readwrite("tile_overlap",
+                         &SEOpts::tile_overlap,
+                         "Overlap in pixels between neighboring tiles.")
+          .def_readwrite("tile_num_threads",
+                         &SEOpts::tile_num_threads,
+                         "Number of threads for tiled extraction.")
           .def_readwrite("first_octave",
                          &SEOpts::first_octave,
                          "First octave in the pyramid, i.e. -1 upsamples the "
@@ -127,7 +165,28 @@ void BindExtractFeatures(py::module& m) {
           .def_readwrite("dsp_num_scales", &SEOpts::dsp_num_scales)
           .def_readwrite("normalization",
                          &SEOpts::normalization,
-                         "L1_ROOT or L2 descriptor normalization");
+                         "L1_ROOT or L2 descriptor normalization")
+          .def_readwrite("descriptor_type",
+                         &SEOpts::descriptor_type,
+                         "SIFT or BINARY descriptors. Binary descriptors are "
+                         "always extracted on the CPU.")
+          .def_readwrite("pca_path",
+                         &SEOpts::pca_path,
+                         "Path to a SIFT PCA projection, by which the "
+                         "descriptors are reduced before they are stored.")
+          .def_readwrite("feature_cache_path",
+                         &SEOpts::feature_cache_path,
+                         "Path to a directory of features cached by image "
+                         "content and options, which can be shared by "
+                         "multiple databases. Disabled if empty.")
+          .def_readwrite("max_num_images_per_transaction",
+                         &SEOpts::max_num_images_per_transaction,
+                         "Maximum number of images written to the database "
+                         "in one transaction.")
+          .def_readwrite("max_transaction_duration",
+                         &SEOpts::max_transaction_duration,
+                         "Maximum duration in seconds of one database "
+                         "transaction.");
   MakeDataclass(PySiftExtractionOptions);
   auto sift_extraction_options = PySiftExtractionOptions().cast<SEOpts>();
 
@@ -48,8 +48,7 @@ void ImportImages(const std::string& database_path,
     Camera camera;
     Image image;
     PosePrior pose_prior;
-    Bitmap bitmap;
-    if (image_reader.Next(&camera, &image, &pose_prior, &bitmap, nullptr) !=
+    if (image_reader.NextMetadata(&camera, &image, &pose_prior) !=
         ImageReader::Status::SUCCESS) {
       continue;
     }
@@ -67,7 +66,7 @@ Camera InferCameraFromImage(const std::string& image_path,
                             const ImageReaderOptions& options) {
   Bitmap bitmap;
   THROW_CHECK_FILE_EXISTS(image_path);
-  THROW_CHECK(bitmap.Read(image_path, false))
+  THROW_CHECK(bitmap.ReadHeader(image_path))
       << "Cannot read image file: " << image_path;
 
   double focal_length = 0.0;
@@ -95,7 +94,8 @@ void UndistortImages(const std::string& output_path,
                      const std::string& output_type,
                      const CopyType copy_type,
                      const int num_patch_match_src_images,
-                     const UndistortCameraOptions& undistort_camera_options) {
+                     const UndistortCameraOptions& undistort_camera_options,
+                     const bool keep_distorted_images) {
   THROW_CHECK_DIR_EXISTS(image_path);
   CreateDirIfNotExists(output_path);
   Reconstruction reconstruction;
@@ -123,7 +123,8 @@ void UndistortImages(const std::string& output_path,
                                             output_path,
                                             num_patch_match_src_images,
                                             copy_type,
-                                            image_ids));
+                                            image_ids,
+                                            keep_distorted_images));
   } else if (output_type == "PMVS") {
     undistorter.reset(new PMVSUndistorter(
         undistort_camera_options, reconstruction, image_path, output_path));
@@ -187,7 +188,43 @@ void BindImages(py::module& m) {
               &IROpts::camera_mask_path,
               "Optional path to an image file specifying a mask for all "
               "images. No features will be extracted in regions where the "
-              "mask is black (pixel intensity value 0 in grayscale)");
+              "mask is black (pixel intensity value 0 in grayscale)")
+          .def_readwrite("num_threads",
+                         &IROpts::num_threads,
+                         "The number of threads used to read and decode "
+                         "images ahead of the feature extraction.")
+          .def_readwrite("max_image_size",
+                         &IROpts::max_image_size,
+                         "If positive, JPEG images that are at least twice as "
+                         "large are decoded at a reduced resolution of 1/2, "
+                         "1/4, or 1/8 that is still at least this size.")
+          .def_readwrite("bitmap_decoder",
+                         &IROpts::bitmap_decoder,
+                         "The backend used to decode the images, i.e., "
+                         "freeimage, libjpeg, or nvjpeg.")
+          .def_readwrite("video_path",
+                         &IROpts::video_path,
+                         "Optional path to a video file, whose frames are "
+                         "read instead of the images. Requires FFmpeg.")
+          .def_readwrite("video_frame_step",
+                         &IROpts::video_frame_step,
+                         "Only read every n-th selected frame of the video.")
+          .def_readwrite("video_keyframes_only",
+                         &IROpts::video_keyframes_only,
+                         "Only select the keyframes of the video.")
+          .def_readwrite("detect_changed_images",
+                         &IROpts::detect_changed_images,
+                         "Whether to re-extract the features of images whose "
+                         "file changed since their features were extracted.")
+          .def_readwrite("shard_index",
+                         &IROpts::shard_index,
+                         "Index of the contiguous block of the sorted images "
+                         "to read out of num_shards blocks.")
+          .def_readwrite("num_shards",
+                         &IROpts::num_shards,
+                         "Number of shards. New images of a shard are "
+                         "written with their index in the listing of all "
+                         "shards plus one as identifier.");
   MakeDataclass(PyImageReaderOptions);
   auto reader_options = PyImageReaderOptions().cast<IROpts>();
 
@@ -220,7 +257,15 @@ void BindImages(py::module& m) {
           .def_readwrite("roi_min_x", &UDOpts::roi_min_x)
           .def_readwrite("roi_min_y", &UDOpts::roi_min_y)
           .def_readwrite("roi_max_x", &UDOpts::roi_max_x)
-          .def_readwrite("roi_max_y", &UDOpts::roi_max_y);
+          .def_readwrite("roi_max_y", &UDOpts::roi_max_y)
+          .def_readwrite("jpeg_quality",
+                         &UDOpts::jpeg_quality,
+                         "The JPEG quality in the range [1, 100] of the "
+                         "written images. Superb quality if negative.")
+          .def_readwrite("png_compression_level",
+                         &UDOpts::png_compression_level,
+                         "The PNG compression level in the range [0, 9] of "
+                         "the written images. Default level if negative.");
   MakeDataclass(PyUndistortCameraOptions);
   auto undistort_options = PyUndistortCameraOptions().cast<UDOpts>();
 
@@ -249,5 +294,6 @@ void BindImages(py::module& m) {
         "copy_policy"_a = CopyType::COPY,
         "num_patch_match_src_images"_a = 20,
         "undistort_options"_a = undistort_options,
+        "keep_distorted_images"_a = false,
         "Undistort images");
 }
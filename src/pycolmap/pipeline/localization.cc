@@ -0,0 +1,123 @@
+#include "colmap/controllers/localization.h"
+
+#include "colmap/scene/database.h"
+#include "colmap/util/logging.h"
+
+#include "pycolmap/helpers.h"
+#include "pycolmap/pybind11_extension.h"
+#include "pycolmap/utils.h"
+
+#include <memory>
+
+#include <pybind11/eigen.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+using namespace colmap;
+using namespace pybind11::literals;
+namespace py = pybind11;
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    PyKeypoints;
+
+std::shared_ptr<Localizer> CreateLocalizer(
+    std::shared_ptr<const Reconstruction> reconstruction,
+    const std::string& database_path,
+    const LocalizationOptions& options) {
+  THROW_CHECK_FILE_EXISTS(database_path);
+  py::gil_scoped_release release;
+  const Database database(database_path);
+  return std::make_shared<Localizer>(
+      options, std::move(reconstruction), database);
+}
+
+py::object Localize(const Localizer& localizer,
+                    const Eigen::Ref<const PyKeypoints>& keypoints,
+                    const FeatureDescriptors& descriptors,
+                    Camera& camera) {
+  THROW_CHECK_GE(keypoints.cols(), 2);
+  FeatureKeypoints query_keypoints;
+  query_keypoints.reserve(keypoints.rows());
+  for (Eigen::Index i = 0; i < keypoints.rows(); ++i) {
+    query_keypoints.emplace_back(keypoints(i, 0), keypoints(i, 1));
+  }
+
+  // Concurrent queries from multiple Python threads share the matchers.
+  py::gil_scoped_release release;
+  Camera query_camera = camera;
+  LocalizationResult result;
+  const bool success = localizer.Localize(
+      query_keypoints, descriptors, &query_camera, &result);
+  py::gil_scoped_acquire acquire;
+  camera = query_camera;
+  if (!success) {
+    return py::none();
+  }
+  return py::dict("cam_from_world"_a = result.cam_from_world,
+                  "num_inliers"_a = result.num_inliers,
+                  "inliers"_a = ToPythonMask(result.inlier_mask),
+                  "correspondences"_a = result.correspondences,
+                  "retrieved_image_ids"_a = result.retrieved_image_ids,
+                  "elapsed_seconds"_a = result.elapsed_seconds);
+}
+
+}  // namespace
+
+void BindLocalization(py::module& m) {
+  using LOpts = LocalizationOptions;
+  auto PyLocalizationOptions =
+      py::class_<LOpts>(m, "LocalizationOptions")
+          .def(py::init<>())
+          .def_readwrite("vocab_tree_path",
+                         &LOpts::vocab_tree_path,
+                         "Path to the vocabulary tree or to the visual index "
+                         "of a previous vocabulary tree matching run. If "
+                         "empty, queries are matched against all 3D points.")
+          .def_readwrite("num_images",
+                         &LOpts::num_images,
+                         "The number of retrieved images per query, whose 3D "
+                         "points are matched against the query.")
+          .def_readwrite("num_nearest_neighbors",
+                         &LOpts::num_nearest_neighbors)
+          .def_readwrite("num_checks", &LOpts::num_checks)
+          .def_readwrite("max_num_features",
+                         &LOpts::max_num_features,
+                         "The maximum number of largest-scale features used "
+                         "for the retrieval.")
+          .def_readwrite("num_matchers",
+                         &LOpts::num_matchers,
+                         "The number of queries that are localized "
+                         "concurrently.")
+          .def_readwrite("num_threads", &LOpts::num_threads)
+          .def_readwrite("abs_pose_max_error",
+                         &LOpts::abs_pose_max_error,
+                         "Maximum reprojection error in pixels of the "
+                         "inliers of the pose.")
+          .def_readwrite("abs_pose_min_num_inliers",
+                         &LOpts::abs_pose_min_num_inliers)
+          .def_readwrite("abs_pose_min_inlier_ratio",
+                         &LOpts::abs_pose_min_inlier_ratio)
+          .def_readwrite("matching", &LOpts::matching)
+          .def_readwrite("abs_pose", &LOpts::abs_pose)
+          .def_readwrite("abs_pose_refinement", &LOpts::abs_pose_refinement);
+  MakeDataclass(PyLocalizationOptions);
+  auto localization_options = PyLocalizationOptions().cast<LOpts>();
+
+  py::class_<Localizer, std::shared_ptr<Localizer>>(m, "Localizer")
+      .def(py::init(&CreateLocalizer),
+           "reconstruction"_a,
+           "database_path"_a,
+           "options"_a = localization_options,
+           "Build the point descriptors and visual index of the "
+           "reconstruction from the features in the database.")
+      .def("localize",
+           &Localize,
+           "keypoints"_a,
+           "descriptors"_a,
+           "camera"_a,
+           "Estimate the pose of a query image from its keypoints and SIFT "
+           "descriptors. Returns None, if the query cannot be localized.")
+      .def_property_readonly("num_points3D", &Localizer::NumPoints3D);
+}
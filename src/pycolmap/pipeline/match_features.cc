@@ -96,7 +96,60 @@ void BindMatchFeatures(py::module& m) {
           .def_readwrite("guided_matching",
                          &SMOpts::guided_matching,
                          "Whether to perform guided matching, if geometric "
-                         "verification succeeds.");
+                         "verification succeeds.")
+          .def_readwrite("vote_and_verify",
+                         &SMOpts::vote_and_verify,
+                         "Whether to reject image pairs with the cheap "
+                         "vote-and-verify spatial verification before the "
+                         "full geometric verification.")
+          .def_readwrite("vote_and_verify_min_num_inliers",
+                         &SMOpts::vote_and_verify_min_num_inliers,
+                         "Minimum number of effective inliers of the "
+                         "vote-and-verify spatial verification.")
+          .def_readwrite("coarse_num_features",
+                         &SMOpts::coarse_num_features,
+                         "Number of features with the largest scale per "
+                         "image, which are first matched and verified in a "
+                         "coarse stage. Set to 0 to disable.")
+          .def_readwrite("coarse_min_num_inliers",
+                         &SMOpts::coarse_min_num_inliers,
+                         "Minimum number of inliers in the coarse stage for "
+                         "an image pair to be fully matched.")
+          .def_readwrite("prediction_max_error",
+                         &SMOpts::prediction_max_error,
+                         "Maximum epipolar or homography error in pixels of "
+                         "the matching guided by a predicted geometry.")
+          .def_readwrite("pca_path",
+                         &SMOpts::pca_path,
+                         "Path to the SIFT PCA projection of reduced "
+                         "descriptors. Only required for GPU matching.")
+          .def_readwrite("batch_size",
+                         &SMOpts::batch_size,
+                         "Maximum number of image pairs with the same first "
+                         "image that are matched in one batch.")
+          .def_readwrite("max_num_pairs_per_transaction",
+                         &SMOpts::max_num_pairs_per_transaction,
+                         "Maximum number of image pairs written to the "
+                         "database in one transaction.")
+          .def_readwrite("max_transaction_duration",
+                         &SMOpts::max_transaction_duration,
+                         "Maximum duration in seconds of one database "
+                         "transaction.")
+          .def_readwrite("numa_affinity",
+                         &SMOpts::numa_affinity,
+                         "Whether to pin the CPU matching and verification "
+                         "threads to the NUMA nodes of the system.")
+          .def_readwrite("gpu_tiled_matching",
+                         &SMOpts::gpu_tiled_matching,
+                         "Whether to match descriptor sets larger than the "
+                         "GPU capacity block by block instead of clamping "
+                         "them. Only supported by CUDA.")
+          .def_readwrite("gpu_descriptor_cache_size",
+                         &SMOpts::gpu_descriptor_cache_size,
+                         "Cache size in gigabytes for the descriptors of "
+                         "recently matched images, which each GPU matcher "
+                         "keeps in device memory. Only supported by CUDA. "
+                         "Set to 0 to disable the cache.");
   MakeDataclass(PySiftMatchingOptions);
   auto sift_matching_options = PySiftMatchingOptions().cast<SMOpts>();
 
@@ -119,6 +172,10 @@ void BindMatchFeatures(py::module& m) {
               "quadratic_overlap",
               &SeqMOpts::quadratic_overlap,
               "Whether to match images against their quadratic neighbors.")
+          .def_readwrite("motion_prediction",
+                         &SeqMOpts::motion_prediction,
+                         "Whether to match consecutive pairs guided by the "
+                         "two-view geometry of the preceding pair.")
           .def_readwrite("loop_detection",
                          &SeqMOpts::loop_detection,
                          "Loop detection is invoked every "
@@ -146,6 +203,11 @@ void BindMatchFeatures(py::module& m) {
                          "The maximum number of features to use for indexing "
                          "an image. If an image has more features, only the "
                          "largest-scale features will be indexed.")
+          .def_readwrite("loop_detection_incremental",
+                         &SeqMOpts::loop_detection_incremental,
+                         "Whether to detect loops with an incremental index "
+                         "of the preceding images, instead of indexing all "
+                         "images up front.")
           .def_readwrite("vocab_tree_path",
                          &SeqMOpts::vocab_tree_path,
                          "Path to the vocabulary tree.")
@@ -203,7 +265,37 @@ void BindMatchFeatures(py::module& m) {
               "match_list_path",
               &VTMOpts::match_list_path,
               "Optional path to file with specific image names to match.")
+          .def_readwrite(
+              "index_path",
+              &VTMOpts::index_path,
+              "Optional path to a persistent visual index of the database "
+              "images. Only images not yet in the index are indexed and "
+              "queried and the updated index is written back to the path.")
+          .def_readwrite("index_shard_paths",
+                         &VTMOpts::index_shard_paths,
+                         "Optional comma-separated list of paths to visual "
+                         "index shards that are queried together with the "
+                         "index of the remaining images.")
           .def_readwrite("num_threads", &VTMOpts::num_threads)
+          .def_readwrite(
+              "spatial_max_distance",
+              &VTMOpts::spatial_max_distance,
+              "If positive, retrieved image pairs whose location priors are "
+              "farther apart are rejected. Pairs with an image without a "
+              "prior are kept.")
+          .def_readwrite("spatial_union",
+                         &VTMOpts::spatial_union,
+                         "Whether to match the union of the retrieved pairs "
+                         "and the spatial nearest neighbors within the maximum "
+                         "distance instead.")
+          .def_readwrite(
+              "spatial_max_num_neighbors",
+              &VTMOpts::spatial_max_num_neighbors,
+              "The maximum number of spatial nearest neighbors for the union.")
+          .def_readwrite(
+              "spatial_ignore_z",
+              &VTMOpts::spatial_ignore_z,
+              "Whether to ignore the Z-component of the location priors.")
           .def("check", [](VTMOpts& self) {
             THROW_CHECK(!self.vocab_tree_path.empty())
                 << "vocab_tree_path required.";
@@ -212,6 +304,50 @@ void BindMatchFeatures(py::module& m) {
   MakeDataclass(PyVocabTreeMatchingOptions);
   auto vocabtree_options = PyVocabTreeMatchingOptions().cast<VTMOpts>();
 
+  using VLADMOpts = VLADMatchingOptions;
+  auto PyVLADMatchingOptions =
+      py::class_<VLADMOpts>(m, "VLADMatchingOptions")
+          .def(py::init<>())
+          .def_readwrite("num_images",
+                         &VLADMOpts::num_images,
+                         "Number of images to retrieve for each query image.")
+          .def_readwrite("num_clusters",
+                         &VLADMOpts::num_clusters,
+                         "The number of clusters of the VLAD codebook, which "
+                         "is learned from the visual words of the vocabulary "
+                         "tree.")
+          .def_readwrite("num_lists",
+                         &VLADMOpts::num_lists,
+                         "The number of lists of the inverted file index. If "
+                         "not positive, the square root of the number of "
+                         "images is used.")
+          .def_readwrite("num_probes",
+                         &VLADMOpts::num_probes,
+                         "The number of lists to search for each query image.")
+          .def_readwrite(
+              "max_num_features",
+              &VLADMOpts::max_num_features,
+              "The maximum number of features to use for describing an "
+              "image.")
+          .def_readwrite("vocab_tree_path",
+                         &VLADMOpts::vocab_tree_path,
+                         "Path to the vocabulary tree. Only required, if not "
+                         "all images have a global descriptor in the "
+                         "database.")
+          .def_readwrite(
+              "match_list_path",
+              &VLADMOpts::match_list_path,
+              "Optional path to file with specific image names to match.")
+          .def_readwrite("num_threads", &VLADMOpts::num_threads)
+          .def("check", [](VLADMOpts& self) {
+            THROW_CHECK(self.Check());
+            if (!self.vocab_tree_path.empty()) {
+              THROW_CHECK_FILE_EXISTS(self.vocab_tree_path);
+            }
+          });
+  MakeDataclass(PyVLADMatchingOptions);
+  auto vlad_options = PyVLADMatchingOptions().cast<VLADMOpts>();
+
   auto verification_options =
       m.attr("TwoViewGeometryOptions")().cast<TwoViewGeometryOptions>();
 
@@ -251,6 +387,15 @@ void BindMatchFeatures(py::module& m) {
         "device"_a = Device::AUTO,
         "Vocab tree feature matching");
 
+  m.def("match_vlad",
+        &MatchFeatures<VLADMOpts, CreateVLADFeatureMatcher>,
+        "database_path"_a,
+        "sift_options"_a = sift_matching_options,
+        "matching_options"_a = vlad_options,
+        "verification_options"_a = verification_options,
+        "device"_a = Device::AUTO,
+        "Global VLAD descriptor feature matching");
+
   m.def("verify_matches",
         &verify_matches,
         "database_path"_a,
@@ -276,6 +421,11 @@ void BindMatchFeatures(py::module& m) {
            "options"_a,
            "database"_a,
            "query_image_ids"_a = std::vector<image_t>());
+  py::class_<VLADPairGenerator, PairGenerator>(m, "VLADPairGenerator")
+      .def(py::init<const VLADMatchingOptions&,
+                    const std::shared_ptr<Database>&>(),
+           "options"_a,
+           "database"_a);
   py::class_<SequentialPairGenerator, PairGenerator>(m,
                                                      "SequentialPairGenerator")
       .def(py::init<const SequentialMatchingOptions&,
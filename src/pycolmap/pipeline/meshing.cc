@@ -55,7 +55,22 @@ void BindMeshing(py::module& m) {
           .def_readwrite(
               "num_threads",
               &PoissonMOpts::num_threads,
-              "The number of threads used for the Poisson reconstruction.");
+              "The number of threads used for the Poisson reconstruction.")
+          .def_readwrite(
+              "max_num_block_points",
+              &PoissonMOpts::max_num_block_points,
+              "If positive, the input points are partitioned by an octree "
+              "into blocks of at most this number of points, which are "
+              "reconstructed and trimmed one after another and stitched into "
+              "a single mesh.")
+          .def_readwrite("block_overlap",
+                         &PoissonMOpts::block_overlap,
+                         "Overlap of the points of neighboring blocks relative "
+                         "to the block size.")
+          .def_readwrite("voxel_size",
+                         &PoissonMOpts::voxel_size,
+                         "If positive, the input points are first merged on "
+                         "a voxel grid of this size.");
   MakeDataclass(PyPoissonMeshingOptions);
   auto poisson_options = PyPoissonMeshingOptions().cast<PoissonMOpts>();
 
@@ -113,7 +128,11 @@ void BindMeshing(py::module& m) {
           .def_readwrite("num_threads",
                          &DMOpts::num_threads,
                          "The number of threads to use for reconstruction. "
-                         "Default is all threads.");
+                         "Default is all threads.")
+          .def_readwrite("voxel_size",
+                         &DMOpts::voxel_size,
+                         "If positive, the fused points are first merged on "
+                         "a voxel grid of this size with their visibility.");
   MakeDataclass(PyDelaunayMeshingOptions);
   auto delaunay_options = PyDelaunayMeshingOptions().cast<DMOpts>();
 
@@ -133,6 +152,37 @@ void BindMeshing(py::module& m) {
       "options"_a = poisson_options,
       "Perform Poisson surface reconstruction and return true if successful.");
 
+  using PCDOpts = mvs::PointCloudDownsamplingOptions;
+  auto PyPointCloudDownsamplingOptions =
+      py::class_<PCDOpts>(m, "PointCloudDownsamplingOptions")
+          .def(py::init<>())
+          .def_readwrite("voxel_size",
+                         &PCDOpts::voxel_size,
+                         "Edge length of the voxels, in which all points are "
+                         "merged into one point.")
+          .def_readwrite("num_threads",
+                         &PCDOpts::num_threads,
+                         "The number of threads to merge the points.");
+  MakeDataclass(PyPointCloudDownsamplingOptions);
+  auto downsampling_options =
+      PyPointCloudDownsamplingOptions().cast<PCDOpts>();
+
+  m.def(
+      "downsample_point_cloud",
+      [](const std::string& input_path,
+         const std::string& output_path,
+         const PCDOpts& options) -> void {
+        THROW_CHECK_HAS_FILE_EXTENSION(input_path, ".ply");
+        THROW_CHECK_FILE_EXISTS(input_path);
+        THROW_CHECK_HAS_FILE_EXTENSION(output_path, ".ply");
+        THROW_CHECK_PATH_OPEN(output_path);
+        mvs::DownsamplePointCloud(options, input_path, output_path);
+      },
+      "input_path"_a,
+      "output_path"_a,
+      "options"_a = downsampling_options,
+      "Merge the points and, if it exists, their visibility on a voxel grid.");
+
 #ifdef COLMAP_CGAL_ENABLED
   m.def("sparse_delaunay_meshing",
         &mvs::SparseDelaunayMeshing,
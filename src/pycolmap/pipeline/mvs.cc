@@ -57,6 +57,11 @@ Reconstruction StereoFusion(const std::string& output_path,
   py::gil_scoped_release release;
   mvs::StereoFusion fuser(
       options, workspace_path, workspace_format, pmvs_option_name, input_type);
+  // The fused points are directly streamed to a PLY output file.
+  const bool write_ply = !ExistsDir(output_path);
+  if (write_ply) {
+    fuser.SetOutputPath(output_path);
+  }
   fuser.Run();
 
   Reconstruction reconstruction;
@@ -66,14 +71,11 @@ Reconstruction StereoFusion(const std::string& output_path,
   }
 
   // overwrite sparse point cloud with dense point cloud from fuser
-  reconstruction.ImportPLY(fuser.GetFusedPoints());
-
-  if (ExistsDir(output_path)) {
-    reconstruction.WriteBinary(output_path);
+  if (write_ply) {
+    reconstruction.ImportPLY(output_path);
   } else {
-    WriteBinaryPlyPoints(output_path, fuser.GetFusedPoints());
-    mvs::WritePointsVisibility(output_path + ".vis",
-                               fuser.GetFusedPointsVisibility());
+    reconstruction.ImportPLY(fuser.GetFusedPoints());
+    reconstruction.WriteBinary(output_path);
   }
 
   return reconstruction;
@@ -125,6 +127,32 @@ void BindMVS(py::module& m) {
           .def_readwrite("num_iterations",
                          &PMOpts::num_iterations,
                          "Number of coordinate descent iterations.")
+          .def_readwrite("num_pyramid_levels",
+                         &PMOpts::num_pyramid_levels,
+                         "Number of coarser pyramid levels, each at half the "
+                         "resolution of the next finer level, whose depth "
+                         "and normal maps initialize the next finer level. "
+                         "Only used without geometric consistency.")
+          .def_readwrite("num_pyramid_iterations",
+                         &PMOpts::num_pyramid_iterations,
+                         "Number of coordinate descent iterations at the "
+                         "coarser pyramid levels.")
+          .def_readwrite("init_from_sparse_points",
+                         &PMOpts::init_from_sparse_points,
+                         "Whether to seed the random initialization of the "
+                         "photometric pass with the sparse points observed "
+                         "by the reference image.")
+          .def_readwrite("init_from_src_maps",
+                         &PMOpts::init_from_src_maps,
+                         "Whether to seed the random initialization of the "
+                         "photometric pass with the already estimated depth "
+                         "and normal maps of the source images. Only used "
+                         "with geometric consistency, which keeps these maps "
+                         "in the workspace.")
+          .def_readwrite("init_radius",
+                         &PMOpts::init_radius,
+                         "Radius in pixels of the window around each "
+                         "projected seed point that is initialized.")
           .def_readwrite("geom_consistency",
                          &PMOpts::geom_consistency,
                          "Whether to add a regularized geometric consistency "
@@ -160,13 +188,36 @@ void BindMVS(py::module& m) {
           .def_readwrite("cache_size",
                          &PMOpts::cache_size,
                          "Cache size in gigabytes for patch match.")
+          .def_readwrite("gpu_cache_size",
+                         &PMOpts::gpu_cache_size,
+                         "Cache size in gigabytes for the source images and "
+                         "depth maps kept in GPU memory across problems. If "
+                         "negative, a quarter of the free GPU memory is used.")
+          .def_readwrite("bitmap_decoder",
+                         &PMOpts::bitmap_decoder,
+                         "The backend used to decode the images, i.e., "
+                         "freeimage, libjpeg, or nvjpeg.")
+          .def_readwrite("num_problems_per_gpu",
+                         &PMOpts::num_problems_per_gpu,
+                         "Number of problems processed concurrently for each "
+                         "GPU, which overlaps reading and writing of their "
+                         "data with the computation on the GPU.")
+          .def_readwrite("num_prefetch_problems",
+                         &PMOpts::num_prefetch_problems,
+                         "Number of upcoming problems whose inputs are read "
+                         "on CPU threads while the GPU processes the current "
+                         "problem.")
           .def_readwrite(
               "allow_missing_files",
               &PMOpts::allow_missing_files,
               "Whether to tolerate missing images/maps in the problem setup")
           .def_readwrite("write_consistency_graph",
                          &PMOpts::write_consistency_graph,
-                         "Whether to write the consistency graph.");
+                         "Whether to write the consistency graph.")
+          .def_readwrite("map_file_format",
+                         &PMOpts::map_file_format,
+                         "The file format of the depth and normal maps, i.e., "
+                         "float, half, or half_lz4.");
   MakeDataclass(PyPatchMatchOptions);
   auto patch_match_options = PyPatchMatchOptions().cast<PMOpts>();
 
@@ -227,6 +278,22 @@ void BindMVS(py::module& m) {
           .def_readwrite("cache_size",
                          &SFOpts::cache_size,
                          "Cache size in gigabytes for fusion.")
+          .def_readwrite("bitmap_decoder",
+                         &SFOpts::bitmap_decoder,
+                         "The backend used to decode the images, i.e., "
+                         "freeimage, libjpeg, or nvjpeg.")
+          .def_readwrite("use_gpu",
+                         &SFOpts::use_gpu,
+                         "Whether to run the consistency checks on the GPU.")
+          .def_readwrite("gpu_index",
+                         &SFOpts::gpu_index,
+                         "Index of the GPU used for fusion. By default, the "
+                         "best GPU is selected.")
+          .def_readwrite("max_num_tile_images",
+                         &SFOpts::max_num_tile_images,
+                         "Maximum number of images per tile of the scene. If "
+                         "positive, the tiles are fused one after another and "
+                         "only written to disk.")
           .def_readwrite("bounding_box",
                          &SFOpts::bounding_box,
                          "Bounding box Tuple[min, max]");
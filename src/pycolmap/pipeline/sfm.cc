@@ -111,6 +111,23 @@ void BindSfM(py::module& m) {
           "ignore_watermarks",
           &MapperOpts::ignore_watermarks,
           "Whether to ignore the inlier matches of watermark image pairs.")
+      .def_readwrite("lazy_load_points2D",
+                     &MapperOpts::lazy_load_points2D,
+                     "Whether to load the 2D points of an image from the "
+                     "database only once the reconstruction first tries to "
+                     "register it or one of its neighbors.")
+      .def_readwrite("lazy_points2D_cache_size",
+                     &MapperOpts::lazy_points2D_cache_size,
+                     "The maximum memory in gigabytes of lazily loaded 2D "
+                     "points that are kept in memory by the database cache.")
+      .def_readwrite("compact_points2D",
+                     &MapperOpts::compact_points2D,
+                     "Whether to keep the 2D points in a compact "
+                     "single-precision array in the database cache.")
+      .def_readwrite("precompute_tracks",
+                     &MapperOpts::precompute_tracks,
+                     "Whether to precompute the feature tracks of all "
+                     "verified matches after loading the database.")
       .def_readwrite("multiple_models",
                      &MapperOpts::multiple_models,
                      "Whether to reconstruct multiple sub-models.")
@@ -140,6 +157,22 @@ void BindSfM(py::module& m) {
       .def_readwrite("init_num_trials",
                      &MapperOpts::init_num_trials,
                      "The number of trials to initialize the reconstruction.")
+      .def_readwrite("num_parallel_models",
+                     &MapperOpts::num_parallel_models,
+                     "The number of sub-models that are reconstructed "
+                     "concurrently from disjoint initial pairs, if multiple "
+                     "models are reconstructed from scratch.")
+      .def_readwrite("num_parallel_reg_images",
+                     &MapperOpts::num_parallel_reg_images,
+                     "The number of next image candidates whose poses are "
+                     "estimated in parallel before they are registered one "
+                     "after another.")
+      .def_readwrite("tri_partition_max_num_images",
+                     &MapperOpts::tri_partition_max_num_images,
+                     "The maximum number of images per partition when "
+                     "triangulating a reconstruction with fixed poses. If "
+                     "positive and exceeded, the overlapping image clusters "
+                     "are triangulated in parallel and their tracks merged.")
       .def_readwrite("extract_colors",
                      &MapperOpts::extract_colors,
                      "Whether to extract colors for reconstructed points.")
@@ -175,6 +208,28 @@ void BindSfM(py::module& m) {
           &MapperOpts::ba_min_num_residuals_for_multi_threading,
           "The minimum number of residuals per bundle adjustment problem to "
           "enable multi-threading solving of the problems.")
+      .def_readwrite("ba_use_gpu",
+                     &MapperOpts::ba_use_gpu,
+                     "Whether to use the GPU for the global bundle adjustment.")
+      .def_readwrite("ba_gpu_index", &MapperOpts::ba_gpu_index)
+      .def_readwrite(
+          "ba_min_num_images_gpu_solver",
+          &MapperOpts::ba_min_num_images_gpu_solver,
+          "The minimum number of images to use the GPU for the global bundle "
+          "adjustment.")
+      .def_readwrite("ba_use_float_jacobians",
+                     &MapperOpts::ba_use_float_jacobians,
+                     "Whether to evaluate the reprojection Jacobians in "
+                     "single precision.")
+      .def_readwrite("ba_global_marginalize_constant_pose_points",
+                     &MapperOpts::ba_global_marginalize_constant_pose_points,
+                     "Whether to marginalize the points only observed by "
+                     "constant camera poses in the global bundle adjustment.")
+      .def_readwrite("ba_global_reject_outliers_in_solver",
+                     &MapperOpts::ba_global_reject_outliers_in_solver,
+                     "Whether to reject the observations exceeding "
+                     "filter_max_reproj_error during the global bundle "
+                     "adjustment solve.")
       .def_readwrite(
           "ba_local_num_images",
           &MapperOpts::ba_local_num_images,
@@ -203,6 +258,18 @@ void BindSfM(py::module& m) {
           "ba_global_points_freq",
           &MapperOpts::ba_global_points_freq,
           "The growth rates after which to perform global bundle adjustment.")
+      .def_readwrite(
+          "ba_global_max_drift",
+          &MapperOpts::ba_global_max_drift,
+          "The accumulated drift in pixels of the local bundle adjustments, "
+          "after which to perform global bundle adjustment instead of the "
+          "growth ratios. Disabled if zero.")
+      .def_readwrite(
+          "ba_global_partial_max_images_ratio",
+          &MapperOpts::ba_global_partial_max_images_ratio,
+          "The maximum fraction of the registered images that were adjusted "
+          "by drifted local bundle adjustments, for which only these images "
+          "are adjusted in a partial global bundle adjustment.")
       .def_readwrite(
           "ba_global_function_tolerance",
           &MapperOpts::ba_global_function_tolerance,
@@ -235,6 +302,18 @@ void BindSfM(py::module& m) {
                      &MapperOpts::snapshot_images_freq,
                      "Frequency of registered images according to which "
                      "reconstruction snapshots will be saved.")
+      .def_readwrite("checkpoint_path",
+                     &MapperOpts::checkpoint_path,
+                     "Path to a folder in which checkpoints are written in the "
+                     "background and from which the reconstruction resumes.")
+      .def_readwrite("checkpoint_images_freq",
+                     &MapperOpts::checkpoint_images_freq,
+                     "Frequency of registered images according to which "
+                     "checkpoints will be written.")
+      .def_readwrite("ba_telemetry_path",
+                     &MapperOpts::ba_telemetry_path,
+                     "Path to a file to which the telemetry of every bundle "
+                     "adjustment is appended as one line of JSON.")
       .def_readwrite("image_names",
                      &MapperOpts::image_names,
                      "Which images to reconstruct. If no images are specified, "
@@ -243,6 +322,18 @@ void BindSfM(py::module& m) {
                      &MapperOpts::fix_existing_images,
                      "If reconstruction is provided as input, fix the existing "
                      "image poses.")
+      .def_readwrite("stream_new_images",
+                     &MapperOpts::stream_new_images,
+                     "Whether to wait for new images with matches written to "
+                     "the database, once no more images can be registered.")
+      .def_readwrite("stream_poll_interval",
+                     &MapperOpts::stream_poll_interval,
+                     "The interval in seconds at which the database is polled "
+                     "for new images.")
+      .def_readwrite("stream_max_idle_time",
+                     &MapperOpts::stream_max_idle_time,
+                     "The maximum time in seconds to wait for new images. If "
+                     "not positive, wait until the mapper is stopped.")
       .def_readwrite(
           "mapper", &MapperOpts::mapper, "Options of the IncrementalMapper.")
       .def_readwrite("triangulation",
@@ -298,6 +389,48 @@ void BindSfM(py::module& m) {
                          "single-threaded is typically better for small bundle "
                          "adjustment problems "
                          "due to the overhead of threading. ")
+          .def_readwrite("use_gpu",
+                         &BAOpts::use_gpu,
+                         "Whether to solve the linear systems on the GPU with "
+                         "the CUDA backends of Ceres, if available.")
+          .def_readwrite("gpu_index", &BAOpts::gpu_index)
+          .def_readwrite("min_num_images_gpu_solver",
+                         &BAOpts::min_num_images_gpu_solver,
+                         "Minimum number of images to use the GPU solver.")
+          .def_readwrite("max_num_images_direct_dense_cpu_solver",
+                         &BAOpts::max_num_images_direct_dense_cpu_solver,
+                         "Maximum number of images to use the direct dense "
+                         "solver on the CPU.")
+          .def_readwrite("max_num_images_direct_sparse_cpu_solver",
+                         &BAOpts::max_num_images_direct_sparse_cpu_solver,
+                         "Maximum number of images to use the direct sparse "
+                         "solver on the CPU.")
+          .def_readwrite("max_num_images_direct_dense_gpu_solver",
+                         &BAOpts::max_num_images_direct_dense_gpu_solver,
+                         "Maximum number of images to use the direct dense "
+                         "solver on the GPU.")
+          .def_readwrite("max_num_images_direct_sparse_gpu_solver",
+                         &BAOpts::max_num_images_direct_sparse_gpu_solver,
+                         "Maximum number of images to use the direct sparse "
+                         "solver on the GPU.")
+          .def_readwrite("use_float_jacobians",
+                         &BAOpts::use_float_jacobians,
+                         "Whether to evaluate the reprojection Jacobians in "
+                         "single precision. Residuals and the normal "
+                         "equations remain in double precision.")
+          .def_readwrite("marginalize_constant_pose_points",
+                         &BAOpts::marginalize_constant_pose_points,
+                         "Whether to marginalize the 3D points whose "
+                         "observations all have constant camera poses into "
+                         "fixed priors on the variable cameras.")
+          .def_readwrite("outlier_max_reproj_error",
+                         &BAOpts::outlier_max_reproj_error,
+                         "If positive, the maximum reprojection error in "
+                         "pixels, above which observations are deactivated "
+                         "as outliers during the solve.")
+          .def_readwrite("telemetry_label",
+                         &BAOpts::telemetry_label,
+                         "Label of the telemetry reported after solving.")
           .def_readwrite(
               "solver_options",
               &BAOpts::solver_options,
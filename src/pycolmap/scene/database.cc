@@ -2,6 +2,8 @@
 
 #include "pycolmap/pybind11_extension.h"
 
+#include <functional>
+
 #include <pybind11/eigen.h>
 #include <pybind11/pybind11.h>
 
@@ -9,6 +11,59 @@ using namespace colmap;
 using namespace pybind11::literals;
 namespace py = pybind11;
 
+// Iterates over the matches or two-view geometries of all image pairs by
+// reading them in chunks, such that only one chunk is in memory at a time.
+template <typename T>
+class DatabasePairIterator {
+ public:
+  typedef std::function<std::vector<std::pair<image_pair_t, T>>(image_pair_t,
+                                                                size_t)>
+      ReadChunkFunc;
+
+  DatabasePairIterator(ReadChunkFunc read_chunk, size_t chunk_size)
+      : read_chunk_(std::move(read_chunk)), chunk_size_(chunk_size) {
+    THROW_CHECK_GT(chunk_size_, 0);
+  }
+
+  std::pair<image_pair_t, T> Next() {
+    if (next_idx_ == chunk_.size()) {
+      if (finished_) {
+        throw py::stop_iteration();
+      }
+      {
+        py::gil_scoped_release release;
+        chunk_ = read_chunk_(prev_pair_id_, chunk_size_);
+      }
+      next_idx_ = 0;
+      finished_ = chunk_.size() < chunk_size_;
+      if (chunk_.empty()) {
+        throw py::stop_iteration();
+      }
+    }
+    std::pair<image_pair_t, T>& item = chunk_[next_idx_++];
+    prev_pair_id_ = item.first;
+    return std::move(item);
+  }
+
+ private:
+  const ReadChunkFunc read_chunk_;
+  const size_t chunk_size_;
+  std::vector<std::pair<image_pair_t, T>> chunk_;
+  size_t next_idx_ = 0;
+  image_pair_t prev_pair_id_ = 0;
+  bool finished_ = false;
+};
+
+template <typename T>
+void BindDatabasePairIterator(py::module& m, const std::string& name) {
+  py::class_<DatabasePairIterator<T>>(m, name.c_str())
+      .def("__iter__",
+           [](DatabasePairIterator<T>& self) -> DatabasePairIterator<T>& {
+             return self;
+           })
+      .def("__next__", &DatabasePairIterator<T>::Next);
+}
+
 class DatabaseTransactionWrapper {
  public:
   explicit DatabaseTransactionWrapper(Database* database)
@@ -26,11 +81,19 @@ class DatabaseTransactionWrapper {
 };
 
 void BindDatabase(py::module& m) {
+  BindDatabasePairIterator<FeatureMatchesBlob>(m, "DatabaseMatchesIterator");
+  BindDatabasePairIterator<TwoViewGeometry>(
+      m, "DatabaseTwoViewGeometriesIterator");
+
   py::class_<Database, std::shared_ptr<Database>> PyDatabase(m, "Database");
   PyDatabase.def(py::init<>())
       .def(py::init<const std::string&>(), "path"_a)
       .def("open", &Database::Open, "path"_a)
       .def("close", &Database::Close)
+      .def("set_blob_compression",
+           &Database::SetBlobCompression,
+           "compress"_a,
+           "Whether to compress newly written descriptors and matches.")
       .def_property_readonly("num_cameras", &Database::NumCameras)
       .def_property_readonly("num_images", &Database::NumImages)
       .def_property_readonly("num_keypoints", &Database::NumKeypoints)
@@ -41,6 +104,8 @@ void BindDatabase(py::module& m) {
       .def("num_descriptors_for_image",
            &Database::NumDescriptorsForImage,
            "image_id"_a)
+      .def_property_readonly("num_global_descriptors",
+                             &Database::NumGlobalDescriptors)
       .def_property_readonly("num_matches", &Database::NumMatches)
       .def_property_readonly("num_inlier_matches", &Database::NumInlierMatches)
       .def_property_readonly("num_matched_image_pairs",
@@ -62,13 +127,43 @@ void BindDatabase(py::module& m) {
       .def("read_image", &Database::ReadImage, "image_id"_a)
       .def("read_image", &Database::ReadImageWithName, "name"_a)
       .def("read_all_images", &Database::ReadAllImages)
+      .def("read_cameras_page",
+           &Database::ReadCamerasPage,
+           "offset"_a,
+           "max_num_cameras"_a,
+           "Read at most max_num_cameras cameras in the order of their "
+           "identifiers, skipping the first offset cameras.")
+      .def("read_images_page",
+           &Database::ReadImagesPage,
+           "offset"_a,
+           "max_num_images"_a,
+           "Read at most max_num_images images in the order of their "
+           "identifiers, skipping the first offset images.")
       .def("read_keypoints", &Database::ReadKeypointsBlob, "image_id"_a)
       .def("read_descriptors", &Database::ReadDescriptors, "image_id"_a)
+      .def("read_global_descriptor",
+           &Database::ReadGlobalDescriptor,
+           "image_id"_a)
       .def("read_matches",
            &Database::ReadMatchesBlob,
            "image_id1"_a,
            "image_id2"_a)
-      // TODO: ReadAllMatches
+      .def(
+          "iter_matches",
+          [](const Database& self, const size_t chunk_size) {
+            return DatabasePairIterator<FeatureMatchesBlob>(
+                [&self](const image_pair_t prev_pair_id,
+                        const size_t max_num_pairs) {
+                  return self.ReadMatchesChunk(prev_pair_id, max_num_pairs);
+                },
+                chunk_size);
+          },
+          "chunk_size"_a = 1024,
+          py::keep_alive<0, 1>(),
+          "Iterate over the (pair_id, matches) of all image pairs with "
+          "matches in ascending order of their pair identifiers, where the "
+          "matches are Nx2 arrays. The rows are read in chunks of chunk_size "
+          "image pairs, so that the entire table is never in memory.")
       .def("read_two_view_geometry",
            &Database::ReadTwoViewGeometry,
            "image_id1"_a,
@@ -80,6 +175,22 @@ void BindDatabase(py::module& m) {
              self.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
              return std::make_pair(image_pair_ids, two_view_geometries);
            })
+      .def(
+          "iter_two_view_geometries",
+          [](const Database& self, const size_t chunk_size) {
+            return DatabasePairIterator<TwoViewGeometry>(
+                [&self](const image_pair_t prev_pair_id,
+                        const size_t max_num_pairs) {
+                  return self.ReadTwoViewGeometriesChunk(prev_pair_id,
+                                                         max_num_pairs);
+                },
+                chunk_size);
+          },
+          "chunk_size"_a = 1024,
+          py::keep_alive<0, 1>(),
+          "Iterate over the (pair_id, two_view_geometry) of all image pairs "
+          "with inlier matches in ascending order of their pair identifiers, "
+          "reading the rows in chunks of chunk_size image pairs.")
       .def("read_two_view_geometry_num_inliers",
            [](const Database& self) {
              std::vector<std::pair<image_t, image_t>> image_pair_ids;
@@ -104,6 +215,10 @@ void BindDatabase(py::module& m) {
            &Database::WriteDescriptors,
            "image_id"_a,
            "descriptors"_a)
+      .def("write_global_descriptor",
+           &Database::WriteGlobalDescriptor,
+           "image_id"_a,
+           "descriptor"_a)
       .def("write_matches",
            py::overload_cast<image_t, image_t, const FeatureMatchesBlob&>(
                &Database::WriteMatches, py::const_),
@@ -129,14 +244,28 @@ void BindDatabase(py::module& m) {
       .def("clear_cameras", &Database::ClearCameras)
       .def("clear_images", &Database::ClearImages)
       .def("clear_descriptors", &Database::ClearDescriptors)
+      .def("clear_global_descriptors", &Database::ClearGlobalDescriptors)
       .def("clear_keypoints", &Database::ClearKeypoints)
       .def("clear_matches", &Database::ClearMatches)
       .def("clear_two_view_geometries", &Database::ClearTwoViewGeometries)
-      .def_static("merge",
-                  &Database::Merge,
-                  "database1"_a,
-                  "database2"_a,
-                  "merged_database"_a);
+      .def_static(
+          "merge",
+          py::overload_cast<const Database&, const Database&, Database*>(
+              &Database::Merge),
+          "database1"_a,
+          "database2"_a,
+          "merged_database"_a)
+      .def_static(
+          "merge",
+          py::overload_cast<const std::vector<const Database*>&,
+                            Database*,
+                            int,
+                            bool>(&Database::Merge),
+          "databases"_a,
+          "merged_database"_a,
+          "num_threads"_a = -1,
+          "preserve_image_ids"_a = false,
+          py::call_guard<py::gil_scoped_release>());
 
   py::class_<DatabaseTransactionWrapper>(m, "DatabaseTransaction")
       .def(py::init<Database*>(), "database"_a)
@@ -13,16 +13,65 @@ void BindDatabaseCache(py::module& m) {
   py::class_<DatabaseCache, std::shared_ptr<DatabaseCache>> PyDatabaseCache(
       m, "DatabaseCache");
   PyDatabaseCache.def(py::init<>())
-      .def_static("create",
-                  &DatabaseCache::Create,
-                  "database"_a,
-                  "min_num_matches"_a,
-                  "ignore_watermarks"_a,
-                  "image_names"_a)
+      .def_static(
+          "create",
+          [](const Database& database,
+             const size_t min_num_matches,
+             const bool ignore_watermarks,
+             const std::unordered_set<std::string>& image_names) {
+            return DatabaseCache::Create(
+                database, min_num_matches, ignore_watermarks, image_names);
+          },
+          "database"_a,
+          "min_num_matches"_a,
+          "ignore_watermarks"_a,
+          "image_names"_a)
+      .def_static(
+          "create_lazy",
+          [](const std::string& database_path,
+             const size_t min_num_matches,
+             const bool ignore_watermarks,
+             const std::unordered_set<std::string>& image_names,
+             const size_t max_points2D_num_bytes) {
+            return DatabaseCache::CreateLazy(database_path,
+                                             min_num_matches,
+                                             ignore_watermarks,
+                                             image_names,
+                                             /*feature_store=*/nullptr,
+                                             max_points2D_num_bytes);
+          },
+          "database_path"_a,
+          "min_num_matches"_a,
+          "ignore_watermarks"_a,
+          "image_names"_a,
+          "max_points2D_num_bytes"_a)
+      .def_static(
+          "create_compact",
+          [](const Database& database,
+             const size_t min_num_matches,
+             const bool ignore_watermarks,
+             const std::unordered_set<std::string>& image_names) {
+            return DatabaseCache::CreateCompact(
+                database, min_num_matches, ignore_watermarks, image_names);
+          },
+          "database"_a,
+          "min_num_matches"_a,
+          "ignore_watermarks"_a,
+          "image_names"_a)
+      .def("add_new_images",
+           &DatabaseCache::AddNewImages,
+           "database"_a,
+           "min_num_matches"_a,
+           "ignore_watermarks"_a,
+           "image_names"_a)
       .def("num_cameras", &DatabaseCache::NumCameras)
       .def("num_images", &DatabaseCache::NumImages)
       .def("exists_camera", &DatabaseCache::ExistsCamera, "camera_id"_a)
       .def("exists_image", &DatabaseCache::ExistsImage, "image_id"_a)
+      .def("is_lazy", &DatabaseCache::IsLazy)
+      .def("num_points2D_for_image",
+           &DatabaseCache::NumPoints2DForImage,
+           "image_id"_a)
       .def_property_readonly("cameras", &DatabaseCache::Cameras)
       .def_property_readonly("images", &DatabaseCache::Images)
       .def_property_readonly("correspondence_graph",
@@ -14,6 +14,7 @@
 #include <sstream>
 
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
@@ -92,6 +93,38 @@ void BindImage(py::module& m) {
           py::overload_cast<>(&Image::Points2D),
           py::overload_cast<const Point2DVector&>(&Image::SetPoints2D),
           "Array of Points2D (=keypoints).")
+      .def_property_readonly(
+          "points2D_xy",
+          [](py::object pyself) {
+            Image& self = pyself.cast<Image&>();
+            Point2DVector& points2D = self.Points2D();
+            return py::array_t<double>(
+                {points2D.size(), static_cast<size_t>(2)},
+                {sizeof(Point2D), sizeof(double)},
+                points2D.empty() ? nullptr : points2D[0].xy.data(),
+                pyself);
+          },
+          "Writable Nx2 view of the coordinates of all points2D without "
+          "copying. The view keeps the image alive, but is invalidated when "
+          "the points2D are replaced.")
+      .def_property_readonly(
+          "points2D_point3D_ids",
+          [](py::object pyself) {
+            Image& self = pyself.cast<Image&>();
+            Point2DVector& points2D = self.Points2D();
+            py::array_t<point3D_t> point3D_ids(
+                {points2D.size()},
+                {sizeof(Point2D)},
+                points2D.empty() ? nullptr : &points2D[0].point3D_id,
+                pyself);
+            // Changing the identifiers would corrupt the 3D point tracks.
+            py::detail::array_proxy(point3D_ids.ptr())->flags &=
+                ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+            return point3D_ids;
+          },
+          "Read-only view of the 3D point identifiers of all points2D "
+          "without copying. The view keeps the image alive, but is "
+          "invalidated when the points2D are replaced.")
       .def("point2D", py::overload_cast<camera_t>(&Image::Point2D))
       .def(
           "set_point3D_for_point2D",
@@ -59,8 +59,16 @@ void BindReconstruction(py::module& m) {
            "Write reconstruction in COLMAP binary format.")
       .def("read_text", &Reconstruction::ReadText)
       .def("read_binary", &Reconstruction::ReadBinary)
+      .def("read_chunked",
+           &Reconstruction::ReadChunked,
+           "sfm_dir"_a,
+           "image_ids"_a = std::unordered_set<image_t>(),
+           "Read reconstruction in chunked binary format. If image_ids are "
+           "given, only these images and the points observed by them are "
+           "read.")
       .def("write_text", &Reconstruction::WriteText)
       .def("write_binary", &Reconstruction::WriteBinary)
+      .def("write_chunked", &Reconstruction::WriteChunked)
       .def("num_images", &Reconstruction::NumImages)
       .def("num_cameras", &Reconstruction::NumCameras)
       .def("num_reg_images", &Reconstruction::NumRegImages)
@@ -78,6 +86,54 @@ void BindReconstruction(py::module& m) {
                              py::return_value_policy::reference_internal)
       .def("point3D", py::overload_cast<point3D_t>(&Reconstruction::Point3D))
       .def("point3D_ids", &Reconstruction::Point3DIds)
+      .def(
+          "points3D_ids_array",
+          [](const Reconstruction& self) {
+            Eigen::Matrix<point3D_t, Eigen::Dynamic, 1> point3D_ids(
+                self.NumPoints3D());
+            size_t i = 0;
+            for (const auto& point3D : self.Points3D()) {
+              point3D_ids(i++) = point3D.first;
+            }
+            return point3D_ids;
+          },
+          "Identifiers of all 3D points as one array. The order matches "
+          "the other bulk accessors as long as the points are not modified.")
+      .def(
+          "points3D_xyz",
+          [](const Reconstruction& self) {
+            Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> xyz(
+                self.NumPoints3D(), 3);
+            size_t i = 0;
+            for (const auto& point3D : self.Points3D()) {
+              xyz.row(i++) = point3D.second.xyz.transpose();
+            }
+            return xyz;
+          },
+          "Positions of all 3D points as one Nx3 array.")
+      .def(
+          "points3D_colors",
+          [](const Reconstruction& self) {
+            Eigen::Matrix<uint8_t, Eigen::Dynamic, 3, Eigen::RowMajor> colors(
+                self.NumPoints3D(), 3);
+            size_t i = 0;
+            for (const auto& point3D : self.Points3D()) {
+              colors.row(i++) = point3D.second.color.transpose();
+            }
+            return colors;
+          },
+          "Colors of all 3D points as one Nx3 array.")
+      .def(
+          "points3D_errors",
+          [](const Reconstruction& self) {
+            Eigen::VectorXd errors(self.NumPoints3D());
+            size_t i = 0;
+            for (const auto& point3D : self.Points3D()) {
+              errors(i++) = point3D.second.error;
+            }
+            return errors;
+          },
+          "Reprojection errors of all 3D points as one array.")
       .def("reg_image_ids", &Reconstruction::RegImageIds)
       .def("exists_camera", &Reconstruction::ExistsCamera)
       .def("exists_image", &Reconstruction::ExistsImage)
@@ -168,6 +224,27 @@ void BindReconstruction(py::module& m) {
            &Reconstruction::ComputeMeanObservationsPerRegImage)
       .def("compute_mean_reprojection_error",
            &Reconstruction::ComputeMeanReprojectionError)
+      .def(
+          "compute_statistics",
+          [](const Reconstruction& self, const double p0, const double p1) {
+            const ReconstructionStatistics statistics =
+                self.ComputeStatistics(p0, p1);
+            return py::dict(
+                "num_observations"_a = statistics.num_observations,
+                "mean_track_length"_a = statistics.mean_track_length,
+                "mean_observations_per_reg_image"_a =
+                    statistics.mean_observations_per_reg_image,
+                "mean_reprojection_error"_a =
+                    statistics.mean_reprojection_error,
+                "bbox_min"_a = statistics.bbox_min,
+                "bbox_max"_a = statistics.bbox_max,
+                "centroid"_a = statistics.centroid);
+          },
+          "p0"_a = 0.0,
+          "p1"_a = 1.0,
+          "Compute the observation, track, and error statistics and the "
+          "robust bounding box and centroid of the 3D points in one "
+          "parallel pass.")
       .def("import_PLY",
            py::overload_cast<const std::string&>(&Reconstruction::ImportPLY),
            "Import from PLY format. Note that these import functions are\n"
@@ -177,6 +254,13 @@ void BindReconstruction(py::module& m) {
            &ExportPLY,
            "output_path"_a,
            "Export 3D points to PLY format (.ply).")
+      .def(
+          "export_PLY_octree",
+          [](const Reconstruction& self, const std::string& output_dir) {
+            ExportPLYOctree(self, output_dir);
+          },
+          "output_dir"_a,
+          "Export 3D points as a level-of-detail octree of PLY files.")
       .def("extract_colors_for_image",
            &Reconstruction::ExtractColorsForImage,
            "Extract colors for 3D points of given image. Colors will be "
@@ -192,13 +276,23 @@ void BindReconstruction(py::module& m) {
            "@return              True if image could be read at given path.")
       .def("extract_colors_for_all_images",
            &Reconstruction::ExtractColorsForAllImages,
+           "path"_a,
+           "num_threads"_a = -1,
+           "min_image_size"_a = -1,
            "Extract colors for all 3D points by computing the mean color of "
            "all images.\n\n"
            "@param path          Absolute or relative path to root folder of "
            "image.\n"
            "                     The image path is determined by concatenating "
            "the\n"
-           "                     root path and the name of the image.")
+           "                     root path and the name of the image.\n"
+           "@param num_threads   Number of threads to read the images in "
+           "parallel.\n"
+           "@param min_image_size  If positive, JPEG images are decoded at "
+           "the lowest\n"
+           "                     reduced resolution whose maximum dimension is "
+           "at\n"
+           "                     least the given size.")
       .def("create_image_dirs",
            &Reconstruction::CreateImageDirs,
            "Create all image sub-directories in the given path.")
@@ -242,17 +336,18 @@ void BindReconstruction(py::module& m) {
              return ss.str();
            })
       .def("summary", [](const Reconstruction& self) {
+        const ReconstructionStatistics statistics = self.ComputeStatistics();
         std::stringstream ss;
         ss << "Reconstruction:"
            << "\n\tnum_reg_images = " << self.NumRegImages()
            << "\n\tnum_cameras = " << self.NumCameras()
            << "\n\tnum_points3D = " << self.NumPoints3D()
-           << "\n\tnum_observations = " << self.ComputeNumObservations()
-           << "\n\tmean_track_length = " << self.ComputeMeanTrackLength()
+           << "\n\tnum_observations = " << statistics.num_observations
+           << "\n\tmean_track_length = " << statistics.mean_track_length
            << "\n\tmean_observations_per_image = "
-           << self.ComputeMeanObservationsPerRegImage()
+           << statistics.mean_observations_per_reg_image
            << "\n\tmean_reprojection_error = "
-           << self.ComputeMeanReprojectionError();
+           << statistics.mean_reprojection_error;
         return ss.str();
       });
 }
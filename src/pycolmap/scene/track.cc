@@ -37,9 +37,13 @@ void BindTrack(py::module& m) {
         track->AddElements(elements);
         return track;
       }))
-      .def_property("elements",
-                    py::overload_cast<>(&Track::Elements),
-                    &Track::SetElements)
+      .def_property(
+          "elements",
+          [](const Track& self) {
+            return std::vector<TrackElement>(self.Elements().begin(),
+                                             self.Elements().end());
+          },
+          &Track::SetElements)
       .def("length", &Track::Length, "Track Length.")
       .def("add_element",
            py::overload_cast<image_t, point2D_t>(&Track::AddElement),
@@ -51,7 +55,10 @@ void BindTrack(py::module& m) {
       .def(
           "add_element",
           py::overload_cast<const image_t, const point2D_t>(&Track::AddElement))
-      .def("add_elements", &Track::AddElements, "Add TrackElement list.")
+      .def("add_elements",
+           py::overload_cast<const std::vector<TrackElement>&>(
+               &Track::AddElements),
+           "Add TrackElement list.")
       .def("remove",
            py::overload_cast<size_t>(&Track::DeleteElement),
            "index"_a,
@@ -4,6 +4,7 @@
 #include "colmap/scene/image.h"
 #include "colmap/scene/point2d.h"
 #include "colmap/scene/point3d.h"
+#include "colmap/util/slot_map.h"
 #include "colmap/util/types.h"
 
 #include <pybind11/eigen.h>
@@ -21,5 +22,5 @@ PYBIND11_MAKE_OPAQUE(ImageMap);
 using CameraMap = std::unordered_map<camera_t, Camera>;
 PYBIND11_MAKE_OPAQUE(CameraMap);
 
-using Point3DMap = std::unordered_map<point3D_t, Point3D>;
+using Point3DMap = SlotMap<point3D_t, Point3D>;
 PYBIND11_MAKE_OPAQUE(Point3DMap);
@@ -123,6 +123,17 @@ void BindIncrementalMapperOptions(py::module& m) {
                      &Opts::abs_pose_refine_extra_params,
                      "Whether to estimate the extra parameters in absolute "
                      "pose estimation.")
+      .def_readwrite("abs_pose_use_position_prior",
+                     &Opts::abs_pose_use_position_prior,
+                     "Whether to seed the absolute pose estimation from the "
+                     "position priors in the database and only fall back to "
+                     "the full RANSAC, if the seeded pose has too few "
+                     "inliers.")
+      .def_readwrite("abs_pose_position_prior_max_error",
+                     &Opts::abs_pose_position_prior_max_error,
+                     "Maximum distance between the aligned projection centers "
+                     "and the position priors of the registered images, in "
+                     "the unit of the priors.")
       .def_readwrite("local_ba_num_images",
                      &Opts::local_ba_num_images,
                      "Number of images to optimize in local bundle adjustment.")
@@ -190,7 +201,8 @@ void BindIncrementalMapperImpl(py::module& m) {
       .def_readwrite("num_filtered_observations",
                      &LocalBAReport::num_filtered_observations)
       .def_readwrite("num_adjusted_observations",
-                     &LocalBAReport::num_adjusted_observations);
+                     &LocalBAReport::num_adjusted_observations)
+      .def_readwrite("mean_reproj_drift", &LocalBAReport::mean_reproj_drift);
   MakeDataclass(PyLocalBAReport);
 
   // bind incremental mapper
@@ -204,6 +216,7 @@ void BindIncrementalMapperImpl(py::module& m) {
       .def("end_reconstruction",
            &IncrementalMapper::EndReconstruction,
            "discard"_a)
+      .def("add_images", &IncrementalMapper::AddImages, "image_ids"_a)
       .def(
           "find_initial_image_pair",
           [](IncrementalMapper& self,
@@ -290,6 +303,11 @@ void BindIncrementalMapperImpl(py::module& m) {
            &IncrementalMapper::AdjustGlobalBundle,
            "options"_a,
            "ba_options"_a)
+      .def("adjust_partial_global_bundle",
+           &IncrementalMapper::AdjustPartialGlobalBundle,
+           "options"_a,
+           "ba_options"_a,
+           "image_ids"_a)
       .def("iterative_global_refinement",
            &IncrementalMapper::IterativeGlobalRefinement,
            "max_num_refinements"_a,
@@ -313,6 +331,9 @@ void BindIncrementalMapperImpl(py::module& m) {
                              &IncrementalMapper::NumRegImagesPerCamera)
       .def("num_total_reg_images", &IncrementalMapper::NumTotalRegImages)
       .def("num_shared_reg_images", &IncrementalMapper::NumSharedRegImages)
+      .def("local_bundle_drift", &IncrementalMapper::LocalBundleDrift)
+      .def("local_bundle_drift_image_ids",
+           &IncrementalMapper::LocalBundleDriftImageIds)
       .def("get_modified_points3D", &IncrementalMapper::GetModifiedPoints3D)
       .def("clear_modified_points3D",
            &IncrementalMapper::ClearModifiedPoints3D);
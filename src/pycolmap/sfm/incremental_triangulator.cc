@@ -51,6 +51,11 @@ void BindIncrementalTriangulator(py::module& m) {
           "re_max_trials",
           &Opts::re_max_trials,
           "Maximum number of trials to re-triangulate an image pair.")
+      .def_readwrite("re_min_pose_change",
+                     &Opts::re_min_pose_change,
+                     "Minimum change in degrees of the relative pose of an "
+                     "image pair since its last trial to re-triangulate it "
+                     "again, unless its triangulated correspondences changed.")
       .def_readwrite(
           "min_angle",
           &Opts::min_angle,
@@ -69,7 +74,11 @@ void BindIncrementalTriangulator(py::module& m) {
       .def_readwrite("max_extra_param",
                      &Opts::max_extra_param,
                      "The threshold used to filter and ignore images with "
-                     "degenerate intrinsics.");
+                     "degenerate intrinsics.")
+      .def_readwrite("num_threads",
+                     &Opts::num_threads,
+                     "The number of threads used to complete and merge tracks. "
+                     "The results do not depend on the number of threads.");
   MakeDataclass(PyOpts);
 
   // TODO: Add bindings for GetModifiedPoints3D.
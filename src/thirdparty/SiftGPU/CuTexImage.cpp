@@ -198,6 +198,12 @@ void CuTexImage::CopyFromHost(const void * buf)
 	cudaMemcpy( _cuData, buf, _imgWidth * _imgHeight * _numChannel * sizeof(float), cudaMemcpyHostToDevice);
 }
 
+void CuTexImage::CopyFromDevice(const CuTexImage& src)
+{
+	if(_cuData == NULL || src._cuData == NULL) return;
+	cudaMemcpy(_cuData, src._cuData, _imgWidth * _imgHeight * _numChannel * sizeof(float), cudaMemcpyDeviceToDevice);
+}
+
 void CuTexImage::CopyToHost(void * buf)
 {
 	if(_cuData == NULL) return;
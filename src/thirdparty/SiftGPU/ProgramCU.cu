@@ -1693,7 +1693,7 @@ void ProgramCU::MultiplyDescriptorG(CuTexImage* des1, CuTexImage* des2,
 #define ROWMATCH_BLOCK_WIDTH 32
 #define ROWMATCH_BLOCK_HEIGHT 1
 
-void __global__  RowMatch_Kernel(int*d_dot, int* d_result, int num2, float distmax, float ratiomax)
+void __global__  RowMatch_Kernel(int*d_dot, int* d_result, int3* d_best, int num2, float distmax, float ratiomax)
 {
 #if ROWMATCH_BLOCK_HEIGHT == 1
 	__shared__ int dotmax[ROWMATCH_BLOCK_WIDTH];
@@ -1742,7 +1742,11 @@ void __global__  RowMatch_Kernel(int*d_dot, int* d_result, int num2, float distm
 		}
 		__syncthreads();
 	}
-	if(threadIdx.x == 0)
+	if(threadIdx.x == 0 && d_best)
+	{
+		d_best[row] = make_int3(dotmax[0], dotidx[0], dotnxt[0]);
+	}
+	else if(threadIdx.x == 0)
 	{
 		float dist =  acos(min(dotmax[0] * 0.000003814697265625f, 1.0));
 		float distn = acos(min(dotnxt[0] * 0.000003814697265625f, 1.0));
@@ -1760,12 +1764,22 @@ void ProgramCU::GetRowMatch(CuTexImage* texDot, CuTexImage* texMatch, float dist
 	dim3 grid(1, num1/ROWMATCH_BLOCK_HEIGHT);
 	dim3 block(ROWMATCH_BLOCK_WIDTH, ROWMATCH_BLOCK_HEIGHT);
 	RowMatch_Kernel<<<grid, block>>>((int*)texDot->_cuData,
-		(int*)texMatch->_cuData, num2, distmax, ratiomax);
+		(int*)texMatch->_cuData, NULL, num2, distmax, ratiomax);
+}
+
+void ProgramCU::GetRowBestMatch(CuTexImage* texDot, CuTexImage* texBest)
+{
+	int num1 = texDot->GetImgHeight();
+	int num2 = texDot->GetImgWidth();
+	dim3 grid(1, num1/ROWMATCH_BLOCK_HEIGHT);
+	dim3 block(ROWMATCH_BLOCK_WIDTH, ROWMATCH_BLOCK_HEIGHT);
+	RowMatch_Kernel<<<grid, block>>>((int*)texDot->_cuData,
+		NULL, (int3*)texBest->_cuData, num2, 0, 0);
 }
 
 #define COLMATCH_BLOCK_WIDTH 32
 
-void __global__  ColMatch_Kernel(int3*d_crt, int* d_result, int height, int num2, float distmax, float ratiomax)
+void __global__  ColMatch_Kernel(int3*d_crt, int* d_result, int3* d_best, int height, int num2, float distmax, float ratiomax)
 {
 	int col = COLMATCH_BLOCK_WIDTH * blockIdx.x + threadIdx.x;
 	if(col >= num2) return;
@@ -1779,6 +1793,12 @@ void __global__  ColMatch_Kernel(int3*d_crt, int* d_result, int height, int num2
 			make_int3(result.x, result.y, max(result.z, temp.x));
 	}
 
+	if(d_best)
+	{
+		d_best[col] = result;
+		return;
+	}
+
 	float dist =  acos(min(result.x * 0.000003814697265625f, 1.0));
 	float distn = acos(min(result.z * 0.000003814697265625f, 1.0));
 		//float ratio = dist / distn;
@@ -1793,7 +1813,16 @@ void ProgramCU::GetColMatch(CuTexImage* texCRT, CuTexImage* texMatch, float dist
 	//texCRT->BindTexture(texCT);
     dim3 grid((num2 + COLMATCH_BLOCK_WIDTH -1) / COLMATCH_BLOCK_WIDTH);
     dim3 block(COLMATCH_BLOCK_WIDTH);
-	ColMatch_Kernel<<<grid, block>>>((int3*)texCRT->_cuData, (int*) texMatch->_cuData, height, num2, distmax, ratiomax);
+	ColMatch_Kernel<<<grid, block>>>((int3*)texCRT->_cuData, (int*) texMatch->_cuData, NULL, height, num2, distmax, ratiomax);
+}
+
+void ProgramCU::GetColBestMatch(CuTexImage* texCRT, CuTexImage* texBest)
+{
+	int height = texCRT->GetImgHeight();
+	int num2 = texCRT->GetImgWidth();
+    dim3 grid((num2 + COLMATCH_BLOCK_WIDTH -1) / COLMATCH_BLOCK_WIDTH);
+    dim3 block(COLMATCH_BLOCK_WIDTH);
+	ColMatch_Kernel<<<grid, block>>>((int3*)texCRT->_cuData, NULL, (int3*)texBest->_cuData, height, num2, 0, 0);
 }
 
 #endif
@@ -67,6 +67,9 @@ public:
 		float* H, float hdistmax, float* F, float fdistmax);
 	static void GetRowMatch(CuTexImage* texDot, CuTexImage* texMatch, float distmax, float ratiomax);
 	static void GetColMatch(CuTexImage* texCRT, CuTexImage* texMatch, float distmax, float ratiomax);
+	//best and second best dot product and index of the best match, as int3
+	static void GetRowBestMatch(CuTexImage* texDot, CuTexImage* texBest);
+	static void GetColBestMatch(CuTexImage* texCRT, CuTexImage* texBest);
 };
 
 #endif
@@ -64,6 +64,8 @@ typedef unsigned __int64 uint64_t;
 #include <stdint.h>
 #endif
 
+#include <stddef.h>
+
 ///////////////////////////////////////////////////////////////////
 //clss SiftParam
 //description: SIFT parameters
@@ -317,6 +319,9 @@ public:
 	SIFTGPU_EXPORT virtual void SetDescriptors(int index, int num, const float* descriptors, int id  = -1);
 	//Option 2 unsigned char descriptors. They must be already normalized to 512
 	SIFTGPU_EXPORT virtual void SetDescriptors(int index, int num, const unsigned char * descriptors, int id = -1);
+	//Keep the descriptors of recently set ids (!= -1) in device memory of at most the given
+	//number of bytes, such that setting them again is a copy on the device. Only CUDA.
+	SIFTGPU_EXPORT virtual void SetDescriptorCacheSize(size_t max_num_bytes);
 
 	//match two sets of features, the function RETURNS the number of matches.
 	//Given two normalized descriptor d1,d2, the distance here is acos(d1 *d2);
@@ -349,6 +354,14 @@ public:
 					float hdistmax = 32,    //threshold for |H * x1 - x2|_2
 					float fdistmax = 16,    //threshold for sampson error of x2'FX1
 					int mutual_best_match = 1); //mutual best or one wayx
+
+	//compute the best match of every feature in the first set (and of every
+	//feature in the second set, if col_best is not NULL) without applying any
+	//threshold. Each entry is [best dot product, index of the best match,
+	//second best dot product], where the dot products are scaled by 512 * 512.
+	//Used to match feature sets that exceed the capacity block by block.
+	//RETURNS 1 on success, -1 on failure and 0 if not supported (GLSL).
+	SIFTGPU_EXPORT virtual int  GetSiftMatchCandidates(int row_best[][3], int col_best[][3] = NULL);
 };
 
 typedef SiftGPU::SiftKeypoint SiftKeypoint;
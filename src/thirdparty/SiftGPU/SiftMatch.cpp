@@ -668,6 +668,11 @@ void SiftMatchGPU::SetDescriptors(int index, int num, const float* descriptors,
 	__matcher->SetDescriptors(index, num, descriptors, id);
 }
 
+void SiftMatchGPU::SetDescriptorCacheSize(size_t max_num_bytes)
+{
+	if(__matcher) __matcher->SetDescriptorCacheSize(max_num_bytes);
+}
+
 void SiftMatchGPU::SetFeautreLocation(int index, const float* locations, int gap)
 {
 	__matcher->SetFeautreLocation(index, locations, gap);
@@ -693,6 +698,11 @@ int  SiftMatchGPU::GetSiftMatch(int max_match, uint32_t match_buffer[][2], float
 	return __matcher->GetSiftMatch(max_match, match_buffer, distmax, ratiomax, mutual_best_match);
 }
 
+int  SiftMatchGPU::GetSiftMatchCandidates(int row_best[][3], int col_best[][3])
+{
+	return __matcher ? __matcher->GetSiftMatchCandidates(row_best, col_best) : 0;
+}
+
 SiftMatchGPU* CreateNewSiftMatchGPU(int max_sift)
 {
 	return new SiftMatchGPU(max_sift);
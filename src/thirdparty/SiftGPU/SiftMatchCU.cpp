@@ -50,6 +50,8 @@ SiftMatchCU::SiftMatchCU(int max_sift) : SiftMatchGPU() {
   _have_loc[0] = _have_loc[1] = 0;
   __max_sift = max_sift <= 0 ? 4096 : ((max_sift + 31) / 32 * 32);
   _initialized = 0;
+  _cache_num_bytes = 0;
+  _cache_max_num_bytes = 0;
 }
 
 bool SiftMatchCU::Allocate(int max_sift, int mbm) {
@@ -108,7 +110,54 @@ void SiftMatchCU::SetDescriptors(int index, int num,
   if (num > __max_sift) num = __max_sift;
   _num_sift[index] = num;
   _texDes[index].InitTexture(8 * num, 1, 4);
+  if (id != -1 && LoadCachedDescriptors(index, id)) return;
   _texDes[index].CopyFromHost((void*)descriptors);
+  if (id != -1) CacheDescriptors(index, id);
+}
+
+void SiftMatchCU::SetDescriptorCacheSize(size_t max_num_bytes) {
+  _cache_max_num_bytes = max_num_bytes;
+  while (_cache_num_bytes > _cache_max_num_bytes) {
+    _cache_num_bytes -= 128 * static_cast<size_t>(_cache.back().num);
+    _cache_index.erase(_cache.back().id);
+    _cache.pop_back();
+  }
+}
+
+bool SiftMatchCU::LoadCachedDescriptors(int index, int id) {
+  const auto it = _cache_index.find(id);
+  if (it == _cache_index.end() || it->second->num != _num_sift[index]) {
+    return false;
+  }
+  _cache.splice(_cache.begin(), _cache, it->second);
+  _texDes[index].CopyFromDevice(*_cache.front().tex);
+  return true;
+}
+
+void SiftMatchCU::CacheDescriptors(int index, int id) {
+  const size_t num_bytes = 128 * static_cast<size_t>(_num_sift[index]);
+  if (num_bytes > _cache_max_num_bytes) return;
+  const auto it = _cache_index.find(id);
+  if (it != _cache_index.end()) {
+    // The descriptors of the id changed.
+    _cache_num_bytes -= 128 * static_cast<size_t>(it->second->num);
+    _cache.erase(it->second);
+    _cache_index.erase(it);
+  }
+  while (_cache_num_bytes + num_bytes > _cache_max_num_bytes) {
+    _cache_num_bytes -= 128 * static_cast<size_t>(_cache.back().num);
+    _cache_index.erase(_cache.back().id);
+    _cache.pop_back();
+  }
+  CachedDescriptors cached;
+  cached.id = id;
+  cached.num = _num_sift[index];
+  cached.tex.reset(new CuTexImage());
+  if (!cached.tex->InitTexture(8 * cached.num, 1, 4)) return;
+  cached.tex->CopyFromDevice(_texDes[index]);
+  _cache.push_front(std::move(cached));
+  _cache_index[id] = _cache.begin();
+  _cache_num_bytes += num_bytes;
 }
 
 void SiftMatchCU::SetDescriptors(int index, int num, const float* descriptors,
@@ -167,6 +216,28 @@ int SiftMatchCU::GetSiftMatch(int max_match, uint32_t match_buffer[][2],
   return GetBestMatch(max_match, match_buffer, distmax, ratiomax, mbm);
 }
 
+int SiftMatchCU::GetSiftMatchCandidates(int row_best[][3], int col_best[][3]) {
+  if (_initialized == 0) return 0;
+  if (_num_sift[0] <= 0 || _num_sift[1] <= 0) return 0;
+  ProgramCU::MultiplyDescriptor(_texDes, _texDes + 1, &_texDot,
+                                (col_best ? &_texCRT : NULL));
+  _texMatch[0].InitTexture(_num_sift[0], 1, 3);
+  ProgramCU::GetRowBestMatch(&_texDot, _texMatch);
+  _texMatch[0].CopyToHost(row_best);
+  if (col_best) {
+    _texMatch[1].InitTexture(_num_sift[1], 1, 3);
+    ProgramCU::GetColBestMatch(&_texCRT, _texMatch + 1);
+    _texMatch[1].CopyToHost(col_best);
+  }
+
+  cudaError_t error = cudaGetLastError();
+  if (error != cudaSuccess) {
+    return -1;
+  }
+
+  return 1;
+}
+
 int SiftMatchCU::GetBestMatch(int max_match, uint32_t match_buffer[][2],
                               float distmax, float ratiomax, int mbm) {
   sift_buffer.resize(_num_sift[0] + _num_sift[1]);
@@ -25,6 +25,10 @@
 #define CU_SIFT_MATCH_H
 #if defined(CUDA_SIFTGPU_ENABLED)
 
+#include <list>
+#include <memory>
+#include <unordered_map>
+
 class CuTexImage;
 class SiftMatchCU:public SiftMatchGPU
 {
@@ -45,8 +49,22 @@ private:
 	//gpu parameter
 	int _initialized;
 	vector<int> sift_buffer;
+
+	//descriptors of recently set ids, the most recently used first
+	struct CachedDescriptors
+	{
+		int id;
+		int num;
+		std::unique_ptr<CuTexImage> tex;
+	};
+	std::list<CachedDescriptors> _cache;
+	std::unordered_map<int, std::list<CachedDescriptors>::iterator> _cache_index;
+	size_t _cache_num_bytes;
+	size_t _cache_max_num_bytes;
 private:
 	int  GetBestMatch(int max_match, uint32_t match_buffer[][2], float distmax, float ratiomax, int mbm);
+	bool LoadCachedDescriptors(int index, int id);
+	void CacheDescriptors(int index, int id);
 public:
 	SiftMatchCU(int max_sift);
 	virtual ~SiftMatchCU(){};
@@ -55,10 +73,12 @@ public:
 	void SetMaxSift(int max_sift) override;
 	void SetDescriptors(int index, int num, const unsigned char * descriptor, int id = -1);
 	void SetDescriptors(int index, int num, const float * descriptor, int id = -1);
+	void SetDescriptorCacheSize(size_t max_num_bytes) override;
 	void SetFeautreLocation(int index, const float* locatoins, int gap);
 	int  GetSiftMatch(int max_match, uint32_t match_buffer[][2], float distmax, float ratiomax, int mbm);
 	int  GetGuidedSiftMatch(int max_match, uint32_t match_buffer[][2], float* H, float* F,
 									 float distmax, float ratiomax, float hdistmax, float fdistmax, int mbm);
+	int  GetSiftMatchCandidates(int row_best[][3], int col_best[][3]);
     //////////////////////////////
     static int  CheckCudaDevice(int device);
 };